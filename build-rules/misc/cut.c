@@ -157,3 +157,171 @@ int cut_main(int argc, char **argv)
 
 }
 
+
+static void _bench_mem(struct cut_bench_mem *mem, int restart_peak)
+{
+    if (NULL == cut.bench_mem_stats || 0 != cut.bench_mem_stats(mem, restart_peak)) {
+        memset(mem, 0, sizeof(struct cut_bench_mem));
+    }
+}
+
+void cut_bench_reset(struct cut_bench *bench)
+{
+    struct cut_bench_mem mem;
+
+    _bench_mem(&mem, 1);
+    bench->allocs_start = mem.allocs;
+    bench->alloc_bytes_start = mem.bytes;
+    bench->in_use_start = mem.in_use;
+    bench->start_ms = cut_uptime_ms();
+}
+
+/* ms spent by n ops, adds what they allocated to allocs and bytes and keeps the peak over in use before */
+static uint64_t _bench_run(struct cut_bench *b, uint32_t n, uint64_t *allocs, uint64_t *bytes, uint32_t *peak)
+{
+    struct cut_bench_mem mem;
+    uint64_t elapsed;
+
+    cut_bench_reset(b);
+    b->run(b, n);
+    elapsed = cut_uptime_ms() - b->start_ms;
+    _bench_mem(&mem, 0);
+    *allocs += mem.allocs - b->allocs_start;
+    *bytes += mem.bytes - b->alloc_bytes_start;
+    if (mem.peak > b->in_use_start && mem.peak - b->in_use_start > *peak) {
+        *peak = mem.peak - b->in_use_start;
+    }
+
+    return elapsed;
+}
+
+/* runs it until warm and n ops last a sample, returns n */
+static uint32_t _bench_calibrate(struct cut_bench *b)
+{
+    uint64_t start = cut_uptime_ms();
+    uint64_t elapsed, allocs = 0, bytes = 0;
+    uint32_t n = 1, next, peak = 0;
+
+    for (;;) {
+        elapsed = _bench_run(b, n, &allocs, &bytes, &peak);
+        if (elapsed >= CUT_BENCH_SAMPLE_MS && cut_uptime_ms() - start >= CUT_BENCH_WARMUP_MS) {
+            break;
+        }
+        if (elapsed >= CUT_BENCH_SAMPLE_MS) {
+            continue;
+        }
+
+        /* aim 20% past a sample, growing at most 100 times a round */
+        next = (0 == elapsed) ? n * 100 : (uint32_t)((uint64_t)n * CUT_BENCH_SAMPLE_MS * 6 / 5 / elapsed);
+        if (next > n * 100 || next < n) {
+            next = n * 100;
+        }
+        if (next <= n) {
+            next = n + 1;
+        }
+        if (next > 0x7FFFFFFF / 100) {
+            break;
+        }
+        n = next;
+    }
+
+    return n;
+}
+
+static void _bench_sort(uint64_t *v, int cnt)
+{
+    int i, j;
+    uint64_t t;
+
+    for (i = 1; i < cnt; i++) {
+        t = v[i];
+        for (j = i; j > 0 && v[j - 1] > t; j--) {
+            v[j] = v[j - 1];
+        }
+        v[j] = t;
+    }
+}
+
+static void _bench_filter(int argc, char **argv)
+{
+    int i = 0;
+    struct cut_bench *b = NULL;
+
+    if (argc == 2 && 0 == strcmp(argv[1], "all")) {
+        return;
+    }
+
+    for (i = 0; i < cut.bcnt_total; i++) {
+        b = cut.blist[i];
+        if ((argc == 2 && (NULL == strstr(b->sname, argv[1]))) ||
+            (argc == 3 && (NULL == strstr(b->sname, argv[1]) || NULL == strstr(b->cname, argv[2])))) {
+            b->skip = 1;
+        }
+    }
+}
+
+/*
+ * one JSON object a line for each benchmark, times in ns per op:
+ * {"suite":"s","bench":"b","n":1000,"samples":50,"min_ns":1,"median_ns":1,"p99_ns":1,
+ *  "mb_per_s":1.0,"allocs_per_op":0.0,"bytes_per_op":0.0,"peak_bytes":0}
+ * peak_bytes is the most heap a sample held over what was in use before it
+ */
+int cut_bench_main(int argc, char **argv)
+{
+    static uint64_t samples[CUT_BENCH_SAMPLES];
+    struct cut_bench *b;
+    uint64_t allocs, bytes, total_ms;
+    uint32_t n, peak;
+    int i, k;
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "--list")) {
+        for (i = 0; i < cut.bcnt_total; i++) {
+            cut_printf("  [%02d] %s.%s\n", i + 1, cut.blist[i]->sname, cut.blist[i]->cname);
+        }
+        return 0;
+    }
+    if (argc >= 2 && 0 == strcmp(argv[1], "--help")) {
+        cut_printf("Usage: %s [--list] S-FILTER [B-FILTER]\n\n" \
+                   "S-FILTER:    suite name filter, e.g. '%s all' means run all suites\n" \
+                   "B-FILTER:    benchmark name filter\n", argv[0], argv[0]);
+        return 0;
+    }
+
+    _bench_filter(argc, argv);
+
+    for (i = 0; i < cut.bcnt_total; i++) {
+        b = cut.blist[i];
+        if (b->skip) {
+            continue;
+        }
+
+        b->bytes = 0;
+        n = _bench_calibrate(b);
+
+        allocs = 0;
+        bytes = 0;
+        total_ms = 0;
+        peak = 0;
+        for (k = 0; k < CUT_BENCH_SAMPLES; k++) {
+            samples[k] = _bench_run(b, n, &allocs, &bytes, &peak);
+            total_ms += samples[k];
+            samples[k] = samples[k] * 1000000 / n;
+        }
+        _bench_sort(samples, CUT_BENCH_SAMPLES);
+
+        cut_printf("{\"suite\":\"%s\",\"bench\":\"%s\",\"n\":%u,\"samples\":%d,"
+                   "\"min_ns\":%llu,\"median_ns\":%llu,\"p99_ns\":%llu,\"mb_per_s\":%.2f,"
+                   "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.2f,\"peak_bytes\":%u}\n",
+                   b->sname, b->cname, (unsigned int)n, CUT_BENCH_SAMPLES,
+                   (unsigned long long)samples[0],
+                   (unsigned long long)samples[CUT_BENCH_SAMPLES / 2],
+                   (unsigned long long)samples[(CUT_BENCH_SAMPLES * 99 + 99) / 100 - 1],
+                   (0 == total_ms) ? 0.0 : (double)b->bytes * n * CUT_BENCH_SAMPLES / 1000 / (double)total_ms,
+                   (double)allocs / n / CUT_BENCH_SAMPLES,
+                   (double)bytes / n / CUT_BENCH_SAMPLES,
+                   (unsigned int)peak);
+        fflush(stdout);
+    }
+
+    return 0;
+}
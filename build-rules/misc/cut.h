@@ -11,16 +11,32 @@ extern "C" {
 #include <setjmp.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
 
 #define CUT_CASE_MAX_CNT        (200)
 #define CUT_MSG_MAX_LEN         (256)
+#define CUT_BENCH_MAX_CNT       (100)
+
+/* warm-up before the samples, each sample at least CUT_BENCH_SAMPLE_MS long to keep the ms clock precise */
+#ifndef CUT_BENCH_WARMUP_MS
+#define CUT_BENCH_WARMUP_MS     (200)
+#endif
+#ifndef CUT_BENCH_SAMPLE_MS
+#define CUT_BENCH_SAMPLE_MS     (20)
+#endif
+#ifndef CUT_BENCH_SAMPLES
+#define CUT_BENCH_SAMPLES       (50)
+#endif
 
 #define cut_printf              printf
 #define cut_snprintf            snprintf
 #define cut_malloc              malloc
 #define cut_free                free
+#define cut_uptime_ms           HAL_UptimeMs
 
+extern uint64_t cut_uptime_ms(void);
 extern int cut_main(int argc, char **argv);
+extern int cut_bench_main(int argc, char **argv);
 extern struct cut_runtime cut;
 
 struct cut_case {
@@ -33,6 +49,26 @@ struct cut_case {
     int skip;
 };
 
+struct cut_bench {
+    const char *sname;
+    const char *cname;
+    void (*run)(struct cut_bench *, uint32_t);
+    uint32_t bytes;                 /* processed per op, for the throughput */
+    uint64_t start_ms;
+    uint32_t allocs_start;
+    uint32_t alloc_bytes_start;
+    uint32_t in_use_start;
+    int skip;
+};
+
+/* allocations made so far, and the most in use since the peak was last restarted */
+struct cut_bench_mem {
+    uint32_t allocs;
+    uint32_t bytes;
+    uint32_t in_use;
+    uint32_t peak;
+};
+
 struct cut_runtime {
     jmp_buf jmpbuf;
     int     scnt_total;
@@ -43,6 +79,10 @@ struct cut_runtime {
     struct  cut_case *clist[CUT_CASE_MAX_CNT];
     struct  cut_case *ccur;
     char    *cerrmsg[CUT_CASE_MAX_CNT];
+    int     bcnt_total;
+    struct  cut_bench *blist[CUT_BENCH_MAX_CNT];
+    /* set it for allocs/op, bytes/op and peak heap, restarts the peak from in_use if asked, 0 on success */
+    int     (*bench_mem_stats)(struct cut_bench_mem *mem, int restart_peak);
 };
 
 #define CUT_CASE_RUNNER(sname, cname)  cut_##sname##_##cname##_run
@@ -50,6 +90,8 @@ struct cut_runtime {
 #define CUT_CASE_DATA(sname)           cut_##sname##_data
 #define CUT_CASE_SETUP(sname)          cut_##sname##_setup
 #define CUT_CASE_TEARDOWN(sname)       cut_##sname##_teardown
+#define CUT_BENCH_RUNNER(sname, cname) cut_bench_##sname##_##cname##_run
+#define CUT_BENCH_NAME(sname, cname)   cut_bench_##sname##_##cname
 
 #define DATA(sname) \
     struct CUT_CASE_DATA(sname)
@@ -157,6 +199,74 @@ struct cut_runtime {
         }                                                 \
     } while (0)
 
+/*
+ * @brief: construct a benchmark structor and a benchmark runner, which runs
+ *         the operation n times; cut_bench_main() finds n for a sample to last
+ *         CUT_BENCH_SAMPLE_MS and prints min/median/p99 of the time per op
+ * @sname: suite name
+ * @cname: benchmark name
+ * e.g.
+    BENCH(mysuite, mybench1) {
+        uint32_t i;
+        char *buf = malloc(1024);
+
+        BENCH_SET_BYTES(1024);
+        BENCH_RESET_TIMER();
+        for (i = 0; i < n; i++) {
+            my_checksum(buf, 1024);
+        }
+        free(buf);
+    }
+ */
+#define BENCH(sname, cname) \
+    static void CUT_BENCH_RUNNER(sname, cname)(struct cut_bench *bench, uint32_t n); \
+    static struct cut_bench CUT_BENCH_NAME(sname, cname) = \
+            { \
+              #sname, #cname, CUT_BENCH_RUNNER(sname, cname), 0, 0, 0, 0, 0, 0}; \
+    static void CUT_BENCH_RUNNER(sname, cname)(struct cut_bench *bench, uint32_t n)
+
+/* bytes one op processes, reported as MB/s */
+#define BENCH_SET_BYTES(b)       (bench->bytes = (b))
+
+/* leaves out of the sample the time and allocations spent so far in the runner */
+#define BENCH_RESET_TIMER()      cut_bench_reset(bench)
+
+extern void cut_bench_reset(struct cut_bench *bench);
+
+/*
+ * @brief: construct a benchmark suite by adding benchmark(s)
+ * @sname: suite name
+ * e.g.
+    BENCH_SUITE(mysuite) = {
+        ADD_BENCH(mysuite, mybench1),
+        ADD_BENCH_NULL
+    };
+ */
+#define BENCH_SUITE(sname) struct cut_bench *cut_bench_suite_##sname[]
+
+#define ADD_BENCH(sname, cname)  &CUT_BENCH_NAME(sname, cname)
+#define ADD_BENCH_NULL           (struct cut_bench*)(NULL)
+
+/*
+ * @brief: add a benchmark suite into benchmark list
+ * @sname: suite name
+ */
+#define ADD_BENCH_SUITE(sname)                                 \
+    do {                                                       \
+        int i = 0;                                             \
+        extern struct cut_bench *cut_bench_suite_##sname[];    \
+        struct cut_bench *b = cut_bench_suite_##sname[i];      \
+        while (b) {                                            \
+            if (cut.bcnt_total >= CUT_BENCH_MAX_CNT) {         \
+                cut_printf("reaches maximum bench count:%d\n", \
+                           CUT_BENCH_MAX_CNT);                 \
+                break;                                         \
+            }                                                  \
+            *(cut.blist + cut.bcnt_total++) = b;               \
+            b = *(cut_bench_suite_##sname + (++i));            \
+        }                                                      \
+    } while (0)
+
 
 #define TRY                if (0 == setjmp(cut.jmpbuf))
 #define EXCEPT             else
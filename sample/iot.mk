@@ -84,10 +84,16 @@ endif
 
 
 ifneq (,$(filter -DDM_ENABLED,$(CFLAGS)))   
+HDR_REFS                  += src/dm
 TARGET                    += linkkit-example 
 SRCS_linkkit-example      := linkkit/src/linkkit_export.c \
                              linkkit/src/lite_queue.c \
+                             linkkit/src/lite_ring.c \
                              linkkit/samples/linkkit_sample.c
+TARGET                    += linkkit-tsl-compiler
+SRCS_linkkit-tsl-compiler := linkkit/samples/linkkit_tsl_compiler.c
+TARGET                    += linkkit-tsl-codegen
+SRCS_linkkit-tsl-codegen  := linkkit/samples/linkkit_tsl_codegen.c
 endif
 
 ifneq (,$(filter -DMQTT_COMM_ENABLED,$(CFLAGS)))
@@ -95,3 +101,7 @@ TARGET              				+= mqtt_multi_region-example
 SRCS_mqtt_multi_region-example     := mqtt/mqtt_multi_region-example.c
 endif
 
+ifneq (,$(filter -DMBEDTLS_SHA1_PROCESS_ALT,$(CFLAGS)))
+# the sha blocks of mbedtls are in libiot_platform, which takes them from libiot_sdk
+LDFLAGS             += -liot_platform -liot_sdk
+endif
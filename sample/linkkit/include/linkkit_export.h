@@ -25,13 +25,25 @@ typedef struct _linkkit_ops {
     int (*thing_enable)(void *thing_id, void *ctx);
     int (*thing_disable)(void *thing_id, void *ctx);
 #ifdef RRPC_ENABLED
+    /* rrpc is 0, or the token of a rrpc request to pass to linkkit_answer_service. */
     int (*thing_call_service)(void *thing_id, char *service, int request_id, int rrpc, void *ctx);
 #else
     int (*thing_call_service)(void *thing_id, char *service, int request_id, void *ctx);
 #endif /* RRPC_ENABLED */
     int (*thing_prop_changed)(void *thing_id, char *property, void *ctx);
+    /* reply to linkkit_trigger_event_async, code is alink code of the reply, -1 when not replied in time. */
+    int (*thing_reply)(void *thing_id, int request_id, int code, void *ctx);
+#ifdef DM_BACKPRESSURE_ENABLED
+    /* a property post returned LINKKIT_WOULD_BLOCK before, posts go through again. */
+    int (*on_writable)(void *ctx);
+#endif /* DM_BACKPRESSURE_ENABLED */
 } linkkit_ops_t;
 
+#ifdef DM_BACKPRESSURE_ENABLED
+/* property post not sent as the connection is saturated, on_writable of linkkit_ops tells when to post again. */
+#define LINKKIT_WOULD_BLOCK DM_SEND_WOULD_BLOCK
+#endif /* DM_BACKPRESSURE_ENABLED */
+
 typedef enum _linkkit_loglevel {
     linkkit_loglevel_emerg = 0,
     linkkit_loglevel_crit,
@@ -52,7 +64,35 @@ typedef enum {
     linkkit_cloud_domain_max,
 } linkkit_cloud_domain_type_t;
 
+/* what to do with a new message when max_buffered_msg messages wait for linkkit_dispatch. */
+typedef enum {
+    linkkit_message_overflow_drop_newest = 0, /* new message is dropped, default. */
+    linkkit_message_overflow_drop_oldest,     /* oldest message waiting is dropped. */
+    linkkit_message_overflow_block,           /* wait till linkkit_dispatch frees a slot, only when dispatched by another thread than linkkit_yield. */
+
+    linkkit_message_overflow_max,
+} linkkit_message_overflow_policy_t;
+
+/* dispatch counters since linkkit_start, times in ms. */
+typedef struct {
+    unsigned int queue_depth;          /* messages buffered now, worker queues included. */
+    unsigned int dropped;              /* messages dropped or overwritten on overflow. */
+    unsigned int handled;              /* messages handed over to linkkit_ops. */
+    unsigned int wait_time_total_ms;   /* buffered till handler started. */
+    unsigned int wait_time_max_ms;
+    unsigned int handle_time_total_ms; /* spent in linkkit_ops handlers. */
+    unsigned int handle_time_max_ms;
+} linkkit_dispatch_stats_t;
+
 /* device info related operation */
+/* encoding of property and event posts. */
+typedef enum {
+    linkkit_payload_format_json = 0, /* default. */
+    linkkit_payload_format_cbor,     /* alink message as cbor(RFC 8949), published as raw data. */
+
+    linkkit_payload_format_max,
+} linkkit_payload_format_t;
+
 typedef enum {
     linkkit_deviceinfo_operate_update,
     linkkit_deviceinfo_operate_delete,
@@ -62,6 +102,7 @@ typedef enum {
 
 /**
  * @brief dispatch message of queue for further process.
+ *        if multi-thread enabled, messages are queued by cmp thread, and coalesced property posts due are sent here.
  *
  * @return int, 0 when success, -1 when fail.
  */
@@ -69,8 +110,9 @@ int linkkit_dispatch(void);
 
 /**
  * @brief start linkkit routines, and install callback funstions(async type for cloud connecting).
+ *        the phases of getting online are timed from here, LITE_startup_dump of lite-startup.h prints them.
  *
- * @param max_buffered_msg, specify max buffered message size.
+ * @param max_buffered_msg, specify max buffered message number, their slots are allocated here once.
  * @param ops, callback function struct to be installed.
  * @param get_tsl_from_cloud, config if device need to get tsl from cloud(!0) or local(0), if local selected, must invoke linkkit_set_tsl to tell tsl to dm after start complete.
  * @param log_level, config log level.
@@ -81,6 +123,40 @@ int linkkit_dispatch(void);
  */
 int linkkit_start(int max_buffered_msg, int get_tsl_from_cloud, linkkit_loglevel_t log_level, linkkit_ops_t *ops, linkkit_cloud_domain_type_t domain_type, void *user_context);
 
+/**
+ * @brief set what to do when a message arrives and max_buffered_msg messages are already buffered.
+ *        may be called before or after linkkit_start, messages are buffered in max_buffered_msg slots allocated by linkkit_start.
+ *
+ * @param policy, linkkit_message_overflow_drop_newest by default.
+ *
+ * @return int, 0 when success, -1 when fail.
+ */
+int linkkit_set_message_overflow_policy(linkkit_message_overflow_policy_t policy);
+
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+/**
+ * @brief run linkkit_ops handlers on worker threads instead of the linkkit_dispatch caller.
+ *        messages of one thing always go to the same worker, so they are handled in arriving order,
+ *        messages of different things may be handled concurrently, handlers must be thread safe.
+ *        call it after linkkit_start and before linkkit_yield, linkkit_dispatch has nothing to do afterwards.
+ *        every worker buffers up to max_buffered_msg messages, workers are stopped by linkkit_end.
+ *
+ * @param worker_number, number of worker threads, 1 to 8.
+ *
+ * @return int, 0 when success, -1 when fail.
+ */
+int linkkit_start_dispatch_workers(int worker_number);
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+
+/**
+ * @brief get dispatch counters, queue depth and handler latency.
+ *
+ * @param stats, filled with counters.
+ *
+ * @return int, 0 when success, -1 when fail.
+ */
+int linkkit_get_dispatch_stats(linkkit_dispatch_stats_t* stats);
+
 #ifdef SERVICE_OTA_ENABLED
 /**
  * @brief init fota service routines, and install callback funstions.
@@ -90,8 +166,36 @@ int linkkit_start(int max_buffered_msg, int get_tsl_from_cloud, linkkit_loglevel
  * @return int, 0 when success, -1 when fail.
  */
 int linkkit_fota_init(handle_service_fota_callback_fp_t callback_fp);
+/**
+ * @brief get the time to first byte, rates, stalls, retries and resumes of firmware download going on,
+ * or of the last one. the callback gets service_fota_callback_type_download_finished when it is over.
+ *
+ * @param stats, filled with the stats.
+ *
+ * @return int, 0 when success, -1 when fail.
+ */
+int linkkit_fota_get_stats(service_ota_stats_t* stats);
 #ifdef SERVICE_COTA_ENABLED
 int linkkit_cota_init(handle_service_cota_callback_fp_t callback_fp);
+/**
+ * @brief hand the values of json configs to stream_fp as they are downloaded by linkkit_invoke_cota_service(),
+ * instead of persisting the configs. a value may be as long as the buffer of linkkit_invoke_cota_service().
+ * after linkkit_cota_init().
+ *
+ * @param stream_fp, called for each value, NULL to persist configs again.
+ * @param ctx, handed to stream_fp.
+ *
+ * @return int, 0 when success, -1 when fail.
+ */
+int linkkit_cota_set_stream_callback(handle_service_cota_stream_fp_t stream_fp, void* ctx);
+/**
+ * @brief same as linkkit_fota_get_stats(), for the config download going on or the last one.
+ *
+ * @param stats, filled with the stats.
+ *
+ * @return int, 0 when success, -1 when fail.
+ */
+int linkkit_cota_get_stats(service_ota_stats_t* stats);
 #endif /**< SERVICE_COTA_ENABLED*/
 #endif /* SERVICE_OTA_ENABLED */
 
@@ -106,13 +210,28 @@ int linkkit_end();
 /**
  * @brief install user tsl.
  *
- * @param tsl, tsl string that contains json description for thing object.
+ * @param tsl, tsl string that contains json description for thing object,
+ *        or binary tsl made by linkkit-tsl-compiler, which must stay valid until the thing is deleted.
  * @param tsl_len, tsl string length.
  *
  * @return pointer to thing object, NULL when fails.
  */
 extern void* linkkit_set_tsl(const char* tsl, int tsl_len);
 
+/**
+ * @brief install several user tsls at once, like a gateway with its sub-devices.
+ *        tsls differing only in profile are parsed once, the others load the same template,
+ *        and their subscriptions are made after all things are created.
+ *
+ * @param tsls, tsl strings or binary tsls, same as linkkit_set_tsl.
+ * @param tsl_lens, length of each tsl.
+ * @param number, number of tsls.
+ * @param things, filled with thing object of each tsl, NULL for a tsl failed.
+ *
+ * @return number of things created, -1 when fail.
+ */
+extern int linkkit_set_tsls(const char* const* tsls, const int* tsl_lens, int number, void** things);
+
 /* patterns: */
 /* method:
  * set_property_/event_output_/service_output_value:
@@ -179,6 +298,136 @@ extern int linkkit_get_value(linkkit_method_get_t method_get, const void* thing_
                              void* value, char** value_str);
 
 
+/**
+ * @brief resolve property identifier to a handle once, so that linkkit_set_value_by_handle
+ *        and linkkit_get_value_by_handle do not parse identifier every call.
+ *        identifier format is the same as linkkit_set_value with linkkit_method_set_property_value.
+ *
+ * @param thing_id, pointer to thing object.
+ * @param identifier, property identifier, like "identifier1.identifier2" or "identifier[1]".
+ *
+ * @return property handle when success, NULL when fail.
+ *         handle should be released by linkkit_release_property_handle before thing destroyed.
+ */
+extern void* linkkit_resolve_property_handle(const void* thing_id, const char* identifier);
+
+/**
+ * @brief release property handle returned by linkkit_resolve_property_handle.
+ *
+ * @param handle, property handle.
+ *
+ * @return 0 when success, -1 when fail.
+ */
+extern int linkkit_release_property_handle(void* handle);
+
+/**
+ * @brief set property value by handle, value/value_str usage is the same as linkkit_set_value.
+ *
+ * @param handle, property handle.
+ * @param value, value to set.
+ * @param value_str, value to set in string format if value is null.
+ *
+ * @return 0 when success, -1 when fail.
+ */
+extern int linkkit_set_value_by_handle(const void* handle, const void* value, const char* value_str);
+
+/**
+ * @brief get property value by handle, value/value_str usage is the same as linkkit_get_value.
+ *
+ * @param handle, property handle.
+ * @param value, value to get.
+ * @param value_str, value to get in string format.
+ *
+ * @return 0 when success, -1 when fail.
+ */
+extern int linkkit_get_value_by_handle(const void* handle, void* value, char** value_str);
+
+/**
+ * @brief get property value into buffers of user, nothing allocated and nothing of thing returned,
+ *        so it is safe while other threads set the property. the property post and the reply of a
+ *        property get read the values under the same lock.
+ *
+ * @param thing_id, pointer to thing object.
+ * @param identifier, property identifier, item of array as "id[index]" and member of struct as "id.member".
+ * @param value, native value to get(input int* if int type or enum or bool, float* if float type,
+ *        double* if double type, unsigned long long* if date type). must be NULL for text type, which only buf gets.
+ * @param buf, buffer to get value in string format, text as it is. may be NULL.
+ * @param buf_len, length of buf, '\0' included.
+ *
+ * @return length of string copied into buf, 0 when buf is NULL, -1 when fail or buf too small.
+ */
+extern int linkkit_get_value_copy(const void* thing_id, const char* identifier, void* value, char* buf, int buf_len);
+
+/**
+ * @brief get property value by handle into buffers of user, usage is the same as linkkit_get_value_copy.
+ *
+ * @param handle, property handle.
+ * @param value, native value to get.
+ * @param buf, buffer to get value in string format.
+ * @param buf_len, length of buf.
+ *
+ * @return length of string copied into buf, 0 when buf is NULL, -1 when fail or buf too small.
+ */
+extern int linkkit_get_value_copy_by_handle(const void* handle, void* value, char* buf, int buf_len);
+
+/* one item of linkkit_set_values, fields usage is the same as dm_property_value_t. */
+typedef dm_property_value_t linkkit_property_value_t;
+
+/**
+ * @brief set several property values of one thing in one call.
+ *        each item uses handle if not NULL, otherwise identifier, value/value_str usage is the same as linkkit_set_value.
+ *        all items are applied even if some of them fail.
+ *
+ * @param thing_id, pointer to thing object.
+ * @param values, property values to set.
+ * @param number, number of values.
+ * @param post, post changed properties to cloud in one message after set if not 0, see linkkit_post_changed_property.
+ *
+ * @return 0 when all items set (and posted), -1 when any fails.
+ */
+extern int linkkit_set_values(const void* thing_id, const linkkit_property_value_t* values, int number, int post);
+
+/**
+ * @brief set items of an array property in one call, instead of one linkkit_set_value per "identifier[index]".
+ *
+ * @param thing_id, pointer to thing object.
+ * @param identifier, identifier of array property, without "[index]".
+ * @param start, index of first array item to set.
+ * @param values, number items of array item type: int, float or double. text arrays are not supported.
+ * @param number, number of items to set, start + number must not exceed array size.
+ *
+ * @return 0 when successfully set, -1 when fail.
+ */
+extern int linkkit_set_array_values(const void* thing_id, const char* identifier, int start, const void* values, int number);
+
+/**
+ * @brief get items of an array property in one call.
+ *
+ * @param thing_id, pointer to thing object.
+ * @param identifier, identifier of array property, without "[index]".
+ * @param start, index of first array item to get.
+ * @param values, buffer for number items of array item type: int, float or double.
+ * @param number, number of items to get, start + number must not exceed array size.
+ *
+ * @return 0 when successfully got, -1 when fail.
+ */
+extern int linkkit_get_array_values(const void* thing_id, const char* identifier, int start, void* values, int number);
+
+/* handler of linkkit_register_route, arguments are the same as dm_route_handler_fp_t. */
+typedef dm_route_handler_fp_t linkkit_route_handler_fp_t;
+
+/**
+ * @brief route downlink messages of a custom method to handler, the topic is subscribed for the device.
+ *
+ * @param method, uri part after /sys/productKey/deviceName/, like "thing/custom/notify".
+ *        uri ending in /${id} also matches method without the id. built in methods can not be taken.
+ * @param handler, called with params of each message arrived.
+ * @param ctx, user context passed to handler.
+ *
+ * @return 0 when successfully registered, -1 when fail.
+ */
+extern int linkkit_register_route(const char* method, linkkit_route_handler_fp_t handler, void* ctx);
+
 /**
  * @brief answer to a service when a service requested by cloud.
  *
@@ -188,7 +437,8 @@ extern int linkkit_get_value(linkkit_method_get_t method_get, const void* thing_
  * @param response_id, id value in response payload. its value is from "dm_callback_type_service_requested" type callback function.
  *        use the same id as the request to send response as the same communication session.
  * @param code, code value in response payload. for example, 200 when service successfully executed, 400 when not successfully executed.
- * @param rrpc, specify rrpc service call or not.
+ * @param rrpc, 0 for a service call not by rrpc, else rrpc of thing_call_service. rrpc calls pending at once are
+ *        answered by it in any order and from any thread, until CONFIG_DM_RRPC_TIMEOUT_MS after they arrived.
  *
  * @return 0 when success, -1 when fail.
  */
@@ -235,7 +485,10 @@ extern int linkkit_invoke_cota_get_config(const char* config_scope, const char*
  * @param params, json type string that user to send to cloud.
  * @param linkkit_deviceinfo_operation, specify update type or delete type.
  *
- * @return 0 when success, -1 when fail.
+ * only the keys not acked by cloud as asked for are sent, merged with the ones asked for within
+ * CONFIG_DM_DEVICEINFO_MERGE_MS into one request, asking for the same again sends nothing.
+ *
+ * @return 0 when params are taken, -1 when fail.
  */
 
 int linkkit_trigger_deviceinfo_operate(const void* thing_id, const char* params, linkkit_deviceinfo_operate_t linkkit_deviceinfo_operation);
@@ -251,16 +504,167 @@ int linkkit_trigger_deviceinfo_operate(const void* thing_id, const char* params,
  */
 extern int linkkit_trigger_event(const void* thing_id, const char* event_identifier);
 
+/**
+ * @brief trigger a event to post to cloud without waiting for its reply, events may be posted one after another.
+ *        the reply, or its absence after timeout_ms, is handed to thing_reply of linkkit_ops by linkkit_dispatch.
+ *        property post event is sent at once too, not coalesced.
+ *
+ * @param thing_id, pointer to thing object.
+ * @param event_identifier, event identifier to trigger.
+ * @param timeout_ms, time to wait for the reply.
+ *
+ * @return request id > 0 when success, -1 when fail or too many events wait for reply.
+ */
+extern int linkkit_trigger_event_async(const void* thing_id, const char* event_identifier, int timeout_ms);
+
+/**
+ * @brief stop waiting for the reply of a request, thing_reply is not called for it.
+ *
+ * @param request_id, from linkkit_trigger_event_async.
+ *
+ * @return 0 when the request was waiting for reply, -1 otherwise.
+ */
+extern int linkkit_cancel_request(int request_id);
+
 /**
  * @brief post property to cloud.
  *
  * @param thing_id, pointer to thing object.
  * @param property_identifier, used when trigger event with method "event.property.post", if set, post specified property, if NULL, post all.
  *
- * @return 0 when success, -1 when fail.
+ * @return 0 when success, -1 when fail, LINKKIT_WOULD_BLOCK when not sent as the connection is saturated.
  */
 extern int linkkit_post_property(const void* thing_id, const char* property_identifier);
 
+/**
+ * @brief post properties changed to cloud, only properties set since last post acked by cloud are posted.
+ *        property post without property_identifier is tracked the same way.
+ *
+ * @param thing_id, pointer to thing object.
+ *
+ * @return 0 when success or nothing changed, -1 when fail, LINKKIT_WOULD_BLOCK when not sent as the connection is saturated.
+ */
+extern int linkkit_post_changed_property(const void* thing_id);
+
+/**
+ * @brief coalesce property posts, so a burst of linkkit_post_property and linkkit_post_changed_property
+ *        calls of a thing goes to cloud as one property post carrying the latest value of each property.
+ *        a post requested is sent min_interval_ms after the last post of the thing at the earliest,
+ *        or max_latency_ms after it was first requested if that is sooner. posts due are sent in
+ *        linkkit_yield(linkkit_dispatch if multi-thread enabled), or by linkkit_flush_property_post.
+ *
+ * @param min_interval_ms, minimum interval between property posts of a thing, 0 posts at once(default).
+ * @param max_latency_ms, longest time a post requested waits, 0 for no limit beyond min_interval_ms.
+ *
+ * @return 0 when success, -1 when fail.
+ */
+extern int linkkit_set_property_post_schedule(int min_interval_ms, int max_latency_ms);
+
+#ifdef DM_REPORT_POLICY_ENABLED
+/* report policy of linkkit_set_property_report_policy, fields usage is the same as dm_report_policy_t. */
+typedef dm_report_policy_t linkkit_report_policy_t;
+
+/**
+ * @brief filter the values set to a property before they go with linkkit_post_changed_property, so values within
+ *        a deadband of the one last reported, or set again within min_interval_ms of the last report, are not posted.
+ *        a value held by min_interval_ms, and a property not reported for max_interval_ms, is posted as changed
+ *        property post in linkkit_yield(linkkit_flush_property_post if multi-thread enabled) when due.
+ *        with aggregate_window_ms set, the values of a numeric property are aggregated per window instead and
+ *        posted once per window the same way, see dm_report_policy_t.
+ *
+ * @param thing_id, pointer to thing object.
+ * @param property_identifier, top level property to attach policy to, all properties of the thing if NULL.
+ * @param policy, report policy, NULL to detach so every value set is posted again.
+ *
+ * @return 0 when success, -1 when fail.
+ */
+extern int linkkit_set_property_report_policy(const void* thing_id, const char* property_identifier,
+                                              const linkkit_report_policy_t* policy);
+#endif /* DM_REPORT_POLICY_ENABLED */
+
+#ifdef DM_CHANNELS_ENABLED
+/* what carries the uplinks of a route, see dm_channel_t. */
+typedef dm_channel_t linkkit_channel_t;
+
+/**
+ * @brief send the uplink requests and raw data of the device whose topic after /sys/{productKey}/{deviceName}/
+ *        starts with prefix over channel, e.g. "thing/event/" over dm_channel_coap, the route of the longest prefix
+ *        wins and dm_channel_mqtt routes a longer prefix back to MQTT. uplinks routed to CoAP or HTTP wait in the
+ *        queue of their channel, CONFIG_DM_CHANNEL_QUEUE_MAX at most, and are sent by linkkit_yield, each channel
+ *        connected and sending on its own so one that is down or slow holds up none of the others.
+ *        a request taken by the cloud over CoAP or HTTP gets a reply of code 200 as from MQTT.
+ *
+ * @param prefix, topic prefix, relative to /sys/{productKey}/{deviceName}/.
+ * @param channel, @see linkkit_channel_t.
+ *
+ * @return 0 when success, -1 when fail, the channel is not built in or CMP_CHANNEL_ROUTE_MAX routes are set.
+ */
+extern int linkkit_set_channel_route(const char* prefix, linkkit_channel_t channel);
+#endif /* DM_CHANNELS_ENABLED */
+
+#ifdef DM_STATIC_THING_ENABLED
+/* model generated by linkkit-tsl-codegen, see dm_static_thing_model_t. */
+typedef dm_static_thing_model_t linkkit_static_thing_model_t;
+
+/**
+ * @brief keep the property values of a thing in the struct generated from its tsl by linkkit-tsl-codegen, so
+ *        a property value is stored into its field and posts are formatted from the fields by the code generated.
+ *        property sets from cloud are stored into data before thing_prop_changed is called with the identifier,
+ *        linkkit_get_value and linkkit_set_value of its properties reach the template values, which are not posted then.
+ *
+ * @param thing_id, pointer to thing object.
+ * @param model, model generated from the tsl of the thing, NULL to unbind.
+ * @param data, struct generated along with model, which must stay valid while bound.
+ *
+ * @return 0 when success, -1 when fail or model is not of the tsl of the thing.
+ */
+extern int linkkit_bind_static_thing(const void* thing_id, const linkkit_static_thing_model_t* model, void* data);
+
+/**
+ * @brief mark properties stored into the struct of a static thing, so linkkit_post_changed_property posts them.
+ *
+ * @param thing_id, pointer to thing object.
+ * @param ids, DM_STATIC_THING_IDS_SIZE(number of properties) bytes, DM_STATIC_THING_ID_SET of the property ids
+ *        generated for the properties changed, NULL for all properties.
+ *
+ * @return 0 when success, -1 when fail.
+ */
+extern int linkkit_set_static_properties_changed(const void* thing_id, const unsigned char* ids);
+#endif /* DM_STATIC_THING_ENABLED */
+
+/**
+ * @brief send coalesced property posts due, call it periodically if linkkit_yield is not called.
+ *
+ * @param force, send all pending posts now if not 0.
+ *
+ * @return 0 when success, -1 when any post fails.
+ */
+extern int linkkit_flush_property_post(int force);
+
+/**
+ * @brief post the metrics of the sdk, see lite-metrics.h, as one json object to
+ *        /sys/{productKey}/{deviceName}/thing/sdk/metrics/post every interval_ms while connected.
+ *        posts are sent in linkkit_yield(linkkit_dispatch if multi-thread enabled), or by linkkit_flush_property_post.
+ *        the metrics can be read by LITE_metrics_find or LITE_metrics_format at any time too.
+ *
+ * @param interval_ms, interval between metrics posts, 0 stops posting(default).
+ *
+ * @return 0 when success, -1 when fail.
+ */
+extern int linkkit_set_metrics_post_interval(int interval_ms);
+
+/**
+ * @brief choose how property and event posts are encoded, cbor makes numeric heavy posts a lot smaller.
+ *        a cbor post carries the same id, version, params and method as its json form, but is published
+ *        as raw data, so the cloud side must decode it, e.g. by a data parsing script.
+ *        replies to downlink requests and other messages stay json.
+ *
+ * @param format, @see linkkit_payload_format_t.
+ *
+ * @return 0 when success, -1 when fail.
+ */
+extern int linkkit_set_payload_format(linkkit_payload_format_t format);
+
 #ifndef CMP_SUPPORT_MULTI_THREAD
 /**
  * @brief this function used to yield when want to receive or send data.
@@ -271,6 +675,16 @@ extern int linkkit_post_property(const void* thing_id, const char* property_iden
  * @return 0 when success, -1 when fail.
  */
 extern int linkkit_yield(int timeout_ms);
+
+/**
+ * @brief milliseconds till linkkit_yield has something to do besides what comes from the cloud:
+ *        coalesced property posts due, requests timing out, the keep-alive or reconnect of the connection.
+ *        linkkit_yield for that long, capped to the longest the application may sleep, waits in the read
+ *        of the connection, so the CPU wakes for nothing else. ask again after each yield.
+ *
+ * @return the milliseconds, 0 when due now, 0xFFFFFFFF when nothing is waited for.
+ */
+extern uint32_t linkkit_get_timeout(void);
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,36 @@
+#ifndef LITE_RING_H
+#define LITE_RING_H
+
+#include <stdlib.h>
+
+/* what lite_ring_push does when all slots are taken. */
+typedef enum {
+    lite_ring_overflow_drop_newest = 0, /* item pushed is dropped. */
+    lite_ring_overflow_drop_oldest,     /* oldest item is overwritten. */
+    lite_ring_overflow_block,           /* wait till a slot is popped, needs a synchronized ring popped by another thread. */
+} lite_ring_overflow_policy_t;
+
+/* fixed number of item_size slots allocated once, items are copied in and out. */
+typedef struct _lite_ring_t
+{
+    void*  lite_ring_slots;
+    void*  lite_ring_mutex;
+    size_t item_size;
+    size_t slot_number;
+    size_t head; /* slot of oldest item. */
+    size_t count;
+    size_t dropped; /* items dropped or overwritten on overflow. */
+    lite_ring_overflow_policy_t overflow_policy;
+} lite_ring_t;
+
+lite_ring_t* lite_ring_create(int slot_number, size_t item_size, lite_ring_overflow_policy_t overflow_policy, int synchronized);
+void lite_ring_destroy(lite_ring_t* _lite_ring);
+void lite_ring_set_overflow_policy(lite_ring_t* _lite_ring, lite_ring_overflow_policy_t overflow_policy);
+int lite_ring_push(lite_ring_t* _lite_ring, const void* item);
+int lite_ring_pop(lite_ring_t* _lite_ring, void* item);
+size_t lite_ring_dropped(lite_ring_t* _lite_ring);
+size_t lite_ring_count(lite_ring_t* _lite_ring);
+/* index of the ring among ring_number that items of key go to, pointer keys are spread evenly. */
+size_t lite_ring_pick(const void* key, size_t ring_number);
+
+#endif /* LITE_RING_H */
@@ -82,6 +82,16 @@ static void fota_callback(service_fota_callback_type_t callback_type, const char
 
     assert(callback_type < service_fota_callback_type_number);
 
+    if (callback_type == service_fota_callback_type_download_finished) {
+        service_ota_stats_t stats;
+
+        if (0 == linkkit_fota_get_stats(&stats)) {
+            LINKKIT_PRINTF("fota %s done %d: %u bytes in %u ms, fetch %u B/s, write %u B/s\n", version, stats.result,
+                           stats.written, stats.elapsed_ms, stats.fetch_bytes_per_s, stats.write_bytes_per_s);
+        }
+        return;
+    }
+
     sample = &g_sample_context;
 
     /* temporarily disable thing when ota service invoked */
@@ -107,6 +117,16 @@ static void cota_callback(service_cota_callback_type_t callback_type,
 
     assert(callback_type < service_cota_callback_type_number);
 
+    if (callback_type == service_cota_callback_type_download_finished) {
+        service_ota_stats_t stats;
+
+        if (0 == linkkit_cota_get_stats(&stats)) {
+            LINKKIT_PRINTF("cota %s done %d: %u bytes in %u ms, fetch %u B/s, write %u B/s\n", configid, stats.result,
+                           stats.written, stats.elapsed_ms, stats.fetch_bytes_per_s, stats.write_bytes_per_s);
+        }
+        return;
+    }
+
     sample = &g_sample_context;
 
     /* temporarily disable thing when ota service invoked */
@@ -0,0 +1,576 @@
+/** USER NOTIFICATION
+ *  this tool generates C code of a json TSL for linkkit_bind_static_thing: a struct holding the values of
+ *  the properties, with a nested struct per struct property and fixed arrays, enum ids of the properties,
+ *  and the model formatting posts straight from the fields and storing property sets straight into them.
+ *
+ *  usage: linkkit-tsl-codegen tsl.json name
+ *  writes name.h and name.c, prefixed by the base name of name.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "class_interface.h"
+#include "logger.h"
+#include "dm_thing.h"
+
+#define CODEGEN_NAME_MAXLEN 64
+#define CODEGEN_PATH_MAXLEN 256
+
+typedef struct {
+    FILE*       h;
+    FILE*       c;
+    const char* tsl_path;
+    char        prefix[CODEGEN_NAME_MAXLEN]; /* of functions and types. */
+    char        upper[CODEGEN_NAME_MAXLEN]; /* of ids and the header guard. */
+} codegen_t;
+
+static const char* const c_keywords[] = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern",
+    "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return", "short", "signed",
+    "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while",
+};
+
+static char* read_file(const char* path, int* len)
+{
+    FILE* fp;
+    char* buf = NULL;
+    long size;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) return NULL;
+
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buf = calloc(1, size + 1);
+        if (buf && fread(buf, 1, size, fp) != (size_t)size) {
+            free(buf);
+            buf = NULL;
+        }
+        *len = (int)size;
+    }
+
+    fclose(fp);
+
+    return buf;
+}
+
+/* identifiers go into the code as they are, in C strings and json keys, none may need escaping. */
+static int check_identifier(const char* identifier)
+{
+    const char* p;
+
+    if (identifier == NULL || *identifier == '\0') return -1;
+
+    for (p = identifier; *p; ++p) {
+        if (*p < 0x20 || *p >= 0x7f || *p == '"' || *p == '\\' || *p == '?') {
+            printf("identifier(%s) can not be generated\n", identifier);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* C name of identifier, other characters than letters, digits and '_' made '_'. */
+static void c_name(const char* identifier, char* buf)
+{
+    size_t len = 0;
+    size_t i;
+
+    if (isdigit((unsigned char)*identifier)) buf[len++] = '_';
+
+    for (; *identifier && len < CODEGEN_NAME_MAXLEN - 2; ++identifier) {
+        buf[len++] = isalnum((unsigned char)*identifier) ? *identifier : '_';
+    }
+    buf[len] = '\0';
+
+    for (i = 0; i < sizeof(c_keywords) / sizeof(c_keywords[0]); ++i) {
+        if (strcmp(buf, c_keywords[i]) == 0) {
+            buf[len++] = '_';
+            buf[len] = '\0';
+            break;
+        }
+    }
+}
+
+/* 0 when the C names of items are distinct. */
+static int check_c_names(const lite_property_t* items, int number, size_t item_size)
+{
+    char a[CODEGEN_NAME_MAXLEN];
+    char b[CODEGEN_NAME_MAXLEN];
+    const lite_property_t* item;
+    int i, j;
+
+    for (i = 0; i < number; ++i) {
+        item = (const lite_property_t*)((const char*)items + i * item_size);
+        if (check_identifier(item->identifier) != 0) return -1;
+
+        c_name(item->identifier, a);
+        for (j = 0; j < i; ++j) {
+            c_name(((const lite_property_t*)((const char*)items + j * item_size))->identifier, b);
+            if (strcmp(a, b) == 0) {
+                printf("identifier(%s) takes the C name of one before\n", item->identifier);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static const char* scalar_c_type(data_type_type_t type)
+{
+    switch (type) {
+    case data_type_type_int:
+    case data_type_type_enum:
+    case data_type_type_bool:
+        return "int";
+    case data_type_type_float:
+        return "float";
+    case data_type_type_double:
+        return "double";
+    case data_type_type_date:
+        return "unsigned long long";
+    default:
+        return NULL;
+    }
+}
+
+static const char* type_name(data_type_type_t type)
+{
+    static const char* const names[] = {"text", "enum", "bool", "float", "double", "int", "date", "struct", "array"};
+
+    return (unsigned)type < sizeof(names) / sizeof(names[0]) ? names[type] : "unknown";
+}
+
+/* a scalar or text field of the struct of lite_property. */
+static int emit_field(codegen_t* gen, const lite_property_t* lite_property, const char* indent)
+{
+    const data_type_x_t* value = &lite_property->data_type.value;
+    char name[CODEGEN_NAME_MAXLEN];
+    const char* type = scalar_c_type(lite_property->data_type.type);
+
+    c_name(lite_property->identifier, name);
+
+    if (type) {
+        fprintf(gen->h, "%s%s %s;\n", indent, type, name);
+    } else if (lite_property->data_type.type == data_type_type_text && value->data_type_text_t.length > 0) {
+        fprintf(gen->h, "%schar %s[%d + 1];\n", indent, name, value->data_type_text_t.length);
+    } else if (lite_property->data_type.type == data_type_type_text) {
+        fprintf(gen->h, "%schar %s[DM_STATIC_THING_ARRAY_TEXT_LEN + 1];\n", indent, name);
+    } else {
+        printf("property(%s) of %s type can not be a member\n", lite_property->identifier, type_name(lite_property->data_type.type));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int emit_struct_type(codegen_t* gen, const property_t* property)
+{
+    const lite_property_t* members = property->data_type.specs;
+    int number = (int)property->data_type.data_type_specs_number;
+    char name[CODEGEN_NAME_MAXLEN];
+    int i;
+
+    if (number == 0) {
+        printf("struct property(%s) has no members\n", property->identifier);
+        return -1;
+    }
+    if (check_c_names(members, number, sizeof(lite_property_t)) != 0) return -1;
+
+    c_name(property->identifier, name);
+
+    fprintf(gen->h, "/* %s */\ntypedef struct {\n", property->identifier);
+    for (i = 0; i < number; ++i) {
+        if (emit_field(gen, members + i, "    ") != 0) return -1;
+    }
+    fprintf(gen->h, "} %s_%s_t;\n\n", gen->prefix, name);
+
+    return 0;
+}
+
+static int emit_property_field(codegen_t* gen, const property_t* property)
+{
+    const data_type_x_t* value = &property->data_type.value;
+    char name[CODEGEN_NAME_MAXLEN];
+
+    c_name(property->identifier, name);
+
+    switch (property->data_type.type) {
+    case data_type_type_struct:
+        fprintf(gen->h, "    %s_%s_t %s;\n", gen->prefix, name, name);
+        return 0;
+    case data_type_type_array:
+        if (value->data_type_array_t.size <= 0) {
+            printf("array property(%s) has no items\n", property->identifier);
+            return -1;
+        }
+        switch (value->data_type_array_t.item_type) {
+        case data_type_type_int:
+        case data_type_type_float:
+        case data_type_type_double:
+            fprintf(gen->h, "    %s %s[%d];\n", scalar_c_type(value->data_type_array_t.item_type), name, value->data_type_array_t.size);
+            return 0;
+        case data_type_type_text:
+            fprintf(gen->h, "    char %s[%d][DM_STATIC_THING_ARRAY_TEXT_LEN + 1];\n", name, value->data_type_array_t.size);
+            return 0;
+        default:
+            printf("array property(%s) of %s items can not be generated\n", property->identifier,
+                   type_name(value->data_type_array_t.item_type));
+            return -1;
+        }
+    default:
+        return emit_field(gen, (const lite_property_t*)property, "    ");
+    }
+}
+
+static int emit_header(codegen_t* gen, const dsl_template_t* dsl_template)
+{
+    const property_t* property;
+    char name[CODEGEN_NAME_MAXLEN];
+    size_t i;
+
+    fprintf(gen->h, "/* generated by linkkit-tsl-codegen from %s, do not edit. */\n\n", gen->tsl_path);
+    fprintf(gen->h, "#ifndef %s_H\n#define %s_H\n\n", gen->upper, gen->upper);
+    fprintf(gen->h, "#include \"dm_static_thing.h\"\n\n");
+    fprintf(gen->h, "#ifdef __cplusplus\nextern \"C\" {\n#endif /* __cplusplus */\n\n");
+
+    fprintf(gen->h, "/* ids of the properties, their indexes in the tsl. */\nenum {\n");
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        c_name(dsl_template->properties[i].identifier, name);
+        fprintf(gen->h, "    %s_PROPERTY_%s,\n", gen->upper, name);
+    }
+    fprintf(gen->h, "\n    %s_PROPERTY_NUMBER\n};\n\n", gen->upper);
+
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        property = dsl_template->properties + i;
+        if (property->data_type.type == data_type_type_struct && emit_struct_type(gen, property) != 0) return -1;
+    }
+
+    fprintf(gen->h, "/* values of the properties. */\ntypedef struct {\n");
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        if (emit_property_field(gen, dsl_template->properties + i) != 0) return -1;
+    }
+    fprintf(gen->h, "} %s_t;\n\n", gen->prefix);
+
+    fprintf(gen->h, "/* model for linkkit_bind_static_thing with a %s_t. */\n", gen->prefix);
+    fprintf(gen->h, "extern const dm_static_thing_model_t %s_model;\n\n", gen->prefix);
+
+    fprintf(gen->h, "#ifdef __cplusplus\n}\n#endif /* __cplusplus */\n\n#endif /* %s_H */\n", gen->upper);
+
+    return 0;
+}
+
+static void emit_key(codegen_t* gen, const char* identifier, const char* indent)
+{
+    fprintf(gen->c, "%sdm_json_writer_key_raw(writer, \"\\\"%s\\\":\", %d);\n", indent, identifier, (int)strlen(identifier) + 3);
+}
+
+/* value of a scalar or text of type at field. */
+static void emit_format_value(codegen_t* gen, data_type_type_t type, const char* field, const char* indent)
+{
+    switch (type) {
+    case data_type_type_int:
+    case data_type_type_enum:
+    case data_type_type_bool:
+        fprintf(gen->c, "%sdm_json_writer_int(writer, %s);\n", indent, field);
+        break;
+    case data_type_type_float:
+        fprintf(gen->c, "%sdm_json_writer_double(writer, %s, 7);\n", indent, field);
+        break;
+    case data_type_type_double:
+        fprintf(gen->c, "%sdm_json_writer_double(writer, %s, 16);\n", indent, field);
+        break;
+    case data_type_type_date:
+        fprintf(gen->c, "%sdm_static_thing_write_date(writer, %s);\n", indent, field);
+        break;
+    case data_type_type_text:
+        fprintf(gen->c, "%sdm_json_writer_string(writer, %s, strlen(%s));\n", indent, field, field);
+        break;
+    default:
+        break;
+    }
+}
+
+static void emit_format_property(codegen_t* gen, const property_t* property)
+{
+    const data_type_x_t* value = &property->data_type.value;
+    const lite_property_t* member;
+    char name[CODEGEN_NAME_MAXLEN];
+    char member_name[CODEGEN_NAME_MAXLEN];
+    char field[3 * CODEGEN_NAME_MAXLEN];
+    size_t i;
+
+    c_name(property->identifier, name);
+
+    fprintf(gen->c, "    if (ids == NULL || DM_STATIC_THING_ID_ISSET(ids, %s_PROPERTY_%s)) {\n", gen->upper, name);
+    emit_key(gen, property->identifier, "        ");
+
+    switch (property->data_type.type) {
+    case data_type_type_struct:
+        fprintf(gen->c, "        dm_json_writer_object_begin(writer);\n");
+        for (i = 0; i < property->data_type.data_type_specs_number; ++i) {
+            member = (const lite_property_t*)property->data_type.specs + i;
+            c_name(member->identifier, member_name);
+            snprintf(field, sizeof(field), "data->%s.%s", name, member_name);
+            emit_key(gen, member->identifier, "        ");
+            emit_format_value(gen, member->data_type.type, field, "        ");
+        }
+        fprintf(gen->c, "        dm_json_writer_object_end(writer);\n");
+        break;
+    case data_type_type_array:
+        snprintf(field, sizeof(field), "data->%s[i]", name);
+        fprintf(gen->c, "        dm_json_writer_array_begin(writer);\n");
+        fprintf(gen->c, "        for (i = 0; i < %d; ++i) {\n", value->data_type_array_t.size);
+        emit_format_value(gen, value->data_type_array_t.item_type, field, "            ");
+        fprintf(gen->c, "        }\n");
+        fprintf(gen->c, "        dm_json_writer_array_end(writer);\n");
+        break;
+    default:
+        snprintf(field, sizeof(field), "data->%s", name);
+        emit_format_value(gen, property->data_type.type, field, "        ");
+        break;
+    }
+
+    fprintf(gen->c, "    }\n");
+}
+
+/* store item of a scalar or text of type at field, return -1 when it is not of the type. */
+static void emit_parse_value(codegen_t* gen, data_type_type_t type, const char* item, const char* field, const char* indent)
+{
+    switch (type) {
+    case data_type_type_int:
+    case data_type_type_enum:
+    case data_type_type_bool:
+        fprintf(gen->c, "%sif (dm_static_thing_get_int(%s, &%s) != 0) return -1;\n", indent, item, field);
+        break;
+    case data_type_type_float:
+        fprintf(gen->c, "%sif (dm_static_thing_get_double(%s, &number) != 0) return -1;\n", indent, item);
+        fprintf(gen->c, "%s%s = (float)number;\n", indent, field);
+        break;
+    case data_type_type_double:
+        fprintf(gen->c, "%sif (dm_static_thing_get_double(%s, &%s) != 0) return -1;\n", indent, item, field);
+        break;
+    case data_type_type_date:
+        fprintf(gen->c, "%sif (dm_static_thing_get_date(%s, &%s) != 0) return -1;\n", indent, item, field);
+        break;
+    case data_type_type_text:
+        fprintf(gen->c, "%sif (dm_static_thing_get_text(%s, %s, sizeof(%s)) != 0) return -1;\n", indent, item, field, field);
+        break;
+    default:
+        break;
+    }
+}
+
+/* a struct or array is stored whole or not at all, its members and items not set keep their values, unknown members are skipped. */
+static void emit_parse_property(codegen_t* gen, const property_t* property)
+{
+    const data_type_x_t* value = &property->data_type.value;
+    const lite_property_t* member;
+    char name[CODEGEN_NAME_MAXLEN];
+    char member_name[CODEGEN_NAME_MAXLEN];
+    char field[3 * CODEGEN_NAME_MAXLEN];
+    int uses_number = 0;
+    size_t i;
+
+    c_name(property->identifier, name);
+
+    fprintf(gen->c, "static int parse_%s(%s_t* data, const cJSON* item)\n{\n", name, gen->prefix);
+
+    switch (property->data_type.type) {
+    case data_type_type_struct:
+        for (i = 0; i < property->data_type.data_type_specs_number; ++i) {
+            member = (const lite_property_t*)property->data_type.specs + i;
+            if (member->data_type.type == data_type_type_float) uses_number = 1;
+        }
+        fprintf(gen->c, "    %s_%s_t value = data->%s;\n", gen->prefix, name, name);
+        fprintf(gen->c, "    const cJSON* member;\n");
+        if (uses_number) fprintf(gen->c, "    double number;\n");
+        fprintf(gen->c, "\n    if (!cJSON_IsObject(item)) return -1;\n\n");
+        fprintf(gen->c, "    cJSON_ArrayForEach(member, item) {\n");
+        for (i = 0; i < property->data_type.data_type_specs_number; ++i) {
+            member = (const lite_property_t*)property->data_type.specs + i;
+            c_name(member->identifier, member_name);
+            snprintf(field, sizeof(field), "value.%s", member_name);
+            fprintf(gen->c, "        %sif (dm_static_thing_key_equal(member, \"%s\", %d)) {\n", i ? "} else " : "",
+                    member->identifier, (int)strlen(member->identifier));
+            emit_parse_value(gen, member->data_type.type, "member", field, "            ");
+        }
+        fprintf(gen->c, "        }\n    }\n\n");
+        fprintf(gen->c, "    data->%s = value;\n", name);
+        break;
+    case data_type_type_array:
+        if (value->data_type_array_t.item_type == data_type_type_text) {
+            fprintf(gen->c, "    char value[%d][DM_STATIC_THING_ARRAY_TEXT_LEN + 1];\n", value->data_type_array_t.size);
+        } else {
+            fprintf(gen->c, "    %s value[%d];\n", scalar_c_type(value->data_type_array_t.item_type), value->data_type_array_t.size);
+        }
+        fprintf(gen->c, "    const cJSON* element;\n");
+        if (value->data_type_array_t.item_type == data_type_type_float) fprintf(gen->c, "    double number;\n");
+        fprintf(gen->c, "    int i = 0;\n\n");
+        fprintf(gen->c, "    if (!cJSON_IsArray(item) || cJSON_GetArraySize(item) > %d) return -1;\n\n", value->data_type_array_t.size);
+        fprintf(gen->c, "    memcpy(value, data->%s, sizeof(value));\n", name);
+        fprintf(gen->c, "    cJSON_ArrayForEach(element, item) {\n");
+        emit_parse_value(gen, value->data_type_array_t.item_type, "element", "value[i]", "        ");
+        fprintf(gen->c, "        i++;\n    }\n");
+        fprintf(gen->c, "    memcpy(data->%s, value, sizeof(value));\n", name);
+        break;
+    default:
+        snprintf(field, sizeof(field), "data->%s", name);
+        if (property->data_type.type == data_type_type_float) fprintf(gen->c, "    double number;\n\n");
+        emit_parse_value(gen, property->data_type.type, "item", field, "    ");
+        break;
+    }
+
+    fprintf(gen->c, "\n    return 0;\n}\n\n");
+}
+
+static int emit_source(codegen_t* gen, const dsl_template_t* dsl_template, const char* header)
+{
+    const property_t* property;
+    char name[CODEGEN_NAME_MAXLEN];
+    int uses_index = 0;
+    size_t i;
+
+    fprintf(gen->c, "/* generated by linkkit-tsl-codegen from %s, do not edit. */\n\n", gen->tsl_path);
+    fprintf(gen->c, "#include <string.h>\n\n#include \"%s\"\n\n", header);
+
+    fprintf(gen->c, "static const char* const %s_identifiers[%s_PROPERTY_NUMBER] = {\n", gen->prefix, gen->upper);
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        fprintf(gen->c, "    \"%s\",\n", dsl_template->properties[i].identifier);
+    }
+    fprintf(gen->c, "};\n\n");
+
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        if (dsl_template->properties[i].data_type.type == data_type_type_array) uses_index = 1;
+    }
+
+    fprintf(gen->c, "static void format_properties(const void* _data, const unsigned char* ids, void* _writer)\n{\n");
+    fprintf(gen->c, "    const %s_t* data = _data;\n", gen->prefix);
+    fprintf(gen->c, "    dm_json_writer_t* writer = _writer;\n");
+    if (uses_index) fprintf(gen->c, "    int i;\n");
+    fprintf(gen->c, "\n");
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        emit_format_property(gen, dsl_template->properties + i);
+    }
+    fprintf(gen->c, "}\n\n");
+
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        emit_parse_property(gen, dsl_template->properties + i);
+    }
+
+    fprintf(gen->c, "static int parse_properties(void* _data, const void* params, unsigned char* ids)\n{\n");
+    fprintf(gen->c, "    %s_t* data = _data;\n", gen->prefix);
+    fprintf(gen->c, "    const cJSON* item;\n    int ret = 0;\n\n");
+    fprintf(gen->c, "    cJSON_ArrayForEach(item, (const cJSON*)params) {\n");
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        property = dsl_template->properties + i;
+        c_name(property->identifier, name);
+        fprintf(gen->c, "        %sif (dm_static_thing_key_equal(item, \"%s\", %d)) {\n", i ? "} else " : "",
+                property->identifier, (int)strlen(property->identifier));
+        fprintf(gen->c, "            if (parse_%s(data, item) != 0) {\n                ret = -1;\n                continue;\n            }\n", name);
+        fprintf(gen->c, "            DM_STATIC_THING_ID_SET(ids, %s_PROPERTY_%s);\n", gen->upper, name);
+    }
+    fprintf(gen->c, "        }\n    }\n\n    return ret;\n}\n\n");
+
+    fprintf(gen->c, "const dm_static_thing_model_t %s_model = {\n", gen->prefix);
+    fprintf(gen->c, "    %s_PROPERTY_NUMBER,\n    %s_identifiers,\n    format_properties,\n    parse_properties,\n};\n", gen->upper, gen->prefix);
+
+    return 0;
+}
+
+static int generate(codegen_t* gen, const dsl_template_t* dsl_template, const char* name)
+{
+    char path[CODEGEN_PATH_MAXLEN];
+    const char* base;
+    int ret = -1;
+
+    if (dsl_template->property_number == 0) {
+        printf("tsl has no properties\n");
+        return -1;
+    }
+    if (check_c_names((const lite_property_t*)dsl_template->properties, (int)dsl_template->property_number, sizeof(property_t)) != 0) {
+        return -1;
+    }
+
+    base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+
+    snprintf(path, sizeof(path), "%s.h", name);
+    gen->h = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s.c", name);
+    gen->c = fopen(path, "w");
+
+    if (gen->h && gen->c) {
+        snprintf(path, sizeof(path), "%s.h", base);
+        ret = emit_header(gen, dsl_template) == 0 && emit_source(gen, dsl_template, path) == 0 ? 0 : -1;
+    }
+
+    if (gen->h) fclose(gen->h);
+    if (gen->c) fclose(gen->c);
+
+    /* no half written code is left. */
+    if (ret != 0) {
+        snprintf(path, sizeof(path), "%s.h", name);
+        remove(path);
+        snprintf(path, sizeof(path), "%s.c", name);
+        remove(path);
+    }
+
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    codegen_t gen = {0};
+    void* logger;
+    thing_t** thing;
+    const char* base;
+    char* tsl;
+    int tsl_len = 0;
+    int ret = -1;
+    size_t i;
+
+    if (argc != 3) {
+        printf("usage: %s tsl.json name\n", argv[0]);
+        return -1;
+    }
+
+    base = strrchr(argv[2], '/');
+    base = base ? base + 1 : argv[2];
+    if (*base == '\0' || strlen(argv[2]) + 3 > CODEGEN_PATH_MAXLEN) {
+        printf("bad name %s\n", argv[2]);
+        return -1;
+    }
+    c_name(base, gen.prefix);
+    for (i = 0; gen.prefix[i]; ++i) gen.upper[i] = (char)toupper((unsigned char)gen.prefix[i]);
+    gen.tsl_path = argv[1];
+
+    tsl = read_file(argv[1], &tsl_len);
+    if (tsl == NULL) {
+        printf("read %s fail\n", argv[1]);
+        return -1;
+    }
+
+    logger = new_object(LOGGER_CLASS, "tsl codegen", log_level_err);
+
+    thing = new_object(DM_THING_CLASS, "tsl json");
+    if ((*thing)->set_dsl_string(thing, tsl, tsl_len) == 0) {
+        ret = generate(&gen, &((dm_thing_t*)thing)->dsl_template, argv[2]);
+    }
+
+    if (ret == 0) {
+        printf("%s.h, %s.c: %d properties\n", argv[2], argv[2], (int)((dm_thing_t*)thing)->dsl_template.property_number);
+    } else {
+        printf("generate %s fail\n", argv[1]);
+    }
+
+    free(tsl);
+    delete_object(thing);
+    delete_object(logger);
+
+    return ret;
+}
@@ -0,0 +1,115 @@
+/** USER NOTIFICATION
+ *  this tool compiles a json TSL into the binary TSL accepted by linkkit_set_tsl,
+ *  so the device loads its thing model without parsing json at boot.
+ *
+ *  usage: linkkit-tsl-compiler tsl.json tsl.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "class_interface.h"
+#include "logger.h"
+#include "dm_thing.h"
+#include "dm_tsl_blob.h"
+
+static char* read_file(const char* path, int* len)
+{
+    FILE* fp;
+    char* buf = NULL;
+    long size;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) return NULL;
+
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buf = calloc(1, size + 1);
+        if (buf && fread(buf, 1, size, fp) != (size_t)size) {
+            free(buf);
+            buf = NULL;
+        }
+        *len = (int)size;
+    }
+
+    fclose(fp);
+
+    return buf;
+}
+
+/* serialize template of a loaded thing, caller frees the blob. */
+static unsigned char* compile_thing(thing_t** thing, int* len)
+{
+    const dsl_template_t* dsl_template = &((dm_thing_t*)thing)->dsl_template;
+    unsigned char* blob;
+
+    *len = dm_tsl_blob_write(dsl_template, NULL, 0);
+    if (*len <= 0) return NULL;
+
+    blob = malloc(*len);
+    if (blob && dm_tsl_blob_write(dsl_template, blob, *len) != *len) {
+        free(blob);
+        blob = NULL;
+    }
+
+    return blob;
+}
+
+int main(int argc, char** argv)
+{
+    void* logger;
+    thing_t** thing;
+    thing_t** check_thing;
+    char* tsl;
+    unsigned char* blob = NULL;
+    unsigned char* check_blob = NULL;
+    int tsl_len = 0, blob_len = 0, check_len = 0;
+    int ret = -1;
+    FILE* fp;
+
+    if (argc != 3) {
+        printf("usage: %s tsl.json tsl.bin\n", argv[0]);
+        return -1;
+    }
+
+    tsl = read_file(argv[1], &tsl_len);
+    if (tsl == NULL) {
+        printf("read %s fail\n", argv[1]);
+        return -1;
+    }
+
+    logger = new_object(LOGGER_CLASS, "tsl compiler", log_level_err);
+
+    thing = new_object(DM_THING_CLASS, "tsl json");
+    if ((*thing)->set_dsl_string(thing, tsl, tsl_len) == 0) {
+        blob = compile_thing(thing, &blob_len);
+    }
+
+    /* round trip, the blob must load back into the same template. */
+    if (blob) {
+        check_thing = new_object(DM_THING_CLASS, "tsl blob");
+        if ((*check_thing)->set_dsl_string(check_thing, (char*)blob, blob_len) == 0) {
+            check_blob = compile_thing(check_thing, &check_len);
+        }
+        delete_object(check_thing);
+    }
+
+    if (blob && check_blob && check_len == blob_len && memcmp(blob, check_blob, blob_len) == 0) {
+        fp = fopen(argv[2], "wb");
+        if (fp && fwrite(blob, 1, blob_len, fp) == (size_t)blob_len) {
+            printf("%s: %d bytes json -> %d bytes blob\n", argv[2], tsl_len, blob_len);
+            ret = 0;
+        }
+        if (fp) fclose(fp);
+    }
+
+    if (ret != 0) printf("compile %s fail\n", argv[1]);
+
+    free(check_blob);
+    free(blob);
+    free(tsl);
+    delete_object(thing);
+    delete_object(logger);
+
+    return ret;
+}
@@ -2,24 +2,55 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "iot_import.h"
 #include "linkkit_export.h"
 #include "class_interface.h"
+#include "dm_tsl_blob.h"
+#include "lite_ring.h"
+#include "lite-trace.h"
+#include "lite-metrics.h"
+#include "lite-startup.h"
 
 #define EVENT_PROPERTY_POST_IDENTIFIER         "post"
 #define LINKKIT_EXPORT_PRINTF printf
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+#define LINKKIT_DISPATCH_WORKER_MAX            8
+#define LINKKIT_DISPATCH_WORKER_IDLE_MS        10
+#define LINKKIT_DISPATCH_WORKER_STACK_SIZE     (8 * 1024)
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
 
 /* used for packing up all parameters from dm callback. */
 typedef struct {
     void* thing_id;
     char  property_service_version_identifier[64];
     int   request_id;
+    int   code; /* alink code of a reply. */
     void* raw_data;
     int   raw_data_length;
     dm_callback_type_t callback_type;
+    uint64_t submit_time; /* uptime in ms when buffered. */
 } dm_msg_t;
 
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+/* every worker drains its own queue, messages of one thing always go to the same worker. */
+typedef struct {
+    void*        exit_sem; /* posted by the worker when it returns. */
+    lite_ring_t* message_queue;
+} linkkit_dispatch_worker_t;
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+
 static linkkit_ops_t* g_linkkit_ops = NULL;
-static lite_queue_t* g_message_queue = NULL;
+static lite_ring_t* g_message_queue = NULL;
+static linkkit_message_overflow_policy_t g_message_overflow_policy = linkkit_message_overflow_drop_newest;
+static linkkit_dispatch_stats_t g_dispatch_stats;
+static void* g_dispatch_stats_mutex = NULL;
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+static linkkit_dispatch_worker_t g_dispatch_workers[LINKKIT_DISPATCH_WORKER_MAX];
+static volatile int g_dispatch_worker_number = 0;
+static volatile int g_dispatch_worker_running = 0;
+/* held to submit a message and to switch from the caller thread queue to the workers. */
+static void* g_dispatch_submit_mutex = NULL;
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
 static void* user_ctx = NULL;
 static void* dm_object  = NULL;
 #ifdef SERVICE_OTA_ENABLED
@@ -28,6 +59,67 @@ static void* fota_object = NULL;
 static void* cota_object = NULL;
 #endif /* SERVICE_COTA_ENABLED */
 #endif /* SERVICE_OTA_ENABLED */
+
+#if WITH_METRICS
+/* messages waiting in the queue of the caller thread and in those of the workers. */
+static int count_queued_messages(void)
+{
+    lite_ring_t* message_queue = g_message_queue;
+    int queued = message_queue ? (int)lite_ring_count(message_queue) : 0;
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    int worker_number = g_dispatch_worker_number;
+    int index;
+
+    for (index = 0; index < worker_number; index++) {
+        queued += (int)lite_ring_count(g_dispatch_workers[index].message_queue);
+    }
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+
+    return queued;
+}
+#endif /* WITH_METRICS */
+
+LITE_METRIC_DEFINE_GAUGE(g_queued_metric, "linkkit.queue", count_queued_messages);
+/* ms a message waited in queue before its handler ran. */
+LITE_METRIC_DEFINE_HISTOGRAM(g_dispatch_wait_metric, "linkkit.dispatch_ms", 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000);
+
+/* queue a message of thing_id waits in, the caller thread queue unless workers are started. */
+static lite_ring_t* select_message_queue(const void* thing_id)
+{
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    int worker_number = g_dispatch_worker_number;
+
+    if (worker_number > 0) {
+        return g_dispatch_workers[lite_ring_pick(thing_id, worker_number)].message_queue;
+    }
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+    return g_message_queue;
+}
+
+static void submit_message(dm_msg_t* msg)
+{
+    int ret;
+
+    msg->submit_time = HAL_UptimeMs();
+
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    HAL_MutexLock(g_dispatch_submit_mutex);
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+    /* copied into a preallocated slot, nothing allocated per message. */
+    ret = lite_ring_push(select_message_queue(msg->thing_id), msg);
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    HAL_MutexUnlock(g_dispatch_submit_mutex);
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+    if (ret != 0) {
+        LINKKIT_EXPORT_PRINTF("\n---------------\nqueue full, message type %d dropped.\n---------------\n", msg->callback_type);
+        return;
+    }
+
+    LITE_TRACE(LITE_TRACE_QUEUE_PUT, msg->request_id);
+
+    LINKKIT_EXPORT_PRINTF("\n---------------\nsubmit an item to queue, type %d.\n---------------\n", msg->callback_type);
+}
+
 /* callback function for dm. pack up all parameters and send to queue. this callback should be processed as fast as possible. */
 static void dm_callback(dm_callback_type_t callback_type,
                         void* thing_id, const char* property_service_identifier,
@@ -35,7 +127,7 @@ static void dm_callback(dm_callback_type_t callback_type,
 {
     linkkit_ops_t* linkkit_ops = g_linkkit_ops;
     void* context = user_ctx;
-    dm_msg_t* msg = NULL;
+    dm_msg_t msg;
 
     if (!linkkit_ops || ! context) return;
 
@@ -46,23 +138,41 @@ static void dm_callback(dm_callback_type_t callback_type,
         return;
     }
 
-    msg = calloc(1, sizeof(dm_msg_t));
-    if (!msg) return;
+    memset(&msg, 0, sizeof(dm_msg_t));
 
-    msg->callback_type = callback_type;
-    msg->thing_id = thing_id;
+    msg.callback_type = callback_type;
+    msg.thing_id = thing_id;
 
     if (property_service_identifier) {
-        strcpy(msg->property_service_version_identifier, property_service_identifier);
+        strncpy(msg.property_service_version_identifier, property_service_identifier, sizeof(msg.property_service_version_identifier) - 1);
     }
 
-    msg->request_id = request_id;
-    msg->raw_data = raw_data;
-    msg->raw_data_length = raw_data_length;
+    msg.request_id = request_id;
+    msg.raw_data = raw_data;
+    msg.raw_data_length = raw_data_length;
+
+    submit_message(&msg);
+}
+
+/* reply handler for dm, replies wait in queue like other messages. */
+static void dm_reply_callback(const void* thing_id, int request_id, int code, const char* payload, int payload_len, void* ctx)
+{
+    dm_msg_t msg;
+
+    (void)payload;
+    (void)payload_len;
+    (void)ctx;
+
+    if (!g_linkkit_ops || !user_ctx) return;
 
-    lite_queue_insert(g_message_queue, msg);
+    memset(&msg, 0, sizeof(dm_msg_t));
 
-    LINKKIT_EXPORT_PRINTF("\n---------------\nsubmit an item to queue @%p.\n---------------\n", msg);
+    msg.callback_type = dm_callback_type_response_arrived;
+    msg.thing_id = (void*)thing_id;
+    msg.request_id = request_id;
+    msg.code = code;
+
+    submit_message(&msg);
 }
 
 static void handle_request(dm_msg_t* msg, void* ctx)
@@ -93,7 +203,7 @@ static void handle_request(dm_msg_t* msg, void* ctx)
         break;
 #ifdef RRPC_ENABLED
     case dm_callback_type_rrpc_requested:
-        rrpc = 1;
+        rrpc = msg->raw_data_length;
 #endif /* RRPC_ENABLED */
     case dm_callback_type_service_requested:
         if (linkkit_ops->thing_call_service) {
@@ -115,11 +225,43 @@ static void handle_request(dm_msg_t* msg, void* ctx)
     case dm_callback_type_thing_disabled:
         if (linkkit_ops->thing_disable) linkkit_ops->thing_disable(msg->thing_id, context);
         break;
+    case dm_callback_type_response_arrived:
+        if (linkkit_ops->thing_reply) linkkit_ops->thing_reply(msg->thing_id, msg->request_id, msg->code, context);
+        break;
+#ifdef DM_BACKPRESSURE_ENABLED
+    case dm_callback_type_send_writable:
+        if (linkkit_ops->on_writable) linkkit_ops->on_writable(context);
+        break;
+#endif /* DM_BACKPRESSURE_ENABLED */
     default:
         break;
     }
 }
 
+/* handle one message and account its waiting and handling time. */
+static void dispatch_message(dm_msg_t* msg)
+{
+    uint64_t start_time = HAL_UptimeMs();
+    unsigned int wait_time = (unsigned int)(start_time - msg->submit_time);
+    unsigned int handle_time;
+
+    LITE_TRACE(LITE_TRACE_DISPATCH, msg->request_id);
+
+    handle_request(msg, user_ctx);
+
+    handle_time = (unsigned int)(HAL_UptimeMs() - start_time);
+
+    LITE_METRIC_OBSERVE(g_dispatch_wait_metric, wait_time);
+
+    HAL_MutexLock(g_dispatch_stats_mutex);
+    g_dispatch_stats.handled++;
+    g_dispatch_stats.wait_time_total_ms += wait_time;
+    if (wait_time > g_dispatch_stats.wait_time_max_ms) g_dispatch_stats.wait_time_max_ms = wait_time;
+    g_dispatch_stats.handle_time_total_ms += handle_time;
+    if (handle_time > g_dispatch_stats.handle_time_max_ms) g_dispatch_stats.handle_time_max_ms = handle_time;
+    HAL_MutexUnlock(g_dispatch_stats_mutex);
+}
+
 int linkkit_dispatch(void)
 {
     if (!g_message_queue || !user_ctx) {
@@ -128,12 +270,134 @@ int linkkit_dispatch(void)
     }
 
     while (1) {
-        dm_msg_t* msg = lite_queue_delete(g_message_queue);
-        if (!msg) break;
-        handle_request(msg, user_ctx);
-        free(msg);
+        dm_msg_t msg;
+        if (lite_ring_pop(g_message_queue, &msg) != 0) break;
+        dispatch_message(&msg);
     }
 
+#ifdef CMP_SUPPORT_MULTI_THREAD
+    /* no linkkit_yield to send coalesced posts due, they are queued to cmp thread from here. */
+    linkkit_flush_property_post(0);
+#endif
+
+    return 0;
+}
+
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+static void* dispatch_worker_routine(void* arg)
+{
+    linkkit_dispatch_worker_t* worker = arg;
+    dm_msg_t msg;
+
+    while (g_dispatch_worker_running) {
+        if (lite_ring_pop(worker->message_queue, &msg) != 0) {
+            HAL_SleepMs(LINKKIT_DISPATCH_WORKER_IDLE_MS);
+            continue;
+        }
+        dispatch_message(&msg);
+    }
+
+    HAL_SemaphorePost(worker->exit_sem);
+
+    return NULL;
+}
+
+static void stop_dispatch_workers(int worker_number)
+{
+    int index;
+
+    HAL_MutexLock(g_dispatch_submit_mutex);
+    g_dispatch_worker_number = 0;
+    HAL_MutexUnlock(g_dispatch_submit_mutex);
+    g_dispatch_worker_running = 0;
+
+    for (index = 0; index < worker_number; index++) {
+        HAL_SemaphoreWait(g_dispatch_workers[index].exit_sem, PLATFORM_WAIT_INFINITE);
+    }
+
+    for (index = 0; index < LINKKIT_DISPATCH_WORKER_MAX; index++) {
+        if (g_dispatch_workers[index].exit_sem) HAL_SemaphoreDestroy(g_dispatch_workers[index].exit_sem);
+        if (g_dispatch_workers[index].message_queue) lite_ring_destroy(g_dispatch_workers[index].message_queue);
+        g_dispatch_workers[index].exit_sem = NULL;
+        g_dispatch_workers[index].message_queue = NULL;
+    }
+}
+
+int linkkit_start_dispatch_workers(int worker_number)
+{
+    int index;
+    int started = 0;
+    void* thread = NULL;
+    hal_os_thread_param_t thread_param;
+    dm_msg_t msg;
+
+    if (!g_message_queue || !user_ctx || g_dispatch_worker_number > 0) return -1;
+
+    if (worker_number <= 0 || worker_number > LINKKIT_DISPATCH_WORKER_MAX) return -1;
+
+    for (index = 0; index < worker_number; index++) {
+        g_dispatch_workers[index].message_queue = lite_ring_create(g_message_queue->slot_number, sizeof(dm_msg_t),
+                                                                   (lite_ring_overflow_policy_t)g_message_overflow_policy, 1);
+        if (!g_dispatch_workers[index].message_queue) goto err_handler;
+        g_dispatch_workers[index].exit_sem = HAL_SemaphoreCreate();
+        if (!g_dispatch_workers[index].exit_sem) goto err_handler;
+    }
+
+    memset(&thread_param, 0, sizeof(hal_os_thread_param_t));
+    thread_param.stack_size = LINKKIT_DISPATCH_WORKER_STACK_SIZE;
+    thread_param.name = "linkkit_dispatch";
+
+    g_dispatch_worker_running = 1;
+
+    for (started = 0; started < worker_number; started++) {
+        if (HAL_ThreadCreate(&thread, dispatch_worker_routine, &g_dispatch_workers[started], &thread_param, NULL) != 0) goto err_handler;
+        HAL_ThreadDetach(thread);
+    }
+
+    /*
+     * submission waits until what was buffered before workers ran is handed over,
+     * so no later message of a thing is taken by its worker ahead of an earlier one.
+     */
+    HAL_MutexLock(g_dispatch_submit_mutex);
+    while (lite_ring_pop(g_message_queue, &msg) == 0) {
+        if (lite_ring_push(g_dispatch_workers[lite_ring_pick(msg.thing_id, worker_number)].message_queue, &msg) != 0) {
+            LINKKIT_EXPORT_PRINTF("\n---------------\nqueue full, message type %d dropped.\n---------------\n", msg.callback_type);
+        }
+    }
+    g_dispatch_worker_number = worker_number;
+    HAL_MutexUnlock(g_dispatch_submit_mutex);
+
+    return 0;
+
+err_handler:
+    stop_dispatch_workers(started);
+
+    return -1;
+}
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+
+int linkkit_get_dispatch_stats(linkkit_dispatch_stats_t* stats)
+{
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    int index;
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+
+    if (!stats || !g_message_queue) return -1;
+
+    HAL_MutexLock(g_dispatch_stats_mutex);
+    memcpy(stats, &g_dispatch_stats, sizeof(linkkit_dispatch_stats_t));
+    HAL_MutexUnlock(g_dispatch_stats_mutex);
+
+    stats->queue_depth = (unsigned int)lite_ring_count(g_message_queue);
+    stats->dropped = (unsigned int)lite_ring_dropped(g_message_queue);
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    for (index = 0; index < LINKKIT_DISPATCH_WORKER_MAX; index++) {
+        if (!g_dispatch_workers[index].message_queue) continue;
+        stats->queue_depth += (unsigned int)lite_ring_count(g_dispatch_workers[index].message_queue);
+        stats->dropped += (unsigned int)lite_ring_dropped(g_dispatch_workers[index].message_queue);
+    }
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+
     return 0;
 }
 
@@ -159,9 +423,33 @@ int linkkit_start(int max_buffered_msg, int get_tsl_from_cloud, linkkit_loglevel
 
     if (!ops || !user_context || max_buffered_msg <= 0) return ret;
 
-    g_message_queue = lite_queue_create(max_buffered_msg, 0);
+    g_message_queue = lite_ring_create(max_buffered_msg, sizeof(dm_msg_t), (lite_ring_overflow_policy_t)g_message_overflow_policy, 1);
     if (!g_message_queue) return ret;
 
+    g_dispatch_stats_mutex = HAL_MutexCreate();
+    if (!g_dispatch_stats_mutex) {
+        lite_ring_destroy(g_message_queue);
+        g_message_queue = NULL;
+        return ret;
+    }
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    g_dispatch_submit_mutex = HAL_MutexCreate();
+    if (!g_dispatch_submit_mutex) {
+        HAL_MutexDestroy(g_dispatch_stats_mutex);
+        g_dispatch_stats_mutex = NULL;
+        lite_ring_destroy(g_message_queue);
+        g_message_queue = NULL;
+        return ret;
+    }
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+    memset(&g_dispatch_stats, 0, sizeof(linkkit_dispatch_stats_t));
+
+    LITE_METRIC_REGISTER(g_queued_metric);
+    LITE_METRIC_REGISTER(g_dispatch_wait_metric);
+
+    /* the phases of getting online from here, see lite-startup.h. */
+    LITE_startup_reset();
+
     g_linkkit_ops = ops;
     user_ctx = user_context;
 
@@ -190,6 +478,15 @@ int linkkit_fota_init(handle_service_fota_callback_fp_t callback_fp)
 
     return ret;
 }
+
+int linkkit_fota_get_stats(service_ota_stats_t* stats)
+{
+    fota_t** ota = fota_object;
+
+    if (ota == NULL || *ota == NULL || (*ota)->get_stats == NULL) return -1;
+
+    return (*ota)->get_stats(ota, stats);
+}
 #ifdef SERVICE_COTA_ENABLED
 int linkkit_cota_init(handle_service_cota_callback_fp_t callback_fp)
 {
@@ -211,20 +508,69 @@ int linkkit_cota_init(handle_service_cota_callback_fp_t callback_fp)
 
     return ret;
 }
+
+int linkkit_cota_set_stream_callback(handle_service_cota_stream_fp_t stream_fp, void* ctx)
+{
+    cota_t** ota = cota_object;
+
+    if (ota == NULL || *ota == NULL || (*ota)->install_stream_callback_function == NULL) return -1;
+
+    (*ota)->install_stream_callback_function(ota, stream_fp, ctx);
+
+    return 0;
+}
+
+int linkkit_cota_get_stats(service_ota_stats_t* stats)
+{
+    cota_t** ota = cota_object;
+
+    if (ota == NULL || *ota == NULL || (*ota)->get_stats == NULL) return -1;
+
+    return (*ota)->get_stats(ota, stats);
+}
 #endif /* SERVICE_COTA_ENABLED*/
 #endif /* SERVICE_OTA_ENABLED */
+int linkkit_set_message_overflow_policy(linkkit_message_overflow_policy_t policy)
+{
+    if (policy < linkkit_message_overflow_drop_newest || policy >= linkkit_message_overflow_max) return -1;
+
+    g_message_overflow_policy = policy;
+
+    if (g_message_queue) lite_ring_set_overflow_policy(g_message_queue, (lite_ring_overflow_policy_t)policy);
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    {
+        int index;
+        for (index = 0; index < LINKKIT_DISPATCH_WORKER_MAX; index++) {
+            if (g_dispatch_workers[index].message_queue) lite_ring_set_overflow_policy(g_dispatch_workers[index].message_queue, (lite_ring_overflow_policy_t)policy);
+        }
+    }
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+
+    return 0;
+}
+
 int linkkit_end()
 {
-    if (g_message_queue) lite_queue_destroy(g_message_queue);
+#ifdef LINKKIT_DISPATCH_WORKER_ENABLED
+    /* workers may still call into dm, stop them first. */
+    stop_dispatch_workers(g_dispatch_worker_number);
+    if (g_dispatch_submit_mutex) HAL_MutexDestroy(g_dispatch_submit_mutex);
+    g_dispatch_submit_mutex = NULL;
+#endif /* LINKKIT_DISPATCH_WORKER_ENABLED */
+    if (g_message_queue) lite_ring_destroy(g_message_queue);
+    if (g_dispatch_stats_mutex) HAL_MutexDestroy(g_dispatch_stats_mutex);
 #ifdef SERVICE_OTA_ENABLED
     if (fota_object) delete_object(fota_object);
 #ifdef SERVICE_COTA_ENABLED
     if (cota_object) delete_object(cota_object);
 #endif /* SERVICE_COTA_ENABLED*/
 #endif /* SERVICE_OTA_ENABLED */
+    /* latest values of coalesced property posts are not lost. */
+    linkkit_flush_property_post(1);
     if (dm_object) delete_object(dm_object);
 
     g_message_queue = NULL;
+    g_dispatch_stats_mutex = NULL;
     dm_object = NULL;
 #ifdef SERVICE_OTA_ENABLED
     fota_object = NULL;
@@ -237,13 +583,23 @@ void* linkkit_set_tsl(const char* tsl, int tsl_len)
     void* thing = NULL;
     const dm_t** dm = dm_object;
 
-    if (dm && *dm && tsl && tsl_len > 0 && *tsl == '{' && *(tsl + tsl_len - 1) == '}') {
+    if (dm && *dm && tsl && tsl_len > 0 &&
+        ((*tsl == '{' && *(tsl + tsl_len - 1) == '}') || dm_tsl_blob_detect(tsl, tsl_len))) {
         thing = (*dm)->generate_new_thing(dm, tsl, tsl_len);
     }
 
     return thing;
 }
 
+int linkkit_set_tsls(const char* const* tsls, const int* tsl_lens, int number, void** things)
+{
+    const dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->generate_new_things == NULL || tsls == NULL || tsl_lens == NULL || things == NULL || number <= 0) return -1;
+
+    return (*dm)->generate_new_things(dm, tsls, tsl_lens, number, things);
+}
+
 int linkkit_set_value(linkkit_method_set_t method_set, const void* thing_id, const char* identifier, const void* value, const char* value_str)
 {
     dm_t** dm = dm_object;
@@ -298,6 +654,103 @@ int linkkit_get_value(linkkit_method_get_t method_get, const void* thing_id, con
 
     return ret;
 }
+void* linkkit_resolve_property_handle(const void* thing_id, const char* identifier)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || thing_id == NULL || identifier == NULL) return NULL;
+
+    return (*dm)->resolve_property_handle(dm, thing_id, identifier);
+}
+
+int linkkit_release_property_handle(void* handle)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || handle == NULL) return -1;
+
+    (*dm)->release_property_handle(dm, handle);
+
+    return 0;
+}
+
+int linkkit_set_value_by_handle(const void* handle, const void* value, const char* value_str)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || handle == NULL || (value == NULL && value_str == NULL)) return -1;
+
+    return (*dm)->set_property_value_by_handle(dm, handle, value, value_str);
+}
+
+int linkkit_get_value_by_handle(const void* handle, void* value, char** value_str)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || handle == NULL || (value == NULL && value_str == NULL)) return -1;
+
+    return (*dm)->get_property_value_by_handle(dm, handle, value, value_str);
+}
+
+int linkkit_get_value_copy(const void* thing_id, const char* identifier, void* value, char* buf, int buf_len)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || thing_id == NULL || identifier == NULL || (value == NULL && buf == NULL)) return -1;
+
+    return (*dm)->copy_property_value(dm, thing_id, identifier, value, buf, buf_len);
+}
+
+int linkkit_get_value_copy_by_handle(const void* handle, void* value, char* buf, int buf_len)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || handle == NULL || (value == NULL && buf == NULL)) return -1;
+
+    return (*dm)->copy_property_value_by_handle(dm, handle, value, buf, buf_len);
+}
+
+int linkkit_set_values(const void* thing_id, const linkkit_property_value_t* values, int number, int post)
+{
+    dm_t** dm = dm_object;
+    int ret;
+
+    if (dm == NULL || *dm == NULL || thing_id == NULL || values == NULL || number <= 0) return -1;
+
+    ret = (*dm)->set_property_values(dm, thing_id, values, number);
+
+    if (post && (*dm)->post_changed_property(dm, thing_id) != 0) ret = -1;
+
+    return ret;
+}
+
+int linkkit_set_array_values(const void* thing_id, const char* identifier, int start, const void* values, int number)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || thing_id == NULL || identifier == NULL || values == NULL) return -1;
+
+    return (*dm)->set_property_array_values(dm, thing_id, identifier, start, values, number);
+}
+
+int linkkit_get_array_values(const void* thing_id, const char* identifier, int start, void* values, int number)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || thing_id == NULL || identifier == NULL || values == NULL) return -1;
+
+    return (*dm)->get_property_array_values(dm, thing_id, identifier, start, values, number);
+}
+
+int linkkit_register_route(const char* method, linkkit_route_handler_fp_t handler, void* ctx)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || method == NULL || handler == NULL) return -1;
+
+    return (*dm)->register_route(dm, method, handler, ctx);
+}
+
 #ifdef RRPC_ENABLED
 int linkkit_answer_service(const void* thing_id, const char* service_identifier, int response_id, int code, int rrpc)
 #else
@@ -396,6 +849,24 @@ int linkkit_trigger_event(const void* thing_id, const char* event_identifier)
     return (*dm)->trigger_event(dm, thing_id, event_identifier, NULL);
 }
 
+int linkkit_trigger_event_async(const void* thing_id, const char* event_identifier, int timeout_ms)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->trigger_event_async == NULL || thing_id == NULL || event_identifier == NULL) return -1;
+
+    return (*dm)->trigger_event_async(dm, thing_id, event_identifier, NULL, timeout_ms, dm_reply_callback, NULL);
+}
+
+int linkkit_cancel_request(int request_id)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->cancel_request == NULL) return -1;
+
+    return (*dm)->cancel_request(dm, request_id);
+}
+
 int linkkit_post_property(const void* thing_id, const char* property_identifier)
 {
     dm_t** dm = dm_object;
@@ -405,6 +876,96 @@ int linkkit_post_property(const void* thing_id, const char* property_identifier)
     return (*dm)->trigger_event(dm, thing_id, EVENT_PROPERTY_POST_IDENTIFIER, property_identifier);
 }
 
+int linkkit_post_changed_property(const void* thing_id)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->post_changed_property == NULL || thing_id == NULL) return -1;
+
+    return (*dm)->post_changed_property(dm, thing_id);
+}
+
+int linkkit_set_property_post_schedule(int min_interval_ms, int max_latency_ms)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->set_property_post_schedule == NULL) return -1;
+
+    return (*dm)->set_property_post_schedule(dm, min_interval_ms, max_latency_ms);
+}
+
+#ifdef DM_REPORT_POLICY_ENABLED
+int linkkit_set_property_report_policy(const void* thing_id, const char* property_identifier,
+                                       const linkkit_report_policy_t* policy)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->set_property_report_policy == NULL || thing_id == NULL) return -1;
+
+    return (*dm)->set_property_report_policy(dm, thing_id, property_identifier, policy);
+}
+#endif /* DM_REPORT_POLICY_ENABLED */
+
+#ifdef DM_CHANNELS_ENABLED
+int linkkit_set_channel_route(const char* prefix, linkkit_channel_t channel)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->set_channel_route == NULL || prefix == NULL) return -1;
+
+    return (*dm)->set_channel_route(dm, prefix, channel);
+}
+#endif /* DM_CHANNELS_ENABLED */
+
+#ifdef DM_STATIC_THING_ENABLED
+int linkkit_bind_static_thing(const void* thing_id, const linkkit_static_thing_model_t* model, void* data)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->bind_static_thing == NULL || thing_id == NULL) return -1;
+
+    return (*dm)->bind_static_thing(dm, thing_id, model, data);
+}
+
+int linkkit_set_static_properties_changed(const void* thing_id, const unsigned char* ids)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->set_static_properties_changed == NULL || thing_id == NULL) return -1;
+
+    return (*dm)->set_static_properties_changed(dm, thing_id, ids);
+}
+#endif /* DM_STATIC_THING_ENABLED */
+
+int linkkit_flush_property_post(int force)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->flush_property_post == NULL) return -1;
+
+    return (*dm)->flush_property_post(dm, force);
+}
+
+int linkkit_set_metrics_post_interval(int interval_ms)
+{
+    dm_t** dm = dm_object;
+
+    if (dm == NULL || *dm == NULL || (*dm)->set_metrics_post_interval == NULL) return -1;
+
+    return (*dm)->set_metrics_post_interval(dm, interval_ms);
+}
+
+int linkkit_set_payload_format(linkkit_payload_format_t format)
+{
+    dm_t** dm = dm_object;
+
+    if (format < linkkit_payload_format_json || format >= linkkit_payload_format_max) return -1;
+
+    if (dm == NULL || *dm == NULL || (*dm)->set_payload_format == NULL) return -1;
+
+    return (*dm)->set_payload_format(dm, format == linkkit_payload_format_cbor ? dm_payload_format_cbor : dm_payload_format_json);
+}
+
 #ifndef CMP_SUPPORT_MULTI_THREAD
 int linkkit_yield(int timeout_ms)
 {
@@ -416,4 +977,15 @@ int linkkit_yield(int timeout_ms)
 
     return -1;
 }
+
+uint32_t linkkit_get_timeout(void)
+{
+    dm_t** dm = dm_object;
+
+    if (dm && *dm && (*dm)->get_timeout) {
+        return (*dm)->get_timeout(dm);
+    }
+
+    return 0;
+}
 #endif
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "lite_ring.h"
+
+#define LITE_RING_BLOCK_SLEEP_MS 10
+
+lite_ring_t* lite_ring_create(int slot_number, size_t item_size, lite_ring_overflow_policy_t overflow_policy, int synchronized)
+{
+    lite_ring_t* lite_ring;
+
+    if (slot_number <= 0 || item_size == 0) return NULL;
+
+    lite_ring = calloc(1, sizeof(lite_ring_t));
+
+    if (lite_ring == NULL) goto err_handler;
+
+    lite_ring->item_size = item_size;
+    lite_ring->slot_number = slot_number;
+    lite_ring->overflow_policy = overflow_policy;
+
+    lite_ring->lite_ring_slots = calloc(lite_ring->slot_number, lite_ring->item_size);
+
+    if (lite_ring->lite_ring_slots == NULL) goto err_handler;
+
+    if (synchronized) {
+        lite_ring->lite_ring_mutex = HAL_MutexCreate();
+
+        if (lite_ring->lite_ring_mutex == NULL) goto err_handler;
+    }
+
+    return lite_ring;
+
+err_handler:
+    if (lite_ring && lite_ring->lite_ring_slots) free(lite_ring->lite_ring_slots);
+
+    if (lite_ring) free(lite_ring);
+
+    return NULL;
+}
+
+void lite_ring_destroy(lite_ring_t* _lite_ring)
+{
+    lite_ring_t* lite_ring = _lite_ring;
+
+    if (!lite_ring) return;
+
+    if (lite_ring->lite_ring_slots) free(lite_ring->lite_ring_slots);
+
+    if (lite_ring->lite_ring_mutex) {
+        HAL_MutexDestroy(lite_ring->lite_ring_mutex);
+        lite_ring->lite_ring_mutex = NULL;
+    }
+
+    free(lite_ring);
+}
+
+void lite_ring_set_overflow_policy(lite_ring_t* _lite_ring, lite_ring_overflow_policy_t overflow_policy)
+{
+    lite_ring_t* lite_ring = _lite_ring;
+
+    if (!lite_ring) return;
+
+    if (lite_ring->lite_ring_mutex) HAL_MutexLock(lite_ring->lite_ring_mutex);
+    lite_ring->overflow_policy = overflow_policy;
+    if (lite_ring->lite_ring_mutex) HAL_MutexUnlock(lite_ring->lite_ring_mutex);
+}
+
+static void* lite_ring_slot(lite_ring_t* lite_ring, size_t index)
+{
+    return (char*)lite_ring->lite_ring_slots + (index % lite_ring->slot_number) * lite_ring->item_size;
+}
+
+/* copy item into a free slot, -1 when item is dropped. */
+int lite_ring_push(lite_ring_t* _lite_ring, const void* item)
+{
+    lite_ring_t* lite_ring = _lite_ring;
+
+    if (!lite_ring || !item) return -1;
+
+    if (lite_ring->lite_ring_mutex) HAL_MutexLock(lite_ring->lite_ring_mutex);
+
+    while (lite_ring->count == lite_ring->slot_number) {
+        if (lite_ring->overflow_policy == lite_ring_overflow_drop_oldest) {
+            lite_ring->head = (lite_ring->head + 1) % lite_ring->slot_number;
+            lite_ring->count--;
+            lite_ring->dropped++;
+        } else if (lite_ring->overflow_policy == lite_ring_overflow_block && lite_ring->lite_ring_mutex) {
+            HAL_MutexUnlock(lite_ring->lite_ring_mutex);
+            HAL_SleepMs(LITE_RING_BLOCK_SLEEP_MS);
+            HAL_MutexLock(lite_ring->lite_ring_mutex);
+        } else {
+            /* nobody else could pop for an unsynchronized ring, blocking would never return. */
+            lite_ring->dropped++;
+            if (lite_ring->lite_ring_mutex) HAL_MutexUnlock(lite_ring->lite_ring_mutex);
+            return -1;
+        }
+    }
+
+    memcpy(lite_ring_slot(lite_ring, lite_ring->head + lite_ring->count), item, lite_ring->item_size);
+    lite_ring->count++;
+
+    if (lite_ring->lite_ring_mutex) HAL_MutexUnlock(lite_ring->lite_ring_mutex);
+
+    return 0;
+}
+
+/* copy oldest item out and free its slot, -1 when empty. */
+int lite_ring_pop(lite_ring_t* _lite_ring, void* item)
+{
+    lite_ring_t* lite_ring = _lite_ring;
+    int ret = -1;
+
+    if (!lite_ring || !item) return -1;
+
+    if (lite_ring->lite_ring_mutex) HAL_MutexLock(lite_ring->lite_ring_mutex);
+
+    if (lite_ring->count) {
+        memcpy(item, lite_ring_slot(lite_ring, lite_ring->head), lite_ring->item_size);
+        lite_ring->head = (lite_ring->head + 1) % lite_ring->slot_number;
+        lite_ring->count--;
+        ret = 0;
+    }
+
+    if (lite_ring->lite_ring_mutex) HAL_MutexUnlock(lite_ring->lite_ring_mutex);
+
+    return ret;
+}
+
+size_t lite_ring_dropped(lite_ring_t* _lite_ring)
+{
+    lite_ring_t* lite_ring = _lite_ring;
+    size_t dropped;
+
+    if (!lite_ring) return 0;
+
+    if (lite_ring->lite_ring_mutex) HAL_MutexLock(lite_ring->lite_ring_mutex);
+    dropped = lite_ring->dropped;
+    if (lite_ring->lite_ring_mutex) HAL_MutexUnlock(lite_ring->lite_ring_mutex);
+
+    return dropped;
+}
+
+size_t lite_ring_count(lite_ring_t* _lite_ring)
+{
+    lite_ring_t* lite_ring = _lite_ring;
+    size_t count;
+
+    if (!lite_ring) return 0;
+
+    if (lite_ring->lite_ring_mutex) HAL_MutexLock(lite_ring->lite_ring_mutex);
+    count = lite_ring->count;
+    if (lite_ring->lite_ring_mutex) HAL_MutexUnlock(lite_ring->lite_ring_mutex);
+
+    return count;
+}
+
+size_t lite_ring_pick(const void* key, size_t ring_number)
+{
+    uintptr_t bits = (uintptr_t)key;
+    uint32_t hash;
+
+    if (ring_number == 0) return 0;
+
+    /* allocators align blocks to 8 or 16 bytes and space them alike, every bit of the address is mixed
+     * into the low ones, or keys of one allocator would only reach some of the rings. */
+    hash = (uint32_t)bits;
+#if UINTPTR_MAX > 0xffffffffu
+    hash ^= (uint32_t)(bits >> 32);
+#endif
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+
+    return hash % ring_number;
+}
@@ -373,6 +373,9 @@ int main(int argc, char **argv)
             HAL_Printf("\t-r jp \t\tSelect Japan demain.\r\n");
             HAL_Printf("\t-r us \t\tSelect America demain.\r\n");
             HAL_Printf("\t-r ger\t\tSelect Germany demain.\r\n");
+#ifdef REGION_AUTO_ENABLED
+            HAL_Printf("\t-r auto\t\tSelect the fastest demain.\r\n");
+#endif
             return 1;
         }
     }
@@ -426,6 +429,13 @@ int main(int argc, char **argv)
     IOT_OpenLog("mqtt");
     IOT_SetLogLevel(IOT_LOG_DEBUG);
     IOT_SetupDomain(domain_type);
+#ifdef REGION_AUTO_ENABLED
+    /* the device of PRODUCT_KEY, which must be reachable in every region */
+    if (0 == strncmp(region, "auto", strlen("auto")))
+    {
+        EXAMPLE_TRACE("Domain %d selected", IOT_SetupDomainAuto(PRODUCT_KEY));
+    }
+#endif
 
     mqtt_client();
 
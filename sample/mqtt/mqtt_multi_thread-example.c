@@ -211,6 +211,15 @@ void CASE2(void * pclient)
 }
 
 
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+#define MQTT_ASYNC_QUEUE_LEN    (16)
+
+/* called from the yield thread once the message is acknowledged, timed out or failed */
+static void _demo_publish_done(void *pcontext, int packet_id, iotx_mqtt_publish_result_t result)
+{
+    EXAMPLE_TRACE("%s publish done, packet-id=%d, result=%d", (const char *)pcontext, packet_id, result);
+}
+#endif
 
 void* thread_publish1(void *pclient)
 {
@@ -226,7 +235,11 @@ void* thread_publish1(void *pclient)
     topic_msg.payload_len = strlen(msg_pub);
 
     while(--cnt) {
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+        ret = IOT_MQTT_PublishAsync(pclient, TOPIC_DATA, &topic_msg, _demo_publish_done, "thread1");
+#else
         ret = IOT_MQTT_Publish(pclient, TOPIC_DATA, &topic_msg);
+#endif
         printf("thread<%d>:ret = %d\n", (int)pthread_self(), ret);
         HAL_SleepMs(300);
     }
@@ -248,7 +261,11 @@ void* thread_publish2(void *pclient)
     topic_msg.payload_len = strlen(msg_pub);
 
     while(--cnt) {
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+        ret = IOT_MQTT_PublishAsync(pclient, TOPIC_DATA, &topic_msg, _demo_publish_done, "thread2");
+#else
         ret = IOT_MQTT_Publish(pclient, TOPIC_DATA, &topic_msg);
+#endif
         printf("thread<%d>:ret = %d\n", (int)pthread_self(), ret);
         HAL_SleepMs(200);
     }
@@ -294,9 +311,14 @@ static int yield_exit = 0;
 void *thread_yield(void *pclient)
 {
     while(yield_exit == 0) {
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+        /* queued messages go out from here, so no sleep between the reads */
+        IOT_MQTT_YieldAsync(pclient, 200);
+#else
         IOT_MQTT_Yield(pclient, 200);
         
         HAL_SleepMs(200);
+#endif
     }
 
     return NULL;
@@ -359,7 +381,11 @@ int mqtt_client(void)
 
 
     /* Construct a MQTT client with specify parameter */
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+    pclient = IOT_MQTT_ConstructAsync(&mqtt_params, MQTT_ASYNC_QUEUE_LEN);
+#else
     pclient = IOT_MQTT_Construct(&mqtt_params);
+#endif
     if (NULL == pclient) {
         EXAMPLE_TRACE("MQTT construct failed");
         rc = -1;
@@ -384,7 +410,11 @@ int mqtt_client(void)
     HAL_SleepMs(200);
     
 
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+    IOT_MQTT_DestroyAsync(&pclient);
+#else
     IOT_MQTT_Destroy(&pclient);
+#endif
 
 do_exit:
     if (NULL != msg_buf) {
@@ -27,7 +27,11 @@
 #include "json_parser.h"
 #include "CoAPMessage.h"
 #include "CoAPExport.h"
+#include "CoAPSerialize.h"
+#include "CoAPBlock.h"
+#include "CoAPObserve.h"
 #include "lite-system.h"
+#include "utils_token.h"
 
 #define IOTX_SIGN_LENGTH         (40+1)
 #define IOTX_SIGN_SOURCE_LEN     (256)
@@ -42,6 +46,8 @@
 
 #define IOTX_COAP_ONLINE_DTLS_SERVER_URL "coaps://%s.iot-as-coap.cn-shanghai.aliyuncs.com:5684"
 
+#define IOTX_COAP_TOKEN_KV_KEY   "coap.token"
+
 
 typedef struct {
     char                *p_auth_token;
@@ -51,10 +57,57 @@ typedef struct {
     CoAPContext         *p_coap_ctx;
     unsigned int         coap_token;
     iotx_event_handle_t  event_handle;
+    utils_hmac_ctx_t     sign_ctx;          /* the device secret, set up once for every auth */
+    utils_token_t        token_life;        /* of p_auth_token, refreshed ahead of its lapse by the yields */
 } iotx_coap_t;
 
+/*
+ * auth token of the last context, kept across IOT_CoAP_Deinit so the next one of the same device skips the auth,
+ * and saved under IOTX_COAP_TOKEN_KV_KEY for the same after a restart
+ */
+typedef struct {
+    char                 valid;
+    char                 product_key[IOTX_PRODUCT_KEY_LEN + 1];
+    char                 device_name[IOTX_DEVICE_NAME_LEN + 1];
+    char                 auth_token[IOTX_AUTH_TOKEN_LEN];
+    utils_token_t        life;
+} iotx_coap_resume_t;
+
+static iotx_coap_resume_t iotx_coap_resume;
+
+static int iotx_coap_resume_match(iotx_coap_t *p_iotx_coap)
+{
+    if (iotx_coap_resume.valid
+        && 0 == strncmp(iotx_coap_resume.product_key, p_iotx_coap->p_devinfo->product_key, IOTX_PRODUCT_KEY_LEN)
+        && 0 == strncmp(iotx_coap_resume.device_name, p_iotx_coap->p_devinfo->device_name, IOTX_DEVICE_NAME_LEN)) {
+        return 1;
+    }
+
+    /* or the one an earlier run saved */
+    memset(&iotx_coap_resume, 0x00, sizeof(iotx_coap_resume_t));
+    if (0 != utils_token_load(IOTX_COAP_TOKEN_KV_KEY, p_iotx_coap->p_devinfo->product_key,
+                              p_iotx_coap->p_devinfo->device_name, iotx_coap_resume.auth_token,
+                              IOTX_AUTH_TOKEN_LEN, &iotx_coap_resume.life)) {
+        return 0;
+    }
+    strncpy(iotx_coap_resume.product_key, p_iotx_coap->p_devinfo->product_key, IOTX_PRODUCT_KEY_LEN);
+    strncpy(iotx_coap_resume.device_name, p_iotx_coap->p_devinfo->device_name, IOTX_DEVICE_NAME_LEN);
+    iotx_coap_resume.valid = 1;
+    return 1;
+}
+
+static void iotx_coap_resume_save(iotx_coap_t *p_iotx_coap)
+{
+    memset(&iotx_coap_resume, 0x00, sizeof(iotx_coap_resume_t));
+    strncpy(iotx_coap_resume.product_key, p_iotx_coap->p_devinfo->product_key, IOTX_PRODUCT_KEY_LEN);
+    strncpy(iotx_coap_resume.device_name, p_iotx_coap->p_devinfo->device_name, IOTX_DEVICE_NAME_LEN);
+    strncpy(iotx_coap_resume.auth_token, p_iotx_coap->p_auth_token, IOTX_AUTH_TOKEN_LEN - 1);
+    iotx_coap_resume.life = p_iotx_coap->token_life;
+    iotx_coap_resume.valid = 1;
+}
+
 
-int iotx_calc_sign(const char *p_device_secret, const char *p_client_id,
+int iotx_calc_sign(const utils_hmac_ctx_t *p_sign_ctx, const char *p_client_id,
                    const char *p_device_name, const char *p_product_key, char sign[IOTX_SIGN_LENGTH])
 {
     char *p_msg = NULL;
@@ -71,29 +124,30 @@ int iotx_calc_sign(const char *p_device_secret, const char *p_client_id,
                  p_client_id,
                  p_device_name,
                  p_product_key);
-    utils_hmac_md5(p_msg, strlen(p_msg), sign, p_device_secret, strlen(p_device_secret));
+    utils_hmac_sign(p_sign_ctx, p_msg, strlen(p_msg), sign);
 
     coap_free(p_msg);
     COAP_DEBUG("The device name sign: %s", sign);
     return IOTX_SUCCESS;
 }
 
-static int iotx_get_token_from_json(char *p_str, char *p_token, int len)
+/* p_str is the payload in the receive buffer, str_len bytes not NUL terminated, the token is parsed in place */
+static int iotx_get_token_from_json(char *p_str, int str_len, char *p_token, int len)
 {
     char *p_value = NULL;
+    int   value_len = 0;
     if (NULL == p_str || NULL == p_token) {
         COAP_ERR("Invalid paramter p_str %p, p_token %p", p_str, p_token);
         return IOTX_ERR_INVALID_PARAM;
     }
 
-    p_value = LITE_json_value_of("token", p_str);
+    p_value = json_get_value_by_name(p_str, str_len, "token", &value_len, 0);
     if (NULL != p_value) {
-        if (len - 1 < strlen(p_value)) {
+        if (len - 1 < value_len) {
             return IOTX_ERR_BUFF_TOO_SHORT;
         }
         memset(p_token, 0x00, len);
-        strncpy(p_token, p_value, strlen(p_value));
-        LITE_free(p_value);
+        memcpy(p_token, p_value, value_len);
         return IOTX_SUCCESS;
     }
 
@@ -118,13 +172,18 @@ static void iotx_device_name_auth_callback(void *user, void *p_message)
     }
     COAP_DEBUG("Receive response message:");
     COAP_DEBUG("* Response Code : 0x%x", message->header.code);
-    COAP_DEBUG("* Payload: %s", message->payload);
+    COAP_DEBUG("* Payload: %.*s", message->payloadlen, message->payload);
 
     switch (message->header.code) {
         case COAP_MSG_CODE_205_CONTENT: {
-            ret_code = iotx_get_token_from_json((char *)message->payload, p_iotx_coap->p_auth_token, p_iotx_coap->auth_token_len);
+            ret_code = iotx_get_token_from_json((char *)message->payload, message->payloadlen,
+                                                p_iotx_coap->p_auth_token, p_iotx_coap->auth_token_len);
             if (IOTX_SUCCESS == ret_code) {
                 p_iotx_coap->is_authed = IOT_TRUE;
+                utils_token_start(&p_iotx_coap->token_life, p_iotx_coap->p_auth_token);
+                utils_token_save(IOTX_COAP_TOKEN_KV_KEY, p_iotx_coap->p_devinfo->product_key,
+                                 p_iotx_coap->p_devinfo->device_name, p_iotx_coap->p_auth_token,
+                                 &p_iotx_coap->token_life);
                 COAP_INFO("CoAP authenticate success!!!");
             }
             break;
@@ -159,7 +218,7 @@ void iotx_event_notifyer(unsigned int code, CoAPMessage *message)
         return ;
     }
 
-    COAP_DEBUG("Error code: 0x%x, payload: %s", code, message->payload);
+    COAP_DEBUG("Error code: 0x%x, payload: %.*s", code, message->payloadlen, message->payload);
     switch (code) {
         case COAP_MSG_CODE_402_BAD_OPTION:
         case COAP_MSG_CODE_401_UNAUTHORIZED: {
@@ -167,6 +226,8 @@ void iotx_event_notifyer(unsigned int code, CoAPMessage *message)
             if (NULL != message->user) {
                 p_context = (iotx_coap_t *)message->user;
                 p_context->is_authed = IOT_FALSE;
+                iotx_coap_resume.valid = 0;
+                utils_token_forget(IOTX_COAP_TOKEN_KV_KEY);
                 IOT_CoAP_DeviceNameAuth(p_context);
                 COAP_INFO("IoTx token expired, will reauthenticate");
             }
@@ -189,7 +250,7 @@ static void iotx_get_well_known_handler(void *arg, void *p_response)
     IOT_CoAP_GetMessageCode(p_response, &resp_code);
     IOT_CoAP_GetMessagePayload(p_response, &p_payload, &len);
     COAP_INFO("[APPL]: Message response code: %d", resp_code);
-    COAP_INFO("[APPL]: Len: %d, Payload: %s, ", len, p_payload);
+    COAP_INFO("[APPL]: Len: %d, Payload: %.*s, ", len, len, p_payload);
 }
 
 
@@ -233,10 +294,10 @@ static void iotx_coap_mid_rsphdl(void *arg, void *p_response)
     log_debug("MID Report: CoAP response code = %d", resp_code);
     log_debug("MID Report: CoAP msg_len = %d", p_payload_len);
     if (p_payload_len > 0) {
-        log_debug("MID Report: CoAP msg = '%s'", p_payload);
+        log_debug("MID Report: CoAP msg = '%.*s'", p_payload_len, p_payload);
         msg = json_get_value_by_name((char *)p_payload, p_payload_len, "id", &p_payload_len, 0);
         if (NULL != msg) {
-            log_debug("MID Report: CoAP mid_report responseID = '%s'", msg);
+            log_debug("MID Report: CoAP mid_report responseID = '%.*s'", p_payload_len, msg);
         } else {
             log_warning("MID Report: CoAP mid_report responseID not found in msg");
         }
@@ -329,26 +390,17 @@ static int iotx_coap_report_mid(iotx_coap_context_t *p_context)
     return SUCCESS_RETURN;
 }
 
-int IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context)
+/* the auth request, its reply sets the token in the callback */
+static int iotx_coap_auth_send(iotx_coap_t *p_iotx_coap)
 {
     int len = 0;
     int ret = COAP_SUCCESS;
-    CoAPContext      *p_coap_ctx = NULL;
-    iotx_coap_t      *p_iotx_coap = NULL;
+    CoAPContext      *p_coap_ctx = (CoAPContext *)p_iotx_coap->p_coap_ctx;
     CoAPMessage       message;
     unsigned char    *p_payload   = NULL;
     unsigned char     token[8] = {0};
     char sign[IOTX_SIGN_LENGTH]   = {0};
 
-    p_iotx_coap = (iotx_coap_t *)p_context;
-    if (NULL == p_iotx_coap || (NULL != p_iotx_coap && (NULL == p_iotx_coap->p_auth_token
-                                || NULL == p_iotx_coap->p_coap_ctx || 0 == p_iotx_coap->auth_token_len))) {
-        COAP_DEBUG("Invalid paramter");
-        return IOTX_ERR_INVALID_PARAM;
-    }
-
-    p_coap_ctx = (CoAPContext *)p_iotx_coap->p_coap_ctx;
-
     CoAPMessage_init(&message);
     CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_CON);
     CoAPMessageCode_set(&message, COAP_MSG_CODE_POST);
@@ -367,7 +419,7 @@ int IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context)
         CoAPMessage_destory(&message);
         return IOTX_ERR_NO_MEM;
     }
-    iotx_calc_sign(p_iotx_coap->p_devinfo->device_secret, p_iotx_coap->p_devinfo->device_id,
+    iotx_calc_sign(&p_iotx_coap->sign_ctx, p_iotx_coap->p_devinfo->device_id,
                    p_iotx_coap->p_devinfo->device_name, p_iotx_coap->p_devinfo->product_key, sign);
     HAL_Snprintf((char *)p_payload, COAP_MSG_MAX_PDU_LEN,
                  IOTX_AUTH_DEVICENAME_STR,
@@ -387,6 +439,49 @@ int IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context)
         return IOTX_ERR_SEND_MSG_FAILED;
     }
 
+    return IOTX_SUCCESS;
+}
+
+/* ahead of its lapse the token is refreshed without waiting, the one in hand serves till the reply replaces it */
+static void iotx_coap_token_refresh(iotx_coap_t *p_iotx_coap)
+{
+    if (p_iotx_coap->is_authed && utils_token_due(&p_iotx_coap->token_life)) {
+        utils_token_retry(&p_iotx_coap->token_life);
+        if (IOTX_SUCCESS != iotx_coap_auth_send(p_iotx_coap)) {
+            COAP_INFO("CoAP token refresh failed, will retry it");
+        }
+    }
+}
+
+int IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context)
+{
+    int ret = COAP_SUCCESS;
+    CoAPContext      *p_coap_ctx = NULL;
+    iotx_coap_t      *p_iotx_coap = NULL;
+
+    p_iotx_coap = (iotx_coap_t *)p_context;
+    if (NULL == p_iotx_coap || (NULL != p_iotx_coap && (NULL == p_iotx_coap->p_auth_token
+                                || NULL == p_iotx_coap->p_coap_ctx || 0 == p_iotx_coap->auth_token_len))) {
+        COAP_DEBUG("Invalid paramter");
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    p_coap_ctx = (CoAPContext *)p_iotx_coap->p_coap_ctx;
+
+    /* the server answers 4.01 once the token expires, then the notifier drops it and authenticates again */
+    if (iotx_coap_resume_match(p_iotx_coap)) {
+        strncpy(p_iotx_coap->p_auth_token, iotx_coap_resume.auth_token, p_iotx_coap->auth_token_len - 1);
+        p_iotx_coap->token_life = iotx_coap_resume.life;
+        p_iotx_coap->is_authed = IOT_TRUE;
+        COAP_INFO("CoAP authenticate with the saved token");
+        return IOTX_SUCCESS;
+    }
+
+    ret = iotx_coap_auth_send(p_iotx_coap);
+    if (IOTX_SUCCESS != ret) {
+        return ret;
+    }
+
     ret = CoAPMessage_recv(p_coap_ctx, CONFIG_COAP_AUTH_TIMEOUT, 2);
     if (0 < ret && !p_iotx_coap->is_authed) {
         COAP_INFO("CoAP authenticate failed");
@@ -443,22 +538,61 @@ static int iotx_split_path_2_option(char *uri, CoAPMessage *message)
     return IOTX_SUCCESS;
 }
 
-int IOT_CoAP_SendMessage(iotx_coap_context_t *p_context, char *p_path, iotx_message_t *p_message)
+/* the path as a string split at every send, or one split once */
+static int iotx_coap_message_build(iotx_coap_t *p_iotx_coap, char *p_path, CoAPPath *path,
+                                   iotx_message_t *p_message, CoAPMessage *message)
 {
-
     int len = 0;
+    int ret = IOTX_SUCCESS;
+    CoAPContext      *p_coap_ctx = (CoAPContext *)p_iotx_coap->p_coap_ctx;
+    unsigned char    token[8] = {0};
+
+    CoAPMessage_init(message);
+    CoAPMessageType_set(message, COAP_MESSAGE_TYPE_CON);
+    CoAPMessageCode_set(message, COAP_MSG_CODE_POST);
+    CoAPMessageId_set(message, CoAPMessageId_gen(p_coap_ctx));
+    len = iotx_get_coap_token(p_iotx_coap, token);
+    CoAPMessageToken_set(message, token, len);
+    CoAPMessageUserData_set(message, (void *)p_message->user_data);
+    CoAPMessageHandler_set(message, p_message->resp_callback);
+
+    if (NULL != path) {
+        ret = (COAP_SUCCESS == CoAPPathOption_add(message, path)) ? IOTX_SUCCESS : IOTX_ERR_INVALID_PARAM;
+    } else {
+        ret = iotx_split_path_2_option(p_path, message);
+    }
+    if (IOTX_SUCCESS != ret) {
+        CoAPMessage_destory(message);
+        return ret;
+    }
+
+    if (IOTX_CONTENT_TYPE_CBOR == p_message->content_type) {
+        CoAPUintOption_add(message, COAP_OPTION_CONTENT_FORMAT, COAP_CT_APP_CBOR);
+        CoAPUintOption_add(message, COAP_OPTION_ACCEPT, COAP_CT_APP_OCTET_STREAM);
+    } else {
+        CoAPUintOption_add(message, COAP_OPTION_CONTENT_FORMAT, COAP_CT_APP_JSON);
+        CoAPUintOption_add(message, COAP_OPTION_ACCEPT, COAP_CT_APP_OCTET_STREAM);
+    }
+    CoAPStrOption_add(message,  COAP_OPTION_AUTH_TOKEN,
+                      (unsigned char *)p_iotx_coap->p_auth_token, strlen(p_iotx_coap->p_auth_token));
+
+    return IOTX_SUCCESS;
+}
+
+static int iotx_coap_send(iotx_coap_context_t *p_context, char *p_path, CoAPPath *path, iotx_message_t *p_message)
+{
+
     int ret = IOTX_SUCCESS;
     CoAPContext      *p_coap_ctx = NULL;
     iotx_coap_t      *p_iotx_coap = NULL;
     CoAPMessage      message;
-    unsigned char    token[8] = {0};
 
     p_iotx_coap = (iotx_coap_t *)p_context;
 
-    if (NULL == p_context || NULL == p_path || NULL == p_message ||
+    if (NULL == p_context || (NULL == p_path && NULL == path) || NULL == p_message ||
         (NULL != p_iotx_coap && NULL == p_iotx_coap->p_coap_ctx)) {
         COAP_ERR("Invalid paramter p_context %p, p_uri %p, p_message %p",
-                 p_context, p_path, p_message);
+                 p_context, (NULL != path) ? (void *)path : (void *)p_path, p_message);
         return IOTX_ERR_INVALID_PARAM;
     }
 
@@ -472,30 +606,11 @@ int IOT_CoAP_SendMessage(iotx_coap_context_t *p_context, char *p_path, iotx_mess
     p_coap_ctx = (CoAPContext *)p_iotx_coap->p_coap_ctx;
     if (p_iotx_coap->is_authed) {
 
-        CoAPMessage_init(&message);
-        CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_CON);
-        CoAPMessageCode_set(&message, COAP_MSG_CODE_POST);
-        CoAPMessageId_set(&message, CoAPMessageId_gen(p_coap_ctx));
-        len = iotx_get_coap_token(p_iotx_coap, token);
-        CoAPMessageToken_set(&message, token, len);
-        CoAPMessageUserData_set(&message, (void *)p_message->user_data);
-        CoAPMessageHandler_set(&message, p_message->resp_callback);
-
-        ret = iotx_split_path_2_option(p_path, &message);
+        ret = iotx_coap_message_build(p_iotx_coap, p_path, path, p_message, &message);
         if (IOTX_SUCCESS != ret) {
             return ret;
         }
 
-        if (IOTX_CONTENT_TYPE_CBOR == p_message->content_type) {
-            CoAPUintOption_add(&message, COAP_OPTION_CONTENT_FORMAT, COAP_CT_APP_CBOR);
-            CoAPUintOption_add(&message, COAP_OPTION_ACCEPT, COAP_CT_APP_OCTET_STREAM);
-        } else {
-            CoAPUintOption_add(&message, COAP_OPTION_CONTENT_FORMAT, COAP_CT_APP_JSON);
-            CoAPUintOption_add(&message, COAP_OPTION_ACCEPT, COAP_CT_APP_OCTET_STREAM);
-        }
-        CoAPStrOption_add(&message,  COAP_OPTION_AUTH_TOKEN,
-                          (unsigned char *)p_iotx_coap->p_auth_token, strlen(p_iotx_coap->p_auth_token));
-
         CoAPMessagePayload_set(&message, p_message->p_payload, p_message->payload_len);
 
         ret = CoAPMessage_send(p_coap_ctx, &message);
@@ -510,6 +625,156 @@ int IOT_CoAP_SendMessage(iotx_coap_context_t *p_context, char *p_path, iotx_mess
     }
 }
 
+int IOT_CoAP_SendMessage(iotx_coap_context_t *p_context, char *p_path, iotx_message_t *p_message)
+{
+    return iotx_coap_send(p_context, p_path, NULL, p_message);
+}
+
+iotx_coap_path_t *IOT_CoAP_PathCreate(const char *p_path)
+{
+    CoAPPath *path = NULL;
+
+    if (NULL == p_path || IOTX_URI_MAX_LEN < strlen(p_path)) {
+        COAP_ERR("Invalid paramter p_path %p", p_path);
+        return NULL;
+    }
+
+    path = CoAPPath_create(p_path);
+    if (NULL == path) {
+        COAP_ERR("The path %s can't be split", p_path);
+    }
+    return (iotx_coap_path_t *)path;
+}
+
+void IOT_CoAP_PathDestroy(iotx_coap_path_t **pp_path)
+{
+    if (NULL != pp_path && NULL != *pp_path) {
+        CoAPPath_free((CoAPPath *)*pp_path);
+        *pp_path = NULL;
+    }
+}
+
+int IOT_CoAP_SendPathMessage(iotx_coap_context_t *p_context, iotx_coap_path_t *p_path, iotx_message_t *p_message)
+{
+    if (NULL == p_path) {
+        COAP_ERR("Invalid paramter p_path %p", p_path);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+    return iotx_coap_send(p_context, NULL, (CoAPPath *)p_path, p_message);
+}
+
+
+int IOT_CoAP_SendBlockMessage(iotx_coap_context_t *p_context, char *p_path, iotx_message_t *p_message,
+                              iotx_block_read_callback_t read_cb, iotx_block_write_callback_t write_cb,
+                              unsigned int block_size)
+{
+    int ret = IOTX_SUCCESS;
+    unsigned char szx = 0;
+    iotx_coap_t      *p_iotx_coap = NULL;
+    CoAPMessage      message;
+
+    p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_context || NULL == p_path || NULL == p_message ||
+        (NULL != p_iotx_coap && NULL == p_iotx_coap->p_coap_ctx)) {
+        COAP_ERR("Invalid paramter p_context %p, p_uri %p, p_message %p",
+                 p_context, p_path, p_message);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    while (szx <= COAP_BLOCK_SZX_1024 && COAP_BLOCK_SIZE(szx) != block_size) {
+        szx++;
+    }
+    if (COAP_BLOCK_SZX_1024 < szx) {
+        COAP_ERR("Invalid block size %d", block_size);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    if (!p_iotx_coap->is_authed) {
+        return IOTX_ERR_NOT_AUTHED;
+    }
+
+    ret = iotx_coap_message_build(p_iotx_coap, p_path, NULL, p_message, &message);
+    if (IOTX_SUCCESS != ret) {
+        return ret;
+    }
+
+    ret = CoAPBlockMessage_send((CoAPContext *)p_iotx_coap->p_coap_ctx, &message, szx,
+                                (CoAPBlockReadHandler)read_cb, (CoAPBlockWriteHandler)write_cb);
+    CoAPMessage_destory(&message);
+    if (COAP_ERROR_MALLOC == ret) {
+        return IOTX_ERR_NO_MEM;
+    } else if (COAP_SUCCESS != ret) {
+        return IOTX_ERR_SEND_MSG_FAILED;
+    }
+    return IOTX_SUCCESS;
+}
+
+int IOT_CoAP_Observe(iotx_coap_context_t *p_context, char *p_path, iotx_message_t *p_message,
+                     unsigned int *p_observe_id)
+{
+    int ret = IOTX_SUCCESS;
+    iotx_coap_t      *p_iotx_coap = NULL;
+    CoAPMessage      message;
+
+    p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_context || NULL == p_path || NULL == p_message || NULL == p_observe_id ||
+        (NULL != p_iotx_coap && NULL == p_iotx_coap->p_coap_ctx)) {
+        COAP_ERR("Invalid paramter p_context %p, p_uri %p, p_message %p",
+                 p_context, p_path, p_message);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    if (!p_iotx_coap->is_authed) {
+        return IOTX_ERR_NOT_AUTHED;
+    }
+
+    /* the observation is identified by its token */
+    *p_observe_id = p_iotx_coap->coap_token;
+    ret = iotx_coap_message_build(p_iotx_coap, p_path, NULL, p_message, &message);
+    if (IOTX_SUCCESS != ret) {
+        return ret;
+    }
+    CoAPMessageCode_set(&message, COAP_MSG_CODE_GET);
+
+    ret = CoAPObserve_register((CoAPContext *)p_iotx_coap->p_coap_ctx, &message);
+    CoAPMessage_destory(&message);
+    if (COAP_ERROR_MALLOC == ret) {
+        return IOTX_ERR_NO_MEM;
+    } else if (COAP_SUCCESS != ret) {
+        return IOTX_ERR_SEND_MSG_FAILED;
+    }
+    return IOTX_SUCCESS;
+}
+
+int IOT_CoAP_ObserveCancel(iotx_coap_context_t *p_context, unsigned int observe_id)
+{
+    int ret = IOTX_SUCCESS;
+    iotx_coap_t      *p_iotx_coap = NULL;
+    unsigned char    token[8] = {0};
+
+    p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_context || NULL == p_iotx_coap->p_coap_ctx) {
+        COAP_ERR("Invalid paramter p_context %p", p_context);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    token[0] = (unsigned char)(observe_id & 0x000000FF);
+    token[1] = (unsigned char)((observe_id & 0x0000FF00) >> 8);
+    token[2] = (unsigned char)((observe_id & 0x00FF0000) >> 16);
+    token[3] = (unsigned char)((observe_id & 0xFF000000) >> 24);
+
+    ret = CoAPObserve_deregister((CoAPContext *)p_iotx_coap->p_coap_ctx, token, sizeof(unsigned int),
+                                 p_iotx_coap->is_authed);
+    if (COAP_ERROR_NOT_FOUND == ret) {
+        return IOTX_ERR_INVALID_PARAM;
+    } else if (COAP_SUCCESS != ret) {
+        return IOTX_ERR_SEND_MSG_FAILED;
+    }
+    return IOTX_SUCCESS;
+}
 
 int IOT_CoAP_GetMessagePayload(void *p_message, unsigned char **pp_payload, int *p_len)
 {
@@ -592,6 +857,11 @@ iotx_coap_context_t *IOT_CoAP_Init(iotx_coap_config_t *p_config)
         strncpy(p_iotx_coap->p_devinfo->device_secret, p_config->p_devinfo->device_secret, IOTX_DEVICE_SECRET_LEN);
         strncpy(p_iotx_coap->p_devinfo->device_name,  p_config->p_devinfo->device_name, IOTX_DEVICE_NAME_LEN);
     }
+    if (0 != utils_hmac_setkey(&p_iotx_coap->sign_ctx, UTILS_HMAC_MD5, p_iotx_coap->p_devinfo->device_secret,
+                               strlen(p_iotx_coap->p_devinfo->device_secret))) {
+        COAP_ERR(" Set up the sign key failed");
+        goto err;
+    }
 
     /*Init coap token*/
     p_iotx_coap->coap_token = IOTX_COAP_INIT_TOKEN;
@@ -609,6 +879,17 @@ iotx_coap_context_t *IOT_CoAP_Init(iotx_coap_config_t *p_config)
     param.maxcount = IOTX_LIST_MAX_ITEM;
     param.notifier = (CoAPEventNotifier)iotx_event_notifyer;
     param.waittime = p_config->wait_time_ms;
+    param.nstart = p_config->nstart;
+    param.cocoa = p_config->cocoa;
+#ifdef COAP_GROUP_ENABLED
+    param.group = (CoAPGroup *)p_config->p_group;
+    param.user = p_iotx_coap;
+#else
+    if (NULL != p_config->p_group) {
+        COAP_ERR(" CoAP groups are not enabled");
+        goto err;
+    }
+#endif
     p_iotx_coap->p_coap_ctx = CoAPContext_create(&param);
     if (NULL == p_iotx_coap->p_coap_ctx) {
         COAP_ERR(" Create coap context failed");
@@ -635,6 +916,7 @@ err:
 
         p_iotx_coap->auth_token_len = 0;
         p_iotx_coap->is_authed = IOT_FALSE;
+        utils_hmac_free(&p_iotx_coap->sign_ctx);
         coap_free(p_iotx_coap);
     }
     return NULL;
@@ -646,6 +928,9 @@ void IOT_CoAP_Deinit(iotx_coap_context_t **pp_context)
 
     if (NULL != pp_context && NULL != *pp_context) {
         p_iotx_coap = (iotx_coap_t *)*pp_context;
+        if (p_iotx_coap->is_authed && NULL != p_iotx_coap->p_auth_token && NULL != p_iotx_coap->p_devinfo) {
+            iotx_coap_resume_save(p_iotx_coap);
+        }
         p_iotx_coap->is_authed = IOT_FALSE;
         p_iotx_coap->auth_token_len = 0;
         p_iotx_coap->coap_token = IOTX_COAP_INIT_TOKEN;
@@ -664,6 +949,7 @@ void IOT_CoAP_Deinit(iotx_coap_context_t **pp_context)
             CoAPContext_free(p_iotx_coap->p_coap_ctx);
             p_iotx_coap->p_coap_ctx = NULL;
         }
+        utils_hmac_free(&p_iotx_coap->sign_ctx);
         coap_free(p_iotx_coap);
         *pp_context = NULL;
     }
@@ -678,6 +964,86 @@ int IOT_CoAP_Yield(iotx_coap_context_t *p_context)
         return IOTX_ERR_INVALID_PARAM;
     }
 
+    iotx_coap_token_refresh(p_iotx_coap);
     return CoAPMessage_cycle(p_iotx_coap->p_coap_ctx);
 }
 
+#ifdef COAP_GROUP_ENABLED
+iotx_coap_group_t *IOT_CoAP_GroupCreate(char *p_url, unsigned int capacity, int wait_time_ms)
+{
+    if (NULL == p_url || 0 > wait_time_ms) {
+        COAP_ERR("Invalid paramter");
+        return NULL;
+    }
+
+    return (iotx_coap_group_t *)CoAPGroup_create(p_url, capacity, (unsigned int)wait_time_ms);
+}
+
+void IOT_CoAP_GroupDestroy(iotx_coap_group_t **pp_group)
+{
+    if (NULL != pp_group && NULL != *pp_group) {
+        CoAPGroup_free((CoAPGroup *)*pp_group);
+        *pp_group = NULL;
+    }
+}
+
+int IOT_CoAP_GroupYield(iotx_coap_group_t *p_group)
+{
+    unsigned int i = 0;
+    CoAPGroup *group = (CoAPGroup *)p_group;
+
+    if (NULL == group) {
+        COAP_ERR("Invalid paramter");
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    for (i = 0; i < group->capacity; i++) {
+        if (NULL != group->members[i]) {
+            iotx_coap_token_refresh((iotx_coap_t *)group->members[i]->user);
+        }
+    }
+    return CoAPGroup_cycle(group);
+}
+#endif  /* COAP_GROUP_ENABLED */
+
+#ifdef HAL_EVENT_ENABLED
+intptr_t IOT_CoAP_GetFd(iotx_coap_context_t *p_context)
+{
+    iotx_coap_t *p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_iotx_coap || NULL == p_iotx_coap->p_coap_ctx) {
+        COAP_ERR("Invalid paramter");
+        return -1;
+    }
+
+    return CoAPNetwork_fd(&((CoAPContext *)p_iotx_coap->p_coap_ctx)->network);
+}
+
+int IOT_CoAP_Process(iotx_coap_context_t *p_context)
+{
+    iotx_coap_t *p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_iotx_coap || NULL == p_iotx_coap->p_coap_ctx) {
+        COAP_ERR("Invalid paramter");
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    iotx_coap_token_refresh(p_iotx_coap);
+    return CoAPMessage_process(p_iotx_coap->p_coap_ctx);
+}
+
+unsigned int IOT_CoAP_GetTimeout(iotx_coap_context_t *p_context)
+{
+    iotx_coap_t *p_iotx_coap = (iotx_coap_t *)p_context;
+    unsigned int timeout, refresh;
+
+    if (NULL == p_iotx_coap || NULL == p_iotx_coap->p_coap_ctx) {
+        return 0;
+    }
+
+    timeout = CoAPMessage_timeout(p_iotx_coap->p_coap_ctx);
+    refresh = p_iotx_coap->is_authed ? utils_token_left(&p_iotx_coap->token_life) : 0xFFFFFFFF;
+    return (refresh < timeout) ? refresh : timeout;
+}
+#endif  /* HAL_EVENT_ENABLED */
+
@@ -18,6 +18,8 @@
 #include "iot_export_cmp.h"
 #include "iot_export_errno.h"
 #include "lite-utils.h"
+#include "lite-json-stream.h"
+#include "utils_identity.h"
 
 static void config_ota_handler(void* pcontext, iotx_cmp_cota_parameter_t* ota_parameter, void* user_data)
 {
@@ -96,7 +98,7 @@ static void config_ota_cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t* m
         if (config_ota->_ota_inited == 0) {
             if (config_ota->_destructing == 1) return;
 
-            HAL_GetFirmwareVesion(config_ota->_current_verison);
+            strncpy(config_ota->_current_verison, utils_identity_get()->firmware_version, FIRMWARE_VERSION_MAXLEN);
 
             log_info("Current firmware version: %s", config_ota->_current_verison);
 
@@ -203,11 +205,64 @@ static int config_ota_end(void* _self)
     return ret;
 }
 
+/* the fetch and the writes go in turn, each waits while the other works */
+static void config_ota_stats_get(config_ota_t* self, service_ota_stats_t* stats)
+{
+    uint32_t fetching;
+
+    *stats = self->_stats;
+    if (1 == stats->result) stats->elapsed_ms = (uint32_t)(HAL_UptimeMs() - self->_stats_start_ms);
+
+    fetching = stats->elapsed_ms > stats->fetch_stall_ms ? stats->elapsed_ms - stats->fetch_stall_ms : 0;
+    stats->fetch_bytes_per_s = fetching ? (uint32_t)((uint64_t)stats->fetched * 1000 / fetching) : 0;
+    stats->write_bytes_per_s = stats->write_ms ? (uint32_t)((uint64_t)stats->written * 1000 / stats->write_ms) : 0;
+}
+
+static void config_ota_stats_finish(config_ota_t* self, int result)
+{
+    service_ota_stats_t stats;
+
+    self->_stats.elapsed_ms = (uint32_t)(HAL_UptimeMs() - self->_stats_start_ms);
+    self->_stats.result = result;
+    config_ota_stats_get(self, &stats);
+
+    log_info("service cota %s: %u of %u bytes in %u ms, first byte %u ms, fetch %u B/s stalled %u ms, "
+             "write %u B/s stalled %u ms", result ? "failed" : "done", stats.written, stats.size,
+             stats.elapsed_ms, stats.first_byte_ms, stats.fetch_bytes_per_s, stats.fetch_stall_ms,
+             stats.write_bytes_per_s, stats.write_stall_ms);
+
+    if (self->_linkkit_callback_fp) {
+        ((handle_service_cota_callback_fp_t)self->_linkkit_callback_fp)(service_cota_callback_type_download_finished,
+                                                                        self->_rsp_configId,
+                                                                        self->_rsp_configSize,
+                                                                        self->_rsp_getType,
+                                                                        self->_rsp_sign,
+                                                                        self->_rsp_signMethod,
+                                                                        self->_rsp_url);
+    }
+}
+
+static int config_ota_stream_callback(char* name, int name_len, char* value, int value_len, int value_type, void* user_data)
+{
+    config_ota_t* self = user_data;
+
+    if (((handle_service_cota_stream_fp_t)self->_stream_callback_fp)(name, name_len, value, value_len,
+                                                                     (service_cota_value_type_t)value_type,
+                                                                     self->_stream_ctx)) {
+        return JSON_PARSE_FINISH;
+    }
+
+    return JSON_PARSE_OK;
+}
+
 static int config_ota_perform_ota_service(void* _self, void* _data_buf, int _data_buf_length)
 {
     config_ota_t* self = _self;
     int ret = -1;
     iotx_cmp_ota_t* iotx_cmp_ota;
+    lite_json_stream_t* stream = NULL;
+    char* stream_value = NULL;
+    uint64_t since;
 
     assert(_data_buf && _data_buf_length);
 
@@ -224,20 +279,52 @@ static int config_ota_perform_ota_service(void* _self, void* _data_buf, int _dat
 	iotx_cmp_ota->ota_type = IOTX_CMP_OTA_TYPE_COTA;
 
     self->_total_len = 0;
-
-    config_ota_start(self);
+    memset(&self->_stats, 0, sizeof(service_ota_stats_t));
+    self->_stats.size = self->_rsp_configSize;
+    self->_stats.result = 1;
+    self->_stats_start_ms = HAL_UptimeMs();
+
+    if (self->_stream_callback_fp) {
+        /* a value may be as long as a whole chunk */
+        stream = config_ota_lite_calloc(1, sizeof(lite_json_stream_t));
+        stream_value = config_ota_lite_malloc(self->_data_buf_length + 1);
+        if (stream == NULL || stream_value == NULL) {
+            log_err("service cota stream malloc fail.");
+            goto err_handler;
+        }
+        LITE_json_stream_init(stream, stream_value, self->_data_buf_length + 1, config_ota_stream_callback, self);
+    } else {
+        config_ota_start(self);
+    }
 
     while (1) {
         /* reset buffer size every time after fetch */
         iotx_cmp_ota->buffer_length = self->_data_buf_length;
+        since = HAL_UptimeMs();
         ret = IOT_CMP_OTA_Yield(iotx_cmp_ota);
+        /* the writes wait for the fetch */
+        self->_stats.write_stall_ms += (uint32_t)(HAL_UptimeMs() - since);
 
         assert(iotx_cmp_ota->buffer && iotx_cmp_ota->buffer_length);
 
         if (ret == 0 && iotx_cmp_ota->buffer && iotx_cmp_ota->buffer_length) {
-            ret = config_ota_write(self, iotx_cmp_ota->buffer, iotx_cmp_ota->buffer_length);
+            if (0 == self->_stats.first_byte_ms) {
+                self->_stats.first_byte_ms = (uint32_t)(HAL_UptimeMs() - self->_stats_start_ms);
+                if (0 == self->_stats.first_byte_ms) self->_stats.first_byte_ms = 1;
+            }
+            self->_stats.fetched += iotx_cmp_ota->buffer_length;
+            since = HAL_UptimeMs();
+            if (stream)
+                ret = LITE_json_stream_feed(stream, iotx_cmp_ota->buffer, iotx_cmp_ota->buffer_length);
+            else
+                ret = config_ota_write(self, iotx_cmp_ota->buffer, iotx_cmp_ota->buffer_length);
+            /* the fetch waits for the write */
+            since = HAL_UptimeMs() - since;
+            self->_stats.write_ms += (uint32_t)since;
+            self->_stats.fetch_stall_ms += (uint32_t)since;
             if (ret == 0) {
                 self->_total_len += iotx_cmp_ota->buffer_length;
+                self->_stats.written += iotx_cmp_ota->buffer_length;
             }
             log_debug("\nservice cota write flash,\tret=%d,\tbuffer_length=%d,\ttotal len:%d\n",
                       ret, iotx_cmp_ota->buffer_length, self->_total_len);
@@ -260,14 +347,24 @@ static int config_ota_perform_ota_service(void* _self, void* _data_buf, int _dat
 
 err_handler:
     if (ret == 0 && iotx_cmp_ota->result == 0) {
-        ret = config_ota_end(self);
-        if (ret) {
-            log_err("service cota invoke end function error, ret=%d", ret);
+        if (stream) {
+            ret = LITE_json_stream_finish(stream);
+            if (ret) {
+                log_err("service cota config is not a whole json");
+            }
+        } else {
+            ret = config_ota_end(self);
+            if (ret) {
+                log_err("service cota invoke end function error, ret=%d", ret);
+            }
         }
     } else {
         ret = -1;
     }
+    config_ota_stats_finish(self, ret ? -1 : 0);
 
+    if (stream) config_ota_lite_free(stream);
+    if (stream_value) config_ota_lite_free(stream_value);
     if (iotx_cmp_ota) service_ota_lite_free(iotx_cmp_ota);
 
     return ret;
@@ -282,6 +379,26 @@ static void config_ota_install_callback_function(void* _self, handle_service_cot
     self->_linkkit_callback_fp = linkkit_callback_fp;
 }
 
+static void config_ota_install_stream_callback_function(void* _self, handle_service_cota_stream_fp_t stream_callback_fp, void* ctx)
+{
+    config_ota_t* self = _self;
+
+    /* NULL goes back to persisting the config */
+    self->_stream_callback_fp = stream_callback_fp;
+    self->_stream_ctx = ctx;
+}
+
+/* the stats of the download going on, or of the last one once it is over */
+static int config_ota_get_stats(void* _self, service_ota_stats_t* stats)
+{
+    config_ota_t* self = _self;
+
+    if (NULL == stats) return -1;
+
+    config_ota_stats_get(self, stats);
+    return 0;
+}
+
 void* config_ota_lite_calloc(size_t nmemb, size_t size)
 {
 #ifdef CMP_SUPPORT_MEMORY_MAGIC
@@ -315,7 +432,9 @@ static const cota_t _service_cota_class = {
 		config_ota_write,
 		config_ota_end,
 		config_ota_perform_ota_service,
-		config_ota_install_callback_function
+		config_ota_install_callback_function,
+		config_ota_install_stream_callback_function,
+		config_ota_get_stats
 };
 const void* get_config_ota_class()
 {
@@ -83,6 +83,13 @@ typedef struct cJSON_Hooks {
 
 typedef int cJSON_bool;
 
+/* A buffer of the caller that cJSON_ParseInArena takes all items and strings from, to be given back as a whole. */
+typedef struct cJSON_Arena {
+    unsigned char* buffer;
+    size_t size;
+    size_t used;
+} cJSON_Arena;
+
 #if !defined(__WINDOWS__) && (defined(WIN32) || defined(WIN64) || defined(_MSC_VER) || defined(_WIN32))
 #define __WINDOWS__
 #endif
@@ -146,6 +153,15 @@ CJSON_PUBLIC(cJSON*) cJSON_Parse(const char* value);
 CJSON_PUBLIC(cJSON*) cJSON_ParseWithOpts(const char* value, const char** return_parse_end,
         cJSON_bool require_null_terminated);
 
+/* Arena variants: the tree parsed, or the text printed, lives in the arena and is NOT to be passed to cJSON_Delete or free.
+ * it is gone with cJSON_ResetArena or with the buffer of the arena. NULL when the value is invalid or the arena is too small,
+ * in which case the arena is left as it was. With CJSON_STRING_ZEROCOPY the strings of the tree point into value. */
+CJSON_PUBLIC(void) cJSON_InitArena(cJSON_Arena* arena, void* buffer, size_t size);
+CJSON_PUBLIC(void) cJSON_ResetArena(cJSON_Arena* arena);
+CJSON_PUBLIC(cJSON_bool) cJSON_ArenaOwns(const cJSON_Arena* arena, const cJSON* item);
+CJSON_PUBLIC(cJSON*) cJSON_ParseInArena(const char* value, cJSON_Arena* arena);
+CJSON_PUBLIC(char*) cJSON_PrintInArena(cJSON* item, cJSON_Arena* arena, cJSON_bool fmt);
+
 /* Render a cJSON entity to text for transfer/storage. */
 CJSON_PUBLIC(char*) cJSON_Print(const cJSON* item);
 /* Render a cJSON entity to text for transfer/storage without any formatting. */
@@ -15,9 +15,42 @@ extern "C" {
 
 #define CMP_ABSTRACT_IMPL_CLASS get_cmp_impl_class()
 
+#ifdef RAW_DATA_DIRECT_ENABLED
+#define CMP_IMPL_RAW_URI_MAX 4
+#endif
+
+/* the LAN is served from the yield of CMP, there is none when CMP runs its own thread. */
+#if defined(LOCAL_CONTROL_ENABLED) && !defined(CMP_SUPPORT_MULTI_THREAD)
+#define CMP_IMPL_LOCAL_CONTROL
+#include "cmp_local.h"
+#endif
+
+/* the channels besides MQTT send from the yield of CMP too. */
+#if defined(DM_CHANNELS_ENABLED) && !defined(CMP_SUPPORT_MULTI_THREAD)
+#define CMP_IMPL_CHANNELS
+#include "cmp_channel.h"
+#endif
+
 typedef struct {
     const void* _;
     int         cmp_inited;
+#ifdef RAW_DATA_DIRECT_ENABLED
+    iotx_cmp_event_handle_func_fpt event_cb; /* told of the subscribes raw data takes past CMP. */
+    void*       event_pcontext;
+    iotx_cmp_register_func_fpt raw_register_cb; /* raw data from the MQTT client goes to it as CMP would hand it over. */
+    void*       raw_pcontext;
+    char*       raw_uri[CMP_IMPL_RAW_URI_MAX]; /* the MQTT client keeps the topics it is given till deinit. */
+#endif
+#ifdef CMP_IMPL_LOCAL_CONTROL
+    cmp_local_t local; /* requests of the LAN to the handlers registered, answered back on the LAN. */
+#endif
+#ifdef CMP_IMPL_CHANNELS
+    cmp_channel_t channels; /* uplinks routed to CoAP and HTTP, each channel from its own queue. */
+#endif
+#ifdef DM_BACKPRESSURE_ENABLED
+    uint32_t    write_ms; /* the last send took this long, a socket buffer full makes it wait. */
+    uint64_t    write_end_ms;
+#endif /* DM_BACKPRESSURE_ENABLED */
 } cmp_abstract_impl_t;
 
 extern const void* get_cmp_impl_class();
@@ -0,0 +1,130 @@
+#ifndef CMP_CHANNEL_H
+#define CMP_CHANNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "iot_export_cmp.h"
+#include "iot_export_dm.h"
+
+/*
+ * channels of the uplinks of the device besides the MQTT connection of CMP. an uplink request or raw data of the
+ * device whose uri after /sys/${productKey}/${deviceName}/ starts with the prefix of a route goes to the queue of
+ * the channel of the longest such prefix, and is sent from the yield of CMP by the CoAP or the HTTP client of the
+ * device to /topic${uri}. each channel sends from its own queue with its own budget per yield and connects on its
+ * own, so one that is down or slow leaves the others and MQTT sending. a request the cloud took over CoAP or HTTP
+ * is answered to the handler registered for ${uri}_reply as by a reply of code 200 with {} as data.
+ */
+
+/* routes at most. */
+#ifndef CMP_CHANNEL_ROUTE_MAX
+#define CMP_CHANNEL_ROUTE_MAX 8
+#endif
+
+/* CoAP requests waiting for their response at most, more wait in the queue. */
+#ifndef CMP_CHANNEL_INFLIGHT_MAX
+#define CMP_CHANNEL_INFLIGHT_MAX 8
+#endif
+
+/* the channels that have a queue, all but MQTT. */
+#define CMP_CHANNEL_QUEUE_NUMBER (dm_channel_max - dm_channel_coap)
+
+typedef struct _cmp_channel_message {
+    struct _cmp_channel_message* next;
+    int                          id;
+    int                          raw; /* raw data, nothing answers it. */
+    int                          tries; /* sends failed. */
+    dm_payload_format_t          payload_format; /* cbor is labeled so over CoAP, the rest as json. */
+    uint32_t                     payload_len;
+    char*                        payload; /* allocated past uri. */
+    char                         uri[1]; /* allocated past the end. */
+} cmp_channel_message_t;
+
+typedef struct _cmp_channel_reply {
+    struct _cmp_channel_reply* next;
+    iotx_cmp_register_func_fpt register_cb;
+    void*                      pcontext;
+    char                       uri[1]; /* allocated past the end. */
+} cmp_channel_reply_t;
+
+typedef struct {
+    char*        prefix; /* NULL when free. */
+    int          prefix_len;
+    dm_channel_t channel;
+} cmp_channel_route_t;
+
+typedef struct {
+    void*     channels; /* the cmp_channel_t of the slot, for the response handler. */
+    int       used;
+    int       id;
+    uint64_t  expire_ms;
+    char*     uri;
+} cmp_channel_inflight_t;
+
+struct _cmp_channel;
+struct _cmp_channel_queue;
+
+/* how the client of a channel connects and sends, tests put their own in place of the CoAP and HTTP clients. */
+typedef struct {
+    void* (*connect)(struct _cmp_channel* channels); /* the client, NULL when not connected. */
+    void  (*disconnect)(struct _cmp_channel* channels, struct _cmp_channel_queue* queue);
+    /* 0 when sent, 1 when it waits, -1 when the send failed. */
+    int   (*send)(struct _cmp_channel* channels, struct _cmp_channel_queue* queue, cmp_channel_message_t* message, char* path);
+    int   answered_on_send; /* a request sent is one the cloud took, nothing answers it later. */
+} cmp_channel_transport_t;
+
+typedef struct _cmp_channel_queue {
+    dm_channel_t                   channel;
+    const cmp_channel_transport_t* transport; /* NULL when the channel is not built in. */
+    void*                          client; /* NULL till connected. */
+    uint64_t                       retry_ms; /* not connected again before. */
+    uint32_t                       backoff_ms;
+    cmp_channel_message_t*         head;
+    cmp_channel_message_t*         tail;
+    int                            number;
+} cmp_channel_queue_t;
+
+typedef struct _cmp_channel {
+    void*                  mutex; /* of routes, queues and reply uris, which the send of other threads reaches. */
+    int                    inited;
+    iotx_device_info_t     device_info;
+    char                   uri_base[CMP_TOPIC_LEN_MAX]; /* /sys/${productKey}/${deviceName}/ */
+    int                    uri_base_len;
+    cmp_channel_route_t    routes[CMP_CHANNEL_ROUTE_MAX];
+    int                    route_number; /* uplinks all go over CMP while there is none. */
+    cmp_channel_queue_t    queues[CMP_CHANNEL_QUEUE_NUMBER];
+    int                    next_queue; /* served first by the next yield. */
+    cmp_channel_reply_t*   reply_list;
+    cmp_channel_inflight_t inflight[CMP_CHANNEL_INFLIGHT_MAX];
+    char                   response[256]; /* of the HTTP server, checked by the client. */
+} cmp_channel_t;
+
+/* channels and routes live as long as CMP of DM, the clients between init and deinit. */
+int  cmp_channel_create(cmp_channel_t* channels);
+void cmp_channel_destroy(cmp_channel_t* channels);
+int  cmp_channel_init(cmp_channel_t* channels, const char* product_key, const char* device_name, const char* device_secret,
+                      const char* device_id);
+void cmp_channel_deinit(cmp_channel_t* channels);
+/* 0 when uplinks of prefix go over channel from now on, dm_channel_mqtt routes them back to CMP. */
+int  cmp_channel_set_route(cmp_channel_t* channels, const char* prefix, dm_channel_t channel);
+/* replies to uri go to register_cb, as registered to CMP. */
+int  cmp_channel_regist(cmp_channel_t* channels, const char* uri, iotx_cmp_register_func_fpt register_cb, void* pcontext);
+void cmp_channel_unregist(cmp_channel_t* channels, const char* uri);
+/* 0 when queued to its channel, 1 when it goes over CMP, -1 when the queue of its channel is full. */
+int  cmp_channel_send(cmp_channel_t* channels, const iotx_cmp_message_info_t* iotx_cmp_message_info,
+                      dm_payload_format_t payload_format);
+/* send what the channels have queued, connect the ones down and due, take CoAP responses. */
+void cmp_channel_yield(cmp_channel_t* channels);
+/* ms till yield has something to do, 0xFFFFFFFF for never. */
+uint32_t cmp_channel_get_timeout(cmp_channel_t* channels);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CMP_CHANNEL_H */
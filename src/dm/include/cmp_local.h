@@ -0,0 +1,89 @@
+#ifndef CMP_LOCAL_H
+#define CMP_LOCAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+#include "iot_import.h"
+#include "iot_export_cmp.h"
+#include "utils_hmac.h"
+#include "CoAPExport.h"
+
+/*
+ * local control channel, requests of the LAN taken past the cloud. a CoAP POST to the uri of a request dm subscribes,
+ * like /sys/${productKey}/${deviceName}/thing/service/property/set, with the alink request as payload goes to the
+ * handler dm registered for the uri as if it came from the cloud, and its answer goes back to the peer as payload
+ * of the CoAP response. the peer signs each request in the auth token option with the hex hmac-sha1 of the uri and
+ * the payload keyed by the device secret, the id of each request is larger than the one before so a replay is
+ * refused. a property set answered 200 is posted to the cloud from the next yield, off the path of the LAN request.
+ */
+
+/* LAN requests waiting for their answer at most. */
+#ifndef CMP_LOCAL_PENDING_MAX
+#define CMP_LOCAL_PENDING_MAX 8
+#endif
+
+/* ids of LAN requests as dm sees them, negative, never the id of a request of the cloud. */
+#define CMP_LOCAL_ID_MIN (-0x3FFFFFFF)
+
+typedef struct _cmp_local_uri {
+    struct _cmp_local_uri*     next;
+    iotx_cmp_register_func_fpt register_cb;
+    void*                      pcontext;
+    char                       uri[1]; /* allocated past the end. */
+} cmp_local_uri_t;
+
+typedef struct {
+    int            id; /* as dm sees it, 0 when free. */
+    int            peer_id; /* id of the request of the peer. */
+    hal_udp_peer_t peer;
+    unsigned short msgid;
+    unsigned char  type;
+    unsigned char  acked; /* a con request acked empty, its answer goes as a separate response. */
+    unsigned char  tokenlen;
+    unsigned char  token[COAP_MSG_MAX_TOKEN_LEN];
+    uint64_t       expire_ms;
+    char*          set_uri; /* uri of the property post of a property set, NULL for a service. */
+    char*          set_params;
+} cmp_local_pending_t;
+
+typedef struct _cmp_local_sync {
+    struct _cmp_local_sync* next;
+    char*                   uri;
+    char*                   params;
+} cmp_local_sync_t;
+
+typedef struct {
+    void*               socket; /* NULL when not serving. */
+    utils_hmac_ctx_t    hmac;
+    int                 last_peer_id;
+    int                 next_id;
+    unsigned short      msgid;
+    cmp_local_uri_t*    uri_list;
+    cmp_local_pending_t pending[CMP_LOCAL_PENDING_MAX];
+    cmp_local_sync_t*   sync_head;
+    int                 sync_number;
+    int                 sync_id;
+    unsigned char       recvbuf[COAP_MSG_MAX_PDU_LEN];
+    unsigned char       sendbuf[COAP_MSG_MAX_PDU_LEN];
+} cmp_local_t;
+
+/* 0 when serving on CONFIG_LOCAL_CONTROL_PORT for the device of device_secret. */
+int  cmp_local_init(cmp_local_t* local, const char* device_secret);
+void cmp_local_deinit(cmp_local_t* local);
+/* requests to uri go to register_cb, as registered to CMP. */
+int  cmp_local_regist(cmp_local_t* local, const char* uri, iotx_cmp_register_func_fpt register_cb, void* pcontext);
+void cmp_local_unregist(cmp_local_t* local, const char* uri);
+/* serve the LAN requests arrived, give up the ones not answered in time, post the property sets answered. */
+void cmp_local_yield(cmp_local_t* local);
+/* 0 when message is the answer of a LAN request and went back to its peer instead of the cloud. */
+int  cmp_local_answer(cmp_local_t* local, const iotx_cmp_message_info_t* iotx_cmp_message_info);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CMP_LOCAL_H */
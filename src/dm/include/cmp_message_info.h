@@ -17,33 +17,182 @@ extern "C" {
 #define CMP_MESSAGE_INFO_MESSAGE_TYPE_RAW      2
 
 typedef struct _req_rsp_param {
-    char* key;
-    char* value;
+    char*  key;
+    char*  value;
+    size_t key_size;   /* bytes allocated for key. */
+    size_t value_size; /* bytes allocated for value. */
 } req_rsp_param_t;
 
+/* growth-only buffer, kept when message info is cleared and reused by the next message. */
+typedef struct {
+    char*  buf;
+    size_t size;
+} cmp_message_info_storage_t;
+
 typedef struct {
     const void*     _;
     char*           uri;
     char*           payload_buf;
     char*           params_data_buf;
+    int             params_data_length;
 #ifdef MEMORY_NO_COPY
     int             params_data_buf_prefix_len;
 #endif
-    char*           raw_data_buf;
+    char*           raw_data_buf; /* raw data of the caller till clear, or a cbor request in raw_data_storage. */
     int             raw_data_length;
     char*           product_key;
     char*           device_name;
     int             id;
     int             code;
     char*           version;
-    void*           param_list;
+    req_rsp_param_t* params; /* params added since last clear, slots and their strings are reused. */
+    int             param_number;
+    int             param_capacity;
     char*           method;
     int             message_type; /* 0: request; 1: response; 2: raw. */
+    int             payload_format; /* dm_payload_format_t, a cbor request is serialized into raw data. */
     int             ret;
+    /* storage of the strings above, they point into it or are NULL when not set. */
+    cmp_message_info_storage_t uri_storage;
+    cmp_message_info_storage_t payload_storage;
+#ifndef MEMORY_NO_COPY
+    cmp_message_info_storage_t params_data_storage;
+    cmp_message_info_storage_t raw_data_storage;
+#endif
+    cmp_message_info_storage_t product_key_storage;
+    cmp_message_info_storage_t device_name_storage;
+    cmp_message_info_storage_t version_storage;
+    cmp_message_info_storage_t method_storage;
 } cmp_message_info_t;
 
 extern const void* get_cmp_message_info_class();
 
+/*
+ * message info is of one class only. with DM_MESSAGE_INFO_STATIC its methods are called directly instead of
+ * through the class, the accessors below are then inlined.
+ */
+#ifdef DM_MESSAGE_INFO_STATIC
+#define CMP_MESSAGE_INFO_CALL(message_info, method) cmp_message_info_##method
+#else
+#define CMP_MESSAGE_INFO_CALL(message_info, method) (*(const message_info_t**)(message_info))->method
+#endif
+
+#ifdef DM_MESSAGE_INFO_STATIC
+int   cmp_message_info_set_uri(void* _self, char* uri);
+void  cmp_message_info_set_payload(void* _self, char* payload_buf, unsigned int payload_len);
+void  cmp_message_info_clear(void* _self);
+void  cmp_message_info_set_version(void* _self, const char* version);
+void  cmp_message_info_add_params_data_item(void* _self, const char* key, const char* value);
+void  cmp_message_info_set_method(void* _self, const char* method);
+int   cmp_message_info_serialize_to_payload_request(void* _self);
+int   cmp_message_info_serialize_to_payload_response(void* _self);
+void  cmp_message_info_set_params_data(void* _self, char* params_data_buf);
+char* cmp_message_info_reserve_params_data(void* _self, int len);
+int   cmp_message_info_set_raw_data_and_length(void* _self, void* raw_data, int raw_data_length);
+void  cmp_message_info_set_product_key(void* _self, char* product_key);
+void  cmp_message_info_set_device_name(void* _self, char* device_name);
+#endif /* DM_MESSAGE_INFO_STATIC */
+
+static inline void* cmp_message_info_get_uri(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->uri;
+}
+
+static inline void* cmp_message_info_get_payload(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->payload_buf;
+}
+
+static inline void cmp_message_info_set_id(void* _self, int id)
+{
+    ((cmp_message_info_t*)_self)->id = id;
+}
+
+static inline int cmp_message_info_get_id(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->id;
+}
+
+static inline char* cmp_message_info_get_version(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->version;
+}
+
+static inline char* cmp_message_info_get_method(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->method;
+}
+
+static inline void cmp_message_info_set_message_type(void* _self, int message_type)
+{
+    ((cmp_message_info_t*)_self)->message_type = message_type;
+}
+
+static inline int cmp_message_info_get_message_type(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->message_type;
+}
+
+#ifdef MEMORY_NO_COPY
+/* start: with the room for the message prefix in front of the params. */
+static inline char* cmp_message_info_get_params_data(void* _self, int start)
+{
+    cmp_message_info_t* self = _self;
+
+    return start ? self->params_data_buf : self->params_data_buf + self->params_data_buf_prefix_len;
+}
+#else
+static inline char* cmp_message_info_get_params_data(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->params_data_buf;
+}
+#endif
+
+static inline int cmp_message_info_get_params_data_length(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->params_data_length;
+}
+
+static inline void* cmp_message_info_get_raw_data(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->raw_data_buf;
+}
+
+static inline int cmp_message_info_get_raw_data_length(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->raw_data_length;
+}
+
+static inline char* cmp_message_info_get_product_key(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->product_key;
+}
+
+static inline char* cmp_message_info_get_device_name(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->device_name;
+}
+
+static inline void cmp_message_info_set_code(void* _self, int code)
+{
+    ((cmp_message_info_t*)_self)->code = code;
+}
+
+static inline int cmp_message_info_get_code(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->code;
+}
+
+static inline void cmp_message_info_set_payload_format(void* _self, int format)
+{
+    ((cmp_message_info_t*)_self)->payload_format = format;
+}
+
+static inline int cmp_message_info_get_payload_format(void* _self)
+{
+    return ((cmp_message_info_t*)_self)->payload_format;
+}
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,40 @@
+#ifndef DM_ARENA_H
+#define DM_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdlib.h>
+
+#include "dm_id_index.h"
+
+#define DM_ARENA_MIN_CHUNK_SIZE 512
+#define DM_ARENA_ALIGN_SIZE     8 /* enough for double and long long members. */
+
+typedef struct _dm_arena_chunk {
+    struct _dm_arena_chunk* next;
+    size_t                  size; /* bytes of data following this header. */
+    size_t                  used;
+} dm_arena_chunk_t;
+
+/* bump allocator, memory is only given back all at once by dm_arena_deinit. */
+typedef struct {
+    dm_arena_chunk_t* chunks; /* current chunk first. */
+    size_t            chunk_size;
+    dm_id_index_t     strings; /* interned strings, dropped by dm_arena_seal. */
+} dm_arena_t;
+
+int   dm_arena_init(dm_arena_t* arena, size_t chunk_size);
+void  dm_arena_deinit(dm_arena_t* arena);
+void* dm_arena_calloc(dm_arena_t* arena, size_t nmemb, size_t size);
+char* dm_arena_intern(dm_arena_t* arena, const char* str, size_t len);
+void  dm_arena_seal(dm_arena_t* arena);
+int   dm_arena_is_active(const dm_arena_t* arena);
+char* dm_arena_chunk_data(const dm_arena_chunk_t* chunk);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_ARENA_H */
@@ -0,0 +1,69 @@
+#ifndef DM_DEVICEINFO_H
+#define DM_DEVICEINFO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+#include "iot_import.h"
+#include "dm_json_writer.h"
+
+#ifdef DEVICEINFO_ENABLED
+
+/*
+ * deviceinfo of a thing: each attrKey with the value the cloud acked and the value asked for. only the keys asked
+ * for since their last ack, or never acked, are sent, so asking for the same again sends nothing. with
+ * CONFIG_DM_DEVICEINFO_KV the values acked are kept in kv, so the same tags pushed on every boot are not sent again.
+ */
+
+#define DM_DEVICEINFO_UPDATE    0
+#define DM_DEVICEINFO_DELETE    1
+#define DM_DEVICEINFO_KEY_MAXLEN 16
+
+/* ms an update or delete waits for its reply, what it sent is taken as refused after. */
+#ifndef DM_DEVICEINFO_REPLY_TIMEOUT_MS
+#define DM_DEVICEINFO_REPLY_TIMEOUT_MS 10000
+#endif
+
+typedef struct {
+    char*       key;
+    char*       acked; /* NULL when the cloud has none. */
+    char*       wanted; /* NULL when asked to be deleted. */
+    char*       sent; /* of the request in flight. */
+    signed char flight; /* op of the request in flight, -1 when none. */
+    char        known; /* acked is what the cloud has, not known before the first ack of a boot without kv. */
+    char        asked; /* wanted is asked for. */
+} dm_deviceinfo_item_t;
+
+typedef struct {
+    dm_deviceinfo_item_t* items;
+    int      item_number;
+    int      item_size;
+    int      request_id[2]; /* of update and delete in flight, 0 when none. */
+    uint64_t due_ms; /* uptime the items pending are sent, 0 when they are not waited for. */
+    char     kv_key[DM_DEVICEINFO_KEY_MAXLEN];
+} dm_deviceinfo_t;
+
+/* name is the thing, productKey/deviceName, the values acked kept in kv for it are taken up. */
+void dm_deviceinfo_init(dm_deviceinfo_t* info, const char* name);
+void dm_deviceinfo_deinit(dm_deviceinfo_t* info);
+/* 0 when params, a json array of attrKey and attrValue objects to update or attrKey ones to delete, are asked for. */
+int  dm_deviceinfo_ask(dm_deviceinfo_t* info, int op, const char* params);
+/* 1 when an item waits to be sent by op. */
+int  dm_deviceinfo_pending(const dm_deviceinfo_t* info, int op);
+/* params of the items waiting to be sent by op. */
+void dm_deviceinfo_write(const dm_deviceinfo_t* info, int op, dm_json_writer_t* writer);
+/* the items waiting to be sent by op are in flight with request id. */
+void dm_deviceinfo_sent(dm_deviceinfo_t* info, int op, int request_id);
+/* reply of request id, the items in flight with it are acked when ok, else what they asked for is dropped. */
+void dm_deviceinfo_replied(dm_deviceinfo_t* info, int request_id, int ok);
+
+#endif /* DEVICEINFO_ENABLED */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_DEVICEINFO_H */
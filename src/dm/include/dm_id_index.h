@@ -0,0 +1,41 @@
+#ifndef DM_ID_INDEX_H
+#define DM_ID_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdlib.h>
+
+#define DM_ID_INDEX_CHILD_NUMBER 2
+#define DM_ID_INDEX_CHILD_INPUT  0 /* struct specs of property, outputData of event, inputData of service. */
+#define DM_ID_INDEX_CHILD_OUTPUT 1 /* outputData of service. */
+
+struct _dm_id_index;
+
+typedef struct {
+    const char* key; /* not owned, points to identifier kept by the item. */
+    size_t      key_len;
+    void*       item;
+    struct _dm_id_index* child[DM_ID_INDEX_CHILD_NUMBER];
+} dm_id_index_entry_t;
+
+/* open addressing hash table, linear probing, slot number is power of 2. */
+typedef struct _dm_id_index {
+    size_t               slot_number;
+    size_t               entry_number;
+    dm_id_index_entry_t* slots;
+} dm_id_index_t;
+
+int   dm_id_index_init(dm_id_index_t* index, size_t capacity);
+void  dm_id_index_deinit(dm_id_index_t* index);
+dm_id_index_entry_t* dm_id_index_insert(dm_id_index_t* index, const char* key, size_t key_len, void* item);
+dm_id_index_entry_t* dm_id_index_find(const dm_id_index_t* index, const char* key, size_t key_len);
+int   dm_id_index_remove(dm_id_index_t* index, const char* key, size_t key_len);
+dm_id_index_t* dm_id_index_new_child(dm_id_index_entry_t* entry, int child_type, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_ID_INDEX_H */
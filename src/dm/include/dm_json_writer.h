@@ -0,0 +1,61 @@
+#ifndef DM_JSON_WRITER_H
+#define DM_JSON_WRITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdlib.h>
+
+#include "utils_base64.h"
+
+#define DM_JSON_WRITER_DEPTH_MAX 32
+
+/*
+ * append-only json writer into a caller buffer. like snprintf it keeps counting once buf is full,
+ * so length tells the size needed, a writer inited with NULL buf only measures.
+ * buf is kept NUL terminated whenever size > 0.
+ */
+typedef struct {
+    char*        buf;
+    size_t       size;
+    size_t       len;
+    int          depth;
+    int          after_key;
+    unsigned int first; /* bit n set while container at depth n has no member yet. */
+    utils_base64_stream_t base64; /* bytes of the base64 string written not encoded yet. */
+} dm_json_writer_t;
+
+void   dm_json_writer_init(dm_json_writer_t* writer, char* buf, size_t size);
+void   dm_json_writer_object_begin(dm_json_writer_t* writer);
+void   dm_json_writer_object_end(dm_json_writer_t* writer);
+void   dm_json_writer_array_begin(dm_json_writer_t* writer);
+void   dm_json_writer_array_end(dm_json_writer_t* writer);
+void   dm_json_writer_key(dm_json_writer_t* writer, const char* key, size_t key_len);
+/* key_json is a key written by dm_json_writer_key before, quoted, escaped and with its ':'. */
+void   dm_json_writer_key_raw(dm_json_writer_t* writer, const char* key_json, size_t key_json_len);
+/* str is quoted and escaped. */
+void   dm_json_writer_string(dm_json_writer_t* writer, const char* str, size_t str_len);
+/* value is json already, numbers or preformatted objects, copied as is. */
+void   dm_json_writer_raw(dm_json_writer_t* writer, const char* value, size_t value_len);
+void   dm_json_writer_int(dm_json_writer_t* writer, int value);
+void   dm_json_writer_double(dm_json_writer_t* writer, double value, int precision);
+/* data as a base64 string, for binary fields. */
+void   dm_json_writer_base64(dm_json_writer_t* writer, const unsigned char* data, size_t len);
+/* the same in chunks, begin, append any number of times, then end. */
+void   dm_json_writer_base64_begin(dm_json_writer_t* writer);
+void   dm_json_writer_base64_append(dm_json_writer_t* writer, const unsigned char* data, size_t len);
+void   dm_json_writer_base64_end(dm_json_writer_t* writer);
+/*
+ * goes on writing into buf from its start, what was written before is the caller's. a document longer than
+ * any buffer is written in pieces, each sent before the next, as by the read callback of IOT_MQTT_PublishStream.
+ */
+void   dm_json_writer_rebuffer(dm_json_writer_t* writer, char* buf, size_t size);
+size_t dm_json_writer_length(const dm_json_writer_t* writer); /* bytes written or needed, without NUL. */
+int    dm_json_writer_truncated(const dm_json_writer_t* writer);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_JSON_WRITER_H */
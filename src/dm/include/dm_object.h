@@ -0,0 +1,20 @@
+#ifndef DM_OBJECT_H
+#define DM_OBJECT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * new_object and delete_object into memory of the caller, for objects that live as long as the one holding
+ * them and take no heap of their own then. mem is at least of the size of _class.
+ */
+void* dm_object_new_at(void* mem, const void* _class, ...);
+/* destructs an object of dm_object_new_at, its memory stays the caller's. */
+void  dm_object_delete_at(void* object);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_OBJECT_H */
@@ -0,0 +1,79 @@
+#ifndef DM_OFFLINE_H
+#define DM_OFFLINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+#include "iot_import.h"
+
+#ifdef DM_OFFLINE_ENABLED
+
+/*
+ * ring of property values whose post failed, replayed as history posts once connected again.
+ * a value is a record of the time since the record before, the property index and the change since the value
+ * of the property before, each a varint, in blocks of CONFIG_DM_OFFLINE_BLOCK_SIZE bytes. a block starts from its
+ * own header, so dropping the oldest one for a new one leaves the others readable. once full a block is sealed,
+ * into kv with CONFIG_DM_OFFLINE_KV or into RAM, only sealed blocks are read. memory and kv taken are fixed by
+ * CONFIG_DM_OFFLINE_BLOCKS, whatever the length of the outage.
+ */
+
+/* block header: flags, base time, boot, property number and length. */
+#define DM_OFFLINE_BLOCK_HEADER_LEN 17
+
+typedef struct {
+    uint64_t time_ms; /* epoch ms, or uptime of this boot when epoch is 0. */
+    int      epoch;
+    int      index; /* property index. */
+    int64_t  value; /* integer, float and double ones scaled by CONFIG_DM_OFFLINE_DECIMALS. */
+} dm_offline_record_t;
+
+typedef struct {
+    int           property_number;
+    uint32_t      boot; /* count of inits with kv, uptime based blocks of an other boot are dropped. */
+    uint32_t      first_seq; /* oldest sealed block. */
+    uint32_t      next_seq; /* seq the block written gets when sealed. */
+    unsigned char write_block[CONFIG_DM_OFFLINE_BLOCK_SIZE];
+    int           write_len; /* 0 when empty. */
+    uint64_t      write_time_ms; /* of the last record written. */
+    int64_t*      write_values; /* last value of each property in the block written. */
+    unsigned char* write_seen; /* property has a value in the block written. */
+    unsigned char read_block[CONFIG_DM_OFFLINE_BLOCK_SIZE];
+    int           read_len; /* of block first_seq loaded, 0 when none is. */
+    int           read_offset;
+    int           read_committed; /* offset the records before are replayed. */
+    uint64_t      read_time_ms;
+    int64_t*      read_values;
+#if !CONFIG_DM_OFFLINE_KV
+    unsigned char blocks[CONFIG_DM_OFFLINE_BLOCKS][CONFIG_DM_OFFLINE_BLOCK_SIZE]; /* sealed block seq at seq % number. */
+#endif
+    uint32_t      dropped; /* records lost to full ring or a changed thing model. */
+} dm_offline_t;
+
+/* 0 when ready for things of property_number properties, blocks kept in kv are taken up again. */
+int  dm_offline_init(dm_offline_t* offline, int property_number);
+/* seals the block written, so it is kept in kv. */
+void dm_offline_deinit(dm_offline_t* offline);
+int  dm_offline_append(dm_offline_t* offline, const dm_offline_record_t* record);
+/* 0 with the value of property index last appended to the block written. */
+int  dm_offline_last(const dm_offline_t* offline, int index, int64_t* value);
+/* seal the block written if it has records, so they can be read. */
+void dm_offline_seal(dm_offline_t* offline);
+/* 0 with the next record of the sealed blocks, read from the last commit or rewind on. */
+int  dm_offline_read(dm_offline_t* offline, dm_offline_record_t* record);
+/* records read are replayed, a block read through is dropped. */
+void dm_offline_commit(dm_offline_t* offline);
+/* read again from the last commit. */
+void dm_offline_rewind(dm_offline_t* offline);
+/* 1 when there are records, sealed or not. */
+int  dm_offline_pending(const dm_offline_t* offline);
+
+#endif /* DM_OFFLINE_ENABLED */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_OFFLINE_H */
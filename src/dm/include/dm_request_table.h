@@ -0,0 +1,65 @@
+#ifndef DM_REQUEST_TABLE_H
+#define DM_REQUEST_TABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "iot_export_dm.h"
+
+/* requests waiting for their reply at most, power of 2. */
+#ifndef DM_REQUEST_TABLE_SIZE
+#define DM_REQUEST_TABLE_SIZE 32
+#endif
+
+/* timer wheel of timeouts, a timeout longer than a turn stays in its slot for more turns. */
+#ifndef DM_REQUEST_WHEEL_SIZE
+#define DM_REQUEST_WHEEL_SIZE 16
+#endif
+
+#ifndef DM_REQUEST_WHEEL_TICK_MS
+#define DM_REQUEST_WHEEL_TICK_MS 250
+#endif
+
+typedef struct _dm_request {
+    int                    id; /* alink id of request, 0 when free. */
+    const void*            thing_id;
+    dm_reply_handler_fp_t  handler;
+    void*                  ctx;
+    uint64_t               expire_ms; /* uptime the request times out. */
+    int                    wheel_slot;
+    struct _dm_request*    bucket_next; /* in bucket of id, or in free list. */
+    struct _dm_request*    wheel_prev;
+    struct _dm_request*    wheel_next;
+} dm_request_t;
+
+/* pending requests keyed by id, nothing allocated once created. ids are sequential, so buckets hardly collide. */
+typedef struct {
+    dm_request_t  requests[DM_REQUEST_TABLE_SIZE];
+    dm_request_t* buckets[DM_REQUEST_TABLE_SIZE];
+    dm_request_t* free_list;
+    dm_request_t* wheel[DM_REQUEST_WHEEL_SIZE];
+    uint64_t      wheel_tick; /* tick the wheel has expired up to, uptime / DM_REQUEST_WHEEL_TICK_MS. */
+    int           request_number;
+} dm_request_table_t;
+
+void dm_request_table_init(dm_request_table_t* table, uint64_t now_ms);
+/* 0 when added, -1 when table is full or id is pending already. */
+int  dm_request_table_add(dm_request_table_t* table, int id, const void* thing_id, dm_reply_handler_fp_t handler, void* ctx,
+                          uint64_t expire_ms);
+/* take request of id out of table into request, 0 when it was pending. */
+int  dm_request_table_take(dm_request_table_t* table, int id, dm_request_t* request);
+/* take one request timed out by now_ms out of table into request, 0 when there is one. */
+int  dm_request_table_take_expired(dm_request_table_t* table, uint64_t now_ms, dm_request_t* request);
+/* ms from now_ms till a request times out, 0 when one has, -1 when none is pending. */
+int64_t dm_request_table_next_timeout(const dm_request_table_t* table, uint64_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_REQUEST_TABLE_H */
@@ -0,0 +1,55 @@
+#ifndef DM_STATIC_THING_H
+#define DM_STATIC_THING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdarg.h>
+
+#include "iot_export_dm.h"
+#include "dm_json_writer.h"
+#include "cJSON.h"
+
+#ifdef DM_STATIC_THING_ENABLED
+
+/*
+ * a dm thing bound to a model generated from its tsl by linkkit-tsl-codegen. the template still describes the
+ * thing and tracks which properties changed, their values are the fields of data, posts and property sets of the
+ * thing go through the code generated instead of the template values and identifier lookups.
+ */
+
+/* room of each text item of an array property in the structs generated, text properties take their tsl length. */
+#ifndef DM_STATIC_THING_ARRAY_TEXT_LEN
+#define DM_STATIC_THING_ARRAY_TEXT_LEN 64
+#endif
+
+typedef struct {
+    const dm_static_thing_model_t* model;
+    void*          data;
+    unsigned char* post_ids; /* properties of the post being formatted, under the send lock. */
+    unsigned char* set_ids; /* properties stored by the property set being routed. */
+} dm_static_thing_t;
+
+/* 0 when the properties of model are those of the thing in the same order, a NULL model unbinds. */
+int dm_thing_bind_static(void* _self, const dm_static_thing_model_t* model, void* data);
+/* the model bound to the thing, NULL when it has none. */
+dm_static_thing_t* dm_thing_get_static(const void* _self);
+
+/* helpers of the code generated, number items take bools as 0 and 1, 0 when item holds a value of the type. */
+int  dm_static_thing_key_equal(const cJSON* item, const char* key, int key_len);
+int  dm_static_thing_get_int(const cJSON* item, int* value);
+int  dm_static_thing_get_double(const cJSON* item, double* value);
+int  dm_static_thing_get_date(const cJSON* item, unsigned long long* value);
+/* text of size - 1 bytes at most into buf, NUL terminated, -1 when longer. */
+int  dm_static_thing_get_text(const cJSON* item, char* buf, int size);
+/* dates go as strings of their ms, as the template formats them. */
+void dm_static_thing_write_date(dm_json_writer_t* writer, unsigned long long value);
+
+#endif /* DM_STATIC_THING_ENABLED */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_STATIC_THING_H */
@@ -8,16 +8,59 @@ extern "C" {
 #include "interface/thing_abstract.h"
 #include "interface/log_abstract.h"
 #include "dsl.h"
+#include "dm_id_index.h"
+#include "dm_arena.h"
+#ifdef DM_REPORT_POLICY_ENABLED
+#include "iot_export_dm.h"
+#endif
+#ifdef DM_STATIC_THING_ENABLED
+#include "dm_static_thing.h"
+#endif
 
 #define DEFAULT_DSL_DELIMITER '.'
 #define MAX_IDENTIFIER_LENGTH (50+1) /* user input max id lengh is 50 characters. */
+#define DM_THING_VALUE_STR_BUFF_SIZE 48 /* longest formatted number, double with 16 decimals. */
+
+/* _property_post_state flags. */
+#define DM_THING_PROPERTY_CHANGED 0x01 /* set after last property post started. */
+#define DM_THING_PROPERTY_POSTING 0x02 /* in a property post not acked yet. */
+#define DM_THING_PROPERTY_HELD    0x04 /* set within min interval of its report policy, changed when it passes. */
 
 #define DM_THING_CLASS get_dm_thing_class()
 
+#ifdef DM_REPORT_POLICY_ENABLED
+/* report policy of a property and its last report. */
+typedef struct {
+    dm_report_policy_t policy;
+    unsigned char      attached; /* policy applies. */
+    unsigned char      reported; /* reported since attached. */
+    unsigned char      reported_numeric; /* reported_value holds the value reported. */
+    double             reported_value;
+    uint64_t           reported_ms; /* uptime of last report, of attach before the first, or of window start. */
+    const property_t*  aggregate_min; /* properties aggregate_* of policy resolved, NULL for none. */
+    const property_t*  aggregate_max;
+    const property_t*  aggregate_count;
+    const property_t*  aggregate_samples;
+    double             window_min; /* of the values set in the window. */
+    double             window_max;
+    double             window_sum;
+    unsigned int       window_count;
+} dm_thing_report_t;
+#endif
+
 void property_iterator(void* _self, handle_item_t handle_fp, ...);
 void event_iterator(void* _self, handle_item_t handle_fp, ...);
 void service_iterator(void* _self, handle_item_t handle_fp, ...);
 
+/* typed visitors, ctx is passed through untouched. return non 0 to stop, visit returns that value, 0 if all visited. */
+typedef int (*property_visit_fp_t)(property_t* property, int index, void* ctx);
+typedef int (*event_visit_fp_t)(event_t* event, int index, void* ctx);
+typedef int (*service_visit_fp_t)(service_t* service, int index, void* ctx);
+
+int property_visit(void* _self, property_visit_fp_t visit_fp, void* ctx);
+int event_visit(void* _self, event_visit_fp_t visit_fp, void* ctx);
+int service_visit(void* _self, service_visit_fp_t visit_fp, void* ctx);
+
 typedef struct {
     const void*    _;
     char*          _name; /* dm thing object name. */
@@ -26,10 +69,35 @@ typedef struct {
     void*          _json_object; /* json object after dsl string parsed. */
     dsl_template_t dsl_template;
     int            _arr_index;
+    dm_id_index_t  _property_index; /* identifier index of properties, child tables hold struct specs. */
+    dm_id_index_t  _event_index; /* identifier index of events, child tables hold outputData. */
+    dm_id_index_t  _service_index; /* identifier index of services, child tables hold inputData/outputData. */
+    dm_arena_t     _arena; /* owns the whole template when DM_THING_ARENA_ENABLED or loaded from tsl blob. */
+    const void*    _index_master; /* thing whose identifier index is shared, NULL if it has its own. */
+    char*          _template_base; /* template loaded by dm_thing_set_shared_dsl_blob, one arena chunk from here. */
+    size_t         _template_size;
+    unsigned char* _property_post_state; /* per property flags, allocated on first property set. */
+    int            _property_post_id; /* message id of last property post started. */
+    void*          _value_mutex; /* property sets against copies of the values taken by other threads. */
+#ifdef DM_REPORT_POLICY_ENABLED
+    dm_thing_report_t* _property_report; /* per property, allocated on first policy attached. */
+#endif
+#ifdef DM_STATIC_THING_ENABLED
+    dm_static_thing_t* _static; /* generated model the values are kept by, NULL when they are in the template. */
+#endif
+#ifdef DM_THING_COMPACT_VALUE_ENABLED
+    char           _value_str_buff[DM_THING_VALUE_STR_BUFF_SIZE]; /* value string returned by last get. */
+#endif
 } dm_thing_t;
 
 extern const void* get_dm_thing_class();
 
+/*
+ * load template from tsl blob into a single arena chunk. things loaded so from the same blob get the same layout,
+ * with master one of them, the thing shares its identifier index instead of building one, lookups translate the items.
+ */
+int dm_thing_set_shared_dsl_blob(void* _self, const char* blob, int blob_len, const void* master);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
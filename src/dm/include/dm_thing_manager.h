@@ -10,14 +10,25 @@ extern "C" {
 #include "interface/log_abstract.h"
 #include "interface/list_abstract.h"
 #include "dm_import.h"
+#include "dm_id_index.h"
+#include "dsl.h"
 #include "iot_export.h"
 #include "iot_export_cmp.h"
 #include "iot_import.h"
+#include "cJSON.h"
+#include "single_list.h"
+#include "cmp_message_info.h"
+#include "dm_deviceinfo.h"
 
 #define DM_THING_MANAGER_CLASS get_dm_thing_manager_class()
 #define DM_LOCAL_THING_NAME_PATTERN "lthing_%d"
 #define DM_REQUEST_VERSION_STRING "1.0"
 
+/* json arena of a downlink message is sized for an item every this many bytes of params. */
+#ifndef DM_MESSAGE_JSON_ARENA_BYTES_PER_ITEM
+#define DM_MESSAGE_JSON_ARENA_BYTES_PER_ITEM 4
+#endif
+
 #define METHOD_NAME_SUB_REGISTER            "thing/sub/register"
 #define METHOD_NAME_SUB_REGISTER_REPLY      "thing/sub/register_reply"
 #define METHOD_NAME_SUB_UNREGISTER          "thing/sub/unregister"
@@ -50,6 +61,10 @@ extern "C" {
 #define METHOD_NAME_DOWN_RAW_PEPLY          "thing/model/down_raw_reply"
 #define METHOD_NAME_UP_RAW                  "thing/model/up_raw"
 #define METHOD_NAME_UP_RAW_REPLY            "thing/model/up_raw_reply"
+#define METHOD_NAME_SDK_METRICS_POST        "thing/sdk/metrics/post"
+#ifdef DM_OFFLINE_ENABLED
+#define METHOD_NAME_PROPERTY_HISTORY_POST   "thing/event/property/history/post"
+#endif /* DM_OFFLINE_ENABLED */
 #ifdef DEVICEINFO_ENABLED
 #define METHOD_NAME_DEVICEINFO_UPDATE       "thing/deviceinfo/update"
 #define METHOD_NAME_DEVICEINFO_UPDATE_REPLY "thing/deviceinfo/update_reply"
@@ -64,25 +79,55 @@ extern "C" {
 #define METHOD_MAX_LENGH                    128
 #define URI_MAX_LENGH                       256
 #define PROPERTY_KEY_VALUE_BUFF_MAX_LENGTH  1024
+#define DM_LOCAL_THING_KEY_MAXLEN           (PRODUCT_KEY_MAXLEN + DEVICE_NAME_MAXLEN) /* "productKey/deviceName" */
+
+#ifdef RRPC_ENABLED
+#define DM_RRPC_MESSAGE_ID_MAXLEN           24 /* messageId of rrpc/request/${messageId}, up to 20 digits. */
+
+/* rrpc request waiting for its answer, answered to rrpc/response/${messageId}. */
+typedef struct {
+    int      token; /* rrpc of the service call to the app, passed back to answer it, 0 when free. */
+    int      request_id;
+    uint64_t expire_ms;
+    char     message_id[DM_RRPC_MESSAGE_ID_MAXLEN];
+} dm_rrpc_pending_t;
+#endif /* RRPC_ENABLED */
+
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+/* classes of uplinks, from the type of the event in the tsl. a higher one goes before the lower ones. */
+typedef enum {
+    dm_uplink_priority_normal = 0, /* property posts, info events, metrics and history posts. */
+    dm_uplink_priority_alert,
+    dm_uplink_priority_error,
+} dm_uplink_priority_t;
+
+/* event of an alert or error not sent, sent before any other uplink once connected. */
+typedef struct {
+    void* thing_id;
+    int   priority;
+    char* method;
+    char* uri;
+    char* params;
+} dm_uplink_pending_t;
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
 
 typedef struct {
     const  void* _;
     char*  _name; /* dm thing manager object name. */
     void*  _local_thing_list; /* local thing list. */
     void*  _local_thing_name_list; /* local thing list. */
+    void*  _template_list; /* templates shared by things of one product. */
     void*  _sub_thing_list; /* sub thing list. currently not use. */
     void*  _callback_list; /* callback function list */
-    void*  _service_property_get_identifier_list; /* identifier list when method=thing.service.property.get */
+    const char* _property_get_params; /* json array of identifiers of the thing.service.property.get answered. */
+    int    _property_get_params_length;
     void*  _ota;
-    void*  _thing_id;
+    void*  _thing_id; /* uplink scratch, guarded by _send_mutex like the fields below. */
     void*  _identifier;
     void*  _property_identifier_post; /* used when event = thing.event.property.post */
-    void*  _property_identifier_set; /* used when event = thing.service.property.set */
-    void*  _property_identifier_value_set; /* used when event = thing.service.property.set */
-    void*  _service_identifier_requested; /* service identifier when requested. */
-    void*  _get_value;
-    void*  _set_value;
-    char*  _set_value_str;
+    int    _property_post_changed_only; /* used when event = thing.event.property.post, post changed properties only. */
+    int    _property_post_skipped; /* changed only post found nothing to post. */
+    int    _params_written; /* params of the uplink written in place, not serialized from its items. */
     char*  _get_value_str;
     void*  _message_info;
     void*  _cmp;
@@ -92,18 +137,46 @@ typedef struct {
     char*  _dm_version;
     int    _id;
     int    _response_id;
-    int    _request_id;
-    void*  _raw_data;
-    int    _raw_data_length;
     char*  _method;
     int    _cloud_connected;
     int    _get_tsl_from_cloud;
+    void*  _cloud_template; /* template of the thing of the tsl from cloud, further dsltemplate/get_reply only revalidate it. */
     int    _destructing;
+    void*  _send_mutex; /* uplink messages share _message_info and the scratch fields. */
+    int    _property_post_min_interval_ms; /* property posts of a thing are coalesced when > 0, see set_property_post_schedule. */
+    int    _property_post_max_latency_ms;
+    int    _metrics_post_interval_ms; /* lite-metrics are posted this often when > 0, see set_metrics_post_interval. */
+    uint64_t _metrics_post_last_ms;
+    volatile int _regist_pending; /* subscribes waiting for their result, for the startup profile of lite-startup.h. */
+    int    _payload_format; /* dm_payload_format_t of property and event posts. */
+    dm_reply_handler_fp_t _reply_handler; /* uplink scratch, set while an async request is sent. */
+    void*  _reply_ctx;
+    int    _reply_timeout_ms;
+    int    _request_id; /* id of the async request sent. */
+    void*  _requests; /* dm_request_table_t of async requests waiting for reply, created on first one. */
+    void*  _request_mutex; /* guards _requests, handlers are called without it. */
 #ifdef RRPC_ENABLED
     int    _rrpc;
-    int    _rrpc_message_id;
+    const char* _rrpc_message_id; /* uplink scratch, messageId of the rrpc answered. */
+    dm_rrpc_pending_t _rrpc_pending[CONFIG_DM_RRPC_PENDING]; /* guarded by _send_mutex. */
+    int    _rrpc_token; /* token of the last rrpc request. */
 #endif /* RRPC_ENABLED */
-    dm_callback_type_t _callback_type;
+#ifdef DM_OFFLINE_ENABLED
+    void*  _offline; /* dm_offline_t of the property posts of the device failed, created on first one. */
+    uint64_t _offline_replay_last_ms;
+#endif /* DM_OFFLINE_ENABLED */
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+    dm_uplink_pending_t _uplink_pending[CONFIG_DM_UPLINK_PRIORITY_PENDING]; /* by priority, the oldest first within one. */
+    int    _uplink_pending_number;
+    uint64_t _uplink_pending_retry_ms;
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+#ifdef DM_BACKPRESSURE_ENABLED
+    int    _send_blocked; /* a post was refused as the connection is saturated, send_writable is due once it is not. */
+    int    _property_post_backoff; /* coalesced posts go this many min intervals apart, doubled while saturated. */
+#endif /* DM_BACKPRESSURE_ENABLED */
+    dm_id_index_t _route_index; /* downlink routes keyed by method part of uri. */
+    dm_id_index_t _local_thing_index; /* dm_thing_manager_local_thing_t keyed by thing id. */
+    dm_id_index_t _local_thing_key_index; /* dm_thing_manager_local_thing_t keyed by "productKey/deviceName". */
     dm_cloud_domain_type_t _cloud_domain;
     iotx_cmp_event_handle_func_fpt _cmp_event_handle_func_fp;
     iotx_cmp_register_func_fpt _cmp_register_func_fp;
@@ -111,8 +184,69 @@ typedef struct {
     char  _product_key[PRODUCT_KEY_MAXLEN];
     char  _device_secret[DEVICE_SECRET_MAXLEN];
     char  _device_id[DEVICE_ID_MAXLEN];
+    /* the lists and message info above are constructed in these, they live as long as the manager. */
+    single_list_t      _list_storage[5];
+    cmp_message_info_t _message_info_storage;
 } dm_thing_manager_t;
 
+typedef struct {
+    void* thing_id;
+    thing_property_handle_t thing_handle;
+} dm_thing_manager_property_handle_t;
+
+/*
+ * params of an event other than property post, compiled when the thing is created: the uri and the keys
+ * of its outputData are serialized once, a trigger only writes the values between them.
+ */
+typedef struct {
+    const event_t*        event;
+    char*                 uri;
+    char*                 keys; /* "identifier": of each outputData back to back. */
+    const unsigned short* key_ends; /* end of each in keys. */
+} dm_thing_manager_event_template_t;
+
+/* local thing in the thing indexes, keys of both point into it. */
+typedef struct {
+    thing_t** thing;
+    char      key[DM_LOCAL_THING_KEY_MAXLEN];
+    int       property_post_pending; /* a coalesced property post waits for its time. */
+    uint64_t  property_post_pending_ms; /* uptime of first request of the pending post. */
+    uint64_t  property_post_last_ms; /* uptime of last property post sent. */
+    dm_thing_manager_event_template_t* event_templates; /* one block with what they point to, NULL if none. */
+    int       event_template_number;
+    dm_id_index_t service_method_index; /* service_t keyed by alink method, slots NULL if it can not be had. */
+#ifdef DEVICEINFO_ENABLED
+    dm_deviceinfo_t* deviceinfo; /* created on first deviceinfo update or delete. */
+#endif /* DEVICEINFO_ENABLED */
+} dm_thing_manager_local_thing_t;
+
+/*
+ * state of one downlink message, or of one api call that invokes callbacks.
+ * it lives on the stack of whoever handles the message, so messages for different
+ * things may be handled concurrently without touching dm_thing_manager fields.
+ */
+typedef struct {
+    thing_t**                thing; /* NULL for messages not for a local thing, like tsl got from cloud. */
+    iotx_cmp_message_info_t* iotx_cmp_message_info; /* NULL when not from cloud. */
+    const char*              service_identifier_requested; /* service identifier when requested. */
+    const char*              identifier; /* property or service identifier passed to callbacks. */
+    int                      request_id;
+    void*                    raw_data;
+    int                      raw_data_length;
+    int                      ret;
+    void*                    json_arena_buffer; /* of json_arena, taken on first parse of params. */
+    cJSON_Arena              json_arena; /* params trees parsed for the message, given back with it. */
+} dm_thing_manager_message_t;
+
+typedef void (*dm_thing_manager_route_fp_t)(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message);
+
+typedef struct {
+    const char* method; /* uri part after /sys/productKey/deviceName/. */
+    dm_thing_manager_route_fp_t route_fp; /* built in route, NULL for custom route. */
+    dm_route_handler_fp_t custom_fp; /* custom route registered by application. */
+    void* ctx; /* ctx of custom_fp. */
+} dm_thing_manager_route_t;
+
 extern const void* get_dm_thing_manager_class();
 
 #ifdef __cplusplus
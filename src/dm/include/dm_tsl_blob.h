@@ -0,0 +1,56 @@
+#ifndef DM_TSL_BLOB_H
+#define DM_TSL_BLOB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdlib.h>
+
+#include "dsl.h"
+
+/*
+ * precompiled tsl, all numbers little endian:
+ *
+ * header  : "TSLB", u16 version, u16 header size, u32 total size,
+ *           u32 string table offset, u32 string table size, u32 record offset.
+ * records : profile, properties, events and services in template order.
+ * strings : NUL terminated, records refer to them by u32 offset from
+ *           string table start, DM_TSL_BLOB_NULL_STRING for NULL.
+ *
+ * strings of a template loaded from a blob point into the blob, so the blob
+ * must stay readable (flash, rodata or mmap) as long as the thing lives.
+ */
+#define DM_TSL_BLOB_MAGIC            "TSLB"
+#define DM_TSL_BLOB_MAGIC_SIZE       4
+#define DM_TSL_BLOB_VERSION          1
+#define DM_TSL_BLOB_HEADER_SIZE      24
+#define DM_TSL_BLOB_NULL_STRING      0xFFFFFFFFu
+#define DM_TSL_BLOB_MAX_ITEM_NUMBER  0xFFFF /* enum/bool items and array size, they take no blob bytes. */
+
+typedef struct {
+    const unsigned char* blob;
+    size_t               size;
+    size_t               pos; /* next record byte. */
+    const char*          strings;
+    size_t               strings_size;
+    int                  error; /* sticky, set on any out of range read. */
+} dm_tsl_blob_reader_t;
+
+int dm_tsl_blob_detect(const char* src, size_t src_len);
+
+int            dm_tsl_blob_reader_init(dm_tsl_blob_reader_t* reader, const char* src, size_t src_len);
+unsigned char  dm_tsl_blob_read_u8(dm_tsl_blob_reader_t* reader);
+unsigned int   dm_tsl_blob_read_u32(dm_tsl_blob_reader_t* reader);
+int            dm_tsl_blob_read_i32(dm_tsl_blob_reader_t* reader);
+double         dm_tsl_blob_read_f64(dm_tsl_blob_reader_t* reader);
+char*          dm_tsl_blob_read_string(dm_tsl_blob_reader_t* reader);
+
+/* serialize a LITE_THING_MODEL template, returns blob size, like snprintf it only fills buf when big enough. -1 when fail. */
+int dm_tsl_blob_write(const dsl_template_t* dsl_template, unsigned char* buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DM_TSL_BLOB_H */
@@ -37,7 +37,61 @@ typedef enum {
     service_type_property_set, /* "method": "thing.service.property.set" */
 } service_type_t;
 
-#ifdef LITE_THING_MODEL
+#if defined(DM_THING_COMPACT_VALUE_ENABLED)
+/* values in native form only, strings are formatted on demand. */
+typedef union _data_type_x {
+    struct _data_type_int {
+        int min; /* min */
+        int max; /* max */
+        int value;  /* truly value. */
+        int precise; /* precise */
+    } data_type_int_t;
+
+    struct _data_type_float {
+        float min; /* min */
+        float max; /* max */
+        float value;  /* truly value. */
+        int precise; /* precise */
+    } data_type_float_t;
+
+    struct _data_type_double {
+        double min; /* min */
+        double max; /* max */
+        double value;  /* truly value. */
+        int precise; /* precise */
+    } data_type_double_t;
+
+    struct _data_type_enum {
+        int enum_item_number; /* number of enum items. */
+        int value; /* truly value. */
+        char** enum_item_key;
+        char** enum_item_value;
+    } data_type_enum_t;
+
+    struct _data_type_text {
+        int length; /* text length. */
+        char* value; /* truly value. */
+    } data_type_text_t;
+
+    struct _data_type_date {
+        unsigned long long value; /* truly value. */
+    } data_type_date_t;
+
+    struct _data_type_bool {
+        int bool_item_number; /* number of enum items. */
+        int value; /* 0: false; 1: true. */
+        char** bool_item_key;
+        char** bool_item_value;
+    } data_type_bool_t;
+
+    struct _data_type_array {
+        int size;
+        data_type_type_t item_type;
+        void* array;
+    } data_type_array_t;
+
+} data_type_x_t;
+#elif defined(LITE_THING_MODEL)
 typedef union _data_type_x {
     struct _data_type_int {
         int min; /* min */
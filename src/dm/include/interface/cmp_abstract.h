@@ -14,6 +14,16 @@ extern "C" {
 
 #include "message_info_abstract.h"
 
+#ifdef DM_BACKPRESSURE_ENABLED
+/* what the connection takes now without waiting, see get_send_budget. */
+typedef struct {
+    int      connected;
+    uint32_t pub_slots; /* QoS1 publishes more that can wait for their PUBACK. */
+    uint32_t pub_bytes; /* of the QoS1 publishes waiting for their PUBACK. */
+    uint32_t write_ms; /* the last send waited this long for the socket to take it, 0 once it had as long again to drain. */
+} cmp_send_budget_t;
+#endif /* DM_BACKPRESSURE_ENABLED */
+
 typedef struct {
     size_t size;
     const char*  _class_name;
@@ -27,7 +37,14 @@ typedef struct {
     int   (*send)(void* _self, message_info_t** msg, void* option);
 #ifndef CMP_SUPPORT_MULTI_THREAD
     int   (*yield)(void* _self, int timeout_ms);
+    uint32_t (*get_timeout)(void* _self); /* ms till yield has something to do on its own, 0xFFFFFFFF for never. */
 #endif
+#ifdef DM_BACKPRESSURE_ENABLED
+    int   (*get_send_budget)(void* _self, cmp_send_budget_t* budget); /* -1 when the connection tells none. */
+#endif /* DM_BACKPRESSURE_ENABLED */
+#ifdef DM_CHANNELS_ENABLED
+    int   (*set_channel_route)(void* _self, const char* prefix, dm_channel_t channel);
+#endif /* DM_CHANNELS_ENABLED */
 } cmp_abstract_t;
 
 #ifdef __cplusplus
@@ -10,6 +10,7 @@ extern "C" {
 
 typedef void (*print_fp_t)(void* data);
 typedef void (*handle_fp_t)(void* node, va_list* params);
+typedef int  (*visit_fp_t)(void* node, void* ctx); /* return non 0 to stop visiting. */
 
 typedef struct {
     size_t size;
@@ -23,6 +24,7 @@ typedef struct {
     int   (*get_size)(const void* _self);
     void  (*iterator)(const void* _self, handle_fp_t handle_fp, va_list* params);
     void  (*print)(const void* _self, print_fp_t print_fp);
+    int   (*visit)(const void* _self, visit_fp_t visit_fp, void* ctx);
 } list_t;
 
 #ifdef __cplusplus
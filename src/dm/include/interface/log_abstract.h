@@ -32,12 +32,45 @@ typedef struct {
     void  (*log)(const void* _self, const char* _func, const int _line, log_level_t _log_level, const char* fmt, ...);
 } log_t;
 
+/* dm_log_xxx() of levels above it are compiled out, 0 for emerg up to 5 for debug. */
+#ifndef DM_LOG_LEVEL_MAX
+#define DM_LOG_LEVEL_MAX        5
+#endif
+
+/* what is compiled out still has its arguments checked, and nothing is evaluated. */
+#define dm_log_none(level, ...) do { if (0) (*(log_t**)_g_default_logger)->log(_g_default_logger, __FUNCTION__, __LINE__, level, __VA_ARGS__); } while (0)
+
 #define dm_log_emerg(...)      (*(log_t**)_g_default_logger)->log(_g_default_logger, __FUNCTION__, __LINE__, log_level_emerg,   __VA_ARGS__)
+
+#if DM_LOG_LEVEL_MAX >= 1
 #define dm_log_crit(...)       (*(log_t**)_g_default_logger)->log(_g_default_logger, __FUNCTION__, __LINE__, log_level_crit,    __VA_ARGS__)
+#else
+#define dm_log_crit(...)       dm_log_none(log_level_crit, __VA_ARGS__)
+#endif
+
+#if DM_LOG_LEVEL_MAX >= 2
 #define dm_log_err(...)        (*(log_t**)_g_default_logger)->log(_g_default_logger, __FUNCTION__, __LINE__, log_level_err,     __VA_ARGS__)
+#else
+#define dm_log_err(...)        dm_log_none(log_level_err, __VA_ARGS__)
+#endif
+
+#if DM_LOG_LEVEL_MAX >= 3
 #define dm_log_warning(...)    (*(log_t**)_g_default_logger)->log(_g_default_logger, __FUNCTION__, __LINE__, log_level_warning, __VA_ARGS__)
+#else
+#define dm_log_warning(...)    dm_log_none(log_level_warning, __VA_ARGS__)
+#endif
+
+#if DM_LOG_LEVEL_MAX >= 4
 #define dm_log_info(...)       (*(log_t**)_g_default_logger)->log(_g_default_logger, __FUNCTION__, __LINE__, log_level_info,    __VA_ARGS__)
+#else
+#define dm_log_info(...)       dm_log_none(log_level_info, __VA_ARGS__)
+#endif
+
+#if DM_LOG_LEVEL_MAX >= 5
 #define dm_log_debug(...)      (*(log_t**)_g_default_logger)->log(_g_default_logger, __FUNCTION__, __LINE__, log_level_debug,   __VA_ARGS__)
+#else
+#define dm_log_debug(...)      dm_log_none(log_level_debug, __VA_ARGS__)
+#endif
 
 #ifdef __cplusplus
 }
@@ -35,7 +35,9 @@ typedef struct {
     char* (*get_params_data)(void* _self);
 #endif
     void  (*set_params_data)(void* _self, char* params_data_buf);  /* malloc mem and copy payload. */
-    int   (*set_raw_data_and_length)(void* _self, void* raw_data, int raw_data_length);  /* malloc mem and copy payload. */
+    char* (*reserve_params_data)(void* _self, int len);  /* params of len bytes are written in place, NUL after them. */
+    int   (*get_params_data_length)(void* _self);  /* as serialized or set, without the NUL. */
+    int   (*set_raw_data_and_length)(void* _self, void* raw_data, int raw_data_length);  /* lent till clear, copied with MEMORY_NO_COPY. */
     void* (*get_raw_data)(void* _self);
     int   (*get_raw_data_length)(void* _self);
     char* (*get_product_key)(void* _self);
@@ -44,6 +46,8 @@ typedef struct {
     void  (*set_device_name)(void* _self, char* device_name);  /* malloc mem and copy payload. */
     void  (*set_code)(void* _self, int code);
     int   (*get_code)(void* _self);
+    void  (*set_payload_format)(void* _self, int format); /* of the next request serialized, reset by clear. */
+    int   (*get_payload_format)(void* _self);
 } message_info_t;
 
 #ifdef __cplusplus
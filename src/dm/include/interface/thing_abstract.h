@@ -7,9 +7,17 @@ extern "C" {
 
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 typedef void (*handle_item_t)(void* property, int index, va_list* params);
 
+/* property identifier resolved once, used to set/get value without parsing identifier again. */
+typedef struct {
+    void* property; /* top level property_t. */
+    void* lite_property; /* property itself or struct specs member the identifier points to. */
+    int   arr_index; /* array item index, -1 if not array item. */
+} thing_property_handle_t;
+
 typedef struct {
     size_t size;
     const char*  _class_name;
@@ -53,6 +61,33 @@ typedef struct {
     int   (*set_service_input_output_data_value_by_identifier)(void* _self, const char* const identifier, const void* value, const char* value_str);
     int   (*get_service_input_output_data_value_by_identifier)(void* _self, const char* const identifier, void* value, char** value_str);
     int   (*get_lite_property_value)(const void* _self, const void* const property, void* value, char** value_str);
+    int   (*resolve_property_handle)(const void* _self, const char* const identifier, thing_property_handle_t* handle);
+    int   (*set_property_value_by_handle)(void* _self, const thing_property_handle_t* handle, const void* value, const char* value_str);
+    int   (*get_property_value_by_handle)(void* _self, const thing_property_handle_t* handle, void* value, char** value_str);
+    /* native value into value, -1 for text which only goes to buff, and value string into buff, returns length of string or -1. */
+    int   (*copy_property_value_by_handle)(const void* _self, const thing_property_handle_t* handle, void* value, char* buff, int buff_len);
+    /* hold off property sets of other threads while values are read through get_lite_property_value. */
+    void  (*lock_property_values)(const void* _self);
+    void  (*unlock_property_values)(const void* _self);
+    /* properties set since last acked property post, start returns number of properties to post. */
+    int   (*start_property_post)(void* _self, int message_id);
+    int   (*is_property_posting)(const void* _self, const void* property);
+    void  (*finish_property_post)(void* _self, int message_id, int success);
+    /* bulk access of array property items, values holds number items of native int, float or double. */
+    int   (*set_property_array_values)(void* _self, const char* const identifier, int start, const void* values, int number);
+    int   (*get_property_array_values)(const void* _self, const char* const identifier, int start, void* values, int number);
+    /* track property, all properties if NULL, as changed so next changed property post carries it. */
+    int   (*request_property_post)(void* _self, const void* property);
+    int   (*set_profile)(void* _self, const char* product_key, int product_key_len, const char* device_name, int device_name_len);
+#ifdef DM_REPORT_POLICY_ENABLED
+    /* attach dm_report_policy_t to property, all properties if NULL, a NULL policy detaches. */
+    int   (*set_property_report_policy)(void* _self, const void* property, const void* policy);
+    /*
+     * properties held past their min interval and the ones due by max interval at now, tracked as changed if mark.
+     * returns number of them, timeout_ms is lowered to ms till the next one is due.
+     */
+    int   (*report_due_properties)(void* _self, uint64_t now, int mark, uint32_t* timeout_ms);
+#endif
 } thing_t;
 
 #ifdef __cplusplus
@@ -40,6 +40,38 @@ typedef struct {
     int   (*yield)(void* _self, int timeout);
 #endif
     int   (*install_product_key_device_name)(void *_self, const void* thing_id, char *product_key, char *device_name);
+    void* (*resolve_thing_property_handle)(void* _self, const void* thing_id, const char* identifier);
+    void  (*release_thing_property_handle)(void* _self, void* handle);
+    int   (*set_thing_property_value_by_handle)(void* _self, const void* handle, const void* value, const char* value_str);
+    int   (*get_thing_property_value_by_handle)(void* _self, const void* handle, void* value, char** value_str);
+    int   (*copy_thing_property_value)(void* _self, const void* thing_id, const char* identifier, void* value, char* buff, int buff_len);
+    int   (*copy_thing_property_value_by_handle)(void* _self, const void* handle, void* value, char* buff, int buff_len);
+    int   (*trigger_changed_property_post)(void* _self, const void* thing_id);
+    int   (*set_thing_property_values)(void* _self, const void* thing_id, const void* values, int number);
+    int   (*set_thing_property_array_values)(void* _self, const void* thing_id, const void* identifier, int start, const void* values, int number);
+    int   (*get_thing_property_array_values)(void* _self, const void* thing_id, const void* identifier, int start, void* values, int number);
+    int   (*register_route)(void* _self, const char* method, dm_route_handler_fp_t handler, void* ctx);
+    int   (*set_property_post_schedule)(void* _self, int min_interval_ms, int max_latency_ms);
+    int   (*flush_property_post)(void* _self, int force);
+    int   (*generate_new_local_things)(void* _self, const char* const* tsls, const int* tsl_lens, int number, void** things);
+    int   (*set_payload_format)(void* _self, int format);
+    int   (*trigger_event_async)(void* _self, const void* thing_id, const void* event_identifier, const char* property_identifier,
+                                 int timeout_ms, dm_reply_handler_fp_t handler, void* ctx);
+    int   (*cancel_request)(void* _self, int request_id);
+    int   (*set_metrics_post_interval)(void* _self, int interval_ms);
+#ifndef CMP_SUPPORT_MULTI_THREAD
+    uint32_t (*get_timeout)(void* _self);
+#endif
+#ifdef DM_REPORT_POLICY_ENABLED
+    int   (*set_property_report_policy)(void* _self, const void* thing_id, const char* identifier, const dm_report_policy_t* policy);
+#endif
+#ifdef DM_CHANNELS_ENABLED
+    int   (*set_channel_route)(void* _self, const char* prefix, dm_channel_t channel);
+#endif
+#ifdef DM_STATIC_THING_ENABLED
+    int   (*bind_static_thing)(void* _self, const void* thing_id, const dm_static_thing_model_t* model, void* data);
+    int   (*set_static_properties_changed)(void* _self, const void* thing_id, const unsigned char* ids);
+#endif
 } thing_manager_t;
 
 #ifdef __cplusplus
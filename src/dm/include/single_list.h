@@ -10,17 +10,21 @@ extern "C" {
 #define SINGLE_LIST_CLASS get_single_list_class()
 
 void list_iterator(const void* _list, handle_fp_t handle_fn, ...);
+int  list_visit(const void* _list, visit_fp_t visit_fn, void* ctx); /* returns what stopped visiting, 0 if all visited. */
 
-typedef struct _node {
-    void* data;
-    struct _node* next;
-} node_t;
+/* in the list itself, most lists never hold more and take no other allocation. */
+#ifndef SINGLE_LIST_INLINE_NUM
+#define SINGLE_LIST_INLINE_NUM 4
+#endif
 
+/* the data in insertion order, grown by doubling once _inline is outgrown. */
 typedef struct {
     const void* _;
-    node_t*     _head;
+    void**      _items;
     int         _size;
+    int         _capacity;
     char*       _name;
+    void*       _inline[SINGLE_LIST_INLINE_NUM];
 } single_list_t;
 
 extern const void* get_single_list_class();
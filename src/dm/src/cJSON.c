@@ -57,6 +57,8 @@
 #endif
 
 #include "cJSON.h"
+#include "lite-number.h"
+#include "lite-json-str.h"
 
 /* define our own boolean type */
 #define true ((cJSON_bool)1)
@@ -102,11 +104,35 @@ static int case_insensitive_strcmp(const unsigned char* string1, const unsigned
 
     return tolower(*string1) - tolower(*string2);
 }
+#else
+/* Case insensitive comparison of a C string with a string of length that is not zero terminated */
+static int case_insensitive_strncmp(const unsigned char* string1, const unsigned char* string2, size_t length)
+{
+    if ((string1 == NULL) || (string2 == NULL))
+        return 1;
+
+    for (; length > 0; (void)string1++, string2++, length--) {
+        if ((*string1 == '\0') || (tolower(*string1) != tolower(*string2)))
+            return 1;
+    }
+
+    return *string1 != '\0';
+}
+
+/* Case sensitive comparison of a C string with a string of length that is not zero terminated */
+static int length_strcmp(const char* string1, const char* string2, size_t length)
+{
+    if ((string1 == NULL) || (string2 == NULL))
+        return 1;
+
+    return (strlen(string1) != length) || (strncmp(string1, string2, length) != 0);
+}
 #endif
 typedef struct internal_hooks {
     void* (*allocate)(size_t size);
     void (*deallocate)(void* pointer);
     void* (*reallocate)(void* pointer, size_t size);
+    cJSON_Arena* arena; /* where a parse takes its items from, NULL for the heap */
 } internal_hooks;
 
 #if defined(_MSC_VER)
@@ -129,7 +155,32 @@ static void* internal_realloc(void* pointer, size_t size)
 #define internal_realloc realloc
 #endif
 
-static internal_hooks global_hooks = { internal_malloc, internal_free, internal_realloc };
+static internal_hooks global_hooks = { internal_malloc, internal_free, internal_realloc, NULL };
+
+/* arena allocations are aligned for any item member */
+#define arena_align(size) (((size) + sizeof(double) - 1) & ~(sizeof(double) - 1))
+
+static void* arena_allocate(cJSON_Arena* const arena, size_t size)
+{
+    unsigned char* pointer = NULL;
+
+    size = arena_align(size);
+    if ((arena->buffer == NULL) || (size > arena->size - arena->used))
+        return NULL;
+
+    pointer = arena->buffer + arena->used;
+    arena->used += size;
+
+    return pointer;
+}
+
+static void* hooks_allocate(const internal_hooks* const hooks, size_t size)
+{
+    if (hooks->arena != NULL)
+        return arena_allocate(hooks->arena, size);
+
+    return hooks->allocate(size);
+}
 
 static unsigned char* cJSON_strdup(const unsigned char* string, const internal_hooks* const hooks)
 {
@@ -175,7 +226,7 @@ CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks* hooks)
 /* Internal constructor. */
 static cJSON* cJSON_New_Item(const internal_hooks* const hooks)
 {
-    cJSON* node = (cJSON*)hooks->allocate(sizeof(cJSON));
+    cJSON* node = (cJSON*)hooks_allocate(hooks, sizeof(cJSON));
     if (node)
         memset(node, '\0', sizeof(cJSON));
 
@@ -190,16 +241,10 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON* item)
         next = item->next;
         if (!(item->type & cJSON_IsReference) && (item->child != NULL))
             cJSON_Delete(item->child);
-        if (!(item->type & cJSON_IsReference) && (item->valuestring != NULL)) {
-#ifndef CJSON_STRING_ZEROCOPY
+        if (!(item->type & cJSON_IsReference) && (item->valuestring != NULL))
             global_hooks.deallocate(item->valuestring);
-#endif
-        }
-        if (!(item->type & cJSON_StringIsConst) && (item->string != NULL)) {
-#ifndef CJSON_STRING_ZEROCOPY
+        if (!(item->type & cJSON_StringIsConst) && (item->string != NULL))
             global_hooks.deallocate(item->string);
-#endif
-        }
         global_hooks.deallocate(item);
         item = next;
     }
@@ -224,6 +269,13 @@ typedef struct {
     internal_hooks hooks;
 } parse_buffer;
 
+/* Delete what a failed parse made so far, an arena is given back as a whole by its owner. */
+static void parse_delete(cJSON* const item, const parse_buffer* const input_buffer)
+{
+    if (input_buffer->hooks.arena == NULL)
+        cJSON_Delete(item);
+}
+
 /* check if the given size is left to read in a given parse buffer (starting with 1) */
 #define can_read(buffer, size) ((buffer != NULL) && (((buffer)->offset + size) <= (buffer)->length))
 /* check if the buffer can be accessed at the given index (starting with 0) */
@@ -277,7 +329,11 @@ static cJSON_bool parse_number(cJSON* const item, parse_buffer* const input_buff
 loop_end:
     number_c_string[i] = '\0';
 
+#ifdef ENABLE_LOCALES
     number = strtod((const char*)number_c_string, (char**)&after_end);
+#else
+    number = LITE_parse_double((const char*)number_c_string, (char**)&after_end);
+#endif
     if (number_c_string == after_end) {
         return false; /* parse_error */
     }
@@ -405,9 +461,8 @@ static cJSON_bool print_number(const cJSON* const item, printbuffer* const outpu
     double d = item->valuedouble;
     int length = 0;
     size_t i = 0;
-    unsigned char number_buffer[26]; /* temporary buffer to print the number into */
+    unsigned char number_buffer[LITE_NUMBER_LEN_MAX]; /* temporary buffer to print the number into */
     unsigned char decimal_point = get_decimal_point();
-    double test;
 
     if (output_buffer == NULL)
         return false;
@@ -416,14 +471,8 @@ static cJSON_bool print_number(const cJSON* const item, printbuffer* const outpu
     if ((d * 0) != 0)
         length = sprintf((char*)number_buffer, "null");
     else {
-        /* Try 15 decimal places of precision to avoid nonsignificant nonzero digits */
-        length = sprintf((char*)number_buffer, "%1.15g", d);
-
-        /* Check whether the original double can be recovered */
-        if ((sscanf((char*)number_buffer, "%lg", &test) != 1) || ((double)test != d)) {
-            /* If not, print with 17 decimal places of precision */
-            length = sprintf((char*)number_buffer, "%1.17g", d);
-        }
+        /* the shortest text the original double is recovered from */
+        length = LITE_format_double((char*)number_buffer, d);
     }
 
     /* sprintf failed or buffer overrun occured */
@@ -616,7 +665,7 @@ static cJSON_bool parse_string(cJSON* const item, parse_buffer* const input_buff
         /* This is at most how much we need for the output */
         allocation_length = (size_t)(input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
 
-        output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+        output = (unsigned char*)hooks_allocate(&input_buffer->hooks, allocation_length + sizeof(""));
         if (output == NULL) {
             goto fail; /* allocation failure */
         }
@@ -680,8 +729,9 @@ static cJSON_bool parse_string(cJSON* const item, parse_buffer* const input_buff
     item->type = cJSON_String;
     item->valuestring = (char*)output;
 #ifdef CJSON_STRING_ZEROCOPY
+    /* the string is the input's */
+    item->type |= cJSON_IsReference;
     item->valuestring_length = input_end - output;
-#else
 #endif
     input_buffer->offset = (size_t)(input_end - input_buffer->content);
     input_buffer->offset++;
@@ -690,7 +740,7 @@ static cJSON_bool parse_string(cJSON* const item, parse_buffer* const input_buff
 
 fail:
 #ifndef CJSON_STRING_ZEROCOPY
-    if (output != NULL)
+    if ((output != NULL) && (input_buffer->hooks.arena == NULL))
         input_buffer->hooks.deallocate(output);
 #endif
     if (input_pointer != NULL)
@@ -702,9 +752,11 @@ fail:
 /* Render the cstring provided to an escaped version that can be printed. */
 static cJSON_bool print_string_ptr(const unsigned char* const input, printbuffer* const output_buffer)
 {
-    const unsigned char* input_pointer = NULL;
     unsigned char* output = NULL;
     unsigned char* output_pointer = NULL;
+    size_t input_length = 0;
+    size_t offset = 0;
+    size_t run = 0;
     size_t output_length = 0;
     /* numbers of additional characters needed for escaping */
     size_t escape_characters = 0;
@@ -722,9 +774,12 @@ static cJSON_bool print_string_ptr(const unsigned char* const input, printbuffer
         return true;
     }
 
-    /* set "flag" to 1 if something needs to be escaped */
-    for (input_pointer = input; *input_pointer; input_pointer++) {
-        switch (*input_pointer) {
+    input_length = strlen((const char*)input);
+
+    /* count the characters to be escaped, skipping the plain runs between them */
+    for (offset = LITE_json_plain_len((const char*)input, input_length); offset < input_length;
+            offset += 1 + LITE_json_plain_len((const char*)input + offset + 1, input_length - offset - 1)) {
+        switch (input[offset]) {
         case '\"':
         case '\\':
         case '\b':
@@ -736,14 +791,12 @@ static cJSON_bool print_string_ptr(const unsigned char* const input, printbuffer
             escape_characters++;
             break;
         default:
-            if (*input_pointer < 32) {
-                /* UTF-16 escape sequence uXXXX */
-                escape_characters += 5;
-            }
+            /* UTF-16 escape sequence uXXXX */
+            escape_characters += 5;
             break;
         }
     }
-    output_length = (size_t)(input_pointer - input) + escape_characters;
+    output_length = input_length + escape_characters;
 
     output = ensure(output_buffer, output_length + sizeof("\"\""));
     if (output == NULL)
@@ -761,42 +814,44 @@ static cJSON_bool print_string_ptr(const unsigned char* const input, printbuffer
 
     output[0] = '\"';
     output_pointer = output + 1;
-    /* copy the string */
-    for (input_pointer = input; *input_pointer != '\0'; (void)input_pointer++, output_pointer++) {
-        if ((*input_pointer > 31) && (*input_pointer != '\"') && (*input_pointer != '\\')) {
-            /* normal character, copy */
-            *output_pointer = *input_pointer;
-        } else {
-            /* character needs to be escaped */
-            *output_pointer++ = '\\';
-            switch (*input_pointer) {
-            case '\\':
-                *output_pointer = '\\';
-                break;
-            case '\"':
-                *output_pointer = '\"';
-                break;
-            case '\b':
-                *output_pointer = 'b';
-                break;
-            case '\f':
-                *output_pointer = 'f';
-                break;
-            case '\n':
-                *output_pointer = 'n';
-                break;
-            case '\r':
-                *output_pointer = 'r';
-                break;
-            case '\t':
-                *output_pointer = 't';
-                break;
-            default:
-                /* escape and print as unicode codepoint */
-                sprintf((char*)output_pointer, "u%04x", *input_pointer);
-                output_pointer += 4;
-                break;
-            }
+    /* copy the string, plain runs at once */
+    for (offset = 0; ; (void)offset++, output_pointer++) {
+        run = LITE_json_plain_len((const char*)input + offset, input_length - offset);
+        memcpy(output_pointer, input + offset, run);
+        output_pointer += run;
+        offset += run;
+        if (offset == input_length)
+            break;
+
+        /* character needs to be escaped */
+        *output_pointer++ = '\\';
+        switch (input[offset]) {
+        case '\\':
+            *output_pointer = '\\';
+            break;
+        case '\"':
+            *output_pointer = '\"';
+            break;
+        case '\b':
+            *output_pointer = 'b';
+            break;
+        case '\f':
+            *output_pointer = 'f';
+            break;
+        case '\n':
+            *output_pointer = 'n';
+            break;
+        case '\r':
+            *output_pointer = 'r';
+            break;
+        case '\t':
+            *output_pointer = 't';
+            break;
+        default:
+            /* escape and print as unicode codepoint */
+            sprintf((char*)output_pointer, "u%04x", input[offset]);
+            output_pointer += 4;
+            break;
         }
     }
     output[output_length + 1] = '\"';
@@ -847,9 +902,10 @@ static parse_buffer* skip_utf8_bom(parse_buffer* const buffer)
 }
 
 /* Parse an object - create a new root, and populate. */
-CJSON_PUBLIC(cJSON*) cJSON_ParseWithOpts(const char* value, const char** return_parse_end, cJSON_bool require_null_terminated)
+static cJSON* parse_with_hooks(const char* value, const char** return_parse_end, cJSON_bool require_null_terminated,
+                               const internal_hooks* const hooks)
 {
-    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0, 0 } };
     cJSON* item = NULL;
 
     /* reset error position */
@@ -862,9 +918,9 @@ CJSON_PUBLIC(cJSON*) cJSON_ParseWithOpts(const char* value, const char** return_
     buffer.content = (const unsigned char*)value;
     buffer.length = strlen((const char*)value) + sizeof("");
     buffer.offset = 0;
-    buffer.hooks = global_hooks;
+    buffer.hooks = *hooks;
 
-    item = cJSON_New_Item(&global_hooks);
+    item = cJSON_New_Item(hooks);
     if (item == NULL) /* memory fail */
         goto fail;
 
@@ -886,7 +942,7 @@ CJSON_PUBLIC(cJSON*) cJSON_ParseWithOpts(const char* value, const char** return_
 
 fail:
     if (item != NULL)
-        cJSON_Delete(item);
+        parse_delete(item, &buffer);
 
     if (value != NULL) {
         error local_error;
@@ -907,12 +963,66 @@ fail:
     return NULL;
 }
 
+CJSON_PUBLIC(cJSON*) cJSON_ParseWithOpts(const char* value, const char** return_parse_end, cJSON_bool require_null_terminated)
+{
+    return parse_with_hooks(value, return_parse_end, require_null_terminated, &global_hooks);
+}
+
 /* Default options for cJSON_Parse */
 CJSON_PUBLIC(cJSON*) cJSON_Parse(const char* value)
 {
     return cJSON_ParseWithOpts(value, 0, 0);
 }
 
+CJSON_PUBLIC(void) cJSON_InitArena(cJSON_Arena* arena, void* buffer, size_t size)
+{
+    size_t skipped = 0;
+
+    if (arena == NULL)
+        return;
+
+    /* start at an aligned address, whatever buffer is */
+    if (buffer != NULL)
+        skipped = arena_align((size_t)buffer) - (size_t)buffer;
+
+    arena->buffer = (buffer != NULL) && (size > skipped) ? (unsigned char*)buffer + skipped : NULL;
+    arena->size = (arena->buffer != NULL) ? size - skipped : 0;
+    arena->used = 0;
+}
+
+CJSON_PUBLIC(void) cJSON_ResetArena(cJSON_Arena* arena)
+{
+    if (arena != NULL)
+        arena->used = 0;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_ArenaOwns(const cJSON_Arena* arena, const cJSON* item)
+{
+    if ((arena == NULL) || (arena->buffer == NULL) || (item == NULL))
+        return false;
+
+    return ((const unsigned char*)item >= arena->buffer) && ((const unsigned char*)item < arena->buffer + arena->size);
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_ParseInArena(const char* value, cJSON_Arena* arena)
+{
+    internal_hooks hooks = global_hooks;
+    cJSON* item = NULL;
+    size_t used = 0;
+
+    if (arena == NULL)
+        return NULL;
+
+    used = arena->used;
+    hooks.arena = arena;
+
+    item = parse_with_hooks(value, 0, 0, &hooks);
+    if (item == NULL)
+        arena->used = used; /* what the failed parse took */
+
+    return item;
+}
+
 #define cjson_min(a, b) ((a < b) ? a : b)
 
 static unsigned char* print(const cJSON* const item, cJSON_bool format, const internal_hooks* const hooks)
@@ -1016,6 +1126,24 @@ CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON* item, char* buf, const i
     return print_value(item, &p);
 }
 
+CJSON_PUBLIC(char*) cJSON_PrintInArena(cJSON* item, cJSON_Arena* arena, cJSON_bool fmt)
+{
+    char* printed = NULL;
+    size_t length = 0;
+
+    if ((arena == NULL) || (arena->buffer == NULL))
+        return NULL;
+
+    printed = (char*)arena->buffer + arena->used;
+    length = cjson_min(arena->size - arena->used, (size_t)INT_MAX);
+    if (!cJSON_PrintPreallocated(item, printed, (int)length, fmt))
+        return NULL;
+
+    arena->used = cjson_min(arena->size, arena->used + arena_align(strlen(printed) + sizeof("")));
+
+    return printed;
+}
+
 /* Parser core - when encountering text, process appropriately. */
 static cJSON_bool parse_value(cJSON* const item, parse_buffer* const input_buffer)
 {
@@ -1198,7 +1326,7 @@ success:
 
 fail:
     if (head != NULL)
-        cJSON_Delete(head);
+        parse_delete(head, input_buffer);
 
     return false;
 }
@@ -1311,6 +1439,7 @@ static cJSON_bool parse_object(cJSON* const item, parse_buffer* const input_buff
         current_item->string = current_item->valuestring;
 #ifdef CJSON_STRING_ZEROCOPY
         current_item->string_length = current_item->valuestring_length;
+        current_item->type = cJSON_StringIsConst; /* the name is the input's */
 #endif
         current_item->valuestring = NULL;
 
@@ -1324,6 +1453,9 @@ static cJSON_bool parse_object(cJSON* const item, parse_buffer* const input_buff
         if (!parse_value(current_item, input_buffer)) {
             goto fail; /* failed to parse value */
         }
+#ifdef CJSON_STRING_ZEROCOPY
+        current_item->type |= cJSON_StringIsConst; /* parse_value set the type */
+#endif
         buffer_skip_whitespace(input_buffer);
     } while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
 
@@ -1342,7 +1474,7 @@ success:
 
 fail:
     if (head != NULL)
-        cJSON_Delete(head);
+        parse_delete(head, input_buffer);
 
     return false;
 }
@@ -1484,13 +1616,17 @@ static cJSON* get_object_item(const cJSON* const object, const char* const name,
 
     current_element = object->child;
     if (case_sensitive) {
+#ifndef CJSON_STRING_ZEROCOPY
         while ((current_element != NULL) && (strcmp(name, current_element->string) != 0))
+#else
+        while ((current_element != NULL) && (length_strcmp(name, current_element->string, current_element->string_length) != 0))
+#endif
             current_element = current_element->next;
     } else {
 #ifndef CJSON_STRING_ZEROCOPY
         while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0))
 #else
-        while ((current_element != NULL) && (strncmp((const char*)name, (const char*)(current_element->string), current_element->string_length) != 0))
+        while ((current_element != NULL) && (case_insensitive_strncmp((const unsigned char*)name, (const unsigned char*)(current_element->string), current_element->string_length) != 0))
 #endif
         {
             current_element = current_element->next;
@@ -1587,6 +1723,9 @@ CJSON_PUBLIC(void) cJSON_AddItemToObjectCS(cJSON* object, const char* string, cJ
     if (!(item->type & cJSON_StringIsConst) && item->string)
         global_hooks.deallocate(item->string);
     item->string = (char*)string;
+#ifdef CJSON_STRING_ZEROCOPY
+    item->string_length = strlen(string);
+#endif
     item->type |= cJSON_StringIsConst;
     cJSON_AddItemToArray(object, item);
 }
@@ -1737,6 +1876,9 @@ static cJSON_bool replace_item_in_object(cJSON* object, const char* string, cJSO
     if (!(replacement->type & cJSON_StringIsConst) && (replacement->string != NULL))
         cJSON_free(replacement->string);
     replacement->string = (char*)cJSON_strdup((const unsigned char*)string, &global_hooks);
+#ifdef CJSON_STRING_ZEROCOPY
+    replacement->string_length = (replacement->string != NULL) ? strlen(replacement->string) : 0;
+#endif
     replacement->type &= ~cJSON_StringIsConst;
 
     cJSON_ReplaceItemViaPointer(object, get_object_item(object, string, case_sensitive), replacement);
@@ -1820,6 +1962,9 @@ CJSON_PUBLIC(cJSON*) cJSON_CreateString(const char* string)
             cJSON_Delete(item);
             return NULL;
         }
+#ifdef CJSON_STRING_ZEROCOPY
+        item->valuestring_length = strlen(item->valuestring);
+#endif
     }
 
     return item;
@@ -1835,6 +1980,9 @@ CJSON_PUBLIC(cJSON*) cJSON_CreateRaw(const char* raw)
             cJSON_Delete(item);
             return NULL;
         }
+#ifdef CJSON_STRING_ZEROCOPY
+        item->valuestring_length = strlen(item->valuestring);
+#endif
     }
 
     return item;
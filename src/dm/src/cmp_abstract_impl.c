@@ -7,8 +7,15 @@
 #include "cmp_abstract_impl.h"
 #include "logger.h"
 #include "cmp_message_info.h"
+#include "lite-trace.h"
+#include "lite-startup.h"
 
 #include "dm_import.h"
+#include "iot_export.h"
+#ifdef PAYLOAD_COMPRESS_ENABLED
+#include "utils_lz.h"
+#endif
+#include "mqtt_instance.h"
 
 #define CMP_IMPL_EXTENTED_ROOM_FOR_STRING_MALLOC 1
 static int cmp_impl_deinit(void* _self, const void* option);
@@ -25,6 +32,14 @@ static void* cmp_impl_ctor(void* _self, va_list* params)
     cmp_abstract_impl_t* self = _self;
 
     self->cmp_inited = 0;
+#ifdef DM_BACKPRESSURE_ENABLED
+    self->write_ms = 0;
+    self->write_end_ms = 0;
+#endif /* DM_BACKPRESSURE_ENABLED */
+#ifdef CMP_IMPL_CHANNELS
+    /* uplinks all go over CMP without the lock of the routes. */
+    if (cmp_channel_create(&self->channels) != 0) dm_log_err("channels not created");
+#endif
 
     return self;
 }
@@ -34,6 +49,9 @@ static void* cmp_impl_dtor(void* _self)
     cmp_abstract_impl_t* self = _self;
 
     if (self->cmp_inited) cmp_impl_deinit(self, NULL);
+#ifdef CMP_IMPL_CHANNELS
+    cmp_channel_destroy(&self->channels);
+#endif
 
     return self;
 }
@@ -52,11 +70,17 @@ static int cmp_impl_init(void* _self, const char* _product_key, const char* _dev
 
     init_param.event_func = event_cb;
     init_param.user_data = pcontext;
+#ifdef RAW_DATA_DIRECT_ENABLED
+    self->event_cb = event_cb;
+    self->event_pcontext = pcontext;
+#endif
 
     init_param.domain_type = (iotx_cmp_cloud_domain_types_t)domain_type;
     init_param.secret_type = IOTX_CMP_DEVICE_SECRET_DEVICE;
 
+    LITE_STARTUP_BEGIN(LITE_STARTUP_CMP_INIT);
     ret = IOT_CMP_Init(&init_param, NULL);
+    LITE_STARTUP_END(LITE_STARTUP_CMP_INIT, FAIL_RETURN != ret);
 
     dm_log_debug("ret = IOT_CMP_Init() = %d\n", ret);
 
@@ -64,6 +88,13 @@ static int cmp_impl_init(void* _self, const char* _product_key, const char* _dev
         dm_printf("init fail\n");
     } else {
         self->cmp_inited = 1;
+#ifdef CMP_IMPL_LOCAL_CONTROL
+        /* the cloud goes on without the LAN when the port is not there. */
+        cmp_local_init(&self->local, _device_secret);
+#endif
+#ifdef CMP_IMPL_CHANNELS
+        cmp_channel_init(&self->channels, _product_key, _device_name, _device_secret, _device_id);
+#endif
     }
 
     return ret;
@@ -72,18 +103,127 @@ static int cmp_impl_init(void* _self, const char* _product_key, const char* _dev
 static int cmp_impl_deinit(void* _self, const void* option)
 {
     cmp_abstract_impl_t* self = _self;
+    int ret;
+#ifdef RAW_DATA_DIRECT_ENABLED
+    int i;
+#endif
 
     (void)option; /* prevent build warning. */
 
     self->cmp_inited = 0;
 
-    return IOT_CMP_Deinit(NULL);;
+    ret = IOT_CMP_Deinit(NULL);
+    /* CMP destroyed its MQTT client but leaves it the instance, which the client of the next init could not replace. */
+    mqtt_remove_instance();
+
+#ifdef CMP_IMPL_LOCAL_CONTROL
+    cmp_local_deinit(&self->local);
+#endif
+#ifdef CMP_IMPL_CHANNELS
+    cmp_channel_deinit(&self->channels);
+#endif
+
+#ifdef RAW_DATA_DIRECT_ENABLED
+    for (i = 0; i < CMP_IMPL_RAW_URI_MAX; i++) {
+        if (self->raw_uri[i]) dm_lite_free(self->raw_uri[i]);
+        self->raw_uri[i] = NULL;
+    }
+#endif
+
+    return ret;
+}
+
+#ifdef RAW_DATA_DIRECT_ENABLED
+/* raw data subscribed past CMP, handed over as CMP would but as a view of the read buffer of the MQTT client. */
+static void cmp_impl_raw_arrived(void* pcontext, void* pclient, iotx_mqtt_event_msg_pt msg)
+{
+    cmp_abstract_impl_t* self = pcontext;
+    iotx_mqtt_topic_info_pt topic_info = (iotx_mqtt_topic_info_pt)msg->msg;
+    iotx_cmp_message_info_t iotx_cmp_message_info = {0};
+    iotx_cmp_send_peer_t send_peer;
+    char uri[CMP_TOPIC_LEN_MAX];
+    const char* product_key;
+    const char* device_name;
+    const char* end;
+
+    (void)pclient;
+
+    if (IOTX_MQTT_EVENT_PUBLISH_RECVEIVED != msg->event_type || topic_info->topic_len >= sizeof(uri)) return;
+
+    memcpy(uri, topic_info->ptopic, topic_info->topic_len);
+    uri[topic_info->topic_len] = '\0';
+
+    /* the peer is the one of /sys/<product_key>/<device_name>/ the topic starts with. */
+    memset(&send_peer, 0, sizeof(iotx_cmp_send_peer_t));
+    product_key = uri + strlen("/sys/");
+    if (strncmp(uri, "/sys/", strlen("/sys/")) != 0 || NULL == (device_name = strchr(product_key, '/'))
+        || device_name - product_key >= sizeof(send_peer.product_key) || NULL == (end = strchr(++device_name, '/'))
+        || end - device_name >= sizeof(send_peer.device_name)) return;
+    memcpy(send_peer.product_key, product_key, device_name - 1 - product_key);
+    memcpy(send_peer.device_name, device_name, end - device_name);
+
+    iotx_cmp_message_info.message_type = IOTX_CMP_MESSAGE_RAW;
+    iotx_cmp_message_info.URI = uri;
+    iotx_cmp_message_info.URI_type = IOTX_CMP_URI_SYS;
+    /* valid till the callback returns, like the copy CMP frees after it. */
+    iotx_cmp_message_info.parameter = (void*)topic_info->payload;
+    iotx_cmp_message_info.parameter_length = topic_info->payload_len;
+
+    self->raw_register_cb(&send_peer, &iotx_cmp_message_info, self->raw_pcontext);
+}
+
+/* the slot of the copy of uri the MQTT client is given, NULL when they are all taken. */
+static char** cmp_impl_raw_topic(cmp_abstract_impl_t* self, const char* uri)
+{
+    char** topic = NULL;
+    int i;
+
+    for (i = 0; i < CMP_IMPL_RAW_URI_MAX; i++) {
+        if (self->raw_uri[i] && strcmp(self->raw_uri[i], uri) == 0) return &self->raw_uri[i];
+        if (self->raw_uri[i] == NULL && topic == NULL) topic = &self->raw_uri[i];
+    }
+
+    return topic;
 }
 
+static int cmp_impl_regist_raw(cmp_abstract_impl_t* self, char** topic, const char* uri,
+                               iotx_cmp_register_func_fpt register_cb, void* pcontext)
+{
+    iotx_cmp_event_result_t event_result = {0};
+    iotx_cmp_event_msg_t event;
+    int ret;
+
+    if (*topic == NULL) {
+        *topic = dm_lite_calloc(1, strlen(uri) + CMP_IMPL_EXTENTED_ROOM_FOR_STRING_MALLOC);
+        if (*topic == NULL) return FAIL_RETURN;
+        strcpy(*topic, uri);
+    }
+
+    self->raw_register_cb = register_cb;
+    self->raw_pcontext = pcontext;
+
+    ret = IOT_MQTT_Subscribe(mqtt_get_instance(), *topic, IOTX_MQTT_QOS1, cmp_impl_raw_arrived, self);
+    if (ret < 0) return FAIL_RETURN;
+
+    /* its SUBACK goes to the event handler of CMP which does not know the subscribe, it counts as done once sent. */
+    event_result.result = 0;
+    event_result.URI = *topic;
+    event_result.URI_type = IOTX_CMP_URI_UNDEFINE;
+    event.event_id = IOTX_CMP_EVENT_REGISTER_RESULT;
+    event.msg = &event_result;
+    if (self->event_cb) self->event_cb(NULL, &event, self->event_pcontext);
+
+    return SUCCESS_RETURN;
+}
+#endif /* RAW_DATA_DIRECT_ENABLED */
+
 static int cmp_impl_regist(void* _self, char* uri, iotx_cmp_register_func_fpt register_cb, void* pcontext, void* option)
 {
     iotx_cmp_register_param_t register_param;
     int ret;
+#ifdef RAW_DATA_DIRECT_ENABLED
+    char** topic;
+#endif
 
     if(!uri || !register_cb || !pcontext) {
         dm_log_err("invalid param!");
@@ -96,15 +236,25 @@ static int cmp_impl_regist(void* _self, char* uri, iotx_cmp_register_func_fpt re
 
     if (strstr(uri, string_down_raw) || strstr(uri, string_down_raw_reply) || strstr(uri, string_up_raw) || strstr(uri, string_up_raw_reply)) {
         register_param.message_type = IOTX_CMP_MESSAGE_RAW;
+#ifdef RAW_DATA_DIRECT_ENABLED
+        if (mqtt_get_instance() && (topic = cmp_impl_raw_topic(_self, uri)))
+            return cmp_impl_regist_raw(_self, topic, uri, register_cb, pcontext);
+#endif
     } else if (strstr(uri, string__reply)) {
         register_param.message_type = IOTX_CMP_MESSAGE_RESPONSE;
+#ifdef CMP_IMPL_CHANNELS
+        cmp_channel_regist(&((cmp_abstract_impl_t*)_self)->channels, uri, register_cb, pcontext);
+#endif
     } else {
         register_param.message_type = IOTX_CMP_MESSAGE_REQUEST;
+#ifdef CMP_IMPL_LOCAL_CONTROL
+        cmp_local_regist(&((cmp_abstract_impl_t*)_self)->local, uri, register_cb, pcontext);
+#endif
     }
 
     register_param.register_func = register_cb;
     register_param.user_data = pcontext;
-    ret = IOT_CMP_Register(&register_param, NULL);
+    ret = IOT_CMP_Register(&register_param, option);
 
     dm_log_debug("ret = IOT_CMP_Register() = %d\n", ret);
 
@@ -121,14 +271,18 @@ static int cmp_impl_unregist(void* _self, char* uri, void* option)
     iotx_cmp_unregister_param_t unregister_param;
     int ret = -1;
 
-    (void)option; /* prevent build warning. */
-
     if (!uri || !self->cmp_inited) return -1;
 
     unregister_param.URI_type = IOTX_CMP_URI_UNDEFINE;
     unregister_param.URI = uri;
+#ifdef CMP_IMPL_LOCAL_CONTROL
+    cmp_local_unregist(&self->local, uri);
+#endif
+#ifdef CMP_IMPL_CHANNELS
+    cmp_channel_unregist(&self->channels, uri);
+#endif
 
-    ret = IOT_CMP_Unregister(&unregister_param, NULL);
+    ret = IOT_CMP_Unregister(&unregister_param, option);
 
     dm_log_debug("ret = IOT_CMP_Unregister() = %d\n", ret);
 
@@ -147,60 +301,255 @@ void recycle_memory(void* _user_data)
 }
 #endif
 
-static int cmp_impl_send(void* _self, message_info_t** msg, void* option)
+static int cmp_impl_send_to_cmp(message_info_t** message_info, iotx_cmp_message_info_t* iotx_cmp_message_info, void* option)
 {
-    message_info_t** message_info = msg;
-    iotx_cmp_message_info_t iotx_cmp_message_info = {0};
     iotx_cmp_send_peer_t send_peer;
     char* device_name;
     char* product_key;
     int ret;
+
+    product_key = CMP_MESSAGE_INFO_CALL(message_info, get_product_key)(message_info);
+    device_name = CMP_MESSAGE_INFO_CALL(message_info, get_device_name)(message_info);
+
+    memset(&send_peer, 0, sizeof(iotx_cmp_send_peer_t));
+
+    strncpy(send_peer.device_name, device_name, sizeof(send_peer.device_name));
+    strncpy(send_peer.product_key, product_key, sizeof(send_peer.product_key));
+
+    LITE_TRACE(LITE_TRACE_CMP_SEND, iotx_cmp_message_info->id);
+
+    /* the per send option goes down to CMP as it is, to pick what carries the message. */
+    ret = IOT_CMP_Send(&send_peer, iotx_cmp_message_info, option);
+
+    dm_log_debug("ret = IOT_CMP_Send() = %d\n", ret);
+
+    return ret;
+}
+
+#if defined(RAW_DATA_DIRECT_ENABLED) && !defined(MEMORY_NO_COPY)
+/* raw data published from the buffer it is in, CMP would copy it for its message and again for its send. */
+static int cmp_impl_publish_raw(void* mqtt, const iotx_cmp_message_info_t* iotx_cmp_message_info)
+{
+    iotx_mqtt_topic_info_t topic_msg;
+    int ret;
+
+    memset(&topic_msg, 0, sizeof(iotx_mqtt_topic_info_t));
+
+    /* as CMP sends a message that does not ask for an ack. */
+    topic_msg.qos = IOTX_MQTT_QOS0;
+    topic_msg.payload = iotx_cmp_message_info->parameter;
+    topic_msg.payload_len = iotx_cmp_message_info->parameter_length;
+    topic_msg.ptopic = iotx_cmp_message_info->URI;
+    topic_msg.topic_len = strlen(iotx_cmp_message_info->URI);
+
+    LITE_TRACE(LITE_TRACE_CMP_SEND, iotx_cmp_message_info->id);
+
+    ret = IOT_MQTT_Publish(mqtt, iotx_cmp_message_info->URI, &topic_msg);
+
+    dm_log_debug("ret = IOT_MQTT_Publish() = %d\n", ret);
+
+    return ret < 0 ? FAIL_RETURN : SUCCESS_RETURN;
+}
+#endif /* RAW_DATA_DIRECT_ENABLED && !MEMORY_NO_COPY */
+
+static int cmp_impl_send(void* _self, message_info_t** msg, void* option)
+{
+    message_info_t** message_info = msg;
+    iotx_cmp_message_info_t iotx_cmp_message_info = {0};
+    int ret;
     int message_type;
-    (void)option; /* prevent build warning. */
+#if defined(PAYLOAD_COMPRESS_ENABLED) && !defined(MEMORY_NO_COPY)
+    unsigned char* compressed = NULL;
+    int compressed_length;
+#endif
+#if defined(RAW_DATA_DIRECT_ENABLED) && !defined(MEMORY_NO_COPY)
+    void* mqtt;
+#endif
+#ifdef DM_BACKPRESSURE_ENABLED
+    cmp_abstract_impl_t* self = _self;
+    uint64_t write_start_ms;
+#endif /* DM_BACKPRESSURE_ENABLED */
 
     if (!msg) return -1;
 
-    iotx_cmp_message_info.id = (*message_info)->get_id(message_info);
-    iotx_cmp_message_info.code = (*message_info)->get_code(message_info);
-    message_type = (*message_info)->get_message_type(message_info);
+    iotx_cmp_message_info.id = CMP_MESSAGE_INFO_CALL(message_info, get_id)(message_info);
+    iotx_cmp_message_info.code = CMP_MESSAGE_INFO_CALL(message_info, get_code)(message_info);
+    message_type = CMP_MESSAGE_INFO_CALL(message_info, get_message_type)(message_info);
     iotx_cmp_message_info.message_type = message_type == CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST ? IOTX_CMP_MESSAGE_REQUEST : (message_type == CMP_MESSAGE_INFO_MESSAGE_TYPE_RESPONSE ? IOTX_CMP_MESSAGE_RESPONSE : IOTX_CMP_MESSAGE_RAW);
-    iotx_cmp_message_info.URI = (*message_info)->get_uri(message_info);
+    iotx_cmp_message_info.URI = CMP_MESSAGE_INFO_CALL(message_info, get_uri)(message_info);
     iotx_cmp_message_info.URI_type = IOTX_CMP_URI_UNDEFINE;
-    iotx_cmp_message_info.method = (*message_info)->get_method(message_info);
+    iotx_cmp_message_info.method = CMP_MESSAGE_INFO_CALL(message_info, get_method)(message_info);
 #ifdef MEMORY_NO_COPY
-    iotx_cmp_message_info.parameter = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? (*message_info)->get_raw_data(message_info) : (*message_info)->get_params_data(message_info, 0);
+    iotx_cmp_message_info.parameter = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? CMP_MESSAGE_INFO_CALL(message_info, get_raw_data)(message_info) : CMP_MESSAGE_INFO_CALL(message_info, get_params_data)(message_info, 0);
 #else
-    iotx_cmp_message_info.parameter = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? (*message_info)->get_raw_data(message_info) : (*message_info)->get_params_data(message_info);
+    iotx_cmp_message_info.parameter = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? CMP_MESSAGE_INFO_CALL(message_info, get_raw_data)(message_info) : CMP_MESSAGE_INFO_CALL(message_info, get_params_data)(message_info);
 #endif
-    iotx_cmp_message_info.parameter_length = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? (*message_info)->get_raw_data_length(message_info) : strlen(iotx_cmp_message_info.parameter);
+    /* the length comes from the serializer, params are not measured again. */
+    iotx_cmp_message_info.parameter_length = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? CMP_MESSAGE_INFO_CALL(message_info, get_raw_data_length)(message_info) : CMP_MESSAGE_INFO_CALL(message_info, get_params_data_length)(message_info);
 #ifdef MEMORY_NO_COPY
     iotx_cmp_message_info.recycle_memory_fp = recycle_memory;
-    iotx_cmp_message_info.user_data = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? (*message_info)->get_raw_data(message_info) : (*message_info)->get_params_data(message_info, 1);;
+    iotx_cmp_message_info.user_data = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? CMP_MESSAGE_INFO_CALL(message_info, get_raw_data)(message_info) : CMP_MESSAGE_INFO_CALL(message_info, get_params_data)(message_info, 1);;
+#endif
+#if defined(PAYLOAD_COMPRESS_ENABLED) && !defined(MEMORY_NO_COPY)
+    /* a long raw uplink goes as a frame the data parser of the product decompresses, when it is shorter. */
+    if (iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW && iotx_cmp_message_info.parameter_length >= CONFIG_PAYLOAD_COMPRESS_MIN
+        && iotx_cmp_message_info.parameter_length <= UTILS_LZ_MAX_INPUT
+        && NULL != (compressed = dm_lite_malloc(iotx_cmp_message_info.parameter_length))) {
+        compressed_length = utils_lz_frame_encode(iotx_cmp_message_info.parameter, iotx_cmp_message_info.parameter_length,
+                                                  compressed, iotx_cmp_message_info.parameter_length);
+        if (compressed_length > 0) {
+            dm_log_debug("raw data compressed %d -> %d bytes", (int)iotx_cmp_message_info.parameter_length, compressed_length);
+            iotx_cmp_message_info.parameter = compressed;
+            iotx_cmp_message_info.parameter_length = compressed_length;
+        }
+    }
+#endif
+#ifdef CMP_IMPL_LOCAL_CONTROL
+    /* the answer of a request of the LAN goes back there. */
+    if (cmp_local_answer(&((cmp_abstract_impl_t*)_self)->local, &iotx_cmp_message_info) == 0) {
+        CMP_MESSAGE_INFO_CALL(message_info, clear)(message_info);
+        return SUCCESS_RETURN;
+    }
+#endif
+#ifdef CMP_IMPL_CHANNELS
+    /* an uplink routed to CoAP or HTTP waits in the queue of its channel, which copied it. */
+    ret = cmp_channel_send(&((cmp_abstract_impl_t*)_self)->channels, &iotx_cmp_message_info,
+                           (dm_payload_format_t)CMP_MESSAGE_INFO_CALL(message_info, get_payload_format)(message_info));
+    if (ret <= 0) {
+#ifdef MEMORY_NO_COPY
+        iotx_cmp_message_info.recycle_memory_fp(iotx_cmp_message_info.user_data);
+#endif
+#if defined(PAYLOAD_COMPRESS_ENABLED) && !defined(MEMORY_NO_COPY)
+        if (compressed) dm_lite_free(compressed);
+#endif
+        CMP_MESSAGE_INFO_CALL(message_info, clear)(message_info);
+        return ret == 0 ? SUCCESS_RETURN : FAIL_RETURN;
+    }
+#endif
+#ifdef DM_BACKPRESSURE_ENABLED
+    write_start_ms = HAL_UptimeMs();
+#endif /* DM_BACKPRESSURE_ENABLED */
+#if defined(RAW_DATA_DIRECT_ENABLED) && !defined(MEMORY_NO_COPY)
+    mqtt = iotx_cmp_message_info.message_type == IOTX_CMP_MESSAGE_RAW ? mqtt_get_instance() : NULL;
+    if (mqtt) {
+        ret = cmp_impl_publish_raw(mqtt, &iotx_cmp_message_info);
+    } else {
+        ret = cmp_impl_send_to_cmp(message_info, &iotx_cmp_message_info, option);
+    }
+#else
+    ret = cmp_impl_send_to_cmp(message_info, &iotx_cmp_message_info, option);
 #endif
-    product_key = (*message_info)->get_product_key(message_info);
-    device_name = (*message_info)->get_device_name(message_info);
+#ifdef DM_BACKPRESSURE_ENABLED
+    self->write_end_ms = HAL_UptimeMs();
+    self->write_ms = (uint32_t)(self->write_end_ms - write_start_ms);
+#endif /* DM_BACKPRESSURE_ENABLED */
 
-    memset(&send_peer, 0, sizeof(iotx_cmp_send_peer_t));
+#if defined(PAYLOAD_COMPRESS_ENABLED) && !defined(MEMORY_NO_COPY)
+    if (compressed) dm_lite_free(compressed);
+#endif
+    CMP_MESSAGE_INFO_CALL(message_info, clear)(message_info);
 
-    strncpy(send_peer.device_name, device_name, sizeof(send_peer.device_name));
-    strncpy(send_peer.product_key, product_key, sizeof(send_peer.product_key));
+    return ret;
+}
 
-    ret = IOT_CMP_Send(&send_peer, &iotx_cmp_message_info, NULL);
+#ifndef CMP_SUPPORT_MULTI_THREAD
+#if defined(CMP_IMPL_LOCAL_CONTROL) || defined(CMP_IMPL_CHANNELS)
+/* ms of the slices the yield of CMP is cut into, 0 when nothing is served between them. */
+static int cmp_impl_slice_ms(cmp_abstract_impl_t* self)
+{
+    int slice_ms = 0;
 
-    dm_log_debug("ret = IOT_CMP_Send() = %d\n", ret);
+#ifdef CMP_IMPL_LOCAL_CONTROL
+    if (self->local.socket) slice_ms = CONFIG_LOCAL_CONTROL_POLL_MS;
+#endif
+#ifdef CMP_IMPL_CHANNELS
+    if (self->channels.route_number && (slice_ms == 0 || CONFIG_DM_CHANNEL_POLL_MS < slice_ms)) slice_ms = CONFIG_DM_CHANNEL_POLL_MS;
+#endif
 
-    (*message_info)->clear(message_info);
+    return slice_ms;
+}
 
-    return ret;
+static void cmp_impl_yield_slice(cmp_abstract_impl_t* self)
+{
+#ifdef CMP_IMPL_LOCAL_CONTROL
+    cmp_local_yield(&self->local);
+#endif
+#ifdef CMP_IMPL_CHANNELS
+    cmp_channel_yield(&self->channels);
+#endif
 }
+#endif /* CMP_IMPL_LOCAL_CONTROL || CMP_IMPL_CHANNELS */
 
-#ifndef CMP_SUPPORT_MULTI_THREAD
 static int cmp_impl_yield(void* _self, int timeout_ms)
 {
+#if defined(CMP_IMPL_LOCAL_CONTROL) || defined(CMP_IMPL_CHANNELS)
+    cmp_abstract_impl_t* self = _self;
+    uint64_t end = HAL_UptimeMs() + timeout_ms;
+    int slice_ms = cmp_impl_slice_ms(self);
+    int64_t left;
+    int ret;
+
+    if (slice_ms == 0) return IOT_CMP_Yield(timeout_ms, NULL);
+
+    /* in slices, the LAN and the channels are served between them. */
+    do {
+        cmp_impl_yield_slice(self);
+        left = (int64_t)(end - HAL_UptimeMs());
+        ret = IOT_CMP_Yield(left > slice_ms ? slice_ms : (left > 0 ? (int)left : 0), NULL);
+    } while (ret == SUCCESS_RETURN && (int64_t)(end - HAL_UptimeMs()) > 0);
+    cmp_impl_yield_slice(self);
+
+    return ret;
+#else
     return IOT_CMP_Yield(timeout_ms, NULL);
+#endif
+}
+
+/* the MQTT client CMP connects is what keeps time under its yield, with the channels when they have work. */
+static uint32_t cmp_impl_get_timeout(void* _self)
+{
+    uint32_t timeout = IOT_MQTT_GetTimeout(mqtt_get_instance());
+#ifdef CMP_IMPL_CHANNELS
+    uint32_t channel_timeout = cmp_channel_get_timeout(&((cmp_abstract_impl_t*)_self)->channels);
+
+    if (channel_timeout < timeout) timeout = channel_timeout;
+#endif
+
+    return timeout;
 }
 #endif
 
+#ifdef DM_BACKPRESSURE_ENABLED
+/* budget of the MQTT client CMP sends on, with how long the socket took the last send, none till it connected. */
+static int cmp_impl_get_send_budget(void* _self, cmp_send_budget_t* budget)
+{
+    cmp_abstract_impl_t* self = _self;
+    iotx_mqtt_send_budget_t mqtt_budget;
+    void* mqtt = mqtt_get_instance();
+
+    if (mqtt == NULL || IOT_MQTT_GetSendBudget(mqtt, &mqtt_budget) != 0) return -1;
+
+    budget->connected = mqtt_budget.connected;
+    budget->pub_slots = mqtt_budget.pub_slots;
+    budget->pub_bytes = mqtt_budget.pub_bytes;
+    /* what the socket took that long to take has drained once as long passed again. */
+    budget->write_ms = HAL_UptimeMs() - self->write_end_ms < self->write_ms ? self->write_ms : 0;
+
+    return 0;
+}
+#endif /* DM_BACKPRESSURE_ENABLED */
+
+#ifdef DM_CHANNELS_ENABLED
+static int cmp_impl_set_channel_route(void* _self, const char* prefix, dm_channel_t channel)
+{
+#ifdef CMP_IMPL_CHANNELS
+    return cmp_channel_set_route(&((cmp_abstract_impl_t*)_self)->channels, prefix, channel);
+#else
+    return -1;
+#endif
+}
+#endif /* DM_CHANNELS_ENABLED */
+
 static const cmp_abstract_t _cmp_impl_class = {
     sizeof(cmp_abstract_impl_t),
     string_cmp_abstrct_impl_class_name,
@@ -213,7 +562,14 @@ static const cmp_abstract_t _cmp_impl_class = {
     cmp_impl_send,
 #ifndef CMP_SUPPORT_MULTI_THREAD
     cmp_impl_yield,
+    cmp_impl_get_timeout,
 #endif
+#ifdef DM_BACKPRESSURE_ENABLED
+    cmp_impl_get_send_budget,
+#endif /* DM_BACKPRESSURE_ENABLED */
+#ifdef DM_CHANNELS_ENABLED
+    cmp_impl_set_channel_route,
+#endif /* DM_CHANNELS_ENABLED */
 };
 
 const void* get_cmp_impl_class()
@@ -0,0 +1,630 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "interface/log_abstract.h"
+#include "logger.h"
+#include "dm_import.h"
+#include "iot_export.h"
+
+#ifdef DM_CHANNELS_ENABLED
+#include "cmp_channel.h"
+
+/* sends of one message failed in a row before it is dropped, a channel that is down is not sent to. */
+#define CMP_CHANNEL_SEND_TRIES 3
+
+#define CMP_CHANNEL_QUEUE(channels, channel) (&(channels)->queues[(channel) - dm_channel_coap])
+
+static const char string_channel_request_fmt[] __DM_READ_ONLY__ = "{\"id\":\"%d\",\"version\":\"1.0\",\"params\":%.*s,\"method\":\"%s\"}";
+static const char string_channel_path_fmt[] __DM_READ_ONLY__ = "/topic%s";
+static const char string_channel__reply[] __DM_READ_ONLY__ = "_reply";
+static const char string_channel_reply_data[] __DM_READ_ONLY__ = "{}";
+static const char* const string_channel_names[dm_channel_max] = {"mqtt", "coap", "http"};
+
+#ifdef COAP_COMM_ENABLED
+static const cmp_channel_transport_t coap_transport;
+#endif
+#ifdef HTTP_COMM_ENABLED
+static const cmp_channel_transport_t http_transport;
+#endif
+
+static void channel_lock(cmp_channel_t* channels)
+{
+    if (channels->mutex) HAL_MutexLock(channels->mutex);
+}
+
+static void channel_unlock(cmp_channel_t* channels)
+{
+    if (channels->mutex) HAL_MutexUnlock(channels->mutex);
+}
+
+int cmp_channel_create(cmp_channel_t* channels)
+{
+    int i;
+
+    memset(channels, 0, sizeof(cmp_channel_t));
+    for (i = 0; i < CMP_CHANNEL_QUEUE_NUMBER; i++) channels->queues[i].channel = (dm_channel_t)(dm_channel_coap + i);
+#ifdef COAP_COMM_ENABLED
+    CMP_CHANNEL_QUEUE(channels, dm_channel_coap)->transport = &coap_transport;
+#endif
+#ifdef HTTP_COMM_ENABLED
+    CMP_CHANNEL_QUEUE(channels, dm_channel_http)->transport = &http_transport;
+#endif
+
+    channels->mutex = HAL_MutexCreate();
+
+    return channels->mutex ? 0 : -1;
+}
+
+void cmp_channel_destroy(cmp_channel_t* channels)
+{
+    cmp_channel_reply_t* reply;
+    int i;
+
+    cmp_channel_deinit(channels);
+
+    for (i = 0; i < CMP_CHANNEL_ROUTE_MAX; i++) {
+        if (channels->routes[i].prefix) dm_lite_free(channels->routes[i].prefix);
+        channels->routes[i].prefix = NULL;
+    }
+    channels->route_number = 0;
+
+    while ((reply = channels->reply_list) != NULL) {
+        channels->reply_list = reply->next;
+        dm_lite_free(reply);
+    }
+
+    if (channels->mutex) HAL_MutexDestroy(channels->mutex);
+    channels->mutex = NULL;
+}
+
+int cmp_channel_init(cmp_channel_t* channels, const char* product_key, const char* device_name, const char* device_secret,
+                     const char* device_id)
+{
+    iotx_device_info_t* device_info = &channels->device_info;
+
+    if (strlen(product_key) > PRODUCT_KEY_LEN || strlen(device_name) > DEVICE_NAME_LEN
+        || strlen(device_secret) > DEVICE_SECRET_LEN || strlen(device_id) > DEVICE_ID_LEN) return -1;
+
+    memset(device_info, 0, sizeof(iotx_device_info_t));
+    strcpy(device_info->product_key, product_key);
+    strcpy(device_info->device_name, device_name);
+    strcpy(device_info->device_secret, device_secret);
+    strcpy(device_info->device_id, device_id);
+
+    channels->uri_base_len = dm_snprintf(channels->uri_base, sizeof(channels->uri_base), "/sys/%s/%s/", product_key, device_name);
+    channels->inited = 1;
+
+    return 0;
+}
+
+static void inflight_free(cmp_channel_inflight_t* inflight)
+{
+    if (inflight->uri) dm_lite_free(inflight->uri);
+    memset(inflight, 0, sizeof(cmp_channel_inflight_t));
+}
+
+static void queue_disconnect(cmp_channel_t* channels, cmp_channel_queue_t* queue)
+{
+    if (queue->client == NULL) return;
+
+    queue->transport->disconnect(channels, queue);
+    queue->client = NULL;
+}
+
+void cmp_channel_deinit(cmp_channel_t* channels)
+{
+    cmp_channel_queue_t* queue;
+    cmp_channel_message_t* message;
+    int i;
+
+    channels->inited = 0;
+
+    for (i = 0; i < CMP_CHANNEL_QUEUE_NUMBER; i++) {
+        queue = &channels->queues[i];
+        queue_disconnect(channels, queue);
+        queue->retry_ms = 0;
+        queue->backoff_ms = 0;
+
+        channel_lock(channels);
+        while ((message = queue->head) != NULL) {
+            queue->head = message->next;
+            dm_lite_free(message);
+        }
+        queue->tail = NULL;
+        queue->number = 0;
+        channel_unlock(channels);
+    }
+}
+
+int cmp_channel_set_route(cmp_channel_t* channels, const char* prefix, dm_channel_t channel)
+{
+    cmp_channel_route_t* route = NULL;
+    int i;
+
+    if (prefix == NULL || prefix[0] == '\0' || channel < dm_channel_mqtt || channel >= dm_channel_max) return -1;
+    if (channel != dm_channel_mqtt && CMP_CHANNEL_QUEUE(channels, channel)->transport == NULL) return -1;
+
+    channel_lock(channels);
+    for (i = 0; i < CMP_CHANNEL_ROUTE_MAX; i++) {
+        if (channels->routes[i].prefix && strcmp(channels->routes[i].prefix, prefix) == 0) {
+            route = &channels->routes[i];
+            break;
+        }
+        if (channels->routes[i].prefix == NULL && route == NULL) route = &channels->routes[i];
+    }
+
+    if (route && route->prefix == NULL) {
+        route->prefix_len = strlen(prefix);
+        route->prefix = dm_lite_malloc(route->prefix_len + 1);
+        if (route->prefix) {
+            strcpy(route->prefix, prefix);
+            channels->route_number++;
+        }
+    }
+    if (route && route->prefix) route->channel = channel;
+    channel_unlock(channels);
+
+    return route && route->prefix ? 0 : -1;
+}
+
+int cmp_channel_regist(cmp_channel_t* channels, const char* uri, iotx_cmp_register_func_fpt register_cb, void* pcontext)
+{
+    cmp_channel_reply_t* reply;
+
+    channel_lock(channels);
+    for (reply = channels->reply_list; reply; reply = reply->next) {
+        if (strcmp(reply->uri, uri) == 0) break;
+    }
+
+    if (reply == NULL && NULL != (reply = dm_lite_calloc(1, sizeof(cmp_channel_reply_t) + strlen(uri)))) {
+        strcpy(reply->uri, uri);
+        reply->next = channels->reply_list;
+        channels->reply_list = reply;
+    }
+    if (reply) {
+        reply->register_cb = register_cb;
+        reply->pcontext = pcontext;
+    }
+    channel_unlock(channels);
+
+    return reply ? 0 : -1;
+}
+
+void cmp_channel_unregist(cmp_channel_t* channels, const char* uri)
+{
+    cmp_channel_reply_t** reply;
+    cmp_channel_reply_t* found;
+
+    channel_lock(channels);
+    for (reply = &channels->reply_list; *reply; reply = &(*reply)->next) {
+        if (strcmp((*reply)->uri, uri) == 0) {
+            found = *reply;
+            *reply = found->next;
+            dm_lite_free(found);
+            break;
+        }
+    }
+    channel_unlock(channels);
+}
+
+/* caller holds the lock. the channel of the longest prefix uri of the device starts with, MQTT when none. */
+static dm_channel_t find_channel(cmp_channel_t* channels, const char* uri)
+{
+    const cmp_channel_route_t* best = NULL;
+    const char* method;
+    int i;
+
+    if (strncmp(uri, channels->uri_base, channels->uri_base_len) != 0) return dm_channel_mqtt;
+    method = uri + channels->uri_base_len;
+
+    for (i = 0; i < CMP_CHANNEL_ROUTE_MAX; i++) {
+        const cmp_channel_route_t* route = &channels->routes[i];
+
+        if (route->prefix && strncmp(method, route->prefix, route->prefix_len) == 0
+            && (best == NULL || route->prefix_len > best->prefix_len)) best = route;
+    }
+
+    return best ? best->channel : dm_channel_mqtt;
+}
+
+int cmp_channel_send(cmp_channel_t* channels, const iotx_cmp_message_info_t* iotx_cmp_message_info,
+                     dm_payload_format_t payload_format)
+{
+    cmp_channel_message_t* message;
+    cmp_channel_queue_t* queue;
+    dm_channel_t channel;
+    const char* method;
+    int uri_len, payload_size, ret = 0;
+
+    if (!channels->inited || channels->route_number == 0 || iotx_cmp_message_info->URI == NULL
+        || (iotx_cmp_message_info->message_type != IOTX_CMP_MESSAGE_REQUEST
+            && iotx_cmp_message_info->message_type != IOTX_CMP_MESSAGE_RAW)) return 1;
+
+    channel_lock(channels);
+    channel = find_channel(channels, iotx_cmp_message_info->URI);
+    channel_unlock(channels);
+    if (channel == dm_channel_mqtt) return 1;
+
+    /* a request goes as the alink message CMP would publish, raw data as it is. */
+    method = iotx_cmp_message_info->method ? iotx_cmp_message_info->method : "";
+    uri_len = strlen(iotx_cmp_message_info->URI);
+    payload_size = iotx_cmp_message_info->parameter_length + 1;
+    if (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_REQUEST) payload_size += sizeof(string_channel_request_fmt) + 11 + strlen(method);
+
+    message = dm_lite_malloc(sizeof(cmp_channel_message_t) + uri_len + payload_size);
+    if (message == NULL) return -1;
+
+    message->next = NULL;
+    message->id = iotx_cmp_message_info->id;
+    message->raw = iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_RAW;
+    message->tries = 0;
+    message->payload_format = payload_format;
+    memcpy(message->uri, iotx_cmp_message_info->URI, uri_len + 1);
+    message->payload = message->uri + uri_len + 1;
+    if (message->raw) {
+        memcpy(message->payload, iotx_cmp_message_info->parameter, iotx_cmp_message_info->parameter_length);
+        message->payload_len = iotx_cmp_message_info->parameter_length;
+    } else {
+        message->payload_len = dm_snprintf(message->payload, payload_size, string_channel_request_fmt, message->id,
+                                           (int)iotx_cmp_message_info->parameter_length,
+                                           (const char*)iotx_cmp_message_info->parameter, method);
+    }
+
+    queue = CMP_CHANNEL_QUEUE(channels, channel);
+
+    channel_lock(channels);
+    if (queue->number >= CONFIG_DM_CHANNEL_QUEUE_MAX) {
+        ret = -1;
+    } else {
+        if (queue->tail) queue->tail->next = message;
+        else queue->head = message;
+        queue->tail = message;
+        queue->number++;
+    }
+    channel_unlock(channels);
+
+    if (ret != 0) {
+        dm_log_warning("%s not queued, %d messages wait for %s", message->uri, CONFIG_DM_CHANNEL_QUEUE_MAX, string_channel_names[channel]);
+        dm_lite_free(message);
+    }
+
+    return ret;
+}
+
+/* productKey and deviceName of the device, whose uplinks are all the channels carry. */
+static void get_send_peer(cmp_channel_t* channels, iotx_cmp_send_peer_t* send_peer)
+{
+    memset(send_peer, 0, sizeof(iotx_cmp_send_peer_t));
+    strncpy(send_peer->product_key, channels->device_info.product_key, sizeof(send_peer->product_key) - 1);
+    strncpy(send_peer->device_name, channels->device_info.device_name, sizeof(send_peer->device_name) - 1);
+}
+
+/* a request to uri the cloud took answered to the handler of its reply, which frees the message as one of CMP. */
+static void answer(cmp_channel_t* channels, const char* uri, int id)
+{
+    iotx_cmp_message_info_t iotx_cmp_message_info = {0};
+    iotx_cmp_send_peer_t send_peer;
+    iotx_cmp_register_func_fpt register_cb = NULL;
+    void* pcontext = NULL;
+    cmp_channel_reply_t* reply;
+    int uri_len = strlen(uri);
+
+    channel_lock(channels);
+    for (reply = channels->reply_list; reply; reply = reply->next) {
+        if (strncmp(reply->uri, uri, uri_len) == 0 && strcmp(reply->uri + uri_len, string_channel__reply) == 0) {
+            register_cb = reply->register_cb;
+            pcontext = reply->pcontext;
+            break;
+        }
+    }
+    channel_unlock(channels);
+
+    if (register_cb == NULL) return;
+
+    iotx_cmp_message_info.URI = dm_lite_malloc(uri_len + sizeof(string_channel__reply));
+    iotx_cmp_message_info.parameter = dm_lite_malloc(sizeof(string_channel_reply_data));
+    if (iotx_cmp_message_info.URI == NULL || iotx_cmp_message_info.parameter == NULL) {
+        if (iotx_cmp_message_info.URI) dm_lite_free(iotx_cmp_message_info.URI);
+        if (iotx_cmp_message_info.parameter) dm_lite_free(iotx_cmp_message_info.parameter);
+        return;
+    }
+    memcpy(iotx_cmp_message_info.URI, uri, uri_len);
+    strcpy(iotx_cmp_message_info.URI + uri_len, string_channel__reply);
+    strcpy(iotx_cmp_message_info.parameter, string_channel_reply_data);
+
+    iotx_cmp_message_info.id = id;
+    iotx_cmp_message_info.code = 200;
+    iotx_cmp_message_info.URI_type = IOTX_CMP_URI_SYS;
+    iotx_cmp_message_info.parameter_length = sizeof(string_channel_reply_data) - 1;
+    iotx_cmp_message_info.message_type = IOTX_CMP_MESSAGE_RESPONSE;
+
+    get_send_peer(channels, &send_peer);
+    register_cb(&send_peer, &iotx_cmp_message_info, pcontext);
+}
+
+#ifdef COAP_COMM_ENABLED
+static cmp_channel_inflight_t* find_free_inflight(cmp_channel_t* channels)
+{
+    int i;
+
+    for (i = 0; i < CMP_CHANNEL_INFLIGHT_MAX; i++) {
+        if (!channels->inflight[i].used) return &channels->inflight[i];
+    }
+
+    return NULL;
+}
+
+static void coap_response(void* p_arg, void* p_message)
+{
+    cmp_channel_inflight_t* inflight = p_arg;
+    cmp_channel_t* channels = inflight->channels;
+    iotx_coap_resp_code_t resp_code;
+    char* uri = inflight->uri;
+    int id = inflight->id;
+
+    if (!inflight->used) return;
+
+    inflight->uri = NULL;
+    inflight_free(inflight);
+
+    if (p_message && IOT_CoAP_GetMessageCode(p_message, &resp_code) == IOTX_SUCCESS && resp_code == IOTX_COAP_RESP_CODE_CONTENT) {
+        answer(channels, uri, id);
+    } else {
+        dm_log_warning("request %d to %s not taken over coap", id, uri);
+    }
+
+    dm_lite_free(uri);
+}
+
+static void* coap_connect(cmp_channel_t* channels)
+{
+    iotx_coap_config_t config;
+    iotx_coap_context_t* client;
+
+    memset(&config, 0, sizeof(iotx_coap_config_t));
+    config.p_devinfo = &channels->device_info;
+    /* a tick of the retransmissions lasts this long, one yield of the client waits it at most. */
+    config.wait_time_ms = CONFIG_DM_CHANNEL_POLL_MS;
+
+    client = IOT_CoAP_Init(&config);
+    if (client && IOT_CoAP_DeviceNameAuth(client) != IOTX_SUCCESS) IOT_CoAP_Deinit(&client);
+
+    return client;
+}
+
+static void coap_disconnect(cmp_channel_t* channels, cmp_channel_queue_t* queue)
+{
+    int i;
+
+    /* the responses waited for go with the client, their handler is not called any more. */
+    IOT_CoAP_Deinit((iotx_coap_context_t**)&queue->client);
+    for (i = 0; i < CMP_CHANNEL_INFLIGHT_MAX; i++) inflight_free(&channels->inflight[i]);
+}
+
+/* 1 when the request must wait for one in flight to be answered. */
+static int coap_send(cmp_channel_t* channels, cmp_channel_queue_t* queue, cmp_channel_message_t* message, char* path)
+{
+    cmp_channel_inflight_t* inflight = NULL;
+    iotx_message_t coap_message;
+    char* uri = NULL;
+    int uri_len;
+
+    if (!message->raw) {
+        inflight = find_free_inflight(channels);
+        if (inflight == NULL) return 1;
+
+        uri_len = strlen(message->uri);
+        uri = dm_lite_malloc(uri_len + 1);
+        if (uri == NULL) return -1;
+        memcpy(uri, message->uri, uri_len + 1);
+    }
+
+    memset(&coap_message, 0, sizeof(iotx_message_t));
+    coap_message.p_payload = (unsigned char*)message->payload;
+    coap_message.payload_len = (unsigned short)message->payload_len;
+    coap_message.content_type = message->payload_format == dm_payload_format_cbor ? IOTX_CONTENT_TYPE_CBOR : IOTX_CONTENT_TYPE_JSON;
+    coap_message.msg_type = IOTX_MESSAGE_CON;
+    coap_message.user_data = inflight;
+    coap_message.resp_callback = inflight ? coap_response : NULL;
+
+    if (message->payload_len > 0xFFFF || IOT_CoAP_SendMessage(queue->client, path, &coap_message) != IOTX_SUCCESS) {
+        if (uri) dm_lite_free(uri);
+        return -1;
+    }
+
+    if (inflight) {
+        inflight->channels = channels;
+        inflight->used = 1;
+        inflight->id = message->id;
+        inflight->uri = uri;
+        inflight->expire_ms = HAL_UptimeMs() + CONFIG_DM_CHANNEL_COAP_TIMEOUT;
+    }
+
+    return 0;
+}
+
+/* take the responses arrived, give up the requests past the last retransmission of the client. */
+static void coap_yield(cmp_channel_t* channels)
+{
+    cmp_channel_queue_t* queue = CMP_CHANNEL_QUEUE(channels, dm_channel_coap);
+    uint64_t now;
+    int i;
+
+    if (queue->client == NULL) return;
+
+    for (i = 0; i < CMP_CHANNEL_INFLIGHT_MAX && !channels->inflight[i].used; i++);
+    if (i == CMP_CHANNEL_INFLIGHT_MAX) return;
+
+    IOT_CoAP_Yield(queue->client);
+
+    now = HAL_UptimeMs();
+    for (i = 0; i < CMP_CHANNEL_INFLIGHT_MAX; i++) {
+        if (channels->inflight[i].used && channels->inflight[i].expire_ms <= now) {
+            dm_log_warning("request %d to %s not answered over coap", channels->inflight[i].id, channels->inflight[i].uri);
+            inflight_free(&channels->inflight[i]);
+        }
+    }
+}
+
+static const cmp_channel_transport_t coap_transport = {coap_connect, coap_disconnect, coap_send, 0};
+#endif /* COAP_COMM_ENABLED */
+
+#ifdef HTTP_COMM_ENABLED
+static void* http_connect(cmp_channel_t* channels)
+{
+    iotx_http_param_t param;
+    void* client;
+
+    memset(&param, 0, sizeof(iotx_http_param_t));
+    param.device_info = &channels->device_info;
+    param.keep_alive = 1;
+    param.timeout_ms = CONFIG_DM_CHANNEL_HTTP_TIMEOUT;
+
+    client = IOT_HTTP_Init(&param);
+    if (client && IOT_HTTP_DeviceNameAuth(client) != 0) {
+        IOT_HTTP_DeInit(&client);
+        client = NULL;
+    }
+
+    return client;
+}
+
+static void http_disconnect(cmp_channel_t* channels, cmp_channel_queue_t* queue)
+{
+    IOT_HTTP_Disconnect(queue->client);
+    IOT_HTTP_DeInit(&queue->client);
+}
+
+static int http_send(cmp_channel_t* channels, cmp_channel_queue_t* queue, cmp_channel_message_t* message, char* path)
+{
+    iotx_http_message_param_t param;
+
+    memset(&param, 0, sizeof(iotx_http_message_param_t));
+    param.topic_path = path;
+    param.request_payload = message->payload;
+    param.request_payload_len = message->payload_len;
+    param.response_payload = channels->response;
+    param.response_payload_len = sizeof(channels->response);
+    param.timeout_ms = CONFIG_DM_CHANNEL_HTTP_TIMEOUT;
+
+    /* the server answers once it published the message. */
+    return IOT_HTTP_SendMessage(queue->client, &param) != 0 ? -1 : 0;
+}
+
+static const cmp_channel_transport_t http_transport = {http_connect, http_disconnect, http_send, 1};
+#endif /* HTTP_COMM_ENABLED */
+
+/* 0 when the client of queue is connected, a channel down is connected again after a backoff doubling up to a max. */
+static int queue_connect(cmp_channel_t* channels, cmp_channel_queue_t* queue)
+{
+    uint64_t now = HAL_UptimeMs();
+
+    if (queue->client) return 0;
+    if ((int64_t)(queue->retry_ms - now) > 0) return -1;
+
+    queue->client = queue->transport ? queue->transport->connect(channels) : NULL;
+    if (queue->client) {
+        queue->backoff_ms = 0;
+        return 0;
+    }
+
+    queue->backoff_ms = queue->backoff_ms == 0 ? CONFIG_DM_CHANNEL_RETRY_MIN
+                        : (queue->backoff_ms >= CONFIG_DM_CHANNEL_RETRY_MAX / 2 ? CONFIG_DM_CHANNEL_RETRY_MAX : queue->backoff_ms * 2);
+    queue->retry_ms = HAL_UptimeMs() + queue->backoff_ms;
+    dm_log_warning("%s not connected, again in %u ms", string_channel_names[queue->channel], (unsigned int)queue->backoff_ms);
+
+    return -1;
+}
+
+/* 0 when sent, 1 when it waits, -1 when the send failed. */
+static int queue_send(cmp_channel_t* channels, cmp_channel_queue_t* queue, cmp_channel_message_t* message)
+{
+    char path[CMP_TOPIC_LEN_MAX + sizeof(string_channel_path_fmt)];
+
+    dm_snprintf(path, sizeof(path), string_channel_path_fmt, message->uri);
+
+    return queue->transport->send(channels, queue, message, path);
+}
+
+static void queue_yield(cmp_channel_t* channels, cmp_channel_queue_t* queue)
+{
+    cmp_channel_message_t* message;
+    int i, ret;
+
+    for (i = 0; i < CONFIG_DM_CHANNEL_SEND_PER_YIELD; i++) {
+        /* the send of other threads only adds behind the tail. */
+        channel_lock(channels);
+        message = queue->head;
+        channel_unlock(channels);
+
+        if (message == NULL || queue_connect(channels, queue) != 0) return;
+
+        ret = queue_send(channels, queue, message);
+        if (ret > 0) return;
+        if (ret < 0 && ++message->tries < CMP_CHANNEL_SEND_TRIES) {
+            /* the client is connected again before the next try. */
+            queue_disconnect(channels, queue);
+            queue->retry_ms = 0;
+            return;
+        }
+        if (ret < 0) dm_log_warning("%s dropped, %d sends over %s failed", message->uri, message->tries, string_channel_names[queue->channel]);
+        /* a request sent over a transport answered on send is one the cloud took. */
+        if (ret == 0 && !message->raw && queue->transport->answered_on_send) answer(channels, message->uri, message->id);
+
+        channel_lock(channels);
+        queue->head = message->next;
+        if (queue->head == NULL) queue->tail = NULL;
+        queue->number--;
+        channel_unlock(channels);
+
+        dm_lite_free(message);
+    }
+}
+
+void cmp_channel_yield(cmp_channel_t* channels)
+{
+    int i;
+
+    if (!channels->inited) return;
+
+    /* the channel first of this yield is the last of the next one. */
+    for (i = 0; i < CMP_CHANNEL_QUEUE_NUMBER; i++) {
+        queue_yield(channels, &channels->queues[(channels->next_queue + i) % CMP_CHANNEL_QUEUE_NUMBER]);
+    }
+    channels->next_queue = (channels->next_queue + 1) % CMP_CHANNEL_QUEUE_NUMBER;
+
+#ifdef COAP_COMM_ENABLED
+    coap_yield(channels);
+#endif
+}
+
+uint32_t cmp_channel_get_timeout(cmp_channel_t* channels)
+{
+    uint32_t timeout = 0xFFFFFFFF;
+    uint64_t now = HAL_UptimeMs();
+    const cmp_channel_queue_t* queue;
+    int i;
+
+    if (!channels->inited) return timeout;
+
+    channel_lock(channels);
+    for (i = 0; i < CMP_CHANNEL_QUEUE_NUMBER; i++) {
+        queue = &channels->queues[i];
+        if (queue->head == NULL) continue;
+        if (queue->client || (int64_t)(queue->retry_ms - now) <= 0) {
+            timeout = 0;
+        } else if (queue->retry_ms - now < timeout) {
+            timeout = (uint32_t)(queue->retry_ms - now);
+        }
+    }
+    channel_unlock(channels);
+
+    /* the responses waited for arrive in a yield of the client. */
+    for (i = 0; i < CMP_CHANNEL_INFLIGHT_MAX; i++) {
+        if (channels->inflight[i].used && timeout > CONFIG_DM_CHANNEL_POLL_MS) timeout = CONFIG_DM_CHANNEL_POLL_MS;
+    }
+
+    return timeout;
+}
+
+#endif /* DM_CHANNELS_ENABLED */
@@ -0,0 +1,498 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "interface/log_abstract.h"
+#include "logger.h"
+#include "dm_import.h"
+#include "iot_export.h"
+#include "json_parser.h"
+#include "CoAPMessage.h"
+#include "CoAPSerialize.h"
+#include "CoAPDeserialize.h"
+
+#ifdef LOCAL_CONTROL_ENABLED
+#include "cmp_local.h"
+
+/* datagrams served per yield at most, the cloud is not kept waiting by a flood of the LAN. */
+#define CMP_LOCAL_RECV_PER_YIELD 8
+#define CMP_LOCAL_SIGN_LEN 40
+#define CMP_LOCAL_SYNC_ID_BASE 0x40000000
+
+static const char string_local_property_set[] __DM_READ_ONLY__ = "/thing/service/property/set";
+static const char string_local_property_post_fmt[] __DM_READ_ONLY__ = "/sys/%s/%s/thing/event/property/post";
+static const char string_local_property_post_method[] __DM_READ_ONLY__ = "thing.event.property.post";
+static const char string_local_answer_fmt[] __DM_READ_ONLY__ = "{\"id\":\"%d\",\"code\":%d,\"data\":%.*s}";
+
+static char* local_strndup(const char* s, int len)
+{
+    char* p = dm_lite_malloc(len + 1);
+
+    if (p) {
+        memcpy(p, s, len);
+        p[len] = '\0';
+    }
+
+    return p;
+}
+
+int cmp_local_init(cmp_local_t* local, const char* device_secret)
+{
+    void* socket;
+
+    if (local->socket) return 0;
+
+    if (device_secret == NULL || utils_hmac_setkey(&local->hmac, UTILS_HMAC_SHA1, device_secret, strlen(device_secret)) != 0) {
+        return -1;
+    }
+
+    socket = HAL_UDP_bind(CONFIG_LOCAL_CONTROL_PORT);
+    if ((void*) - 1 == socket) {
+        dm_log_err("local control not bound to port %d", CONFIG_LOCAL_CONTROL_PORT);
+        utils_hmac_free(&local->hmac);
+        return -1;
+    }
+
+    local->socket = socket;
+    local->last_peer_id = 0;
+    local->next_id = -1;
+    local->sync_id = 0;
+    memset(local->pending, 0, sizeof(local->pending));
+    dm_log_info("local control on port %d", CONFIG_LOCAL_CONTROL_PORT);
+
+    return 0;
+}
+
+static void pending_free(cmp_local_pending_t* pending)
+{
+    if (pending->set_uri) dm_lite_free(pending->set_uri);
+    if (pending->set_params) dm_lite_free(pending->set_params);
+    memset(pending, 0, sizeof(cmp_local_pending_t));
+}
+
+void cmp_local_deinit(cmp_local_t* local)
+{
+    cmp_local_uri_t* uri;
+    cmp_local_sync_t* sync;
+    int i;
+
+    if (local->socket) HAL_UDP_close(local->socket);
+    local->socket = NULL;
+    utils_hmac_free(&local->hmac);
+
+    for (i = 0; i < CMP_LOCAL_PENDING_MAX; i++) pending_free(&local->pending[i]);
+
+    while ((uri = local->uri_list) != NULL) {
+        local->uri_list = uri->next;
+        dm_lite_free(uri);
+    }
+
+    while ((sync = local->sync_head) != NULL) {
+        local->sync_head = sync->next;
+        dm_lite_free(sync->uri);
+        dm_lite_free(sync->params);
+        dm_lite_free(sync);
+    }
+    local->sync_number = 0;
+}
+
+int cmp_local_regist(cmp_local_t* local, const char* uri, iotx_cmp_register_func_fpt register_cb, void* pcontext)
+{
+    cmp_local_uri_t* node;
+
+    for (node = local->uri_list; node; node = node->next) {
+        if (strcmp(node->uri, uri) == 0) break;
+    }
+
+    if (node == NULL) {
+        node = dm_lite_calloc(1, sizeof(cmp_local_uri_t) + strlen(uri));
+        if (node == NULL) return -1;
+        strcpy(node->uri, uri);
+        node->next = local->uri_list;
+        local->uri_list = node;
+    }
+    node->register_cb = register_cb;
+    node->pcontext = pcontext;
+
+    return 0;
+}
+
+void cmp_local_unregist(cmp_local_t* local, const char* uri)
+{
+    cmp_local_uri_t** node;
+    cmp_local_uri_t* found;
+
+    for (node = &local->uri_list; *node; node = &(*node)->next) {
+        if (strcmp((*node)->uri, uri) == 0) {
+            found = *node;
+            *node = found->next;
+            dm_lite_free(found);
+            return;
+        }
+    }
+}
+
+/* a response of code to the request message, piggybacked on the ack of a con request. */
+static void send_response(cmp_local_t* local, const hal_udp_peer_t* peer, unsigned char type, unsigned short msgid,
+                          unsigned char* token, unsigned char tokenlen, CoAPMessageCode code, const char* payload, int payload_len)
+{
+    CoAPMessage message;
+    int len;
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, type == COAP_MESSAGE_TYPE_CON ? COAP_MESSAGE_TYPE_ACK : COAP_MESSAGE_TYPE_NON);
+    CoAPMessageId_set(&message, type == COAP_MESSAGE_TYPE_CON ? msgid : local->msgid++);
+    CoAPMessageCode_set(&message, code);
+    CoAPMessageToken_set(&message, token, tokenlen);
+    if (payload) {
+        CoAPUintOption_add(&message, COAP_OPTION_CONTENT_FORMAT, COAP_CT_APP_JSON);
+        CoAPMessagePayload_set(&message, (unsigned char*)payload, payload_len);
+    }
+
+    len = CoAPSerialize_Message(&message, local->sendbuf, sizeof(local->sendbuf));
+    CoAPMessage_destory(&message);
+    if (len <= 0) {
+        dm_log_err("response to %s:%d not serialized", peer->addr, peer->port);
+        return;
+    }
+
+    if (HAL_UDP_sendto(local->socket, peer, local->sendbuf, len) != len) {
+        dm_log_warning("response to %s:%d not sent", peer->addr, peer->port);
+    }
+}
+
+static void send_empty_ack(cmp_local_t* local, const hal_udp_peer_t* peer, unsigned short msgid)
+{
+    CoAPMessage message;
+    int len;
+
+    CoAPMessage_init(&message);
+    CoAPMessageId_set(&message, msgid);
+
+    len = CoAPSerialize_Message(&message, local->sendbuf, sizeof(local->sendbuf));
+    if (len > 0) HAL_UDP_sendto(local->socket, peer, local->sendbuf, len);
+}
+
+/* /sys/pk/dn/... of the uri path options of message into uri, its length, -1 when it does not fit. */
+static int get_uri(CoAPMessage* message, char* uri, int uri_size)
+{
+    CoAPMsgOptionIter iter;
+    CoAPMsgOption option;
+    int len = 0;
+
+    memset(&iter, 0, sizeof(iter));
+    while (CoAPMessageOption_next(message, &iter, &option) == COAP_SUCCESS) {
+        if (option.num != COAP_OPTION_URI_PATH) continue;
+        if (len + 1 + option.len >= uri_size) return -1;
+        uri[len++] = '/';
+        memcpy(uri + len, option.val, option.len);
+        len += option.len;
+    }
+    uri[len] = '\0';
+
+    return len;
+}
+
+/* the token the peer signed the request with, NULL when there is none. */
+static const unsigned char* get_sign(CoAPMessage* message, int* sign_len)
+{
+    CoAPMsgOptionIter iter;
+    CoAPMsgOption option;
+
+    memset(&iter, 0, sizeof(iter));
+    while (CoAPMessageOption_next(message, &iter, &option) == COAP_SUCCESS) {
+        if (option.num == COAP_OPTION_AUTH_TOKEN) {
+            *sign_len = option.len;
+            return option.val;
+        }
+    }
+
+    return NULL;
+}
+
+/* 0 when sign is the hmac of uri and payload, compared in full whatever differs. */
+static int check_sign(cmp_local_t* local, const char* uri, int uri_len, CoAPMessage* message, const unsigned char* sign, int sign_len)
+{
+    char digest[CMP_LOCAL_SIGN_LEN + 1];
+    unsigned char diff = 0;
+    int i;
+
+    if (sign == NULL || sign_len != CMP_LOCAL_SIGN_LEN || uri_len + message->payloadlen > sizeof(local->sendbuf)) return -1;
+
+    /* sendbuf is free till the request is dispatched. */
+    memcpy(local->sendbuf, uri, uri_len);
+    memcpy(local->sendbuf + uri_len, message->payload, message->payloadlen);
+    utils_hmac_sign(&local->hmac, (const char*)local->sendbuf, uri_len + message->payloadlen, digest);
+
+    for (i = 0; i < CMP_LOCAL_SIGN_LEN; i++) diff |= digest[i] ^ sign[i];
+
+    return diff ? -1 : 0;
+}
+
+static cmp_local_uri_t* find_uri(cmp_local_t* local, const char* uri)
+{
+    cmp_local_uri_t* node;
+
+    for (node = local->uri_list; node; node = node->next) {
+        if (strcmp(node->uri, uri) == 0) return node;
+    }
+
+    return NULL;
+}
+
+static cmp_local_pending_t* find_pending(cmp_local_t* local, int id)
+{
+    int i;
+
+    for (i = 0; i < CMP_LOCAL_PENDING_MAX; i++) {
+        if (local->pending[i].id == id) return &local->pending[i];
+    }
+
+    return NULL;
+}
+
+/* productKey and deviceName of /sys/pk/dn/... into send_peer, -1 when uri is not of a device. */
+static int get_send_peer(const char* uri, iotx_cmp_send_peer_t* send_peer)
+{
+    const char* product_key = uri + strlen("/sys/");
+    const char* device_name;
+    const char* end;
+
+    memset(send_peer, 0, sizeof(iotx_cmp_send_peer_t));
+    if (strncmp(uri, "/sys/", strlen("/sys/")) != 0 || NULL == (device_name = strchr(product_key, '/'))
+        || device_name - product_key >= sizeof(send_peer->product_key) || NULL == (end = strchr(++device_name, '/'))
+        || end - device_name >= sizeof(send_peer->device_name)) return -1;
+    memcpy(send_peer->product_key, product_key, device_name - 1 - product_key);
+    memcpy(send_peer->device_name, device_name, end - device_name);
+
+    return 0;
+}
+
+/* one request of the LAN to the handler of its uri, answered at once when it cannot go there. */
+static void serve_request(cmp_local_t* local, const hal_udp_peer_t* peer, unsigned char* buf, int len)
+{
+    CoAPMessage message;
+    iotx_cmp_message_info_t iotx_cmp_message_info = {0};
+    iotx_cmp_send_peer_t send_peer;
+    cmp_local_pending_t* pending;
+    cmp_local_uri_t* node;
+    char uri[CMP_TOPIC_LEN_MAX];
+    const unsigned char* sign;
+    char* id;
+    char* method;
+    char* params;
+    int uri_len, sign_len = 0, id_len, method_len, params_len, type, peer_id;
+    CoAPMessageCode code = COAP_MSG_CODE_400_BAD_REQUEST;
+
+    memset(&message, 0, sizeof(message));
+    if (CoAPDeserialize_Message(&message, buf, len) != COAP_SUCCESS) return;
+
+    /* acks and resets of the separate responses are not waited for. */
+    if (message.header.type != COAP_MESSAGE_TYPE_CON && message.header.type != COAP_MESSAGE_TYPE_NON) return;
+
+    if (message.header.code != COAP_MSG_CODE_POST || (uri_len = get_uri(&message, uri, sizeof(uri))) <= 0
+        || message.payloadlen == 0) {
+        goto answer;
+    }
+
+    sign = get_sign(&message, &sign_len);
+    if (check_sign(local, uri, uri_len, &message, sign, sign_len) != 0) {
+        dm_log_warning("request of %s:%d not signed by the device secret", peer->addr, peer->port);
+        code = COAP_MSG_CODE_401_UNAUTHORIZED;
+        goto answer;
+    }
+
+    id = json_get_value_by_name((char*)message.payload, message.payloadlen, "id", &id_len, &type);
+    method = json_get_value_by_name((char*)message.payload, message.payloadlen, "method", &method_len, &type);
+    params = json_get_value_by_name((char*)message.payload, message.payloadlen, "params", &params_len, &type);
+    if (id == NULL || method == NULL || params == NULL || type != JOBJECT) goto answer;
+
+    peer_id = atoi(id);
+    if (peer_id <= local->last_peer_id) {
+        dm_log_warning("request %d of %s:%d replayed", peer_id, peer->addr, peer->port);
+        code = COAP_MSG_CODE_401_UNAUTHORIZED;
+        goto answer;
+    }
+    local->last_peer_id = peer_id;
+
+    node = find_uri(local, uri);
+    if (node == NULL || get_send_peer(uri, &send_peer) != 0) {
+        code = COAP_MSG_CODE_404_NOT_FOUND;
+        goto answer;
+    }
+
+    pending = find_pending(local, 0);
+    if (pending == NULL) {
+        code = COAP_MSG_CODE_503_SERVICE_UNAVAILABLE;
+        goto answer;
+    }
+
+    /* the handler frees them as the ones of a message of CMP. */
+    iotx_cmp_message_info.URI = local_strndup(uri, uri_len);
+    iotx_cmp_message_info.method = local_strndup(method, method_len);
+    iotx_cmp_message_info.parameter = local_strndup(params, params_len);
+    if (iotx_cmp_message_info.URI == NULL || iotx_cmp_message_info.method == NULL || iotx_cmp_message_info.parameter == NULL) {
+        if (iotx_cmp_message_info.URI) dm_lite_free(iotx_cmp_message_info.URI);
+        if (iotx_cmp_message_info.method) dm_lite_free(iotx_cmp_message_info.method);
+        if (iotx_cmp_message_info.parameter) dm_lite_free(iotx_cmp_message_info.parameter);
+        code = COAP_MSG_CODE_500_INTERNAL_SERVER_ERROR;
+        goto answer;
+    }
+
+    pending->id = local->next_id;
+    local->next_id = local->next_id <= CMP_LOCAL_ID_MIN ? -1 : local->next_id - 1;
+    pending->peer_id = peer_id;
+    pending->peer = *peer;
+    pending->msgid = message.header.msgid;
+    pending->type = message.header.type;
+    pending->tokenlen = message.header.tokenlen;
+    memcpy(pending->token, message.token, message.header.tokenlen);
+    pending->expire_ms = HAL_UptimeMs() + CONFIG_LOCAL_CONTROL_ANSWER_TIMEOUT;
+    if (uri_len > sizeof(string_local_property_set) - 1
+        && strcmp(uri + uri_len - (sizeof(string_local_property_set) - 1), string_local_property_set) == 0) {
+        pending->set_uri = dm_lite_malloc(CMP_TOPIC_LEN_MAX);
+        pending->set_params = local_strndup(params, params_len);
+        if (pending->set_uri) {
+            dm_snprintf(pending->set_uri, CMP_TOPIC_LEN_MAX, string_local_property_post_fmt, send_peer.product_key,
+                        send_peer.device_name);
+        }
+    }
+
+    iotx_cmp_message_info.id = pending->id;
+    iotx_cmp_message_info.URI_type = IOTX_CMP_URI_SYS;
+    iotx_cmp_message_info.parameter_length = params_len;
+    iotx_cmp_message_info.message_type = IOTX_CMP_MESSAGE_REQUEST;
+
+    dm_log_debug("request %d of %s:%d to %s", peer_id, peer->addr, peer->port, uri);
+
+    node->register_cb(&send_peer, &iotx_cmp_message_info, node->pcontext);
+
+    /* a service the user answers later, the con request is acked so the peer stops sending it again. */
+    pending = find_pending(local, iotx_cmp_message_info.id);
+    if (pending && pending->type == COAP_MESSAGE_TYPE_CON) {
+        send_empty_ack(local, peer, pending->msgid);
+        pending->acked = 1;
+    }
+    return;
+
+answer:
+    send_response(local, peer, message.header.type, message.header.msgid, message.token, message.header.tokenlen, code, NULL, 0);
+}
+
+/* the property set posted to the cloud once it is connected, in the order they were done. */
+static void sync_add(cmp_local_t* local, cmp_local_pending_t* pending)
+{
+    cmp_local_sync_t* sync;
+    cmp_local_sync_t** tail;
+
+    if (pending->set_uri == NULL || pending->set_params == NULL) return;
+
+    if (local->sync_number >= CONFIG_LOCAL_CONTROL_SYNC_MAX) {
+        sync = local->sync_head;
+        local->sync_head = sync->next;
+        local->sync_number--;
+        dm_log_warning("property set of %s not posted", sync->params);
+        dm_lite_free(sync->uri);
+        dm_lite_free(sync->params);
+        dm_lite_free(sync);
+    }
+
+    sync = dm_lite_malloc(sizeof(cmp_local_sync_t));
+    if (sync == NULL) return;
+
+    sync->next = NULL;
+    sync->uri = pending->set_uri;
+    sync->params = pending->set_params;
+    pending->set_uri = NULL;
+    pending->set_params = NULL;
+
+    for (tail = &local->sync_head; *tail; tail = &(*tail)->next);
+    *tail = sync;
+    local->sync_number++;
+}
+
+static void sync_post(cmp_local_t* local)
+{
+    iotx_cmp_message_info_t iotx_cmp_message_info = {0};
+    iotx_cmp_send_peer_t send_peer;
+    cmp_local_sync_t* sync;
+
+    while ((sync = local->sync_head) != NULL) {
+        if (get_send_peer(sync->uri, &send_peer) == 0) {
+            iotx_cmp_message_info.id = CMP_LOCAL_SYNC_ID_BASE + local->sync_id;
+            iotx_cmp_message_info.URI = sync->uri;
+            iotx_cmp_message_info.URI_type = IOTX_CMP_URI_SYS;
+            iotx_cmp_message_info.method = (char*)string_local_property_post_method;
+            iotx_cmp_message_info.parameter = sync->params;
+            iotx_cmp_message_info.parameter_length = strlen(sync->params);
+            iotx_cmp_message_info.message_type = IOTX_CMP_MESSAGE_REQUEST;
+
+            /* kept for the next yield while the cloud is away. */
+            if (IOT_CMP_Send(&send_peer, &iotx_cmp_message_info, NULL) != SUCCESS_RETURN) return;
+            local->sync_id = (local->sync_id + 1) & (CMP_LOCAL_SYNC_ID_BASE - 1);
+        }
+
+        local->sync_head = sync->next;
+        local->sync_number--;
+        dm_lite_free(sync->uri);
+        dm_lite_free(sync->params);
+        dm_lite_free(sync);
+    }
+}
+
+void cmp_local_yield(cmp_local_t* local)
+{
+    hal_udp_peer_t peer;
+    uint64_t now;
+    int i, len;
+
+    if (local->socket == NULL) return;
+
+    for (i = 0; i < CMP_LOCAL_RECV_PER_YIELD; i++) {
+        len = HAL_UDP_recvfrom(local->socket, &peer, local->recvbuf, sizeof(local->recvbuf), 0);
+        if (len < 0) break;
+        serve_request(local, &peer, local->recvbuf, len);
+    }
+
+    now = HAL_UptimeMs();
+    for (i = 0; i < CMP_LOCAL_PENDING_MAX; i++) {
+        if (local->pending[i].id && local->pending[i].expire_ms <= now) {
+            dm_log_warning("request %d of %s:%d not answered", local->pending[i].peer_id, local->pending[i].peer.addr,
+                           local->pending[i].peer.port);
+            pending_free(&local->pending[i]);
+        }
+    }
+
+    sync_post(local);
+}
+
+int cmp_local_answer(cmp_local_t* local, const iotx_cmp_message_info_t* iotx_cmp_message_info)
+{
+    cmp_local_pending_t* pending;
+    int len;
+
+    if (iotx_cmp_message_info->message_type != IOTX_CMP_MESSAGE_RESPONSE || iotx_cmp_message_info->id >= 0
+        || iotx_cmp_message_info->id < CMP_LOCAL_ID_MIN) return -1;
+
+    /* one given up goes nowhere, the cloud never asked for it. */
+    pending = find_pending(local, iotx_cmp_message_info->id);
+    if (pending == NULL || local->socket == NULL) return 0;
+
+    len = dm_snprintf((char*)local->recvbuf, sizeof(local->recvbuf), string_local_answer_fmt, pending->peer_id,
+                      (int)iotx_cmp_message_info->code,
+                      iotx_cmp_message_info->parameter ? (int)iotx_cmp_message_info->parameter_length : 2,
+                      iotx_cmp_message_info->parameter ? (const char*)iotx_cmp_message_info->parameter : "{}");
+    if (len < 0 || len >= sizeof(local->recvbuf)) {
+        send_response(local, &pending->peer, pending->acked ? COAP_MESSAGE_TYPE_NON : pending->type, pending->msgid,
+                      pending->token, pending->tokenlen, COAP_MSG_CODE_500_INTERNAL_SERVER_ERROR, NULL, 0);
+    } else {
+        send_response(local, &pending->peer, pending->acked ? COAP_MESSAGE_TYPE_NON : pending->type, pending->msgid,
+                      pending->token, pending->tokenlen, COAP_MSG_CODE_205_CONTENT, (const char*)local->recvbuf, len);
+    }
+
+    if (iotx_cmp_message_info->code == 200) sync_add(local, pending);
+    pending_free(pending);
+
+    return 0;
+}
+
+#endif /* LOCAL_CONTROL_ENABLED */
@@ -8,24 +8,26 @@
 #include "logger.h"
 #include "dm_import.h"
 #include "iot_export_dm.h"
-#include "interface/list_abstract.h"
-#include "single_list.h"
 #include "class_interface.h"
+#include "dm_json_writer.h"
+#include "lite-cbor.h"
+#include "lite-trace.h"
 
 #define CMP_MESSAGE_INFO_EXTENTED_ROOM_FOR_STRING_MALLOC 1
+#define CMP_MESSAGE_INFO_PARAM_NUMBER_INITIAL 4
 
-static const char string_cmp_message_info_class_name[] __DM_READ_ONLY__ = "cmp_msg_info_cls";
-static const char string_cmp_message_info_param_list_object_name[] __DM_READ_ONLY__ = "cmp message info param list";
-
-static void cmp_message_info_clear(void* _self);
-static void cmp_message_info_set_params_data(void* _self, char* params_buf);
+/* the header binds callers to them with DM_MESSAGE_INFO_STATIC, else they are reached through the class only. */
+#ifdef DM_MESSAGE_INFO_STATIC
+#define CMP_MESSAGE_INFO_METHOD
+#else
+#define CMP_MESSAGE_INFO_METHOD static
+#endif
 
-static void list_insert(void* _list, void* _data)
-{
-    list_t** list = (list_t**)_list;
+static const char string_cmp_message_info_class_name[] __DM_READ_ONLY__ = "cmp_msg_info_cls";
 
-    (*list)->insert(list, _data);
-}
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_clear(void* _self);
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_set_params_data(void* _self, char* params_buf);
+static char* params_data_reserve(cmp_message_info_t* self, size_t len);
 
 static void* cmp_message_info_ctor(void* _self, va_list* params)
 {
@@ -34,501 +36,475 @@ static void* cmp_message_info_ctor(void* _self, va_list* params)
     self->uri = NULL;
     self->payload_buf = NULL;
     self->params_data_buf = NULL;
-    self->params_data_buf = NULL;
+    self->params_data_length = 0;
+    self->raw_data_buf = NULL;
     self->raw_data_length = 0;
     self->product_key = NULL;
     self->device_name = NULL;
     self->id = 0;
     self->code = 0;
     self->version = NULL;
-    self->param_list = new_object(SINGLE_LIST_CLASS, string_cmp_message_info_param_list_object_name);
+    self->params = NULL;
+    self->param_number = 0;
+    self->param_capacity = 0;
     self->method = NULL;
     self->message_type = CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST;
+    self->payload_format = dm_payload_format_json;
     self->ret = -1;
     (void)params;
 
     return self;
 }
 
-static int deep_strcpy(char** _dst, const void* _src)
+/*
+ * make buffer *_buf of *_size bytes hold at least len bytes plus NUL, the buffer is only reallocated
+ * when too small, so a message info reused for messages of similar size stops allocating. returns the buffer.
+ */
+static char* storage_reserve(char** _buf, size_t* _size, size_t len)
 {
-    char** dst = _dst;
-    const char* src = _src;
-    int size = strlen(src) + CMP_MESSAGE_INFO_EXTENTED_ROOM_FOR_STRING_MALLOC;
+    size_t size = len + CMP_MESSAGE_INFO_EXTENTED_ROOM_FOR_STRING_MALLOC;
+    char* buf;
 
-    *dst = dm_lite_calloc(1, size);
+    if (*_size < size) {
+        /* at least double, values growing a few bytes per message should not reallocate each time. */
+        if (size < *_size * 2) size = *_size * 2;
 
-    assert(*dst);
-    if (*dst == NULL) return -1;
+        buf = dm_lite_calloc(1, size);
 
-    strcpy(*dst, src);
+        assert(buf);
+        if (buf == NULL) return NULL;
 
-    return 0;
+        if (*_buf) dm_lite_free(*_buf);
+        *_buf = buf;
+        *_size = size;
+    }
+
+    return *_buf;
+}
+
+/* copy src into buffer *_buf of *_size bytes, see storage_reserve. */
+static char* storage_copy(char** _buf, size_t* _size, const void* src, size_t len)
+{
+    if (storage_reserve(_buf, _size, len) == NULL) return NULL;
+
+    memcpy(*_buf, src, len);
+    (*_buf)[len] = 0;
+
+    return *_buf;
+}
+
+static int storage_strcpy(char** _dst, cmp_message_info_storage_t* storage, const char* src)
+{
+    *_dst = storage_copy(&storage->buf, &storage->size, src, strlen(src));
+
+    return *_dst ? 0 : -1;
+}
+
+static void storage_free(cmp_message_info_storage_t* storage)
+{
+    if (storage->buf) dm_lite_free(storage->buf);
+    storage->buf = NULL;
+    storage->size = 0;
 }
 
 static void* cmp_message_info_dtor(void* _self)
 {
     cmp_message_info_t* self = _self;
+    int index;
 
     cmp_message_info_clear(self);
-    delete_object(self->param_list);
+
+    for (index = 0; index < self->param_capacity; ++index) {
+        if (self->params[index].key) dm_lite_free(self->params[index].key);
+        if (self->params[index].value) dm_lite_free(self->params[index].value);
+    }
+    if (self->params) dm_lite_free(self->params);
+    self->params = NULL;
+    self->param_capacity = 0;
+
+    storage_free(&self->uri_storage);
+    storage_free(&self->payload_storage);
+#ifndef MEMORY_NO_COPY
+    storage_free(&self->params_data_storage);
+    storage_free(&self->raw_data_storage);
+#endif
+    storage_free(&self->product_key_storage);
+    storage_free(&self->device_name_storage);
+    storage_free(&self->version_storage);
+    storage_free(&self->method_storage);
 
     return self;
 }
 
-static int cmp_message_info_set_uri(void* _self, char* uri)
+CMP_MESSAGE_INFO_METHOD int cmp_message_info_set_uri(void* _self, char* uri)
 {
     cmp_message_info_t* self = _self;
 
-    if (self->uri) {
-        dm_lite_free(self->uri);
-        self->uri = NULL;
-    }
+    self->uri = NULL;
     assert(uri);
     if (uri) {
-        return deep_strcpy(&self->uri, uri);
+        return storage_strcpy(&self->uri, &self->uri_storage, uri);
     }
 
     return -1;
 }
 
-static void cmp_message_info_set_payload(void* _self, char* payload_buf, unsigned int payload_len)
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_set_payload(void* _self, char* payload_buf, unsigned int payload_len)
 {
     cmp_message_info_t* self = _self;
 
-    if (self->payload_buf) {
-        dm_lite_free(self->payload_buf);
-        self->payload_buf = NULL;
-    }
+    self->payload_buf = NULL;
     assert(payload_buf);
-    if (payload_buf) deep_strcpy(&self->payload_buf, payload_buf);
+    if (payload_buf) storage_strcpy(&self->payload_buf, &self->payload_storage, payload_buf);
 }
 
-static void clear_req_rsp_params(void* _req_rsp_param, va_list* params)
+/* fields are only unset, their storage is kept for the next message. */
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_clear(void* _self)
 {
-    req_rsp_param_t* req_rsp_param = _req_rsp_param;
-    cmp_message_info_t* cmp_message_info;
-
-    cmp_message_info = va_arg(*params, void*);
+    cmp_message_info_t* self = _self;
 
-    assert(cmp_message_info);
+    self->uri = NULL;
+    self->payload_buf = NULL;
+    self->product_key = NULL;
+    self->device_name = NULL;
+    self->params_data_buf = NULL;
+    self->params_data_length = 0;
+    self->raw_data_buf = NULL;
+    self->raw_data_length = 0;
+    self->version = NULL;
+    self->id = 0;
+    self->param_number = 0;
+    self->method = NULL;
+    self->payload_format = dm_payload_format_json;
+}
 
-    if (req_rsp_param) {
-        if (req_rsp_param->key) dm_lite_free(req_rsp_param->key);
-        if (req_rsp_param->value) dm_lite_free(req_rsp_param->value);
 
-        dm_lite_free(req_rsp_param);
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_set_version(void* _self, const char* version)
+{
+    cmp_message_info_t* self = _self;
 
-        req_rsp_param = NULL;
-    }
+    self->version = NULL;
+    assert(version);
+    if (version) storage_strcpy(&self->version, &self->version_storage, version);
 }
 
-static void cmp_message_info_clear(void* _self)
+
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_add_params_data_item(void* _self, const char* key, const char* value)
 {
     cmp_message_info_t* self = _self;
+    req_rsp_param_t* req_rsp_param;
+    req_rsp_param_t* params;
+    int capacity;
 
-    if (self->uri) {
-        dm_lite_free(self->uri);
-        self->uri = NULL;
-    }
+    assert(key && value);
 
-    if (self->payload_buf) {
-        dm_lite_free(self->payload_buf);
-        self->payload_buf = NULL;
-    }
+    if (key == NULL || value == NULL) return;
 
-    if (self->product_key) {
-        dm_lite_free(self->product_key);
-        self->product_key = NULL;
-    }
+    if (self->param_number == self->param_capacity) {
+        capacity = self->param_capacity ? self->param_capacity * 2 : CMP_MESSAGE_INFO_PARAM_NUMBER_INITIAL;
+        params = dm_lite_calloc(capacity, sizeof(req_rsp_param_t));
 
-    if (self->device_name) {
-        dm_lite_free(self->device_name);
-        self->device_name = NULL;
-    }
-#ifdef MEMORY_NO_COPY
-    self->params_data_buf = NULL;
-    self->raw_data_buf = NULL;
-    self->raw_data_length = 0;
-#else
-    if (self->params_data_buf) {
-        dm_lite_free(self->params_data_buf);
-        self->params_data_buf = NULL;
-    }
+        assert(params);
+        if (params == NULL) return;
 
-    if (self->raw_data_buf) {
-        dm_lite_free(self->raw_data_buf);
-        self->raw_data_buf = NULL;
-        self->raw_data_length = 0;
-    }
-#endif
-    if (self->version) {
-        dm_lite_free(self->version);
-        self->version = NULL;
+        if (self->params) {
+            memcpy(params, self->params, self->param_capacity * sizeof(req_rsp_param_t));
+            dm_lite_free(self->params);
+        }
+        self->params = params;
+        self->param_capacity = capacity;
     }
 
-    self->id = 0;
+    req_rsp_param = self->params + self->param_number;
 
-    if (self->param_list) {
-        list_t** list = self->param_list;
-        list_iterator(list, clear_req_rsp_params, self);
-        (*list)->clear(list);
-    }
+    if (storage_copy(&req_rsp_param->key, &req_rsp_param->key_size, key, strlen(key)) == NULL ||
+        storage_copy(&req_rsp_param->value, &req_rsp_param->value_size, value, strlen(value)) == NULL) return;
 
-    if (self->method) {
-        dm_lite_free(self->method);
-        self->method = NULL;
-    }
+    self->param_number++;
 }
 
-static void* cmp_message_info_get_uri(void* _self)
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_set_method(void* _self, const char* method)
 {
     cmp_message_info_t* self = _self;
 
-    return self->uri;
+    self->method = NULL;
+    assert(method);
+    if (method) storage_strcpy(&self->method, &self->method_storage, method);
 }
 
-static void* cmp_message_info_get_payload(void* _self)
-{
-    cmp_message_info_t* self = _self;
-
-    return self->payload_buf;
-}
 
-static void cmp_message_info_set_id(void* _self, int id)
+static void serialize_params(const cmp_message_info_t* self, dm_json_writer_t* writer)
 {
-    cmp_message_info_t* self = _self;
-    self->id = id;
-}
+    const req_rsp_param_t* req_rsp_param;
+    int index;
 
-static int cmp_message_info_get_id(void* _self)
-{
-    cmp_message_info_t* self = _self;
-    return self->id;
-}
+    dm_json_writer_object_begin(writer);
 
-static void cmp_message_info_set_version(void* _self, const char* version)
-{
-    cmp_message_info_t* self = _self;
+    for (index = 0; index < self->param_number; ++index) {
+        req_rsp_param = self->params + index;
 
-    assert(version);
+        assert(req_rsp_param->key && req_rsp_param->value);
 
-    if (self->version) {
-        dm_lite_free(self->version);
-        self->version = NULL;
+        dm_json_writer_key(writer, req_rsp_param->key, strlen(req_rsp_param->key));
+        dm_json_writer_raw(writer, req_rsp_param->value, strlen(req_rsp_param->value));
     }
-    assert(version);
-    if (version) deep_strcpy(&self->version, version);
-}
-
-static char* cmp_message_info_get_version(void* _self)
-{
-    cmp_message_info_t* self = _self;
 
-    return self->version;
+    dm_json_writer_object_end(writer);
 }
 
-static void cmp_message_info_add_params_data_item(void* _self, const char* key, const char* value)
+/* measure params first, then write them straight into params data buffer, no intermediate copy. returns the params. */
+static char* serialize_params_to_params_data(cmp_message_info_t* self)
 {
-    cmp_message_info_t* self = _self;
-    list_t** list = self->param_list;
-    req_rsp_param_t* req_rsp_param;
+    dm_json_writer_t writer;
+    size_t len;
+    char* params;
 
-    req_rsp_param = (req_rsp_param_t*)dm_lite_calloc(1, sizeof(req_rsp_param_t));
+    dm_json_writer_init(&writer, NULL, 0);
+    serialize_params(self, &writer);
+    len = dm_json_writer_length(&writer);
 
-    assert(req_rsp_param);
+    if (len + 1 > CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX) {
+        dm_printf("\n[err] param buffer is short,len(%lu) available(%d)\n", (long unsigned int)(len + 1), CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX);
+        return NULL;
+    }
 
-    if (req_rsp_param == NULL) return;
+    params = params_data_reserve(self, len);
 
-    if (key && value) {
-        deep_strcpy(&req_rsp_param->key, key);
-        deep_strcpy(&req_rsp_param->value, value);
-    }
+    if (params == NULL) return NULL;
 
-    list_insert(list, req_rsp_param);
+    dm_json_writer_init(&writer, params, len + 1);
+    serialize_params(self, &writer);
+
+    return params;
 }
 
-static void cmp_message_info_set_method(void* _self, const char* method)
+/* the map cmp would frame as json, params values are json and transcoded. -1 when a value is not json. */
+static int serialize_request_cbor(const cmp_message_info_t* self, lite_cbor_writer_t* writer)
 {
-    cmp_message_info_t* self = _self;
+    const req_rsp_param_t* req_rsp_param;
+    char id[16];
+    int index;
 
-    assert(method);
+    dm_snprintf(id, sizeof(id), "%u", (unsigned int)self->id);
 
-    if (self->method) {
-        dm_lite_free(self->method);
-        self->method = NULL;
+    LITE_cbor_write_map(writer, 4);
+    LITE_cbor_write_text(writer, "id", strlen("id"));
+    LITE_cbor_write_text(writer, id, strlen(id));
+    LITE_cbor_write_text(writer, "version", strlen("version"));
+    LITE_cbor_write_text(writer, self->version, strlen(self->version));
+    LITE_cbor_write_text(writer, "params", strlen("params"));
+    LITE_cbor_write_map(writer, self->param_number);
+
+    for (index = 0; index < self->param_number; ++index) {
+        req_rsp_param = self->params + index;
+
+        assert(req_rsp_param->key && req_rsp_param->value);
+
+        LITE_cbor_write_text(writer, req_rsp_param->key, strlen(req_rsp_param->key));
+        if (LITE_cbor_write_json(writer, req_rsp_param->value, strlen(req_rsp_param->value)) != 0) {
+            dm_printf("\n[err] param %s is not json\n", req_rsp_param->key);
+            return -1;
+        }
     }
-    assert(method);
-    if (method) deep_strcpy(&self->method, method);
-}
 
-static char* cmp_message_info_get_method(void* _self)
-{
-    cmp_message_info_t* self = _self;
+    LITE_cbor_write_text(writer, "method", strlen("method"));
+    LITE_cbor_write_text(writer, self->method, strlen(self->method));
 
-    return self->method;
+    return 0;
 }
 
-static void serialize_params_data(void* _req_rsp_param, va_list* _params)
+/* measure then encode the whole request into raw data, it goes out as a raw message. */
+static int serialize_request_to_raw_data(cmp_message_info_t* self)
 {
-    req_rsp_param_t* req_rsp_param = _req_rsp_param;
-    cmp_message_info_t* cmp_message_info;
-    char* params;
-    int len = 6; /* "key":"value"\0 */
+    lite_cbor_writer_t writer;
+    size_t len;
 
-    cmp_message_info = va_arg(*_params, void*);
-    params = va_arg(*_params, char*);
+    LITE_cbor_writer_init(&writer, NULL, 0);
+    if (serialize_request_cbor(self, &writer) != 0) return -1;
+    len = LITE_cbor_writer_length(&writer);
 
-    if(0 != cmp_message_info->ret) return;
-    assert(req_rsp_param && cmp_message_info && req_rsp_param->key && req_rsp_param->value && params);
-
-    if (strcmp(params, "{}") == 0) {
-        *(params + 1) = 0;
-    }
-    else {
-        *(params + strlen(params) - 1) = ','; /* change from '}' to ',' */
+    if (len > CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX) {
+        dm_printf("\n[err] param buffer is short,len(%lu) available(%d)\n", (long unsigned int)len, CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX);
+        return -1;
     }
 
-    if (req_rsp_param && cmp_message_info && req_rsp_param->key && req_rsp_param->value) {
-        len += strlen(req_rsp_param->key);
-        len += strlen(req_rsp_param->value);
+#ifdef MEMORY_NO_COPY
+    self->raw_data_buf = dm_lite_calloc(1, len);
+#else
+    self->raw_data_buf = storage_reserve(&self->raw_data_storage.buf, &self->raw_data_storage.size, len);
+#endif
+    assert(self->raw_data_buf);
+    if (self->raw_data_buf == NULL) return -1;
 
-        /* check if there is enough room for new key-value. */
-        if (len > (CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX - strlen(params))) {
-            cmp_message_info->ret = -1;
+    LITE_cbor_writer_init(&writer, (unsigned char*)self->raw_data_buf, len);
+    serialize_request_cbor(self, &writer);
 
-            dm_printf("\n[err] param buffer is short,len(%d) available(%lu)\n", len,(long unsigned int)(CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX - strlen(params)));
-            return;
-        }
+    self->raw_data_length = len;
+    self->message_type = CMP_MESSAGE_INFO_MESSAGE_TYPE_RAW;
 
-        dm_sprintf(params + strlen(params), "\"%s\":%s}", req_rsp_param->key, req_rsp_param->value);
-    }
+    return 0;
 }
 
-static int cmp_message_info_serialize_to_payload_request(void* _self)
+CMP_MESSAGE_INFO_METHOD int cmp_message_info_serialize_to_payload_request(void* _self)
 {
     cmp_message_info_t* self = _self;
-    const list_t** list = self->param_list;
-    char params[CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX] = {'{', '}', 0};
-#if 0
-    char request[CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX + 32] = {0};
-#endif
+    char* params;
     int ret = -1;
 
-    assert(self->version && self->method && list && (*list));
-    if (self->version && self->method && list && (*list)) {
-        self->ret = 0;
-        list_iterator(list, serialize_params_data, self, params);
-#if 0
-        dm_snprintf(request, CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX + 32, "{\"id\":%d,\"version\":\"%s\",\"params\":%s,\"method\":\"%s\"}",
-                    self->id, self->version, params, self->method);
-        cmp_message_info_set_payload(self, request, strlen(request));
-#endif
-        if(0 == self->ret) {
-        cmp_message_info_set_params_data(self, params);
+    LITE_TRACE(LITE_TRACE_SERIALIZE, self->id);
 
-        /* for debug only. */
-        dm_printf("\nrequest params:\n%s\n\n", params);
+    assert(self->version && self->method);
+    if (self->version && self->method && self->payload_format == dm_payload_format_cbor) {
+        ret = serialize_request_to_raw_data(self);
+    } else if (self->version && self->method) {
+        params = serialize_params_to_params_data(self);
 
-        ret = 0;
+        if (params) {
+            /* for debug only. */
+            dm_printf("\nrequest params:\n%s\n\n", params);
+
+            ret = 0;
         }
-        self->ret = 0;
     }
 
     return ret;
 }
 
-static int cmp_message_info_serialize_to_payload_response(void* _self)
+CMP_MESSAGE_INFO_METHOD int cmp_message_info_serialize_to_payload_response(void* _self)
 {
     cmp_message_info_t* self = _self;
-    const list_t** list = self->param_list;
-    char data[CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX] = {'{', '}', 0};
-#if 0
-    char response[CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX + 32] = {0};
-#endif
+    char* data;
     int ret = -1;
 
-    assert(list && (*list));
-    if (list && (*list)) {
-        self->ret = 0;
-        list_iterator(list, serialize_params_data, self, data);
-#if 0
-        dm_snprintf(response, CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX + 32, "{\"id\":%d,\"code\":%d,\"data\":%s}",
-                    self->id, self->code, data);
-        cmp_message_info_set_payload(self, response, strlen(response));
-#endif
-        if(0 == self->ret) {
-        cmp_message_info_set_params_data(self, data);
+    LITE_TRACE(LITE_TRACE_SERIALIZE, self->id);
+
+    /* data written in place by reserve_params_data is kept. */
+    data = (self->param_number == 0 && self->params_data_buf) ? self->params_data_buf : serialize_params_to_params_data(self);
 
+    if (data) {
         /* for debug only. */
         dm_printf("\nresponse data:\n%s\n\n", data);
 
         ret = 0;
-        }
-        self->ret = 0;
     }
 
     return ret;
 }
 
-static void cmp_message_info_set_message_type(void* _self, int message_type)
-{
-    cmp_message_info_t* self = _self;
 
-    self->message_type = message_type;
-}
-
-static int cmp_message_info_get_message_type(void* _self)
+/*
+ * get a params data buffer for len bytes plus NUL, returns where params go.
+ * with MEMORY_NO_COPY room for the message prefix is left in front of them, cmp fills it in.
+ */
+static char* params_data_reserve(cmp_message_info_t* self, size_t len)
 {
-    cmp_message_info_t* self = _self;
-
-    return self->message_type;
-}
 #ifdef MEMORY_NO_COPY
-static char* cmp_message_info_get_params_data(void* _self, int start)
-{
-    cmp_message_info_t* self = _self;
-
-    if (start) {
-        return self->params_data_buf;
-    } else {
-        return self->params_data_buf + self->params_data_buf_prefix_len;
-    }
-}
-#else
-static char* cmp_message_info_get_params_data(void* _self)
-{
-    cmp_message_info_t* self = _self;
-
-    return self->params_data_buf;
-}
-#endif
-
-
-/* malloc mem and copy payload. */
-static void cmp_message_info_set_params_data(void* _self, char* params_data_buf)
-{
-    cmp_message_info_t* self = _self;
-#ifdef MEMORY_NO_COPY
-    int param_data_buf_length = 0;
     char temp_buf[128] = {0};
     int prefix_len = 0;
-#endif
-    assert(params_data_buf);
 
+    /* buffer is handed over to cmp and freed by recycle_memory after sent, it can not be reused. */
     if (self->params_data_buf) {
         dm_lite_free(self->params_data_buf);
         self->params_data_buf = NULL;
     }
-#ifdef MEMORY_NO_COPY
-    if (params_data_buf) {
-        if (self->message_type == CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST) {
-            snprintf(temp_buf, sizeof(temp_buf), "{\"id\":%d,\"version\":\"%s\",\"method\":\"%s\",\"params\":",
-                     self->id, self->version, self->method);
-        } else if (self->message_type == CMP_MESSAGE_INFO_MESSAGE_TYPE_RESPONSE) {
-            snprintf(temp_buf, sizeof(temp_buf), "{\"id\":%d,\"code\":%d,\"data\":",
-                     self->id, self->code);
-        } else {
-            return;
-        }
-        param_data_buf_length = strlen(params_data_buf);
-        prefix_len = strlen(temp_buf);
-        self->params_data_buf = dm_lite_calloc(1, param_data_buf_length + prefix_len + 1 + 1);
-        strcpy(self->params_data_buf + prefix_len, params_data_buf);
-        memset(self->params_data_buf, 0, prefix_len);
-        self->params_data_buf_prefix_len = prefix_len;
+    self->params_data_buf_prefix_len = 0;
+
+    if (self->message_type == CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST) {
+        snprintf(temp_buf, sizeof(temp_buf), "{\"id\":%d,\"version\":\"%s\",\"method\":\"%s\",\"params\":",
+                 self->id, self->version, self->method);
+    } else if (self->message_type == CMP_MESSAGE_INFO_MESSAGE_TYPE_RESPONSE) {
+        snprintf(temp_buf, sizeof(temp_buf), "{\"id\":%d,\"code\":%d,\"data\":",
+                 self->id, self->code);
+    } else {
+        return NULL;
     }
+    prefix_len = strlen(temp_buf);
+    self->params_data_buf = dm_lite_calloc(1, len + prefix_len + 1 + 1);
+    assert(self->params_data_buf);
+    if (self->params_data_buf == NULL) return NULL;
+    self->params_data_buf_prefix_len = prefix_len;
+
+    self->params_data_length = len;
+
+    return self->params_data_buf + prefix_len;
 #else
-    if (params_data_buf) deep_strcpy(&self->params_data_buf, params_data_buf);
+    self->params_data_buf = storage_reserve(&self->params_data_storage.buf, &self->params_data_storage.size, len);
+    self->params_data_length = self->params_data_buf ? len : 0;
+
+    return self->params_data_buf;
 #endif
 }
 
 /* malloc mem and copy payload. */
-static int cmp_message_info_set_raw_data_and_length(void* _self, void* raw_data, int raw_data_length)
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_set_params_data(void* _self, char* params_data_buf)
 {
     cmp_message_info_t* self = _self;
+    size_t len;
+    char* params;
 
-    if (self->raw_data_buf) {
-        dm_lite_free(self->params_data_buf);
-        self->raw_data_buf = NULL;
-    }
-
-    self->raw_data_buf = dm_lite_calloc(1, raw_data_length);
-    assert(self->raw_data_buf);
-    if (self->raw_data_buf == NULL) return -1;
-    self->raw_data_length = raw_data_length;
+    assert(params_data_buf);
+    if (params_data_buf == NULL) return;
 
-    memcpy(self->raw_data_buf, raw_data, raw_data_length);
+    len = strlen(params_data_buf);
+    params = params_data_reserve(self, len);
 
-    return 0;
+    if (params) memcpy(params, params_data_buf, len + 1);
 }
 
-
-static void* cmp_message_info_get_raw_data(void* _self)
+CMP_MESSAGE_INFO_METHOD char* cmp_message_info_reserve_params_data(void* _self, int len)
 {
     cmp_message_info_t* self = _self;
 
-    return self->raw_data_buf;
-}
-
-static int cmp_message_info_get_raw_data_length(void* _self)
-{
-    cmp_message_info_t* self = _self;
+    if (len < 0 || len + 1 > CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX) {
+        dm_printf("\n[err] param buffer is short,len(%d) available(%d)\n", len + 1, CMP_MESSAGE_INFO_PARAMS_LENGTH_MAX);
+        return NULL;
+    }
 
-    return self->raw_data_length;
+    return params_data_reserve(self, len);
 }
 
-static char* cmp_message_info_get_product_key(void* _self)
+/* malloc mem and copy payload with MEMORY_NO_COPY, as CMP takes it. referenced till clear otherwise, CMP copies it when sent. */
+CMP_MESSAGE_INFO_METHOD int cmp_message_info_set_raw_data_and_length(void* _self, void* raw_data, int raw_data_length)
 {
     cmp_message_info_t* self = _self;
 
-    return self->product_key;
+#ifdef MEMORY_NO_COPY
+    self->raw_data_buf = dm_lite_calloc(1, raw_data_length);
+    assert(self->raw_data_buf);
+    if (self->raw_data_buf == NULL) return -1;
+    memcpy(self->raw_data_buf, raw_data, raw_data_length);
+#else
+    assert(raw_data);
+    if (raw_data == NULL) return -1;
+    self->raw_data_buf = raw_data;
+#endif
+    self->raw_data_length = raw_data_length;
+
+    return 0;
 }
 
+
 /* malloc mem and copy payload. */
-static void cmp_message_info_set_product_key(void* _self, char* product_key)
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_set_product_key(void* _self, char* product_key)
 {
     cmp_message_info_t* self = _self;
 
-    if (self->product_key) {
-        dm_lite_free(self->product_key);
-        self->product_key = NULL;
-    }
+    self->product_key = NULL;
     assert(product_key);
-    if (product_key) deep_strcpy(&self->product_key, product_key);
+    if (product_key) storage_strcpy(&self->product_key, &self->product_key_storage, product_key);
 }
 
-static char* cmp_message_info_get_device_name(void* _self)
-{
-    cmp_message_info_t* self = _self;
-
-    return self->device_name;
-}
 
 /* malloc mem and copy payload. */
-static void cmp_message_info_set_device_name(void* _self, char* device_name)
+CMP_MESSAGE_INFO_METHOD void cmp_message_info_set_device_name(void* _self, char* device_name)
 {
     cmp_message_info_t* self = _self;
 
-    if (self->device_name) {
-        dm_lite_free(self->device_name);
-        self->device_name = NULL;
-    }
+    self->device_name = NULL;
     assert(device_name);
-    if (device_name) deep_strcpy(&self->device_name, device_name);
-}
-
-static void cmp_message_info_set_code(void* _self, int code)
-{
-    cmp_message_info_t* self = _self;
-    self->code = code;
+    if (device_name) storage_strcpy(&self->device_name, &self->device_name_storage, device_name);
 }
 
-static int cmp_message_info_get_code(void* _self)
-{
-    cmp_message_info_t* self = _self;
-    return self->code;
-}
 
 static const message_info_t _cmp_message_info_class = {
     sizeof(cmp_message_info_t),
@@ -553,6 +529,8 @@ static const message_info_t _cmp_message_info_class = {
     cmp_message_info_get_message_type,
     cmp_message_info_get_params_data,
     cmp_message_info_set_params_data,
+    cmp_message_info_reserve_params_data,
+    cmp_message_info_get_params_data_length,
     cmp_message_info_set_raw_data_and_length,
     cmp_message_info_get_raw_data,
     cmp_message_info_get_raw_data_length,
@@ -562,6 +540,8 @@ static const message_info_t _cmp_message_info_class = {
     cmp_message_info_set_device_name,
     cmp_message_info_set_code,
     cmp_message_info_get_code,
+    cmp_message_info_set_payload_format,
+    cmp_message_info_get_payload_format,
 };
 
 const void* get_cmp_message_info_class()
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dm_arena.h"
+#include "dm_import.h"
+
+#define DM_ARENA_INTERN_CAPACITY 32
+
+#define dm_arena_align(n) (((n) + DM_ARENA_ALIGN_SIZE - 1) & ~((size_t)DM_ARENA_ALIGN_SIZE - 1))
+#define dm_arena_chunk_header_size dm_arena_align(sizeof(dm_arena_chunk_t))
+
+static dm_arena_chunk_t* dm_arena_new_chunk(size_t size)
+{
+    dm_arena_chunk_t* chunk;
+
+    chunk = dm_lite_calloc(1, dm_arena_chunk_header_size + size);
+    if (chunk == NULL) return NULL;
+
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+int dm_arena_init(dm_arena_t* arena, size_t chunk_size)
+{
+    if (arena == NULL) return -1;
+
+    memset(arena, 0, sizeof(dm_arena_t));
+
+    arena->chunk_size = dm_arena_align(chunk_size < DM_ARENA_MIN_CHUNK_SIZE ? DM_ARENA_MIN_CHUNK_SIZE : chunk_size);
+    arena->chunks = dm_arena_new_chunk(arena->chunk_size);
+    if (arena->chunks == NULL) return -1;
+
+    if (dm_id_index_init(&arena->strings, DM_ARENA_INTERN_CAPACITY) != 0) {
+        dm_lite_free(arena->chunks);
+        arena->chunks = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void dm_arena_deinit(dm_arena_t* arena)
+{
+    dm_arena_chunk_t* chunk;
+    dm_arena_chunk_t* next;
+
+    if (arena == NULL) return;
+
+    dm_arena_seal(arena);
+
+    for (chunk = arena->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        dm_lite_free(chunk);
+    }
+    arena->chunks = NULL;
+}
+
+void* dm_arena_calloc(dm_arena_t* arena, size_t nmemb, size_t size)
+{
+    dm_arena_chunk_t* chunk;
+    size_t total;
+    void* p;
+
+    if (arena == NULL || arena->chunks == NULL || nmemb == 0 || size == 0) return NULL;
+    if (nmemb > (size_t)-1 / size) return NULL;
+
+    total = dm_arena_align(nmemb * size);
+    chunk = arena->chunks;
+
+    if (chunk->size - chunk->used < total) {
+        if (total > arena->chunk_size / 2) {
+            /* large block gets a chunk of its own, keep bumping in the current one. */
+            chunk = dm_arena_new_chunk(total);
+            if (chunk == NULL) return NULL;
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        } else {
+            chunk = dm_arena_new_chunk(arena->chunk_size);
+            if (chunk == NULL) return NULL;
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    p = (char*)chunk + dm_arena_chunk_header_size + chunk->used;
+    chunk->used += total;
+
+    return p; /* chunks come from calloc and are never reused, already zeroed. */
+}
+
+char* dm_arena_intern(dm_arena_t* arena, const char* str, size_t len)
+{
+    dm_id_index_entry_t* entry;
+    char* copy;
+
+    if (arena == NULL || str == NULL) return NULL;
+
+    entry = dm_id_index_find(&arena->strings, str, len);
+    if (entry) return entry->item;
+
+    copy = dm_arena_calloc(arena, 1, len + 1);
+    if (copy == NULL) return NULL;
+    memcpy(copy, str, len);
+
+    /* sealed arena or full table, still hand out the copy. */
+    dm_id_index_insert(&arena->strings, copy, len, copy);
+
+    return copy;
+}
+
+void dm_arena_seal(dm_arena_t* arena)
+{
+    if (arena == NULL) return;
+
+    dm_id_index_deinit(&arena->strings);
+}
+
+int dm_arena_is_active(const dm_arena_t* arena)
+{
+    return arena && arena->chunks;
+}
+
+char* dm_arena_chunk_data(const dm_arena_chunk_t* chunk)
+{
+    return (char*)chunk + dm_arena_chunk_header_size;
+}
@@ -0,0 +1,392 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dm_deviceinfo.h"
+#include "dm_import.h"
+#include "logger.h"
+#include "cJSON.h"
+
+#ifdef DEVICEINFO_ENABLED
+
+#define DM_DEVICEINFO_KV_PREFIX "dm.di"
+
+/* keys and values are kept as the json strings sent, quoted and escaped. */
+static char* json_string_literal(const cJSON* item)
+{
+    char* literal;
+#ifdef CJSON_STRING_ZEROCOPY
+    /* the string points into the params, escapes and all. */
+    size_t len = item->valuestring_length;
+
+    literal = dm_lite_malloc(len + 3);
+    if (literal == NULL) return NULL;
+
+    literal[0] = '"';
+    memcpy(literal + 1, item->valuestring, len);
+    literal[len + 1] = '"';
+    literal[len + 2] = '\0';
+#else
+    dm_json_writer_t writer;
+    size_t len;
+
+    dm_json_writer_init(&writer, NULL, 0);
+    dm_json_writer_string(&writer, item->valuestring, strlen(item->valuestring));
+    len = dm_json_writer_length(&writer);
+
+    literal = dm_lite_malloc(len + 1);
+    if (literal == NULL) return NULL;
+
+    dm_json_writer_init(&writer, literal, len + 1);
+    dm_json_writer_string(&writer, item->valuestring, strlen(item->valuestring));
+#endif
+
+    return literal;
+}
+
+static char* string_dup(const char* str, size_t len)
+{
+    char* dup = dm_lite_malloc(len + 1);
+
+    if (dup) {
+        memcpy(dup, str, len);
+        dup[len] = '\0';
+    }
+
+    return dup;
+}
+
+static int string_equal(const char* a, const char* b)
+{
+    if (a == NULL || b == NULL) return a == b;
+
+    return strcmp(a, b) == 0;
+}
+
+static void free_string(char** str)
+{
+    if (*str) dm_lite_free(*str);
+    *str = NULL;
+}
+
+static int item_pending(const dm_deviceinfo_item_t* item, int op)
+{
+    if (!item->asked || item->flight >= 0) return 0;
+    if ((op == DM_DEVICEINFO_UPDATE) != (item->wanted != NULL)) return 0;
+
+    return !item->known || !string_equal(item->wanted, item->acked);
+}
+
+static dm_deviceinfo_item_t* find_item(dm_deviceinfo_t* info, const char* key)
+{
+    int i;
+
+    for (i = 0; i < info->item_number; ++i) {
+        if (strcmp(info->items[i].key, key) == 0) return info->items + i;
+    }
+
+    return NULL;
+}
+
+/* key is the item's once added. */
+static dm_deviceinfo_item_t* add_item(dm_deviceinfo_t* info, char* key)
+{
+    dm_deviceinfo_item_t* items;
+    dm_deviceinfo_item_t* item;
+    int size;
+
+    if (info->item_number == info->item_size) {
+        size = info->item_size ? info->item_size * 2 : 4;
+        items = dm_lite_calloc(size, sizeof(dm_deviceinfo_item_t));
+        if (items == NULL) return NULL;
+
+        if (info->items) {
+            memcpy(items, info->items, info->item_number * sizeof(dm_deviceinfo_item_t));
+            dm_lite_free(info->items);
+        }
+        info->items = items;
+        info->item_size = size;
+    }
+
+    item = info->items + info->item_number++;
+    memset(item, 0, sizeof(dm_deviceinfo_item_t));
+    item->key = key;
+    item->flight = -1;
+
+    return item;
+}
+
+#if CONFIG_DM_DEVICEINFO_KV
+/* key and value acked of each item known, NUL terminated, as many as fit. */
+static void save_acked(const dm_deviceinfo_t* info)
+{
+    const dm_deviceinfo_item_t* item;
+    char* buf;
+    int len = 0;
+    int key_len;
+    int value_len;
+    int i;
+
+    buf = dm_lite_malloc(CONFIG_DM_DEVICEINFO_KV_MAXLEN);
+    if (buf == NULL) return;
+
+    for (i = 0; i < info->item_number; ++i) {
+        item = info->items + i;
+        if (!item->known || item->acked == NULL) continue;
+
+        key_len = strlen(item->key) + 1;
+        value_len = strlen(item->acked) + 1;
+        if (len + key_len + value_len > CONFIG_DM_DEVICEINFO_KV_MAXLEN) continue;
+
+        memcpy(buf + len, item->key, key_len);
+        memcpy(buf + len + key_len, item->acked, value_len);
+        len += key_len + value_len;
+    }
+
+    if (len == 0) {
+        HAL_Kv_Del(info->kv_key);
+    } else if (HAL_Kv_Set(info->kv_key, buf, len, 1) != 0) {
+        dm_log_err("save deviceinfo fail");
+    }
+
+    dm_lite_free(buf);
+}
+
+static void load_acked(dm_deviceinfo_t* info)
+{
+    dm_deviceinfo_item_t* item;
+    char* buf;
+    char* key;
+    char* value;
+    int len = CONFIG_DM_DEVICEINFO_KV_MAXLEN;
+    int offset = 0;
+    char* key_end;
+    char* value_end;
+
+    buf = dm_lite_malloc(CONFIG_DM_DEVICEINFO_KV_MAXLEN);
+    if (buf == NULL) return;
+
+    if (HAL_Kv_Get(info->kv_key, buf, &len) != 0) len = 0;
+
+    while (offset < len) {
+        key_end = memchr(buf + offset, '\0', len - offset);
+        value_end = key_end ? memchr(key_end + 1, '\0', buf + len - key_end - 1) : NULL;
+        if (value_end == NULL) break;
+
+        key = string_dup(buf + offset, key_end - (buf + offset));
+        value = string_dup(key_end + 1, value_end - key_end - 1);
+        item = key && value ? add_item(info, key) : NULL;
+        if (item == NULL) {
+            if (key) dm_lite_free(key);
+            if (value) dm_lite_free(value);
+            break;
+        }
+        item->acked = value;
+        item->known = 1;
+
+        offset = value_end + 1 - buf;
+    }
+
+    dm_lite_free(buf);
+}
+#else
+static void save_acked(const dm_deviceinfo_t* info)
+{
+    (void)info;
+}
+
+static void load_acked(dm_deviceinfo_t* info)
+{
+    (void)info;
+}
+#endif /* CONFIG_DM_DEVICEINFO_KV */
+
+void dm_deviceinfo_init(dm_deviceinfo_t* info, const char* name)
+{
+    uint32_t hash = 2166136261u;
+
+    memset(info, 0, sizeof(dm_deviceinfo_t));
+
+    /* fnv-1a of the name, kv keys are short. */
+    while (*name) hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    dm_snprintf(info->kv_key, sizeof(info->kv_key), "%s.%08x", DM_DEVICEINFO_KV_PREFIX, (unsigned int)hash);
+
+    load_acked(info);
+}
+
+void dm_deviceinfo_deinit(dm_deviceinfo_t* info)
+{
+    dm_deviceinfo_item_t* item;
+    int i;
+
+    for (i = 0; i < info->item_number; ++i) {
+        item = info->items + i;
+        free_string(&item->key);
+        free_string(&item->acked);
+        free_string(&item->wanted);
+        free_string(&item->sent);
+    }
+
+    if (info->items) dm_lite_free(info->items);
+    memset(info, 0, sizeof(dm_deviceinfo_t));
+}
+
+static int check_params(const cJSON* params, int op)
+{
+    const cJSON* element;
+    const cJSON* key;
+    const cJSON* value;
+
+    if (!cJSON_IsArray(params) || cJSON_GetArraySize(params) <= 0) {
+        dm_log_err("input params format error, MUST be json array type");
+        return -1;
+    }
+
+    cJSON_ArrayForEach(element, params) {
+        key = cJSON_IsObject(element) ? cJSON_GetObjectItem(element, "attrKey") : NULL;
+        value = cJSON_IsObject(element) ? cJSON_GetObjectItem(element, "attrValue") : NULL;
+        if (!cJSON_IsString(key) || (op == DM_DEVICEINFO_UPDATE && !cJSON_IsString(value))) {
+            dm_log_err("input params format error, attrKey%s MUST be string", op == DM_DEVICEINFO_UPDATE ? " and attrValue" : "");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int dm_deviceinfo_ask(dm_deviceinfo_t* info, int op, const char* params)
+{
+    cJSON* params_obj;
+    const cJSON* element;
+    dm_deviceinfo_item_t* item;
+    char* key;
+    char* value;
+    int ret = 0;
+
+    params_obj = cJSON_Parse(params);
+
+    if (check_params(params_obj, op) != 0) {
+        if (params_obj) cJSON_Delete(params_obj);
+        return -1;
+    }
+
+    cJSON_ArrayForEach(element, params_obj) {
+        key = json_string_literal(cJSON_GetObjectItem(element, "attrKey"));
+        value = op == DM_DEVICEINFO_UPDATE ? json_string_literal(cJSON_GetObjectItem(element, "attrValue")) : NULL;
+        if (key == NULL || (op == DM_DEVICEINFO_UPDATE && value == NULL)) {
+            if (key) dm_lite_free(key);
+            ret = -1;
+            break;
+        }
+
+        item = find_item(info, key);
+        if (item) {
+            dm_lite_free(key);
+        } else if (NULL == (item = add_item(info, key))) {
+            dm_lite_free(key);
+            if (value) dm_lite_free(value);
+            ret = -1;
+            break;
+        }
+
+        free_string(&item->wanted);
+        item->wanted = value;
+        item->asked = 1;
+    }
+
+    cJSON_Delete(params_obj);
+
+    return ret;
+}
+
+int dm_deviceinfo_pending(const dm_deviceinfo_t* info, int op)
+{
+    int i;
+
+    /* one request of an op in flight at a time, what is asked for meanwhile waits for its reply. */
+    if (info->request_id[op]) return 0;
+
+    for (i = 0; i < info->item_number; ++i) {
+        if (item_pending(info->items + i, op)) return 1;
+    }
+
+    return 0;
+}
+
+void dm_deviceinfo_write(const dm_deviceinfo_t* info, int op, dm_json_writer_t* writer)
+{
+    const dm_deviceinfo_item_t* item;
+    int i;
+
+    dm_json_writer_array_begin(writer);
+    for (i = 0; i < info->item_number; ++i) {
+        item = info->items + i;
+        if (!item_pending(item, op)) continue;
+
+        dm_json_writer_object_begin(writer);
+        dm_json_writer_key(writer, "attrKey", 7);
+        dm_json_writer_raw(writer, item->key, strlen(item->key));
+        if (op == DM_DEVICEINFO_UPDATE) {
+            dm_json_writer_key(writer, "attrValue", 9);
+            dm_json_writer_raw(writer, item->wanted, strlen(item->wanted));
+        }
+        dm_json_writer_object_end(writer);
+    }
+    dm_json_writer_array_end(writer);
+}
+
+void dm_deviceinfo_sent(dm_deviceinfo_t* info, int op, int request_id)
+{
+    dm_deviceinfo_item_t* item;
+    int i;
+
+    for (i = 0; i < info->item_number; ++i) {
+        item = info->items + i;
+        if (!item_pending(item, op)) continue;
+
+        /* one not copied is not taken as acked, it is sent again. */
+        if (item->wanted && NULL == (item->sent = string_dup(item->wanted, strlen(item->wanted)))) continue;
+        item->flight = (signed char)op;
+    }
+
+    info->request_id[op] = request_id;
+}
+
+void dm_deviceinfo_replied(dm_deviceinfo_t* info, int request_id, int ok)
+{
+    dm_deviceinfo_item_t* item;
+    int op;
+    int i;
+
+    if (request_id == 0) return;
+
+    if (info->request_id[DM_DEVICEINFO_UPDATE] == request_id) {
+        op = DM_DEVICEINFO_UPDATE;
+    } else if (info->request_id[DM_DEVICEINFO_DELETE] == request_id) {
+        op = DM_DEVICEINFO_DELETE;
+    } else {
+        return;
+    }
+
+    for (i = 0; i < info->item_number; ++i) {
+        item = info->items + i;
+        if (item->flight != op) continue;
+
+        if (ok) {
+            free_string(&item->acked);
+            item->acked = item->sent;
+            item->sent = NULL;
+            item->known = 1;
+        } else {
+            /* a value refused is not asked again by itself, asking for it again sends it again. */
+            if (string_equal(item->wanted, item->sent)) item->asked = 0;
+            free_string(&item->sent);
+        }
+        item->flight = -1;
+    }
+
+    info->request_id[op] = 0;
+
+    if (ok) save_acked(info);
+}
+
+#endif /* DEVICEINFO_ENABLED */
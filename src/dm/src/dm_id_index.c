@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dm_id_index.h"
+#include "dm_import.h"
+
+#define DM_ID_INDEX_MIN_SLOT_NUMBER 4
+
+static unsigned int dm_id_index_hash(const char* key, size_t key_len)
+{
+    /* FNV-1a */
+    unsigned int hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < key_len; ++i) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+int dm_id_index_init(dm_id_index_t* index, size_t capacity)
+{
+    size_t slot_number = DM_ID_INDEX_MIN_SLOT_NUMBER;
+
+    if (index == NULL) return -1;
+
+    /* keep load factor under 0.5. */
+    while (slot_number < capacity * 2) {
+        slot_number <<= 1;
+    }
+
+    index->slots = dm_lite_calloc(slot_number, sizeof(dm_id_index_entry_t));
+    if (index->slots == NULL) {
+        index->slot_number = 0;
+        index->entry_number = 0;
+        return -1;
+    }
+
+    index->slot_number = slot_number;
+    index->entry_number = 0;
+
+    return 0;
+}
+
+void dm_id_index_deinit(dm_id_index_t* index)
+{
+    dm_id_index_entry_t* entry;
+    size_t i;
+    int child_type;
+
+    if (index == NULL || index->slots == NULL) return;
+
+    for (i = 0; i < index->slot_number; ++i) {
+        entry = index->slots + i;
+        for (child_type = 0; child_type < DM_ID_INDEX_CHILD_NUMBER; ++child_type) {
+            if (entry->child[child_type]) {
+                dm_id_index_deinit(entry->child[child_type]);
+                dm_lite_free(entry->child[child_type]);
+                entry->child[child_type] = NULL;
+            }
+        }
+    }
+
+    dm_lite_free(index->slots);
+    index->slots = NULL;
+    index->slot_number = 0;
+    index->entry_number = 0;
+}
+
+static int dm_id_index_grow(dm_id_index_t* index)
+{
+    dm_id_index_entry_t* old_slots = index->slots;
+    dm_id_index_entry_t* old_entry;
+    dm_id_index_entry_t* new_entry;
+    size_t old_slot_number = index->slot_number;
+    size_t new_slot_number = old_slot_number << 1;
+    size_t i, pos;
+
+    index->slots = dm_lite_calloc(new_slot_number, sizeof(dm_id_index_entry_t));
+    if (index->slots == NULL) {
+        index->slots = old_slots;
+        return -1;
+    }
+    index->slot_number = new_slot_number;
+
+    for (i = 0; i < old_slot_number; ++i) {
+        old_entry = old_slots + i;
+        if (old_entry->key == NULL) continue;
+
+        pos = dm_id_index_hash(old_entry->key, old_entry->key_len) & (new_slot_number - 1);
+        for (new_entry = index->slots + pos; new_entry->key; new_entry = index->slots + pos) {
+            pos = (pos + 1) & (new_slot_number - 1);
+        }
+        memcpy(new_entry, old_entry, sizeof(dm_id_index_entry_t));
+    }
+
+    dm_lite_free(old_slots);
+
+    return 0;
+}
+
+dm_id_index_entry_t* dm_id_index_insert(dm_id_index_t* index, const char* key, size_t key_len, void* item)
+{
+    dm_id_index_entry_t* entry;
+    size_t pos;
+
+    if (index == NULL || index->slots == NULL || key == NULL) return NULL;
+
+    if ((index->entry_number + 1) * 2 > index->slot_number && dm_id_index_grow(index) != 0) return NULL;
+
+    pos = dm_id_index_hash(key, key_len) & (index->slot_number - 1);
+    for (entry = index->slots + pos; entry->key; entry = index->slots + pos) {
+        /* first inserted wins, same as the linear scan it replaces. */
+        if (entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) return entry;
+        pos = (pos + 1) & (index->slot_number - 1);
+    }
+
+    entry->key = key;
+    entry->key_len = key_len;
+    entry->item = item;
+    index->entry_number++;
+
+    return entry;
+}
+
+dm_id_index_entry_t* dm_id_index_find(const dm_id_index_t* index, const char* key, size_t key_len)
+{
+    dm_id_index_entry_t* entry;
+    size_t pos;
+
+    if (index == NULL || index->slots == NULL || key == NULL) return NULL;
+
+    pos = dm_id_index_hash(key, key_len) & (index->slot_number - 1);
+    for (entry = index->slots + pos; entry->key; entry = index->slots + pos) {
+        if (entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) return entry;
+        pos = (pos + 1) & (index->slot_number - 1);
+    }
+
+    return NULL;
+}
+
+int dm_id_index_remove(dm_id_index_t* index, const char* key, size_t key_len)
+{
+    dm_id_index_entry_t* entry;
+    dm_id_index_entry_t* next;
+    size_t hole, pos, home;
+    int child_type;
+
+    entry = dm_id_index_find(index, key, key_len);
+    if (entry == NULL) return -1;
+
+    for (child_type = 0; child_type < DM_ID_INDEX_CHILD_NUMBER; ++child_type) {
+        if (entry->child[child_type]) {
+            dm_id_index_deinit(entry->child[child_type]);
+            dm_lite_free(entry->child[child_type]);
+        }
+    }
+    memset(entry, 0, sizeof(dm_id_index_entry_t));
+    index->entry_number--;
+
+    /* backward shift the following cluster so lookups never stop early. */
+    hole = entry - index->slots;
+    pos = (hole + 1) & (index->slot_number - 1);
+    for (next = index->slots + pos; next->key; next = index->slots + pos) {
+        home = dm_id_index_hash(next->key, next->key_len) & (index->slot_number - 1);
+        if (((pos - home) & (index->slot_number - 1)) >= ((pos - hole) & (index->slot_number - 1))) {
+            memcpy(index->slots + hole, next, sizeof(dm_id_index_entry_t));
+            memset(next, 0, sizeof(dm_id_index_entry_t));
+            hole = pos;
+        }
+        pos = (pos + 1) & (index->slot_number - 1);
+    }
+
+    return 0;
+}
+
+dm_id_index_t* dm_id_index_new_child(dm_id_index_entry_t* entry, int child_type, size_t capacity)
+{
+    dm_id_index_t* child;
+
+    if (entry == NULL || child_type < 0 || child_type >= DM_ID_INDEX_CHILD_NUMBER) return NULL;
+
+    if (entry->child[child_type]) return entry->child[child_type];
+
+    child = dm_lite_calloc(1, sizeof(dm_id_index_t));
+    if (child == NULL) return NULL;
+
+    if (dm_id_index_init(child, capacity) != 0) {
+        dm_lite_free(child);
+        return NULL;
+    }
+    entry->child[child_type] = child;
+
+    return child;
+}
@@ -79,6 +79,16 @@ static void* dm_impl_generate_new_thing(void* _self, const char* tsl, int tsl_le
     return thing;
 }
 
+static int dm_impl_generate_new_things(void* _self, const char* const* tsls, const int* tsl_lens, int number, void** things)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->generate_new_local_things && tsls && tsl_lens && things && number > 0);
+
+    return (*thing_manager)->generate_new_local_things(thing_manager, tsls, tsl_lens, number, things);
+}
+
 static int dm_impl_set_property_value(void* _self, const void* thing_id, const void* identifier, const void* value, const char* value_str)
 {
     dm_impl_t* self = _self;
@@ -246,6 +256,234 @@ static int dm_impl_yield(const void* _self, int timeout_ms)
     return (*thing_manager)->yield(thing_manager, timeout_ms);
 }
 #endif
+static void* dm_impl_resolve_property_handle(void* _self, const void* thing_id, const char* identifier)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->resolve_thing_property_handle && thing_id && identifier);
+
+    return (*thing_manager)->resolve_thing_property_handle(thing_manager, thing_id, identifier);
+}
+
+static void dm_impl_release_property_handle(void* _self, void* handle)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->release_thing_property_handle);
+
+    (*thing_manager)->release_thing_property_handle(thing_manager, handle);
+}
+
+static int dm_impl_set_property_value_by_handle(void* _self, const void* handle, const void* value, const char* value_str)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_thing_property_value_by_handle && handle && (value || value_str));
+
+    return (*thing_manager)->set_thing_property_value_by_handle(thing_manager, handle, value, value_str);
+}
+
+static int dm_impl_get_property_value_by_handle(const void* _self, const void* handle, void* value, char** value_str)
+{
+    const dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->get_thing_property_value_by_handle && handle && (value || value_str));
+
+    return (*thing_manager)->get_thing_property_value_by_handle(thing_manager, handle, value, value_str);
+}
+
+static int dm_impl_copy_property_value(const void* _self, const void* thing_id, const char* identifier, void* value, char* buff, int buff_len)
+{
+    const dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->copy_thing_property_value && thing_id && identifier && (value || buff));
+
+    return (*thing_manager)->copy_thing_property_value(thing_manager, thing_id, identifier, value, buff, buff_len);
+}
+
+static int dm_impl_copy_property_value_by_handle(const void* _self, const void* handle, void* value, char* buff, int buff_len)
+{
+    const dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->copy_thing_property_value_by_handle && handle && (value || buff));
+
+    return (*thing_manager)->copy_thing_property_value_by_handle(thing_manager, handle, value, buff, buff_len);
+}
+
+static int dm_impl_post_changed_property(const void* _self, const void* thing_id)
+{
+    const dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->trigger_changed_property_post && thing_id);
+
+    return (*thing_manager)->trigger_changed_property_post(thing_manager, thing_id);
+}
+
+static int dm_impl_set_property_values(void* _self, const void* thing_id, const dm_property_value_t* values, int number)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_thing_property_values && thing_id && values && number > 0);
+
+    return (*thing_manager)->set_thing_property_values(thing_manager, thing_id, values, number);
+}
+
+static int dm_impl_set_property_array_values(void* _self, const void* thing_id, const void* identifier, int start, const void* values, int number)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_thing_property_array_values && thing_id && identifier && values);
+
+    return (*thing_manager)->set_thing_property_array_values(thing_manager, thing_id, identifier, start, values, number);
+}
+
+static int dm_impl_get_property_array_values(void* _self, const void* thing_id, const void* identifier, int start, void* values, int number)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->get_thing_property_array_values && thing_id && identifier && values);
+
+    return (*thing_manager)->get_thing_property_array_values(thing_manager, thing_id, identifier, start, values, number);
+}
+
+static int dm_impl_register_route(void* _self, const char* method, dm_route_handler_fp_t handler, void* ctx)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->register_route && method && handler);
+
+    return (*thing_manager)->register_route(thing_manager, method, handler, ctx);
+}
+
+static int dm_impl_set_property_post_schedule(void* _self, int min_interval_ms, int max_latency_ms)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_property_post_schedule);
+
+    return (*thing_manager)->set_property_post_schedule(thing_manager, min_interval_ms, max_latency_ms);
+}
+
+#ifdef DM_REPORT_POLICY_ENABLED
+static int dm_impl_set_property_report_policy(void* _self, const void* thing_id, const char* identifier, const dm_report_policy_t* policy)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_property_report_policy && thing_id);
+
+    return (*thing_manager)->set_property_report_policy(thing_manager, thing_id, identifier, policy);
+}
+#endif
+
+#ifdef DM_CHANNELS_ENABLED
+static int dm_impl_set_channel_route(void* _self, const char* prefix, dm_channel_t channel)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_channel_route);
+
+    return (*thing_manager)->set_channel_route(thing_manager, prefix, channel);
+}
+#endif
+
+#ifdef DM_STATIC_THING_ENABLED
+static int dm_impl_bind_static_thing(void* _self, const void* thing_id, const dm_static_thing_model_t* model, void* data)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->bind_static_thing && thing_id);
+
+    return (*thing_manager)->bind_static_thing(thing_manager, thing_id, model, data);
+}
+
+static int dm_impl_set_static_properties_changed(void* _self, const void* thing_id, const unsigned char* ids)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_static_properties_changed && thing_id);
+
+    return (*thing_manager)->set_static_properties_changed(thing_manager, thing_id, ids);
+}
+#endif
+
+static int dm_impl_flush_property_post(void* _self, int force)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->flush_property_post);
+
+    return (*thing_manager)->flush_property_post(thing_manager, force);
+}
+
+static int dm_impl_set_payload_format(void* _self, dm_payload_format_t format)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_payload_format);
+
+    return (*thing_manager)->set_payload_format(thing_manager, format);
+}
+
+static int dm_impl_trigger_event_async(void* _self, const void* thing_id, const void* event_identifier, const char* property_identifier,
+                                       int timeout_ms, dm_reply_handler_fp_t handler, void* ctx)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->trigger_event_async);
+
+    return (*thing_manager)->trigger_event_async(thing_manager, thing_id, event_identifier, property_identifier, timeout_ms, handler, ctx);
+}
+
+static int dm_impl_cancel_request(void* _self, int request_id)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->cancel_request);
+
+    return (*thing_manager)->cancel_request(thing_manager, request_id);
+}
+
+static int dm_impl_set_metrics_post_interval(void* _self, int interval_ms)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->set_metrics_post_interval);
+
+    return (*thing_manager)->set_metrics_post_interval(thing_manager, interval_ms);
+}
+#ifndef CMP_SUPPORT_MULTI_THREAD
+static uint32_t dm_impl_get_timeout(void* _self)
+{
+    dm_impl_t* self = _self;
+    thing_manager_t** thing_manager = self->_thing_manager;
+
+    assert(thing_manager && *thing_manager && (*thing_manager)->get_timeout);
+
+    return (*thing_manager)->get_timeout(thing_manager);
+}
+#endif
+
 void* dm_lite_calloc(size_t nmemb, size_t size)
 {
 #ifdef CMP_SUPPORT_MEMORY_MAGIC
@@ -305,6 +543,37 @@ static dm_t _dm_impl_class = {
     dm_impl_answer_raw_service,
 #ifndef CMP_SUPPORT_MULTI_THREAD
     dm_impl_yield,
+#endif
+    dm_impl_resolve_property_handle,
+    dm_impl_release_property_handle,
+    dm_impl_set_property_value_by_handle,
+    dm_impl_get_property_value_by_handle,
+    dm_impl_copy_property_value,
+    dm_impl_copy_property_value_by_handle,
+    dm_impl_post_changed_property,
+    dm_impl_set_property_values,
+    dm_impl_set_property_array_values,
+    dm_impl_get_property_array_values,
+    dm_impl_register_route,
+    dm_impl_set_property_post_schedule,
+    dm_impl_flush_property_post,
+    dm_impl_generate_new_things,
+    dm_impl_set_payload_format,
+    dm_impl_trigger_event_async,
+    dm_impl_cancel_request,
+    dm_impl_set_metrics_post_interval,
+#ifndef CMP_SUPPORT_MULTI_THREAD
+    dm_impl_get_timeout,
+#endif
+#ifdef DM_REPORT_POLICY_ENABLED
+    dm_impl_set_property_report_policy,
+#endif
+#ifdef DM_CHANNELS_ENABLED
+    dm_impl_set_channel_route,
+#endif
+#ifdef DM_STATIC_THING_ENABLED
+    dm_impl_bind_static_thing,
+    dm_impl_set_static_properties_changed,
 #endif
 };
 
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "dm_json_writer.h"
+#include "dm_import.h"
+#include "lite-number.h"
+#include "lite-json-str.h"
+
+static void json_writer_put(dm_json_writer_t* writer, const char* src, size_t len)
+{
+    size_t room;
+
+    if (writer->buf && writer->size > writer->len + 1) {
+        room = writer->size - writer->len - 1;
+        memcpy(writer->buf + writer->len, src, len < room ? len : room);
+    }
+
+    writer->len += len;
+
+    if (writer->buf && writer->size) {
+        writer->buf[writer->len < writer->size ? writer->len : writer->size - 1] = '\0';
+    }
+}
+
+static void json_writer_put_char(dm_json_writer_t* writer, char c)
+{
+    json_writer_put(writer, &c, 1);
+}
+
+/* comma between members, none right after a key. */
+static void json_writer_begin_value(dm_json_writer_t* writer)
+{
+    unsigned int bit;
+
+    if (writer->after_key) {
+        writer->after_key = 0;
+        return;
+    }
+
+    if (writer->depth == 0 || writer->depth > DM_JSON_WRITER_DEPTH_MAX) return;
+
+    bit = 1u << (writer->depth - 1);
+
+    if (writer->first & bit) {
+        writer->first &= ~bit;
+    } else {
+        json_writer_put_char(writer, ',');
+    }
+}
+
+static void json_writer_begin_container(dm_json_writer_t* writer, char c)
+{
+    json_writer_begin_value(writer);
+    json_writer_put_char(writer, c);
+
+    writer->depth++;
+
+    assert(writer->depth <= DM_JSON_WRITER_DEPTH_MAX);
+
+    if (writer->depth <= DM_JSON_WRITER_DEPTH_MAX) writer->first |= 1u << (writer->depth - 1);
+}
+
+static void json_writer_end_container(dm_json_writer_t* writer, char c)
+{
+    assert(writer->depth > 0);
+
+    if (writer->depth > 0) writer->depth--;
+
+    json_writer_put_char(writer, c);
+}
+
+/* plain runs are copied at once, only '"', '\\' and control characters are escaped. */
+static void json_writer_put_escaped(dm_json_writer_t* writer, const char* str, size_t str_len)
+{
+    char escaped[8];
+    size_t start = 0;
+    size_t i;
+    unsigned char c;
+
+    json_writer_put_char(writer, '"');
+
+    for (;;) {
+        i = start + LITE_json_plain_len(str + start, str_len - start);
+
+        json_writer_put(writer, str + start, i - start);
+        if (i == str_len) break;
+
+        c = (unsigned char)str[i];
+        start = i + 1;
+
+        switch (c) {
+        case '"':  json_writer_put(writer, "\\\"", 2); break;
+        case '\\': json_writer_put(writer, "\\\\", 2); break;
+        case '\b': json_writer_put(writer, "\\b", 2); break;
+        case '\f': json_writer_put(writer, "\\f", 2); break;
+        case '\n': json_writer_put(writer, "\\n", 2); break;
+        case '\r': json_writer_put(writer, "\\r", 2); break;
+        case '\t': json_writer_put(writer, "\\t", 2); break;
+        default:
+            dm_snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            json_writer_put(writer, escaped, 6);
+            break;
+        }
+    }
+
+    json_writer_put_char(writer, '"');
+}
+
+void dm_json_writer_init(dm_json_writer_t* writer, char* buf, size_t size)
+{
+    writer->buf = buf;
+    writer->size = buf ? size : 0;
+    writer->len = 0;
+    writer->depth = 0;
+    writer->after_key = 0;
+    writer->first = 0;
+    utils_base64_stream_init(&writer->base64);
+
+    if (writer->buf && writer->size) writer->buf[0] = '\0';
+}
+
+void dm_json_writer_rebuffer(dm_json_writer_t* writer, char* buf, size_t size)
+{
+    writer->buf = buf;
+    writer->size = buf ? size : 0;
+    writer->len = 0;
+
+    if (writer->buf && writer->size) writer->buf[0] = '\0';
+}
+
+void dm_json_writer_object_begin(dm_json_writer_t* writer)
+{
+    json_writer_begin_container(writer, '{');
+}
+
+void dm_json_writer_object_end(dm_json_writer_t* writer)
+{
+    json_writer_end_container(writer, '}');
+}
+
+void dm_json_writer_array_begin(dm_json_writer_t* writer)
+{
+    json_writer_begin_container(writer, '[');
+}
+
+void dm_json_writer_array_end(dm_json_writer_t* writer)
+{
+    json_writer_end_container(writer, ']');
+}
+
+void dm_json_writer_key(dm_json_writer_t* writer, const char* key, size_t key_len)
+{
+    json_writer_begin_value(writer);
+    json_writer_put_escaped(writer, key, key_len);
+    json_writer_put_char(writer, ':');
+
+    writer->after_key = 1;
+}
+
+void dm_json_writer_key_raw(dm_json_writer_t* writer, const char* key_json, size_t key_json_len)
+{
+    json_writer_begin_value(writer);
+    json_writer_put(writer, key_json, key_json_len);
+
+    writer->after_key = 1;
+}
+
+void dm_json_writer_string(dm_json_writer_t* writer, const char* str, size_t str_len)
+{
+    json_writer_begin_value(writer);
+    json_writer_put_escaped(writer, str, str_len);
+}
+
+void dm_json_writer_raw(dm_json_writer_t* writer, const char* value, size_t value_len)
+{
+    json_writer_begin_value(writer);
+    json_writer_put(writer, value, value_len);
+}
+
+void dm_json_writer_int(dm_json_writer_t* writer, int value)
+{
+    char temp_buf[LITE_NUMBER_LEN_MAX];
+
+    dm_json_writer_raw(writer, temp_buf, LITE_format_llong(temp_buf, value));
+}
+
+void dm_json_writer_double(dm_json_writer_t* writer, double value, int precision)
+{
+    char temp_buf[LITE_NUMBER_LEN_MAX];
+
+    /* huge values come in exponent notation. */
+    dm_json_writer_raw(writer, temp_buf, LITE_format_fixed(temp_buf, value, precision));
+}
+
+void dm_json_writer_base64(dm_json_writer_t* writer, const unsigned char* data, size_t len)
+{
+    dm_json_writer_base64_begin(writer);
+    dm_json_writer_base64_append(writer, data, len);
+    dm_json_writer_base64_end(writer);
+}
+
+void dm_json_writer_base64_begin(dm_json_writer_t* writer)
+{
+    json_writer_begin_value(writer);
+    json_writer_put_char(writer, '"');
+    utils_base64_stream_init(&writer->base64);
+}
+
+/* encoded straight into buf while it has room, through a stack block past it so length still counts. */
+void dm_json_writer_base64_append(dm_json_writer_t* writer, const unsigned char* data, size_t len)
+{
+    unsigned char block[64];
+    size_t room;
+    size_t n;
+
+    while (len > 0) {
+        room = (writer->buf && writer->size > writer->len + 1) ? writer->size - writer->len - 1 : 0;
+
+        if (room >= UTILS_BASE64_ENCODE_UPDATE_LEN(&writer->base64, len)) {
+            writer->len += utils_base64encode_update(&writer->base64, data, (uint32_t)len,
+                                                     (unsigned char*)writer->buf + writer->len);
+            writer->buf[writer->len] = '\0';
+            return;
+        }
+
+        /* a quantum may be left of the chunk before. */
+        n = len < (sizeof(block) / 4 - 1) * 3 ? len : (sizeof(block) / 4 - 1) * 3;
+        json_writer_put(writer, (const char*)block, utils_base64encode_update(&writer->base64, data, (uint32_t)n, block));
+        data += n;
+        len -= n;
+    }
+}
+
+void dm_json_writer_base64_end(dm_json_writer_t* writer)
+{
+    unsigned char block[4];
+
+    json_writer_put(writer, (const char*)block, utils_base64encode_final(&writer->base64, block));
+    json_writer_put_char(writer, '"');
+}
+
+size_t dm_json_writer_length(const dm_json_writer_t* writer)
+{
+    return writer->len;
+}
+
+int dm_json_writer_truncated(const dm_json_writer_t* writer)
+{
+    return writer->len >= writer->size;
+}
@@ -0,0 +1,31 @@
+#include <stdarg.h>
+#include <string.h>
+
+#include "dm_object.h"
+#include "class_interface.h"
+
+void* dm_object_new_at(void* mem, const void* _class, ...)
+{
+    const abstract_class_t* ab_class = _class;
+    void* p = mem;
+
+    memset(mem, 0, ab_class->_size);
+    *(const abstract_class_t**)p = ab_class;
+
+    if (ab_class->ctor) {
+        va_list params;
+
+        va_start(params, _class);
+        p = ab_class->ctor(p, &params);
+        va_end(params);
+    }
+
+    return p;
+}
+
+void dm_object_delete_at(void* object)
+{
+    const abstract_class_t** ab_class = object;
+
+    if (object && *ab_class && (*ab_class)->dtor) (*ab_class)->dtor(object);
+}
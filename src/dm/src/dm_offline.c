@@ -0,0 +1,369 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dm_offline.h"
+#include "dm_import.h"
+#include "logger.h"
+
+#ifdef DM_OFFLINE_ENABLED
+
+#define DM_OFFLINE_META_KEY     "dm.off"
+#define DM_OFFLINE_META_VERSION 1
+#define DM_OFFLINE_META_LEN     15
+#define DM_OFFLINE_KEY_MAXLEN   16
+#define DM_OFFLINE_FLAG_EPOCH   0x01
+#define DM_OFFLINE_RECORD_MAX   30 /* three varints of 10 bytes at most. */
+
+static void put_u16(unsigned char* p, unsigned int v)
+{
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+static unsigned int get_u16(const unsigned char* p)
+{
+    return ((unsigned int)p[0] << 8) | p[1];
+}
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+    put_u16(p, v >> 16);
+    put_u16(p + 2, v & 0xFFFF);
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+    return ((uint32_t)get_u16(p) << 16) | get_u16(p + 2);
+}
+
+static void put_u64(unsigned char* p, uint64_t v)
+{
+    put_u32(p, (uint32_t)(v >> 32));
+    put_u32(p + 4, (uint32_t)v);
+}
+
+static uint64_t get_u64(const unsigned char* p)
+{
+    return ((uint64_t)get_u32(p) << 32) | get_u32(p + 4);
+}
+
+static int put_varint(unsigned char* p, uint64_t v)
+{
+    int n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+
+    return n;
+}
+
+/* bytes taken, 0 when p of len does not hold a whole varint. */
+static int get_varint(const unsigned char* p, int len, uint64_t* v)
+{
+    int n;
+
+    *v = 0;
+    for (n = 0; n < len && n < 10; ++n) {
+        *v |= (uint64_t)(p[n] & 0x7F) << (7 * n);
+        if ((p[n] & 0x80) == 0) return n + 1;
+    }
+
+    return 0;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+#if CONFIG_DM_OFFLINE_KV
+static void block_key(char* key, uint32_t seq)
+{
+    dm_snprintf(key, DM_OFFLINE_KEY_MAXLEN, "%s.%u", DM_OFFLINE_META_KEY, (unsigned int)(seq % CONFIG_DM_OFFLINE_BLOCKS));
+}
+
+static void save_meta(const dm_offline_t* offline)
+{
+    unsigned char meta[DM_OFFLINE_META_LEN];
+
+    meta[0] = DM_OFFLINE_META_VERSION;
+    put_u32(meta + 1, offline->first_seq);
+    put_u32(meta + 5, offline->next_seq);
+    put_u32(meta + 9, offline->boot);
+    put_u16(meta + 13, offline->property_number);
+
+    if (HAL_Kv_Set(DM_OFFLINE_META_KEY, meta, sizeof(meta), 1) != 0) dm_log_err("save offline meta fail");
+}
+
+static int store_block(dm_offline_t* offline, uint32_t seq, const unsigned char* block, int len)
+{
+    char key[DM_OFFLINE_KEY_MAXLEN];
+
+    block_key(key, seq);
+
+    return HAL_Kv_Set(key, block, len, 1);
+}
+
+static int load_block(dm_offline_t* offline, uint32_t seq, unsigned char* block)
+{
+    char key[DM_OFFLINE_KEY_MAXLEN];
+    int len = CONFIG_DM_OFFLINE_BLOCK_SIZE;
+
+    block_key(key, seq);
+
+    return HAL_Kv_Get(key, block, &len) == 0 ? len : -1;
+}
+#else
+static void save_meta(const dm_offline_t* offline)
+{
+    (void)offline;
+}
+
+static int store_block(dm_offline_t* offline, uint32_t seq, const unsigned char* block, int len)
+{
+    memcpy(offline->blocks[seq % CONFIG_DM_OFFLINE_BLOCKS], block, len);
+
+    return 0;
+}
+
+static int load_block(dm_offline_t* offline, uint32_t seq, unsigned char* block)
+{
+    memcpy(block, offline->blocks[seq % CONFIG_DM_OFFLINE_BLOCKS], CONFIG_DM_OFFLINE_BLOCK_SIZE);
+
+    return get_u16(block + 15);
+}
+#endif
+
+int dm_offline_init(dm_offline_t* offline, int property_number)
+{
+#if CONFIG_DM_OFFLINE_KV
+    unsigned char meta[DM_OFFLINE_META_LEN];
+    int len = sizeof(meta);
+#endif
+
+    memset(offline, 0, sizeof(dm_offline_t));
+
+    if (property_number <= 0 || property_number > 0xFFFF) return -1;
+
+    offline->property_number = property_number;
+    offline->write_values = dm_lite_calloc(property_number, sizeof(int64_t));
+    offline->write_seen = dm_lite_calloc(property_number, 1);
+    offline->read_values = dm_lite_calloc(property_number, sizeof(int64_t));
+    if (offline->write_values == NULL || offline->write_seen == NULL || offline->read_values == NULL) {
+        dm_offline_deinit(offline);
+        return -1;
+    }
+
+#if CONFIG_DM_OFFLINE_KV
+    /* blocks of an other thing model are given up. */
+    if (HAL_Kv_Get(DM_OFFLINE_META_KEY, meta, &len) == 0 && len == sizeof(meta) && meta[0] == DM_OFFLINE_META_VERSION &&
+        get_u16(meta + 13) == (unsigned int)property_number && get_u32(meta + 5) - get_u32(meta + 1) <= CONFIG_DM_OFFLINE_BLOCKS) {
+        offline->first_seq = get_u32(meta + 1);
+        offline->next_seq = get_u32(meta + 5);
+        offline->boot = get_u32(meta + 9) + 1;
+    }
+    save_meta(offline);
+#endif
+
+    return 0;
+}
+
+void dm_offline_deinit(dm_offline_t* offline)
+{
+    if (offline->write_values && CONFIG_DM_OFFLINE_KV) dm_offline_seal(offline);
+
+    if (offline->write_values) dm_lite_free(offline->write_values);
+    if (offline->write_seen) dm_lite_free(offline->write_seen);
+    if (offline->read_values) dm_lite_free(offline->read_values);
+    offline->write_values = NULL;
+    offline->write_seen = NULL;
+    offline->read_values = NULL;
+}
+
+void dm_offline_seal(dm_offline_t* offline)
+{
+    if (offline->write_len == 0) return;
+
+    put_u16(offline->write_block + 15, offline->write_len);
+
+    /* the oldest block goes for the new one. */
+    if (offline->next_seq - offline->first_seq >= CONFIG_DM_OFFLINE_BLOCKS) {
+        offline->first_seq++;
+        offline->read_len = 0;
+        offline->dropped++;
+    }
+
+    if (store_block(offline, offline->next_seq, offline->write_block, offline->write_len) == 0) {
+        offline->next_seq++;
+    } else {
+        dm_log_err("store offline block fail");
+        offline->dropped++;
+    }
+    save_meta(offline);
+
+    offline->write_len = 0;
+}
+
+int dm_offline_append(dm_offline_t* offline, const dm_offline_record_t* record)
+{
+    unsigned char buff[DM_OFFLINE_RECORD_MAX];
+    unsigned char flags = record->epoch ? DM_OFFLINE_FLAG_EPOCH : 0;
+    int len;
+
+    if (record->index < 0 || record->index >= offline->property_number) return -1;
+
+    /* a block holds times of one clock going forward. */
+    if (offline->write_len && ((offline->write_block[0] & DM_OFFLINE_FLAG_EPOCH) != flags ||
+                               record->time_ms < offline->write_time_ms)) {
+        dm_offline_seal(offline);
+    }
+
+    if (offline->write_len) {
+        len = put_varint(buff, record->time_ms - offline->write_time_ms);
+        len += put_varint(buff + len, record->index);
+        len += put_varint(buff + len, zigzag(record->value - offline->write_values[record->index]));
+        if (offline->write_len + len <= CONFIG_DM_OFFLINE_BLOCK_SIZE) {
+            memcpy(offline->write_block + offline->write_len, buff, len);
+            offline->write_len += len;
+            offline->write_time_ms = record->time_ms;
+            offline->write_values[record->index] = record->value;
+            offline->write_seen[record->index] = 1;
+            return 0;
+        }
+        dm_offline_seal(offline);
+    }
+
+    offline->write_block[0] = flags;
+    put_u64(offline->write_block + 1, record->time_ms);
+    put_u32(offline->write_block + 9, offline->boot);
+    put_u16(offline->write_block + 13, offline->property_number);
+    memset(offline->write_values, 0, offline->property_number * sizeof(int64_t));
+    memset(offline->write_seen, 0, offline->property_number);
+
+    len = put_varint(buff, 0);
+    len += put_varint(buff + len, record->index);
+    len += put_varint(buff + len, zigzag(record->value));
+
+    memcpy(offline->write_block + DM_OFFLINE_BLOCK_HEADER_LEN, buff, len);
+    offline->write_len = DM_OFFLINE_BLOCK_HEADER_LEN + len;
+    offline->write_time_ms = record->time_ms;
+    offline->write_values[record->index] = record->value;
+    offline->write_seen[record->index] = 1;
+
+    return 0;
+}
+
+int dm_offline_last(const dm_offline_t* offline, int index, int64_t* value)
+{
+    if (offline->write_len == 0 || index < 0 || index >= offline->property_number || !offline->write_seen[index]) return -1;
+
+    *value = offline->write_values[index];
+
+    return 0;
+}
+
+static void start_read_block(dm_offline_t* offline)
+{
+    offline->read_offset = DM_OFFLINE_BLOCK_HEADER_LEN;
+    offline->read_time_ms = get_u64(offline->read_block + 1);
+    memset(offline->read_values, 0, offline->property_number * sizeof(int64_t));
+}
+
+/* next record of the block loaded, -1 at its end. */
+static int read_record(dm_offline_t* offline, dm_offline_record_t* record)
+{
+    const unsigned char* p = offline->read_block + offline->read_offset;
+    int len = offline->read_len - offline->read_offset;
+    uint64_t dt;
+    uint64_t index;
+    uint64_t delta;
+    int n;
+    int m;
+    int k;
+
+    if (len <= 0) return -1;
+
+    n = get_varint(p, len, &dt);
+    m = n ? get_varint(p + n, len - n, &index) : 0;
+    k = m ? get_varint(p + n + m, len - n - m, &delta) : 0;
+    if (k == 0 || index >= (uint64_t)offline->property_number) {
+        /* a broken block is read up to where it breaks. */
+        offline->read_offset = offline->read_len;
+        return -1;
+    }
+
+    offline->read_offset += n + m + k;
+    offline->read_time_ms += dt;
+    offline->read_values[index] += unzigzag(delta);
+
+    record->time_ms = offline->read_time_ms;
+    record->epoch = (offline->read_block[0] & DM_OFFLINE_FLAG_EPOCH) ? 1 : 0;
+    record->index = (int)index;
+    record->value = offline->read_values[index];
+
+    return 0;
+}
+
+int dm_offline_read(dm_offline_t* offline, dm_offline_record_t* record)
+{
+    int len;
+
+    while (offline->read_len == 0) {
+        if (offline->first_seq == offline->next_seq) return -1;
+
+        len = load_block(offline, offline->first_seq, offline->read_block);
+        if (len < DM_OFFLINE_BLOCK_HEADER_LEN || len > CONFIG_DM_OFFLINE_BLOCK_SIZE ||
+            get_u16(offline->read_block + 13) != (unsigned int)offline->property_number ||
+            (!(offline->read_block[0] & DM_OFFLINE_FLAG_EPOCH) && get_u32(offline->read_block + 9) != offline->boot)) {
+            /* uptimes of an other boot tell no time. */
+            offline->first_seq++;
+            offline->dropped++;
+            save_meta(offline);
+            continue;
+        }
+
+        offline->read_len = len;
+        start_read_block(offline);
+        offline->read_committed = offline->read_offset;
+    }
+
+    return read_record(offline, record);
+}
+
+void dm_offline_commit(dm_offline_t* offline)
+{
+    if (offline->read_len == 0) return;
+
+    offline->read_committed = offline->read_offset;
+
+    if (offline->read_offset >= offline->read_len) {
+        offline->first_seq++;
+        offline->read_len = 0;
+        save_meta(offline);
+    }
+}
+
+void dm_offline_rewind(dm_offline_t* offline)
+{
+    dm_offline_record_t record;
+
+    if (offline->read_len == 0) return;
+
+    start_read_block(offline);
+    while (offline->read_offset < offline->read_committed && read_record(offline, &record) == 0);
+}
+
+int dm_offline_pending(const dm_offline_t* offline)
+{
+    return offline->first_seq != offline->next_seq || offline->write_len > 0;
+}
+
+#endif /* DM_OFFLINE_ENABLED */
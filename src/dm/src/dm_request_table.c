@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dm_request_table.h"
+
+#define DM_REQUEST_BUCKET(id) ((unsigned int)(id) & (DM_REQUEST_TABLE_SIZE - 1))
+
+void dm_request_table_init(dm_request_table_t* table, uint64_t now_ms)
+{
+    int i;
+
+    memset(table, 0, sizeof(dm_request_table_t));
+
+    for (i = DM_REQUEST_TABLE_SIZE - 1; i >= 0; --i) {
+        table->requests[i].bucket_next = table->free_list;
+        table->free_list = table->requests + i;
+    }
+
+    table->wheel_tick = now_ms / DM_REQUEST_WHEEL_TICK_MS;
+}
+
+static void wheel_unlink(dm_request_table_t* table, dm_request_t* request)
+{
+    if (request->wheel_prev) {
+        request->wheel_prev->wheel_next = request->wheel_next;
+    } else {
+        table->wheel[request->wheel_slot] = request->wheel_next;
+    }
+
+    if (request->wheel_next) request->wheel_next->wheel_prev = request->wheel_prev;
+}
+
+/* unlink request from both lists, copy it out and give its slot back. */
+static void take_request(dm_request_table_t* table, dm_request_t* request, dm_request_t* out)
+{
+    dm_request_t** link = &table->buckets[DM_REQUEST_BUCKET(request->id)];
+
+    while (*link != request) link = &(*link)->bucket_next;
+    *link = request->bucket_next;
+
+    wheel_unlink(table, request);
+
+    *out = *request;
+    out->bucket_next = out->wheel_prev = out->wheel_next = NULL;
+
+    memset(request, 0, sizeof(dm_request_t));
+    request->bucket_next = table->free_list;
+    table->free_list = request;
+    table->request_number--;
+}
+
+static dm_request_t* find_request(const dm_request_table_t* table, int id)
+{
+    dm_request_t* request;
+
+    for (request = table->buckets[DM_REQUEST_BUCKET(id)]; request; request = request->bucket_next) {
+        if (request->id == id) return request;
+    }
+
+    return NULL;
+}
+
+int dm_request_table_add(dm_request_table_t* table, int id, const void* thing_id, dm_reply_handler_fp_t handler, void* ctx,
+                         uint64_t expire_ms)
+{
+    dm_request_t* request = table->free_list;
+    uint64_t tick = expire_ms / DM_REQUEST_WHEEL_TICK_MS;
+    int bucket = DM_REQUEST_BUCKET(id);
+
+    if (request == NULL || id == 0 || find_request(table, id)) return -1;
+
+    table->free_list = request->bucket_next;
+    table->request_number++;
+
+    request->id = id;
+    request->thing_id = thing_id;
+    request->handler = handler;
+    request->ctx = ctx;
+    request->expire_ms = expire_ms;
+
+    request->bucket_next = table->buckets[bucket];
+    table->buckets[bucket] = request;
+
+    /* a tick passed already is checked again on next expiry. */
+    if (tick < table->wheel_tick) tick = table->wheel_tick;
+    request->wheel_slot = (int)(tick % DM_REQUEST_WHEEL_SIZE);
+    request->wheel_prev = NULL;
+    request->wheel_next = table->wheel[request->wheel_slot];
+    if (request->wheel_next) request->wheel_next->wheel_prev = request;
+    table->wheel[request->wheel_slot] = request;
+
+    return 0;
+}
+
+int dm_request_table_take(dm_request_table_t* table, int id, dm_request_t* request)
+{
+    dm_request_t* found = find_request(table, id);
+
+    if (found == NULL) return -1;
+
+    take_request(table, found, request);
+
+    return 0;
+}
+
+int dm_request_table_take_expired(dm_request_table_t* table, uint64_t now_ms, dm_request_t* request)
+{
+    uint64_t now_tick = now_ms / DM_REQUEST_WHEEL_TICK_MS;
+    dm_request_t* item;
+
+    if (table->request_number == 0) {
+        if (table->wheel_tick < now_tick) table->wheel_tick = now_tick;
+        return -1;
+    }
+
+    /* a turn visits every slot, more ticks behind than that need not be walked one by one. */
+    if (now_tick > table->wheel_tick + DM_REQUEST_WHEEL_SIZE) table->wheel_tick = now_tick - DM_REQUEST_WHEEL_SIZE;
+
+    while (1) {
+        /* slot of a tick also holds requests of later turns, they stay. */
+        for (item = table->wheel[table->wheel_tick % DM_REQUEST_WHEEL_SIZE]; item; item = item->wheel_next) {
+            if (item->expire_ms <= now_ms) {
+                take_request(table, item, request);
+                return 0;
+            }
+        }
+
+        /* the current tick is walked again, requests of it may expire later in it. */
+        if (table->wheel_tick >= now_tick) return -1;
+        table->wheel_tick++;
+    }
+}
+
+int64_t dm_request_table_next_timeout(const dm_request_table_t* table, uint64_t now_ms)
+{
+    const dm_request_t* request;
+    int64_t timeout = -1;
+
+    if (table->request_number == 0) return -1;
+
+    /* few enough to look at all, the wheel only orders them by tick. */
+    for (request = table->requests; request < table->requests + DM_REQUEST_TABLE_SIZE; ++request) {
+        if (request->id == 0) continue;
+        if (request->expire_ms <= now_ms) return 0;
+        if (timeout < 0 || (int64_t)(request->expire_ms - now_ms) < timeout) timeout = (int64_t)(request->expire_ms - now_ms);
+    }
+
+    return timeout;
+}
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dm_static_thing.h"
+#include "dm_thing.h"
+#include "dm_import.h"
+#include "logger.h"
+
+#ifdef DM_STATIC_THING_ENABLED
+
+int dm_thing_bind_static(void* _self, const dm_static_thing_model_t* model, void* data)
+{
+    dm_thing_t* self = _self;
+    const dsl_template_t* dsl_template = &self->dsl_template;
+    dm_static_thing_t* bound;
+    size_t ids_size;
+    int i;
+
+    if (model == NULL) {
+        if (self->_static) dm_lite_free(self->_static);
+        self->_static = NULL;
+        return 0;
+    }
+
+    if (data == NULL || model->property_number != (int)dsl_template->property_number) {
+        dm_log_err("static model of %d properties, thing has %d", model->property_number, (int)dsl_template->property_number);
+        return -1;
+    }
+
+    /* ids are the template indexes, the model must come from the same tsl. */
+    for (i = 0; i < model->property_number; ++i) {
+        if (dsl_template->properties[i].identifier == NULL || strcmp(dsl_template->properties[i].identifier, model->identifiers[i]) != 0) {
+            dm_log_err("static model property(%s) not found at %d", model->identifiers[i], i);
+            return -1;
+        }
+    }
+
+    ids_size = DM_STATIC_THING_IDS_SIZE(model->property_number);
+    bound = self->_static ? self->_static : dm_lite_malloc(sizeof(dm_static_thing_t) + 2 * ids_size);
+    if (bound == NULL) return -1;
+
+    bound->model = model;
+    bound->data = data;
+    bound->post_ids = (unsigned char*)(bound + 1);
+    bound->set_ids = bound->post_ids + ids_size;
+    self->_static = bound;
+
+    return 0;
+}
+
+dm_static_thing_t* dm_thing_get_static(const void* _self)
+{
+    const dm_thing_t* self = _self;
+
+    return self->_static;
+}
+
+int dm_static_thing_key_equal(const cJSON* item, const char* key, int key_len)
+{
+#ifdef CJSON_STRING_ZEROCOPY
+    return (int)item->string_length == key_len && memcmp(item->string, key, key_len) == 0;
+#else
+    return strncmp(item->string, key, key_len) == 0 && item->string[key_len] == '\0';
+#endif
+}
+
+int dm_static_thing_get_int(const cJSON* item, int* value)
+{
+    if (cJSON_IsBool(item)) {
+        *value = cJSON_IsTrue(item) ? 1 : 0;
+        return 0;
+    }
+    if (!cJSON_IsNumber(item)) return -1;
+
+    *value = item->valueint;
+
+    return 0;
+}
+
+int dm_static_thing_get_double(const cJSON* item, double* value)
+{
+    if (!cJSON_IsNumber(item)) return -1;
+
+    *value = item->valuedouble;
+
+    return 0;
+}
+
+int dm_static_thing_get_date(const cJSON* item, unsigned long long* value)
+{
+    char buff[24];
+    char* end;
+    int len;
+
+    if (cJSON_IsNumber(item) && item->valuedouble >= 0) {
+        *value = (unsigned long long)item->valuedouble;
+        return 0;
+    }
+    if (!cJSON_IsString(item)) return -1;
+
+#ifdef CJSON_STRING_ZEROCOPY
+    len = (int)item->valuestring_length;
+#else
+    len = (int)strlen(item->valuestring);
+#endif
+    if (len == 0 || len >= (int)sizeof(buff)) return -1;
+
+    memcpy(buff, item->valuestring, len);
+    buff[len] = '\0';
+    *value = strtoull(buff, &end, 10);
+
+    return *end == '\0' ? 0 : -1;
+}
+
+int dm_static_thing_get_text(const cJSON* item, char* buf, int size)
+{
+    int len;
+
+    if (!cJSON_IsString(item)) return -1;
+
+    /* escapes are kept with CJSON_STRING_ZEROCOPY, as for template values. */
+#ifdef CJSON_STRING_ZEROCOPY
+    len = (int)item->valuestring_length;
+#else
+    len = (int)strlen(item->valuestring);
+#endif
+    if (len >= size) return -1;
+
+    memcpy(buf, item->valuestring, len);
+    buf[len] = '\0';
+
+    return 0;
+}
+
+void dm_static_thing_write_date(dm_json_writer_t* writer, unsigned long long value)
+{
+    char buff[24];
+    int len = sizeof(buff);
+
+    do {
+        buff[--len] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    dm_json_writer_string(writer, buff + len, sizeof(buff) - len);
+}
+
+#endif /* DM_STATIC_THING_ENABLED */
@@ -8,15 +8,26 @@
 #include "interface/thing_abstract.h"
 #include "interface/list_abstract.h"
 #include "dm_thing.h"
+#include "dm_tsl_blob.h"
 #include "dm_import.h"
 #include "logger.h"
 #include "single_list.h"
 
 #include "lite-utils.h"
+#include "lite-number.h"
+#include "lite-json-str.h"
+#ifdef USING_UTILS_JSON
+#include "json_parser.h"
+#endif
 
 #include "cJSON.h"
 
+#ifdef DM_REPORT_POLICY_ENABLED
+#include "iot_import.h"
+#endif
+
 #define DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC 1
+#define DM_THING_PROFILE_ROOM (PRODUCT_KEY_MAXLEN + DEVICE_NAME_MAXLEN + 2 * DM_ARENA_ALIGN_SIZE) /* profile set after a shared template loaded. */
 
 static const char string_dm_thing_class_name[] __DM_READ_ONLY__ =  "dm_thing_cls";
 static const char string_property[] __DM_READ_ONLY__ = "property";
@@ -57,8 +68,9 @@ static const char string_item[] __DM_READ_ONLY__ = "item";
 static const char string_thing_event_property_post[] __DM_READ_ONLY__ = "thing.event.property.post";
 static const char string_thing_service_property_set[] __DM_READ_ONLY__ = "thing.service.property.set";
 static const char string_thing_service_property_get[] __DM_READ_ONLY__ = "thing.service.property.get";
-static const char string_profile_productKey[] __DM_READ_ONLY__ = "profile.productKey";
-static const char string_profile_deviceName[] __DM_READ_ONLY__ = "profile.deviceName";
+static const char string_profile[] __DM_READ_ONLY__ = "profile";
+static const char string_productKey[] __DM_READ_ONLY__ = "productKey";
+static const char string_deviceName[] __DM_READ_ONLY__ = "deviceName";
 static const char string_input[] __DM_READ_ONLY__ = "input";
 static const char string_output[] __DM_READ_ONLY__ = "output";
 static const char string_false[] __DM_READ_ONLY__ = "false";
@@ -67,18 +79,14 @@ static const char string_true[] __DM_READ_ONLY__ = "true";
 #endif
 
 #ifdef USING_UTILS_JSON
-#define KEY_BUFF_SIZE 32
-static int install_cjson_item_string(void** dst, const char* key, const char* src, int src_len);
+static void install_cjson_item_string(void** dst, const char* val, int val_len);
 static void install_cjson_obj_property(property_t* dst, const char* src, int src_len);
 static void install_cjson_obj_lite_property(void* dst, const char* src, int src_len);
-#ifdef LITE_THING_MODEL
-static void install_cjson_item_string_without_malloc(void* dst, const char *key, const char* src, int src_len);
-#endif
 #else
 static int install_cjson_item_string(void** dst, const cJSON* const cjson_obj, const char* const item_name);
 static void install_cjson_obj_property(property_t* dst, const cJSON* cjson_obj);
 static void install_cjson_obj_lite_property(void* dst, const cJSON* const cjson_obj);
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
 static void install_cjson_item_string_without_malloc(void* dst, const cJSON* const cjson_obj, const char* const item_name);
 #endif
 #endif
@@ -87,46 +95,118 @@ static void property_print_data_type_info(void* dst);
 static void item_print_info(void* _item, int index, va_list* params);
 #endif /* ENABLE_THING_DEBUG */
 
-static void dm_lltoa(long long n, char* str, int radix)
+static void free_item_memory(void* _item, int index, va_list* params);
+static void free_lite_property(void* _lite_property);
+static void free_property(void* _property, ...);
+static void free_template_runtime_memory(dm_thing_t* self);
+
+static void dm_thing_deinit_identifier_index(dm_thing_t* self)
 {
-    int i, j;
-    long long remain;
-    unsigned long long n_abs;
-    char tmp_char;
+    if (self->_index_master) {
+        /* tables belong to the master. */
+        memset(&self->_property_index, 0, sizeof(dm_id_index_t));
+        memset(&self->_event_index, 0, sizeof(dm_id_index_t));
+        memset(&self->_service_index, 0, sizeof(dm_id_index_t));
+        self->_index_master = NULL;
+        return;
+    }
 
-    i = 0;
+    dm_id_index_deinit(&self->_property_index);
+    dm_id_index_deinit(&self->_event_index);
+    dm_id_index_deinit(&self->_service_index);
+}
 
-    if (n < 0) {
-        str[i] = '-';
-        str++;
-        n_abs = -1 * n;
-    } else {
-        n_abs = n;
-    }
+/* item of entry found in the identifier index, in a shared index it is the master's, at the same offset in own template. */
+static void* dm_thing_index_item(const dm_thing_t* self, const dm_id_index_entry_t* entry)
+{
+    const dm_thing_t* master = self->_index_master;
+    const char* item;
 
-    do {
-        remain = n_abs % radix;
-        if(remain > 9)
-            str[i] = remain  - 10 + 'A';
-        else
-            str[i] = remain + '0';
-        i++;
-    } while(n_abs /= radix);
+    if (entry == NULL) return NULL;
+    if (master == NULL) return entry->item;
 
-    str[i] = '\0';
+    item = entry->item;
+    assert(item >= master->_template_base && item < master->_template_base + master->_template_size);
 
-    for(i-- , j = 0 ; j <= i ; j++ , i--)
-    {
-        tmp_char = str[j];
-        str[j] = str[i];
-        str[i] = tmp_char;
+    return self->_template_base + (item - master->_template_base);
+}
+
+static int index_lite_property_array(dm_id_index_t* index, lite_property_t* lite_property, size_t number)
+{
+    size_t i;
+
+    for (i = 0; i < number; ++i, ++lite_property) {
+        if (lite_property->identifier == NULL) continue;
+        if (dm_id_index_insert(index, lite_property->identifier, strlen(lite_property->identifier), lite_property) == NULL) return -1;
     }
-    return;
+
+    return 0;
 }
 
-static void free_item_memory(void* _item, int index, va_list* params);
-static void free_lite_property(void* _lite_property);
-static void free_property(void* _property, ...);
+/* build identifier index once after dsl parsed, lookups use it instead of scanning the template. */
+static int dm_thing_build_identifier_index(dm_thing_t* self)
+{
+    dsl_template_t* dsl_template = &self->dsl_template;
+    dm_id_index_entry_t* entry;
+    dm_id_index_t* child;
+    property_t* property;
+    event_t* event;
+    service_t* service;
+    input_data_t* input_data;
+    size_t index;
+    size_t input_index;
+
+    dm_thing_deinit_identifier_index(self);
+
+    if (dm_id_index_init(&self->_property_index, dsl_template->property_number) != 0 ||
+        dm_id_index_init(&self->_event_index, dsl_template->event_number) != 0 ||
+        dm_id_index_init(&self->_service_index, dsl_template->service_number) != 0) goto err;
+
+    for (index = 0; index < dsl_template->property_number; ++index) {
+        property = dsl_template->properties + index;
+        if (property->identifier == NULL) continue;
+        entry = dm_id_index_insert(&self->_property_index, property->identifier, strlen(property->identifier), property);
+        if (entry == NULL) goto err;
+        if (property->data_type.type == data_type_type_struct && property->data_type.specs && entry->item == property) {
+            child = dm_id_index_new_child(entry, DM_ID_INDEX_CHILD_INPUT, property->data_type.data_type_specs_number);
+            if (child == NULL ||
+                index_lite_property_array(child, property->data_type.specs, property->data_type.data_type_specs_number) != 0) goto err;
+        }
+    }
+
+    for (index = 0; index < dsl_template->event_number; ++index) {
+        event = dsl_template->events + index;
+        if (event->identifier == NULL) continue;
+        entry = dm_id_index_insert(&self->_event_index, event->identifier, strlen(event->identifier), event);
+        if (entry == NULL) goto err;
+        if (entry->item != event) continue;
+        child = dm_id_index_new_child(entry, DM_ID_INDEX_CHILD_INPUT, event->event_output_data_num);
+        if (child == NULL || index_lite_property_array(child, event->event_output_data, event->event_output_data_num) != 0) goto err;
+    }
+
+    for (index = 0; index < dsl_template->service_number; ++index) {
+        service = dsl_template->services + index;
+        if (service->identifier == NULL) continue;
+        entry = dm_id_index_insert(&self->_service_index, service->identifier, strlen(service->identifier), service);
+        if (entry == NULL) goto err;
+        if (entry->item != service) continue;
+        child = dm_id_index_new_child(entry, DM_ID_INDEX_CHILD_INPUT, service->service_input_data_num);
+        if (child == NULL) goto err;
+        for (input_index = 0; input_index < service->service_input_data_num; ++input_index) {
+            input_data = service->service_input_data + input_index;
+            if (index_lite_property_array(child, &input_data->lite_property, 1) != 0) goto err;
+        }
+        child = dm_id_index_new_child(entry, DM_ID_INDEX_CHILD_OUTPUT, service->service_output_data_num);
+        if (child == NULL || index_lite_property_array(child, service->service_output_data, service->service_output_data_num) != 0) goto err;
+    }
+
+    return 0;
+
+err:
+    dm_log_err("build identifier index fail");
+    dm_thing_deinit_identifier_index(self);
+    return -1;
+}
 
 static void* dm_thing_ctor(void* _self, va_list* params)
 {
@@ -138,6 +218,23 @@ static void* dm_thing_ctor(void* _self, va_list* params)
     self->_arr_index = -1;
     self->_json_object = NULL;
     memset(&self->dsl_template, 0, sizeof(dsl_template_t));
+    memset(&self->_property_index, 0, sizeof(dm_id_index_t));
+    memset(&self->_event_index, 0, sizeof(dm_id_index_t));
+    memset(&self->_service_index, 0, sizeof(dm_id_index_t));
+    memset(&self->_arena, 0, sizeof(dm_arena_t));
+    self->_index_master = NULL;
+    self->_template_base = NULL;
+    self->_template_size = 0;
+    self->_property_post_state = NULL;
+    self->_property_post_id = 0;
+    self->_value_mutex = HAL_MutexCreate();
+    if (self->_value_mutex == NULL) dm_log_err("value mutex create failed");
+#ifdef DM_REPORT_POLICY_ENABLED
+    self->_property_report = NULL;
+#endif
+#ifdef DM_STATIC_THING_ENABLED
+    self->_static = NULL;
+#endif
 
     return self;
 }
@@ -146,6 +243,35 @@ static void* dm_thing_dtor(void* _self)
 {
     dm_thing_t* self = _self;
 
+    dm_thing_deinit_identifier_index(self);
+
+    if (self->_property_post_state) {
+        dm_lite_free(self->_property_post_state);
+        self->_property_post_state = NULL;
+    }
+    if (self->_value_mutex) {
+        HAL_MutexDestroy(self->_value_mutex);
+        self->_value_mutex = NULL;
+    }
+#ifdef DM_REPORT_POLICY_ENABLED
+    if (self->_property_report) {
+        dm_lite_free(self->_property_report);
+        self->_property_report = NULL;
+    }
+#endif
+#ifdef DM_STATIC_THING_ENABLED
+    if (self->_static) {
+        dm_lite_free(self->_static);
+        self->_static = NULL;
+    }
+#endif
+
+    if (dm_arena_is_active(&self->_arena)) {
+        free_template_runtime_memory(self);
+        dm_arena_deinit(&self->_arena);
+        return self;
+    }
+
     property_iterator((thing_t*)self, free_item_memory, string_property, self->dsl_template.property_number);
     event_iterator((thing_t*)self, free_item_memory, string_event, self->dsl_template.event_number);
     service_iterator((thing_t*)self, free_item_memory, string_service, self->dsl_template.service_number);
@@ -168,11 +294,11 @@ static void* dm_thing_dtor(void* _self)
 
 static void sprintf_float_double_precise(void* dst, double value, int precise)
 {
-    char temp_buff[48] = {0};
+    char temp_buff[LITE_NUMBER_LEN_MAX] = {0};
     char *point = NULL;
     assert(dst);
 
-    dm_snprintf(temp_buff, sizeof(temp_buff), "%.16lf", value);
+    LITE_format_fixed(temp_buff, value, 16);
     point = strchr(temp_buff, '.');
 
     assert(point);
@@ -184,6 +310,69 @@ static void sprintf_float_double_precise(void* dst, double value, int precise)
     strcpy(dst, temp_buff);
 }
 
+/* value string of a numeric array item, NULL for text items. */
+static char* format_array_item_value_str(const data_type_x_t* data_type_x, int arr_index, char* buff, size_t buff_size)
+{
+    if (buff_size < LITE_NUMBER_LEN_MAX) {
+        return NULL;
+    } else if (data_type_x->data_type_array_t.item_type == data_type_type_int) {
+        LITE_format_llong(buff, *((int*)data_type_x->data_type_array_t.array + arr_index));
+    } else if (data_type_x->data_type_array_t.item_type == data_type_type_double) {
+        LITE_format_fixed(buff, *((double*)data_type_x->data_type_array_t.array + arr_index), 16);
+    } else if (data_type_x->data_type_array_t.item_type == data_type_type_float) {
+        LITE_format_fixed(buff, *((float*)data_type_x->data_type_array_t.array + arr_index), 7);
+    } else {
+        return NULL;
+    }
+
+    return buff;
+}
+
+/* value string in the format the string shadows used to hold, arr_index only for array. */
+static char* format_value_str(const data_type_t* data_type, int arr_index, char* buff, size_t buff_size)
+{
+    const data_type_x_t* data_type_x = &data_type->value;
+
+    if (buff_size < LITE_NUMBER_LEN_MAX) return NULL;
+
+    switch (data_type->type) {
+    case data_type_type_int:
+        LITE_format_llong(buff, data_type_x->data_type_int_t.value);
+        break;
+    case data_type_type_float:
+        sprintf_float_double_precise(buff, data_type_x->data_type_float_t.value, data_type_x->data_type_float_t.precise);
+        break;
+    case data_type_type_double:
+        sprintf_float_double_precise(buff, data_type_x->data_type_double_t.value, data_type_x->data_type_double_t.precise);
+        break;
+    case data_type_type_bool:
+        LITE_format_llong(buff, data_type_x->data_type_bool_t.value);
+        break;
+    case data_type_type_enum:
+        LITE_format_llong(buff, data_type_x->data_type_enum_t.value);
+        break;
+    case data_type_type_date:
+        LITE_format_llong(buff, data_type_x->data_type_date_t.value);
+        break;
+    case data_type_type_array:
+        return format_array_item_value_str(data_type_x, arr_index, buff, buff_size);
+    default:
+        return NULL;
+    }
+
+    return buff;
+}
+
+static void value_lock(const dm_thing_t* self)
+{
+    if (self->_value_mutex) HAL_MutexLock(self->_value_mutex);
+}
+
+static void value_unlock(const dm_thing_t* self)
+{
+    if (self->_value_mutex) HAL_MutexUnlock(self->_value_mutex);
+}
+
 static int get_type_size(data_type_type_t type)
 {
     int size = 0;
@@ -237,504 +426,884 @@ static data_type_type_t detect_data_type_type(const char* const type_str)
     return type;
 }
 
-#ifdef USING_UTILS_JSON
-static void install_cjson_item_data_type_value(void *dst, data_type_type_t type, const char *src, int src_len)
+#if defined(USING_UTILS_JSON) || defined(LITE_THING_MODEL)
+static dm_arena_t* _g_dm_thing_arena = NULL; /* arena of the thing being loaded. */
+
+static void* dm_thing_template_calloc(size_t nmemb, size_t size)
 {
-    data_type_x_t *data_type_x = (data_type_x_t *)dst;
-    int index = 0;
+    if (_g_dm_thing_arena) return dm_arena_calloc(_g_dm_thing_arena, nmemb, size);
+
+    return dm_lite_calloc(nmemb, size);
+}
+
+/* default values and value string buffers, once min/max, item numbers, size etc. are known. */
+static void install_data_type_int_value(data_type_x_t* data_type_x)
+{
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
     char temp_buf[24] = {0};
-    char temp_identifiy[32] = {0};
-    char **current_key;
-#ifndef LITE_THING_MODEL
-    char *p_tmp = NULL;
-    char **current_val;
-#endif
     long long long_val;
+#endif
 
-    if (type == data_type_type_int) {
-        /* min */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, string_min, src, src_len);
-        data_type_x->data_type_int_t.min = atoi(temp_buf);
-#else
-        install_cjson_item_string((void **)&data_type_x->data_type_int_t.min_str, string_min, src, src_len);
-        data_type_x->data_type_int_t.min = atoi(data_type_x->data_type_int_t.min_str);
+    data_type_x->data_type_int_t.precise = 0;
+    data_type_x->data_type_int_t.value = (data_type_x->data_type_int_t.min + data_type_x->data_type_int_t.max) / 2; /* default value? */
+
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    long_val = data_type_x->data_type_int_t.max;
+    LITE_format_llong(temp_buf, long_val);
+    data_type_x->data_type_int_t.value_str = dm_thing_template_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_int_t.precise  + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+
+    assert(data_type_x->data_type_int_t.value_str);
+    LITE_format_llong(data_type_x->data_type_int_t.value_str, data_type_x->data_type_int_t.value);
 #endif
-        /* max */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, string_max, src, src_len);
-        data_type_x->data_type_int_t.max = atoi(temp_buf);
-#else
-        install_cjson_item_string((void **)&data_type_x->data_type_int_t.max_str, string_max, src, src_len);
-        data_type_x->data_type_int_t.max = atoi(data_type_x->data_type_int_t.max_str);
+}
+
+static void install_data_type_float_value(data_type_x_t* data_type_x)
+{
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    char temp_buf[24] = {0};
+    long long long_val;
 #endif
 
-#if 0
-        /* precise */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, "precise", src, src_len);
-        if (strlen(temp_buf)) {
-            data_type_x->data_type_int_t.precise = atoi(temp_buf);
-        }
-#else
-        install_cjson_item_string((void **)&data_type_x->data_type_int_t.precise_str, "precise", src, src_len);
-        if (data_type_x->data_type_int_t.precise_str) {
-            data_type_x->data_type_int_t.precise = atoi(data_type_x->data_type_int_t.precise_str);
-        }
+    data_type_x->data_type_float_t.precise = 7;
+    data_type_x->data_type_float_t.value = (data_type_x->data_type_float_t.min + data_type_x->data_type_float_t.max) / 2; /* default value? */
+
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    long_val = (long long)data_type_x->data_type_float_t.max;
+    LITE_format_llong(temp_buf, long_val);
+    data_type_x->data_type_float_t.value_str = dm_thing_template_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_float_t.precise + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+    assert(data_type_x->data_type_float_t.value_str);
+    sprintf_float_double_precise(data_type_x->data_type_float_t.value_str, data_type_x->data_type_float_t.value,
+                                 data_type_x->data_type_float_t.precise);
 #endif
-#else
-        data_type_x->data_type_int_t.precise = 0;
+}
+
+static void install_data_type_double_value(data_type_x_t* data_type_x)
+{
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    char temp_buf[24] = {0};
+    long long long_val;
 #endif
 
-#ifndef LITE_THING_MODEL
-        /* unit */
-        install_cjson_item_string((void **)&data_type_x->data_type_int_t.unit, "unit", src, src_len);
-        /* unitName */
-        install_cjson_item_string((void **)&data_type_x->data_type_int_t.unit_name, "unitName", src, src_len);
+    data_type_x->data_type_double_t.precise = 16;
+    data_type_x->data_type_double_t.value = (data_type_x->data_type_double_t.min + data_type_x->data_type_double_t.max) / 2; /* default value? */
+
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    long_val = (long long)data_type_x->data_type_double_t.max;
+    LITE_format_llong(temp_buf, long_val);
+    data_type_x->data_type_double_t.value_str = dm_thing_template_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_double_t.precise + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+    assert(data_type_x->data_type_double_t.value_str);
+    sprintf_float_double_precise(data_type_x->data_type_double_t.value_str, data_type_x->data_type_double_t.value, data_type_x->data_type_double_t.precise);
 #endif
+}
 
-        data_type_x->data_type_int_t.value = (data_type_x->data_type_int_t.min + data_type_x->data_type_int_t.max) / 2; /* default value? */
+/* item keys are "0", "1"..., value string is sized by the last key. */
+static char* install_data_type_item_keys(char** item_key, int item_number)
+{
+    char temp_buf[24] = {0};
+    char** current_key;
+    char* value_str = NULL;
+    int index;
 
-        long_val = data_type_x->data_type_int_t.max;
-        dm_lltoa(long_val, temp_buf, 10);
-        data_type_x->data_type_int_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_int_t.precise  + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+    for (index = 0; index < item_number; ++index) {
+        dm_snprintf(temp_buf, sizeof(temp_buf), "%d", index);
+        current_key = item_key + index;
+        *current_key = dm_thing_template_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+        assert(*current_key);
+        strcpy(*current_key, temp_buf);
+    }
 
-        assert(data_type_x->data_type_int_t.value_str);
-        dm_sprintf(data_type_x->data_type_int_t.value_str, "%d", data_type_x->data_type_int_t.value);
-    } else if (type == data_type_type_float) {
-        /* min */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, string_min, src, src_len);
-        data_type_x->data_type_float_t.min = atof(temp_buf);
-#else
-        install_cjson_item_string((void **)&data_type_x->data_type_float_t.min_str, string_min, src, src_len);
-        data_type_x->data_type_float_t.min = atof(data_type_x->data_type_float_t.min_str);
-#endif
-        /* max */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, string_max, src, src_len);
-        data_type_x->data_type_float_t.max = atof(temp_buf);
-#else
-        install_cjson_item_string((void **)&data_type_x->data_type_float_t.max_str, string_max, src, src_len);
-        data_type_x->data_type_float_t.max = atof(data_type_x->data_type_float_t.max_str);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    value_str = dm_thing_template_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+    assert(value_str);
 #endif
-#if 0
-        /* precise */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, "precise", src, src_len);
-        if (strlen(temp_buf)) {
-            data_type_x->data_type_float_t.precise = atoi(temp_buf);
-        }
+
+    return value_str;
+}
+
+static void install_data_type_enum_value(data_type_x_t* data_type_x)
+{
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    data_type_x->data_type_enum_t.value_str = install_data_type_item_keys(data_type_x->data_type_enum_t.enum_item_key,
+                                                                          data_type_x->data_type_enum_t.enum_item_number);
+    data_type_x->data_type_enum_t.value = atoi(*data_type_x->data_type_enum_t.enum_item_key);
+    LITE_format_llong(data_type_x->data_type_enum_t.value_str, data_type_x->data_type_enum_t.value);
 #else
-        install_cjson_item_string((void **)&data_type_x->data_type_float_t.precise_str, "precise", src, src_len);
-        if (data_type_x->data_type_float_t.precise_str) {
-            data_type_x->data_type_float_t.precise = atoi(data_type_x->data_type_float_t.precise_str);
-        }
+    install_data_type_item_keys(data_type_x->data_type_enum_t.enum_item_key, data_type_x->data_type_enum_t.enum_item_number);
+    data_type_x->data_type_enum_t.value = atoi(*data_type_x->data_type_enum_t.enum_item_key);
 #endif
+}
+
+static void install_data_type_bool_value(data_type_x_t* data_type_x)
+{
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    data_type_x->data_type_bool_t.value_str = install_data_type_item_keys(data_type_x->data_type_bool_t.bool_item_key,
+                                                                          data_type_x->data_type_bool_t.bool_item_number);
+
+    data_type_x->data_type_bool_t.value = 1; /* default value. */
+    LITE_format_llong(data_type_x->data_type_bool_t.value_str, data_type_x->data_type_bool_t.value);
 #else
-        data_type_x->data_type_float_t.precise = 7;
+    install_data_type_item_keys(data_type_x->data_type_bool_t.bool_item_key, data_type_x->data_type_bool_t.bool_item_number);
+    data_type_x->data_type_bool_t.value = 1; /* default value. */
 #endif
+}
 
+static void install_data_type_text_value(data_type_x_t* data_type_x)
+{
+    if (data_type_x->data_type_text_t.length < 1) {
+        data_type_x->data_type_text_t.length = 1;
+    }
+    data_type_x->data_type_text_t.value = NULL; /* default value. */
+}
 
-#ifndef LITE_THING_MODEL
-        /* unit */
-        install_cjson_item_string((void **)&data_type_x->data_type_float_t.unit, "unit", src, src_len);
-        /* unitName */
-        install_cjson_item_string((void **)&data_type_x->data_type_float_t.unit_name, "unitName", src, src_len);
+static void install_data_type_date_value(data_type_x_t* data_type_x)
+{
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    char temp_buf[24] = {0};
 #endif
-        data_type_x->data_type_float_t.value = (data_type_x->data_type_float_t.min + data_type_x->data_type_float_t.max) / 2; /* default value? */
-        long_val = (long long)data_type_x->data_type_float_t.max;
-        dm_lltoa(long_val, temp_buf, 10);
-        data_type_x->data_type_float_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_float_t.precise + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
-        assert(data_type_x->data_type_float_t.value_str);
-        sprintf_float_double_precise(data_type_x->data_type_float_t.value_str, data_type_x->data_type_float_t.value,
-                                     data_type_x->data_type_float_t.precise);
-    } else if (type == data_type_type_double) {
-        /* min */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, string_min, src, src_len);
-        data_type_x->data_type_double_t.min = atof(temp_buf);
+
+    data_type_x->data_type_date_t.value = 1513406265000; /* ms, UTC. default value. */
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+#if !(WIN32)
+    LITE_format_llong(temp_buf, __LONG_LONG_MAX__);
 #else
-        install_cjson_item_string((void**)&data_type_x->data_type_double_t.min_str, string_min, src, src_len);
-        data_type_x->data_type_double_t.min = atof(data_type_x->data_type_double_t.min_str);
+    LITE_format_llong(temp_buf, LLONG_MAX);
 #endif
-        /* max */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, string_max, src, src_len);
-        data_type_x->data_type_double_t.max = atof(temp_buf);
-#else
-        install_cjson_item_string((void**)&data_type_x->data_type_double_t.max_str, string_max, src, src_len);
-        data_type_x->data_type_double_t.max = atof(data_type_x->data_type_double_t.max_str);
+    data_type_x->data_type_date_t.value_str = dm_thing_template_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+    assert(data_type_x->data_type_date_t.value_str);
+    LITE_format_llong(data_type_x->data_type_date_t.value_str, data_type_x->data_type_date_t.value);
 #endif
+}
 
-#if 0
-        /* precise */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, data_type_obj, "precise");
-        if (strlen(temp_buf)) {
-            data_type_x->data_type_double_t.precise = atoi(temp_buf);
-        }
-#else
-        install_cjson_item_string((void**)&data_type_x->data_type_double_t.precise_str, data_type_obj, "precise");
-        if (data_type_x->data_type_double_t.precise_str) {
-            data_type_x->data_type_double_t.precise = atoi(data_type_x->data_type_double_t.precise_str);
-        }
+static void install_data_type_array_value(data_type_x_t* data_type_x)
+{
+    data_type_x->data_type_array_t.array = dm_thing_template_calloc(data_type_x->data_type_array_t.size, get_type_size(data_type_x->data_type_array_t.item_type));
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    if (data_type_x->data_type_array_t.item_type != data_type_type_text) {
+        data_type_x->data_type_array_t.value_str = dm_thing_template_calloc(data_type_x->data_type_array_t.size, sizeof(char**));
+    }
 #endif
-#else
-        data_type_x->data_type_double_t.precise = 16;
+}
 #endif
 
-#ifndef LITE_THING_MODEL
-        /* unit */
-        install_cjson_item_string((void**)&data_type_x->data_type_double_t.unit, "unit", src, src_len);
-        /* unitName */
-        install_cjson_item_string((void**)&data_type_x->data_type_double_t.unit_name, "unitName", src, src_len);
-#endif
-        data_type_x->data_type_double_t.value = (data_type_x->data_type_double_t.min + data_type_x->data_type_double_t.max) / 2; /* default value? */
-        long_val = (long long)data_type_x->data_type_double_t.max;
-        dm_lltoa(long_val, temp_buf, 10);
-        data_type_x->data_type_double_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_double_t.precise + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
-        assert(data_type_x->data_type_double_t.value_str);
-        sprintf_float_double_precise(data_type_x->data_type_double_t.value_str, data_type_x->data_type_double_t.value, data_type_x->data_type_double_t.precise);
-    }else if (type == data_type_type_enum) {
-        /* detect enum item number */
+#ifdef LITE_THING_MODEL
+/* precompiled tsl, strings stay in the blob, structs and value buffers go to the arena. */
 
-        index = get_json_item_size((char*)src, src_len);
+/* value strings are sized by the integer part of max, also false for nan. */
+#define dm_tsl_blob_range_valid(min, max) ((min) > -9.2e18 && (min) < 9.2e18 && (max) > -9.2e18 && (max) < 9.2e18)
 
-        data_type_x->data_type_enum_t.enum_item_number = index;
+static void install_blob_lite_property(dm_tsl_blob_reader_t* reader, lite_property_t* lite_property);
+static void install_blob_arr_lite_property(dm_tsl_blob_reader_t* reader, lite_property_t** dst, size_t* number);
 
-        if (data_type_x->data_type_enum_t.enum_item_number == 0) {
-            data_type_x->data_type_enum_t.enum_item_key = NULL;
-            data_type_x->data_type_enum_t.enum_item_value = NULL;
-            return;
-        }
+static void install_blob_data_type(dm_tsl_blob_reader_t* reader, data_type_t* data_type)
+{
+    data_type_x_t* data_type_x = &data_type->value;
 
+    data_type->type_str = dm_tsl_blob_read_string(reader);
+    data_type->type = (data_type_type_t)dm_tsl_blob_read_u8(reader);
+
+    switch (data_type->type) {
+    case data_type_type_int:
+        data_type_x->data_type_int_t.min = dm_tsl_blob_read_i32(reader);
+        data_type_x->data_type_int_t.max = dm_tsl_blob_read_i32(reader);
+        install_data_type_int_value(data_type_x);
+        break;
+    case data_type_type_float:
+        data_type_x->data_type_float_t.min = (float)dm_tsl_blob_read_f64(reader);
+        data_type_x->data_type_float_t.max = (float)dm_tsl_blob_read_f64(reader);
+        if (!dm_tsl_blob_range_valid(data_type_x->data_type_float_t.min, data_type_x->data_type_float_t.max)) {
+            reader->error = 1;
+            break;
+        }
+        install_data_type_float_value(data_type_x);
+        break;
+    case data_type_type_double:
+        data_type_x->data_type_double_t.min = dm_tsl_blob_read_f64(reader);
+        data_type_x->data_type_double_t.max = dm_tsl_blob_read_f64(reader);
+        if (!dm_tsl_blob_range_valid(data_type_x->data_type_double_t.min, data_type_x->data_type_double_t.max)) {
+            reader->error = 1;
+            break;
+        }
+        install_data_type_double_value(data_type_x);
+        break;
+    case data_type_type_enum:
+        data_type_x->data_type_enum_t.enum_item_number = dm_tsl_blob_read_u32(reader);
+        if (data_type_x->data_type_enum_t.enum_item_number <= 0 || data_type_x->data_type_enum_t.enum_item_number > DM_TSL_BLOB_MAX_ITEM_NUMBER ||
+            reader->error) {
+            data_type_x->data_type_enum_t.enum_item_number = 0;
+            break;
+        }
+        data_type_x->data_type_enum_t.enum_item_key = (char**)dm_thing_template_calloc(data_type_x->data_type_enum_t.enum_item_number, sizeof(char**));
+        if (data_type_x->data_type_enum_t.enum_item_key == NULL) {
+            reader->error = 1;
+            break;
+        }
+        install_data_type_enum_value(data_type_x);
+        break;
+    case data_type_type_bool:
+        data_type_x->data_type_bool_t.bool_item_number = dm_tsl_blob_read_u32(reader);
+        if (data_type_x->data_type_bool_t.bool_item_number <= 0 || data_type_x->data_type_bool_t.bool_item_number > DM_TSL_BLOB_MAX_ITEM_NUMBER ||
+            reader->error) {
+            data_type_x->data_type_bool_t.bool_item_number = 0;
+            break;
+        }
+        data_type_x->data_type_bool_t.bool_item_key = (char**)dm_thing_template_calloc(data_type_x->data_type_bool_t.bool_item_number, sizeof(char**));
+        if (data_type_x->data_type_bool_t.bool_item_key == NULL) {
+            reader->error = 1;
+            break;
+        }
+        install_data_type_bool_value(data_type_x);
+        break;
+    case data_type_type_text:
+        data_type_x->data_type_text_t.length = dm_tsl_blob_read_i32(reader);
+        install_data_type_text_value(data_type_x);
+        break;
+    case data_type_type_date:
+        install_data_type_date_value(data_type_x);
+        break;
+    case data_type_type_array:
+        data_type_x->data_type_array_t.size = dm_tsl_blob_read_i32(reader);
+        data_type_x->data_type_array_t.item_type = (data_type_type_t)dm_tsl_blob_read_u8(reader);
+        if (data_type_x->data_type_array_t.size < 0 || data_type_x->data_type_array_t.size > DM_TSL_BLOB_MAX_ITEM_NUMBER ||
+            get_type_size(data_type_x->data_type_array_t.item_type) == 0 || reader->error) {
+            data_type_x->data_type_array_t.size = 0;
+            reader->error = 1;
+            break;
+        }
+        install_data_type_array_value(data_type_x);
+        break;
+    case data_type_type_struct:
+        install_blob_arr_lite_property(reader, (lite_property_t**)&data_type->specs, &data_type->data_type_specs_number);
+        break;
+    default:
+        reader->error = 1;
+        break;
+    }
+}
+
+static void install_blob_lite_property(dm_tsl_blob_reader_t* reader, lite_property_t* lite_property)
+{
+    lite_property->identifier = dm_tsl_blob_read_string(reader);
+    install_blob_data_type(reader, &lite_property->data_type);
+}
+
+static void install_blob_property(dm_tsl_blob_reader_t* reader, property_t* property)
+{
+    property->identifier = dm_tsl_blob_read_string(reader);
+    property->access_mode = (property_access_mode_t)dm_tsl_blob_read_u8(reader);
+    property->required = dm_tsl_blob_read_u8(reader);
+    install_blob_data_type(reader, &property->data_type);
+}
+
+/* counts are checked against bytes left, every record takes at least one byte. */
+static void* install_blob_array(dm_tsl_blob_reader_t* reader, size_t* number, size_t size)
+{
+    void* array;
+
+    *number = dm_tsl_blob_read_u32(reader);
+    if (*number == 0 || reader->error) return NULL;
+
+    if (*number > reader->size - reader->pos) {
+        reader->error = 1;
+        *number = 0;
+        return NULL;
+    }
+
+    array = dm_thing_template_calloc(*number, size);
+    if (array == NULL) {
+        reader->error = 1;
+        *number = 0;
+    }
+
+    return array;
+}
+
+static void install_blob_arr_lite_property(dm_tsl_blob_reader_t* reader, lite_property_t** dst, size_t* number)
+{
+    size_t index;
+
+    *dst = install_blob_array(reader, number, sizeof(lite_property_t));
+    for (index = 0; *dst && index < *number && !reader->error; ++index) {
+        install_blob_lite_property(reader, *dst + index);
+    }
+}
+
+static int parse_blob_to_dsl_template(dm_thing_t* self, dm_tsl_blob_reader_t* reader)
+{
+    dsl_template_t* dsl_template = &self->dsl_template;
+    event_t* event;
+    service_t* service;
+    input_data_t* input_data;
+    size_t i, j;
+
+    dsl_template->profile.product_key = dm_tsl_blob_read_string(reader);
+    dsl_template->profile.device_name = dm_tsl_blob_read_string(reader);
+
+    dsl_template->properties = install_blob_array(reader, &dsl_template->property_number, sizeof(property_t));
+    for (i = 0; i < dsl_template->property_number && !reader->error; ++i) {
+        install_blob_property(reader, dsl_template->properties + i);
+    }
+
+    dsl_template->events = install_blob_array(reader, &dsl_template->event_number, sizeof(event_t));
+    for (i = 0; i < dsl_template->event_number && !reader->error; ++i) {
+        event = dsl_template->events + i;
+        event->identifier = dm_tsl_blob_read_string(reader);
+        event->method = dm_tsl_blob_read_string(reader);
+        event->event_type_str = dm_tsl_blob_read_string(reader);
+        event->event_type = (event_type_t)dm_tsl_blob_read_u8(reader);
+        event->required = dm_tsl_blob_read_u8(reader);
+        install_blob_arr_lite_property(reader, &event->event_output_data, &event->event_output_data_num);
+    }
+
+    dsl_template->services = install_blob_array(reader, &dsl_template->service_number, sizeof(service_t));
+    for (i = 0; i < dsl_template->service_number && !reader->error; ++i) {
+        service = dsl_template->services + i;
+        service->identifier = dm_tsl_blob_read_string(reader);
+        service->method = dm_tsl_blob_read_string(reader);
+        service->call_type = dm_tsl_blob_read_string(reader);
+        service->service_type = (service_type_t)dm_tsl_blob_read_u8(reader);
+        service->required = dm_tsl_blob_read_u8(reader);
+        install_blob_arr_lite_property(reader, &service->service_output_data, &service->service_output_data_num);
+
+        service->service_input_data = install_blob_array(reader, &service->service_input_data_num, sizeof(input_data_t));
+        for (j = 0; j < service->service_input_data_num && !reader->error; ++j) {
+            input_data = service->service_input_data + j;
+            if (service->service_type == service_type_property_get) {
+                input_data->property_to_get_name = dm_tsl_blob_read_string(reader);
+            } else if (service->service_type == service_type_property_set) {
+                install_blob_property(reader, &input_data->property_to_set);
+            } else {
+                install_blob_lite_property(reader, &input_data->lite_property);
+            }
+        }
+    }
+
+    if (reader->error) {
+        dm_log_err("tsl blob corrupted");
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+#ifdef LITE_THING_MODEL
+/* whole template goes to the arena, the dtor releases it in one go even when loading failed halfway. */
+static int load_blob_into_arena(dm_thing_t* self, dm_arena_t* arena, const char* blob, int blob_len, size_t chunk_size)
+{
+    dm_tsl_blob_reader_t reader;
+    int ret;
+
+    if (dm_tsl_blob_reader_init(&reader, blob, blob_len) != 0) {
+        dm_log_err("tsl blob header invalid");
+        return -1;
+    }
+
+    if (!dm_arena_is_active(arena) && dm_arena_init(arena, chunk_size ? chunk_size : reader.size) != 0) {
+        dm_log_err("arena init fail");
+        return -1;
+    }
+
+    _g_dm_thing_arena = arena;
+    ret = parse_blob_to_dsl_template(self, &reader);
+    _g_dm_thing_arena = NULL;
+    dm_arena_seal(arena);
+
+    return ret;
+}
+
+/* offset of p in the template loaded by dm_thing_set_shared_dsl_blob, -1 for NULL. */
+static long template_offset(const dm_thing_t* self, const void* p)
+{
+    return p ? (const char*)p - self->_template_base : -1;
+}
+
+static int is_same_template_layout(const dm_thing_t* self, const dm_thing_t* master)
+{
+    const dsl_template_t* a = &self->dsl_template;
+    const dsl_template_t* b = &master->dsl_template;
+
+    return self->_template_size == master->_template_size && self->_arena.chunks->next == NULL &&
+           a->property_number == b->property_number && a->event_number == b->event_number &&
+           a->service_number == b->service_number &&
+           template_offset(self, a->properties) == template_offset(master, b->properties) &&
+           template_offset(self, a->events) == template_offset(master, b->events) &&
+           template_offset(self, a->services) == template_offset(master, b->services);
+}
+#endif
+
+static int dm_thing_set_dsl_blob(dm_thing_t* self, const char* src, int src_len)
+{
+#ifdef LITE_THING_MODEL
+    int ret;
+
+    ret = load_blob_into_arena(self, &self->_arena, src, src_len, 0);
+
+    if (ret == 0) {
+        ret = dm_thing_build_identifier_index(self);
+    }
+
+    return ret;
+#else
+    dm_log_err("tsl blob needs LITE_THING_MODEL");
+    return -1;
+#endif
+}
+
+int dm_thing_set_shared_dsl_blob(void* _self, const char* blob, int blob_len, const void* _master)
+{
+#ifdef LITE_THING_MODEL
+    dm_thing_t* self = _self;
+    const dm_thing_t* master = _master;
+    dm_arena_chunk_t* chunk;
+    dm_arena_t probe;
+    size_t size = 0;
+
+    if (dm_arena_is_active(&self->_arena)) return -1;
+    if (master && (master->_template_size == 0 || master->_index_master)) master = NULL;
+
+    if (master) {
+        size = master->_template_size;
+    } else {
+        /* a first load finds the size of the template. */
+        memset(&probe, 0, sizeof(dm_arena_t));
+        if (load_blob_into_arena(self, &probe, blob, blob_len, 0) == 0) {
+            for (chunk = probe.chunks; chunk; chunk = chunk->next) size += chunk->used;
+        }
+        dm_arena_deinit(&probe);
+        memset(&self->dsl_template, 0, sizeof(dsl_template_t));
+        if (size == 0) return -1;
+    }
+
+    if (load_blob_into_arena(self, &self->_arena, blob, blob_len, size + DM_THING_PROFILE_ROOM) != 0) return -1;
+
+    chunk = self->_arena.chunks;
+    self->_template_base = dm_arena_chunk_data(chunk);
+    self->_template_size = chunk->used;
+
+    if (master && is_same_template_layout(self, master)) {
+        self->_property_index = master->_property_index;
+        self->_event_index = master->_event_index;
+        self->_service_index = master->_service_index;
+        self->_index_master = master;
+        return 0;
+    }
+
+    if (chunk->next) self->_template_size = 0;
+
+    return dm_thing_build_identifier_index(self);
+#else
+    (void)_self;
+    (void)blob;
+    (void)blob_len;
+    (void)_master;
+    dm_log_err("tsl blob needs LITE_THING_MODEL");
+    return -1;
+#endif
+}
+
+#ifdef USING_UTILS_JSON
+/*
+ * tsl is walked in a single pass: members of every object are dispatched by key while iterating,
+ * spans that depend on other members (specs, outputData, inputData) are remembered and installed
+ * once the object is done. arrays are only sized by get_json_item_size before they are filled.
+ */
+typedef struct {
+    char* val;
+    int   val_len;
+    int   val_type;
+} tsl_span_t;
+
+static int tsl_key_equal(const char* key, int key_len, const char* str)
+{
+    return key && (int)strlen(str) == key_len && strncmp(key, str, key_len) == 0;
+}
+
+static void tsl_span_install(tsl_span_t* span, char* val, int val_len, int val_type)
+{
+    span->val = val;
+    span->val_len = val_len;
+    span->val_type = val_type;
+}
+
+static void tsl_find_key(const char* src, int src_len, const char* key_str, tsl_span_t* span)
+{
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        if (tsl_key_equal(key, key_len, key_str)) {
+            tsl_span_install(span, val, val_len, val_type);
+            return;
+        }
+    }
+}
+
+static void install_cjson_item_string(void** dst, const char* val, int val_len)
+{
+    size_t size;
+
+    if (_g_dm_thing_arena) {
+        /* template strings are never written after load, share equal ones. */
+        *dst = val ? dm_arena_intern(_g_dm_thing_arena, val, val_len) : NULL;
+        assert(val == NULL || *dst);
+        return;
+    }
+
+    if (*dst) dm_lite_free(*dst);
+    *dst = NULL;
+
+    if (val == NULL) return;
+
+    size = val_len + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC;
+    *dst = dm_thing_template_calloc(1, size);
+    assert(*dst);
+    if (*dst) memcpy(*dst, val, val_len);
+}
+
+static void install_cjson_item_string_without_malloc(void* dst, int dst_size, const char* val, int val_len)
+{
+    char* buff = dst;
+
+    if (val == NULL) {
+        buff[0] = '\0';
+        return;
+    }
+    if (val_len > dst_size - 1) val_len = dst_size - 1;
+    memcpy(buff, val, val_len);
+    buff[val_len] = '\0';
+}
+
+static void install_cjson_item_bool(void* dst, const char* val, int val_len)
+{
+    int* bool_val = dst;
+
+    *bool_val = 1;
+    if (val && !strncmp(val, string_false, val_len)) {
+        *bool_val = 0;
+    }
+}
+
+#ifndef LITE_THING_MODEL
+/* enum and bool item values, keyed by "0", "1"... */
+static void install_cjson_item_enum_value(char** item_value, int item_number, const char* src, int src_len)
+{
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+    int index;
+    int i;
+
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        index = 0;
+        for (i = 0; i < key_len; ++i) {
+            if (key[i] > '9' || key[i] < '0') break;
+            index = index * 10 + key[i] - '0';
+        }
+        if (key_len == 0 || i < key_len || index >= item_number) continue;
+        install_cjson_item_string((void**)item_value + index, val, val_len);
+    }
+}
+#endif
+
+static void install_cjson_item_data_type_value(void* dst, data_type_type_t type, const char* src, int src_len)
+{
+    data_type_x_t* data_type_x = (data_type_x_t*)dst;
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+    tsl_span_t min = {0}, max = {0}, length = {0}, size = {0}, item_type = {0};
+#if !defined(LITE_THING_MODEL) && !defined(DM_THING_COMPACT_VALUE_ENABLED)
+    tsl_span_t unit = {0}, unit_name = {0};
+#endif
+    int item_number = 0;
+    char temp_buf[24] = {0};
+
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        item_number++;
+        if (tsl_key_equal(key, key_len, string_min)) {
+            tsl_span_install(&min, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, string_max)) {
+            tsl_span_install(&max, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, string_length)) {
+            tsl_span_install(&length, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, string_size)) {
+            tsl_span_install(&size, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, string_item) && val_type == JOBJECT) {
+            tsl_find_key(val, val_len, string_type, &item_type);
+        }
+#if !defined(LITE_THING_MODEL) && !defined(DM_THING_COMPACT_VALUE_ENABLED)
+        else if (tsl_key_equal(key, key_len, "unit")) {
+            tsl_span_install(&unit, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, "unitName")) {
+            tsl_span_install(&unit_name, val, val_len, val_type);
+        }
+#endif
+    }
+
+    if (type == data_type_type_int) {
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), min.val, min.val_len);
+        data_type_x->data_type_int_t.min = atoi(temp_buf);
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), max.val, max.val_len);
+        data_type_x->data_type_int_t.max = atoi(temp_buf);
+#else
+        install_cjson_item_string((void**)&data_type_x->data_type_int_t.min_str, min.val, min.val_len);
+        data_type_x->data_type_int_t.min = data_type_x->data_type_int_t.min_str ? atoi(data_type_x->data_type_int_t.min_str) : 0;
+        install_cjson_item_string((void**)&data_type_x->data_type_int_t.max_str, max.val, max.val_len);
+        data_type_x->data_type_int_t.max = data_type_x->data_type_int_t.max_str ? atoi(data_type_x->data_type_int_t.max_str) : 0;
+        install_cjson_item_string((void**)&data_type_x->data_type_int_t.unit, unit.val, unit.val_len);
+        install_cjson_item_string((void**)&data_type_x->data_type_int_t.unit_name, unit_name.val, unit_name.val_len);
+#endif
+        install_data_type_int_value(data_type_x);
+    } else if (type == data_type_type_float) {
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), min.val, min.val_len);
+        data_type_x->data_type_float_t.min = atof(temp_buf);
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), max.val, max.val_len);
+        data_type_x->data_type_float_t.max = atof(temp_buf);
+#else
+        install_cjson_item_string((void**)&data_type_x->data_type_float_t.min_str, min.val, min.val_len);
+        data_type_x->data_type_float_t.min = data_type_x->data_type_float_t.min_str ? atof(data_type_x->data_type_float_t.min_str) : 0;
+        install_cjson_item_string((void**)&data_type_x->data_type_float_t.max_str, max.val, max.val_len);
+        data_type_x->data_type_float_t.max = data_type_x->data_type_float_t.max_str ? atof(data_type_x->data_type_float_t.max_str) : 0;
+        install_cjson_item_string((void**)&data_type_x->data_type_float_t.unit, unit.val, unit.val_len);
+        install_cjson_item_string((void**)&data_type_x->data_type_float_t.unit_name, unit_name.val, unit_name.val_len);
+#endif
+        install_data_type_float_value(data_type_x);
+    } else if (type == data_type_type_double) {
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), min.val, min.val_len);
+        data_type_x->data_type_double_t.min = atof(temp_buf);
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), max.val, max.val_len);
+        data_type_x->data_type_double_t.max = atof(temp_buf);
+#else
+        install_cjson_item_string((void**)&data_type_x->data_type_double_t.min_str, min.val, min.val_len);
+        data_type_x->data_type_double_t.min = data_type_x->data_type_double_t.min_str ? atof(data_type_x->data_type_double_t.min_str) : 0;
+        install_cjson_item_string((void**)&data_type_x->data_type_double_t.max_str, max.val, max.val_len);
+        data_type_x->data_type_double_t.max = data_type_x->data_type_double_t.max_str ? atof(data_type_x->data_type_double_t.max_str) : 0;
+        install_cjson_item_string((void**)&data_type_x->data_type_double_t.unit, unit.val, unit.val_len);
+        install_cjson_item_string((void**)&data_type_x->data_type_double_t.unit_name, unit_name.val, unit_name.val_len);
+#endif
+        install_data_type_double_value(data_type_x);
+    } else if (type == data_type_type_enum) {
+        data_type_x->data_type_enum_t.enum_item_number = item_number;
+
+        if (data_type_x->data_type_enum_t.enum_item_number == 0) {
+            data_type_x->data_type_enum_t.enum_item_key = NULL;
+            data_type_x->data_type_enum_t.enum_item_value = NULL;
+            return;
+        }
+
+        data_type_x->data_type_enum_t.enum_item_key = (char**)dm_thing_template_calloc(1, data_type_x->data_type_enum_t.enum_item_number * sizeof(char**));
 #ifdef LITE_THING_MODEL
-        data_type_x->data_type_enum_t.enum_item_key = (char**)dm_lite_calloc(1, data_type_x->data_type_enum_t.enum_item_number * sizeof(char **));
         assert(data_type_x->data_type_enum_t.enum_item_key);
         if (data_type_x->data_type_enum_t.enum_item_key == NULL) {
             data_type_x->data_type_enum_t.enum_item_number = 0;
             return;
         }
 #else
-        data_type_x->data_type_enum_t.enum_item_key = (char**)dm_lite_calloc(1, data_type_x->data_type_enum_t.enum_item_number * sizeof(char **));
-        data_type_x->data_type_enum_t.enum_item_value = (char**)dm_lite_calloc(1, data_type_x->data_type_enum_t.enum_item_number * sizeof(char **));
+        data_type_x->data_type_enum_t.enum_item_value = (char**)dm_thing_template_calloc(1, data_type_x->data_type_enum_t.enum_item_number * sizeof(char**));
 
         assert(data_type_x->data_type_enum_t.enum_item_key && data_type_x->data_type_enum_t.enum_item_value);
         if (data_type_x->data_type_enum_t.enum_item_key == NULL || data_type_x->data_type_enum_t.enum_item_value == NULL) {
             data_type_x->data_type_enum_t.enum_item_number = 0;
             return;
         }
+        install_cjson_item_enum_value(data_type_x->data_type_enum_t.enum_item_value, item_number, src, src_len);
 #endif
-        for (index = 0; index < data_type_x->data_type_enum_t.enum_item_number; ++index) {
-            dm_snprintf(temp_buf, sizeof(temp_buf), "%d", index);
-            current_key = data_type_x->data_type_enum_t.enum_item_key + index;
-            *current_key = dm_lite_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
-            assert(*current_key);
-            strcpy(*current_key, temp_buf);
-#ifndef LITE_THING_MODEL
-            current_val = data_type_x->data_type_enum_t.enum_item_value + index;
-            install_cjson_item_string((void **)current_val, temp_buf, src, src_len);
-#endif
-        }
-        data_type_x->data_type_enum_t.value = atoi(*data_type_x->data_type_enum_t.enum_item_key);
-        data_type_x->data_type_enum_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
-        assert(data_type_x->data_type_enum_t.value_str);
-        dm_sprintf(data_type_x->data_type_enum_t.value_str, "%d", data_type_x->data_type_enum_t.value);
-
+        install_data_type_enum_value(data_type_x);
     } else if (type == data_type_type_bool) {
         data_type_x->data_type_bool_t.bool_item_number = 2;
-        data_type_x->data_type_bool_t.bool_item_key = (char**)dm_lite_calloc(1, data_type_x->data_type_bool_t.bool_item_number * sizeof(char **));
+        data_type_x->data_type_bool_t.bool_item_key = (char**)dm_thing_template_calloc(1, data_type_x->data_type_bool_t.bool_item_number * sizeof(char**));
 #ifndef LITE_THING_MODEL
-        data_type_x->data_type_bool_t.bool_item_value = (char**)dm_lite_calloc(1, data_type_x->data_type_bool_t.bool_item_number * sizeof(char **));
+        data_type_x->data_type_bool_t.bool_item_value = (char**)dm_thing_template_calloc(1, data_type_x->data_type_bool_t.bool_item_number * sizeof(char**));
 
         assert(data_type_x->data_type_bool_t.bool_item_key && data_type_x->data_type_bool_t.bool_item_value);
+        if (data_type_x->data_type_bool_t.bool_item_value) {
+            install_cjson_item_enum_value(data_type_x->data_type_bool_t.bool_item_value, 2, src, src_len);
+        }
 #else
         assert(data_type_x->data_type_bool_t.bool_item_key);
 #endif
-        for (index = 0; index < data_type_x->data_type_bool_t.bool_item_number; ++index) {
-            dm_snprintf(temp_buf, sizeof(temp_buf), "%d", index);
-            current_key = data_type_x->data_type_bool_t.bool_item_key + index;
-            *current_key = dm_lite_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
-            assert(*current_key);
-            strcpy(*current_key, temp_buf);
-#ifndef LITE_THING_MODEL
-            current_val = data_type_x->data_type_bool_t.bool_item_value + index;
-            install_cjson_item_string((void **)current_val, temp_buf, src, src_len);
-#endif
-        }
-
-        data_type_x->data_type_bool_t.value = 1; /* default value. */
-
-        data_type_x->data_type_bool_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
-        assert(data_type_x->data_type_bool_t.value_str);
-        dm_sprintf(data_type_x->data_type_bool_t.value_str, "%d", data_type_x->data_type_bool_t.value);
+        install_data_type_bool_value(data_type_x);
     } else if (type == data_type_type_text) {
-        /* length */
-#ifdef LITE_THING_MODEL
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, string_length, src, src_len);
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), length.val, length.val_len);
         if (strlen(temp_buf)) {
             data_type_x->data_type_text_t.length = atoi(temp_buf);
         }
 #else
-        install_cjson_item_string((void **)&data_type_x->data_type_text_t.length_str, string_length, src, src_len);
+        install_cjson_item_string((void**)&data_type_x->data_type_text_t.length_str, length.val, length.val_len);
         if (data_type_x->data_type_text_t.length_str) {
             data_type_x->data_type_text_t.length = atoi(data_type_x->data_type_text_t.length_str);
         }
+        install_cjson_item_string((void**)&data_type_x->data_type_text_t.unit, unit.val, unit.val_len);
+        install_cjson_item_string((void**)&data_type_x->data_type_text_t.unit_name, unit_name.val, unit_name.val_len);
 #endif
-        if (data_type_x->data_type_text_t.length < 1) {
-            data_type_x->data_type_text_t.length = 1;
-        }
-#ifndef LITE_THING_MODEL
-        /* unit */
-        install_cjson_item_string((void **)&data_type_x->data_type_text_t.unit, "unit", src, src_len);
-        /* unitName */
-        install_cjson_item_string((void **)&data_type_x->data_type_text_t.unit_name, "unitName", src, src_len);
-#endif
-        data_type_x->data_type_text_t.value = NULL; /* default value. */
+        install_data_type_text_value(data_type_x);
     } else if (type == data_type_type_date) {
-        data_type_x->data_type_date_t.value = 1513406265000; /* ms, UTC. default value. */
-#if !(WIN32)
-		dm_lltoa(__LONG_LONG_MAX__, temp_buf, 10);
-#else
-        dm_lltoa(LLONG_MAX, temp_buf, 10);
-#endif
-        data_type_x->data_type_date_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
-        assert(data_type_x->data_type_date_t.value_str);
-        dm_lltoa(data_type_x->data_type_date_t.value, data_type_x->data_type_date_t.value_str, 10);
-    } else if(type == data_type_type_array){
-#ifdef  LITE_THING_MODEL
-        dm_snprintf(temp_identifiy, sizeof(temp_identifiy), "%s.%s", string_item, string_type);
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, string_size, src, src_len);
+        install_data_type_date_value(data_type_x);
+    } else if (type == data_type_type_array) {
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), size.val, size.val_len);
         data_type_x->data_type_array_t.size = atoi(temp_buf);
-        memset(temp_buf, 0, sizeof(temp_buf));
-        install_cjson_item_string_without_malloc(temp_buf, temp_identifiy, src, src_len);
+        install_cjson_item_string_without_malloc(temp_buf, sizeof(temp_buf), item_type.val, item_type.val_len);
         data_type_x->data_type_array_t.item_type = detect_data_type_type(temp_buf);
-#else
-        install_cjson_item_string((void**)&p_tmp, string_size, src, src_len);
-        data_type_x->data_type_array_t.size = p_tmp ? atoi(p_tmp) : 0;
-        dm_lite_free(p_tmp);
-        p_tmp = NULL;
-        dm_snprintf(temp_identifiy, sizeof(temp_identifiy), "%s.%s", string_item, string_type);
-        install_cjson_item_string((void**)&p_tmp, temp_identifiy, src, src_len);
-        data_type_x->data_type_array_t.item_type = detect_data_type_type(p_tmp);
-        dm_lite_free(p_tmp);
-        p_tmp = NULL;
-#endif
-        data_type_x->data_type_array_t.array = dm_lite_calloc(data_type_x->data_type_array_t.size, get_type_size(data_type_x->data_type_array_t.item_type));
-        if (data_type_x->data_type_array_t.item_type != data_type_type_text) {
-            data_type_x->data_type_array_t.value_str = dm_lite_calloc(data_type_x->data_type_array_t.size, sizeof(char**));
-        }
-    }else {
+        install_data_type_array_value(data_type_x);
+    } else {
         assert(0);
     }
 }
 
-static void install_cjson_item_data_type(void *dst, const char *key, const char *src, int src_len)
+static void install_cjson_item_data_type(void* dst, const char* src, int src_len)
 {
-    char *val = NULL, *dm_val = NULL;
-    char _key_index[KEY_BUFF_SIZE] = {0};
-    int val_len = 0, dm_len = 0;
-    data_type_t *data_type = (data_type_t *)dst;
-    size_t specs_array_size, index;
-    size_t size;
-    lite_property_t *lite_property_item;
+    data_type_t* data_type = (data_type_t*)dst;
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+    tsl_span_t specs = {0};
+    lite_property_t* lite_property_item;
+    size_t index;
 
-    val = LITE_json_value_of_ext2((char*)key, (char*)src, src_len, &val_len);
-    if (!val) {
-        return;
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        if (tsl_key_equal(key, key_len, string_type)) {
+            install_cjson_item_string((void**)&data_type->type_str, val, val_len);
+            if (data_type->type_str) data_type->type = detect_data_type_type(data_type->type_str);
+        } else if (tsl_key_equal(key, key_len, string_specs)) {
+            tsl_span_install(&specs, val, val_len, val_type);
+        }
     }
 
-    dm_val = LITE_json_value_of_ext2((char*)string_type, val, val_len, &dm_len);
-    if (dm_val) {
-        size = dm_len + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC;
-        data_type->type_str = dm_lite_calloc(1, size);
-        assert(data_type->type_str);
-        memset(data_type->type_str, 0, size);
-        strncpy(data_type->type_str, dm_val, size - 1);
-        data_type->type = detect_data_type_type(data_type->type_str);
-    }
+    if (specs.val == NULL) return;
 
-    dm_val = LITE_json_value_of_ext2((char*)string_specs, val, val_len, &dm_len);
-    if (!dm_val) {
-        return;
-    }
     if (data_type->type != data_type_type_struct) {
-        if ('{' != *dm_val) {
-            return;
-        }
+        if (specs.val_type != JOBJECT) return;
+
         data_type->data_type_specs_number = 0;
         data_type->specs = NULL;
-        install_cjson_item_data_type_value((void *)&data_type->value, data_type->type, dm_val, dm_len);
+        install_cjson_item_data_type_value((void*)&data_type->value, data_type->type, specs.val, specs.val_len);
+        return;
+    }
+
+    if (specs.val_type != JARRAY) return;
+
+    data_type->data_type_specs_number = get_json_item_size(specs.val, specs.val_len);
+    if (data_type->data_type_specs_number == 0) {
+        data_type->specs = NULL;
     } else {
-        char *spec_val = NULL;
-        int spec_len = 0;
-        if ('[' != *dm_val) {
-            return;
-        }
-        specs_array_size = get_json_item_size(dm_val, dm_len);
+        data_type->specs = dm_thing_template_calloc(data_type->data_type_specs_number, sizeof(lite_property_t));
+        assert(data_type->specs);
+        if (data_type->specs == NULL) data_type->data_type_specs_number = 0;
+    }
 
-        data_type->data_type_specs_number = specs_array_size;
-        if (data_type->data_type_specs_number == 0) {
-            data_type->specs = NULL;
-        } else {
-            data_type->specs = dm_lite_calloc(data_type->data_type_specs_number, sizeof(lite_property_t));
-            assert(data_type->specs);
-        }
+    memset(&data_type->value, 0, sizeof(data_type_x_t));
 
-        memset(&data_type->value, 0, sizeof(data_type_x_t));
+    index = 0;
+    json_array_for_each_entry(specs.val, specs.val_len, pos, val, val_len, val_type) {
+        if (index >= data_type->data_type_specs_number) break;
+        lite_property_item = (lite_property_t*)data_type->specs + index++;
+        if (val_type == JOBJECT) install_cjson_obj_lite_property(lite_property_item, val, val_len);
+    }
+}
 
-        for (index = 0; index < data_type->data_type_specs_number; ++index) {
-            lite_property_item = (lite_property_t *)data_type->specs + index;
-            snprintf(_key_index, KEY_BUFF_SIZE - 1, "[%lu]", index + 1);
-            spec_val = LITE_json_value_of_ext2(_key_index, dm_val, dm_len, &spec_len);
-            if (spec_val) {
-                lite_property_item = (lite_property_t *)data_type->specs + index;
-                install_cjson_obj_lite_property(lite_property_item, spec_val, spec_len);
-            }
+static void install_cjson_obj_lite_property(void* dst, const char* src, int src_len)
+{
+    lite_property_t* lite_property_item = (lite_property_t*)dst;
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        if (tsl_key_equal(key, key_len, string_identifier)) {
+            install_cjson_item_string((void**)&lite_property_item->identifier, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_dataType) && val_type == JOBJECT) {
+            install_cjson_item_data_type(&lite_property_item->data_type, val, val_len);
         }
+#ifndef LITE_THING_MODEL
+        else if (tsl_key_equal(key, key_len, string_name)) {
+            install_cjson_item_string((void**)&lite_property_item->name, val, val_len);
+        }
+#endif
     }
 }
 
-static void install_cjson_obj_lite_property(void *dst, const char *src, int src_len)
+static void install_cjson_obj_property(property_t* dst, const char* src, int src_len)
 {
-    lite_property_t *lite_property_item = (lite_property_t *)dst;
+    property_t* property = dst;
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
 
-    install_cjson_item_string((void **)&lite_property_item->identifier, string_identifier, src, src_len);
+    property->name = NULL;
+    property->desc = NULL;
+    property->required = 1;
+
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        if (tsl_key_equal(key, key_len, string_identifier)) {
+            install_cjson_item_string((void**)&property->identifier, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_required)) {
+            install_cjson_item_bool((void*)&property->required, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_accessMode)) {
+            property->access_mode = val_len == 2 ? property_access_mode_rw :
+                                                   (val_len == 1 && *val == 'r' ? property_access_mode_r : property_access_mode_w);
+        } else if (tsl_key_equal(key, key_len, string_dataType) && val_type == JOBJECT) {
+            install_cjson_item_data_type(&property->data_type, val, val_len);
+        }
 #ifndef LITE_THING_MODEL
-    install_cjson_item_string((void **)&lite_property_item->name, string_name, src, src_len);
+        else if (tsl_key_equal(key, key_len, string_name)) {
+            install_cjson_item_string((void**)&property->name, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_desc)) {
+            install_cjson_item_string((void**)&property->desc, val, val_len);
+        }
 #endif
-    install_cjson_item_data_type(&lite_property_item->data_type, string_dataType, src, src_len);
+    }
 }
 
-static void install_cjson_item_input_data(void *dst, service_type_t service_type, const char *src, int src_len)
+static void install_cjson_item_input_data(void* dst, service_type_t service_type, const char* src, int src_len)
 {
-    input_data_t *input_data_item = (input_data_t *)dst;
-    int property_to_get_name_size = 0;
+    input_data_t* input_data_item = (input_data_t*)dst;
+
     if (service_type == service_type_others) {
         install_cjson_obj_lite_property(&input_data_item->lite_property, src, src_len);
     } else if (service_type == service_type_property_set) {
         install_cjson_obj_property(&input_data_item->property_to_set, src, src_len);
     } else if (service_type == service_type_property_get) {
-        property_to_get_name_size = src_len + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC;
-        input_data_item->property_to_get_name = (char*)dm_lite_calloc(1, property_to_get_name_size);
-        strncpy(input_data_item->property_to_get_name, src, property_to_get_name_size - 1);
+        install_cjson_item_string((void**)&input_data_item->property_to_get_name, src, src_len);
     }
 }
 
-static int install_cjson_item_string(void **dst, const char *key, const char *src, int src_len)
+/* size and fill a lite property array, like outputData of event and service. */
+static size_t install_cjson_arr_lite_property(lite_property_t** dst, const tsl_span_t* span)
 {
-    int val_len = 0;
-    char *val = LITE_json_value_of_ext2((char*)key, (char*)src, src_len, &val_len);
-    size_t size;
+    char *pos, *val;
+    int val_len, val_type;
+    size_t number;
+    size_t index = 0;
 
-    if (*dst) dm_lite_free(*dst);
-
-    if (val) {
-        size = val_len + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC;
-        *dst = dm_lite_calloc(1, size);
-        assert(*dst);
-        memset(*dst, 0, size);
-        strncpy(*dst, val, val_len);
-    } else {
-        dm_log_err("parse key:%s from val:%.*s failed", key, src_len, src);
-    }
+    number = get_json_item_size(span->val, span->val_len);
+    if (number == 0) return 0;
 
-    return val ? 0 : -1;
-}
+    *dst = (lite_property_t*)dm_thing_template_calloc(number, sizeof(lite_property_t));
+    assert(*dst);
+    if (*dst == NULL) return 0;
 
-#ifdef LITE_THING_MODEL
-static void install_cjson_item_string_without_malloc(void *dst, const char *key, const char *src, int src_len)
-{
-    int val_len = 0;
-    char *val = LITE_json_value_of_ext2((char*)key, (char*)src, src_len, &val_len);
-    if (val) {
-        strncpy(dst, val, val_len);
-    } else {
-        dm_log_err("parse key:%s from val:%.*s failed", key, src_len, src);
-    }
-    return;
-}
-#endif
-
-static void install_cjson_item_bool(void *dst, const char *key, const char *src, int src_len)
-{
-    char *bool_val = NULL;
-    int bool_val_len = 0;
-    int *val = dst;
-
-    *val = 1;
-    bool_val = LITE_json_value_of_ext2((char*)key, (char*)src, src_len, &bool_val_len);
-
-    if (bool_val) {
-        if (!strncmp(bool_val, string_false, bool_val_len)) {
-            *val = 0;
-        }
+    json_array_for_each_entry(span->val, span->val_len, pos, val, val_len, val_type) {
+        if (index >= number) break;
+        if (val_type == JOBJECT) install_cjson_obj_lite_property(*dst + index, val, val_len);
+        index++;
     }
 
-    return;
+    return number;
 }
 
-static void install_cjson_obj_property(property_t *dst, const char *src, int src_len)
+static void parse_cjson_obj_to_dsl_template_properties(void* _self, const char* src, int src_len)
 {
-    property_t *property = dst;
-    char *temp_str = NULL;
-
-    /* properties.identifier */
-    install_cjson_item_string((void **)&property->identifier, string_identifier, src, src_len);
-#ifdef LITE_THING_MODEL
-    property->name = NULL;
-    property->desc = NULL;
-#else
-    /* properties.name */
-    install_cjson_item_string((void **)&property->name, string_name, src, src_len);
-    /* properties.desc */
-    install_cjson_item_string((void **)&property->desc, string_desc, src, src_len);
-#endif
-    /* properties.required */
-    install_cjson_item_bool((void *)&property->required, string_required, src, src_len);
-    /* properties.accessMode */
-    install_cjson_item_string((void **)&temp_str, string_accessMode, src, src_len);
-    if (temp_str) {
-        property->access_mode = strlen(temp_str) == 2 ? property_access_mode_rw :
-                                                        (strcmp(temp_str, "r") == 0 ? property_access_mode_r : property_access_mode_w);
-        dm_lite_free(temp_str);
-    }
-    install_cjson_item_data_type(&property->data_type, string_dataType, src, src_len);
-    return;
-}
-
-static void parse_cjson_obj_to_dsl_template_properties(void *_self, const char *src, int src_len)
-{
-    char _key[KEY_BUFF_SIZE] = {0};
-    char *val = NULL;
-    int val_len = 0;
-
-    dm_thing_t *self = _self;
-    int properties_array_size;
-    int index;
-    property_t *property;
-
-    properties_array_size = get_json_item_size((char*)src, src_len);
+    dm_thing_t* self = _self;
+    char *pos, *val;
+    int val_len, val_type;
+    int index = 0;
 
-    self->dsl_template.property_number = properties_array_size;
+    self->dsl_template.property_number = get_json_item_size((char*)src, src_len);
 
     if (self->dsl_template.property_number == 0) {
         return;
     }
 
-    self->dsl_template.properties = (property_t *)dm_lite_calloc(self->dsl_template.property_number, sizeof(property_t));
+    self->dsl_template.properties = (property_t*)dm_thing_template_calloc(self->dsl_template.property_number, sizeof(property_t));
 
     assert(self->dsl_template.properties);
     if (self->dsl_template.properties == 0) {
@@ -742,107 +1311,78 @@ static void parse_cjson_obj_to_dsl_template_properties(void *_self, const char *
         return;
     }
 
-    if (src) {
-        for (index = 0; index < self->dsl_template.property_number; ++index) {
-            snprintf(_key, KEY_BUFF_SIZE - 1, "[%d]", index + 1);
-            property = self->dsl_template.properties + index;
-
-            val = LITE_json_value_of_ext2(_key, (char*)src, src_len, &val_len);
-            if (val) {
-                install_cjson_obj_property(property, val, val_len);
-            }
-
-        }
+    json_array_for_each_entry((char*)src, src_len, pos, val, val_len, val_type) {
+        if (index >= self->dsl_template.property_number) break;
+        if (val_type == JOBJECT) install_cjson_obj_property(self->dsl_template.properties + index, val, val_len);
+        index++;
     }
 }
 
-
-static void install_cjson_obj_event(event_t *dst, const char *src, int src_len)
+static void install_cjson_obj_event(event_t* dst, const char* src, int src_len)
 {
-    char _key_index[KEY_BUFF_SIZE] = {0};
-    char *val = NULL;
-    int val_len = 0;
-    char *dm_val = NULL;
-    int dm_val_len = 0;
-    event_t *event = dst;
-    int output_data_array_size;
-    int output_data_index;
-    lite_property_t *output_data_item;
-
-    /* events.identifier */
-    install_cjson_item_string((void **)&event->identifier, string_identifier, src, src_len);
-#ifndef LITE_THING_MODEL
-    /* events.name */
-    install_cjson_item_string((void **)&event->name, string_name, src, src_len);
-    /* events.desc */
-    install_cjson_item_string((void **)&event->desc, string_desc, src, src_len);
-#endif
-    /* events.method */
-    install_cjson_item_string((void **)&event->method, string_method, src, src_len);
-    /* events.required */
-    install_cjson_item_bool((void *)&event->required, string_required, src, src_len);
-    /* events.type */
-    install_cjson_item_string((void **)&event->event_type_str, string_type, src, src_len);
-    if (strcmp(event->event_type_str, string_info) == 0) {
-        event->event_type = event_type_info;
-    } else if (strcmp(event->event_type_str, string_alert) == 0) {
-        event->event_type = event_type_alert;
-    } else if (strcmp(event->event_type_str, string_error) == 0) {
-        event->event_type = event_type_error;
-    }
-
-#ifdef LITE_THING_MODEL
-    if (strcmp(event->method, string_thing_event_property_post) == 0) {
-        return;
-    }
-#endif
-
-    val = LITE_json_value_of_ext2((char*)string_outputData, (char*)src, src_len, &val_len);
-    if (val) {
-        output_data_array_size = get_json_item_size(val, val_len);
-        event->event_output_data_num = output_data_array_size;
-        if (event->event_output_data_num == 0) {
-            return;
+    event_t* event = dst;
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+    tsl_span_t output_data = {0};
+
+    event->required = 1;
+
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        if (tsl_key_equal(key, key_len, string_identifier)) {
+            install_cjson_item_string((void**)&event->identifier, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_method)) {
+            install_cjson_item_string((void**)&event->method, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_required)) {
+            install_cjson_item_bool((void*)&event->required, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_type)) {
+            install_cjson_item_string((void**)&event->event_type_str, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_outputData) && val_type == JARRAY) {
+            tsl_span_install(&output_data, val, val_len, val_type);
         }
-
-        event->event_output_data = (lite_property_t *)dm_lite_calloc(event->event_output_data_num, sizeof(lite_property_t));
-        assert(event->event_output_data);
-
-        if (event->event_output_data == NULL) {
-            event->event_output_data_num = 0;
-            return;
+#ifndef LITE_THING_MODEL
+        else if (tsl_key_equal(key, key_len, string_name)) {
+            install_cjson_item_string((void**)&event->name, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_desc)) {
+            install_cjson_item_string((void**)&event->desc, val, val_len);
         }
+#endif
     }
 
-    for (output_data_index = 0; output_data_index < event->event_output_data_num; ++output_data_index) {
-        output_data_item = event->event_output_data + output_data_index;
-        snprintf(_key_index, KEY_BUFF_SIZE - 1, "[%d]", output_data_index + 1);
-        dm_val = LITE_json_value_of_ext2(_key_index, val, val_len, &dm_val_len);
-        if (dm_val) {
-            install_cjson_obj_lite_property(output_data_item, dm_val, dm_val_len);
+    if (event->event_type_str) {
+        if (strcmp(event->event_type_str, string_info) == 0) {
+            event->event_type = event_type_info;
+        } else if (strcmp(event->event_type_str, string_alert) == 0) {
+            event->event_type = event_type_alert;
+        } else if (strcmp(event->event_type_str, string_error) == 0) {
+            event->event_type = event_type_error;
         }
     }
+
+#ifdef LITE_THING_MODEL
+    if (event->method && strcmp(event->method, string_thing_event_property_post) == 0) {
+        return;
+    }
+#endif
+
+    if (output_data.val) {
+        event->event_output_data_num = install_cjson_arr_lite_property(&event->event_output_data, &output_data);
+    }
 }
 
-static void parse_cjson_obj_to_dsl_template_events(void *_self, const char *src, int src_len)
+static void parse_cjson_obj_to_dsl_template_events(void* _self, const char* src, int src_len)
 {
-    char *val = NULL;
-    char _key[KEY_BUFF_SIZE] = {0};
-    dm_thing_t *self = _self;
-    int events_array_size;
-    int index;
-    int val_len = 0;
-    event_t *event;
-
-    events_array_size = get_json_item_size((char*)src, src_len);
+    dm_thing_t* self = _self;
+    char *pos, *val;
+    int val_len, val_type;
+    int index = 0;
 
-    self->dsl_template.event_number = events_array_size;
+    self->dsl_template.event_number = get_json_item_size((char*)src, src_len);
 
     if (self->dsl_template.event_number == 0) {
         return;
     }
 
-    self->dsl_template.events = (event_t *)dm_lite_calloc(self->dsl_template.event_number, sizeof(event_t));
+    self->dsl_template.events = (event_t*)dm_thing_template_calloc(self->dsl_template.event_number, sizeof(event_t));
 
     assert(self->dsl_template.events);
     if (self->dsl_template.events == NULL) {
@@ -851,198 +1391,168 @@ static void parse_cjson_obj_to_dsl_template_events(void *_self, const char *src,
         return;
     }
 
-    for (index = 0; index < self->dsl_template.event_number; ++index) {
-        event = self->dsl_template.events + index;
-        snprintf(_key, KEY_BUFF_SIZE - 1, "[%d]", index + 1);
-        val = LITE_json_value_of_ext2(_key, (char*)src, src_len, &val_len);
-        if (val) {
-            install_cjson_obj_event(event, val, val_len);
-        }
+    json_array_for_each_entry((char*)src, src_len, pos, val, val_len, val_type) {
+        if (index >= self->dsl_template.event_number) break;
+        if (val_type == JOBJECT) install_cjson_obj_event(self->dsl_template.events + index, val, val_len);
+        index++;
     }
 }
 
-static void install_cjson_obj_service(service_t *dst, const char *src, int src_len)
+static void install_cjson_obj_service(service_t* dst, const char* src, int src_len)
 {
-    char _key_index[KEY_BUFF_SIZE] = {0};
-    char *val = NULL;
-    int val_len = 0;
-    char *dm_val = NULL;
-    int dm_val_len = 0;
-
-    service_t *service = dst;
-    int output_data_array_size, input_data_array_size;
-    int output_data_index, input_data_index;
-    lite_property_t *output_data_item;
-    input_data_t *input_data_item;
-
-    /* service.identifier */
-    install_cjson_item_string((void **)&service->identifier, string_identifier, src, src_len);
+    service_t* service = dst;
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+    tsl_span_t output_data = {0}, input_data = {0};
+    size_t input_data_index = 0;
+
+    service->required = 1;
+
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        if (tsl_key_equal(key, key_len, string_identifier)) {
+            install_cjson_item_string((void**)&service->identifier, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_method)) {
+            install_cjson_item_string((void**)&service->method, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_callType)) {
+            install_cjson_item_string((void**)&service->call_type, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_required)) {
+            install_cjson_item_bool((void*)&service->required, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_outputData) && val_type == JARRAY) {
+            tsl_span_install(&output_data, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, string_inputData) && val_type == JARRAY) {
+            tsl_span_install(&input_data, val, val_len, val_type);
+        }
 #ifndef LITE_THING_MODEL
-    /* service.name */
-    install_cjson_item_string((void **)&service->name, string_name, src, src_len);
-    /* service.desc */
-    install_cjson_item_string((void **)&service->desc, string_desc, src, src_len);
+        else if (tsl_key_equal(key, key_len, string_name)) {
+            install_cjson_item_string((void**)&service->name, val, val_len);
+        } else if (tsl_key_equal(key, key_len, string_desc)) {
+            install_cjson_item_string((void**)&service->desc, val, val_len);
+        }
 #endif
-    /* service.method */
-    install_cjson_item_string((void **)&service->method, string_method, src, src_len);
-    /* service.call_type */
-    install_cjson_item_string((void **)&service->call_type, string_callType, src, src_len);
-    /* service.required */
-    install_cjson_item_bool((void *)&service->required, string_required, src, src_len);
+    }
 
-    if (strcmp(service->method, string_thing_service_property_set) == 0) {
+    if (service->method && strcmp(service->method, string_thing_service_property_set) == 0) {
         service->service_type = service_type_property_set;
-    } else if (strcmp(service->method, string_thing_service_property_get) == 0) {
+    } else if (service->method && strcmp(service->method, string_thing_service_property_get) == 0) {
         service->service_type = service_type_property_get;
     } else {
         service->service_type = service_type_others;
     }
 
     /* output data process */
-    val = LITE_json_value_of_ext2((char*)string_outputData, (char*)src, src_len, &val_len);
 #ifdef LITE_THING_MODEL
-    if (val && (service->service_type != service_type_property_get))
+    if (output_data.val && (service->service_type != service_type_property_get))
 #else
-    if (val)
+    if (output_data.val)
 #endif
     {
-        output_data_array_size = get_json_item_size(val, val_len);
-        service->service_output_data_num = output_data_array_size;
-
-        if (service->service_output_data_num) {
-            if (service->service_output_data_num) {
-                service->service_output_data = (lite_property_t *)dm_lite_calloc(service->service_output_data_num,
-                                                                                 sizeof(lite_property_t));
-                assert(service->service_output_data);
-                if (service->service_output_data == NULL) {
-                    service->service_output_data_num = 0;
-                }
-            } else {
-                service->service_output_data = NULL;
-            }
-        }
-    }
-
-    for (output_data_index = 0; output_data_index < service->service_output_data_num; ++output_data_index) {
-        output_data_item = service->service_output_data + output_data_index;
-        snprintf(_key_index, KEY_BUFF_SIZE, "[%d]", output_data_index + 1);
-        dm_val = LITE_json_value_of_ext2(_key_index, val, val_len, &dm_val_len);
-        install_cjson_obj_lite_property(output_data_item, dm_val, dm_val_len);
+        service->service_output_data_num = install_cjson_arr_lite_property(&service->service_output_data, &output_data);
     }
 
     /* input data process */
     service->service_input_data_num = 0;
-    val = LITE_json_value_of_ext2((char*)string_inputData, (char*)src, src_len, &val_len);
 #ifdef LITE_THING_MODEL
-    if (val && (service->service_type != service_type_property_set))
+    if (input_data.val && (service->service_type != service_type_property_set))
 #else
-    if (val)
+    if (input_data.val)
 #endif
     {
-        input_data_array_size = get_json_item_size(val, val_len);
-        service->service_input_data_num = input_data_array_size;
-        service->service_input_data = (input_data_t *)dm_lite_calloc(service->service_input_data_num, sizeof(input_data_t));
+        service->service_input_data_num = get_json_item_size(input_data.val, input_data.val_len);
+        if (service->service_input_data_num == 0) return;
+
+        service->service_input_data = (input_data_t*)dm_thing_template_calloc(service->service_input_data_num, sizeof(input_data_t));
         if (service->service_input_data == NULL) {
             service->service_input_data_num = 0;
+            return;
         }
-    }
-    for (input_data_index = 0; input_data_index < service->service_input_data_num; ++input_data_index) {
-        input_data_item = service->service_input_data + input_data_index;
-        snprintf(_key_index, KEY_BUFF_SIZE, "[%d]", input_data_index + 1);
-        dm_val = LITE_json_value_of_ext2(_key_index, val, val_len, &dm_val_len);
-        if (dm_val) {
-            install_cjson_item_input_data(input_data_item, service->service_type, dm_val, dm_val_len);
+
+        json_array_for_each_entry(input_data.val, input_data.val_len, pos, val, val_len, val_type) {
+            if (input_data_index >= service->service_input_data_num) break;
+            install_cjson_item_input_data(service->service_input_data + input_data_index++, service->service_type, val, val_len);
         }
     }
 }
 
-static void parse_cjson_obj_to_dsl_template_services(void *_self, const char *src, int src_len)
+static void parse_cjson_obj_to_dsl_template_services(void* _self, const char* src, int src_len)
 {
-    char _key[KEY_BUFF_SIZE] = {0};
-    dm_thing_t *self = _self;
-
-    int sercives_array_size;
-    int index;
-    service_t *service;
+    dm_thing_t* self = _self;
+    char *pos, *val;
+    int val_len, val_type;
+    int index = 0;
 
-    char *val = NULL;
-    int val_len = 0;
+    self->dsl_template.service_number = get_json_item_size((char*)src, src_len);
 
-    sercives_array_size = get_json_item_size((char*)src, src_len);
+    if (self->dsl_template.service_number == 0) {
+        return;
+    }
 
-    self->dsl_template.service_number = sercives_array_size;
-    self->dsl_template.services = (service_t *)dm_lite_calloc(self->dsl_template.service_number, sizeof(service_t));
+    self->dsl_template.services = (service_t*)dm_thing_template_calloc(self->dsl_template.service_number, sizeof(service_t));
 
     if (self->dsl_template.services == NULL) {
         self->dsl_template.service_number = 0;
-        dm_log_err("self->dsl_template.events malloc fail");
+        dm_log_err("self->dsl_template.services malloc fail");
         return;
     }
 
-    for (index = 0; index < self->dsl_template.service_number; ++index) {
-        service = self->dsl_template.services + index;
-        snprintf(_key, KEY_BUFF_SIZE, "[%d]", index + 1);
-        val = LITE_json_value_of_ext2(_key, (char*)src, src_len, &val_len);
-        if (val) {
-            install_cjson_obj_service(service, val, val_len);
-        }
+    json_array_for_each_entry((char*)src, src_len, pos, val, val_len, val_type) {
+        if (index >= self->dsl_template.service_number) break;
+        if (val_type == JOBJECT) install_cjson_obj_service(self->dsl_template.services + index, val, val_len);
+        index++;
     }
 }
 
-static int parse_cjson_obj_to_dsl_template(void *_self, const char *src, int src_len)
+static int parse_cjson_obj_to_dsl_template(void* _self, const char* src, int src_len)
 {
-    if(!_self || !src || src_len <= 0) {
+    dm_thing_t* self = _self;
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+    tsl_span_t properties = {0}, events = {0}, services = {0}, profile = {0};
+
+    if (!_self || !src || src_len <= 0) {
         return -1;
     }
 
-    dm_thing_t *self = _self;
-    char *val = NULL;
-    int val_len = 0;
-#ifdef LITE_THING_MODEL
     self->dsl_template.schema = NULL;
     self->dsl_template.link = NULL;
-#else
-    /* schema */
-    if(0 != install_cjson_item_string((void **)&self->dsl_template.schema, "schema", src, src_len)) {
-        dm_log_err("parse schema fail");
-    }
-    /* link */
-    if(0 != install_cjson_item_string((void **)&self->dsl_template.link, "link", src, src_len)) {
-        dm_log_err("parse link fail");
-    }
-#endif
 
-    /* profile */
-    if(0 != install_cjson_item_string((void **)&self->dsl_template.profile.product_key, string_profile_productKey, src, src_len)) {
-        self->dsl_template.profile.product_key = NULL;
-    }
-    if(0 != install_cjson_item_string((void **)&self->dsl_template.profile.device_name, string_profile_deviceName, src, src_len)) {
-        self->dsl_template.profile.device_name = NULL;
+    json_object_for_each_kv((char*)src, src_len, pos, key, key_len, val, val_len, val_type) {
+        if (tsl_key_equal(key, key_len, string_properties) && val_type == JARRAY) {
+            tsl_span_install(&properties, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, string_events) && val_type == JARRAY) {
+            tsl_span_install(&events, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, string_services) && val_type == JARRAY) {
+            tsl_span_install(&services, val, val_len, val_type);
+        } else if (tsl_key_equal(key, key_len, string_profile) && val_type == JOBJECT) {
+            tsl_span_install(&profile, val, val_len, val_type);
+        }
+#ifndef LITE_THING_MODEL
+        else if (tsl_key_equal(key, key_len, "schema")) {
+            install_cjson_item_string((void**)&self->dsl_template.schema, val, val_len);
+        } else if (tsl_key_equal(key, key_len, "link")) {
+            install_cjson_item_string((void**)&self->dsl_template.link, val, val_len);
+        }
+#endif
     }
 
-    /* properties */
-    val = LITE_json_value_of_ext2((char*)string_properties, (char*)src, src_len, &val_len);
-    if (val) {
-        parse_cjson_obj_to_dsl_template_properties(self, val, val_len);
-    }else {
-        return -1;
+    /* profile */
+    if (profile.val) {
+        json_object_for_each_kv(profile.val, profile.val_len, pos, key, key_len, val, val_len, val_type) {
+            if (tsl_key_equal(key, key_len, string_productKey)) {
+                install_cjson_item_string((void**)&self->dsl_template.profile.product_key, val, val_len);
+            } else if (tsl_key_equal(key, key_len, string_deviceName)) {
+                install_cjson_item_string((void**)&self->dsl_template.profile.device_name, val, val_len);
+            }
+        }
     }
 
-    /* events */
-    val = LITE_json_value_of_ext2((char*)string_events, (char*)src, src_len, &val_len);
-    if (val) {
-        parse_cjson_obj_to_dsl_template_events(self, val, val_len);
-    }else {
+    if (properties.val == NULL || events.val == NULL || services.val == NULL) {
+        dm_log_err("tsl lack of properties, events or services");
         return -1;
     }
 
-    /* services */
-    val = LITE_json_value_of_ext2((char*)string_services, (char*)src, src_len, &val_len);
-    if (val) {
-        parse_cjson_obj_to_dsl_template_services(self, val, val_len);
-    }else {
-        return -1;
-    }
+    parse_cjson_obj_to_dsl_template_properties(self, properties.val, properties.val_len);
+    parse_cjson_obj_to_dsl_template_events(self, events.val, events.val_len);
+    parse_cjson_obj_to_dsl_template_services(self, services.val, services.val_len);
 
     return 0;
 }
@@ -1051,8 +1561,26 @@ static int dm_thing_set_dsl_string(void *_self, const char *src, int src_len)
 {
     int ret;
     dm_thing_t *self = _self;
+
+    if (dm_tsl_blob_detect(src, src_len)) return dm_thing_set_dsl_blob(self, src, src_len);
+
+#ifdef DM_THING_ARENA_ENABLED
+    if (dm_arena_is_active(&self->_arena) || dm_arena_init(&self->_arena, src_len) == 0) {
+        _g_dm_thing_arena = &self->_arena;
+    }
+#endif
+
     ret = parse_cjson_obj_to_dsl_template(self, src, src_len);
 
+#ifdef DM_THING_ARENA_ENABLED
+    _g_dm_thing_arena = NULL;
+    dm_arena_seal(&self->_arena);
+#endif
+
+    if (ret == 0) {
+        ret = dm_thing_build_identifier_index(self);
+    }
+
     self->_json_object = 0;
 
     return ret;
@@ -1072,11 +1600,13 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
 #ifndef LITE_THING_MODEL
     char** current_val;
 #endif
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
     long long long_val;
+#endif
 
     if (type == data_type_type_int) {
         /* min */
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         memset(temp_buf, 0, sizeof(temp_buf));
         install_cjson_item_string_without_malloc(temp_buf, data_type_obj, string_min);
         data_type_x->data_type_int_t.min = atoi(temp_buf);
@@ -1086,7 +1616,7 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
 #endif
 
         /* max */
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         memset(temp_buf, 0, sizeof(temp_buf));
         install_cjson_item_string_without_malloc(temp_buf, data_type_obj, string_max);
         data_type_x->data_type_int_t.max = atoi(temp_buf);
@@ -1113,7 +1643,7 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
         data_type_x->data_type_int_t.precise = 0;
 #endif
 
-#ifndef LITE_THING_MODEL
+#if !defined(LITE_THING_MODEL) && !defined(DM_THING_COMPACT_VALUE_ENABLED)
         /* unit */
         install_cjson_item_string((void**)&data_type_x->data_type_int_t.unit, data_type_obj, "unit");
         /* unitName */
@@ -1121,14 +1651,16 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
 #endif
         data_type_x->data_type_int_t.value = (data_type_x->data_type_int_t.min + data_type_x->data_type_int_t.max) / 2; /* default value? */
 
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         long_val = data_type_x->data_type_int_t.max;
-        dm_lltoa(long_val, temp_buf, 10);
+        LITE_format_llong(temp_buf, long_val);
         data_type_x->data_type_int_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_int_t.precise  + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
         assert(data_type_x->data_type_int_t.value_str);
-        dm_sprintf(data_type_x->data_type_int_t.value_str, "%d", data_type_x->data_type_int_t.value);
+        LITE_format_llong(data_type_x->data_type_int_t.value_str, data_type_x->data_type_int_t.value);
+#endif
     } else if (type == data_type_type_float) {
         /* min */
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         memset(temp_buf, 0, sizeof(temp_buf));
         install_cjson_item_string_without_malloc(temp_buf, data_type_obj, string_min);
         data_type_x->data_type_float_t.min = atof(temp_buf);
@@ -1137,7 +1669,7 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
         data_type_x->data_type_float_t.min = atof(data_type_x->data_type_float_t.min_str);
 #endif
         /* max */
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         memset(temp_buf, 0, sizeof(temp_buf));
         install_cjson_item_string_without_malloc(temp_buf, data_type_obj, string_max);
         data_type_x->data_type_float_t.max = atof(temp_buf);
@@ -1164,21 +1696,23 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
         data_type_x->data_type_float_t.precise = 7;
 #endif
 
-#ifndef LITE_THING_MODEL
+#if !defined(LITE_THING_MODEL) && !defined(DM_THING_COMPACT_VALUE_ENABLED)
         /* unit */
         install_cjson_item_string((void**)&data_type_x->data_type_float_t.unit, data_type_obj, "unit");
         /* unitName */
         install_cjson_item_string((void**)&data_type_x->data_type_float_t.unit_name, data_type_obj, "unitName");
 #endif
         data_type_x->data_type_float_t.value = (data_type_x->data_type_float_t.min + data_type_x->data_type_float_t.max) / 2; /* default value? */
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         long_val = (long long)data_type_x->data_type_float_t.max;
-        dm_lltoa(long_val, temp_buf, 10);
+        LITE_format_llong(temp_buf, long_val);
         data_type_x->data_type_float_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_float_t.precise + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
         assert(data_type_x->data_type_float_t.value_str);
         sprintf_float_double_precise(data_type_x->data_type_float_t.value_str, data_type_x->data_type_float_t.value, data_type_x->data_type_float_t.precise);
+#endif
     } else if (type == data_type_type_double) {
         /* min */
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         memset(temp_buf, 0, sizeof(temp_buf));
         install_cjson_item_string_without_malloc(temp_buf, data_type_obj, string_min);
         data_type_x->data_type_double_t.min = atof(temp_buf);
@@ -1187,7 +1721,7 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
         data_type_x->data_type_double_t.min = atof(data_type_x->data_type_double_t.min_str);
 #endif
         /* max */
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         memset(temp_buf, 0, sizeof(temp_buf));
         install_cjson_item_string_without_malloc(temp_buf, data_type_obj, string_max);
         data_type_x->data_type_double_t.max = atof(temp_buf);
@@ -1214,18 +1748,20 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
         data_type_x->data_type_double_t.precise = 16;
 #endif
 
-#ifndef LITE_THING_MODEL
+#if !defined(LITE_THING_MODEL) && !defined(DM_THING_COMPACT_VALUE_ENABLED)
         /* unit */
         install_cjson_item_string((void**)&data_type_x->data_type_double_t.unit, data_type_obj, "unit");
         /* unitName */
         install_cjson_item_string((void**)&data_type_x->data_type_double_t.unit_name, data_type_obj, "unitName");
 #endif
         data_type_x->data_type_double_t.value = (data_type_x->data_type_double_t.min + data_type_x->data_type_double_t.max) / 2; /* default value? */
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         long_val = (long long)data_type_x->data_type_double_t.max;
-        dm_lltoa(long_val, temp_buf, 10);
+        LITE_format_llong(temp_buf, long_val);
         data_type_x->data_type_double_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + 2 + data_type_x->data_type_double_t.precise + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
         assert(data_type_x->data_type_double_t.value_str);
         sprintf_float_double_precise(data_type_x->data_type_double_t.value_str, data_type_x->data_type_double_t.value, data_type_x->data_type_double_t.precise);
+#endif
     } else if (type == data_type_type_enum) {
         /* find enum number */
         for (index = 0; index < 100; ++index) {
@@ -1279,9 +1815,11 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
         }
 
         data_type_x->data_type_enum_t.value = atoi(*data_type_x->data_type_enum_t.enum_item_key); /* default value. */
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         data_type_x->data_type_enum_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
         assert(data_type_x->data_type_enum_t.value_str);
-        dm_sprintf(data_type_x->data_type_enum_t.value_str, "%d", data_type_x->data_type_enum_t.value);
+        LITE_format_llong(data_type_x->data_type_enum_t.value_str, data_type_x->data_type_enum_t.value);
+#endif
 
     } else if (type == data_type_type_bool) {
         data_type_x->data_type_bool_t.bool_item_number = 2;
@@ -1307,12 +1845,14 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
 
         data_type_x->data_type_bool_t.value = 1; /* default value. */
 
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         data_type_x->data_type_bool_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
         assert(data_type_x->data_type_bool_t.value_str);
-        dm_sprintf(data_type_x->data_type_bool_t.value_str, "%d", data_type_x->data_type_bool_t.value);
+        LITE_format_llong(data_type_x->data_type_bool_t.value_str, data_type_x->data_type_bool_t.value);
+#endif
     } else if (type == data_type_type_text) {
         /* length */
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         memset(temp_buf, 0, sizeof(temp_buf));
         install_cjson_item_string_without_malloc(temp_buf, data_type_obj, string_length);
         if (strlen(temp_buf)) {
@@ -1325,7 +1865,7 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
         }
 #endif
         if (data_type_x->data_type_text_t.length < 1) data_type_x->data_type_text_t.length = 1;
-#ifndef LITE_THING_MODEL
+#if !defined(LITE_THING_MODEL) && !defined(DM_THING_COMPACT_VALUE_ENABLED)
         /* unit */
         install_cjson_item_string((void**)&data_type_x->data_type_text_t.unit, data_type_obj, "unit");
         /* unitName */
@@ -1334,10 +1874,12 @@ static void install_cjson_item_data_type_value(void* dst, data_type_type_t type,
         data_type_x->data_type_text_t.value = NULL; /* default value. */
     } else if (type == data_type_type_date) {
         data_type_x->data_type_date_t.value = 1513406265000; /* ms, UTC. default value. */
-        dm_lltoa(__LONG_LONG_MAX__, temp_buf, 10);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+        LITE_format_llong(temp_buf, __LONG_LONG_MAX__);
         data_type_x->data_type_date_t.value_str = dm_lite_calloc(1, strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
         assert(data_type_x->data_type_date_t.value_str);
-        dm_lltoa(data_type_x->data_type_date_t.value, data_type_x->data_type_date_t.value_str, 10);
+        LITE_format_llong(data_type_x->data_type_date_t.value_str, data_type_x->data_type_date_t.value);
+#endif
     } else {
         assert(0);
     }
@@ -1484,7 +2026,7 @@ static int install_cjson_item_string(void** dst, const cJSON* const cjson_obj, c
     return ret;
 }
 
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
 static void install_cjson_item_string_without_malloc(void* dst, const cJSON* const cjson_obj, const char* const item_name)
 {
     const cJSON* const root_obj = cjson_obj;
@@ -1874,10 +2416,15 @@ static int dm_thing_set_dsl_string(void* _self, const char* dsl, int dsl_str_len
     int ret = -1;
     dm_thing_t* self = _self;
 
+    if (dm_tsl_blob_detect(dsl, dsl_str_len)) return dm_thing_set_dsl_blob(self, dsl, dsl_str_len);
+
     self->_json_object = cJSON_Parse(dsl);
 
     assert(self->_json_object);
     ret = parse_cjson_obj_to_dsl_template(self, self->_json_object);
+    if (ret == 0) {
+        ret = dm_thing_build_identifier_index(self);
+    }
 
     cJSON_Delete(self->_json_object);
     self->_json_object = 0;
@@ -1950,67 +2497,61 @@ static int get_array_index_by_identifier(const char* identifier, char** arrpre_p
 }
 
 
+/* look up segment "id" or "id[n]", array form must hit an array type item unless array_type_check is 0. */
+static dm_id_index_entry_t* find_identifier_segment(const dm_id_index_t* index, const char* segment, size_t segment_len, int array_type_check)
+{
+    dm_id_index_entry_t* entry;
+    const char* arr_pre;
+    const char* p;
+    data_type_t* data_type;
+
+    arr_pre = memchr(segment, '[', segment_len);
+    if (arr_pre && segment[segment_len - 1] == ']' && segment + segment_len - arr_pre > 2) {
+        for (p = arr_pre + 1; p < segment + segment_len - 1; ++p) {
+            if (*p > '9' || *p < '0') break;
+        }
+        if (p == segment + segment_len - 1) {
+            entry = dm_id_index_find(index, segment, arr_pre - segment);
+            if (entry) {
+                /* property_t and lite_property_t share the same leading layout. */
+                data_type = &((lite_property_t*)entry->item)->data_type;
+                if (!array_type_check || data_type->type == data_type_type_array) return entry;
+            }
+        }
+    }
+
+    return dm_id_index_find(index, segment, segment_len);
+}
+
 static void* dm_thing_get_property_by_identifier(const void* _self, const char* const identifier)
 {
     const dm_thing_t* self = _self;
-    property_t* property = NULL;
-    lite_property_t* lite_property = NULL;
-    size_t property_number = self->dsl_template.property_number;
-    size_t data_type_specs_number;
-    int index;
-    int arr_index;
-    char delimeter[] = {DEFAULT_DSL_DELIMITER, 0};
-    char* p;
-    char id_buff[MAX_IDENTIFIER_LENGTH] = {0};
-    char* arrpre_pos = NULL;
+    dm_id_index_entry_t* entry;
+    size_t identifier_len;
+    const char* p;
+    const char* segment;
 
-    if (property_number == 0 || strlen(identifier) >= MAX_IDENTIFIER_LENGTH) {
-        return NULL;
-    }
+    if (self->dsl_template.property_number == 0) return NULL;
 
-    strcpy(id_buff, identifier);
+    identifier_len = strlen(identifier);
+    if (identifier_len >= MAX_IDENTIFIER_LENGTH) return NULL;
 
-    if (strchr(identifier, DEFAULT_DSL_DELIMITER)) {
-        p = strtok(id_buff, delimeter);
+    p = strchr(identifier, DEFAULT_DSL_DELIMITER);
+    if (p) {
+        entry = dm_id_index_find(&self->_property_index, identifier, p - identifier);
+        if (entry == NULL || entry->child[DM_ID_INDEX_CHILD_INPUT] == NULL) return NULL;
 
-        for (index = 0; index < property_number; ++index) {
-            property = self->dsl_template.properties + index;
-            if (property) {
-                if (strcmp(property->identifier, p) == 0) {
-                    break;
-                }
-            }
-        }
-        if (property && index < property_number) {
-            p = strtok(NULL, delimeter);
-            arr_index = get_array_index_by_identifier(p, &arrpre_pos);
-            data_type_specs_number = property->data_type.data_type_specs_number;
-            for (index = 0; index < data_type_specs_number; ++index) {
-                lite_property = (lite_property_t*)property->data_type.specs + index;
-                if (-1 != arr_index && strncmp(lite_property->identifier, p, arrpre_pos - p) == 0 &&
-                        lite_property->data_type.type == data_type_type_array) {
-                    return lite_property;
-                }else if(strcmp(lite_property->identifier, p) == 0){
-                    return lite_property;
-                }
-            }
-        }
+        segment = ++p;
+        p = strchr(segment, DEFAULT_DSL_DELIMITER);
+        identifier_len = p ? (size_t)(p - segment) : strlen(segment);
+        if (identifier_len == 0) return NULL;
+
+        entry = find_identifier_segment(entry->child[DM_ID_INDEX_CHILD_INPUT], segment, identifier_len, 1);
     } else {
-        for (index = 0; index < property_number; ++index) {
-            property = self->dsl_template.properties + index;
-            arr_index = get_array_index_by_identifier(identifier, &arrpre_pos);
-            if (property) {
-                if(-1 != arr_index && strncmp(property->identifier, identifier, arrpre_pos - identifier) == 0 &&
-                        property->data_type.type == data_type_type_array) {
-                    return property;
-                }else if (strcmp(property->identifier, identifier) == 0) {
-                    return property;
-                }
-            }
-        }
+        entry = find_identifier_segment(&self->_property_index, identifier, identifier_len, 1);
     }
 
-    return NULL;
+    return dm_thing_index_item(self, entry);
 }
 
 static int dm_thing_get_property_identifier_by_index(const void* _self, int index, char* identifier)
@@ -2031,71 +2572,42 @@ static int dm_thing_get_property_identifier_by_index(const void* _self, int inde
 static void* dm_thing_get_service_by_identifier(const void* _self, const char* const identifier)
 {
     const dm_thing_t* self = _self;
-    service_t* service = NULL;
-    lite_property_t* lite_property = NULL;
-    input_data_t* input_data;
-    size_t service_number = self->dsl_template.service_number;
-    size_t service_output_data_num;
-    size_t service_input_data_num;
-    int index;
-    char delimeter[] = {DEFAULT_DSL_DELIMITER, 0};
-    char* p;
-    char* p_m;
-    char* p_l;
-    char id_buff[MAX_IDENTIFIER_LENGTH] = {0};
-    char* arrpre_pos = NULL;
-    int arr_index;
-    if (service_number == 0 || strlen(identifier) >= MAX_IDENTIFIER_LENGTH) return NULL;
+    dm_id_index_entry_t* entry;
+    dm_id_index_entry_t* data_entry = NULL;
+    size_t identifier_len;
+    size_t segment_len;
+    const char* p;
+    const char* p_m;
+    const char* p_l;
 
-    strcpy(id_buff, identifier);
+    if (self->dsl_template.service_number == 0) return NULL;
 
-    if (strchr(identifier, DEFAULT_DSL_DELIMITER)) {
-        p = strtok(id_buff, delimeter);
+    identifier_len = strlen(identifier);
+    if (identifier_len >= MAX_IDENTIFIER_LENGTH) return NULL;
 
-        for (index = 0; index < service_number; ++index) {
-            service = self->dsl_template.services + index;
-            if (service) {
-                if (strcmp(service->identifier, p) == 0) {
-                    break;
-                }
-            }
-        }
-        p_m = strtok(NULL, delimeter);
-        p_l = strtok(NULL, delimeter);
-        if (p_m && service && index < service_number && (p_l ? strcmp(p_l, string_input) == 0 : 1)) {
-            service_input_data_num = service->service_input_data_num;
-            arr_index = get_array_index_by_identifier(p_m, &arrpre_pos);
-            for (index = 0; index < service_input_data_num; ++index) {
-                input_data = service->service_input_data + index;
-                lite_property = &input_data->lite_property;
-                if (strcmp(lite_property->identifier, p_m) == 0 || (-1 != arr_index && strncmp(lite_property->identifier, p_m, arrpre_pos - p_m) == 0)) {
-                    return lite_property;
-                }
-            }
-        }
-        if (p_m && service && index < service_number && (p_l ? strcmp(p_l, string_output) == 0 : 1)) {
-            service_output_data_num = service->service_output_data_num;
-            arr_index = get_array_index_by_identifier(p_m, &arrpre_pos);
-            for (index = 0; index < service_output_data_num; ++index) {
-                lite_property = service->service_output_data + index;
+    p = strchr(identifier, DEFAULT_DSL_DELIMITER);
+    if (p == NULL) {
+        entry = dm_id_index_find(&self->_service_index, identifier, identifier_len);
+        return dm_thing_index_item(self, entry);
+    }
 
-                if (strcmp(lite_property->identifier, p_m) == 0 || (-1 != arr_index && strncmp(lite_property->identifier, p_m, arrpre_pos - p_m) == 0)) {
-                    return lite_property;
-                }
-            }
-        }
-    } else {
-        for (index = 0; index < service_number; ++index) {
-            service = self->dsl_template.services + index;
-            if (service) {
-                if (strcmp(service->identifier, identifier) == 0) {
-                    return service;
-                }
-            }
-        }
+    entry = dm_id_index_find(&self->_service_index, identifier, p - identifier);
+    if (entry == NULL) return NULL;
+
+    p_m = p + 1;
+    p_l = strchr(p_m, DEFAULT_DSL_DELIMITER);
+    segment_len = p_l ? (size_t)(p_l - p_m) : strlen(p_m);
+    if (segment_len == 0) return NULL;
+    if (p_l) ++p_l;
+
+    if (p_l == NULL || strcmp(p_l, string_input) == 0) {
+        data_entry = find_identifier_segment(entry->child[DM_ID_INDEX_CHILD_INPUT], p_m, segment_len, 0);
+    }
+    if (data_entry == NULL && (p_l == NULL || strcmp(p_l, string_output) == 0)) {
+        data_entry = find_identifier_segment(entry->child[DM_ID_INDEX_CHILD_OUTPUT], p_m, segment_len, 0);
     }
 
-    return NULL;
+    return dm_thing_index_item(self, data_entry);
 }
 
 static int dm_thing_get_service_identifier_by_index(const void* _self, int index, char* identifier)
@@ -2118,58 +2630,32 @@ static int dm_thing_get_service_identifier_by_index(const void* _self, int index
 static void* dm_thing_get_event_by_identifier(const void* _self, const char* const identifier)
 {
     const dm_thing_t* self = _self;
-    int arr_index;
-    event_t* event = NULL;
-    lite_property_t* lite_property = NULL;
-    size_t event_number = self->dsl_template.event_number;
-    size_t event_output_data_num;
-    int index;
-    char delimeter[] = {DEFAULT_DSL_DELIMITER, 0};
-    char* p;
-    char id_buff[MAX_IDENTIFIER_LENGTH] = {0};
-    char* arrpre_pos = NULL;
+    dm_id_index_entry_t* entry;
+    size_t identifier_len;
+    const char* p;
+    const char* segment;
 
-    if (event_number == 0 || strlen(identifier) >= MAX_IDENTIFIER_LENGTH) return NULL;
+    if (self->dsl_template.event_number == 0) return NULL;
 
-    strcpy(id_buff, identifier);
+    identifier_len = strlen(identifier);
+    if (identifier_len >= MAX_IDENTIFIER_LENGTH) return NULL;
 
-    if (strchr(identifier, DEFAULT_DSL_DELIMITER)) {
-        p = strtok(id_buff, delimeter);
+    p = strchr(identifier, DEFAULT_DSL_DELIMITER);
+    if (p) {
+        entry = dm_id_index_find(&self->_event_index, identifier, p - identifier);
+        if (entry == NULL) return NULL;
 
-        for (index = 0; index < event_number; ++index) {
-            event = self->dsl_template.events + index;
-            if (event) {
-                if (strcmp(event->identifier, p) == 0) {
-                    break;
-                }
-            }
-        }
-        if (event && index < event_number) {
-            p = strtok(NULL, delimeter);
-            event_output_data_num = event->event_output_data_num;
-            arr_index = get_array_index_by_identifier(p, &arrpre_pos);
-            for (index = 0; index < event_output_data_num; ++index) {
-                lite_property = event->event_output_data + index;
-                if (-1 != arr_index && strncmp(lite_property->identifier, p, arrpre_pos - p) == 0 &&
-                        lite_property->data_type.type == data_type_type_array) {
-                        return lite_property;
-                }else if (strcmp(lite_property->identifier, p) == 0) {
-                    return lite_property;
-                }
-            }
-        }
+        segment = ++p;
+        p = strchr(segment, DEFAULT_DSL_DELIMITER);
+        identifier_len = p ? (size_t)(p - segment) : strlen(segment);
+        if (identifier_len == 0) return NULL;
+
+        entry = find_identifier_segment(entry->child[DM_ID_INDEX_CHILD_INPUT], segment, identifier_len, 1);
     } else {
-        for (index = 0; index < event_number; ++index) {
-            event = self->dsl_template.events + index;
-            if (event) {
-                if (strcmp(event->identifier, identifier) == 0) {
-                    return event;
-                }
-            }
-        }
+        entry = dm_id_index_find(&self->_event_index, identifier, identifier_len);
     }
 
-    return NULL;
+    return dm_thing_index_item(self, entry);
 }
 
 static int dm_thing_get_event_identifier_by_index(const void* _self, int index, char* identifier)
@@ -2243,33 +2729,82 @@ static char* dm_thing_return_product_key(const void* _self)
 
 static int dm_thing_get_device_name(const void* _self, char* device_name)
 {
-    const dm_thing_t* self = _self;
-    int ret = -1;
+    const dm_thing_t* self = _self;
+    int ret = -1;
+
+    if (self->dsl_template.profile.device_name) {
+        strcpy(device_name, self->dsl_template.profile.device_name);
+        ret = 0;
+    }
+    return ret;
+}
+
+static char* dm_thing_return_device_name(const void* _self)
+{
+    const dm_thing_t* self = _self;
+
+    if (self->dsl_template.profile.device_name) {
+        return self->dsl_template.profile.device_name;
+    }
+
+    return NULL;
+}
+
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+/* replace string shadow of a numeric array item, free the former one. */
+static int set_array_item_value_str(data_type_x_t* data_type_x, int arr_index, const char* str)
+{
+    char** item_value_str = (char**)data_type_x->data_type_array_t.value_str + arr_index;
+
+    if (*item_value_str) {
+        dm_lite_free(*item_value_str);
+    }
+
+    *item_value_str = (char*)dm_lite_calloc(1, strlen(str) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+    if (*item_value_str == NULL) {
+        dm_log_err("calloc %d byte failed", strlen(str) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC);
+        return -1;
+    }
+    strcpy(*item_value_str, str);
+
+    return 0;
+}
+
+/* string shadow of a numeric array item, formatted again if dropped by a bulk set. */
+static char* get_array_item_value_str(const data_type_x_t* data_type_x, int arr_index)
+{
+    char** item_value_str = (char**)data_type_x->data_type_array_t.value_str + arr_index;
+    char temp_buf[DM_THING_VALUE_STR_BUFF_SIZE] = {0};
 
-    if (self->dsl_template.profile.device_name) {
-        strcpy(device_name, self->dsl_template.profile.device_name);
-        ret = 0;
+    if (*item_value_str == NULL && format_array_item_value_str(data_type_x, arr_index, temp_buf, sizeof(temp_buf))) {
+        set_array_item_value_str((data_type_x_t*)data_type_x, arr_index, temp_buf);
     }
-    return ret;
+
+    return *item_value_str;
 }
 
-static char* dm_thing_return_device_name(const void* _self)
+/* free string shadows of numeric array items, a bulk set leaves them to be formatted on get. */
+static void drop_array_item_value_str(data_type_x_t* data_type_x, int start, int number)
 {
-    const dm_thing_t* self = _self;
+    char** item_value_str = (char**)data_type_x->data_type_array_t.value_str + start;
+    int index;
 
-    if (self->dsl_template.profile.device_name) {
-        return self->dsl_template.profile.device_name;
+    for (index = 0; index < number; ++index) {
+        if (item_value_str[index]) {
+            dm_lite_free(item_value_str[index]);
+            item_value_str[index] = NULL;
+        }
     }
-
-    return NULL;
 }
+#endif
 
 static int set_array_item_value(lite_property_t *lite_property, int arr_index, const void* value, const char* value_str)
 {
     int ret = -1;
     int val_int;
-    char temp_buf[24] = {0};
-    int alloc_size;
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    char temp_buf[LITE_NUMBER_LEN_MAX] = {0};
+#endif
     double val_double;
     float val_float;
     int text_length;
@@ -2286,36 +2821,43 @@ static int set_array_item_value(lite_property_t *lite_property, int arr_index, c
     data_type_x = &lite_property->data_type.value;
     switch(lite_property->data_type.value.data_type_array_t.item_type) {
     case data_type_type_int:
-        val_int = value ? *(const int*)value : atoi(value_str);
+        val_int = value ? *(const int*)value : LITE_parse_int(value_str, NULL);
         *((int*)data_type_x->data_type_array_t.array + arr_index)  = val_int;
-        dm_snprintf(temp_buf, sizeof(temp_buf), "%d", val_int);
-        alloc_size = strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC;
-        *((char**)data_type_x->data_type_array_t.value_str + arr_index) = (char*)dm_lite_calloc(1, alloc_size);
-        dm_snprintf(*((char**)data_type_x->data_type_array_t.value_str + arr_index), alloc_size, "%d", val_int);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+        LITE_format_llong(temp_buf, val_int);
+        ret = set_array_item_value_str(data_type_x, arr_index, temp_buf);
+#else
         ret = 0;
+#endif
         break;
     case data_type_type_double:
-        val_double = value ? *(const double*)value : atof(value_str);
+        val_double = value ? *(const double*)value : LITE_parse_double(value_str, NULL);
         *((double*)data_type_x->data_type_array_t.array + arr_index)  = val_double;
-        dm_snprintf(temp_buf, sizeof(temp_buf), "%.16lf", val_double);
-        alloc_size = strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC;
-        *((char**)data_type_x->data_type_array_t.value_str + arr_index) = (char*)dm_lite_calloc(1, alloc_size);
-        dm_snprintf(*((char**)data_type_x->data_type_array_t.value_str + arr_index), alloc_size, "%.16lf", val_double);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+        LITE_format_fixed(temp_buf, val_double, 16);
+        ret = set_array_item_value_str(data_type_x, arr_index, temp_buf);
+#else
         ret = 0;
+#endif
         break;
     case data_type_type_float:
-        val_float = value ? *(const float*)value : atof(value_str);
+        val_float = value ? *(const float*)value : LITE_parse_double(value_str, NULL);
         *((float*)data_type_x->data_type_array_t.array + arr_index)  = val_float;
-        dm_snprintf(temp_buf, sizeof(temp_buf), "%.7f", val_float);
-        alloc_size = strlen(temp_buf) + DM_THING_EXTENTED_ROOM_FOR_STRING_MALLOC;
-        *((char**)data_type_x->data_type_array_t.value_str + arr_index) = (char*)dm_lite_calloc(1, alloc_size);
-        dm_snprintf(*((char**)data_type_x->data_type_array_t.value_str + arr_index), alloc_size, "%.7f", val_float);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+        LITE_format_fixed(temp_buf, val_float, 7);
+        ret = set_array_item_value_str(data_type_x, arr_index, temp_buf);
+#else
         ret = 0;
+#endif
         break;
     case data_type_type_text:
 
         val_char_p = value ? (const char*)value : value_str;
         text_length = strlen(val_char_p);
+        if (!LITE_utf8_valid(val_char_p, text_length)) {
+            dm_log_err("text is not utf-8");
+            return -1;
+        }
 
         if (*((char**)data_type_x->data_type_array_t.array + arr_index)) {
             dm_lite_free(*((char**)data_type_x->data_type_array_t.array + arr_index));
@@ -2375,47 +2917,52 @@ static int set_lite_property_value(void* _self, void* property, const void* valu
 
     switch (type) {
     case data_type_type_int:
-        val_int = value ? *(const int*)value : atoi(value_str);
+        val_int = value ? *(const int*)value : LITE_parse_int(value_str, NULL);
         val_int = val_int > data_type_x->data_type_int_t.max ? data_type_x->data_type_int_t.max :
                                                                (val_int < data_type_x->data_type_int_t.min ? data_type_x->data_type_int_t.min : val_int);
         data_type_x->data_type_int_t.value = val_int;
-        dm_sprintf(data_type_x->data_type_int_t.value_str, "%d", data_type_x->data_type_int_t.value);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+        LITE_format_llong(data_type_x->data_type_int_t.value_str, data_type_x->data_type_int_t.value);
+#endif
         break;
     case data_type_type_float:
-        val_float = value ? *(const float*)value : atof(value_str);
+        val_float = value ? *(const float*)value : LITE_parse_double(value_str, NULL);
         val_float = val_float > data_type_x->data_type_float_t.max ? data_type_x->data_type_float_t.max :
                                                                      (val_float < data_type_x->data_type_float_t.min ? data_type_x->data_type_float_t.min : val_float);
         data_type_x->data_type_float_t.value = val_float;
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         sprintf_float_double_precise(data_type_x->data_type_float_t.value_str, data_type_x->data_type_float_t.value,
                                      data_type_x->data_type_float_t.precise);
+#endif
         break;
     case data_type_type_double:
-        val_double = value ? *(const double*)value : atof(value_str);
+        val_double = value ? *(const double*)value : LITE_parse_double(value_str, NULL);
         val_double = val_double > data_type_x->data_type_double_t.max ? data_type_x->data_type_double_t.max :
                                                                         (val_double < data_type_x->data_type_double_t.min ? data_type_x->data_type_double_t.min : val_double);
         data_type_x->data_type_double_t.value = val_double;
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         sprintf_float_double_precise(data_type_x->data_type_double_t.value_str, data_type_x->data_type_double_t.value,
                                      data_type_x->data_type_double_t.precise);
+#endif
         break;
     case data_type_type_bool:
-        val_int = value ? *(const int*)value : atoi(value_str);
-        if (val_int) {
-            data_type_x->data_type_bool_t.value = 1;
-            dm_sprintf(data_type_x->data_type_bool_t.value_str, "%d", 1);
-        } else {
-            data_type_x->data_type_bool_t.value = 0;
-            dm_sprintf(data_type_x->data_type_bool_t.value_str, "%d", 0);
-        }
+        val_int = value ? *(const int*)value : LITE_parse_int(value_str, NULL);
+        data_type_x->data_type_bool_t.value = val_int ? 1 : 0;
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+        LITE_format_llong(data_type_x->data_type_bool_t.value_str, data_type_x->data_type_bool_t.value);
+#endif
 
         break;
     case data_type_type_enum:
-        val_int = value ? *(const int*)value : atoi(value_str);
+        val_int = value ? *(const int*)value : LITE_parse_int(value_str, NULL);
         /* check if match predefined keys. */
         for (index = 0; index < data_type_x->data_type_enum_t.enum_item_number; ++index) {
             enum_item_key_str = *(data_type_x->data_type_enum_t.enum_item_key + index);
-            if (val_int == atoi(enum_item_key_str)) {
+            if (val_int == LITE_parse_int(enum_item_key_str, NULL)) {
                 data_type_x->data_type_enum_t.value = val_int;
-                dm_sprintf(data_type_x->data_type_enum_t.value_str, "%d", data_type_x->data_type_enum_t.value);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+                LITE_format_llong(data_type_x->data_type_enum_t.value_str, data_type_x->data_type_enum_t.value);
+#endif
                 return 0;
             }
         }
@@ -2424,6 +2971,10 @@ static int set_lite_property_value(void* _self, void* property, const void* valu
     case data_type_type_text:
         val_char_p = value ? (const char*)value : value_str;
         text_length = strlen(val_char_p);
+        if (!LITE_utf8_valid(val_char_p, text_length)) {
+            dm_log_err("text is not utf-8");
+            return -1;
+        }
         /* check if length restrict satisfied. */
         if (text_length <= data_type_x->data_type_text_t.length) {
             if (data_type_x->data_type_text_t.value) {
@@ -2443,9 +2994,11 @@ static int set_lite_property_value(void* _self, void* property, const void* valu
         }
         break;
     case data_type_type_date:
-        val_long = value ? *(const unsigned long long*)value : atoll(value_str);
+        val_long = value ? *(const unsigned long long*)value : LITE_parse_llong(value_str, NULL);
         data_type_x->data_type_date_t.value = val_long;
-        dm_lltoa(data_type_x->data_type_date_t.value, data_type_x->data_type_date_t.value_str, 10);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+        LITE_format_llong(data_type_x->data_type_date_t.value_str, data_type_x->data_type_date_t.value);
+#endif
         break;
     case data_type_type_struct:
         for(index = 0; index < lite_property->data_type.data_type_specs_number; ++index) {
@@ -2477,6 +3030,271 @@ static int set_lite_property_value(void* _self, void* property, const void* valu
     return 0;
 }
 
+/* post state flags of property, NULL if property is not a top level one or out of memory. */
+static unsigned char* get_property_post_state(dm_thing_t* self, const property_t* property)
+{
+    size_t property_number = self->dsl_template.property_number;
+
+    if (property == NULL || property < self->dsl_template.properties ||
+        property >= self->dsl_template.properties + property_number) return NULL;
+
+    if (self->_property_post_state == NULL) {
+        self->_property_post_state = dm_lite_calloc(1, property_number);
+        if (self->_property_post_state == NULL) return NULL;
+    }
+
+    return self->_property_post_state + (property - self->dsl_template.properties);
+}
+
+static void mark_property_changed(dm_thing_t* self, const property_t* property)
+{
+    unsigned char* state = get_property_post_state(self, property);
+
+    if (state) *state |= DM_THING_PROPERTY_CHANGED;
+}
+
+#ifdef DM_REPORT_POLICY_ENABLED
+/* 0 with value of property in number if it has one a deadband applies to. */
+static int get_property_number(const property_t* property, double* number)
+{
+    const data_type_x_t* data_type_x = &property->data_type.value;
+
+    switch (property->data_type.type) {
+    case data_type_type_int:
+        *number = data_type_x->data_type_int_t.value;
+        break;
+    case data_type_type_float:
+        *number = data_type_x->data_type_float_t.value;
+        break;
+    case data_type_type_double:
+        *number = data_type_x->data_type_double_t.value;
+        break;
+    case data_type_type_enum:
+        *number = data_type_x->data_type_enum_t.value;
+        break;
+    case data_type_type_bool:
+        *number = data_type_x->data_type_bool_t.value;
+        break;
+    case data_type_type_date:
+        *number = (double)data_type_x->data_type_date_t.value;
+        break;
+    default:
+        return -1;
+    }
+
+    return 0;
+}
+
+static double report_abs(double number)
+{
+    return number < 0 ? -number : number;
+}
+
+static void record_property_report(dm_thing_report_t* report, const property_t* property, uint64_t now)
+{
+    report->reported = 1;
+    report->reported_numeric = get_property_number(property, &report->reported_value) == 0;
+    report->reported_ms = now;
+}
+
+/* set numeric property to number in its native type. */
+static int set_property_number(dm_thing_t* self, const property_t* property, double number)
+{
+    int val_int;
+    float val_float;
+    unsigned long long val_long;
+    const void* value;
+
+    switch (property->data_type.type) {
+    case data_type_type_int:
+    case data_type_type_enum:
+    case data_type_type_bool:
+        val_int = (int)(number < 0 ? number - 0.5 : number + 0.5);
+        value = &val_int;
+        break;
+    case data_type_type_float:
+        val_float = (float)number;
+        value = &val_float;
+        break;
+    case data_type_type_double:
+        value = &number;
+        break;
+    case data_type_type_date:
+        val_long = (unsigned long long)(number + 0.5);
+        value = &val_long;
+        break;
+    default:
+        return -1;
+    }
+
+    return set_lite_property_value(self, (void*)property, value, NULL);
+}
+
+/* add number to the window of property, the samples array drops its first item for it. */
+static void aggregate_property_value(dm_thing_t* self, dm_thing_report_t* report, double number)
+{
+    data_type_x_t* data_type_x;
+    char* array;
+    size_t item_size;
+    int size;
+    int val_int;
+    float val_float;
+    uint64_t now;
+
+    if (report->window_count == 0) {
+        /* windows without a value set are skipped. */
+        now = HAL_UptimeMs();
+        report->reported_ms += (now - report->reported_ms) / report->policy.aggregate_window_ms * report->policy.aggregate_window_ms;
+        report->window_min = number;
+        report->window_max = number;
+        report->window_sum = 0;
+    }
+    if (number < report->window_min) report->window_min = number;
+    if (number > report->window_max) report->window_max = number;
+    report->window_sum += number;
+    report->window_count++;
+
+    if (report->aggregate_samples == NULL) return;
+
+    data_type_x = (data_type_x_t*)&report->aggregate_samples->data_type.value;
+    size = data_type_x->data_type_array_t.size;
+    array = data_type_x->data_type_array_t.array;
+    if (size <= 0 || array == NULL) return;
+
+    item_size = get_type_size(data_type_x->data_type_array_t.item_type);
+    memmove(array, array + item_size, (size - 1) * item_size);
+    array += (size - 1) * item_size;
+
+    switch (data_type_x->data_type_array_t.item_type) {
+    case data_type_type_int:
+        val_int = (int)(number < 0 ? number - 0.5 : number + 0.5);
+        memcpy(array, &val_int, item_size);
+        break;
+    case data_type_type_float:
+        val_float = (float)number;
+        memcpy(array, &val_float, item_size);
+        break;
+    default:
+        memcpy(array, &number, item_size);
+        break;
+    }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    drop_array_item_value_str(data_type_x, 0, size);
+#endif
+}
+
+/* set the aggregate properties of the window of property ending by now if mark, 1 when it has one to post. */
+static int report_property_window(dm_thing_t* self, dm_thing_report_t* report, const property_t* property,
+                                  uint64_t now, int mark, uint32_t* timeout_ms)
+{
+    uint64_t window_ms = report->policy.aggregate_window_ms;
+    uint64_t due = report->reported_ms + window_ms;
+
+    if (report->window_count == 0) return 0;
+
+    if (due > now || !mark) {
+        due = due > now ? due - now : 0;
+        if (timeout_ms && due < *timeout_ms) *timeout_ms = (uint32_t)due;
+        return due == 0;
+    }
+
+    report->reported_ms += (now - report->reported_ms) / window_ms * window_ms;
+
+    if (set_property_number(self, property, report->window_sum / report->window_count) == 0) {
+        mark_property_changed(self, property);
+        record_property_report(report, property, report->reported_ms);
+    }
+    if (report->aggregate_min && set_property_number(self, report->aggregate_min, report->window_min) == 0) {
+        mark_property_changed(self, report->aggregate_min);
+    }
+    if (report->aggregate_max && set_property_number(self, report->aggregate_max, report->window_max) == 0) {
+        mark_property_changed(self, report->aggregate_max);
+    }
+    if (report->aggregate_count && set_property_number(self, report->aggregate_count, report->window_count) == 0) {
+        mark_property_changed(self, report->aggregate_count);
+    }
+    if (report->aggregate_samples) mark_property_changed(self, report->aggregate_samples);
+
+    report->window_count = 0;
+
+    return 1;
+}
+
+/* 1 when report policy of property keeps the value just set from the next post, a held one goes when due. */
+static int filter_property_report(dm_thing_t* self, const property_t* property)
+{
+    dm_thing_report_t* report;
+    unsigned char* state;
+    double number;
+    double diff;
+    uint64_t now;
+
+    if (self->_property_report == NULL || property == NULL || property < self->dsl_template.properties ||
+        property >= self->dsl_template.properties + self->dsl_template.property_number) return 0;
+
+    report = self->_property_report + (property - self->dsl_template.properties);
+    if (!report->attached) return 0;
+
+    if (report->policy.aggregate_window_ms > 0) {
+        if (get_property_number(property, &number) != 0) return 0;
+
+        aggregate_property_value(self, report, number);
+        /* the property keeps the average of the last window, a post coalesced may not have taken it yet. */
+        if (report->reported) set_property_number(self, property, report->reported_value);
+        return 1;
+    }
+
+    state = get_property_post_state(self, property);
+    if (state == NULL) return 0;
+
+    /* the post not started yet carries this value instead. */
+    if (*state & DM_THING_PROPERTY_CHANGED) {
+        report->reported_numeric = get_property_number(property, &report->reported_value) == 0;
+        return 0;
+    }
+
+    if (report->reported && report->reported_numeric && get_property_number(property, &number) == 0) {
+        diff = report_abs(number - report->reported_value);
+        if ((report->policy.on_change_only && diff == 0) || diff < report->policy.deadband ||
+            diff < report_abs(report->reported_value) * report->policy.deadband_percent / 100) {
+            /* back within the band of the value reported, nothing held to report. */
+            *state &= ~DM_THING_PROPERTY_HELD;
+            return 1;
+        }
+    }
+
+    now = HAL_UptimeMs();
+    if (report->reported && now - report->reported_ms < (uint64_t)report->policy.min_interval_ms) {
+        *state |= DM_THING_PROPERTY_HELD;
+        return 1;
+    }
+
+    *state &= ~DM_THING_PROPERTY_HELD;
+    record_property_report(report, property, now);
+
+    return 0;
+}
+#endif
+
+/* value set to property goes with next changed property post, unless its report policy filters it. */
+static void mark_property_set(dm_thing_t* self, const property_t* property)
+{
+#ifdef DM_REPORT_POLICY_ENABLED
+    if (filter_property_report(self, property)) return;
+#endif
+    mark_property_changed(self, property);
+}
+
+/* top level property of identifier like "identifier1.identifier2" or "identifier[1]". */
+static property_t* get_top_property_by_identifier(const dm_thing_t* self, const char* identifier)
+{
+    dm_id_index_entry_t* entry;
+
+    entry = dm_id_index_find(&self->_property_index, identifier, strcspn(identifier, ".["));
+
+    return dm_thing_index_item(self, entry);
+}
+
 static int dm_thing_set_property_value(void* _self, void* _property, const void* value, const char* value_str)
 {
     dm_thing_t* self = _self;
@@ -2493,7 +3311,11 @@ static int dm_thing_set_property_value(void* _self, void* _property, const void*
 #endif
     lite_property = (lite_property_t*)property;
 
-    set_lite_property_value(self, lite_property, value, value_str);
+    value_lock(self);
+    if (set_lite_property_value(self, lite_property, value, value_str) == 0) {
+        mark_property_set(self, property);
+    }
+    value_unlock(self);
 
     return 0;
 }
@@ -2525,15 +3347,22 @@ static int dm_thing_set_property_value_by_identifier(void* _self, const char* co
         return -1;
     }
 #endif
+    value_lock(self);
     self->_arr_index = get_array_index_by_identifier(identifier, &arrpre_pos);
     lite_property = dm_thing_get_property_by_identifier(self, identifier);
 
     if (lite_property == NULL) {
+        self->_arr_index = -1;
+        value_unlock(self);
         dm_log_err("property(%s) not find", identifier);
         return -1;
     }
     ret = set_lite_property_value(self, lite_property, value, value_str);
     self->_arr_index = -1;
+    if (ret == 0) {
+        mark_property_set(self, get_top_property_by_identifier(self, identifier));
+    }
+    value_unlock(self);
     return ret;
 }
 
@@ -2557,18 +3386,22 @@ static int get_array_item_value(const lite_property_t *lite_property, int arr_in
         if (value) {
             *(int*)value = val_int;
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
-            *value_str = *((char**)data_type_x->data_type_array_t.value_str + arr_index);
+            *value_str = get_array_item_value_str(data_type_x, arr_index);
         }
+#endif
         ret = 0;
     }else if(type == data_type_type_double) {
         val_double = *((double*)data_type_x->data_type_array_t.array + arr_index);
         if (value) {
             *(double*)value = val_double;
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
-            *value_str = *((char**)data_type_x->data_type_array_t.value_str + arr_index);
+            *value_str = get_array_item_value_str(data_type_x, arr_index);
         }
+#endif
 
         ret = 0;
     }else if(type == data_type_type_float) {
@@ -2576,9 +3409,11 @@ static int get_array_item_value(const lite_property_t *lite_property, int arr_in
         if (value) {
             *(float*)value = val_float;
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
-            *value_str = *((char**)data_type_x->data_type_array_t.value_str + arr_index);
+            *value_str = get_array_item_value_str(data_type_x, arr_index);
         }
+#endif
 
         ret = 0;
     }else if(type == data_type_type_text) {
@@ -2600,6 +3435,94 @@ static int get_array_item_value(const lite_property_t *lite_property, int arr_in
     return ret;
 }
 
+/* array property of identifier with items [start, start + number) in range, numeric item types only. */
+static lite_property_t* get_array_property_for_bulk_access(const dm_thing_t* self, const char* const identifier, int start, int number)
+{
+    lite_property_t* lite_property;
+    const data_type_x_t* data_type_x;
+    data_type_type_t item_type;
+
+    lite_property = dm_thing_get_property_by_identifier(self, identifier);
+    if (lite_property == NULL || lite_property->data_type.type != data_type_type_array) {
+        dm_log_err("array property(%s) not find", identifier);
+        return NULL;
+    }
+
+    data_type_x = &lite_property->data_type.value;
+    if (start < 0 || number <= 0 || number > data_type_x->data_type_array_t.size - start) {
+        dm_log_err("invalid param, start:%d number:%d size:%d", start, number, data_type_x->data_type_array_t.size);
+        return NULL;
+    }
+
+    item_type = data_type_x->data_type_array_t.item_type;
+    if (item_type != data_type_type_int && item_type != data_type_type_float && item_type != data_type_type_double) {
+        dm_log_err("don't support %d", item_type);
+        return NULL;
+    }
+
+    return lite_property;
+}
+
+/* copy number items of native type (int, float or double) from values into array, from item start on. */
+static int dm_thing_set_property_array_values(void* _self, const char* const identifier, int start, const void* values, int number)
+{
+    dm_thing_t* self = _self;
+    lite_property_t* lite_property;
+    data_type_x_t* data_type_x;
+    size_t item_size;
+#ifdef PROPERTY_ACCESS_MODE_ENABLED
+    property_t* property;
+#endif
+
+    if (identifier == NULL || values == NULL) return -1;
+
+    lite_property = get_array_property_for_bulk_access(self, identifier, start, number);
+    if (lite_property == NULL) return -1;
+
+#ifdef PROPERTY_ACCESS_MODE_ENABLED
+    property = get_top_property_by_identifier(self, identifier);
+    if (property && property->access_mode == property_access_mode_r) {
+        dm_log_err("try to set value to readonly property, id:%s\n", property->identifier);
+        return -1;
+    }
+#endif
+
+    data_type_x = &lite_property->data_type.value;
+    item_size = get_type_size(data_type_x->data_type_array_t.item_type);
+
+    value_lock(self);
+    memcpy((char*)data_type_x->data_type_array_t.array + start * item_size, values, number * item_size);
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+    drop_array_item_value_str(data_type_x, start, number);
+#endif
+
+    mark_property_set(self, get_top_property_by_identifier(self, identifier));
+    value_unlock(self);
+
+    return 0;
+}
+
+/* copy number items of array from item start on into values, values holds items of native type. */
+static int dm_thing_get_property_array_values(const void* _self, const char* const identifier, int start, void* values, int number)
+{
+    const dm_thing_t* self = _self;
+    const lite_property_t* lite_property;
+    const data_type_x_t* data_type_x;
+    size_t item_size;
+
+    if (identifier == NULL || values == NULL) return -1;
+
+    lite_property = get_array_property_for_bulk_access(self, identifier, start, number);
+    if (lite_property == NULL) return -1;
+
+    data_type_x = &lite_property->data_type.value;
+    item_size = get_type_size(data_type_x->data_type_array_t.item_type);
+
+    memcpy(values, (const char*)data_type_x->data_type_array_t.array + start * item_size, number * item_size);
+
+    return 0;
+}
+
 static int dm_thing_get_lite_property_value(const void* _self, const void* const property, void* value, char** value_str)
 {
     const dm_thing_t* self = _self;
@@ -2632,9 +3555,11 @@ static int dm_thing_get_lite_property_value(const void* _self, const void* const
         if (value) {
             *(int*)value = val_int;
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
             *value_str = data_type_x->data_type_int_t.value_str;
         }
+#endif
 
         ret = 0;
         break;
@@ -2643,9 +3568,11 @@ static int dm_thing_get_lite_property_value(const void* _self, const void* const
         if (value) {
             *(float*)value = val_float;
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
             *value_str = data_type_x->data_type_float_t.value_str;
         }
+#endif
 
         ret = 0;
         break;
@@ -2654,9 +3581,11 @@ static int dm_thing_get_lite_property_value(const void* _self, const void* const
         if (value) {
             *(double*)value = val_double;
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
             *value_str = data_type_x->data_type_double_t.value_str;
         }
+#endif
 
         ret = 0;
         break;
@@ -2667,18 +3596,22 @@ static int dm_thing_get_lite_property_value(const void* _self, const void* const
                 *(int*)value = 1;
             }
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
             *value_str = data_type_x->data_type_bool_t.value_str;
         }
+#endif
         ret = 0;
         break;
     case data_type_type_enum:
         if (value) {
             *(int*)value = data_type_x->data_type_enum_t.value;
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
             *value_str = data_type_x->data_type_enum_t.value_str;
         }
+#endif
         ret = 0;
         break;
     case data_type_type_text:
@@ -2696,11 +3629,13 @@ static int dm_thing_get_lite_property_value(const void* _self, const void* const
         if (value) {
             *(unsigned long long*)value = data_type_x->data_type_date_t.value;
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (value_str) {
             if (data_type_x->data_type_date_t.value_str) {
                 *value_str = data_type_x->data_type_date_t.value_str;
             }
         }
+#endif
         ret = 0;
         break;
     case data_type_type_array:
@@ -2717,6 +3652,14 @@ static int dm_thing_get_lite_property_value(const void* _self, const void* const
         break;
     }
 
+#ifdef DM_THING_COMPACT_VALUE_ENABLED
+    /* text is kept as string, the others are formatted into the buffer of thing, valid until next get. */
+    if (ret == 0 && value_str && type != data_type_type_text &&
+        !(type == data_type_type_array && data_type_x->data_type_array_t.item_type == data_type_type_text)) {
+        *value_str = format_value_str(&lite_property->data_type, self->_arr_index, (char*)self->_value_str_buff, sizeof(self->_value_str_buff));
+    }
+#endif
+
     return ret;
 
 }
@@ -2861,7 +3804,49 @@ void service_iterator(void* _self, handle_item_t handle_fp, ...)
 
     dm_thing_service_iterator(self, handle_fp, &params);
 
-    va_end(params);
+    va_end(params);
+}
+
+int property_visit(void* _self, property_visit_fp_t visit_fp, void* ctx)
+{
+    dm_thing_t* self = _self;
+    int index, number = (int)self->dsl_template.property_number;
+    int ret;
+
+    for (index = 0; index < number; ++index) {
+        ret = visit_fp(self->dsl_template.properties + index, index, ctx);
+        if (ret) return ret;
+    }
+
+    return 0;
+}
+
+int event_visit(void* _self, event_visit_fp_t visit_fp, void* ctx)
+{
+    dm_thing_t* self = _self;
+    int index, number = (int)self->dsl_template.event_number;
+    int ret;
+
+    for (index = 0; index < number; ++index) {
+        ret = visit_fp(self->dsl_template.events + index, index, ctx);
+        if (ret) return ret;
+    }
+
+    return 0;
+}
+
+int service_visit(void* _self, service_visit_fp_t visit_fp, void* ctx)
+{
+    dm_thing_t* self = _self;
+    int index, number = (int)self->dsl_template.service_number;
+    int ret;
+
+    for (index = 0; index < number; ++index) {
+        ret = visit_fp(self->dsl_template.services + index, index, ctx);
+        if (ret) return ret;
+    }
+
+    return 0;
 }
 static void property_free_array_type(data_type_x_t* data_type_x)
 {
@@ -2872,10 +3857,18 @@ static void property_free_array_type(data_type_x_t* data_type_x)
     case data_type_type_int:
     case data_type_type_double:
     case data_type_type_float:
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if(data_type_x->data_type_array_t.value_str) {
+            for(index = 0; index < data_type_x->data_type_array_t.size; index++) {
+                p = *(data_type_x->data_type_array_t.value_str + index);
+                if (p) {
+                    dm_lite_free(p);
+                }
+            }
             dm_lite_free(data_type_x->data_type_array_t.value_str);
             data_type_x->data_type_array_t.value_str = NULL;
         }
+#endif
         if(data_type_x->data_type_array_t.array) {
             dm_lite_free(data_type_x->data_type_array_t.array);
             data_type_x->data_type_array_t.array = NULL;
@@ -2911,6 +3904,7 @@ static void property_free_data_type_info(void* dst)
 
     switch (data_type->type) {
     case data_type_type_int:
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
 #ifdef LITE_THING_MODEL
         if (data_type_x->data_type_int_t.value_str) {
             dm_lite_free(data_type_x->data_type_int_t.value_str);
@@ -2934,9 +3928,11 @@ static void property_free_data_type_info(void* dst)
         if (data_type_x->data_type_int_t.unit_name) {
             dm_lite_free(data_type_x->data_type_int_t.unit_name);
         }
+#endif
 #endif
         break;
     case data_type_type_float:
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
 #ifdef LITE_THING_MODEL
         if (data_type_x->data_type_float_t.value_str) {
             dm_lite_free(data_type_x->data_type_float_t.value_str);
@@ -2960,9 +3956,11 @@ static void property_free_data_type_info(void* dst)
         if (data_type_x->data_type_float_t.unit_name) {
             dm_lite_free(data_type_x->data_type_float_t.unit_name);
         }
+#endif
 #endif
         break;
     case data_type_type_double:
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
 #ifdef LITE_THING_MODEL
         if (data_type_x->data_type_double_t.value_str) {
             dm_lite_free(data_type_x->data_type_double_t.value_str);
@@ -2986,6 +3984,7 @@ static void property_free_data_type_info(void* dst)
         if (data_type_x->data_type_double_t.unit_name) {
             dm_lite_free(data_type_x->data_type_double_t.unit_name);
         }
+#endif
 #endif
         break;
     case data_type_type_enum:
@@ -2995,9 +3994,11 @@ static void property_free_data_type_info(void* dst)
                 dm_lite_free(*(data_type_x->data_type_enum_t.enum_item_value + index));
             }
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (data_type_x->data_type_enum_t.value_str) {
             dm_lite_free(data_type_x->data_type_enum_t.value_str);
         }
+#endif
 
         if (data_type_x->data_type_enum_t.enum_item_number) {
             dm_lite_free(data_type_x->data_type_enum_t.enum_item_key);
@@ -3013,9 +4014,11 @@ static void property_free_data_type_info(void* dst)
                 dm_lite_free(*(data_type_x->data_type_bool_t.bool_item_value + index));
             }
         }
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (data_type_x->data_type_bool_t.value_str) {
             dm_lite_free(data_type_x->data_type_bool_t.value_str);
         }
+#endif
 
         if (data_type_x->data_type_bool_t.bool_item_number) {
             dm_lite_free(data_type_x->data_type_bool_t.bool_item_key);
@@ -3025,26 +4028,21 @@ static void property_free_data_type_info(void* dst)
         }
         break;
     case data_type_type_text:
-#ifdef LITE_THING_MODEL
-        if (data_type_x->data_type_text_t.length_str) {
-            dm_lite_free(data_type_x->data_type_text_t.length_str);
-        }
         if (data_type_x->data_type_text_t.value) {
             dm_lite_free(data_type_x->data_type_text_t.value);
         }
-#else
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (data_type_x->data_type_text_t.length_str) {
             dm_lite_free(data_type_x->data_type_text_t.length_str);
         }
-        if (data_type_x->data_type_text_t.value) {
-            dm_lite_free(data_type_x->data_type_text_t.value);
-        }
+#ifndef LITE_THING_MODEL
         if (data_type_x->data_type_text_t.unit) {
             dm_lite_free(data_type_x->data_type_text_t.unit);
         }
         if (data_type_x->data_type_text_t.unit_name) {
             dm_lite_free(data_type_x->data_type_text_t.unit_name);
         }
+#endif
 #endif
         break;
     case data_type_type_struct:
@@ -3057,9 +4055,11 @@ static void property_free_data_type_info(void* dst)
         }
         break;
     case data_type_type_date:
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
         if (data_type_x->data_type_date_t.value_str) {
             dm_lite_free(data_type_x->data_type_date_t.value_str);
         }
+#endif
         break;
     case data_type_type_array:
         property_free_array_type(data_type_x);
@@ -3074,6 +4074,71 @@ static void property_free_data_type_info(void* dst)
     }
 }
 
+/* template lives in the arena, only values set at runtime are on the heap. */
+static void free_lite_property_runtime_memory(lite_property_t* lite_property)
+{
+    data_type_x_t* data_type_x = &lite_property->data_type.value;
+    char** p;
+    int index;
+
+    switch (lite_property->data_type.type) {
+    case data_type_type_text:
+        if (data_type_x->data_type_text_t.value) {
+            dm_lite_free(data_type_x->data_type_text_t.value);
+            data_type_x->data_type_text_t.value = NULL;
+        }
+        break;
+    case data_type_type_array:
+#ifndef DM_THING_COMPACT_VALUE_ENABLED
+        p = data_type_x->data_type_array_t.item_type == data_type_type_text ? (char**)data_type_x->data_type_array_t.array :
+                                                                              data_type_x->data_type_array_t.value_str;
+#else
+        p = data_type_x->data_type_array_t.item_type == data_type_type_text ? (char**)data_type_x->data_type_array_t.array : NULL;
+#endif
+        for (index = 0; p && index < data_type_x->data_type_array_t.size; ++index) {
+            if (p[index]) {
+                dm_lite_free(p[index]);
+                p[index] = NULL;
+            }
+        }
+        break;
+    case data_type_type_struct:
+        for (index = 0; index < lite_property->data_type.data_type_specs_number; ++index) {
+            free_lite_property_runtime_memory((lite_property_t*)lite_property->data_type.specs + index);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void free_template_runtime_memory(dm_thing_t* self)
+{
+    dsl_template_t* dsl_template = &self->dsl_template;
+    service_t* service;
+    size_t i, j;
+
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        free_lite_property_runtime_memory((lite_property_t*)(dsl_template->properties + i));
+    }
+    for (i = 0; i < dsl_template->event_number; ++i) {
+        for (j = 0; j < dsl_template->events[i].event_output_data_num; ++j) {
+            free_lite_property_runtime_memory(dsl_template->events[i].event_output_data + j);
+        }
+    }
+    for (i = 0; i < dsl_template->service_number; ++i) {
+        service = dsl_template->services + i;
+        for (j = 0; j < service->service_output_data_num; ++j) {
+            free_lite_property_runtime_memory(service->service_output_data + j);
+        }
+        if (service->service_type == service_type_property_get) continue;
+        for (j = 0; j < service->service_input_data_num; ++j) {
+            /* lite_property_t is the common head of both input data kinds. */
+            free_lite_property_runtime_memory(&service->service_input_data[j].lite_property);
+        }
+    }
+}
+
 static void free_lite_property(void* _lite_property)
 {
     lite_property_t* lite_property = _lite_property;
@@ -3308,7 +4373,7 @@ static void property_print_data_type_info(void* dst)
     data_type_x = &data_type->value;
     switch (data_type->type) {
     case data_type_type_int:
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         dm_printf("\tdataType:{type:%s,min:%d,max:%d\n\tvalue:%d}\n",
                   data_type->type_str,
                   data_type_x->data_type_int_t.min,
@@ -3327,7 +4392,7 @@ static void property_print_data_type_info(void* dst)
         break;
 #endif
     case data_type_type_float:
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         dm_printf("\tdataType:{type:%s,min:%.2f,max:%.2f,precise:%d\n\tvalue:%.2f}\n",
                   data_type->type_str,
                   data_type_x->data_type_float_t.min,
@@ -3348,7 +4413,7 @@ static void property_print_data_type_info(void* dst)
 #endif
 
     case data_type_type_double:
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         dm_printf("\tdataType:{type:%s,min:%.2f,max:%.2f,precise:%d\n\tvalue:%.7f}\n",
                   data_type->type_str,
                   data_type_x->data_type_double_t.min,
@@ -3397,7 +4462,7 @@ static void property_print_data_type_info(void* dst)
         dm_printf("\n\tvalue:%s}\n", data_type_x->data_type_bool_t.value ? string_true : string_false);
         break;
     case data_type_type_text:
-#ifdef LITE_THING_MODEL
+#if defined(LITE_THING_MODEL) || defined(DM_THING_COMPACT_VALUE_ENABLED)
         dm_printf("\tdataType:{type:%s,length:%d\n\tvalue:%s}\n",
                   data_type->type_str,
                   data_type_x->data_type_text_t.length,
@@ -3704,6 +4769,398 @@ static int dm_thing_get_service_input_output_data_value_by_identifier(void* _sel
     return ret;
 }
 
+static int dm_thing_resolve_property_handle(const void* _self, const char* const identifier, thing_property_handle_t* handle)
+{
+    const dm_thing_t* self = _self;
+    dm_id_index_entry_t* entry;
+    char* arrpre_pos = NULL;
+    const char* p;
+
+    if (identifier == NULL || handle == NULL) return -1;
+
+    handle->lite_property = dm_thing_get_property_by_identifier(self, identifier);
+    if (handle->lite_property == NULL) {
+        dm_log_err("property(%s) not find", identifier);
+        return -1;
+    }
+
+    p = strchr(identifier, DEFAULT_DSL_DELIMITER);
+    if (p) {
+        entry = dm_id_index_find(&self->_property_index, identifier, p - identifier);
+        handle->property = dm_thing_index_item(self, entry);
+    } else {
+        handle->property = handle->lite_property;
+    }
+    handle->arr_index = get_array_index_by_identifier(identifier, &arrpre_pos);
+
+    return 0;
+}
+
+static int dm_thing_set_property_value_by_handle(void* _self, const thing_property_handle_t* handle, const void* value, const char* value_str)
+{
+    dm_thing_t* self = _self;
+    int ret;
+
+    if (handle == NULL || handle->lite_property == NULL) return -1;
+#ifdef PROPERTY_ACCESS_MODE_ENABLED
+    if (handle->property && ((property_t*)handle->property)->access_mode == property_access_mode_r) {
+        dm_log_err("try to set value to readonly property, id:%s\n", ((property_t*)handle->property)->identifier);
+        return -1;
+    }
+#endif
+    value_lock(self);
+    self->_arr_index = handle->arr_index;
+    ret = set_lite_property_value(self, handle->lite_property, value, value_str);
+    self->_arr_index = -1;
+    if (ret == 0) {
+        mark_property_set(self, handle->property);
+    }
+    value_unlock(self);
+
+    return ret;
+}
+
+static int dm_thing_get_property_value_by_handle(void* _self, const thing_property_handle_t* handle, void* value, char** value_str)
+{
+    dm_thing_t* self = _self;
+    int ret;
+
+    if (handle == NULL || handle->lite_property == NULL) return -1;
+#ifdef PROPERTY_ACCESS_MODE_ENABLED
+    if (handle->property && ((property_t*)handle->property)->access_mode == property_access_mode_w) {
+        dm_log_err("try to get value from write only property, id:%s\n", ((property_t*)handle->property)->identifier);
+        return -1;
+    }
+#endif
+    self->_arr_index = handle->arr_index;
+    ret = dm_thing_get_lite_property_value(self, handle->lite_property, value, value_str);
+    self->_arr_index = -1;
+
+    return ret;
+}
+
+/* copies of the value taken under the value mutex, so are consistent against sets of other threads. */
+static int dm_thing_copy_property_value_by_handle(const void* _self, const thing_property_handle_t* handle, void* value, char* buff, int buff_len)
+{
+    const dm_thing_t* self = _self;
+    const lite_property_t* lite_property;
+    const data_type_x_t* data_type_x;
+    const char* str = NULL;
+    char num_buff[DM_THING_VALUE_STR_BUFF_SIZE];
+    data_type_type_t type;
+    int arr_index;
+    int ret = 0;
+
+    if (handle == NULL || handle->lite_property == NULL || (buff && buff_len <= 0)) return -1;
+#ifdef PROPERTY_ACCESS_MODE_ENABLED
+    if (handle->property && ((property_t*)handle->property)->access_mode == property_access_mode_w) {
+        dm_log_err("try to get value from write only property, id:%s\n", ((property_t*)handle->property)->identifier);
+        return -1;
+    }
+#endif
+    lite_property = handle->lite_property;
+    data_type_x = &lite_property->data_type.value;
+    type = lite_property->data_type.type;
+    arr_index = handle->arr_index;
+
+    if (type == data_type_type_struct) return -1;
+    if (type == data_type_type_array) {
+        if (arr_index < 0 || arr_index >= data_type_x->data_type_array_t.size) return -1;
+        type = data_type_x->data_type_array_t.item_type;
+    }
+
+    /* a text has no native value, it is only copied into buff. */
+    if (type == data_type_type_text && value) return -1;
+
+    value_lock(self);
+    if (type == data_type_type_text) {
+        if (lite_property->data_type.type == data_type_type_array) {
+            str = *((char**)data_type_x->data_type_array_t.array + arr_index);
+        } else {
+            str = data_type_x->data_type_text_t.value;
+        }
+        if (str == NULL) str = "";
+    } else {
+        if (value) {
+            if (lite_property->data_type.type == data_type_type_array) {
+                ret = get_array_item_value(lite_property, arr_index, value, NULL);
+            } else {
+                ret = dm_thing_get_lite_property_value(self, lite_property, value, NULL);
+            }
+        }
+        if (ret == 0 && buff) {
+            str = format_value_str(&lite_property->data_type, arr_index, num_buff, sizeof(num_buff));
+            if (str == NULL) ret = -1;
+        }
+    }
+    if (ret == 0 && buff) {
+        ret = strlen(str);
+        if (ret < buff_len) {
+            memcpy(buff, str, ret + 1);
+        } else {
+            ret = -1;
+        }
+    }
+    value_unlock(self);
+
+    return ret;
+}
+
+static void dm_thing_lock_property_values(const void* _self)
+{
+    value_lock(_self);
+}
+
+static void dm_thing_unlock_property_values(const void* _self)
+{
+    value_unlock(_self);
+}
+
+static int dm_thing_start_property_post(void* _self, int message_id)
+{
+    dm_thing_t* self = _self;
+    size_t index;
+    int number = 0;
+
+    self->_property_post_id = message_id;
+
+    if (self->_property_post_state == NULL) return 0;
+
+    /* properties of a post not acked are posted again. */
+    for (index = 0; index < self->dsl_template.property_number; ++index) {
+        if (self->_property_post_state[index] & DM_THING_PROPERTY_CHANGED) {
+            self->_property_post_state[index] = DM_THING_PROPERTY_POSTING;
+        }
+        if (self->_property_post_state[index] & DM_THING_PROPERTY_POSTING) number++;
+    }
+
+    return number;
+}
+
+static int dm_thing_is_property_posting(const void* _self, const void* _property)
+{
+    const dm_thing_t* self = _self;
+    const property_t* property = _property;
+
+    if (self->_property_post_state == NULL || property < self->dsl_template.properties ||
+        property >= self->dsl_template.properties + self->dsl_template.property_number) return 0;
+
+    return (self->_property_post_state[property - self->dsl_template.properties] & DM_THING_PROPERTY_POSTING) ? 1 : 0;
+}
+
+static void dm_thing_finish_property_post(void* _self, int message_id, int success)
+{
+    dm_thing_t* self = _self;
+    size_t index;
+
+    /* an older post is covered by the latest one, which posts its properties again. */
+    if (self->_property_post_state == NULL || message_id != self->_property_post_id || !success) return;
+
+    for (index = 0; index < self->dsl_template.property_number; ++index) {
+        self->_property_post_state[index] &= ~DM_THING_PROPERTY_POSTING;
+    }
+}
+
+/* mark property, or all properties when NULL, to go with next changed property post even if not set. */
+static int dm_thing_request_property_post(void* _self, const void* _property)
+{
+    dm_thing_t* self = _self;
+    const property_t* property = _property;
+    size_t index;
+
+    if (property) {
+        if (property < self->dsl_template.properties ||
+            property >= self->dsl_template.properties + self->dsl_template.property_number) return -1;
+
+        mark_property_changed(self, property);
+
+        return 0;
+    }
+
+    for (index = 0; index < self->dsl_template.property_number; ++index) {
+        mark_property_changed(self, self->dsl_template.properties + index);
+    }
+
+    return 0;
+}
+
+#ifdef DM_REPORT_POLICY_ENABLED
+/* top level property of identifier to hold an aggregate, a numeric one or a numeric array one for samples. */
+static int resolve_aggregate_property(const dm_thing_t* self, const char* identifier, int samples, const property_t** target)
+{
+    data_type_type_t item_type;
+    double number;
+
+    *target = NULL;
+    if (identifier == NULL) return 0;
+
+    *target = dm_thing_get_property_by_identifier(self, identifier);
+    if (*target == NULL || *target < self->dsl_template.properties ||
+        *target >= self->dsl_template.properties + self->dsl_template.property_number) {
+        dm_log_err("aggregate property(%s) not find", identifier);
+        return -1;
+    }
+
+    if (!samples) return get_property_number(*target, &number);
+
+    item_type = (*target)->data_type.value.data_type_array_t.item_type;
+    if ((*target)->data_type.type != data_type_type_array ||
+        (item_type != data_type_type_int && item_type != data_type_type_float && item_type != data_type_type_double)) {
+        dm_log_err("aggregate samples property(%s) not int, float or double array", identifier);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int dm_thing_set_property_report_policy(void* _self, const void* _property, const void* _policy)
+{
+    dm_thing_t* self = _self;
+    const property_t* property = _property;
+    const dm_report_policy_t* policy = _policy;
+    dm_thing_report_t* report;
+    const property_t* aggregate[4] = {NULL, NULL, NULL, NULL};
+    size_t index;
+    size_t end;
+    uint64_t now;
+
+    if (property && (property < self->dsl_template.properties ||
+                     property >= self->dsl_template.properties + self->dsl_template.property_number)) return -1;
+
+    if (policy && (policy->deadband < 0 || policy->deadband_percent < 0 || policy->min_interval_ms < 0 ||
+                   policy->max_interval_ms < 0 || policy->aggregate_window_ms < 0)) return -1;
+
+    if (policy && policy->aggregate_window_ms > 0) {
+        /* all properties can not share where their aggregates go. */
+        if (property == NULL && (policy->aggregate_min || policy->aggregate_max ||
+                                 policy->aggregate_count || policy->aggregate_samples)) return -1;
+
+        if (resolve_aggregate_property(self, policy->aggregate_min, 0, &aggregate[0]) == -1 ||
+            resolve_aggregate_property(self, policy->aggregate_max, 0, &aggregate[1]) == -1 ||
+            resolve_aggregate_property(self, policy->aggregate_count, 0, &aggregate[2]) == -1 ||
+            resolve_aggregate_property(self, policy->aggregate_samples, 1, &aggregate[3]) == -1) return -1;
+    }
+
+    if (self->_property_report == NULL) {
+        if (policy == NULL || self->dsl_template.property_number == 0) return 0;
+
+        self->_property_report = dm_lite_calloc(self->dsl_template.property_number, sizeof(dm_thing_report_t));
+        if (self->_property_report == NULL) return -1;
+    }
+
+    index = property ? (size_t)(property - self->dsl_template.properties) : 0;
+    end = property ? index + 1 : self->dsl_template.property_number;
+    now = HAL_UptimeMs();
+
+    for (; index < end; ++index) {
+        report = self->_property_report + index;
+        memset(report, 0, sizeof(dm_thing_report_t));
+        if (self->_property_post_state) self->_property_post_state[index] &= ~DM_THING_PROPERTY_HELD;
+
+        if (policy == NULL) continue;
+
+        report->policy = *policy;
+        report->policy.aggregate_min = NULL;
+        report->policy.aggregate_max = NULL;
+        report->policy.aggregate_count = NULL;
+        report->policy.aggregate_samples = NULL;
+        report->attached = 1;
+        report->reported_ms = now;
+        report->aggregate_min = aggregate[0];
+        report->aggregate_max = aggregate[1];
+        report->aggregate_count = aggregate[2];
+        report->aggregate_samples = aggregate[3];
+    }
+
+    return 0;
+}
+
+static int dm_thing_report_due_properties(void* _self, uint64_t now, int mark, uint32_t* timeout_ms)
+{
+    dm_thing_t* self = _self;
+    dm_thing_report_t* report;
+    const property_t* property;
+    unsigned char* state;
+    uint64_t due;
+    size_t index;
+    int number = 0;
+
+    if (self->_property_report == NULL) return 0;
+
+    for (index = 0; index < self->dsl_template.property_number; ++index) {
+        report = self->_property_report + index;
+        if (!report->attached) continue;
+
+        property = self->dsl_template.properties + index;
+        if (report->policy.aggregate_window_ms > 0) {
+            number += report_property_window(self, report, property, now, mark, timeout_ms);
+            continue;
+        }
+
+        state = self->_property_post_state ? self->_property_post_state + index : NULL;
+
+        if (state && (*state & DM_THING_PROPERTY_HELD)) {
+            due = report->reported_ms + report->policy.min_interval_ms;
+        } else if (report->policy.max_interval_ms > 0) {
+            due = report->reported_ms + report->policy.max_interval_ms;
+        } else {
+            continue;
+        }
+
+        if (due > now || !mark) {
+            due = due > now ? due - now : 0;
+            if (timeout_ms && due < *timeout_ms) *timeout_ms = (uint32_t)due;
+            number += due == 0;
+            continue;
+        }
+
+        mark_property_changed(self, property);
+        if (self->_property_post_state) self->_property_post_state[index] &= ~DM_THING_PROPERTY_HELD;
+        record_property_report(report, property, now);
+        number++;
+
+        if (report->policy.max_interval_ms > 0 && timeout_ms && (uint32_t)report->policy.max_interval_ms < *timeout_ms) {
+            *timeout_ms = (uint32_t)report->policy.max_interval_ms;
+        }
+    }
+
+    return number;
+}
+#endif
+
+static int install_profile_string(dm_thing_t* self, char** dst, const char* str, int len)
+{
+    char* buf;
+
+    /* strings of an arena template, or of a tsl blob, are given back with the whole arena. */
+    if (dm_arena_is_active(&self->_arena)) {
+        buf = dm_arena_calloc(&self->_arena, 1, len + 1);
+    } else {
+        buf = dm_lite_calloc(1, len + 1);
+    }
+
+    if (buf == NULL) return -1;
+
+    memcpy(buf, str, len);
+
+    if (*dst && !dm_arena_is_active(&self->_arena)) dm_lite_free(*dst);
+    *dst = buf;
+
+    return 0;
+}
+
+/* replace productKey/deviceName of the profile, for things sharing a template loaded from another thing's tsl. */
+static int dm_thing_set_profile(void* _self, const char* product_key, int product_key_len, const char* device_name, int device_name_len)
+{
+    dm_thing_t* self = _self;
+    profile_t* profile = &self->dsl_template.profile;
+
+    if (product_key && install_profile_string(self, &profile->product_key, product_key, product_key_len) != 0) return -1;
+    if (device_name && install_profile_string(self, &profile->device_name, device_name, device_name_len) != 0) return -1;
+
+    return 0;
+}
+
 static thing_t _dm_thing_class = {
     sizeof(dm_thing_t),
     string_dm_thing_class_name,
@@ -3746,6 +5203,23 @@ static thing_t _dm_thing_class = {
     dm_thing_set_service_input_output_data_value_by_identifier,
     dm_thing_get_service_input_output_data_value_by_identifier,
     dm_thing_get_lite_property_value,
+    dm_thing_resolve_property_handle,
+    dm_thing_set_property_value_by_handle,
+    dm_thing_get_property_value_by_handle,
+    dm_thing_copy_property_value_by_handle,
+    dm_thing_lock_property_values,
+    dm_thing_unlock_property_values,
+    dm_thing_start_property_post,
+    dm_thing_is_property_posting,
+    dm_thing_finish_property_post,
+    dm_thing_set_property_array_values,
+    dm_thing_get_property_array_values,
+    dm_thing_request_property_post,
+    dm_thing_set_profile,
+#ifdef DM_REPORT_POLICY_ENABLED
+    dm_thing_set_property_report_policy,
+    dm_thing_report_due_properties,
+#endif
 };
 
 const void* get_dm_thing_class()
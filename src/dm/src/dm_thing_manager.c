@@ -14,19 +14,42 @@
 #include "single_list.h"
 #include "dm_import.h"
 #include "cmp_message_info.h"
+#include "dm_object.h"
 #include "cmp_abstract_impl.h"
+#include "dm_json_writer.h"
+#include "dm_tsl_blob.h"
+#include "dm_request_table.h"
+#include "utils_identity.h"
+#include "utils_sha256.h"
+#ifdef PAYLOAD_COMPRESS_ENABLED
+#include "utils_lz.h"
+#endif
+#ifdef DM_OFFLINE_ENABLED
+#include "dm_offline.h"
+#include "utils_epoch_time.h"
+#endif /* DM_OFFLINE_ENABLED */
 
 #include "iot_import.h"
 #include "iot_export.h"
 #include "class_interface.h"
 
 #include "cJSON.h"
+#ifdef USING_UTILS_JSON
+#include "json_parser.h"
+#endif /* USING_UTILS_JSON */
+#include "lite-number.h"
+#include "lite-log-ring.h"
+#include "lite-trace.h"
+#include "lite-metrics.h"
+#include "lite-startup.h"
+#include "lite-mem-pressure.h"
 
 
 static const char string_dm_thing_manager_class_name[] __DM_READ_ONLY__ = "dm_thg_mng_cls";
 static const char string_thing_service_property_set[] __DM_READ_ONLY__ = "thing.service.property.set";
 static const char string_thing_service_property_get[] __DM_READ_ONLY__ = "thing.service.property.get";
 static const char string_thing_event_property_post[] __DM_READ_ONLY__ = "thing.event.property.post";
+static const char string_event_property_post_identifier[] __DM_READ_ONLY__ = "post";
 static const char string_method_name_thing_enable[] __DM_READ_ONLY__ = METHOD_NAME_THING_ENABLE;
 static const char string_method_name_thing_disable[] __DM_READ_ONLY__ = METHOD_NAME_THING_DISABLE;
 static const char string_method_name_thing_delete[] __DM_READ_ONLY__ = METHOD_NAME_THING_DELETE;
@@ -38,6 +61,9 @@ static const char string_method_name_up_raw[] __DM_READ_ONLY__ = METHOD_NAME_UP_
 static const char string_method_name_up_raw_reply[] __DM_READ_ONLY__ = METHOD_NAME_UP_RAW_REPLY;
 static const char string_method_name_property_set[] __DM_READ_ONLY__ = METHOD_NAME_PROPERTY_SET;
 static const char string_method_name_property_get[] __DM_READ_ONLY__ = METHOD_NAME_PROPERTY_GET;
+static const char string_method_name_property_post_reply[] __DM_READ_ONLY__ = METHOD_NAME_PROPERTY_POST_REPLY;
+static const char string_uri_prefix_sys[] __DM_READ_ONLY__ = "/sys/";
+static const char string_method_name_sdk_metrics_post[] __DM_READ_ONLY__ = METHOD_NAME_SDK_METRICS_POST;
 #ifdef DEVICEINFO_ENABLED
 static const char string_method_name_deviceinfo_update[] __DM_READ_ONLY__ = METHOD_NAME_DEVICEINFO_UPDATE;
 static const char string_method_name_deviceinfo_update_reply[] __DM_READ_ONLY__ = METHOD_NAME_DEVICEINFO_UPDATE_REPLY;
@@ -48,6 +74,9 @@ static const char string_method_name_deviceinfo_delete_reply[] __DM_READ_ONLY__
 static const char string_method_name_rrpc_request_plus[] __DM_READ_ONLY__ = METHOD_NAME_RRPC_REQUEST_PLUS;
 static const char string_method_name_rrpc_request[] __DM_READ_ONLY__ = METHOD_NAME_RRPC_REQUEST;
 #endif /* RRPC_ENABLED */
+#ifdef DM_OFFLINE_ENABLED
+static const char string_method_name_property_history_post[] __DM_READ_ONLY__ = METHOD_NAME_PROPERTY_HISTORY_POST;
+#endif /* DM_OFFLINE_ENABLED */
 static const char string_cmp_event_handler_prompt_start[] __DM_READ_ONLY__ = "\ncmp_event_handler:\n###\n";
 static const char string_cmp_event_handler_prompt_end[] __DM_READ_ONLY__ = "\n###\n";
 static const char string_cmp_event_type_cloud_connected[] __DM_READ_ONLY__ = "cloud connected";
@@ -62,9 +91,9 @@ static const char string_cmp_event_type_new_data_received[] __DM_READ_ONLY__ = "
 
 static const char string_local_thing_list[] __DM_READ_ONLY__ = "local thing";
 static const char string_local_thing_name_list[] __DM_READ_ONLY__ = "local thing name";
+static const char string_template_list[] __DM_READ_ONLY__ = "thing template";
 static const char string_sub_thing_list[] __DM_READ_ONLY__ = "sub thing";
 static const char string_callback_list[] __DM_READ_ONLY__ = "callback list";
-static const char string_service_property_get_identifier_list[] __DM_READ_ONLY__ = "service property get id list";
 
 static const char string_success[] __DM_READ_ONLY__ = "success";
 static const char string_fail[] __DM_READ_ONLY__ = "fail";
@@ -77,26 +106,43 @@ static const char string_event[] __DM_READ_ONLY__ = "event";
 static const char string_service[] __DM_READ_ONLY__ = "service";
 
 static void free_list_string(void* _thing_name, va_list* params);
-static void free_list_thing(void* _thing_name, va_list* params);
-static void local_thing_list_iterator(const void* _self, handle_fp_t handle_fp);
+static void free_list_template(void* _template, va_list* params);
+static int free_list_thing(void* _thing, void* ctx);
+static int local_thing_list_visit(const void* _self, visit_fp_t visit_fp);
+static int local_thing_visit(const void* _self, visit_fp_t visit_fp);
 static void invoke_callback_func(void* _callback_fp, va_list* params);
-static void callback_list_iterator(const void* _self, handle_fp_t handle_fp);
 static void generate_subscribe_uri(void* _dm_thing_manager, void* _thing);
 static void send_request_to_uri(void* _dm_thing_manager, const char *_uri);
 static void clear_and_set_message_info(message_info_t** _message_info, dm_thing_manager_t* _dm_thing_manager);
 static void get_product_key_device_name(char* _product_key, char* _device_name, void* _thing, void* _dm_thing_manager);
 static void* dm_thing_manager_generate_new_local_thing(void* _self, const char* tsl, int tsl_len);
-static int dm_thing_manager_set_thing_property_value(void* _self, const void* thing_id, const void* identifier, const void* value, const char* value_str);
+#if defined(TSL_CACHE_ENABLED) && defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+static thing_t** load_tsl_cache(dm_thing_manager_t* self);
+static void save_tsl_cache(dm_thing_manager_t* self, const char* tsl, int tsl_len, thing_t** thing);
+#endif
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+static void free_uplink_pending(dm_uplink_pending_t* pending);
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+static void on_mem_pressure(int level, void* ctx);
+static int set_thing_property_value(dm_thing_manager_t* dm_thing_manager, const dm_thing_manager_message_t* message, thing_t** thing,
+                                    const char* identifier, const void* value, const char* value_str);
 
 static int dm_thing_manager_install_product_key_device_name(void *_self, const void* thing_id, char *product_key, char *device_name);
 
 #ifdef RRPC_ENABLED
+static int answer_service(dm_thing_manager_t* self, const void* thing_id, const void* identifier, int response_id, int code, int rrpc);
 static int dm_thing_manager_answer_service(void* _self, const void* thing_id, const void* identifier, int response_id, int code, int rrpc);
 #else
+static int answer_service(dm_thing_manager_t* self, const void* thing_id, const void* identifier, int response_id, int code);
 static int dm_thing_manager_answer_service(void* _self, const void* thing_id, const void* identifier, int response_id, int code);
 #endif /* RRPC_ENABLED */
 
 static void cmp_register_handler(iotx_cmp_send_peer_t* _source, iotx_cmp_message_info_t* _msg, void* user_data);
+static void route_property_set(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message);
+static void route_property_get(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message);
+#ifdef USING_UTILS_JSON
+static int set_service_input_by_token(thing_t** thing, service_t* service, char* parameter, int parameter_length);
+#endif /* USING_UTILS_JSON */
 
 static void list_insert(void* _list, void* _data)
 {
@@ -105,38 +151,140 @@ static void list_insert(void* _list, void* _data)
     (*list)->insert(list, _data);
 }
 
-static void invoke_callback_list(void* _dm_thing_manager, dm_callback_type_t dm_callback_type)
+#if defined(TSL_CACHE_ENABLED) && defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+static void list_remove(void* _list, void* _data)
+{
+    list_t** list = (list_t**)_list;
+
+    (*list)->remove(list, _data);
+}
+#endif
+
+static void invoke_callback_list(void* _dm_thing_manager, const dm_thing_manager_message_t* message, dm_callback_type_t dm_callback_type)
 {
     dm_thing_manager_t* dm_thing_manager = _dm_thing_manager;
     list_t** list;
 
-    assert(dm_callback_type < dm_callback_type_number);
+    assert(message && dm_callback_type < dm_callback_type_number);
 
     /* invoke callback funtions. */
     list = dm_thing_manager->_callback_list;
     if (list && !(*list)->empty(list)) {
-        dm_thing_manager->_callback_type = dm_callback_type;
-        callback_list_iterator(dm_thing_manager, invoke_callback_func);
+        list_iterator(list, invoke_callback_func, message, dm_callback_type);
+    }
+}
+
+/* property_value_set callback of a top level property, message is the downlink message setting it or NULL. */
+static void invoke_property_value_set_callback(dm_thing_manager_t* dm_thing_manager, const dm_thing_manager_message_t* message,
+                                               thing_t** thing, const char* identifier)
+{
+    dm_thing_manager_message_t property_message = {0};
+
+    if (message) property_message = *message;
+    property_message.thing = thing;
+    property_message.identifier = identifier;
+
+    invoke_callback_list(dm_thing_manager, &property_message, dm_callback_type_property_value_set);
+}
+
+static void send_lock(dm_thing_manager_t* dm_thing_manager)
+{
+    if (dm_thing_manager->_send_mutex) HAL_MutexLock(dm_thing_manager->_send_mutex);
+}
+
+static void send_unlock(dm_thing_manager_t* dm_thing_manager)
+{
+    if (dm_thing_manager->_send_mutex) HAL_MutexUnlock(dm_thing_manager->_send_mutex);
+}
+
+static void request_lock(dm_thing_manager_t* dm_thing_manager)
+{
+    if (dm_thing_manager->_request_mutex) HAL_MutexLock(dm_thing_manager->_request_mutex);
+}
+
+static void request_unlock(dm_thing_manager_t* dm_thing_manager)
+{
+    if (dm_thing_manager->_request_mutex) HAL_MutexUnlock(dm_thing_manager->_request_mutex);
+}
+
+/* caller holds send lock. the request waits for its reply before it is sent, the reply may come on cmp thread before send returns. */
+static int add_request(dm_thing_manager_t* dm_thing_manager, int request_id)
+{
+    int ret = -1;
+
+    request_lock(dm_thing_manager);
+    if (dm_thing_manager->_requests == NULL) {
+        dm_thing_manager->_requests = dm_lite_calloc(1, sizeof(dm_request_table_t));
+        if (dm_thing_manager->_requests) dm_request_table_init(dm_thing_manager->_requests, HAL_UptimeMs());
+    }
+    if (dm_thing_manager->_requests) {
+        ret = dm_request_table_add(dm_thing_manager->_requests, request_id, dm_thing_manager->_thing_id, dm_thing_manager->_reply_handler,
+                                   dm_thing_manager->_reply_ctx, HAL_UptimeMs() + dm_thing_manager->_reply_timeout_ms);
+    }
+    request_unlock(dm_thing_manager);
+
+    return ret;
+}
+
+static int take_request(dm_thing_manager_t* dm_thing_manager, int request_id, dm_request_t* request)
+{
+    int ret = -1;
+
+    request_lock(dm_thing_manager);
+    if (dm_thing_manager->_requests) ret = dm_request_table_take(dm_thing_manager->_requests, request_id, request);
+    request_unlock(dm_thing_manager);
+
+    return ret;
+}
+
+/* reply of a request waiting for it goes to the handler of the request. */
+static void finish_request(dm_thing_manager_t* dm_thing_manager, const iotx_cmp_message_info_t* iotx_cmp_message_info)
+{
+    dm_request_t request;
+
+    if (take_request(dm_thing_manager, iotx_cmp_message_info->id, &request) != 0) return;
+
+    request.handler(request.thing_id, request.id, iotx_cmp_message_info->code, iotx_cmp_message_info->parameter,
+                    iotx_cmp_message_info->parameter_length, request.ctx);
+}
+
+static void expire_requests(dm_thing_manager_t* dm_thing_manager)
+{
+    dm_request_t request;
+    uint64_t now = HAL_UptimeMs();
+    int ret;
+
+    while (1) {
+        request_lock(dm_thing_manager);
+        ret = dm_thing_manager->_requests ? dm_request_table_take_expired(dm_thing_manager->_requests, now, &request) : -1;
+        request_unlock(dm_thing_manager);
+
+        if (ret != 0) break;
+
+        request.handler(request.thing_id, request.id, DM_REPLY_CODE_TIMEOUT, NULL, 0, request.ctx);
     }
 }
 
-static void local_thing_generate_subscribe_uri(void* _thing, va_list* params)
+static int local_thing_generate_subscribe_uri(void* _thing, void* ctx)
 {
     thing_t** thing = _thing;
     dm_thing_manager_t* dm_thing_manager;
 
-    dm_thing_manager = va_arg(*params, void*);
+    dm_thing_manager = ctx;
 
     assert(dm_thing_manager && thing && *thing);
 
     /* subscribe subjects. */
     generate_subscribe_uri(dm_thing_manager, thing);
+
+    return 0;
 }
 
 static void cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t* msg, void* user_data)
 {
     iotx_cmp_event_result_t* cmp_event_result;
     dm_thing_manager_t* dm_thing_manager = user_data;
+    dm_thing_manager_message_t message = {0};
     const char* event_str = NULL;
 
     dm_printf("%s", string_cmp_event_handler_prompt_start);
@@ -148,6 +296,9 @@ static void cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t* msg, void* u
                     cmp_event_result->URI, cmp_event_result->URI_type == IOTX_CMP_URI_SYS ?
                         string_uri_type_sys : (cmp_event_result->URI_type == IOTX_CMP_URI_EXT ? string_uri_type_ext : string_uri_type_undefine));
 
+        if (cmp_event_result->result != 0) LITE_STARTUP_END(LITE_STARTUP_SUBSCRIBE, 0);
+        if (HAL_AtomicAdd(&dm_thing_manager->_regist_pending, -1) <= 0) LITE_STARTUP_END(LITE_STARTUP_SUBSCRIBE, 1);
+
         event_str = string_cmp_event_type_register_result;
     } else if (IOTX_CMP_EVENT_UNREGISTER_RESULT == msg->event_id) {
         cmp_event_result = (iotx_cmp_event_result_t*)msg->msg;
@@ -160,16 +311,17 @@ static void cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t* msg, void* u
     } else if (IOTX_CMP_EVENT_CLOUD_DISCONNECT == msg->event_id) {
         if (dm_thing_manager->_cloud_connected) {
             dm_thing_manager->_cloud_connected = 0;
-            invoke_callback_list(dm_thing_manager, dm_callback_type_cloud_disconnected);
+            invoke_callback_list(dm_thing_manager, &message, dm_callback_type_cloud_disconnected);
         }
         event_str = string_cmp_event_type_cloud_disconnect;
     } else if (IOTX_CMP_EVENT_CLOUD_RECONNECT == msg->event_id) {
         if (dm_thing_manager->_cloud_connected == 0) {
             dm_thing_manager->_cloud_connected = 1;
-            invoke_callback_list(dm_thing_manager, dm_callback_type_cloud_connected);
+            invoke_callback_list(dm_thing_manager, &message, dm_callback_type_cloud_connected);
         }
         event_str = string_cmp_event_type_cloud_reconnect;
     }  else if (IOTX_CMP_EVENT_CLOUD_CONNECTED == msg->event_id) {
+        LITE_STARTUP_END(LITE_STARTUP_MQTT_CONNECT, 1);
         if (dm_thing_manager->_cloud_connected == 0) {
             dm_thing_manager->_cloud_connected = 1;
 
@@ -178,13 +330,20 @@ static void cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t* msg, void* u
             generate_subscribe_uri(dm_thing_manager, NULL);
 
             if (dm_thing_manager->_get_tsl_from_cloud) {
+#if defined(TSL_CACHE_ENABLED) && defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+                /* the thing of the tsl kept by the last boot, the get below only revalidates it. */
+                if (dm_thing_manager->_cloud_template == NULL) load_tsl_cache(dm_thing_manager);
+#endif
                 /* get tsl template. */
+                send_lock(dm_thing_manager);
+                LITE_STARTUP_BEGIN(LITE_STARTUP_TSL_GET);
                 send_request_to_uri(dm_thing_manager, string_method_name_thing_dsl_get);
+                send_unlock(dm_thing_manager);
             }
 
-            local_thing_list_iterator(dm_thing_manager, local_thing_generate_subscribe_uri);
+            local_thing_list_visit(dm_thing_manager, local_thing_generate_subscribe_uri);
 
-            invoke_callback_list(dm_thing_manager, dm_callback_type_cloud_connected);
+            invoke_callback_list(dm_thing_manager, &message, dm_callback_type_cloud_connected);
         }
         event_str = string_cmp_event_type_cloud_connected;
     } else if (IOTX_CMP_EVENT_FOUND_DEVICE == msg->event_id) {
@@ -212,26 +371,72 @@ static void print_iotx_cmp_message_info(const void* _source, const void* _msg)
     const iotx_cmp_send_peer_t* iotx_cmp_send_peer = _source;
     const iotx_cmp_message_info_t* iotx_cmp_message_info = _msg;
 
-    dm_printf("***\nsource\t%s:%s\n", iotx_cmp_send_peer->product_key, iotx_cmp_send_peer->device_name);
+    /* debug level, one line per message, compiled out below it and deferred by the log ring. */
+    dm_log_debug("source %s:%s, type %s, URI %s, URI_type %s, code %d, id %d, method %s",
+                 iotx_cmp_send_peer->product_key, iotx_cmp_send_peer->device_name,
+                 iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_RAW ?
+                 "RAW" : (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_REQUEST ? string_request : string_response),
+                 iotx_cmp_message_info->URI,
+                 iotx_cmp_message_info->URI_type == IOTX_CMP_URI_SYS ?
+                 string_uri_type_sys : (iotx_cmp_message_info->URI_type == IOTX_CMP_URI_EXT ? string_uri_type_ext : string_uri_type_undefine),
+                 iotx_cmp_message_info->code, iotx_cmp_message_info->id,
+                 iotx_cmp_message_info->method ? iotx_cmp_message_info->method : "NULL");
+    dm_log_debug("param %d bytes: %.*s", (int)iotx_cmp_message_info->parameter_length,
+                 (int)iotx_cmp_message_info->parameter_length, (char*)iotx_cmp_message_info->parameter);
+}
+
+/* with CJSON_STRING_ZEROCOPY cJSON strings point into the params and are not NUL terminated. */
+static int json_string_length(const cJSON* item)
+{
+#ifdef CJSON_STRING_ZEROCOPY
+    return (int)item->valuestring_length;
+#else
+    return (int)strlen(item->valuestring);
+#endif
+}
+
+static char* json_string_dup(const cJSON* item)
+{
+    char* str;
+    int len = json_string_length(item);
+
+    str = dm_lite_calloc(1, len + 1);
+    if (str) memcpy(str, item->valuestring, len);
+
+    return str;
+}
+
+/* params of a downlink message are parsed into one buffer given back with the message, heap when they do not fit. */
+static cJSON* message_json_parse(dm_thing_manager_message_t* message, const char* text)
+{
+    cJSON* obj = NULL;
+    size_t len, size;
+
+    if (text == NULL) return NULL;
 
-    dm_printf("type\t%s\n", iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_RAW ?
-                  "RAW" : (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_REQUEST ? string_request : string_response));
-    dm_printf("URI\t%s\n", iotx_cmp_message_info->URI);
+    /* under memory pressure the trees go to the heap, it takes only what they need. */
+    if (message->json_arena_buffer == NULL && LITE_mem_pressure_level() == LITE_MEM_PRESSURE_NONE) {
+        len = strlen(text);
+        size = (len / DM_MESSAGE_JSON_ARENA_BYTES_PER_ITEM + 2) * sizeof(cJSON) + len + 1;
+        message->json_arena_buffer = dm_lite_malloc(size);
+        cJSON_InitArena(&message->json_arena, message->json_arena_buffer, message->json_arena_buffer ? size : 0);
+    }
 
-    dm_printf("URI_type\t%s\n", iotx_cmp_message_info->URI_type == IOTX_CMP_URI_SYS ?
-                  string_uri_type_sys : (iotx_cmp_message_info->URI_type == IOTX_CMP_URI_EXT ? string_uri_type_ext : string_uri_type_undefine));
+    obj = cJSON_ParseInArena(text, &message->json_arena);
 
-    dm_printf("code\t%d\n", iotx_cmp_message_info->code);
-    dm_printf("id\t%d\n", iotx_cmp_message_info->id);
+    return obj ? obj : cJSON_Parse(text);
+}
 
-    if (iotx_cmp_message_info->method)
-        dm_printf("method\t%s\n", iotx_cmp_message_info->method);
-    else
-        dm_printf("method\tNULL\n");
+static void message_json_delete(dm_thing_manager_message_t* message, cJSON* obj)
+{
+    if (obj && !cJSON_ArenaOwns(&message->json_arena, obj)) cJSON_Delete(obj);
+}
 
-    dm_printf("param:\n%s\n", (char*)iotx_cmp_message_info->parameter);
-    dm_printf("param len:\t%dbytes\n", iotx_cmp_message_info->parameter_length);
-    dm_printf("***\n");
+static void message_json_release(dm_thing_manager_message_t* message)
+{
+    if (message->json_arena_buffer) dm_lite_free(message->json_arena_buffer);
+    message->json_arena_buffer = NULL;
+    cJSON_InitArena(&message->json_arena, NULL, 0);
 }
 
 static int check_set_lite_property_for_struct(cJSON* cjson_obj, lite_property_t *lite_property)
@@ -253,13 +458,15 @@ static int check_set_lite_property_for_struct(cJSON* cjson_obj, lite_property_t
     return 0;
 }
 
-static void find_and_set_array_item(dm_thing_manager_t* dm_thing_manager,thing_t** thing, cJSON* cjson_arr_obj, int item_index, lite_property_t *lite_property,data_type_type_t type)
+static void find_and_set_array_item(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message, thing_t** thing, cJSON* cjson_arr_obj,
+                                    int item_index, lite_property_t *lite_property, data_type_type_t type, const char* identifier_set)
 {
+    char* value_set = NULL;
     int int_val;
     float float_val;
     double double_val;
     char temp_buf[64] = {0};
-    char identifier[64] = {0};
+    char identifier[128 + 16] = {0}; /* identifier_set, as long as identifier_buff of the caller, and [item_index]. */
     char* string_val = NULL;
     cJSON *arr_json_item;
     if(item_index > lite_property->data_type.value.data_type_array_t.size) {
@@ -275,57 +482,59 @@ static void find_and_set_array_item(dm_thing_manager_t* dm_thing_manager,thing_t
     switch(lite_property->data_type.value.data_type_array_t.item_type) {
         case data_type_type_int: {
             int_val = arr_json_item->valueint;
-            dm_snprintf(temp_buf, sizeof(temp_buf), "%d", int_val);
+            LITE_format_llong(temp_buf, int_val);
         }break;
         case data_type_type_double: {
                 double_val = arr_json_item->valuedouble;
-                dm_snprintf(temp_buf, sizeof(temp_buf), "%.16lf", double_val);
+                LITE_format_fixed(temp_buf, double_val, 16);
         }break;
         case data_type_type_float: {
             float_val = arr_json_item->valuedouble;
-            dm_snprintf(temp_buf, sizeof(temp_buf), "%.7f", float_val);
+            LITE_format_fixed(temp_buf, float_val, 7);
         }break;
         case data_type_type_text: {
-            string_val = dm_lite_calloc(1, strlen(arr_json_item->valuestring) + 1);
+            string_val = json_string_dup(arr_json_item);
             assert(string_val);
             if (string_val == NULL) {
                 dm_printf("NO memory...");
                 return;
             }
-            strcpy(string_val, arr_json_item->valuestring);
         }break;
         default:{
             dm_log_err("don't support %d type", lite_property->data_type.value.data_type_array_t.item_type);
             goto do_exit;
         }
     }
-    dm_thing_manager->_property_identifier_value_set = NULL;
     if (string_val) {
-        dm_thing_manager->_property_identifier_value_set = string_val;
+        value_set = string_val;
     } else if (strlen(temp_buf)) {
-        dm_thing_manager->_property_identifier_value_set = dm_lite_calloc(1, strlen(temp_buf) + 1);
-        assert(dm_thing_manager->_property_identifier_value_set);
-        strcpy(dm_thing_manager->_property_identifier_value_set, temp_buf);
+        value_set = dm_lite_calloc(1, strlen(temp_buf) + 1);
+        assert(value_set);
+        strcpy(value_set, temp_buf);
     }
 
-    if (dm_thing_manager->_property_identifier_set && dm_thing_manager->_property_identifier_value_set) {
-        dm_snprintf(identifier, sizeof(identifier), "%s[%d]",(char*)dm_thing_manager->_property_identifier_set, item_index);
-        dm_thing_manager_set_thing_property_value(dm_thing_manager, thing, identifier,
-                                                  NULL, dm_thing_manager->_property_identifier_value_set);
+    if (identifier_set && value_set) {
+        dm_snprintf(identifier, sizeof(identifier), "%s[%d]", identifier_set, item_index);
+        message->ret = set_thing_property_value(dm_thing_manager, message, thing, identifier, NULL, value_set);
 
-        dm_lite_free(dm_thing_manager->_property_identifier_value_set);
-        dm_thing_manager->_property_identifier_value_set = NULL;
+        dm_lite_free(value_set);
     }
 do_exit:
     return;
 }
 
 
-static void find_and_set_lite_property_struct_for_service_property_set(void* _item, ...);
-static void find_and_set_lite_property_for_service_property_set(void* _item, int _index, va_list* params)
+typedef struct {
+    dm_thing_manager_t* dm_thing_manager;
+    dm_thing_manager_message_t* message;
+    cJSON*              property_set_param_obj;
+    thing_t**           thing;
+    char*               identifier_prefix; /* struct identifier when setting a struct member, or NULL. */
+} property_set_ctx_t;
+
+static void set_lite_property_for_service_property_set(lite_property_t* lite_property, property_set_ctx_t* property_set_ctx)
 {
-    property_t* property = _item;
-    lite_property_t* lite_property;
+    property_set_ctx_t struct_property_set_ctx;
     lite_property_t* lite_property_struct;
     dm_thing_manager_t* dm_thing_manager;
     thing_t** thing;
@@ -338,65 +547,52 @@ static void find_and_set_lite_property_for_service_property_set(void* _item, int
     char* string_val = NULL;
     char* identifier_prefix = NULL;
     char identifier_buff[128] = {0};
+    const char* identifier_set = NULL;
+    char* value_set = NULL;
     int index;
     int arrsize = 0;
 
-    dm_thing_manager = va_arg(*params, dm_thing_manager_t*);
-    property_set_param_obj = va_arg(*params, cJSON*);
-    thing = va_arg(*params, thing_t**);
-    identifier_prefix = va_arg(*params, char*);
-
-    _index = _index;
-
-    assert(property && dm_thing_manager && property_set_param_obj && thing && *thing);
+    dm_thing_manager = property_set_ctx->dm_thing_manager;
+    property_set_param_obj = property_set_ctx->property_set_param_obj;
+    thing = property_set_ctx->thing;
+    identifier_prefix = property_set_ctx->identifier_prefix;
 
-    lite_property = (lite_property_t*)property;
+    assert(lite_property && dm_thing_manager && property_set_param_obj && thing && *thing);
 
     temp_cjson_obj = cJSON_GetObjectItem(property_set_param_obj, lite_property->identifier);
     if (temp_cjson_obj) {
         if (identifier_prefix) {
             dm_snprintf(identifier_buff, sizeof(identifier_buff), "%s%c%s", identifier_prefix, DEFAULT_DSL_DELIMITER, lite_property->identifier);
-            dm_thing_manager->_property_identifier_set = identifier_buff;
+            identifier_set = identifier_buff;
         } else {
-            dm_thing_manager->_property_identifier_set = lite_property->identifier;
+            identifier_set = lite_property->identifier;
         }
 
         if (lite_property->data_type.type == data_type_type_text) {
-#ifndef CJSON_STRING_ZEROCOPY
-            string_val = dm_lite_calloc(1, strlen(temp_cjson_obj->valuestring) + 1);
-            assert(string_val);
-            if (string_val == NULL) {
-                dm_printf("NO memory...");
-                return;
-            }
-            strcpy(string_val, temp_cjson_obj->valuestring);
-#else
-            string_val = dm_lite_calloc(1, temp_cjson_obj->valuestring_length + 1);
+            string_val = json_string_dup(temp_cjson_obj);
             assert(string_val);
             if (string_val == NULL) {
                 dm_printf("NO memory...");
                 return;
             }
-            strncpy(string_val, temp_cjson_obj->valuestring, temp_cjson_obj->valuestring_length);
-#endif
         } else if (lite_property->data_type.type == data_type_type_float) {
             float_val = temp_cjson_obj->valuedouble;
-            dm_snprintf(temp_buf, sizeof(temp_buf), "%.7f", float_val);
+            LITE_format_fixed(temp_buf, float_val, 7);
         } else if (lite_property->data_type.type == data_type_type_double) {
             double_val = temp_cjson_obj->valuedouble;
-            dm_snprintf(temp_buf, sizeof(temp_buf), "%.16lf", double_val);
+            LITE_format_fixed(temp_buf, double_val, 16);
         } else if (lite_property->data_type.type == data_type_type_date) {
-            if(temp_cjson_obj->type == cJSON_String) {
-                dm_snprintf(temp_buf, sizeof(temp_buf), "%s", temp_cjson_obj->valuestring);
-            }else if(temp_cjson_obj->type == cJSON_Number) {
-                dm_snprintf(temp_buf, sizeof(temp_buf), "%lf", temp_cjson_obj->valuedouble);
+            if(cJSON_IsString(temp_cjson_obj)) {
+                dm_snprintf(temp_buf, sizeof(temp_buf), "%.*s", json_string_length(temp_cjson_obj), temp_cjson_obj->valuestring);
+            }else if(cJSON_IsNumber(temp_cjson_obj)) {
+                LITE_format_llong(temp_buf, (long long)temp_cjson_obj->valuedouble);
             }
         } else if (lite_property->data_type.type == data_type_type_enum ||
                    lite_property->data_type.type == data_type_type_bool ||
                    lite_property->data_type.type == data_type_type_int) {
 
             int_val = temp_cjson_obj->valueint;
-            dm_snprintf(temp_buf, sizeof(temp_buf), "%d", int_val);
+            LITE_format_llong(temp_buf, int_val);
         } else if (lite_property->data_type.type == data_type_type_struct) {
             assert(cJSON_IsObject(temp_cjson_obj));
             if (!cJSON_IsObject(temp_cjson_obj)) return;
@@ -405,13 +601,16 @@ static void find_and_set_lite_property_for_service_property_set(void* _item, int
                 return;
             }
 
+            struct_property_set_ctx.dm_thing_manager = dm_thing_manager;
+            struct_property_set_ctx.message = property_set_ctx->message;
+            struct_property_set_ctx.property_set_param_obj = temp_cjson_obj;
+            struct_property_set_ctx.thing = thing;
+            struct_property_set_ctx.identifier_prefix = lite_property->identifier;
             for (index = 0; index < lite_property->data_type.data_type_specs_number; ++index) {
                 lite_property_struct = (lite_property_t*)lite_property->data_type.specs + index;
-                find_and_set_lite_property_struct_for_service_property_set(lite_property_struct, dm_thing_manager,
-                                                                           temp_cjson_obj, thing, lite_property->identifier);
+                set_lite_property_for_service_property_set(lite_property_struct, &struct_property_set_ctx);
             }
-            dm_thing_manager->_identifier = lite_property->identifier;
-            invoke_callback_list(dm_thing_manager, dm_callback_type_property_value_set);
+            invoke_property_value_set_callback(dm_thing_manager, property_set_ctx->message, thing, lite_property->identifier);
         } else if(lite_property->data_type.type == data_type_type_array) {
             if(!cJSON_IsArray(temp_cjson_obj)) {
                 dm_log_err("json type is not array");
@@ -423,61 +622,240 @@ static void find_and_set_lite_property_for_service_property_set(void* _item, int
                 return;
             }
             for(index = 0; index < arrsize; index++){
-                find_and_set_array_item(dm_thing_manager,thing, temp_cjson_obj, index, lite_property, lite_property->data_type.type);
+                find_and_set_array_item(dm_thing_manager, property_set_ctx->message, thing, temp_cjson_obj, index, lite_property,
+                                        lite_property->data_type.type, identifier_set);
             }
-            dm_thing_manager->_identifier = lite_property->identifier;
-            invoke_callback_list(dm_thing_manager, dm_callback_type_property_value_set);
+            invoke_property_value_set_callback(dm_thing_manager, property_set_ctx->message, thing, lite_property->identifier);
             return;
         }
 
         if (string_val) {
-            dm_thing_manager->_property_identifier_value_set = string_val;
+            value_set = string_val;
         } else if (strlen(temp_buf)) {
-            dm_thing_manager->_property_identifier_value_set = dm_lite_calloc(1, strlen(temp_buf) + 1);
-            assert(dm_thing_manager->_property_identifier_value_set);
-            strcpy(dm_thing_manager->_property_identifier_value_set, temp_buf);
+            value_set = dm_lite_calloc(1, strlen(temp_buf) + 1);
+            assert(value_set);
+            strcpy(value_set, temp_buf);
         }
     }
 
-    if (dm_thing_manager->_property_identifier_set && dm_thing_manager->_property_identifier_value_set) {
-        dm_thing_manager_set_thing_property_value(dm_thing_manager, thing, dm_thing_manager->_property_identifier_set,
-                                                  NULL, dm_thing_manager->_property_identifier_value_set);
+    if (identifier_set && value_set) {
+        property_set_ctx->message->ret = set_thing_property_value(dm_thing_manager, property_set_ctx->message, thing, identifier_set,
+                                                                  NULL, value_set);
 
-        dm_lite_free(dm_thing_manager->_property_identifier_value_set);
-        dm_thing_manager->_property_identifier_value_set = NULL;
+        dm_lite_free(value_set);
     }
 }
 
-static void find_and_set_lite_property_struct_for_service_property_set(void* _item, ...)
+static int find_and_set_lite_property_for_service_property_set(property_t* property, int index, void* ctx)
+{
+    (void)index;
+
+    set_lite_property_for_service_property_set((lite_property_t*)property, ctx);
+
+    return 0;
+}
+
+static dm_thing_manager_local_thing_t* find_local_thing(const dm_thing_manager_t* dm_thing_manager, const void* thing_id)
+{
+    dm_id_index_entry_t* entry;
+
+    entry = dm_id_index_find(&dm_thing_manager->_local_thing_index, (const char*)&thing_id, sizeof(thing_id));
+
+    return entry ? entry->item : NULL;
+}
+
+static dm_thing_manager_local_thing_t* find_local_thing_via_product_key_and_device_name(const dm_thing_manager_t* dm_thing_manager,
+                                                                                        const char* product_key, const char* device_name)
 {
-    va_list params;
+    dm_id_index_entry_t* entry;
+    char key[DM_LOCAL_THING_KEY_MAXLEN] = {0};
+    int key_len;
 
-    va_start(params, _item);
+    key_len = dm_snprintf(key, sizeof(key), "%s/%s", product_key, device_name);
+    if (key_len <= 0 || key_len >= sizeof(key)) return NULL;
 
-    find_and_set_lite_property_for_service_property_set(_item, 0, &params);
+    entry = dm_id_index_find(&dm_thing_manager->_local_thing_key_index, key, key_len);
 
-    va_end(params);
+    return entry ? entry->item : NULL;
 }
 
-static void find_thing_via_product_key_and_device_name(void* _thing, va_list* params)
+typedef struct {
+    dm_thing_manager_event_template_t* templates; /* NULL while the block is measured. */
+    unsigned short* key_ends;
+    char*           chars;
+    int             number;
+    size_t          key_end_number;
+    size_t          chars_len;
+    const char*     product_key;
+    const char*     device_name;
+} compile_event_template_ctx_t;
+
+/* the template of event, measured into ctx when there are no templates yet, written into them otherwise. */
+static int compile_event_template(event_t* event, int index, void* _ctx)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
-    iotx_cmp_send_peer_t* iotx_cmp_send_peer;
+    compile_event_template_ctx_t* ctx = _ctx;
+    dm_thing_manager_event_template_t* template = NULL;
+    unsigned short* key_ends = NULL;
+    lite_property_t* lite_property;
+    dm_json_writer_t writer;
+    size_t uri_len, keys_len = 0, len, i;
+    char* p;
+
+    (void)index;
+
+    if (event->identifier == NULL || event->method == NULL || strcmp(event->method, string_thing_event_property_post) == 0) return 0;
+
+    uri_len = strlen("/sys///") + strlen(ctx->product_key) + strlen(ctx->device_name) + strlen(event->method);
+    if (uri_len >= URI_MAX_LENGH) return 0;
+
+    for (i = 0; i < event->event_output_data_num; ++i) {
+        lite_property = event->event_output_data + i;
+        dm_json_writer_init(&writer, NULL, 0);
+        if (lite_property->identifier) dm_json_writer_key(&writer, lite_property->identifier, strlen(lite_property->identifier));
+        keys_len += dm_json_writer_length(&writer);
+    }
+    /* left to the slow path. */
+    if (keys_len > 0xFFFF) return 0;
+
+    if (ctx->templates) {
+        template = ctx->templates + ctx->number;
+        key_ends = ctx->key_ends + ctx->key_end_number;
+
+        template->event = event;
+        template->uri = ctx->chars + ctx->chars_len;
+        dm_snprintf(template->uri, uri_len + 1, "/sys/%s/%s/%s", ctx->product_key, ctx->device_name, event->method);
+        /* subtitute '.' by '/' */
+        for (p = template->uri + uri_len - strlen(event->method); *p; ++p) {
+            if (*p == '.') *p = '/';
+        }
+        template->keys = template->uri + uri_len + 1;
+        template->key_ends = key_ends;
+
+        for (i = 0, len = 0; i < event->event_output_data_num; ++i) {
+            lite_property = event->event_output_data + i;
+            dm_json_writer_init(&writer, template->keys + len, keys_len - len + 1);
+            if (lite_property->identifier) dm_json_writer_key(&writer, lite_property->identifier, strlen(lite_property->identifier));
+            len += dm_json_writer_length(&writer);
+            key_ends[i] = (unsigned short)len;
+        }
+    }
+
+    ctx->number++;
+    ctx->key_end_number += event->event_output_data_num;
+    ctx->chars_len += uri_len + 1 + keys_len + 1;
+
+    return 0;
+}
+
+/* event templates of the thing in one block, the thing goes without them when it can not be had. */
+static void compile_event_templates(dm_thing_manager_local_thing_t* local_thing, const char* product_key, const char* device_name)
+{
+    compile_event_template_ctx_t ctx = {0};
+    size_t templates_size, key_ends_size;
+    char* block;
+
+    ctx.product_key = product_key;
+    ctx.device_name = device_name;
+    event_visit(local_thing->thing, compile_event_template, &ctx);
+    if (ctx.number == 0) return;
+
+    templates_size = ctx.number * sizeof(dm_thing_manager_event_template_t);
+    key_ends_size = ctx.key_end_number * sizeof(unsigned short);
+    block = dm_lite_calloc(1, templates_size + key_ends_size + ctx.chars_len);
+    if (block == NULL) {
+        dm_log_err("calloc %d byte failed", (int)(templates_size + key_ends_size + ctx.chars_len));
+        return;
+    }
+
+    local_thing->event_template_number = ctx.number;
+    ctx.templates = (dm_thing_manager_event_template_t*)block;
+    ctx.key_ends = (unsigned short*)(block + templates_size);
+    ctx.chars = block + templates_size + key_ends_size;
+    ctx.number = 0;
+    ctx.key_end_number = 0;
+    ctx.chars_len = 0;
+    event_visit(local_thing->thing, compile_event_template, &ctx);
 
+    local_thing->event_templates = ctx.templates;
+}
+
+static int index_service_method(service_t* service, int index, void* ctx)
+{
+    (void)index;
+    if (service->method) dm_id_index_insert(ctx, service->method, strlen(service->method), service);
+
+    return 0;
+}
+
+/* services of the thing keyed by method, requests go without the index when it can not be had. */
+static void index_service_methods(dm_thing_manager_local_thing_t* local_thing)
+{
+    thing_t** thing = local_thing->thing;
+    int service_number = (*thing)->get_service_number(thing);
+
+    if (service_number <= 0 || dm_id_index_init(&local_thing->service_method_index, service_number) != 0) return;
+
+    service_visit(thing, index_service_method, &local_thing->service_method_index);
+}
+
+/* add thing to both local thing indexes, keyed by the productKey/deviceName its messages come with. */
+static int index_local_thing(dm_thing_manager_t* dm_thing_manager, thing_t** thing)
+{
+    dm_thing_manager_local_thing_t* local_thing;
     char product_key[PRODUCT_KEY_MAXLEN] = {0};
     char device_name[DEVICE_NAME_MAXLEN] = {0};
 
-    dm_thing_manager = va_arg(*params, void*);
-    iotx_cmp_send_peer = va_arg(*params, iotx_cmp_send_peer_t*);
+    local_thing = dm_lite_calloc(1, sizeof(dm_thing_manager_local_thing_t));
+    if (local_thing == NULL) {
+        dm_log_err("calloc %d byte failed", sizeof(dm_thing_manager_local_thing_t));
+        return -1;
+    }
 
-    assert(dm_thing_manager && thing && *thing);
+    dm_thing_manager_install_product_key_device_name(dm_thing_manager, thing, product_key, device_name);
 
-    dm_thing_manager_install_product_key_device_name(dm_thing_manager,thing,product_key,device_name);
+    local_thing->thing = thing;
+    dm_snprintf(local_thing->key, sizeof(local_thing->key), "%s/%s", product_key, device_name);
+
+    /* first thing of the same productKey/deviceName wins, same as the list walk it replaces. */
+    if (dm_id_index_insert(&dm_thing_manager->_local_thing_index, (const char*)&local_thing->thing,
+                           sizeof(local_thing->thing), local_thing) == NULL) {
+        dm_lite_free(local_thing);
+        return -1;
+    }
+    if (dm_id_index_insert(&dm_thing_manager->_local_thing_key_index, local_thing->key, strlen(local_thing->key), local_thing) == NULL) {
+        dm_id_index_remove(&dm_thing_manager->_local_thing_index, (const char*)&local_thing->thing, sizeof(local_thing->thing));
+        dm_lite_free(local_thing);
+        return -1;
+    }
 
-    if (strcmp(product_key, iotx_cmp_send_peer->product_key) == 0 && strcmp(device_name, iotx_cmp_send_peer->device_name) == 0) {
-        dm_thing_manager->_thing_id = thing;
+    compile_event_templates(local_thing, product_key, device_name);
+    index_service_methods(local_thing);
+
+    return 0;
+}
+
+static void free_local_thing_index(dm_thing_manager_t* dm_thing_manager)
+{
+    dm_thing_manager_local_thing_t* local_thing;
+    size_t index;
+
+    for (index = 0; index < dm_thing_manager->_local_thing_index.slot_number; ++index) {
+        local_thing = dm_thing_manager->_local_thing_index.slots[index].item;
+        if (local_thing == NULL) continue;
+
+        if (local_thing->event_templates) dm_lite_free(local_thing->event_templates);
+        dm_id_index_deinit(&local_thing->service_method_index);
+#ifdef DEVICEINFO_ENABLED
+        if (local_thing->deviceinfo) {
+            dm_deviceinfo_deinit(local_thing->deviceinfo);
+            dm_lite_free(local_thing->deviceinfo);
+        }
+#endif /* DEVICEINFO_ENABLED */
+        dm_lite_free(local_thing);
     }
+
+    dm_id_index_deinit(&dm_thing_manager->_local_thing_index);
+    dm_id_index_deinit(&dm_thing_manager->_local_thing_key_index);
 }
 
 static int set_service_array_input(dm_thing_manager_t* _dm_thing_manager, thing_t** thing, cJSON* cjson_arr_obj, int item_index,lite_property_t *lite_property, data_type_type_t type, char *_identifier)
@@ -487,7 +865,7 @@ static int set_service_array_input(dm_thing_manager_t* _dm_thing_manager, thing_
     float float_val;
     double double_val;
     char temp_buf[64] = {0};
-    char identifier[64] = {0};
+    char identifier[128 + 16] = {0}; /* _identifier, as long as identifier of the caller, and [item_index]. */
     cJSON *arr_json_item;
 
     if(!_dm_thing_manager || !thing || !cjson_arr_obj || item_index < 0 || !lite_property || !_identifier)   {
@@ -508,18 +886,18 @@ static int set_service_array_input(dm_thing_manager_t* _dm_thing_manager, thing_
     switch(lite_property->data_type.value.data_type_array_t.item_type) {
     case data_type_type_int: {
         int_val = arr_json_item->valueint;
-        dm_snprintf(temp_buf, sizeof(temp_buf), "%d", int_val);
+        LITE_format_llong(temp_buf, int_val);
     }break;
     case data_type_type_double: {
         double_val = arr_json_item->valuedouble;
-        dm_snprintf(temp_buf, sizeof(temp_buf), "%.16lf", double_val);
+        LITE_format_fixed(temp_buf, double_val, 16);
     }break;
     case data_type_type_float: {
         float_val = arr_json_item->valuedouble;
-        dm_snprintf(temp_buf, sizeof(temp_buf), "%.7f", float_val);
+        LITE_format_fixed(temp_buf, float_val, 7);
     }break;
     case data_type_type_text: {
-        dm_snprintf(temp_buf, sizeof(temp_buf), "%s", arr_json_item->valuestring);
+        dm_snprintf(temp_buf, sizeof(temp_buf), "%.*s", json_string_length(arr_json_item), arr_json_item->valuestring);
     }break;
     default:{
         dm_log_err("don't support %d type", lite_property->data_type.value.data_type_array_t.item_type);
@@ -536,7 +914,8 @@ do_exit:
     return ret;
 }
 
-static int parse_and_set_service_input(dm_thing_manager_t *_dm_thing_manager,thing_t **thing, service_t *service, char* parameter)
+static int parse_and_set_service_input(dm_thing_manager_t *_dm_thing_manager, dm_thing_manager_message_t* message, thing_t **thing,
+                                       service_t *service, char* parameter)
 {
     cJSON* obj = NULL;
     cJSON* item;
@@ -550,7 +929,7 @@ static int parse_and_set_service_input(dm_thing_manager_t *_dm_thing_manager,thi
 
     dm_thing_manager_t* dm_thing_manager = _dm_thing_manager;
 
-    obj = cJSON_Parse(parameter);
+    obj = message_json_parse(message, parameter);
     if (!obj) return - 1;
 
     for (i = 0; i < service->service_input_data_num; i++) {
@@ -566,23 +945,12 @@ static int parse_and_set_service_input(dm_thing_manager_t *_dm_thing_manager,thi
         switch (property->data_type.type) {
         case data_type_type_text:
         {
-#ifndef CJSON_STRING_ZEROCOPY
-            string_val = dm_lite_calloc(1, strlen(item->valuestring) + 1);
-
-            if (string_val == NULL) {
-                if (obj) cJSON_Delete(obj);
-                return -1;
-            }
-            strcpy(string_val, item->valuestring);
-#else
-            string_val = dm_lite_calloc(1, item->valuestring_length + 1);
+            string_val = json_string_dup(item);
 
             if (string_val == NULL) {
-                cJSON_Delete(obj);
+                message_json_delete(message, obj);
                 return -1;
             }
-            strncpy(string_val, item->valuestring, item->valuestring_length);
-#endif /* CJSON_STRING_ZEROCOPY */
             (*thing)->set_service_input_output_data_value_by_identifier(thing, identifier, NULL, string_val);
 
             dm_lite_free(string_val);
@@ -609,189 +977,738 @@ static int parse_and_set_service_input(dm_thing_manager_t *_dm_thing_manager,thi
         }
     }
 
-    if (obj) cJSON_Delete(obj);
+    message_json_delete(message, obj);
 
     return 0;
 }
 
-static void find_and_set_service_input(void* _item, int index, va_list* params)
+typedef struct {
+    dm_thing_manager_t*         dm_thing_manager;
+    dm_thing_manager_message_t* message;
+    const dm_thing_manager_route_t* route; /* route of message uri, NULL if none. */
+} service_input_ctx_t;
+
+/* service the request is for, its input set from params. */
+static void set_service_input(service_input_ctx_t* service_input_ctx, service_t* service)
 {
-    service_t* service;
     thing_t **thing;
     dm_thing_manager_t* dm_thing_manager;
     iotx_cmp_message_info_t* iotx_cmp_message_info;
     char* parameter = NULL;
 
-    dm_thing_manager = va_arg(*params, void*);
-    iotx_cmp_message_info = va_arg(*params, iotx_cmp_message_info_t*);
-    thing = va_arg(*params, thing_t**);
-
-    service = _item;
+    dm_thing_manager = service_input_ctx->dm_thing_manager;
+    iotx_cmp_message_info = service_input_ctx->message->iotx_cmp_message_info;
+    thing = service_input_ctx->message->thing;
 
     assert(dm_thing_manager && iotx_cmp_message_info && service);
 
-    if (strcmp(service->method, iotx_cmp_message_info->method) == 0) {
-        dm_thing_manager->_service_identifier_requested = service->identifier;
+    service_input_ctx->message->service_identifier_requested = service->identifier;
 
-        if (strstr(iotx_cmp_message_info->URI, string_method_name_property_set) != NULL || strstr(iotx_cmp_message_info->URI, string_method_name_property_get) != NULL) return;
+    /* property set/get carry properties, not service input. */
+    if (service_input_ctx->route && (service_input_ctx->route->route_fp == route_property_set ||
+                                     service_input_ctx->route->route_fp == route_property_get)) return;
 
-        parameter = iotx_cmp_message_info->parameter;
-        if (parameter) parse_and_set_service_input(dm_thing_manager, thing, service, parameter);
-    }
+    parameter = iotx_cmp_message_info->parameter;
+    if (parameter == NULL) return;
+
+#ifdef USING_UTILS_JSON
+    if (set_service_input_by_token(thing, service, parameter, iotx_cmp_message_info->parameter_length) == 0) return;
+#endif /* USING_UTILS_JSON */
+    parse_and_set_service_input(dm_thing_manager, service_input_ctx->message, thing, service, parameter);
 }
 
-static void cmp_register_handler(iotx_cmp_send_peer_t* _source, iotx_cmp_message_info_t* _msg, void* user_data)
+static int find_and_set_service_input(service_t* service, int index, void* ctx)
 {
-    dm_thing_manager_t* dm_thing_manager = user_data;
-    iotx_cmp_send_peer_t* iotx_cmp_send_peer = _source;
-    iotx_cmp_message_info_t* iotx_cmp_message_info = _msg;
-    thing_t** thing;
-    list_t** list;
-    cJSON* property_set_param_obj;
-    cJSON* property_get_param_obj;
-    cJSON* property_get_param_item_obj;
-    int array_size, index;
-    char* property_get_param_identifier;
-
-    assert(dm_thing_manager && iotx_cmp_send_peer && iotx_cmp_message_info);
-
-    print_iotx_cmp_message_info(iotx_cmp_send_peer, iotx_cmp_message_info);
+    service_input_ctx_t* service_input_ctx = ctx;
 
-    list = dm_thing_manager->_local_thing_list;
+    (void)index;
+    if (strcmp(service->method, service_input_ctx->message->iotx_cmp_message_info->method) == 0) {
+        set_service_input(service_input_ctx, service);
 
-    /* find thing id. */
-    dm_thing_manager->_thing_id = NULL;
-    list_iterator(list, find_thing_via_product_key_and_device_name, dm_thing_manager, iotx_cmp_send_peer);
+        return 1;
+    }
 
-    if (dm_thing_manager->_thing_id == NULL && strstr(iotx_cmp_message_info->URI, string_method_name_thing_dsl_get_reply) == NULL) {
-        dm_log_err("thing id NOT match");
+    return 0;
+}
 
+/* thing/dsltemplate/get_reply */
+static void route_thing_dsl_get_reply(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message)
+{
+    iotx_cmp_message_info_t* iotx_cmp_message_info = message->iotx_cmp_message_info;
+    thing_t** new_thing = NULL;
+
+#if defined(TSL_CACHE_ENABLED) && defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+    if (dm_thing_manager->_cloud_template) {
+        /* the thing is there already, a tsl changed since is kept for the next boot. */
+        save_tsl_cache(dm_thing_manager, iotx_cmp_message_info->parameter, iotx_cmp_message_info->parameter_length, NULL);
+        LITE_STARTUP_END(LITE_STARTUP_TSL_GET, 1);
         return;
     }
+#endif
 
-    thing = dm_thing_manager->_thing_id;
-
-    if (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_REQUEST) {
-        dm_thing_manager->_request_id = iotx_cmp_message_info->id;
+    new_thing = dm_thing_manager_generate_new_local_thing(dm_thing_manager, iotx_cmp_message_info->parameter,
+                                                          iotx_cmp_message_info->parameter_length);
+    if(NULL == new_thing) {
+        dm_log_err("generate new thing failed");
+    }
+#if defined(TSL_CACHE_ENABLED) && defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+    else {
+        save_tsl_cache(dm_thing_manager, iotx_cmp_message_info->parameter, iotx_cmp_message_info->parameter_length, new_thing);
+    }
+#endif
+    LITE_STARTUP_END(LITE_STARTUP_TSL_GET, NULL != new_thing);
+}
 
-        /* find service id trigged. */
-        dm_thing_manager->_service_identifier_requested = NULL;
-        service_iterator(thing, find_and_set_service_input, dm_thing_manager, iotx_cmp_message_info, thing);
-        assert(dm_thing_manager->_service_identifier_requested);
-        if (dm_thing_manager->_service_identifier_requested == NULL) {
-            dm_log_err("method NOT match of service requested");
-            return;
-        }
-    } else if (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_RAW) {
-        dm_thing_manager->_request_id = iotx_cmp_message_info->id;
-        dm_thing_manager->_raw_data = iotx_cmp_message_info->parameter;
-        dm_thing_manager->_raw_data_length = iotx_cmp_message_info->parameter_length;
+#ifdef USING_UTILS_JSON
+/*
+ * property/set params are tokenized in place instead of parsed into a cJSON tree: every key is
+ * resolved through the thing identifier index and its token converted straight into the typed value.
+ * string tokens are NUL terminated in place while being set and restored right after.
+ */
+static int token_key_equal(const char* key, int key_len, const char* str)
+{
+    return key && (int)strlen(str) == key_len && strncmp(key, str, key_len) == 0;
+}
 
-        /* invoke callback funtions. */
-        invoke_callback_list(dm_thing_manager, dm_callback_type_raw_data_arrived);
+static int set_property_value_by_token(thing_t** thing, const thing_property_handle_t* handle, char* val, int val_len, int val_type)
+{
+    const lite_property_t* lite_property = handle->lite_property;
+    data_type_type_t type = lite_property->data_type.type;
+    int int_val;
+    float float_val;
+    double double_val;
+    unsigned long long date_val;
+    char last_char;
+    int ret;
 
-        dm_thing_manager->_raw_data = NULL;
-        dm_thing_manager->_raw_data_length = 0;
+    if (type == data_type_type_array) type = lite_property->data_type.value.data_type_array_t.item_type;
 
-        return;
+    switch (type) {
+    case data_type_type_int:
+    case data_type_type_enum:
+    case data_type_type_bool:
+        if (val_type == JBOOLEAN) {
+            int_val = (*val == 't' || *val == 'T') ? 1 : 0;
+        } else if (val_type == JNUMBER) {
+            int_val = (int)LITE_parse_double(val, NULL);
+        } else {
+            return -1;
+        }
+        return (*thing)->set_property_value_by_handle(thing, handle, &int_val, NULL);
+    case data_type_type_float:
+        if (val_type != JNUMBER) return -1;
+        float_val = (float)LITE_parse_double(val, NULL);
+        return (*thing)->set_property_value_by_handle(thing, handle, &float_val, NULL);
+    case data_type_type_double:
+        if (val_type != JNUMBER) return -1;
+        double_val = LITE_parse_double(val, NULL);
+        return (*thing)->set_property_value_by_handle(thing, handle, &double_val, NULL);
+    case data_type_type_date:
+        if (val_type != JNUMBER && val_type != JSTRING) return -1;
+        date_val = strtoull(val, NULL, 10);
+        return (*thing)->set_property_value_by_handle(thing, handle, &date_val, NULL);
+    case data_type_type_text:
+        if (val_type != JSTRING) return -1;
+        backup_json_str_last_char(val, val_len, last_char);
+        ret = (*thing)->set_property_value_by_handle(thing, handle, val, NULL);
+        restore_json_str_last_char(val, val_len, last_char);
+        return ret;
+    default:
+        break;
     }
 
-    if (iotx_cmp_message_info->URI) {
-        if (strstr(iotx_cmp_message_info->URI, string_method_name_thing_dsl_get_reply)) { /* thing/dsltemplate/get_reply match */
-            thing = dm_thing_manager_generate_new_local_thing(dm_thing_manager, iotx_cmp_message_info->parameter,
-                                                              iotx_cmp_message_info->parameter_length);
-            if(NULL == thing) {
-                dm_log_err("generate new thing failed");
-                return;
+    return -1;
+}
+
+/* every struct member must be set at once, same as check_set_lite_property_for_struct. */
+static int check_struct_token(const lite_property_t* lite_property, char* src, int src_len)
+{
+    const lite_property_t* sub_property;
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+    int index;
+    int found;
+
+    for (index = 0; index < lite_property->data_type.data_type_specs_number; index++) {
+        sub_property = (const lite_property_t*)lite_property->data_type.specs + index;
+        found = 0;
+        json_object_for_each_kv(src, src_len, pos, key, key_len, val, val_len, val_type) {
+            if (token_key_equal(key, key_len, sub_property->identifier)) {
+                found = 1;
+                break;
             }
-        } else if (strstr(iotx_cmp_message_info->URI, string_method_name_property_set)) { /* thing/service/property/set match */
-            assert(thing && iotx_cmp_message_info->parameter);
-            property_set_param_obj = cJSON_Parse(iotx_cmp_message_info->parameter);
-            assert(property_set_param_obj && cJSON_IsObject(property_set_param_obj));
+        }
+        if (!found) return -1;
+    }
 
-            property_iterator(thing, find_and_set_lite_property_for_service_property_set, dm_thing_manager, property_set_param_obj, thing, NULL);
+    return 0;
+}
 
-            dm_log_info("%s triggerd", string_method_name_property_set);
+static void set_property_by_token(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message, thing_t** thing,
+                                  char* key, int key_len, char* val, int val_len, int val_type)
+{
+    thing_property_handle_t handle;
+    thing_property_handle_t item_handle;
+    const lite_property_t* lite_property;
+    char identifier[128] = {0};
+    char item_identifier[128 + 16] = {0};
+    char *pos, *item_key, *item_val;
+    int item_key_len, item_val_len, item_val_type;
+    int index;
 
-#ifdef RRPC_ENABLED
-            dm_thing_manager_answer_service(dm_thing_manager, thing, dm_thing_manager->_service_identifier_requested,
-                                            dm_thing_manager->_request_id, dm_thing_manager->_ret == 0 ? 200 : 400, 0);
-#else
-            dm_thing_manager_answer_service(dm_thing_manager, thing, dm_thing_manager->_service_identifier_requested,
-                                            dm_thing_manager->_request_id, dm_thing_manager->_ret == 0 ? 200 : 400);
-#endif /* RRPC_ENABLED */
+    if (key_len <= 0 || key_len >= sizeof(identifier)) return;
 
-            cJSON_Delete(property_set_param_obj);
+    memcpy(identifier, key, key_len);
 
-        } else if (strstr(iotx_cmp_message_info->URI, string_method_name_property_get)) { /* thing/service/property/get match */
-            assert(iotx_cmp_message_info->parameter);
-            list = dm_thing_manager->_service_property_get_identifier_list;
-            property_get_param_obj = cJSON_Parse(iotx_cmp_message_info->parameter);
+    /* keys not in tsl are skipped. */
+    if ((*thing)->resolve_property_handle(thing, identifier, &handle) != 0) return;
 
-            assert(property_get_param_obj && cJSON_IsArray(property_get_param_obj));
+    lite_property = handle.lite_property;
 
-            if (property_get_param_obj == NULL || cJSON_IsArray(property_get_param_obj) == 0) {
-                dm_log_err("UNABLE to resolve %s params format", string_method_name_property_get);
-                return;
+    if (lite_property->data_type.type == data_type_type_struct) {
+        if (val_type != JOBJECT || check_struct_token(lite_property, val, val_len)) {
+            dm_printf("invalid json");
+            return;
+        }
+        json_object_for_each_kv(val, val_len, pos, item_key, item_key_len, item_val, item_val_len, item_val_type) {
+            dm_snprintf(item_identifier, sizeof(item_identifier), "%s%c%.*s", identifier, DEFAULT_DSL_DELIMITER, item_key_len, item_key);
+            if ((*thing)->resolve_property_handle(thing, item_identifier, &item_handle) != 0) continue;
+            message->ret = set_property_value_by_token(thing, &item_handle, item_val, item_val_len, item_val_type);
+        }
+    } else if (lite_property->data_type.type == data_type_type_array) {
+        if (val_type != JARRAY) {
+            dm_log_err("json type is not array");
+            return;
+        }
+        index = 0;
+        json_array_for_each_entry(val, val_len, pos, item_val, item_val_len, item_val_type) {
+            if (index >= lite_property->data_type.value.data_type_array_t.size) {
+                dm_printf("input json array item > lite json array item:%d ", lite_property->data_type.value.data_type_array_t.size);
+                break;
             }
+            dm_snprintf(item_identifier, sizeof(item_identifier), "%s[%d]", identifier, index++);
+            if ((*thing)->resolve_property_handle(thing, item_identifier, &item_handle) != 0) break;
+            message->ret = set_property_value_by_token(thing, &item_handle, item_val, item_val_len, item_val_type);
+        }
+    } else {
+        message->ret = set_property_value_by_token(thing, &handle, val, val_len, val_type);
+    }
 
-            array_size = cJSON_GetArraySize(property_get_param_obj);
-            for (index = 0; index < array_size; ++index) {
-                property_get_param_item_obj = cJSON_GetArrayItem(property_get_param_obj, index);
-                assert(cJSON_IsString(property_get_param_item_obj));
-#ifndef CJSON_STRING_ZEROCOPY
-                property_get_param_identifier = dm_lite_calloc(1, strlen(property_get_param_item_obj->valuestring) + 1);
-                strcpy(property_get_param_identifier, property_get_param_item_obj->valuestring);
-#else
-                property_get_param_identifier = dm_lite_calloc(1, property_get_param_item_obj->valuestring_length + 1);
-                strncpy(property_get_param_identifier, property_get_param_item_obj->valuestring,
-                        property_get_param_item_obj->valuestring_length);
-#endif
-                list_insert(list, property_get_param_identifier);
-            }
-            cJSON_Delete(property_get_param_obj);
-#ifdef RRPC_ENABLED
-            dm_thing_manager_answer_service(dm_thing_manager, thing, dm_thing_manager->_service_identifier_requested,
-                                            dm_thing_manager->_request_id, 200, 0);
-#else
-            dm_thing_manager_answer_service(dm_thing_manager, thing, dm_thing_manager->_service_identifier_requested,
-                                            dm_thing_manager->_request_id, 200);
-#endif /* RRPC_ENABLED */
+    invoke_property_value_set_callback(dm_thing_manager, message, thing, identifier);
+}
+
+/* -1 if parameter is no json object or needs unescaping, which only the cJSON path does. */
+static int set_properties_by_token(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message, thing_t** thing,
+                                   char* parameter, int parameter_length)
+{
+    char *pos, *key, *val;
+    int key_len, val_len, val_type;
+
+    if (memchr(parameter, '\\', parameter_length)) return -1;
+
+    if (json_get_object(JOBJECT, parameter, parameter + parameter_length) == NULL) return -1;
+
+    json_object_for_each_kv(parameter, parameter_length, pos, key, key_len, val, val_len, val_type) {
+        set_property_by_token(dm_thing_manager, message, thing, key, key_len, val, val_len, val_type);
+    }
+
+    return 0;
+}
+
+/*
+ * inputData of the service bound by key to its lite property, no identifier built or looked up per value.
+ * same as set_properties_by_token, -1 leaves params to the cJSON path. keys not in inputData are skipped.
+ */
+static int set_service_input_by_token(thing_t** thing, service_t* service, char* parameter, int parameter_length)
+{
+    thing_property_handle_t handle;
+    lite_property_t* lite_property;
+    char *pos, *key, *val, *item_pos, *item_val;
+    int key_len, val_len, val_type, item_val_len, item_val_type;
+    int i;
+
+    if (memchr(parameter, '\\', parameter_length)) return -1;
+
+    if (json_get_object(JOBJECT, parameter, parameter + parameter_length) == NULL) return -1;
+
+    handle.property = NULL;
+    json_object_for_each_kv(parameter, parameter_length, pos, key, key_len, val, val_len, val_type) {
+        for (i = 0; i < service->service_input_data_num; i++) {
+            if (token_key_equal(key, key_len, service->service_input_data[i].lite_property.identifier)) break;
+        }
+        if (i == service->service_input_data_num) continue;
+
+        lite_property = &service->service_input_data[i].lite_property;
+        handle.lite_property = lite_property;
+        handle.arr_index = -1;
+
+        if (lite_property->data_type.type == data_type_type_array) {
+            if (val_type != JARRAY) continue;
+            json_array_for_each_entry(val, val_len, item_pos, item_val, item_val_len, item_val_type) {
+                if (++handle.arr_index >= lite_property->data_type.value.data_type_array_t.size) {
+                    dm_printf("input json array item > lite json array size:%d ", lite_property->data_type.value.data_type_array_t.size);
+                    break;
+                }
+                set_property_value_by_token(thing, &handle, item_val, item_val_len, item_val_type);
+            }
+        } else {
+            set_property_value_by_token(thing, &handle, val, val_len, val_type);
+        }
+    }
+
+    return 0;
+}
+#endif /* USING_UTILS_JSON */
+
+/* thing/service/property/set */
+#ifdef DM_STATIC_THING_ENABLED
+/* members of a property set stored into the struct of a static thing by its model, each property stored is changed. */
+static void set_static_properties(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message, thing_t** thing,
+                                  const cJSON* params)
+{
+    dm_static_thing_t* bound = dm_thing_get_static(thing);
+    const dm_static_thing_model_t* model = bound->model;
+    const property_t* properties = ((dm_thing_t*)thing)->dsl_template.properties;
+    int id;
+
+    memset(bound->set_ids, 0, DM_STATIC_THING_IDS_SIZE(model->property_number));
+    if (!cJSON_IsObject(params) || model->parse_properties(bound->data, params, bound->set_ids) != 0) message->ret = -1;
+
+    for (id = 0; id < model->property_number; ++id) {
+        if (!DM_STATIC_THING_ID_ISSET(bound->set_ids, id)) continue;
+
+        (*thing)->request_property_post(thing, properties + id);
+        invoke_property_value_set_callback(dm_thing_manager, message, thing, model->identifiers[id]);
+    }
+}
+#endif /* DM_STATIC_THING_ENABLED */
+
+static void route_property_set(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message)
+{
+    thing_t** thing = message->thing;
+    iotx_cmp_message_info_t* iotx_cmp_message_info = message->iotx_cmp_message_info;
+    property_set_ctx_t property_set_ctx;
+    cJSON* property_set_param_obj;
+
+    assert(thing && iotx_cmp_message_info->parameter);
+
+    LITE_TRACE(LITE_TRACE_TSL_SET, message->request_id);
+
+#ifdef DM_STATIC_THING_ENABLED
+    if (dm_thing_get_static(thing)) {
+        property_set_param_obj = message_json_parse(message, iotx_cmp_message_info->parameter);
+        set_static_properties(dm_thing_manager, message, thing, property_set_param_obj);
+    } else
+#endif /* DM_STATIC_THING_ENABLED */
+#ifdef USING_UTILS_JSON
+    if (set_properties_by_token(dm_thing_manager, message, thing, iotx_cmp_message_info->parameter,
+                                iotx_cmp_message_info->parameter_length) == 0) {
+        property_set_param_obj = NULL;
+    } else
+#endif /* USING_UTILS_JSON */
+    {
+        property_set_param_obj = message_json_parse(message, iotx_cmp_message_info->parameter);
+        assert(property_set_param_obj && cJSON_IsObject(property_set_param_obj));
+
+        property_set_ctx.dm_thing_manager = dm_thing_manager;
+        property_set_ctx.message = message;
+        property_set_ctx.property_set_param_obj = property_set_param_obj;
+        property_set_ctx.thing = thing;
+        property_set_ctx.identifier_prefix = NULL;
+        property_visit(thing, find_and_set_lite_property_for_service_property_set, &property_set_ctx);
+    }
+
+    dm_log_info("%s triggerd", string_method_name_property_set);
+
+#ifdef RRPC_ENABLED
+    dm_thing_manager_answer_service(dm_thing_manager, thing, message->service_identifier_requested,
+                                    message->request_id, message->ret == 0 ? 200 : 400, 0);
+#else
+    dm_thing_manager_answer_service(dm_thing_manager, thing, message->service_identifier_requested,
+                                    message->request_id, message->ret == 0 ? 200 : 400);
+#endif /* RRPC_ENABLED */
+
+    message_json_delete(message, property_set_param_obj);
+}
+
+/* thing/service/property/get */
+static void route_property_get(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message)
+{
+    thing_t** thing = message->thing;
+    iotx_cmp_message_info_t* iotx_cmp_message_info = message->iotx_cmp_message_info;
+    const char* params = iotx_cmp_message_info->parameter;
+    int params_length = iotx_cmp_message_info->parameter_length;
+    int i;
+
+    assert(params);
+
+    for (i = 0; i < params_length && (params[i] == ' ' || params[i] == '\t' || params[i] == '\r' || params[i] == '\n'); ++i);
+
+    if (i == params_length || params[i] != '[') {
+        dm_log_err("UNABLE to resolve %s params format", string_method_name_property_get);
+        return;
+    }
+
+    /* identifiers are read from the request while the reply is written, hold sending till it is out. */
+    send_lock(dm_thing_manager);
+
+    dm_thing_manager->_property_get_params = params + i;
+    dm_thing_manager->_property_get_params_length = params_length - i;
+#ifdef RRPC_ENABLED
+    answer_service(dm_thing_manager, thing, message->service_identifier_requested, message->request_id, 200, 0);
+#else
+    answer_service(dm_thing_manager, thing, message->service_identifier_requested, message->request_id, 200);
+#endif /* RRPC_ENABLED */
+    dm_thing_manager->_property_get_params = NULL;
+    dm_thing_manager->_property_get_params_length = 0;
+
+    send_unlock(dm_thing_manager);
+}
+
+/* thing/enable */
+static void route_thing_enable(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message)
+{
+    /* invoke callback funtions. */
+    invoke_callback_list(dm_thing_manager, message, dm_callback_type_thing_enabled);
+}
+
+/* thing/disable */
+static void route_thing_disable(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message)
+{
+    /* invoke callback funtions. */
+    invoke_callback_list(dm_thing_manager, message, dm_callback_type_thing_disabled);
+}
+
+/* thing/event/property/post_reply */
+static void route_property_post_reply(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message)
+{
+    thing_t** thing = message->thing;
+    iotx_cmp_message_info_t* iotx_cmp_message_info = message->iotx_cmp_message_info;
+
+    (void)dm_thing_manager;
+
+    if (iotx_cmp_message_info->message_type != IOTX_CMP_MESSAGE_RESPONSE) return;
+
+    (*thing)->finish_property_post(thing, iotx_cmp_message_info->id, iotx_cmp_message_info->code == 200);
+    LITE_STARTUP_END(LITE_STARTUP_FIRST_POST, iotx_cmp_message_info->code == 200);
+}
+
+#ifdef RRPC_ENABLED
+/* keep messageId of a rrpc request till it is answered, returns the token to answer it with. caller holds send lock. */
+static int add_rrpc_pending(dm_thing_manager_t* self, const char* message_id, int request_id)
+{
+    dm_rrpc_pending_t* pending = NULL;
+    uint64_t now = HAL_UptimeMs();
+    int i;
+
+    for (i = 0; i < CONFIG_DM_RRPC_PENDING; ++i) {
+        dm_rrpc_pending_t* item = &self->_rrpc_pending[i];
+
+        if (item->token == 0 || item->expire_ms <= now) {
+            pending = item;
+            break;
+        }
+        if (pending == NULL || item->expire_ms < pending->expire_ms) pending = item;
+    }
+    if (pending->token && pending->expire_ms > now) {
+        dm_log_err("rrpc(%s) pushed out unanswered", pending->message_id);
+    }
+
+    /* 1 is left to callers passing rrpc as a flag, those are answered by request_id. */
+    if (++self->_rrpc_token <= 1) self->_rrpc_token = 2;
+
+    pending->token = self->_rrpc_token;
+    pending->request_id = request_id;
+    pending->expire_ms = now + CONFIG_DM_RRPC_TIMEOUT_MS;
+    strncpy(pending->message_id, message_id, sizeof(pending->message_id) - 1);
+    pending->message_id[sizeof(pending->message_id) - 1] = '\0';
+
+    return pending->token;
+}
+
+/* messageId of the rrpc request of token, or of request_id for a token not known, valid till the next add. caller holds send lock. */
+static const char* take_rrpc_pending(dm_thing_manager_t* self, int token, int request_id)
+{
+    dm_rrpc_pending_t* pending = NULL;
+    uint64_t now = HAL_UptimeMs();
+    int i;
+
+    for (i = 0; i < CONFIG_DM_RRPC_PENDING; ++i) {
+        dm_rrpc_pending_t* item = &self->_rrpc_pending[i];
+
+        if (item->token == 0 || item->expire_ms <= now) continue;
+        if (item->token == token) {
+            pending = item;
+            break;
+        }
+        if (item->request_id == request_id && pending == NULL) pending = item;
+    }
+    if (pending == NULL) return NULL;
+
+    pending->token = 0;
+
+    return pending->message_id;
+}
+
+/* rrpc/request/${messageId} */
+static void route_rrpc_request(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message)
+{
+    iotx_cmp_message_info_t* iotx_cmp_message_info = message->iotx_cmp_message_info;
+    char* p;
+
+//            "/sys/productKey/{productKey}/productKey/{deviceName}/rrpc/request/${messageId}"
+    p = strrchr(iotx_cmp_message_info->URI, '/');
+    if (p == NULL || *(++p) == '\0') {
+        dm_log_err("rrpc request without messageId");
+        return;
+    }
+
+    /* requests are answered by token, in any order and from any thread. */
+    send_lock(dm_thing_manager);
+    message->raw_data = NULL;
+    message->raw_data_length = add_rrpc_pending(dm_thing_manager, p, message->request_id);
+    send_unlock(dm_thing_manager);
+
+    /* invoke callback funtions. */
+    message->identifier = message->service_identifier_requested;
+    invoke_callback_list(dm_thing_manager, message, dm_callback_type_rrpc_requested);
+}
+#endif /* RRPC_ENABLED */
 
-        } else if (strstr(iotx_cmp_message_info->URI, string_method_name_thing_enable)) { /* thing/enable match */
-            /* invoke callback funtions. */
-            invoke_callback_list(dm_thing_manager, dm_callback_type_thing_enabled);
-        } else if (strstr(iotx_cmp_message_info->URI, string_method_name_thing_disable)) { /* thing/disable match */
-            /* invoke callback funtions. */
-            invoke_callback_list(dm_thing_manager, dm_callback_type_thing_disabled);
-#ifdef RRPC_ENABLED
-        } else if (strstr(iotx_cmp_message_info->URI, string_method_name_rrpc_request)) { /* rrpc/request match */
-            char* p;
-//            "/sys/productKey/{productKey}/productKey/{deviceName}/rrpc/request/${messageId}"
-            p = strrchr(iotx_cmp_message_info->URI, '/');
-            if (p) {
-                p++;
-                dm_thing_manager->_rrpc_message_id = atoi(p);
-            }
-            /* invoke callback funtions. */
-            dm_thing_manager->_identifier = dm_thing_manager->_service_identifier_requested;
-            invoke_callback_list(dm_thing_manager, dm_callback_type_rrpc_requested);
-#endif /* RRPC_ENABLED */
 #ifdef DEVICEINFO_ENABLED
-        } else if (strstr(iotx_cmp_message_info->URI, string_method_name_deviceinfo_update_reply)) { /* deviceinfo/update_reply. */
+/* thing/deviceinfo/update_reply and thing/deviceinfo/delete_reply, taken by the request waiting for them. */
+static void route_deviceinfo_reply(dm_thing_manager_t* dm_thing_manager, dm_thing_manager_message_t* message)
+{
+    (void)dm_thing_manager;
+    (void)message;
+}
+#endif /* DEVICEINFO_ENABLED*/
 
-        } else if (strstr(iotx_cmp_message_info->URI, string_method_name_deviceinfo_delete_reply)) { /* deviceinfo/delete_reply. */
+/* built in routes, keyed by method part of uri. */
+static const dm_thing_manager_route_t dm_thing_manager_routes[] = {
+    {string_method_name_thing_dsl_get_reply, route_thing_dsl_get_reply, NULL, NULL},
+    {string_method_name_property_set, route_property_set, NULL, NULL},
+    {string_method_name_property_get, route_property_get, NULL, NULL},
+    {string_method_name_thing_enable, route_thing_enable, NULL, NULL},
+    {string_method_name_thing_disable, route_thing_disable, NULL, NULL},
+    {string_method_name_property_post_reply, route_property_post_reply, NULL, NULL},
+#ifdef RRPC_ENABLED
+    {string_method_name_rrpc_request, route_rrpc_request, NULL, NULL},
+#endif /* RRPC_ENABLED */
+#ifdef DEVICEINFO_ENABLED
+    {string_method_name_deviceinfo_update_reply, route_deviceinfo_reply, NULL, NULL},
+    {string_method_name_deviceinfo_delete_reply, route_deviceinfo_reply, NULL, NULL},
 #endif /* DEVICEINFO_ENABLED*/
+};
+
+/* method part of uri "/sys/productKey/deviceName/method", cmp strips that prefix of the topics of
+ * this device and hands over "method" alone, NULL if uri is in neither format. */
+static const char* get_uri_method(const char* uri)
+{
+    const char* p;
+    int i;
+
+    if (uri == NULL || *uri == '\0') return NULL;
+
+    if (strncmp(uri, string_uri_prefix_sys, sizeof(string_uri_prefix_sys) - 1) != 0) return uri[0] == '/' ? NULL : uri;
+
+    p = uri + sizeof(string_uri_prefix_sys) - 1;
+    /* skip productKey and deviceName. */
+    for (i = 0; i < 2; ++i) {
+        p = strchr(p, '/');
+        if (p == NULL) return NULL;
+        ++p;
+    }
+
+    return p;
+}
+
+static const dm_thing_manager_route_t* find_route(const dm_thing_manager_t* dm_thing_manager, const char* uri)
+{
+    dm_id_index_entry_t* entry;
+    const char* method;
+    const char* p;
+
+    method = get_uri_method(uri);
+    if (method == NULL) return NULL;
+
+    entry = dm_id_index_find(&dm_thing_manager->_route_index, method, strlen(method));
+
+    /* route ends with an id, like rrpc/request/${messageId}. */
+    if (entry == NULL && (p = strrchr(method, '/')) != NULL) {
+        entry = dm_id_index_find(&dm_thing_manager->_route_index, method, p - method);
+    }
+
+    return entry ? entry->item : NULL;
+}
+
+static void install_routes(dm_thing_manager_t* dm_thing_manager)
+{
+    const dm_thing_manager_route_t* route;
+    size_t index;
+    size_t route_number = sizeof(dm_thing_manager_routes) / sizeof(dm_thing_manager_route_t);
+
+    if (dm_id_index_init(&dm_thing_manager->_route_index, route_number) != 0) {
+        dm_log_err("route index init failed");
+        return;
+    }
+
+    for (index = 0; index < route_number; ++index) {
+        route = dm_thing_manager_routes + index;
+        dm_id_index_insert(&dm_thing_manager->_route_index, route->method, strlen(route->method), (void*)route);
+    }
+}
+
+static void free_routes(dm_thing_manager_t* dm_thing_manager)
+{
+    dm_thing_manager_route_t* route;
+    size_t index;
+
+    for (index = 0; index < dm_thing_manager->_route_index.slot_number; ++index) {
+        route = dm_thing_manager->_route_index.slots[index].item;
+        /* custom route owns itself and its method. */
+        if (route && route->route_fp == NULL) dm_lite_free(route);
+    }
+
+    dm_id_index_deinit(&dm_thing_manager->_route_index);
+}
+
+/* subscribe uri, the subscribes of the startup last till every one issued has its result. */
+static void regist_uri(dm_thing_manager_t* dm_thing_manager, char* uri)
+{
+    cmp_abstract_t** cmp = dm_thing_manager->_cmp;
+
+    LITE_STARTUP_BEGIN(LITE_STARTUP_SUBSCRIBE);
+    HAL_AtomicAdd(&dm_thing_manager->_regist_pending, 1);
+
+    if ((*cmp)->regist(cmp, uri, dm_thing_manager->_cmp_register_func_fp, dm_thing_manager, NULL) == -1) {
+        HAL_AtomicAdd(&dm_thing_manager->_regist_pending, -1);
+    }
+}
+
+static void subscribe_route(dm_thing_manager_t* dm_thing_manager, const char* method)
+{
+    char uri_buff[URI_MAX_LENGH] = {0};
+
+    dm_snprintf(uri_buff, sizeof(uri_buff), "%s%s", utils_identity_get()->sys_topic_prefix, method);
+
+    regist_uri(dm_thing_manager, uri_buff);
+}
+
+static void subscribe_custom_routes(dm_thing_manager_t* dm_thing_manager)
+{
+    dm_thing_manager_route_t* route;
+    size_t index;
+
+    for (index = 0; index < dm_thing_manager->_route_index.slot_number; ++index) {
+        route = dm_thing_manager->_route_index.slots[index].item;
+        if (route && route->route_fp == NULL) subscribe_route(dm_thing_manager, route->method);
+    }
+}
+
+static void cmp_register_handler(iotx_cmp_send_peer_t* _source, iotx_cmp_message_info_t* _msg, void* user_data)
+{
+    dm_thing_manager_t* dm_thing_manager = user_data;
+    iotx_cmp_send_peer_t* iotx_cmp_send_peer = _source;
+    iotx_cmp_message_info_t* iotx_cmp_message_info = _msg;
+    dm_thing_manager_local_thing_t* local_thing;
+    dm_thing_manager_message_t message = {0};
+    const dm_thing_manager_route_t* route;
+    service_input_ctx_t service_input_ctx;
+    dm_id_index_entry_t* entry;
+
+    assert(dm_thing_manager && iotx_cmp_send_peer && iotx_cmp_message_info);
+
+    LITE_TRACE(LITE_TRACE_CMP_RECV, iotx_cmp_message_info->id);
+
+    print_iotx_cmp_message_info(iotx_cmp_send_peer, iotx_cmp_message_info);
+
+    /* find thing id. */
+    local_thing = find_local_thing_via_product_key_and_device_name(dm_thing_manager, iotx_cmp_send_peer->product_key,
+                                                                   iotx_cmp_send_peer->device_name);
+    message.thing = local_thing ? local_thing->thing : NULL;
+    message.iotx_cmp_message_info = iotx_cmp_message_info;
+
+    route = find_route(dm_thing_manager, iotx_cmp_message_info->URI);
+
+    if (message.thing == NULL && (route == NULL || route->route_fp != route_thing_dsl_get_reply)) {
+        dm_log_err("thing id NOT match");
+
+        return;
+    }
+
+    /* custom route takes the message as is, no service lookup. */
+    if (route && route->route_fp == NULL) {
+        route->custom_fp(message.thing, get_uri_method(iotx_cmp_message_info->URI), iotx_cmp_message_info->id,
+                         iotx_cmp_message_info->parameter, iotx_cmp_message_info->parameter_length, route->ctx);
+        goto do_exit;
+    }
+
+    if (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_REQUEST) {
+        message.request_id = iotx_cmp_message_info->id;
+
+        /* find service id trigged. */
+        service_input_ctx.dm_thing_manager = dm_thing_manager;
+        service_input_ctx.message = &message;
+        service_input_ctx.route = route;
+        if (local_thing && local_thing->service_method_index.slots && iotx_cmp_message_info->method) {
+            entry = dm_id_index_find(&local_thing->service_method_index, iotx_cmp_message_info->method,
+                                     strlen(iotx_cmp_message_info->method));
+            if (entry) set_service_input(&service_input_ctx, entry->item);
+        } else {
+            service_visit(message.thing, find_and_set_service_input, &service_input_ctx);
+        }
+        assert(message.service_identifier_requested);
+        if (message.service_identifier_requested == NULL) {
+            dm_log_err("method NOT match of service requested");
+            message_json_release(&message);
+            return;
+        }
+    } else if (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_RAW) {
+#ifdef PAYLOAD_COMPRESS_ENABLED
+        void* decompressed = NULL;
+        int raw_length = utils_lz_frame_length(iotx_cmp_message_info->parameter, iotx_cmp_message_info->parameter_length);
+#endif
+        message.request_id = iotx_cmp_message_info->id;
+        message.raw_data = iotx_cmp_message_info->parameter;
+        message.raw_data_length = iotx_cmp_message_info->parameter_length;
+#ifdef PAYLOAD_COMPRESS_ENABLED
+        /* a compressed frame reaches the callbacks as the raw data it holds, one that does not decode as it came. */
+        if (raw_length > 0 && NULL != (decompressed = dm_lite_malloc(raw_length))) {
+            if (raw_length == utils_lz_frame_decode(iotx_cmp_message_info->parameter, iotx_cmp_message_info->parameter_length,
+                                                    decompressed, raw_length)) {
+                message.raw_data = decompressed;
+                message.raw_data_length = raw_length;
+            } else {
+                dm_log_warning("raw data of %d bytes not decompressed", (int)iotx_cmp_message_info->parameter_length);
+            }
+        }
+#endif
+
+        /* invoke callback funtions. */
+        invoke_callback_list(dm_thing_manager, &message, dm_callback_type_raw_data_arrived);
+
+#ifdef PAYLOAD_COMPRESS_ENABLED
+        if (decompressed) dm_lite_free(decompressed);
+#endif
+        return;
+    }
+
+    if (iotx_cmp_message_info->URI) {
+        if (route) {
+            route->route_fp(dm_thing_manager, &message);
         } else if (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_REQUEST) { /* normal service. */
             /* invoke callback funtions. */
-            dm_thing_manager->_identifier = dm_thing_manager->_service_identifier_requested;
-            invoke_callback_list(dm_thing_manager, dm_callback_type_service_requested);
-        } else if (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_RESPONSE) { /* event resonse. */
-            /* invoke callback funtions. */
-            dm_thing_manager->_identifier = dm_thing_manager->_service_identifier_requested;
+            message.identifier = message.service_identifier_requested;
+            invoke_callback_list(dm_thing_manager, &message, dm_callback_type_service_requested);
         }
     }
 
+do_exit:
+    if (iotx_cmp_message_info->message_type == IOTX_CMP_MESSAGE_RESPONSE) finish_request(dm_thing_manager, iotx_cmp_message_info);
+
+    message_json_release(&message);
+
     if (iotx_cmp_message_info->URI) {
         dm_lite_free(iotx_cmp_message_info->URI);
         iotx_cmp_message_info->URI = NULL;
@@ -840,10 +1757,10 @@ static void send_request_to_uri(void* _dm_thing_manager, const char* _uri)
 
     clear_and_set_message_info(message_info, dm_thing_manager);
 
-    (*message_info)->set_uri(message_info, uri_buff);
-    (*message_info)->set_message_type(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
+    CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, uri_buff);
+    CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
 
-    ret = (*message_info)->serialize_to_payload_request(message_info);
+    ret = CMP_MESSAGE_INFO_CALL(message_info, serialize_to_payload_request)(message_info);
 
     if (ret == -1) {
         dm_log_err("serialize_to_payload_request FAIL");
@@ -853,12 +1770,54 @@ static void send_request_to_uri(void* _dm_thing_manager, const char* _uri)
 
 }
 
+static int dm_thing_manager_register_route(void* _self, const char* method, dm_route_handler_fp_t handler, void* ctx)
+{
+    dm_thing_manager_t* self = _self;
+    dm_thing_manager_route_t* route;
+    size_t method_len;
+
+    assert(method && handler);
+
+    method_len = method ? strlen(method) : 0;
+    if (method_len == 0 || handler == NULL) {
+        dm_log_err("invalid param");
+        return -1;
+    }
+
+    if (dm_id_index_find(&self->_route_index, method, method_len)) {
+        dm_log_err("route %s exists", method);
+        return -1;
+    }
+
+    /* method is kept right after route. */
+    route = dm_lite_calloc(1, sizeof(dm_thing_manager_route_t) + method_len + 1);
+    if (route == NULL) {
+        dm_log_err("calloc %d byte failed", sizeof(dm_thing_manager_route_t) + method_len + 1);
+        return -1;
+    }
+    memcpy(route + 1, method, method_len);
+    route->method = (char*)(route + 1);
+    route->custom_fp = handler;
+    route->ctx = ctx;
+
+    if (dm_id_index_insert(&self->_route_index, route->method, method_len, route) == NULL) {
+        dm_lite_free(route);
+        return -1;
+    }
+
+    /* otherwise subscribed with the others when cloud connected. */
+    if (self->_cloud_connected) subscribe_route(self, route->method);
+
+    return 0;
+}
+
 static void* dm_thing_manager_ctor(void* _self, va_list* params)
 {
     dm_thing_manager_t* self = _self;
     cmp_abstract_t** cmp;
     handle_dm_callback_fp_t callback_func;
     list_t** list;
+    const utils_identity_t* identity;
 
     self->_name = va_arg(*params, char*);
     self->_get_tsl_from_cloud = va_arg(*params, int);
@@ -867,14 +1826,17 @@ static void* dm_thing_manager_ctor(void* _self, va_list* params)
 
     assert(self->_name);
 
-    self->_local_thing_list = new_object(SINGLE_LIST_CLASS, string_local_thing_list);
-    self->_local_thing_name_list = new_object(SINGLE_LIST_CLASS, string_local_thing_name_list);
-    self->_sub_thing_list = new_object(SINGLE_LIST_CLASS, string_sub_thing_list);
-    self->_callback_list = new_object(SINGLE_LIST_CLASS, string_callback_list);
-    self->_service_property_get_identifier_list = new_object(SINGLE_LIST_CLASS, string_service_property_get_identifier_list);
+    self->_local_thing_list = dm_object_new_at(&self->_list_storage[0], SINGLE_LIST_CLASS, string_local_thing_list);
+    self->_local_thing_name_list = dm_object_new_at(&self->_list_storage[1], SINGLE_LIST_CLASS, string_local_thing_name_list);
+    self->_template_list = dm_object_new_at(&self->_list_storage[2], SINGLE_LIST_CLASS, string_template_list);
+    self->_cloud_template = NULL;
+    self->_sub_thing_list = dm_object_new_at(&self->_list_storage[3], SINGLE_LIST_CLASS, string_sub_thing_list);
+    self->_callback_list = dm_object_new_at(&self->_list_storage[4], SINGLE_LIST_CLASS, string_callback_list);
+    self->_property_get_params = NULL;
+    self->_property_get_params_length = 0;
     self->_local_thing_id = 0;
     self->_thing_id = NULL;
-    self->_message_info = new_object(CMP_MESSAGE_INFO_CLASS);
+    self->_message_info = dm_object_new_at(&self->_message_info_storage, CMP_MESSAGE_INFO_CLASS);
     self->_dm_version = DM_REQUEST_VERSION_STRING;
     self->_id = 0;
     self->_method = NULL;
@@ -882,17 +1844,58 @@ static void* dm_thing_manager_ctor(void* _self, va_list* params)
     self->_cmp_event_handle_func_fp = cmp_event_handler;
     self->_cmp_register_func_fp = cmp_register_handler;
     self->_cloud_connected = 0;
-    self->_property_identifier_set = NULL;
     self->_destructing = 0;
+    self->_property_post_min_interval_ms = 0;
+    self->_property_post_max_latency_ms = 0;
+    self->_metrics_post_interval_ms = 0;
+    self->_regist_pending = 0;
+    self->_metrics_post_last_ms = 0;
+    self->_payload_format = dm_payload_format_json;
+    self->_reply_handler = NULL;
+    self->_reply_ctx = NULL;
+    self->_requests = NULL;
+#ifdef RRPC_ENABLED
+    self->_rrpc = 0;
+    self->_rrpc_message_id = NULL;
+    memset(self->_rrpc_pending, 0, sizeof(self->_rrpc_pending));
+    self->_rrpc_token = 0;
+#endif /* RRPC_ENABLED */
+#ifdef DM_OFFLINE_ENABLED
+    self->_offline = NULL;
+    self->_offline_replay_last_ms = 0;
+#endif /* DM_OFFLINE_ENABLED */
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+    memset(self->_uplink_pending, 0, sizeof(self->_uplink_pending));
+    self->_uplink_pending_number = 0;
+    self->_uplink_pending_retry_ms = 0;
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+#ifdef DM_BACKPRESSURE_ENABLED
+    self->_send_blocked = 0;
+    self->_property_post_backoff = 1;
+#endif /* DM_BACKPRESSURE_ENABLED */
+
+    self->_send_mutex = HAL_MutexCreate();
+    if (self->_send_mutex == NULL) dm_log_err("send mutex create failed");
+
+    self->_request_mutex = HAL_MutexCreate();
+    if (self->_request_mutex == NULL) dm_log_err("request mutex create failed");
+
+    install_routes(self);
+
+    LITE_mem_pressure_register(on_mem_pressure, self);
+
+    dm_id_index_init(&self->_local_thing_index, 1);
+    dm_id_index_init(&self->_local_thing_key_index, 1);
 
     list = (list_t**)self->_callback_list;
     if (callback_func) list_insert(list, callback_func);
 
     /* get relative information. */
-    HAL_GetProductKey(self->_product_key);
-    HAL_GetDeviceName(self->_device_name);
-    HAL_GetDeviceSecret(self->_device_secret);
-    HAL_GetDeviceID(self->_device_id);
+    identity = utils_identity_get();
+    strcpy(self->_product_key, identity->product_key);
+    strcpy(self->_device_name, identity->device_name);
+    strcpy(self->_device_secret, identity->device_secret);
+    strcpy(self->_device_id, identity->device_id);
 
     assert(self->_product_key && self->_device_name && self->_device_secret && self->_device_id);
 
@@ -919,24 +1922,58 @@ static void* dm_thing_manager_dtor(void* _self)
 
     self->_destructing = 1;
 
-    local_thing_list_iterator(self, free_list_thing);
+    LITE_mem_pressure_unregister(on_mem_pressure, self);
+
+    local_thing_list_visit(self, free_list_thing);
 
     list = self->_local_thing_name_list;
     list_iterator(list, free_list_string, self);
 
-    list = self->_service_property_get_identifier_list;
-    list_iterator(list, free_list_string, self);
+    /* after things, they may point into the blobs. */
+    list = self->_template_list;
+    list_iterator(list, free_list_template, self);
 
     assert(self->_local_thing_list && self->_local_thing_name_list && self->_sub_thing_list && self->_callback_list && self->_message_info);
 
-    delete_object(self->_local_thing_list);
-    delete_object(self->_local_thing_name_list);
-    delete_object(self->_service_property_get_identifier_list);
-    delete_object(self->_sub_thing_list);
-    delete_object(self->_callback_list);
-    delete_object(self->_message_info);
+    dm_object_delete_at(self->_local_thing_list);
+    dm_object_delete_at(self->_local_thing_name_list);
+    dm_object_delete_at(self->_template_list);
+    dm_object_delete_at(self->_sub_thing_list);
+    dm_object_delete_at(self->_callback_list);
+    dm_object_delete_at(self->_message_info);
     delete_object(self->_cmp);
 
+    free_routes(self);
+    free_local_thing_index(self);
+
+#ifdef DM_OFFLINE_ENABLED
+    /* the block written is kept in kv for the next start. */
+    if (self->_offline) {
+        dm_offline_deinit(self->_offline);
+        dm_lite_free(self->_offline);
+        self->_offline = NULL;
+    }
+#endif /* DM_OFFLINE_ENABLED */
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+    while (self->_uplink_pending_number > 0) free_uplink_pending(self->_uplink_pending + --self->_uplink_pending_number);
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+
+    if (self->_send_mutex) {
+        HAL_MutexDestroy(self->_send_mutex);
+        self->_send_mutex = NULL;
+    }
+
+    /* requests waiting are forgotten, their handlers are not called. */
+    if (self->_requests) {
+        dm_lite_free(self->_requests);
+        self->_requests = NULL;
+    }
+
+    if (self->_request_mutex) {
+        HAL_MutexDestroy(self->_request_mutex);
+        self->_request_mutex = NULL;
+    }
+
     self->_dm_version = NULL;
     self->_id = 0;
     self->_method = NULL;
@@ -950,7 +1987,6 @@ static void generate_thing_event_service_subscribe_uri(void* _item, int index, v
     service_t* service = NULL;
     dm_thing_manager_t* dm_thing_manager;
     thing_t** thing;
-    cmp_abstract_t** cmp;
 
     char method_buff[METHOD_MAX_LENGH] = {0};
     char product_key[PRODUCT_KEY_MAXLEN] = {0};
@@ -986,15 +2022,13 @@ static void generate_thing_event_service_subscribe_uri(void* _item, int index, v
         p = strtok(NULL, delimeter);
     }
 
-    cmp = dm_thing_manager->_cmp;
-    (*cmp)->regist(cmp, uri_buff, dm_thing_manager->_cmp_register_func_fp, dm_thing_manager, NULL);
+    regist_uri(dm_thing_manager, uri_buff);
 }
 
 static void generate_subscribe_uri(void* _dm_thing_manager, void* _thing)
 {
     dm_thing_manager_t* dm_thing_manager = _dm_thing_manager;
     thing_t** thing = _thing;
-    cmp_abstract_t** cmp = dm_thing_manager->_cmp;
 
     int index;
     const char** uri;
@@ -1020,803 +2054,2671 @@ static void generate_subscribe_uri(void* _dm_thing_manager, void* _thing)
     } else {
         for (index = 0 ; index < sizeof(uri_array) / sizeof(char*); ++index) {
             uri = uri_array + index;
-            dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/", dm_thing_manager->_product_key, dm_thing_manager->_device_name);
-            strcat(uri_buff, *uri);
+            dm_snprintf(uri_buff, sizeof(uri_buff), "%s%s", utils_identity_get()->sys_topic_prefix, *uri);
 
-            (*cmp)->regist(cmp, uri_buff, dm_thing_manager->_cmp_register_func_fp, dm_thing_manager, NULL);
+            regist_uri(dm_thing_manager, uri_buff);
         }
+
+        subscribe_custom_routes(dm_thing_manager);
     }
 }
 
-static void* dm_thing_manager_generate_new_local_thing(void* _self, const char* tsl, int tsl_len)
+/*
+ * things of one productKey whose tsl differs only in profile, like sub-devices of one product, share a template.
+ * the first one is parsed from tsl, the following ones load the blob compiled from it and share the identifier index
+ * of the first thing loaded from the blob. kept in _template_list till the thing manager goes, as the things.
+ */
+typedef struct {
+    unsigned char  digest[32]; /* sha256 of tsl without its profile object. */
+    char*          product_key;
+    thing_t**      thing; /* first thing of the template, parsed from tsl. */
+    unsigned char* blob; /* compiled from thing when a second one comes, things loaded from it point into it. */
+    int            blob_len;
+    thing_t**      master; /* first thing loaded from blob. */
+} dm_thing_template_t;
+
+#if defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+/* productKey and deviceName of tsl, and the digest of it without the profile which are the template key. */
+typedef struct {
+    unsigned char digest[32];
+    const char*   product_key;
+    int           product_key_len;
+    const char*   device_name;
+    int           device_name_len;
+    dm_thing_template_t* found;
+} thing_template_key_t;
+
+static int find_tsl_profile(const char* tsl, int tsl_len, int* begin, int* end)
 {
-    dm_thing_manager_t* self = _self;
-    thing_t** thing;
-    list_t** list;
-    char* thing_name;
-    size_t name_size;
+    char* pos;
+    char* key;
+    char* val;
+    int key_len, val_len, val_type;
+
+    if (tsl_len <= 0 || tsl[0] != '{') return -1;
+
+    json_object_for_each_kv((char*)tsl, tsl_len, pos, key, key_len, val, val_len, val_type) {
+        if (token_key_equal(key, key_len, "profile") && val_type == JOBJECT) {
+            *begin = val - tsl;
+            *end = *begin + val_len;
+            return 0;
+        }
+    }
 
-    assert(tsl);
+    return -1;
+}
 
-    name_size = sizeof(DM_LOCAL_THING_NAME_PATTERN) + 2;
-    thing_name = (char*)dm_lite_calloc(1, name_size);
+static int get_tsl_profile_items(const char* profile, int profile_len, const char** product_key, int* product_key_len,
+                                 const char** device_name, int* device_name_len)
+{
+    char* pos;
+    char* key;
+    char* val;
+    int key_len, val_len, val_type;
+
+    *product_key = NULL;
+    *device_name = NULL;
+
+    json_object_for_each_kv((char*)profile, profile_len, pos, key, key_len, val, val_len, val_type) {
+        /* escaped strings are left to the json loader. */
+        if (val_type != JSTRING || memchr(val, '\\', val_len)) continue;
+
+        if (token_key_equal(key, key_len, "productKey")) {
+            *product_key = val;
+            *product_key_len = val_len;
+        } else if (token_key_equal(key, key_len, "deviceName")) {
+            *device_name = val;
+            *device_name_len = val_len;
+        }
+    }
+
+    return *product_key && *device_name ? 0 : -1;
+}
 
-    memset(thing_name, 0, name_size);
-    dm_sprintf(thing_name, DM_LOCAL_THING_NAME_PATTERN, self->_local_thing_id++);
+static int get_thing_template_key(const char* tsl, int tsl_len, thing_template_key_t* key)
+{
+    iot_sha256_context ctx;
+    int profile_begin, profile_end;
 
-    thing = (thing_t**)new_object(DM_THING_CLASS, thing_name);
+    if (find_tsl_profile(tsl, tsl_len, &profile_begin, &profile_end) != 0 ||
+        get_tsl_profile_items(tsl + profile_begin, profile_end - profile_begin, &key->product_key, &key->product_key_len,
+                              &key->device_name, &key->device_name_len) != 0) return -1;
 
-    if(0 == (*thing)->set_dsl_string(thing, tsl, tsl_len)) {
-        list = self->_local_thing_list;
-        list_insert(list, thing);
+    utils_sha256_init(&ctx);
+    utils_sha256_starts(&ctx);
+    utils_sha256_update(&ctx, (const unsigned char*)tsl, profile_begin);
+    utils_sha256_update(&ctx, (const unsigned char*)tsl + profile_end, tsl_len - profile_end);
+    utils_sha256_finish(&ctx, key->digest);
+    utils_sha256_free(&ctx);
 
-        list = self->_local_thing_name_list;
-        list_insert(list, thing_name);
+    key->found = NULL;
 
-        self->_thing_id = thing;
+    return 0;
+}
 
-        dm_log_debug("new thing created@%p", self->_thing_id);
+static int match_thing_template(void* _template, void* _key)
+{
+    dm_thing_template_t* template = _template;
+    thing_template_key_t* key = _key;
 
-        /* subscribe subjects. */
-        generate_subscribe_uri(self, thing);
+    if (memcmp(template->digest, key->digest, sizeof(key->digest)) != 0 ||
+        strlen(template->product_key) != (size_t)key->product_key_len ||
+        memcmp(template->product_key, key->product_key, key->product_key_len) != 0) return 0;
 
-        /* invoke callback funtions. */
-        invoke_callback_list(self, dm_callback_type_new_thing_created);
-    }else {
-        delete_object(thing);
-        thing = NULL;
-    }
+    key->found = template;
 
-    return thing;
+    return 1;
 }
 
-static int dm_thing_manager_add_callback_function(void* _self, handle_dm_callback_fp_t callback_func)
+static dm_thing_template_t* find_thing_template(dm_thing_manager_t* self, thing_template_key_t* key)
 {
-    dm_thing_manager_t* self = _self;
-    list_t** list;
-
-    list = (list_t**)self->_callback_list;
+    list_t** list = self->_template_list;
 
-    assert(list);
-
-    if (callback_func) list_insert(list, callback_func);
+    list_visit(list, match_thing_template, key);
 
-    return 0;
+    return key->found;
 }
 
-static void free_list_thing(void* _thing, va_list* params)
+static dm_thing_template_t* new_thing_template(dm_thing_manager_t* self, const thing_template_key_t* key, thing_t** thing)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    list_t** list = self->_template_list;
+    dm_thing_template_t* template;
 
-    dm_thing_manager = va_arg(*params, void*);
+    template = dm_lite_calloc(1, sizeof(dm_thing_template_t) + key->product_key_len + 1);
+    if (template == NULL) {
+        dm_log_err("calloc %d byte failed", sizeof(dm_thing_template_t) + key->product_key_len + 1);
+        return NULL;
+    }
 
-    (void)dm_thing_manager;
+    memcpy(template->digest, key->digest, sizeof(key->digest));
+    template->product_key = (char*)(template + 1);
+    memcpy(template->product_key, key->product_key, key->product_key_len);
+    template->thing = thing;
 
-    assert(thing && *thing);
+    list_insert(list, template);
 
-    delete_object(thing);
+    return template;
 }
 
-static void free_list_string(void* _string, va_list* params)
+static int compile_thing_template(dm_thing_template_t* template)
 {
-    void* string = _string;
-    dm_thing_manager_t* dm_thing_manager;
+    const dsl_template_t* dsl_template = &((dm_thing_t*)template->thing)->dsl_template;
+    unsigned char* blob;
+    int blob_len;
 
-    dm_thing_manager = va_arg(*params, void*);
+    blob_len = dm_tsl_blob_write(dsl_template, NULL, 0);
+    if (blob_len <= 0) return -1;
 
-    (void)dm_thing_manager;
+    blob = dm_lite_calloc(1, blob_len);
+    if (blob == NULL) {
+        dm_log_err("calloc %d byte failed", blob_len);
+        return -1;
+    }
 
-    assert(string && dm_thing_manager);
+    if (dm_tsl_blob_write(dsl_template, blob, blob_len) != blob_len) {
+        dm_lite_free(blob);
+        return -1;
+    }
 
-    dm_lite_free(string);
+    template->blob = blob;
+    template->blob_len = blob_len;
 
-    string = NULL;
+    return 0;
 }
 
-static void get_service_input_output_value(void* _thing, va_list* params)
+/* load template shared, with the profile of key. */
+static int load_thing_template(thing_t** thing, dm_thing_template_t* template, const thing_template_key_t* key)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
-
-    dm_thing_manager = va_arg(*params, void*);
+    if (template->blob == NULL && compile_thing_template(template) != 0) return -1;
 
-    assert(dm_thing_manager && thing && *thing && (*thing)->get_service_input_output_data_value_by_identifier);
+    if (dm_thing_set_shared_dsl_blob(thing, (const char*)template->blob, template->blob_len, template->master) != 0) return -1;
 
-    if (dm_thing_manager->_thing_id == thing) {
-        dm_thing_manager->_ret = (*thing)->get_service_input_output_data_value_by_identifier(thing, dm_thing_manager->_identifier,
-                                                                                             dm_thing_manager->_get_value, &dm_thing_manager->_get_value_str);
-    }
+    return (*thing)->set_profile(thing, key->product_key, key->product_key_len, key->device_name, key->device_name_len);
 }
+#endif /* LITE_THING_MODEL && USING_UTILS_JSON */
 
-static void set_service_input_output_value(void* _thing, va_list* params)
+static void free_list_template(void* _template, va_list* params)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    dm_thing_template_t* template = _template;
 
-    dm_thing_manager = va_arg(*params, void*);
-
-    assert(dm_thing_manager && thing && *thing && (*thing)->set_service_input_output_data_value_by_identifier);
+    (void)params;
 
-    if (dm_thing_manager->_thing_id == thing) {
-        dm_thing_manager->_ret = (*thing)->set_service_input_output_data_value_by_identifier(thing, dm_thing_manager->_identifier,
-                                                                                             dm_thing_manager->_set_value, dm_thing_manager->_set_value_str);
-    }
+    if (template->blob) dm_lite_free(template->blob);
+    dm_lite_free(template);
 }
 
-static void get_event_output_value(void* _thing, va_list* params)
+/* empty thing object named after the next local thing id, NULL if it fails. */
+static thing_t** new_local_thing(dm_thing_manager_t* self, char** thing_name)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    thing_t** thing;
+    size_t name_size;
 
-    dm_thing_manager = va_arg(*params, void*);
+    name_size = sizeof(DM_LOCAL_THING_NAME_PATTERN) + 2;
+    *thing_name = (char*)dm_lite_calloc(1, name_size);
+    if (*thing_name == NULL) {
+        dm_log_err("calloc %d byte failed", name_size);
+        return NULL;
+    }
 
-    assert(dm_thing_manager && thing && *thing && (*thing)->get_event_value_by_identifier);
+    dm_sprintf(*thing_name, DM_LOCAL_THING_NAME_PATTERN, self->_local_thing_id++);
 
-    if (dm_thing_manager->_thing_id == thing) {
-        dm_thing_manager->_ret = (*thing)->get_event_value_by_identifier(thing, dm_thing_manager->_identifier, dm_thing_manager->_get_value, &dm_thing_manager->_get_value_str);
-    }
+    thing = (thing_t**)new_object(DM_THING_CLASS, *thing_name);
+    if (thing == NULL) dm_lite_free(*thing_name);
+
+    return thing;
 }
 
-static void set_event_output_value(void* _thing, va_list* params)
+static void insert_local_thing(dm_thing_manager_t* self, thing_t** thing, char* thing_name)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    list_t** list;
 
-    dm_thing_manager = va_arg(*params, void*);
+    list = self->_local_thing_list;
+    list_insert(list, thing);
 
-    assert(dm_thing_manager && thing && *thing && (*thing)->set_event_value_by_identifier);
+    list = self->_local_thing_name_list;
+    list_insert(list, thing_name);
 
-    if (dm_thing_manager->_thing_id == thing) {
-        dm_thing_manager->_ret = (*thing)->set_event_value_by_identifier(thing, dm_thing_manager->_identifier,
-                                                                         dm_thing_manager->_set_value, dm_thing_manager->_set_value_str);
-    }
+    dm_log_debug("new thing created@%p", thing);
 }
 
-static void invoke_callback_func(void* _callback_fp, va_list* params)
+/*
+ * create local thing and add it to the local thing lists and indexes, not subscribed yet.
+ * template is loaded from the shared one of tsl when there is one, tsl is parsed otherwise.
+ */
+static thing_t** add_local_thing(dm_thing_manager_t* self, const char* tsl, int tsl_len, dm_thing_template_t** shared)
 {
-    handle_dm_callback_fp_t callback_fp = _callback_fp;
-    dm_thing_manager_t* dm_thing_manager;
+    thing_t** thing = NULL;
+    char* thing_name = NULL;
+    int ret;
+#if defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+    thing_template_key_t key;
+    dm_thing_template_t* template = NULL;
+    int has_key;
 
-    dm_thing_manager = va_arg(*params, void*);
+    has_key = get_thing_template_key(tsl, tsl_len, &key) == 0;
+    if (has_key) template = find_thing_template(self, &key);
+#endif
+
+    *shared = NULL;
+
+#if defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+    if (template) {
+        thing = new_local_thing(self, &thing_name);
+        if (thing == NULL) return NULL;
+
+        if (load_thing_template(thing, template, &key) != 0 || index_local_thing(self, thing) != 0) {
+            dm_log_debug("tsl loaded without shared template");
+            delete_object(thing);
+            dm_lite_free(thing_name);
+            thing = NULL;
+        } else {
+            if (template->master == NULL) template->master = thing;
+            *shared = template;
+        }
+    }
+#endif
+
+    if (thing == NULL) {
+        thing = new_local_thing(self, &thing_name);
+        if (thing == NULL) return NULL;
 
-    assert(dm_thing_manager && callback_fp);
+        ret = (*thing)->set_dsl_string(thing, tsl, tsl_len);
+        if (ret != 0 || index_local_thing(self, thing) != 0) {
+            delete_object(thing);
+            dm_lite_free(thing_name);
+            return NULL;
+        }
 
-    if (callback_fp && dm_thing_manager) {
-        callback_fp(dm_thing_manager->_callback_type, dm_thing_manager->_thing_id, dm_thing_manager->_identifier,
-                    dm_thing_manager->_request_id, dm_thing_manager->_raw_data, dm_thing_manager->_raw_data_length);
+#if defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+        /* first thing of a template, the following ones of it are loaded from it. */
+        if (has_key && template == NULL) *shared = new_thing_template(self, &key, thing);
+#endif
     }
+
+    insert_local_thing(self, thing, thing_name);
+
+    return thing;
 }
 
-static void callback_list_iterator(const void* _self, handle_fp_t handle_fp)
+static void dm_thing_manager_new_local_thing_created(dm_thing_manager_t* self, thing_t** thing, int subscribe)
 {
-    const dm_thing_manager_t* self = _self;
-    list_t** list = (list_t**)self->_callback_list;
+    dm_thing_manager_message_t message = {0};
+
+    /* subscribe subjects. */
+    if (subscribe) generate_subscribe_uri(self, thing);
 
-    assert((*list)->iterator);
-    list_iterator(list, handle_fp, self);
+    /* invoke callback funtions. */
+    message.thing = thing;
+    invoke_callback_list(self, &message, dm_callback_type_new_thing_created);
 }
 
-static void set_property_value(void* _thing, va_list* params)
+static void* dm_thing_manager_generate_new_local_thing(void* _self, const char* tsl, int tsl_len)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    dm_thing_manager_t* self = _self;
+    dm_thing_template_t* shared;
+    thing_t** thing;
 
-    dm_thing_manager = va_arg(*params, void*);
+    assert(tsl);
 
-    assert(dm_thing_manager && thing && *thing && (*thing)->set_property_value_by_identifier);
+    LITE_STARTUP_BEGIN(LITE_STARTUP_TSL_LOAD);
 
-    if (dm_thing_manager->_thing_id == thing) {
-        dm_thing_manager->_ret = (*thing)->set_property_value_by_identifier(thing, dm_thing_manager->_identifier, dm_thing_manager->_set_value, dm_thing_manager->_set_value_str);
+    thing = add_local_thing(self, tsl, tsl_len, &shared);
 
-        /* invoke callback funtions. */
+    if (thing) dm_thing_manager_new_local_thing_created(self, thing, 1);
 
-            if (strchr(dm_thing_manager->_identifier, '.') == NULL &&
-                    strchr(dm_thing_manager->_identifier, '[') == NULL &&
-                    strchr(dm_thing_manager->_identifier, ']') == NULL ) {
-                invoke_callback_list(dm_thing_manager, dm_callback_type_property_value_set);
+    LITE_STARTUP_END(LITE_STARTUP_TSL_LOAD, thing != NULL);
 
-        }
-    }
+    return thing;
 }
 
-static void get_property_value(void* _thing, va_list* params)
+#if defined(TSL_CACHE_ENABLED) && defined(LITE_THING_MODEL) && defined(USING_UTILS_JSON)
+/*
+ * the tsl got from cloud is kept in kv as the blob compiled from it, behind a version byte, the template digest
+ * and the productKey it is of. a boot with get_tsl_from_cloud loads its thing from the blob as soon as cloud
+ * connects, dsltemplate/get still goes out and its reply only revalidates the digest: a tsl changed since is
+ * kept for the next boot, as things are not replaced once created.
+ */
+#define DM_TSL_CACHE_KV_KEY         "dm.tsl"
+#define DM_TSL_CACHE_KV_VERSION     (1)
+#define DM_TSL_CACHE_HEADER_LEN     (1 + 32 + 1) /* version, digest, productKey length, productKey follows. */
+
+static const char string_tsl_cache_thing[] __DM_READ_ONLY__ = "tsl cache";
+
+static void write_tsl_cache(const thing_template_key_t* key, const dsl_template_t* dsl_template)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    unsigned char* record;
+    int header_len, blob_len;
 
-    dm_thing_manager = va_arg(*params, void*);
+    header_len = DM_TSL_CACHE_HEADER_LEN + key->product_key_len;
+    blob_len = dm_tsl_blob_write(dsl_template, NULL, 0);
+    if (blob_len <= 0 || key->product_key_len > 0xFF || header_len + blob_len > CONFIG_TSL_CACHE_MAXLEN) {
+        dm_log_info("tsl of %d byte blob not cached", blob_len);
+        return;
+    }
 
-    assert(dm_thing_manager && thing && *thing && (*thing)->get_property_value_by_identifier);
+    record = dm_lite_calloc(1, header_len + blob_len);
+    if (record == NULL) {
+        dm_log_err("calloc %d byte failed", header_len + blob_len);
+        return;
+    }
 
-    if (dm_thing_manager->_thing_id == thing) {
-        dm_thing_manager->_ret = (*thing)->get_property_value_by_identifier(thing, dm_thing_manager->_identifier, dm_thing_manager->_get_value, &dm_thing_manager->_get_value_str);
+    record[0] = DM_TSL_CACHE_KV_VERSION;
+    memcpy(record + 1, key->digest, sizeof(key->digest));
+    record[1 + sizeof(key->digest)] = (unsigned char)key->product_key_len;
+    memcpy(record + DM_TSL_CACHE_HEADER_LEN, key->product_key, key->product_key_len);
+
+    if (dm_tsl_blob_write(dsl_template, record + header_len, blob_len) != blob_len ||
+        HAL_Kv_Set(DM_TSL_CACHE_KV_KEY, record, header_len + blob_len, 1) != 0) {
+        dm_log_info("save tsl cache failed");
     }
+
+    dm_lite_free(record);
 }
 
-static void local_thing_list_iterator(const void* _self, handle_fp_t handle_fp)
+/* tsl from dsltemplate/get_reply, thing the one created of it, NULL when the cached thing is there already. */
+static void save_tsl_cache(dm_thing_manager_t* self, const char* tsl, int tsl_len, thing_t** thing)
 {
-    const dm_thing_manager_t* self = _self;
-    list_t** list = (list_t**)self->_local_thing_list;
+    thing_template_key_t key;
+    thing_t** parsed;
 
-    assert((*list)->iterator);
-    list_iterator(list, handle_fp, self);
-}
+    if (get_thing_template_key(tsl, tsl_len, &key) != 0) return;
 
-static int dm_thing_manager_set_thing_property_value(void* _self, const void* thing_id, const void* identifier,
-                                                     const void* value, const char* value_str)
-{
-    dm_thing_manager_t* self = _self;
+    if (thing) {
+        write_tsl_cache(&key, &((dm_thing_t*)thing)->dsl_template);
+        self->_cloud_template = find_thing_template(self, &key);
+        return;
+    }
 
-    assert(thing_id && identifier && (value || value_str));
+    if (match_thing_template(self->_cloud_template, &key)) {
+        dm_log_debug("cached tsl up to date");
+        return;
+    }
 
-    self->_thing_id = (void*)thing_id;
-    self->_identifier = (void*)identifier;
-    self->_set_value = (void*)value;
-    self->_set_value_str = (char*)value_str;
-    self->_ret = -1;
+    parsed = (thing_t**)new_object(DM_THING_CLASS, string_tsl_cache_thing);
+    if (parsed == NULL) return;
 
-    local_thing_list_iterator(self, set_property_value);
+    if ((*parsed)->set_dsl_string(parsed, tsl, tsl_len) == 0) {
+        write_tsl_cache(&key, &((dm_thing_t*)parsed)->dsl_template);
+        dm_log_info("tsl changed on cloud, takes effect at the next boot");
+    }
 
-    return self->_ret;
+    delete_object(parsed);
 }
 
-static int dm_thing_manager_get_thing_property_value(void* _self, const void* thing_id, const void* identifier,
-                                                     void* value, char** value_str)
+/* the thing of the cached tsl of this productKey, created and subscribed, NULL if there is none. */
+static thing_t** load_tsl_cache(dm_thing_manager_t* self)
 {
-    dm_thing_manager_t* self = _self;
+    const utils_identity_t* identity = utils_identity_get();
+    thing_template_key_t key;
+    dm_thing_template_t* template;
+    thing_t** thing = NULL;
+    char* thing_name = NULL;
+    unsigned char* record;
+    unsigned char* blob;
+    int len = CONFIG_TSL_CACHE_MAXLEN;
+    int header_len;
+
+    key.product_key = identity->product_key;
+    key.product_key_len = strlen(identity->product_key);
+    key.device_name = identity->device_name;
+    key.device_name_len = strlen(identity->device_name);
+    key.found = NULL;
+    header_len = DM_TSL_CACHE_HEADER_LEN + key.product_key_len;
+
+    record = dm_lite_malloc(len);
+    if (record == NULL) {
+        dm_log_err("malloc %d byte failed", len);
+        return NULL;
+    }
 
-    assert(thing_id && identifier && (value || value_str));
+    if (HAL_Kv_Get(DM_TSL_CACHE_KV_KEY, record, &len) != 0 || len <= header_len ||
+        record[0] != DM_TSL_CACHE_KV_VERSION || record[1 + sizeof(key.digest)] != key.product_key_len ||
+        memcmp(record + DM_TSL_CACHE_HEADER_LEN, key.product_key, key.product_key_len) != 0) {
+        dm_lite_free(record);
+        return NULL;
+    }
 
-    self->_thing_id = (void*)thing_id;
-    self->_identifier = (void*)identifier;
-    self->_get_value = value;
-    self->_ret = -1;
-    self->_get_value_str = NULL;
+    memcpy(key.digest, record + 1, sizeof(key.digest));
+    blob = dm_lite_malloc(len - header_len);
+    if (blob) memcpy(blob, record + header_len, len - header_len);
+    dm_lite_free(record);
+    if (blob == NULL) return NULL;
 
-    local_thing_list_iterator(self, get_property_value);
+    LITE_STARTUP_BEGIN(LITE_STARTUP_TSL_LOAD);
 
-    if (value_str) *value_str = self->_get_value_str;
+    template = new_thing_template(self, &key, NULL);
+    if (template == NULL) {
+        dm_lite_free(blob);
+        return NULL;
+    }
+    template->blob = blob;
+    template->blob_len = len - header_len;
 
-    return self->_ret;
-}
+    thing = new_local_thing(self, &thing_name);
+    if (thing && (load_thing_template(thing, template, &key) != 0 || index_local_thing(self, thing) != 0)) {
+        delete_object(thing);
+        dm_lite_free(thing_name);
+        thing = NULL;
+    }
 
-static int dm_thing_manager_set_thing_event_output_value(void* _self, const void* thing_id, const void* identifier,
-                                                         const void* value, const char* value_str)
+    if (thing == NULL) {
+        /* the tsl from cloud makes its own thing and cache. */
+        dm_log_info("tsl cache not loaded");
+        list_remove(self->_template_list, template);
+        free_list_template(template, NULL);
+        (void)HAL_Kv_Del(DM_TSL_CACHE_KV_KEY);
+    } else {
+        template->master = thing;
+        self->_cloud_template = template;
+        insert_local_thing(self, thing, thing_name);
+        dm_thing_manager_new_local_thing_created(self, thing, 1);
+    }
+
+    LITE_STARTUP_END(LITE_STARTUP_TSL_LOAD, thing != NULL);
+
+    return thing;
+}
+#endif /* TSL_CACHE_ENABLED && LITE_THING_MODEL && USING_UTILS_JSON */
+
+/*
+ * create number things, each tsl is parsed once per distinct template: things whose tsl differs only in profile,
+ * like sub-devices of one product, load the template compiled from the first one instead of parsing json again.
+ * subscriptions go after all things are created, one set per template and productKey/deviceName.
+ */
+static int dm_thing_manager_generate_new_local_things(void* _self, const char* const* tsls, const int* tsl_lens, int number, void** things)
 {
     dm_thing_manager_t* self = _self;
+    dm_thing_template_t** thing_templates; /* shared template of each thing, NULL if none. */
+    int created = 0;
+    int i, j;
 
-    assert(thing_id && identifier && (value || value_str));
+    assert(tsls && tsl_lens && things && number > 0);
 
-    self->_thing_id = (void*)thing_id;
-    self->_identifier = (void*)identifier;
-    self->_set_value = (void*)value;
-    self->_set_value_str = (char*)value_str;
-    self->_ret = -1;
+    thing_templates = dm_lite_calloc(number, sizeof(dm_thing_template_t*));
+    if (thing_templates == NULL) {
+        dm_log_err("calloc %d byte failed", number * sizeof(dm_thing_template_t*));
+        return 0;
+    }
 
-    local_thing_list_iterator(self, set_event_output_value);
+    LITE_STARTUP_BEGIN(LITE_STARTUP_TSL_LOAD);
 
-    return self->_ret;
-}
+    for (i = 0; i < number; ++i) {
+        things[i] = NULL;
 
-static int dm_thing_manager_get_thing_event_output_value(void* _self, const void* thing_id, const void* identifier,
-                                                         void* value, char** value_str)
-{
-    dm_thing_manager_t* self = _self;
+        if (tsls[i] == NULL || tsl_lens[i] <= 0) continue;
 
-    assert(thing_id && identifier && (value || value_str));
+        things[i] = add_local_thing(self, tsls[i], tsl_lens[i], thing_templates + i);
+        if (things[i]) created++;
+    }
 
-    self->_thing_id = (void*)thing_id;
-    self->_identifier = (void*)identifier;
-    self->_get_value = value;
-    self->_ret = -1;
+    for (i = 0; i < number; ++i) {
+        if (things[i] == NULL) continue;
 
-    local_thing_list_iterator(self, get_event_output_value);
+        /* same template and productKey/deviceName subscribe the same uris, CMP would refuse them anyway. */
+        for (j = 0; j < i; ++j) {
+            if (things[j] && thing_templates[i] && thing_templates[j] == thing_templates[i] &&
+                strcmp(find_local_thing(self, things[j])->key, find_local_thing(self, things[i])->key) == 0) break;
+        }
+
+        dm_thing_manager_new_local_thing_created(self, things[i], j == i);
+    }
 
-    if (value_str) *value_str = self->_get_value_str;
+    LITE_STARTUP_END(LITE_STARTUP_TSL_LOAD, created > 0);
 
-    return self->_ret;
+    dm_lite_free(thing_templates);
+
+    return created;
 }
 
-static int dm_thing_manager_get_thing_service_input_value(void* _self, const void* thing_id, const void* identifier,
-                                                          void* value, char** value_str)
+static int dm_thing_manager_add_callback_function(void* _self, handle_dm_callback_fp_t callback_func)
 {
     dm_thing_manager_t* self = _self;
+    list_t** list;
 
-    assert(thing_id && identifier && (value || value_str));
-
-    self->_thing_id = (void*)thing_id;
-    self->_identifier = (void*)identifier;
-    self->_get_value = value;
-    self->_ret = -1;
+    list = (list_t**)self->_callback_list;
 
-    local_thing_list_iterator(self, get_service_input_output_value);
+    assert(list);
 
-    if (value_str) *value_str = self->_get_value_str;
+    if (callback_func) list_insert(list, callback_func);
 
-    return self->_ret;
+    return 0;
 }
 
-static int dm_thing_manager_get_thing_service_output_value(void* _self, const void* thing_id, const void* identifier,
-                                                           void* value, char** value_str)
+static int free_list_thing(void* _thing, void* ctx)
 {
-    dm_thing_manager_t* self = _self;
+    thing_t** thing = _thing;
+    dm_thing_manager_t* dm_thing_manager;
 
-    return dm_thing_manager_get_thing_service_input_value(self, thing_id, identifier, value, value_str);
+    dm_thing_manager = ctx;
+
+    (void)dm_thing_manager;
+
+    assert(thing && *thing);
+
+    delete_object(thing);
+
+    return 0;
 }
 
-static int dm_thing_manager_set_thing_service_output_value(void* _self, const void* thing_id, const void* identifier,
-                                                           const void* value, const char* value_str)
+static void free_list_string(void* _string, va_list* params)
 {
-    dm_thing_manager_t* self = _self;
+    void* string = _string;
+    dm_thing_manager_t* dm_thing_manager;
 
-    assert(thing_id && identifier && (value || value_str));
+    dm_thing_manager = va_arg(*params, void*);
 
-    self->_thing_id = (void*)thing_id;
-    self->_identifier = (void*)identifier;
-    self->_set_value = (void*)value;
-    self->_set_value_str = (char*)value_str;
-    self->_ret = -1;
+    (void)dm_thing_manager;
 
-    local_thing_list_iterator(self, set_service_input_output_value);
+    assert(string && dm_thing_manager);
 
-    return self->_ret;
+    dm_lite_free(string);
+
+    string = NULL;
 }
 
-static int install_lite_property_to_message_info(dm_thing_manager_t* _thing_manager, message_info_t** _message_info, lite_property_t* _lite_property)
+static void invoke_callback_func(void* _callback_fp, va_list* params)
 {
-    lite_property_t* lite_property = _lite_property;
-    message_info_t** message_info = _message_info;
-    dm_thing_manager_t* dm_thing_manager = _thing_manager;
-    thing_t** thing = dm_thing_manager->_thing_id;
-    char* p = NULL;
-
-    char* q = NULL;
-    dm_thing_t* dm_thing;
-    size_t params_buffer_len = 0;
-    size_t params_val_len = 0;
-    int ret, i;
-    char property_key_value_buff[PROPERTY_KEY_VALUE_BUFF_MAX_LENGTH] = {0};
+    handle_dm_callback_fp_t callback_fp = _callback_fp;
+    const dm_thing_manager_message_t* message;
+    dm_callback_type_t dm_callback_type;
 
-    ret = (*thing)->get_lite_property_value(thing, lite_property, NULL, &dm_thing_manager->_get_value_str);
+    message = va_arg(*params, const dm_thing_manager_message_t*);
+    dm_callback_type = va_arg(*params, int);
 
-    if ((lite_property->data_type.type == data_type_type_text || lite_property->data_type.type == data_type_type_date) && dm_thing_manager->_get_value_str) {
-        p = dm_lite_calloc(1, strlen(dm_thing_manager->_get_value_str) + 3);
-        assert(p);
+    assert(message && callback_fp);
 
-        dm_sprintf(p, "\"%s\"", dm_thing_manager->_get_value_str);
-        dm_thing_manager->_get_value_str = p;
+    if (callback_fp && message) {
+        callback_fp(dm_callback_type, message->thing, message->identifier,
+                    message->request_id, message->raw_data, message->raw_data_length);
     }
+}
 
-    if (ret != 0 && lite_property->data_type.type == data_type_type_array) {
-        dm_thing = (dm_thing_t*)thing;
-        property_key_value_buff[0] = '[';
-        property_key_value_buff[1] = '\0';
+static int set_thing_property_value(dm_thing_manager_t* dm_thing_manager, const dm_thing_manager_message_t* message, thing_t** thing,
+                                    const char* identifier, const void* value, const char* value_str)
+{
+    int ret;
 
-        params_buffer_len = sizeof(property_key_value_buff);
-        for (i = 0; i < lite_property->data_type.value.data_type_array_t.size; i++) {
-            dm_thing->_arr_index = i;
-            dm_thing_manager->_get_value_str = NULL;
-            ret = (*thing)->get_lite_property_value(thing, lite_property, NULL, &dm_thing_manager->_get_value_str);
-            params_val_len = strlen(property_key_value_buff);
+    ret = (*thing)->set_property_value_by_identifier(thing, identifier, value, value_str);
 
-            if (ret != 0 || !dm_thing_manager->_get_value_str) {
-                dm_thing_manager->_get_value_str = NULL;
-            }
-            if (lite_property->data_type.value.data_type_array_t.item_type == data_type_type_text) {
-                dm_snprintf(property_key_value_buff + params_val_len, params_buffer_len - params_val_len, "\"%s\",", dm_thing_manager->_get_value_str ? dm_thing_manager->_get_value_str : "");
+    /* invoke callback funtions. */
+    if (strchr(identifier, '.') == NULL &&
+            strchr(identifier, '[') == NULL &&
+            strchr(identifier, ']') == NULL ) {
+        invoke_property_value_set_callback(dm_thing_manager, message, thing, identifier);
+    }
+
+    return ret;
+}
+
+/* local thing of thing_id, NULL if thing_id is not a local thing. */
+static thing_t** get_local_thing(const dm_thing_manager_t* dm_thing_manager, const void* thing_id)
+{
+    dm_thing_manager_local_thing_t* local_thing;
+
+    local_thing = find_local_thing(dm_thing_manager, thing_id);
+
+    return local_thing ? local_thing->thing : NULL;
+}
+
+/* visit all local things, handler returns non 0 to skip the rest. */
+static int local_thing_list_visit(const void* _self, visit_fp_t visit_fp)
+{
+    const dm_thing_manager_t* self = _self;
+    list_t** list = (list_t**)self->_local_thing_list;
+
+    assert((*list)->visit);
+    return list_visit(list, visit_fp, (void*)self);
+}
+
+/* visit local thing of _thing_id only, it is looked up in the index, nothing visited if not a local thing. */
+static int local_thing_visit(const void* _self, visit_fp_t visit_fp)
+{
+    const dm_thing_manager_t* self = _self;
+    dm_thing_manager_local_thing_t* local_thing;
+
+    local_thing = find_local_thing(self, self->_thing_id);
+    if (local_thing == NULL) return 0;
+
+    return visit_fp(local_thing->thing, (void*)self);
+}
+
+static int dm_thing_manager_set_thing_property_value(void* _self, const void* thing_id, const void* identifier,
+                                                     const void* value, const char* value_str)
+{
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+
+    assert(thing_id && identifier && (value || value_str));
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    return set_thing_property_value(self, NULL, thing, identifier, value, value_str);
+}
+
+static int dm_thing_manager_get_thing_property_value(void* _self, const void* thing_id, const void* identifier,
+                                                     void* value, char** value_str)
+{
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+    char* get_value_str = NULL;
+    int ret;
+
+    assert(thing_id && identifier && (value || value_str));
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    ret = (*thing)->get_property_value_by_identifier(thing, identifier, value, &get_value_str);
+
+    if (value_str) *value_str = get_value_str;
+
+    return ret;
+}
+
+static void* dm_thing_manager_resolve_thing_property_handle(void* _self, const void* thing_id, const char* identifier)
+{
+    dm_thing_manager_t* self = _self;
+    dm_thing_manager_property_handle_t* handle;
+    thing_t** thing;
+
+    assert(thing_id && identifier);
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return NULL;
+
+    handle = dm_lite_calloc(1, sizeof(dm_thing_manager_property_handle_t));
+    if (handle == NULL) return NULL;
+
+    if ((*thing)->resolve_property_handle(thing, identifier, &handle->thing_handle) != 0) {
+        dm_lite_free(handle);
+        return NULL;
+    }
+
+    handle->thing_id = thing;
+
+    return handle;
+}
+
+static void dm_thing_manager_release_thing_property_handle(void* _self, void* handle)
+{
+    if (handle) dm_lite_free(handle);
+}
+
+static int dm_thing_manager_set_thing_property_value_by_handle(void* _self, const void* _handle, const void* value, const char* value_str)
+{
+    dm_thing_manager_t* self = _self;
+    const dm_thing_manager_property_handle_t* handle = _handle;
+    thing_t** thing;
+    int ret;
+
+    assert(handle && (value || value_str));
+
+    thing = handle->thing_id;
+    ret = (*thing)->set_property_value_by_handle(thing, &handle->thing_handle, value, value_str);
+
+    /* invoke callback funtions only when top level property set, same as set by identifier. */
+    if (handle->thing_handle.lite_property == handle->thing_handle.property && handle->thing_handle.arr_index == -1) {
+        invoke_property_value_set_callback(self, NULL, thing, ((property_t*)handle->thing_handle.property)->identifier);
+    }
+
+    return ret;
+}
+
+static int dm_thing_manager_get_thing_property_value_by_handle(void* _self, const void* _handle, void* value, char** value_str)
+{
+    const dm_thing_manager_property_handle_t* handle = _handle;
+    thing_t** thing;
+
+    assert(handle && (value || value_str));
+
+    thing = handle->thing_id;
+
+    return (*thing)->get_property_value_by_handle(thing, &handle->thing_handle, value, value_str);
+}
+
+static int dm_thing_manager_copy_thing_property_value(void* _self, const void* thing_id, const char* identifier,
+                                                      void* value, char* buff, int buff_len)
+{
+    dm_thing_manager_t* self = _self;
+    thing_property_handle_t handle;
+    thing_t** thing;
+
+    assert(thing_id && identifier && (value || buff));
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    if ((*thing)->resolve_property_handle(thing, identifier, &handle) != 0) return -1;
+
+    return (*thing)->copy_property_value_by_handle(thing, &handle, value, buff, buff_len);
+}
+
+static int dm_thing_manager_copy_thing_property_value_by_handle(void* _self, const void* _handle, void* value, char* buff, int buff_len)
+{
+    const dm_thing_manager_property_handle_t* handle = _handle;
+    thing_t** thing;
+
+    assert(handle && (value || buff));
+
+    thing = handle->thing_id;
+
+    return (*thing)->copy_property_value_by_handle(thing, &handle->thing_handle, value, buff, buff_len);
+}
+
+static int dm_thing_manager_set_thing_property_values(void* _self, const void* thing_id, const void* values, int number)
+{
+    dm_thing_manager_t* self = _self;
+    const dm_property_value_t* property_values = values;
+    const dm_property_value_t* property_value;
+    const dm_thing_manager_property_handle_t* handle;
+    thing_t** thing;
+    int index, ret, failed = 0;
+
+    assert(thing_id && values && number > 0);
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    /* apply all items, one failed item does not stop the others. */
+    for (index = 0; index < number; ++index) {
+        property_value = property_values + index;
+        handle = property_value->handle;
+        ret = -1;
+
+        if (property_value->value == NULL && property_value->value_str == NULL) {
+            dm_log_err("property value %d has no value", index);
+        } else if (handle) {
+            if (handle->thing_id == thing) {
+                ret = dm_thing_manager_set_thing_property_value_by_handle(self, handle, property_value->value, property_value->value_str);
             } else {
-                dm_snprintf(property_key_value_buff + params_val_len, params_buffer_len - params_val_len, "%s,", dm_thing_manager->_get_value_str ? dm_thing_manager->_get_value_str : "0");
+                dm_log_err("property handle %d NOT belongs to thing", index);
             }
+        } else if (property_value->identifier) {
+            ret = set_thing_property_value(self, NULL, thing, property_value->identifier, property_value->value, property_value->value_str);
+        }
+
+        if (ret != 0) failed++;
+    }
+
+    return failed ? -1 : 0;
+}
+
+static int dm_thing_manager_set_thing_property_array_values(void* _self, const void* thing_id, const void* identifier,
+                                                            int start, const void* values, int number)
+{
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+    int ret;
+
+    assert(thing_id && identifier && values);
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    ret = (*thing)->set_property_array_values(thing, identifier, start, values, number);
+
+    /* invoke callback funtions for top level array, same as set_thing_property_value. */
+    if (ret == 0 && strchr(identifier, '.') == NULL && strchr(identifier, '[') == NULL) {
+        invoke_property_value_set_callback(self, NULL, thing, identifier);
+    }
+
+    return ret;
+}
+
+static int dm_thing_manager_get_thing_property_array_values(void* _self, const void* thing_id, const void* identifier,
+                                                            int start, void* values, int number)
+{
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+
+    assert(thing_id && identifier && values);
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    return (*thing)->get_property_array_values(thing, identifier, start, values, number);
+}
+
+static int dm_thing_manager_set_thing_event_output_value(void* _self, const void* thing_id, const void* identifier,
+                                                         const void* value, const char* value_str)
+{
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+
+    assert(thing_id && identifier && (value || value_str));
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    return (*thing)->set_event_value_by_identifier(thing, identifier, value, value_str);
+}
+
+static int dm_thing_manager_get_thing_event_output_value(void* _self, const void* thing_id, const void* identifier,
+                                                         void* value, char** value_str)
+{
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+    char* get_value_str = NULL;
+    int ret;
+
+    assert(thing_id && identifier && (value || value_str));
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    ret = (*thing)->get_event_value_by_identifier(thing, identifier, value, &get_value_str);
+
+    if (value_str) *value_str = get_value_str;
+
+    return ret;
+}
+
+static int dm_thing_manager_get_thing_service_input_value(void* _self, const void* thing_id, const void* identifier,
+                                                          void* value, char** value_str)
+{
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+    char* get_value_str = NULL;
+    int ret;
+
+    assert(thing_id && identifier && (value || value_str));
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    ret = (*thing)->get_service_input_output_data_value_by_identifier(thing, identifier, value, &get_value_str);
+
+    if (value_str) *value_str = get_value_str;
+
+    return ret;
+}
+
+static int dm_thing_manager_get_thing_service_output_value(void* _self, const void* thing_id, const void* identifier,
+                                                           void* value, char** value_str)
+{
+    dm_thing_manager_t* self = _self;
+
+    return dm_thing_manager_get_thing_service_input_value(self, thing_id, identifier, value, value_str);
+}
+
+static int dm_thing_manager_set_thing_service_output_value(void* _self, const void* thing_id, const void* identifier,
+                                                           const void* value, const char* value_str)
+{
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+
+    assert(thing_id && identifier && (value || value_str));
+
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
+
+    return (*thing)->set_service_input_output_data_value_by_identifier(thing, identifier, value, value_str);
+}
+
+typedef void (*format_property_value_t)(dm_json_writer_t* writer, void* ctx);
+
+/*
+ * format a property value into buff, only when it does not fit it is measured and formatted
+ * again on heap, caller frees result if it is not buff. NULL when fail.
+ */
+static char* format_property_value(format_property_value_t format, void* ctx, char* buff, size_t buff_size)
+{
+    dm_json_writer_t writer;
+    size_t len;
+    char* dst;
+
+    dm_json_writer_init(&writer, buff, buff_size);
+    format(&writer, ctx);
+
+    if (!dm_json_writer_truncated(&writer)) return buff;
+
+    len = dm_json_writer_length(&writer);
+    dst = dm_lite_calloc(1, len + 1);
+    if (dst == NULL) {
+        dm_log_err("calloc %d byte failed", (int)(len + 1));
+        return NULL;
+    }
+
+    dm_json_writer_init(&writer, dst, len + 1);
+    format(&writer, ctx);
+
+    return dst;
+}
+
+/* json array like [1,2,3] straight from array storage. */
+static void format_array_property_value(dm_json_writer_t* writer, void* ctx)
+{
+    const lite_property_t* lite_property = ctx;
+    const data_type_x_t* data_type_x = &lite_property->data_type.value;
+    const void* array = data_type_x->data_type_array_t.array;
+    data_type_type_t item_type = data_type_x->data_type_array_t.item_type;
+    int size = data_type_x->data_type_array_t.size;
+    const char* text;
+    int i;
+
+    dm_json_writer_array_begin(writer);
+
+    for (i = 0; i < size; ++i) {
+        switch (item_type) {
+        case data_type_type_int:
+            dm_json_writer_int(writer, ((const int*)array)[i]);
+            break;
+        case data_type_type_float:
+            dm_json_writer_double(writer, ((const float*)array)[i], 7);
+            break;
+        case data_type_type_double:
+            dm_json_writer_double(writer, ((const double*)array)[i], 16);
+            break;
+        case data_type_type_text:
+            text = ((char* const*)array)[i];
+            dm_json_writer_string(writer, text ? text : "", text ? strlen(text) : 0);
+            break;
+        default:
+            break;
         }
-        q = property_key_value_buff + strlen(property_key_value_buff) - 1;
-        if (*q == '[') *(q+1) = ']';
-        if (*q == ',') *(q) = ']';
+    }
+
+    dm_json_writer_array_end(writer);
+}
+
+static void format_string_property_value(dm_json_writer_t* writer, void* ctx)
+{
+    const char* value_str = ctx;
+
+    dm_json_writer_string(writer, value_str, strlen(value_str));
+}
+
+static int install_lite_property_to_message_info(dm_thing_manager_t* _thing_manager, message_info_t** _message_info, lite_property_t* _lite_property)
+{
+    lite_property_t* lite_property = _lite_property;
+    message_info_t** message_info = _message_info;
+    dm_thing_manager_t* dm_thing_manager = _thing_manager;
+    thing_t** thing = dm_thing_manager->_thing_id;
+    char* value = NULL;
+    int ret;
+    char property_key_value_buff[PROPERTY_KEY_VALUE_BUFF_MAX_LENGTH];
+
+    if (lite_property->data_type.type == data_type_type_array) {
+        value = format_property_value(format_array_property_value, lite_property, property_key_value_buff, sizeof(property_key_value_buff));
+        if (value == NULL) return -1;
+
+        CMP_MESSAGE_INFO_CALL(message_info, add_params_data_item)(message_info, lite_property->identifier, value);
+
+        if (value != property_key_value_buff) dm_lite_free(value);
+
+        return 0;
+    }
+
+    ret = (*thing)->get_lite_property_value(thing, lite_property, NULL, &dm_thing_manager->_get_value_str);
+
+    if (ret != 0 || lite_property->identifier == NULL || dm_thing_manager->_get_value_str == NULL) return ret;
+
+    value = dm_thing_manager->_get_value_str;
+
+    /* string values are quoted and escaped. */
+    if (lite_property->data_type.type == data_type_type_text || lite_property->data_type.type == data_type_type_date) {
+        value = format_property_value(format_string_property_value, dm_thing_manager->_get_value_str,
+                                      property_key_value_buff, sizeof(property_key_value_buff));
+        if (value == NULL) return -1;
+    }
+
+    CMP_MESSAGE_INFO_CALL(message_info, add_params_data_item)(message_info, lite_property->identifier, value);
+
+    if (value != dm_thing_manager->_get_value_str && value != property_key_value_buff) dm_lite_free(value);
+
+    return ret;
+}
+
+static void get_product_key_device_name(char* _product_key, char* _device_name, void* _thing, void* _dm_thing_manager)
+{
+    char* product_key = _product_key;
+    char* device_name = _device_name;
+
+    thing_t** thing = _thing;
+    dm_thing_manager_t* dm_thing_manager = _dm_thing_manager;
+    if (thing && *thing) {
+        dm_thing_manager_install_product_key_device_name(dm_thing_manager, thing, product_key, device_name);
+    } else {
+        strcpy(product_key, dm_thing_manager->_product_key);
+        strcpy(device_name, dm_thing_manager->_device_name);
+    }
+}
+
+static void clear_and_set_message_info(message_info_t** _message_info, dm_thing_manager_t* _dm_thing_manager)
+{
+    dm_thing_manager_t* dm_thing_manager = _dm_thing_manager;
+    message_info_t** message_info = _message_info;
+    thing_t** thing;
+
+    char product_key[PRODUCT_KEY_MAXLEN] = {0};
+    char device_name[DEVICE_NAME_MAXLEN] = {0};
+
+    assert(message_info && *message_info && dm_thing_manager);
+
+    if (message_info == NULL || *message_info == NULL || dm_thing_manager == NULL) return;
+
+    thing = dm_thing_manager->_thing_id;
+
+    get_product_key_device_name(product_key, device_name, thing, dm_thing_manager);
+    if (0 == dm_thing_manager->_id) dm_thing_manager->_id++;
+
+    CMP_MESSAGE_INFO_CALL(message_info, clear)(message_info);
+
+    CMP_MESSAGE_INFO_CALL(message_info, set_product_key)(message_info, product_key);
+    CMP_MESSAGE_INFO_CALL(message_info, set_device_name)(message_info, device_name);
+    CMP_MESSAGE_INFO_CALL(message_info, set_version)(message_info, dm_thing_manager->_dm_version);
+    CMP_MESSAGE_INFO_CALL(message_info, set_id)(message_info, dm_thing_manager->_id);
+    dm_thing_manager->_id = (dm_thing_manager->_id + 1) % INT32_MAX;
+    CMP_MESSAGE_INFO_CALL(message_info, set_method)(message_info, dm_thing_manager->_method);
+}
+
+typedef struct {
+    dm_thing_manager_t* dm_thing_manager;
+    thing_t**           thing;
+    message_info_t**    message_info;
+    const char*         target_property_identifier; /* NULL for all properties. */
+    property_t*         property; /* struct property being formatted. */
+} install_property_ctx_t;
+
+typedef struct {
+    dm_thing_manager_t* dm_thing_manager;
+    message_info_t**    message_info;
+    thing_t**           thing;
+} key_value_ctx_t;
+
+/* json object of struct members, text members are quoted and escaped. */
+static void format_struct_property_value(dm_json_writer_t* writer, void* ctx)
+{
+    install_property_ctx_t* install_ctx = ctx;
+    dm_thing_manager_t* dm_thing_manager = install_ctx->dm_thing_manager;
+    thing_t** thing = install_ctx->thing;
+    property_t* property = install_ctx->property;
+    lite_property_t* struct_lite_property;
+    char* value_str;
+    int i;
+
+    dm_json_writer_object_begin(writer);
+
+    for (i = 0; i < property->data_type.data_type_specs_number; ++i) {
+        struct_lite_property = (lite_property_t*)property->data_type.specs + i;
+
+        if ((*thing)->get_lite_property_value(thing, struct_lite_property, NULL, &dm_thing_manager->_get_value_str) != 0) continue;
+
+        value_str = dm_thing_manager->_get_value_str;
+        if (value_str == NULL) continue;
+
+        dm_json_writer_key(writer, struct_lite_property->identifier, strlen(struct_lite_property->identifier));
+
+        if (struct_lite_property->data_type.type == data_type_type_text) {
+            dm_json_writer_string(writer, value_str, strlen(value_str));
+        } else {
+            dm_json_writer_raw(writer, value_str, strlen(value_str));
+        }
+    }
+
+    dm_json_writer_object_end(writer);
+}
+
+static int install_property_to_message_info(property_t* property, int index, void* ctx)
+{
+    install_property_ctx_t* install_ctx = ctx;
+    lite_property_t* lite_property;
+    dm_thing_manager_t* dm_thing_manager;
+    thing_t** thing;
+    message_info_t** message_info;
+    const char* target_property_identifier;
+    int ret;
+    char property_key_value_buff[PROPERTY_KEY_VALUE_BUFF_MAX_LENGTH] = {0};
+    char* value;
+
+    dm_thing_manager = install_ctx->dm_thing_manager;
+    thing = install_ctx->thing;
+    message_info = install_ctx->message_info;
+    target_property_identifier = install_ctx->target_property_identifier;
+
+    (void)index;
+
+    assert(property && dm_thing_manager && thing && *thing && message_info && *message_info);
+
+    lite_property = (lite_property_t*)property;
+
+    if (target_property_identifier == NULL && dm_thing_manager->_property_post_changed_only &&
+        (*thing)->is_property_posting(thing, property) == 0) return 0;
+
+    /* post all value, or specify identifier. */
+    if (property && (target_property_identifier == NULL || (property->identifier && strcmp(property->identifier, target_property_identifier) == 0))) {
+        ret = install_lite_property_to_message_info(dm_thing_manager, message_info, lite_property);
+
+        if (ret == -1) {
+            value = property_key_value_buff;
+
+            if (property->data_type.type == data_type_type_struct) {
+                install_ctx->property = property;
+                value = format_property_value(format_struct_property_value, install_ctx,
+                                              property_key_value_buff, sizeof(property_key_value_buff));
+            }
+
+            if (value) {
+                CMP_MESSAGE_INFO_CALL(message_info, add_params_data_item)(message_info, property->identifier, value);
+
+                if (value != property_key_value_buff) dm_lite_free(value);
+            }
+        }
+        dm_thing_manager->_ret = 0;
+
+        /* a specified identifier is unique, stop here. */
+        if (target_property_identifier) return 1;
+    }
+
+    return 0;
+}
+
+#ifdef DM_STATIC_THING_ENABLED
+/* id of the top level property identifier of a static thing, -1 when it has none. */
+static int get_static_property_id(thing_t** thing, const char* identifier)
+{
+    const dsl_template_t* dsl_template = &((dm_thing_t*)thing)->dsl_template;
+    const property_t* property;
+
+    property = (*thing)->get_property_by_identifier(thing, identifier);
+    if (property < dsl_template->properties || property >= dsl_template->properties + dsl_template->property_number) return -1;
+
+    return (int)(property - dsl_template->properties);
+}
+
+static void format_static_properties(dm_json_writer_t* writer, const dm_static_thing_t* bound, const unsigned char* ids)
+{
+    dm_json_writer_object_begin(writer);
+    bound->model->format_properties(bound->data, ids, writer);
+    dm_json_writer_object_end(writer);
+}
+
+/* caller holds send lock. property post params of a static thing, formatted by its model in place. */
+static int install_static_property_post(dm_thing_manager_t* self, message_info_t** message_info, thing_t** thing)
+{
+    dm_static_thing_t* bound = dm_thing_get_static(thing);
+    const property_t* properties = ((dm_thing_t*)thing)->dsl_template.properties;
+    const unsigned char* ids = NULL;
+    dm_json_writer_t writer;
+    char* params;
+    size_t len;
+    int id;
+
+    if (self->_property_identifier_post || self->_property_post_changed_only) {
+        memset(bound->post_ids, 0, DM_STATIC_THING_IDS_SIZE(bound->model->property_number));
+        if (self->_property_identifier_post) {
+            id = get_static_property_id(thing, self->_property_identifier_post);
+            if (id == -1) return -1;
+            DM_STATIC_THING_ID_SET(bound->post_ids, id);
+        } else {
+            for (id = 0; id < bound->model->property_number; ++id) {
+                if ((*thing)->is_property_posting(thing, properties + id)) DM_STATIC_THING_ID_SET(bound->post_ids, id);
+            }
+        }
+        ids = bound->post_ids;
+    }
+
+    dm_json_writer_init(&writer, NULL, 0);
+    format_static_properties(&writer, bound, ids);
+    len = dm_json_writer_length(&writer);
+
+    params = CMP_MESSAGE_INFO_CALL(message_info, reserve_params_data)(message_info, (int)len);
+    if (params == NULL) return -1;
+
+    dm_json_writer_init(&writer, params, len + 1);
+    format_static_properties(&writer, bound, ids);
+    self->_params_written = 1;
+
+    return 0;
+}
+#endif /* DM_STATIC_THING_ENABLED */
+
+static int handle_event_key_value(event_t* event, int index, void* ctx)
+{
+    key_value_ctx_t* key_value_ctx = ctx;
+    install_property_ctx_t install_ctx;
+    lite_property_t* lite_property;
+    dm_thing_manager_t* dm_thing_manager;
+    message_info_t** message_info;
+    thing_t** thing;
+    char method_buff[METHOD_MAX_LENGH] = {0};
+    char uri_buff[URI_MAX_LENGH] = {0};
+    char product_key[PRODUCT_KEY_MAXLEN] = {0};
+    char device_name[DEVICE_NAME_MAXLEN] = {0};
+
+    char* p;
+    int output_data_numb;
+    int i;
+
+    (void)index;
+    dm_thing_manager = key_value_ctx->dm_thing_manager;
+    message_info = key_value_ctx->message_info;
+    thing = key_value_ctx->thing;
+
+    assert(dm_thing_manager && message_info && *message_info && thing && *thing);
+
+    if (strcmp(event->identifier, dm_thing_manager->_identifier) != 0) return 0;
+
+    dm_thing_manager->_method = event->method;
+
+    clear_and_set_message_info(message_info, dm_thing_manager);
+
+    CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
+
+    strcpy(method_buff, event->method);
+    /* subtitute '.' by '/' */
+    do {
+        p = strchr(method_buff, '.');
+        if (p) *p = '/';
+    } while (p);
+
+    dm_thing_manager_install_product_key_device_name(dm_thing_manager,thing,product_key,device_name);
+
+    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s", product_key, device_name, method_buff);
+    CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, uri_buff);
+
+    if (strcmp(dm_thing_manager->_method, string_thing_event_property_post) != 0) {
+        output_data_numb = event->event_output_data_num;
+        for (i = 0; i < output_data_numb; ++i) {
+            lite_property = event->event_output_data + i;
+            assert(lite_property);
+            install_lite_property_to_message_info(dm_thing_manager, message_info, lite_property);
+        }
+        dm_thing_manager->_ret = 0;
+    } else {
+        /* a post of all properties covers changed ones too, so both are tracked until acked. */
+        if (dm_thing_manager->_property_identifier_post == NULL &&
+            (*thing)->start_property_post(thing, CMP_MESSAGE_INFO_CALL(message_info, get_id)(message_info)) == 0 &&
+            dm_thing_manager->_property_post_changed_only) {
+            dm_thing_manager->_property_post_skipped = 1;
+            return 1;
+        }
+#ifdef DM_STATIC_THING_ENABLED
+        if (dm_thing_get_static(thing)) {
+            dm_thing_manager->_ret = install_static_property_post(dm_thing_manager, message_info, thing);
+            return 1;
+        }
+#endif /* DM_STATIC_THING_ENABLED */
+        install_ctx.dm_thing_manager = dm_thing_manager;
+        install_ctx.thing = thing;
+        install_ctx.message_info = dm_thing_manager->_message_info;
+        install_ctx.target_property_identifier = dm_thing_manager->_property_identifier_post;
+        /* the values are read through pointers into the thing, sets of other threads wait till all are formatted. */
+        (*thing)->lock_property_values(thing);
+        property_visit(thing, install_property_to_message_info, &install_ctx);
+        (*thing)->unlock_property_values(thing);
+    }
+
+    return 1;
+}
+
+/* next string of the json array of identifiers from *pos, 0 at its end. an escaped one is no identifier, its length is 0. */
+static int next_property_get_identifier(const char* params, int params_length, int* pos, const char** identifier, int* identifier_length)
+{
+    int i = *pos;
+    int escaped = 0;
+    int start;
+
+    while (i < params_length && params[i] != '"' && params[i] != ']') ++i;
+    if (i >= params_length || params[i] == ']') return 0;
+
+    start = ++i;
+    while (i < params_length && params[i] != '"') {
+        if (params[i] == '\\') {
+            escaped = 1;
+            ++i;
+        }
+        ++i;
+    }
+    if (i >= params_length) return 0;
+
+    *identifier = params + start;
+    *identifier_length = escaped ? 0 : i - start;
+    *pos = i + 1;
+
+    return 1;
+}
+
+/* "identifier":value of a property, nothing when it has no value. */
+static void format_property_get_item(dm_json_writer_t* writer, install_property_ctx_t* install_ctx, property_t* property)
+{
+    lite_property_t* lite_property = (lite_property_t*)property;
+    dm_thing_manager_t* dm_thing_manager = install_ctx->dm_thing_manager;
+    thing_t** thing = install_ctx->thing;
+    const char* value;
+
+    if (lite_property->identifier == NULL) return;
+
+    if (lite_property->data_type.type == data_type_type_array) {
+        dm_json_writer_key(writer, lite_property->identifier, strlen(lite_property->identifier));
+        format_array_property_value(writer, lite_property);
+        return;
+    }
+
+    if (property->data_type.type == data_type_type_struct) {
+        install_ctx->property = property;
+        dm_json_writer_key(writer, lite_property->identifier, strlen(lite_property->identifier));
+        format_struct_property_value(writer, install_ctx);
+        return;
+    }
+
+    if ((*thing)->get_lite_property_value(thing, lite_property, NULL, &dm_thing_manager->_get_value_str) != 0) return;
+
+    value = dm_thing_manager->_get_value_str;
+    if (value == NULL) return;
+
+    dm_json_writer_key(writer, lite_property->identifier, strlen(lite_property->identifier));
+
+    if (lite_property->data_type.type == data_type_type_text || lite_property->data_type.type == data_type_type_date) {
+        dm_json_writer_string(writer, value, strlen(value));
+    } else {
+        dm_json_writer_raw(writer, value, strlen(value));
+    }
+}
+
+/* values of the properties asked for, each looked up in the identifier index of the thing. */
+static void format_property_get_params(dm_json_writer_t* writer, void* ctx)
+{
+    install_property_ctx_t* install_ctx = ctx;
+    dm_thing_manager_t* dm_thing_manager = install_ctx->dm_thing_manager;
+    thing_t** thing = install_ctx->thing;
+    const char* params = dm_thing_manager->_property_get_params;
+    int params_length = dm_thing_manager->_property_get_params_length;
+    char identifier[MAX_IDENTIFIER_LENGTH];
+    const char* requested;
+    int requested_length;
+    property_t* property;
+    int pos = 1;
+#ifdef DM_STATIC_THING_ENABLED
+    dm_static_thing_t* bound = dm_thing_get_static(thing);
+    int id;
+
+    if (bound) {
+        memset(bound->post_ids, 0, DM_STATIC_THING_IDS_SIZE(bound->model->property_number));
+        while (next_property_get_identifier(params, params_length, &pos, &requested, &requested_length)) {
+            if (requested_length == 0 || requested_length >= (int)sizeof(identifier)) continue;
+
+            memcpy(identifier, requested, requested_length);
+            identifier[requested_length] = '\0';
+
+            id = get_static_property_id(thing, identifier);
+            if (id != -1) DM_STATIC_THING_ID_SET(bound->post_ids, id);
+        }
+        format_static_properties(writer, bound, bound->post_ids);
+        return;
+    }
+#endif /* DM_STATIC_THING_ENABLED */
+
+    dm_json_writer_object_begin(writer);
+
+    while (next_property_get_identifier(params, params_length, &pos, &requested, &requested_length)) {
+        /* members of struct properties are not answered on their own. */
+        if (requested_length == 0 || requested_length >= (int)sizeof(identifier) ||
+            memchr(requested, DEFAULT_DSL_DELIMITER, requested_length)) continue;
+
+        memcpy(identifier, requested, requested_length);
+        identifier[requested_length] = '\0';
+
+        property = (*thing)->get_property_by_identifier(thing, identifier);
+        if (property) format_property_get_item(writer, install_ctx, property);
+    }
+
+    dm_json_writer_object_end(writer);
+}
+
+/* caller holds send lock. the reply data measured then written in place, serialize_to_payload_response keeps it. */
+static int install_property_get_to_message_info(dm_thing_manager_t* dm_thing_manager, message_info_t** message_info, thing_t** thing)
+{
+    install_property_ctx_t install_ctx;
+    dm_json_writer_t writer;
+    char* data;
+    size_t len;
+
+    install_ctx.dm_thing_manager = dm_thing_manager;
+    install_ctx.thing = thing;
+    install_ctx.message_info = message_info;
+    install_ctx.target_property_identifier = NULL;
+    install_ctx.property = NULL;
+
+    /* measured and written from the same values, as the property post is. */
+    (*thing)->lock_property_values(thing);
+    dm_json_writer_init(&writer, NULL, 0);
+    format_property_get_params(&writer, &install_ctx);
+    len = dm_json_writer_length(&writer);
+
+    data = CMP_MESSAGE_INFO_CALL(message_info, reserve_params_data)(message_info, (int)len);
+    if (data == NULL) {
+        (*thing)->unlock_property_values(thing);
+        return -1;
+    }
+
+    dm_json_writer_init(&writer, data, len + 1);
+    format_property_get_params(&writer, &install_ctx);
+    (*thing)->unlock_property_values(thing);
+
+    return 0;
+}
+
+static int handle_service_key_value(service_t* service, int index, void* ctx)
+{
+    key_value_ctx_t* key_value_ctx = ctx;
+    lite_property_t* lite_property;
+    dm_thing_manager_t* dm_thing_manager;
+    message_info_t** message_info;
+    thing_t** thing;
+    int output_data_numb;
+    char method_buff[METHOD_MAX_LENGH] = {0};
+    char uri_buff[URI_MAX_LENGH] = {0};
+    char product_key[PRODUCT_KEY_MAXLEN] = {0};
+    char device_name[DEVICE_NAME_MAXLEN] = {0};
+
+    char* p;
+    int i;
+
+    (void)index;
+    dm_thing_manager = key_value_ctx->dm_thing_manager;
+    message_info = key_value_ctx->message_info;
+    thing = key_value_ctx->thing;
+
+    assert(dm_thing_manager && message_info && *message_info && thing && *thing);
+
+    if (service && service->identifier && strcmp(service->identifier, dm_thing_manager->_identifier) != 0) return 0;
+
+    dm_thing_manager->_method = service->method;
+
+    clear_and_set_message_info(message_info, dm_thing_manager);
+
+    strcpy(method_buff, service->method);
+    /* subtitute '.' by '/' */
+    do {
+        p = strchr(method_buff, '.');
+        if (p) *p = '/';
+    } while (p);
+
+    dm_thing_manager_install_product_key_device_name(dm_thing_manager,thing,product_key,device_name);
+#ifdef RRPC_ENABLED
+    if (dm_thing_manager->_rrpc) {
+        dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/rrpc/response/%s", product_key, device_name, dm_thing_manager->_rrpc_message_id);
+    } else {
+        dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s_reply", product_key, device_name, method_buff);
+    }
+#else
+    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s_reply", product_key, device_name, method_buff);
+#endif /* RRPC_ENABLED */
+
+    CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, uri_buff);
+
+    CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_RESPONSE);
+    CMP_MESSAGE_INFO_CALL(message_info, set_id)(message_info, dm_thing_manager->_response_id);
+    CMP_MESSAGE_INFO_CALL(message_info, set_code)(message_info, dm_thing_manager->_code);
+
+    if (strcmp(dm_thing_manager->_method, string_thing_service_property_set) == 0) {
+        /* set property */
+    } else if (strcmp(dm_thing_manager->_method, string_thing_service_property_get) == 0) {
+        /* get property */
+        if (dm_thing_manager->_property_get_params) install_property_get_to_message_info(dm_thing_manager, message_info, thing);
+    } else {
+        /* normal service */
+        output_data_numb = service->service_output_data_num;
+        for (i = 0; i < output_data_numb; ++i) {
+            lite_property = service->service_output_data + i;
+            assert(lite_property);
+            install_lite_property_to_message_info(dm_thing_manager, message_info, lite_property);
+        }
+    }
+
+    return 1;
+}
+
+static int get_event_key_value(void* _thing, void* ctx)
+{
+    thing_t** thing = _thing;
+    dm_thing_manager_t* dm_thing_manager;
+    key_value_ctx_t key_value_ctx;
+
+    dm_thing_manager = ctx;
+
+    assert(dm_thing_manager && thing && *thing);
+
+    if (dm_thing_manager->_thing_id == thing) {
+        key_value_ctx.dm_thing_manager = dm_thing_manager;
+        key_value_ctx.message_info = dm_thing_manager->_message_info;
+        key_value_ctx.thing = thing;
+        event_visit(thing, handle_event_key_value, &key_value_ctx);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int get_service_key_value(void* _thing, void* ctx)
+{
+    thing_t** thing = _thing;
+    dm_thing_manager_t* dm_thing_manager;
+    key_value_ctx_t key_value_ctx;
+
+    dm_thing_manager = ctx;
+
+    assert(dm_thing_manager && thing && *thing);
+
+    if (dm_thing_manager->_thing_id == thing) {
+        key_value_ctx.dm_thing_manager = dm_thing_manager;
+        key_value_ctx.message_info = dm_thing_manager->_message_info;
+        key_value_ctx.thing = thing;
+        service_visit(thing, handle_service_key_value, &key_value_ctx);
+        return 1;
+    }
+
+    return 0;
+}
+
+static const dm_thing_manager_event_template_t* find_event_template(const dm_thing_manager_t* dm_thing_manager, const void* thing_id,
+                                                                     const char* event_identifier)
+{
+    const dm_thing_manager_local_thing_t* local_thing;
+    int i;
+
+    local_thing = find_local_thing(dm_thing_manager, thing_id);
+    if (local_thing == NULL) return NULL;
+
+    for (i = 0; i < local_thing->event_template_number; ++i) {
+        if (strcmp(local_thing->event_templates[i].event->identifier, event_identifier) == 0) return local_thing->event_templates + i;
+    }
+
+    return NULL;
+}
+
+typedef struct {
+    dm_thing_manager_t*                      dm_thing_manager;
+    thing_t**                                thing;
+    const dm_thing_manager_event_template_t* template;
+} format_event_template_ctx_t;
+
+/* params of the event, the values of its outputData between the keys of the template, as install_lite_property_to_message_info has them. */
+static void format_event_template_params(dm_json_writer_t* writer, void* ctx)
+{
+    format_event_template_ctx_t* template_ctx = ctx;
+    dm_thing_manager_t* dm_thing_manager = template_ctx->dm_thing_manager;
+    thing_t** thing = template_ctx->thing;
+    const dm_thing_manager_event_template_t* template = template_ctx->template;
+    lite_property_t* lite_property;
+    const char* value;
+    size_t i, start, key_len;
+
+    dm_json_writer_object_begin(writer);
+
+    for (i = 0, start = 0; i < template->event->event_output_data_num; start = template->key_ends[i++]) {
+        lite_property = template->event->event_output_data + i;
+        key_len = template->key_ends[i] - start;
+        if (key_len == 0) continue;
+
+        if (lite_property->data_type.type == data_type_type_array) {
+            dm_json_writer_key_raw(writer, template->keys + start, key_len);
+            format_array_property_value(writer, lite_property);
+            continue;
+        }
+
+        if ((*thing)->get_lite_property_value(thing, lite_property, NULL, &dm_thing_manager->_get_value_str) != 0) continue;
+
+        value = dm_thing_manager->_get_value_str;
+        if (value == NULL) continue;
+
+        dm_json_writer_key_raw(writer, template->keys + start, key_len);
+
+        if (lite_property->data_type.type == data_type_type_text || lite_property->data_type.type == data_type_type_date) {
+            dm_json_writer_string(writer, value, strlen(value));
+        } else {
+            dm_json_writer_raw(writer, value, strlen(value));
+        }
+    }
+
+    dm_json_writer_object_end(writer);
+}
+
+/* caller holds send lock. the request of the event filled from its template, params measured then written in place. */
+static int install_event_template_to_message_info(dm_thing_manager_t* self, const dm_thing_manager_event_template_t* template)
+{
+    message_info_t** message_info = self->_message_info;
+    format_event_template_ctx_t template_ctx;
+    dm_json_writer_t writer;
+    char* params;
+    size_t len;
+
+    self->_method = template->event->method;
+
+    clear_and_set_message_info(message_info, self);
+
+    CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
+    if (CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, template->uri) == -1) return -1;
+
+    LITE_TRACE(LITE_TRACE_SERIALIZE, CMP_MESSAGE_INFO_CALL(message_info, get_id)(message_info));
+
+    template_ctx.dm_thing_manager = self;
+    template_ctx.thing = self->_thing_id;
+    template_ctx.template = template;
+
+    dm_json_writer_init(&writer, NULL, 0);
+    format_event_template_params(&writer, &template_ctx);
+    len = dm_json_writer_length(&writer);
+
+    params = CMP_MESSAGE_INFO_CALL(message_info, reserve_params_data)(message_info, (int)len);
+    if (params == NULL) return -1;
+
+    dm_json_writer_init(&writer, params, len + 1);
+    format_event_template_params(&writer, &template_ctx);
+
+    return 0;
+}
+
+/* caller holds send lock. */
+#ifdef DM_OFFLINE_ENABLED
+/* history post params of a replay at most, a record takes its identifier and some 60 bytes. */
+#ifndef DM_OFFLINE_HISTORY_POST_LEN
+#define DM_OFFLINE_HISTORY_POST_LEN 2048
+#endif
+
+typedef struct {
+    dm_offline_t*       offline;
+    thing_t**           thing;
+    const char*         target_property_identifier;
+    int                 changed_only;
+    dm_offline_record_t record;
+} offline_keep_ctx_t;
+
+static int is_offline_property_scaled(const property_t* property)
+{
+    return property->data_type.type == data_type_type_float || property->data_type.type == data_type_type_double;
+}
+
+/* value of a numeric property as kept offline, -1 for other types. */
+static int get_offline_property_value(const property_t* property, int64_t* value)
+{
+    const data_type_x_t* data_type_x = &property->data_type.value;
+    double scaled;
+    int decimals;
+
+    switch (property->data_type.type) {
+    case data_type_type_int:
+        *value = data_type_x->data_type_int_t.value;
+        return 0;
+    case data_type_type_enum:
+        *value = data_type_x->data_type_enum_t.value;
+        return 0;
+    case data_type_type_bool:
+        *value = data_type_x->data_type_bool_t.value;
+        return 0;
+    case data_type_type_date:
+        *value = (int64_t)data_type_x->data_type_date_t.value;
+        return 0;
+    case data_type_type_float:
+        scaled = data_type_x->data_type_float_t.value;
+        break;
+    case data_type_type_double:
+        scaled = data_type_x->data_type_double_t.value;
+        break;
+    default:
+        return -1;
+    }
+
+    for (decimals = 0; decimals < CONFIG_DM_OFFLINE_DECIMALS; ++decimals) scaled *= 10;
+    if (!(scaled > -9.2e18 && scaled < 9.2e18)) return -1;
+
+    *value = (int64_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+
+    return 0;
+}
+
+/* caller holds send lock. local thing of the device itself, the one kept offline. */
+static thing_t** get_offline_thing(const dm_thing_manager_t* self)
+{
+    dm_thing_manager_local_thing_t* local_thing;
+
+    local_thing = find_local_thing_via_product_key_and_device_name(self, self->_product_key, self->_device_name);
+
+    return local_thing ? local_thing->thing : NULL;
+}
+
+/* caller holds send lock. store for the properties of thing, taken up again for a changed thing model. */
+static dm_offline_t* get_offline(dm_thing_manager_t* self, thing_t** thing)
+{
+    int property_number = (*thing)->get_property_number(thing);
+
+    if (self->_offline && ((dm_offline_t*)self->_offline)->property_number == property_number) return self->_offline;
+
+    /* the records would take the memory left, only kv keeps them then. */
+    if (self->_offline == NULL && !CONFIG_DM_OFFLINE_KV && LITE_mem_pressure_level() >= LITE_MEM_PRESSURE_CRITICAL) return NULL;
+
+    if (self->_offline) {
+        dm_offline_deinit(self->_offline);
+    } else {
+        self->_offline = dm_lite_calloc(1, sizeof(dm_offline_t));
+        if (self->_offline == NULL) return NULL;
+    }
+
+    if (dm_offline_init(self->_offline, property_number) != 0) {
+        dm_log_err("offline store of %d properties not ready", property_number);
+        dm_lite_free(self->_offline);
+        self->_offline = NULL;
+    }
+
+    return self->_offline;
+}
+
+static int keep_offline_property(property_t* property, int index, void* ctx)
+{
+    offline_keep_ctx_t* keep_ctx = ctx;
+    int64_t last;
+
+    if (keep_ctx->target_property_identifier) {
+        if (property->identifier == NULL || strcmp(property->identifier, keep_ctx->target_property_identifier) != 0) return 0;
+    } else if (keep_ctx->changed_only && (*keep_ctx->thing)->is_property_posting(keep_ctx->thing, property) == 0) {
+        return 0;
+    }
+
+    if (get_offline_property_value(property, &keep_ctx->record.value) == 0) {
+        keep_ctx->record.index = index;
+
+        /* a property not acked goes with each changed only post, its value is kept once. */
+        if (!keep_ctx->changed_only || dm_offline_last(keep_ctx->offline, index, &last) != 0 || last != keep_ctx->record.value) {
+            dm_offline_append(keep_ctx->offline, &keep_ctx->record);
+        }
+    }
+
+    /* a specified identifier is unique, stop here. */
+    return keep_ctx->target_property_identifier ? 1 : 0;
+}
+
+/* caller holds send lock. numeric values of a property post of the device failed are kept for the history post. */
+static void keep_offline_property_post(dm_thing_manager_t* self, const void* thing_id, const char* property_identifier, int changed_only)
+{
+    offline_keep_ctx_t keep_ctx;
+
+    keep_ctx.thing = get_offline_thing(self);
+    if (keep_ctx.thing == NULL || (const void*)keep_ctx.thing != thing_id) return;
+#ifdef DM_STATIC_THING_ENABLED
+    /* its values are in the struct of its model, not kept. */
+    if (dm_thing_get_static(keep_ctx.thing)) return;
+#endif /* DM_STATIC_THING_ENABLED */
+
+    keep_ctx.offline = get_offline(self, keep_ctx.thing);
+    if (keep_ctx.offline == NULL) return;
+
+    keep_ctx.target_property_identifier = property_identifier;
+    keep_ctx.changed_only = changed_only;
+    keep_ctx.record.time_ms = utils_epoch_time_now();
+    keep_ctx.record.epoch = keep_ctx.record.time_ms != 0;
+    if (!keep_ctx.record.epoch) keep_ctx.record.time_ms = HAL_UptimeMs();
+
+    property_visit(keep_ctx.thing, keep_offline_property, &keep_ctx);
+}
+#endif /* DM_OFFLINE_ENABLED */
+
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+/* class of the uplink of event_identifier, from the type of the event in the tsl. */
+static int get_uplink_priority(thing_t** thing, const char* event_identifier, const dm_thing_manager_event_template_t* template)
+{
+    const event_t* event;
+
+    if (strcmp(event_identifier, string_event_property_post_identifier) == 0) return dm_uplink_priority_normal;
+
+    event = template ? template->event : (*thing)->get_event_by_identifier(thing, event_identifier);
+    if (event == NULL) return dm_uplink_priority_normal;
+
+    if (event->event_type == event_type_error) return dm_uplink_priority_error;
+
+    return event->event_type == event_type_alert ? dm_uplink_priority_alert : dm_uplink_priority_normal;
+}
+
+static char* copy_uplink_string(const char* src, int len)
+{
+    char* dst = dm_lite_malloc(len + 1);
+
+    if (dst == NULL) return NULL;
+
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+
+    return dst;
+}
+
+static void free_uplink_pending(dm_uplink_pending_t* pending)
+{
+    if (pending->method) dm_lite_free(pending->method);
+    if (pending->uri) dm_lite_free(pending->uri);
+    if (pending->params) dm_lite_free(pending->params);
+
+    memset(pending, 0, sizeof(dm_uplink_pending_t));
+}
+
+/* request in message_info copied, to be kept if it is not sent. 0 when copied. */
+static int copy_uplink_pending(dm_uplink_pending_t* pending, message_info_t** message_info, const void* thing_id, int priority)
+{
+    const char* method = CMP_MESSAGE_INFO_CALL(message_info, get_method)(message_info);
+    const char* uri = CMP_MESSAGE_INFO_CALL(message_info, get_uri)(message_info);
+#ifdef MEMORY_NO_COPY
+    const char* params = CMP_MESSAGE_INFO_CALL(message_info, get_params_data)(message_info, 0);
+#else
+    const char* params = CMP_MESSAGE_INFO_CALL(message_info, get_params_data)(message_info);
+#endif
+
+    memset(pending, 0, sizeof(dm_uplink_pending_t));
+
+    /* a cbor request goes as raw data, it is not kept. */
+    if (CMP_MESSAGE_INFO_CALL(message_info, get_message_type)(message_info) != CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST ||
+        method == NULL || uri == NULL || params == NULL) return -1;
+
+    pending->thing_id = (void*)thing_id;
+    pending->priority = priority;
+    pending->method = copy_uplink_string(method, strlen(method));
+    pending->uri = copy_uplink_string(uri, strlen(uri));
+    pending->params = copy_uplink_string(params, CMP_MESSAGE_INFO_CALL(message_info, get_params_data_length)(message_info));
+
+    if (pending->method && pending->uri && pending->params) return 0;
+
+    free_uplink_pending(pending);
+
+    return -1;
+}
+
+/* caller holds send lock. pending is taken in after the ones of its class, when full the oldest of the lowest class goes. */
+static void keep_uplink_pending(dm_thing_manager_t* self, dm_uplink_pending_t* pending)
+{
+    dm_uplink_pending_t* queue = self->_uplink_pending;
+    int lowest;
+    int index;
+
+    if (self->_uplink_pending_number == CONFIG_DM_UPLINK_PRIORITY_PENDING) {
+        lowest = queue[self->_uplink_pending_number - 1].priority;
+        if (pending->priority < lowest) {
+            dm_log_warning("%s not kept, %d of higher priority waiting", pending->method, self->_uplink_pending_number);
+            free_uplink_pending(pending);
+            return;
+        }
+
+        for (index = 0; queue[index].priority != lowest; ++index);
+        dm_log_warning("%s kept dropped for %s", queue[index].method, pending->method);
+        free_uplink_pending(queue + index);
+        memmove(queue + index, queue + index + 1, (self->_uplink_pending_number - index - 1) * sizeof(dm_uplink_pending_t));
+        self->_uplink_pending_number--;
+    }
+
+    for (index = self->_uplink_pending_number; index > 0 && queue[index - 1].priority < pending->priority; --index) {
+        queue[index] = queue[index - 1];
+    }
+    queue[index] = *pending;
+    self->_uplink_pending_number++;
+
+    dm_log_debug("%s kept, %d waiting for the cloud", pending->method, self->_uplink_pending_number);
+}
+
+/* caller holds send lock. the events kept go in priority order while connected, 0 once none is left. */
+static int send_uplink_pending(dm_thing_manager_t* self)
+{
+    message_info_t** message_info = self->_message_info;
+    cmp_abstract_t** cmp = self->_cmp;
+    dm_uplink_pending_t* pending = self->_uplink_pending;
+
+    while (self->_uplink_pending_number > 0 && self->_cloud_connected) {
+        /* one of a thing removed since goes. */
+        if (find_local_thing(self, pending->thing_id)) {
+            self->_thing_id = pending->thing_id;
+            self->_method = pending->method;
+
+            clear_and_set_message_info(message_info, self);
+
+            CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
+            CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, pending->uri);
+            CMP_MESSAGE_INFO_CALL(message_info, set_params_data)(message_info, pending->params);
+
+            if ((*cmp)->send(cmp, message_info, NULL) == -1) return -1;
+
+            dm_log_debug("%s kept sent", pending->method);
+        }
+
+        free_uplink_pending(pending);
+        self->_uplink_pending_number--;
+        memmove(pending, pending + 1, self->_uplink_pending_number * sizeof(dm_uplink_pending_t));
+    }
+
+    return self->_uplink_pending_number > 0 ? -1 : 0;
+}
+
+/* the events kept are tried each retry interval while connected, 1 while some are left. */
+static int send_uplink_pending_if_due(dm_thing_manager_t* self)
+{
+    uint64_t now;
+    int ret;
+
+    send_lock(self);
+    now = HAL_UptimeMs();
+    if (self->_uplink_pending_number > 0 && self->_cloud_connected &&
+        now - self->_uplink_pending_retry_ms >= CONFIG_DM_UPLINK_PRIORITY_RETRY_INTERVAL) {
+        self->_uplink_pending_retry_ms = now;
+        send_uplink_pending(self);
+    }
+    ret = self->_uplink_pending_number > 0;
+    send_unlock(self);
+
+    return ret;
+}
+
+/* caller holds send lock. uplinks of lower classes sent from yield wait while events are kept. */
+#define uplink_pending_held(self) ((self)->_uplink_pending_number > 0)
+#else
+#define uplink_pending_held(self) 0
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+
+static int trigger_event(dm_thing_manager_t* self, const void* thing_id, const void* event_identifier, const char* property_identifier,
+                         int property_post_changed_only)
+{
+    message_info_t** message_info = self->_message_info;
+    cmp_abstract_t** cmp = self->_cmp;
+    const dm_thing_manager_event_template_t* template;
+    int payload_format;
+    int ret;
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+    dm_uplink_pending_t pending;
+    int priority;
+    int kept = 0;
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+
+    assert(thing_id && event_identifier && cmp && *cmp);
+
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+    /* the events kept go before this one. */
+    if (self->_uplink_pending_number > 0) send_uplink_pending(self);
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+
+    self->_thing_id = (void*)thing_id;
+    self->_identifier = (void*)event_identifier;
+    self->_property_identifier_post = (void*)property_identifier;
+    self->_property_post_changed_only = property_post_changed_only;
+    self->_property_post_skipped = 0;
+    self->_params_written = 0;
+    self->_ret = -1;
+    self->_get_value_str = NULL;
 
-        dm_thing->_arr_index = -1;
+    /* reply of a cbor post is raw data, so an async post goes as json for its reply to be matched. */
+    payload_format = self->_reply_handler ? dm_payload_format_json : self->_payload_format;
+    /* a cbor request is encoded from the params items, only json ones are filled from the template. */
+    template = payload_format == dm_payload_format_json ? find_event_template(self, thing_id, event_identifier) : NULL;
 
-        (*message_info)->add_params_data_item(message_info, lite_property->identifier, property_key_value_buff);
+    if (template) {
+        self->_ret = install_event_template_to_message_info(self, template);
+    } else {
+        local_thing_visit(self, get_event_key_value);
+    }
 
+    if (self->_property_post_skipped) {
+        dm_log_debug("no property changed since last post");
         return 0;
     }
 
-    if (ret == 0 && lite_property->identifier && dm_thing_manager->_get_value_str) {
-        (*message_info)->add_params_data_item(message_info, lite_property->identifier, dm_thing_manager->_get_value_str);
+    if(-1 != self->_ret) {
+        dm_log_debug("event(%s) triggered, method(%s)", self->_identifier, self->_method);
+        /* params written in place go as json. */
+        if (template == NULL && !self->_params_written) {
+            CMP_MESSAGE_INFO_CALL(message_info, set_payload_format)(message_info, payload_format);
+            ret = CMP_MESSAGE_INFO_CALL(message_info, serialize_to_payload_request)(message_info);
+            if (ret == -1) {
+                dm_log_err("serialize_to_payload_request FAIL");
+                return ret;
+            }
+        }
+
+        if (self->_reply_handler) {
+            self->_request_id = CMP_MESSAGE_INFO_CALL(message_info, get_id)(message_info);
+            if (add_request(self, self->_request_id) == -1) {
+                dm_log_err("request(%d) can not wait for reply", self->_request_id);
+                CMP_MESSAGE_INFO_CALL(message_info, clear)(message_info);
+                return -1;
+            }
+        }
+
+        if (strcmp(self->_identifier, string_event_property_post_identifier) == 0) LITE_STARTUP_BEGIN(LITE_STARTUP_FIRST_POST);
+
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+        /* an async one is not kept, its handler is told it failed. */
+        priority = self->_reply_handler ? dm_uplink_priority_normal : get_uplink_priority((thing_t**)thing_id, event_identifier, template);
+        if (priority != dm_uplink_priority_normal) kept = copy_uplink_pending(&pending, message_info, thing_id, priority) == 0;
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+
+        self->_ret = (*cmp)->send(cmp, message_info, NULL);
+
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+        if (kept && self->_ret == -1) {
+            keep_uplink_pending(self, &pending);
+        } else if (kept) {
+            free_uplink_pending(&pending);
+        }
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+
+        if (self->_reply_handler && self->_ret == -1) {
+            dm_request_t request;
+
+            take_request(self, self->_request_id, &request);
+        }
+#ifdef DM_OFFLINE_ENABLED
+        if (self->_ret == -1 && strcmp(self->_identifier, string_event_property_post_identifier) == 0) {
+            keep_offline_property_post(self, thing_id, property_identifier, property_post_changed_only);
+        }
+#endif /* DM_OFFLINE_ENABLED */
     }
 
-    if (p) dm_lite_free(p);
+    return self->_ret;
+}
+
+#ifdef DM_BACKPRESSURE_ENABLED
+/* caller holds send lock. 1 when the connection is up but takes no more routine posts without waiting. */
+static int send_saturated(dm_thing_manager_t* self)
+{
+    cmp_abstract_t** cmp = self->_cmp;
+    cmp_send_budget_t budget;
 
-    return ret;
+    /* a post while disconnected fails as it did, it is what the offline store keeps. */
+    if ((*cmp)->get_send_budget(cmp, &budget) != 0 || !budget.connected) return 0;
+
+    return budget.pub_slots < CONFIG_DM_BACKPRESSURE_MIN_SLOTS || budget.pub_bytes > CONFIG_DM_BACKPRESSURE_MAX_BYTES ||
+           budget.write_ms >= CONFIG_DM_BACKPRESSURE_WRITE_MS;
 }
 
-static void get_product_key_device_name(char* _product_key, char* _device_name, void* _thing, void* _dm_thing_manager)
+/* caller holds send lock. DM_SEND_WOULD_BLOCK with send_writable due when saturated, 0 to send. */
+static int check_send_budget(dm_thing_manager_t* self)
 {
-    char* product_key = _product_key;
-    char* device_name = _device_name;
+    if (!send_saturated(self)) return 0;
 
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager = _dm_thing_manager;
-    if (thing && *thing) {
-        dm_thing_manager_install_product_key_device_name(dm_thing_manager, thing, product_key, device_name);
-    } else {
-        strcpy(product_key, dm_thing_manager->_product_key);
-        strcpy(device_name, dm_thing_manager->_device_name);
+    self->_send_blocked = 1;
+
+    return DM_SEND_WOULD_BLOCK;
+}
+
+/* send_writable once posts refused can go through. */
+static void notify_writable_if_due(dm_thing_manager_t* self)
+{
+    dm_thing_manager_message_t message = {0};
+    int writable;
+
+    send_lock(self);
+    writable = self->_send_blocked && !send_saturated(self);
+    if (writable) self->_send_blocked = 0;
+    send_unlock(self);
+
+    if (writable) invoke_callback_list(self, &message, dm_callback_type_send_writable);
+}
+
+#define property_post_interval_ms(self) ((uint64_t)(self)->_property_post_min_interval_ms * (self)->_property_post_backoff)
+#else
+#define property_post_interval_ms(self) ((uint64_t)(self)->_property_post_min_interval_ms)
+#endif /* DM_BACKPRESSURE_ENABLED */
+
+/* caller holds send lock. */
+static int property_post_late(const dm_thing_manager_t* self, const dm_thing_manager_local_thing_t* local_thing, uint64_t now)
+{
+    return self->_property_post_max_latency_ms > 0 &&
+           now - local_thing->property_post_pending_ms >= (uint64_t)self->_property_post_max_latency_ms;
+}
+
+/* caller holds send lock. */
+static int property_post_due(const dm_thing_manager_t* self, const dm_thing_manager_local_thing_t* local_thing, uint64_t now)
+{
+    if (now - local_thing->property_post_last_ms >= property_post_interval_ms(self)) return 1;
+
+    return property_post_late(self, local_thing, now);
+}
+
+/* caller holds send lock. a pending post goes as changed only post, so it carries the latest values of all properties requested. */
+static int flush_local_thing_property_post(dm_thing_manager_t* self, dm_thing_manager_local_thing_t* local_thing, uint64_t now, int force)
+{
+    int ret;
+
+    if (!local_thing->property_post_pending || (!force && !property_post_due(self, local_thing, now))) return 0;
+
+#ifdef DM_BACKPRESSURE_ENABLED
+    /* a saturated connection stretches the interval up to the max latency, each post through shortens it again. */
+    if (!force && !property_post_late(self, local_thing, now) && send_saturated(self)) {
+        self->_property_post_backoff = self->_property_post_backoff * 2 > CONFIG_DM_BACKPRESSURE_MAX_BACKOFF ?
+                                       CONFIG_DM_BACKPRESSURE_MAX_BACKOFF : self->_property_post_backoff * 2;
+        local_thing->property_post_last_ms = now;
+        dm_log_debug("connection saturated, property posts %d min intervals apart", self->_property_post_backoff);
+        return 0;
     }
+    if (self->_property_post_backoff > 1) self->_property_post_backoff /= 2;
+#endif /* DM_BACKPRESSURE_ENABLED */
+
+    ret = trigger_event(self, local_thing->thing, string_event_property_post_identifier, NULL, 1);
+
+    /* a post failed is tried again when due, the properties stay tracked. */
+    local_thing->property_post_last_ms = now;
+    if (ret != -1) local_thing->property_post_pending = 0;
+
+    return ret;
 }
 
-static void clear_and_set_message_info(message_info_t** _message_info, dm_thing_manager_t* _dm_thing_manager)
+/* caller holds send lock. request marks property_identifier, all properties if NULL, for the post, otherwise only properties set go. */
+static int schedule_property_post(dm_thing_manager_t* self, const void* thing_id, const char* property_identifier, int request)
 {
-    dm_thing_manager_t* dm_thing_manager = _dm_thing_manager;
-    message_info_t** message_info = _message_info;
+    dm_thing_manager_local_thing_t* local_thing;
     thing_t** thing;
+    void* property = NULL;
+    uint64_t now;
 
-    char product_key[PRODUCT_KEY_MAXLEN] = {0};
-    char device_name[DEVICE_NAME_MAXLEN] = {0};
+    local_thing = find_local_thing(self, thing_id);
+    if (local_thing == NULL) return -1;
 
-    assert(message_info && *message_info && dm_thing_manager);
+    thing = local_thing->thing;
 
-    if (message_info == NULL || *message_info == NULL || dm_thing_manager == NULL) return;
+    if (property_identifier) {
+        property = (*thing)->get_property_by_identifier(thing, property_identifier);
+        if (property == NULL) {
+            dm_log_err("property(%s) not found", property_identifier);
+            return -1;
+        }
+    }
 
-    thing = dm_thing_manager->_thing_id;
+    if (request) (*thing)->request_property_post(thing, property);
 
-    get_product_key_device_name(product_key, device_name, thing, dm_thing_manager);
-    if (0 == dm_thing_manager->_id) dm_thing_manager->_id++;
+    now = HAL_UptimeMs();
 
-    (*message_info)->clear(message_info);
+    if (!local_thing->property_post_pending) {
+        local_thing->property_post_pending = 1;
+        local_thing->property_post_pending_ms = now;
+    }
 
-    (*message_info)->set_product_key(message_info, product_key);
-    (*message_info)->set_device_name(message_info, device_name);
-    (*message_info)->set_version(message_info, dm_thing_manager->_dm_version);
-    (*message_info)->set_id(message_info, dm_thing_manager->_id);
-    dm_thing_manager->_id = (dm_thing_manager->_id + 1) % INT32_MAX;
-    (*message_info)->set_method(message_info, dm_thing_manager->_method);
+    return flush_local_thing_property_post(self, local_thing, now, 0);
 }
 
-static void install_property_to_message_info(void* _item, int index, va_list* params)
+static int dm_thing_manager_trigger_event(void* _self, const void* thing_id, const void* event_identifier, const char* property_identifier)
 {
-    property_t* property = _item;
-    lite_property_t* lite_property;
-    lite_property_t* struct_lite_property;
-    dm_thing_manager_t* dm_thing_manager;
-    thing_t** thing;
-    message_info_t** message_info;
-    size_t params_buffer_len = 0;
-    size_t params_val_len = 0;
-    char* target_property_identifier;
-    int ret, i;
-    char property_key_value_buff[PROPERTY_KEY_VALUE_BUFF_MAX_LENGTH] = {0};
-    char* p;
-    char* q = NULL;
+    dm_thing_manager_t* self = _self;
+    int ret;
 
-    dm_thing_manager = va_arg(*params, dm_thing_manager_t*);
-    thing = va_arg(*params, thing_t**);
-    message_info = va_arg(*params, message_info_t**);
-    target_property_identifier = va_arg(*params, char*);
+    send_lock(self);
+    if (self->_property_post_min_interval_ms > 0 && strcmp(event_identifier, string_event_property_post_identifier) == 0) {
+        ret = schedule_property_post(self, thing_id, property_identifier, 1);
+#ifdef DM_BACKPRESSURE_ENABLED
+    } else if (strcmp(event_identifier, string_event_property_post_identifier) == 0 && check_send_budget(self) != 0) {
+        ret = DM_SEND_WOULD_BLOCK;
+#endif /* DM_BACKPRESSURE_ENABLED */
+    } else {
+        ret = trigger_event(self, thing_id, event_identifier, property_identifier, 0);
+    }
+    send_unlock(self);
 
-    index = index;
+    return ret;
+}
 
-    assert(property && dm_thing_manager && thing && *thing && message_info && *message_info);
+static int dm_thing_manager_trigger_event_async(void* _self, const void* thing_id, const void* event_identifier, const char* property_identifier,
+                                                int timeout_ms, dm_reply_handler_fp_t handler, void* ctx)
+{
+    dm_thing_manager_t* self = _self;
+    int ret;
 
-    lite_property = (lite_property_t*)property;
+    if (thing_id == NULL || event_identifier == NULL || handler == NULL || timeout_ms < 0) return -1;
 
-    /* post all value, or specify identifier. */
-    if (property && (target_property_identifier == NULL || (property->identifier && strcmp(property->identifier, target_property_identifier) == 0))) {
-        ret = install_lite_property_to_message_info(dm_thing_manager, message_info, lite_property);
+    send_lock(self);
+    self->_reply_handler = handler;
+    self->_reply_ctx = ctx;
+    self->_reply_timeout_ms = timeout_ms;
+    ret = trigger_event(self, thing_id, event_identifier, property_identifier, 0);
+    if (ret != -1) ret = self->_request_id;
+    self->_reply_handler = NULL;
+    self->_reply_ctx = NULL;
+    send_unlock(self);
 
-        params_buffer_len = sizeof(property_key_value_buff);
-        if (ret == -1) {
-            if(property->data_type.type == data_type_type_struct) {
-                property_key_value_buff[0] = '{';
-                property_key_value_buff[1] = '\0';
-                for (i = 0; i < property->data_type.data_type_specs_number; ++i) {
-                    struct_lite_property = (lite_property_t*)property->data_type.specs + i;
-                    ret = (*thing)->get_lite_property_value(thing, struct_lite_property, NULL, &dm_thing_manager->_get_value_str);
-                    if (ret == 0 && dm_thing_manager->_get_value_str) {
-                        params_val_len = strlen(property_key_value_buff);
-                        p = property_key_value_buff + params_val_len - 1;
-
-                        /* not the last item, chang from '}' to ','. */
-                        if (p && *p == '}') *p = ',';
-
-                        if (struct_lite_property->data_type.type == data_type_type_text && dm_thing_manager->_get_value_str) {
-                            q = dm_lite_calloc(1, strlen(dm_thing_manager->_get_value_str) + 3);
-                            assert(q);
-
-                            dm_snprintf(q, strlen(dm_thing_manager->_get_value_str) + 3, "\"%s\"", dm_thing_manager->_get_value_str);
-                            dm_thing_manager->_get_value_str = q;
-                        }
-
-                        dm_snprintf(property_key_value_buff + params_val_len, params_buffer_len - params_val_len, "\"%s\":%s}",
-                                   struct_lite_property->identifier, dm_thing_manager->_get_value_str);
-
-                        if (q) dm_lite_free(q);
-                    }
-                }
+    return ret;
+}
 
-            }
-            (*message_info)->add_params_data_item(message_info, property->identifier, property_key_value_buff);
-        }
-        dm_thing_manager->_ret = 0;
+static int dm_thing_manager_cancel_request(void* _self, int request_id)
+{
+    dm_thing_manager_t* self = _self;
+    dm_request_t request;
+
+    return take_request(self, request_id, &request);
+}
+
+static int dm_thing_manager_trigger_changed_property_post(void* _self, const void* thing_id)
+{
+    dm_thing_manager_t* self = _self;
+    int ret;
+
+    assert(thing_id);
+
+    send_lock(self);
+    if (self->_property_post_min_interval_ms > 0) {
+        ret = schedule_property_post(self, thing_id, NULL, 0);
+#ifdef DM_BACKPRESSURE_ENABLED
+    } else if (check_send_budget(self) != 0) {
+        ret = DM_SEND_WOULD_BLOCK;
+#endif /* DM_BACKPRESSURE_ENABLED */
+    } else {
+        ret = trigger_event(self, thing_id, string_event_property_post_identifier, NULL, 1);
     }
+    send_unlock(self);
+
+    return ret;
 }
 
-static void handle_event_key_value(void* _item, int index, va_list* params)
+/* caller holds send lock. */
+static int post_metrics(dm_thing_manager_t* self)
 {
-    event_t* event;
-    lite_property_t* lite_property;
-    dm_thing_manager_t* dm_thing_manager;
-    message_info_t** message_info;
-    thing_t** thing;
+    message_info_t** message_info = self->_message_info;
+    cmp_abstract_t** cmp = self->_cmp;
+
     char method_buff[METHOD_MAX_LENGH] = {0};
     char uri_buff[URI_MAX_LENGH] = {0};
-    char product_key[PRODUCT_KEY_MAXLEN] = {0};
-    char device_name[DEVICE_NAME_MAXLEN] = {0};
 
+    char* params;
     char* p;
-    int output_data_numb;
-    int i;
+    int len;
 
-    (void)index;
-    dm_thing_manager = va_arg(*params, void*);
-    message_info = va_arg(*params, message_info_t**);
-    thing = va_arg(*params, thing_t**);
+    assert(cmp && *cmp && message_info && *message_info);
 
-    assert(dm_thing_manager && message_info && *message_info && (*message_info)->set_message_type && thing && *thing);
+    len = LITE_metrics_format(NULL, 0) + 1;
+    params = dm_lite_malloc(len);
+    if (params == NULL) return -1;
+    LITE_metrics_format(params, len);
 
-    event = _item;
-    if (strcmp(event->identifier, dm_thing_manager->_identifier) != 0) return;
+    /* metrics are of the device, not of a thing. */
+    self->_thing_id = NULL;
 
-    dm_thing_manager->_method = event->method;
+    strcpy(method_buff, string_method_name_sdk_metrics_post);
+    /* subtitute '/' by '.' */
+    do {
+        p = strchr(method_buff, '/');
+        if (p) *p = '.';
+    } while (p);
 
-    clear_and_set_message_info(message_info, dm_thing_manager);
+    self->_method = method_buff;
 
-    (*message_info)->set_message_type(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
+    clear_and_set_message_info(message_info, self);
 
-    strcpy(method_buff, event->method);
-    /* subtitute '.' by '/' */
-    do {
-        p = strchr(method_buff, '.');
-        if (p) *p = '/';
-    } while (p);
+    CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
 
-    dm_thing_manager_install_product_key_device_name(dm_thing_manager,thing,product_key,device_name);
+    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s", self->_product_key, self->_device_name, string_method_name_sdk_metrics_post);
+    CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, uri_buff);
 
-    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s", product_key, device_name, method_buff);
-    (*message_info)->set_uri(message_info, uri_buff);
+    CMP_MESSAGE_INFO_CALL(message_info, set_params_data)(message_info, params);
+    dm_lite_free(params);
 
-    if (strcmp(dm_thing_manager->_method, string_thing_event_property_post) != 0) {
-        output_data_numb = event->event_output_data_num;
-        for (i = 0; i < output_data_numb; ++i) {
-            lite_property = event->event_output_data + i;
-            assert(lite_property);
-            install_lite_property_to_message_info(dm_thing_manager, message_info, lite_property);
-        }
-        dm_thing_manager->_ret = 0;
-    } else {
-        property_iterator(thing, install_property_to_message_info, dm_thing_manager, thing,
-                          dm_thing_manager->_message_info, dm_thing_manager->_property_identifier_post);
+    return (*cmp)->send(cmp, message_info, NULL);
+}
+
+/* optional uplinks sent from yield, metrics and offline replay, wait under memory pressure. */
+#define mem_pressure_held() (LITE_mem_pressure_level() != LITE_MEM_PRESSURE_NONE)
+
+/* from LITE_mem_pressure_poll() in yield, what is kept and not needed is given back. */
+static void on_mem_pressure(int level, void* ctx)
+{
+#ifdef DM_OFFLINE_ENABLED
+    dm_thing_manager_t* self = ctx;
+    dm_offline_t* offline;
+
+    if (level == LITE_MEM_PRESSURE_NONE) return;
+
+    /* an empty store is made again by the next post failed, with kv the block written is sealed into it. */
+    send_lock(self);
+    offline = self->_offline;
+    if (offline && (CONFIG_DM_OFFLINE_KV || !dm_offline_pending(offline) || level >= LITE_MEM_PRESSURE_CRITICAL)) {
+        if (!CONFIG_DM_OFFLINE_KV && dm_offline_pending(offline)) dm_log_warning("memory pressure %d, offline records dropped", level);
+        dm_offline_deinit(offline);
+        dm_lite_free(offline);
+        self->_offline = NULL;
     }
+    send_unlock(self);
+#else
+    (void)level;
+    (void)ctx;
+#endif /* DM_OFFLINE_ENABLED */
+}
+
+/* post metrics when interval passed since the last post, while connected. */
+static int post_metrics_if_due(dm_thing_manager_t* self)
+{
+    uint64_t now;
+    int ret = 0;
+
+    if (self->_metrics_post_interval_ms <= 0 || !self->_cloud_connected) return 0;
+
+    send_lock(self);
+    now = HAL_UptimeMs();
+    /* waits for the events kept. */
+    if (!uplink_pending_held(self) && !mem_pressure_held() && now - self->_metrics_post_last_ms >= (uint64_t)self->_metrics_post_interval_ms) {
+        self->_metrics_post_last_ms = now;
+        ret = post_metrics(self);
+    }
+    send_unlock(self);
+
+    return ret;
+}
+
+static int dm_thing_manager_set_metrics_post_interval(void* _self, int interval_ms)
+{
+    dm_thing_manager_t* self = _self;
+
+    if (interval_ms < 0) return -1;
 
+    send_lock(self);
+    self->_metrics_post_interval_ms = interval_ms;
+    self->_metrics_post_last_ms = HAL_UptimeMs();
+    send_unlock(self);
+
+    return 0;
 }
 
-static void install_service_property_get_to_message_info(void* _string, va_list* params)
+#ifdef DM_OFFLINE_ENABLED
+/* the value of record as posted. */
+static int format_offline_value(const property_t* property, const dm_offline_record_t* record, char* buff)
 {
-    char* identifier_to_get = _string;
-    dm_thing_manager_t* dm_thing_manager;
-    thing_t** thing;
-    message_info_t** message_info;
+    double value = (double)record->value;
+    int decimals;
 
-    dm_thing_manager = va_arg(*params, dm_thing_manager_t*);
-    thing = va_arg(*params, thing_t**);
-    message_info = va_arg(*params, message_info_t**);
+    if (!is_offline_property_scaled(property)) return LITE_format_llong(buff, record->value);
 
-    assert(identifier_to_get);
+    for (decimals = 0; decimals < CONFIG_DM_OFFLINE_DECIMALS; ++decimals) value /= 10;
 
-    property_iterator(thing, install_property_to_message_info, dm_thing_manager, thing, message_info, identifier_to_get);
+    return LITE_format_double(buff, value);
 }
 
-static void handle_service_key_value(void* _item, int index, va_list* params)
+/* caller holds send lock. a batch of the values kept offline goes as a history post, read again from its start if not sent. */
+static int replay_offline(dm_thing_manager_t* self)
 {
-    service_t* service;
-    lite_property_t* lite_property;
-    dm_thing_manager_t* dm_thing_manager;
-    message_info_t** message_info;
+    message_info_t** message_info = self->_message_info;
+    cmp_abstract_t** cmp = self->_cmp;
     thing_t** thing;
-    list_t** list;
-    int output_data_numb;
+    dm_offline_t* offline;
+    dm_offline_record_t record;
+    dm_json_writer_t writer;
+    const property_t* property;
+    char params[DM_OFFLINE_HISTORY_POST_LEN];
+    char value_buff[LITE_NUMBER_LEN_MAX];
     char method_buff[METHOD_MAX_LENGH] = {0};
     char uri_buff[URI_MAX_LENGH] = {0};
-    char product_key[PRODUCT_KEY_MAXLEN] = {0};
-    char device_name[DEVICE_NAME_MAXLEN] = {0};
-
+    uint64_t epoch_now = utils_epoch_time_now();
+    uint64_t uptime_now = HAL_UptimeMs();
+    uint64_t time_ms;
+    int number = 0;
+    int left = 0;
+    int len;
     char* p;
-    int i;
+    int ret;
 
-    (void)index;
-    dm_thing_manager = va_arg(*params, void*);
-    message_info = va_arg(*params, message_info_t**);
-    thing = va_arg(*params, thing_t**);
+    thing = get_offline_thing(self);
+    /* a store in kv is read at start, one in RAM waits for a post failed. */
+    if (thing == NULL || (self->_offline == NULL && !CONFIG_DM_OFFLINE_KV)) return 0;
+
+    offline = get_offline(self, thing);
+    if (offline == NULL || !dm_offline_pending(offline)) return 0;
+
+    /* the block written goes once the sealed ones are through. */
+    if (offline->first_seq == offline->next_seq) dm_offline_seal(offline);
+
+    dm_json_writer_init(&writer, params, sizeof(params));
+    dm_json_writer_array_begin(&writer);
+    dm_json_writer_object_begin(&writer);
+    dm_json_writer_key(&writer, "identity", strlen("identity"));
+    dm_json_writer_object_begin(&writer);
+    dm_json_writer_key(&writer, "productKey", strlen("productKey"));
+    dm_json_writer_string(&writer, self->_product_key, strlen(self->_product_key));
+    dm_json_writer_key(&writer, "deviceName", strlen("deviceName"));
+    dm_json_writer_string(&writer, self->_device_name, strlen(self->_device_name));
+    dm_json_writer_object_end(&writer);
+    dm_json_writer_key(&writer, "properties", strlen("properties"));
+    dm_json_writer_array_begin(&writer);
+
+    while (number < CONFIG_DM_OFFLINE_REPLAY_RECORDS && dm_offline_read(offline, &record) == 0) {
+        property = ((dm_thing_t*)thing)->dsl_template.properties + record.index;
+
+        /* uptimes wait for the clock, a record of identifier and numbers is some 60 bytes. */
+        if ((!record.epoch && epoch_now == 0) || property->identifier == NULL ||
+            dm_json_writer_length(&writer) + strlen(property->identifier) + 64 + 3 > sizeof(params)) {
+            left = 1;
+            break;
+        }
 
-    assert(dm_thing_manager && message_info && *message_info && thing && *thing);
+        time_ms = record.epoch ? record.time_ms : epoch_now - (uptime_now - record.time_ms);
 
-    service = _item;
-    list = dm_thing_manager->_service_property_get_identifier_list;
+        dm_json_writer_object_begin(&writer);
+        dm_json_writer_key(&writer, property->identifier, strlen(property->identifier));
+        dm_json_writer_object_begin(&writer);
+        dm_json_writer_key(&writer, "value", strlen("value"));
+        len = format_offline_value(property, &record, value_buff);
+        if (property->data_type.type == data_type_type_date) {
+            dm_json_writer_string(&writer, value_buff, len);
+        } else {
+            dm_json_writer_raw(&writer, value_buff, len);
+        }
+        dm_json_writer_key(&writer, "time", strlen("time"));
+        len = LITE_format_llong(value_buff, (long long)time_ms);
+        dm_json_writer_raw(&writer, value_buff, len);
+        dm_json_writer_object_end(&writer);
+        dm_json_writer_object_end(&writer);
 
-    if (service && service->identifier && strcmp(service->identifier, dm_thing_manager->_identifier) != 0) return;
+        number++;
+    }
 
-    dm_thing_manager->_method = service->method;
+    dm_json_writer_array_end(&writer);
+    dm_json_writer_object_end(&writer);
+    dm_json_writer_array_end(&writer);
 
-    clear_and_set_message_info(message_info, dm_thing_manager);
+    /* records are read again up to where the batch ends. */
+    dm_offline_rewind(offline);
 
-    strcpy(method_buff, service->method);
-    /* subtitute '.' by '/' */
+    if (number == 0) {
+        /* nothing readable is left of the block, it goes. */
+        if (!left && dm_offline_read(offline, &record) != 0) dm_offline_commit(offline);
+        return 0;
+    }
+
+    self->_thing_id = thing;
+
+    strcpy(method_buff, string_method_name_property_history_post);
+    /* subtitute '/' by '.' */
     do {
-        p = strchr(method_buff, '.');
-        if (p) *p = '/';
+        p = strchr(method_buff, '/');
+        if (p) *p = '.';
     } while (p);
 
-    dm_thing_manager_install_product_key_device_name(dm_thing_manager,thing,product_key,device_name);
-#ifdef RRPC_ENABLED
-    if (dm_thing_manager->_rrpc) {
-        dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/rrpc/response/%d", product_key, device_name, dm_thing_manager->_rrpc_message_id);
-    } else {
-        dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s_reply", product_key, device_name, method_buff);
-    }
-#else
-    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s_reply", product_key, device_name, method_buff);
-#endif /* RRPC_ENABLED */
+    self->_method = method_buff;
 
-    (*message_info)->set_uri(message_info, uri_buff);
+    clear_and_set_message_info(message_info, self);
 
-    (*message_info)->set_message_type(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_RESPONSE);
-    (*message_info)->set_id(message_info, dm_thing_manager->_response_id);
-    (*message_info)->set_code(message_info, dm_thing_manager->_code);
+    CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
 
-    if (strcmp(dm_thing_manager->_method, string_thing_service_property_set) == 0) {
-        /* set property */
-    } else if (strcmp(dm_thing_manager->_method, string_thing_service_property_get) == 0) {
-        assert((*list)->get_size(list));
-        /* get property */
-        list_iterator(list, install_service_property_get_to_message_info, dm_thing_manager, thing, dm_thing_manager->_message_info);
-        /* clear after use. */
-        list_iterator(list, free_list_string, dm_thing_manager);
-        (*list)->clear(list);
-    } else {
-        /* normal service */
-        output_data_numb = service->service_output_data_num;
-        for (i = 0; i < output_data_numb; ++i) {
-            lite_property = service->service_output_data + i;
-            assert(lite_property);
-            install_lite_property_to_message_info(dm_thing_manager, message_info, lite_property);
-        }
-    }
+    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s", self->_product_key, self->_device_name, string_method_name_property_history_post);
+    CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, uri_buff);
+
+    CMP_MESSAGE_INFO_CALL(message_info, set_params_data)(message_info, params);
+
+    ret = (*cmp)->send(cmp, message_info, NULL);
+    if (ret == -1) return -1;
+
+    for (len = 0; len < number; ++len) dm_offline_read(offline, &record);
+    dm_offline_commit(offline);
+
+    dm_log_debug("%d offline records replayed", number);
+
+    return ret;
 }
 
-static void get_event_key_value(void* _thing, va_list* params)
+/* replay one batch each replay interval, while connected. */
+static int replay_offline_if_due(dm_thing_manager_t* self)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    uint64_t now;
+    int ret = 0;
 
-    dm_thing_manager = va_arg(*params, void*);
-
-    assert(dm_thing_manager && thing && *thing);
+    if (!self->_cloud_connected) return 0;
 
-    if (dm_thing_manager->_thing_id == thing) {
-        event_iterator(thing, handle_event_key_value, dm_thing_manager, dm_thing_manager->_message_info, thing);
+    send_lock(self);
+    now = HAL_UptimeMs();
+    /* the backlog drains after the events kept. */
+    if (!uplink_pending_held(self) && !mem_pressure_held() && now - self->_offline_replay_last_ms >= CONFIG_DM_OFFLINE_REPLAY_INTERVAL) {
+        self->_offline_replay_last_ms = now;
+        ret = replay_offline(self);
     }
+    send_unlock(self);
+
+    return ret;
 }
+#endif /* DM_OFFLINE_ENABLED */
 
-static void get_service_key_value(void* _thing, va_list* params)
+#ifdef DM_REPORT_POLICY_ENABLED
+/* caller holds send lock. post the properties of each thing its report policies held or made due by now. */
+static int post_due_property_reports(dm_thing_manager_t* self, uint64_t now)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    dm_thing_manager_local_thing_t* local_thing;
+    thing_t** thing;
+    size_t index;
+    int ret = 0;
 
-    dm_thing_manager = va_arg(*params, void*);
+    for (index = 0; index < self->_local_thing_index.slot_number; ++index) {
+        local_thing = self->_local_thing_index.slots[index].item;
+        if (local_thing == NULL) continue;
 
-    assert(dm_thing_manager && thing && *thing);
+        thing = local_thing->thing;
+        if ((*thing)->report_due_properties(thing, now, 1, NULL) == 0) continue;
 
-    if (dm_thing_manager->_thing_id == thing) {
-        service_iterator(thing, handle_service_key_value, dm_thing_manager, dm_thing_manager->_message_info, thing);
+        if (self->_property_post_min_interval_ms > 0) {
+            if (schedule_property_post(self, thing, NULL, 0) == -1) ret = -1;
+        } else if (trigger_event(self, thing, string_event_property_post_identifier, NULL, 1) == -1) {
+            ret = -1;
+        }
     }
+
+    return ret;
 }
 
-static int dm_thing_manager_trigger_event(void* _self, const void* thing_id, const void* event_identifier, const char* property_identifier)
+static int dm_thing_manager_set_property_report_policy(void* _self, const void* thing_id, const char* identifier,
+                                                       const dm_report_policy_t* policy)
 {
     dm_thing_manager_t* self = _self;
-    message_info_t** message_info = self->_message_info;
-    cmp_abstract_t** cmp = self->_cmp;
+    thing_t** thing;
+    void* property = NULL;
     int ret;
 
-    assert(thing_id && event_identifier && cmp && *cmp);
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
 
-    self->_thing_id = (void*)thing_id;
-    self->_identifier = (void*)event_identifier;
-    self->_property_identifier_post = (void*)property_identifier;
-    self->_ret = -1;
-    self->_get_value_str = NULL;
+    if (identifier) {
+        property = (*thing)->get_property_by_identifier(thing, identifier);
+        if (property == NULL) {
+            dm_log_err("property(%s) not found", identifier);
+            return -1;
+        }
+    }
 
-    local_thing_list_iterator(self, get_event_key_value);
+    send_lock(self);
+    ret = (*thing)->set_property_report_policy(thing, property, policy);
+    send_unlock(self);
 
-    if(-1 != self->_ret) {
-        dm_log_debug("event(%s) triggered, method(%s)", self->_identifier, self->_method);
-        ret = (*message_info)->serialize_to_payload_request(message_info);
-        if (ret == -1) {
-            dm_log_err("serialize_to_payload_request FAIL");
-            return ret;
-        }
+    return ret;
+}
+#endif
 
-        self->_ret = (*cmp)->send(cmp, message_info, NULL);
-    }
+#ifdef DM_CHANNELS_ENABLED
+static int dm_thing_manager_set_channel_route(void* _self, const char* prefix, dm_channel_t channel)
+{
+    dm_thing_manager_t* self = _self;
+    cmp_abstract_t** cmp = self->_cmp;
 
-    return self->_ret;
+    if (cmp == NULL || *cmp == NULL) return -1;
+
+    return (*cmp)->set_channel_route(cmp, prefix, channel);
 }
+#endif /* DM_CHANNELS_ENABLED */
 
-#ifdef DEVICEINFO_ENABLED
-static void check_thing_id(void* _thing, va_list* params)
+#ifdef DM_STATIC_THING_ENABLED
+static int dm_thing_manager_bind_static_thing(void* _self, const void* thing_id, const dm_static_thing_model_t* model, void* data)
 {
-    thing_t** thing = _thing;
-    dm_thing_manager_t* dm_thing_manager;
+    dm_thing_manager_t* self = _self;
+    thing_t** thing;
+    int ret;
 
-    dm_thing_manager = va_arg(*params, void*);
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
 
-    assert(dm_thing_manager && thing && *thing);
+    send_lock(self);
+    ret = dm_thing_bind_static(thing, model, data);
+    send_unlock(self);
 
-    if (dm_thing_manager->_thing_id == thing) {
-        dm_thing_manager->_ret = 0;
-    }
+    return ret;
 }
 
-static int check_deviceinfo_params(const char* params)
+static int dm_thing_manager_set_static_properties_changed(void* _self, const void* thing_id, const unsigned char* ids)
 {
-    cJSON* params_obj;
-    int array_size;
-
-    params_obj = cJSON_Parse(params);
+    dm_thing_manager_t* self = _self;
+    const dm_static_thing_t* bound;
+    const property_t* properties;
+    thing_t** thing;
+    int id;
 
-    if (!cJSON_IsArray(params_obj)) {
-        dm_log_err("input params format errorm, MUST be json array type");
-        return -1;
-    }
+    thing = get_local_thing(self, thing_id);
+    if (thing == NULL) return -1;
 
-    array_size = cJSON_GetArraySize(params_obj);
+    bound = dm_thing_get_static(thing);
+    if (bound == NULL) return -1;
 
-    if (array_size <= 0) return -1;
+    if (ids == NULL) return (*thing)->request_property_post(thing, NULL);
 
-    cJSON_Delete(params_obj);
+    properties = ((dm_thing_t*)thing)->dsl_template.properties;
+    for (id = 0; id < bound->model->property_number; ++id) {
+        if (DM_STATIC_THING_ID_ISSET(ids, id)) (*thing)->request_property_post(thing, properties + id);
+    }
 
     return 0;
 }
+#endif /* DM_STATIC_THING_ENABLED */
 
-static int dm_thing_manager_trigger_deviceinfo_update(void* _self, const void* thing_id, const char* params)
+#ifdef DEVICEINFO_ENABLED
+static void deviceinfo_reply_handler(const void* thing_id, int request_id, int code, const char* payload, int payload_len, void* ctx)
+{
+    dm_thing_manager_t* self = ctx;
+    dm_thing_manager_local_thing_t* local_thing;
+    dm_deviceinfo_t* info;
+
+    (void)payload;
+    (void)payload_len;
+
+    if (code != 200) dm_log_err("deviceinfo request(%d) fail, code %d", request_id, code);
+
+    send_lock(self);
+    local_thing = find_local_thing(self, thing_id);
+    info = local_thing ? local_thing->deviceinfo : NULL;
+    if (info) {
+        dm_deviceinfo_replied(info, request_id, code == 200);
+        /* what was asked for while it was in flight goes next. */
+        if (info->due_ms == 0 && (dm_deviceinfo_pending(info, DM_DEVICEINFO_UPDATE) || dm_deviceinfo_pending(info, DM_DEVICEINFO_DELETE))) {
+            info->due_ms = HAL_UptimeMs();
+        }
+    }
+    send_unlock(self);
+}
+
+/* caller holds send lock. one request of the items of op waiting, they are in flight with it once sent. */
+static int send_deviceinfo(dm_thing_manager_t* self, dm_thing_manager_local_thing_t* local_thing, int op)
 {
-    dm_thing_manager_t* self = _self;
     message_info_t** message_info = self->_message_info;
     cmp_abstract_t** cmp = self->_cmp;
-    thing_t** thing;
-
+    dm_deviceinfo_t* info = local_thing->deviceinfo;
+    const char* method_name = op == DM_DEVICEINFO_UPDATE ? string_method_name_deviceinfo_update : string_method_name_deviceinfo_delete;
+    dm_json_writer_t writer;
+    dm_request_t request;
     char method_buff[METHOD_MAX_LENGH] = {0};
     char uri_buff[URI_MAX_LENGH] = {0};
-
     char product_key[PRODUCT_KEY_MAXLEN] = {0};
     char device_name[DEVICE_NAME_MAXLEN] = {0};
-
+    char* params;
     char* p;
+    size_t len;
+    int request_id;
 
-    assert(thing_id && cmp && *cmp && message_info && *message_info);
+    assert(cmp && *cmp && message_info && *message_info);
 
-    self->_thing_id = (void*)thing_id;
+    self->_thing_id = (void*)local_thing->thing;
     self->_ret = -1;
     self->_get_value_str = NULL;
 
-    check_deviceinfo_params(params);
-
-    local_thing_list_iterator(self, check_thing_id);
-
-    if (self->_ret != 0) return -1;
-
-    thing = (thing_t**)thing_id;
-
-    strcpy(method_buff, string_method_name_deviceinfo_update);
+    strcpy(method_buff, method_name);
     /* subtitute '/' by '.' */
     do {
         p = strchr(method_buff, '/');
@@ -1827,69 +4729,215 @@ static int dm_thing_manager_trigger_deviceinfo_update(void* _self, const void* t
 
     clear_and_set_message_info(message_info, self);
 
-    (*message_info)->set_message_type(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
+    CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
 
-    dm_thing_manager_install_product_key_device_name(self,thing,product_key,device_name);
+    dm_thing_manager_install_product_key_device_name(self, local_thing->thing, product_key, device_name);
 
-    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s", product_key, device_name, string_method_name_deviceinfo_update);
-    (*message_info)->set_uri(message_info, uri_buff);
+    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s", product_key, device_name, method_name);
+    CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, uri_buff);
 
-    (*message_info)->set_params_data(message_info, (char*)params);
+    dm_json_writer_init(&writer, NULL, 0);
+    dm_deviceinfo_write(info, op, &writer);
+    len = dm_json_writer_length(&writer);
 
-    return (*cmp)->send(cmp, message_info, NULL);
+    params = CMP_MESSAGE_INFO_CALL(message_info, reserve_params_data)(message_info, (int)len);
+    if (params == NULL) return -1;
+
+    dm_json_writer_init(&writer, params, len + 1);
+    dm_deviceinfo_write(info, op, &writer);
+
+    /* the reply may come on cmp thread before send returns, it waits for send lock to take the items in flight. */
+    self->_reply_handler = deviceinfo_reply_handler;
+    self->_reply_ctx = self;
+    self->_reply_timeout_ms = DM_DEVICEINFO_REPLY_TIMEOUT_MS;
+    request_id = CMP_MESSAGE_INFO_CALL(message_info, get_id)(message_info);
+    if (add_request(self, request_id) == -1) {
+        dm_log_err("request(%d) can not wait for reply", request_id);
+        self->_reply_handler = NULL;
+        self->_reply_ctx = NULL;
+        CMP_MESSAGE_INFO_CALL(message_info, clear)(message_info);
+        return -1;
+    }
+    self->_reply_handler = NULL;
+    self->_reply_ctx = NULL;
+
+    if ((*cmp)->send(cmp, message_info, NULL) == -1) {
+        take_request(self, request_id, &request);
+        return -1;
+    }
+
+    dm_deviceinfo_sent(info, op, request_id);
+
+    return 0;
+}
+
+/* caller holds send lock. updates go before deletes, a key asked to be deleted is in one of them only. */
+static int flush_local_thing_deviceinfo(dm_thing_manager_t* self, dm_thing_manager_local_thing_t* local_thing, uint64_t now, int force)
+{
+    dm_deviceinfo_t* info = local_thing->deviceinfo;
+    int ret = 0;
+
+    if (info == NULL || info->due_ms == 0 || (!force && (info->due_ms > now || !self->_cloud_connected))) return 0;
+
+    info->due_ms = 0;
+
+    if (dm_deviceinfo_pending(info, DM_DEVICEINFO_UPDATE) && send_deviceinfo(self, local_thing, DM_DEVICEINFO_UPDATE) == -1) ret = -1;
+    if (dm_deviceinfo_pending(info, DM_DEVICEINFO_DELETE) && send_deviceinfo(self, local_thing, DM_DEVICEINFO_DELETE) == -1) ret = -1;
+
+    /* not sent, tried again a window later. */
+    if (ret == -1) info->due_ms = now + CONFIG_DM_DEVICEINFO_MERGE_MS;
+
+    return ret;
+}
+
+/* caller holds send lock. */
+static int flush_deviceinfo(dm_thing_manager_t* self, uint64_t now)
+{
+    dm_thing_manager_local_thing_t* local_thing;
+    size_t index;
+    int ret = 0;
+
+    for (index = 0; index < self->_local_thing_index.slot_number; ++index) {
+        local_thing = self->_local_thing_index.slots[index].item;
+
+        if (local_thing && flush_local_thing_deviceinfo(self, local_thing, now, 0) == -1) ret = -1;
+    }
+
+    return ret;
+}
+
+/* caller holds send lock. the keys asked for are merged with the ones waiting, only the ones not acked as asked are sent. */
+static int ask_deviceinfo(dm_thing_manager_t* self, const void* thing_id, int op, const char* params)
+{
+    dm_thing_manager_local_thing_t* local_thing;
+    dm_deviceinfo_t* info;
+    uint64_t now;
+
+    local_thing = find_local_thing(self, thing_id);
+    if (local_thing == NULL || params == NULL) return -1;
+
+    if (local_thing->deviceinfo == NULL) {
+        local_thing->deviceinfo = dm_lite_calloc(1, sizeof(dm_deviceinfo_t));
+        if (local_thing->deviceinfo == NULL) return -1;
+
+        dm_deviceinfo_init(local_thing->deviceinfo, local_thing->key);
+    }
+    info = local_thing->deviceinfo;
+
+    if (dm_deviceinfo_ask(info, op, params) != 0) return -1;
+
+    if (!dm_deviceinfo_pending(info, DM_DEVICEINFO_UPDATE) && !dm_deviceinfo_pending(info, DM_DEVICEINFO_DELETE)) {
+        dm_log_debug("deviceinfo asked for is acked or in flight already");
+        return 0;
+    }
+
+    now = HAL_UptimeMs();
+    if (info->due_ms == 0) info->due_ms = now + CONFIG_DM_DEVICEINFO_MERGE_MS;
+
+    return CONFIG_DM_DEVICEINFO_MERGE_MS == 0 ? flush_local_thing_deviceinfo(self, local_thing, now, 0) : 0;
+}
+
+static int dm_thing_manager_trigger_deviceinfo_update(void* _self, const void* thing_id, const char* params)
+{
+    dm_thing_manager_t* self = _self;
+    int ret;
+
+    send_lock(self);
+    ret = ask_deviceinfo(self, thing_id, DM_DEVICEINFO_UPDATE, params);
+    send_unlock(self);
+
+    return ret;
 }
 
 static int dm_thing_manager_trigger_deviceinfo_delete(void* _self, const void* thing_id, const char* params)
 {
     dm_thing_manager_t* self = _self;
-    message_info_t** message_info = self->_message_info;
-    cmp_abstract_t** cmp = self->_cmp;
-    thing_t** thing;
+    int ret;
 
-    char method_buff[METHOD_MAX_LENGH] = {0};
-    char uri_buff[URI_MAX_LENGH] = {0};
-    char product_key[PRODUCT_KEY_MAXLEN] = {0};
-    char device_name[DEVICE_NAME_MAXLEN] = {0};
-    char* p;
+    send_lock(self);
+    ret = ask_deviceinfo(self, thing_id, DM_DEVICEINFO_DELETE, params);
+    send_unlock(self);
 
-    assert(thing_id && cmp && *cmp && message_info && *message_info);
+    return ret;
+}
+#endif /* DEVICEINFO_ENABLED*/
 
-    self->_thing_id = (void*)thing_id;
-    self->_ret = -1;
-    self->_get_value_str = NULL;
+static int dm_thing_manager_flush_property_post(void* _self, int force)
+{
+    dm_thing_manager_t* self = _self;
+    dm_thing_manager_local_thing_t* local_thing;
+    uint64_t now;
+    size_t index;
+    int ret = 0;
 
-    check_deviceinfo_params(params);
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+    /* the events kept go first. */
+    if (send_uplink_pending_if_due(self)) ret = -1;
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
 
-    local_thing_list_iterator(self, check_thing_id);
+    send_lock(self);
 
-    if (self->_ret != 0) return -1;
+    now = HAL_UptimeMs();
 
-    thing = (thing_t**)thing_id;
+    for (index = 0; index < self->_local_thing_index.slot_number; ++index) {
+        local_thing = self->_local_thing_index.slots[index].item;
 
-    strcpy(method_buff, string_method_name_deviceinfo_delete);
-    /* subtitute '/' by '.' */
-    do {
-        p = strchr(method_buff, '/');
-        if (p) *p = '.';
-    } while (p);
+        if (local_thing && flush_local_thing_property_post(self, local_thing, now, force) == -1) ret = -1;
+    }
+#ifdef DM_REPORT_POLICY_ENABLED
+    if (post_due_property_reports(self, now) == -1) ret = -1;
+#endif
+#ifdef DEVICEINFO_ENABLED
+    if (flush_deviceinfo(self, now) == -1) ret = -1;
+#endif /* DEVICEINFO_ENABLED */
 
-    self->_method = method_buff;
+    send_unlock(self);
 
-    clear_and_set_message_info(message_info, self);
+    expire_requests(self);
+
+    if (post_metrics_if_due(self) == -1) ret = -1;
+#ifdef DM_OFFLINE_ENABLED
+    if (replay_offline_if_due(self) == -1) ret = -1;
+#endif /* DM_OFFLINE_ENABLED */
+#ifdef DM_BACKPRESSURE_ENABLED
+    notify_writable_if_due(self);
+#endif /* DM_BACKPRESSURE_ENABLED */
 
-    (*message_info)->set_message_type(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_REQUEST);
+    return ret;
+}
+
+static int dm_thing_manager_set_property_post_schedule(void* _self, int min_interval_ms, int max_latency_ms)
+{
+    dm_thing_manager_t* self = _self;
 
-    dm_thing_manager_install_product_key_device_name(self,thing,product_key,device_name);
+    if (min_interval_ms < 0 || max_latency_ms < 0) return -1;
 
-    dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s", product_key, device_name, string_method_name_deviceinfo_delete);
-    (*message_info)->set_uri(message_info, uri_buff);
+    send_lock(self);
+    self->_property_post_min_interval_ms = min_interval_ms;
+    self->_property_post_max_latency_ms = max_latency_ms;
+    send_unlock(self);
 
-    (*message_info)->set_params_data(message_info, (char*)params);
+    /* posts pending are not coalesced any more. */
+    if (min_interval_ms == 0) return dm_thing_manager_flush_property_post(self, 1);
 
-    return (*cmp)->send(cmp, message_info, NULL);
+    return 0;
 }
-#endif /* DEVICEINFO_ENABLED*/
-static int generate_raw_message_info(void* _dm_thing_manager, void* _thing, void* _message_info, const char* raw_topic)
+
+static int dm_thing_manager_set_payload_format(void* _self, int format)
+{
+    dm_thing_manager_t* self = _self;
+
+    if (format < dm_payload_format_json || format >= dm_payload_format_max) return -1;
+
+    send_lock(self);
+    self->_payload_format = format;
+    send_unlock(self);
+
+    return 0;
+}
+
+static int generate_raw_message_info(void* _dm_thing_manager, void* _thing, void* _message_info, const char* raw_topic,
+                                     void* raw_data, int raw_data_length)
 {
     dm_thing_manager_t* dm_thing_manager = _dm_thing_manager;
     thing_t** thing = _thing;
@@ -1905,42 +4953,53 @@ static int generate_raw_message_info(void* _dm_thing_manager, void* _thing, void
 
     dm_snprintf(uri_buff, sizeof(uri_buff), "/sys/%s/%s/%s", product_key, device_name, raw_topic);
 
+    /* raw data has no method, the topic stands for the one left by a previous message. */
+    dm_thing_manager->_method = (char*)raw_topic;
     clear_and_set_message_info(message_info, dm_thing_manager);
 
-    ret = (*message_info)->set_uri(message_info, uri_buff);
+    ret = CMP_MESSAGE_INFO_CALL(message_info, set_uri)(message_info, uri_buff);
     if (ret == -1) return ret;
 
-    (*message_info)->set_message_type(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_RAW);
+    CMP_MESSAGE_INFO_CALL(message_info, set_message_type)(message_info, CMP_MESSAGE_INFO_MESSAGE_TYPE_RAW);
 
-    ret = (*message_info)->set_raw_data_and_length(message_info, dm_thing_manager->_raw_data, dm_thing_manager->_raw_data_length);
+    ret = CMP_MESSAGE_INFO_CALL(message_info, set_raw_data_and_length)(message_info, raw_data, raw_data_length);
     if (ret == -1) return ret;
 
     return 0;
 }
 
-static int generate_raw_up_message_info(void* _dm_thing_manager, void* _thing, void* _message_info)
+static int generate_raw_up_message_info(void* _dm_thing_manager, void* _thing, void* _message_info, void* raw_data, int raw_data_length)
 {
-    return generate_raw_message_info(_dm_thing_manager, _thing, _message_info, string_method_name_up_raw);
+    return generate_raw_message_info(_dm_thing_manager, _thing, _message_info, string_method_name_up_raw, raw_data, raw_data_length);
 }
 
-static int generate_raw_down_reply_message_info(void* _dm_thing_manager, void* _thing, void* _message_info)
+static int generate_raw_down_reply_message_info(void* _dm_thing_manager, void* _thing, void* _message_info, void* raw_data, int raw_data_length)
 {
-    return generate_raw_message_info(_dm_thing_manager, _thing, _message_info, string_method_name_down_raw_reply);
+    return generate_raw_message_info(_dm_thing_manager, _thing, _message_info, string_method_name_down_raw_reply, raw_data, raw_data_length);
 }
 
+/* caller holds send lock. */
 #ifdef RRPC_ENABLED
-static int dm_thing_manager_answer_service(void* _self, const void* thing_id, const void* identifier, int response_id, int code, int rrpc)
+static int answer_service(dm_thing_manager_t* self, const void* thing_id, const void* identifier, int response_id, int code, int rrpc)
 #else
-static int dm_thing_manager_answer_service(void* _self, const void* thing_id, const void* identifier, int response_id, int code)
+static int answer_service(dm_thing_manager_t* self, const void* thing_id, const void* identifier, int response_id, int code)
 #endif /* RRPC_ENABLED */
 {
-    dm_thing_manager_t* self = _self;
     message_info_t** message_info = self->_message_info;
     cmp_abstract_t** cmp = self->_cmp;
     int ret;
 
     assert(thing_id && identifier && cmp && *cmp);
 
+#ifdef RRPC_ENABLED
+    if (rrpc) {
+        self->_rrpc_message_id = take_rrpc_pending(self, rrpc, response_id);
+        if (self->_rrpc_message_id == NULL) {
+            dm_log_err("rrpc(%d) not pending or timed out", rrpc);
+            return -1;
+        }
+    }
+#endif /* RRPC_ENABLED */
     self->_thing_id = (void*)thing_id;
     self->_identifier = (void*)identifier;
     self->_ret = 0;
@@ -1948,22 +5007,14 @@ static int dm_thing_manager_answer_service(void* _self, const void* thing_id, co
     self->_code = code;
     self->_response_id = response_id;
     self->_method = NULL;
-
-    /* response id matches request id. */
-    if (self->_response_id == self->_request_id) {
-        dm_log_debug("response id(%d) matches request id(%d).", self->_response_id, self->_request_id);
-        self->_request_id = 0;
-    } else {
-        dm_log_warning("response id(%d) not matche request id(%d).", self->_response_id, self->_request_id);
-    }
 #ifdef RRPC_ENABLED
     self->_rrpc = rrpc;
 #endif /* RRPC_ENABLED */
-    local_thing_list_iterator(self, get_service_key_value);
+    local_thing_visit(self, get_service_key_value);
 
     dm_log_debug("answer normal service(%s), method(%s)", self->_identifier, self->_method ? self->_method : "NULL");
 
-    ret = (*message_info)->serialize_to_payload_response(message_info);
+    ret = CMP_MESSAGE_INFO_CALL(message_info, serialize_to_payload_response)(message_info);
 
     if (ret == -1) {
         dm_log_err("serialize_to_payload_response FAIL");
@@ -1975,33 +5026,53 @@ static int dm_thing_manager_answer_service(void* _self, const void* thing_id, co
     return self->_ret;
 }
 
+#ifdef RRPC_ENABLED
+static int dm_thing_manager_answer_service(void* _self, const void* thing_id, const void* identifier, int response_id, int code, int rrpc)
+#else
+static int dm_thing_manager_answer_service(void* _self, const void* thing_id, const void* identifier, int response_id, int code)
+#endif /* RRPC_ENABLED */
+{
+    dm_thing_manager_t* self = _self;
+    int ret;
+
+    send_lock(self);
+#ifdef RRPC_ENABLED
+    ret = answer_service(self, thing_id, identifier, response_id, code, rrpc);
+#else
+    ret = answer_service(self, thing_id, identifier, response_id, code);
+#endif /* RRPC_ENABLED */
+    send_unlock(self);
+
+    return ret;
+}
+
 static int dm_thing_manager_invoke_raw_service(void* _self, const void* thing_id, void* raw_data, int raw_data_length)
 {
     dm_thing_manager_t* self = _self;
     message_info_t** message_info = self->_message_info;
     cmp_abstract_t** cmp = self->_cmp;
+    int ret;
 
     assert(thing_id);
 
-    self->_thing_id = (void*)thing_id;
-    self->_ret = 0;
-    self->_raw_data = raw_data;
-    self->_raw_data_length = raw_data_length;
-
     dm_log_debug("invoke up raw service");
 
-    if (generate_raw_up_message_info(self, self->_thing_id, message_info) == -1)
+    send_lock(self);
+
+    self->_thing_id = (void*)thing_id;
+
+    if (generate_raw_up_message_info(self, self->_thing_id, message_info, raw_data, raw_data_length) == -1)
     {
+        send_unlock(self);
         dm_log_err("invoke up raw service FAIL!");
         return -1;
     }
 
-    self->_ret = (*cmp)->send(cmp, message_info, NULL);
+    ret = (*cmp)->send(cmp, message_info, NULL);
 
-    self->_raw_data = NULL;
-    self->_raw_data_length = 0;
+    send_unlock(self);
 
-    return self->_ret;
+    return ret;
 }
 
 static int dm_thing_manager_answer_raw_service(void* _self, const void* thing_id, void* raw_data, int raw_data_length)
@@ -2009,28 +5080,28 @@ static int dm_thing_manager_answer_raw_service(void* _self, const void* thing_id
     dm_thing_manager_t* self = _self;
     message_info_t** message_info = self->_message_info;
     cmp_abstract_t** cmp = self->_cmp;
+    int ret;
 
     assert(thing_id);
 
-    self->_thing_id = (void*)thing_id;
-    self->_ret = 0;
-    self->_raw_data = raw_data;
-    self->_raw_data_length = raw_data_length;
-
     dm_log_debug("invoke down raw reply service");
 
-    if (generate_raw_down_reply_message_info(self, self->_thing_id, message_info) == -1)
+    send_lock(self);
+
+    self->_thing_id = (void*)thing_id;
+
+    if (generate_raw_down_reply_message_info(self, self->_thing_id, message_info, raw_data, raw_data_length) == -1)
     {
+        send_unlock(self);
         dm_log_err("invoke down raw reply service FAIL!");
         return -1;
     }
 
-    self->_ret = (*cmp)->send(cmp, message_info, NULL);
+    ret = (*cmp)->send(cmp, message_info, NULL);
 
-    self->_raw_data = NULL;
-    self->_raw_data_length = 0;
+    send_unlock(self);
 
-    return self->_ret;
+    return ret;
 }
 #ifndef CMP_SUPPORT_MULTI_THREAD
 static int dm_thing_manager_yield(void* _self, int timeout_ms)
@@ -2038,8 +5109,125 @@ static int dm_thing_manager_yield(void* _self, int timeout_ms)
     dm_thing_manager_t* self = _self;
     cmp_abstract_t** cmp = self->_cmp;
 
+    LITE_mem_pressure_poll();
+
+    if (self->_property_post_min_interval_ms > 0) {
+        dm_thing_manager_flush_property_post(self, 0);
+    } else {
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+        /* the events kept go first. */
+        send_uplink_pending_if_due(self);
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+#ifdef DM_REPORT_POLICY_ENABLED
+        send_lock(self);
+        post_due_property_reports(self, HAL_UptimeMs());
+        send_unlock(self);
+#endif
+#ifdef DEVICEINFO_ENABLED
+        send_lock(self);
+        flush_deviceinfo(self, HAL_UptimeMs());
+        send_unlock(self);
+#endif /* DEVICEINFO_ENABLED */
+        expire_requests(self);
+        post_metrics_if_due(self);
+#ifdef DM_OFFLINE_ENABLED
+        replay_offline_if_due(self);
+#endif /* DM_OFFLINE_ENABLED */
+#ifdef DM_BACKPRESSURE_ENABLED
+        notify_writable_if_due(self);
+#endif /* DM_BACKPRESSURE_ENABLED */
+    }
+
+#if WITH_LOG_RING && !WITH_LOG_RING_THREAD
+    /* no thread drains the log ring, the loop does between messages. */
+    LITE_log_ring_drain(0);
+#endif
+
     return (*cmp)->yield(cmp, timeout_ms);
 }
+
+/* soonest of the coalesced posts, deviceinfo merged, metrics post, offline replay and retry of events kept due, the requests timing out and what the connection waits for. */
+static uint32_t dm_thing_manager_get_timeout(void* _self)
+{
+    dm_thing_manager_t* self = _self;
+    cmp_abstract_t** cmp = self->_cmp;
+    dm_thing_manager_local_thing_t* local_thing;
+    uint64_t now = HAL_UptimeMs();
+    uint64_t timeout = (*cmp)->get_timeout(cmp);
+    uint64_t due;
+    int64_t request_timeout;
+    size_t index;
+#ifdef DM_REPORT_POLICY_ENABLED
+    uint32_t report_timeout;
+#endif
+
+    send_lock(self);
+    for (index = 0; self->_property_post_min_interval_ms > 0 && index < self->_local_thing_index.slot_number; ++index) {
+        local_thing = self->_local_thing_index.slots[index].item;
+        if (local_thing == NULL || !local_thing->property_post_pending) continue;
+
+        due = local_thing->property_post_last_ms + property_post_interval_ms(self);
+        if (self->_property_post_max_latency_ms > 0 &&
+            local_thing->property_post_pending_ms + self->_property_post_max_latency_ms < due) {
+            due = local_thing->property_post_pending_ms + self->_property_post_max_latency_ms;
+        }
+        if (due <= now) due = now;
+        if (due - now < timeout) timeout = due - now;
+    }
+#ifdef DM_REPORT_POLICY_ENABLED
+    for (index = 0; index < self->_local_thing_index.slot_number; ++index) {
+        local_thing = self->_local_thing_index.slots[index].item;
+        if (local_thing == NULL) continue;
+
+        report_timeout = timeout > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)timeout;
+        (*local_thing->thing)->report_due_properties(local_thing->thing, now, 0, &report_timeout);
+        if (report_timeout < timeout) timeout = report_timeout;
+    }
+#endif
+#ifdef DEVICEINFO_ENABLED
+    for (index = 0; self->_cloud_connected && index < self->_local_thing_index.slot_number; ++index) {
+        local_thing = self->_local_thing_index.slots[index].item;
+        if (local_thing == NULL || local_thing->deviceinfo == NULL || local_thing->deviceinfo->due_ms == 0) continue;
+
+        due = local_thing->deviceinfo->due_ms;
+        if (due <= now) due = now;
+        if (due - now < timeout) timeout = due - now;
+    }
+#endif /* DEVICEINFO_ENABLED */
+    /* what waits for the events kept or for memory is not due before them. */
+    if (self->_metrics_post_interval_ms > 0 && self->_cloud_connected && !uplink_pending_held(self) && !mem_pressure_held()) {
+        due = self->_metrics_post_last_ms + self->_metrics_post_interval_ms;
+        if (due <= now) due = now;
+        if (due - now < timeout) timeout = due - now;
+    }
+#ifdef DM_OFFLINE_ENABLED
+    if (self->_offline && self->_cloud_connected && dm_offline_pending(self->_offline) && !uplink_pending_held(self) &&
+        !mem_pressure_held()) {
+        due = self->_offline_replay_last_ms + CONFIG_DM_OFFLINE_REPLAY_INTERVAL;
+        if (due <= now) due = now;
+        if (due - now < timeout) timeout = due - now;
+    }
+#endif /* DM_OFFLINE_ENABLED */
+#ifdef DM_UPLINK_PRIORITY_ENABLED
+    if (self->_uplink_pending_number > 0 && self->_cloud_connected) {
+        due = self->_uplink_pending_retry_ms + CONFIG_DM_UPLINK_PRIORITY_RETRY_INTERVAL;
+        if (due <= now) due = now;
+        if (due - now < timeout) timeout = due - now;
+    }
+#endif /* DM_UPLINK_PRIORITY_ENABLED */
+#ifdef DM_BACKPRESSURE_ENABLED
+    /* the budget comes back with acks the yield reads, it is checked after each. */
+    if (self->_send_blocked && CONFIG_DM_BACKPRESSURE_POLL_INTERVAL < timeout) timeout = CONFIG_DM_BACKPRESSURE_POLL_INTERVAL;
+#endif /* DM_BACKPRESSURE_ENABLED */
+    send_unlock(self);
+
+    request_lock(self);
+    request_timeout = self->_requests ? dm_request_table_next_timeout(self->_requests, now) : -1;
+    request_unlock(self);
+    if (request_timeout >= 0 && (uint64_t)request_timeout < timeout) timeout = (uint64_t)request_timeout;
+
+    return (uint32_t)timeout;
+}
 #endif
 
 
@@ -2047,16 +5235,15 @@ static int dm_thing_manager_install_product_key_device_name(void *_self, const v
 {
     char *dsl_product_key;
     char *dsl_device_name;
-    char hal_product_key[PRODUCT_KEY_MAXLEN] = {0};
-    char hal_device_name[DEVICE_NAME_MAXLEN] = {0};
+    const utils_identity_t *identity = utils_identity_get();
+    const char *hal_product_key = identity->product_key;
+    const char *hal_device_name = identity->device_name;
 
-    dm_thing_manager_t* self = _self;
     const thing_t** thing = (const thing_t**)thing_id;
 
-    self->_ret = -1;
+    (void)_self;
 
-    if(HAL_GetProductKey(hal_product_key) <= 0 ||
-        (HAL_GetDeviceName(hal_device_name) <= 0)) {
+    if('\0' == hal_product_key[0] || '\0' == hal_device_name[0]) {
         dm_log_err("get HAL DeviceInfo failed!");
     }
 
@@ -2076,9 +5263,7 @@ static int dm_thing_manager_install_product_key_device_name(void *_self, const v
         strcpy(device_name, hal_device_name);
     }
 
-    self->_ret = 0;
-
-    return self->_ret;
+    return 0;
 }
 
 
@@ -2108,7 +5293,37 @@ static thing_manager_t _dm_thing_manager_class = {
     dm_thing_manager_yield,
 #endif
     dm_thing_manager_install_product_key_device_name,
-
+    dm_thing_manager_resolve_thing_property_handle,
+    dm_thing_manager_release_thing_property_handle,
+    dm_thing_manager_set_thing_property_value_by_handle,
+    dm_thing_manager_get_thing_property_value_by_handle,
+    dm_thing_manager_copy_thing_property_value,
+    dm_thing_manager_copy_thing_property_value_by_handle,
+    dm_thing_manager_trigger_changed_property_post,
+    dm_thing_manager_set_thing_property_values,
+    dm_thing_manager_set_thing_property_array_values,
+    dm_thing_manager_get_thing_property_array_values,
+    dm_thing_manager_register_route,
+    dm_thing_manager_set_property_post_schedule,
+    dm_thing_manager_flush_property_post,
+    dm_thing_manager_generate_new_local_things,
+    dm_thing_manager_set_payload_format,
+    dm_thing_manager_trigger_event_async,
+    dm_thing_manager_cancel_request,
+    dm_thing_manager_set_metrics_post_interval,
+#ifndef CMP_SUPPORT_MULTI_THREAD
+    dm_thing_manager_get_timeout,
+#endif
+#ifdef DM_REPORT_POLICY_ENABLED
+    dm_thing_manager_set_property_report_policy,
+#endif
+#ifdef DM_CHANNELS_ENABLED
+    dm_thing_manager_set_channel_route,
+#endif
+#ifdef DM_STATIC_THING_ENABLED
+    dm_thing_manager_bind_static_thing,
+    dm_thing_manager_set_static_properties_changed,
+#endif
 };
 
 const void* get_dm_thing_manager_class()
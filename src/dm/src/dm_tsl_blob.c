@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dm_tsl_blob.h"
+#include "dm_id_index.h"
+#include "dm_import.h"
+
+#define DM_TSL_BLOB_STRING_CAPACITY 32
+#define DM_TSL_BLOB_MAX_SIZE        0x7FFFFFFF
+
+typedef struct {
+    unsigned char* buf; /* NULL when only measuring. */
+    size_t         buf_size;
+    size_t         pos; /* next record byte. */
+    size_t         strings_offset; /* string table offset in blob. */
+    size_t         strings_size;
+    dm_id_index_t  strings; /* equal strings are written once, item is offset + 1. */
+    int            error;
+} dm_tsl_blob_writer_t;
+
+int dm_tsl_blob_detect(const char* src, size_t src_len)
+{
+    return src && src_len >= DM_TSL_BLOB_HEADER_SIZE && memcmp(src, DM_TSL_BLOB_MAGIC, DM_TSL_BLOB_MAGIC_SIZE) == 0;
+}
+
+static unsigned int dm_tsl_blob_get_u32(const unsigned char* p)
+{
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void dm_tsl_blob_put_u32(unsigned char* p, unsigned int val)
+{
+    p[0] = (unsigned char)val;
+    p[1] = (unsigned char)(val >> 8);
+    p[2] = (unsigned char)(val >> 16);
+    p[3] = (unsigned char)(val >> 24);
+}
+
+int dm_tsl_blob_reader_init(dm_tsl_blob_reader_t* reader, const char* src, size_t src_len)
+{
+    const unsigned char* blob = (const unsigned char*)src;
+    size_t version, header_size, total_size, strings_offset, strings_size, record_offset;
+
+    if (reader == NULL || !dm_tsl_blob_detect(src, src_len)) return -1;
+
+    memset(reader, 0, sizeof(dm_tsl_blob_reader_t));
+
+    version = blob[4] | (blob[5] << 8);
+    header_size = blob[6] | (blob[7] << 8);
+    total_size = dm_tsl_blob_get_u32(blob + 8);
+    strings_offset = dm_tsl_blob_get_u32(blob + 12);
+    strings_size = dm_tsl_blob_get_u32(blob + 16);
+    record_offset = dm_tsl_blob_get_u32(blob + 20);
+
+    if (version != DM_TSL_BLOB_VERSION || header_size < DM_TSL_BLOB_HEADER_SIZE || total_size > src_len ||
+        record_offset < header_size || record_offset > total_size ||
+        strings_offset > total_size || strings_size > total_size - strings_offset) {
+        return -1;
+    }
+
+    /* the last string must be terminated so no string read runs past the table. */
+    if (strings_size && blob[strings_offset + strings_size - 1] != '\0') return -1;
+
+    reader->blob = blob;
+    reader->size = total_size;
+    reader->pos = record_offset;
+    reader->strings = (const char*)blob + strings_offset;
+    reader->strings_size = strings_size;
+
+    return 0;
+}
+
+static const unsigned char* dm_tsl_blob_read(dm_tsl_blob_reader_t* reader, size_t len)
+{
+    const unsigned char* p;
+
+    if (reader->error || len > reader->size - reader->pos) {
+        reader->error = 1;
+        return NULL;
+    }
+
+    p = reader->blob + reader->pos;
+    reader->pos += len;
+
+    return p;
+}
+
+unsigned char dm_tsl_blob_read_u8(dm_tsl_blob_reader_t* reader)
+{
+    const unsigned char* p = dm_tsl_blob_read(reader, 1);
+
+    return p ? *p : 0;
+}
+
+unsigned int dm_tsl_blob_read_u32(dm_tsl_blob_reader_t* reader)
+{
+    const unsigned char* p = dm_tsl_blob_read(reader, 4);
+
+    return p ? dm_tsl_blob_get_u32(p) : 0;
+}
+
+int dm_tsl_blob_read_i32(dm_tsl_blob_reader_t* reader)
+{
+    return (int)dm_tsl_blob_read_u32(reader);
+}
+
+double dm_tsl_blob_read_f64(dm_tsl_blob_reader_t* reader)
+{
+    const unsigned char* p = dm_tsl_blob_read(reader, 8);
+    unsigned long long bits;
+    double val = 0;
+
+    if (p) {
+        bits = dm_tsl_blob_get_u32(p) | ((unsigned long long)dm_tsl_blob_get_u32(p + 4) << 32);
+        memcpy(&val, &bits, sizeof(val));
+    }
+
+    return val;
+}
+
+char* dm_tsl_blob_read_string(dm_tsl_blob_reader_t* reader)
+{
+    unsigned int offset = dm_tsl_blob_read_u32(reader);
+
+    if (reader->error || offset == DM_TSL_BLOB_NULL_STRING) return NULL;
+
+    if (offset >= reader->strings_size) {
+        reader->error = 1;
+        return NULL;
+    }
+
+    /* template never writes its strings, they are shared with the blob. */
+    return (char*)reader->strings + offset;
+}
+
+static void dm_tsl_blob_write_bytes(dm_tsl_blob_writer_t* writer, const void* src, size_t len)
+{
+    if (writer->buf && writer->pos + len <= writer->buf_size) {
+        memcpy(writer->buf + writer->pos, src, len);
+    }
+    writer->pos += len;
+}
+
+static void dm_tsl_blob_write_u8(dm_tsl_blob_writer_t* writer, unsigned char val)
+{
+    dm_tsl_blob_write_bytes(writer, &val, 1);
+}
+
+static void dm_tsl_blob_write_u32(dm_tsl_blob_writer_t* writer, unsigned int val)
+{
+    unsigned char p[4];
+
+    dm_tsl_blob_put_u32(p, val);
+    dm_tsl_blob_write_bytes(writer, p, sizeof(p));
+}
+
+static void dm_tsl_blob_write_f64(dm_tsl_blob_writer_t* writer, double val)
+{
+    unsigned long long bits;
+    unsigned char p[8];
+
+    memcpy(&bits, &val, sizeof(bits));
+    dm_tsl_blob_put_u32(p, (unsigned int)bits);
+    dm_tsl_blob_put_u32(p + 4, (unsigned int)(bits >> 32));
+    dm_tsl_blob_write_bytes(writer, p, sizeof(p));
+}
+
+static void dm_tsl_blob_write_string(dm_tsl_blob_writer_t* writer, const char* str)
+{
+    dm_id_index_entry_t* entry;
+    size_t len, offset;
+
+    if (str == NULL) {
+        dm_tsl_blob_write_u32(writer, DM_TSL_BLOB_NULL_STRING);
+        return;
+    }
+
+    len = strlen(str);
+    entry = dm_id_index_find(&writer->strings, str, len);
+    if (entry) {
+        offset = (size_t)entry->item - 1;
+    } else {
+        offset = writer->strings_size;
+        if (dm_id_index_insert(&writer->strings, str, len, (void*)(offset + 1)) == NULL) writer->error = 1;
+
+        if (writer->buf && writer->strings_offset + offset + len + 1 <= writer->buf_size) {
+            memcpy(writer->buf + writer->strings_offset + offset, str, len + 1);
+        }
+        writer->strings_size += len + 1;
+    }
+
+    dm_tsl_blob_write_u32(writer, (unsigned int)offset);
+}
+
+static void dm_tsl_blob_write_lite_property(dm_tsl_blob_writer_t* writer, const lite_property_t* lite_property);
+
+static void dm_tsl_blob_write_data_type(dm_tsl_blob_writer_t* writer, const data_type_t* data_type)
+{
+    const data_type_x_t* data_type_x = &data_type->value;
+    size_t index;
+
+    dm_tsl_blob_write_string(writer, data_type->type_str);
+    dm_tsl_blob_write_u8(writer, (unsigned char)data_type->type);
+
+    switch (data_type->type) {
+    case data_type_type_int:
+        dm_tsl_blob_write_u32(writer, (unsigned int)data_type_x->data_type_int_t.min);
+        dm_tsl_blob_write_u32(writer, (unsigned int)data_type_x->data_type_int_t.max);
+        break;
+    case data_type_type_float:
+        dm_tsl_blob_write_f64(writer, data_type_x->data_type_float_t.min);
+        dm_tsl_blob_write_f64(writer, data_type_x->data_type_float_t.max);
+        break;
+    case data_type_type_double:
+        dm_tsl_blob_write_f64(writer, data_type_x->data_type_double_t.min);
+        dm_tsl_blob_write_f64(writer, data_type_x->data_type_double_t.max);
+        break;
+    case data_type_type_enum:
+        dm_tsl_blob_write_u32(writer, (unsigned int)data_type_x->data_type_enum_t.enum_item_number);
+        break;
+    case data_type_type_bool:
+        dm_tsl_blob_write_u32(writer, (unsigned int)data_type_x->data_type_bool_t.bool_item_number);
+        break;
+    case data_type_type_text:
+        dm_tsl_blob_write_u32(writer, (unsigned int)data_type_x->data_type_text_t.length);
+        break;
+    case data_type_type_array:
+        dm_tsl_blob_write_u32(writer, (unsigned int)data_type_x->data_type_array_t.size);
+        dm_tsl_blob_write_u8(writer, (unsigned char)data_type_x->data_type_array_t.item_type);
+        break;
+    case data_type_type_struct:
+        dm_tsl_blob_write_u32(writer, (unsigned int)data_type->data_type_specs_number);
+        for (index = 0; index < data_type->data_type_specs_number; ++index) {
+            dm_tsl_blob_write_lite_property(writer, (const lite_property_t*)data_type->specs + index);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void dm_tsl_blob_write_lite_property(dm_tsl_blob_writer_t* writer, const lite_property_t* lite_property)
+{
+    dm_tsl_blob_write_string(writer, lite_property->identifier);
+    dm_tsl_blob_write_data_type(writer, &lite_property->data_type);
+}
+
+static void dm_tsl_blob_write_property(dm_tsl_blob_writer_t* writer, const property_t* property)
+{
+    dm_tsl_blob_write_string(writer, property->identifier);
+    dm_tsl_blob_write_u8(writer, (unsigned char)property->access_mode);
+    dm_tsl_blob_write_u8(writer, (unsigned char)property->required);
+    dm_tsl_blob_write_data_type(writer, &property->data_type);
+}
+
+static void dm_tsl_blob_write_lite_properties(dm_tsl_blob_writer_t* writer, const lite_property_t* lite_property, size_t number)
+{
+    size_t index;
+
+    dm_tsl_blob_write_u32(writer, (unsigned int)number);
+    for (index = 0; index < number; ++index) {
+        dm_tsl_blob_write_lite_property(writer, lite_property + index);
+    }
+}
+
+static void dm_tsl_blob_write_template(dm_tsl_blob_writer_t* writer, const dsl_template_t* dsl_template)
+{
+    const event_t* event;
+    const service_t* service;
+    size_t i, j;
+
+    dm_tsl_blob_write_string(writer, dsl_template->profile.product_key);
+    dm_tsl_blob_write_string(writer, dsl_template->profile.device_name);
+
+    dm_tsl_blob_write_u32(writer, (unsigned int)dsl_template->property_number);
+    for (i = 0; i < dsl_template->property_number; ++i) {
+        dm_tsl_blob_write_property(writer, dsl_template->properties + i);
+    }
+
+    dm_tsl_blob_write_u32(writer, (unsigned int)dsl_template->event_number);
+    for (i = 0; i < dsl_template->event_number; ++i) {
+        event = dsl_template->events + i;
+        dm_tsl_blob_write_string(writer, event->identifier);
+        dm_tsl_blob_write_string(writer, event->method);
+        dm_tsl_blob_write_string(writer, event->event_type_str);
+        dm_tsl_blob_write_u8(writer, (unsigned char)event->event_type);
+        dm_tsl_blob_write_u8(writer, (unsigned char)event->required);
+        dm_tsl_blob_write_lite_properties(writer, event->event_output_data, event->event_output_data_num);
+    }
+
+    dm_tsl_blob_write_u32(writer, (unsigned int)dsl_template->service_number);
+    for (i = 0; i < dsl_template->service_number; ++i) {
+        service = dsl_template->services + i;
+        dm_tsl_blob_write_string(writer, service->identifier);
+        dm_tsl_blob_write_string(writer, service->method);
+        dm_tsl_blob_write_string(writer, service->call_type);
+        dm_tsl_blob_write_u8(writer, (unsigned char)service->service_type);
+        dm_tsl_blob_write_u8(writer, (unsigned char)service->required);
+        dm_tsl_blob_write_lite_properties(writer, service->service_output_data, service->service_output_data_num);
+
+        dm_tsl_blob_write_u32(writer, (unsigned int)service->service_input_data_num);
+        for (j = 0; j < service->service_input_data_num; ++j) {
+            if (service->service_type == service_type_property_get) {
+                dm_tsl_blob_write_string(writer, service->service_input_data[j].property_to_get_name);
+            } else if (service->service_type == service_type_property_set) {
+                dm_tsl_blob_write_property(writer, &service->service_input_data[j].property_to_set);
+            } else {
+                dm_tsl_blob_write_lite_property(writer, &service->service_input_data[j].lite_property);
+            }
+        }
+    }
+}
+
+int dm_tsl_blob_write(const dsl_template_t* dsl_template, unsigned char* buf, size_t buf_size)
+{
+    dm_tsl_blob_writer_t writer;
+    size_t total_size;
+
+    if (dsl_template == NULL) return -1;
+
+    /* first pass measures records so the string table can follow them. */
+    memset(&writer, 0, sizeof(dm_tsl_blob_writer_t));
+    if (dm_id_index_init(&writer.strings, DM_TSL_BLOB_STRING_CAPACITY) != 0) return -1;
+    writer.pos = DM_TSL_BLOB_HEADER_SIZE;
+    dm_tsl_blob_write_template(&writer, dsl_template);
+    dm_id_index_deinit(&writer.strings);
+
+    total_size = writer.pos + writer.strings_size;
+    if (writer.error || total_size > DM_TSL_BLOB_MAX_SIZE) return -1;
+    if (buf == NULL || buf_size < total_size) return (int)total_size;
+
+    memset(buf, 0, total_size);
+    memcpy(buf, DM_TSL_BLOB_MAGIC, DM_TSL_BLOB_MAGIC_SIZE);
+    buf[4] = DM_TSL_BLOB_VERSION;
+    buf[6] = DM_TSL_BLOB_HEADER_SIZE;
+    dm_tsl_blob_put_u32(buf + 8, (unsigned int)total_size);
+    dm_tsl_blob_put_u32(buf + 12, (unsigned int)writer.pos);
+    dm_tsl_blob_put_u32(buf + 16, (unsigned int)writer.strings_size);
+    dm_tsl_blob_put_u32(buf + 20, DM_TSL_BLOB_HEADER_SIZE);
+
+    writer.strings_offset = writer.pos;
+    writer.strings_size = 0;
+    writer.pos = DM_TSL_BLOB_HEADER_SIZE;
+    writer.buf = buf;
+    writer.buf_size = buf_size;
+    if (dm_id_index_init(&writer.strings, DM_TSL_BLOB_STRING_CAPACITY) != 0) return -1;
+    dm_tsl_blob_write_template(&writer, dsl_template);
+    dm_id_index_deinit(&writer.strings);
+
+    return writer.error ? -1 : (int)total_size;
+}
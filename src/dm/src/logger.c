@@ -7,6 +7,7 @@
 #include "dm_import.h"
 
 #include "lite-log.h"
+#include "lite-log-ring.h"
 #include "iot_export.h"
 
 void* _g_default_logger = NULL;
@@ -65,6 +66,9 @@ static void logger_open(void* _self, void* _log_name)
     self->_log_name = _log_name;
 
     LITE_openlog(_log_name);
+
+    /* with WITH_LOG_RING, lines are formatted by the drain of the ring from now on. */
+    LITE_log_ring_start();
 }
 
 static void logger_close(const void* _self)
@@ -73,6 +77,7 @@ static void logger_close(const void* _self)
 
     self = self;
 
+    LITE_log_ring_stop();
     LITE_closelog();
 
     return;
@@ -125,8 +130,10 @@ static void logger_print_log(const void* _self, const char* _func, const int _li
     vsprintf(self->_log_buffer, fmt, *params);
     fprintf(stdout, "%s", self->_log_buffer);
 #else
-    /* use LITE-log functions. */
-    LITE_syslog_routine(_func, _line, _log_level, fmt, params);
+    /* use LITE-log functions, the ring keeps the line to be formatted later if it is started. */
+    if (LITE_log_ring_put(_func, _line, _log_level, fmt, params) != 0) {
+        LITE_syslog_routine(_func, _line, _log_level, fmt, params);
+    }
 #endif
     return;
 }
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include "interface/list_abstract.h"
 #include "single_list.h"
 #include "logger.h"
@@ -11,63 +12,59 @@ static const char string_single_list_clear_pattern[] __DM_READ_ONLY__ = "slist(%
 static const char string_single_list_insert[] __DM_READ_ONLY__ = "insert";
 static const char string_single_list_remove[] __DM_READ_ONLY__ = "remove";
 
-static void single_list_insert(void* _self, void* data);
-static void single_list_clear(void* _self);
-
 static void* single_list_ctor(void* _self, va_list* params)
 {
     single_list_t* self = _self;
 
-    self->_head = (node_t*)dm_lite_calloc(1, sizeof(node_t));
-
-    if (self->_head == NULL) return NULL;
-
-    self->_head->next = NULL;
-    self->_head->data = NULL;
+    self->_items = self->_inline;
     self->_size = 0;
+    self->_capacity = SINGLE_LIST_INLINE_NUM;
 
     self->_name = va_arg(*params, char*);
 
-    if (self->_name == NULL) goto err_handler;
+    if (self->_name == NULL) return NULL;
 
     return self;
-
-err_handler:
-    if (self->_head) dm_lite_free(self->_head);
-    if (self->_name) dm_lite_free(self->_name);
-
-    return NULL;
 }
 
 static void* single_list_dtor(void* _self)
 {
     single_list_t* self = _self;
-    node_t** p = &self->_head;
 
-    self->_size = 0;
+    if (self->_items != self->_inline) dm_lite_free(self->_items);
 
-    while ((*p) != NULL) {
-        node_t* node = *p;
-        *p = node->next;
-        dm_lite_free(node);
-    }
+    self->_items = self->_inline;
+    self->_size = 0;
+    self->_capacity = SINGLE_LIST_INLINE_NUM;
 
     return self;
 }
 
+static int single_list_grow(single_list_t* self)
+{
+    void** items = (void**)dm_lite_calloc(self->_capacity * 2, sizeof(void*));
+
+    if (items == NULL) return -1;
+
+    memcpy(items, self->_items, self->_size * sizeof(void*));
+    if (self->_items != self->_inline) dm_lite_free(self->_items);
+
+    self->_items = items;
+    self->_capacity *= 2;
+
+    return 0;
+}
+
 static void single_list_insert(void* _self, void* data)
 {
     single_list_t* self = _self;
-    node_t* node = (node_t*)dm_lite_calloc(1, sizeof(node_t));
 
-    node_t** p = (node_t**)&self->_head;
-    for (; (*p) != NULL; p = &(*p)->next)
-        ;
+    if (self->_size == self->_capacity && single_list_grow(self) != 0) {
+        dm_log_err("slist(%s) insert failed, size:%d", self->_name, self->_size);
+        return;
+    }
 
-    node->data = data;
-    node->next = *p;
-    *p = node;
-    self->_size++;
+    self->_items[self->_size++] = data;
 
     printf(string_single_list_log_pattern, self->_name, string_single_list_insert, self->_size);
 }
@@ -75,32 +72,24 @@ static void single_list_insert(void* _self, void* data)
 static void single_list_remove(void* _self, void* data)
 {
     single_list_t* self = _self;
-    node_t** p = (node_t**)&self->_head;
-
-    while ((*p) != NULL) {
-        node_t* node = *p;
-        if (node->data == data) {
-            *p = node->next;
-            self->_size--;
-            printf(string_single_list_log_pattern, self->_name, string_single_list_remove, self->_size);
-            dm_lite_free(node);
-        } else {
-            p = &(*p)->next;
-        }
+    int i, j;
+
+    /* what is kept moves down in place, in the order it was inserted. */
+    for (i = 0, j = 0; i < self->_size; ++i) {
+        if (self->_items[i] != data) self->_items[j++] = self->_items[i];
+    }
+
+    if (j != self->_size) {
+        self->_size = j;
+        printf(string_single_list_log_pattern, self->_name, string_single_list_remove, self->_size);
     }
 }
 
 static void single_list_clear(void* _self)
 {
     single_list_t* self = _self;
-    node_t** p = (node_t**)&self->_head->next;
 
-    while ((*p) != NULL) {
-        node_t* node = *p;
-        *p = node->next;
-        dm_lite_free(node);
-    }
-    self->_head->next = NULL;
+    /* the storage grown is kept for the list to be filled again. */
     self->_size = 0;
     printf(string_single_list_clear_pattern, self->_name);
 }
@@ -109,7 +98,7 @@ static int single_list_empty(const void* _self)
 {
     const single_list_t* self = _self;
 
-    return self->_head == NULL;
+    return self->_size == 0;
 }
 
 static int single_list_get_size(const void* _self)
@@ -119,15 +108,16 @@ static int single_list_get_size(const void* _self)
     return self->_size;
 }
 
+/* by index, _items is read again each time as a handler may insert into the list. */
 static void single_list_iterator(const void* _self, handle_fp_t handle_fn, va_list* params)
 {
     const single_list_t* self = _self;
-    node_t** p = &self->_head->next;
+    int i;
 
-    for (; (*p) != NULL; p = &(*p)->next) {
+    for (i = 0; i < self->_size; ++i) {
         va_list args;
         va_copy(args, *params);
-        handle_fn((*p)->data, &args);
+        handle_fn(self->_items[i], &args);
         va_end(args);
     }
 }
@@ -142,14 +132,34 @@ void list_iterator(const void* _list, handle_fp_t handle_fn, ...)
     va_end(params);
 }
 
+static int single_list_visit(const void* _self, visit_fp_t visit_fn, void* ctx)
+{
+    const single_list_t* self = _self;
+    int i;
+    int ret;
+
+    for (i = 0; i < self->_size; ++i) {
+        ret = visit_fn(self->_items[i], ctx);
+        if (ret) return ret;
+    }
+
+    return 0;
+}
+
+int list_visit(const void* _list, visit_fp_t visit_fn, void* ctx)
+{
+    const list_t** list = (const list_t**)_list;
+
+    return (*list)->visit(list, visit_fn, ctx);
+}
+
 static void single_list_print(const void* _self, print_fp_t print_fn)
 {
     const single_list_t* self = _self;
-    node_t** p = &self->_head->next;
+    int i;
 
-    while ((*p) != NULL) {
-        print_fn((*p)->data);
-        p = &(*p)->next;
+    for (i = 0; i < self->_size; ++i) {
+        print_fn(self->_items[i]);
     }
 }
 
@@ -165,6 +175,7 @@ static const list_t _single_list_class = {
     single_list_get_size,
     single_list_iterator,
     single_list_print,
+    single_list_visit,
 };
 
 const void* get_single_list_class()
@@ -10,6 +10,103 @@
 #include "iot_export_cmp.h"
 #include "iot_export_errno.h"
 #include "lite-utils.h"
+#include "lite-startup.h"
+#include "lite-system.h"
+#include "utils_md5.h"
+#include "utils_sha256.h"
+#include "utils_httpc.h"
+#include "utils_identity.h"
+#include "service_ota_delta.h"
+
+/* what is written of an image, in HAL_Kv_Set() to go on after a reboot */
+#define SERVICE_OTA_PROGRESS_KEY            "fota.progress"
+#define SERVICE_OTA_PROGRESS_MAGIC          (0x46505247)
+
+/* the progress is saved each time this much more is written, not to wear the flash */
+#ifndef SERVICE_OTA_PROGRESS_STEP
+    #define SERVICE_OTA_PROGRESS_STEP       (16 * 1024)
+#endif
+
+/* fetches with no byte written before giving up, the wait doubles from 1s after each */
+#ifndef SERVICE_OTA_RESUME_RETRY_MAX
+    #define SERVICE_OTA_RESUME_RETRY_MAX    (6)
+#endif
+
+#define SERVICE_OTA_FETCH_TIMEOUT_MS        (10 * 1000)
+
+/* connections fetching disjoint ranges of an image at once, for fast uplinks, 1 to fetch it in one stream */
+#ifndef SERVICE_OTA_PARALLEL_RANGES
+    #define SERVICE_OTA_PARALLEL_RANGES     (1)
+#endif
+
+/* smaller images are fetched in one stream, the connections would cost more than they save */
+#ifndef SERVICE_OTA_PARALLEL_MIN_SIZE
+    #define SERVICE_OTA_PARALLEL_MIN_SIZE   (1024 * 1024)
+#endif
+
+/* buffers of a download being written while the next is fetched, 1 to write each before fetching on */
+#ifndef SERVICE_OTA_PIPELINE_BUFFERS
+    #define SERVICE_OTA_PIPELINE_BUFFERS    (2)
+#endif
+
+#ifndef SERVICE_OTA_WRITER_STACK_SIZE
+    #define SERVICE_OTA_WRITER_STACK_SIZE   (0)
+#endif
+
+/* each chunk written is read back and compared, in pieces of this size on the stack */
+#ifdef SERVICE_OTA_VERIFY_READ_BACK
+    #ifndef SERVICE_OTA_READ_BACK_LEN
+        #define SERVICE_OTA_READ_BACK_LEN   (128)
+    #endif
+#endif
+
+/* the digest of the image written, kept up chunk by chunk */
+#ifdef SERVICE_OTA_DIGEST_SHA256
+    #define SERVICE_OTA_DIGEST_NAME         "sha256"
+    #define SERVICE_OTA_DIGEST_LEN          (32)
+    typedef iot_sha256_context              service_ota_digest_t;
+    #define service_ota_digest_starts(ctx)  do { utils_sha256_init(ctx); utils_sha256_starts(ctx); } while (0)
+    #define service_ota_digest_update       utils_sha256_update
+    #define service_ota_digest_finish       utils_sha256_finish
+    #define service_ota_digest_free         utils_sha256_free
+#else
+    #define SERVICE_OTA_DIGEST_NAME         "md5"
+    #define SERVICE_OTA_DIGEST_LEN          (16)
+    typedef iot_md5_context                 service_ota_digest_t;
+    #define service_ota_digest_starts(ctx)  do { utils_md5_init(ctx); utils_md5_starts(ctx); } while (0)
+    #define service_ota_digest_update       utils_md5_update
+    #define service_ota_digest_finish       utils_md5_finish
+    #define service_ota_digest_free         utils_md5_free
+#endif
+
+typedef struct {
+    uint32_t                magic;
+    uint32_t                size;
+    uint32_t                offset;                                 /* written and digested */
+    char                    version[FIRMWARE_VERSION_MAXLEN];
+    service_ota_digest_t    digest;                                 /* of the first 'offset' bytes */
+} service_ota_progress_t;
+
+/*
+ * A ring of the buffer of the caller and SERVICE_OTA_PIPELINE_BUFFERS - 1 more of its size. The fetch
+ * fills them in turn from 'head' and the writer thread writes them from 'tail', the semaphores count
+ * the free and the filled ones. With one buffer each is written by the fetch before it goes on.
+ */
+typedef struct {
+    service_ota_t*          self;
+    service_ota_progress_t* progress;
+    char*                   buf[SERVICE_OTA_PIPELINE_BUFFERS];
+    int                     len[SERVICE_OTA_PIPELINE_BUFFERS];
+    int                     count;
+    int                     head;
+    int                     tail;
+    int                     ret;                                    /* of the first write failed */
+    int                     stop;
+    service_ota_delta_t*    delta;                                  /* a patch being applied, not a whole image */
+    void*                   sem_free;
+    void*                   sem_full;
+    void*                   sem_exit;
+} service_ota_pipe_t;
 
 
 static void service_ota_handler(void* pcontext, iotx_cmp_fota_parameter_t* ota_parameter, void* user_data)
@@ -29,6 +126,14 @@ static void service_ota_handler(void* pcontext, iotx_cmp_fota_parameter_t* ota_p
     strcpy(service_ota->_ota_version, iotx_cmp_ota_parameter->version);
     log_debug("new OTA version %s", service_ota->_ota_version);
 
+    if (service_ota->_ota_url) service_ota_lite_free(service_ota->_ota_url);
+
+    service_ota->_ota_url = service_ota_lite_calloc(1, strlen(iotx_cmp_ota_parameter->purl) + 1);
+    if (service_ota->_ota_url != NULL) {
+        strcpy(service_ota->_ota_url, iotx_cmp_ota_parameter->purl);
+    }
+    service_ota->_ota_size = iotx_cmp_ota_parameter->size_file;
+
     /* invoke callback funtions. */
     if (service_ota->_linkkit_callback_fp) {
         ((handle_service_fota_callback_fp_t)service_ota->_linkkit_callback_fp)(service_fota_callback_type_new_version_detected, service_ota->_ota_version);
@@ -46,11 +151,13 @@ static void service_ota_cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t*
         if (service_ota->_ota_inited == 0) {
             if (service_ota->_destructing == 1) return;
 
-            HAL_GetFirmwareVesion(service_ota->_current_verison);
+            strncpy(service_ota->_current_verison, utils_identity_get()->firmware_version, FIRMWARE_VERSION_MAXLEN);
 
             log_info("Current firmware version: %s", service_ota->_current_verison);
 
+            LITE_STARTUP_BEGIN(LITE_STARTUP_OTA_REPORT);
             ret = IOT_CMP_OTA_Start(service_ota->_current_verison, NULL);
+            LITE_STARTUP_END(LITE_STARTUP_OTA_REPORT, ret == SUCCESS_RETURN);
             if (ret == SUCCESS_RETURN) {
                 service_ota->_ota_inited = 1;
             }
@@ -99,6 +206,7 @@ static void* service_ota_dtor(void* _self)
     self->_data_buf = NULL;
     self->_data_buf_length = 0;
     if (self->_ota_version) service_ota_lite_free(self->_ota_version);
+    if (self->_ota_url) service_ota_lite_free(self->_ota_url);
     if (self->_current_verison) service_ota_lite_free(self->_current_verison);
 
     return self;
@@ -146,11 +254,739 @@ static int service_ota_end(void* _self)
     return ret;
 }
 
+/* the stats of a download, a field is updated by one thread at a time: the fetch, the writer or a range under its lock */
+static void service_ota_stats_start(service_ota_t* self)
+{
+    memset(&self->_stats, 0, sizeof(service_ota_stats_t));
+    self->_stats.size = self->_ota_size;
+    self->_stats.result = 1;
+    self->_stats_start_ms = self->_stats_write_end_ms = HAL_UptimeMs();
+}
+
+static void service_ota_stats_fetched(service_ota_t* self, int len)
+{
+    if (0 == self->_stats.first_byte_ms) {
+        self->_stats.first_byte_ms = (uint32_t)(HAL_UptimeMs() - self->_stats_start_ms);
+        if (0 == self->_stats.first_byte_ms) self->_stats.first_byte_ms = 1;
+    }
+    self->_stats.fetched += len;
+}
+
+/* the fetch waited from 'since' for the writes */
+static void service_ota_stats_fetch_stall(service_ota_t* self, uint64_t since)
+{
+    self->_stats.fetch_stall_ms += (uint32_t)(HAL_UptimeMs() - since);
+}
+
+/* a write of 'len' bytes started at 'since', the time from the last one is what it waited for the fetch */
+static void service_ota_stats_written(service_ota_t* self, uint64_t since, int len)
+{
+    uint64_t now = HAL_UptimeMs();
+
+    if (since > self->_stats_write_end_ms) self->_stats.write_stall_ms += (uint32_t)(since - self->_stats_write_end_ms);
+    self->_stats.write_ms += (uint32_t)(now - since);
+    self->_stats.written += len;
+    self->_stats_write_end_ms = now;
+}
+
+static void service_ota_stats_resumed(service_ota_t* self, uint32_t offset)
+{
+    self->_stats.resumes++;
+    self->_stats.resume_offset = offset;
+}
+
+static void service_ota_stats_get(service_ota_t* self, service_ota_stats_t* stats)
+{
+    uint32_t fetching;
+
+    *stats = self->_stats;
+    if (1 == stats->result) stats->elapsed_ms = (uint32_t)(HAL_UptimeMs() - self->_stats_start_ms);
+
+    fetching = stats->elapsed_ms > stats->fetch_stall_ms ? stats->elapsed_ms - stats->fetch_stall_ms : 0;
+    stats->fetch_bytes_per_s = fetching ? (uint32_t)((uint64_t)stats->fetched * 1000 / fetching) : 0;
+    stats->write_bytes_per_s = stats->write_ms ? (uint32_t)((uint64_t)stats->written * 1000 / stats->write_ms) : 0;
+}
+
+/* logs the stats and hands them to the linkkit callback, before the device restarts after a download done */
+static void service_ota_stats_finish(service_ota_t* self, int result)
+{
+    service_ota_stats_t stats;
+
+    self->_stats.elapsed_ms = (uint32_t)(HAL_UptimeMs() - self->_stats_start_ms);
+    self->_stats.result = result;
+    service_ota_stats_get(self, &stats);
+
+    log_info("service fota %s: %u of %u bytes in %u ms, first byte %u ms, fetch %u B/s stalled %u ms, "
+             "write %u B/s stalled %u ms, %u retries, %u resumes last at %u", result ? "failed" : "done",
+             stats.written, stats.size, stats.elapsed_ms, stats.first_byte_ms, stats.fetch_bytes_per_s,
+             stats.fetch_stall_ms, stats.write_bytes_per_s, stats.write_stall_ms, stats.retries, stats.resumes,
+             stats.resume_offset);
+
+    if (self->_linkkit_callback_fp) {
+        ((handle_service_fota_callback_fp_t)self->_linkkit_callback_fp)(service_fota_callback_type_download_finished,
+                                                                        self->_ota_version);
+    }
+}
+
+/* a saved progress of the version to fetch is gone on with if what it counts is still written */
+static int service_ota_progress_load(service_ota_t* self, service_ota_progress_t* progress)
+{
+    int len = sizeof(service_ota_progress_t);
+
+    if (NULL == self->_ota_version || NULL == self->_ota_url) return -1;
+
+    if (0 != HAL_Kv_Get(SERVICE_OTA_PROGRESS_KEY, progress, &len) || len != sizeof(service_ota_progress_t) ||
+        SERVICE_OTA_PROGRESS_MAGIC != progress->magic || progress->size != self->_ota_size ||
+        progress->offset >= progress->size ||
+        0 != strncmp(progress->version, self->_ota_version, FIRMWARE_VERSION_MAXLEN)) {
+        return -1;
+    }
+
+    if (0 != HAL_Firmware_Persistence_Resume(progress->offset)) {
+        log_info("saved fota progress of %s not resumable", progress->version);
+        return -1;
+    }
+
+    log_info("fota of %s resumed at %u of %u bytes", progress->version, progress->offset, progress->size);
+    return 0;
+}
+
+static void service_ota_progress_reset(service_ota_t* self, service_ota_progress_t* progress)
+{
+    memset(progress, 0, sizeof(service_ota_progress_t));
+    progress->magic = SERVICE_OTA_PROGRESS_MAGIC;
+    progress->size = self->_ota_size;
+    if (self->_ota_version) {
+        strncpy(progress->version, self->_ota_version, FIRMWARE_VERSION_MAXLEN - 1);
+    }
+    service_ota_digest_starts(&progress->digest);
+
+    service_ota_start(self);
+}
+
+int service_ota_flash_write(uint32_t offset, const char* data, int data_length)
+{
+#ifdef SERVICE_OTA_VERIFY_READ_BACK
+    char back[SERVICE_OTA_READ_BACK_LEN];
+    int pos, len;
+#endif
+
+    if (0 != HAL_Firmware_Persistence_Write((char*)data, data_length)) return -1;
+
+#ifdef SERVICE_OTA_VERIFY_READ_BACK
+    /* while the chunk is still here, the image is not read again as a whole before it is used */
+    for (pos = 0; pos < data_length; pos += len) {
+        len = data_length - pos < SERVICE_OTA_READ_BACK_LEN ? data_length - pos : SERVICE_OTA_READ_BACK_LEN;
+        if (len != HAL_Firmware_Persistence_Read(offset + pos, back, len) || 0 != memcmp(back, data + pos, len)) {
+            log_err("fota read back differs at %u", offset + pos);
+            return -1;
+        }
+    }
+#else
+    (void)offset;
+#endif
+
+    return 0;
+}
+
+/* writes a chunk at the offset of the progress and saves the progress each SERVICE_OTA_PROGRESS_STEP */
+static int service_ota_progress_write(service_ota_t* self, service_ota_progress_t* progress, void* data, int data_length)
+{
+    uint32_t offset = progress->offset;
+    int ret;
+
+    /* not service_ota_write(), the chunk is in any buffer of the pipe */
+    ret = service_ota_flash_write(offset, data, data_length);
+    if (ret) return ret;
+
+    self->_total_len += data_length;
+    service_ota_digest_update(&progress->digest, data, data_length);
+    progress->offset += data_length;
+    if (offset / SERVICE_OTA_PROGRESS_STEP != progress->offset / SERVICE_OTA_PROGRESS_STEP) {
+        (void)HAL_Kv_Set(SERVICE_OTA_PROGRESS_KEY, progress, sizeof(service_ota_progress_t), 0);
+    }
+
+    return 0;
+}
+
+/*
+ * A download starting with SERVICE_OTA_DELTA_MAGIC is a patch of the running image, applied as it comes.
+ * What is written of the image does not tell how far the patch is applied, it is not saved to go on with.
+ */
+static int service_ota_pipe_write(service_ota_pipe_t* pipe, char* data, int data_length)
+{
+    service_ota_progress_t* progress = pipe->progress;
+    uint64_t since = HAL_UptimeMs();
+    int ret = 0;
+
+    if (0 == progress->offset && NULL == pipe->delta && service_ota_delta_is_patch(data, data_length)) {
+        pipe->delta = service_ota_delta_open();
+        if (NULL == pipe->delta) return -1;
+    }
+
+    if (NULL == pipe->delta) {
+        ret = service_ota_progress_write(pipe->self, progress, data, data_length);
+    } else if (0 != service_ota_delta_write(pipe->delta, data, data_length)) {
+        ret = -1;
+    } else {
+        pipe->self->_total_len += data_length;
+        progress->offset += data_length;
+    }
+
+    if (0 == ret) service_ota_stats_written(pipe->self, since, data_length);
+    return ret;
+}
+
+static void* service_ota_pipe_writer(void* arg)
+{
+    service_ota_pipe_t* pipe = arg;
+
+    for (;;) {
+        (void)HAL_SemaphoreWait(pipe->sem_full, PLATFORM_WAIT_INFINITE);
+        if (pipe->stop) break;
+
+        /* after a failed write the rest is dropped, the fetch sees 'ret' */
+        if (0 == pipe->ret) {
+            pipe->ret = service_ota_pipe_write(pipe, pipe->buf[pipe->tail], pipe->len[pipe->tail]);
+        }
+        pipe->tail = (pipe->tail + 1) % pipe->count;
+        HAL_SemaphorePost(pipe->sem_free);
+    }
+
+    HAL_SemaphorePost(pipe->sem_exit);
+    return NULL;
+}
+
+static void service_ota_pipe_release(service_ota_pipe_t* pipe)
+{
+    int i;
+
+    for (i = 1; i < SERVICE_OTA_PIPELINE_BUFFERS; i++) {
+        if (pipe->buf[i]) service_ota_lite_free(pipe->buf[i]);
+    }
+    if (pipe->sem_free) HAL_SemaphoreDestroy(pipe->sem_free);
+    if (pipe->sem_full) HAL_SemaphoreDestroy(pipe->sem_full);
+    if (pipe->sem_exit) HAL_SemaphoreDestroy(pipe->sem_exit);
+    pipe->sem_free = pipe->sem_full = pipe->sem_exit = NULL;
+    pipe->count = 1;
+}
+
+/* the writes go on in a thread of their own only if the HAL lets them, written in turn otherwise */
+static void service_ota_pipe_open(service_ota_pipe_t* pipe, service_ota_t* self, service_ota_progress_t* progress)
+{
+    void* thread = NULL;
+    hal_os_thread_param_t param;
+    int i;
+
+    memset(pipe, 0, sizeof(service_ota_pipe_t));
+    pipe->self = self;
+    pipe->progress = progress;
+    pipe->buf[0] = self->_data_buf;
+    pipe->count = 1;
+
+    if (SERVICE_OTA_PIPELINE_BUFFERS < 2 || 1 != HAL_Firmware_Persistence_Async()) return;
+
+    for (i = 1; i < SERVICE_OTA_PIPELINE_BUFFERS; i++) {
+        pipe->buf[i] = service_ota_lite_malloc(self->_data_buf_length);
+        if (NULL == pipe->buf[i]) {
+            log_info("no memory for fota buffers, written before fetching on");
+            service_ota_pipe_release(pipe);
+            return;
+        }
+    }
+
+    pipe->sem_free = HAL_SemaphoreCreate();
+    pipe->sem_full = HAL_SemaphoreCreate();
+    pipe->sem_exit = HAL_SemaphoreCreate();
+    if (NULL == pipe->sem_free || NULL == pipe->sem_full || NULL == pipe->sem_exit) {
+        log_err("create semaphore error, fota written before fetching on");
+        service_ota_pipe_release(pipe);
+        return;
+    }
+
+    pipe->count = SERVICE_OTA_PIPELINE_BUFFERS;
+    memset(&param, 0, sizeof(param));
+    param.stack_size = SERVICE_OTA_WRITER_STACK_SIZE;
+    param.name = "fota_writer";
+    if (0 != HAL_ThreadCreate(&thread, service_ota_pipe_writer, pipe, &param, NULL)) {
+        log_err("create thread error, fota written before fetching on");
+        service_ota_pipe_release(pipe);
+        return;
+    }
+    /* sem_exit tells when it ends */
+    HAL_ThreadDetach(thread);
+
+    for (i = 0; i < pipe->count; i++) HAL_SemaphorePost(pipe->sem_free);
+}
+
+/* the next buffer to fetch into, once the writer is done with it */
+static char* service_ota_pipe_get(service_ota_pipe_t* pipe)
+{
+    uint64_t since;
+
+    if (pipe->count > 1) {
+        since = HAL_UptimeMs();
+        (void)HAL_SemaphoreWait(pipe->sem_free, PLATFORM_WAIT_INFINITE);
+        service_ota_stats_fetch_stall(pipe->self, since);
+    }
+
+    return pipe->buf[pipe->head];
+}
+
+/* hands the buffer of service_ota_pipe_get() with 'len' bytes fetched to the writer, it is kept when empty */
+static int service_ota_pipe_put(service_ota_pipe_t* pipe, int len)
+{
+    uint64_t since;
+
+    if (pipe->count == 1) {
+        if (len <= 0 || pipe->ret) return pipe->ret;
+        /* the fetch waits for the write */
+        since = HAL_UptimeMs();
+        pipe->ret = service_ota_pipe_write(pipe, pipe->buf[0], len);
+        service_ota_stats_fetch_stall(pipe->self, since);
+        return pipe->ret;
+    }
+
+    if (len <= 0) {
+        HAL_SemaphorePost(pipe->sem_free);
+    } else {
+        pipe->len[pipe->head] = len;
+        pipe->head = (pipe->head + 1) % pipe->count;
+        HAL_SemaphorePost(pipe->sem_full);
+    }
+
+    return pipe->ret;
+}
+
+/* waits until all that is fetched is written, the progress counts it then */
+static int service_ota_pipe_drain(service_ota_pipe_t* pipe)
+{
+    int i;
+
+    if (pipe->count > 1) {
+        for (i = 0; i < pipe->count; i++) (void)HAL_SemaphoreWait(pipe->sem_free, PLATFORM_WAIT_INFINITE);
+        for (i = 0; i < pipe->count; i++) HAL_SemaphorePost(pipe->sem_free);
+    }
+
+    return pipe->ret;
+}
+
+static int service_ota_pipe_close(service_ota_pipe_t* pipe)
+{
+    int ret = service_ota_pipe_drain(pipe);
+
+    if (pipe->count > 1) {
+        pipe->stop = 1;
+        HAL_SemaphorePost(pipe->sem_full);
+        (void)HAL_SemaphoreWait(pipe->sem_exit, PLATFORM_WAIT_INFINITE);
+        service_ota_pipe_release(pipe);
+    }
+    if (pipe->delta) {
+        service_ota_delta_close(pipe->delta);
+        pipe->delta = NULL;
+    }
+
+    return ret;
+}
+
+/* a range fetch the body of which is written as it comes */
+typedef struct {
+    service_ota_t*          self;
+    service_ota_pipe_t*     pipe;
+    httpclient_t*           http;
+    httpclient_data_t*      http_data;
+    uint32_t                fetched;
+    int                     checked;
+    int                     held;                                   /* response_buf is from service_ota_pipe_get() */
+    int                     written;                                /* something written, the retries start over */
+    int                     failed;                                 /* not to be fetched again */
+} service_ota_fetch_t;
+
+/* the body of the range response, in the buffer of the pipe it is written from */
+static int service_ota_fetch_body(void* _fetch, char* data, int len)
+{
+    service_ota_fetch_t* fetch = _fetch;
+    service_ota_progress_t* progress = fetch->pipe->progress;
+
+    if (!fetch->checked) {
+        fetch->checked = 1;
+        if (200 == fetch->http->response_code && (uint32_t)fetch->http_data->response_content_len == progress->size) {
+            log_info("fota server ignores range, fetching from the start");
+            if (fetch->pipe->delta) {
+                service_ota_delta_close(fetch->pipe->delta);
+                fetch->pipe->delta = NULL;
+            }
+            service_ota_progress_reset(fetch->self, progress);
+            fetch->self->_total_len = 0;
+            fetch->fetched = 0;
+            fetch->self->_stats.resume_offset = 0;
+        } else if (206 != fetch->http->response_code ||
+                   (uint32_t)fetch->http_data->response_content_len != progress->size - progress->offset) {
+            log_err("fota range fetch got %d, %d bytes", fetch->http->response_code,
+                    fetch->http_data->response_content_len);
+            return -1;
+        }
+    }
+
+    if (fetch->fetched + len > progress->size) {
+        log_err("fota fetch beyond %u bytes", progress->size);
+        fetch->failed = 1;
+        return -1;
+    }
+
+    /* the bytes read along with the headers */
+    if (data != fetch->http_data->response_buf) memcpy(fetch->http_data->response_buf, data, len);
+    service_ota_stats_fetched(fetch->self, len);
+
+    fetch->held = 0;
+    if (0 != service_ota_pipe_put(fetch->pipe, len)) {
+        log_err("fota write failed at %u of %u bytes", fetch->fetched, progress->size);
+        fetch->failed = 1;
+        return -1;
+    }
+    fetch->fetched += len;
+    fetch->written = 1;
+
+    fetch->http_data->response_buf = service_ota_pipe_get(fetch->pipe);
+    fetch->held = 1;
+    return 0;
+}
+
+/*
+ * Fetches the rest of the image from the offset of the progress with a "Range:" request, again after
+ * each failure. A server ignoring the range sends the image from its first byte, written anew. The
+ * body is read straight into the buffers of the pipe, SERVICE_OTA_FETCH_TIMEOUT_MS for each read.
+ */
+static int service_ota_fetch_range(service_ota_t* self, service_ota_pipe_t* pipe)
+{
+    service_ota_progress_t* progress = pipe->progress;
+    httpclient_t http;
+    httpclient_data_t http_data;
+    service_ota_fetch_t fetch;
+    char header[48];
+    int retry = 0, ret;
+
+    if (NULL == self->_ota_url) return -1;
+
+    for (;;) {
+        /* a request goes on from what is written, not from what was fetched before it broke */
+        if (0 != service_ota_pipe_drain(pipe)) {
+            log_err("fota write failed at %u of %u bytes", progress->offset, progress->size);
+            return -1;
+        }
+        if (progress->offset >= progress->size) return 0;
+
+        if (retry >= SERVICE_OTA_RESUME_RETRY_MAX) {
+            log_err("fota fetch failed at %u of %u bytes", progress->offset, progress->size);
+            return -1;
+        }
+        if (retry) {
+            self->_stats.retries++;
+            HAL_SleepMs(1000 << (retry - 1));
+        }
+        retry++;
+        if (progress->offset > 0) service_ota_stats_resumed(self, progress->offset);
+
+        memset(&http, 0, sizeof(httpclient_t));
+        memset(&http_data, 0, sizeof(httpclient_data_t));
+        memset(&fetch, 0, sizeof(service_ota_fetch_t));
+        HAL_Snprintf(header, sizeof(header), "Range: bytes=%u-\r\n", progress->offset);
+        http.header = header;
+        fetch.self = self;
+        fetch.pipe = pipe;
+        fetch.http = &http;
+        fetch.http_data = &http_data;
+        fetch.fetched = progress->offset;
+
+        http_data.response_buf = service_ota_pipe_get(pipe);
+        http_data.response_buf_len = self->_data_buf_length;
+        http_data.on_body = service_ota_fetch_body;
+        http_data.on_body_ctx = &fetch;
+        fetch.held = 1;
+#ifndef IOTX_WITHOUT_ITLS
+        ret = httpclient_common(&http, self->_ota_url, 80, iotx_ca_get(), HTTPCLIENT_GET,
+                                SERVICE_OTA_FETCH_TIMEOUT_MS, &http_data);
+#else
+        ret = httpclient_common(&http, self->_ota_url, 443, iotx_ca_get(), HTTPCLIENT_GET,
+                                SERVICE_OTA_FETCH_TIMEOUT_MS, &http_data);
+#endif
+        if (fetch.held) (void)service_ota_pipe_put(pipe, 0);
+        httpclient_close(&http);
+
+        if (fetch.failed) return -1;
+        if (fetch.written) retry = 0;
+        if (ret || fetch.fetched < progress->size) {
+            log_info("fota fetch broken at %u of %u bytes, try %d", fetch.fetched, progress->size, retry);
+        }
+    }
+}
+
+#if SERVICE_OTA_PARALLEL_RANGES > 1
+/* one of the disjoint ranges of an image fetched at once, each on a connection and thread of its own */
+typedef struct service_ota_ranges_s service_ota_ranges_t;
+
+typedef struct {
+    service_ota_ranges_t*   ranges;
+    httpclient_t*           http;
+    httpclient_data_t*      http_data;
+    char*                   buf;
+    uint32_t                start;
+    uint32_t                offset;                                 /* written up to */
+    uint32_t                end;
+    int                     checked;
+    int                     written;
+    int                     ret;
+} service_ota_range_t;
+
+struct service_ota_ranges_s {
+    service_ota_t*          self;
+    service_ota_range_t     range[SERVICE_OTA_PARALLEL_RANGES];
+    void*                   lock;                                   /* writes of the ranges one at a time */
+    void*                   sem_exit;
+    int                     stop;                                   /* all stop once one failed for good */
+};
+
+/* the result of a range when the image is to be fetched in order, a patch or a server ignoring ranges */
+#define SERVICE_OTA_RANGE_IN_ORDER          (1)
+
+static int service_ota_range_body(void* _range, char* data, int len)
+{
+    service_ota_range_t* range = _range;
+    service_ota_ranges_t* ranges = range->ranges;
+    uint64_t since, written;
+    int ret;
+
+    if (ranges->stop) return -1;
+
+    if (!range->checked) {
+        range->checked = 1;
+        if (206 != range->http->response_code ||
+            (uint32_t)range->http_data->response_content_len != range->end - range->offset) {
+            log_err("fota range %u-%u got %d, %d bytes", range->offset, range->end - 1, range->http->response_code,
+                    range->http_data->response_content_len);
+            /* the server ignoring ranges is not going to take them on the next try either */
+            if (200 == range->http->response_code) range->ret = SERVICE_OTA_RANGE_IN_ORDER;
+            return -1;
+        }
+        if (0 == range->offset && service_ota_delta_is_patch(data, len)) {
+            range->ret = SERVICE_OTA_RANGE_IN_ORDER;
+            return -1;
+        }
+    }
+
+    if (range->offset + len > range->end) {
+        log_err("fota range %u-%u fetch beyond it", range->start, range->end - 1);
+        range->ret = -1;
+        return -1;
+    }
+
+    /* the fetch of this range waits for the writes of all of them */
+    since = HAL_UptimeMs();
+    HAL_MutexLock(ranges->lock);
+    service_ota_stats_fetched(ranges->self, len);
+    written = HAL_UptimeMs();
+    ret = HAL_Firmware_Persistence_WriteAt(range->offset, data, len);
+    if (0 == ret) service_ota_stats_written(ranges->self, written, len);
+    service_ota_stats_fetch_stall(ranges->self, since);
+    HAL_MutexUnlock(ranges->lock);
+    if (0 != ret) {
+        log_err("fota write failed at %u", range->offset);
+        range->ret = -1;
+        return -1;
+    }
+
+    range->offset += len;
+    range->written = 1;
+    return 0;
+}
+
+/* fetches the rest of a range, again after each failure as service_ota_fetch_range() does */
+static void* service_ota_range_fetch(void* arg)
+{
+    service_ota_range_t* range = arg;
+    service_ota_ranges_t* ranges = range->ranges;
+    httpclient_t http;
+    httpclient_data_t http_data;
+    char header[48];
+    int retry = 0;
+
+    range->http = &http;
+    range->http_data = &http_data;
+
+    while (0 == range->ret && range->offset < range->end) {
+        if (ranges->stop) {
+            range->ret = -1;
+            break;
+        }
+        if (retry >= SERVICE_OTA_RESUME_RETRY_MAX) {
+            log_err("fota range %u-%u failed at %u", range->start, range->end - 1, range->offset);
+            range->ret = -1;
+            break;
+        }
+        if (retry) HAL_SleepMs(1000 << (retry - 1));
+        if (retry || range->offset > range->start) {
+            HAL_MutexLock(ranges->lock);
+            if (retry) ranges->self->_stats.retries++;
+            if (range->offset > range->start) service_ota_stats_resumed(ranges->self, range->offset);
+            HAL_MutexUnlock(ranges->lock);
+        }
+        retry++;
+
+        memset(&http, 0, sizeof(httpclient_t));
+        memset(&http_data, 0, sizeof(httpclient_data_t));
+        HAL_Snprintf(header, sizeof(header), "Range: bytes=%u-%u\r\n", range->offset, range->end - 1);
+        http.header = header;
+        http_data.response_buf = range->buf;
+        http_data.response_buf_len = ranges->self->_data_buf_length;
+        http_data.on_body = service_ota_range_body;
+        http_data.on_body_ctx = range;
+        range->checked = 0;
+        range->written = 0;
+#ifndef IOTX_WITHOUT_ITLS
+        (void)httpclient_common(&http, ranges->self->_ota_url, 80, iotx_ca_get(), HTTPCLIENT_GET,
+                                SERVICE_OTA_FETCH_TIMEOUT_MS, &http_data);
+#else
+        (void)httpclient_common(&http, ranges->self->_ota_url, 443, iotx_ca_get(), HTTPCLIENT_GET,
+                                SERVICE_OTA_FETCH_TIMEOUT_MS, &http_data);
+#endif
+        httpclient_close(&http);
+        if (range->written) retry = 0;
+    }
+
+    if (0 != range->ret) ranges->stop = 1;
+    HAL_SemaphorePost(ranges->sem_exit);
+    return NULL;
+}
+
+/* the digest of the assembled image, read back as a whole, goes in the progress for service_ota_verify() */
+static int service_ota_ranges_digest(service_ota_t* self, service_ota_progress_t* progress)
+{
+    uint32_t offset;
+    int len;
+
+    for (offset = 0; offset < progress->size; offset += len) {
+        len = progress->size - offset < (uint32_t)self->_data_buf_length ? progress->size - offset : self->_data_buf_length;
+        if (len != HAL_Firmware_Persistence_Read(offset, self->_data_buf, len)) {
+            log_err("fota read back failed at %u", offset);
+            return -1;
+        }
+        service_ota_digest_update(&progress->digest, self->_data_buf, len);
+    }
+
+    progress->offset = progress->size;
+    self->_total_len = progress->size;
+    return 0;
+}
+
+/*
+ * Fetches an image of SERVICE_OTA_PARALLEL_MIN_SIZE and more in SERVICE_OTA_PARALLEL_RANGES disjoint ranges
+ * at once, written where they go with HAL_Firmware_Persistence_WriteAt(). The ranges are not saved to go on
+ * with after a reboot. 0 when fetched, -1 when failed, SERVICE_OTA_RANGE_IN_ORDER when it is to be fetched
+ * in order instead: a patch, a server ignoring ranges, or no HAL, memory or threads for them.
+ */
+static int service_ota_fetch_ranges(service_ota_t* self, service_ota_progress_t* progress)
+{
+    service_ota_ranges_t* ranges;
+    service_ota_range_t* range;
+    hal_os_thread_param_t param;
+    void* thread;
+    uint32_t size = progress->size / SERVICE_OTA_PARALLEL_RANGES;
+    int started = 0, ret = 0, i;
+
+    if (NULL == self->_ota_url || progress->size < SERVICE_OTA_PARALLEL_MIN_SIZE ||
+        0 != HAL_Firmware_Persistence_WriteAt(0, self->_data_buf, 0)) {
+        return SERVICE_OTA_RANGE_IN_ORDER;
+    }
+
+    ranges = service_ota_lite_calloc(1, sizeof(service_ota_ranges_t));
+    if (NULL == ranges) return SERVICE_OTA_RANGE_IN_ORDER;
+    ranges->self = self;
+    ranges->lock = HAL_MutexCreate();
+    ranges->sem_exit = HAL_SemaphoreCreate();
+    if (NULL == ranges->lock || NULL == ranges->sem_exit) {
+        ret = SERVICE_OTA_RANGE_IN_ORDER;
+        goto do_exit;
+    }
+
+    for (i = 0; i < SERVICE_OTA_PARALLEL_RANGES; i++) {
+        range = &ranges->range[i];
+        range->ranges = ranges;
+        range->start = range->offset = i * size;
+        range->end = (i == SERVICE_OTA_PARALLEL_RANGES - 1) ? progress->size : (i + 1) * size;
+        range->buf = (0 == i) ? self->_data_buf : service_ota_lite_malloc(self->_data_buf_length);
+        if (NULL == range->buf) {
+            ret = SERVICE_OTA_RANGE_IN_ORDER;
+            goto do_exit;
+        }
+    }
+
+    log_info("fota of %u bytes fetched in %d ranges", progress->size, SERVICE_OTA_PARALLEL_RANGES);
+    memset(&param, 0, sizeof(param));
+    param.stack_size = SERVICE_OTA_WRITER_STACK_SIZE;
+    param.name = "fota_range";
+    for (i = 0; i < SERVICE_OTA_PARALLEL_RANGES; i++) {
+        if (0 != HAL_ThreadCreate(&thread, service_ota_range_fetch, &ranges->range[i], &param, NULL)) {
+            log_err("create thread error, fota fetched in order");
+            ranges->stop = 1;
+            ret = SERVICE_OTA_RANGE_IN_ORDER;
+            break;
+        }
+        HAL_ThreadDetach(thread);
+        started++;
+    }
+
+    for (i = 0; i < started; i++) (void)HAL_SemaphoreWait(ranges->sem_exit, PLATFORM_WAIT_INFINITE);
+
+    for (i = 0; i < started && 0 == ret; i++) {
+        if (SERVICE_OTA_RANGE_IN_ORDER == ranges->range[i].ret) ret = SERVICE_OTA_RANGE_IN_ORDER;
+    }
+    for (i = 0; i < started && 0 == ret; i++) {
+        if (0 != ranges->range[i].ret) ret = -1;
+    }
+    if (0 == ret) ret = service_ota_ranges_digest(self, progress);
+
+do_exit:
+    for (i = 1; i < SERVICE_OTA_PARALLEL_RANGES; i++) {
+        if (ranges->range[i].buf) service_ota_lite_free(ranges->range[i].buf);
+    }
+    if (ranges->lock) HAL_MutexDestroy(ranges->lock);
+    if (ranges->sem_exit) HAL_SemaphoreDestroy(ranges->sem_exit);
+    service_ota_lite_free(ranges);
+
+    return ret;
+}
+#endif  /* SERVICE_OTA_PARALLEL_RANGES > 1 */
+
+/*
+ * The last check before HAL_Firmware_Persistence_Stop() takes the image: all of it is written, each
+ * chunk read back with SERVICE_OTA_VERIFY_READ_BACK. The OTA channel checks the MD5 the cloud sent
+ * against what it fetched but does not hand it on, the digest of what is written is logged for it.
+ */
+static int service_ota_verify(service_ota_progress_t* progress)
+{
+    unsigned char digest[SERVICE_OTA_DIGEST_LEN];
+    char digest_hex[SERVICE_OTA_DIGEST_LEN * 2 + 1];
+
+    if (progress->size && progress->offset != progress->size) {
+        log_err("service fota wrote %u of %u bytes", progress->offset, progress->size);
+        return -1;
+    }
+
+    service_ota_digest_finish(&progress->digest, digest);
+    LITE_hexbuf_convert(digest, digest_hex, sizeof(digest), 0);
+    digest_hex[sizeof(digest_hex) - 1] = '\0';
+    log_info("service fota image of %u bytes, %s %s", progress->offset, SERVICE_OTA_DIGEST_NAME, digest_hex);
+
+    return 0;
+}
+
 static int service_ota_perform_ota_service(void* _self, void* _data_buf, int _data_buf_length)
 {
     service_ota_t* self = _self;
-    int ret = -1;
+    int ret = -1, resumable;
     iotx_cmp_ota_t* iotx_cmp_ota;
+    service_ota_progress_t progress;
+    service_ota_pipe_t pipe;
 
     assert(_data_buf && _data_buf_length);
 
@@ -162,29 +998,52 @@ static int service_ota_perform_ota_service(void* _self, void* _data_buf, int _da
     assert(iotx_cmp_ota);
     if (iotx_cmp_ota == NULL) return -1;
 
-    iotx_cmp_ota->buffer = self->_data_buf;
-    iotx_cmp_ota->buffer_length = self->_data_buf_length;
     iotx_cmp_ota->ota_type = IOTX_CMP_OTA_TYPE_FOTA;
 
     self->_total_len = 0;
+    service_ota_stats_start(self);
 
-    service_ota_start(self);
+    /* the next chunk is fetched while the one before is written, if the HAL lets it */
+    service_ota_pipe_open(&pipe, self, &progress);
+
+    /* the fetch of the OTA channel starts from byte 0, the rest of an image is fetched with a range */
+    if (0 == service_ota_progress_load(self, &progress)) {
+        self->_total_len = progress.offset;
+        goto fetch_range;
+    }
+
+    service_ota_progress_reset(self, &progress);
+
+#if SERVICE_OTA_PARALLEL_RANGES > 1
+    /* a large image is fetched on several connections if the HAL writes it out of order, else from its start */
+    ret = service_ota_fetch_ranges(self, &progress);
+    if (SERVICE_OTA_RANGE_IN_ORDER != ret) goto err_handler;
+    /* anything the ranges wrote is written over from the start */
+    service_ota_progress_reset(self, &progress);
+#endif
 
     while (1) {
         /* reset buffer size every time after fetch */
+        iotx_cmp_ota->buffer = service_ota_pipe_get(&pipe);
         iotx_cmp_ota->buffer_length = self->_data_buf_length;
         ret = IOT_CMP_OTA_Yield(iotx_cmp_ota);
         
         assert(iotx_cmp_ota->buffer && iotx_cmp_ota->buffer_length);
 
         if (ret == 0 && iotx_cmp_ota->buffer && iotx_cmp_ota->buffer_length) {
-            ret = service_ota_write(self, iotx_cmp_ota->buffer, iotx_cmp_ota->buffer_length);
-            if (ret == 0) {
-                self->_total_len += iotx_cmp_ota->buffer_length;
-            }
+            service_ota_stats_fetched(self, iotx_cmp_ota->buffer_length);
+            ret = service_ota_pipe_put(&pipe, iotx_cmp_ota->buffer_length);
             log_debug("\nservice fota write flash,\tret=%d,\tbuffer_length=%d,\ttotal len:%d\n",
                       ret, iotx_cmp_ota->buffer_length, self->_total_len);
             if (ret) goto err_handler;
+        } else {
+            (void)service_ota_pipe_put(&pipe, 0);
+        }
+
+        if (ret && 0 == service_ota_pipe_drain(&pipe) && NULL == pipe.delta &&
+            progress.offset > 0 && progress.offset < progress.size) {
+            log_info("service fota broken at %u of %u bytes, resuming", progress.offset, progress.size);
+            goto fetch_range;
         }
 
         if (ret || iotx_cmp_ota->result) {
@@ -195,20 +1054,46 @@ static int service_ota_perform_ota_service(void* _self, void* _data_buf, int _da
         if (iotx_cmp_ota->is_more) continue;
 
         if(iotx_cmp_ota->is_more == 0 && iotx_cmp_ota->result == 0) {
-            ret = 0;
+            ret = service_ota_pipe_drain(&pipe);
+            if (ret == 0 && pipe.delta) ret = service_ota_delta_finish(pipe.delta);
             log_debug("\nservice fota complete\n");
             break;
         }
     }
 
+    goto err_handler;
+
+fetch_range:
+    /* only the OTA channel knows the MD5 the cloud sent, an image resumed here is checked by its length */
+    ret = service_ota_fetch_range(self, &pipe);
+    iotx_cmp_ota->result = 0;
+    if (ret == 0 && pipe.delta) {
+        /* a patched image is checked by the MD5 in the patch */
+        ret = service_ota_delta_finish(pipe.delta);
+    } else if (ret == 0) {
+        log_info("service fota complete after resume, %u bytes", progress.offset);
+    }
+
 err_handler:
+    /* nothing is written any more from here */
+    resumable = (NULL == pipe.delta);
+    if (0 != service_ota_pipe_close(&pipe)) ret = -1;
+    if (ret == 0 && iotx_cmp_ota->result == 0 && resumable) ret = service_ota_verify(&progress);
+    service_ota_digest_free(&progress.digest);
     if (ret == 0 && iotx_cmp_ota->result == 0) {
+        (void)HAL_Kv_Del(SERVICE_OTA_PROGRESS_KEY);
+        service_ota_stats_finish(self, 0);
         ret = service_ota_end(self);
         if (ret) {
             log_err("service fota invoke end function error, ret=%d", ret);
         }
     } else {
+        /* saved as far as it is written, for a fetch of the same version to go on with */
+        if (resumable && progress.offset > 0 && progress.offset < progress.size) {
+            (void)HAL_Kv_Set(SERVICE_OTA_PROGRESS_KEY, &progress, sizeof(service_ota_progress_t), 1);
+        }
         ret = -1;
+        service_ota_stats_finish(self, -1);
     }
 
     if (iotx_cmp_ota) service_ota_lite_free(iotx_cmp_ota);
@@ -225,6 +1110,17 @@ static void service_ota_install_callback_function(void* _self, handle_service_fo
     self->_linkkit_callback_fp = linkkit_callback_fp;
 }
 
+/* the stats of the download going on, or of the last one once it is over */
+static int service_ota_get_stats(void* _self, service_ota_stats_t* stats)
+{
+    service_ota_t* self = _self;
+
+    if (NULL == stats) return -1;
+
+    service_ota_stats_get(self, stats);
+    return 0;
+}
+
 void* service_ota_lite_calloc(size_t nmemb, size_t size)
 {
 #ifdef CMP_SUPPORT_MEMORY_MAGIC
@@ -258,6 +1154,7 @@ static const fota_t _service_ota_class = {
     service_ota_end,
     service_ota_perform_ota_service,
     service_ota_install_callback_function,
+    service_ota_get_stats,
 };
 
 const void* get_service_ota_class()
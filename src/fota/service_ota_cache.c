@@ -0,0 +1,518 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#include "iot_import.h"
+#include "iot_export_ota.h"
+#include "iot_export_fota.h"
+#include "iot_export_ota_cache.h"
+#include "ota_internal.h"
+#include "lite-utils.h"
+#include "lite-system.h"
+#include "utils_md5.h"
+#include "utils_httpc.h"
+
+#ifdef OTA_CACHE_ENABLED
+
+/* what is fetched into a slot and of which image, in HAL_Kv_Set() to go on after a reboot */
+#define OTA_CACHE_SLOT_KEY                  "otacache.%d"
+#define OTA_CACHE_SLOT_MAGIC                (0x4F434348)
+#define OTA_CACHE_MD5_LEN                   (32 + 1)
+
+/* the fetched length in a slot is saved each time this much more is written */
+#ifndef OTA_CACHE_PROGRESS_STEP
+    #define OTA_CACHE_PROGRESS_STEP         (16 * 1024)
+#endif
+
+/* fetches with no byte written before giving up, the wait doubles from 1s after each */
+#ifndef OTA_CACHE_FETCH_RETRY_MAX
+    #define OTA_CACHE_FETCH_RETRY_MAX       (6)
+#endif
+
+/* the progress of a sub-device is reported each time this many more percent of its image is sent */
+#ifndef OTA_CACHE_REPORT_PERCENT_STEP
+    #define OTA_CACHE_REPORT_PERCENT_STEP   (10)
+#endif
+
+#define OTA_CACHE_FETCH_TIMEOUT_MS          (10 * 1000)
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    size;
+    uint32_t    offset;                                 /* fetched and written */
+    uint32_t    verified;                               /* all of it is fetched and its md5 checked */
+    char        product_key[PRODUCT_KEY_MAXLEN];
+    char        version[FIRMWARE_VERSION_MAXLEN];
+    char        md5[OTA_CACHE_MD5_LEN];
+} ota_cache_slot_t;
+
+typedef struct ota_cache_bind_s {
+    void*       handle;
+    char        product_key[PRODUCT_KEY_MAXLEN];
+    char*       url;                                    /* of the upgrade announced last, NULL before */
+    struct ota_cache_bind_s* next;
+} ota_cache_bind_t;
+
+/* the slots are loaded from kv by the first fan out, used_ms is when each was read from last */
+static struct {
+    void*               mutex;
+    ota_cache_bind_t*   binds;
+    ota_cache_slot_t    slots[CONFIG_OTA_CACHE_SLOTS];
+    uint64_t            used_ms[CONFIG_OTA_CACHE_SLOTS];
+    int                 loaded;
+} g_ota_cache;
+
+/* a fetch into a slot the body of which is written as it comes */
+typedef struct {
+    int                 slot;
+    httpclient_t*       http;
+    httpclient_data_t*  http_data;
+    int                 checked;
+    int                 written;                        /* something written, the retries start over */
+    int                 failed;                         /* not to be fetched again */
+} ota_cache_fetch_t;
+
+/* the bind of handle, under the mutex */
+static ota_cache_bind_t* ota_cache_find(void* handle)
+{
+    ota_cache_bind_t* bind;
+
+    for (bind = g_ota_cache.binds; bind; bind = bind->next) {
+        if (bind->handle == handle) return bind;
+    }
+
+    return NULL;
+}
+
+static char* ota_cache_strdup(const char* str)
+{
+    char* copy = service_ota_lite_calloc(1, strlen(str) + 1);
+
+    if (copy) strcpy(copy, str);
+
+    return copy;
+}
+
+/* the url of an upgrade announced, called by the OTA handle; it is not fetched by the handle */
+static void ota_cache_fetch_callback(void* user_data, int is_fetch, uint32_t size_file, char* purl, char* version)
+{
+    ota_cache_bind_t* bind;
+
+    (void)size_file;
+    (void)version;
+    if (is_fetch || NULL == purl) return;
+
+    HAL_MutexLock(g_ota_cache.mutex);
+    bind = ota_cache_find(user_data);
+    if (bind) {
+        if (bind->url) service_ota_lite_free(bind->url);
+        bind->url = ota_cache_strdup(purl);
+    }
+    HAL_MutexUnlock(g_ota_cache.mutex);
+}
+
+int IOT_OTA_CacheBind(void* handle, const char* product_key)
+{
+    ota_cache_bind_t* bind;
+
+    if (NULL == handle || NULL == product_key || strlen(product_key) >= PRODUCT_KEY_MAXLEN) return -1;
+
+    /* the first bind comes before the handles are yielded */
+    if (NULL == g_ota_cache.mutex) {
+        g_ota_cache.mutex = HAL_MutexCreate();
+        if (NULL == g_ota_cache.mutex) return -1;
+    }
+
+    HAL_MutexLock(g_ota_cache.mutex);
+    bind = ota_cache_find(handle);
+    if (NULL == bind) {
+        bind = service_ota_lite_calloc(1, sizeof(ota_cache_bind_t));
+        if (bind) {
+            bind->handle = handle;
+            bind->next = g_ota_cache.binds;
+            g_ota_cache.binds = bind;
+        }
+    }
+    if (bind) strcpy(bind->product_key, product_key);
+    HAL_MutexUnlock(g_ota_cache.mutex);
+
+    if (NULL == bind) return -1;
+
+    return 0 == iotx_ota_set_fetch_callback(handle, ota_cache_fetch_callback, handle) ? 0 : -1;
+}
+
+int IOT_OTA_CacheUnbind(void* handle)
+{
+    ota_cache_bind_t** link;
+    ota_cache_bind_t* bind = NULL;
+
+    if (NULL == g_ota_cache.mutex) return -1;
+
+    HAL_MutexLock(g_ota_cache.mutex);
+    for (link = &g_ota_cache.binds; *link; link = &(*link)->next) {
+        if ((*link)->handle == handle) {
+            bind = *link;
+            *link = bind->next;
+            break;
+        }
+    }
+    HAL_MutexUnlock(g_ota_cache.mutex);
+
+    if (NULL == bind) return -1;
+
+    if (bind->url) service_ota_lite_free(bind->url);
+    service_ota_lite_free(bind);
+
+    return 0;
+}
+
+static void ota_cache_slot_save(int slot, int sync)
+{
+    char key[16];
+
+    HAL_Snprintf(key, sizeof(key), OTA_CACHE_SLOT_KEY, slot);
+    (void)HAL_Kv_Set(key, &g_ota_cache.slots[slot], sizeof(ota_cache_slot_t), sync);
+}
+
+static void ota_cache_slots_load(void)
+{
+    char key[16];
+    int slot, len;
+
+    if (g_ota_cache.loaded) return;
+    g_ota_cache.loaded = 1;
+
+    for (slot = 0; slot < CONFIG_OTA_CACHE_SLOTS; slot++) {
+        len = sizeof(ota_cache_slot_t);
+        HAL_Snprintf(key, sizeof(key), OTA_CACHE_SLOT_KEY, slot);
+        if (0 != HAL_Kv_Get(key, &g_ota_cache.slots[slot], &len) || len != sizeof(ota_cache_slot_t) ||
+            OTA_CACHE_SLOT_MAGIC != g_ota_cache.slots[slot].magic) {
+            memset(&g_ota_cache.slots[slot], 0, sizeof(ota_cache_slot_t));
+        }
+    }
+}
+
+/* the upgrade announced to handle as a slot, with the url of its bind; -1 when it is not bound or not announced */
+static int ota_cache_upgrade_get(void* handle, ota_cache_slot_t* upgrade, char** url)
+{
+    ota_cache_bind_t* bind;
+    int ret = -1;
+
+    memset(upgrade, 0, sizeof(ota_cache_slot_t));
+    *url = NULL;
+    if (NULL == handle || 1 != IOT_OTA_IsFetching(handle)) return -1;
+
+    if (0 != IOT_OTA_Ioctl(handle, IOT_OTAG_FILE_SIZE, &upgrade->size, sizeof(uint32_t)) || 0 == upgrade->size) return -1;
+    (void)IOT_OTA_Ioctl(handle, IOT_OTAG_VERSION, upgrade->version, sizeof(upgrade->version));
+    (void)IOT_OTA_Ioctl(handle, IOT_OTAG_MD5SUM, upgrade->md5, sizeof(upgrade->md5));
+
+    HAL_MutexLock(g_ota_cache.mutex);
+    bind = ota_cache_find(handle);
+    if (bind) {
+        strcpy(upgrade->product_key, bind->product_key);
+        if (bind->url) *url = ota_cache_strdup(bind->url);
+        ret = 0;
+    }
+    HAL_MutexUnlock(g_ota_cache.mutex);
+
+    upgrade->magic = OTA_CACHE_SLOT_MAGIC;
+    return ret;
+}
+
+/* the same image, the md5 the cloud sends is either case */
+static int ota_cache_upgrade_equal(const ota_cache_slot_t* a, const ota_cache_slot_t* b)
+{
+    int i;
+
+    if (a->size != b->size || 0 != strcmp(a->product_key, b->product_key) || 0 != strcmp(a->version, b->version)) {
+        return 0;
+    }
+    for (i = 0; i < OTA_CACHE_MD5_LEN && (a->md5[i] || b->md5[i]); i++) {
+        if (tolower((unsigned char)a->md5[i]) != tolower((unsigned char)b->md5[i])) return 0;
+    }
+
+    return 1;
+}
+
+/* the slot of upgrade, a free one or the one read from longest ago given to it when none has it */
+static int ota_cache_slot_get(const ota_cache_slot_t* upgrade)
+{
+    int slot, oldest = 0;
+
+    for (slot = 0; slot < CONFIG_OTA_CACHE_SLOTS; slot++) {
+        if (OTA_CACHE_SLOT_MAGIC == g_ota_cache.slots[slot].magic &&
+            ota_cache_upgrade_equal(&g_ota_cache.slots[slot], upgrade)) {
+            return slot;
+        }
+    }
+
+    for (slot = 0; slot < CONFIG_OTA_CACHE_SLOTS; slot++) {
+        if (OTA_CACHE_SLOT_MAGIC != g_ota_cache.slots[slot].magic) break;
+        if (g_ota_cache.used_ms[slot] < g_ota_cache.used_ms[oldest]) oldest = slot;
+    }
+    if (slot == CONFIG_OTA_CACHE_SLOTS) slot = oldest;
+
+    g_ota_cache.slots[slot] = *upgrade;
+    g_ota_cache.slots[slot].offset = 0;
+    g_ota_cache.slots[slot].verified = 0;
+    ota_cache_slot_save(slot, 1);
+
+    return slot;
+}
+
+/* the body of the range response, written into the slot as it comes */
+static int ota_cache_fetch_body(void* _fetch, char* data, int len)
+{
+    ota_cache_fetch_t* fetch = _fetch;
+    ota_cache_slot_t* cache = &g_ota_cache.slots[fetch->slot];
+    uint32_t offset = cache->offset;
+
+    if (!fetch->checked) {
+        fetch->checked = 1;
+        if (200 == fetch->http->response_code && (uint32_t)fetch->http_data->response_content_len == cache->size) {
+            log_info("ota cache server ignores range, fetching from the start");
+            offset = cache->offset = 0;
+        } else if (206 != fetch->http->response_code ||
+                   (uint32_t)fetch->http_data->response_content_len != cache->size - cache->offset) {
+            log_err("ota cache range fetch got %d, %d bytes", fetch->http->response_code,
+                    fetch->http_data->response_content_len);
+            return -1;
+        }
+    }
+
+    if (cache->offset + len > cache->size) {
+        log_err("ota cache fetch beyond %u bytes", cache->size);
+        fetch->failed = 1;
+        return -1;
+    }
+
+    if (0 != HAL_Firmware_Cache_Write(fetch->slot, cache->offset, data, len)) {
+        log_err("ota cache write failed at %u of %u bytes", cache->offset, cache->size);
+        fetch->failed = 1;
+        return -1;
+    }
+    cache->offset += len;
+    fetch->written = 1;
+    if (offset / OTA_CACHE_PROGRESS_STEP != cache->offset / OTA_CACHE_PROGRESS_STEP) ota_cache_slot_save(fetch->slot, 0);
+
+    return 0;
+}
+
+/* fetches the rest of the image of slot from what is written with a "Range:" request, again after each failure */
+static int ota_cache_fetch(int slot, const char* url, char* buf, uint32_t buf_len)
+{
+    ota_cache_slot_t* cache = &g_ota_cache.slots[slot];
+    httpclient_t http;
+    httpclient_data_t http_data;
+    ota_cache_fetch_t fetch;
+    char header[48];
+    int retry = 0, ret;
+
+    for (;;) {
+        if (cache->offset >= cache->size) return 0;
+
+        if (retry >= OTA_CACHE_FETCH_RETRY_MAX) {
+            log_err("ota cache fetch failed at %u of %u bytes", cache->offset, cache->size);
+            return -1;
+        }
+        if (retry) HAL_SleepMs(1000 << (retry - 1));
+        retry++;
+
+        memset(&http, 0, sizeof(httpclient_t));
+        memset(&http_data, 0, sizeof(httpclient_data_t));
+        memset(&fetch, 0, sizeof(ota_cache_fetch_t));
+        HAL_Snprintf(header, sizeof(header), "Range: bytes=%u-\r\n", cache->offset);
+        http.header = header;
+        fetch.slot = slot;
+        fetch.http = &http;
+        fetch.http_data = &http_data;
+
+        http_data.response_buf = buf;
+        http_data.response_buf_len = buf_len;
+        http_data.on_body = ota_cache_fetch_body;
+        http_data.on_body_ctx = &fetch;
+#ifndef IOTX_WITHOUT_ITLS
+        ret = httpclient_common(&http, url, 80, iotx_ca_get(), HTTPCLIENT_GET, OTA_CACHE_FETCH_TIMEOUT_MS, &http_data);
+#else
+        ret = httpclient_common(&http, url, 443, iotx_ca_get(), HTTPCLIENT_GET, OTA_CACHE_FETCH_TIMEOUT_MS, &http_data);
+#endif
+        httpclient_close(&http);
+
+        if (fetch.failed) return -1;
+        if (fetch.written) retry = 0;
+        if (ret || cache->offset < cache->size) {
+            log_info("ota cache fetch broken at %u of %u bytes, try %d", cache->offset, cache->size, retry);
+        }
+    }
+}
+
+/* the md5 of all that is written into slot against the one the cloud sent, read back as the sub-devices will */
+static int ota_cache_verify(int slot, char* buf, uint32_t buf_len)
+{
+    ota_cache_slot_t* cache = &g_ota_cache.slots[slot];
+    iot_md5_context md5;
+    unsigned char digest[16];
+    char digest_hex[OTA_CACHE_MD5_LEN];
+    uint32_t offset;
+    int len, ret = 0, i;
+
+    utils_md5_init(&md5);
+    utils_md5_starts(&md5);
+    for (offset = 0; offset < cache->size; offset += len) {
+        len = cache->size - offset < buf_len ? cache->size - offset : buf_len;
+        if (len != HAL_Firmware_Cache_Read(slot, offset, buf, len)) {
+            ret = -1;
+            break;
+        }
+        utils_md5_update(&md5, (unsigned char*)buf, len);
+    }
+    utils_md5_finish(&md5, digest);
+    utils_md5_free(&md5);
+    if (ret) return -1;
+
+    LITE_hexbuf_convert(digest, digest_hex, sizeof(digest), 0);
+    digest_hex[sizeof(digest_hex) - 1] = '\0';
+    for (i = 0; i < OTA_CACHE_MD5_LEN; i++) {
+        if (tolower((unsigned char)cache->md5[i]) != digest_hex[i]) {
+            log_err("ota cache image of %s %s has md5 %s, not %s", cache->product_key, cache->version, digest_hex,
+                    cache->md5);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* the slot holding the whole of upgrade checked, fetched into it from url unless it is there; -1 when it fails */
+static int ota_cache_prepare(const ota_cache_slot_t* upgrade, const char* url, char* buf, uint32_t buf_len)
+{
+    int slot = ota_cache_slot_get(upgrade);
+    ota_cache_slot_t* cache = &g_ota_cache.slots[slot];
+
+    g_ota_cache.used_ms[slot] = HAL_UptimeMs();
+    if (cache->verified) return slot;
+
+    if (NULL == url) {
+        log_err("ota cache has no url of %s %s", cache->product_key, cache->version);
+        return -1;
+    }
+    if (cache->offset) log_info("ota cache of %s %s resumed at %u of %u bytes", cache->product_key, cache->version,
+                                    cache->offset, cache->size);
+
+    if (0 != ota_cache_fetch(slot, url, buf, buf_len)) {
+        /* kept as far as it is written, for a fan out of the same image to go on with */
+        ota_cache_slot_save(slot, 1);
+        return -1;
+    }
+
+    if (0 != ota_cache_verify(slot, buf, buf_len)) {
+        cache->offset = 0;
+        ota_cache_slot_save(slot, 1);
+        return -1;
+    }
+
+    cache->verified = 1;
+    ota_cache_slot_save(slot, 1);
+    log_info("ota cache of %s %s fetched, %u bytes", cache->product_key, cache->version, cache->size);
+
+    return slot;
+}
+
+/* sends the image of slot to the handles of members by chunks, a member send fails for is set to -1 */
+static void ota_cache_send(int slot, void* handles[], int members[], int count, char* buf, uint32_t buf_len,
+                           iotx_ota_cache_send_fpt send)
+{
+    uint32_t size = g_ota_cache.slots[slot].size;
+    uint32_t offset, before, after;
+    int len, i, active = count;
+
+    for (i = 0; i < count; i++) IOT_OTA_ReportProgress(handles[members[i]], IOT_OTAP_FETCH_PERCENTAGE_MIN, NULL);
+
+    for (offset = 0; offset < size && active; offset += len) {
+        len = size - offset < buf_len ? size - offset : buf_len;
+        if (len != HAL_Firmware_Cache_Read(slot, offset, buf, len)) {
+            log_err("ota cache read failed at %u of %u bytes", offset, size);
+            for (i = 0; i < count; i++) {
+                if (-1 == members[i]) continue;
+                IOT_OTA_ReportProgress(handles[members[i]], IOT_OTAP_GENERAL_FAILED, NULL);
+                members[i] = -1;
+            }
+            return;
+        }
+
+        before = (uint32_t)((uint64_t)offset * 100 / size);
+        after = (uint32_t)((uint64_t)(offset + len) * 100 / size);
+        for (i = 0; i < count; i++) {
+            if (-1 == members[i]) continue;
+
+            if (0 != send(handles[members[i]], size, offset, buf, len)) {
+                log_info("ota cache send failed at %u of %u bytes", offset, size);
+                IOT_OTA_ReportProgress(handles[members[i]], IOT_OTAP_BURN_FAILED, NULL);
+                members[i] = -1;
+                active--;
+            } else if (before / OTA_CACHE_REPORT_PERCENT_STEP != after / OTA_CACHE_REPORT_PERCENT_STEP) {
+                IOT_OTA_ReportProgress(handles[members[i]], (IOT_OTA_Progress_t)after, NULL);
+            }
+        }
+    }
+}
+
+int IOT_OTA_CacheFanOut(void* handles[], int count, char* buf, uint32_t buf_len, iotx_ota_cache_send_fpt send)
+{
+    ota_cache_slot_t upgrade, other;
+    char *url, *other_url;
+    int *members, *done;
+    int i, j, number, slot, sent, served = 0;
+
+    if (NULL == handles || count <= 0 || NULL == buf || 0 == buf_len || NULL == send || NULL == g_ota_cache.mutex) {
+        return -1;
+    }
+
+    members = service_ota_lite_calloc(2 * count, sizeof(int));
+    if (NULL == members) return -1;
+    done = members + count;
+
+    ota_cache_slots_load();
+
+    for (i = 0; i < count; i++) {
+        if (done[i]) continue;
+        done[i] = 1;
+        if (0 != ota_cache_upgrade_get(handles[i], &upgrade, &url)) continue;
+
+        /* the handles after upgraded to the same image, any of them with the url to fetch it */
+        number = 0;
+        members[number++] = i;
+        for (j = i + 1; j < count; j++) {
+            if (done[j] || 0 != ota_cache_upgrade_get(handles[j], &other, &other_url)) continue;
+            if (ota_cache_upgrade_equal(&upgrade, &other)) {
+                done[j] = 1;
+                members[number++] = j;
+                if (NULL == url) {
+                    url = other_url;
+                    other_url = NULL;
+                }
+            }
+            if (other_url) service_ota_lite_free(other_url);
+        }
+
+        slot = ota_cache_prepare(&upgrade, url, buf, buf_len);
+        if (url) service_ota_lite_free(url);
+        if (-1 == slot) {
+            for (j = 0; j < number; j++) IOT_OTA_ReportProgress(handles[members[j]], IOT_OTAP_FETCH_FAILED, NULL);
+            continue;
+        }
+
+        ota_cache_send(slot, handles, members, number, buf, buf_len, send);
+        for (sent = 0, j = 0; j < number; j++) {
+            if (-1 != members[j]) sent++;
+        }
+        log_info("ota cache sent %s %s to %d of %d sub-devices", upgrade.product_key, upgrade.version, sent, number);
+        served += sent;
+    }
+
+    service_ota_lite_free(members);
+
+    return served;
+}
+
+#endif /* OTA_CACHE_ENABLED */
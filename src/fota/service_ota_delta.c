@@ -0,0 +1,358 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export_fota.h"
+#include "lite-utils.h"
+#include "utils_md5.h"
+#include "service_ota_delta.h"
+
+/* the old image is read this much at a time */
+#ifndef SERVICE_OTA_DELTA_READ_LEN
+    #define SERVICE_OTA_DELTA_READ_LEN      (256)
+#endif
+
+/* the new image is written this much at a time */
+#ifndef SERVICE_OTA_DELTA_WRITE_LEN
+    #define SERVICE_OTA_DELTA_WRITE_LEN     (512)
+#endif
+
+#define SERVICE_OTA_DELTA_HEADER_LEN        (SERVICE_OTA_DELTA_MAGIC_LEN + 4 + 4 + 16 + 16)
+#define SERVICE_OTA_DELTA_CONTROL_LEN       (4 + 4 + 4)
+
+typedef enum {
+    SERVICE_OTA_DELTA_STATE_HEADER,
+    SERVICE_OTA_DELTA_STATE_CONTROL,
+    SERVICE_OTA_DELTA_STATE_DIFF_TAG,
+    SERVICE_OTA_DELTA_STATE_DIFF_ADD,
+    SERVICE_OTA_DELTA_STATE_DIFF_SAME,
+    SERVICE_OTA_DELTA_STATE_EXTRA,
+    SERVICE_OTA_DELTA_STATE_DONE,
+    SERVICE_OTA_DELTA_STATE_FAILED,
+} service_ota_delta_state_t;
+
+struct service_ota_delta_s {
+    service_ota_delta_state_t   state;
+    unsigned char               stage[SERVICE_OTA_DELTA_HEADER_LEN];    /* of the header or a control */
+    int                         stage_len;
+    uint32_t                    old_size;
+    uint32_t                    new_size;
+    unsigned char               new_md5[16];
+    uint32_t                    old_pos;
+    uint32_t                    new_pos;
+    uint32_t                    diff_left;                              /* of the record */
+    uint32_t                    extra_left;
+    uint32_t                    segment_left;                           /* of the diff segment */
+    int32_t                     seek;
+    uint32_t                    old_buf_pos;
+    uint32_t                    old_buf_len;
+    unsigned char               old_buf[SERVICE_OTA_DELTA_READ_LEN];
+    int                         out_len;
+    unsigned char               out[SERVICE_OTA_DELTA_WRITE_LEN];
+    iot_md5_context             md5;                                    /* of the new image written */
+};
+
+static uint32_t service_ota_delta_u32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* points 'old' to the old image at old_pos, the count returned is what is in the buffer up to 'max' */
+static int service_ota_delta_old(service_ota_delta_t* delta, uint32_t max, const unsigned char** old)
+{
+    uint32_t len;
+
+    if (delta->old_pos < delta->old_buf_pos || delta->old_pos >= delta->old_buf_pos + delta->old_buf_len) {
+        len = delta->old_size - delta->old_pos;
+        if (len > SERVICE_OTA_DELTA_READ_LEN) len = SERVICE_OTA_DELTA_READ_LEN;
+
+        if (0 == len || (int)len != HAL_Firmware_Current_Read(delta->old_pos, (char*)delta->old_buf, len)) {
+            log_err("read running image failed at %u", delta->old_pos);
+            return -1;
+        }
+        delta->old_buf_pos = delta->old_pos;
+        delta->old_buf_len = len;
+    }
+
+    *old = delta->old_buf + (delta->old_pos - delta->old_buf_pos);
+    len = delta->old_buf_pos + delta->old_buf_len - delta->old_pos;
+
+    return (int)(len < max ? len : max);
+}
+
+static int service_ota_delta_flush(service_ota_delta_t* delta)
+{
+    if (0 == delta->out_len) return 0;
+
+    if (0 != service_ota_flash_write(delta->new_pos - delta->out_len, (char*)delta->out, delta->out_len)) {
+        log_err("write new image failed at %u", delta->new_pos);
+        return -1;
+    }
+    utils_md5_update(&delta->md5, delta->out, delta->out_len);
+    delta->out_len = 0;
+
+    return 0;
+}
+
+/* 'n' bytes of the new image, each the sum of the 'old' and the 'add' one, either may be NULL */
+static int service_ota_delta_emit(service_ota_delta_t* delta, const unsigned char* old, const unsigned char* add, int n)
+{
+    int i, len;
+
+    while (n > 0) {
+        len = SERVICE_OTA_DELTA_WRITE_LEN - delta->out_len;
+        if (len > n) len = n;
+
+        for (i = 0; i < len; i++) {
+            delta->out[delta->out_len + i] = (unsigned char)((old ? old[i] : 0) + (add ? add[i] : 0));
+        }
+        if (old) old += len;
+        if (add) add += len;
+        delta->out_len += len;
+        delta->new_pos += len;
+        n -= len;
+
+        if (SERVICE_OTA_DELTA_WRITE_LEN == delta->out_len && 0 != service_ota_delta_flush(delta)) return -1;
+    }
+
+    return 0;
+}
+
+/* the MD5 of the old image is checked before anything is written from it */
+static int service_ota_delta_header(service_ota_delta_t* delta)
+{
+    iot_md5_context md5;
+    unsigned char digest[16];
+    uint32_t len;
+
+    if (0 != memcmp(delta->stage, SERVICE_OTA_DELTA_MAGIC, SERVICE_OTA_DELTA_MAGIC_LEN)) return -1;
+
+    delta->old_size = service_ota_delta_u32(delta->stage + SERVICE_OTA_DELTA_MAGIC_LEN);
+    delta->new_size = service_ota_delta_u32(delta->stage + SERVICE_OTA_DELTA_MAGIC_LEN + 4);
+    memcpy(delta->new_md5, delta->stage + SERVICE_OTA_DELTA_MAGIC_LEN + 4 + 4 + 16, 16);
+    if (0 == delta->old_size || 0 == delta->new_size) {
+        log_err("fota patch of %u to %u bytes", delta->old_size, delta->new_size);
+        return -1;
+    }
+
+    utils_md5_init(&md5);
+    utils_md5_starts(&md5);
+    for (delta->old_pos = 0; delta->old_pos < delta->old_size; delta->old_pos += len) {
+        len = delta->old_size - delta->old_pos;
+        if (len > SERVICE_OTA_DELTA_READ_LEN) len = SERVICE_OTA_DELTA_READ_LEN;
+
+        if ((int)len != HAL_Firmware_Current_Read(delta->old_pos, (char*)delta->old_buf, len)) {
+            log_err("read running image failed at %u", delta->old_pos);
+            utils_md5_free(&md5);
+            return -1;
+        }
+        utils_md5_update(&md5, delta->old_buf, len);
+    }
+    utils_md5_finish(&md5, digest);
+    utils_md5_free(&md5);
+
+    if (0 != memcmp(digest, delta->stage + SERVICE_OTA_DELTA_MAGIC_LEN + 4 + 4, 16)) {
+        log_err("fota patch is not of the running image");
+        return -1;
+    }
+
+    log_info("fota patch of %u to %u bytes", delta->old_size, delta->new_size);
+    delta->old_pos = 0;
+    delta->old_buf_len = 0;
+    delta->state = SERVICE_OTA_DELTA_STATE_CONTROL;
+
+    return 0;
+}
+
+static int service_ota_delta_control(service_ota_delta_t* delta)
+{
+    delta->diff_left = service_ota_delta_u32(delta->stage);
+    delta->extra_left = service_ota_delta_u32(delta->stage + 4);
+    delta->seek = (int32_t)service_ota_delta_u32(delta->stage + 8);
+
+    if (delta->diff_left > delta->old_size - delta->old_pos ||
+        delta->diff_left > delta->new_size - delta->new_pos ||
+        delta->extra_left > delta->new_size - delta->new_pos - delta->diff_left) {
+        log_err("fota patch record beyond the image at %u", delta->new_pos);
+        return -1;
+    }
+    delta->state = SERVICE_OTA_DELTA_STATE_DIFF_TAG;
+
+    return 0;
+}
+
+/* goes on with what needs no more of the patch, the bytes the same as the old ones and the ends of records */
+static int service_ota_delta_settle(service_ota_delta_t* delta)
+{
+    const unsigned char* old;
+    int n;
+
+    for (;;) {
+        switch (delta->state) {
+            case SERVICE_OTA_DELTA_STATE_DIFF_SAME:
+                while (delta->segment_left > 0) {
+                    n = service_ota_delta_old(delta, delta->segment_left, &old);
+                    if (n < 0 || 0 != service_ota_delta_emit(delta, old, NULL, n)) return -1;
+                    delta->old_pos += n;
+                    delta->segment_left -= n;
+                    delta->diff_left -= n;
+                }
+                delta->state = SERVICE_OTA_DELTA_STATE_DIFF_TAG;
+                break;
+
+            case SERVICE_OTA_DELTA_STATE_DIFF_ADD:
+                if (delta->segment_left) return 0;
+                delta->state = SERVICE_OTA_DELTA_STATE_DIFF_TAG;
+                break;
+
+            case SERVICE_OTA_DELTA_STATE_DIFF_TAG:
+                if (delta->diff_left) return 0;
+                delta->state = SERVICE_OTA_DELTA_STATE_EXTRA;
+                break;
+
+            case SERVICE_OTA_DELTA_STATE_EXTRA:
+                if (delta->extra_left) return 0;
+                if (delta->seek < 0 ? (uint32_t)0 - (uint32_t)delta->seek > delta->old_pos
+                    : (uint32_t)delta->seek > delta->old_size - delta->old_pos) {
+                    log_err("fota patch seeks out of the running image at %u", delta->new_pos);
+                    return -1;
+                }
+                delta->old_pos += delta->seek;
+                delta->state = delta->new_pos == delta->new_size ? SERVICE_OTA_DELTA_STATE_DONE
+                               : SERVICE_OTA_DELTA_STATE_CONTROL;
+                break;
+
+            default:
+                return 0;
+        }
+    }
+}
+
+static int service_ota_delta_apply(service_ota_delta_t* delta, const unsigned char* data, int data_length)
+{
+    const unsigned char* old;
+    int need, n;
+
+    while (data_length > 0) {
+        switch (delta->state) {
+            case SERVICE_OTA_DELTA_STATE_HEADER:
+            case SERVICE_OTA_DELTA_STATE_CONTROL:
+                need = SERVICE_OTA_DELTA_STATE_HEADER == delta->state ?
+                       SERVICE_OTA_DELTA_HEADER_LEN : SERVICE_OTA_DELTA_CONTROL_LEN;
+                n = need - delta->stage_len;
+                if (n > data_length) n = data_length;
+                memcpy(delta->stage + delta->stage_len, data, n);
+                delta->stage_len += n;
+                data += n;
+                data_length -= n;
+                if (delta->stage_len < need) break;
+
+                delta->stage_len = 0;
+                if (SERVICE_OTA_DELTA_STATE_HEADER == delta->state) {
+                    if (0 != service_ota_delta_header(delta)) return -1;
+                } else if (0 != service_ota_delta_control(delta)) {
+                    return -1;
+                }
+                break;
+
+            case SERVICE_OTA_DELTA_STATE_DIFF_TAG:
+                delta->segment_left = (*data & 0x7f) + 1;
+                delta->state = (*data & 0x80) ? SERVICE_OTA_DELTA_STATE_DIFF_SAME : SERVICE_OTA_DELTA_STATE_DIFF_ADD;
+                data++;
+                data_length--;
+                if (delta->segment_left > delta->diff_left) {
+                    log_err("fota patch segment beyond the record at %u", delta->new_pos);
+                    return -1;
+                }
+                break;
+
+            case SERVICE_OTA_DELTA_STATE_DIFF_ADD:
+                n = service_ota_delta_old(delta, delta->segment_left < (uint32_t)data_length ?
+                                          delta->segment_left : (uint32_t)data_length, &old);
+                if (n < 0 || 0 != service_ota_delta_emit(delta, old, data, n)) return -1;
+                data += n;
+                data_length -= n;
+                delta->old_pos += n;
+                delta->segment_left -= n;
+                delta->diff_left -= n;
+                break;
+
+            case SERVICE_OTA_DELTA_STATE_EXTRA:
+                n = delta->extra_left < (uint32_t)data_length ? (int)delta->extra_left : data_length;
+                if (0 != service_ota_delta_emit(delta, NULL, data, n)) return -1;
+                data += n;
+                data_length -= n;
+                delta->extra_left -= n;
+                break;
+
+            default:
+                log_err("fota patch goes on after the new image");
+                return -1;
+        }
+
+        if (0 != service_ota_delta_settle(delta)) return -1;
+    }
+
+    return 0;
+}
+
+int service_ota_delta_is_patch(const char* data, int data_length)
+{
+    return data && data_length >= SERVICE_OTA_DELTA_MAGIC_LEN &&
+           0 == memcmp(data, SERVICE_OTA_DELTA_MAGIC, SERVICE_OTA_DELTA_MAGIC_LEN);
+}
+
+service_ota_delta_t* service_ota_delta_open(void)
+{
+    service_ota_delta_t* delta = service_ota_lite_calloc(1, sizeof(service_ota_delta_t));
+
+    if (NULL == delta) {
+        log_err("no memory for fota patch");
+        return NULL;
+    }
+
+    delta->state = SERVICE_OTA_DELTA_STATE_HEADER;
+    utils_md5_init(&delta->md5);
+    utils_md5_starts(&delta->md5);
+
+    return delta;
+}
+
+int service_ota_delta_write(service_ota_delta_t* delta, const char* data, int data_length)
+{
+    if (SERVICE_OTA_DELTA_STATE_FAILED == delta->state) return -1;
+
+    if (0 != service_ota_delta_apply(delta, (const unsigned char*)data, data_length)) {
+        delta->state = SERVICE_OTA_DELTA_STATE_FAILED;
+        return -1;
+    }
+
+    return 0;
+}
+
+int service_ota_delta_finish(service_ota_delta_t* delta)
+{
+    unsigned char digest[16];
+
+    if (SERVICE_OTA_DELTA_STATE_DONE != delta->state) {
+        log_err("fota patch ends at %u of %u bytes", delta->new_pos, delta->new_size);
+        return -1;
+    }
+
+    if (0 != service_ota_delta_flush(delta)) return -1;
+
+    utils_md5_finish(&delta->md5, digest);
+    if (0 != memcmp(digest, delta->new_md5, sizeof(digest))) {
+        log_err("fota patched image of %u bytes has a wrong md5", delta->new_size);
+        return -1;
+    }
+
+    log_info("fota patched image of %u bytes", delta->new_size);
+    return 0;
+}
+
+void service_ota_delta_close(service_ota_delta_t* delta)
+{
+    utils_md5_free(&delta->md5);
+    service_ota_lite_free(delta);
+}
@@ -0,0 +1,42 @@
+#ifndef SERVICE_OTA_DELTA_H
+#define SERVICE_OTA_DELTA_H
+
+/*
+ * A patch of the running image to the new one, applied as it is downloaded in constant memory. All
+ * numbers are little endian.
+ *
+ *   header:  "IOTXDF01", old size (u32), new size (u32), MD5 of the old image, MD5 of the new image
+ *   records until the new image is made, bsdiff alike:
+ *            diff length (u32), extra length (u32), seek (s32)
+ *            diff:  'diff length' bytes of the new image made from the old image segment by segment, a
+ *                   tag 0x00-0x7f is followed by tag + 1 bytes added to the old ones, a tag 0x80-0xff
+ *                   stands for (tag & 0x7f) + 1 bytes the same as the old ones
+ *            extra: 'extra length' bytes of the new image as they are
+ *            the old image is read on by 'diff length' and then moved by 'seek'
+ *
+ * The old image is read with HAL_Firmware_Current_Read(), the new one is written with
+ * HAL_Firmware_Persistence_Write(). src/scripts/fota_delta.py makes the patches.
+ */
+
+/* in service_ota.c, writes at 'offset' of the new image, read back with SERVICE_OTA_VERIFY_READ_BACK */
+int service_ota_flash_write(uint32_t offset, const char* data, int data_length);
+
+#define SERVICE_OTA_DELTA_MAGIC             "IOTXDF01"
+#define SERVICE_OTA_DELTA_MAGIC_LEN         (8)
+
+typedef struct service_ota_delta_s service_ota_delta_t;
+
+/* if a download starting with 'data' is a patch */
+int service_ota_delta_is_patch(const char* data, int data_length);
+
+service_ota_delta_t* service_ota_delta_open(void);
+
+/* applies the next 'data_length' bytes of the patch, 0 or -1 on a bad patch or a failed read or write */
+int service_ota_delta_write(service_ota_delta_t* delta, const char* data, int data_length);
+
+/* 0 if the whole new image is written and its MD5 is the one of the patch */
+int service_ota_delta_finish(service_ota_delta_t* delta);
+
+void service_ota_delta_close(service_ota_delta_t* delta);
+
+#endif /* SERVICE_OTA_DELTA_H */
@@ -25,6 +25,8 @@
 #include "utils_hmac.h"
 #include "utils_httpc.h"
 #include "utils_epoch_time.h"
+#include "utils_token.h"
+#include "json_parser.h"
 #include "sdk-impl_internal.h"
 #include "lite-system.h"
 
@@ -76,17 +78,32 @@
 #endif /* USING_SHA1_IN_HMAC */
 
 #define IOTX_HTTP_HEADER_KEEPALIVE_STR  "Connection: Keep-Alive\r\n"
+#define IOTX_HTTP_HEADER_CLOSE_STR      "Connection: close\r\n"
 #define IOTX_HTTP_HEADER_PASSWORD_STR   "password:"
 #define IOTX_HTTP_UPSTREAM_HEADER_STR   \
-    IOTX_HTTP_HEADER_KEEPALIVE_STR \
+    "%s" \
     IOTX_HTTP_HEADER_PASSWORD_STR \
     "%s" \
     IOTX_HTTP_HEADER_END_STR
 #define IOTX_HTTP_HEADER_END_STR "\r\n"
+/* the longest upstream header, with the longest connection header and token */
+#define IOTX_HTTP_UPSTREAM_HEADER_LEN   \
+    (sizeof(IOTX_HTTP_HEADER_KEEPALIVE_STR) + sizeof(IOTX_HTTP_HEADER_PASSWORD_STR) + \
+     IOTX_HTTP_AUTH_TOKEN_LEN + sizeof(IOTX_HTTP_HEADER_END_STR))
 
 #define HTTP_AUTH_RESP_MAX_LEN      (256)
 
+/* where a batch of messages is posted, framed as IOT_HTTP_SendBatch() tells */
+#define IOTX_HTTP_BATCH_PATH            "/topics"
+#define IOTX_HTTP_BATCH_CONTENT_TYPE    "application/vnd.iotx.batch"
+#define IOTX_HTTP_BATCH_FRAME_HEAD_LEN  (6)
+
 static iotx_http_t *iotx_http_context_bak = NULL;
+/* the device secret of the context, set up once for every auth */
+static utils_hmac_ctx_t iotx_http_sign_ctx;
+/* the life of its token, saved under IOTX_HTTP_TOKEN_KV_KEY for the next run */
+static utils_token_t iotx_http_token_life;
+#define IOTX_HTTP_TOKEN_KV_KEY          "http.token"
 
 
 /*
@@ -103,15 +120,14 @@ static iotx_http_t *iotx_http_context_bak = NULL;
   body: {"version":"default","clientId":"xxxxx","signmethod":"hmacsha1","sign":"xxxxxxxxxx","productKey":"xxxxxx","deviceName":"xxxxxxx","timestamp":"xxxxxxx"}
 */
 
-static int iotx_calc_sign(const char *p_device_secret, const char *p_msg, char *sign)
+static int iotx_calc_sign(const utils_hmac_ctx_t *p_sign_ctx, const char *p_msg, char *sign)
 {
 #if USING_SHA1_IN_HMAC
     log_info("| method: %s", IOTX_SHA_METHOD);
-    utils_hmac_sha1(p_msg, strlen(p_msg), sign, p_device_secret, strlen(p_device_secret));
 #else
     log_info("| method: %s", IOTX_MD5_METHOD);
-    utils_hmac_md5(p_msg, strlen(p_msg), sign, p_device_secret, strlen(p_device_secret));
 #endif
+    utils_hmac_sign(p_sign_ctx, p_msg, strlen(p_msg), sign);
     return IOTX_SUCCESS;
 }
 
@@ -162,10 +178,19 @@ static int construct_full_http_upstream_url(char *buf, const char *topic_path)
 {
     LITE_snprintf(buf, IOTX_HTTP_URL_LEN_MAX,
                   "%s%s", IOTX_HTTP_ONLINE_SERVER_URL, topic_path);
-    log_info("construct_full_http_upstream_url is %s", buf);
+    log_debug("construct_full_http_upstream_url is %s", buf);
     return 0;
 }
 
+/* splices the token into the header every upstream message is sent with, once per auth */
+static void construct_http_upstream_header(iotx_http_t *iotx_http_context)
+{
+    LITE_snprintf(iotx_http_context->p_header, IOTX_HTTP_UPSTREAM_HEADER_LEN,
+                  IOTX_HTTP_UPSTREAM_HEADER_STR,
+                  iotx_http_context->keep_alive ? IOTX_HTTP_HEADER_KEEPALIVE_STR : IOTX_HTTP_HEADER_CLOSE_STR,
+                  iotx_http_context->p_auth_token);
+}
+
 /* report ModuleID */
 static int iotx_http_report_mid(iotx_http_t *handle)
 {
@@ -285,6 +310,7 @@ void *IOT_HTTP_Init(iotx_http_param_t *pInitParams)
     }
 
     memset(iotx_http_context, 0x00, sizeof(iotx_http_t));
+    memset(&iotx_http_token_life, 0x00, sizeof(utils_token_t));
 
     iotx_http_context->keep_alive = pInitParams->keep_alive;
     iotx_http_context->timeout_ms = pInitParams->timeout_ms;
@@ -297,6 +323,13 @@ void *IOT_HTTP_Init(iotx_http_param_t *pInitParams)
     iotx_http_context->is_authed = 0;
     iotx_http_context->auth_token_len = IOTX_HTTP_AUTH_TOKEN_LEN;
 
+    iotx_http_context->p_header = LITE_malloc(IOTX_HTTP_UPSTREAM_HEADER_LEN);
+    if (NULL == iotx_http_context->p_header) {
+        log_err("Allocate memory for upstream header failed");
+        goto err;
+    }
+    memset(iotx_http_context->p_header, 0x00, IOTX_HTTP_UPSTREAM_HEADER_LEN);
+
     /*Get deivce information*/
     iotx_http_context->p_devinfo = (iotx_device_info_t *)LITE_malloc(sizeof(iotx_device_info_t));
     if (NULL == iotx_http_context->p_devinfo) {
@@ -316,6 +349,17 @@ void *IOT_HTTP_Init(iotx_http_param_t *pInitParams)
     iotx_device_info_set(iotx_http_context->p_devinfo->product_key, iotx_http_context->p_devinfo->device_name,
                          iotx_http_context->p_devinfo->device_secret);
 
+#if USING_SHA1_IN_HMAC
+    if (0 != utils_hmac_setkey(&iotx_http_sign_ctx, UTILS_HMAC_SHA1, iotx_http_context->p_devinfo->device_secret,
+                               strlen(iotx_http_context->p_devinfo->device_secret))) {
+#else
+    if (0 != utils_hmac_setkey(&iotx_http_sign_ctx, UTILS_HMAC_MD5, iotx_http_context->p_devinfo->device_secret,
+                               strlen(iotx_http_context->p_devinfo->device_secret))) {
+#endif
+        log_err("Set up the sign key failed");
+        goto err;
+    }
+
     iotx_http_context->httpc = LITE_malloc(sizeof(httpclient_t));
     if (NULL == iotx_http_context->httpc) {
         log_err("Allocate memory for iotx_http_context->httpc failed");
@@ -335,10 +379,14 @@ err:
         if (NULL != iotx_http_context->p_auth_token) {
             LITE_free(iotx_http_context->p_auth_token);
         }
+        if (NULL != iotx_http_context->p_header) {
+            LITE_free(iotx_http_context->p_header);
+        }
 
         iotx_http_context->auth_token_len = 0;
         LITE_free(iotx_http_context);
     }
+    utils_hmac_free(&iotx_http_sign_ctx);
     return NULL;
 }
 
@@ -359,6 +407,9 @@ void IOT_HTTP_DeInit(void **handle)
     if (NULL != iotx_http_context->p_auth_token) {
         LITE_free(iotx_http_context->p_auth_token);
     }
+    if (NULL != iotx_http_context->p_header) {
+        LITE_free(iotx_http_context->p_header);
+    }
     if (NULL != iotx_http_context->httpc) {
         LITE_free(iotx_http_context->httpc);
     }
@@ -366,9 +417,11 @@ void IOT_HTTP_DeInit(void **handle)
     iotx_http_context->auth_token_len = 0;
     LITE_free(iotx_http_context);
     iotx_http_context_bak = NULL;
+    utils_hmac_free(&iotx_http_sign_ctx);
 }
 
-int IOT_HTTP_DeviceNameAuth(void *handle)
+/* an auth round trip, the token in hand is kept when it fails before a new one came */
+static int iotx_http_device_name_auth(void *handle)
 {
     int                 ret = -1;
     int                 ret_code = 0;
@@ -383,7 +436,6 @@ int IOT_HTTP_DeviceNameAuth(void *handle)
     char               *rsp_payload = NULL;
     int                 len = 0;
     char                p_msg_unsign[IOTX_HTTP_SIGN_SOURCE_LEN] = {0};
-    iotx_time_t         timer;
     iotx_http_t        *iotx_http_context;
     /*
         //    body:
@@ -422,7 +474,7 @@ int IOT_HTTP_DeviceNameAuth(void *handle)
 #endif
                  );
 
-    iotx_calc_sign(iotx_http_context->p_devinfo->device_secret, p_msg_unsign, sign);
+    iotx_calc_sign(&iotx_http_sign_ctx, p_msg_unsign, sign);
 
     /* to save stack memory*/
     len = calc_snprintf_string_length(IOTX_HTTP_AUTH_DEVICENAME_STR,
@@ -484,7 +536,7 @@ int IOT_HTTP_DeviceNameAuth(void *handle)
     httpc_data.response_buf = rsp_payload;
     httpc_data.response_buf_len = HTTP_AUTH_RESP_MAX_LEN;
 
-    httpc->header = "Connection: Keep-Alive\r\n";
+    httpc->header = iotx_http_context->keep_alive ? IOTX_HTTP_HEADER_KEEPALIVE_STR : IOTX_HTTP_HEADER_CLOSE_STR;
 
     /*
     Test Code
@@ -496,27 +548,17 @@ int IOT_HTTP_DeviceNameAuth(void *handle)
     */
 
     /* Send Request and Get Response */
-    if (0 != iotx_post(httpc,
-                       http_url,
-                       IOTX_HTTP_ONLINE_SERVER_PORT,
-                       IOTX_HTTP_CA_GET,
-                       &httpc_data)) {
-        goto do_exit;
-    }
-
-    iotx_time_init(&timer);
-    utils_time_countdown_ms(&timer, CONFIG_HTTP_AUTH_TIMEOUT);
-
-
-    ret = httpclient_recv_response(httpc, iotx_time_left(&timer), &httpc_data);
+    ret = iotx_post_recv(httpc,
+                         http_url,
+                         IOTX_HTTP_ONLINE_SERVER_PORT,
+                         IOTX_HTTP_CA_GET,
+                         CONFIG_HTTP_AUTH_TIMEOUT,
+                         &httpc_data,
+                         iotx_http_context->keep_alive);
     if (ret < 0) {
-        log_err("httpclient_recv_response error, ret = %d", ret);
-        httpclient_close(httpc);
-        return ret;
-    }
-    if (0 == iotx_http_context->keep_alive) {
-        httpclient_close(httpc);
+        goto do_exit;
     }
+    ret = -1;
     /*
     body:
     {
@@ -566,8 +608,17 @@ int IOT_HTTP_DeviceNameAuth(void *handle)
         goto do_exit;
     }
 
+    if (strlen(pvalue) >= iotx_http_context->auth_token_len) {
+        log_err("token too long, Abort!");
+        goto do_exit;
+    }
     strcpy(iotx_http_context->p_auth_token, pvalue);
+    construct_http_upstream_header(iotx_http_context);
     iotx_http_context->is_authed = 1;
+    utils_token_start(&iotx_http_token_life, iotx_http_context->p_auth_token);
+    utils_token_save(IOTX_HTTP_TOKEN_KV_KEY, iotx_http_context->p_devinfo->product_key,
+                     iotx_http_context->p_devinfo->device_name, iotx_http_context->p_auth_token,
+                     &iotx_http_token_life);
     LITE_free(pvalue);
     pvalue = NULL;
 
@@ -599,111 +650,91 @@ do_exit:
     return ret;
 }
 
-int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
+int IOT_HTTP_DeviceNameAuth(void *handle)
 {
-    int                 ret = -1;
-    int                 response_code = 0;
-    char               *pvalue = NULL;
-    char                http_url[IOTX_HTTP_URL_LEN_MAX] = {0};
-    httpclient_t       *httpc = NULL;
-    httpclient_data_t   httpc_data = {0};
-    char               *messageId = NULL;
-    char               *user_data = NULL;
-    char               *response_message = NULL;
-    int                 len = 0;
-    uint32_t            payload_len = 0;
-    iotx_time_t         timer;
     iotx_http_t        *iotx_http_context;
-    /*
-        POST /topic/${topic} HTTP/1.1
-        Host: iot-as-http.cn-shanghai.aliyuncs.com
-        password:${token}
-        Content-Type: application/octet-stream
-        body: ${your_data}
-    */
+
     if (NULL == (iotx_http_context = verify_iotx_http_context(handle))) {
-        goto do_exit;
+        return -1;
     }
 
-    if (NULL == msg_param) {
-        log_err("iotx_http_context or msg_param NULL pointer!");
-        goto do_exit;
+    /* the token of an earlier run, until it is refreshed ahead of its lapse or refused */
+    if (0 == utils_token_load(IOTX_HTTP_TOKEN_KV_KEY, iotx_http_context->p_devinfo->product_key,
+                              iotx_http_context->p_devinfo->device_name, iotx_http_context->p_auth_token,
+                              iotx_http_context->auth_token_len, &iotx_http_token_life)) {
+        construct_http_upstream_header(iotx_http_context);
+        iotx_http_context->is_authed = 1;
+        log_info("http authenticate with the saved token");
+        return 0;
     }
 
-    httpc = (httpclient_t *)iotx_http_context->httpc;
+    return iotx_http_device_name_auth(iotx_http_context);
+}
+
+/* the context to send upstream on, refreshing its token when due, NULL when it is not authed */
+static iotx_http_t *iotx_http_upstream_context(void *handle)
+{
+    iotx_http_t *iotx_http_context;
 
-    if (NULL == httpc) {
+    if (NULL == (iotx_http_context = verify_iotx_http_context(handle))) {
+        return NULL;
+    }
+
+    if (NULL == iotx_http_context->httpc) {
         log_err("httpc null pointer");
-        goto do_exit;
+        return NULL;
     }
 
     if (0 == iotx_http_context->is_authed) {
         log_err("Device is not authed");
-        goto do_exit;
-    }
-
-    if (NULL == msg_param->request_payload) {
-        log_err("IOT_HTTP_SendMessage request_payload NULL!");
-        goto do_exit;
+        return NULL;
     }
 
-    if (NULL == msg_param->response_payload) {
-        log_err("IOT_HTTP_SendMessage response_payload NULL!");
-        goto do_exit;
+    /* ahead of its lapse, while the token in hand still serves this message when the refresh fails */
+    if (utils_token_due(&iotx_http_token_life)) {
+        utils_token_retry(&iotx_http_token_life);
+        if (0 != iotx_http_device_name_auth(iotx_http_context)) {
+            log_info("token refresh failed, retried later");
+            iotx_http_context->is_authed = 1;
+        }
     }
 
-    if (NULL == msg_param->topic_path) {
-        log_err("IOT_HTTP_SendMessage topic_path NULL!");
-        goto do_exit;
-    }
+    return iotx_http_context;
+}
 
-    payload_len = strlen(msg_param->request_payload) + 1;
-    msg_param->request_payload_len = msg_param->request_payload_len > payload_len \
-                                     ? payload_len : msg_param->request_payload_len;
+/* posts httpc_data to topic_path and checks the response of the server, 0 when the message is published */
+static int iotx_http_upstream(iotx_http_t *iotx_http_context, const char *topic_path, uint32_t timeout_ms,
+                              httpclient_data_t *httpc_data)
+{
+    int                 ret = -1;
+    int                 response_code = 0;
+    char               *pvalue = NULL;
+    char               *info = NULL;
+    int                 value_len = 0;
+    int                 info_len = 0;
+    int                 response_len = 0;
+    char                http_url[IOTX_HTTP_URL_LEN_MAX] = {0};
+    httpclient_t       *httpc = (httpclient_t *)iotx_http_context->httpc;
 
     /* Construct Auth Url */
-    construct_full_http_upstream_url(http_url, msg_param->topic_path);
-
-    len = strlen(IOTX_HTTP_HEADER_PASSWORD_STR) + strlen(iotx_http_context->p_auth_token) + strlen(
-                      IOTX_HTTP_HEADER_KEEPALIVE_STR) + strlen(IOTX_HTTP_HEADER_END_STR);
-    httpc->header = LITE_malloc(len + 1);
-    if (NULL == httpc->header) {
-        log_err("Allocate memory for httpc->header failed");
-        goto do_exit;
-    }
-    LITE_snprintf(httpc->header, len + 1,
-                  IOTX_HTTP_UPSTREAM_HEADER_STR, iotx_http_context->p_auth_token);
-    log_info("httpc->header = %s", httpc->header);
-
-    httpc_data.post_content_type = "application/octet-stream";
-    httpc_data.post_buf = msg_param->request_payload;
-    httpc_data.post_buf_len = msg_param->request_payload_len;
-    httpc_data.response_buf = msg_param->response_payload;
-    httpc_data.response_buf_len = msg_param->response_payload_len;
-
-    log_info("request_payload: \r\n\r\n%s\r\n", httpc_data.post_buf);
-
-    /* Send Request and Get Response */
-    if (iotx_post(httpc,
-                  http_url,
-                  IOTX_HTTP_ONLINE_SERVER_PORT,
-                  IOTX_HTTP_CA_GET,
-                  &httpc_data)) {
-        goto do_exit_pre;
-    }
-    iotx_time_init(&timer);
-    utils_time_countdown_ms(&timer, msg_param->timeout_ms);
-
-    ret = httpclient_recv_response(httpc, iotx_time_left(&timer), &httpc_data);
+    construct_full_http_upstream_url(http_url, topic_path);
+
+    /* built with the token when authed */
+    httpc->header = iotx_http_context->p_header;
+
+    /* Send Request and Get Response, on the connection kept from the last message with keep_alive */
+    ret = iotx_post_recv(httpc,
+                         http_url,
+                         IOTX_HTTP_ONLINE_SERVER_PORT,
+                         IOTX_HTTP_CA_GET,
+                         timeout_ms,
+                         httpc_data,
+                         iotx_http_context->keep_alive);
+    httpc->header = NULL;
     if (ret < 0) {
-        log_err("httpclient_recv_response error, ret = %d", ret);
-        httpclient_close(httpc);
-        goto do_exit_pre;
-    }
-
-    if (0 == iotx_http_context->keep_alive) {
-        httpclient_close(httpc);
+        goto do_exit;
     }
+    ret = -1;
 
     /*
         body:
@@ -716,91 +747,238 @@ int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
           }
         }
     */
-    log_info("http response: \r\n\r\n%s\r\n", httpc_data.response_buf);
+    response_len = strlen(httpc_data->response_buf);
+    log_debug("http response: %d bytes", response_len);
 
-    pvalue = LITE_json_value_of("code", httpc_data.response_buf);
-    if (!pvalue) {
-        goto do_exit_pre;
+    /* values are read in place in the response, nothing is copied out */
+    pvalue = json_get_value_by_name(httpc_data->response_buf, response_len, "code", &value_len, NULL);
+    if (NULL == pvalue) {
+        goto do_exit;
     }
 
     response_code = atoi(pvalue);
-    LITE_free(pvalue);
-    pvalue = NULL;
     log_info("response code: %d", response_code);
 
-    pvalue = LITE_json_value_of("message", httpc_data.response_buf);
+    pvalue = json_get_value_by_name(httpc_data->response_buf, response_len, "message", &value_len, NULL);
     if (NULL == pvalue) {
-        goto do_exit_pre;
+        goto do_exit;
     }
-    response_message = LITE_strdup(pvalue);
-    log_info("response_message: %s", response_message);
-    LITE_free(pvalue);
-    pvalue = NULL;
+    log_info("response_message: %.*s", value_len, pvalue);
 
     switch (response_code) {
         case IOTX_HTTP_SUCCESS:
             break;
         case IOTX_HTTP_TOKEN_EXPIRED_ERROR:
             iotx_http_context->is_authed = IOT_FALSE;
-            IOT_HTTP_DeviceNameAuth((iotx_http_t *)iotx_http_context);
+            utils_token_forget(IOTX_HTTP_TOKEN_KV_KEY);
+            iotx_http_device_name_auth((iotx_http_t *)iotx_http_context);
+            goto do_exit;
+        case IOTX_HTTP_TOKEN_CHECK_ERROR:
+            utils_token_forget(IOTX_HTTP_TOKEN_KV_KEY);
         case IOTX_HTTP_COMMON_ERROR:
         case IOTX_HTTP_PARAM_ERROR:
         case IOTX_HTTP_AUTH_CHECK_ERROR:
         case IOTX_HTTP_TOKEN_NULL_ERROR:
-        case IOTX_HTTP_TOKEN_CHECK_ERROR:
         case IOTX_HTTP_UPDATE_SESSION_ERROR:
         case IOTX_HTTP_PUBLISH_MESSAGE_ERROR:
         case IOTX_HTTP_REQUEST_TOO_MANY_ERROR:
         default:
-            goto do_exit_pre;
+            goto do_exit;
+    }
+
+    info = json_get_value_by_name(httpc_data->response_buf, response_len, "info", &info_len, NULL);
+    if (NULL == info) {
+        log_err("info: NULL");
+        goto do_exit;
     }
 
     /* info.messageId */
-    pvalue = LITE_json_value_of("info.messageId", httpc_data.response_buf);
+    pvalue = json_get_value_by_name(info, info_len, "messageId", &value_len, NULL);
     if (NULL == pvalue) {
         log_err("messageId: NULL");
-        goto do_exit_pre;
+        goto do_exit;
     }
-    messageId = pvalue;
-    log_info("messageId: %s", messageId);
-    LITE_free(pvalue);
-    pvalue = NULL;
+    log_info("messageId: %.*s", value_len, pvalue);
 
-    /* info.data */
-    pvalue = LITE_json_value_of("info.data", httpc_data.response_buf);
-    user_data = pvalue;
+    /* info.data, Maybe NULL */
+    pvalue = json_get_value_by_name(info, info_len, "data", &value_len, NULL);
+    log_debug("user_data: %d bytes", (NULL == pvalue) ? 0 : value_len);
 
-    /* Maybe NULL */
-    if (user_data) {
-        log_info("user_data: %s", user_data);
-    } else {
-        log_info("user_data: %p", user_data);
+    ret = 0;
+
+do_exit:
+
+    return ret;
+}
+
+int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
+{
+    httpclient_data_t   httpc_data = {0};
+    iotx_http_t        *iotx_http_context;
+    /*
+        POST /topic/${topic} HTTP/1.1
+        Host: iot-as-http.cn-shanghai.aliyuncs.com
+        password:${token}
+        Content-Type: application/octet-stream
+        body: ${your_data}
+    */
+    if (NULL == msg_param) {
+        log_err("iotx_http_context or msg_param NULL pointer!");
+        return -1;
     }
-    if (NULL != pvalue) {
-        LITE_free(pvalue);
+
+    if (NULL == (iotx_http_context = iotx_http_upstream_context(handle))) {
+        return -1;
     }
-    pvalue = NULL;
 
-    ret = 0;
+    if (NULL == msg_param->request_payload) {
+        log_err("IOT_HTTP_SendMessage request_payload NULL!");
+        return -1;
+    }
 
-do_exit_pre:
+    if (NULL == msg_param->response_payload) {
+        log_err("IOT_HTTP_SendMessage response_payload NULL!");
+        return -1;
+    }
 
-    if (pvalue) {
-        LITE_free(pvalue);
+    if (NULL == msg_param->topic_path) {
+        log_err("IOT_HTTP_SendMessage topic_path NULL!");
+        return -1;
     }
 
-    if (response_message) {
-        LITE_free(response_message);
+    /* binary payloads are sent as long as the caller says, a string one may leave it 0 */
+    if (0 == msg_param->request_payload_len) {
+        msg_param->request_payload_len = strlen(msg_param->request_payload) + 1;
     }
 
+    httpc_data.post_content_type = "application/octet-stream";
+    httpc_data.post_buf = msg_param->request_payload;
+    httpc_data.post_buf_len = msg_param->request_payload_len;
+    httpc_data.response_buf = msg_param->response_payload;
+    httpc_data.response_buf_len = msg_param->response_payload_len;
+
+    log_debug("request_payload: %u bytes", msg_param->request_payload_len);
+
+    return iotx_http_upstream(iotx_http_context, msg_param->topic_path, msg_param->timeout_ms, &httpc_data);
+}
+
+/* where a batch of messages is sent, as it is framed */
+typedef struct {
+    iotx_http_batch_param_t *batch_param;
+    uint32_t                 index;     /* of the message framed next */
+    int                      head;      /* the head of the message is handed next, else its payload */
+    iotx_http_batch_message_t message;
+    char                     frame[IOTX_HTTP_BATCH_FRAME_HEAD_LEN + IOTX_URI_MAX_LEN];
+} iotx_http_batch_ctx_t;
+
+/* the message of index, 0 when there is one */
+static int iotx_http_batch_message(iotx_http_batch_param_t *batch_param, uint32_t index,
+                                   iotx_http_batch_message_t *message)
+{
+    if (NULL != batch_param->messages) {
+        if (index >= batch_param->message_num) {
+            return -1;
+        }
+        *message = batch_param->messages[index];
+    } else if (0 != batch_param->next_cb(batch_param->pcontext, index, message)) {
+        return -1;
+    }
 
-    if (httpc != NULL && httpc->header) {
-        LITE_free(httpc->header);
+    /* binary payloads are sent as long as the caller says, a string one may leave it 0 */
+    if (0 == message->payload_len) {
+        message->payload_len = strlen(message->payload) + 1;
     }
 
-do_exit:
+    return 0;
+}
 
-    return ret;
+/* the body of a batch: ${topic_len:2}${payload_len:4}${topic}, then ${payload}, of each message */
+static int iotx_http_batch_post(void *ctx, const char **data, int *len)
+{
+    iotx_http_batch_ctx_t *batch = (iotx_http_batch_ctx_t *)ctx;
+    uint32_t topic_len;
+
+    if (NULL == data) {
+        batch->index = 0;
+        batch->head = 1;
+        return 0;
+    }
+
+    if (!batch->head) {
+        *data = batch->message.payload;
+        *len = (int)batch->message.payload_len;
+        batch->head = 1;
+        return 0;
+    }
+
+    if (0 != iotx_http_batch_message(batch->batch_param, batch->index, &batch->message)) {
+        *len = 0;
+        return 0;
+    }
+
+    topic_len = strlen(batch->message.topic_path);
+    if (topic_len > IOTX_URI_MAX_LEN) {
+        log_err("topic of message %u too long", (unsigned int)batch->index);
+        return -1;
+    }
+
+    batch->frame[0] = (char)(topic_len >> 8);
+    batch->frame[1] = (char)topic_len;
+    batch->frame[2] = (char)(batch->message.payload_len >> 24);
+    batch->frame[3] = (char)(batch->message.payload_len >> 16);
+    batch->frame[4] = (char)(batch->message.payload_len >> 8);
+    batch->frame[5] = (char)batch->message.payload_len;
+    memcpy(batch->frame + IOTX_HTTP_BATCH_FRAME_HEAD_LEN, batch->message.topic_path, topic_len);
+
+    *data = batch->frame;
+    *len = IOTX_HTTP_BATCH_FRAME_HEAD_LEN + topic_len;
+    batch->head = 0;
+    ++batch->index;
+
+    return 0;
+}
+
+int IOT_HTTP_SendBatch(void *handle, iotx_http_batch_param_t *batch_param)
+{
+    httpclient_data_t       httpc_data = {0};
+    iotx_http_batch_ctx_t   batch;
+    iotx_http_batch_message_t message;
+    iotx_http_t            *iotx_http_context;
+    uint32_t                index;
+    int                     body_len = 0;
+
+    if (NULL == batch_param || NULL == batch_param->response_payload
+        || (NULL == batch_param->messages && NULL == batch_param->next_cb)) {
+        log_err("batch_param, its response_payload or its messages NULL!");
+        return -1;
+    }
+
+    if (NULL == (iotx_http_context = iotx_http_upstream_context(handle))) {
+        return -1;
+    }
+
+    /* the length of a batch handed by next_cb is not known before it is sent, it goes chunked */
+    if (NULL != batch_param->messages) {
+        for (index = 0; 0 == iotx_http_batch_message(batch_param, index, &message); ++index) {
+            body_len += IOTX_HTTP_BATCH_FRAME_HEAD_LEN + strlen(message.topic_path) + message.payload_len;
+        }
+    } else {
+        body_len = -1;
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    batch.batch_param = batch_param;
+
+    httpc_data.post_content_type = IOTX_HTTP_BATCH_CONTENT_TYPE;
+    httpc_data.post_buf_len = body_len;
+    httpc_data.on_post = iotx_http_batch_post;
+    httpc_data.on_post_ctx = &batch;
+    httpc_data.response_buf = batch_param->response_payload;
+    httpc_data.response_buf_len = batch_param->response_payload_len;
+
+    log_debug("batch: %d bytes", body_len);
+
+    return iotx_http_upstream(iotx_http_context, IOTX_HTTP_BATCH_PATH, batch_param->timeout_ms, &httpc_data);
 }
 
 void IOT_HTTP_Disconnect(void *handle)
@@ -808,6 +986,9 @@ void IOT_HTTP_Disconnect(void *handle)
     iotx_http_t *iotx_http_context;
     if (NULL != (iotx_http_context = verify_iotx_http_context(handle))) {
         httpclient_close(iotx_http_context->httpc);
+#ifdef HTTP_CONN_POOL_ENABLED
+        httpclient_pool_clear(IOTX_HTTP_ONLINE_SERVER_URL "/");
+#endif
     }
 }
 
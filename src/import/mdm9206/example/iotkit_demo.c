@@ -148,8 +148,10 @@ static QCLI_Command_Status_t mqtt(uint32_t Parameter_Count, QCLI_Parameter_t *Pa
 #define MQTT_DEVICE_SECRET_LEN      (64)
 
     static char isInit = 0;
-    static char msg_buf[MSG_LEN_MAX];
-    static char msg_readbuf[MSG_LEN_MAX] ;
+    static char msg_static_buf[MSG_LEN_MAX];
+    static char msg_static_readbuf[MSG_LEN_MAX];
+    static char *msg_buf = NULL;
+    static char *msg_readbuf = NULL;
 
     static iotx_conn_info_pt pconn_info = NULL;
     static iotx_mqtt_param_t mqtt_params;
@@ -165,8 +167,6 @@ static QCLI_Command_Status_t mqtt(uint32_t Parameter_Count, QCLI_Parameter_t *Pa
     }
 
     if(isInit == 0){
-        memset(msg_buf, 0, sizeof(msg_buf));
-        memset(msg_readbuf, 0, sizeof(msg_readbuf));
         memset(&mqtt_params, 0, sizeof(mqtt_params));
         memset(product_key, 0, sizeof(product_key));
         memset(device_name, 0, sizeof(device_name));
@@ -271,6 +271,21 @@ static QCLI_Command_Status_t mqtt(uint32_t Parameter_Count, QCLI_Parameter_t *Pa
                 mqtt_params.request_timeout_ms = timeout;
                 mqtt_params.clean_session = clean;
                 mqtt_params.keepalive_interval_ms = keepalive;
+                /* kept across constructs, in the modem DMA buffers rather than module RAM if the firmware has them */
+#ifdef QAPI_IOT_MODEMBUF_ENABLED
+                if (NULL == msg_buf) {
+                    msg_buf = HAL_ModemBuf_Malloc(MSG_LEN_MAX);
+                }
+                if (NULL == msg_readbuf) {
+                    msg_readbuf = HAL_ModemBuf_Malloc(MSG_LEN_MAX);
+                }
+#endif
+                if (NULL == msg_buf) {
+                    msg_buf = msg_static_buf;
+                }
+                if (NULL == msg_readbuf) {
+                    msg_readbuf = msg_static_readbuf;
+                }
                 mqtt_params.pread_buf = msg_readbuf;
                 mqtt_params.read_buf_size = MSG_LEN_MAX;
                 mqtt_params.pwrite_buf = msg_buf;
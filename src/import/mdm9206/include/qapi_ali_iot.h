@@ -72,6 +72,13 @@
 #define TXM_QAPI_IOT_HAL_DTLSSESSION_CREATE                  TXM_QAPI_IOT_HAL_BASE+ 25
 #define TXM_QAPI_IOT_HAL_DTLSSESSION_WRITE                   TXM_QAPI_IOT_HAL_BASE+ 26
 #define TXM_QAPI_IOT_HAL_DTLSSESSION_READ                    TXM_QAPI_IOT_HAL_BASE+ 27
+/*
+*no shipped modem firmware serves these two yet, define QAPI_IOT_MODEMBUF_ENABLED for one which does
+*/
+#ifdef QAPI_IOT_MODEMBUF_ENABLED
+#define TXM_QAPI_IOT_HAL_MODEMBUF_MALLOC                     TXM_QAPI_IOT_HAL_BASE+ 28
+#define TXM_QAPI_IOT_HAL_MODEMBUF_FREE                       TXM_QAPI_IOT_HAL_BASE+ 29
+#endif
 /*SIMCOM zhangwei 2017-10-19 fixed bug end*/
 /*SIMCOM zhangwei 2017-10-26 add ota qapi and HAL base index  end*/
 #if 0
@@ -198,6 +205,9 @@
                                   (ULONG) 0,(ULONG) 0,(ULONG) 0, (ULONG) 0, (ULONG) 0, (ULONG) 0, \
                                   (ULONG) 0))
 
+/*
+*HAL_SSL_* run TLS in the secure sockets of the modem, so the module links no TLS library of its own
+*/
 #define     HAL_SSL_Establish(host,port,ca_crt,ca_crt_len)  \
     ( (_txm_module_system_call12)(TXM_QAPI_IOT_HAL_SSL_ESTABLISH ,\
                                   (ULONG) host,(ULONG) port, (ULONG) ca_crt, (ULONG) ca_crt_len,(ULONG) 0,\
@@ -314,6 +324,24 @@
                                   (ULONG) 0,(ULONG) 0,(ULONG) 0, (ULONG) 0, (ULONG) 0, (ULONG) 0, \
                                   (ULONG) 0))
 
+#ifdef QAPI_IOT_MODEMBUF_ENABLED
+/*
+*buffers of the modem, the TCP/TLS stack DMAs to and from them, for the MQTT read/write buffers;
+*they cost no module RAM and the modem copies nothing between its own buffers and the module
+*/
+#define    HAL_ModemBuf_Malloc(size) \
+    ((char*) (_txm_module_system_call12)(TXM_QAPI_IOT_HAL_MODEMBUF_MALLOC,\
+                                         (ULONG) size,(ULONG) 0, (ULONG) 0, (ULONG) 0,(ULONG) 0,\
+                                         (ULONG) 0,(ULONG) 0,(ULONG) 0, (ULONG) 0, (ULONG) 0, (ULONG) 0, \
+                                         (ULONG) 0))
+
+#define    HAL_ModemBuf_Free(ptr) \
+    ( (_txm_module_system_call12)(TXM_QAPI_IOT_HAL_MODEMBUF_FREE,\
+                                  (ULONG) ptr,(ULONG) 0, (ULONG) 0, (ULONG) 0,(ULONG) 0,\
+                                  (ULONG) 0,(ULONG) 0,(ULONG) 0, (ULONG) 0, (ULONG) 0, (ULONG) 0, \
+                                  (ULONG) 0))
+#endif /* QAPI_IOT_MODEMBUF_ENABLED */
+
 int HAL_Snprintf(_IN_ char *str, const int len, const char *fmt, ...);
 
 int HAL_Vsnprintf(_IN_ char *str, _IN_ const int len, _IN_ const char *format, va_list ap);
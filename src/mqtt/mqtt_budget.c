@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_net.h"
+#include "utils_list.h"
+#include "utils_timer.h"
+#include "sdk-impl_internal.h"
+
+#include "MQTTPacket/MQTTPacket.h"
+#include "mqtt_client.h"
+
+int IOT_MQTT_GetSendBudget(void *handle, iotx_mqtt_send_budget_pt budget)
+{
+    iotx_mc_client_t *c = (iotx_mc_client_t *)handle;
+    iotx_mc_pub_info_t *pub;
+    list_node_t *node;
+    uint32_t waiting = 0;
+
+    if (NULL == c || NULL == budget) {
+        return -1;
+    }
+
+    memset(budget, 0, sizeof(iotx_mqtt_send_budget_t));
+
+    HAL_MutexLock(c->lock_generic);
+    budget->connected = (IOTX_MC_STATE_CONNECTED == c->client_state) ? 1 : 0;
+    budget->packet_len = c->buf_size_send;
+    HAL_MutexUnlock(c->lock_generic);
+
+    /* a node given up holds its slot till the next yield frees it, as the client counts them */
+    if (NULL != c->list_pub_wait_ack) {
+        HAL_MutexLock(c->lock_list_pub);
+        waiting = c->list_pub_wait_ack->len;
+        for (node = c->list_pub_wait_ack->head; NULL != node; node = node->next) {
+            pub = (iotx_mc_pub_info_t *)node->val;
+            if (NULL != pub && IOTX_MC_NODE_STATE_INVALID != pub->node_state) {
+                budget->pub_bytes += pub->len;
+            }
+        }
+        HAL_MutexUnlock(c->lock_list_pub);
+    }
+
+    budget->pub_slots = (waiting < IOTX_MC_REPUB_NUM_MAX) ? IOTX_MC_REPUB_NUM_MAX - waiting : 0;
+
+    return 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "lite-metrics.h"
+#include "utils_net.h"
+#include "utils_list.h"
+#include "utils_timer.h"
+#include "sdk-impl_internal.h"
+
+#include "MQTTPacket/MQTTPacket.h"
+#include "mqtt_client.h"
+
+/*
+ * Growable buffers of the client.
+ *
+ * The pread_buf and pwrite_buf given to the client stay its buffers for the packets they hold. A
+ * packet longer is read into, or published from, a buffer of the smallest size class it fits in,
+ * taken from a pool all the clients share. Once no packet needed it for CONFIG_MQTT_BUFFER_IDLE_MS
+ * the buffer goes back to the pool and the client to its own, a buffer of the pool none took again
+ * in that time is freed.
+ *
+ * The read buffer is changed on the last remaining length byte of a packet, as the client reads it
+ * one byte at a time just before the rest, the write buffer before a publish under the lock of it.
+ */
+
+#define MQTT_BUFFER_CLIENT_MAX          (2)
+
+/* classes of CONFIG_MQTT_BUFFER_CLASS_MIN bytes, doubling */
+#define MQTT_BUFFER_CLASSES             (8)
+
+typedef struct {
+    char                       *buf;
+    uint64_t                    freed_ms;
+} mqtt_buffer_free_t;
+
+typedef struct {
+    iotx_mc_client_t           *client;
+    utils_network_pt            network;
+    uint32_t                    max_len;
+
+    char                       *base_read;
+    uint32_t                    base_read_len;
+    char                       *base_send;
+    uint32_t                    base_send_len;
+
+    int (*read_raw)(utils_network_pt, char *, uint32_t, uint32_t);
+    int (*up_process_raw)(char *, iotx_mqtt_topic_info_pt);
+
+    uint64_t                    read_used_ms;   /* last packet that needed the read buffer of the pool */
+    uint64_t                    send_used_ms;   /* guarded by lock_write_buf of the client */
+
+    /* remaining length of the packet read, of the read thread */
+    int                         in_length;      /* the reads of one byte are of the remaining length */
+    int                         length_bytes;
+    uint32_t                    length;
+    uint32_t                    multiplier;
+} mqtt_buffer_t;
+
+static mqtt_buffer_t g_mqtt_buffer[MQTT_BUFFER_CLIENT_MAX];
+
+static void *g_mqtt_buffer_lock = NULL;
+static mqtt_buffer_free_t g_mqtt_buffer_free[MQTT_BUFFER_CLASSES];
+static int g_mqtt_buffer_bytes = 0;     /* taken of the pool and kept free in it */
+static int g_mqtt_buffer_peak = 0;
+
+LITE_METRIC_DEFINE_GAUGE(mqtt_buffer_bytes, "mqtt.buffer", NULL);
+LITE_METRIC_DEFINE_GAUGE(mqtt_buffer_peak, "mqtt.buffer.peak", NULL);
+
+static mqtt_buffer_t *_mqtt_buffer_find(utils_network_pt network, void *client)
+{
+    int i;
+
+    for (i = 0; i < MQTT_BUFFER_CLIENT_MAX; i++) {
+        if (NULL != g_mqtt_buffer[i].network
+            && (network == g_mqtt_buffer[i].network || client == g_mqtt_buffer[i].client)) {
+            return &g_mqtt_buffer[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int _mqtt_buffer_class(uint32_t len)
+{
+    int cls;
+
+    for (cls = 0; cls < MQTT_BUFFER_CLASSES; cls++) {
+        if (len <= ((uint32_t)CONFIG_MQTT_BUFFER_CLASS_MIN << cls)) {
+            return cls;
+        }
+    }
+
+    return -1;
+}
+
+/* frees what nobody took in CONFIG_MQTT_BUFFER_IDLE_MS, called with g_mqtt_buffer_lock held */
+static void _mqtt_buffer_pool_trim(void)
+{
+    uint64_t now = HAL_UptimeMs();
+    int cls;
+
+    for (cls = 0; cls < MQTT_BUFFER_CLASSES; cls++) {
+        if (NULL != g_mqtt_buffer_free[cls].buf && now - g_mqtt_buffer_free[cls].freed_ms > CONFIG_MQTT_BUFFER_IDLE_MS) {
+            HAL_Free(g_mqtt_buffer_free[cls].buf);
+            g_mqtt_buffer_free[cls].buf = NULL;
+            g_mqtt_buffer_bytes -= CONFIG_MQTT_BUFFER_CLASS_MIN << cls;
+        }
+    }
+    LITE_METRIC_SET(mqtt_buffer_bytes, g_mqtt_buffer_bytes);
+}
+
+static char *_mqtt_buffer_take(int cls)
+{
+    char *buf;
+
+    HAL_MutexLock(g_mqtt_buffer_lock);
+    buf = g_mqtt_buffer_free[cls].buf;
+    g_mqtt_buffer_free[cls].buf = NULL;
+    if (NULL == buf && NULL != (buf = HAL_Malloc(CONFIG_MQTT_BUFFER_CLASS_MIN << cls))) {
+        g_mqtt_buffer_bytes += CONFIG_MQTT_BUFFER_CLASS_MIN << cls;
+        if (g_mqtt_buffer_bytes > g_mqtt_buffer_peak) {
+            g_mqtt_buffer_peak = g_mqtt_buffer_bytes;
+            LITE_METRIC_SET(mqtt_buffer_peak, g_mqtt_buffer_peak);
+        }
+    }
+    _mqtt_buffer_pool_trim();
+    HAL_MutexUnlock(g_mqtt_buffer_lock);
+
+    if (NULL == buf) {
+        log_err("no memory for a buffer of %d bytes", CONFIG_MQTT_BUFFER_CLASS_MIN << cls);
+    }
+    return buf;
+}
+
+static void _mqtt_buffer_give(char *buf, uint32_t len)
+{
+    int cls = _mqtt_buffer_class(len);
+
+    HAL_MutexLock(g_mqtt_buffer_lock);
+    if (NULL != g_mqtt_buffer_free[cls].buf) {
+        HAL_Free(g_mqtt_buffer_free[cls].buf);
+        g_mqtt_buffer_bytes -= len;
+    }
+    g_mqtt_buffer_free[cls].buf = buf;
+    g_mqtt_buffer_free[cls].freed_ms = HAL_UptimeMs();
+    _mqtt_buffer_pool_trim();
+    HAL_MutexUnlock(g_mqtt_buffer_lock);
+}
+
+/* the read buffer fits a packet of len bytes, header byte kept, of the read thread */
+static int _mqtt_buffer_read_fit(mqtt_buffer_t *mb, uint32_t len)
+{
+    iotx_mc_client_t *c = mb->client;
+    int cls;
+    char *buf;
+
+    if (len > mb->base_read_len) {
+        mb->read_used_ms = HAL_UptimeMs();
+    }
+    if (len <= c->buf_size_read) {
+        return 0;
+    }
+    if (len > mb->max_len || 0 > (cls = _mqtt_buffer_class(len)) || NULL == (buf = _mqtt_buffer_take(cls))) {
+        /* the client drops it as too long */
+        return -1;
+    }
+
+    buf[0] = c->buf_read[0];
+    if (c->buf_read != mb->base_read) {
+        _mqtt_buffer_give(c->buf_read, c->buf_size_read);
+    }
+    c->buf_read = buf;
+    c->buf_size_read = CONFIG_MQTT_BUFFER_CLASS_MIN << cls;
+
+    return 0;
+}
+
+/* back to the buffers of the client once the ones of the pool are idle, of the read thread */
+static void _mqtt_buffer_shrink(mqtt_buffer_t *mb, int all)
+{
+    iotx_mc_client_t *c = mb->client;
+    uint64_t now = HAL_UptimeMs();
+
+    if (c->buf_read != mb->base_read && (all || now - mb->read_used_ms > CONFIG_MQTT_BUFFER_IDLE_MS)) {
+        _mqtt_buffer_give(c->buf_read, c->buf_size_read);
+        c->buf_read = mb->base_read;
+        c->buf_size_read = mb->base_read_len;
+    }
+
+    if (c->buf_send != mb->base_send) {
+        HAL_MutexLock(c->lock_write_buf);
+        if (c->buf_send != mb->base_send && (all || now - mb->send_used_ms > CONFIG_MQTT_BUFFER_IDLE_MS)) {
+            _mqtt_buffer_give(c->buf_send, c->buf_size_send);
+            c->buf_send = mb->base_send;
+            c->buf_size_send = mb->base_send_len;
+        }
+        HAL_MutexUnlock(c->lock_write_buf);
+    }
+
+    HAL_MutexLock(g_mqtt_buffer_lock);
+    _mqtt_buffer_pool_trim();
+    HAL_MutexUnlock(g_mqtt_buffer_lock);
+}
+
+static int _mqtt_buffer_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    mqtt_buffer_t *mb = _mqtt_buffer_find(pNetwork, NULL);
+    iotx_mc_client_t *c;
+    int ret;
+
+    if (NULL == mb) {
+        return -1;
+    }
+    c = mb->client;
+
+    if (1 == len && buffer == c->buf_read) {
+        /* header of the next packet */
+        _mqtt_buffer_shrink(mb, 0);
+        ret = mb->read_raw(pNetwork, c->buf_read, len, timeout_ms);
+        mb->in_length = (1 == ret);
+        mb->length_bytes = 0;
+        mb->length = 0;
+        mb->multiplier = 1;
+        return ret;
+    }
+
+    ret = mb->read_raw(pNetwork, buffer, len, timeout_ms);
+    if (!mb->in_length || 1 != len) {
+        return ret;
+    }
+    if (1 != ret) {
+        mb->in_length = 0;
+        return ret;
+    }
+
+    mb->length += ((unsigned char)buffer[0] & 127) * mb->multiplier;
+    mb->multiplier *= 128;
+    mb->length_bytes++;
+    if (0 == ((unsigned char)buffer[0] & 128)) {
+        _mqtt_buffer_read_fit(mb, 1 + mb->length_bytes + mb->length);
+        mb->in_length = 0;
+    }
+
+    return ret;
+}
+
+/* the write buffer fits the publish, before the client takes lock_write_buf for it */
+static int _mqtt_buffer_up_process(mqtt_buffer_t *mb, char *topic, iotx_mqtt_topic_info_pt topic_msg)
+{
+    iotx_mc_client_t *c = mb->client;
+    uint32_t len;
+    int rc = 0;
+    int cls;
+    char *buf;
+
+    if (NULL != mb->up_process_raw) {
+        rc = mb->up_process_raw(topic, topic_msg);
+    }
+
+    /* fixed header, topic length, topic, packet id and payload */
+    len = 5 + 2 + strlen(topic) + 2 + topic_msg->payload_len;
+    if (len <= mb->base_send_len) {
+        return rc;
+    }
+
+    HAL_MutexLock(c->lock_write_buf);
+    mb->send_used_ms = HAL_UptimeMs();
+    if (len > c->buf_size_send && len <= mb->max_len && 0 <= (cls = _mqtt_buffer_class(len))
+        && NULL != (buf = _mqtt_buffer_take(cls))) {
+        if (c->buf_send != mb->base_send) {
+            _mqtt_buffer_give(c->buf_send, c->buf_size_send);
+        }
+        c->buf_send = buf;
+        c->buf_size_send = CONFIG_MQTT_BUFFER_CLASS_MIN << cls;
+    }
+    HAL_MutexUnlock(c->lock_write_buf);
+
+    return rc;
+}
+
+/* the hook has no client, one of these per slot */
+static int _mqtt_buffer_up_process_0(char *topic, iotx_mqtt_topic_info_pt topic_msg)
+{
+    return _mqtt_buffer_up_process(&g_mqtt_buffer[0], topic, topic_msg);
+}
+
+static int _mqtt_buffer_up_process_1(char *topic, iotx_mqtt_topic_info_pt topic_msg)
+{
+    return _mqtt_buffer_up_process(&g_mqtt_buffer[1], topic, topic_msg);
+}
+
+static int (*const g_mqtt_buffer_up_process[MQTT_BUFFER_CLIENT_MAX])(char *, iotx_mqtt_topic_info_pt) = {
+    _mqtt_buffer_up_process_0,
+    _mqtt_buffer_up_process_1
+};
+
+static void _mqtt_buffer_unbind(mqtt_buffer_t *mb)
+{
+    iotx_mc_client_t *c = mb->client;
+
+    _mqtt_buffer_shrink(mb, 1);
+    mb->network->read = mb->read_raw;
+    c->mqtt_up_process = mb->up_process_raw;
+    memset(mb, 0, sizeof(mqtt_buffer_t));
+}
+
+int IOT_MQTT_SetBufferGrowth(void *handle, uint32_t max_len)
+{
+    iotx_mc_client_t *c = (iotx_mc_client_t *)handle;
+    mqtt_buffer_t *mb;
+    int i;
+
+    if (NULL == c || NULL == c->ipstack || (0 != max_len && 0 > _mqtt_buffer_class(max_len))) {
+        log_err("param error");
+        return -1;
+    }
+
+    mb = _mqtt_buffer_find(c->ipstack, c);
+    if (NULL != mb && (mb->network != c->ipstack || mb->client != c)) {
+        /* of a client destroyed without ending the mode, whose memory is taken again */
+        memset(mb, 0, sizeof(mqtt_buffer_t));
+        mb = NULL;
+    }
+
+    if (0 == max_len) {
+        if (NULL != mb) {
+            _mqtt_buffer_unbind(mb);
+        }
+        return 0;
+    }
+
+    if (NULL != mb) {
+        mb->max_len = max_len;
+        return 0;
+    }
+
+    for (i = 0; i < MQTT_BUFFER_CLIENT_MAX; i++) {
+        if (NULL == g_mqtt_buffer[i].network) {
+            mb = &g_mqtt_buffer[i];
+            break;
+        }
+    }
+    if (NULL == mb) {
+        log_err("MQTT_BUFFER_CLIENT_MAX clients with growable buffers already");
+        return -1;
+    }
+
+    if (NULL == g_mqtt_buffer_lock) {
+        if (NULL == (g_mqtt_buffer_lock = HAL_MutexCreate())) {
+            log_err("create mutex failed");
+            return -1;
+        }
+        LITE_METRIC_REGISTER(mqtt_buffer_bytes);
+        LITE_METRIC_REGISTER(mqtt_buffer_peak);
+    }
+
+    memset(mb, 0, sizeof(mqtt_buffer_t));
+    mb->client = c;
+    mb->max_len = max_len;
+    mb->base_read = c->buf_read;
+    mb->base_read_len = c->buf_size_read;
+    mb->base_send = c->buf_send;
+    mb->base_send_len = c->buf_size_send;
+
+    mb->read_raw = c->ipstack->read;
+    mb->up_process_raw = c->mqtt_up_process;
+    mb->network = c->ipstack;
+
+    c->ipstack->read = _mqtt_buffer_read;
+    c->mqtt_up_process = g_mqtt_buffer_up_process[mb - g_mqtt_buffer];
+
+    return 0;
+}
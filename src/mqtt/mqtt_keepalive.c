@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_net.h"
+#include "utils_list.h"
+#include "utils_timer.h"
+#include "sdk-impl_internal.h"
+
+#include "MQTTPacket/MQTTPacket.h"
+#include "mqtt_client.h"
+
+/*
+ * Adaptive keep-alive, on the network of the client.
+ *
+ * The keep-alive interval of the CONNECT stays what the server is told, the ceiling. Below it the
+ * client pings once the connection was idle for the longest interval a ping was answered after on
+ * this network, the safe one. Till the safe and the shortest one a ping was lost after are less
+ * than CONFIG_MQTT_KEEPALIVE_STEP_MS apart, the ping goes after the idle interval halfway between
+ * them instead, a probe. A ping is lost when nothing comes in CONFIG_MQTT_KEEPALIVE_ANSWER_MS, the
+ * read fails then so the client reconnects at once instead of after its missed pings. Both
+ * intervals are kept in kv per network, so a network is probed once.
+ *
+ * Any packet read or written puts the ping off, a packet read only up to the ceiling after the last
+ * one written, as the server wants one of the client in each keep-alive interval.
+ */
+
+#ifndef MQTT_KEEPALIVE_CLIENT_MAX
+    #define MQTT_KEEPALIVE_CLIENT_MAX   (2)
+#endif
+
+#define MQTT_KEEPALIVE_KV_FMT           "mqtt.ka.%08x"
+#define MQTT_KEEPALIVE_KV_LEN           (sizeof("mqtt.ka.") + 8)
+
+typedef struct {
+    uint32_t                    safe_ms;
+    uint32_t                    unsafe_ms;  /* 0 while not known */
+} mqtt_keepalive_kv_t;
+
+typedef struct {
+    iotx_mc_client_t           *client;
+    utils_network_pt            network;
+    void                       *lock;
+    char                        key[MQTT_KEEPALIVE_KV_LEN];
+
+    int (*read_raw)(utils_network_pt, char *, uint32_t, uint32_t);
+    int (*write_raw)(utils_network_pt, const char *, uint32_t, uint32_t);
+    int (*writev_raw)(utils_network_pt, const hal_iovec_t *, uint32_t, uint32_t);
+    int (*connect_raw)(utils_network_pt);
+
+    /* guarded by lock */
+    mqtt_keepalive_kv_t         known;
+    uint32_t                    interval_ms;    /* idle the next ping goes after */
+    uint64_t                    last_ms;        /* last packet read or written */
+    uint64_t                    last_tx_ms;     /* last packet written */
+    uint64_t                    ping_ms;        /* the ping waiting for an answer went then, 0 for none */
+    uint32_t                    probe_ms;       /* idle interval of that ping when it is a probe, else 0 */
+} mqtt_keepalive_t;
+
+static mqtt_keepalive_t g_keepalive[MQTT_KEEPALIVE_CLIENT_MAX];
+
+static mqtt_keepalive_t *_keepalive_find(utils_network_pt network, void *client)
+{
+    int i;
+
+    for (i = 0; i < MQTT_KEEPALIVE_CLIENT_MAX; i++) {
+        if (NULL != g_keepalive[i].network
+            && (network == g_keepalive[i].network || client == g_keepalive[i].client)) {
+            return &g_keepalive[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint32_t _keepalive_ceiling(mqtt_keepalive_t *ka)
+{
+    return (uint32_t)ka->client->connect_data.keepAliveInterval * 1000;
+}
+
+/* the idle interval the next ping goes after, called with lock held */
+static void _keepalive_plan(mqtt_keepalive_t *ka)
+{
+    uint32_t ceiling = _keepalive_ceiling(ka);
+    uint32_t high = ceiling + CONFIG_MQTT_KEEPALIVE_STEP_MS;
+
+    if (0 != ka->known.unsafe_ms && ka->known.unsafe_ms < high) {
+        high = ka->known.unsafe_ms;
+    }
+
+    if (ka->known.safe_ms >= ceiling) {
+        ka->interval_ms = ceiling;
+    } else if (high - ka->known.safe_ms > CONFIG_MQTT_KEEPALIVE_STEP_MS) {
+        ka->interval_ms = ka->known.safe_ms + (high - ka->known.safe_ms) / 2;
+        if (ka->interval_ms > ceiling) {
+            ka->interval_ms = ceiling;
+        }
+    } else {
+        ka->interval_ms = ka->known.safe_ms;
+    }
+}
+
+/* what was learnt of the network, called with lock held */
+static void _keepalive_learnt(mqtt_keepalive_t *ka)
+{
+    log_info("keepalive %s: safe %u ms, unsafe %u ms", ka->key,
+             (unsigned int)ka->known.safe_ms, (unsigned int)ka->known.unsafe_ms);
+
+    HAL_Kv_Set(ka->key, &ka->known, sizeof(mqtt_keepalive_kv_t), 1);
+    _keepalive_plan(ka);
+}
+
+/* the client pings when the next ping is due, called with lock held */
+static void _keepalive_schedule(mqtt_keepalive_t *ka)
+{
+    uint64_t now = HAL_UptimeMs();
+    uint64_t due = ka->last_ms + ka->interval_ms;
+
+    if (ka->last_tx_ms + _keepalive_ceiling(ka) < due) {
+        due = ka->last_tx_ms + _keepalive_ceiling(ka);
+    }
+
+    utils_time_countdown_ms(&ka->client->next_ping_time, (due > now) ? (uint32_t)(due - now) : 0);
+}
+
+/* a ping waiting for an answer is lost, called with lock held */
+static void _keepalive_lost(mqtt_keepalive_t *ka)
+{
+    if (0 != ka->probe_ms) {
+        ka->known.unsafe_ms = ka->probe_ms;
+    } else if (ka->interval_ms == ka->known.safe_ms && ka->known.safe_ms > CONFIG_MQTT_KEEPALIVE_MIN_MS) {
+        /* the network changed its mind, search below what was safe */
+        ka->known.unsafe_ms = ka->known.safe_ms;
+        ka->known.safe_ms /= 2;
+        if (ka->known.safe_ms < CONFIG_MQTT_KEEPALIVE_MIN_MS) {
+            ka->known.safe_ms = CONFIG_MQTT_KEEPALIVE_MIN_MS;
+        }
+    } else {
+        ka->ping_ms = 0;
+        return;
+    }
+
+    log_warning("ping after %u ms idle lost", (unsigned int)ka->interval_ms);
+    ka->ping_ms = 0;
+    ka->probe_ms = 0;
+    _keepalive_learnt(ka);
+}
+
+static void _keepalive_written(mqtt_keepalive_t *ka, const char *buf, uint32_t len)
+{
+    uint64_t now = HAL_UptimeMs();
+
+    HAL_MutexLock(ka->lock);
+    if (2 == len && 0xC0 == (unsigned char)buf[0] && 0 == ka->ping_ms) {
+        ka->ping_ms = now;
+        ka->probe_ms = (ka->interval_ms > ka->known.safe_ms && now - ka->last_ms >= ka->interval_ms) ?
+                       (uint32_t)(now - ka->last_ms) : 0;
+    }
+    ka->last_ms = now;
+    ka->last_tx_ms = now;
+    _keepalive_schedule(ka);
+    HAL_MutexUnlock(ka->lock);
+}
+
+static int _keepalive_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    mqtt_keepalive_t *ka = _keepalive_find(pNetwork, NULL);
+    int ret;
+
+    if (NULL == ka) {
+        return -1;
+    }
+
+    ret = ka->read_raw(pNetwork, buffer, len, timeout_ms);
+
+    HAL_MutexLock(ka->lock);
+    if (ret > 0) {
+        if (0 != ka->ping_ms && 0 != ka->probe_ms) {
+            ka->known.safe_ms = ka->probe_ms;
+            ka->probe_ms = 0;
+            _keepalive_learnt(ka);
+        }
+        ka->ping_ms = 0;
+        ka->last_ms = HAL_UptimeMs();
+    } else if (0 != ka->ping_ms && (ret < 0 || HAL_UptimeMs() - ka->ping_ms > CONFIG_MQTT_KEEPALIVE_ANSWER_MS)) {
+        _keepalive_lost(ka);
+        ret = -1;
+    }
+    /* on every read, the client puts the ping at the ceiling after a reconnect */
+    _keepalive_schedule(ka);
+    HAL_MutexUnlock(ka->lock);
+
+    return ret;
+}
+
+static int _keepalive_write(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    mqtt_keepalive_t *ka = _keepalive_find(pNetwork, NULL);
+    int ret;
+
+    if (NULL == ka) {
+        return -1;
+    }
+
+    ret = ka->write_raw(pNetwork, buffer, len, timeout_ms);
+    if (ret > 0) {
+        _keepalive_written(ka, buffer, len);
+    }
+
+    return ret;
+}
+
+static int _keepalive_writev(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    mqtt_keepalive_t *ka = _keepalive_find(pNetwork, NULL);
+    int ret;
+
+    if (NULL == ka) {
+        return -1;
+    }
+
+    ret = ka->writev_raw(pNetwork, iov, iovcnt, timeout_ms);
+    if (ret > 0 && iovcnt > 0) {
+        _keepalive_written(ka, iov[0].buf, (1 == iovcnt) ? iov[0].len : 0);
+    }
+
+    return ret;
+}
+
+static int _keepalive_connect(utils_network_pt pNetwork)
+{
+    mqtt_keepalive_t *ka = _keepalive_find(pNetwork, NULL);
+
+    if (NULL == ka) {
+        return -1;
+    }
+
+    HAL_MutexLock(ka->lock);
+    ka->ping_ms = 0;
+    ka->probe_ms = 0;
+    HAL_MutexUnlock(ka->lock);
+
+    return ka->connect_raw(pNetwork);
+}
+
+static void _keepalive_load(mqtt_keepalive_t *ka, const char *network_id)
+{
+    uint32_t hash = 2166136261u;
+    int len = sizeof(mqtt_keepalive_kv_t);
+
+    for (; '\0' != *network_id; network_id++) {
+        hash = (hash ^ (unsigned char)*network_id) * 16777619u;
+    }
+    HAL_Snprintf(ka->key, sizeof(ka->key), MQTT_KEEPALIVE_KV_FMT, (unsigned int)hash);
+
+    if (0 != HAL_Kv_Get(ka->key, &ka->known, &len) || sizeof(mqtt_keepalive_kv_t) != len
+        || ka->known.safe_ms < CONFIG_MQTT_KEEPALIVE_MIN_MS) {
+        ka->known.safe_ms = CONFIG_MQTT_KEEPALIVE_MIN_MS;
+        ka->known.unsafe_ms = 0;
+    }
+    if (ka->known.unsafe_ms <= ka->known.safe_ms) {
+        ka->known.unsafe_ms = 0;
+    }
+
+    _keepalive_plan(ka);
+    log_info("keepalive %s: safe %u ms, pings after %u ms idle", ka->key,
+             (unsigned int)ka->known.safe_ms, (unsigned int)ka->interval_ms);
+}
+
+static void _keepalive_unbind(mqtt_keepalive_t *ka)
+{
+    utils_network_pt network = ka->network;
+
+    network->read = ka->read_raw;
+    network->write = ka->write_raw;
+    network->writev = ka->writev_raw;
+    network->connect = ka->connect_raw;
+
+    HAL_MutexLock(ka->lock);
+    ka->network = NULL;
+    HAL_MutexUnlock(ka->lock);
+    HAL_MutexDestroy(ka->lock);
+    memset(ka, 0, sizeof(mqtt_keepalive_t));
+}
+
+int IOT_MQTT_SetKeepaliveAdaptive(void *handle, const char *network_id)
+{
+    iotx_mc_client_t *c = (iotx_mc_client_t *)handle;
+    mqtt_keepalive_t *ka;
+    int i;
+
+    if (NULL == c || NULL == c->ipstack) {
+        log_err("param error");
+        return -1;
+    }
+
+    ka = _keepalive_find(c->ipstack, c);
+    if (NULL != ka && (ka->network != c->ipstack || ka->client != c)) {
+        /* of a client destroyed without ending the mode, whose memory is taken again */
+        HAL_MutexDestroy(ka->lock);
+        memset(ka, 0, sizeof(mqtt_keepalive_t));
+        ka = NULL;
+    }
+
+    if (NULL == network_id) {
+        if (NULL != ka) {
+            _keepalive_unbind(ka);
+        }
+        return 0;
+    }
+
+    if (NULL != ka) {
+        HAL_MutexLock(ka->lock);
+        _keepalive_load(ka, network_id);
+        _keepalive_schedule(ka);
+        HAL_MutexUnlock(ka->lock);
+        return 0;
+    }
+
+    for (i = 0; i < MQTT_KEEPALIVE_CLIENT_MAX; i++) {
+        if (NULL == g_keepalive[i].network) {
+            ka = &g_keepalive[i];
+            break;
+        }
+    }
+    if (NULL == ka) {
+        log_err("MQTT_KEEPALIVE_CLIENT_MAX clients adaptive already");
+        return -1;
+    }
+
+    memset(ka, 0, sizeof(mqtt_keepalive_t));
+    if (NULL == (ka->lock = HAL_MutexCreate())) {
+        log_err("create mutex failed");
+        return -1;
+    }
+
+    ka->client = c;
+    ka->last_ms = HAL_UptimeMs();
+    ka->last_tx_ms = ka->last_ms;
+    _keepalive_load(ka, network_id);
+
+    ka->read_raw = c->ipstack->read;
+    ka->write_raw = c->ipstack->write;
+    ka->writev_raw = c->ipstack->writev;
+    ka->connect_raw = c->ipstack->connect;
+    ka->network = c->ipstack;
+
+    c->ipstack->read = _keepalive_read;
+    c->ipstack->write = _keepalive_write;
+    c->ipstack->writev = _keepalive_writev;
+    c->ipstack->connect = _keepalive_connect;
+
+    HAL_MutexLock(ka->lock);
+    _keepalive_schedule(ka);
+    HAL_MutexUnlock(ka->lock);
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "lite-utils.h"
+#include "utils_identity.h"
+#include "utils_epoch_time.h"
+#include "utils_net.h"
+#include "utils_list.h"
+#include "utils_timer.h"
+#include "sdk-impl_internal.h"
+
+#include "MQTTPacket/MQTTPacket.h"
+#include "mqtt_client.h"
+
+/*
+ * The cloud ntp topic: the request carries the uptime it was sent at, the response adds when the
+ * server got it and sent the reply, so the middle of the two server times is taken to be the middle
+ * of the round-trip on the device. The reply comes in a yield like any message, nothing waits on it.
+ */
+
+#define MQTT_NTP_TOPIC_FMT          "/ext/ntp/%s/%s/%s"
+#define MQTT_NTP_TOPIC_LEN          (PRODUCT_KEY_MAXLEN + DEVICE_NAME_MAXLEN + 18)
+#define MQTT_NTP_PAYLOAD_LEN        (64)
+
+/* it stays subscribed, so the filter may not be on the stack */
+static char g_ntp_response_topic[MQTT_NTP_TOPIC_LEN];
+
+static uint64_t _ntp_number(const char *val, int len)
+{
+    uint64_t num = 0;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if (val[i] >= '0' && val[i] <= '9') {
+            num = num * 10 + (val[i] - '0');
+        }
+    }
+
+    return num;
+}
+
+static uint64_t _ntp_value_of(char *key, char *payload, int payload_len)
+{
+    char *val;
+    int val_len = 0;
+
+    val = LITE_json_value_of_ext2(key, payload, payload_len, &val_len);
+    if (NULL == val) {
+        return 0;
+    }
+
+    return _ntp_number(val, val_len);
+}
+
+static void _ntp_response_handle(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    iotx_mqtt_topic_info_pt topic_info = (iotx_mqtt_topic_info_pt)msg->msg;
+    uint64_t recv_ms = HAL_UptimeMs();
+    uint64_t device_send, server_recv, server_send;
+
+    (void)pcontext;
+    (void)pclient;
+
+    if (IOTX_MQTT_EVENT_PUBLISH_RECVEIVED != msg->event_type || NULL == topic_info) {
+        return;
+    }
+
+    device_send = _ntp_value_of("deviceSendTime", (char *)topic_info->payload, topic_info->payload_len);
+    server_recv = _ntp_value_of("serverRecvTime", (char *)topic_info->payload, topic_info->payload_len);
+    server_send = _ntp_value_of("serverSendTime", (char *)topic_info->payload, topic_info->payload_len);
+    if (0 == server_recv || 0 == server_send || device_send > recv_ms) {
+        log_err("bad ntp response: %.*s", topic_info->payload_len, (char *)topic_info->payload);
+        return;
+    }
+
+    utils_epoch_time_set((server_recv + server_send) / 2, device_send + (recv_ms - device_send) / 2);
+    log_debug("epoch time synced, round-trip %u ms", (uint32_t)(recv_ms - device_send));
+}
+
+/*
+ * 1 when the client has the handler of the response or waits for its SUBACK. It is asked of the client
+ * itself, so a client destroyed and one constructed after it, at the same address maybe, are told apart.
+ */
+static int _ntp_subscribed(iotx_mc_client_t *c)
+{
+    iotx_mc_subsribe_info_t *sub;
+    list_node_t *node;
+    int found = 0;
+    int i;
+
+    HAL_MutexLock(c->lock_generic);
+    for (i = 0; i < IOTX_MC_SUB_NUM_MAX && !found; i++) {
+        found = (_ntp_response_handle == c->sub_handle[i].handle.h_fp);
+    }
+    HAL_MutexUnlock(c->lock_generic);
+
+    if (!found && NULL != c->list_sub_wait_ack) {
+        HAL_MutexLock(c->lock_list_sub);
+        for (node = c->list_sub_wait_ack->head; NULL != node && !found; node = node->next) {
+            sub = (iotx_mc_subsribe_info_t *)node->val;
+            found = (NULL != sub && IOTX_MC_NODE_STATE_INVALID != sub->node_state && SUBSCRIBE == sub->type &&
+                     _ntp_response_handle == sub->handler.handle.h_fp);
+        }
+        HAL_MutexUnlock(c->lock_list_sub);
+    }
+
+    return found;
+}
+
+int IOT_MQTT_SyncTime(void *handle)
+{
+    const utils_identity_t *identity = utils_identity_get();
+    char topic[MQTT_NTP_TOPIC_LEN];
+    char payload[MQTT_NTP_PAYLOAD_LEN];
+    iotx_mqtt_topic_info_t topic_msg;
+    int ret;
+
+    if (NULL == handle) {
+        log_err("param error");
+        return NULL_VALUE_ERROR;
+    }
+
+    if (!_ntp_subscribed((iotx_mc_client_t *)handle)) {
+        HAL_Snprintf(g_ntp_response_topic, sizeof(g_ntp_response_topic), MQTT_NTP_TOPIC_FMT,
+                     identity->product_key, identity->device_name, "response");
+        ret = IOT_MQTT_Subscribe(handle, g_ntp_response_topic, IOTX_MQTT_QOS0, _ntp_response_handle, NULL);
+        if (ret < 0) {
+            log_err("subscribe ntp response failed, %d", ret);
+            return ret;
+        }
+    }
+
+    HAL_Snprintf(topic, sizeof(topic), MQTT_NTP_TOPIC_FMT, identity->product_key, identity->device_name, "request");
+    HAL_Snprintf(payload, sizeof(payload), "{\"deviceSendTime\":\"%llu\"}", (unsigned long long)HAL_UptimeMs());
+
+    memset(&topic_msg, 0, sizeof(iotx_mqtt_topic_info_t));
+    topic_msg.qos = IOTX_MQTT_QOS0;
+    topic_msg.payload = payload;
+    topic_msg.payload_len = strlen(payload);
+
+    return IOT_MQTT_Publish(handle, topic, &topic_msg);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_region.h"
+
+#ifdef REGION_AUTO_ENABLED
+/*
+ * The guider builds the endpoint of the domain setup here, the networks of utils_net.c move to the
+ * one of the next region themselves when the endpoint stops answering, see utils_region.h.
+ */
+int IOT_SetupDomainAuto(const char *product_key)
+{
+    int domain_type = utils_region_select(product_key);
+
+    if (domain_type >= 0) {
+        IOT_SetupDomain(domain_type);
+    }
+
+    return domain_type;
+}
+#endif  /* #ifdef REGION_AUTO_ENABLED */
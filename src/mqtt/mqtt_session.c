@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_net.h"
+#include "utils_list.h"
+#include "utils_timer.h"
+#include "sdk-impl_internal.h"
+
+#include "MQTTPacket/MQTTPacket.h"
+#include "mqtt_client.h"
+
+/*
+ * The client parses CONNACK in its read buffer and keeps only the return code, the buffer holds
+ * the packet until the next one is read, which is after IOTX_MQTT_EVENT_RECONNECT is handled.
+ */
+int IOT_MQTT_SessionPresent(void *handle)
+{
+    iotx_mc_client_t *c = (iotx_mc_client_t *)handle;
+    unsigned char *connack;
+
+    if (NULL == c || NULL == c->buf_read || c->buf_size_read < 4) {
+        log_err("param error");
+        return -1;
+    }
+
+    connack = (unsigned char *)c->buf_read;
+    if (0x20 != connack[0] || 0x02 != connack[1] || 0 != connack[3]) {
+        log_debug("no CONNACK accepted in read buffer");
+        return -1;
+    }
+
+    return connack[2] & 0x01;
+}
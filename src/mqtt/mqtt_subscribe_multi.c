@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+
+/*
+ * Each filter goes out in a SUBSCRIBE of its own, the client handles one return code per SUBACK.
+ * All of them are sent before any SUBACK is waited for, so the requests share one round-trip,
+ * and with the write batching of the network layer they leave in one transport write too.
+ */
+int IOT_MQTT_SubscribeMulti(void *handle,
+                            const char *topic_filters[],
+                            int filter_num,
+                            iotx_mqtt_qos_t qos,
+                            iotx_mqtt_event_handle_func_fpt topic_handle_func,
+                            void *pcontext,
+                            int packet_ids[])
+{
+    int i, ret;
+
+    if (NULL == handle || NULL == topic_filters || filter_num <= 0 || NULL == topic_handle_func) {
+        log_err("param error");
+        return NULL_VALUE_ERROR;
+    }
+
+    for (i = 0; i < filter_num; i++) {
+        ret = IOT_MQTT_Subscribe(handle, topic_filters[i], qos, topic_handle_func, pcontext);
+        if (ret < 0) {
+            log_err("subscribe [%s] failed, %d of %d sent", topic_filters[i], i, filter_num);
+            return (0 == i) ? ret : i;
+        }
+
+        if (NULL != packet_ids) {
+            packet_ids[i] = ret;
+        }
+    }
+
+    return filter_num;
+}
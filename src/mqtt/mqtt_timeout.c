@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_net.h"
+#include "utils_list.h"
+#include "utils_timer.h"
+#include "sdk-impl_internal.h"
+
+#include "MQTTPacket/MQTTPacket.h"
+#include "mqtt_client.h"
+
+#define MQTT_TIMEOUT_NONE       (0xFFFFFFFF)
+
+/* the client resends a PUBLISH and gives up a SUBSCRIBE once it waited twice the request timeout */
+static uint32_t _mqtt_ack_timeout(iotx_mc_client_t *c, list_t *list, void *lock, int is_pub)
+{
+    uint32_t limit = c->request_timeout_ms * 2;
+    uint32_t timeout = MQTT_TIMEOUT_NONE;
+    uint32_t spent;
+    list_node_t *node;
+    iotx_time_t *start;
+
+    if (NULL == list) {
+        return MQTT_TIMEOUT_NONE;
+    }
+
+    HAL_MutexLock(lock);
+    for (node = list->head; NULL != node; node = node->next) {
+        if (NULL == node->val) {
+            continue;
+        }
+        if (is_pub) {
+            if (IOTX_MC_NODE_STATE_INVALID == ((iotx_mc_pub_info_t *)node->val)->node_state) {
+                continue;
+            }
+            start = &((iotx_mc_pub_info_t *)node->val)->pub_start_time;
+        } else {
+            if (IOTX_MC_NODE_STATE_INVALID == ((iotx_mc_subsribe_info_t *)node->val)->node_state) {
+                continue;
+            }
+            start = &((iotx_mc_subsribe_info_t *)node->val)->sub_start_time;
+        }
+
+        spent = utils_time_spend(start);
+        if (spent > limit) {
+            timeout = 0;
+            break;
+        }
+        if (limit - spent + 1 < timeout) {
+            timeout = limit - spent + 1;
+        }
+    }
+    HAL_MutexUnlock(lock);
+
+    return timeout;
+}
+
+uint32_t IOT_MQTT_GetTimeout(void *handle)
+{
+    iotx_mc_client_t *c = (iotx_mc_client_t *)handle;
+    iotx_mc_state_t state;
+    uint32_t timeout;
+    uint32_t ack;
+
+    if (NULL == c) {
+        return MQTT_TIMEOUT_NONE;
+    }
+
+    HAL_MutexLock(c->lock_generic);
+    state = c->client_state;
+    HAL_MutexUnlock(c->lock_generic);
+
+    switch (state) {
+        case IOTX_MC_STATE_CONNECTED:
+            break;
+        case IOTX_MC_STATE_DISCONNECTED:
+            /* the next yield closes the connection and schedules the reconnect */
+            return 0;
+        case IOTX_MC_STATE_DISCONNECTED_RECONNECTING:
+            return iotx_time_left(&c->reconnect_param.reconnect_next_time);
+        default:
+            return MQTT_TIMEOUT_NONE;
+    }
+
+    timeout = iotx_time_left(&c->next_ping_time);
+    if (0 != timeout) {
+        ack = _mqtt_ack_timeout(c, c->list_pub_wait_ack, c->lock_list_pub, 1);
+        timeout = (ack < timeout) ? ack : timeout;
+    }
+    if (0 != timeout) {
+        ack = _mqtt_ack_timeout(c, c->list_sub_wait_ack, c->lock_list_sub, 0);
+        timeout = (ack < timeout) ? ack : timeout;
+    }
+
+    return timeout;
+}
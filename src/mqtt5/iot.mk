@@ -0,0 +1,2 @@
+LIBA_TARGET := libiot_mqtt5.a
+HDR_REFS    := src
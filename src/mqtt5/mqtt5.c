@@ -0,0 +1,1078 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_net.h"
+
+/*
+ * MQTT 5.0 for the MQTT client, which frames MQTT 3.1.1.
+ *
+ * The network of a client constructed by IOT_MQTT_ConstructV5() translates between the two:
+ * what the client writes is turned into MQTT 5.0 on its way out, what the server sends is turned
+ * back into MQTT 3.1.1 before the client reads it. Only the packet headers are held, payloads
+ * pass through, so a packet is never copied as a whole.
+ *
+ * Outbound, CONNECT carries the session expiry and receive maximum of 'iotx_mqtt_param_t', and a
+ * PUBLISH whose topic the server knows already goes with an empty topic and its 2-byte alias.
+ * The QoS1/2 publishes the server has not acknowledged are kept under the receive maximum of its
+ * CONNACK, the ones above it wait here and go out as acknowledgements come in.
+ *
+ * Inbound, the properties are dropped and the reason codes mapped or logged. The client is given
+ * no topic alias maximum, so the server always sends its topics in full.
+ */
+
+/* headers of packets, PUBLISH up to and including its topic and packet id, any other as a whole */
+#ifndef MQTT5_HEAD_LEN_MAX
+    #define MQTT5_HEAD_LEN_MAX          (1024)
+#endif
+
+/* topic aliases used towards the server at most, whatever it allows */
+#ifndef MQTT5_TOPIC_ALIAS_MAX
+    #define MQTT5_TOPIC_ALIAS_MAX       (16)
+#endif
+
+/* QoS1/2 publishes in flight at most, whatever receive maximum the server allows */
+#ifndef MQTT5_SEND_MAXIMUM
+    #define MQTT5_SEND_MAXIMUM          (16)
+#endif
+
+/* publishes waiting for the receive maximum, more are sent over it with a warning */
+#ifndef MQTT5_DEFER_MAX
+    #define MQTT5_DEFER_MAX             (16)
+#endif
+
+#ifndef MQTT5_CLIENT_MAX
+    #define MQTT5_CLIENT_MAX            (2)
+#endif
+
+#define MQTT5_PROTOCOL_LEVEL            (5)
+#define MQTT5_HEAD_SLACK                (16)    /* what translating a head may add to it */
+#define MQTT5_IN_BODY_OFF               (8)     /* inbound bodies are read behind room for the new fixed header */
+
+#define MQTT5_CONNECT                   (1)
+#define MQTT5_CONNACK                   (2)
+#define MQTT5_PUBLISH                   (3)
+#define MQTT5_PUBACK                    (4)
+#define MQTT5_PUBREC                    (5)
+#define MQTT5_PUBREL                    (6)
+#define MQTT5_PUBCOMP                   (7)
+#define MQTT5_SUBSCRIBE                 (8)
+#define MQTT5_SUBACK                    (9)
+#define MQTT5_UNSUBSCRIBE               (10)
+#define MQTT5_UNSUBACK                  (11)
+#define MQTT5_PINGRESP                  (13)
+#define MQTT5_DISCONNECT                (14)
+
+#define MQTT5_PROP_SESSION_EXPIRY       (0x11)
+#define MQTT5_PROP_RECEIVE_MAXIMUM      (0x21)
+#define MQTT5_PROP_TOPIC_ALIAS_MAXIMUM  (0x22)
+#define MQTT5_PROP_TOPIC_ALIAS          (0x23)
+
+typedef struct mqtt5_defer_st {
+    struct mqtt5_defer_st      *next;
+    uint16_t                    packet_id;
+    uint32_t                    len;
+    unsigned char               data[1];    /* the publish as the client framed it */
+} mqtt5_defer_t;
+
+typedef struct {
+    char                       *topic;
+    uint16_t                    topic_len;
+    uint16_t                    alias;
+    uint32_t                    used;       /* alias_clock when last sent, the oldest is replaced */
+} mqtt5_alias_t;
+
+typedef struct {
+    /* recognises the network of the client under construction in iotx_mqtt5_net_bind() */
+    const char                 *host;
+    uint16_t                    port;
+    utils_network_pt            network;
+    void                       *client;
+    uint32_t                    timeout_ms;
+
+    uint32_t                    session_expiry_s;
+    uint16_t                    receive_maximum;
+    uint16_t                    alias_want;
+
+    int (*read_raw)(utils_network_pt, char *, uint32_t, uint32_t);
+    int (*write_raw)(utils_network_pt, const char *, uint32_t, uint32_t);
+    int (*connect_raw)(utils_network_pt);
+
+    /* learnt from CONNACK */
+    uint16_t                    alias_max;
+    uint16_t                    send_max;
+
+    /* outbound, guarded by lock_out */
+    void                       *lock_out;
+    unsigned char               out_head[MQTT5_HEAD_LEN_MAX];
+    uint32_t                    out_head_len;
+    uint32_t                    out_pass;   /* payload bytes of the current PUBLISH still to pass */
+    int                         out_drop;   /* the current PUBLISH is deferred already, drop it */
+    unsigned char               out_tx[MQTT5_HEAD_LEN_MAX + MQTT5_HEAD_SLACK];
+    mqtt5_alias_t               aliases[MQTT5_TOPIC_ALIAS_MAX];
+    uint16_t                    alias_count;
+    uint32_t                    alias_clock;
+    uint16_t                    outstanding[MQTT5_SEND_MAXIMUM];
+    uint32_t                    outstanding_count;
+    mqtt5_defer_t              *defer_head;
+    mqtt5_defer_t              *defer_tail;
+    uint32_t                    defer_count;
+
+    /* inbound, only the reading thread touches it */
+    unsigned char               in_head[MQTT5_HEAD_LEN_MAX];
+    uint32_t                    in_len;
+    uint32_t                    in_off;
+    uint32_t                    in_pass;    /* payload bytes of the current PUBLISH still to pass */
+} mqtt5_t;
+
+static mqtt5_t *g_mqtt5[MQTT5_CLIENT_MAX];
+
+/* the context IOT_MQTT_ConstructV5() is constructing the client of */
+static mqtt5_t *g_mqtt5_pending;
+
+static mqtt5_t *_mqtt5_find(utils_network_pt network, void *client)
+{
+    int i;
+
+    for (i = 0; i < MQTT5_CLIENT_MAX; i++) {
+        if (NULL == g_mqtt5[i]) {
+            continue;
+        }
+        if ((NULL != network && network == g_mqtt5[i]->network)
+            || (NULL != client && client == g_mqtt5[i]->client)) {
+            return g_mqtt5[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint16_t _mqtt5_get16(const unsigned char *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t _mqtt5_varint_put(unsigned char *p, uint32_t value)
+{
+    uint32_t n = 0;
+
+    do {
+        p[n] = (unsigned char)(value & 0x7F);
+        value >>= 7;
+        if (value > 0) {
+            p[n] |= 0x80;
+        }
+        n++;
+    } while (value > 0);
+
+    return n;
+}
+
+/* bytes of the variable byte integer at 'p', 0 if it is not complete within 'left' or too long */
+static uint32_t _mqtt5_varint_get(const unsigned char *p, uint32_t left, uint32_t *value)
+{
+    uint32_t i, mult = 1;
+
+    *value = 0;
+    for (i = 0; i < left && i < 4; i++) {
+        *value += (uint32_t)(p[i] & 0x7F) * mult;
+        if (0 == (p[i] & 0x80)) {
+            return i + 1;
+        }
+        mult *= 128;
+    }
+
+    return 0;
+}
+
+/* length of the value of property 'id' at 'p', -1 if unknown or beyond 'left' */
+static int _mqtt5_prop_len(unsigned char id, const unsigned char *p, uint32_t left)
+{
+    uint32_t len, value;
+
+    switch (id) {
+        case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+            len = 1;
+            break;
+        case 0x13: case 0x21: case 0x22: case 0x23:
+            len = 2;
+            break;
+        case 0x02: case 0x11: case 0x18: case 0x27:
+            len = 4;
+            break;
+        case 0x0B:
+            len = _mqtt5_varint_get(p, left, &value);
+            if (0 == len) {
+                return -1;
+            }
+            break;
+        case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+            if (left < 2) {
+                return -1;
+            }
+            len = 2 + _mqtt5_get16(p);
+            break;
+        case 0x26:
+            if (left < 2 || left < 4 + (uint32_t)_mqtt5_get16(p)) {
+                return -1;
+            }
+            len = 4 + _mqtt5_get16(p) + _mqtt5_get16(p + 2 + _mqtt5_get16(p));
+            break;
+        default:
+            return -1;
+    }
+
+    return (len > left) ? -1 : (int)len;
+}
+
+static int _mqtt5_send(mqtt5_t *ctx, const unsigned char *buf, uint32_t len, uint32_t timeout_ms)
+{
+    int rc;
+
+    while (len > 0) {
+        rc = ctx->write_raw(ctx->network, (const char *)buf, len, timeout_ms);
+        if (rc <= 0) {
+            return -1;
+        }
+        buf += rc;
+        len -= (uint32_t)rc;
+    }
+
+    return 0;
+}
+
+static void _mqtt5_alias_reset(mqtt5_t *ctx)
+{
+    uint16_t i;
+
+    for (i = 0; i < ctx->alias_count; i++) {
+        HAL_Free(ctx->aliases[i].topic);
+    }
+    ctx->alias_count = 0;
+    ctx->alias_clock = 0;
+}
+
+/* the alias for 'topic', 0 for none, '*is_new' if the server has not been told the topic yet */
+static uint16_t _mqtt5_alias(mqtt5_t *ctx, const unsigned char *topic, uint16_t topic_len, int *is_new)
+{
+    mqtt5_alias_t *entry = NULL;
+    uint16_t i, limit = ctx->alias_max;
+    char *copy;
+
+    if (limit > ctx->alias_want) {
+        limit = ctx->alias_want;
+    }
+    if (limit > MQTT5_TOPIC_ALIAS_MAX) {
+        limit = MQTT5_TOPIC_ALIAS_MAX;
+    }
+    if (0 == limit || 0 == topic_len) {
+        return 0;
+    }
+
+    ctx->alias_clock++;
+    for (i = 0; i < ctx->alias_count; i++) {
+        if (ctx->aliases[i].topic_len == topic_len && 0 == memcmp(ctx->aliases[i].topic, topic, topic_len)) {
+            ctx->aliases[i].used = ctx->alias_clock;
+            *is_new = 0;
+            return ctx->aliases[i].alias;
+        }
+    }
+
+    if (NULL == (copy = HAL_Malloc(topic_len))) {
+        return 0;
+    }
+    memcpy(copy, topic, topic_len);
+
+    if (ctx->alias_count < limit) {
+        entry = &ctx->aliases[ctx->alias_count];
+        entry->alias = ++ctx->alias_count;
+    } else {
+        entry = &ctx->aliases[0];
+        for (i = 1; i < ctx->alias_count; i++) {
+            if (ctx->aliases[i].used < entry->used) {
+                entry = &ctx->aliases[i];
+            }
+        }
+        HAL_Free(entry->topic);     /* its alias is remapped to the new topic */
+    }
+    entry->topic = copy;
+    entry->topic_len = topic_len;
+    entry->used = ctx->alias_clock;
+
+    *is_new = 1;
+    return entry->alias;
+}
+
+static uint32_t _mqtt5_send_window(mqtt5_t *ctx)
+{
+    return (ctx->send_max < MQTT5_SEND_MAXIMUM) ? ctx->send_max : MQTT5_SEND_MAXIMUM;
+}
+
+static int _mqtt5_outstanding_find(mqtt5_t *ctx, uint16_t packet_id)
+{
+    uint32_t i;
+
+    for (i = 0; i < ctx->outstanding_count; i++) {
+        if (ctx->outstanding[i] == packet_id) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static void _mqtt5_outstanding_release(mqtt5_t *ctx, uint16_t packet_id)
+{
+    int i = _mqtt5_outstanding_find(ctx, packet_id);
+
+    if (i >= 0) {
+        ctx->outstanding[i] = ctx->outstanding[--ctx->outstanding_count];
+    }
+}
+
+static int _mqtt5_deferred(mqtt5_t *ctx, uint16_t packet_id)
+{
+    mqtt5_defer_t *node;
+
+    for (node = ctx->defer_head; NULL != node; node = node->next) {
+        if (node->packet_id == packet_id) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void _mqtt5_defer_reset(mqtt5_t *ctx)
+{
+    mqtt5_defer_t *node;
+
+    while (NULL != (node = ctx->defer_head)) {
+        ctx->defer_head = node->next;
+        HAL_Free(node);
+    }
+    ctx->defer_tail = NULL;
+    ctx->defer_count = 0;
+}
+
+/* CONNECT of MQTT 5.0 for the one in out_head, 'total' bytes of which 'hdr_len' the fixed header */
+static int _mqtt5_out_connect(mqtt5_t *ctx, uint32_t hdr_len, uint32_t total, uint32_t timeout_ms)
+{
+    unsigned char *h = ctx->out_head, *tx = ctx->out_tx, props[8];
+    uint32_t level_off, vh_end, cid_end, props_len = 0, rem, n = 0;
+    int will;
+
+    /* protocol name, level, flags, keep alive, then the client id */
+    if (hdr_len + 2 > total
+        || (level_off = hdr_len + 2 + _mqtt5_get16(h + hdr_len)) + 6 > total
+        || (cid_end = level_off + 6 + _mqtt5_get16(h + level_off + 4)) > total) {
+        log_err("malformed CONNECT");
+        return -1;
+    }
+    vh_end = level_off + 4;
+    will = (0 != (h[level_off + 1] & 0x04));
+
+    if (ctx->session_expiry_s > 0) {
+        props[props_len++] = MQTT5_PROP_SESSION_EXPIRY;
+        props[props_len++] = (unsigned char)(ctx->session_expiry_s >> 24);
+        props[props_len++] = (unsigned char)(ctx->session_expiry_s >> 16);
+        props[props_len++] = (unsigned char)(ctx->session_expiry_s >> 8);
+        props[props_len++] = (unsigned char)ctx->session_expiry_s;
+    }
+    if (ctx->receive_maximum > 0) {
+        props[props_len++] = MQTT5_PROP_RECEIVE_MAXIMUM;
+        props[props_len++] = (unsigned char)(ctx->receive_maximum >> 8);
+        props[props_len++] = (unsigned char)ctx->receive_maximum;
+    }
+
+    rem = total - hdr_len + 1 + props_len + (will ? 1 : 0);
+    tx[n++] = h[0];
+    n += _mqtt5_varint_put(tx + n, rem);
+    memcpy(tx + n, h + hdr_len, level_off - hdr_len);
+    n += level_off - hdr_len;
+    tx[n++] = MQTT5_PROTOCOL_LEVEL;
+    memcpy(tx + n, h + level_off + 1, vh_end - level_off - 1);
+    n += vh_end - level_off - 1;
+    tx[n++] = (unsigned char)props_len;
+    memcpy(tx + n, props, props_len);
+    n += props_len;
+    memcpy(tx + n, h + vh_end, cid_end - vh_end);
+    n += cid_end - vh_end;
+    if (will) {
+        tx[n++] = 0;    /* will properties */
+    }
+    memcpy(tx + n, h + cid_end, total - cid_end);
+    n += total - cid_end;
+
+    return _mqtt5_send(ctx, tx, n, timeout_ms);
+}
+
+static int _mqtt5_out_publish(mqtt5_t *ctx,
+                              uint32_t hdr_len,
+                              uint32_t rem,
+                              const unsigned char **pbuf,
+                              uint32_t *plen,
+                              uint32_t timeout_ms)
+{
+    unsigned char *h = ctx->out_head, *tx = ctx->out_tx;
+    uint32_t qos = (h[0] >> 1) & 0x03, payload_len, head_len = ctx->out_head_len, n = 0, new_rem;
+    uint16_t topic_len = _mqtt5_get16(h + hdr_len), packet_id = 0, alias = 0;
+    const unsigned char *topic = h + hdr_len + 2;
+    mqtt5_defer_t *node;
+    int is_new = 0;
+
+    payload_len = hdr_len + rem - head_len;
+    if (qos > 0) {
+        packet_id = _mqtt5_get16(topic + topic_len);
+
+        if (_mqtt5_deferred(ctx, packet_id)) {
+            /* the client republishes what still waits here, the waiting one goes */
+            ctx->out_pass = payload_len;
+            ctx->out_drop = 1;
+            return 0;
+        }
+
+        if (_mqtt5_outstanding_find(ctx, packet_id) < 0) {
+            if (ctx->outstanding_count >= _mqtt5_send_window(ctx)) {
+                if (*plen >= payload_len && ctx->defer_count < MQTT5_DEFER_MAX
+                    && NULL != (node = HAL_Malloc(sizeof(mqtt5_defer_t) + head_len + payload_len))) {
+                    node->next = NULL;
+                    node->packet_id = packet_id;
+                    node->len = head_len + payload_len;
+                    memcpy(node->data, h, head_len);
+                    memcpy(node->data + head_len, *pbuf, payload_len);
+                    if (NULL == ctx->defer_tail) {
+                        ctx->defer_head = node;
+                    } else {
+                        ctx->defer_tail->next = node;
+                    }
+                    ctx->defer_tail = node;
+                    ctx->defer_count++;
+                    *pbuf += payload_len;
+                    *plen -= payload_len;
+                    return 0;
+                }
+                log_warning("receive maximum %u of server exceeded, packet id %u", ctx->send_max, packet_id);
+            }
+            if (ctx->outstanding_count < MQTT5_SEND_MAXIMUM) {
+                ctx->outstanding[ctx->outstanding_count++] = packet_id;
+            }
+        }
+    }
+
+    alias = _mqtt5_alias(ctx, topic, topic_len, &is_new);
+
+    /* topic, packet id, property length and the alias property */
+    new_rem = rem + 1 + ((0 != alias) ? 3 : 0) - ((0 != alias && !is_new) ? topic_len : 0);
+    tx[n++] = h[0];
+    n += _mqtt5_varint_put(tx + n, new_rem);
+    if (0 != alias && !is_new) {
+        tx[n++] = 0;
+        tx[n++] = 0;
+    } else {
+        memcpy(tx + n, h + hdr_len, 2 + topic_len);
+        n += 2 + topic_len;
+    }
+    if (qos > 0) {
+        tx[n++] = (unsigned char)(packet_id >> 8);
+        tx[n++] = (unsigned char)packet_id;
+    }
+    if (0 != alias) {
+        tx[n++] = 3;
+        tx[n++] = MQTT5_PROP_TOPIC_ALIAS;
+        tx[n++] = (unsigned char)(alias >> 8);
+        tx[n++] = (unsigned char)alias;
+    } else {
+        tx[n++] = 0;
+    }
+
+    ctx->out_pass = payload_len;
+    ctx->out_drop = 0;
+    return _mqtt5_send(ctx, tx, n, timeout_ms);
+}
+
+/* head bytes the current packet needs, -1 for a malformed or too large one */
+static int _mqtt5_out_need(mqtt5_t *ctx, uint32_t *hdr_len, uint32_t *rem)
+{
+    unsigned char *h = ctx->out_head;
+    uint32_t len = ctx->out_head_len, total, n;
+
+    if (len < 2) {
+        return 2;
+    }
+    if (0 == (n = _mqtt5_varint_get(h + 1, len - 1, rem))) {
+        return (len < 5) ? (int)len + 1 : -1;
+    }
+    *hdr_len = 1 + n;
+
+    if (MQTT5_PUBLISH == (h[0] >> 4)) {
+        if (*rem < 2) {
+            return -1;
+        }
+        if (len < *hdr_len + 2) {
+            return (int)(*hdr_len + 2);
+        }
+        total = *hdr_len + 2 + _mqtt5_get16(h + *hdr_len) + ((0 != (h[0] & 0x06)) ? 2 : 0);
+        if (total > *hdr_len + *rem) {
+            return -1;
+        }
+    } else {
+        total = *hdr_len + *rem;
+    }
+
+    if (total > MQTT5_HEAD_LEN_MAX) {
+        log_err("packet 0x%02x of %u bytes exceeds MQTT5_HEAD_LEN_MAX", h[0], total);
+        return -1;
+    }
+
+    return (int)total;
+}
+
+/* takes what the client writes, writes its translation */
+static int _mqtt5_out_feed(mqtt5_t *ctx, const unsigned char *buf, uint32_t len, uint32_t timeout_ms)
+{
+    uint32_t n, hdr_len = 0, rem = 0;
+    int need, rc;
+    unsigned char *h = ctx->out_head;
+
+    while (len > 0) {
+        if (ctx->out_pass > 0) {
+            n = (len < ctx->out_pass) ? len : ctx->out_pass;
+            if (!ctx->out_drop && 0 != _mqtt5_send(ctx, buf, n, timeout_ms)) {
+                return -1;
+            }
+            ctx->out_pass -= n;
+            buf += n;
+            len -= n;
+            continue;
+        }
+
+        for (;;) {
+            if ((need = _mqtt5_out_need(ctx, &hdr_len, &rem)) < 0) {
+                ctx->out_head_len = 0;
+                return -1;
+            }
+            if (ctx->out_head_len >= (uint32_t)need || 0 == len) {
+                break;
+            }
+            n = (uint32_t)need - ctx->out_head_len;
+            n = (len < n) ? len : n;
+            memcpy(h + ctx->out_head_len, buf, n);
+            ctx->out_head_len += n;
+            buf += n;
+            len -= n;
+        }
+        if (ctx->out_head_len < (uint32_t)need) {
+            return 0;
+        }
+
+        switch (h[0] >> 4) {
+            case MQTT5_CONNECT:
+                rc = _mqtt5_out_connect(ctx, hdr_len, (uint32_t)need, timeout_ms);
+                break;
+            case MQTT5_PUBLISH:
+                rc = _mqtt5_out_publish(ctx, hdr_len, rem, &buf, &len, timeout_ms);
+                break;
+            case MQTT5_SUBSCRIBE:
+            case MQTT5_UNSUBSCRIBE:
+                /* no properties after the packet id */
+                if (rem < 2) {
+                    rc = -1;
+                    break;
+                }
+                n = 0;
+                ctx->out_tx[n++] = h[0];
+                n += _mqtt5_varint_put(ctx->out_tx + n, rem + 1);
+                ctx->out_tx[n++] = h[hdr_len];
+                ctx->out_tx[n++] = h[hdr_len + 1];
+                ctx->out_tx[n++] = 0;
+                memcpy(ctx->out_tx + n, h + hdr_len + 2, rem - 2);
+                rc = _mqtt5_send(ctx, ctx->out_tx, n + rem - 2, timeout_ms);
+                break;
+            default:
+                /* acknowledgements of 2 bytes mean success in MQTT 5.0 as well, PINGREQ and DISCONNECT are the same */
+                rc = _mqtt5_send(ctx, h, (uint32_t)need, timeout_ms);
+                break;
+        }
+        ctx->out_head_len = 0;
+        if (0 != rc) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* sends what waits for the receive maximum, between packets of the client only */
+static void _mqtt5_defer_flush(mqtt5_t *ctx, uint32_t timeout_ms)
+{
+    mqtt5_defer_t *node;
+
+    while (NULL != (node = ctx->defer_head)
+           && 0 == ctx->out_head_len && 0 == ctx->out_pass
+           && ctx->outstanding_count < _mqtt5_send_window(ctx)) {
+        ctx->defer_head = node->next;
+        if (NULL == ctx->defer_head) {
+            ctx->defer_tail = NULL;
+        }
+        ctx->defer_count--;
+
+        if (0 != _mqtt5_out_feed(ctx, node->data, node->len, timeout_ms)) {
+            log_err("send deferred publish %u failed", node->packet_id);
+        }
+        HAL_Free(node);
+    }
+}
+
+/* the next packet of the server, translated into in_head; what it did not take is passed by in_pass */
+static int _mqtt5_in_next(mqtt5_t *ctx, uint32_t timeout_ms)
+{
+    unsigned char *h = ctx->in_head, *b = ctx->in_head + MQTT5_IN_BODY_OFF, byte;
+    uint32_t rem = 0, mult = 1, i, n, consumed, topic_len, id_len, props_len, value;
+    int rc, plen;
+
+    ctx->in_len = 0;
+    ctx->in_off = 0;
+
+    rc = ctx->read_raw(ctx->network, (char *)h, 1, timeout_ms);
+    if (rc <= 0) {
+        return rc;
+    }
+
+    /* the rest of the packet is there already or follows soon */
+    timeout_ms = ctx->timeout_ms;
+    for (i = 0; i < 4; i++) {
+        if (1 != ctx->read_raw(ctx->network, (char *)&byte, 1, timeout_ms)) {
+            return -1;
+        }
+        rem += (uint32_t)(byte & 0x7F) * mult;
+        mult *= 128;
+        if (0 == (byte & 0x80)) {
+            break;
+        }
+    }
+    if (4 == i) {
+        log_err("malformed remaining length");
+        return -1;
+    }
+
+    if (MQTT5_PUBLISH == (h[0] >> 4)) {
+        id_len = (0 != (h[0] & 0x06)) ? 2 : 0;
+        if (rem < 2 || 2 != ctx->read_raw(ctx->network, (char *)b, 2, timeout_ms)) {
+            return -1;
+        }
+        topic_len = _mqtt5_get16(b);
+        if (MQTT5_IN_BODY_OFF + 2 + topic_len + id_len > MQTT5_HEAD_LEN_MAX || rem < 2 + topic_len + id_len + 1) {
+            log_err("topic of %u bytes too long or packet malformed", topic_len);
+            return -1;
+        }
+        n = topic_len + id_len;
+        if (n > 0 && (int)n != ctx->read_raw(ctx->network, (char *)b + 2, n, timeout_ms)) {
+            return -1;
+        }
+        consumed = 2 + n;
+
+        /* property length, then the properties, nothing in them is of use to the client */
+        for (i = 0, props_len = 0, mult = 1; i < 4; i++) {
+            if (1 != ctx->read_raw(ctx->network, (char *)&byte, 1, timeout_ms)) {
+                return -1;
+            }
+            props_len += (uint32_t)(byte & 0x7F) * mult;
+            mult *= 128;
+            if (0 == (byte & 0x80)) {
+                break;
+            }
+        }
+        if (4 == i || consumed + i + 1 + props_len > rem) {
+            log_err("malformed PUBLISH properties");
+            return -1;
+        }
+        consumed += i + 1;
+        while (props_len > 0) {
+            unsigned char skip[32];
+
+            n = (props_len < sizeof(skip)) ? props_len : sizeof(skip);
+            if ((int)n != ctx->read_raw(ctx->network, (char *)skip, n, timeout_ms)) {
+                return -1;
+            }
+            props_len -= n;
+            consumed += n;
+        }
+
+        n = 2 + topic_len + id_len;
+        value = rem - (consumed - n);
+        i = 1 + _mqtt5_varint_put(h + 1, value);
+        memmove(h + i, b, n);
+        ctx->in_len = i + n;
+        ctx->in_pass = rem - consumed;
+        return 1;
+    }
+
+    if (rem > MQTT5_HEAD_LEN_MAX - MQTT5_IN_BODY_OFF) {
+        log_err("packet 0x%02x of %u bytes exceeds MQTT5_HEAD_LEN_MAX", h[0], rem);
+        return -1;
+    }
+    if (rem > 0 && (int)rem != ctx->read_raw(ctx->network, (char *)b, rem, timeout_ms)) {
+        return -1;
+    }
+
+    switch (h[0] >> 4) {
+        case MQTT5_CONNACK: {
+            static const unsigned char codes[][2] = {
+                {0x84, 1}, {0x85, 2}, {0x88, 3}, {0x89, 3}, {0x86, 4}, {0x87, 5}, {0x8C, 4}
+            };
+            unsigned char code = 0;
+
+            if (rem < 2) {
+                return -1;
+            }
+            ctx->alias_max = 0;
+            ctx->send_max = 65535;
+            if (rem > 2 && 0 != (n = _mqtt5_varint_get(b + 2, rem - 2, &props_len))) {
+                for (i = 2 + n; i < rem && i < 2 + n + props_len; i += 1 + (uint32_t)plen) {
+                    if ((plen = _mqtt5_prop_len(b[i], b + i + 1, rem - i - 1)) < 0) {
+                        log_warning("unknown CONNACK property 0x%02x", b[i]);
+                        break;
+                    }
+                    if (MQTT5_PROP_RECEIVE_MAXIMUM == b[i]) {
+                        ctx->send_max = _mqtt5_get16(b + i + 1);
+                    } else if (MQTT5_PROP_TOPIC_ALIAS_MAXIMUM == b[i]) {
+                        ctx->alias_max = _mqtt5_get16(b + i + 1);
+                    }
+                }
+            }
+            if (0 == ctx->send_max) {
+                ctx->send_max = 1;
+            }
+            if (b[1] >= 0x80) {
+                code = 3;
+                for (i = 0; i < sizeof(codes) / sizeof(codes[0]); i++) {
+                    if (codes[i][0] == b[1]) {
+                        code = codes[i][1];
+                    }
+                }
+                log_err("connection refused, reason 0x%02x", b[1]);
+            }
+            log_debug("server topic alias maximum %u, receive maximum %u", ctx->alias_max, ctx->send_max);
+            h[1] = 2;
+            h[2] = b[0];
+            h[3] = code;
+            ctx->in_len = 4;
+            break;
+        }
+        case MQTT5_PUBACK:
+        case MQTT5_PUBREC:
+        case MQTT5_PUBREL:
+        case MQTT5_PUBCOMP: {
+            uint16_t packet_id;
+            unsigned char reason;
+
+            if (rem < 2) {
+                return -1;
+            }
+            packet_id = _mqtt5_get16(b);
+            reason = (rem > 2) ? b[2] : 0;
+            if (reason >= 0x80) {
+                log_warning("packet 0x%02x of id %u, reason 0x%02x", h[0], packet_id, reason);
+            }
+            if (MQTT5_PUBACK == (h[0] >> 4) || MQTT5_PUBCOMP == (h[0] >> 4)
+                || (MQTT5_PUBREC == (h[0] >> 4) && reason >= 0x80)) {
+                HAL_MutexLock(ctx->lock_out);
+                _mqtt5_outstanding_release(ctx, packet_id);
+                _mqtt5_defer_flush(ctx, ctx->timeout_ms);
+                HAL_MutexUnlock(ctx->lock_out);
+            }
+            h[1] = 2;
+            h[2] = b[0];
+            h[3] = b[1];
+            ctx->in_len = 4;
+            break;
+        }
+        case MQTT5_SUBACK:
+            if (rem < 3 || 0 == (n = _mqtt5_varint_get(b + 2, rem - 2, &props_len)) || 2 + n + props_len > rem) {
+                return -1;
+            }
+            consumed = 2 + n + props_len;
+            i = 1 + _mqtt5_varint_put(h + 1, 2 + rem - consumed);
+            h[i++] = b[0];
+            h[i++] = b[1];
+            memmove(h + i, b + consumed, rem - consumed);
+            ctx->in_len = i + rem - consumed;
+            break;
+        case MQTT5_UNSUBACK:
+            if (rem < 2) {
+                return -1;
+            }
+            h[1] = 2;
+            h[2] = b[0];
+            h[3] = b[1];
+            ctx->in_len = 4;
+            break;
+        case MQTT5_PINGRESP:
+            h[1] = 0;
+            ctx->in_len = 2;
+            break;
+        case MQTT5_DISCONNECT:
+            log_err("disconnected by server, reason 0x%02x", (rem > 0) ? b[0] : 0);
+            return -1;
+        default:
+            log_err("unexpected packet 0x%02x", h[0]);
+            return -1;
+    }
+
+    ctx->in_pass = 0;
+    return 1;
+}
+
+static int _mqtt5_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    mqtt5_t *ctx = _mqtt5_find(pNetwork, NULL);
+    uint32_t n, done;
+    int rc;
+
+    if (NULL == ctx) {
+        return -1;
+    }
+
+    if (ctx->in_off == ctx->in_len && 0 == ctx->in_pass) {
+        rc = _mqtt5_in_next(ctx, timeout_ms);
+        if (rc <= 0) {
+            return rc;
+        }
+    }
+
+    /* within one packet at most, the client reads what remains of it in one call */
+    done = 0;
+    if (ctx->in_off < ctx->in_len) {
+        n = ctx->in_len - ctx->in_off;
+        n = (len < n) ? len : n;
+        memcpy(buffer, ctx->in_head + ctx->in_off, n);
+        ctx->in_off += n;
+        done = n;
+    }
+
+    n = len - done;
+    n = (n < ctx->in_pass) ? n : ctx->in_pass;
+    if (n > 0) {
+        rc = ctx->read_raw(pNetwork, buffer + done, n, ctx->timeout_ms);
+        if (rc < 0) {
+            return rc;
+        }
+        ctx->in_pass -= (uint32_t)rc;
+        done += (uint32_t)rc;
+    }
+
+    return (int)done;
+}
+
+static int _mqtt5_write(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    mqtt5_t *ctx = _mqtt5_find(pNetwork, NULL);
+    int rc;
+
+    if (NULL == ctx) {
+        return -1;
+    }
+
+    HAL_MutexLock(ctx->lock_out);
+    rc = _mqtt5_out_feed(ctx, (const unsigned char *)buffer, len, timeout_ms);
+    if (0 == rc) {
+        _mqtt5_defer_flush(ctx, timeout_ms);
+    }
+    HAL_MutexUnlock(ctx->lock_out);
+
+    return (0 == rc) ? (int)len : -1;
+}
+
+static int _mqtt5_writev(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    mqtt5_t *ctx = _mqtt5_find(pNetwork, NULL);
+    uint32_t i, total = 0;
+    int rc = 0;
+
+    if (NULL == ctx) {
+        return -1;
+    }
+
+    HAL_MutexLock(ctx->lock_out);
+    for (i = 0; i < iovcnt && 0 == rc; i++) {
+        rc = _mqtt5_out_feed(ctx, (const unsigned char *)iov[i].buf, iov[i].len, timeout_ms);
+        total += iov[i].len;
+    }
+    if (0 == rc) {
+        _mqtt5_defer_flush(ctx, timeout_ms);
+    }
+    HAL_MutexUnlock(ctx->lock_out);
+
+    return (0 == rc) ? (int)total : -1;
+}
+
+static int _mqtt5_connect(utils_network_pt pNetwork)
+{
+    mqtt5_t *ctx = _mqtt5_find(pNetwork, NULL);
+
+    if (NULL == ctx) {
+        return -1;
+    }
+
+    /* a new connection, the server knows no alias and holds no publish of ours */
+    HAL_MutexLock(ctx->lock_out);
+    ctx->out_head_len = 0;
+    ctx->out_pass = 0;
+    ctx->out_drop = 0;
+    _mqtt5_alias_reset(ctx);
+    ctx->alias_max = 0;
+    ctx->send_max = 65535;
+    ctx->outstanding_count = 0;
+    _mqtt5_defer_reset(ctx);
+    HAL_MutexUnlock(ctx->lock_out);
+
+    ctx->in_len = 0;
+    ctx->in_off = 0;
+    ctx->in_pass = 0;
+
+    return ctx->connect_raw(pNetwork);
+}
+
+void iotx_mqtt5_net_bind(utils_network_pt pNetwork)
+{
+    mqtt5_t *ctx = g_mqtt5_pending;
+
+    if (NULL == ctx || NULL != ctx->network
+        || pNetwork->port != ctx->port || 0 != strcmp(pNetwork->pHostAddress, ctx->host)) {
+        return;
+    }
+
+    ctx->network = pNetwork;
+    ctx->read_raw = pNetwork->read;
+    ctx->write_raw = pNetwork->write;
+    ctx->connect_raw = pNetwork->connect;
+
+    pNetwork->read = _mqtt5_read;
+    pNetwork->write = _mqtt5_write;
+    pNetwork->writev = _mqtt5_writev;
+    pNetwork->connect = _mqtt5_connect;
+}
+
+static void _mqtt5_release(mqtt5_t *ctx)
+{
+    int i;
+
+    for (i = 0; i < MQTT5_CLIENT_MAX; i++) {
+        if (ctx == g_mqtt5[i]) {
+            g_mqtt5[i] = NULL;
+        }
+    }
+
+    _mqtt5_alias_reset(ctx);
+    _mqtt5_defer_reset(ctx);
+    if (NULL != ctx->lock_out) {
+        HAL_MutexDestroy(ctx->lock_out);
+    }
+    HAL_Free(ctx);
+}
+
+void *IOT_MQTT_ConstructV5(iotx_mqtt_param_t *pInitParams)
+{
+    mqtt5_t *ctx;
+    void *client;
+    int i, slot = -1;
+
+    if (NULL == pInitParams || NULL == pInitParams->host) {
+        log_err("invalid parameter");
+        return NULL;
+    }
+    if (NULL != g_mqtt5_pending) {
+        log_err("another client is under construction");
+        return NULL;
+    }
+    for (i = 0; i < MQTT5_CLIENT_MAX; i++) {
+        if (NULL == g_mqtt5[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        log_err("MQTT5_CLIENT_MAX clients constructed already");
+        return NULL;
+    }
+
+    if (NULL == (ctx = HAL_Malloc(sizeof(mqtt5_t)))) {
+        log_err("malloc failed");
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(mqtt5_t));
+    if (NULL == (ctx->lock_out = HAL_MutexCreate())) {
+        log_err("create mutex failed");
+        HAL_Free(ctx);
+        return NULL;
+    }
+    ctx->host = pInitParams->host;
+    ctx->port = pInitParams->port;
+    ctx->timeout_ms = (0 != pInitParams->request_timeout_ms) ? pInitParams->request_timeout_ms : 2000;
+    ctx->session_expiry_s = pInitParams->session_expiry_s;
+    ctx->receive_maximum = pInitParams->receive_maximum;
+    ctx->alias_want = pInitParams->topic_alias_maximum;
+    ctx->send_max = 65535;
+
+    /* the client connects while it is constructed, its network is bound to ctx in iotx_net_init() */
+    g_mqtt5[slot] = ctx;
+    g_mqtt5_pending = ctx;
+#ifndef MQTT_ID2_AUTH
+    client = IOT_MQTT_Construct(pInitParams);
+#else
+    client = IOT_MQTT_ConstructSecure(pInitParams);
+#endif /**< MQTT_ID2_AUTH*/
+    g_mqtt5_pending = NULL;
+
+    if (NULL == client) {
+        log_err("construct MQTT failed");
+        _mqtt5_release(ctx);
+        return NULL;
+    }
+    if (NULL == ctx->network) {
+        log_err("network of client not bound");
+        IOT_MQTT_Destroy(&client);
+        _mqtt5_release(ctx);
+        return NULL;
+    }
+
+    ctx->client = client;
+    return client;
+}
+
+int IOT_MQTT_DestroyV5(void **phandle)
+{
+    mqtt5_t *ctx;
+    int rc;
+
+    if (NULL == phandle || NULL == (ctx = _mqtt5_find(NULL, *phandle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructV5");
+        return NULL_VALUE_ERROR;
+    }
+
+    /* the DISCONNECT goes through the translation still */
+    rc = IOT_MQTT_Destroy(phandle);
+    _mqtt5_release(ctx);
+
+    return rc;
+}
@@ -0,0 +1,2 @@
+LIBA_TARGET := libiot_mqtt_async.a
+HDR_REFS    := src
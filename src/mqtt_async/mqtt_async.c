@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "lite-utils.h"
+#include "lite-metrics.h"
+
+/*
+ * Asynchronous publish on top of the MQTT client.
+ *
+ * Publishers only copy their message into the outbound queue of the client. The thread running
+ * IOT_MQTT_YieldAsync() writes the queue out between its reads, so publishers never wait on the
+ * write buffer of the client or on each other. QoS1 messages then wait in the in-flight table for
+ * their PUBACK, which arrives through the event handler interposed at construction. Both the
+ * writes and the events happen on the yield thread, so only the queue itself needs a lock.
+ */
+
+#ifndef MQTT_ASYNC_CLIENT_MAX
+    #define MQTT_ASYNC_CLIENT_MAX           (4)
+#endif
+
+/* longest read of IOT_MQTT_YieldAsync() before the queue is looked at again */
+#ifndef MQTT_ASYNC_YIELD_SLICE_MS
+    #define MQTT_ASYNC_YIELD_SLICE_MS       (50)
+#endif
+
+/* PUBACK wait in request timeouts, the client republishes once every two of them */
+#define MQTT_ASYNC_ACK_TIMEOUT_TIMES        (3)
+
+/* request timeout the client ends up with, out of range values are replaced by its default */
+#define MQTT_ASYNC_REQUEST_TIMEOUT_MIN_MS   (500)
+#define MQTT_ASYNC_REQUEST_TIMEOUT_MAX_MS   (5000)
+#define MQTT_ASYNC_REQUEST_TIMEOUT_MS       (2000)
+
+typedef struct {
+    char                       *topic;      /* topic and payload share one allocation */
+    iotx_mqtt_topic_info_t      info;
+    iotx_mqtt_publish_cb_fpt    cb;
+    void                       *pcontext;
+    uint64_t                    deadline;   /* uptime in ms the PUBACK of a QoS1 message is given up */
+} mqtt_async_msg_t;
+
+typedef struct {
+    void                       *client;
+    iotx_mqtt_event_handle_t    user_event;
+    uint32_t                    ack_timeout_ms;
+
+    void                       *lock_queue;
+    mqtt_async_msg_t           *queue;      /* ring filled by any thread, drained by the yield thread */
+    uint32_t                    queue_len;
+    uint32_t                    queue_head;
+    uint32_t                    queue_count;
+
+    mqtt_async_msg_t           *inflight;   /* QoS1 messages waiting for PUBACK, yield thread only */
+    uint32_t                    inflight_count;
+} mqtt_async_t;
+
+static mqtt_async_t *g_mqtt_async[MQTT_ASYNC_CLIENT_MAX];
+
+/* of all the async clients */
+LITE_METRIC_DEFINE_GAUGE(mqtt_async_queued, "mqtt.queue", NULL);
+LITE_METRIC_DEFINE_GAUGE(mqtt_async_inflight, "mqtt.inflight", NULL);
+
+static mqtt_async_t *_mqtt_async_find(void *client)
+{
+    int i;
+
+    if (NULL == client) {
+        return NULL;
+    }
+
+    for (i = 0; i < MQTT_ASYNC_CLIENT_MAX; i++) {
+        if (NULL != g_mqtt_async[i] && client == g_mqtt_async[i]->client) {
+            return g_mqtt_async[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void _mqtt_async_complete(mqtt_async_msg_t *msg, int packet_id, iotx_mqtt_publish_result_t result)
+{
+    if (NULL != msg->cb) {
+        msg->cb(msg->pcontext, packet_id, result);
+    }
+
+    LITE_free(msg->topic);
+    msg->topic = NULL;
+}
+
+/* complete the in-flight message of packet_id, unknown ids belong to synchronous publishes */
+static void _mqtt_async_ack(mqtt_async_t *ctx, uint16_t packet_id, iotx_mqtt_publish_result_t result)
+{
+    mqtt_async_msg_t msg;
+    uint32_t i;
+
+    for (i = 0; i < ctx->inflight_count; i++) {
+        if (packet_id == ctx->inflight[i].info.packet_id) {
+            msg = ctx->inflight[i];
+            ctx->inflight[i] = ctx->inflight[--ctx->inflight_count];
+            LITE_METRIC_ADD(mqtt_async_inflight, -1);
+            _mqtt_async_complete(&msg, packet_id, result);
+            return;
+        }
+    }
+}
+
+static void _mqtt_async_check_timeout(mqtt_async_t *ctx)
+{
+    mqtt_async_msg_t msg;
+    uint64_t now = HAL_UptimeMs();
+    uint32_t i = 0;
+
+    while (i < ctx->inflight_count) {
+        if (now < ctx->inflight[i].deadline) {
+            i++;
+            continue;
+        }
+
+        msg = ctx->inflight[i];
+        ctx->inflight[i] = ctx->inflight[--ctx->inflight_count];
+        LITE_METRIC_ADD(mqtt_async_inflight, -1);
+        log_info("publish wait ack timeout, packet-id=%u", (unsigned int)msg.info.packet_id);
+        _mqtt_async_complete(&msg, msg.info.packet_id, IOTX_MQTT_PUBLISH_RESULT_TIMEOUT);
+    }
+}
+
+/* write out the queue while connected, as long as the in-flight table has room */
+static void _mqtt_async_flush(mqtt_async_t *ctx)
+{
+    mqtt_async_msg_t msg;
+    int rc;
+
+    while (ctx->inflight_count < ctx->queue_len && IOT_MQTT_CheckStateNormal(ctx->client)) {
+        HAL_MutexLock(ctx->lock_queue);
+        if (0 == ctx->queue_count) {
+            HAL_MutexUnlock(ctx->lock_queue);
+            break;
+        }
+        msg = ctx->queue[ctx->queue_head];
+        ctx->queue_head = (ctx->queue_head + 1) % ctx->queue_len;
+        ctx->queue_count--;
+        LITE_METRIC_ADD(mqtt_async_queued, -1);
+        HAL_MutexUnlock(ctx->lock_queue);
+
+        rc = IOT_MQTT_Publish(ctx->client, msg.topic, &msg.info);
+        if (rc < 0) {
+            log_err("async publish failed, rc = %d", rc);
+            _mqtt_async_complete(&msg, 0, IOTX_MQTT_PUBLISH_RESULT_FAILED);
+        } else if (IOTX_MQTT_QOS0 == msg.info.qos) {
+            _mqtt_async_complete(&msg, 0, IOTX_MQTT_PUBLISH_RESULT_SUCCESS);
+        } else {
+            msg.info.packet_id = (uint16_t)rc;
+            msg.deadline = HAL_UptimeMs() + ctx->ack_timeout_ms;
+            ctx->inflight[ctx->inflight_count++] = msg;
+            LITE_METRIC_ADD(mqtt_async_inflight, 1);
+        }
+    }
+}
+
+static void _mqtt_async_event_handle(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    mqtt_async_t *ctx = (mqtt_async_t *)pcontext;
+    uint16_t packet_id = (uint16_t)(uintptr_t)msg->msg;
+
+    int acked = 1;
+
+    switch (msg->event_type) {
+        case IOTX_MQTT_EVENT_PUBLISH_SUCCESS:
+            _mqtt_async_ack(ctx, packet_id, IOTX_MQTT_PUBLISH_RESULT_SUCCESS);
+            break;
+
+        case IOTX_MQTT_EVENT_PUBLISH_TIMEOUT:
+            _mqtt_async_ack(ctx, packet_id, IOTX_MQTT_PUBLISH_RESULT_TIMEOUT);
+            break;
+
+        case IOTX_MQTT_EVENT_PUBLISH_NACK:
+            _mqtt_async_ack(ctx, packet_id, IOTX_MQTT_PUBLISH_RESULT_FAILED);
+            break;
+
+        default:
+            acked = 0;
+            break;
+    }
+
+    /* the application still sees every event */
+    if (NULL != ctx->user_event.h_fp) {
+        ctx->user_event.h_fp(ctx->user_event.pcontext, pclient, msg);
+    }
+
+    /* an ack frees an in-flight slot, refill it now rather than after the read slice */
+    if (acked && NULL != ctx->client) {
+        _mqtt_async_flush(ctx);
+    }
+}
+
+static void _mqtt_async_release(mqtt_async_t *ctx)
+{
+    mqtt_async_msg_t *msg;
+
+    /* whatever did not complete yet is cancelled, queued messages in their order first */
+    while (ctx->queue_count > 0) {
+        msg = &ctx->queue[ctx->queue_head];
+        ctx->queue_head = (ctx->queue_head + 1) % ctx->queue_len;
+        ctx->queue_count--;
+        LITE_METRIC_ADD(mqtt_async_queued, -1);
+        _mqtt_async_complete(msg, 0, IOTX_MQTT_PUBLISH_RESULT_CANCELLED);
+    }
+    while (ctx->inflight_count > 0) {
+        msg = &ctx->inflight[--ctx->inflight_count];
+        LITE_METRIC_ADD(mqtt_async_inflight, -1);
+        _mqtt_async_complete(msg, msg->info.packet_id, IOTX_MQTT_PUBLISH_RESULT_CANCELLED);
+    }
+
+    if (NULL != ctx->lock_queue) {
+        HAL_MutexDestroy(ctx->lock_queue);
+    }
+    if (NULL != ctx->queue) {
+        LITE_free(ctx->queue);
+    }
+    if (NULL != ctx->inflight) {
+        LITE_free(ctx->inflight);
+    }
+    LITE_free(ctx);
+}
+
+void *IOT_MQTT_ConstructAsync(iotx_mqtt_param_t *pInitParams, uint32_t queue_len)
+{
+    iotx_mqtt_param_t params;
+    mqtt_async_t *ctx = NULL;
+    int slot;
+
+    if (NULL == pInitParams || 0 == queue_len) {
+        log_err("invalid parameter");
+        return NULL;
+    }
+
+    for (slot = 0; slot < MQTT_ASYNC_CLIENT_MAX; slot++) {
+        if (NULL == g_mqtt_async[slot]) {
+            break;
+        }
+    }
+    if (MQTT_ASYNC_CLIENT_MAX == slot) {
+        log_err("no more than %d async clients", MQTT_ASYNC_CLIENT_MAX);
+        return NULL;
+    }
+
+    if (NULL == (ctx = LITE_malloc(sizeof(mqtt_async_t)))) {
+        log_err("Not enough memory");
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(mqtt_async_t));
+
+    ctx->queue_len = queue_len;
+    ctx->queue = LITE_malloc(queue_len * sizeof(mqtt_async_msg_t));
+    ctx->inflight = LITE_malloc(queue_len * sizeof(mqtt_async_msg_t));
+    ctx->lock_queue = HAL_MutexCreate();
+    if (NULL == ctx->queue || NULL == ctx->inflight || NULL == ctx->lock_queue) {
+        log_err("Not enough memory");
+        goto do_exit;
+    }
+
+    if (pInitParams->request_timeout_ms < MQTT_ASYNC_REQUEST_TIMEOUT_MIN_MS
+        || pInitParams->request_timeout_ms > MQTT_ASYNC_REQUEST_TIMEOUT_MAX_MS) {
+        ctx->ack_timeout_ms = MQTT_ASYNC_ACK_TIMEOUT_TIMES * MQTT_ASYNC_REQUEST_TIMEOUT_MS;
+    } else {
+        ctx->ack_timeout_ms = MQTT_ASYNC_ACK_TIMEOUT_TIMES * pInitParams->request_timeout_ms;
+    }
+
+    /* interpose on the events to see the PUBACKs, they are passed on to the application handler */
+    ctx->user_event = pInitParams->handle_event;
+    params = *pInitParams;
+    params.handle_event.h_fp = _mqtt_async_event_handle;
+    params.handle_event.pcontext = ctx;
+
+#ifndef MQTT_ID2_AUTH
+    if (NULL == (ctx->client = IOT_MQTT_Construct(&params))) {
+#else
+    if (NULL == (ctx->client = IOT_MQTT_ConstructSecure(&params))) {
+#endif /**< MQTT_ID2_AUTH*/
+        log_err("construct MQTT failed");
+        goto do_exit;
+    }
+
+    LITE_METRIC_REGISTER(mqtt_async_queued);
+    LITE_METRIC_REGISTER(mqtt_async_inflight);
+
+    g_mqtt_async[slot] = ctx;
+    return ctx->client;
+
+do_exit:
+    _mqtt_async_release(ctx);
+    return NULL;
+}
+
+int IOT_MQTT_PublishAsync(void *handle,
+                          const char *topic_name,
+                          iotx_mqtt_topic_info_pt topic_msg,
+                          iotx_mqtt_publish_cb_fpt publish_cb,
+                          void *pcontext)
+{
+    mqtt_async_t *ctx;
+    mqtt_async_msg_t msg;
+    size_t topic_len;
+
+    if (NULL == topic_name || NULL == topic_msg || (topic_msg->payload_len > 0 && NULL == topic_msg->payload)) {
+        log_err("invalid parameter");
+        return -1;
+    }
+    if (IOTX_MQTT_QOS0 != topic_msg->qos && IOTX_MQTT_QOS1 != topic_msg->qos) {
+        log_err("only QoS0 and QoS1 are supported");
+        return -1;
+    }
+    if (NULL == (ctx = _mqtt_async_find(handle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructAsync");
+        return -1;
+    }
+
+    /* the message is copied, the caller may reuse its buffers right away */
+    topic_len = strlen(topic_name);
+    if (NULL == (msg.topic = LITE_malloc(topic_len + 1 + topic_msg->payload_len))) {
+        log_err("Not enough memory");
+        return -1;
+    }
+    memcpy(msg.topic, topic_name, topic_len + 1);
+    memcpy(msg.topic + topic_len + 1, topic_msg->payload, topic_msg->payload_len);
+
+    msg.info = *topic_msg;
+    msg.info.packet_id = 0;
+    msg.info.ptopic = msg.topic;
+    msg.info.topic_len = (uint16_t)topic_len;
+    msg.info.payload = msg.topic + topic_len + 1;
+    msg.cb = publish_cb;
+    msg.pcontext = pcontext;
+    msg.deadline = 0;
+
+    HAL_MutexLock(ctx->lock_queue);
+    if (ctx->queue_count == ctx->queue_len) {
+        HAL_MutexUnlock(ctx->lock_queue);
+        log_err("async publish queue full");
+        LITE_free(msg.topic);
+        return -1;
+    }
+    ctx->queue[(ctx->queue_head + ctx->queue_count) % ctx->queue_len] = msg;
+    ctx->queue_count++;
+    LITE_METRIC_ADD(mqtt_async_queued, 1);
+    HAL_MutexUnlock(ctx->lock_queue);
+
+    return 0;
+}
+
+int IOT_MQTT_YieldAsync(void *handle, int timeout_ms)
+{
+    mqtt_async_t *ctx;
+    uint64_t now, end;
+    int rc, slice;
+
+    if (NULL == (ctx = _mqtt_async_find(handle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructAsync");
+        return -1;
+    }
+
+    now = HAL_UptimeMs();
+    end = now + (timeout_ms > 0 ? timeout_ms : 0);
+    do {
+        _mqtt_async_flush(ctx);
+        _mqtt_async_check_timeout(ctx);
+
+        slice = (end - now > MQTT_ASYNC_YIELD_SLICE_MS) ? MQTT_ASYNC_YIELD_SLICE_MS : (int)(end - now);
+        rc = IOT_MQTT_Yield(ctx->client, slice);
+
+        now = HAL_UptimeMs();
+    } while (now < end);
+
+    /* send what the last read brought in or freed up */
+    _mqtt_async_flush(ctx);
+
+    return rc;
+}
+
+int IOT_MQTT_DestroyAsync(void **phandle)
+{
+    mqtt_async_t *ctx;
+    int i, rc;
+
+    if (NULL == phandle || NULL == (ctx = _mqtt_async_find(*phandle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructAsync");
+        return -1;
+    }
+
+    for (i = 0; i < MQTT_ASYNC_CLIENT_MAX; i++) {
+        if (ctx == g_mqtt_async[i]) {
+            g_mqtt_async[i] = NULL;
+        }
+    }
+
+    rc = IOT_MQTT_Destroy(&ctx->client);
+    _mqtt_async_release(ctx);
+    *phandle = NULL;
+
+    return rc;
+}
@@ -0,0 +1,713 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "lite-utils.h"
+
+/*
+ * Store-and-forward of QoS1 publishes, persisted through HAL_Kv_*.
+ *
+ * The store is an append-only log cut into segments of MQTT_STORE_SEGMENT_SIZE bytes, each segment
+ * one KV value, plus a meta record with the oldest and newest segment and the acknowledged mark:
+ * every message below it has got its PUBACK. A publish is written through into the newest segment
+ * before it is accepted. The bound client replays the log from the mark, keeping at most
+ * MQTT_STORE_WINDOW messages in flight, and a segment is dropped once all of it is acknowledged.
+ * RAM use is two segments and the window, however long the client has been offline.
+ *
+ * Out of order PUBACKs above the mark are not persisted, those messages may be sent again after a
+ * reboot, as QoS1 allows. HAL_Kv_Set() must replace a value as a whole, a crash leaves either the
+ * old or the new segment.
+ */
+
+#ifndef MQTT_STORE_SEGMENT_SIZE
+    #define MQTT_STORE_SEGMENT_SIZE     (2048)
+#endif
+
+/* segments a store may hold, once full StorePublish fails until messages are acknowledged */
+#ifndef MQTT_STORE_SEGMENT_MAX
+    #define MQTT_STORE_SEGMENT_MAX      (32)
+#endif
+
+/* messages replayed but not acknowledged yet */
+#ifndef MQTT_STORE_WINDOW
+    #define MQTT_STORE_WINDOW           (4)
+#endif
+
+#ifndef MQTT_STORE_MAX
+    #define MQTT_STORE_MAX              (2)
+#endif
+
+#define MQTT_STORE_NAME_LEN_MAX         (16)
+#define MQTT_STORE_KEY_LEN_MAX          (MQTT_STORE_NAME_LEN_MAX + 12)
+
+#define MQTT_STORE_MAGIC                (0x3153514D)    /* "MQS1" */
+#define MQTT_STORE_META_LEN             (16)            /* magic, head, tail, acked */
+#define MQTT_STORE_SEG_HDR_LEN          (8)             /* segment number, sequence of its first record */
+#define MQTT_STORE_REC_HDR_LEN          (9)             /* sequence, flags, topic length, payload length */
+#define MQTT_STORE_REC_RETAIN           (0x01)
+
+/* segments the replay cursor has left but which still wait for acknowledgements, one per in-flight message at most */
+#define MQTT_STORE_BEHIND_MAX           (MQTT_STORE_WINDOW + 1)
+
+typedef struct {
+    uint32_t                    seq;
+    uint16_t                    packet_id;
+} mqtt_store_inflight_t;
+
+typedef struct {
+    char                        name[MQTT_STORE_NAME_LEN_MAX + 1];
+    void                       *lock;       /* guards everything below, not held across IOT_MQTT_Yield() */
+    void                       *client;     /* bound by IOT_MQTT_ConstructStore() */
+    iotx_mqtt_event_handle_t    user_event;
+
+    uint32_t                    head;       /* oldest segment */
+    uint32_t                    tail;       /* newest segment, the one appended to */
+    uint32_t                    acked;      /* every sequence below is acknowledged */
+    uint32_t                    next_seq;   /* sequence of the next message stored */
+
+    unsigned char               tail_buf[MQTT_STORE_SEGMENT_SIZE];
+    uint32_t                    tail_len;
+
+    /* replay cursor */
+    unsigned char               read_buf[MQTT_STORE_SEGMENT_SIZE];
+    uint32_t                    read_len;
+    uint32_t                    read_loaded; /* segment held in read_buf when read_valid */
+    int                         read_valid;
+    uint32_t                    read_seg;
+    uint32_t                    read_off;
+    uint32_t                    sent_next;  /* sequence after the last record the cursor passed */
+    uint32_t                    seg_end[MQTT_STORE_BEHIND_MAX];  /* sent_next as the cursor left head..read_seg-1 */
+
+    mqtt_store_inflight_t       inflight[MQTT_STORE_WINDOW];
+    uint32_t                    inflight_count;
+} mqtt_store_t;
+
+/* written only by open and close, which must not race with the other calls on that store */
+static mqtt_store_t *g_mqtt_store[MQTT_STORE_MAX];
+
+static void _mqtt_store_put32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t _mqtt_store_get32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void _mqtt_store_put16(unsigned char *p, uint16_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static uint16_t _mqtt_store_get16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static mqtt_store_t *_mqtt_store_find(void *store, void *client)
+{
+    int i;
+
+    for (i = 0; i < MQTT_STORE_MAX; i++) {
+        if (NULL == g_mqtt_store[i]) {
+            continue;
+        }
+        if ((NULL != store && store == g_mqtt_store[i])
+            || (NULL != client && client == g_mqtt_store[i]->client)) {
+            return g_mqtt_store[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* segments reuse MQTT_STORE_SEGMENT_MAX keys, the live ones head..tail never exceed them */
+static void _mqtt_store_key(mqtt_store_t *store, int is_meta, uint32_t seg, char key[MQTT_STORE_KEY_LEN_MAX])
+{
+    if (is_meta) {
+        HAL_Snprintf(key, MQTT_STORE_KEY_LEN_MAX, "%s.m", store->name);
+    } else {
+        HAL_Snprintf(key, MQTT_STORE_KEY_LEN_MAX, "%s.%u", store->name, (unsigned int)(seg % MQTT_STORE_SEGMENT_MAX));
+    }
+}
+
+static int _mqtt_store_save_meta(mqtt_store_t *store, int sync)
+{
+    char key[MQTT_STORE_KEY_LEN_MAX];
+    unsigned char meta[MQTT_STORE_META_LEN];
+
+    _mqtt_store_put32(meta, MQTT_STORE_MAGIC);
+    _mqtt_store_put32(meta + 4, store->head);
+    _mqtt_store_put32(meta + 8, store->tail);
+    _mqtt_store_put32(meta + 12, store->acked);
+
+    _mqtt_store_key(store, 1, 0, key);
+    if (0 != HAL_Kv_Set(key, meta, MQTT_STORE_META_LEN, sync)) {
+        log_err("save store meta failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* length of the record at off, 0 if it is not a whole record */
+static uint32_t _mqtt_store_rec_len(const unsigned char *buf, uint32_t off, uint32_t len)
+{
+    uint32_t topic_len, rec_len;
+
+    if (off + MQTT_STORE_REC_HDR_LEN > len) {
+        return 0;
+    }
+
+    topic_len = _mqtt_store_get16(buf + off + 5);
+    rec_len = MQTT_STORE_REC_HDR_LEN + topic_len + 1 + _mqtt_store_get16(buf + off + 7);
+    if (off + rec_len > len || '\0' != buf[off + MQTT_STORE_REC_HDR_LEN + topic_len]) {
+        return 0;
+    }
+
+    return rec_len;
+}
+
+/* load segment seg, *len is cut at the first broken record, *count tells the whole ones */
+static int _mqtt_store_load_seg(mqtt_store_t *store, uint32_t seg, unsigned char *buf, uint32_t *len, uint32_t *count)
+{
+    char key[MQTT_STORE_KEY_LEN_MAX];
+    int buf_len = MQTT_STORE_SEGMENT_SIZE;
+    uint32_t off, rec_len, n = 0;
+
+    _mqtt_store_key(store, 0, seg, key);
+    if (0 != HAL_Kv_Get(key, buf, &buf_len) || buf_len < MQTT_STORE_SEG_HDR_LEN || seg != _mqtt_store_get32(buf)) {
+        return -1;
+    }
+
+    for (off = MQTT_STORE_SEG_HDR_LEN; 0 != (rec_len = _mqtt_store_rec_len(buf, off, buf_len)); off += rec_len) {
+        n++;
+    }
+    if (off != (uint32_t)buf_len) {
+        log_err("store segment %u cut at %u of %d bytes", (unsigned int)seg, (unsigned int)off, buf_len);
+    }
+
+    *len = off;
+    if (NULL != count) {
+        *count = n;
+    }
+
+    return 0;
+}
+
+static void _mqtt_store_rewind(mqtt_store_t *store)
+{
+    store->inflight_count = 0;
+    store->read_seg = store->head;
+    store->read_off = MQTT_STORE_SEG_HDR_LEN;
+    store->sent_next = store->acked;
+}
+
+static void _mqtt_store_load(mqtt_store_t *store)
+{
+    char key[MQTT_STORE_KEY_LEN_MAX];
+    unsigned char meta[MQTT_STORE_META_LEN];
+    int meta_len = MQTT_STORE_META_LEN;
+    uint32_t seg, len, count;
+
+    _mqtt_store_key(store, 1, 0, key);
+    if (0 == HAL_Kv_Get(key, meta, &meta_len) && MQTT_STORE_META_LEN == meta_len
+        && MQTT_STORE_MAGIC == _mqtt_store_get32(meta)) {
+        store->head = _mqtt_store_get32(meta + 4);
+        store->tail = _mqtt_store_get32(meta + 8);
+        store->acked = _mqtt_store_get32(meta + 12);
+        if (store->tail - store->head >= MQTT_STORE_SEGMENT_MAX) {
+            log_err("store meta broken, head %u tail %u", (unsigned int)store->head, (unsigned int)store->tail);
+            store->head = store->tail;
+        }
+    } else {
+        store->head = store->tail = store->acked = 0;
+    }
+
+    /* a segment started just before a crash may not be in the meta record yet */
+    while (store->tail + 1 - store->head < MQTT_STORE_SEGMENT_MAX
+           && 0 == _mqtt_store_load_seg(store, store->tail + 1, store->read_buf, &len, NULL)) {
+        store->tail++;
+    }
+
+    /* sequences go on after the newest record stored */
+    store->next_seq = store->acked;
+    if (0 == _mqtt_store_load_seg(store, store->tail, store->tail_buf, &store->tail_len, &count)) {
+        store->next_seq = _mqtt_store_get32(store->tail_buf + 4) + count;
+    } else {
+        for (seg = store->tail; seg != store->head; seg--) {
+            if (0 == _mqtt_store_load_seg(store, seg - 1, store->read_buf, &len, &count)) {
+                store->next_seq = _mqtt_store_get32(store->read_buf + 4) + count;
+                break;
+            }
+        }
+        if (store->next_seq < store->acked) {
+            store->next_seq = store->acked;
+        }
+        _mqtt_store_put32(store->tail_buf, store->tail);
+        _mqtt_store_put32(store->tail_buf + 4, store->next_seq);
+        store->tail_len = MQTT_STORE_SEG_HDR_LEN;
+    }
+
+    store->read_valid = 0;
+    _mqtt_store_rewind(store);
+
+    log_info("store %s: %u pending in segments %u..%u", store->name,
+             (unsigned int)(store->next_seq - store->acked), (unsigned int)store->head, (unsigned int)store->tail);
+}
+
+/* drop the oldest segments the cursor has left and all of whose messages are acknowledged */
+static int _mqtt_store_trim(mqtt_store_t *store)
+{
+    char key[MQTT_STORE_KEY_LEN_MAX];
+    int trimmed = 0;
+
+    while (store->head < store->read_seg && store->seg_end[store->head % MQTT_STORE_BEHIND_MAX] <= store->acked) {
+        _mqtt_store_key(store, 0, store->head, key);
+        HAL_Kv_Del(key);
+        store->head++;
+        trimmed = 1;
+    }
+
+    return trimmed;
+}
+
+/* the mark moves up to the oldest message still in flight */
+static void _mqtt_store_ack(mqtt_store_t *store, uint16_t packet_id)
+{
+    uint32_t i, mark;
+
+    for (i = 0; i < store->inflight_count; i++) {
+        if (packet_id == store->inflight[i].packet_id) {
+            break;
+        }
+    }
+    if (i == store->inflight_count) {
+        return;     /* not replayed from the store */
+    }
+    store->inflight[i] = store->inflight[--store->inflight_count];
+
+    mark = store->sent_next;
+    for (i = 0; i < store->inflight_count; i++) {
+        if (store->inflight[i].seq < mark) {
+            mark = store->inflight[i].seq;
+        }
+    }
+    if (mark <= store->acked) {
+        return;
+    }
+
+    store->acked = mark;
+    _mqtt_store_trim(store);
+    _mqtt_store_save_meta(store, 0);
+}
+
+/* the segment under the cursor, a missing one reads as empty */
+static const unsigned char *_mqtt_store_cursor(mqtt_store_t *store, uint32_t *len)
+{
+    if (store->read_seg == store->tail) {
+        *len = store->tail_len;
+        return store->tail_buf;
+    }
+
+    if (!store->read_valid || store->read_loaded != store->read_seg) {
+        store->read_loaded = store->read_seg;
+        store->read_valid = 1;
+        if (0 != _mqtt_store_load_seg(store, store->read_seg, store->read_buf, &store->read_len, NULL)) {
+            log_err("store segment %u lost", (unsigned int)store->read_seg);
+            store->read_len = MQTT_STORE_SEG_HDR_LEN;
+        }
+    }
+
+    *len = store->read_len;
+    return store->read_buf;
+}
+
+/* replay stored messages while connected, as long as the window has room */
+static void _mqtt_store_flush(mqtt_store_t *store)
+{
+    iotx_mqtt_topic_info_t info;
+    const unsigned char *buf;
+    uint32_t len, rec_len, seq, topic_len;
+    int rc;
+
+    while (NULL != store->client && store->inflight_count < MQTT_STORE_WINDOW
+           && IOT_MQTT_CheckStateNormal(store->client)) {
+        buf = _mqtt_store_cursor(store, &len);
+
+        if (store->read_off >= len) {
+            if (store->read_seg == store->tail) {
+                break;  /* caught up */
+            }
+            if (_mqtt_store_trim(store)) {
+                _mqtt_store_save_meta(store, 0);
+            }
+            if (store->read_seg - store->head >= MQTT_STORE_BEHIND_MAX) {
+                break;  /* the segments behind wait for their acknowledgements */
+            }
+            store->seg_end[store->read_seg % MQTT_STORE_BEHIND_MAX] = store->sent_next;
+            store->read_seg++;
+            store->read_off = MQTT_STORE_SEG_HDR_LEN;
+            continue;
+        }
+
+        if (0 == (rec_len = _mqtt_store_rec_len(buf, store->read_off, len))) {
+            store->read_off = len;  /* loaded segments are cut at their first broken record */
+            continue;
+        }
+        seq = _mqtt_store_get32(buf + store->read_off);
+
+        if (seq >= store->acked) {
+            topic_len = _mqtt_store_get16(buf + store->read_off + 5);
+
+            memset(&info, 0, sizeof(iotx_mqtt_topic_info_t));
+            info.qos = IOTX_MQTT_QOS1;
+            info.retain = (buf[store->read_off + 4] & MQTT_STORE_REC_RETAIN) ? 1 : 0;
+            info.payload = (const char *)buf + store->read_off + MQTT_STORE_REC_HDR_LEN + topic_len + 1;
+            info.payload_len = _mqtt_store_get16(buf + store->read_off + 7);
+
+            rc = IOT_MQTT_Publish(store->client, (const char *)buf + store->read_off + MQTT_STORE_REC_HDR_LEN, &info);
+            if (rc < 0) {
+                log_err("replay publish failed, rc = %d", rc);
+                break;  /* tried again by the next yield */
+            }
+
+            store->inflight[store->inflight_count].seq = seq;
+            store->inflight[store->inflight_count].packet_id = (uint16_t)rc;
+            store->inflight_count++;
+        }
+
+        store->read_off += rec_len;
+        store->sent_next = seq + 1;
+    }
+}
+
+static void _mqtt_store_event_handle(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    mqtt_store_t *store = (mqtt_store_t *)pcontext;
+    uint16_t packet_id = (uint16_t)(uintptr_t)msg->msg;
+    uint32_t i;
+    int acked = 0;
+
+    switch (msg->event_type) {
+        case IOTX_MQTT_EVENT_PUBLISH_SUCCESS:
+            HAL_MutexLock(store->lock);
+            _mqtt_store_ack(store, packet_id);
+            HAL_MutexUnlock(store->lock);
+            acked = 1;
+            break;
+
+        case IOTX_MQTT_EVENT_PUBLISH_TIMEOUT:
+        case IOTX_MQTT_EVENT_PUBLISH_NACK:
+            /* given up by the client, send the window again from the mark */
+            HAL_MutexLock(store->lock);
+            for (i = 0; i < store->inflight_count; i++) {
+                if (packet_id == store->inflight[i].packet_id) {
+                    log_info("stored publish not acknowledged, packet-id=%u", (unsigned int)packet_id);
+                    _mqtt_store_rewind(store);
+                    break;
+                }
+            }
+            HAL_MutexUnlock(store->lock);
+            break;
+
+        default:
+            break;
+    }
+
+    /* the application still sees every event */
+    if (NULL != store->user_event.h_fp) {
+        store->user_event.h_fp(store->user_event.pcontext, pclient, msg);
+    }
+
+    /* an ack frees a window slot, refill it now rather than on the next yield */
+    if (acked) {
+        HAL_MutexLock(store->lock);
+        _mqtt_store_flush(store);
+        HAL_MutexUnlock(store->lock);
+    }
+}
+
+void *IOT_MQTT_StoreOpen(const char *name)
+{
+    mqtt_store_t *store;
+    size_t i, len;
+    int slot = -1;
+
+    if (NULL == name || 0 == (len = strlen(name)) || len > MQTT_STORE_NAME_LEN_MAX) {
+        log_err("invalid store name");
+        return NULL;
+    }
+    for (i = 0; i < len; i++) {
+        if (!((name[i] >= 'a' && name[i] <= 'z') || (name[i] >= 'A' && name[i] <= 'Z')
+              || (name[i] >= '0' && name[i] <= '9') || '_' == name[i])) {
+            log_err("store name of letters, digits and '_' only");
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < MQTT_STORE_MAX; i++) {
+        if (NULL == g_mqtt_store[i]) {
+            slot = (slot < 0) ? (int)i : slot;
+        } else if (0 == strcmp(g_mqtt_store[i]->name, name)) {
+            log_err("store %s is open already", name);
+            return NULL;
+        }
+    }
+    if (slot < 0) {
+        log_err("no more than %d stores", MQTT_STORE_MAX);
+        return NULL;
+    }
+
+    if (NULL == (store = LITE_malloc(sizeof(mqtt_store_t)))) {
+        log_err("Not enough memory");
+        return NULL;
+    }
+    memset(store, 0, sizeof(mqtt_store_t));
+    memcpy(store->name, name, len + 1);
+
+    if (NULL == (store->lock = HAL_MutexCreate())) {
+        log_err("create mutex failed");
+        LITE_free(store);
+        return NULL;
+    }
+
+    _mqtt_store_load(store);
+
+    g_mqtt_store[slot] = store;
+    return store;
+}
+
+int IOT_MQTT_StorePublish(void *store_handle, const char *topic_name, iotx_mqtt_topic_info_pt topic_msg)
+{
+    mqtt_store_t *store;
+    unsigned char *rec;
+    uint32_t topic_len, rec_len;
+    char key[MQTT_STORE_KEY_LEN_MAX];
+    int rolled = 0;
+
+    if (NULL == (store = _mqtt_store_find(store_handle, NULL))) {
+        log_err("store not opened by IOT_MQTT_StoreOpen");
+        return -1;
+    }
+    if (NULL == topic_name || NULL == topic_msg || (topic_msg->payload_len > 0 && NULL == topic_msg->payload)) {
+        log_err("invalid parameter");
+        return -1;
+    }
+
+    topic_len = strlen(topic_name);
+    rec_len = MQTT_STORE_REC_HDR_LEN + topic_len + 1 + topic_msg->payload_len;
+    if (rec_len > MQTT_STORE_SEGMENT_SIZE - MQTT_STORE_SEG_HDR_LEN) {
+        log_err("message of %u bytes exceeds a store segment", (unsigned int)rec_len);
+        return -1;
+    }
+
+    HAL_MutexLock(store->lock);
+
+    if (store->tail_len + rec_len > MQTT_STORE_SEGMENT_SIZE) {
+        if (store->tail + 1 - store->head >= MQTT_STORE_SEGMENT_MAX) {
+            HAL_MutexUnlock(store->lock);
+            log_err("store %s full", store->name);
+            return -1;
+        }
+
+        /* the cursor may still be reading the segment being closed */
+        if (store->read_seg == store->tail) {
+            memcpy(store->read_buf, store->tail_buf, store->tail_len);
+            store->read_len = store->tail_len;
+            store->read_loaded = store->tail;
+            store->read_valid = 1;
+        }
+
+        store->tail++;
+        _mqtt_store_put32(store->tail_buf, store->tail);
+        _mqtt_store_put32(store->tail_buf + 4, store->next_seq);
+        store->tail_len = MQTT_STORE_SEG_HDR_LEN;
+        rolled = 1;
+    }
+
+    rec = store->tail_buf + store->tail_len;
+    _mqtt_store_put32(rec, store->next_seq);
+    rec[4] = topic_msg->retain ? MQTT_STORE_REC_RETAIN : 0;
+    _mqtt_store_put16(rec + 5, (uint16_t)topic_len);
+    _mqtt_store_put16(rec + 7, (uint16_t)topic_msg->payload_len);
+    memcpy(rec + MQTT_STORE_REC_HDR_LEN, topic_name, topic_len + 1);
+    memcpy(rec + MQTT_STORE_REC_HDR_LEN + topic_len + 1, topic_msg->payload, topic_msg->payload_len);
+
+    /* accepted only once it is on storage, a new segment before the meta record naming it */
+    _mqtt_store_key(store, 0, store->tail, key);
+    if (0 != HAL_Kv_Set(key, store->tail_buf, store->tail_len + rec_len, 1)) {
+        HAL_MutexUnlock(store->lock);
+        log_err("store %s write failed", store->name);
+        return -1;
+    }
+    store->tail_len += rec_len;
+    store->next_seq++;
+
+    if (rolled) {
+        _mqtt_store_save_meta(store, 0);
+    }
+
+    /* written out by the next yield, which may be a while for a blocked one */
+    _mqtt_store_flush(store);
+
+    HAL_MutexUnlock(store->lock);
+
+    return 0;
+}
+
+int IOT_MQTT_StorePending(void *store_handle)
+{
+    mqtt_store_t *store;
+    int pending;
+
+    if (NULL == (store = _mqtt_store_find(store_handle, NULL))) {
+        log_err("store not opened by IOT_MQTT_StoreOpen");
+        return -1;
+    }
+
+    HAL_MutexLock(store->lock);
+    pending = (int)(store->next_seq - store->acked);
+    HAL_MutexUnlock(store->lock);
+
+    return pending;
+}
+
+int IOT_MQTT_StoreClose(void **pstore)
+{
+    mqtt_store_t *store;
+    int i;
+
+    if (NULL == pstore || NULL == (store = _mqtt_store_find(*pstore, NULL))) {
+        log_err("store not opened by IOT_MQTT_StoreOpen");
+        return -1;
+    }
+    if (NULL != store->client) {
+        log_err("store %s is bound to a client", store->name);
+        return -1;
+    }
+
+    for (i = 0; i < MQTT_STORE_MAX; i++) {
+        if (store == g_mqtt_store[i]) {
+            g_mqtt_store[i] = NULL;
+        }
+    }
+
+    HAL_MutexDestroy(store->lock);
+    LITE_free(store);
+    *pstore = NULL;
+
+    return 0;
+}
+
+void *IOT_MQTT_ConstructStore(iotx_mqtt_param_t *pInitParams, void *store_handle)
+{
+    iotx_mqtt_param_t params;
+    mqtt_store_t *store;
+    void *client;
+
+    if (NULL == pInitParams) {
+        log_err("invalid parameter");
+        return NULL;
+    }
+    if (NULL == (store = _mqtt_store_find(store_handle, NULL))) {
+        log_err("store not opened by IOT_MQTT_StoreOpen");
+        return NULL;
+    }
+    if (NULL != store->client) {
+        log_err("store %s is bound to a client", store->name);
+        return NULL;
+    }
+
+    /* interpose on the events to see the PUBACKs, they are passed on to the application handler */
+    store->user_event = pInitParams->handle_event;
+    params = *pInitParams;
+    params.handle_event.h_fp = _mqtt_store_event_handle;
+    params.handle_event.pcontext = store;
+
+#ifndef MQTT_ID2_AUTH
+    if (NULL == (client = IOT_MQTT_Construct(&params))) {
+#else
+    if (NULL == (client = IOT_MQTT_ConstructSecure(&params))) {
+#endif /**< MQTT_ID2_AUTH*/
+        log_err("construct MQTT failed");
+        return NULL;
+    }
+
+    /* a new client knows none of the packets of the last one, replay from the mark */
+    HAL_MutexLock(store->lock);
+    store->client = client;
+    _mqtt_store_rewind(store);
+    HAL_MutexUnlock(store->lock);
+
+    return client;
+}
+
+int IOT_MQTT_YieldStore(void *handle, int timeout_ms)
+{
+    mqtt_store_t *store;
+    int rc;
+
+    if (NULL == (store = _mqtt_store_find(NULL, handle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructStore");
+        return -1;
+    }
+
+    HAL_MutexLock(store->lock);
+    _mqtt_store_flush(store);
+    HAL_MutexUnlock(store->lock);
+
+    rc = IOT_MQTT_Yield(handle, timeout_ms);
+
+    /* a reconnect in the yield lets the replay go on at once */
+    HAL_MutexLock(store->lock);
+    _mqtt_store_flush(store);
+    HAL_MutexUnlock(store->lock);
+
+    return rc;
+}
+
+int IOT_MQTT_DestroyStore(void **phandle)
+{
+    mqtt_store_t *store;
+    int rc;
+
+    if (NULL == phandle || NULL == (store = _mqtt_store_find(NULL, *phandle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructStore");
+        return -1;
+    }
+
+    HAL_MutexLock(store->lock);
+    store->client = NULL;
+    _mqtt_store_rewind(store);
+    HAL_MutexUnlock(store->lock);
+
+    rc = IOT_MQTT_Destroy(phandle);
+    memset(&store->user_event, 0, sizeof(iotx_mqtt_event_handle_t));
+
+    return rc;
+}
@@ -0,0 +1,2 @@
+LIBA_TARGET := libiot_mqtt_stream.a
+HDR_REFS    := src
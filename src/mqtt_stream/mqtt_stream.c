@@ -0,0 +1,629 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "lite-utils.h"
+#include "utils_net.h"
+#include "utils_list.h"
+#include "utils_timer.h"
+#include "utils_topic.h"
+#include "sdk-impl_internal.h"
+
+#include "MQTTPacket/MQTTPacket.h"
+#include "mqtt_client.h"
+
+/*
+ * Publish of a payload larger than the write buffer of the MQTT client.
+ *
+ * The fixed and variable header are framed into the write buffer, which then carries the payload
+ * chunk by chunk as the caller provides it, so the payload never has to be in memory at once.
+ * The write buffer stays locked until the last byte is written, other packets of the client wait
+ * for it meanwhile, they can not be written in the middle of the PUBLISH.
+ */
+
+/* largest remaining length of an MQTT packet */
+#define MQTT_STREAM_REMAINING_LEN_MAX       (268435455)
+
+/* room for the fixed header, the topic length and the packet identifier */
+#define MQTT_STREAM_HEADER_OVERHEAD         (1 + 4 + 2 + 2)
+
+static int _mqtt_stream_next_packetid(iotx_mc_client_t *c)
+{
+    int id;
+
+    HAL_MutexLock(c->lock_generic);
+    c->packet_id = (c->packet_id == IOTX_MC_PACKET_ID_MAX) ? 1 : c->packet_id + 1;
+    id = (int)c->packet_id;
+    HAL_MutexUnlock(c->lock_generic);
+
+    return id;
+}
+
+static int _mqtt_stream_state_is(iotx_mc_client_t *c, iotx_mc_state_t state)
+{
+    int rc;
+
+    HAL_MutexLock(c->lock_generic);
+    rc = (c->client_state == state);
+    HAL_MutexUnlock(c->lock_generic);
+
+    return rc;
+}
+
+/* a PUBLISH cut short leaves the stream unusable, the next yield reconnects */
+static void _mqtt_stream_abort(iotx_mc_client_t *c)
+{
+    HAL_MutexLock(c->lock_generic);
+    c->client_state = IOTX_MC_STATE_DISCONNECTED;
+    HAL_MutexUnlock(c->lock_generic);
+}
+
+static int _mqtt_stream_send(iotx_mc_client_t *c, const char *buf, uint32_t len, uint32_t timeout_ms)
+{
+    int rc;
+    uint32_t sent = 0;
+    iotx_time_t timer;
+
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, timeout_ms);
+
+    while (sent < len && !utils_time_is_expired(&timer)) {
+        rc = c->ipstack->write(c->ipstack, buf + sent, len - sent, iotx_time_left(&timer));
+        if (rc < 0) {
+            break;
+        }
+        sent += rc;
+    }
+
+    return (sent == len) ? SUCCESS_RETURN : MQTT_NETWORK_ERROR;
+}
+
+int IOT_MQTT_PublishStream(void *handle,
+                           const char *topic_name,
+                           iotx_mqtt_qos_t qos,
+                           uint8_t retain,
+                           uint32_t payload_len,
+                           iotx_mqtt_stream_read_fpt read_cb,
+                           void *pcontext)
+{
+    iotx_mc_client_t *c = (iotx_mc_client_t *)handle;
+    MQTTString topic = MQTTString_initializer;
+    unsigned char *ptr;
+    uint32_t topic_len, remaining_len, offset, fill;
+    int packet_id = 0, rc;
+
+    POINTER_SANITY_CHECK(handle, NULL_VALUE_ERROR);
+    STRING_PTR_SANITY_CHECK(topic_name, NULL_VALUE_ERROR);
+    POINTER_SANITY_CHECK(read_cb, NULL_VALUE_ERROR);
+
+    topic_len = strlen(topic_name);
+    if (topic_len > IOTX_MC_TOPIC_NAME_MAX_LEN || NULL != strpbrk(topic_name, "+#")) {
+        log_err("topic format is error, topic = %s", topic_name);
+        return MQTT_TOPIC_FORMAT_ERROR;
+    }
+    if (IOTX_MQTT_QOS0 != qos && IOTX_MQTT_QOS1 != qos) {
+        log_err("only QoS0 and QoS1 can be streamed, qos = %d", qos);
+        return MQTT_PUBLISH_QOS_ERROR;
+    }
+
+    remaining_len = 2 + topic_len + (IOTX_MQTT_QOS0 == qos ? 0 : 2);
+    if (payload_len > MQTT_STREAM_REMAINING_LEN_MAX - remaining_len) {
+        log_err("payload too long, payload_len = %u", payload_len);
+        return MQTT_PUBLISH_PACKET_ERROR;
+    }
+    remaining_len += payload_len;
+
+    /* the header has to fit, and a chunk of at least one byte behind it */
+    if (c->buf_size_send <= MQTT_STREAM_HEADER_OVERHEAD + topic_len) {
+        log_err("write buffer too small for the header, buf_size = %u", c->buf_size_send);
+        return MQTT_PUBLISH_PACKET_ERROR;
+    }
+
+    /* a payload altered by mqtt_up_process, e.g. encrypted, can not be produced chunk by chunk */
+    if (NULL != c->mqtt_up_process) {
+        log_err("payload processing before publish can not be streamed");
+        return MQTT_PUBLISH_PACKET_ERROR;
+    }
+
+    if (!_mqtt_stream_state_is(c, IOTX_MC_STATE_CONNECTED)) {
+        log_err("mqtt client state is error");
+        return MQTT_STATE_ERROR;
+    }
+
+    if (IOTX_MQTT_QOS1 == qos) {
+        packet_id = _mqtt_stream_next_packetid(c);
+    }
+
+    HAL_MutexLock(c->lock_write_buf);
+
+    ptr = (unsigned char *)c->buf_send;
+    writeChar(&ptr, (char)(0x30 | (qos << 1) | (retain ? 1 : 0)));
+    ptr += MQTTPacket_encode(ptr, (int)remaining_len);
+    topic.cstring = (char *)topic_name;
+    writeMQTTString(&ptr, topic);
+    if (IOTX_MQTT_QOS1 == qos) {
+        writeInt(&ptr, packet_id);
+    }
+
+    rc = SUCCESS_RETURN;
+    offset = 0;
+    fill = (uint32_t)(ptr - (unsigned char *)c->buf_send);
+    do {
+        uint32_t want = c->buf_size_send - fill;
+        int got;
+
+        if (want > payload_len - offset) {
+            want = payload_len - offset;
+        }
+        while (want > 0) {
+            got = read_cb(pcontext, offset, c->buf_send + fill, want);
+            if (got <= 0 || (uint32_t)got > want) {
+                log_err("payload provider failed at offset %u, rc = %d", offset, got);
+                rc = MQTT_PUBLISH_PACKET_ERROR;
+                break;
+            }
+            offset += got;
+            fill += got;
+            want -= got;
+        }
+        if (SUCCESS_RETURN != rc) {
+            break;
+        }
+
+        rc = _mqtt_stream_send(c, c->buf_send, fill, c->request_timeout_ms);
+        fill = 0;
+    } while (SUCCESS_RETURN == rc && offset < payload_len);
+
+    HAL_MutexUnlock(c->lock_write_buf);
+
+    if (SUCCESS_RETURN != rc) {
+        log_err("stream publish failed at %u of %u bytes, rc = %d", offset, payload_len, rc);
+        _mqtt_stream_abort(c);
+        return rc;
+    }
+
+    return packet_id;
+}
+
+/*
+ * Reception of a PUBLISH larger than the read buffer of the MQTT client.
+ *
+ * The client reads every packet whole into its read buffer and drops a larger one. So the read of
+ * its connection is interposed: each packet header is looked at before the client reads it, and a
+ * PUBLISH too large for the read buffer whose topic has a stream subscription is read here instead,
+ * through the read buffer piece by piece into the fragment callback, then acknowledged. The client
+ * sees no data for that read. Every other packet is handed to the client byte for byte.
+ */
+
+#ifndef MQTT_STREAM_CLIENT_MAX
+    #define MQTT_STREAM_CLIENT_MAX          (2)
+#endif
+
+typedef struct {
+    iotx_mqtt_stream_recv_fpt   cb;
+    void                       *pcontext;
+} mqtt_stream_sub_t;
+
+typedef struct {
+    iotx_mc_client_t   *client;
+    int (*read_raw)(utils_network_pt, char *, uint32_t, uint32_t);
+    int (*connect_raw)(utils_network_pt);
+    void               *lock_subs;
+    utils_topic_trie_t  subs;           /* mqtt_stream_sub_t of each topic filter */
+
+    /* bytes of the packet read before the client asked, fixed header, topic length and topic */
+    unsigned char       ahead[1 + 4 + 2 + IOTX_MC_TOPIC_NAME_MAX_LEN];
+    uint32_t            ahead_len;
+    uint32_t            ahead_off;
+    uint32_t            body_left;      /* bytes of the packet behind the ones read ahead */
+} mqtt_stream_recv_t;
+
+static mqtt_stream_recv_t *g_mqtt_stream_recv[MQTT_STREAM_CLIENT_MAX];
+
+static mqtt_stream_recv_t *_mqtt_stream_recv_of(utils_network_pt pNetwork)
+{
+    int i;
+
+    for (i = 0; i < MQTT_STREAM_CLIENT_MAX; i++) {
+        if (NULL != g_mqtt_stream_recv[i] && pNetwork == g_mqtt_stream_recv[i]->client->ipstack) {
+            return g_mqtt_stream_recv[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* the first stream subscription matching takes the message */
+static int _mqtt_stream_sub_take(void *value, void *ctx)
+{
+    *(mqtt_stream_sub_t *)ctx = *(mqtt_stream_sub_t *)value;
+
+    return 1;
+}
+
+static int _mqtt_stream_sub_match(mqtt_stream_recv_t *ctx, const char *topic, uint32_t topic_len,
+                                  mqtt_stream_sub_t *sub)
+{
+    int found;
+
+    HAL_MutexLock(ctx->lock_subs);
+    found = utils_topic_trie_match(&ctx->subs, topic, topic_len, _mqtt_stream_sub_take, sub);
+    HAL_MutexUnlock(ctx->lock_subs);
+
+    return found;
+}
+
+/* read the rest of a large PUBLISH into the fragment callback, the topic is in ctx->ahead already */
+static int _mqtt_stream_deliver(mqtt_stream_recv_t *ctx, utils_network_pt pNetwork, uint32_t hdr_len,
+                                iotx_mqtt_stream_recv_fpt cb, void *pcontext)
+{
+    iotx_mc_client_t *c = ctx->client;
+    iotx_mqtt_stream_fragment_t fragment;
+    char topic[IOTX_MC_TOPIC_NAME_MAX_LEN + 1];
+    unsigned char id[2];
+    uint32_t n;
+
+    memset(&fragment, 0, sizeof(fragment));
+    fragment.qos = (ctx->ahead[0] >> 1) & 0x03;
+    fragment.topic_len = (uint16_t)(ctx->ahead_len - hdr_len - 2);
+    memcpy(topic, ctx->ahead + hdr_len + 2, fragment.topic_len);
+    topic[fragment.topic_len] = '\0';
+    fragment.ptopic = topic;
+
+    if (IOTX_MQTT_QOS0 != fragment.qos) {
+        if (ctx->read_raw(pNetwork, (char *)id, 2, c->request_timeout_ms) != 2) {
+            return -1;
+        }
+        ctx->body_left -= 2;
+        fragment.packet_id = (uint16_t)((id[0] << 8) | id[1]);
+    }
+
+    fragment.total_len = ctx->body_left;
+    do {
+        n = (ctx->body_left > c->buf_size_read) ? c->buf_size_read : ctx->body_left;
+        if (n > 0 && ctx->read_raw(pNetwork, c->buf_read, n, c->request_timeout_ms) != (int)n) {
+            log_err("stream read failed at %u of %u bytes", fragment.offset, fragment.total_len);
+            return -1;
+        }
+        ctx->body_left -= n;
+
+        fragment.payload = c->buf_read;
+        fragment.payload_len = n;
+        fragment.last = (0 == ctx->body_left);
+        cb(pcontext, c, &fragment);
+        fragment.offset += n;
+    } while (ctx->body_left > 0);
+
+    ctx->ahead_len = 0;
+    ctx->ahead_off = 0;
+
+    if (IOTX_MQTT_QOS1 == fragment.qos) {
+        char ack[4];
+        int rc;
+
+        ack[0] = (char)0x40;
+        ack[1] = 0x02;
+        ack[2] = (char)id[0];
+        ack[3] = (char)id[1];
+        HAL_MutexLock(c->lock_write_buf);
+        rc = _mqtt_stream_send(c, ack, sizeof(ack), c->request_timeout_ms);
+        HAL_MutexUnlock(c->lock_write_buf);
+        if (SUCCESS_RETURN != rc) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * read the header of the next packet
+ * return: 1, handed to the client; 0, nothing received or PUBLISH streamed; < 0, connection failed
+ */
+static int _mqtt_stream_next(mqtt_stream_recv_t *ctx, utils_network_pt pNetwork, uint32_t timeout_ms)
+{
+    iotx_mc_client_t *c = ctx->client;
+    unsigned char *ahead = ctx->ahead;
+    uint32_t rem_len = 0, multiplier = 1, hdr_len = 1, topic_len;
+    mqtt_stream_sub_t sub;
+    int rc;
+
+    ctx->ahead_len = 0;
+    ctx->ahead_off = 0;
+
+    rc = ctx->read_raw(pNetwork, (char *)ahead, 1, timeout_ms);
+    if (rc <= 0) {
+        return rc;
+    }
+
+    do {
+        if (hdr_len > 4) {
+            log_err("malformed remaining length");
+            return -1;
+        }
+        if (ctx->read_raw(pNetwork, (char *)ahead + hdr_len, 1, c->request_timeout_ms) != 1) {
+            return -1;
+        }
+        rem_len += (ahead[hdr_len] & 127) * multiplier;
+        multiplier *= 128;
+    } while (ahead[hdr_len++] & 128);
+
+    ctx->ahead_len = hdr_len;
+    ctx->body_left = rem_len;
+
+    /* QoS2 is left to the client, which does not support it */
+    if (PUBLISH != (ahead[0] >> 4) || ((ahead[0] >> 1) & 0x03) > IOTX_MQTT_QOS1
+        || hdr_len + rem_len <= c->buf_size_read || rem_len < 2) {
+        return 1;
+    }
+
+    /* the topic decides whether the message is streamed */
+    if (ctx->read_raw(pNetwork, (char *)ahead + hdr_len, 2, c->request_timeout_ms) != 2) {
+        return -1;
+    }
+    ctx->ahead_len += 2;
+    ctx->body_left -= 2;
+
+    topic_len = (ahead[hdr_len] << 8) | ahead[hdr_len + 1];
+    if (topic_len > IOTX_MC_TOPIC_NAME_MAX_LEN || topic_len > ctx->body_left) {
+        return 1;
+    }
+    if (topic_len > 0 && ctx->read_raw(pNetwork, (char *)ahead + hdr_len + 2, topic_len,
+                                       c->request_timeout_ms) != (int)topic_len) {
+        return -1;
+    }
+    ctx->ahead_len += topic_len;
+    ctx->body_left -= topic_len;
+
+    if (!_mqtt_stream_sub_match(ctx, (char *)ahead + hdr_len + 2, topic_len, &sub)) {
+        return 1;
+    }
+
+    return _mqtt_stream_deliver(ctx, pNetwork, hdr_len, sub.cb, sub.pcontext);
+}
+
+static int _mqtt_stream_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    mqtt_stream_recv_t *ctx = _mqtt_stream_recv_of(pNetwork);
+    uint32_t got = 0, n;
+    int rc;
+
+    if (NULL == ctx) {
+        return -1;
+    }
+
+    while (got < len) {
+        if (ctx->ahead_off < ctx->ahead_len) {
+            n = ctx->ahead_len - ctx->ahead_off;
+            if (n > len - got) {
+                n = len - got;
+            }
+            memcpy(buffer + got, ctx->ahead + ctx->ahead_off, n);
+            ctx->ahead_off += n;
+            got += n;
+            continue;
+        }
+
+        if (ctx->body_left > 0) {
+            n = (ctx->body_left > len - got) ? len - got : ctx->body_left;
+            rc = ctx->read_raw(pNetwork, buffer + got, n, timeout_ms);
+            if (rc < 0) {
+                return (0 == got) ? rc : (int)got;
+            }
+            ctx->body_left -= rc;
+            got += rc;
+            if ((uint32_t)rc < n) {
+                break;
+            }
+            continue;
+        }
+
+        /* the client never reads across packets */
+        if (got > 0) {
+            break;
+        }
+
+        rc = _mqtt_stream_next(ctx, pNetwork, timeout_ms);
+        if (rc <= 0) {
+            return rc;
+        }
+    }
+
+    return got;
+}
+
+/* a new connection starts at a packet boundary */
+static int _mqtt_stream_connect(utils_network_pt pNetwork)
+{
+    mqtt_stream_recv_t *ctx = _mqtt_stream_recv_of(pNetwork);
+
+    if (NULL == ctx) {
+        return -1;
+    }
+
+    ctx->ahead_len = 0;
+    ctx->ahead_off = 0;
+    ctx->body_left = 0;
+
+    return ctx->connect_raw(pNetwork);
+}
+
+/* messages fitting the read buffer come through the client as one piece */
+static void _mqtt_stream_on_message(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    mqtt_stream_recv_t *ctx = _mqtt_stream_recv_of(((iotx_mc_client_t *)pclient)->ipstack);
+    iotx_mqtt_topic_info_pt info = (iotx_mqtt_topic_info_pt)msg->msg;
+    iotx_mqtt_stream_fragment_t fragment;
+    mqtt_stream_sub_t sub;
+
+    (void)pcontext;
+
+    /* looked up again, the client may still deliver for a filter being unsubscribed */
+    if (IOTX_MQTT_EVENT_PUBLISH_RECVEIVED != msg->event_type || NULL == ctx
+        || !_mqtt_stream_sub_match(ctx, info->ptopic, info->topic_len, &sub)) {
+        return;
+    }
+
+    memset(&fragment, 0, sizeof(fragment));
+    fragment.ptopic = info->ptopic;
+    fragment.topic_len = info->topic_len;
+    fragment.qos = info->qos;
+    fragment.packet_id = info->packet_id;
+    fragment.total_len = info->payload_len;
+    fragment.payload = info->payload;
+    fragment.payload_len = info->payload_len;
+    fragment.last = 1;
+    sub.cb(sub.pcontext, pclient, &fragment);
+}
+
+/* hand the connection back to the client once no stream subscription is left */
+static void _mqtt_stream_recv_release(mqtt_stream_recv_t *ctx)
+{
+    int i;
+
+    if (0 != ctx->subs.count) {
+        return;
+    }
+
+    ctx->client->ipstack->read = ctx->read_raw;
+    ctx->client->ipstack->connect = ctx->connect_raw;
+    for (i = 0; i < MQTT_STREAM_CLIENT_MAX; i++) {
+        if (ctx == g_mqtt_stream_recv[i]) {
+            g_mqtt_stream_recv[i] = NULL;
+        }
+    }
+    utils_topic_trie_deinit(&ctx->subs, NULL);
+    HAL_MutexDestroy(ctx->lock_subs);
+    LITE_free(ctx);
+}
+
+int IOT_MQTT_SubscribeStream(void *handle,
+                             const char *topic_filter,
+                             iotx_mqtt_qos_t qos,
+                             iotx_mqtt_stream_recv_fpt fragment_cb,
+                             void *pcontext)
+{
+    iotx_mc_client_t *c = (iotx_mc_client_t *)handle;
+    mqtt_stream_recv_t *ctx;
+    mqtt_stream_sub_t *sub = NULL;
+    int i, slot = -1, rc;
+
+    POINTER_SANITY_CHECK(handle, NULL_VALUE_ERROR);
+    STRING_PTR_SANITY_CHECK(topic_filter, NULL_VALUE_ERROR);
+    POINTER_SANITY_CHECK(fragment_cb, NULL_VALUE_ERROR);
+
+    /* a payload altered by mqtt_down_process, e.g. decrypted, can not be handed out piece by piece */
+    if (NULL != c->mqtt_down_process) {
+        log_err("payload processing after receive can not be streamed");
+        return FAIL_RETURN;
+    }
+
+    ctx = _mqtt_stream_recv_of(c->ipstack);
+    if (NULL == ctx) {
+        for (i = 0; i < MQTT_STREAM_CLIENT_MAX && slot < 0; i++) {
+            if (NULL == g_mqtt_stream_recv[i]) {
+                slot = i;
+            }
+        }
+        if (slot < 0) {
+            log_err("more than %d clients with stream subscriptions", MQTT_STREAM_CLIENT_MAX);
+            return FAIL_RETURN;
+        }
+
+        ctx = (mqtt_stream_recv_t *)LITE_malloc(sizeof(mqtt_stream_recv_t));
+        if (NULL == ctx) {
+            return FAIL_RETURN;
+        }
+        memset(ctx, 0, sizeof(mqtt_stream_recv_t));
+        utils_topic_trie_init(&ctx->subs);
+        ctx->lock_subs = HAL_MutexCreate();
+        if (NULL == ctx->lock_subs) {
+            LITE_free(ctx);
+            return FAIL_RETURN;
+        }
+
+        /* the connection is read at a packet boundary while nobody yields */
+        ctx->client = c;
+        ctx->read_raw = c->ipstack->read;
+        ctx->connect_raw = c->ipstack->connect;
+        g_mqtt_stream_recv[slot] = ctx;
+        c->ipstack->read = _mqtt_stream_read;
+        c->ipstack->connect = _mqtt_stream_connect;
+    }
+
+    sub = (mqtt_stream_sub_t *)LITE_malloc(sizeof(mqtt_stream_sub_t));
+    if (NULL == sub) {
+        _mqtt_stream_recv_release(ctx);
+        return FAIL_RETURN;
+    }
+    sub->cb = fragment_cb;
+    sub->pcontext = pcontext;
+
+    HAL_MutexLock(ctx->lock_subs);
+    rc = utils_topic_trie_insert(&ctx->subs, topic_filter, sub);
+    HAL_MutexUnlock(ctx->lock_subs);
+    if (0 != rc) {
+        log_err("topic filter invalid or subscribed already, topic = %s", topic_filter);
+        LITE_free(sub);
+        _mqtt_stream_recv_release(ctx);
+        return FAIL_RETURN;
+    }
+
+    rc = IOT_MQTT_Subscribe(handle, topic_filter, qos, _mqtt_stream_on_message, NULL);
+    if (rc < 0) {
+        HAL_MutexLock(ctx->lock_subs);
+        sub = utils_topic_trie_remove(&ctx->subs, topic_filter);
+        HAL_MutexUnlock(ctx->lock_subs);
+        LITE_free(sub);
+        _mqtt_stream_recv_release(ctx);
+    }
+
+    return rc;
+}
+
+int IOT_MQTT_UnsubscribeStream(void *handle, const char *topic_filter)
+{
+    iotx_mc_client_t *c = (iotx_mc_client_t *)handle;
+    mqtt_stream_recv_t *ctx;
+    mqtt_stream_sub_t *sub;
+    int rc = FAIL_RETURN;
+
+    POINTER_SANITY_CHECK(handle, NULL_VALUE_ERROR);
+    STRING_PTR_SANITY_CHECK(topic_filter, NULL_VALUE_ERROR);
+
+    ctx = _mqtt_stream_recv_of(c->ipstack);
+    if (NULL == ctx) {
+        return FAIL_RETURN;
+    }
+
+    HAL_MutexLock(ctx->lock_subs);
+    sub = utils_topic_trie_remove(&ctx->subs, topic_filter);
+    HAL_MutexUnlock(ctx->lock_subs);
+    if (NULL != sub) {
+        LITE_free(sub);
+        rc = IOT_MQTT_Unsubscribe(handle, topic_filter);
+    }
+
+    _mqtt_stream_recv_release(ctx);
+
+    return rc;
+}
@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "lite-utils.h"
+
+/*
+ * The MQTT client run by threads of its own.
+ *
+ * The I/O thread yields the client all the time: it reads, pings, reconnects and writes the
+ * republish list, and with MQTT_ASYNC_PUBLISH_ENABLED the outbound queue of the asynchronous
+ * publish too. Events and messages it gets are copied into a queue, the callback thread calls the
+ * application handlers from there, so a slow handler delays other handlers but never a PINGREQ.
+ * The queue is bounded by MQTT_THREAD_QUEUE_MAX, what comes in while it is full is dropped.
+ */
+
+#ifndef MQTT_THREAD_CLIENT_MAX
+    #define MQTT_THREAD_CLIENT_MAX          (2)
+#endif
+
+/* subscriptions through IOT_MQTT_SubscribeThread() a client may have */
+#ifndef MQTT_THREAD_SUB_MAX
+    #define MQTT_THREAD_SUB_MAX             (10)
+#endif
+
+/* events and messages waiting for the callback thread at most */
+#ifndef MQTT_THREAD_QUEUE_MAX
+    #define MQTT_THREAD_QUEUE_MAX           (32)
+#endif
+
+/* longest read of one yield, the I/O thread looks at its stop flag in between */
+#ifndef MQTT_THREAD_YIELD_MS
+    #define MQTT_THREAD_YIELD_MS            (200)
+#endif
+
+/* stack of each thread, 0 for the platform default */
+#ifndef MQTT_THREAD_STACK_SIZE
+    #define MQTT_THREAD_STACK_SIZE          (0)
+#endif
+
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+/* outbound queue of the asynchronous publish, see IOT_MQTT_ConstructAsync() */
+#ifndef MQTT_THREAD_ASYNC_QUEUE_LEN
+    #define MQTT_THREAD_ASYNC_QUEUE_LEN     (8)
+#endif
+#endif
+
+typedef struct mqtt_thread_item_st {
+    struct mqtt_thread_item_st     *next;
+    iotx_mqtt_event_handle_func_fpt fp;
+    void                           *pcontext;
+    void                           *client;
+    iotx_mqtt_event_msg_t           msg;
+    iotx_mqtt_topic_info_t          info;   /* msg.msg of a message, its topic and payload follow the item */
+} mqtt_thread_item_t;
+
+typedef struct {
+    char                           *topic_filter;   /* kept by the client until destroyed */
+    iotx_mqtt_event_handle_func_fpt fp;             /* NULL once unsubscribed */
+    void                           *pcontext;
+    void                           *ctx;
+} mqtt_thread_sub_t;
+
+typedef struct {
+    void                           *client;
+    iotx_mqtt_event_handle_t        user_event;
+
+    void                           *lock;       /* guards the queue and the subscriptions */
+    mqtt_thread_item_t             *queue_head;
+    mqtt_thread_item_t             *queue_tail;
+    uint32_t                        queue_count;
+    uint32_t                        dropped;
+    mqtt_thread_sub_t               subs[MQTT_THREAD_SUB_MAX];
+
+    void                           *sem_work;   /* posted once per item queued and once to stop */
+    void                           *sem_io_exit;
+    void                           *sem_cb_exit;
+    volatile int                    stop_io;
+    volatile int                    stop_cb;
+} mqtt_thread_t;
+
+static mqtt_thread_t *g_mqtt_thread[MQTT_THREAD_CLIENT_MAX];
+
+static mqtt_thread_t *_mqtt_thread_find(void *client)
+{
+    int i;
+
+    for (i = 0; i < MQTT_THREAD_CLIENT_MAX; i++) {
+        if (NULL != g_mqtt_thread[i] && client == g_mqtt_thread[i]->client) {
+            return g_mqtt_thread[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* called on the I/O thread, copies what the callback thread needs after the client moved on */
+static void _mqtt_thread_queue(mqtt_thread_t *ctx,
+                               iotx_mqtt_event_handle_func_fpt fp,
+                               void *pcontext,
+                               void *client,
+                               iotx_mqtt_event_msg_pt msg)
+{
+    iotx_mqtt_topic_info_pt info = NULL;
+    mqtt_thread_item_t *item;
+    uint32_t extra = 0;
+    char *p;
+
+    if (IOTX_MQTT_EVENT_PUBLISH_RECVEIVED == msg->event_type && NULL != msg->msg) {
+        info = (iotx_mqtt_topic_info_pt)msg->msg;
+        extra = info->topic_len + info->payload_len;
+    }
+
+    HAL_MutexLock(ctx->lock);
+    if (ctx->queue_count >= MQTT_THREAD_QUEUE_MAX) {
+        ctx->dropped++;
+        HAL_MutexUnlock(ctx->lock);
+        log_err("callback queue full, event %d dropped, %u so far", msg->event_type, ctx->dropped);
+        return;
+    }
+    HAL_MutexUnlock(ctx->lock);
+
+    if (NULL == (item = LITE_malloc(sizeof(mqtt_thread_item_t) + extra))) {
+        log_err("Not enough memory, event %d dropped", msg->event_type);
+        return;
+    }
+    memset(item, 0, sizeof(mqtt_thread_item_t));
+    item->fp = fp;
+    item->pcontext = pcontext;
+    item->client = client;
+    item->msg = *msg;
+    if (NULL != info) {
+        p = (char *)(item + 1);
+        item->info = *info;
+        memcpy(p, info->ptopic, info->topic_len);
+        item->info.ptopic = p;
+        memcpy(p + info->topic_len, info->payload, info->payload_len);
+        item->info.payload = p + info->topic_len;
+        item->msg.msg = &item->info;
+    }
+
+    HAL_MutexLock(ctx->lock);
+    if (NULL == ctx->queue_tail) {
+        ctx->queue_head = item;
+    } else {
+        ctx->queue_tail->next = item;
+    }
+    ctx->queue_tail = item;
+    ctx->queue_count++;
+    HAL_MutexUnlock(ctx->lock);
+
+    HAL_SemaphorePost(ctx->sem_work);
+}
+
+static void _mqtt_thread_event_handle(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    mqtt_thread_t *ctx = (mqtt_thread_t *)pcontext;
+
+    if (NULL != ctx->user_event.h_fp) {
+        _mqtt_thread_queue(ctx, ctx->user_event.h_fp, ctx->user_event.pcontext, pclient, msg);
+    }
+}
+
+static void _mqtt_thread_topic_handle(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    mqtt_thread_sub_t *sub = (mqtt_thread_sub_t *)pcontext;
+    mqtt_thread_t *ctx = (mqtt_thread_t *)sub->ctx;
+    iotx_mqtt_event_handle_func_fpt fp;
+    void *context;
+
+    HAL_MutexLock(ctx->lock);
+    fp = sub->fp;
+    context = sub->pcontext;
+    HAL_MutexUnlock(ctx->lock);
+
+    /* a message still on its way when the topic was unsubscribed */
+    if (NULL != fp) {
+        _mqtt_thread_queue(ctx, fp, context, pclient, msg);
+    }
+}
+
+static void *_mqtt_thread_io(void *arg)
+{
+    mqtt_thread_t *ctx = (mqtt_thread_t *)arg;
+    int rc;
+
+    while (!ctx->stop_io) {
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+        rc = IOT_MQTT_YieldAsync(ctx->client, MQTT_THREAD_YIELD_MS);
+#else
+        rc = IOT_MQTT_Yield(ctx->client, MQTT_THREAD_YIELD_MS);
+#endif
+        if (rc < 0) {
+            /* a client given up on returns at once */
+            HAL_SleepMs(MQTT_THREAD_YIELD_MS);
+        }
+    }
+
+    HAL_SemaphorePost(ctx->sem_io_exit);
+    return NULL;
+}
+
+static void *_mqtt_thread_callback(void *arg)
+{
+    mqtt_thread_t *ctx = (mqtt_thread_t *)arg;
+    mqtt_thread_item_t *item;
+
+    for (;;) {
+        (void)HAL_SemaphoreWait(ctx->sem_work, PLATFORM_WAIT_INFINITE);
+        if (ctx->stop_cb) {
+            break;
+        }
+
+        HAL_MutexLock(ctx->lock);
+        if (NULL != (item = ctx->queue_head)) {
+            ctx->queue_head = item->next;
+            if (NULL == ctx->queue_head) {
+                ctx->queue_tail = NULL;
+            }
+            ctx->queue_count--;
+        }
+        HAL_MutexUnlock(ctx->lock);
+
+        if (NULL != item) {
+            item->fp(item->pcontext, item->client, &item->msg);
+            LITE_free(item);
+        }
+    }
+
+    HAL_SemaphorePost(ctx->sem_cb_exit);
+    return NULL;
+}
+
+static void _mqtt_thread_release(mqtt_thread_t *ctx)
+{
+    mqtt_thread_item_t *item;
+    int i;
+
+    while (NULL != (item = ctx->queue_head)) {
+        ctx->queue_head = item->next;
+        LITE_free(item);
+    }
+    for (i = 0; i < MQTT_THREAD_SUB_MAX; i++) {
+        if (NULL != ctx->subs[i].topic_filter) {
+            LITE_free(ctx->subs[i].topic_filter);
+        }
+    }
+    if (NULL != ctx->sem_work) {
+        HAL_SemaphoreDestroy(ctx->sem_work);
+    }
+    if (NULL != ctx->sem_io_exit) {
+        HAL_SemaphoreDestroy(ctx->sem_io_exit);
+    }
+    if (NULL != ctx->sem_cb_exit) {
+        HAL_SemaphoreDestroy(ctx->sem_cb_exit);
+    }
+    if (NULL != ctx->lock) {
+        HAL_MutexDestroy(ctx->lock);
+    }
+    LITE_free(ctx);
+}
+
+static int _mqtt_thread_start(mqtt_thread_t *ctx, void *(*routine)(void *), const char *name)
+{
+    hal_os_thread_param_t param;
+    void *thread;
+
+    memset(&param, 0, sizeof(param));
+    param.stack_size = MQTT_THREAD_STACK_SIZE;
+    param.name = name;
+    if (0 != HAL_ThreadCreate(&thread, routine, ctx, &param, NULL)) {
+        log_err("create thread %s failed", name);
+        return -1;
+    }
+
+    /* the exit semaphores tell when it ends */
+    HAL_ThreadDetach(thread);
+    return 0;
+}
+
+void *IOT_MQTT_ConstructThread(iotx_mqtt_param_t *pInitParams)
+{
+    iotx_mqtt_param_t params;
+    mqtt_thread_t *ctx;
+    int slot;
+
+    if (NULL == pInitParams) {
+        log_err("invalid parameter");
+        return NULL;
+    }
+
+    for (slot = 0; slot < MQTT_THREAD_CLIENT_MAX; slot++) {
+        if (NULL == g_mqtt_thread[slot]) {
+            break;
+        }
+    }
+    if (MQTT_THREAD_CLIENT_MAX == slot) {
+        log_err("no more than %d threaded clients", MQTT_THREAD_CLIENT_MAX);
+        return NULL;
+    }
+
+    if (NULL == (ctx = LITE_malloc(sizeof(mqtt_thread_t)))) {
+        log_err("Not enough memory");
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(mqtt_thread_t));
+
+    ctx->lock = HAL_MutexCreate();
+    ctx->sem_work = HAL_SemaphoreCreate();
+    ctx->sem_io_exit = HAL_SemaphoreCreate();
+    ctx->sem_cb_exit = HAL_SemaphoreCreate();
+    if (NULL == ctx->lock || NULL == ctx->sem_work || NULL == ctx->sem_io_exit || NULL == ctx->sem_cb_exit) {
+        log_err("create lock failed");
+        _mqtt_thread_release(ctx);
+        return NULL;
+    }
+
+    /* interpose on the events, they are passed on to the application handler by the callback thread */
+    ctx->user_event = pInitParams->handle_event;
+    params = *pInitParams;
+    params.handle_event.h_fp = _mqtt_thread_event_handle;
+    params.handle_event.pcontext = ctx;
+
+#if defined(MQTT_ASYNC_PUBLISH_ENABLED)
+    ctx->client = IOT_MQTT_ConstructAsync(&params, MQTT_THREAD_ASYNC_QUEUE_LEN);
+#elif !defined(MQTT_ID2_AUTH)
+    ctx->client = IOT_MQTT_Construct(&params);
+#else
+    ctx->client = IOT_MQTT_ConstructSecure(&params);
+#endif
+    if (NULL == ctx->client) {
+        log_err("construct MQTT failed");
+        _mqtt_thread_release(ctx);
+        return NULL;
+    }
+
+    if (0 != _mqtt_thread_start(ctx, _mqtt_thread_callback, "mqtt_cb")) {
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+        IOT_MQTT_DestroyAsync(&ctx->client);
+#else
+        IOT_MQTT_Destroy(&ctx->client);
+#endif
+        _mqtt_thread_release(ctx);
+        return NULL;
+    }
+    if (0 != _mqtt_thread_start(ctx, _mqtt_thread_io, "mqtt_io")) {
+        ctx->stop_cb = 1;
+        HAL_SemaphorePost(ctx->sem_work);
+        (void)HAL_SemaphoreWait(ctx->sem_cb_exit, PLATFORM_WAIT_INFINITE);
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+        IOT_MQTT_DestroyAsync(&ctx->client);
+#else
+        IOT_MQTT_Destroy(&ctx->client);
+#endif
+        _mqtt_thread_release(ctx);
+        return NULL;
+    }
+
+    g_mqtt_thread[slot] = ctx;
+    return ctx->client;
+}
+
+int IOT_MQTT_SubscribeThread(void *handle,
+                             const char *topic_filter,
+                             iotx_mqtt_qos_t qos,
+                             iotx_mqtt_event_handle_func_fpt topic_handle_func,
+                             void *pcontext)
+{
+    mqtt_thread_sub_t *sub = NULL;
+    mqtt_thread_t *ctx;
+    int i, rc;
+
+    if (NULL == topic_filter || NULL == topic_handle_func) {
+        log_err("invalid parameter");
+        return NULL_VALUE_ERROR;
+    }
+    if (NULL == (ctx = _mqtt_thread_find(handle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructThread");
+        return NULL_VALUE_ERROR;
+    }
+
+    /* subscriptions are never freed before destroy, the client may hold on to one a while after unsubscribe */
+    HAL_MutexLock(ctx->lock);
+    for (i = 0; i < MQTT_THREAD_SUB_MAX; i++) {
+        if (NULL != ctx->subs[i].topic_filter && 0 == strcmp(ctx->subs[i].topic_filter, topic_filter)) {
+            sub = &ctx->subs[i];
+            break;
+        }
+        if (NULL == sub && NULL == ctx->subs[i].topic_filter) {
+            sub = &ctx->subs[i];
+        }
+    }
+    if (NULL == sub) {
+        HAL_MutexUnlock(ctx->lock);
+        log_err("no more than %d subscriptions", MQTT_THREAD_SUB_MAX);
+        return FAIL_RETURN;
+    }
+    if (NULL == sub->topic_filter) {
+        if (NULL == (sub->topic_filter = LITE_malloc(strlen(topic_filter) + 1))) {
+            HAL_MutexUnlock(ctx->lock);
+            log_err("Not enough memory");
+            return FAIL_RETURN;
+        }
+        strcpy(sub->topic_filter, topic_filter);
+        sub->ctx = ctx;
+    }
+    sub->fp = topic_handle_func;
+    sub->pcontext = pcontext;
+    HAL_MutexUnlock(ctx->lock);
+
+    rc = IOT_MQTT_Subscribe(handle, sub->topic_filter, qos, _mqtt_thread_topic_handle, sub);
+    if (rc < 0) {
+        HAL_MutexLock(ctx->lock);
+        sub->fp = NULL;
+        HAL_MutexUnlock(ctx->lock);
+    }
+
+    return rc;
+}
+
+int IOT_MQTT_UnsubscribeThread(void *handle, const char *topic_filter)
+{
+    mqtt_thread_t *ctx;
+    char *filter = NULL;
+    int i;
+
+    if (NULL == topic_filter) {
+        log_err("invalid parameter");
+        return NULL_VALUE_ERROR;
+    }
+    if (NULL == (ctx = _mqtt_thread_find(handle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructThread");
+        return NULL_VALUE_ERROR;
+    }
+
+    HAL_MutexLock(ctx->lock);
+    for (i = 0; i < MQTT_THREAD_SUB_MAX; i++) {
+        if (NULL != ctx->subs[i].topic_filter && 0 == strcmp(ctx->subs[i].topic_filter, topic_filter)) {
+            ctx->subs[i].fp = NULL;
+            filter = ctx->subs[i].topic_filter;
+            break;
+        }
+    }
+    HAL_MutexUnlock(ctx->lock);
+
+    if (NULL == filter) {
+        log_err("%s not subscribed by IOT_MQTT_SubscribeThread", topic_filter);
+        return FAIL_RETURN;
+    }
+
+    return IOT_MQTT_Unsubscribe(handle, filter);
+}
+
+int IOT_MQTT_DestroyThread(void **phandle)
+{
+    mqtt_thread_t *ctx;
+    int i, rc;
+
+    if (NULL == phandle || NULL == (ctx = _mqtt_thread_find(*phandle))) {
+        log_err("client not constructed by IOT_MQTT_ConstructThread");
+        return NULL_VALUE_ERROR;
+    }
+
+    for (i = 0; i < MQTT_THREAD_CLIENT_MAX; i++) {
+        if (ctx == g_mqtt_thread[i]) {
+            g_mqtt_thread[i] = NULL;
+        }
+    }
+
+    ctx->stop_io = 1;
+    (void)HAL_SemaphoreWait(ctx->sem_io_exit, PLATFORM_WAIT_INFINITE);
+
+    /* what is still queued is dropped, the callbacks are over before the client goes */
+    ctx->stop_cb = 1;
+    HAL_SemaphorePost(ctx->sem_work);
+    (void)HAL_SemaphoreWait(ctx->sem_cb_exit, PLATFORM_WAIT_INFINITE);
+
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+    rc = IOT_MQTT_DestroyAsync(&ctx->client);
+#else
+    rc = IOT_MQTT_Destroy(&ctx->client);
+#endif
+    _mqtt_thread_release(ctx);
+    *phandle = NULL;
+
+    return rc;
+}
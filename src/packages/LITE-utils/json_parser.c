@@ -27,6 +27,75 @@
 
 #define json_debug log_debug
 
+#if WITH_JSON_VECTOR_SCAN
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/* bytes of word w equal to the byte of c are 0x80 in the result, the others 0 */
+#define SCAN_ONES               (~0UL / 0xFF)
+#define SCAN_EQ(w, c)           ((((w) ^ (SCAN_ONES * (c))) - SCAN_ONES) & ~((w) ^ (SCAN_ONES * (c))) & (SCAN_ONES << 7))
+
+/*
+ * the first of [str, str_end) that is open, close, a quote or the terminating 0, str_end if none.
+ * what the value loop of json_get_next_object() looks at, every other byte is skipped in blocks.
+ */
+static char *json_scan_mark(char *str, char *str_end, char open, char close)
+{
+#if defined(__SSE2__)
+    __m128i         v_open = _mm_set1_epi8(open), v_close = _mm_set1_epi8(close);
+    __m128i         v_quote = _mm_set1_epi8('\"'), v_zero = _mm_setzero_si128();
+    __m128i         block;
+    int             mask;
+
+    while (str_end - str >= 16) {
+        block = _mm_loadu_si128((const __m128i *)str);
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, v_open), _mm_cmpeq_epi8(block, v_close)),
+                                              _mm_or_si128(_mm_cmpeq_epi8(block, v_quote), _mm_cmpeq_epi8(block, v_zero))));
+        if (mask) {
+            return str + __builtin_ctz(mask);
+        }
+        str += 16;
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t      v_open = vdupq_n_u8(open), v_close = vdupq_n_u8(close);
+    uint8x16_t      v_quote = vdupq_n_u8('\"'), v_zero = vdupq_n_u8(0);
+    uint8x16_t      block, hit;
+    uint64x2_t      halves;
+
+    while (str_end - str >= 16) {
+        block = vld1q_u8((const uint8_t *)str);
+        hit = vorrq_u8(vorrq_u8(vceqq_u8(block, v_open), vceqq_u8(block, v_close)),
+                       vorrq_u8(vceqq_u8(block, v_quote), vceqq_u8(block, v_zero)));
+        halves = vreinterpretq_u64_u8(hit);
+        if (vgetq_lane_u64(halves, 0) | vgetq_lane_u64(halves, 1)) {
+            break;  /* found in the block, the bytes below tell where */
+        }
+        str += 16;
+    }
+#else
+    unsigned long   w;
+
+    while ((size_t)(str_end - str) >= sizeof(w)) {
+        memcpy(&w, str, sizeof(w));
+        if (SCAN_EQ(w, (unsigned char)open) | SCAN_EQ(w, (unsigned char)close)
+            | SCAN_EQ(w, (unsigned char)'\"') | SCAN_EQ(w, 0)) {
+            break;  /* found in the word, the bytes below tell where */
+        }
+        str += sizeof(w);
+    }
+#endif
+
+    while (str < str_end && *str != open && *str != close && *str != '\"' && *str != 0) {
+        str++;
+    }
+
+    return str;
+}
+#endif  /* #if WITH_JSON_VECTOR_SCAN */
+
 char *json_get_object(int type, char *str, char *str_end)
 {
     char *pos = NULL;
@@ -96,8 +165,16 @@ char *json_get_next_object(int type, char *str, char *str_end, char **key, int *
     }
 
     while (p_cPos && *p_cPos && p_cPos < str_end && iValueType > JNONE) {
+#if WITH_JSON_VECTOR_SCAN
+        if (iValueType == JSTRING || iValueType == JOBJECT || iValueType == JARRAY) {
+            p_cPos = json_scan_mark(p_cPos, str_end, JsonMark[iValueType][0], JsonMark[iValueType][1]);
+            if (p_cPos >= str_end || !*p_cPos) {
+                break;
+            }
+        }
+#endif
         if (iValueType == JBOOLEAN) {
-            int     len = strlen(p_cValue);
+            int     len = str_end - p_cValue;
 
             if ((*p_cValue == 't' || *p_cValue == 'T') && len >= 4
                 && (!strncmp(p_cValue, "true", 4)
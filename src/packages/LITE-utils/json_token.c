@@ -630,6 +630,78 @@ char *LITE_json_value_of_ext2(char *key, char *src, int src_len, int *value_len)
     return _LITE_json_value_of_ext(key, src, src_len, value_len);
 }
 
+/*
+ * views whose key starts with path (of path_len, up to and with its '.') are resolved in the object of src,
+ * going down only into the values some of them go on into. a value found the first time is kept.
+ */
+static int _LITE_json_values_of(char *src, int src_len, lite_json_view_t *views, int count,
+                                const char *path, int path_len, int *left)
+{
+    char           *pos = 0, *key = 0, *val = 0;
+    int             klen = 0, vlen = 0, vtype = 0;
+    const char     *sub;
+    const char     *seg;
+    int             found = 0;
+    int             i;
+
+    json_object_for_each_kv(src, src_len, pos, key, klen, val, vlen, vtype) {
+        if (!key || !klen || !val || !vlen) {
+            continue;
+        }
+
+        sub = NULL;
+        for (i = 0; i < count; i++) {
+            if (!views[i].key || views[i].value || strncmp(views[i].key, path, path_len)) {
+                continue;
+            }
+
+            seg = views[i].key + path_len;
+            if (strncmp(seg, key, klen)) {
+                continue;
+            }
+            if ('\0' == seg[klen]) {
+                views[i].value = val;
+                views[i].value_len = vlen;
+                views[i].value_type = vtype;
+                ++found;
+                --*left;
+            } else if ('.' == seg[klen] && JOBJECT == vtype && !sub) {
+                sub = views[i].key;
+            }
+        }
+
+        if (sub) {
+            found += _LITE_json_values_of(val, vlen, views, count, sub, path_len + klen + 1, left);
+        }
+        if (*left <= 0) {
+            break;
+        }
+    }
+
+    return found;
+}
+
+int LITE_json_values_of(char *src, int src_len, lite_json_view_t *views, int count)
+{
+    int             left = count;
+    int             i;
+
+    if (NULL == src || src_len <= 0 || NULL == views || count <= 0) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        views[i].value = NULL;
+        views[i].value_len = 0;
+        views[i].value_type = JNONE;
+        if (NULL == views[i].key) {
+            --left;
+        }
+    }
+
+    return _LITE_json_values_of(src, src_len, views, count, "", 0, &left);
+}
+
 int get_json_item_size(char *src, int src_len)
 {
     char       *iter_pos = NULL;
@@ -0,0 +1,930 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <math.h>
+
+#include "lite-utils_internal.h"
+#include "lite-cbor.h"
+
+#define CBOR_MAJOR_UINT         0
+#define CBOR_MAJOR_NEGINT       1
+#define CBOR_MAJOR_BYTES        2
+#define CBOR_MAJOR_TEXT         3
+#define CBOR_MAJOR_ARRAY        4
+#define CBOR_MAJOR_MAP          5
+#define CBOR_MAJOR_TAG          6
+#define CBOR_MAJOR_SIMPLE       7
+
+#define CBOR_INFO_UINT8         24
+#define CBOR_INFO_UINT16        25
+#define CBOR_INFO_UINT32        26
+#define CBOR_INFO_UINT64        27
+#define CBOR_INFO_INDEFINITE    31
+
+#define CBOR_JSON_NUMBER_MAXLEN 64
+
+static void cbor_put(lite_cbor_writer_t *writer, const void *data, size_t len)
+{
+    if (NULL != writer->buf && writer->len + len <= writer->size) {
+        memcpy(writer->buf + writer->len, data, len);
+    }
+    writer->len += len;
+}
+
+static void cbor_put_be(unsigned char *out, uint64_t value, int bytes)
+{
+    int i;
+
+    for (i = bytes - 1; i >= 0; i--) {
+        out[i] = (unsigned char)value;
+        value >>= 8;
+    }
+}
+
+static void cbor_head(lite_cbor_writer_t *writer, int major, uint64_t value)
+{
+    unsigned char head[9];
+    size_t        len;
+
+    if (value < CBOR_INFO_UINT8) {
+        head[0] = (unsigned char)(major << 5 | value);
+        len = 1;
+    } else if (value <= 0xff) {
+        head[0] = (unsigned char)(major << 5 | CBOR_INFO_UINT8);
+        len = 2;
+    } else if (value <= 0xffff) {
+        head[0] = (unsigned char)(major << 5 | CBOR_INFO_UINT16);
+        len = 3;
+    } else if (value <= 0xffffffffu) {
+        head[0] = (unsigned char)(major << 5 | CBOR_INFO_UINT32);
+        len = 5;
+    } else {
+        head[0] = (unsigned char)(major << 5 | CBOR_INFO_UINT64);
+        len = 9;
+    }
+    if (len > 1) {
+        cbor_put_be(head + 1, value, (int)len - 1);
+    }
+    cbor_put(writer, head, len);
+}
+
+void LITE_cbor_writer_init(lite_cbor_writer_t *writer, unsigned char *buf, size_t size)
+{
+    writer->buf = buf;
+    writer->size = (NULL == buf) ? 0 : size;
+    writer->len = 0;
+    writer->error = 0;
+}
+
+void LITE_cbor_write_uint(lite_cbor_writer_t *writer, uint64_t value)
+{
+    cbor_head(writer, CBOR_MAJOR_UINT, value);
+}
+
+void LITE_cbor_write_int(lite_cbor_writer_t *writer, int64_t value)
+{
+    if (value >= 0) {
+        cbor_head(writer, CBOR_MAJOR_UINT, (uint64_t)value);
+    } else {
+        cbor_head(writer, CBOR_MAJOR_NEGINT, (uint64_t)(-(value + 1)));
+    }
+}
+
+/* half precision bits of a single precision value, 0 if it does not fit exactly, subnormal halves are not used */
+static int cbor_half_of_float(float value, uint16_t *half)
+{
+    uint32_t bits;
+    uint32_t sign;
+    int      exponent;
+    uint32_t mantissa;
+
+    memcpy(&bits, &value, sizeof(bits));
+    sign = (bits >> 16) & 0x8000;
+    exponent = (int)((bits >> 23) & 0xff);
+    mantissa = bits & 0x7fffff;
+
+    if (0 == exponent && 0 == mantissa) {
+        *half = (uint16_t)sign;
+        return 1;
+    }
+    if (0xff == exponent) {
+        *half = (uint16_t)(sign | 0x7c00 | (0 != mantissa ? 0x200 : 0));
+        return 0 == (mantissa & 0x1fff) || 0 != mantissa;
+    }
+
+    exponent -= 127;
+    if (exponent < -14 || exponent > 15 || 0 != (mantissa & 0x1fff)) {
+        return 0;
+    }
+    *half = (uint16_t)(sign | (uint32_t)(exponent + 15) << 10 | mantissa >> 13);
+    return 1;
+}
+
+void LITE_cbor_write_double(lite_cbor_writer_t *writer, double value)
+{
+    unsigned char head[9];
+    float         single = (float)value;
+    uint16_t      half;
+    uint32_t      bits32;
+    uint64_t      bits64;
+
+    if (value != value) {
+        head[0] = CBOR_MAJOR_SIMPLE << 5 | CBOR_INFO_UINT16;
+        cbor_put_be(head + 1, 0x7e00, 2);
+        cbor_put(writer, head, 3);
+    } else if ((double)single == value && cbor_half_of_float(single, &half)) {
+        head[0] = CBOR_MAJOR_SIMPLE << 5 | CBOR_INFO_UINT16;
+        cbor_put_be(head + 1, half, 2);
+        cbor_put(writer, head, 3);
+    } else if ((double)single == value) {
+        memcpy(&bits32, &single, sizeof(bits32));
+        head[0] = CBOR_MAJOR_SIMPLE << 5 | CBOR_INFO_UINT32;
+        cbor_put_be(head + 1, bits32, 4);
+        cbor_put(writer, head, 5);
+    } else {
+        memcpy(&bits64, &value, sizeof(bits64));
+        head[0] = CBOR_MAJOR_SIMPLE << 5 | CBOR_INFO_UINT64;
+        cbor_put_be(head + 1, bits64, 8);
+        cbor_put(writer, head, 9);
+    }
+}
+
+void LITE_cbor_write_bool(lite_cbor_writer_t *writer, int value)
+{
+    cbor_head(writer, CBOR_MAJOR_SIMPLE, value ? LITE_CBOR_SIMPLE_TRUE : LITE_CBOR_SIMPLE_FALSE);
+}
+
+void LITE_cbor_write_null(lite_cbor_writer_t *writer)
+{
+    cbor_head(writer, CBOR_MAJOR_SIMPLE, LITE_CBOR_SIMPLE_NULL);
+}
+
+void LITE_cbor_write_bytes(lite_cbor_writer_t *writer, const void *data, size_t len)
+{
+    cbor_head(writer, CBOR_MAJOR_BYTES, len);
+    cbor_put(writer, data, len);
+}
+
+void LITE_cbor_write_text(lite_cbor_writer_t *writer, const char *text, size_t len)
+{
+    cbor_head(writer, CBOR_MAJOR_TEXT, len);
+    cbor_put(writer, text, len);
+}
+
+void LITE_cbor_write_array(lite_cbor_writer_t *writer, size_t count)
+{
+    cbor_head(writer, CBOR_MAJOR_ARRAY, count);
+}
+
+void LITE_cbor_write_map(lite_cbor_writer_t *writer, size_t count)
+{
+    cbor_head(writer, CBOR_MAJOR_MAP, count);
+}
+
+size_t LITE_cbor_writer_length(const lite_cbor_writer_t *writer)
+{
+    return writer->len;
+}
+
+int LITE_cbor_writer_truncated(const lite_cbor_writer_t *writer)
+{
+    return writer->len > writer->size;
+}
+
+static const char *json_ws(const char *p, const char *end)
+{
+    while (p < end && (' ' == *p || '\t' == *p || '\r' == *p || '\n' == *p)) {
+        p++;
+    }
+    return p;
+}
+
+static int json_hex4(const char *p, const char *end, uint32_t *value)
+{
+    int i;
+    char c;
+
+    if (end - p < 4) {
+        return -1;
+    }
+    *value = 0;
+    for (i = 0; i < 4; i++) {
+        c = p[i];
+        *value <<= 4;
+        if (c >= '0' && c <= '9') {
+            *value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            *value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            *value |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static size_t json_utf8(uint32_t code, unsigned char *out)
+{
+    if (code < 0x80) {
+        out[0] = (unsigned char)code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = (unsigned char)(0xc0 | code >> 6);
+        out[1] = (unsigned char)(0x80 | (code & 0x3f));
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = (unsigned char)(0xe0 | code >> 12);
+        out[1] = (unsigned char)(0x80 | (code >> 6 & 0x3f));
+        out[2] = (unsigned char)(0x80 | (code & 0x3f));
+        return 3;
+    }
+    out[0] = (unsigned char)(0xf0 | code >> 18);
+    out[1] = (unsigned char)(0x80 | (code >> 12 & 0x3f));
+    out[2] = (unsigned char)(0x80 | (code >> 6 & 0x3f));
+    out[3] = (unsigned char)(0x80 | (code & 0x3f));
+    return 4;
+}
+
+/*
+ * unescape the json string at p, which starts with its quote, into writer, or only count the bytes if writer is NULL.
+ * returns the end of the string, NULL when invalid.
+ */
+static const char *json_string_scan(const char *p, const char *end, lite_cbor_writer_t *writer, size_t *len)
+{
+    const char   *run;
+    unsigned char utf8[4];
+    size_t        utf8_len;
+    uint32_t      code;
+    uint32_t      low;
+
+    *len = 0;
+    p++;
+    run = p;
+    while (p < end && '"' != *p) {
+        if ((unsigned char)*p < 0x20) {
+            return NULL;
+        }
+        if ('\\' != *p) {
+            p++;
+            continue;
+        }
+
+        if (NULL != writer) {
+            cbor_put(writer, run, p - run);
+        }
+        *len += p - run;
+
+        if (++p >= end) {
+            return NULL;
+        }
+        utf8_len = 1;
+        switch (*p) {
+            case '"':
+            case '\\':
+            case '/':
+                utf8[0] = *p;
+                break;
+            case 'b':
+                utf8[0] = '\b';
+                break;
+            case 'f':
+                utf8[0] = '\f';
+                break;
+            case 'n':
+                utf8[0] = '\n';
+                break;
+            case 'r':
+                utf8[0] = '\r';
+                break;
+            case 't':
+                utf8[0] = '\t';
+                break;
+            case 'u':
+                if (json_hex4(p + 1, end, &code)) {
+                    return NULL;
+                }
+                p += 4;
+                if (code >= 0xd800 && code <= 0xdbff && end - p > 6 && '\\' == p[1] && 'u' == p[2]
+                    && 0 == json_hex4(p + 3, end, &low) && low >= 0xdc00 && low <= 0xdfff) {
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    p += 6;
+                } else if (code >= 0xd800 && code <= 0xdfff) {
+                    code = 0xfffd; /* lone surrogate */
+                }
+                utf8_len = json_utf8(code, utf8);
+                break;
+            default:
+                return NULL;
+        }
+        if (NULL != writer) {
+            cbor_put(writer, utf8, utf8_len);
+        }
+        *len += utf8_len;
+        run = ++p;
+    }
+
+    if (p >= end) {
+        return NULL;
+    }
+    if (NULL != writer) {
+        cbor_put(writer, run, p - run);
+    }
+    *len += p - run;
+
+    return p + 1;
+}
+
+static const char *json_text(const char *p, const char *end, lite_cbor_writer_t *writer)
+{
+    size_t len;
+
+    if (NULL == json_string_scan(p, end, NULL, &len)) {
+        return NULL;
+    }
+    cbor_head(writer, CBOR_MAJOR_TEXT, len);
+    return json_string_scan(p, end, writer, &len);
+}
+
+static const char *json_number(const char *p, const char *end, lite_cbor_writer_t *writer)
+{
+    char        number[CBOR_JSON_NUMBER_MAXLEN];
+    const char *start = p;
+    char       *number_end = NULL;
+    int         integer = 1;
+    int         negative = 0;
+    uint64_t    value = 0;
+    size_t      len;
+    size_t      i;
+
+    while (p < end && (('0' <= *p && '9' >= *p) || '-' == *p || '+' == *p || '.' == *p || 'e' == *p || 'E' == *p)) {
+        if ('.' == *p || 'e' == *p || 'E' == *p) {
+            integer = 0;
+        }
+        p++;
+    }
+    len = p - start;
+    if (0 == len || len >= sizeof(number)) {
+        return NULL;
+    }
+    memcpy(number, start, len);
+    number[len] = '\0';
+
+    if (integer) {
+        i = 0;
+        if ('-' == number[0]) {
+            negative = 1;
+            i = 1;
+        }
+        if (i == len) {
+            return NULL;
+        }
+        for (; i < len; i++) {
+            if ('0' > number[i] || '9' < number[i]) {
+                return NULL;
+            }
+            if (value > (UINT64_MAX - (number[i] - '0')) / 10) {
+                integer = 0; /* too big, kept as a double */
+                break;
+            }
+            value = value * 10 + (number[i] - '0');
+        }
+    }
+
+    if (integer) {
+        if (negative && 0 != value) {
+            cbor_head(writer, CBOR_MAJOR_NEGINT, value - 1);
+        } else {
+            cbor_head(writer, CBOR_MAJOR_UINT, value);
+        }
+    } else {
+        LITE_cbor_write_double(writer, strtod(number, &number_end));
+        if (number_end != number + len) {
+            return NULL;
+        }
+    }
+
+    return p;
+}
+
+static const char *json_literal(const char *p, const char *end, const char *literal)
+{
+    size_t len = strlen(literal);
+
+    if ((size_t)(end - p) < len || 0 != memcmp(p, literal, len)) {
+        return NULL;
+    }
+    return p + len;
+}
+
+static const char *json_value(const char *p, const char *end, lite_cbor_writer_t *writer, int depth);
+
+/* object members or array items of the container at p, which starts with its bracket. */
+static const char *json_container(const char *p, const char *end, lite_cbor_writer_t *writer, int depth)
+{
+    lite_cbor_writer_t counter;
+    const char        *q;
+    char               close = ('{' == *p) ? '}' : ']';
+    size_t             count = 0;
+    int                pass;
+
+    if (depth >= LITE_CBOR_DEPTH_MAX) {
+        return NULL;
+    }
+
+    /* the first pass counts, members are checked only then */
+    for (pass = 0; pass < 2; pass++) {
+        LITE_cbor_writer_init(&counter, NULL, 0);
+        if (1 == pass) {
+            cbor_head(writer, ('}' == close) ? CBOR_MAJOR_MAP : CBOR_MAJOR_ARRAY, count);
+        }
+
+        q = json_ws(p + 1, end);
+        if (q < end && close == *q) {
+            continue;
+        }
+        while (q < end) {
+            if ('}' == close) {
+                if ('"' != *q) {
+                    return NULL;
+                }
+                q = json_text(q, end, pass ? writer : &counter);
+                if (NULL == q) {
+                    return NULL;
+                }
+                q = json_ws(q, end);
+                if (q >= end || ':' != *q) {
+                    return NULL;
+                }
+                q++;
+            }
+            q = json_value(q, end, pass ? writer : &counter, depth + 1);
+            if (NULL == q) {
+                return NULL;
+            }
+            count += pass ? 0 : 1;
+            q = json_ws(q, end);
+            if (q < end && ',' == *q) {
+                q = json_ws(q + 1, end);
+                continue;
+            }
+            if (q < end && close == *q) {
+                break;
+            }
+            return NULL;
+        }
+        if (q >= end) {
+            return NULL;
+        }
+    }
+
+    return q + 1;
+}
+
+static const char *json_value(const char *p, const char *end, lite_cbor_writer_t *writer, int depth)
+{
+    const char *q;
+
+    p = json_ws(p, end);
+    if (p >= end) {
+        return NULL;
+    }
+
+    switch (*p) {
+        case '{':
+        case '[':
+            return json_container(p, end, writer, depth);
+        case '"':
+            return json_text(p, end, writer);
+        case 't':
+            q = json_literal(p, end, "true");
+            if (q) {
+                LITE_cbor_write_bool(writer, 1);
+            }
+            return q;
+        case 'f':
+            q = json_literal(p, end, "false");
+            if (q) {
+                LITE_cbor_write_bool(writer, 0);
+            }
+            return q;
+        case 'n':
+            q = json_literal(p, end, "null");
+            if (q) {
+                LITE_cbor_write_null(writer);
+            }
+            return q;
+        default:
+            return json_number(p, end, writer);
+    }
+}
+
+int LITE_cbor_write_json(lite_cbor_writer_t *writer, const char *json, size_t len)
+{
+    const char *end = json + len;
+    const char *p;
+
+    if (NULL == json) {
+        writer->error = 1;
+        return -1;
+    }
+
+    p = json_value(json, end, writer, 0);
+    if (NULL == p || json_ws(p, end) != end) {
+        writer->error = 1;
+        return -1;
+    }
+
+    return 0;
+}
+
+void LITE_cbor_reader_init(lite_cbor_reader_t *reader, const unsigned char *buf, size_t size)
+{
+    reader->buf = buf;
+    reader->size = (NULL == buf) ? 0 : size;
+    reader->pos = 0;
+    reader->error = 0;
+}
+
+static double cbor_half_to_double(uint16_t half)
+{
+    int      exponent = (half >> 10) & 0x1f;
+    int      mantissa = half & 0x3ff;
+    double   value;
+
+    if (0x1f == exponent) {
+        value = (0 == mantissa) ? HUGE_VAL : NAN;
+    } else {
+        /* subnormal when exponent is 0, scaled by hand to keep libm out */
+        value = (0 == exponent) ? mantissa : mantissa + 1024;
+        for (exponent = (0 == exponent) ? -24 : exponent - 25; exponent < 0; exponent++) {
+            value /= 2;
+        }
+        for (; exponent > 0; exponent--) {
+            value *= 2;
+        }
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+int LITE_cbor_read(lite_cbor_reader_t *reader, lite_cbor_item_t *item)
+{
+    unsigned char head;
+    int           major;
+    int           info;
+    uint64_t      value = 0;
+    size_t        bytes = 0;
+    size_t        i;
+    uint32_t      bits32;
+    uint64_t      bits64;
+    float         single;
+
+    if (reader->error || reader->pos >= reader->size) {
+        goto err;
+    }
+
+    memset(item, 0x00, sizeof(lite_cbor_item_t));
+    head = reader->buf[reader->pos++];
+    major = head >> 5;
+    info = head & 0x1f;
+
+    if (info < CBOR_INFO_UINT8) {
+        value = info;
+    } else if (info <= CBOR_INFO_UINT64) {
+        bytes = (size_t)1 << (info - CBOR_INFO_UINT8);
+        if (reader->size - reader->pos < bytes) {
+            goto err;
+        }
+        for (i = 0; i < bytes; i++) {
+            value = value << 8 | reader->buf[reader->pos++];
+        }
+    } else if (CBOR_INFO_INDEFINITE == info) {
+        /* indefinite length strings are not supported */
+        if (CBOR_MAJOR_ARRAY != major && CBOR_MAJOR_MAP != major && CBOR_MAJOR_SIMPLE != major) {
+            goto err;
+        }
+        item->indefinite = 1;
+    } else {
+        goto err;
+    }
+
+    item->value = value;
+    switch (major) {
+        case CBOR_MAJOR_UINT:
+            item->type = LITE_CBOR_UINT;
+            break;
+        case CBOR_MAJOR_NEGINT:
+            item->type = LITE_CBOR_NEGINT;
+            break;
+        case CBOR_MAJOR_BYTES:
+        case CBOR_MAJOR_TEXT:
+            item->type = (CBOR_MAJOR_BYTES == major) ? LITE_CBOR_BYTES : LITE_CBOR_TEXT;
+            if (reader->size - reader->pos < value) {
+                goto err;
+            }
+            item->data = reader->buf + reader->pos;
+            reader->pos += (size_t)value;
+            break;
+        case CBOR_MAJOR_ARRAY:
+            item->type = LITE_CBOR_ARRAY;
+            break;
+        case CBOR_MAJOR_MAP:
+            item->type = LITE_CBOR_MAP;
+            break;
+        case CBOR_MAJOR_TAG:
+            item->type = LITE_CBOR_TAG;
+            break;
+        default:
+            if (item->indefinite) {
+                item->type = LITE_CBOR_BREAK;
+                item->indefinite = 0;
+            } else if (CBOR_INFO_UINT16 == info) {
+                item->type = LITE_CBOR_FLOAT;
+                item->number = cbor_half_to_double((uint16_t)value);
+            } else if (CBOR_INFO_UINT32 == info) {
+                item->type = LITE_CBOR_FLOAT;
+                bits32 = (uint32_t)value;
+                memcpy(&single, &bits32, sizeof(single));
+                item->number = single;
+            } else if (CBOR_INFO_UINT64 == info) {
+                item->type = LITE_CBOR_FLOAT;
+                bits64 = value;
+                memcpy(&item->number, &bits64, sizeof(item->number));
+            } else {
+                item->type = LITE_CBOR_SIMPLE;
+            }
+            break;
+    }
+
+    return 0;
+
+err:
+    reader->error = 1;
+    return -1;
+}
+
+/* 0 when an item was skipped, 1 when a break was read, -1 when fail */
+static int cbor_skip(lite_cbor_reader_t *reader, int depth)
+{
+    lite_cbor_item_t item;
+    uint64_t         count;
+    int              ret;
+
+    if (depth > LITE_CBOR_DEPTH_MAX || 0 != LITE_cbor_read(reader, &item)) {
+        reader->error = 1;
+        return -1;
+    }
+
+    switch (item.type) {
+        case LITE_CBOR_ARRAY:
+        case LITE_CBOR_MAP:
+            if (item.indefinite) {
+                do {
+                    ret = cbor_skip(reader, depth + 1);
+                } while (0 == ret);
+                return (1 == ret) ? 0 : -1;
+            }
+            for (count = (LITE_CBOR_MAP == item.type) ? item.value * 2 : item.value; count > 0; count--) {
+                if (0 != cbor_skip(reader, depth + 1)) {
+                    reader->error = 1;
+                    return -1;
+                }
+            }
+            return 0;
+        case LITE_CBOR_TAG:
+            return (0 == cbor_skip(reader, depth + 1)) ? 0 : -1;
+        case LITE_CBOR_BREAK:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int LITE_cbor_skip(lite_cbor_reader_t *reader)
+{
+    if (0 != cbor_skip(reader, 0)) {
+        reader->error = 1;
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    char   *buf;
+    size_t  size;
+    size_t  len;
+} cbor_json_t;
+
+static void cbor_json_put(cbor_json_t *json, const char *data, size_t len)
+{
+    size_t room;
+
+    if (json->size > json->len + 1) {
+        room = json->size - json->len - 1;
+        memcpy(json->buf + json->len, data, LITE_MINIMUM(room, len));
+    }
+    json->len += len;
+}
+
+static void cbor_json_string(cbor_json_t *json, const unsigned char *data, size_t len)
+{
+    char   escape[8];
+    size_t run = 0;
+    size_t i;
+
+    cbor_json_put(json, "\"", 1);
+    for (i = 0; i < len; i++) {
+        if ('"' != data[i] && '\\' != data[i] && data[i] >= 0x20) {
+            continue;
+        }
+        cbor_json_put(json, (const char *)data + run, i - run);
+        if ('"' == data[i] || '\\' == data[i]) {
+            escape[0] = '\\';
+            escape[1] = data[i];
+            cbor_json_put(json, escape, 2);
+        } else {
+            LITE_snprintf(escape, sizeof(escape), "\\u%04x", data[i]);
+            cbor_json_put(json, escape, 6);
+        }
+        run = i + 1;
+    }
+    cbor_json_put(json, (const char *)data + run, len - run);
+    cbor_json_put(json, "\"", 1);
+}
+
+/* base64url without padding, as RFC 8949 maps byte strings to json */
+static void cbor_json_bytes(cbor_json_t *json, const unsigned char *data, size_t len)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    char              out[4];
+    uint32_t          group;
+    size_t            i;
+    size_t            n;
+
+    cbor_json_put(json, "\"", 1);
+    for (i = 0; i < len; i += 3) {
+        n = LITE_MINIMUM(len - i, 3);
+        group = (uint32_t)data[i] << 16;
+        if (n > 1) {
+            group |= (uint32_t)data[i + 1] << 8;
+        }
+        if (n > 2) {
+            group |= data[i + 2];
+        }
+        out[0] = alphabet[group >> 18 & 0x3f];
+        out[1] = alphabet[group >> 12 & 0x3f];
+        out[2] = alphabet[group >> 6 & 0x3f];
+        out[3] = alphabet[group & 0x3f];
+        cbor_json_put(json, out, n + 1);
+    }
+    cbor_json_put(json, "\"", 1);
+}
+
+static void cbor_json_number(cbor_json_t *json, const lite_cbor_item_t *item)
+{
+    char number[32];
+    int  precision;
+    int  len = 0;
+
+    switch (item->type) {
+        case LITE_CBOR_UINT:
+            len = LITE_snprintf(number, sizeof(number), "%llu", (unsigned long long)item->value);
+            break;
+        case LITE_CBOR_NEGINT:
+            if (UINT64_MAX == item->value) {
+                len = LITE_snprintf(number, sizeof(number), "-18446744073709551616");
+            } else {
+                len = LITE_snprintf(number, sizeof(number), "-%llu", (unsigned long long)item->value + 1);
+            }
+            break;
+        default:
+            if (isnan(item->number) || isinf(item->number)) {
+                len = LITE_snprintf(number, sizeof(number), "null");
+                break;
+            }
+            /* the shortest form that reads back the same value */
+            for (precision = 1; precision <= 17; precision++) {
+                len = LITE_snprintf(number, sizeof(number), "%.*g", precision, item->number);
+                if (strtod(number, NULL) == item->number) {
+                    break;
+                }
+            }
+            break;
+    }
+    cbor_json_put(json, number, len);
+}
+
+/* 0 when an item was rendered, 1 when a break was read, -1 when fail */
+static int cbor_json_item(lite_cbor_reader_t *reader, cbor_json_t *json, int depth, int key)
+{
+    lite_cbor_item_t item;
+    uint64_t         index;
+
+    if (depth > LITE_CBOR_DEPTH_MAX || 0 != LITE_cbor_read(reader, &item)) {
+        return -1;
+    }
+
+    if (LITE_CBOR_BREAK == item.type) {
+        return 1;
+    }
+    /* json object keys are strings, integer keys are quoted */
+    if (key) {
+        if (LITE_CBOR_TEXT == item.type) {
+            cbor_json_string(json, item.data, (size_t)item.value);
+        } else if (LITE_CBOR_UINT == item.type || LITE_CBOR_NEGINT == item.type) {
+            cbor_json_put(json, "\"", 1);
+            cbor_json_number(json, &item);
+            cbor_json_put(json, "\"", 1);
+        } else {
+            return -1;
+        }
+        return 0;
+    }
+
+    switch (item.type) {
+        case LITE_CBOR_UINT:
+        case LITE_CBOR_NEGINT:
+        case LITE_CBOR_FLOAT:
+            cbor_json_number(json, &item);
+            break;
+        case LITE_CBOR_BYTES:
+            cbor_json_bytes(json, item.data, (size_t)item.value);
+            break;
+        case LITE_CBOR_TEXT:
+            cbor_json_string(json, item.data, (size_t)item.value);
+            break;
+        case LITE_CBOR_ARRAY:
+        case LITE_CBOR_MAP:
+            cbor_json_put(json, (LITE_CBOR_MAP == item.type) ? "{" : "[", 1);
+            for (index = 0; item.indefinite || index < item.value; index++) {
+                if (item.indefinite && reader->pos < reader->size && 0xff == reader->buf[reader->pos]) {
+                    reader->pos++;
+                    break;
+                }
+                if (index > 0) {
+                    cbor_json_put(json, ",", 1);
+                }
+                if (LITE_CBOR_MAP == item.type) {
+                    if (0 != cbor_json_item(reader, json, depth + 1, 1)) {
+                        return -1;
+                    }
+                    cbor_json_put(json, ":", 1);
+                }
+                if (0 != cbor_json_item(reader, json, depth + 1, 0)) {
+                    return -1;
+                }
+            }
+            cbor_json_put(json, (LITE_CBOR_MAP == item.type) ? "}" : "]", 1);
+            break;
+        case LITE_CBOR_TAG:
+            return (0 == cbor_json_item(reader, json, depth + 1, 0)) ? 0 : -1;
+        default:
+            if (LITE_CBOR_SIMPLE_FALSE == item.value) {
+                cbor_json_put(json, "false", 5);
+            } else if (LITE_CBOR_SIMPLE_TRUE == item.value) {
+                cbor_json_put(json, "true", 4);
+            } else {
+                cbor_json_put(json, "null", 4);
+            }
+            break;
+    }
+
+    return 0;
+}
+
+int LITE_cbor_to_json(const unsigned char *cbor, size_t cbor_len, char *buf, size_t size)
+{
+    lite_cbor_reader_t reader;
+    cbor_json_t        json;
+
+    LITE_cbor_reader_init(&reader, cbor, cbor_len);
+    json.buf = buf;
+    json.size = (NULL == buf) ? 0 : size;
+    json.len = 0;
+
+    if (0 != cbor_json_item(&reader, &json, 0, 0)) {
+        return -1;
+    }
+    if (json.size > 0) {
+        json.buf[LITE_MINIMUM(json.len, json.size - 1)] = '\0';
+    }
+
+    return (int)json.len;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_CBOR_H__
+#define __LITE_CBOR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* RFC 8949 CBOR, definite length items are written, both kinds of arrays and maps are read */
+
+#define LITE_CBOR_DEPTH_MAX     16
+
+typedef enum {
+    LITE_CBOR_UINT = 0,
+    LITE_CBOR_NEGINT,       /* value is -1 - n */
+    LITE_CBOR_BYTES,
+    LITE_CBOR_TEXT,
+    LITE_CBOR_ARRAY,
+    LITE_CBOR_MAP,
+    LITE_CBOR_TAG,          /* the tagged item follows */
+    LITE_CBOR_SIMPLE,       /* false 20, true 21, null 22, undefined 23 */
+    LITE_CBOR_FLOAT,
+    LITE_CBOR_BREAK,        /* end of an indefinite length array or map */
+} lite_cbor_type_t;
+
+#define LITE_CBOR_SIMPLE_FALSE      20
+#define LITE_CBOR_SIMPLE_TRUE       21
+#define LITE_CBOR_SIMPLE_NULL       22
+#define LITE_CBOR_SIMPLE_UNDEFINED  23
+
+/*
+ * append-only writer into a caller buffer, like snprintf it keeps counting once buf is full,
+ * so len tells the size needed, a writer inited with NULL buf only measures.
+ */
+typedef struct {
+    unsigned char  *buf;
+    size_t          size;
+    size_t          len;
+    int             error;  /* sticky, set by an invalid json value */
+} lite_cbor_writer_t;
+
+typedef struct {
+    const unsigned char *buf;
+    size_t               size;
+    size_t               pos;
+    int                  error;  /* sticky, set on malformed or truncated input */
+} lite_cbor_reader_t;
+
+typedef struct {
+    lite_cbor_type_t     type;
+    uint64_t             value;      /* uint, negint n, string length, item count, tag or simple value */
+    double               number;     /* float */
+    const unsigned char *data;       /* bytes and text, they point into the reader buffer */
+    int                  indefinite; /* array or map ended by a break */
+} lite_cbor_item_t;
+
+void    LITE_cbor_writer_init(lite_cbor_writer_t *writer, unsigned char *buf, size_t size);
+void    LITE_cbor_write_uint(lite_cbor_writer_t *writer, uint64_t value);
+void    LITE_cbor_write_int(lite_cbor_writer_t *writer, int64_t value);
+/* the shortest of half, single and double precision that keeps value exact */
+void    LITE_cbor_write_double(lite_cbor_writer_t *writer, double value);
+void    LITE_cbor_write_bool(lite_cbor_writer_t *writer, int value);
+void    LITE_cbor_write_null(lite_cbor_writer_t *writer);
+void    LITE_cbor_write_bytes(lite_cbor_writer_t *writer, const void *data, size_t len);
+void    LITE_cbor_write_text(lite_cbor_writer_t *writer, const char *text, size_t len);
+/* count items, or key value pairs of a map, must follow */
+void    LITE_cbor_write_array(lite_cbor_writer_t *writer, size_t count);
+void    LITE_cbor_write_map(lite_cbor_writer_t *writer, size_t count);
+/* transcode one json value, integers stay integers, -1 and error set when json is invalid */
+int     LITE_cbor_write_json(lite_cbor_writer_t *writer, const char *json, size_t len);
+size_t  LITE_cbor_writer_length(const lite_cbor_writer_t *writer);
+int     LITE_cbor_writer_truncated(const lite_cbor_writer_t *writer);
+
+void    LITE_cbor_reader_init(lite_cbor_reader_t *reader, const unsigned char *buf, size_t size);
+/* read the head of the next item, the content of strings is skipped too. 0 when success, -1 when fail */
+int     LITE_cbor_read(lite_cbor_reader_t *reader, lite_cbor_item_t *item);
+/* skip the next item with everything it contains */
+int     LITE_cbor_skip(lite_cbor_reader_t *reader);
+/* render one cbor item as json into buf, returns json length like snprintf, -1 when cbor is invalid */
+int     LITE_cbor_to_json(const unsigned char *cbor, size_t cbor_len, char *buf, size_t size);
+
+#endif  /* __LITE_CBOR_H__ */
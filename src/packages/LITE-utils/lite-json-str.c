@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__) && defined(__GNUC__)
+    #include <emmintrin.h>
+#endif
+
+#include "lite-json-str.h"
+
+typedef uintptr_t json_str_word_t;
+
+#define JSON_STR_ONES           ((json_str_word_t)-1 / 0xFF)
+#define JSON_STR_HIGHS          (JSON_STR_ONES * 0x80)
+/* non zero when a byte of w is 0, or less than n for n up to 0x80, exact for the word as a whole */
+#define JSON_STR_HAS_ZERO(w)    (((w) - JSON_STR_ONES) & ~(w) & JSON_STR_HIGHS)
+#define JSON_STR_HAS_LESS(w, n) (((w) - JSON_STR_ONES * (n)) & ~(w) & JSON_STR_HIGHS)
+#define JSON_STR_HAS_BYTE(w, c) JSON_STR_HAS_ZERO((w) ^ (JSON_STR_ONES * (c)))
+
+#define JSON_STR_IS_PLAIN(c)    ((c) >= 0x20 && (c) != '"' && (c) != '\\')
+#define JSON_STR_IS_CONT(c)     (((c) & 0xC0) == 0x80)
+
+static json_str_word_t _json_str_load(const unsigned char *p)
+{
+    json_str_word_t     w;
+
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+size_t LITE_json_plain_len(const char *str, size_t len)
+{
+    const unsigned char    *p = (const unsigned char *)str;
+    size_t                  i = 0;
+    json_str_word_t         w;
+
+#if defined(__SSE2__) && defined(__GNUC__)
+    {
+        const __m128i       quote = _mm_set1_epi8('"');
+        const __m128i       backslash = _mm_set1_epi8('\\');
+        const __m128i       control = _mm_set1_epi8(0x1F);
+        __m128i             v;
+        int                 mask;
+
+        for (; i + 16 <= len; i += 16) {
+            v = _mm_loadu_si128((const __m128i *)(p + i));
+            /* unsigned v <= 0x1F where max(v, 0x1F) is 0x1F */
+            mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, control), control),
+                                                  _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash))));
+            if (mask) {
+                return i + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+
+    for (; i + sizeof(w) <= len; i += sizeof(w)) {
+        w = _json_str_load(p + i);
+        if (JSON_STR_HAS_LESS(w, 0x20) || JSON_STR_HAS_BYTE(w, '"') || JSON_STR_HAS_BYTE(w, '\\')) {
+            break;
+        }
+    }
+
+    while (i < len && JSON_STR_IS_PLAIN(p[i])) {
+        i++;
+    }
+
+    return i;
+}
+
+int LITE_utf8_valid(const char *str, size_t len)
+{
+    const unsigned char    *p = (const unsigned char *)str;
+    size_t                  i = 0;
+    unsigned char           c, lo, hi;
+    size_t                  n;
+
+    while (i < len) {
+        /* ASCII words at once */
+        if (i + sizeof(json_str_word_t) <= len && !(_json_str_load(p + i) & JSON_STR_HIGHS)) {
+            i += sizeof(json_str_word_t);
+            continue;
+        }
+
+        c = p[i];
+        lo = 0x80;
+        hi = 0xBF;
+        if (c < 0x80) {
+            i++;
+            continue;
+        } else if (c >= 0xC2 && c <= 0xDF) {
+            n = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            n = 2;
+            if (c == 0xE0) {
+                lo = 0xA0;
+            } else if (c == 0xED) {
+                hi = 0x9F;
+            }
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            n = 3;
+            if (c == 0xF0) {
+                lo = 0x90;
+            } else if (c == 0xF4) {
+                hi = 0x8F;
+            }
+        } else {
+            return 0;
+        }
+
+        if (n >= len - i || p[i + 1] < lo || p[i + 1] > hi) {
+            return 0;
+        }
+        if (n >= 2 && !JSON_STR_IS_CONT(p[i + 2])) {
+            return 0;
+        }
+        if (n == 3 && !JSON_STR_IS_CONT(p[i + 3])) {
+            return 0;
+        }
+        i += n + 1;
+    }
+
+    return 1;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_JSON_STR_H__
+#define __LITE_JSON_STR_H__
+
+#include <stddef.h>
+
+/*
+ * Scans of the strings going into and out of JSON, a machine word or, with SSE2, 16 bytes at a time.
+ * Text is mostly plain ASCII, so the runs between the characters a JSON string escapes are found in
+ * a few steps and copied at once, and valid UTF-8 is told from a byte at a time only past ASCII.
+ */
+
+/* bytes from str on that a JSON string keeps as they are, up to the first '"', '\\' or control character */
+size_t      LITE_json_plain_len(const char *str, size_t len);
+/* 1 when the len bytes of str are valid UTF-8, no overlong forms, surrogates or code points past U+10FFFF */
+int         LITE_utf8_valid(const char *str, size_t len);
+
+#endif  /* __LITE_JSON_STR_H__ */
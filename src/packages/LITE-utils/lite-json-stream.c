@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "lite-utils_internal.h"
+#include "lite-json-stream.h"
+
+enum {
+    JSON_STREAM_VALUE,          /* a value is next */
+    JSON_STREAM_VALUE_OR_END,   /* after '[', a value or ']' */
+    JSON_STREAM_KEY_OR_END,     /* after '{', a key or '}' */
+    JSON_STREAM_KEY_START,      /* after ',' in an object */
+    JSON_STREAM_KEY,
+    JSON_STREAM_KEY_ESCAPE,
+    JSON_STREAM_COLON,
+    JSON_STREAM_STRING,
+    JSON_STREAM_STRING_ESCAPE,
+    JSON_STREAM_LITERAL,        /* a number, true, false or null */
+    JSON_STREAM_AFTER_VALUE,    /* ',' or the end of the container */
+    JSON_STREAM_DONE
+};
+
+#define JSON_STREAM_IS_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+static int json_stream_fail(lite_json_stream_t *stream, const char *reason)
+{
+    stream->path[stream->path_len] = '\0';
+    log_err("json stream %s, at '%s'", reason, stream->path);
+    stream->error = 1;
+    return -1;
+}
+
+static int json_stream_path_put(lite_json_stream_t *stream, char c)
+{
+    if (stream->path_len >= LITE_JSON_STREAM_PATH_MAX) {
+        return json_stream_fail(stream, "path too long");
+    }
+    stream->path[stream->path_len++] = c;
+    return 0;
+}
+
+static void json_stream_callback(lite_json_stream_t *stream, char *value, int value_len, int value_type)
+{
+    stream->path[stream->path_len] = '\0';
+    if (JSON_PARSE_FINISH == stream->callback(stream->path, stream->path_len, value, value_len, value_type,
+                                              stream->callback_data)) {
+        stream->finished = 1;
+    }
+}
+
+/* an object or array opens or closes, named by its own path */
+static void json_stream_container(lite_json_stream_t *stream, char c)
+{
+    char        mark[2];
+
+    if (!(stream->flags & LITE_JSON_STREAM_CONTAINERS) || stream->finished) {
+        return;
+    }
+    mark[0] = c;
+    mark[1] = '\0';
+    json_stream_callback(stream, mark, 1, (c == '{' || c == '}') ? JOBJECT : JARRAY);
+}
+
+static int json_stream_value_put(lite_json_stream_t *stream, char c)
+{
+    if (stream->value_len >= stream->value_size - 1) {
+        if (!(stream->flags & LITE_JSON_STREAM_PIECES) || stream->value_type != JSTRING || stream->value_len == 0) {
+            return json_stream_fail(stream, "value too long");
+        }
+        /* the buffer is full, what it holds goes first */
+        stream->value[stream->value_len] = '\0';
+        json_stream_callback(stream, stream->value, stream->value_len, LITE_JSON_STREAM_PIECE);
+        stream->value_len = 0;
+    }
+    stream->value[stream->value_len++] = c;
+    return 0;
+}
+
+/* the path of the element being read, "<path of the array>[<index>]" */
+static int json_stream_element(lite_json_stream_t *stream)
+{
+    lite_json_stream_level_t   *level = &stream->level[stream->depth - 1];
+    char                        index[16];
+    int                         len, i;
+
+    len = LITE_snprintf(index, sizeof(index), "[%d]", level->index);
+    stream->path_len = level->path_len;
+    for (i = 0; i < len; i++) {
+        if (json_stream_path_put(stream, index[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* the path of the member whose key starts, "<path of the object>.<key>" */
+static int json_stream_key(lite_json_stream_t *stream)
+{
+    stream->path_len = stream->level[stream->depth - 1].path_len;
+    if (stream->path_len > 0 && json_stream_path_put(stream, '.') != 0) {
+        return -1;
+    }
+    stream->state = JSON_STREAM_KEY;
+    return 0;
+}
+
+static int json_stream_push(lite_json_stream_t *stream, char type)
+{
+    lite_json_stream_level_t   *level;
+
+    if (stream->depth >= LITE_JSON_STREAM_DEPTH_MAX) {
+        return json_stream_fail(stream, "nested too deep");
+    }
+    level = &stream->level[stream->depth++];
+    level->type = type;
+    level->index = 0;
+    level->path_len = stream->path_len;
+    json_stream_container(stream, type);
+
+    if (type == '[') {
+        stream->state = JSON_STREAM_VALUE_OR_END;
+        return json_stream_element(stream);
+    }
+    stream->state = JSON_STREAM_KEY_OR_END;
+    return 0;
+}
+
+static void json_stream_after_value(lite_json_stream_t *stream)
+{
+    stream->state = (stream->depth == 0) ? JSON_STREAM_DONE : JSON_STREAM_AFTER_VALUE;
+}
+
+static int json_stream_pop(lite_json_stream_t *stream, char type)
+{
+    if (stream->depth == 0 || stream->level[stream->depth - 1].type != type) {
+        return json_stream_fail(stream, "unbalanced");
+    }
+    stream->path_len = stream->level[--stream->depth].path_len;
+    json_stream_container(stream, (type == '{') ? '}' : ']');
+    json_stream_after_value(stream);
+    return 0;
+}
+
+static int json_stream_emit(lite_json_stream_t *stream)
+{
+    stream->value[stream->value_len] = '\0';
+    json_stream_callback(stream, stream->value, stream->value_len, stream->value_type);
+    json_stream_after_value(stream);
+    return 0;
+}
+
+static int json_stream_literal_end(lite_json_stream_t *stream)
+{
+    const char *value = stream->value;
+    int         i;
+
+    stream->value[stream->value_len] = '\0';
+    switch (stream->value_type) {
+        case JBOOLEAN:
+            if (strcmp(value, "true") != 0 && strcmp(value, "false") != 0) {
+                return json_stream_fail(stream, "bad literal");
+            }
+            break;
+        case JNONE:
+            if (strcmp(value, "null") != 0) {
+                return json_stream_fail(stream, "bad literal");
+            }
+            break;
+        default:
+            for (i = 0; i < stream->value_len; i++) {
+                if (NULL == strchr("0123456789+-.eE", value[i])) {
+                    return json_stream_fail(stream, "bad number");
+                }
+            }
+            break;
+    }
+    return json_stream_emit(stream);
+}
+
+static int json_stream_value(lite_json_stream_t *stream, char c)
+{
+    stream->value_len = 0;
+    switch (c) {
+        case '{':
+        case '[':
+            return json_stream_push(stream, c);
+        case '"':
+            stream->value_type = JSTRING;
+            stream->state = JSON_STREAM_STRING;
+            return 0;
+        case 't':
+        case 'f':
+            stream->value_type = JBOOLEAN;
+            break;
+        case 'n':
+            stream->value_type = JNONE;
+            break;
+        default:
+            if (c != '-' && (c < '0' || c > '9')) {
+                return json_stream_fail(stream, "bad value");
+            }
+            stream->value_type = JNUMBER;
+            break;
+    }
+    stream->state = JSON_STREAM_LITERAL;
+    return json_stream_value_put(stream, c);
+}
+
+void LITE_json_stream_init(lite_json_stream_t *stream, char *buf, int size, json_parse_cb callback, void *data)
+{
+    memset(stream, 0, sizeof(lite_json_stream_t));
+    stream->state = JSON_STREAM_VALUE;
+    stream->value = buf;
+    stream->value_size = size;
+    stream->callback = callback;
+    stream->callback_data = data;
+}
+
+void LITE_json_stream_set_flags(lite_json_stream_t *stream, int flags)
+{
+    stream->flags = flags;
+}
+
+int LITE_json_stream_feed(lite_json_stream_t *stream, const char *data, int len)
+{
+    int     i = 0;
+    char    c;
+
+    if (stream->error) {
+        return -1;
+    }
+
+    while (i < len && !stream->finished) {
+        c = data[i];
+
+        switch (stream->state) {
+            case JSON_STREAM_VALUE_OR_END:
+                if (c == ']') {
+                    if (json_stream_pop(stream, '[') != 0) {
+                        return -1;
+                    }
+                    break;
+                }
+            /* fall through */
+            case JSON_STREAM_VALUE:
+                if (!JSON_STREAM_IS_SPACE(c) && json_stream_value(stream, c) != 0) {
+                    return -1;
+                }
+                break;
+            case JSON_STREAM_KEY_OR_END:
+                if (c == '}') {
+                    if (json_stream_pop(stream, '{') != 0) {
+                        return -1;
+                    }
+                    break;
+                }
+            /* fall through */
+            case JSON_STREAM_KEY_START:
+                if (JSON_STREAM_IS_SPACE(c)) {
+                    break;
+                }
+                if (c != '"') {
+                    return json_stream_fail(stream, "bad key");
+                }
+                if (json_stream_key(stream) != 0) {
+                    return -1;
+                }
+                break;
+            case JSON_STREAM_KEY:
+                if (c == '"') {
+                    stream->state = JSON_STREAM_COLON;
+                    break;
+                }
+                if (c == '\\') {
+                    stream->state = JSON_STREAM_KEY_ESCAPE;
+                }
+                if (json_stream_path_put(stream, c) != 0) {
+                    return -1;
+                }
+                break;
+            case JSON_STREAM_KEY_ESCAPE:
+                stream->state = JSON_STREAM_KEY;
+                if (json_stream_path_put(stream, c) != 0) {
+                    return -1;
+                }
+                break;
+            case JSON_STREAM_COLON:
+                if (JSON_STREAM_IS_SPACE(c)) {
+                    break;
+                }
+                if (c != ':') {
+                    return json_stream_fail(stream, "no colon");
+                }
+                stream->state = JSON_STREAM_VALUE;
+                break;
+            case JSON_STREAM_STRING:
+                if (c == '"') {
+                    json_stream_emit(stream);
+                    break;
+                }
+                if (c == '\\') {
+                    stream->state = JSON_STREAM_STRING_ESCAPE;
+                }
+                if (json_stream_value_put(stream, c) != 0) {
+                    return -1;
+                }
+                break;
+            case JSON_STREAM_STRING_ESCAPE:
+                stream->state = JSON_STREAM_STRING;
+                if (json_stream_value_put(stream, c) != 0) {
+                    return -1;
+                }
+                break;
+            case JSON_STREAM_LITERAL:
+                if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                    || c == '+' || c == '-' || c == '.') {
+                    if (json_stream_value_put(stream, c) != 0) {
+                        return -1;
+                    }
+                    break;
+                }
+                if (json_stream_literal_end(stream) != 0) {
+                    return -1;
+                }
+                /* the character after the literal is read again */
+                continue;
+            case JSON_STREAM_AFTER_VALUE:
+                if (JSON_STREAM_IS_SPACE(c)) {
+                    break;
+                }
+                if (c == '}' || c == ']') {
+                    if (json_stream_pop(stream, (c == '}') ? '{' : '[') != 0) {
+                        return -1;
+                    }
+                    break;
+                }
+                if (c != ',') {
+                    return json_stream_fail(stream, "no comma");
+                }
+                if (stream->level[stream->depth - 1].type == '{') {
+                    stream->state = JSON_STREAM_KEY_START;
+                    break;
+                }
+                stream->level[stream->depth - 1].index++;
+                stream->state = JSON_STREAM_VALUE;
+                if (json_stream_element(stream) != 0) {
+                    return -1;
+                }
+                break;
+            default:
+                if (!JSON_STREAM_IS_SPACE(c)) {
+                    return json_stream_fail(stream, "data after the end");
+                }
+                break;
+        }
+        i++;
+    }
+
+    return 0;
+}
+
+int LITE_json_stream_finish(lite_json_stream_t *stream)
+{
+    if (stream->error) {
+        return -1;
+    }
+    if (stream->finished) {
+        return 0;
+    }
+    if (stream->state == JSON_STREAM_LITERAL && stream->depth == 0 && json_stream_literal_end(stream) != 0) {
+        return -1;
+    }
+    if (stream->state != JSON_STREAM_DONE) {
+        return json_stream_fail(stream, "truncated");
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_JSON_STREAM_H__
+#define __LITE_JSON_STREAM_H__
+
+#include "json_parser.h"
+
+/*
+ * Incremental json tokenizer, fed piece by piece as a document arrives. Each string, number, boolean
+ * and null is handed to a json_parse_cb as soon as it ends, named by its path from the top, like
+ * "servers[1].host", with the value type of json_parser (JSTRING, JNUMBER, JBOOLEAN, JNONE for null).
+ * Strings are handed on as they are written, without the quotes and with their escapes. Only the path
+ * and the value being read are kept, the buffer of the caller bounds the longest value.
+ */
+
+#define LITE_JSON_STREAM_DEPTH_MAX      16
+#define LITE_JSON_STREAM_PATH_MAX       128
+
+/* flags of LITE_json_stream_set_flags(), none by default */
+/* objects and arrays are handed on as JOBJECT or JARRAY when they open, with "{" or "[", and close, with "}" or "]" */
+#define LITE_JSON_STREAM_CONTAINERS     0x1
+/* a string longer than the buffer is handed on in pieces of LITE_JSON_STREAM_PIECE, its last piece as JSTRING */
+#define LITE_JSON_STREAM_PIECES         0x2
+
+#define LITE_JSON_STREAM_PIECE          (JTYPEMAX + 1)
+
+typedef struct {
+    char            type;       /* '{' or '[' */
+    int             index;      /* of the element being read, in an array */
+    int             path_len;   /* of the path of the container */
+} lite_json_stream_level_t;
+
+typedef struct {
+    int                         state;
+    int                         error;      /* sticky, set on malformed json or a value or path too long */
+    int                         finished;   /* the callback returned JSON_PARSE_FINISH */
+    int                         depth;
+    lite_json_stream_level_t    level[LITE_JSON_STREAM_DEPTH_MAX];
+    char                        path[LITE_JSON_STREAM_PATH_MAX + 1];
+    int                         path_len;
+    char                       *value;
+    int                         value_size;
+    int                         value_len;
+    int                         value_type;
+    json_parse_cb               callback;
+    void                       *callback_data;
+    int                         flags;
+} lite_json_stream_t;
+
+/* buf holds the value being read, a value needs size - 1 bytes at most */
+void    LITE_json_stream_init(lite_json_stream_t *stream, char *buf, int size, json_parse_cb callback, void *data);
+/* LITE_JSON_STREAM_CONTAINERS and LITE_JSON_STREAM_PIECES, before the first piece is fed */
+void    LITE_json_stream_set_flags(lite_json_stream_t *stream, int flags);
+/* 0 when the piece is parsed, -1 when the json is invalid */
+int     LITE_json_stream_feed(lite_json_stream_t *stream, const char *data, int len);
+/* 0 when one whole json value has been fed, with nothing but spaces after it */
+int     LITE_json_stream_finish(lite_json_stream_t *stream);
+
+#endif  /* __LITE_JSON_STREAM_H__ */
@@ -0,0 +1,547 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "lite-utils_internal.h"
+#include "lite-log-ring.h"
+
+#if WITH_LOG_RING
+
+#define LOG_RING_ARGS_MAX       16
+#define LOG_RING_CONV_MAX       16
+
+typedef enum {
+    LOG_ARG_INT = 0,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+} log_arg_type_t;
+
+typedef union {
+    long long           i;
+    double              d;
+    const void         *p;
+    int                 len;        /* of the copy of a string, the copies follow the arguments in order */
+} log_ring_arg_t;
+
+typedef struct {
+    const char         *func;
+    const char         *fmt;
+    int                 line;
+    unsigned short      len;        /* of the record with its header, 0 pads up to the end of the ring */
+    unsigned char       level;
+    unsigned char       argc;
+} log_ring_hdr_t;
+
+/* a conversion of a format, what follows its '%' */
+typedef struct {
+    int                 stars;      /* width and precision given by int arguments before the value */
+    int                 precision_star;
+    int                 precision;  /* -1 when not given in the format */
+    int                 type;       /* log_arg_type_t, -1 for what is not kept, as %n and long double */
+    const char         *end;        /* past the conversion */
+} log_ring_spec_t;
+
+#define LOG_RING_ROUND_UP(n)    (((n) + sizeof(log_ring_arg_t) - 1) / sizeof(log_ring_arg_t) * sizeof(log_ring_arg_t))
+#define LOG_RING_HDR_LEN        ((int)LOG_RING_ROUND_UP(sizeof(log_ring_hdr_t)))
+#define LOG_RING_BYTES          ((int)sizeof(log_ring_buf))
+
+static log_ring_arg_t log_ring_buf[LITE_LOG_RING_SIZE / sizeof(log_ring_arg_t)];
+static int log_ring_head;
+static int log_ring_tail;
+static int log_ring_used;
+static int log_ring_started;
+static int log_ring_draining;
+static int log_ring_dropped;
+static int log_ring_reported;
+static void *log_ring_lock;
+#if WITH_LOG_RING_THREAD
+static int log_ring_running;
+static void *log_ring_sem;
+#endif
+
+static void _log_ring_lock(void)
+{
+    /* started before other threads are */
+    if (!log_ring_lock) {
+        log_ring_lock = HAL_MutexCreate();
+    }
+    if (log_ring_lock) {
+        HAL_MutexLock(log_ring_lock);
+    }
+}
+
+static void _log_ring_unlock(void)
+{
+    if (log_ring_lock) {
+        HAL_MutexUnlock(log_ring_lock);
+    }
+}
+
+static void _log_ring_spec(const char *p, log_ring_spec_t *spec)
+{
+    int         length = 0;
+
+    spec->stars = 0;
+    spec->precision_star = 0;
+    spec->precision = -1;
+    spec->type = -1;
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        p++;
+    }
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            spec->precision_star = 1;
+            p++;
+        } else {
+            for (spec->precision = 0; *p >= '0' && *p <= '9'; p++) {
+                spec->precision = spec->precision * 10 + (*p - '0');
+            }
+        }
+    }
+    for (;; p++) {
+        if (*p == 'l') {
+            length++;
+        } else if (*p == 'j') {
+            length = 2;
+        } else if (*p == 'z' || *p == 't') {
+            length = 3;
+        } else if (*p != 'h') {
+            break;
+        }
+    }
+
+    switch (*p) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            spec->type = length == 0 ? LOG_ARG_INT : (length == 1 ? LOG_ARG_LONG : (length == 2 ? LOG_ARG_LLONG : LOG_ARG_SIZE));
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec->type = length <= 1 ? LOG_ARG_DOUBLE : -1;
+            break;
+        case 's':
+            spec->type = length == 0 ? LOG_ARG_STR : -1;
+            break;
+        case 'p':
+            spec->type = LOG_ARG_PTR;
+            break;
+        default:
+            break;
+    }
+    spec->end = *p ? p + 1 : p;
+}
+
+/* room for len bytes in one piece, the offset of it, -1 when the ring is full */
+static int _log_ring_reserve(int len)
+{
+    log_ring_hdr_t *pad;
+    int             pos;
+
+    if (log_ring_tail + len > LOG_RING_BYTES) {
+        if (log_ring_used + (LOG_RING_BYTES - log_ring_tail) + len > LOG_RING_BYTES) {
+            return -1;
+        }
+        if (LOG_RING_BYTES - log_ring_tail >= LOG_RING_HDR_LEN) {
+            pad = (log_ring_hdr_t *)((char *)log_ring_buf + log_ring_tail);
+            pad->len = 0;
+        }
+        log_ring_used += LOG_RING_BYTES - log_ring_tail;
+        log_ring_tail = 0;
+    } else if (log_ring_used + len > LOG_RING_BYTES) {
+        return -1;
+    }
+
+    pos = log_ring_tail;
+    log_ring_tail += len;
+    log_ring_used += len;
+
+    return pos;
+}
+
+int LITE_log_ring_put(const char *func, const int line, const int level, const char *fmt, va_list *params)
+{
+    log_ring_arg_t  args[LOG_RING_ARGS_MAX];
+    const char     *strs[LOG_RING_ARGS_MAX];
+    log_ring_spec_t spec;
+    log_ring_hdr_t *hdr;
+    const char     *p;
+    char           *dst;
+    va_list         ap;
+    int             argc = 0;
+    int             bytes = 0;
+    int             limit;
+    int             len;
+    int             pos;
+    int             wake;
+    int             i;
+
+    if (!log_ring_started) {
+        return -1;
+    }
+    if (level > LITE_get_loglevel()) {
+        return 0;
+    }
+
+    /* the arguments in the order of the format, the caller formats what is not kept now */
+    va_copy(ap, *params);
+    for (p = fmt; (p = strchr(p, '%')) != NULL; p = spec.end) {
+        if (p[1] == '%') {
+            spec.end = p + 2;
+            continue;
+        }
+        _log_ring_spec(p + 1, &spec);
+        if (spec.type < 0 || spec.end - p >= LOG_RING_CONV_MAX || argc + spec.stars >= LOG_RING_ARGS_MAX) {
+            va_end(ap);
+            return -1;
+        }
+
+        for (i = 0; i < spec.stars; i++) {
+            strs[argc] = NULL;
+            args[argc++].i = va_arg(ap, int);
+        }
+        strs[argc] = NULL;
+        switch (spec.type) {
+            case LOG_ARG_INT:
+                args[argc].i = va_arg(ap, int);
+                break;
+            case LOG_ARG_LONG:
+                args[argc].i = va_arg(ap, long);
+                break;
+            case LOG_ARG_LLONG:
+                args[argc].i = va_arg(ap, long long);
+                break;
+            case LOG_ARG_SIZE:
+                args[argc].i = (long long)va_arg(ap, size_t);
+                break;
+            case LOG_ARG_DOUBLE:
+                args[argc].d = va_arg(ap, double);
+                break;
+            case LOG_ARG_PTR:
+                args[argc].p = va_arg(ap, void *);
+                break;
+            default:
+                /* what a precision leaves out of a string may not even be there */
+                strs[argc] = va_arg(ap, const char *);
+                if (!strs[argc]) {
+                    strs[argc] = "(null)";
+                }
+                limit = spec.precision_star ? (int)args[argc - 1].i : spec.precision;
+                if (limit < 0 || limit > LITE_LOG_RING_STRING_MAX) {
+                    limit = LITE_LOG_RING_STRING_MAX;
+                }
+                for (len = 0; len < limit && strs[argc][len] != '\0'; len++);
+                args[argc].len = len;
+                bytes += len + 1;
+                break;
+        }
+        argc++;
+    }
+    va_end(ap);
+
+    len = LOG_RING_HDR_LEN + argc * sizeof(log_ring_arg_t) + LOG_RING_ROUND_UP(bytes);
+
+    _log_ring_lock();
+    wake = (log_ring_used == 0);
+    pos = len <= LOG_RING_BYTES ? _log_ring_reserve(len) : -1;
+    if (pos < 0) {
+        log_ring_dropped += 1;
+        _log_ring_unlock();
+        return 0;
+    }
+
+    hdr = (log_ring_hdr_t *)((char *)log_ring_buf + pos);
+    hdr->func = func;
+    hdr->fmt = fmt;
+    hdr->line = line;
+    hdr->len = (unsigned short)len;
+    hdr->level = (unsigned char)level;
+    hdr->argc = (unsigned char)argc;
+    memcpy((char *)hdr + LOG_RING_HDR_LEN, args, argc * sizeof(log_ring_arg_t));
+    dst = (char *)hdr + LOG_RING_HDR_LEN + argc * sizeof(log_ring_arg_t);
+    for (i = 0; i < argc; i++) {
+        if (strs[i]) {
+            memcpy(dst, strs[i], args[i].len);
+            dst[args[i].len] = '\0';
+            dst += args[i].len + 1;
+        }
+    }
+    _log_ring_unlock();
+
+#if WITH_LOG_RING_THREAD
+    if (wake && log_ring_sem) {
+        HAL_SemaphorePost(log_ring_sem);
+    }
+#endif
+
+    return 0;
+}
+
+#define LOG_RING_SNPRINTF(value) \
+    (spec->stars == 0 ? HAL_Snprintf(out, size, conv, value) : \
+     (spec->stars == 1 ? HAL_Snprintf(out, size, conv, stars[0], value) : \
+      HAL_Snprintf(out, size, conv, stars[0], stars[1], value)))
+
+static int _log_ring_conv(char *out, int size, const char *conv, const log_ring_spec_t *spec, const int *stars,
+                          const log_ring_arg_t *arg, const char **str)
+{
+    const char *s;
+
+    switch (spec->type) {
+        case LOG_ARG_INT:
+            return LOG_RING_SNPRINTF((int)arg->i);
+        case LOG_ARG_LONG:
+            return LOG_RING_SNPRINTF((long)arg->i);
+        case LOG_ARG_LLONG:
+            return LOG_RING_SNPRINTF(arg->i);
+        case LOG_ARG_SIZE:
+            return LOG_RING_SNPRINTF((size_t)arg->i);
+        case LOG_ARG_DOUBLE:
+            return LOG_RING_SNPRINTF(arg->d);
+        case LOG_ARG_PTR:
+            return LOG_RING_SNPRINTF(arg->p);
+        default:
+            s = *str;
+            *str += arg->len + 1;
+            return LOG_RING_SNPRINTF(s);
+    }
+}
+
+/* one conversion at a time, each with the argument it was given */
+static void _log_ring_format(const log_ring_hdr_t *hdr, char *out, int size)
+{
+    const log_ring_arg_t   *args = (const log_ring_arg_t *)((const char *)hdr + LOG_RING_HDR_LEN);
+    const char             *str = (const char *)(args + hdr->argc);
+    const char             *p = hdr->fmt;
+    log_ring_spec_t         spec;
+    char                    conv[LOG_RING_CONV_MAX];
+    int                     stars[2];
+    int                     argc = 0;
+    int                     len = 0;
+    int                     n;
+    int                     i;
+
+    while (*p && len < size - 1) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        _log_ring_spec(p + 1, &spec);
+        memcpy(conv, p, spec.end - p);
+        conv[spec.end - p] = '\0';
+        for (i = 0; i < spec.stars; i++) {
+            stars[i] = (int)args[argc++].i;
+        }
+        n = _log_ring_conv(out + len, size - len, conv, &spec, stars, &args[argc++], &str);
+        if (n < 0 || n >= size - len) {
+            len = n < 0 ? len : size - 1;
+            break;
+        }
+        len += n;
+        p = spec.end;
+    }
+    out[len] = '\0';
+}
+
+int LITE_log_ring_drain(int max)
+{
+    log_ring_hdr_t *hdr;
+    char            line[LITE_LOG_RING_LINE_MAX];
+    int             dropped;
+    int             count = 0;
+
+    /* one drain at a time, the lines stay in order */
+    _log_ring_lock();
+    if (log_ring_draining) {
+        _log_ring_unlock();
+        return 0;
+    }
+    log_ring_draining = 1;
+    _log_ring_unlock();
+
+    while (max == 0 || count < max) {
+        _log_ring_lock();
+        if (log_ring_used == 0) {
+            log_ring_head = log_ring_tail = 0;
+            _log_ring_unlock();
+            break;
+        }
+        hdr = (log_ring_hdr_t *)((char *)log_ring_buf + log_ring_head);
+        if (LOG_RING_BYTES - log_ring_head < LOG_RING_HDR_LEN || hdr->len == 0) {
+            log_ring_used -= LOG_RING_BYTES - log_ring_head;
+            log_ring_head = 0;
+            _log_ring_unlock();
+            continue;
+        }
+        _log_ring_unlock();
+
+        /* the record is left alone by those putting lines until it is given back */
+        _log_ring_format(hdr, line, sizeof(line));
+        LITE_syslog(hdr->func, hdr->line, hdr->level, "%s", line);
+        count++;
+
+        _log_ring_lock();
+        log_ring_head += hdr->len;
+        log_ring_used -= hdr->len;
+        _log_ring_unlock();
+    }
+
+    _log_ring_lock();
+    dropped = log_ring_dropped - log_ring_reported;
+    log_ring_reported = log_ring_dropped;
+    log_ring_draining = 0;
+    _log_ring_unlock();
+
+    if (dropped) {
+        log_warning("%d log lines dropped, the ring was full", dropped);
+    }
+
+    return count;
+}
+
+int LITE_log_ring_dropped(void)
+{
+    return log_ring_dropped;
+}
+
+#if WITH_LOG_RING_THREAD
+static void *_log_ring_routine(void *arg)
+{
+    while (log_ring_running) {
+        HAL_SemaphoreWait(log_ring_sem, 100);
+        LITE_log_ring_drain(0);
+    }
+
+    return NULL;
+}
+#endif
+
+int LITE_log_ring_start(void)
+{
+#if WITH_LOG_RING_THREAD
+    hal_os_thread_param_t   param;
+    void                   *thread;
+#endif
+
+    _log_ring_lock();
+    if (log_ring_started) {
+        _log_ring_unlock();
+        return 0;
+    }
+    _log_ring_unlock();
+
+#if WITH_LOG_RING_THREAD
+    if (!log_ring_sem) {
+        log_ring_sem = HAL_SemaphoreCreate();
+        if (!log_ring_sem) {
+            return -1;
+        }
+    }
+
+    log_ring_running = 1;
+    memset(&param, 0, sizeof(param));
+    param.stack_size = LITE_LOG_RING_STACK_SIZE;
+    param.name = "log_ring";
+    if (0 != HAL_ThreadCreate(&thread, _log_ring_routine, NULL, &param, NULL)) {
+        log_ring_running = 0;
+        log_err("create thread log_ring failed");
+        return -1;
+    }
+    HAL_ThreadDetach(thread);
+#endif
+
+    log_ring_started = 1;
+    return 0;
+}
+
+void LITE_log_ring_stop(void)
+{
+    log_ring_started = 0;
+
+#if WITH_LOG_RING_THREAD
+    log_ring_running = 0;
+    if (log_ring_sem) {
+        HAL_SemaphorePost(log_ring_sem);
+    }
+#endif
+
+    /* the thread may be draining the last lines itself */
+    while (log_ring_used) {
+        if (0 == LITE_log_ring_drain(0)) {
+            HAL_SleepMs(10);
+        }
+    }
+}
+
+#else
+
+int LITE_log_ring_start(void)
+{
+    return -1;
+}
+
+void LITE_log_ring_stop(void)
+{
+}
+
+int LITE_log_ring_put(const char *func, const int line, const int level, const char *fmt, va_list *params)
+{
+    return -1;
+}
+
+int LITE_log_ring_drain(int max)
+{
+    return 0;
+}
+
+int LITE_log_ring_dropped(void)
+{
+    return 0;
+}
+
+#endif  /* #if WITH_LOG_RING */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_LOG_RING_H__
+#define __LITE_LOG_RING_H__
+
+#include <stdarg.h>
+
+#include "lite-utils_config.h"
+
+/*
+ * With WITH_LOG_RING, a log line is put in a ring of LITE_LOG_RING_SIZE bytes as the pointer to its
+ * format, its arguments and copies of its strings, nothing is formatted on the thread logging. The
+ * lines are formatted and handed to LITE_syslog() by LITE_log_ring_drain(), from the thread of
+ * LITE_log_ring_start() or from the idle loop where there is no thread for it. The format and the
+ * function name have to live as long as the ring, as literals do. A line the full ring has no room
+ * for is dropped and counted.
+ */
+
+/* the drain thread too with WITH_LOG_RING_THREAD, 0 when lines go to the ring from now on */
+int     LITE_log_ring_start(void);
+/* what is left is drained, lines go to LITE_syslog_routine() again */
+void    LITE_log_ring_stop(void);
+/* 0 when the line is in the ring or dropped, -1 when the ring is not started */
+int     LITE_log_ring_put(const char *func, const int line, const int level, const char *fmt, va_list *params);
+/* at most max lines, all of them for 0, the number drained */
+int     LITE_log_ring_drain(int max);
+int     LITE_log_ring_dropped(void);
+
+#endif  /* __LITE_LOG_RING_H__ */
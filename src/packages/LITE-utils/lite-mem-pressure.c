@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "lite-utils_internal.h"
+#include "lite-mem-pressure.h"
+#include "lite-slab.h"
+
+typedef struct {
+    lite_mem_pressure_fpt   handler;
+    void                   *ctx;
+} mem_pressure_handler_t;
+
+static int mem_pressure_watermarks[LITE_MEM_PRESSURE_CRITICAL] = { LITE_MEM_PRESSURE_HIGH_BYTES, LITE_MEM_PRESSURE_CRITICAL_BYTES };
+static volatile int mem_pressure_counted;
+static volatile int mem_pressure_set;
+static int mem_pressure_notified;
+static mem_pressure_handler_t mem_pressure_handlers[LITE_MEM_PRESSURE_HANDLERS_MAX];
+static void *mem_pressure_lock;
+
+static void _mem_pressure_lock(void)
+{
+    /* the first handler is registered before other threads are started */
+    if (NULL == mem_pressure_lock) {
+        mem_pressure_lock = HAL_MutexCreate();
+    }
+    if (mem_pressure_lock) {
+        HAL_MutexLock(mem_pressure_lock);
+    }
+}
+
+static void _mem_pressure_unlock(void)
+{
+    if (mem_pressure_lock) {
+        HAL_MutexUnlock(mem_pressure_lock);
+    }
+}
+
+void LITE_mem_pressure_set_watermarks(int high, int critical)
+{
+    mem_pressure_watermarks[LITE_MEM_PRESSURE_HIGH - 1] = high;
+    mem_pressure_watermarks[LITE_MEM_PRESSURE_CRITICAL - 1] = critical;
+    LITE_mem_pressure_count(LITE_get_malloc_bytes_in_use());
+}
+
+int LITE_mem_pressure_register(lite_mem_pressure_fpt handler, void *ctx)
+{
+    int i, slot = -1;
+
+    if (!handler) {
+        return -1;
+    }
+
+    _mem_pressure_lock();
+    for (i = 0; i < LITE_MEM_PRESSURE_HANDLERS_MAX; i++) {
+        if (mem_pressure_handlers[i].handler == handler && mem_pressure_handlers[i].ctx == ctx) {
+            _mem_pressure_unlock();
+            return 0;
+        }
+        if (slot < 0 && !mem_pressure_handlers[i].handler) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        mem_pressure_handlers[slot].handler = handler;
+        mem_pressure_handlers[slot].ctx = ctx;
+    }
+    _mem_pressure_unlock();
+
+    if (slot < 0) {
+        log_err("no room for memory pressure handler, LITE_MEM_PRESSURE_HANDLERS_MAX is %d", LITE_MEM_PRESSURE_HANDLERS_MAX);
+        return -1;
+    }
+    return 0;
+}
+
+void LITE_mem_pressure_unregister(lite_mem_pressure_fpt handler, void *ctx)
+{
+    int i;
+
+    _mem_pressure_lock();
+    for (i = 0; i < LITE_MEM_PRESSURE_HANDLERS_MAX; i++) {
+        if (mem_pressure_handlers[i].handler == handler && mem_pressure_handlers[i].ctx == ctx) {
+            mem_pressure_handlers[i].handler = NULL;
+            mem_pressure_handlers[i].ctx = NULL;
+        }
+    }
+    _mem_pressure_unlock();
+}
+
+int LITE_mem_pressure_level(void)
+{
+    return LITE_MAXIMUM(mem_pressure_counted, mem_pressure_set);
+}
+
+void LITE_mem_pressure_set(int level)
+{
+    mem_pressure_set = LITE_MINIMUM(LITE_MAXIMUM(level, LITE_MEM_PRESSURE_NONE), LITE_MEM_PRESSURE_CRITICAL);
+}
+
+void LITE_mem_pressure_poll(void)
+{
+    mem_pressure_handler_t  handlers[LITE_MEM_PRESSURE_HANDLERS_MAX];
+    int                     level = LITE_mem_pressure_level();
+    int                     i;
+
+    if (level == mem_pressure_notified) {
+        return;
+    }
+
+    if (level > mem_pressure_notified) {
+        log_warning("memory pressure %d, %d bytes in use", level, LITE_get_malloc_bytes_in_use());
+    } else {
+        log_info("memory pressure %d, %d bytes in use", level, LITE_get_malloc_bytes_in_use());
+    }
+    mem_pressure_notified = level;
+
+    /* a handler may register or unregister one */
+    _mem_pressure_lock();
+    memcpy(handlers, mem_pressure_handlers, sizeof(handlers));
+    _mem_pressure_unlock();
+
+    for (i = 0; i < LITE_MEM_PRESSURE_HANDLERS_MAX; i++) {
+        if (handlers[i].handler) {
+            handlers[i].handler(level, handlers[i].ctx);
+        }
+    }
+
+    /* last, with what the handlers gave back free in the pages */
+    if (level > LITE_MEM_PRESSURE_NONE) {
+        LITE_slab_trim();
+    }
+}
+
+int LITE_mem_pressure_count(int in_use)
+{
+    int         level = mem_pressure_counted;
+    int         counted = LITE_MEM_PRESSURE_NONE;
+    int         i, watermark;
+
+    for (i = LITE_MEM_PRESSURE_CRITICAL; i > LITE_MEM_PRESSURE_NONE; i--) {
+        watermark = mem_pressure_watermarks[i - 1];
+        if (watermark > 0 && (in_use >= watermark || (level >= i && in_use > watermark - watermark / 8))) {
+            counted = i;
+            break;
+        }
+    }
+
+    if (counted == level) {
+        return 0;
+    }
+    mem_pressure_counted = counted;
+    return counted > level;
+}
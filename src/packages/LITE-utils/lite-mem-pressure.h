@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_MEM_PRESSURE_H__
+#define __LITE_MEM_PRESSURE_H__
+
+#include "lite-utils_config.h"
+
+/*
+ * The level of memory pressure, from what LITE_malloc() has in use against two watermarks, or as set by
+ * a monitor of the platform heap. A level is left once the bytes in use are 1/8 below its watermark, not
+ * to go in and out at every allocation. The handlers registered are called with the level when it changed,
+ * from LITE_mem_pressure_poll() in the thread of its caller and holding no lock, to give back what they
+ * keep and can do without. Pages of the slab free again are given back under pressure. A watermark of 0
+ * is not used, and without WITH_MEM_STATS only the level set counts.
+ */
+
+typedef enum {
+    LITE_MEM_PRESSURE_NONE = 0,
+    LITE_MEM_PRESSURE_HIGH,         /* over the high watermark, what is kept for speed is given back */
+    LITE_MEM_PRESSURE_CRITICAL,     /* over the critical one, what is optional is given up as well */
+} lite_mem_pressure_t;
+
+typedef void (*lite_mem_pressure_fpt)(int level, void *ctx);
+
+/* bytes in use each level begins at, 0 does not use it, LITE_MEM_PRESSURE_HIGH_BYTES and _CRITICAL_BYTES by default */
+void    LITE_mem_pressure_set_watermarks(int high, int critical);
+/* 0 when registered now or before, -1 when LITE_MEM_PRESSURE_HANDLERS_MAX are already */
+int     LITE_mem_pressure_register(lite_mem_pressure_fpt handler, void *ctx);
+void    LITE_mem_pressure_unregister(lite_mem_pressure_fpt handler, void *ctx);
+/* the higher of the level counted and the level set */
+int     LITE_mem_pressure_level(void);
+/* from a monitor of a heap LITE_malloc() does not count, LITE_MEM_PRESSURE_NONE when it is fine again */
+void    LITE_mem_pressure_set(int level);
+/* the handlers are called when the level is not the one they were last called with */
+void    LITE_mem_pressure_poll(void);
+
+/* of mem_stats.c, the bytes in use after each allocation and free, 1 when the level counted went up */
+int     LITE_mem_pressure_count(int in_use);
+
+#endif  /* __LITE_MEM_PRESSURE_H__ */
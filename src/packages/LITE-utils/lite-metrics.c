@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "lite-utils_internal.h"
+#include "lite-metrics.h"
+
+#if WITH_METRICS
+
+#if WITH_MEM_STATS
+static int metrics_heap_in_use(void)
+{
+    return LITE_get_malloc_bytes_in_use();
+}
+
+LITE_METRIC_DEFINE_GAUGE(metrics_heap, "heap.in_use", metrics_heap_in_use);
+#endif
+
+/* a slot is claimed before it is filled, a reader skips one still NULL */
+static lite_metric_t *metrics[LITE_METRICS_MAX];
+static volatile int metrics_claimed;
+
+int LITE_metric_register(lite_metric_t *metric)
+{
+    int slot;
+
+    /* the first of the callers at once takes the slot */
+    if (metric->registered || HAL_AtomicAdd(&metric->registered, 1) != 1) {
+        return 0;
+    }
+
+    slot = HAL_AtomicAdd(&metrics_claimed, 1) - 1;
+    if (slot >= LITE_METRICS_MAX) {
+        log_err("no room for metric %s, LITE_METRICS_MAX is %d", metric->name, LITE_METRICS_MAX);
+        return -1;
+    }
+
+    metrics[slot] = metric;
+    return 0;
+}
+
+void LITE_metric_add(lite_metric_t *metric, int n)
+{
+    HAL_AtomicAdd(&metric->value, n);
+}
+
+void LITE_metric_set(lite_metric_t *metric, int value)
+{
+    metric->value = value;
+}
+
+void LITE_metric_observe(lite_metric_t *metric, int value)
+{
+    int i;
+
+    for (i = 0; i < metric->bucket_num - 1 && value > metric->bounds[i]; i++);
+
+    HAL_AtomicAdd(&metric->buckets[i], 1);
+    HAL_AtomicAdd(&metric->count, 1);
+    HAL_AtomicAdd(&metric->sum, value);
+}
+
+static void metrics_builtin(void)
+{
+#if WITH_MEM_STATS
+    LITE_METRIC_REGISTER(metrics_heap);
+#endif
+}
+
+int LITE_metrics_num(void)
+{
+    int num;
+
+    metrics_builtin();
+
+    num = HAL_AtomicAdd(&metrics_claimed, 0);
+    return num > LITE_METRICS_MAX ? LITE_METRICS_MAX : num;
+}
+
+lite_metric_t *LITE_metrics_get(int index)
+{
+    if (index < 0 || index >= LITE_metrics_num()) {
+        return NULL;
+    }
+
+    return metrics[index];
+}
+
+lite_metric_t *LITE_metrics_find(const char *name)
+{
+    int num = LITE_metrics_num();
+    int i;
+
+    for (i = 0; i < num; i++) {
+        if (NULL != metrics[i] && 0 == strcmp(metrics[i]->name, name)) {
+            return metrics[i];
+        }
+    }
+
+    return NULL;
+}
+
+int LITE_metric_value(lite_metric_t *metric)
+{
+    if (LITE_METRIC_HISTOGRAM == metric->type) {
+        return metric->count;
+    }
+
+    return NULL != metric->read ? metric->read() : metric->value;
+}
+
+/* appends at 'at' as snprintf() would, what does not fit is still counted */
+static int metrics_append(char *buf, int len, int at, const char *fmt, ...)
+{
+    char scratch[1];
+    va_list args;
+    int ret;
+
+    va_start(args, fmt);
+    if (at < len) {
+        ret = HAL_Vsnprintf(buf + at, len - at, fmt, args);
+    } else {
+        ret = HAL_Vsnprintf(scratch, sizeof(scratch), fmt, args);
+    }
+    va_end(args);
+
+    return at + (ret > 0 ? ret : 0);
+}
+
+int LITE_metrics_format(char *buf, int len)
+{
+    int num = LITE_metrics_num();
+    int at, i, b;
+    const char *sep = "";
+    lite_metric_t *metric;
+
+    at = metrics_append(buf, len, 0, "{");
+    for (i = 0; i < num; i++) {
+        if (NULL == (metric = metrics[i])) {
+            continue;
+        }
+
+        /* the names are literals of the modules, nothing in them needs escaping */
+        if (LITE_METRIC_HISTOGRAM != metric->type) {
+            at = metrics_append(buf, len, at, "%s\"%s\":%d", sep, metric->name, LITE_metric_value(metric));
+        } else {
+            at = metrics_append(buf, len, at, "%s\"%s\":[%d,%d", sep, metric->name, metric->count, metric->sum);
+            for (b = 0; b < metric->bucket_num; b++) {
+                at = metrics_append(buf, len, at, ",%d", metric->buckets[b]);
+            }
+            at = metrics_append(buf, len, at, "]");
+        }
+        sep = ",";
+    }
+
+    return metrics_append(buf, len, at, "}");
+}
+
+#else
+
+int LITE_metric_register(lite_metric_t *metric)
+{
+    return 0;
+}
+
+void LITE_metric_add(lite_metric_t *metric, int n)
+{
+}
+
+void LITE_metric_set(lite_metric_t *metric, int value)
+{
+}
+
+void LITE_metric_observe(lite_metric_t *metric, int value)
+{
+}
+
+int LITE_metrics_num(void)
+{
+    return 0;
+}
+
+lite_metric_t *LITE_metrics_get(int index)
+{
+    return NULL;
+}
+
+lite_metric_t *LITE_metrics_find(const char *name)
+{
+    return NULL;
+}
+
+int LITE_metric_value(lite_metric_t *metric)
+{
+    return 0;
+}
+
+int LITE_metrics_format(char *buf, int len)
+{
+    return HAL_Snprintf(buf, len, "{}");
+}
+
+#endif  /* #if WITH_METRICS */
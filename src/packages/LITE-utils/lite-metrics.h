@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_METRICS_H__
+#define __LITE_METRICS_H__
+
+#include "lite-utils_config.h"
+
+/*
+ * One registry of the counters, gauges and histograms of every module, read by name or all at once.
+ * A module defines its metrics statically with LITE_METRIC_DEFINE_xxx(), registers them once from
+ * its init with LITE_METRIC_REGISTER() and updates them with atomic additions, no lock is taken.
+ * A metric stays registered for the life of the program, at most LITE_METRICS_MAX of them. Without
+ * WITH_METRICS the updates are nothing and the reads find no metric, a gauge computed by a function
+ * needs the function under #if WITH_METRICS then.
+ */
+
+typedef enum {
+    LITE_METRIC_COUNTER = 0,    /* only goes up */
+    LITE_METRIC_GAUGE,          /* what it is now, set or added to, or computed when it is read */
+    LITE_METRIC_HISTOGRAM,      /* the values observed by fixed buckets, with their number and sum */
+} lite_metric_type_t;
+
+typedef struct {
+    const char         *name;
+    int                 type;
+    volatile int        value;      /* of a counter or gauge */
+    int               (*read)(void);/* computes a gauge when it is read, value is not used then */
+    const int          *bounds;     /* of a histogram, the upper bounds of its buckets but the last, increasing */
+    int                 bucket_num; /* with the last one, for what is above the bounds */
+    volatile int       *buckets;
+    volatile int        count;
+    volatile int        sum;
+    volatile int        registered;
+} lite_metric_t;
+
+#if WITH_METRICS
+#define LITE_METRIC_DEFINE_COUNTER(var, name) \
+    static lite_metric_t var = { name, LITE_METRIC_COUNTER }
+#define LITE_METRIC_DEFINE_GAUGE(var, name, read) \
+    static lite_metric_t var = { name, LITE_METRIC_GAUGE, 0, read }
+#define LITE_METRIC_DEFINE_HISTOGRAM(var, name, ...) \
+    static const int var##_bounds[] = { __VA_ARGS__ }; \
+    static volatile int var##_buckets[sizeof(var##_bounds) / sizeof(int) + 1]; \
+    static lite_metric_t var = { name, LITE_METRIC_HISTOGRAM, 0, NULL, var##_bounds, \
+                                 sizeof(var##_bounds) / sizeof(int) + 1, var##_buckets }
+
+#define LITE_METRIC_REGISTER(var)       LITE_metric_register(&(var))
+#define LITE_METRIC_ADD(var, n)         LITE_metric_add(&(var), (n))
+#define LITE_METRIC_SET(var, v)         LITE_metric_set(&(var), (v))
+#define LITE_METRIC_OBSERVE(var, v)     LITE_metric_observe(&(var), (v))
+#else
+#define LITE_METRIC_DEFINE_COUNTER(var, name)           extern lite_metric_t var
+#define LITE_METRIC_DEFINE_GAUGE(var, name, read)       extern lite_metric_t var
+#define LITE_METRIC_DEFINE_HISTOGRAM(var, name, ...)    extern lite_metric_t var
+
+#define LITE_METRIC_REGISTER(var)       do {} while (0)
+#define LITE_METRIC_ADD(var, n)         do {} while (0)
+#define LITE_METRIC_SET(var, v)         do {} while (0)
+#define LITE_METRIC_OBSERVE(var, v)     do {} while (0)
+#endif
+
+/* 0 when registered now or before, -1 when LITE_METRICS_MAX are already */
+int     LITE_metric_register(lite_metric_t *metric);
+/* to a counter or a gauge, negative to take off a gauge */
+void    LITE_metric_add(lite_metric_t *metric, int n);
+void    LITE_metric_set(lite_metric_t *metric, int value);
+void    LITE_metric_observe(lite_metric_t *metric, int value);
+
+/* the metrics registered, index from 0 in the order they were, NULL past them */
+int     LITE_metrics_num(void);
+lite_metric_t *LITE_metrics_get(int index);
+lite_metric_t *LITE_metrics_find(const char *name);
+/* of a counter or gauge, the number of values observed by a histogram */
+int     LITE_metric_value(lite_metric_t *metric);
+
+/*
+ * all the metrics as one JSON object, {"<name>":<value>,...}, a histogram as [count,sum,<buckets>...]
+ * under its name, in buf of len bytes. The length of the whole object as snprintf(), what does not
+ * fit is cut and buf is still terminated.
+ */
+int     LITE_metrics_format(char *buf, int len);
+
+#endif  /* __LITE_METRICS_H__ */
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <limits.h>
+
+#include "lite-utils_internal.h"
+#include "lite-number.h"
+
+/* 2^53, integers below it are exact in a double */
+#define NUMBER_EXACT_MAX        (9007199254740992.0)
+
+/* a fraction of a double of 2^-8 and above is a whole number of 2^-60, and ten of those fit in 64 bits */
+#define NUMBER_FRACTION_BITS    (60)
+#define NUMBER_FRACTION_ONE     (1152921504606846976.0)
+#define NUMBER_FRACTION_HALF    ((uint64_t)1 << (NUMBER_FRACTION_BITS - 1))
+#define NUMBER_FRACTION_MASK    (((uint64_t)1 << NUMBER_FRACTION_BITS) - 1)
+
+/* all exact in a double, a product or quotient with one of them is rounded once */
+static const double number_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define NUMBER_POW10_MAX        ((int)(sizeof(number_pow10) / sizeof(number_pow10[0])) - 1)
+
+static const char number_digits[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+#define NUMBER_IS_DIGIT(c)      ((c) >= '0' && (c) <= '9')
+#define NUMBER_IS_SPACE(c)      ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+/* two digits at a time from the end, at least width of them with leading zeros */
+static int _number_format_u64(char *buf, uint64_t value, int width)
+{
+    char        temp[24];
+    char       *p = temp + sizeof(temp);
+    int         len;
+
+    while (value >= 100) {
+        p -= 2;
+        memcpy(p, number_digits + (value % 100) * 2, 2);
+        value /= 100;
+    }
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, number_digits + value * 2, 2);
+    } else {
+        *--p = (char)('0' + value);
+    }
+    while (temp + sizeof(temp) - p < width) {
+        *--p = '0';
+    }
+
+    len = temp + sizeof(temp) - p;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+
+    return len;
+}
+
+/* digits is value * 10^precise */
+static int _number_format_scaled(char *buf, int negative, uint64_t digits, int precise)
+{
+    char        temp[24];
+    int         len = 0;
+    int         n;
+
+    if (negative) {
+        buf[len++] = '-';
+    }
+    if (precise == 0) {
+        return len + _number_format_u64(buf + len, digits, 1);
+    }
+
+    n = _number_format_u64(temp, digits, precise + 1);
+    memcpy(buf + len, temp, n - precise);
+    len += n - precise;
+    buf[len++] = '.';
+    memcpy(buf + len, temp + n - precise, precise + 1);
+
+    return len + precise;
+}
+
+/* the fewest significant digits of "%.*g" that are read back as the same value */
+static int _number_format_general(char *buf, double value, int digits_min, int digits_max, int is_float)
+{
+    double      back;
+    int         digits;
+    int         len = 0;
+
+    for (digits = digits_min; digits <= digits_max; digits++) {
+        len = HAL_Snprintf(buf, LITE_NUMBER_LEN_MAX, "%.*g", digits, value);
+        back = strtod(buf, NULL);
+        if (is_float ? (float)back == (float)value : back == value) {
+            break;
+        }
+    }
+
+    return len;
+}
+
+int LITE_format_llong(char *buf, long long value)
+{
+    if (value < 0) {
+        buf[0] = '-';
+        return 1 + _number_format_u64(buf + 1, (uint64_t)0 - (uint64_t)value, 1);
+    }
+
+    return _number_format_u64(buf, (uint64_t)value, 1);
+}
+
+int LITE_format_fixed(char *buf, double value, int precise)
+{
+    double      abs_value = value < 0 ? -value : value;
+    double      scaled;
+    uint64_t    integer;
+    uint64_t    fraction = 0;
+    uint64_t    rest;
+    int         len = 0;
+    int         i;
+
+    precise = precise < 0 ? 0 : (precise > 16 ? 16 : precise);
+
+    /* not a number as well */
+    if (!(abs_value < 1e19)) {
+        return HAL_Snprintf(buf, LITE_NUMBER_LEN_MAX, "%.17g", value);
+    }
+
+    /* the integer part is taken away exactly, the fraction is held exactly in 60 bits after the point */
+    integer = (uint64_t)abs_value;
+    scaled = (abs_value - (double)integer) * NUMBER_FRACTION_ONE;
+    rest = (uint64_t)scaled;
+    if ((double)rest != scaled) {
+        /* a fraction finer than 2^-60, of a value below 2^-8 */
+        return HAL_Snprintf(buf, LITE_NUMBER_LEN_MAX, "%.*f", precise, value);
+    }
+
+    /* the exact digits of the binary value, what is left of it rounds them, half way to the even one */
+    for (i = 0; i < precise; i++) {
+        rest *= 10;
+        fraction = fraction * 10 + (rest >> NUMBER_FRACTION_BITS);
+        rest &= NUMBER_FRACTION_MASK;
+    }
+    if (rest > NUMBER_FRACTION_HALF || (rest == NUMBER_FRACTION_HALF && ((precise ? fraction : integer) & 1))) {
+        fraction += 1;
+        if (fraction >= (uint64_t)number_pow10[precise]) {
+            fraction = 0;
+            integer += 1;
+        }
+    }
+
+    if (value < 0) {
+        buf[len++] = '-';
+    }
+    len += _number_format_u64(buf + len, integer, 1);
+    if (precise) {
+        buf[len++] = '.';
+        len += _number_format_u64(buf + len, fraction, precise);
+    }
+
+    return len;
+}
+
+int LITE_format_double(char *buf, double value)
+{
+    double      abs_value = value < 0 ? -value : value;
+    double      scaled;
+    uint64_t    digits;
+    int         precise;
+
+    if (abs_value == 0) {
+        return _number_format_u64(buf, 0, 1);
+    }
+
+    /* the fewest digits after the point that divided back by the power of ten give the same double */
+    if (abs_value >= 1e-5 && abs_value < 1e15) {
+        for (precise = 0; precise <= NUMBER_POW10_MAX; precise++) {
+            scaled = abs_value * number_pow10[precise];
+            if (scaled >= NUMBER_EXACT_MAX) {
+                break;
+            }
+            digits = (uint64_t)(scaled + 0.5);
+            if ((double)digits / number_pow10[precise] == abs_value) {
+                return _number_format_scaled(buf, value < 0, digits, precise);
+            }
+        }
+    }
+
+    return _number_format_general(buf, value, 15, 17, 0);
+}
+
+int LITE_format_float(char *buf, float value)
+{
+    double      abs_value = value < 0 ? -(double)value : (double)value;
+    double      scaled;
+    uint64_t    digits;
+    int         precise;
+
+    if (abs_value == 0) {
+        return _number_format_u64(buf, 0, 1);
+    }
+
+    if (abs_value >= 1e-5 && abs_value < 1e15) {
+        for (precise = 0; precise <= NUMBER_POW10_MAX; precise++) {
+            scaled = abs_value * number_pow10[precise];
+            if (scaled >= NUMBER_EXACT_MAX) {
+                break;
+            }
+            digits = (uint64_t)(scaled + 0.5);
+            if ((float)((double)digits / number_pow10[precise]) == (float)abs_value) {
+                return _number_format_scaled(buf, value < 0, digits, precise);
+            }
+        }
+    }
+
+    return _number_format_general(buf, value, 6, 9, 1);
+}
+
+long long LITE_parse_llong(const char *str, char **end)
+{
+    const char         *p = str;
+    unsigned long long  value = 0;
+    unsigned long long  limit;
+    int                 negative = 0;
+    int                 overflow = 0;
+
+    while (NUMBER_IS_SPACE(*p)) {
+        p++;
+    }
+    if (*p == '-' || *p == '+') {
+        negative = (*p++ == '-');
+    }
+    if (!NUMBER_IS_DIGIT(*p)) {
+        if (end) {
+            *end = (char *)str;
+        }
+        return 0;
+    }
+
+    limit = negative ? (unsigned long long)LLONG_MAX + 1 : (unsigned long long)LLONG_MAX;
+    for (; NUMBER_IS_DIGIT(*p); p++) {
+        if (value > (limit - (*p - '0')) / 10) {
+            overflow = 1;
+        } else {
+            value = value * 10 + (*p - '0');
+        }
+    }
+    if (end) {
+        *end = (char *)p;
+    }
+
+    if (overflow) {
+        return negative ? LLONG_MIN : LLONG_MAX;
+    }
+    return negative ? (long long)(0 - value) : (long long)value;
+}
+
+int LITE_parse_int(const char *str, char **end)
+{
+    long long   value = LITE_parse_llong(str, end);
+
+    return value > INT_MAX ? INT_MAX : (value < INT_MIN ? INT_MIN : (int)value);
+}
+
+double LITE_parse_double(const char *str, char **end)
+{
+    const char *p = str;
+    uint64_t    digits = 0;
+    double      value;
+    int         negative = 0;
+    int         exponent = 0;
+    int         exponent_value = 0;
+    int         exponent_negative = 0;
+
+    if (*p == '-') {
+        negative = 1;
+        p++;
+    }
+    if (!NUMBER_IS_DIGIT(*p)) {
+        return strtod(str, end);
+    }
+
+    /* up to 2^53 of digits and a power of ten up to 10^22 are read exactly, the rest by strtod() */
+    for (; NUMBER_IS_DIGIT(*p); p++) {
+        if (digits >= (uint64_t)(NUMBER_EXACT_MAX / 10)) {
+            return strtod(str, end);
+        }
+        digits = digits * 10 + (*p - '0');
+    }
+    if (*p == '.') {
+        for (p++; NUMBER_IS_DIGIT(*p); p++) {
+            if (digits >= (uint64_t)(NUMBER_EXACT_MAX / 10)) {
+                return strtod(str, end);
+            }
+            digits = digits * 10 + (*p - '0');
+            exponent--;
+        }
+    }
+    if ((*p == 'e' || *p == 'E') &&
+        (NUMBER_IS_DIGIT(p[1]) || ((p[1] == '-' || p[1] == '+') && NUMBER_IS_DIGIT(p[2])))) {
+        p++;
+        if (*p == '-' || *p == '+') {
+            exponent_negative = (*p++ == '-');
+        }
+        for (; NUMBER_IS_DIGIT(*p); p++) {
+            if (exponent_value > 1000) {
+                return strtod(str, end);
+            }
+            exponent_value = exponent_value * 10 + (*p - '0');
+        }
+        exponent += exponent_negative ? -exponent_value : exponent_value;
+    }
+    if (exponent < -NUMBER_POW10_MAX || exponent > NUMBER_POW10_MAX) {
+        return strtod(str, end);
+    }
+
+    value = (double)digits;
+    value = exponent < 0 ? value / number_pow10[-exponent] : value * number_pow10[exponent];
+    if (end) {
+        *end = (char *)p;
+    }
+
+    return negative ? -value : value;
+}
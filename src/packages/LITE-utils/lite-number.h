@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_NUMBER_H__
+#define __LITE_NUMBER_H__
+
+/*
+ * Numbers to and from text without going through printf() and strtod() for the values devices
+ * report: integers, and decimals of up to 16 significant digits. The decimals are scaled to integers
+ * by exact powers of ten, so a double is formatted and read with a few integer steps and one
+ * multiplication or division, which soft float MCUs do cheaply. What does not fit is handed to
+ * HAL_Snprintf() and strtod() as before.
+ */
+
+/* what a formatter writes at most, with the '\0' */
+#define LITE_NUMBER_LEN_MAX     40
+
+/* the length written, without the '\0' */
+int         LITE_format_llong(char *buf, long long value);
+/* precise digits after the point, rounded as "%.*f" rounds them, "%.17g" for 1e19 and above */
+int         LITE_format_fixed(char *buf, double value, int precise);
+/* the shortest text that reads back as the same double or float, "%.17g" or "%.9g" when fixed is not it */
+int         LITE_format_double(char *buf, double value);
+int         LITE_format_float(char *buf, float value);
+
+/* as atoi() and atoll(), saturated, end past the last digit when not NULL */
+int         LITE_parse_int(const char *str, char **end);
+long long   LITE_parse_llong(const char *str, char **end);
+/* as strtod() */
+double      LITE_parse_double(const char *str, char **end);
+
+#endif  /* __LITE_NUMBER_H__ */
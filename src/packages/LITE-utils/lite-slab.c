@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "lite-utils_internal.h"
+#include "lite-slab.h"
+#include "lite-mem-pressure.h"
+
+#if WITH_MEM_SLAB
+
+#define SLAB_MAGIC              (0x534C4142)
+
+typedef struct slab_page_s slab_page_t;
+
+typedef struct {
+    list_head_t         partial;            /* pages with a free block */
+    int                 stride;             /* of a block with its header */
+    lite_slab_stats_t   stats;
+} slab_class_t;
+
+struct slab_page_s {
+    list_head_t         list;               /* in partial of its class while a block is free */
+    slab_class_t       *cls;
+    void               *free;               /* the free blocks, each holding the next */
+    int                 in_use;
+};
+
+/* in front of each buffer, as aligned as UTILS_malloc() aligns blocks */
+typedef union {
+    struct {
+        uint32_t        magic;
+        uint32_t        size;               /* asked for */
+        slab_page_t    *page;               /* NULL when taken from UTILS_malloc() as it is */
+    } h;
+    long double         align;
+    void               *ptr;
+} slab_hdr_t;
+
+#define SLAB_ROUND_UP(n)        (((n) + sizeof(slab_hdr_t) - 1) / sizeof(slab_hdr_t) * sizeof(slab_hdr_t))
+#define SLAB_PAGE_HDR_LEN       SLAB_ROUND_UP(sizeof(slab_page_t))
+
+static const int slab_sizes[] = { LITE_SLAB_CLASSES };
+#define SLAB_CLASS_NUM          ((int)(sizeof(slab_sizes) / sizeof(slab_sizes[0])))
+
+static slab_class_t slab_classes[SLAB_CLASS_NUM];
+static lite_slab_stats_t slab_large;
+static int slab_inited;
+static void *slab_lock;
+
+static void _slab_lock(void)
+{
+    int i;
+
+    /* the first allocation is made before other threads are started */
+    if (!slab_inited) {
+        for (i = 0; i < SLAB_CLASS_NUM; i++) {
+            INIT_LIST_HEAD(&slab_classes[i].partial);
+            slab_classes[i].stride = sizeof(slab_hdr_t) + SLAB_ROUND_UP(slab_sizes[i]);
+            slab_classes[i].stats.block_size = slab_sizes[i];
+        }
+        slab_lock = HAL_MutexCreate();
+        slab_inited = 1;
+    }
+    if (slab_lock) {
+        HAL_MutexLock(slab_lock);
+    }
+}
+
+static void _slab_unlock(void)
+{
+    if (slab_lock) {
+        HAL_MutexUnlock(slab_lock);
+    }
+}
+
+/* the classes are in increasing size, a few of them, searched in order */
+static slab_class_t *_slab_class_of(int size)
+{
+    int i;
+
+    for (i = 0; i < SLAB_CLASS_NUM; i++) {
+        if (size <= slab_sizes[i]) {
+            return &slab_classes[i];
+        }
+    }
+
+    return NULL;
+}
+
+static slab_page_t *_slab_page_new(slab_class_t *cls)
+{
+    slab_page_t    *page;
+    slab_hdr_t     *hdr;
+    int             i;
+
+    page = UTILS_malloc(SLAB_PAGE_HDR_LEN + cls->stride * LITE_SLAB_BLOCKS_PER_PAGE);
+    if (!page) {
+        return NULL;
+    }
+
+    page->cls = cls;
+    page->free = NULL;
+    page->in_use = 0;
+    for (i = LITE_SLAB_BLOCKS_PER_PAGE - 1; i >= 0; i--) {
+        hdr = (slab_hdr_t *)((char *)page + SLAB_PAGE_HDR_LEN + cls->stride * i);
+        hdr->h.magic = SLAB_MAGIC;
+        hdr->h.size = 0;
+        hdr->h.page = page;
+        *(void **)(hdr + 1) = page->free;
+        page->free = hdr;
+    }
+
+    list_add(&page->list, &cls->partial);
+    cls->stats.pages += 1;
+    cls->stats.blocks += LITE_SLAB_BLOCKS_PER_PAGE;
+
+    return page;
+}
+
+static void _slab_page_free(slab_page_t *page)
+{
+    list_del(&page->list);
+    page->cls->stats.pages -= 1;
+    page->cls->stats.blocks -= LITE_SLAB_BLOCKS_PER_PAGE;
+    UTILS_free(page);
+}
+
+void *LITE_slab_malloc(int size)
+{
+    slab_class_t   *cls;
+    slab_page_t    *page;
+    slab_hdr_t     *hdr = NULL;
+
+    if (size <= 0) {
+        return NULL;
+    }
+
+    cls = _slab_class_of(size);
+
+    _slab_lock();
+    if (!cls) {
+        hdr = UTILS_malloc(sizeof(slab_hdr_t) + size);
+        if (hdr) {
+            hdr->h.magic = SLAB_MAGIC;
+            hdr->h.page = NULL;
+            slab_large.pages += 1;
+            slab_large.blocks += 1;
+            slab_large.blocks_in_use += 1;
+            slab_large.blocks_max_in_use = LITE_MAXIMUM(slab_large.blocks_max_in_use, slab_large.blocks_in_use);
+            slab_large.bytes_in_use += size;
+            slab_large.allocations += 1;
+        } else {
+            slab_large.failures += 1;
+        }
+    } else {
+        page = list_empty(&cls->partial) ? _slab_page_new(cls) : list_first_entry(&cls->partial, slab_page_t, list);
+        if (page) {
+            hdr = page->free;
+            page->free = *(void **)(hdr + 1);
+            page->in_use += 1;
+            if (!page->free) {
+                list_del(&page->list);
+            }
+
+            cls->stats.blocks_in_use += 1;
+            cls->stats.blocks_max_in_use = LITE_MAXIMUM(cls->stats.blocks_max_in_use, cls->stats.blocks_in_use);
+            cls->stats.bytes_in_use += size;
+            cls->stats.allocations += 1;
+        } else {
+            cls->stats.failures += 1;
+        }
+    }
+    if (hdr) {
+        hdr->h.size = size;
+    }
+    _slab_unlock();
+
+    return hdr ? (void *)(hdr + 1) : NULL;
+}
+
+void LITE_slab_free(void *ptr)
+{
+    slab_hdr_t     *hdr;
+    slab_page_t    *page;
+    slab_class_t   *cls;
+
+    if (!ptr) {
+        return;
+    }
+
+    hdr = (slab_hdr_t *)ptr - 1;
+    if (SLAB_MAGIC != hdr->h.magic) {
+        UTILS_free(ptr);
+        return;
+    }
+
+    _slab_lock();
+    page = hdr->h.page;
+    if (!page) {
+        slab_large.pages -= 1;
+        slab_large.blocks -= 1;
+        slab_large.blocks_in_use -= 1;
+        slab_large.bytes_in_use -= hdr->h.size;
+        hdr->h.magic = 0;
+        UTILS_free(hdr);
+        _slab_unlock();
+        return;
+    }
+
+    cls = page->cls;
+    cls->stats.blocks_in_use -= 1;
+    cls->stats.bytes_in_use -= hdr->h.size;
+
+    if (!page->free) {
+        list_add(&page->list, &cls->partial);
+    }
+    *(void **)(hdr + 1) = page->free;
+    page->free = hdr;
+    page->in_use -= 1;
+
+    /* one free page is kept for the class not to take and give back a page over and over, but under pressure */
+    if (0 == page->in_use && (!list_is_singular(&cls->partial) || LITE_mem_pressure_level())) {
+        _slab_page_free(page);
+    }
+    _slab_unlock();
+}
+
+void LITE_slab_trim(void)
+{
+    slab_page_t    *page, *tmp;
+    int             i;
+
+    _slab_lock();
+    for (i = 0; i < SLAB_CLASS_NUM; i++) {
+        list_for_each_entry_safe(page, tmp, &slab_classes[i].partial, list, slab_page_t) {
+            if (0 == page->in_use) {
+                _slab_page_free(page);
+            }
+        }
+    }
+    _slab_unlock();
+}
+
+void *LITE_slab_realloc(void *ptr, int size)
+{
+    slab_hdr_t     *hdr;
+    void           *temp;
+    int             len;
+
+    if (!ptr) {
+        return LITE_slab_malloc(size);
+    }
+
+    hdr = (slab_hdr_t *)ptr - 1;
+    if (SLAB_MAGIC != hdr->h.magic) {
+        return realloc(ptr, size);
+    }
+
+    /* still fits the block it is in */
+    if (hdr->h.page && size > 0 && _slab_class_of(size) == hdr->h.page->cls) {
+        _slab_lock();
+        hdr->h.page->cls->stats.bytes_in_use += size - (int)hdr->h.size;
+        hdr->h.size = size;
+        _slab_unlock();
+        return ptr;
+    }
+
+    temp = LITE_slab_malloc(size);
+    if (!temp) {
+        return NULL;
+    }
+
+    len = (int)hdr->h.size < size ? (int)hdr->h.size : size;
+    memcpy(temp, ptr, len);
+    LITE_slab_free(ptr);
+
+    return temp;
+}
+
+int LITE_slab_get_stats(int class_index, lite_slab_stats_t *stats)
+{
+    if (!stats || class_index >= SLAB_CLASS_NUM) {
+        return -1;
+    }
+
+    _slab_lock();
+    *stats = class_index < 0 ? slab_large : slab_classes[class_index].stats;
+    _slab_unlock();
+
+    return 0;
+}
+
+void LITE_slab_dump_stats(void)
+{
+    lite_slab_stats_t   stats;
+    int                 i;
+
+    LITE_printf("---------------------------------------------------\r\n");
+    LITE_printf(". slab class   pages  blocks  in use  max use   bytes  lost  allocs  failed\r\n");
+    for (i = -1; 0 == LITE_slab_get_stats(i, &stats); i++) {
+        LITE_printf(". %10d  %6d  %6d  %6d  %7d  %6d  %4d  %6d  %6d\r\n",
+                    stats.block_size, stats.pages, stats.blocks, stats.blocks_in_use, stats.blocks_max_in_use,
+                    stats.bytes_in_use, stats.block_size ? stats.blocks_in_use * stats.block_size - stats.bytes_in_use : 0,
+                    stats.allocations, stats.failures);
+    }
+    LITE_printf("---------------------------------------------------\r\n");
+}
+
+#else
+
+void *LITE_slab_malloc(int size)
+{
+    return size > 0 ? UTILS_malloc(size) : NULL;
+}
+
+void *LITE_slab_realloc(void *ptr, int size)
+{
+    return realloc(ptr, size);
+}
+
+void LITE_slab_free(void *ptr)
+{
+    UTILS_free(ptr);
+}
+
+void LITE_slab_trim(void)
+{
+
+}
+
+int LITE_slab_get_stats(int class_index, lite_slab_stats_t *stats)
+{
+    return -1;
+}
+
+void LITE_slab_dump_stats(void)
+{
+    log_err("WITH_MEM_SLAB = %d", WITH_MEM_SLAB);
+}
+
+#endif  /* #if WITH_MEM_SLAB */
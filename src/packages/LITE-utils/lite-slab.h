@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_SLAB_H__
+#define __LITE_SLAB_H__
+
+/*
+ * With WITH_MEM_SLAB, what LITE_malloc() hands out is a block of the smallest size class of
+ * LITE_SLAB_CLASSES it fits in, from pages of LITE_SLAB_BLOCKS_PER_PAGE blocks taken from UTILS_malloc().
+ * A page is given back once all its blocks are free and another page of its class has a free block,
+ * or at once under memory pressure.
+ * What is larger than all classes is taken from UTILS_malloc() as it is. Blocks are not zeroed.
+ */
+
+typedef struct {
+    int         block_size;         /* of the class, 0 for what is larger than all of them */
+    int         pages;              /* taken from UTILS_malloc() now */
+    int         blocks;             /* in the pages, blocks - blocks_in_use are free in them */
+    int         blocks_in_use;
+    int         blocks_max_in_use;
+    int         bytes_in_use;       /* asked for, blocks_in_use * block_size - bytes_in_use is lost to rounding up */
+    int         allocations;
+    int         failures;           /* no page to be had from UTILS_malloc() */
+} lite_slab_stats_t;
+
+void       *LITE_slab_malloc(int size);
+void       *LITE_slab_realloc(void *ptr, int size);
+/* what was not from LITE_slab_malloc() is handed to UTILS_free() */
+void        LITE_slab_free(void *ptr);
+
+/* give back the pages all free, the one kept for each class as well */
+void        LITE_slab_trim(void);
+
+/* a copy of the stats of a size class, from 0 up, -1 for the larger ones. -1 past the last one */
+int         LITE_slab_get_stats(int class_index, lite_slab_stats_t *stats);
+void        LITE_slab_dump_stats(void);
+
+#endif  /* __LITE_SLAB_H__ */
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "lite-utils_internal.h"
+#include "lite-startup.h"
+
+static const char *startup_names[LITE_STARTUP_PHASE_MAX] = {
+    "cmp_init",
+    "net_connect",
+    "mqtt_connect",
+    "tsl_load",
+    "tsl_get",
+    "subscribe",
+    "ota_report",
+    "first_post",
+};
+
+static lite_startup_phase_t startup_phases[LITE_STARTUP_PHASE_MAX];
+/* the clock of the phases, set by the reset or the first begin */
+static uint64_t startup_origin_us;
+
+const char *LITE_startup_name(int phase)
+{
+    return phase >= 0 && phase < LITE_STARTUP_PHASE_MAX ? startup_names[phase] : "unknown";
+}
+
+const lite_startup_phase_t *LITE_startup_phase(int phase)
+{
+    return phase >= 0 && phase < LITE_STARTUP_PHASE_MAX ? &startup_phases[phase] : NULL;
+}
+
+void LITE_startup_reset(void)
+{
+    memset(startup_phases, 0, sizeof(startup_phases));
+    startup_origin_us = HAL_UptimeUs();
+}
+
+void LITE_startup_begin(int phase)
+{
+    lite_startup_phase_t *p = (lite_startup_phase_t *)LITE_startup_phase(phase);
+    uint64_t now = HAL_UptimeUs();
+
+    /* the first of the callers at once begins it */
+    if (NULL == p || p->begun || HAL_AtomicAdd(&p->begun, 1) != 1) {
+        return;
+    }
+
+    if (0 == startup_origin_us) {
+        startup_origin_us = now;
+    }
+    p->begin_us = now - startup_origin_us;
+}
+
+void LITE_startup_end(int phase, int ok)
+{
+    lite_startup_phase_t *p = (lite_startup_phase_t *)LITE_startup_phase(phase);
+    uint64_t now = HAL_UptimeUs();
+
+    if (NULL == p || !p->begun || p->ended) {
+        return;
+    }
+
+    if (!ok) {
+        HAL_AtomicAdd(&p->failures, 1);
+        return;
+    }
+
+    if (HAL_AtomicAdd(&p->ended, 1) == 1) {
+        p->end_us = now - startup_origin_us;
+    }
+}
+
+void LITE_startup_dump(void)
+{
+    lite_startup_phase_t *p;
+    int i;
+
+    for (i = 0; i < LITE_STARTUP_PHASE_MAX; i++) {
+        p = &startup_phases[i];
+        if (!p->begun) {
+            UTILS_printf("startup %-12s - - - %d\r\n", startup_names[i], p->failures);
+        } else if (!p->ended) {
+            UTILS_printf("startup %-12s %u.%03u - - %d\r\n", startup_names[i], (unsigned int)(p->begin_us / 1000),
+                         (unsigned int)(p->begin_us % 1000), p->failures);
+        } else {
+            UTILS_printf("startup %-12s %u.%03u %u.%03u %u.%03u %d\r\n", startup_names[i],
+                         (unsigned int)(p->begin_us / 1000), (unsigned int)(p->begin_us % 1000),
+                         (unsigned int)(p->end_us / 1000), (unsigned int)(p->end_us % 1000),
+                         (unsigned int)((p->end_us - p->begin_us) / 1000), (unsigned int)((p->end_us - p->begin_us) % 1000),
+                         p->failures);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_STARTUP_H__
+#define __LITE_STARTUP_H__
+
+#include <stdint.h>
+
+#include "lite-utils_config.h"
+
+/*
+ * When each phase of getting online began and ended, in us from LITE_startup_reset(), linkkit_start()
+ * resets it. A phase begins the first time it is begun and ends the first time it is ended with ok,
+ * the ends without ok before are counted as failures, retries stay in the phase then. What is begun
+ * or ended after is not recorded, a reconnect does not change what the startup took. Without
+ * WITH_STARTUP_PROFILE LITE_STARTUP_BEGIN() and LITE_STARTUP_END() are nothing.
+ */
+
+typedef enum {
+    LITE_STARTUP_CMP_INIT = 0,  /* IOT_CMP_Init() of DM, with the connection it makes */
+    LITE_STARTUP_NET_CONNECT,   /* TCP connect and TLS handshake, of the first connection made */
+    LITE_STARTUP_MQTT_CONNECT,  /* from the first connection made to CMP reporting the cloud connected */
+    LITE_STARTUP_TSL_LOAD,      /* the first thing of linkkit_set_tsl() or linkkit_set_tsls() made from its TSL */
+    LITE_STARTUP_TSL_GET,       /* thing/dsltemplate/get to its reply, with get_tsl_from_cloud */
+    LITE_STARTUP_SUBSCRIBE,     /* the first subscribe of DM to the result of every one issued till then */
+    LITE_STARTUP_OTA_REPORT,    /* IOT_CMP_OTA_Start() reporting the firmware version, with FOTA */
+    LITE_STARTUP_FIRST_POST,    /* the first property post to its reply with code 200 */
+    LITE_STARTUP_PHASE_MAX
+} lite_startup_phase_id_t;
+
+typedef struct {
+    uint64_t            begin_us;   /* from the reset */
+    uint64_t            end_us;
+    volatile int        begun;
+    volatile int        ended;
+    volatile int        failures;   /* ends without ok before it ended */
+} lite_startup_phase_t;
+
+#if WITH_STARTUP_PROFILE
+#define LITE_STARTUP_BEGIN(phase)       LITE_startup_begin(phase)
+#define LITE_STARTUP_END(phase, ok)     LITE_startup_end((phase), (ok))
+#else
+#define LITE_STARTUP_BEGIN(phase)       do {} while (0)
+#define LITE_STARTUP_END(phase, ok)     do {} while (0)
+#endif
+
+/* forgets the phases recorded and starts the clock of the next ones, before the SDK is started */
+void        LITE_startup_reset(void);
+void        LITE_startup_begin(int phase);
+void        LITE_startup_end(int phase, int ok);
+/* the phase as recorded so far, NULL when it is not one */
+const lite_startup_phase_t *LITE_startup_phase(int phase);
+/* prints "startup <phase> <begin ms> <end ms> <took ms> <failures>" for each phase, '-' for what was not reached */
+void        LITE_startup_dump(void);
+const char *LITE_startup_name(int phase);
+
+#endif  /* __LITE_STARTUP_H__ */
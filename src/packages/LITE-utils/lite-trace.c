@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "lite-utils_internal.h"
+#include "lite-trace.h"
+
+static const char *trace_names[LITE_TRACE_ID_MAX] = {
+    "net_read",
+    "cmp_recv",
+    "tsl_set",
+    "queue_put",
+    "dispatch",
+    "serialize",
+    "cmp_send",
+    "net_write",
+};
+
+const char *LITE_trace_name(int id)
+{
+    return id >= 0 && id < LITE_TRACE_ID_MAX ? trace_names[id] : "unknown";
+}
+
+#if WITH_TRACE
+
+#define TRACE_RING_MASK         ((unsigned int)LITE_TRACE_RING_SIZE - 1)
+
+static lite_trace_point_t trace_ring[LITE_TRACE_RING_SIZE];
+/* points ever claimed, the next one goes to slot trace_next & TRACE_RING_MASK */
+static volatile int trace_next;
+/* where the next read starts, what is older than a ring behind trace_next is overwritten */
+static unsigned int trace_first;
+
+void LITE_trace(int id, uint32_t arg)
+{
+    lite_trace_point_t *point;
+
+    /* the slot is claimed in one step, the threads tracing at once fill different ones */
+    point = &trace_ring[((unsigned int)HAL_AtomicAdd(&trace_next, 1) - 1) & TRACE_RING_MASK];
+    point->us = HAL_UptimeUs();
+    point->arg = arg;
+    point->id = (uint32_t)id;
+}
+
+/* the first point to read and the number of them, at most a ring */
+static unsigned int trace_window(unsigned int *first)
+{
+    unsigned int next = (unsigned int)HAL_AtomicAdd(&trace_next, 0);
+
+    *first = trace_first;
+    if (next - *first > LITE_TRACE_RING_SIZE) {
+        *first = next - LITE_TRACE_RING_SIZE;
+    }
+
+    return next - *first;
+}
+
+int LITE_trace_read(lite_trace_point_t *points, int max)
+{
+    unsigned int first;
+    unsigned int num = trace_window(&first);
+    int i;
+
+    for (i = 0; i < max && (unsigned int)i < num; i++) {
+        points[i] = trace_ring[(first + i) & TRACE_RING_MASK];
+    }
+
+    return i;
+}
+
+void LITE_trace_dump(void)
+{
+    unsigned int first;
+    unsigned int num = trace_window(&first);
+    unsigned int i;
+    lite_trace_point_t *point;
+
+    for (i = 0; i < num; i++) {
+        point = &trace_ring[(first + i) & TRACE_RING_MASK];
+        UTILS_printf("trace %llu %s %u\r\n", (unsigned long long)point->us, LITE_trace_name((int)point->id),
+                     (unsigned int)point->arg);
+    }
+
+    trace_first = first + num;
+}
+
+#else
+
+void LITE_trace(int id, uint32_t arg)
+{
+}
+
+int LITE_trace_read(lite_trace_point_t *points, int max)
+{
+    return 0;
+}
+
+void LITE_trace_dump(void)
+{
+}
+
+#endif  /* #if WITH_TRACE */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LITE_TRACE_H__
+#define __LITE_TRACE_H__
+
+#include <stdint.h>
+
+#include "lite-utils_config.h"
+
+/*
+ * With WITH_TRACE, LITE_TRACE() puts {us of HAL_UptimeUs(), id, arg} in a ring of LITE_TRACE_RING_SIZE
+ * points, the oldest overwritten, from any thread and without a lock. Without it LITE_TRACE() is
+ * nothing and its arguments are not evaluated. LITE_trace_dump() prints the ring as the lines
+ * src/scripts/trace_latency.py makes the latencies of every stage of each message of.
+ */
+
+/* where a stage starts, arg is the alink id of the message but for the bytes of the net ones */
+typedef enum {
+    LITE_TRACE_NET_READ = 0,    /* bytes read from TCP or TLS, for MQTT to decode and CMP to dispatch */
+    LITE_TRACE_CMP_RECV,        /* cmp_register_handler() of DM routes a message of CMP */
+    LITE_TRACE_TSL_SET,         /* the properties of a property set go into the thing */
+    LITE_TRACE_QUEUE_PUT,       /* a callback of the message waits in the queue of linkkit */
+    LITE_TRACE_DISPATCH,        /* linkkit_dispatch() hands a callback to the application */
+    LITE_TRACE_SERIALIZE,       /* an uplink is serialized */
+    LITE_TRACE_CMP_SEND,        /* cmp_impl_send() hands the uplink to CMP for MQTT to encode */
+    LITE_TRACE_NET_WRITE,       /* bytes written to TCP or TLS, after the write */
+    LITE_TRACE_ID_MAX
+} lite_trace_id_t;
+
+typedef struct {
+    uint64_t            us;
+    uint32_t            arg;
+    uint32_t            id;
+} lite_trace_point_t;
+
+#if WITH_TRACE
+#define LITE_TRACE(id, arg)     LITE_trace((id), (uint32_t)(arg))
+#else
+#define LITE_TRACE(id, arg)     do {} while (0)
+#endif
+
+void        LITE_trace(int id, uint32_t arg);
+/* at most max of the points in the ring oldest first, the number copied */
+int         LITE_trace_read(lite_trace_point_t *points, int max);
+/* prints the ring as "trace <us> <stage> <arg>" lines and empties it */
+void        LITE_trace_dump(void);
+const char *LITE_trace_name(int id);
+
+#endif  /* __LITE_TRACE_H__ */
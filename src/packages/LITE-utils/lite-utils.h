@@ -80,6 +80,21 @@
         ptr = NULL; \
     } while(0)
 
+/* what LITE_malloc() counted, of one module or of all of them */
+typedef struct {
+    int         module_id;                  /* -1 for all modules */
+    char        module_name[32];
+    uint64_t    bytes_total_allocated;      /* since start, as are the freed bytes and the iterations */
+    uint64_t    bytes_total_freed;
+    int         bytes_total_in_use;
+    int         bytes_max_allocated;
+    int         bytes_max_in_use;
+    uint64_t    iterations_allocated;
+    uint64_t    iterations_freed;
+    int         iterations_in_use;
+    int         iterations_max_in_use;
+} lite_mem_stats_t;
+
 void       *LITE_malloc_internal(const char *f, const int l, int size, ...);
 void       *LITE_realloc_internal(const char *f, const int l, void *ptr, int size, ...);
 void        LITE_free_internal(void *ptr);
@@ -95,6 +110,10 @@ void        LITE_hexstr_convert(char *hexstr, uint8_t *out_buf, int len);
 void        LITE_replace_substr(char orig[], char key[], char swap[]);
 
 void        LITE_dump_malloc_free_stats(int level);
+int         LITE_get_malloc_bytes_in_use(void);
+int         LITE_get_malloc_module_id(const char *module_name);
+int         LITE_get_malloc_stats(int module_id, lite_mem_stats_t *stats);
+void        LITE_reset_malloc_max_in_use(void);
 void        LITE_track_malloc_callstack(int state);
 
 char           *LITE_json_value_of(char *key, char *src, ...);
@@ -103,6 +122,17 @@ list_head_t    *LITE_json_keys_of(char *src, char *prefix, ...);
 char           *LITE_json_value_of_ext(char *key, char *src, ...);
 char           *LITE_json_value_of_ext2(char *key, char *src, int src_len, int *value_len);
 
+/* what LITE_json_values_of() sets for a key, found at value in src and not copied */
+typedef struct {
+    const char     *key;            /* dotted path of object keys, like "payload.state.desired" */
+    char           *value;          /* NULL if not found, a string is without its quotes */
+    int             value_len;
+    int             value_type;     /* JSTRING, JOBJECT, ... of json_parser.h */
+} lite_json_view_t;
+
+/* resolve all keys of views in one pass over src, returns how many of them are found */
+int             LITE_json_values_of(char *src, int src_len, lite_json_view_t *views, int count);
+
 list_head_t    *LITE_json_keys_of_ext(char *src, char *prefix, ...);
 
 int             get_json_item_size(char *src, int src_len);
@@ -124,5 +154,8 @@ typedef struct _json_key_t {
 int unittest_string_utils(void);
 int unittest_json_parser(void);
 int unittest_json_token(void);
+int unittest_cbor(void);
+int unittest_json_stream(void);
+int unittest_number(void);
 
 #endif  /* __LITE_UTILS_H__ */
@@ -30,4 +30,96 @@
 #endif
 #endif
 
+/* LITE_malloc() from pools of blocks by size class, lite-slab.h, the classes in increasing size */
+#ifndef WITH_MEM_SLAB
+#define WITH_MEM_SLAB                       0
+#endif
+
+#ifndef LITE_SLAB_CLASSES
+#define LITE_SLAB_CLASSES                   16, 32, 64, 128, 256, 512
+#endif
+
+#ifndef LITE_SLAB_BLOCKS_PER_PAGE
+#define LITE_SLAB_BLOCKS_PER_PAGE           16
+#endif
+
+/* bytes in use the memory pressure levels of lite-mem-pressure.h begin at, 0 does not use one */
+#ifndef LITE_MEM_PRESSURE_HIGH_BYTES
+#if defined(WITH_TOTAL_COST_WARNING)
+#define LITE_MEM_PRESSURE_HIGH_BYTES        WITH_TOTAL_COST_WARNING
+#else
+#define LITE_MEM_PRESSURE_HIGH_BYTES        0
+#endif
+#endif
+
+#ifndef LITE_MEM_PRESSURE_CRITICAL_BYTES
+#define LITE_MEM_PRESSURE_CRITICAL_BYTES    0
+#endif
+
+#ifndef LITE_MEM_PRESSURE_HANDLERS_MAX
+#define LITE_MEM_PRESSURE_HANDLERS_MAX      4
+#endif
+
+/* one in this many allocations has its backtrace recorded, by default of LITE_track_malloc_callstack() */
+#ifndef WITH_MEM_STATS_BACKTRACE_SAMPLE
+#define WITH_MEM_STATS_BACKTRACE_SAMPLE     32
+#endif
+
+/* json_parser.c skips what is not a quote or bracket many bytes at a time, SSE2 or NEON where there is */
+#ifndef WITH_JSON_VECTOR_SCAN
+#define WITH_JSON_VECTOR_SCAN               1
+#endif
+
+/* log lines kept unformatted in a ring and formatted by a drain, lite-log-ring.h */
+#ifndef WITH_LOG_RING
+#define WITH_LOG_RING                       0
+#endif
+
+/* the drain runs in a thread of its own, or only in LITE_log_ring_drain() from the caller when 0 */
+#ifndef WITH_LOG_RING_THREAD
+#define WITH_LOG_RING_THREAD                1
+#endif
+
+#ifndef LITE_LOG_RING_STACK_SIZE
+#define LITE_LOG_RING_STACK_SIZE            4096
+#endif
+
+#ifndef LITE_LOG_RING_SIZE
+#define LITE_LOG_RING_SIZE                  4096
+#endif
+
+/* longest copy of a string argument, what is longer is cut */
+#ifndef LITE_LOG_RING_STRING_MAX
+#define LITE_LOG_RING_STRING_MAX            128
+#endif
+
+/* longest line the drain formats */
+#ifndef LITE_LOG_RING_LINE_MAX
+#define LITE_LOG_RING_LINE_MAX              256
+#endif
+
+/* timestamps of the stages of the messages kept in a ring, lite-trace.h, LITE_TRACE() is nothing when 0 */
+#ifndef WITH_TRACE
+#define WITH_TRACE                          0
+#endif
+
+/* points kept, a power of 2 */
+#ifndef LITE_TRACE_RING_SIZE
+#define LITE_TRACE_RING_SIZE                1024
+#endif
+
+/* counters, gauges and histograms of the modules in one registry, lite-metrics.h, the updates are nothing when 0 */
+#ifndef WITH_METRICS
+#define WITH_METRICS                        1
+#endif
+
+#ifndef LITE_METRICS_MAX
+#define LITE_METRICS_MAX                    32
+#endif
+
+/* when each phase of getting online began and ended, lite-startup.h, the marks are nothing when 0 */
+#ifndef WITH_STARTUP_PROFILE
+#define WITH_STARTUP_PROFILE                1
+#endif
+
 #endif  /* __LITE_UTILS_CONFIG_H__ */
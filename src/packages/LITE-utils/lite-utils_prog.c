@@ -21,9 +21,17 @@
 
 int main(void)
 {
-    unittest_string_utils();
-    unittest_json_token();
-    unittest_json_parser();
+    int             failed = 0;
 
-    return 0;
+    failed += (unittest_string_utils() != 0);
+    failed += (unittest_json_token() != 0);
+    failed += (unittest_json_parser() != 0);
+    failed += (unittest_cbor() != 0);
+    failed += (unittest_json_stream() != 0);
+    failed += (unittest_number() != 0);
+
+    if (failed) {
+        log_err("%d unittests failed", failed);
+    }
+    return failed ? 1 : 0;
 }
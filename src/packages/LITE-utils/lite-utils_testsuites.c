@@ -17,7 +17,12 @@
  */
 
 
+#include <limits.h>
+
 #include "lite-utils_internal.h"
+#include "lite-cbor.h"
+#include "lite-json-stream.h"
+#include "lite-number.h"
 
 int unittest_string_utils(void)
 {
@@ -151,6 +156,9 @@ int unittest_json_parser(void)
 {
     char           *val;
     char          **pkey;
+    lite_json_view_t views[16];
+    int             count;
+    int             i;
     char           *keys[] = {
         "data.iotToken",
         "data.iotId",
@@ -175,6 +183,195 @@ int unittest_json_parser(void)
         LITE_free(val);
     }
 
+    /* the same keys in one pass, each found where LITE_json_value_of() finds it */
+    for (count = 0; keys[count]; ++count) {
+        views[count].key = keys[count];
+    }
+    if (LITE_json_values_of(UNITTEST_JSON_SAMPLE, strlen(UNITTEST_JSON_SAMPLE), views, count) != count) {
+        log_err("failed to get values of all keys in one pass");
+        return -1;
+    }
+    for (i = 0; i < count; ++i) {
+        val = LITE_json_value_of((char *)views[i].key, UNITTEST_JSON_SAMPLE);
+        if (val == NULL || (int)strlen(val) != views[i].value_len || strncmp(val, views[i].value, views[i].value_len)) {
+            log_err("one pass value of key '%s' differs", views[i].key);
+            LITE_free(val);
+            return -1;
+        }
+        LITE_free(val);
+    }
+
+    return 0;
+}
+
+
+/* json texts equal but for the white space between their tokens */
+static int unittest_json_same(const char *a, const char *b)
+{
+    int             in_string = 0;
+
+    while (1) {
+        if (!in_string) {
+            while (*a == ' ' || *a == '\t' || *a == '\r' || *a == '\n') {
+                a++;
+            }
+            while (*b == ' ' || *b == '\t' || *b == '\r' || *b == '\n') {
+                b++;
+            }
+        }
+        if (*a != *b) {
+            return 0;
+        }
+        if (*a == '\0') {
+            return 1;
+        }
+        if (in_string && *a == '\\') {
+            a++;
+            b++;
+            if (*a != *b || *a == '\0') {
+                return 0;
+            }
+        } else if (*a == '"') {
+            in_string = !in_string;
+        }
+        a++;
+        b++;
+    }
+}
+
+int unittest_cbor(void)
+{
+    unsigned char       cbor[256];
+    char               *json;
+    lite_cbor_writer_t  writer;
+    int                 len;
+
+    LITE_cbor_writer_init(&writer, cbor, sizeof(cbor));
+    if (LITE_cbor_write_json(&writer, UNITTEST_JSON_SAMPLE, strlen(UNITTEST_JSON_SAMPLE)) != 0
+        || LITE_cbor_writer_truncated(&writer)) {
+        log_err("failed to encode json sample");
+        return -1;
+    }
+
+    len = LITE_cbor_to_json(cbor, LITE_cbor_writer_length(&writer), NULL, 0);
+    if (len < 0) {
+        log_err("failed to decode cbor sample");
+        return -1;
+    }
+    json = LITE_malloc(len + 1);
+    if (json == NULL) {
+        log_err("failed to allocate %d bytes", len + 1);
+        return -1;
+    }
+    if (LITE_cbor_to_json(cbor, LITE_cbor_writer_length(&writer), json, len + 1) != len) {
+        log_err("failed to decode cbor sample");
+        LITE_free(json);
+        return -1;
+    }
+
+    log_info("cbor %u bytes, json %u bytes: %s",
+             (unsigned int)LITE_cbor_writer_length(&writer), (unsigned int)strlen(UNITTEST_JSON_SAMPLE), json);
+    if (!unittest_json_same(json, UNITTEST_JSON_SAMPLE)) {
+        log_err("json of cbor sample differs from json sample");
+        LITE_free(json);
+        return -1;
+    }
+
+    LITE_free(json);
+    return 0;
+}
+
+static int unittest_json_stream_cb(char *p_cName, int iNameLen, char *p_cValue, int iValueLen, int iValueType,
+                                   void *p_Result)
+{
+    int        *count = (int *)p_Result;
+
+    log_info("%d: %s = '%s' (type %d)", ++*count, p_cName, p_cValue, iValueType);
+    return JSON_PARSE_OK;
+}
+
+int unittest_json_stream(void)
+{
+    lite_json_stream_t  stream;
+    char                value[64];
+    const char         *json = UNITTEST_JSON_SAMPLE;
+    int                 count = 0;
+    int                 len;
+    int                 i;
+
+    /* a byte at a time, the way the worst split of a download hands it over */
+    LITE_json_stream_init(&stream, value, sizeof(value), unittest_json_stream_cb, &count);
+    for (i = 0; json[i] != '\0'; i++) {
+        if (LITE_json_stream_feed(&stream, json + i, 1) != 0) {
+            log_err("failed to parse json sample at %d", i);
+            return -1;
+        }
+    }
+    if (LITE_json_stream_finish(&stream) != 0) {
+        log_err("failed to finish json sample");
+        return -1;
+    }
+
+    log_info("json stream, %d values", count);
+
+    /* again with objects and arrays and with strings too long for the buffer handed on in pieces */
+    count = 0;
+    LITE_json_stream_init(&stream, value, 8, unittest_json_stream_cb, &count);
+    LITE_json_stream_set_flags(&stream, LITE_JSON_STREAM_CONTAINERS | LITE_JSON_STREAM_PIECES);
+    for (i = 0; json[i] != '\0'; i += len) {
+        len = strlen(json + i) < 5 ? (int)strlen(json + i) : 5;
+        if (LITE_json_stream_feed(&stream, json + i, len) != 0) {
+            log_err("failed to parse json sample in pieces at %d", i);
+            return -1;
+        }
+    }
+    if (LITE_json_stream_finish(&stream) != 0) {
+        log_err("failed to finish json sample in pieces");
+        return -1;
+    }
+
+    log_info("json stream in pieces, %d events", count);
+
     return 0;
 }
 
+int unittest_number(void)
+{
+    const double        values[] = { 0, 0.1, -2.5, 13.92, 1e-7, 123456.789, 1.7976931348623157e308 };
+    /* the binary value is off half way, above or below it, only its exact digits round these as printf() */
+    const double        halves[] = { 3.85, 0.95, 1.95, 0.805, 2.335, 0.125, -0.05, 0.003, 9007199254740993.0 };
+    char                buf[LITE_NUMBER_LEN_MAX];
+    char                fixed[LITE_NUMBER_LEN_MAX];
+    int                 precise;
+    int                 i;
+
+    for (i = 0; i < (int)(sizeof(values) / sizeof(values[0])); i++) {
+        LITE_format_double(buf, values[i]);
+        if (LITE_parse_double(buf, NULL) != values[i] || strtod(buf, NULL) != values[i]) {
+            log_err("%s is not read back as %.17g", buf, values[i]);
+            return -1;
+        }
+        LITE_format_fixed(fixed, values[i], 2);
+        log_info("%.17g: shortest %s, fixed %s", values[i], buf, fixed);
+    }
+
+    for (i = 0; i < (int)(sizeof(halves) / sizeof(halves[0])); i++) {
+        for (precise = 0; precise <= 16; precise++) {
+            LITE_format_fixed(fixed, halves[i], precise);
+            HAL_Snprintf(buf, sizeof(buf), "%.*f", precise, halves[i]);
+            if (strcmp(fixed, buf)) {
+                log_err("%.17g to %d decimals is %s, printf() gives %s", halves[i], precise, fixed, buf);
+                return -1;
+            }
+        }
+    }
+
+    LITE_format_llong(buf, -9223372036854775807LL - 1);
+    if (strcmp(buf, "-9223372036854775808") || LITE_parse_llong(buf, NULL) != -9223372036854775807LL - 1
+        || LITE_parse_int(buf, NULL) != INT_MIN) {
+        log_err("failed to format and parse %s", buf);
+        return -1;
+    }
+
+    return 0;
+}
@@ -31,42 +31,88 @@ typedef struct {
 } calling_stack_t;
 
 typedef struct {
-    char module_name[32];
-    calling_stack_t calling_stack;
-
-    int bytes_total_allocated;
-    int bytes_total_freed;
-    int bytes_total_in_use;
-    int bytes_max_allocated;
-    int bytes_max_in_use;
-    int iterations_allocated;
-    int iterations_freed;
-    int iterations_in_use;
-    int iterations_max_in_use;
-} mem_statis_t;
-
-typedef struct {
-    mem_statis_t    mem_statis;
-    list_head_t     list;
+    lite_mem_stats_t    mem_statis;
+    calling_stack_t     calling_stack;
+    list_head_t         list;
 } module_mem_t;
 
+static int mem_module_count;
+
+/*
+ * The module of a name pointer looked up before, found again without strcmp(). Module names are
+ * string literals, a buffer holding another name later at the same address would be counted wrong.
+ */
+#define MEM_MODULE_CACHE_SIZE   (32)
+static struct {
+    const char     *name;
+    module_mem_t   *module;
+} mem_module_cache[MEM_MODULE_CACHE_SIZE];
+
 #endif
 
 #if WITH_MEM_STATS
-    static int bytes_total_allocated;
-    static int bytes_total_freed;
-    static int bytes_total_in_use;
-    static int bytes_max_allocated;
-    static int bytes_max_in_use;
-    static int iterations_allocated;
-    static int iterations_freed;
-    static int iterations_in_use;
-    static int iterations_max_in_use;
+/* the counters, the records and the modules, shared by the threads allocating */
+static lite_mem_stats_t mem_stats_total = { -1, "all" };
+static void *mem_stats_lock;
+
+static void _mem_stats_lock(void)
+{
+    /* the first allocation is made before other threads are started */
+    if (NULL == mem_stats_lock) {
+        mem_stats_lock = HAL_MutexCreate();
+    }
+    if (mem_stats_lock) {
+        HAL_MutexLock(mem_stats_lock);
+    }
+}
+
+static void _mem_stats_unlock(void)
+{
+    if (mem_stats_lock) {
+        HAL_MutexUnlock(mem_stats_lock);
+    }
+}
+
+static void _mem_stats_count_malloc(lite_mem_stats_t *stats, int size)
+{
+    stats->iterations_allocated += 1;
+    stats->bytes_total_allocated += size;
+    stats->bytes_total_in_use += size;
+    stats->bytes_max_in_use = LITE_MAXIMUM(stats->bytes_max_in_use, stats->bytes_total_in_use);
+    stats->bytes_max_allocated = LITE_MAXIMUM(stats->bytes_max_allocated, size);
+
+    stats->iterations_in_use += 1;
+    stats->iterations_max_in_use = LITE_MAXIMUM(stats->iterations_max_in_use, stats->iterations_in_use);
+}
+
+static void _mem_stats_count_free(lite_mem_stats_t *stats, int size)
+{
+    stats->iterations_freed += 1;
+    stats->iterations_in_use -= 1;
+
+    stats->bytes_total_freed += size;
+    stats->bytes_total_in_use -= size;
+}
+
+static void _mem_stats_print(const lite_mem_stats_t *stats)
+{
+    LITE_printf("---------------------------------------------------\r\n");
+    LITE_printf(". bytes_total_allocated:    %llu\r\n", (unsigned long long)stats->bytes_total_allocated);
+    LITE_printf(". bytes_total_freed:        %llu\r\n", (unsigned long long)stats->bytes_total_freed);
+    LITE_printf(". bytes_total_in_use:       %d\r\n", stats->bytes_total_in_use);
+    LITE_printf(". bytes_max_allocated:      %d\r\n", stats->bytes_max_allocated);
+    LITE_printf(". bytes_max_in_use:         %d\r\n", stats->bytes_max_in_use);
+    LITE_printf(". iterations_allocated:     %llu\r\n", (unsigned long long)stats->iterations_allocated);
+    LITE_printf(". iterations_freed:         %llu\r\n", (unsigned long long)stats->iterations_freed);
+    LITE_printf(". iterations_in_use:        %d\r\n", stats->iterations_in_use);
+    LITE_printf(". iterations_max_in_use:    %d\r\n", stats->iterations_max_in_use);
+    LITE_printf("---------------------------------------------------\r\n");
+}
 #endif
 
 #if defined(_PLATFORM_IS_LINUX_) && (WITH_MEM_STATS)
 
-static int tracking_malloc_callstack = 1;
+static int tracking_malloc_callstack = WITH_MEM_STATS_BACKTRACE_SAMPLE;
 
 static int record_backtrace(int *level, char *** trace)
 {
@@ -84,9 +130,13 @@ static int record_backtrace(int *level, char *** trace)
     return 0;
 }
 
+/*
+ * 0 records no backtrace, N records one for one in N allocations, 1 for all of them: backtrace_symbols()
+ * costs far more than the allocation. Those over WITH_ALLOC_WARNING_THRESHOLD are traced unless it is 0.
+ */
 void LITE_track_malloc_callstack(int state)
 {
-    tracking_malloc_callstack = state;
+    tracking_malloc_callstack = state < 0 ? 0 : state;
 }
 
 #else
@@ -102,6 +152,7 @@ void *LITE_realloc_internal(const char *f, const int l, void *ptr, int size, ...
 #if WITH_MEM_STATS
 
     void               *temp = NULL;
+    OS_malloc_record   *pos = NULL;
     int                 magic = 0;
     char               *module_name = NULL;
 
@@ -128,7 +179,13 @@ void *LITE_realloc_internal(const char *f, const int l, void *ptr, int size, ...
     }
 
     if (ptr) {
-        memcpy(temp, ptr, size);
+        /* no more than the old buffer holds */
+        pos = (OS_malloc_record *)((char *)ptr - MEM_STATS_RECORD_LEN);
+        if (MEM_STATS_RECORD_MAGIC == pos->magic && pos->buf == ptr && pos->buflen < size) {
+            memcpy(temp, ptr, pos->buflen);
+        } else {
+            memcpy(temp, ptr, size);
+        }
 
         LITE_free(ptr);
 
@@ -137,7 +194,7 @@ void *LITE_realloc_internal(const char *f, const int l, void *ptr, int size, ...
     return temp;
 
 #else
-    return realloc(ptr, size);
+    return LITE_slab_realloc(ptr, size);
 #endif
 }
 
@@ -155,9 +212,10 @@ void *_create_mem_table(char *module_name, struct list_head *list_head)
         return NULL;
     }
     memset(pos, 0, sizeof(module_mem_t));
-    strncpy(pos->mem_statis.module_name, module_name, sizeof(pos->mem_statis.module_name));
+    strncpy(pos->mem_statis.module_name, module_name, sizeof(pos->mem_statis.module_name) - 1);
+    pos->mem_statis.module_id = mem_module_count++;
 
-    INIT_LIST_HEAD(&pos->mem_statis.calling_stack.func_head);
+    INIT_LIST_HEAD(&pos->calling_stack.func_head);
 
     list_add_tail(&pos->list, list_head);
     return (void *)pos;
@@ -187,9 +245,18 @@ int _del_mem_table(char *module_name, struct list_head *list_head)
 
     calling_stack_t *calling_stack_pos = NULL, *tmp = NULL;
     module_mem_t *table_pos = (module_mem_t *)_find_mem_table(module_name, list_head);
+    int i;
+
     if (table_pos) {
+        for (i = 0; i < MEM_MODULE_CACHE_SIZE; i++) {
+            if (mem_module_cache[i].module == table_pos) {
+                mem_module_cache[i].name = NULL;
+                mem_module_cache[i].module = NULL;
+            }
+        }
+
         list_for_each_entry_safe(calling_stack_pos, tmp, \
-                                 &table_pos->mem_statis.calling_stack.func_head, func_head, calling_stack_t) {
+                                 &table_pos->calling_stack.func_head, func_head, calling_stack_t) {
             if (calling_stack_pos) {
                 list_del(&calling_stack_pos->func_head);
                 if (calling_stack_pos->func_name) {
@@ -209,35 +276,50 @@ int _del_mem_table(char *module_name, struct list_head *list_head)
     return ret;
 }
 
-int _count_malloc_internal(const char *f, const int l, OS_malloc_record *os_malloc_pos, va_list ap)
+/* the module of a name, registered with the next id the first time it is seen */
+static module_mem_t *_lookup_mem_table(char *module_name)
+{
+    unsigned int slot = (unsigned int)(((uintptr_t)module_name >> 2) % MEM_MODULE_CACHE_SIZE);
+    module_mem_t *pos = NULL;
+
+    if (mem_module_cache[slot].name == module_name) {
+        return mem_module_cache[slot].module;
+    }
+
+    pos = (module_mem_t *)_find_mem_table(module_name, &mem_module_statis);
+    if (!pos) {
+        if (NULL == (pos = (module_mem_t *)_create_mem_table(module_name, &mem_module_statis))) {
+            log_err("create_mem_table:[%s] failed!", module_name);
+            return NULL;
+        }
+    }
+
+    mem_module_cache[slot].name = module_name;
+    mem_module_cache[slot].module = pos;
+    return pos;
+}
+
+int _count_malloc_internal(const char *f, const int l, OS_malloc_record *os_malloc_pos, int magic, char *module_name)
 {
     int ret = -1;
 
-    int magic = 0;
     char is_repeat = 0;
-    char *module_name = NULL;
     module_mem_t *pos = NULL;
     calling_stack_t    *call_pos, *call_tmp;
     calling_stack_t    *entry = NULL;
 
-    magic = va_arg(ap, int);
-    if (MEM_MAGIC == magic) {
-        module_name = va_arg(ap, char *);
-    } else {
+    if (MEM_MAGIC != magic || !module_name) {
         module_name = "unknown";
     }
 
-    pos = (module_mem_t *)_find_mem_table(module_name, &mem_module_statis);
+    pos = _lookup_mem_table(module_name);
     if (!pos) {
-        if (NULL == (pos = (module_mem_t *)_create_mem_table(module_name, &mem_module_statis))) {
-            log_err("create_mem_table:[%s] failed!", module_name);
-            return ret;
-        }
+        return ret;
     }
     os_malloc_pos->mem_table = (void *)pos;
 
     if (!strcmp(pos->mem_statis.module_name, "unknown")) {
-        list_for_each_entry_safe(call_pos, call_tmp, &pos->mem_statis.calling_stack.func_head, func_head, calling_stack_t) {
+        list_for_each_entry_safe(call_pos, call_tmp, &pos->calling_stack.func_head, func_head, calling_stack_t) {
             if (!strcmp(call_pos->func_name, f) && (call_pos->line == l)) {
                 is_repeat = 1;
                 break;
@@ -252,21 +334,11 @@ int _count_malloc_internal(const char *f, const int l, OS_malloc_record *os_mall
             memset(entry, 0, sizeof(calling_stack_t));
             entry->func_name = strdup(f);
             entry->line = l;
-            list_add(&entry->func_head, &pos->mem_statis.calling_stack.func_head);
+            list_add(&entry->func_head, &pos->calling_stack.func_head);
         }
     }
 
-    pos->mem_statis.iterations_allocated += 1;
-    pos->mem_statis.bytes_total_allocated += os_malloc_pos->buflen;
-    pos->mem_statis.bytes_total_in_use += os_malloc_pos->buflen;
-    pos->mem_statis.bytes_max_in_use = (pos->mem_statis.bytes_max_in_use > pos->mem_statis.bytes_total_in_use) ?
-                                       pos->mem_statis.bytes_max_in_use : pos->mem_statis.bytes_total_in_use;
-    pos->mem_statis.bytes_max_allocated = (pos->mem_statis.bytes_max_allocated >= os_malloc_pos->buflen) ?
-                                          pos->mem_statis.bytes_max_allocated : os_malloc_pos->buflen;
-
-    pos->mem_statis.iterations_in_use += 1;
-    pos->mem_statis.iterations_max_in_use = (pos->mem_statis.iterations_in_use > pos->mem_statis.iterations_max_in_use) ?
-                                            pos->mem_statis.iterations_in_use : pos->mem_statis.iterations_max_in_use;
+    _mem_stats_count_malloc(&pos->mem_statis, os_malloc_pos->buflen);
     ret = 0;
 
     return ret;
@@ -283,73 +355,73 @@ void  _count_free_internal(void *ptr, OS_malloc_record *os_malloc_pos)
         return;
     }
 
-    pos->mem_statis.iterations_freed += 1;
-    pos->mem_statis.iterations_in_use -= 1;
-
-    pos->mem_statis.bytes_total_freed += os_malloc_pos->buflen;
-    pos->mem_statis.bytes_total_in_use -= os_malloc_pos->buflen;
-
+    _mem_stats_count_free(&pos->mem_statis, os_malloc_pos->buflen);
 }
 
 #endif
 
-void *LITE_malloc_internal(const char *f, const int l, int size, ...)
+/* only calloc() asks for the buffer zeroed, what LITE_malloc() hands out always was */
+static void *_malloc_internal(const char *f, const int l, int size, int zeroed, int magic, char *module_name)
 {
     void                   *ptr = NULL;
 #if WITH_MEM_STATS
     OS_malloc_record       *pos;
+    int                     traced = 0;
+    int                     in_use;
 
     if (size <= 0) {
         return NULL;
     }
 
-    ptr = UTILS_malloc(size);
-    if (!ptr) {
+    pos = LITE_slab_malloc(MEM_STATS_RECORD_LEN + size);
+    if (!pos) {
         return NULL;
     }
+    ptr = (char *)pos + MEM_STATS_RECORD_LEN;
 
-    iterations_allocated += 1;
-    bytes_total_allocated += size;
-    bytes_total_in_use += size;
-    bytes_max_in_use = (bytes_max_in_use > bytes_total_in_use) ? bytes_max_in_use : bytes_total_in_use;
-    bytes_max_allocated = (bytes_max_allocated >= size) ? bytes_max_allocated : size;
-
-#if defined(WITH_TOTAL_COST_WARNING)
-    if (bytes_total_in_use > WITH_TOTAL_COST_WARNING) {
-        log_debug(" ");
-        log_debug("==== PRETTY HIGH TOTAL IN USE: %d BYTES ====", bytes_total_in_use);
-        LITE_dump_malloc_free_stats(LOG_DEBUG_LEVEL);
-    }
-#endif
-
-    iterations_in_use += 1;
-    iterations_max_in_use = (iterations_in_use > iterations_max_in_use) ? iterations_in_use : iterations_max_in_use;
-
-    pos = UTILS_malloc(sizeof(OS_malloc_record));
-    if (NULL == pos) {
-        UTILS_free(ptr);
-        return NULL;
-    }
     memset(pos, 0, sizeof(OS_malloc_record));
 
+    pos->magic = MEM_STATS_RECORD_MAGIC;
     pos->buf = ptr;
     pos->buflen = size;
     pos->func = (char *)f;
     pos->line = (int)l;
+
+    _mem_stats_lock();
+    _mem_stats_count_malloc(&mem_stats_total, size);
+    in_use = mem_stats_total.bytes_total_in_use;
+
+#if WITH_MEM_STATS_PER_MODULE
+    _count_malloc_internal(f, l, pos, magic, module_name);
+#endif
+
 #if defined(_PLATFORM_IS_LINUX_)
-    if (tracking_malloc_callstack) {
+    traced = tracking_malloc_callstack && 0 == mem_stats_total.iterations_allocated % tracking_malloc_callstack;
+#if defined(WITH_ALLOC_WARNING_THRESHOLD)
+    traced = traced || (tracking_malloc_callstack && size > WITH_ALLOC_WARNING_THRESHOLD);
+#endif
+#endif
+    if (!traced) {
+        list_add_tail(&pos->list, &mem_recs);
+    }
+    _mem_stats_unlock();
+
+#if defined(_PLATFORM_IS_LINUX_)
+    /* not holding the lock, the record is not in the list before its backtrace is */
+    if (traced) {
         record_backtrace(&pos->bt_level, &pos->bt_symbols);
+        _mem_stats_lock();
+        list_add_tail(&pos->list, &mem_recs);
+        _mem_stats_unlock();
     }
 #endif
 
-    list_add_tail(&pos->list, &mem_recs);
-
-#if WITH_MEM_STATS_PER_MODULE
-    va_list                 ap;
-    va_start(ap, size);
-    _count_malloc_internal(f, l, pos, ap);
-    va_end(ap);
-#endif
+    /* once each time the level goes up, the handlers are called from LITE_mem_pressure_poll() */
+    if (LITE_mem_pressure_count(in_use)) {
+        log_debug(" ");
+        log_debug("==== PRETTY HIGH TOTAL IN USE: %d BYTES, MEMORY PRESSURE %d ====", in_use, LITE_mem_pressure_level());
+        LITE_dump_malloc_free_stats(LOG_DEBUG_LEVEL);
+    }
 
 #if defined(WITH_ALLOC_WARNING_THRESHOLD)
     if (size > WITH_ALLOC_WARNING_THRESHOLD) {
@@ -376,46 +448,65 @@ void *LITE_malloc_internal(const char *f, const int l, int size, ...)
     }
 #endif
 
-    memset(ptr, 0, size);
+    if (zeroed) {
+        memset(ptr, 0, size);
+    }
     return ptr;
 #else
-    ptr = UTILS_malloc(size);
+    ptr = LITE_slab_malloc(size);
     if (NULL == ptr) {
         return NULL;
     }
-    memset(ptr, 0, size);
+    if (zeroed) {
+        memset(ptr, 0, size);
+    }
     return ptr;
 #endif
 }
 
+void *LITE_malloc_internal(const char *f, const int l, int size, ...)
+{
+    int magic = 0;
+    char *module_name = NULL;
+
+#if WITH_MEM_STATS_PER_MODULE
+
+    va_list ap;
+    va_start(ap, size);
+    magic = va_arg(ap, int);
+    if (MEM_MAGIC == magic) {
+        module_name = va_arg(ap, char *);
+    }
+    va_end(ap);
+#endif
+
+    return _malloc_internal(f, l, size, 1, magic, module_name);
+}
+
 void LITE_free_internal(void *ptr)
 {
 #if WITH_MEM_STATS
     OS_malloc_record       *pos;
+    int                     in_use;
 
     if (!ptr) {
         return;
     }
 
-    pos = NULL;
-    list_for_each_entry(pos, &mem_recs, list, OS_malloc_record) {
-        if (pos->buf == ptr) {
-            break;
-        }
-    }
-
-    if (NULL == pos) {
+    pos = (OS_malloc_record *)((char *)ptr - MEM_STATS_RECORD_LEN);
+    if (MEM_STATS_RECORD_MAGIC != pos->magic || pos->buf != ptr) {
         log_warning("Cannot find %p allocated! Skip stat ...", ptr);
     } else {
-        iterations_freed += 1;
-        iterations_in_use -= 1;
-
-        bytes_total_freed += pos->buflen;
-        bytes_total_in_use -= pos->buflen;
-
+        _mem_stats_lock();
+        _mem_stats_count_free(&mem_stats_total, pos->buflen);
+        in_use = mem_stats_total.bytes_total_in_use;
 #if WITH_MEM_STATS_PER_MODULE
         _count_free_internal(ptr, pos);
 #endif
+        list_del(&pos->list);
+        _mem_stats_unlock();
+
+        LITE_mem_pressure_count(in_use);
 
         if (pos->buf && pos->buflen > 0) {
             memset(pos->buf, 0xEE, pos->buflen);
@@ -429,12 +520,13 @@ void LITE_free_internal(void *ptr)
         UTILS_free(pos->bt_symbols);
         pos->bt_symbols = 0;
 #endif
+        pos->magic = 0;
 
-        list_del(&pos->list);
-        UTILS_free(pos);
+        LITE_slab_free(pos);
+        return;
     }
 #endif
-    UTILS_free(ptr);
+    LITE_slab_free(ptr);
 }
 
 void *LITE_malloc_routine(int size, ...)
@@ -453,7 +545,8 @@ void *LITE_malloc_routine(int size, ...)
     va_end(ap);
 #endif
 
-    return LITE_malloc(size, magic, module_name);
+    /* a malloc() for code that zeroes what it needs itself */
+    return _malloc_internal(__func__, __LINE__, size, 0, magic, module_name);
 }
 
 void *LITE_calloc_routine(size_t n, size_t s, ...)
@@ -472,7 +565,11 @@ void *LITE_calloc_routine(size_t n, size_t s, ...)
     va_end(ap);
 #endif
 
-    return LITE_malloc(n * s, magic, module_name);;
+    if (s && n > (size_t)0x7FFFFFFF / s) {
+        return NULL;
+    }
+
+    return _malloc_internal(__func__, __LINE__, (int)(n * s), 1, magic, module_name);
 }
 
 void LITE_free_routine(void *ptr)
@@ -480,6 +577,92 @@ void LITE_free_routine(void *ptr)
     LITE_free(ptr);
 }
 
+/* bytes LITE_malloc() handed out and not freed yet, 0 without WITH_MEM_STATS */
+int LITE_get_malloc_bytes_in_use(void)
+{
+#if WITH_MEM_STATS
+    return mem_stats_total.bytes_total_in_use;
+#else
+    return 0;
+#endif
+}
+
+/* the id a module is counted by, registered with the next one the first time, -1 without WITH_MEM_STATS_PER_MODULE */
+int LITE_get_malloc_module_id(const char *module_name)
+{
+#if WITH_MEM_STATS && WITH_MEM_STATS_PER_MODULE
+    module_mem_t *pos;
+    int id = -1;
+
+    if (!module_name) {
+        return -1;
+    }
+
+    _mem_stats_lock();
+    pos = _lookup_mem_table((char *)module_name);
+    if (pos) {
+        id = pos->mem_statis.module_id;
+    }
+    _mem_stats_unlock();
+
+    return id;
+#else
+    return -1;
+#endif
+}
+
+/*
+ * A copy of the counters of a module by its id, or of all of them with -1. The ids go from 0 up to the
+ * modules registered, -1 is returned past the last one or without WITH_MEM_STATS.
+ */
+int LITE_get_malloc_stats(int module_id, lite_mem_stats_t *stats)
+{
+#if WITH_MEM_STATS
+    int ret = -1;
+
+    if (!stats) {
+        return -1;
+    }
+
+    _mem_stats_lock();
+    if (module_id < 0) {
+        *stats = mem_stats_total;
+        ret = 0;
+    }
+#if WITH_MEM_STATS_PER_MODULE
+    else {
+        module_mem_t *pos;
+
+        list_for_each_entry(pos, &mem_module_statis, list, module_mem_t) {
+            if (pos->mem_statis.module_id == module_id) {
+                *stats = pos->mem_statis;
+                ret = 0;
+                break;
+            }
+        }
+    }
+#endif
+    _mem_stats_unlock();
+
+    return ret;
+#else
+    (void)module_id;
+    (void)stats;
+    return -1;
+#endif
+}
+
+/* restart bytes_max_in_use and iterations_max_in_use of the totals, module -1, from what is in use now */
+void LITE_reset_malloc_max_in_use(void)
+{
+#if WITH_MEM_STATS
+    _mem_stats_lock();
+    mem_stats_total.bytes_max_in_use = mem_stats_total.bytes_total_in_use;
+    mem_stats_total.iterations_max_in_use = mem_stats_total.iterations_in_use;
+    _mem_stats_unlock();
+#endif
+}
+
 void LITE_dump_malloc_free_stats(int level)
 {
 #if WITH_MEM_STATS
@@ -489,18 +672,10 @@ void LITE_dump_malloc_free_stats(int level)
         return;
     }
 
+    _mem_stats_lock();
+
     LITE_printf("\r\n");
-    LITE_printf("---------------------------------------------------\r\n");
-    LITE_printf(". bytes_total_allocated:    %d\r\n", bytes_total_allocated);
-    LITE_printf(". bytes_total_freed:        %d\r\n", bytes_total_freed);
-    LITE_printf(". bytes_total_in_use:       %d\r\n", bytes_total_in_use);
-    LITE_printf(". bytes_max_allocated:      %d\r\n", bytes_max_allocated);
-    LITE_printf(". bytes_max_in_use:         %d\r\n", bytes_max_in_use);
-    LITE_printf(". iterations_allocated:     %d\r\n", iterations_allocated);
-    LITE_printf(". iterations_freed:         %d\r\n", iterations_freed);
-    LITE_printf(". iterations_in_use:        %d\r\n", iterations_in_use);
-    LITE_printf(". iterations_max_in_use:    %d\r\n", iterations_max_in_use);
-    LITE_printf("---------------------------------------------------\r\n");
+    _mem_stats_print(&mem_stats_total);
 
 #if WITH_MEM_STATS_PER_MODULE
 
@@ -510,17 +685,7 @@ void LITE_dump_malloc_free_stats(int level)
     list_for_each_entry_safe(module_pos, tmp, &mem_module_statis, list, module_mem_t) {
         if (module_pos) {
             LITE_printf("\x1B[1;32mMODULE_NAME: [%s]\x1B[0m\r\n", module_pos->mem_statis.module_name);
-            LITE_printf("---------------------------------------------------\r\n");
-            LITE_printf(". bytes_total_allocated:    %d\r\n", module_pos->mem_statis.bytes_total_allocated);
-            LITE_printf(". bytes_total_freed:        %d\r\n", module_pos->mem_statis.bytes_total_freed);
-            LITE_printf(". bytes_total_in_use:       %d\r\n", module_pos->mem_statis.bytes_total_in_use);
-            LITE_printf(". bytes_max_allocated:      %d\r\n", module_pos->mem_statis.bytes_max_allocated);
-            LITE_printf(". bytes_max_in_use:         %d\r\n", module_pos->mem_statis.bytes_max_in_use);
-            LITE_printf(". iterations_allocated:     %d\r\n", module_pos->mem_statis.iterations_allocated);
-            LITE_printf(". iterations_freed:         %d\r\n", module_pos->mem_statis.iterations_freed);
-            LITE_printf(". iterations_in_use:        %d\r\n", module_pos->mem_statis.iterations_in_use);
-            LITE_printf(". iterations_max_in_use:    %d\r\n", module_pos->mem_statis.iterations_max_in_use);
-            LITE_printf("---------------------------------------------------\r\n");
+            _mem_stats_print(&module_pos->mem_statis);
 
             if (!strcmp(module_pos->mem_statis.module_name, "unknown")) {
                 unknown_mod = module_pos;
@@ -534,7 +699,7 @@ void LITE_dump_malloc_free_stats(int level)
         LITE_printf("\x1B[1;33mMissing module-name references:\x1B[0m\r\n");
         LITE_printf("---------------------------------------------------\r\n");
 
-        list_for_each_entry_safe(call_pos, tmp, &unknown_mod->mem_statis.calling_stack.func_head, func_head, calling_stack_t) {
+        list_for_each_entry_safe(call_pos, tmp, &unknown_mod->calling_stack.func_head, func_head, calling_stack_t) {
             if (call_pos->func_name) {
                 LITE_printf(". \x1B[1;31m%s \x1B[0m Ln:%d\r\n", call_pos->func_name, call_pos->line);
             }
@@ -590,6 +755,8 @@ void LITE_dump_malloc_free_stats(int level)
             }
         }
     }
+
+    _mem_stats_unlock();
 #else
     log_err("WITH_MEM_STATS = %d", WITH_MEM_STATS);
 #endif  /* #if WITH_MEM_STATS */
@@ -21,12 +21,21 @@
 #define __MEM_STATS_H__
 
 #include "lite-utils_internal.h"
+#include "lite-slab.h"
+#include "lite-mem-pressure.h"
 
 #if defined(_PLATFORM_IS_LINUX_) && WITH_MEM_STATS
     #include <execinfo.h>
 #endif
 
+/*
+ * The record of an allocation is in front of its buffer, in the same block of UTILS_malloc(), for
+ * LITE_free_internal() to find it at once. 'magic' and 'buf' tell a buffer of LITE_malloc() from another.
+ */
+#define MEM_STATS_RECORD_MAGIC  (0x4C4D5353)
+
 typedef struct {
+    uint32_t            magic;
     void               *buf;
     int                 buflen;
     char               *func;
@@ -42,5 +51,8 @@ typedef struct {
 #endif
 } OS_malloc_record;
 
+/* the buffer follows the record as aligned as UTILS_malloc() aligns blocks */
+#define MEM_STATS_RECORD_LEN    ((sizeof(OS_malloc_record) + 15) & ~(size_t)15)
+
 #endif  /* __MEM_STATS_H__ */
 
@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "CoAPBlock.h"
+
+#define COAP_BLOCK_MAX_SZX        COAP_BLOCK_SZX_1024
+#define COAP_BLOCK_MAX_NUM        0xFFFFF
+
+#define CoAPSuccessMsg(code)\
+    (((code) >> 5) == 2)
+
+typedef struct
+{
+    CoAPContext             *context;
+    CoAPMsgHeader            header;
+    unsigned char            token[COAP_MSG_MAX_TOKEN_LEN];
+    CoAPMsgOption            options[COAP_MSG_MAX_OPTION_NUM];  /* absolute numbers, values stored after the transfer */
+    unsigned char            optnum;
+    unsigned char            szx;
+    unsigned char            block1_more;   /* last Block1 sent has more blocks after it */
+    unsigned int             block1_num;
+    unsigned int             block2_num;
+    unsigned char           *blockbuf;
+    CoAPBlockReadHandler     reader;
+    CoAPBlockWriteHandler    writer;
+    CoAPRespMsgHandler       handler;
+    void                    *user;
+} CoAPBlockTransfer;
+
+static void CoAPBlock_handler(void *data, void *p_message);
+
+int CoAPBlockOption_get(CoAPMessage *message, unsigned short optnum,
+                        unsigned int *num, unsigned char *more, unsigned char *szx)
+{
+    int ret = COAP_SUCCESS;
+    unsigned int value = 0;
+
+    if (NULL == message || NULL == num || NULL == more || NULL == szx) {
+        return COAP_ERROR_NULL;
+    }
+
+    ret = CoAPUintOption_get(message, optnum, &value);
+    if (COAP_SUCCESS != ret) {
+        return ret;
+    }
+    if (0xFFFFFF < value) {
+        return COAP_ERROR_INVALID_LENGTH;
+    }
+    *num  = value >> 4;
+    *more = (value >> 3) & 0x01;
+    *szx  = value & 0x07;
+
+    return (7 == *szx) ? COAP_ERROR_INVALID_PARAM : COAP_SUCCESS;
+}
+
+static int CoAPBlockOption_encode(unsigned char *buf, unsigned int num, unsigned char more, unsigned char szx)
+{
+    unsigned int value = (num << 4) | ((more & 0x01) << 3) | (szx & 0x07);
+
+    if (0 == value) {
+        return 0;
+    } else if (0xFF >= value) {
+        buf[0] = (unsigned char)value;
+        return 1;
+    } else if (0xFFFF >= value) {
+        buf[0] = (unsigned char)(value >> 8);
+        buf[1] = (unsigned char)value;
+        return 2;
+    }
+    buf[0] = (unsigned char)(value >> 16);
+    buf[1] = (unsigned char)(value >> 8);
+    buf[2] = (unsigned char)value;
+    return 3;
+}
+
+/* options are referenced, not copied, the message must not be destroyed */
+static int CoAPBlockOption_put(CoAPMessage *message, unsigned short optnum, unsigned char *val, unsigned short len)
+{
+    if (COAP_MSG_MAX_OPTION_NUM <= message->optnum) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    message->options[message->optnum].num = optnum - message->optdelta;
+    message->options[message->optnum].len = len;
+    message->options[message->optnum].val = val;
+    message->optdelta = optnum;
+    message->optnum ++;
+
+    return COAP_SUCCESS;
+}
+
+static void CoAPBlockTransfer_finish(CoAPBlockTransfer *transfer, CoAPMessage *message)
+{
+    CoAPRespMsgHandler handler = transfer->handler;
+    void *user = transfer->user;
+
+    coap_free(transfer);
+    if (NULL != handler) {
+        handler(user, message);
+    }
+}
+
+/* one block request, the template options with Block1 and Block2 merged in by number */
+static int CoAPBlockTransfer_send(CoAPBlockTransfer *transfer, int block1, unsigned char *payload,
+                                  unsigned short payloadlen, int block2)
+{
+    int i = 0;
+    int ret = COAP_SUCCESS;
+    CoAPMessage message;
+    unsigned char block1_val[3];
+    unsigned char block2_val[3];
+    unsigned short block1_len = 0;
+    unsigned short block2_len = 0;
+
+    if (block1) {
+        block1_len = CoAPBlockOption_encode(block1_val, transfer->block1_num, transfer->block1_more, transfer->szx);
+    }
+    if (block2) {
+        block2_len = CoAPBlockOption_encode(block2_val, transfer->block2_num, 0, transfer->szx);
+    }
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, transfer->header.type);
+    CoAPMessageCode_set(&message, (CoAPMessageCode)transfer->header.code);
+    CoAPMessageId_set(&message, CoAPMessageId_gen(transfer->context));
+    CoAPMessageToken_set(&message, transfer->token, transfer->header.tokenlen);
+    CoAPMessageHandler_set(&message, CoAPBlock_handler);
+    CoAPMessageUserData_set(&message, transfer);
+    message.drop_notify = 1;
+
+    for (i = 0; i <= transfer->optnum && COAP_SUCCESS == ret; i++) {
+        unsigned short optnum = (i < transfer->optnum) ? transfer->options[i].num : 0xFFFF;
+
+        if (block2 && COAP_OPTION_BLOCK2 < optnum) {
+            ret = CoAPBlockOption_put(&message, COAP_OPTION_BLOCK2, block2_val, block2_len);
+            block2 = 0;
+        }
+        if (block1 && COAP_OPTION_BLOCK1 < optnum && COAP_SUCCESS == ret) {
+            ret = CoAPBlockOption_put(&message, COAP_OPTION_BLOCK1, block1_val, block1_len);
+            block1 = 0;
+        }
+        if (i < transfer->optnum && COAP_SUCCESS == ret) {
+            ret = CoAPBlockOption_put(&message, optnum, transfer->options[i].val, transfer->options[i].len);
+        }
+    }
+    if (COAP_SUCCESS != ret) {
+        return ret;
+    }
+
+    CoAPMessagePayload_set(&message, payload, payloadlen);
+    return CoAPMessage_send(transfer->context, &message);
+}
+
+static int CoAPBlockTransfer_upload(CoAPBlockTransfer *transfer)
+{
+    int len = 0;
+    unsigned int size = COAP_BLOCK_SIZE(transfer->szx);
+
+    if (COAP_BLOCK_MAX_NUM < transfer->block1_num) {
+        return COAP_ERROR_DATA_SIZE;
+    }
+
+    len = transfer->reader(transfer->user, transfer->block1_num * size, transfer->blockbuf, size);
+    if (0 > len || size < (unsigned int)len) {
+        COAP_ERR("Block1 read at block %d failed, return %d", transfer->block1_num, len);
+        return COAP_ERROR_READ_FAILED;
+    }
+
+    /* a body ending on a block boundary is closed by an empty block */
+    transfer->block1_more = (size == (unsigned int)len);
+    COAP_DEBUG("Send Block1 %d len %d more %d", transfer->block1_num, len, transfer->block1_more);
+    return CoAPBlockTransfer_send(transfer, 1, transfer->blockbuf, (unsigned short)len, 0);
+}
+
+/* push a response block to the writer, *requested is set when the next block was asked for */
+static int CoAPBlockTransfer_download(CoAPBlockTransfer *transfer, CoAPMessage *message, int *requested)
+{
+    int ret = 0;
+    unsigned int num = 0;
+    unsigned char more = 0;
+    unsigned char szx = 0;
+
+    ret = CoAPBlockOption_get(message, COAP_OPTION_BLOCK2, &num, &more, &szx);
+    if (COAP_ERROR_NOT_FOUND == ret) {
+        /* the whole body fits one response */
+        return (0 > transfer->writer(transfer->user, 0, message->payload, message->payloadlen, 0)) ?
+               COAP_ERROR_WRITE_FAILED : COAP_SUCCESS;
+    }
+    if (COAP_SUCCESS != ret || num != transfer->block2_num) {
+        COAP_ERR("Unexpected Block2 %d, waiting for %d", num, transfer->block2_num);
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    ret = transfer->writer(transfer->user, num << (szx + 4), message->payload, message->payloadlen, more);
+    if (0 > ret) {
+        return COAP_ERROR_WRITE_FAILED;
+    }
+    if (0 == more) {
+        return COAP_SUCCESS;
+    }
+
+    /* the server picks the block size of the response, later blocks are asked in it */
+    transfer->szx = szx;
+    transfer->block2_num = num + 1;
+    if (COAP_BLOCK_MAX_NUM < transfer->block2_num) {
+        return COAP_ERROR_DATA_SIZE;
+    }
+    COAP_DEBUG("Request Block2 %d", transfer->block2_num);
+    ret = CoAPBlockTransfer_send(transfer, 0, NULL, 0, 1);
+    *requested = (COAP_SUCCESS == ret);
+    return ret;
+}
+
+static void CoAPBlock_handler(void *data, void *p_message)
+{
+    CoAPBlockTransfer *transfer = (CoAPBlockTransfer *)data;
+    CoAPMessage *message = (CoAPMessage *)p_message;
+    unsigned int num = 0;
+    unsigned int offset = 0;
+    unsigned char more = 0;
+    unsigned char szx = 0;
+    int ret = COAP_SUCCESS;
+    int requested = 0;
+
+    if (NULL == message) {
+        COAP_INFO("Block transfer dropped");
+        CoAPBlockTransfer_finish(transfer, NULL);
+        return;
+    }
+
+    if (transfer->block1_more) {
+        if (COAP_MSG_CODE_231_CONTINUE != message->header.code) {
+            /* the server ended the upload early */
+            CoAPBlockTransfer_finish(transfer, message);
+            return;
+        }
+
+        /* a smaller block size asked by the server applies from the next block */
+        offset = (transfer->block1_num + 1) * COAP_BLOCK_SIZE(transfer->szx);
+        if (COAP_SUCCESS == CoAPBlockOption_get(message, COAP_OPTION_BLOCK1, &num, &more, &szx)
+            && szx < transfer->szx) {
+            transfer->szx = szx;
+        }
+        transfer->block1_num = offset / COAP_BLOCK_SIZE(transfer->szx);
+
+        if (COAP_SUCCESS != CoAPBlockTransfer_upload(transfer)) {
+            CoAPBlockTransfer_finish(transfer, NULL);
+        }
+        return;
+    }
+
+    if (NULL != transfer->writer && CoAPSuccessMsg(message->header.code)) {
+        ret = CoAPBlockTransfer_download(transfer, message, &requested);
+        if (requested) {
+            return;
+        }
+        if (COAP_SUCCESS != ret) {
+            CoAPBlockTransfer_finish(transfer, NULL);
+            return;
+        }
+    }
+
+    CoAPBlockTransfer_finish(transfer, message);
+}
+
+int CoAPBlockMessage_send(CoAPContext *context, CoAPMessage *message, unsigned char szx,
+                          CoAPBlockReadHandler reader, CoAPBlockWriteHandler writer)
+{
+    int i = 0;
+    int ret = COAP_SUCCESS;
+    unsigned int optlen = 0;
+    unsigned int bufsize = 0;
+    unsigned short optnum = 0;
+    unsigned char *ptr = NULL;
+    CoAPBlockTransfer *transfer = NULL;
+
+    if (NULL == context || NULL == message) {
+        return COAP_ERROR_NULL;
+    }
+    if (COAP_BLOCK_MAX_SZX < szx) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    for (i = 0; i < message->optnum; i++) {
+        optlen += message->options[i].len;
+    }
+    bufsize = (NULL != reader) ? COAP_BLOCK_SIZE(szx) : 0;
+
+    /* option values and the block buffer live right after the transfer */
+    transfer = coap_malloc(sizeof(CoAPBlockTransfer) + optlen + bufsize);
+    if (NULL == transfer) {
+        return COAP_ERROR_MALLOC;
+    }
+    memset(transfer, 0x00, sizeof(CoAPBlockTransfer));
+    transfer->context  = context;
+    transfer->header   = message->header;
+    transfer->szx      = szx;
+    transfer->reader   = reader;
+    transfer->writer   = writer;
+    transfer->handler  = message->handler;
+    transfer->user     = message->user;
+    memcpy(transfer->token, message->token, message->header.tokenlen);
+
+    ptr = (unsigned char *)(transfer + 1);
+    for (i = 0; i < message->optnum; i++) {
+        optnum += message->options[i].num;
+        if (COAP_OPTION_BLOCK1 == optnum || COAP_OPTION_BLOCK2 == optnum) {
+            continue;
+        }
+        transfer->options[transfer->optnum].num = optnum;
+        transfer->options[transfer->optnum].len = message->options[i].len;
+        transfer->options[transfer->optnum].val = ptr;
+        memcpy(ptr, message->options[i].val, message->options[i].len);
+        ptr += message->options[i].len;
+        transfer->optnum++;
+    }
+    transfer->blockbuf = ptr;
+
+    if (NULL != reader) {
+        ret = CoAPBlockTransfer_upload(transfer);
+    } else {
+        /* ask for the block size early */
+        ret = CoAPBlockTransfer_send(transfer, 0, NULL, 0, NULL != writer);
+    }
+
+    if (COAP_SUCCESS != ret) {
+        coap_free(transfer);
+    }
+    return ret;
+}
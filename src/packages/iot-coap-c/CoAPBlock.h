@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "CoAPExport.h"
+
+#ifndef __COAP_BLOCK_H__
+#define __COAP_BLOCK_H__
+
+/* RFC 7959 block size exponent, a block carries 2^(szx+4) bytes */
+#define COAP_BLOCK_SZX_16         0
+#define COAP_BLOCK_SZX_32         1
+#define COAP_BLOCK_SZX_64         2
+#define COAP_BLOCK_SZX_128        3
+#define COAP_BLOCK_SZX_256        4
+#define COAP_BLOCK_SZX_512        5
+#define COAP_BLOCK_SZX_1024       6
+
+#define COAP_BLOCK_SIZE(szx)      (1U << ((szx) + 4))
+
+/* fill buf with up to len body bytes from offset, returns the byte count, less than len on the last block, <0 to abort */
+typedef int (*CoAPBlockReadHandler)(void *user, unsigned int offset, unsigned char *buf, unsigned int len);
+
+/* consume len response body bytes at offset, more is 0 on the last block, returns <0 to abort */
+typedef int (*CoAPBlockWriteHandler)(void *user, unsigned int offset, unsigned char *data, unsigned int len, int more);
+
+int CoAPBlockOption_get(CoAPMessage *message, unsigned short optnum,
+            unsigned int *num, unsigned char *more, unsigned char *szx);
+
+/*
+ * send message block-wise, type, code, token, options, user and handler are
+ * taken from message, its payload is ignored. The request body is pulled
+ * from reader through Block1 and the response body is pushed to writer
+ * through Block2, either may be NULL. Only one block buffer of the szx size
+ * is allocated per transfer. The handler gets the final response, or NULL
+ * when the transfer is dropped or aborted.
+ */
+int CoAPBlockMessage_send(CoAPContext *context, CoAPMessage *message, unsigned char szx,
+            CoAPBlockReadHandler reader, CoAPBlockWriteHandler writer);
+
+#endif
@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include "CoAPExport.h"
+#include "CoAPDeserialize.h"
 
 int CoAPDeserialize_Header(CoAPMessage *msg, unsigned char *buf)
 {
@@ -38,84 +39,104 @@ int CoAPDeserialize_Token(CoAPMessage *msg, unsigned char *buf)
     return msg->header.tokenlen;
 }
 
-static int CoAPDeserialize_Option(CoAPMsgOption *option, unsigned char *buf, unsigned short *predeltas)
+/* extended option delta or length of nibble, -1 when it does not fit before end or uses the reserved 15 */
+static int CoAPDeserialize_OptionExt(unsigned short nibble, unsigned char **ptr, unsigned char *end,
+                                     unsigned int *value)
 {
-    unsigned char  *ptr      = buf;
-    unsigned short optdelta  = 0;
-    unsigned short optlen    = 0;
-    unsigned short predelta  = 0;
+    if (13 == nibble) {
+        if (end - *ptr < 1) {
+            return -1;
+        }
+        *value = 13 + **ptr;
+        *ptr += 1;
+    } else if (14 == nibble) {
+        if (end - *ptr < 2) {
+            return -1;
+        }
+        *value = 269 + (((*ptr)[0] << 8) | (*ptr)[1]);
+        *ptr += 2;
+    } else if (15 == nibble) {
+        return -1;
+    } else {
+        *value = nibble;
+    }
 
-    optdelta  = (*ptr & 0xF0) >> 4;
-    optlen    = (*ptr & 0x0F);
-    ptr++;
+    return 0;
+}
 
-    predelta = *predeltas;
-    if (13 == optdelta) {
-        predelta += 13 + *ptr;
-        ptr ++;
+/* the option at buf as a view into it, returns its size, -1 when it does not fit in buflen */
+static int CoAPDeserialize_Option(CoAPMsgOption *option, unsigned char *buf, int buflen, unsigned short *predeltas)
+{
+    unsigned char  *ptr      = buf;
+    unsigned char  *end      = buf + buflen;
+    unsigned int    optdelta = 0;
+    unsigned int    optlen   = 0;
 
-    } else if (14 == optdelta) {
-        predelta += 269;
-        predelta += (*ptr << 8);
-        predelta +=  *(ptr + 1);
-        ptr += 2;
-    } else {
-        predelta += optdelta;
+    if (buflen < 1) {
+        return -1;
     }
-    option->num = predelta;
-
-    if (13 == optlen) {
-        optlen = 13 + *ptr;
-        ptr ++;
-    } else if (14 == optlen) {
-        optlen = 269;
-        optlen += (*ptr << 8);
-        optlen += *(ptr + 1);
-        ptr += 2;
+    ptr++;
+    if (0 != CoAPDeserialize_OptionExt((*buf & 0xF0) >> 4, &ptr, end, &optdelta)
+        || 0 != CoAPDeserialize_OptionExt(*buf & 0x0F, &ptr, end, &optlen)
+        || *predeltas + optdelta > 0xFFFF || (unsigned int)(end - ptr) < optlen) {
+        return -1;
     }
-    option->len = optlen;
 
+    option->num = *predeltas + optdelta;
+    option->len = optlen;
     option->val = ptr;
     *predeltas = option->num;
 
-    return (ptr - buf + option->len);
+    return (int)(ptr - buf + optlen);
 }
 
+/* options past COAP_MSG_MAX_OPTION_NUM get no slot, they are reachable by CoAPMessageOption_next */
 int CoAPDeserialize_Options(CoAPMessage *msg, unsigned char *buf, int buflen)
 {
-    int  index = 0;
     int  count = 0;
-    unsigned char  *ptr      = buf;
-    unsigned short len       = 0;
+    int  len   = 0;
     unsigned short optdeltas = 0;
+    CoAPMsgOption  option;
 
     msg->optnum = 0;
-    while ((count < buflen) && (0xFF != *ptr)) {
-        len = CoAPDeserialize_Option(&msg->options[index], ptr, &optdeltas);
-        msg->optnum += 1;
-        ptr += len;
-        index ++;
+    msg->optbuf = buf;
+    while ((count < buflen) && (0xFF != buf[count])) {
+        len = CoAPDeserialize_Option(&option, buf + count, buflen - count, &optdeltas);
+        if (len < 0) {
+            return -1;
+        }
+        if (COAP_MSG_MAX_OPTION_NUM > msg->optnum) {
+            msg->options[msg->optnum++] = option;
+        }
         count += len;
     }
+    msg->optbuflen = (unsigned short)count;
 
-    return (int)(ptr - buf);
+    return count;
 }
 
 int CoAPDeserialize_Payload(CoAPMessage *msg, unsigned char *buf, int buflen)
 {
     unsigned char *ptr = buf;
 
-    if (0xFF == *ptr) {
+    if (0 < buflen && 0xFF == *ptr) {
         ptr ++;
     } else {
         return 0;
     }
+    /* a payload marker must be followed by payload */
+    if (1 == buflen) {
+        return -1;
+    }
     msg->payloadlen = buflen - 1;
     msg->payload = (unsigned char *)ptr;
 
     return buflen;
 }
 
+/*
+ * nothing is copied but the token, options and payload are views into buf, so buf must outlive the use of msg.
+ */
 int CoAPDeserialize_Message(CoAPMessage *msg, unsigned char *buf, int buflen)
 {
     int count  = 0;
@@ -134,6 +155,10 @@ int CoAPDeserialize_Message(CoAPMessage *msg, unsigned char *buf, int buflen)
     count = CoAPDeserialize_Header(msg, ptr);
     ptr += count;
     remlen -= count;
+    if (COAP_CUR_VERSION != msg->header.version || 8 < msg->header.tokenlen
+        || remlen < msg->header.tokenlen) {
+        return COAP_ERROR_INVALID_LENGTH;
+    }
 
     /* Deserialize the token, if any. */
     count = CoAPDeserialize_Token(msg, ptr);
@@ -141,10 +166,45 @@ int CoAPDeserialize_Message(CoAPMessage *msg, unsigned char *buf, int buflen)
     remlen -= count;
 
     count = CoAPDeserialize_Options(msg, ptr, remlen);
+    if (count < 0) {
+        return COAP_ERROR_INVALID_LENGTH;
+    }
     ptr += count;
     remlen -= count;
 
-    CoAPDeserialize_Payload(msg, ptr, remlen);
+    if (0 > CoAPDeserialize_Payload(msg, ptr, remlen)) {
+        return COAP_ERROR_INVALID_LENGTH;
+    }
+
+    return COAP_SUCCESS;
+}
+
+int CoAPMessageOption_next(CoAPMessage *message, CoAPMsgOptionIter *iter, CoAPMsgOption *option)
+{
+    unsigned char *end = NULL;
+    int            len = 0;
+
+    if (NULL == message || NULL == iter || NULL == option) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+    if (NULL == message->optbuf) {
+        return COAP_ERROR_NOT_FOUND;
+    }
+    if (NULL == iter->pos) {
+        iter->pos = message->optbuf;
+        iter->num = 0;
+    }
+
+    end = message->optbuf + message->optbuflen;
+    if (iter->pos >= end) {
+        return COAP_ERROR_NOT_FOUND;
+    }
+    /* already checked by CoAPDeserialize_Options */
+    len = CoAPDeserialize_Option(option, iter->pos, (int)(end - iter->pos), &iter->num);
+    if (len < 0) {
+        return COAP_ERROR_INVALID_LENGTH;
+    }
+    iter->pos += len;
 
     return COAP_SUCCESS;
 }
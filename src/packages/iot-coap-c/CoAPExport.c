@@ -25,6 +25,7 @@
 
 #include "CoAPNetwork.h"
 #include "CoAPExport.h"
+#include "CoAPObserve.h"
 
 #define COAP_DEFAULT_PORT           5683 /* CoAP default UDP port */
 #define COAPS_DEFAULT_PORT          5684 /* CoAP default UDP port for secure transmission */
@@ -120,9 +121,156 @@ unsigned int CoAPUri_parse(char *p_uri, coap_endpoint_type *p_endpoint_type,
 }
 
 
+static unsigned int CoAPContext_recvbuf_init(CoAPContext *p_ctx)
+{
+#ifdef COAP_BATCH_RECV_ENABLED
+    int i = 0;
+
+    p_ctx->recvbuf = coap_malloc(COAP_MSG_MAX_PDU_LEN * COAP_RECV_BATCH_COUNT);
+    if (NULL == p_ctx->recvbuf) {
+        COAP_ERR("not enough memory");
+        return COAP_ERROR_MALLOC;
+    }
+    for (i = 0; i < COAP_RECV_BATCH_COUNT; i++) {
+        p_ctx->recvslot[i] = p_ctx->recvbuf + i * COAP_MSG_MAX_PDU_LEN;
+    }
+#else
+    p_ctx->recvbuf = coap_malloc(COAP_MSG_MAX_PDU_LEN);
+    if (NULL == p_ctx->recvbuf) {
+        COAP_ERR("not enough memory");
+        return COAP_ERROR_MALLOC;
+    }
+#endif
+    return COAP_SUCCESS;
+}
+
+#ifdef COAP_GROUP_ENABLED
+/* a reused slot keeps counting where its message ids left off, the server may still hold an exchange of them */
+static unsigned int CoAPGroup_join(CoAPGroup *p_group, CoAPContext *p_ctx)
+{
+    unsigned int i = 0;
+    unsigned short slot = 0;
+
+    for (i = 0; i < p_group->capacity; i++) {
+        slot = (p_group->next + i) & (p_group->capacity - 1);
+        if (NULL == p_group->members[slot]) {
+            break;
+        }
+    }
+    if (i == p_group->capacity) {
+        COAP_ERR("The group is full, %d members", p_group->count);
+        return COAP_ERROR_MALLOC;
+    }
+
+    p_group->members[slot] = p_ctx;
+    p_group->count++;
+    p_group->next = (slot + 1) & (p_group->capacity - 1);
+    p_ctx->group = p_group;
+    p_ctx->slot = slot;
+    p_ctx->message_id = p_group->nextid[slot];
+    p_ctx->network = p_group->network;
+    p_ctx->waittime = p_group->waittime;
+    COAP_DEBUG("Join the group at slot %d", slot);
+    return COAP_SUCCESS;
+}
+
+static void CoAPGroup_leave(CoAPContext *p_ctx)
+{
+    CoAPGroup *p_group = p_ctx->group;
+
+    p_group->nextid[p_ctx->slot] = p_ctx->message_id;
+    p_group->members[p_ctx->slot] = NULL;
+    p_group->count--;
+    p_ctx->group = NULL;
+}
+
+CoAPGroup *CoAPGroup_create(char *url, unsigned int capacity, unsigned int waittime)
+{
+    unsigned int    ret     = COAP_SUCCESS;
+    CoAPGroup      *p_group = NULL;
+    coap_network_init_t network_param;
+    char host[COAP_DEFAULT_HOST_LEN] = {0};
+
+    if (NULL == url || 0 == capacity || COAP_GROUP_MAX_MEMBERS < capacity || 0 != (capacity & (capacity - 1))) {
+        COAP_ERR("Invalid group url %p or capacity %d", url, capacity);
+        return NULL;
+    }
+
+    memset(&network_param, 0x00, sizeof(coap_network_init_t));
+    ret = CoAPUri_parse(url, &network_param.ep_type, host, &network_param.port);
+    if (COAP_SUCCESS != ret) {
+        return NULL;
+    }
+    /* a DTLS session belongs to one context */
+    if (COAP_ENDPOINT_NOSEC != network_param.ep_type) {
+        COAP_ERR("A group shares plain UDP only");
+        return NULL;
+    }
+    network_param.p_ca_cert_pem = NULL;
+    network_param.p_host = host;
+
+    p_group = coap_malloc(sizeof(CoAPGroup));
+    if (NULL == p_group) {
+        COAP_ERR("malloc for coap group failed");
+        return NULL;
+    }
+    memset(p_group, 0x00, sizeof(CoAPGroup));
+
+    p_group->capacity = capacity;
+    for (p_group->idbits = 16; (1U << (16 - p_group->idbits)) < capacity; p_group->idbits--);
+    p_group->waittime = (0 == waittime) ? COAP_DEFAULT_WAIT_TIME_MS : waittime;
+    p_group->recvbuf = coap_malloc(COAP_MSG_MAX_PDU_LEN);
+    p_group->members = coap_malloc(capacity * sizeof(CoAPContext *));
+    p_group->nextid = coap_malloc(capacity * sizeof(unsigned short));
+    if (NULL == p_group->recvbuf || NULL == p_group->members || NULL == p_group->nextid) {
+        COAP_ERR("not enough memory");
+        goto err;
+    }
+    memset(p_group->members, 0x00, capacity * sizeof(CoAPContext *));
+    memset(p_group->nextid, 0x00, capacity * sizeof(unsigned short));
+
+    ret = CoAPNetwork_init(&network_param, &p_group->network);
+    if (COAP_SUCCESS != ret) {
+        goto err;
+    }
+
+    return p_group;
+err:
+    if (NULL != p_group->recvbuf) {
+        coap_free(p_group->recvbuf);
+    }
+    if (NULL != p_group->members) {
+        coap_free(p_group->members);
+    }
+    if (NULL != p_group->nextid) {
+        coap_free(p_group->nextid);
+    }
+    coap_free(p_group);
+    return NULL;
+}
+
+void CoAPGroup_free(CoAPGroup *p_group)
+{
+    if (NULL == p_group) {
+        return;
+    }
+
+    if (0 != p_group->count) {
+        COAP_ERR("The group is freed with %d members", p_group->count);
+    }
+
+    CoAPNetwork_deinit(&p_group->network);
+    coap_free(p_group->recvbuf);
+    coap_free(p_group->members);
+    coap_free(p_group->nextid);
+    coap_free(p_group);
+}
+#endif
+
 CoAPContext *CoAPContext_create(CoAPInitParam *param)
 {
     unsigned int    ret   = COAP_SUCCESS;
+    int             i     = 0;
     CoAPContext    *p_ctx = NULL;
     coap_network_init_t network_param;
     char host[COAP_DEFAULT_HOST_LEN] = {0};
@@ -143,12 +291,6 @@ CoAPContext *CoAPContext_create(CoAPInitParam *param)
         goto err;
     }
 
-    p_ctx->recvbuf = coap_malloc(COAP_MSG_MAX_PDU_LEN);
-    if (NULL == p_ctx->recvbuf) {
-        COAP_ERR("not enough memory");
-        goto err;
-    }
-
     if (0 == param->waittime) {
         p_ctx->waittime = COAP_DEFAULT_WAIT_TIME_MS;
     } else {
@@ -157,9 +299,58 @@ CoAPContext *CoAPContext_create(CoAPInitParam *param)
 
     /*CoAP message send list*/
     INIT_LIST_HEAD(&p_ctx->list.sendlist);
+    for (i = 0; i < COAP_SEND_HASH_SIZE; i++) {
+        INIT_LIST_HEAD(&p_ctx->list.msgid_hash[i]);
+        INIT_LIST_HEAD(&p_ctx->list.token_hash[i]);
+    }
+    for (i = 0; i < COAP_SEND_TIMER_WHEEL_SIZE; i++) {
+        INIT_LIST_HEAD(&p_ctx->list.timer_wheel[i]);
+    }
     p_ctx->list.count = 0;
+    p_ctx->list.tick = 0;
+
+    INIT_LIST_HEAD(&p_ctx->observelist);
+
+    /*CoAP send window and congestion control*/
+    INIT_LIST_HEAD(&p_ctx->list.waitlist);
+    p_ctx->list.nstart = param->nstart;
+    p_ctx->list.maxretry = param->maxretry;
+    p_ctx->list.cocoa = param->cocoa;
+
+    /*CoAP send node pool, the send path doesn't allocate when set*/
+    INIT_LIST_HEAD(&p_ctx->list.freelist);
+    if (0 != param->poolcount) {
+        p_ctx->list.pdulen = (0 == param->poolpdulen || COAP_MSG_MAX_PDU_LEN < param->poolpdulen) ?
+                             COAP_MSG_MAX_PDU_LEN : param->poolpdulen;
+        p_ctx->list.pool = coap_malloc(param->poolcount * sizeof(CoAPSendNode));
+        p_ctx->list.poolbuf = coap_malloc(param->poolcount * p_ctx->list.pdulen);
+        if (NULL == p_ctx->list.pool || NULL == p_ctx->list.poolbuf) {
+            COAP_ERR("not enough memory");
+            goto err;
+        }
+        memset(p_ctx->list.pool, 0x00, param->poolcount * sizeof(CoAPSendNode));
+        for (i = 0; i < param->poolcount; i++) {
+            p_ctx->list.pool[i].message = p_ctx->list.poolbuf + i * p_ctx->list.pdulen;
+            list_add_tail(&p_ctx->list.pool[i].sendlist, &p_ctx->list.freelist);
+        }
+    }
     p_ctx->list.maxcount = param->maxcount;
 
+#ifdef COAP_GROUP_ENABLED
+    /*a member receives into the buffer of its group*/
+    if (NULL != param->group) {
+        p_ctx->user = param->user;
+        if (COAP_SUCCESS != CoAPGroup_join(param->group, p_ctx)) {
+            goto err;
+        }
+        return p_ctx;
+    }
+#endif
+
+    if (COAP_SUCCESS != CoAPContext_recvbuf_init(p_ctx)) {
+        goto err;
+    }
+
     /*set the endpoint type by uri schema*/
     if (NULL != param->url) {
         ret = CoAPUri_parse(param->url, &network_param.ep_type, host, &network_param.port);
@@ -203,6 +394,14 @@ err:
         p_ctx->sendbuf = NULL;
     }
 
+    if (NULL != p_ctx->list.pool) {
+        coap_free(p_ctx->list.pool);
+    }
+
+    if (NULL != p_ctx->list.poolbuf) {
+        coap_free(p_ctx->list.poolbuf);
+    }
+
     coap_free(p_ctx);
     p_ctx = NULL;
 
@@ -217,10 +416,21 @@ void CoAPContext_free(CoAPContext *p_ctx)
 
     CoAPSendNode *cur, *next;
 
+#ifdef COAP_GROUP_ENABLED
+    if (NULL != p_ctx->group) {
+        CoAPGroup_leave(p_ctx);
+    } else {
+        CoAPNetwork_deinit(&p_ctx->network);
+    }
+#else
     CoAPNetwork_deinit(&p_ctx->network);
+#endif
 
     list_for_each_entry_safe(cur, next, &p_ctx->list.sendlist, sendlist, CoAPSendNode) {
-        if (NULL != cur) {
+        if (NULL != cur && cur->drop_notify && NULL != cur->handler) {
+            cur->handler(cur->user, NULL);
+        }
+        if (NULL != cur && NULL == p_ctx->list.pool) {
             if (NULL != cur->message) {
                 coap_free(cur->message);
                 cur->message = NULL;
@@ -230,6 +440,8 @@ void CoAPContext_free(CoAPContext *p_ctx)
         }
     }
 
+    CoAPObserve_free(p_ctx);
+
     if (NULL != p_ctx->recvbuf) {
         coap_free(p_ctx->recvbuf);
         p_ctx->recvbuf = NULL;
@@ -240,6 +452,15 @@ void CoAPContext_free(CoAPContext *p_ctx)
         p_ctx->sendbuf = NULL;
     }
 
+    if (NULL != p_ctx->list.pool) {
+        coap_free(p_ctx->list.pool);
+        p_ctx->list.pool = NULL;
+    }
+
+    if (NULL != p_ctx->list.poolbuf) {
+        coap_free(p_ctx->list.poolbuf);
+        p_ctx->list.poolbuf = NULL;
+    }
 
     if (NULL != p_ctx) {
         coap_free(p_ctx);
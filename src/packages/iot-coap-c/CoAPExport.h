@@ -25,11 +25,37 @@
 /* #define COAP_DTLS_SUPPORT */
 
 
+#define COAP_CUR_VERSION          1
 #define COAP_MSG_MAX_TOKEN_LEN    12
 #define COAP_MSG_MAX_OPTION_NUM   12
 #define COAP_MSG_MAX_PATH_LEN     32
 #define COAP_MSG_MAX_PDU_LEN      1280
 
+/* send list lookup tables, both must be powers of 2, the wheel must exceed the longest retransmit timeout */
+#define COAP_SEND_HASH_SIZE       32
+#define COAP_SEND_TIMER_WHEEL_SIZE 32
+
+/* cycle ticks before the first retransmit of a CON message, doubled at each one after */
+#ifndef COAP_ACK_TIMEOUT
+#define COAP_ACK_TIMEOUT          2
+#endif
+
+/* datagrams read per wakeup, each takes a COAP_MSG_MAX_PDU_LEN receive buffer */
+#ifdef COAP_BATCH_RECV_ENABLED
+#define COAP_RECV_BATCH_COUNT     4
+#endif
+
+/* waiting messages sent per write when the window opens */
+#ifdef COAP_BATCH_SEND_ENABLED
+#define COAP_SEND_BATCH_COUNT     8
+#endif
+
+/* contexts a group of them sharing one socket holds, the token of each request carries the slot of its member */
+#ifdef COAP_GROUP_ENABLED
+#define COAP_GROUP_MAX_MEMBERS    4096
+#define COAP_GROUP_TAG_LEN        2
+#endif
+
 /*CoAP Content Type*/
 #define COAP_CT_TEXT_PLAIN                 0   /* text/plain (UTF-8) */
 #define COAP_CT_APP_LINK_FORMAT           40   /* application/link-format */
@@ -45,6 +71,7 @@
 #define COAP_OPTION_URI_HOST        3   /* C, String,  1-255 B, destination address */
 #define COAP_OPTION_ETAG            4   /* E, opaque,  1-8 B, (none) */
 #define COAP_OPTION_IF_NONE_MATCH   5   /* empty,      0 B, (none) */
+#define COAP_OPTION_OBSERVE         6   /* E, uint,    0-3 B, (none) */
 #define COAP_OPTION_URI_PORT        7   /* C, uint,    0-2 B, destination port */
 #define COAP_OPTION_LOCATION_PATH   8   /* E, String,  0-255 B, - */
 #define COAP_OPTION_URI_PATH       11   /* C, String,  0-255 B, (none) */
@@ -83,6 +110,7 @@
 #define COAP_ERROR_INTERNAL                    (COAP_ERROR_BASE | 8)  /* Internal Error */
 #define COAP_ERROR_WRITE_FAILED                (COAP_ERROR_BASE | 9)
 #define COAP_ERROR_READ_FAILED                 (COAP_ERROR_BASE | 10)
+#define COAP_ERROR_MALLOC                      (COAP_ERROR_BASE | 11) /* No send node left */
 
 #define COAP_MSG_CODE_DEF(N) (((N)/100 << 5) | (N)%100)
 
@@ -145,8 +173,25 @@ typedef struct
     unsigned short num;
     unsigned short len;
     unsigned char *val;
+    const unsigned char *tail;  /* options of the same number after this one, serialized already, set for a CoAPPath whose val and tail are not freed */
+    unsigned short taillen;
 }CoAPMsgOption;
 
+/* Uri-Path options split and serialized once, the first one is left for its delta to the options before it */
+typedef struct
+{
+    unsigned short firstlen;
+    unsigned short taillen;     /* the other segments, options of delta 0 */
+    unsigned char  buf[1];      /* first segment, then the tail */
+}CoAPPath;
+
+/* walks the options of a received message in its PDU, zero it before the first CoAPMessageOption_next */
+typedef struct
+{
+    unsigned char *pos;
+    unsigned short num;
+}CoAPMsgOptionIter;
+
 typedef void (*CoAPRespMsgHandler)(void *data, void *message);
 
 typedef void (*CoAPEventNotifier)(unsigned int event, void *p_message);
@@ -156,22 +201,54 @@ typedef struct
     void                    *user;
     unsigned short           msgid;
     char                     acked;
+    unsigned char            drop_notify;
     unsigned char            tokenlen;
     unsigned char            token[8];
     unsigned char            retrans_count;
     unsigned short           timeout;
     unsigned short           timeout_val;
+    unsigned int             deadline;      /* cycle tick of the next retransmit check */
+    unsigned char            inflight;      /* counted in the send window */
+    unsigned int             rto_ms;        /* current retransmit interval with congestion control */
+    uint64_t                 sent_ms;       /* first transmission */
     unsigned char           *message;
     unsigned int             msglen;
     CoAPRespMsgHandler       handler;
     struct list_head         sendlist;
+    struct list_head         msgid_hash;
+    struct list_head         token_hash;
+    struct list_head         timer;
 } CoAPSendNode;
 
+/* CoCoA retransmission timeout estimation, strong and weak estimators in ms */
+typedef struct
+{
+    unsigned int             rto;
+    unsigned int             srtt[2];
+    unsigned int             rttvar[2];
+    unsigned char            valid[2];
+    uint64_t                 updated_ms;
+} CoAPRttEstimator;
+
 typedef struct
 {
     unsigned char            count;
     unsigned char            maxcount;
+    unsigned char            nstart;        /* in-flight CON message window, 0 for no limit */
+    unsigned char            inflight;
+    unsigned char            maxretry;      /* 0 for COAP_MAX_RETRY_COUNT */
+    unsigned char            cocoa;         /* retransmit timeouts from the RTT estimator instead of fixed ticks */
+    CoAPRttEstimator         rtt;
+    struct list_head         waitlist;      /* CON messages waiting for the window, linked by timer */
+    unsigned int             tick;          /* CoAPMessage_cycle count */
     struct list_head         sendlist;
+    struct list_head         msgid_hash[COAP_SEND_HASH_SIZE];
+    struct list_head         token_hash[COAP_SEND_HASH_SIZE];
+    struct list_head         timer_wheel[COAP_SEND_TIMER_WHEEL_SIZE];
+    CoAPSendNode            *pool;          /* preallocated nodes, NULL when nodes are allocated per message */
+    unsigned char           *poolbuf;       /* pdulen bytes of PDU per pool node */
+    unsigned short           pdulen;
+    struct list_head         freelist;      /* unused pool nodes, linked by sendlist */
 }CoAPSendList;
 
 
@@ -182,18 +259,30 @@ typedef struct
     CoAPMsgOption   options[COAP_MSG_MAX_OPTION_NUM];
     unsigned char   optnum;
     unsigned char   optdelta;
-    unsigned char  *payload;
+    unsigned char  *optbuf;     /* options of a received message in the receive buffer, all of them even beyond options[] */
+    unsigned short  optbuflen;
+    unsigned char  *payload;    /* of a received message points into the receive buffer, valid during the callback only and not NUL terminated */
     unsigned short  payloadlen;
     CoAPRespMsgHandler handler;
     void           *user;
+    unsigned char   drop_notify;  /* handler gets a NULL message when the message is dropped unanswered */
 }CoAPMessage;
 
 typedef struct
 {
              char       *url;
     unsigned char        maxcount;  /*list maximal count*/
+    unsigned short       poolcount; /*preallocated send nodes, 0 to allocate them per message*/
+    unsigned short       poolpdulen;/*PDU buffer size of a pool node, 0 for COAP_MSG_MAX_PDU_LEN*/
+    unsigned char        nstart;    /*in-flight CON message window, 0 for no limit*/
+    unsigned char        maxretry;  /*retransmissions before giving up, 0 for the default*/
+    unsigned char        cocoa;     /*1 to estimate retransmit timeouts from the RTT (CoCoA)*/
     unsigned int         waittime;
     CoAPEventNotifier    notifier;
+#ifdef COAP_GROUP_ENABLED
+    struct CoAPGroup    *group;     /*joins the group and shares its socket instead of opening url, NULL for its own*/
+    void                *user;      /*of the layer above, for the members a group walks*/
+#endif
 }CoAPInitParam;
 
 typedef struct
@@ -203,10 +292,42 @@ typedef struct
     CoAPEventNotifier        notifier;
     unsigned char            *sendbuf;
     unsigned char            *recvbuf;
+#ifdef COAP_BATCH_RECV_ENABLED
+    unsigned char            *recvslot[COAP_RECV_BATCH_COUNT];  /*COAP_MSG_MAX_PDU_LEN slices of recvbuf*/
+    unsigned int              recvlen[COAP_RECV_BATCH_COUNT];
+#endif
     CoAPSendList             list;
+    struct list_head         observelist;
     unsigned int             waittime;
+#ifdef HAL_EVENT_ENABLED
+    uint64_t                 nexttick_ms;   /*CoAPMessage_process runs a tick every waittime ms of uptime*/
+#endif
+#ifdef COAP_GROUP_ENABLED
+    struct CoAPGroup        *group;         /*receives through the group when set, network is a copy of its socket*/
+    unsigned short           slot;          /*in the group, the high bits of its message ids and the token tag*/
+    void                    *user;
+#endif
 }CoAPContext;
 
+#ifdef COAP_GROUP_ENABLED
+/*
+ * contexts sharing one plain UDP socket and one receive loop, driven from one thread. An ACK or RST goes
+ * to the member of the slot in the high bits of its message id, anything else to the one tagged on its token.
+ */
+typedef struct CoAPGroup
+{
+    coap_network_t           network;
+    unsigned char           *recvbuf;
+    CoAPContext            **members;       /*of each slot, NULL when free*/
+    unsigned short          *nextid;        /*message id counter a slot left off at*/
+    unsigned short           capacity;      /*a power of 2, a member has 65536 / capacity message ids*/
+    unsigned short           count;
+    unsigned short           next;          /*slot the next join looks at first, so freed ones are reused last*/
+    unsigned char            idbits;        /*low message id bits a member counts in*/
+    unsigned int             waittime;
+}CoAPGroup;
+#endif
+
 #define COAP_TRC     log_debug
 #define COAP_DUMP    log_debug
 #define COAP_DEBUG   log_debug
@@ -216,5 +337,11 @@ typedef struct
 CoAPContext *CoAPContext_create(CoAPInitParam *param);
 void CoAPContext_free(CoAPContext *p_ctx);
 
+#ifdef COAP_GROUP_ENABLED
+/* a group of at most capacity members, a power of 2, on a coap:// url. Its members are freed before it */
+CoAPGroup *CoAPGroup_create(char *url, unsigned int capacity, unsigned int waittime);
+void CoAPGroup_free(CoAPGroup *p_group);
+#endif
+
 
 #endif
@@ -20,9 +20,12 @@
 
 #include "stdio.h"
 #include "CoAPExport.h"
+#include "CoAPMessage.h"
 #include "CoAPSerialize.h"
 #include "CoAPDeserialize.h"
+#include "CoAPObserve.h"
 #include "iot_import.h"
+#include "lite-metrics.h"
 
 
 #define COAPAckMsg(header) \
@@ -47,14 +50,61 @@
     ((1 <= header.code) && (32 > header.code))
 
 
-#define COAP_CUR_VERSION        1
 #define COAP_WAIT_TIME_MS       2000
 #define COAP_MAX_MESSAGE_ID     65535
 #define COAP_MAX_RETRY_COUNT    4
-#define COAP_ACK_TIMEOUT        2
 #define COAP_ACK_RANDOM_FACTOR  1
 #define COAP_MAX_TRANSMISSION_SPAN   10
 
+/* CoCoA, draft-ietf-core-cocoa */
+#define COAP_COCOA_INITIAL_RTO_MS    2000
+#define COAP_COCOA_MIN_RTO_MS        100
+#define COAP_COCOA_MAX_RTO_MS        32000
+#define COAP_COCOA_MAX_INTERVAL_MS   60000
+#define COAP_COCOA_STRONG            0
+#define COAP_COCOA_WEAK              1
+
+#define CoAPMaxRetry(context)\
+    ((0 == (context)->list.maxretry) ? COAP_MAX_RETRY_COUNT : (context)->list.maxretry)
+
+/* of every context, registered by the first send */
+LITE_METRIC_DEFINE_COUNTER(coap_retransmits, "coap.retransmit");
+LITE_METRIC_DEFINE_COUNTER(coap_timeouts, "coap.timeout");
+
+/* options are kept as deltas in number order, an option lower than the last one is inserted in place */
+static CoAPMsgOption *CoAPMessageOption_insert(CoAPMessage *message, unsigned short optnum,
+                                               unsigned char *val, unsigned short len)
+{
+    int i = 0;
+    int pos = message->optnum;
+    unsigned short prev = 0;
+
+    if (optnum < message->optdelta) {
+        for (pos = 0; pos < message->optnum; pos++) {
+            if (prev + message->options[pos].num > optnum) {
+                break;
+            }
+            prev += message->options[pos].num;
+        }
+        for (i = message->optnum; i > pos; i--) {
+            message->options[i] = message->options[i - 1];
+        }
+        message->options[pos + 1].num -= optnum - prev;
+    } else {
+        prev = message->optdelta;
+        message->optdelta = optnum;
+    }
+
+    message->options[pos].num = optnum - prev;
+    message->options[pos].len = len;
+    message->options[pos].val = val;
+    message->options[pos].tail = NULL;
+    message->options[pos].taillen = 0;
+    message->optnum ++;
+
+    return &message->options[pos];
+}
+
 int CoAPStrOption_add(CoAPMessage *message, unsigned short optnum, unsigned char *data, unsigned short datalen)
 {
     unsigned char *ptr = NULL;
@@ -62,45 +112,60 @@ int CoAPStrOption_add(CoAPMessage *message, unsigned short optnum, unsigned char
         return COAP_ERROR_INVALID_PARAM;
     }
 
-    message->options[message->optnum].num = optnum - message->optdelta;
-    message->options[message->optnum].len = datalen;
     ptr = (unsigned char *)coap_malloc(datalen);
     if (NULL != ptr) {
         memcpy(ptr, data, datalen);
     }
-    message->options[message->optnum].val = ptr;
-    message->optdelta = optnum;
-    message->optnum ++;
+    CoAPMessageOption_insert(message, optnum, ptr, datalen);
 
     return COAP_SUCCESS;
 
 }
 
+/* the Uri-Path options of path as one, borrowed and not copied, path must outlive the message */
+int CoAPPathOption_add(CoAPMessage *message, CoAPPath *path)
+{
+    CoAPMsgOption *option = NULL;
+
+    if (NULL == message || NULL == path) {
+        return COAP_ERROR_NULL;
+    }
+    if (COAP_MSG_MAX_OPTION_NUM <= message->optnum) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    option = CoAPMessageOption_insert(message, COAP_OPTION_URI_PATH, path->buf, path->firstlen);
+    option->tail = path->buf + path->firstlen;
+    option->taillen = path->taillen;
+
+    return COAP_SUCCESS;
+}
+
 int CoAPUintOption_add(CoAPMessage *message, unsigned short  optnum, unsigned int data)
 {
     unsigned char *ptr = NULL;
+    unsigned short len = 0;
     if (COAP_MSG_MAX_OPTION_NUM <= message->optnum) {
         return COAP_ERROR_INVALID_PARAM;
     }
-    message->options[message->optnum].num = optnum - message->optdelta;
 
     if (0 == data) {
-        message->options[message->optnum].len = 0;
-    } else if (256 >= data) {
-        message->options[message->optnum].len = 1;
+        len = 0;
+    } else if (255 >= data) {
+        len = 1;
         ptr = (unsigned char *)coap_malloc(1);
         if (NULL != ptr) {
             *ptr = (unsigned char)data;
         }
     } else if (65535 >= data) {
-        message->options[message->optnum].len = 2;
+        len = 2;
         ptr  = (unsigned char *)coap_malloc(2);
         if (NULL != ptr) {
             *ptr     = (unsigned char)((data & 0xFF00) >> 8);
             *(ptr + 1) = (unsigned char)(data & 0x00FF);
         }
     } else {
-        message->options[message->optnum].len = 4;
+        len = 4;
         ptr   = (unsigned char *)coap_malloc(4);
         if (NULL != ptr) {
             *ptr     = (unsigned char)((data & 0xFF000000) >> 24);
@@ -109,16 +174,52 @@ int CoAPUintOption_add(CoAPMessage *message, unsigned short  optnum, unsigned in
             *(ptr + 3) = (unsigned char)(data & 0x000000FF);
         }
     }
-    message->options[message->optnum].val = ptr;
-    message->optdelta = optnum;
-    message->optnum   += 1;
+    CoAPMessageOption_insert(message, optnum, ptr, len);
 
     return COAP_SUCCESS;
 }
 
+int CoAPUintOption_get(CoAPMessage *message, unsigned short optnum, unsigned int *data)
+{
+    CoAPMsgOptionIter iter;
+    CoAPMsgOption     option;
+    unsigned short    len = 0;
+
+    if (NULL == message || NULL == data) {
+        return COAP_ERROR_NULL;
+    }
+
+    memset(&iter, 0x00, sizeof(CoAPMsgOptionIter));
+    while (COAP_SUCCESS == CoAPMessageOption_next(message, &iter, &option)) {
+        if (optnum == option.num) {
+            if (4 < option.len) {
+                return COAP_ERROR_INVALID_LENGTH;
+            }
+            *data = 0;
+            for (len = 0; len < option.len; len++) {
+                *data = (*data << 8) | option.val[len];
+            }
+            return COAP_SUCCESS;
+        }
+        if (optnum < option.num) {
+            break;
+        }
+    }
+
+    return COAP_ERROR_NOT_FOUND;
+}
+
 unsigned short CoAPMessageId_gen(CoAPContext *context)
 {
     unsigned short msg_id = 0;
+#ifdef COAP_GROUP_ENABLED
+    /* a member counts in the low bits, its slot above them tells whose the ACK is */
+    if (NULL != context->group) {
+        msg_id = (unsigned short)((context->slot << context->group->idbits)
+                                  | (context->message_id++ & ((1U << context->group->idbits) - 1)));
+        return msg_id;
+    }
+#endif
     msg_id = ((COAP_MAX_MESSAGE_ID == context->message_id)  ? 1 : context->message_id++);
     return msg_id;
 }
@@ -229,7 +330,7 @@ int CoAPMessage_destory(CoAPMessage *message)
     }
 
     for (count = 0; count < COAP_MSG_MAX_TOKEN_LEN; count++) {
-        if (NULL != message->options[count].val) {
+        if (NULL != message->options[count].val && NULL == message->options[count].tail) {
             coap_free(message->options[count].val);
             message->options[count].val = NULL;
         }
@@ -238,78 +339,397 @@ int CoAPMessage_destory(CoAPMessage *message)
     return COAP_SUCCESS;
 }
 
-static int CoAPMessageList_add(CoAPContext *context, CoAPMessage *message, int len)
+static unsigned int CoAPToken_hash(unsigned char *token, unsigned char tokenlen)
+{
+    unsigned int hash = 0;
+    unsigned char i = 0;
+
+    for (i = 0; i < tokenlen; i++) {
+        hash = hash * 31 + token[i];
+    }
+    return hash & (COAP_SEND_HASH_SIZE - 1);
+}
+
+/* the node is checked again by the cycle running timeout ticks after the current one */
+static void CoAPMessageList_schedule(CoAPContext *context, CoAPSendNode *node)
+{
+    node->deadline = context->list.tick + node->timeout + 1;
+    list_del_init(&node->timer);
+    list_add_tail(&node->timer,
+                  &context->list.timer_wheel[node->deadline & (COAP_SEND_TIMER_WHEEL_SIZE - 1)]);
+}
+
+/* a pool node with pdulen bytes of PDU when the context has a pool, otherwise node and len bytes are allocated */
+static CoAPSendNode *CoAPSendNode_alloc(CoAPContext *context, unsigned int len)
 {
     CoAPSendNode *node = NULL;
+
+    if (NULL != context->list.pool) {
+        if (list_empty(&context->list.freelist)) {
+            return NULL;
+        }
+        node = list_first_entry(&context->list.freelist, CoAPSendNode, sendlist);
+        list_del_init(&node->sendlist);
+        return node;
+    }
+
     node = coap_malloc(sizeof(CoAPSendNode));
+    if (NULL == node) {
+        return NULL;
+    }
+    node->message = (unsigned char *)coap_malloc(len);
+    if (NULL == node->message) {
+        coap_free(node);
+        return NULL;
+    }
+    return node;
+}
 
-    if (NULL != node) {
-        node->acked        = 0;
-        node->user         = message->user;
-        node->msgid        = message->header.msgid;
-        node->handler      = message->handler;
-        node->msglen       = len;
-        node->timeout_val   = COAP_ACK_TIMEOUT * COAP_ACK_RANDOM_FACTOR;
-
-        if (COAP_MESSAGE_TYPE_CON == message->header.type) {
-            node->timeout       = node->timeout_val;
-            node->retrans_count = 0;
-        } else {
-            node->timeout       = COAP_MAX_TRANSMISSION_SPAN;
-            node->retrans_count = COAP_MAX_RETRY_COUNT;
+static void CoAPSendNode_free(CoAPContext *context, CoAPSendNode *node)
+{
+    if (NULL != context->list.pool) {
+        list_add(&node->sendlist, &context->list.freelist);
+        return;
+    }
+
+    coap_free(node->message);
+    coap_free(node);
+}
+
+static unsigned int CoAPRtt_rto(CoAPContext *context)
+{
+    return (0 == context->list.rtt.rto) ? COAP_COCOA_INITIAL_RTO_MS : context->list.rtt.rto;
+}
+
+/* one RTO estimator update, the strong one takes clean exchanges, the weak one retransmitted ones */
+static void CoAPRtt_sample(CoAPContext *context, CoAPSendNode *node)
+{
+    CoAPRttEstimator *rtt = &context->list.rtt;
+    uint64_t now = HAL_UptimeMs();
+    unsigned int sample = (unsigned int)(now - node->sent_ms);
+    unsigned int rto = 0;
+    unsigned int diff = 0;
+    int weak = (0 != node->retrans_count);
+
+    /* more than 2 retransmissions say nothing about which one was answered */
+    if (2 < node->retrans_count) {
+        return;
+    }
+
+    if (!rtt->valid[weak]) {
+        rtt->srtt[weak] = sample;
+        rtt->rttvar[weak] = sample / 2;
+        rtt->valid[weak] = 1;
+    } else {
+        diff = (rtt->srtt[weak] > sample) ? rtt->srtt[weak] - sample : sample - rtt->srtt[weak];
+        rtt->rttvar[weak] = (3 * rtt->rttvar[weak] + diff) / 4;
+        rtt->srtt[weak] = (7 * rtt->srtt[weak] + sample) / 8;
+    }
+
+    rto = rtt->srtt[weak] + (weak ? 1 : 4) * rtt->rttvar[weak];
+    if (weak) {
+        rtt->rto = (3 * CoAPRtt_rto(context) + rto) / 4;
+    } else {
+        rtt->rto = (CoAPRtt_rto(context) + rto) / 2;
+    }
+    if (COAP_COCOA_MIN_RTO_MS > rtt->rto) {
+        rtt->rto = COAP_COCOA_MIN_RTO_MS;
+    } else if (COAP_COCOA_MAX_RTO_MS < rtt->rto) {
+        rtt->rto = COAP_COCOA_MAX_RTO_MS;
+    }
+    rtt->updated_ms = now;
+    COAP_DEBUG("RTT sample %d ms %s, rto %d ms", sample, weak ? "weak" : "strong", rtt->rto);
+}
+
+/* a small RTO left alone grows, a large one falls back towards the initial value */
+static void CoAPRtt_age(CoAPContext *context)
+{
+    CoAPRttEstimator *rtt = &context->list.rtt;
+    uint64_t now = HAL_UptimeMs();
+    unsigned int rto = CoAPRtt_rto(context);
+
+    if (1000 > rto && now > rtt->updated_ms + 16 * rto) {
+        rtt->rto = (2 * rto > 1000) ? 1000 : 2 * rto;
+        rtt->updated_ms = now;
+    } else if (3000 < rto && now > rtt->updated_ms + 4 * rto) {
+        rtt->rto = (COAP_COCOA_INITIAL_RTO_MS + rto) / 2;
+        rtt->updated_ms = now;
+    }
+}
+
+/* variable backoff factor, short timeouts back off harder */
+static unsigned int CoAPRtt_backoff(CoAPContext *context, unsigned int interval)
+{
+    unsigned int rto = CoAPRtt_rto(context);
+
+    if (1000 > rto) {
+        interval *= 3;
+    } else if (3000 >= rto) {
+        interval *= 2;
+    } else {
+        interval += interval / 2;
+    }
+    return (COAP_COCOA_MAX_INTERVAL_MS < interval) ? COAP_COCOA_MAX_INTERVAL_MS : interval;
+}
+
+/* the cycle waits waittime for input, so a tick lasts about that long */
+static unsigned short CoAPRtt_ticks(CoAPContext *context, unsigned int ms)
+{
+    unsigned int tick_ms = (0 == context->waittime) ? 1 : context->waittime;
+    unsigned int ticks = (ms + tick_ms - 1) / tick_ms;
+
+    return (unsigned short)((0 == ticks) ? 0 : ticks - 1);
+}
+
+/* the node's CON exchange got its ACK or response, it leaves the send window */
+static void CoAPSendNode_answered(CoAPContext *context, CoAPSendNode *node, int sample)
+{
+    if (!node->inflight) {
+        return;
+    }
+    if (sample && context->list.cocoa) {
+        CoAPRtt_sample(context, node);
+    }
+    node->inflight = 0;
+    context->list.inflight--;
+}
+
+static void CoAPMessageList_remove(CoAPContext *context, CoAPSendNode *node)
+{
+    CoAPSendNode_answered(context, node, 0);
+    list_del_init(&node->sendlist);
+    list_del_init(&node->msgid_hash);
+    list_del_init(&node->token_hash);
+    list_del_init(&node->timer);
+    context->list.count--;
+    CoAPSendNode_free(context, node);
+}
+
+/* remove a node nobody answered, notify its handler when asked to */
+static void CoAPMessageList_drop(CoAPContext *context, CoAPSendNode *node)
+{
+    CoAPRespMsgHandler handler = node->drop_notify ? node->handler : NULL;
+    void *user = node->user;
+
+    CoAPMessageList_remove(context, node);
+    if (NULL != handler) {
+        handler(user, NULL);
+    }
+}
+
+static void CoAPSendNode_start(CoAPContext *context, CoAPSendNode *node)
+{
+    node->sent_ms = HAL_UptimeMs();
+    if (COAP_MESSAGE_TYPE_CON == (node->message[0] >> 4 & 0x03)) {
+        node->inflight = 1;
+        context->list.inflight++;
+        if (context->list.cocoa) {
+            node->rto_ms  = CoAPRtt_rto(context);
+            node->rto_ms += HAL_Random(node->rto_ms / 2 + 1);
+            node->timeout = CoAPRtt_ticks(context, node->rto_ms);
+        }
+    }
+    CoAPMessageList_schedule(context, node);
+}
+
+#ifdef COAP_BATCH_SEND_ENABLED
+/* send the CON messages waiting for the window while it has room, as many per write as it takes */
+static void CoAPMessageList_kick(CoAPContext *context)
+{
+    CoAPSendNode *nodes[COAP_SEND_BATCH_COUNT];
+    const unsigned char *data[COAP_SEND_BATCH_COUNT];
+    unsigned int len[COAP_SEND_BATCH_COUNT];
+    int count, sent, i;
+
+    while (!list_empty(&context->list.waitlist)) {
+        for (count = 0; count < COAP_SEND_BATCH_COUNT && !list_empty(&context->list.waitlist)
+             && (0 == context->list.nstart || context->list.inflight + count < context->list.nstart); count++) {
+            nodes[count] = list_first_entry(&context->list.waitlist, CoAPSendNode, timer);
+            list_del_init(&nodes[count]->timer);
+            data[count] = nodes[count]->message;
+            len[count] = nodes[count]->msglen;
         }
-        node->tokenlen     = message->header.tokenlen;
-        memcpy(node->token, message->token, message->header.tokenlen);
-        node->message      = (unsigned char *)coap_malloc(len);
-        if (NULL != node->message) {
-            memcpy(node->message, context->sendbuf, len);
+        if (0 == count) {
+            return;
         }
 
-        if (&context->list.count >= &context->list.maxcount) {
-            coap_free(node);
-            return -1;
-        } else {
-            list_add_tail(&node->sendlist, &context->list.sendlist);
-            context->list.count ++;
-            return 0;
+        COAP_DEBUG("Send %d waiting messages from id %d", count, nodes[0]->msgid);
+        sent = CoAPNetwork_writeBatch(&context->network, data, len, count);
+        for (i = 0; i < sent; i++) {
+            CoAPSendNode_start(context, nodes[i]);
+        }
+        if (sent < count) {
+            /* the one which failed is dropped, as a single write failing would drop it */
+            COAP_ERR("CoAP transoprt write failed, %d of %d sent", sent, count);
+            CoAPMessageList_drop(context, nodes[sent]);
+            for (i = count - 1; i > sent; i--) {
+                list_add(&nodes[i]->timer, &context->list.waitlist);
+            }
         }
+    }
+}
+#else
+/* send the CON messages waiting for the window while it has room */
+static void CoAPMessageList_kick(CoAPContext *context)
+{
+    unsigned int ret = COAP_SUCCESS;
+    CoAPSendNode *node = NULL;
+
+    while (!list_empty(&context->list.waitlist)
+           && (0 == context->list.nstart || context->list.inflight < context->list.nstart)) {
+        node = list_first_entry(&context->list.waitlist, CoAPSendNode, timer);
+        list_del_init(&node->timer);
+
+        COAP_DEBUG("Send the waiting message id %d len %d", node->msgid, node->msglen);
+        ret = CoAPNetwork_write(&context->network, node->message, node->msglen);
+        if (COAP_SUCCESS != ret) {
+            COAP_ERR("CoAP transoprt write failed, return %d", ret);
+            CoAPMessageList_drop(context, node);
+            continue;
+        }
+        CoAPSendNode_start(context, node);
+    }
+}
+#endif
+
+static int CoAPMessageList_add(CoAPContext *context, CoAPSendNode *node, CoAPMessage *message, int len,
+                               int waiting)
+{
+    node->acked        = 0;
+    node->drop_notify  = message->drop_notify;
+    node->user         = message->user;
+    node->msgid        = message->header.msgid;
+    node->handler      = message->handler;
+    node->msglen       = len;
+    node->timeout_val   = COAP_ACK_TIMEOUT * COAP_ACK_RANDOM_FACTOR;
+
+    if (COAP_MESSAGE_TYPE_CON == message->header.type) {
+        node->timeout       = node->timeout_val;
+        node->retrans_count = 0;
     } else {
+        node->timeout       = COAP_MAX_TRANSMISSION_SPAN;
+        node->retrans_count = CoAPMaxRetry(context);
+    }
+    node->inflight     = 0;
+    node->tokenlen     = message->header.tokenlen;
+    memcpy(node->token, message->token, message->header.tokenlen);
+
+    if (&context->list.count >= &context->list.maxcount) {
+        CoAPSendNode_free(context, node);
         return -1;
+    } else {
+        list_add_tail(&node->sendlist, &context->list.sendlist);
+        list_add_tail(&node->msgid_hash,
+                      &context->list.msgid_hash[node->msgid & (COAP_SEND_HASH_SIZE - 1)]);
+        INIT_LIST_HEAD(&node->token_hash);
+        if (0 != node->tokenlen) {
+            list_add_tail(&node->token_hash,
+                          &context->list.token_hash[CoAPToken_hash(node->token, node->tokenlen)]);
+        }
+        INIT_LIST_HEAD(&node->timer);
+        if (waiting) {
+            list_add_tail(&node->timer, &context->list.waitlist);
+        } else {
+            CoAPSendNode_start(context, node);
+        }
+        context->list.count ++;
+        return 0;
     }
 }
 
 int CoAPMessage_send(CoAPContext *context, CoAPMessage *message)
 {
     unsigned int   ret            = COAP_SUCCESS;
-    unsigned short msglen         = 0;
+    int            msglen         = 0;
+    unsigned char *pdu            = NULL;
+    unsigned short pdulen         = COAP_MSG_MAX_PDU_LEN;
+    CoAPSendNode  *node           = NULL;
+    int            retransmit     = 0;
+#ifdef COAP_GROUP_ENABLED
+    unsigned char  tokenlen       = 0;
+#endif
+
+    LITE_METRIC_REGISTER(coap_retransmits);
+    LITE_METRIC_REGISTER(coap_timeouts);
 
     if (NULL == message || NULL == context) {
         return (COAP_ERROR_INVALID_PARAM);
     }
 
-    /* TODO: get the message length */
-    msglen = CoAPSerialize_MessageLength(message);
-    if (COAP_MSG_MAX_PDU_LEN < msglen) {
-        COAP_INFO("The message length %d is too loog", msglen);
-        return COAP_ERROR_DATA_SIZE;
+    /* a pool node takes the PDU directly, it is written and retransmitted from there */
+    retransmit = CoAPReqMsg(message->header) || CoAPCONRespMsg(message->header);
+    pdu = context->sendbuf;
+    if (retransmit && NULL != context->list.pool) {
+        node = CoAPSendNode_alloc(context, 0);
+        if (NULL == node) {
+            COAP_ERR("No send node for message id %d", message->header.msgid);
+            return COAP_ERROR_MALLOC;
+        }
+        pdu = node->message;
+        pdulen = context->list.pdulen;
     }
 
-    memset(context->sendbuf, 0x00, COAP_MSG_MAX_PDU_LEN);
-    msglen = CoAPSerialize_Message(message, context->sendbuf, COAP_MSG_MAX_PDU_LEN);
+#ifdef COAP_GROUP_ENABLED
+    /* the slot of the member goes on the wire token only, the node and observation keep the token given */
+    tokenlen = message->header.tokenlen;
+    if (NULL != context->group && 0 != message->header.code) {
+        if (8 - COAP_GROUP_TAG_LEN < tokenlen) {
+            COAP_ERR("No room to tag the token of message id %d", message->header.msgid);
+            if (NULL != node) {
+                CoAPSendNode_free(context, node);
+            }
+            return COAP_ERROR_INVALID_PARAM;
+        }
+        message->token[tokenlen] = (unsigned char)(context->slot >> 8);
+        message->token[tokenlen + 1] = (unsigned char)(context->slot & 0xFF);
+        message->header.tokenlen = tokenlen + COAP_GROUP_TAG_LEN;
+    }
+    msglen = CoAPSerialize_Message(message, pdu, pdulen);
+    message->header.tokenlen = tokenlen;
+#else
+    msglen = CoAPSerialize_Message(message, pdu, pdulen);
+#endif
+    if (0 >= msglen) {
+        COAP_INFO("The message id %d is too loog", message->header.msgid);
+        if (NULL != node) {
+            CoAPSendNode_free(context, node);
+        }
+        return COAP_ERROR_DATA_SIZE;
+    }
     COAP_DEBUG("----The message length %d-----", msglen);
 
+    /* take the node first, a message that couldn't be retransmitted isn't sent */
+    if (retransmit && NULL == node) {
+        node = CoAPSendNode_alloc(context, msglen);
+        if (NULL == node) {
+            COAP_ERR("No send node for message id %d len %d", message->header.msgid, msglen);
+            return COAP_ERROR_MALLOC;
+        }
+        memcpy(node->message, pdu, msglen);
+    }
+
+    /* a full window keeps the CON message until an exchange in flight ends */
+    if (NULL != node && COAP_MESSAGE_TYPE_CON == message->header.type && 0 != context->list.nstart
+        && (context->list.inflight >= context->list.nstart || !list_empty(&context->list.waitlist))) {
+        COAP_DEBUG("Window full, message id %d waits", message->header.msgid);
+        CoAPMessageList_add(context, node, message, msglen, 1);
+        return COAP_SUCCESS;
+    }
 
-    ret = CoAPNetwork_write(&context->network, context->sendbuf, (unsigned int)msglen);
+    ret = CoAPNetwork_write(&context->network, pdu, (unsigned int)msglen);
     if (COAP_SUCCESS == ret) {
-        if (CoAPReqMsg(message->header) || CoAPCONRespMsg(message->header)) {
+        if (NULL != node) {
             COAP_DEBUG("Add message id %d len %d to the list",
                        message->header.msgid, msglen);
-            CoAPMessageList_add(context, message, msglen);
+            CoAPMessageList_add(context, node, message, msglen, 0);
         } else {
             COAP_DEBUG("The message doesn't need to be retransmitted");
         }
     } else {
         COAP_ERR("CoAP transoprt write failed, return %d", ret);
+        if (NULL != node) {
+            CoAPSendNode_free(context, node);
+        }
     }
 
     return ret;
@@ -319,10 +739,13 @@ int CoAPMessage_send(CoAPContext *context, CoAPMessage *message)
 static int CoAPAckMessage_handle(CoAPContext *context, CoAPMessage *message)
 {
     CoAPSendNode *node = NULL;
+    struct list_head *bucket = &context->list.msgid_hash[message->header.msgid & (COAP_SEND_HASH_SIZE - 1)];
 
-    list_for_each_entry(node, &context->list.sendlist, sendlist, CoAPSendNode) {
+    list_for_each_entry(node, bucket, msgid_hash, CoAPSendNode) {
         if (node->msgid == message->header.msgid) {
             node->acked = 1;
+            CoAPSendNode_answered(context, node, 1);
+            CoAPMessageList_kick(context);
             return COAP_SUCCESS;
         }
     }
@@ -338,43 +761,78 @@ static int CoAPAckMessage_send(CoAPContext *context, unsigned short msgid)
     return CoAPMessage_send(context, &message);
 }
 
+static int CoAPRstMessage_send(CoAPContext *context, unsigned short msgid)
+{
+    CoAPMessage message;
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_RST);
+    CoAPMessageId_set(&message, msgid);
+    return CoAPMessage_send(context, &message);
+}
+
+static CoAPSendNode *CoAPSendNode_find(CoAPContext *context, CoAPMessage *message)
+{
+    CoAPSendNode *node = NULL;
+    struct list_head *bucket = NULL;
+
+    bucket = &context->list.token_hash[CoAPToken_hash(message->token, message->header.tokenlen)];
+    list_for_each_entry(node, bucket, token_hash, CoAPSendNode) {
+        if (0 != node->tokenlen && node->tokenlen == message->header.tokenlen
+            && 0 == memcmp(node->token, message->token, message->header.tokenlen)) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
 static int CoAPRespMessage_handle(CoAPContext *context, CoAPMessage *message)
 {
     CoAPSendNode *node = NULL;
+    CoAPObserveNode *observe = NULL;
+    CoAPRespMsgHandler handler = NULL;
+    unsigned int seq = 0;
+
+    node = CoAPSendNode_find(context, message);
+    observe = CoAPObserve_find(context, message->token, message->header.tokenlen);
 
     if (COAP_MESSAGE_TYPE_CON == message->header.type) {
+        if (NULL == node && NULL == observe && COAP_SUCCESS == CoAPObserveOption_get(message, &seq)) {
+            /* nobody observes it anymore, the reset ends the observation at the server */
+            COAP_DEBUG("Reset the notification of an unknown observation");
+            CoAPRstMessage_send(context, message->header.msgid);
+            return COAP_ERROR_NOT_FOUND;
+        }
         CoAPAckMessage_send(context, message->header.msgid);
     }
 
+    if (NULL != node) {
+        COAP_DEBUG("Find the node by token");
+        message->user  = node->user;
+        handler = node->handler;
+
+        /* removed first so the handler can send the next message with the same token */
+        COAP_DEBUG("Remove the message id %d from list", node->msgid);
+        CoAPSendNode_answered(context, node, 1);
+        CoAPMessageList_remove(context, node);
+        node = NULL;
+        CoAPMessageList_kick(context);
+    } else if (NULL == observe) {
+        return COAP_ERROR_NOT_FOUND;
+    }
 
-    list_for_each_entry(node, &context->list.sendlist, sendlist, CoAPSendNode) {
-        if (0 != node->tokenlen && node->tokenlen == message->header.tokenlen
-            && 0 == memcmp(node->token, message->token, message->header.tokenlen)) {
-
-            COAP_DEBUG("Find the node by token");
-            message->user  = node->user;
-            if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code) {
-                /* TODO:i */
-                if (NULL != context->notifier) {
-                    context->notifier(message->header.code, message);
-                }
-            }
-
-            if (NULL != node->handler) {
-                node->handler(node->user, message);
-            }
-            COAP_DEBUG("Remove the message id %d from list", node->msgid);
-            list_del_init(&node->sendlist);
-            context->list.count--;
-            if (NULL != node->message) {
-                coap_free(node->message);
-            }
-            coap_free(node);
-            node = NULL;
-            return COAP_SUCCESS;
+    if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code) {
+        /* TODO:i */
+        if (NULL != context->notifier) {
+            context->notifier(message->header.code, message);
         }
     }
-    return COAP_ERROR_NOT_FOUND;
+
+    if (NULL != observe) {
+        CoAPObserve_notify(observe, message);
+    } else if (NULL != handler) {
+        handler(message->user, message);
+    }
+    return COAP_SUCCESS;
 }
 
 static void CoAPMessage_handle(CoAPContext *context,
@@ -387,7 +845,7 @@ static void CoAPMessage_handle(CoAPContext *context,
 
     ret = CoAPDeserialize_Message(&message, buf, datalen);
     if (NULL != message.payload) {
-        COAP_DEBUG("-----payload: %s---", message.payload);
+        COAP_DEBUG("-----payload: %.*s---", message.payloadlen, message.payload);
     }
     COAP_DEBUG("-----code   : 0x%x---", message.header.code);
     COAP_DEBUG("-----type   : 0x%x---", message.header.type);
@@ -399,6 +857,13 @@ static void CoAPMessage_handle(CoAPContext *context,
             /* TODO: */
             /* context->notifier(context, event); */
         }
+        /* RFC 7252 4.2, a malformed confirmable message is rejected, anything else malformed is dropped */
+        COAP_INFO("Drop malformed CoAP message, ret %d", ret);
+        if (4 <= datalen && COAP_CUR_VERSION == message.header.version
+            && COAP_MESSAGE_TYPE_CON == message.header.type) {
+            CoAPRstMessage_send(context, message.header.msgid);
+        }
+        return;
     }
 
     if (COAPAckMsg(message.header)) {
@@ -411,11 +876,139 @@ static void CoAPMessage_handle(CoAPContext *context,
     }
 }
 
+#ifdef COAP_GROUP_ENABLED
+static void CoAPMessage_tick(CoAPContext *context);
+
+/* the member a datagram of the group is for, the tag is taken off its token so the member sees the one it sent */
+static CoAPContext *CoAPGroup_member(CoAPGroup *group, unsigned char *buf, int *len)
+{
+    unsigned int type = 0;
+    unsigned int tkl = 0;
+    unsigned int slot = 0;
+    int tagged = 0;
+
+    if (4 > *len) {
+        return NULL;
+    }
+    type = (buf[0] >> 4) & 0x03;
+    tkl = buf[0] & 0x0F;
+
+    if (0 != buf[1] && COAP_GROUP_TAG_LEN <= tkl && 8 >= tkl && (int)(4 + tkl) <= *len) {
+        slot = ((unsigned int)buf[2 + tkl] << 8) | buf[3 + tkl];
+        buf[0] = (buf[0] & 0xF0) | (tkl - COAP_GROUP_TAG_LEN);
+        memmove(buf + 2 + tkl, buf + 4 + tkl, *len - 4 - tkl);
+        *len -= COAP_GROUP_TAG_LEN;
+        tagged = 1;
+    }
+
+    /* the message id of an ACK or RST is ours, a separate response or notification echoes the token only */
+    if (COAP_MESSAGE_TYPE_ACK == type || COAP_MESSAGE_TYPE_RST == type) {
+        slot = (((unsigned int)buf[2] << 8) | buf[3]) >> group->idbits;
+    } else if (!tagged) {
+        return NULL;
+    }
+
+    if (slot >= group->capacity) {
+        return NULL;
+    }
+    return group->members[slot];
+}
+
+/* readcount counts the datagrams of context only, the others are handled meanwhile. With none it reads for timeout */
+static int CoAPGroup_recv(CoAPGroup *group, CoAPContext *context, unsigned int timeout, int readcount)
+{
+    int len = 0;
+    int count = readcount;
+    uint64_t start = HAL_UptimeMs();
+    CoAPContext *member = NULL;
+
+    while (1) {
+        len = CoAPNetwork_read(&group->network, group->recvbuf, COAP_MSG_MAX_PDU_LEN, timeout);
+        if (len <= 0) {
+            return 0;
+        }
+
+        member = CoAPGroup_member(group, group->recvbuf, &len);
+        if (NULL == member) {
+            COAP_DEBUG("Drop a datagram of no member");
+        } else {
+            CoAPMessage_handle(member, group->recvbuf, len);
+            if (0 != readcount && member == context && 0 == --count) {
+                return len;
+            }
+        }
+
+        /* the members share the socket, a busy one must not hold off the ticks of all */
+        if (0 == readcount && HAL_UptimeMs() - start >= timeout) {
+            return 0;
+        }
+    }
+}
+
+int CoAPGroup_cycle(CoAPGroup *group)
+{
+    unsigned int i = 0;
+
+    CoAPGroup_recv(group, NULL, group->waittime, 0);
+    for (i = 0; i < group->capacity; i++) {
+        if (NULL != group->members[i]) {
+            CoAPMessage_tick(group->members[i]);
+        }
+    }
+    return COAP_SUCCESS;
+}
+#endif
+
+#ifdef COAP_BATCH_RECV_ENABLED
+/* every wakeup drains the datagrams already queued, each is handled in place in its receive slot */
+int CoAPMessage_recv(CoAPContext *context, unsigned int timeout, int readcount)
+{
+    int num = 0;
+    int i = 0;
+    int count = readcount;
+    unsigned int batch = COAP_RECV_BATCH_COUNT;
+
+#ifdef COAP_GROUP_ENABLED
+    if (NULL != context->group) {
+        return CoAPGroup_recv(context->group, context, timeout, readcount);
+    }
+#endif
+
+    while (1) {
+        if (0 != readcount && (unsigned int)count < batch) {
+            batch = count;
+        }
+        num = CoAPNetwork_readBatch(&context->network, context->recvslot,
+                                    COAP_MSG_MAX_PDU_LEN, context->recvlen, batch, timeout);
+        if (num <= 0) {
+            return 0;
+        }
+        for (i = 0; i < num; i++) {
+            if (0 == context->recvlen[i]) {
+                continue;
+            }
+            CoAPMessage_handle(context, context->recvslot[i], context->recvlen[i]);
+            if (0 != readcount) {
+                count--;
+                if (0 == count) {
+                    return context->recvlen[i];
+                }
+            }
+        }
+    }
+}
+#else
 int CoAPMessage_recv(CoAPContext *context, unsigned int timeout, int readcount)
 {
     int len = 0;
     int count = readcount;
 
+#ifdef COAP_GROUP_ENABLED
+    if (NULL != context->group) {
+        return CoAPGroup_recv(context->group, context, timeout, readcount);
+    }
+#endif
+
     while (1) {
         len = CoAPNetwork_read(&context->network, context->recvbuf,
                                COAP_MSG_MAX_PDU_LEN, timeout);
@@ -435,51 +1028,178 @@ int CoAPMessage_recv(CoAPContext *context, unsigned int timeout, int readcount)
         }
     }
 }
+#endif
 
-int CoAPMessage_cycle(CoAPContext *context)
+/* CoCoA retransmission, the timeout follows the RTO estimate instead of doubling fixed ticks */
+static void CoAPMessage_retransmit(CoAPContext *context, CoAPSendNode *node)
 {
-    unsigned int ret = 0;
-    CoAPMessage_recv(context, context->waittime, 0);
+    unsigned int ret = COAP_SUCCESS;
+
+    if (node->retrans_count >= CoAPMaxRetry(context)) {
+        COAP_INFO("Retransmit timeout,remove the message id %d count %d",
+                  node->msgid, context->list.count - 1);
+        LITE_METRIC_ADD(coap_timeouts, 1);
+        CoAPMessageList_drop(context, node);
+        return;
+    }
 
+    node->retrans_count++;
+    LITE_METRIC_ADD(coap_retransmits, 1);
+    node->rto_ms  = CoAPRtt_backoff(context, node->rto_ms);
+    node->timeout = CoAPRtt_ticks(context, node->rto_ms);
+    COAP_DEBUG("Retansmit the message id %d len %d after %d ms", node->msgid, node->msglen, node->rto_ms);
+    ret = CoAPNetwork_write(&context->network, node->message, node->msglen);
+    if (ret != COAP_SUCCESS) {
+        COAP_ERR("CoAP transoprt write failed, return %d", ret);
+    }
+    CoAPMessageList_schedule(context, node);
+}
+
+/* one retransmit timer tick, a tick lasts about waittime */
+static void CoAPMessage_tick(CoAPContext *context)
+{
+    unsigned int ret = 0;
     CoAPSendNode *node = NULL, *next = NULL;
-    list_for_each_entry_safe(node, next, &context->list.sendlist, sendlist, CoAPSendNode) {
-        if (NULL != node) {
-            if (node->timeout == 0) {
-                if (node->retrans_count < COAP_MAX_RETRY_COUNT && (0 == node->acked)) {
-                    node->timeout     = node->timeout_val * 2;
-                    node->timeout_val = node->timeout;
-                    node->retrans_count++;
-                    COAP_DEBUG("Retansmit the message id %d len %d", node->msgid, node->msglen);
-                    ret = CoAPNetwork_write(&context->network, node->message, node->msglen);
-                    if (ret != COAP_SUCCESS) {
-                        if (NULL != context->notifier) {
-                            /* TODO: */
-                            /* context->notifier(context, event); */
-                        }
-                    }
-                }
+    struct list_head *slot = NULL;
+
+    /* only the nodes due at this tick are visited, the others wait in their wheel slot */
+    context->list.tick++;
+    slot = &context->list.timer_wheel[context->list.tick & (COAP_SEND_TIMER_WHEEL_SIZE - 1)];
+    list_for_each_entry_safe(node, next, slot, timer, CoAPSendNode) {
+        if (node->deadline != context->list.tick) {
+            continue;
+        }
 
-                if ((node->timeout > COAP_MAX_TRANSMISSION_SPAN) ||
-                    (node->retrans_count >= COAP_MAX_RETRY_COUNT)) {
-                    if (NULL != context->notifier) {
-                        /* TODO: */
-                        /* context->notifier(context, event); */
-                    }
-
-                    /*Remove the node from the list*/
-                    list_del_init(&node->sendlist);
-                    context->list.count--;
-                    COAP_INFO("Retransmit timeout,remove the message id %d count %d",
-                              node->msgid, context->list.count);
-                    coap_free(node->message);
-                    coap_free(node);
+        if (context->list.cocoa && node->inflight) {
+            CoAPMessage_retransmit(context, node);
+            continue;
+        }
+
+        if (node->retrans_count < CoAPMaxRetry(context) && (0 == node->acked)) {
+            node->timeout     = node->timeout_val * 2;
+            node->timeout_val = node->timeout;
+            node->retrans_count++;
+            LITE_METRIC_ADD(coap_retransmits, 1);
+            COAP_DEBUG("Retansmit the message id %d len %d", node->msgid, node->msglen);
+            ret = CoAPNetwork_write(&context->network, node->message, node->msglen);
+            if (ret != COAP_SUCCESS) {
+                if (NULL != context->notifier) {
+                    /* TODO: */
+                    /* context->notifier(context, event); */
                 }
             }
-             else {
-                node->timeout--;
+        }
+
+        if ((node->timeout > COAP_MAX_TRANSMISSION_SPAN) ||
+            (node->retrans_count >= CoAPMaxRetry(context))) {
+            if (NULL != context->notifier) {
+                /* TODO: */
+                /* context->notifier(context, event); */
             }
+
+            /*Remove the node from the list*/
+            COAP_INFO("Retransmit timeout,remove the message id %d count %d",
+                      node->msgid, context->list.count - 1);
+            LITE_METRIC_ADD(coap_timeouts, 1);
+            CoAPMessageList_drop(context, node);
+        } else if (0 != node->acked) {
+            /* acked, only waits for its response now */
+            list_del_init(&node->timer);
+        } else {
+            CoAPMessageList_schedule(context, node);
+        }
+    }
+
+    if (context->list.cocoa) {
+        CoAPRtt_age(context);
+    }
+    CoAPMessageList_kick(context);
+}
+
+int CoAPMessage_cycle(CoAPContext *context)
+{
+    CoAPMessage_recv(context, context->waittime, 0);
+    CoAPMessage_tick(context);
+    return COAP_SUCCESS;
+}
+
+#ifdef HAL_EVENT_ENABLED
+/* ticks follow uptime here as nothing waits, a long stall runs at most a wheel of them */
+int CoAPMessage_process(CoAPContext *context)
+{
+    int len = 0;
+    int ticks = 0;
+    uint64_t now = 0;
+    unsigned int tick_ms = (0 == context->waittime) ? 1 : context->waittime;
+
+#ifdef COAP_GROUP_ENABLED
+    CoAPContext *member = NULL;
+
+    /* the datagrams of the other members are handled too, each process of any member drains the socket */
+    if (NULL != context->group) {
+        while (0 < (len = CoAPNetwork_readNonblock(&context->group->network, context->group->recvbuf,
+                                                   COAP_MSG_MAX_PDU_LEN))) {
+            member = CoAPGroup_member(context->group, context->group->recvbuf, &len);
+            if (NULL != member) {
+                CoAPMessage_handle(member, context->group->recvbuf, len);
+            }
+        }
+    } else {
+        while (0 < (len = CoAPNetwork_readNonblock(&context->network, context->recvbuf, COAP_MSG_MAX_PDU_LEN))) {
+            CoAPMessage_handle(context, context->recvbuf, len);
         }
     }
+#else
+    while (0 < (len = CoAPNetwork_readNonblock(&context->network, context->recvbuf, COAP_MSG_MAX_PDU_LEN))) {
+        CoAPMessage_handle(context, context->recvbuf, len);
+    }
+#endif
+
+    now = HAL_UptimeMs();
+    if (0 == context->nexttick_ms) {
+        context->nexttick_ms = now + tick_ms;
+    }
+    while (context->nexttick_ms <= now) {
+        CoAPMessage_tick(context);
+        context->nexttick_ms += tick_ms;
+        if (COAP_SEND_TIMER_WHEEL_SIZE <= ++ticks) {
+            context->nexttick_ms = now + tick_ms;
+        }
+    }
+
     return COAP_SUCCESS;
 }
 
+/* the ticks with no node due are slept through, CoAPMessage_process catches up on them when it wakes */
+unsigned int CoAPMessage_timeout(CoAPContext *context)
+{
+    uint64_t now = HAL_UptimeMs();
+    unsigned int tick_ms = (0 == context->waittime) ? 1 : context->waittime;
+    unsigned int wait = 0;
+    unsigned int d = 0;
+    int pending = 0;
+    CoAPSendNode *node = NULL;
+    struct list_head *slot = NULL;
+
+    if (0 == context->nexttick_ms) {
+        return 0;
+    }
+    wait = (context->nexttick_ms > now) ? (unsigned int)(context->nexttick_ms - now) : 0;
+    if (!list_empty(&context->list.waitlist)) {
+        return wait;
+    }
+
+    for (d = 1; d <= COAP_SEND_TIMER_WHEEL_SIZE; d++) {
+        slot = &context->list.timer_wheel[(context->list.tick + d) & (COAP_SEND_TIMER_WHEEL_SIZE - 1)];
+        list_for_each_entry(node, slot, timer, CoAPSendNode) {
+            if (node->deadline == context->list.tick + d) {
+                return wait + (d - 1) * tick_ms;
+            }
+            pending = 1;
+        }
+    }
+
+    /* a node due further than a turn of the wheel is checked a turn from now, the most caught up at once */
+    return pending ? wait + (COAP_SEND_TIMER_WHEEL_SIZE - 1) * tick_ms : 0xFFFFFFFF;
+}
+#endif
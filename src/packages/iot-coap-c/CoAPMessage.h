@@ -29,6 +29,11 @@ int CoAPStrOption_add(CoAPMessage *message, unsigned short optnum,
 int CoAPUintOption_add(CoAPMessage *message, unsigned short  optnum,
             unsigned int data);
 
+/* uint option of a received message, found in its PDU */
+int CoAPUintOption_get(CoAPMessage *message, unsigned short optnum, unsigned int *data);
+
+int CoAPPathOption_add(CoAPMessage *message, CoAPPath *path);
+
 unsigned short CoAPMessageId_gen(CoAPContext *context);
 
 int CoAPMessageId_set(CoAPMessage *message, unsigned short msgid);
@@ -49,6 +54,9 @@ int CoAPMessageHandler_set(CoAPMessage *message, CoAPRespMsgHandler handler);
 
 int CoAPMessage_init(CoAPMessage *message);
 
+/* next option of a received message, views into its receive buffer. COAP_ERROR_NOT_FOUND after the last one */
+int CoAPMessageOption_next(CoAPMessage *message, CoAPMsgOptionIter *iter, CoAPMsgOption *option);
+
 int CoAPMessage_destory(CoAPMessage *message);
 
 int CoAPMessage_send(CoAPContext *context, CoAPMessage *message);
@@ -57,6 +65,19 @@ int CoAPMessage_recv(CoAPContext *context, unsigned int timeout, int readcount);
 
 int CoAPMessage_cycle(CoAPContext *context);
 
+#ifdef COAP_GROUP_ENABLED
+/* receive for the members of the group for its waittime, then run a retransmit tick of each */
+int CoAPGroup_cycle(CoAPGroup *group);
+#endif
+
+#ifdef HAL_EVENT_ENABLED
+/* handle the datagrams already arrived and the retransmit ticks due, never blocks */
+int CoAPMessage_process(CoAPContext *context);
+
+/* ms till CoAPMessage_process has ticks due */
+unsigned int CoAPMessage_timeout(CoAPContext *context);
+#endif
+
 
 
 #endif
@@ -147,6 +147,53 @@ int CoAPNetwork_read(coap_network_t *network, unsigned char  *data,
     return len;
 }
 
+#ifdef COAP_BATCH_SEND_ENABLED
+/* returns the number of datagrams of data[0..count) sent, a DTLS session writes one record at a time */
+int CoAPNetwork_writeBatch(coap_network_t *network, const unsigned char **data,
+                           const unsigned int *len, unsigned int count)
+{
+    int rc = 0;
+
+#ifdef COAP_DTLS_SUPPORT
+    if (COAP_ENDPOINT_DTLS == network->ep_type) {
+        for (rc = 0; rc < (int)count; rc++) {
+            if (COAP_SUCCESS != CoAPNetwork_write(network, data[rc], len[rc])) {
+                break;
+            }
+        }
+        return rc;
+    }
+#endif
+    rc = HAL_UDP_writeBatch((void *)network->context, data, len, count);
+    COAP_TRC(">> CoAP sent %d datagrams", rc);
+    return rc < 0 ? 0 : rc;
+}
+#endif
+
+#ifdef COAP_BATCH_RECV_ENABLED
+/* returns the number of datagrams read into data[0..count), a DTLS session reads one record at a time */
+int CoAPNetwork_readBatch(coap_network_t *network, unsigned char **data,
+                          unsigned int datalen, unsigned int *len,
+                          unsigned int count, unsigned int timeout)
+{
+    int rc = 0;
+
+#ifdef COAP_DTLS_SUPPORT
+    if (COAP_ENDPOINT_DTLS == network->ep_type)  {
+        rc = CoAPNetwork_read(network, data[0], datalen, timeout);
+        if (rc > 0) {
+            len[0] = rc;
+            rc = 1;
+        }
+        return rc;
+    }
+#endif
+    rc = HAL_UDP_readBatch((void *)network->context, data, datalen, len, count, timeout);
+    COAP_TRC("<< CoAP recv %d datagrams", rc);
+    return rc;
+}
+#endif
+
 unsigned int CoAPNetwork_init(const coap_network_init_t *p_param, coap_network_t *p_network)
 {
     unsigned int    err_code = COAP_SUCCESS;
@@ -178,6 +225,32 @@ unsigned int CoAPNetwork_init(const coap_network_init_t *p_param, coap_network_t
 }
 
 
+#ifdef HAL_EVENT_ENABLED
+intptr_t CoAPNetwork_fd(coap_network_t *network)
+{
+#ifdef COAP_DTLS_SUPPORT
+    if (COAP_ENDPOINT_DTLS == network->ep_type) {
+        return -1;
+    }
+#endif
+    return (intptr_t)HAL_UDP_getFd(network->context);
+}
+
+int CoAPNetwork_readNonblock(coap_network_t *network, unsigned char *data, unsigned int datalen)
+{
+    int len = 0;
+
+#ifdef COAP_DTLS_SUPPORT
+    if (COAP_ENDPOINT_DTLS == network->ep_type) {
+        return 0;
+    }
+#endif
+    len = HAL_UDP_readNonblock(network->context, data, datalen);
+    COAP_TRC("<< CoAP recv %d bytes data", len);
+    return (len > 0) ? len : 0;
+}
+#endif
+
 unsigned int CoAPNetwork_deinit(coap_network_t *p_network)
 {
     unsigned int    err_code = COAP_SUCCESS;
@@ -63,6 +63,25 @@ unsigned int CoAPNetwork_write(coap_network_t *p_network,
 int CoAPNetwork_read(coap_network_t *network, unsigned char  *data,
                       unsigned int datalen, unsigned int timeout);
 
+#ifdef COAP_BATCH_SEND_ENABLED
+int CoAPNetwork_writeBatch(coap_network_t *network, const unsigned char **data,
+                      const unsigned int *len, unsigned int count);
+#endif
+
+#ifdef COAP_BATCH_RECV_ENABLED
+int CoAPNetwork_readBatch(coap_network_t *network, unsigned char **data,
+                      unsigned int datalen, unsigned int *len,
+                      unsigned int count, unsigned int timeout);
+#endif
+
+#ifdef HAL_EVENT_ENABLED
+/* descriptor to wait for readiness on, -1 for a DTLS session as the DTLS HAL does not expose it */
+intptr_t CoAPNetwork_fd(coap_network_t *network);
+
+/* one datagram already arrived, 0 when none */
+int CoAPNetwork_readNonblock(coap_network_t *network, unsigned char *data, unsigned int datalen);
+#endif
+
 unsigned int CoAPNetwork_deinit(coap_network_t *p_network);
 
 
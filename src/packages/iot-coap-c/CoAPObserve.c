@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "iot_import.h"
+#include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "CoAPObserve.h"
+
+#define COAP_OBSERVE_SEQ_HALF     (1U << 23)
+#define COAP_OBSERVE_FRESH_MS     (128 * 1000)
+
+#define CoAPSuccessMsg(code)\
+    (((code) >> 5) == 2)
+
+int CoAPObserveOption_get(CoAPMessage *message, unsigned int *seq)
+{
+    int ret = COAP_SUCCESS;
+    unsigned int value = 0;
+
+    if (NULL == message || NULL == seq) {
+        return COAP_ERROR_NULL;
+    }
+
+    ret = CoAPUintOption_get(message, COAP_OPTION_OBSERVE, &value);
+    if (COAP_SUCCESS != ret) {
+        return ret;
+    }
+    if (0xFFFFFF < value) {
+        return COAP_ERROR_INVALID_LENGTH;
+    }
+    *seq = value;
+
+    return COAP_SUCCESS;
+}
+
+/* RFC 7641 3.4, newer in 24 bit serial number order, or anything after 128 seconds */
+static int CoAPObserve_fresh(CoAPObserveNode *node, unsigned int seq, uint64_t now)
+{
+    if (!node->seq_valid) {
+        return 1;
+    }
+
+    return (node->seq < seq && seq - node->seq < COAP_OBSERVE_SEQ_HALF)
+           || (node->seq > seq && node->seq - seq > COAP_OBSERVE_SEQ_HALF)
+           || (now > node->seq_ms + COAP_OBSERVE_FRESH_MS);
+}
+
+/* handler of the registration request, only reached when it is dropped or the node was deregistered meanwhile */
+static void CoAPObserve_dropped(void *data, void *p_message)
+{
+    CoAPObserveNode *node = (CoAPObserveNode *)data;
+    CoAPRespMsgHandler handler = node->handler;
+    void *user = node->user;
+
+    if (list_empty(&node->observelist)) {
+        coap_free(node);
+        return;
+    }
+
+    list_del_init(&node->observelist);
+    coap_free(node);
+    if (NULL != handler) {
+        handler(user, p_message);
+    }
+}
+
+static int CoAPObserve_send(CoAPContext *context, CoAPObserveNode *node, unsigned int observe,
+                            CoAPRespMsgHandler handler, void *user)
+{
+    int i = 0;
+    int ret = COAP_SUCCESS;
+    CoAPMessage message;
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, node->header.type);
+    CoAPMessageCode_set(&message, (CoAPMessageCode)node->header.code);
+    CoAPMessageId_set(&message, CoAPMessageId_gen(context));
+    CoAPMessageToken_set(&message, node->token, node->header.tokenlen);
+    CoAPMessageHandler_set(&message, handler);
+    message.user = user;
+    message.drop_notify = (NULL != handler);
+
+    ret = CoAPUintOption_add(&message, COAP_OPTION_OBSERVE, observe);
+    for (i = 0; i < node->optnum && COAP_SUCCESS == ret; i++) {
+        ret = CoAPStrOption_add(&message, node->options[i].num, node->options[i].val, node->options[i].len);
+    }
+    if (COAP_SUCCESS == ret) {
+        ret = CoAPMessage_send(context, &message);
+    }
+    CoAPMessage_destory(&message);
+
+    return ret;
+}
+
+int CoAPObserve_register(CoAPContext *context, CoAPMessage *message)
+{
+    int i = 0;
+    int ret = COAP_SUCCESS;
+    unsigned int optlen = 0;
+    unsigned short optnum = 0;
+    unsigned char *ptr = NULL;
+    CoAPObserveNode *node = NULL;
+
+    if (NULL == context || NULL == message) {
+        return COAP_ERROR_NULL;
+    }
+    if (0 == message->header.tokenlen) {
+        COAP_ERR("Observation needs a token");
+        return COAP_ERROR_INVALID_PARAM;
+    }
+    if (NULL != CoAPObserve_find(context, message->token, message->header.tokenlen)) {
+        COAP_ERR("The token is observed already");
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    for (i = 0; i < message->optnum; i++) {
+        optlen += message->options[i].len;
+    }
+
+    /* the registered options are kept for the deregistration request */
+    node = coap_malloc(sizeof(CoAPObserveNode) + optlen);
+    if (NULL == node) {
+        return COAP_ERROR_MALLOC;
+    }
+    memset(node, 0x00, sizeof(CoAPObserveNode));
+    node->user    = message->user;
+    node->handler = message->handler;
+    node->header  = message->header;
+    memcpy(node->token, message->token, message->header.tokenlen);
+
+    ptr = (unsigned char *)(node + 1);
+    for (i = 0; i < message->optnum; i++) {
+        optnum += message->options[i].num;
+        if (COAP_OPTION_OBSERVE == optnum) {
+            continue;
+        }
+        node->options[node->optnum].num = optnum;
+        node->options[node->optnum].len = message->options[i].len;
+        node->options[node->optnum].val = ptr;
+        memcpy(ptr, message->options[i].val, message->options[i].len);
+        ptr += message->options[i].len;
+        node->optnum++;
+    }
+
+    list_add_tail(&node->observelist, &context->observelist);
+    node->registering = 1;
+    ret = CoAPObserve_send(context, node, COAP_OBSERVE_REGISTER, CoAPObserve_dropped, node);
+    if (COAP_SUCCESS != ret) {
+        list_del_init(&node->observelist);
+        coap_free(node);
+    }
+
+    return ret;
+}
+
+int CoAPObserve_deregister(CoAPContext *context, unsigned char *token, unsigned char tokenlen, int notify)
+{
+    int ret = COAP_SUCCESS;
+    CoAPObserveNode *node = NULL;
+
+    if (NULL == context || NULL == token) {
+        return COAP_ERROR_NULL;
+    }
+
+    node = CoAPObserve_find(context, token, tokenlen);
+    if (NULL == node) {
+        return COAP_ERROR_NOT_FOUND;
+    }
+
+    list_del_init(&node->observelist);
+    if (notify) {
+        ret = CoAPObserve_send(context, node, COAP_OBSERVE_DEREGISTER, NULL, NULL);
+    }
+
+    /* a pending registration request still refers to the node, it is freed with it */
+    if (!node->registering) {
+        coap_free(node);
+    }
+
+    return ret;
+}
+
+CoAPObserveNode *CoAPObserve_find(CoAPContext *context, unsigned char *token, unsigned char tokenlen)
+{
+    CoAPObserveNode *node = NULL;
+
+    if (0 == tokenlen) {
+        return NULL;
+    }
+
+    list_for_each_entry(node, &context->observelist, observelist, CoAPObserveNode) {
+        if (node->header.tokenlen == tokenlen && 0 == memcmp(node->token, token, tokenlen)) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+void CoAPObserve_notify(CoAPObserveNode *node, CoAPMessage *message)
+{
+    unsigned int seq = 0;
+    uint64_t now = HAL_UptimeMs();
+    CoAPRespMsgHandler handler = node->handler;
+    void *user = node->user;
+
+    node->registering = 0;
+    message->user = user;
+
+    if (!CoAPSuccessMsg(message->header.code) || COAP_SUCCESS != CoAPObserveOption_get(message, &seq)) {
+        COAP_INFO("Observation ended with code 0x%x", message->header.code);
+        list_del_init(&node->observelist);
+        coap_free(node);
+        if (NULL != handler) {
+            handler(user, message);
+        }
+        return;
+    }
+
+    if (!CoAPObserve_fresh(node, seq, now)) {
+        COAP_DEBUG("Drop the stale notification %d, last %d", seq, node->seq);
+        return;
+    }
+
+    node->seq_valid = 1;
+    node->seq = seq;
+    node->seq_ms = now;
+    if (NULL != handler) {
+        handler(user, message);
+    }
+}
+
+void CoAPObserve_free(CoAPContext *context)
+{
+    CoAPObserveNode *node = NULL, *next = NULL;
+    CoAPRespMsgHandler handler = NULL;
+    void *user = NULL;
+
+    list_for_each_entry_safe(node, next, &context->observelist, observelist, CoAPObserveNode) {
+        handler = node->handler;
+        user = node->user;
+        list_del_init(&node->observelist);
+        coap_free(node);
+        if (NULL != handler) {
+            handler(user, NULL);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "CoAPExport.h"
+
+#ifndef __COAP_OBSERVE_H__
+#define __COAP_OBSERVE_H__
+
+#define COAP_OBSERVE_REGISTER     0
+#define COAP_OBSERVE_DEREGISTER   1
+
+typedef struct
+{
+    void                    *user;
+    CoAPRespMsgHandler       handler;
+    CoAPMsgHeader            header;
+    unsigned char            token[COAP_MSG_MAX_TOKEN_LEN];
+    CoAPMsgOption            options[COAP_MSG_MAX_OPTION_NUM];  /* absolute numbers, values stored after the node */
+    unsigned char            optnum;
+    unsigned char            registering;   /* the registration request is still in the send list */
+    unsigned char            seq_valid;
+    unsigned int             seq;           /* Observe value of the last notification */
+    uint64_t                 seq_ms;        /* when it was received */
+    struct list_head         observelist;
+} CoAPObserveNode;
+
+int CoAPObserveOption_get(CoAPMessage *message, unsigned int *seq);
+
+/*
+ * register an observation with message, an Observe option is added to it.
+ * The handler of message gets every fresh notification. The observation
+ * ends with a final response, which is an error or has no Observe option,
+ * or with NULL when it is dropped unanswered.
+ */
+int CoAPObserve_register(CoAPContext *context, CoAPMessage *message);
+
+/* forget the observation of token, notify sends a deregistration request with the registered options */
+int CoAPObserve_deregister(CoAPContext *context, unsigned char *token, unsigned char tokenlen, int notify);
+
+CoAPObserveNode *CoAPObserve_find(CoAPContext *context, unsigned char *token, unsigned char tokenlen);
+
+void CoAPObserve_notify(CoAPObserveNode *node, CoAPMessage *message);
+
+void CoAPObserve_free(CoAPContext *context);
+
+#endif
@@ -18,8 +18,10 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include "CoAPSerialize.h"
 #include "CoAPExport.h"
+#include "iot_import.h"
 
 int CoAPSerialize_Header(CoAPMessage *msg, unsigned char *buf, unsigned short buflen)
 {
@@ -99,9 +101,16 @@ static unsigned short CoAPSerialize_Option(CoAPMsgOption *option, unsigned char
     memcpy(ptr, option->val, option->len);
     ptr += option->len;
 
+    if (NULL != option->tail) {
+        memcpy(ptr, option->tail, option->taillen);
+        ptr += option->taillen;
+    }
+
     return (int)(ptr - buf);
 }
 
+static unsigned short CoAPSerialize_OptionLen(CoAPMsgOption *option);
+
 unsigned short CoAPSerialize_Options(CoAPMessage *msg,  unsigned char * buf, unsigned short buflen)
 {
     int i      = 0;
@@ -110,6 +119,9 @@ unsigned short CoAPSerialize_Options(CoAPMessage *msg,  unsigned char * buf, uns
     for (i = 0; i < msg->optnum; i++)
     {
         unsigned short len = 0;
+        if (CoAPSerialize_OptionLen(&msg->options[i]) > buflen - count){
+            return 0;
+        }
         len = CoAPSerialize_Option(&msg->options[i], &buf[count]);
         if (0 < len){
             count += len;
@@ -145,6 +157,9 @@ static unsigned short CoAPSerialize_OptionLen(CoAPMsgOption *option)
     }
 
     len += option->len;
+    if (NULL != option->tail) {
+        len += option->taillen;
+    }
     return len;
 }
 
@@ -172,7 +187,7 @@ unsigned short CoAPSerialize_OptionsLen(CoAPMessage *msg)
 
 int CoAPSerialize_Payload(CoAPMessage *msg, unsigned char *buf, int buflen)
 {
-    if(msg->payloadlen + 1 > buflen){
+    if(msg->payloadlen > 0 && msg->payloadlen + 1 > buflen){
         return -1;
     }
     if(msg->payloadlen > 0 && NULL != msg->payload)
@@ -203,10 +218,11 @@ unsigned short CoAPSerialize_MessageLength(CoAPMessage *msg)
     return msglen;
 }
 
+/* single pass into buf, returns the message length, 0 when buf is too small */
 int CoAPSerialize_Message(CoAPMessage *msg, unsigned char *buf, unsigned short buflen)
 {
     unsigned char *ptr   = buf;
-    unsigned short count = 0;
+    int            count = 0;
     unsigned short remlen  = buflen;
 
     if(NULL == buf || NULL == msg){
@@ -214,21 +230,102 @@ int CoAPSerialize_Message(CoAPMessage *msg, unsigned char *buf, unsigned short b
     }
 
     count = CoAPSerialize_Header(msg, ptr, remlen);
+    if(0 == count){
+        return 0;
+    }
     ptr += count;
     remlen -= count;
 
+    if(remlen < msg->header.tokenlen){
+        return 0;
+    }
     count = CoAPSerialize_Token(msg, ptr, remlen);
     ptr += count;
     remlen -= count;
 
 
     count = CoAPSerialize_Options(msg, ptr, remlen);
+    if(0 == count && 0 < msg->optnum){
+        return 0;
+    }
     ptr += count;
     remlen -= count;
 
     count = CoAPSerialize_Payload(msg, ptr, remlen);
+    if(0 > count){
+        return 0;
+    }
     ptr += count;
     remlen -= count;
 
     return (buflen-remlen);
 }
+
+/* segments of uri between slashes, empty ones skipped, each at most 255 bytes as the Uri-Path allows */
+CoAPPath *CoAPPath_create(const char *uri)
+{
+    const char *ptr = NULL;
+    const char *seg = NULL;
+    unsigned int total = 0;
+    unsigned short count = 0;
+    CoAPMsgOption option;
+    CoAPPath *path = NULL;
+    unsigned char *buf = NULL;
+
+    if (NULL == uri) {
+        return NULL;
+    }
+
+    /* the first segment as it is, every other one with its option header */
+    for (ptr = uri; '\0' != *ptr; ptr = seg) {
+        for (; '/' == *ptr; ptr++);
+        for (seg = ptr; '\0' != *seg && '/' != *seg; seg++);
+        if (seg == ptr) {
+            break;
+        }
+        if (255 < seg - ptr) {
+            return NULL;
+        }
+        total += (unsigned int)(seg - ptr) + ((0 == count) ? 0 : ((13 <= seg - ptr) ? 2 : 1));
+        count++;
+    }
+    if (0 == count || COAP_MSG_MAX_PDU_LEN < total) {
+        return NULL;
+    }
+
+    path = (CoAPPath *)coap_malloc(sizeof(CoAPPath) + total);
+    if (NULL == path) {
+        return NULL;
+    }
+    memset(path, 0x00, sizeof(CoAPPath));
+
+    buf = path->buf;
+    memset(&option, 0x00, sizeof(CoAPMsgOption));
+    for (count = 0, ptr = uri; '\0' != *ptr; ptr = seg) {
+        for (; '/' == *ptr; ptr++);
+        for (seg = ptr; '\0' != *seg && '/' != *seg; seg++);
+        if (seg == ptr) {
+            break;
+        }
+        if (0 == count) {
+            path->firstlen = (unsigned short)(seg - ptr);
+            memcpy(buf, ptr, path->firstlen);
+            buf += path->firstlen;
+        } else {
+            option.len = (unsigned short)(seg - ptr);
+            option.val = (unsigned char *)ptr;
+            buf += CoAPSerialize_Option(&option, buf);
+        }
+        count++;
+    }
+    path->taillen = (unsigned short)(buf - path->buf - path->firstlen);
+
+    return path;
+}
+
+void CoAPPath_free(CoAPPath *path)
+{
+    if (NULL != path) {
+        coap_free(path);
+    }
+}
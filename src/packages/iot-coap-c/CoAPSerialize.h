@@ -23,7 +23,12 @@
 
 unsigned short CoAPSerialize_MessageLength(CoAPMessage *msg);
 
+/* returns the message length, 0 when buflen is too small */
 int CoAPSerialize_Message(CoAPMessage *msg, unsigned char *buf, unsigned short buflen);
 
+CoAPPath *CoAPPath_create(const char *uri);
+
+void CoAPPath_free(CoAPPath *path);
+
 #endif
 
@@ -1,5 +1,5 @@
 LIBA_TARGET := libiot_platform.a
-HDR_REFS    += src/sdk-impl src/tls
+HDR_REFS    += src/sdk-impl src/tls src/utils
 CFLAGS      := $(filter-out -ansi,$(CFLAGS))
 
 LIB_SRCS_PATTERN    += os/$(CONFIG_VENDOR)/*.c
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "iot_import.h"
+
+#ifdef HAL_EVENT_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define HAL_EVENT_WAIT_MAX  64  /* descriptors reported per epoll_wait */
+
+/* epoll hands back the registration, which carries both the descriptor and the user */
+typedef struct _hal_event_node {
+    uintptr_t                fd;
+    void                    *user;
+    struct _hal_event_node  *next;
+} hal_event_node_t;
+
+typedef struct {
+    int                      epfd;
+    hal_event_node_t        *nodes;
+} hal_event_loop_t;
+
+static unsigned int _linux_events_to_epoll(unsigned int events)
+{
+    unsigned int epoll_events = 0;
+
+    if (events & HAL_EVENT_READ) {
+        epoll_events |= EPOLLIN;
+    }
+    if (events & HAL_EVENT_WRITE) {
+        epoll_events |= EPOLLOUT;
+    }
+
+    return epoll_events;
+}
+
+static hal_event_node_t **_linux_event_find(hal_event_loop_t *event_loop, uintptr_t fd)
+{
+    hal_event_node_t **pos = &event_loop->nodes;
+
+    while (NULL != *pos && (*pos)->fd != fd) {
+        pos = &(*pos)->next;
+    }
+
+    return pos;
+}
+
+void *HAL_EventLoop_create(void)
+{
+    hal_event_loop_t *event_loop = NULL;
+
+    event_loop = malloc(sizeof(hal_event_loop_t));
+    if (NULL == event_loop) {
+        return NULL;
+    }
+
+    event_loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (event_loop->epfd < 0) {
+        perror("epoll_create1 fail");
+        free(event_loop);
+        return NULL;
+    }
+    event_loop->nodes = NULL;
+
+    return event_loop;
+}
+
+void HAL_EventLoop_destroy(void *loop)
+{
+    hal_event_loop_t *event_loop = loop;
+    hal_event_node_t *node = NULL;
+
+    if (NULL == event_loop) {
+        return;
+    }
+
+    while (NULL != event_loop->nodes) {
+        node = event_loop->nodes;
+        event_loop->nodes = node->next;
+        free(node);
+    }
+    close(event_loop->epfd);
+    free(event_loop);
+}
+
+int HAL_EventLoop_add(void *loop, uintptr_t fd, unsigned int events, void *user)
+{
+    hal_event_loop_t   *event_loop = loop;
+    hal_event_node_t  **pos = NULL;
+    hal_event_node_t   *node = NULL;
+    struct epoll_event  event;
+    int                 op = EPOLL_CTL_MOD;
+
+    if (NULL == event_loop) {
+        return -1;
+    }
+
+    pos = _linux_event_find(event_loop, fd);
+    node = *pos;
+    if (NULL == node) {
+        node = malloc(sizeof(hal_event_node_t));
+        if (NULL == node) {
+            return -1;
+        }
+        node->fd = fd;
+        node->next = NULL;
+        op = EPOLL_CTL_ADD;
+    }
+
+    event.events = _linux_events_to_epoll(events);
+    event.data.ptr = node;
+    if (0 != epoll_ctl(event_loop->epfd, op, (int)fd, &event)) {
+        perror("epoll_ctl fail");
+        if (EPOLL_CTL_ADD == op) {
+            free(node);
+        }
+        return -1;
+    }
+
+    node->user = user;
+    if (EPOLL_CTL_ADD == op) {
+        *pos = node;
+    }
+
+    return 0;
+}
+
+int HAL_EventLoop_delete(void *loop, uintptr_t fd)
+{
+    hal_event_loop_t   *event_loop = loop;
+    hal_event_node_t  **pos = NULL;
+    hal_event_node_t   *node = NULL;
+
+    if (NULL == event_loop) {
+        return -1;
+    }
+
+    pos = _linux_event_find(event_loop, fd);
+    node = *pos;
+    if (NULL == node) {
+        return -1;
+    }
+
+    /* fails only when fd was closed already, which removed it from epoll anyway */
+    epoll_ctl(event_loop->epfd, EPOLL_CTL_DEL, (int)fd, NULL);
+    *pos = node->next;
+    free(node);
+
+    return 0;
+}
+
+int HAL_EventLoop_wait(void *loop, hal_event_t *events, int count, uint32_t timeout_ms)
+{
+    hal_event_loop_t   *event_loop = loop;
+    hal_event_node_t   *node = NULL;
+    struct epoll_event  ready[HAL_EVENT_WAIT_MAX];
+    int                 ret;
+    int                 i;
+
+    if (NULL == event_loop || NULL == events || count <= 0) {
+        return -1;
+    }
+    if (count > HAL_EVENT_WAIT_MAX) {
+        count = HAL_EVENT_WAIT_MAX;
+    }
+
+    ret = epoll_wait(event_loop->epfd, ready, count, (int)timeout_ms);
+    if (ret < 0) {
+        if (EINTR == errno) {
+            return 0;
+        }
+        perror("epoll_wait fail");
+        return -1;
+    }
+
+    for (i = 0; i < ret; i++) {
+        node = ready[i].data.ptr;
+        events[i].fd = node->fd;
+        events[i].user = node->user;
+        events[i].events = 0;
+        if (ready[i].events & EPOLLIN) {
+            events[i].events |= HAL_EVENT_READ;
+        }
+        if (ready[i].events & EPOLLOUT) {
+            events[i].events |= HAL_EVENT_WRITE;
+        }
+        if (ready[i].events & (EPOLLERR | EPOLLHUP)) {
+            events[i].events |= HAL_EVENT_ERROR;
+        }
+    }
+
+    return ret;
+}
+
+#endif  /* HAL_EVENT_ENABLED */
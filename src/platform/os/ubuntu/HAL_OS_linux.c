@@ -18,14 +18,22 @@
 
 
 
+#ifdef HAL_FIRMWARE_DIRECT_IO
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <memory.h>
+#include <ctype.h>
+#include <errno.h>
 
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include "iot_import.h"
 #ifdef MQTT_ID2_AUTH
@@ -85,6 +93,132 @@ void HAL_MutexUnlock(_IN_ void *mutex)
     }
 }
 
+typedef struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    uint32_t            count;
+} hal_linux_sem_t;
+
+int HAL_ThreadCreate(void **thread_handle,
+                     void *(*work_routine)(void *),
+                     void *arg,
+                     hal_os_thread_param_t *hal_os_thread_param,
+                     int *stack_used)
+{
+    pthread_t *thread;
+    pthread_attr_t attr;
+    int err_num;
+
+    if (NULL != stack_used) {
+        *stack_used = 0;
+    }
+    if (NULL == thread_handle || NULL == work_routine
+        || NULL == (thread = (pthread_t *)HAL_Malloc(sizeof(pthread_t)))) {
+        return -1;
+    }
+
+    pthread_attr_init(&attr);
+    if (NULL != hal_os_thread_param && hal_os_thread_param->stack_size > 0) {
+        pthread_attr_setstacksize(&attr, hal_os_thread_param->stack_size);
+    }
+    err_num = pthread_create(thread, &attr, work_routine, arg);
+    pthread_attr_destroy(&attr);
+    if (0 != err_num) {
+        perror("create thread failed");
+        HAL_Free(thread);
+        return -1;
+    }
+
+    *thread_handle = thread;
+    return 0;
+}
+
+void HAL_ThreadDetach(_IN_ void *thread_handle)
+{
+    pthread_detach(*(pthread_t *)thread_handle);
+    HAL_Free(thread_handle);
+}
+
+/* a condition variable rather than sem_t, unnamed POSIX semaphores are missing on macOS */
+void *HAL_SemaphoreCreate(void)
+{
+    hal_linux_sem_t *sem = (hal_linux_sem_t *)HAL_Malloc(sizeof(hal_linux_sem_t));
+
+    if (NULL == sem) {
+        return NULL;
+    }
+    if (0 != pthread_mutex_init(&sem->lock, NULL)) {
+        HAL_Free(sem);
+        return NULL;
+    }
+    if (0 != pthread_cond_init(&sem->cond, NULL)) {
+        pthread_mutex_destroy(&sem->lock);
+        HAL_Free(sem);
+        return NULL;
+    }
+    sem->count = 0;
+
+    return sem;
+}
+
+void HAL_SemaphoreDestroy(_IN_ void *sem)
+{
+    hal_linux_sem_t *s = (hal_linux_sem_t *)sem;
+
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    HAL_Free(s);
+}
+
+void HAL_SemaphorePost(_IN_ void *sem)
+{
+    hal_linux_sem_t *s = (hal_linux_sem_t *)sem;
+
+    pthread_mutex_lock(&s->lock);
+    s->count++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+int HAL_SemaphoreWait(_IN_ void *sem, _IN_ uint32_t timeout_ms)
+{
+    hal_linux_sem_t *s = (hal_linux_sem_t *)sem;
+    struct timeval now;
+    struct timespec abstime;
+    int ret = 0;
+
+    if (PLATFORM_WAIT_INFINITE != timeout_ms) {
+        gettimeofday(&now, NULL);
+        abstime.tv_sec = now.tv_sec + timeout_ms / 1000;
+        abstime.tv_nsec = (now.tv_usec + (long)(timeout_ms % 1000) * 1000) * 1000;
+        if (abstime.tv_nsec >= 1000000000) {
+            abstime.tv_sec++;
+            abstime.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&s->lock);
+    while (0 == s->count && 0 == ret) {
+        if (PLATFORM_WAIT_INFINITE == timeout_ms) {
+            pthread_cond_wait(&s->cond, &s->lock);
+        } else {
+            ret = pthread_cond_timedwait(&s->cond, &s->lock, &abstime);
+        }
+    }
+    if (s->count > 0) {
+        s->count--;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return (0 == ret) ? 0 : -1;
+}
+
+int HAL_AtomicAdd(_IN_ volatile int *value, _IN_ int delta)
+{
+    return __sync_add_and_fetch(value, delta);
+}
+
 void *HAL_Malloc(_IN_ uint32_t size)
 {
     return malloc(size);
@@ -107,6 +241,15 @@ uint64_t HAL_UptimeMs(void)
 
     return time_ms;
 }
+
+uint64_t HAL_UptimeUs(void)
+{
+    struct timeval tv = { 0 };
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
 #else
 uint64_t HAL_UptimeMs(void)
 {
@@ -118,6 +261,15 @@ uint64_t HAL_UptimeMs(void)
 
     return time_ms;
 }
+
+uint64_t HAL_UptimeUs(void)
+{
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * (uint64_t)1000000) + (ts.tv_nsec / 1000);
+}
 #endif
 
 void HAL_SleepMs(_IN_ uint32_t ms)
@@ -388,15 +540,135 @@ int HAL_GetFirmwareVesion(_OU_ char* version)
     return strlen(version);
 }
 
-static FILE *fp;
-
 #define otafilename "/tmp/alinkota.bin"
 
+/*
+ * The image is written by pwrite() at its offset. What HAL_Firmware_Persistence_Write() is given is gathered in a
+ * batch of HAL_FIRMWARE_BATCH_SIZE written at once. With HAL_FIRMWARE_DIRECT_IO the whole HAL_FIRMWARE_ALIGN
+ * blocks of a batch go past the page cache with O_DIRECT, the rest through it. The file is synced once, by
+ * HAL_Firmware_Persistence_Stop(); a batch not yet written when the process dies is fetched again after it.
+ */
+#ifndef HAL_FIRMWARE_ALIGN
+#define HAL_FIRMWARE_ALIGN          (4096)
+#endif
+
+/* a multiple of HAL_FIRMWARE_ALIGN, 0 to write each chunk as it comes */
+#ifndef HAL_FIRMWARE_BATCH_SIZE
+#define HAL_FIRMWARE_BATCH_SIZE     (256 * 1024)
+#endif
+
+static struct {
+    int         fd;                 /* -1 when no image is written */
+    int         fd_direct;          /* O_DIRECT, -1 without it */
+    char       *batch;
+    uint32_t    batch_offset;       /* in the image, of the first byte of the batch */
+    uint32_t    batch_len;
+    int         failed;             /* a write failed, the image is broken */
+} fw = { -1, -1, NULL, 0, 0, 0 };
+static pthread_mutex_t fw_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int _fw_pwrite(int fd, const char *buffer, uint32_t length, uint32_t offset)
+{
+    ssize_t written;
+
+    while (length > 0) {
+        written = pwrite(fd, buffer, length, offset);
+        if (written < 0 && EINTR == errno) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        buffer += written;
+        length -= written;
+        offset += written;
+    }
+
+    return 0;
+}
+
+/* writes the batch, under fw_mutex; a tail of part of a block is kept to go direct with what follows it */
+static int _fw_flush(void)
+{
+    uint32_t direct_len = 0;
+    int ret = 0;
+
+    if (0 == fw.batch_len) {
+        return fw.failed ? -1 : 0;
+    }
+
+#ifdef HAL_FIRMWARE_DIRECT_IO
+    if (fw.fd_direct >= 0 && 0 == fw.batch_offset % HAL_FIRMWARE_ALIGN) {
+        direct_len = fw.batch_len - fw.batch_len % HAL_FIRMWARE_ALIGN;
+        if (direct_len > 0 && 0 != _fw_pwrite(fw.fd_direct, fw.batch, direct_len, fw.batch_offset)) {
+            ret = -1;
+        }
+    }
+#endif
+    if (0 == ret && direct_len < fw.batch_len &&
+        0 != _fw_pwrite(fw.fd, fw.batch + direct_len, fw.batch_len - direct_len, fw.batch_offset + direct_len)) {
+        ret = -1;
+    }
+    if (0 != ret) {
+        fw.failed = 1;
+    }
+
+    if (direct_len > 0 && fw.fd_direct >= 0) {
+        memmove(fw.batch, fw.batch + direct_len, fw.batch_len - direct_len);
+        fw.batch_offset += direct_len;
+        fw.batch_len -= direct_len;
+    } else {
+        fw.batch_offset += fw.batch_len;
+        fw.batch_len = 0;
+    }
+
+    return fw.failed ? -1 : 0;
+}
+
+static void _fw_close(void)
+{
+    if (fw.fd_direct >= 0) {
+        close(fw.fd_direct);
+    }
+    if (fw.fd >= 0) {
+        close(fw.fd);
+    }
+    fw.fd = fw.fd_direct = -1;
+    fw.batch_offset = fw.batch_len = 0;
+}
+
+/* the image opened at offset, under fw_mutex */
+static int _fw_open(int flags, uint32_t offset)
+{
+    void *batch = NULL;
+
+    fw.fd = open(otafilename, O_RDWR | O_CREAT | flags, 0644);
+    if (fw.fd < 0) {
+        return -1;
+    }
+#ifdef HAL_FIRMWARE_DIRECT_IO
+    /* not all file systems take it, the batches are written through the page cache then */
+    fw.fd_direct = open(otafilename, O_WRONLY | O_DIRECT);
+#endif
+
+    if (NULL == fw.batch && HAL_FIRMWARE_BATCH_SIZE > 0 &&
+        0 == posix_memalign(&batch, HAL_FIRMWARE_ALIGN, HAL_FIRMWARE_BATCH_SIZE)) {
+        fw.batch = batch;
+    }
+    fw.batch_offset = offset;
+    fw.batch_len = 0;
+    fw.failed = 0;
+
+    return 0;
+}
+
 void HAL_Firmware_Persistence_Start(void)
 {
 #ifdef __DEMO__
-    fp = fopen(otafilename, "w");
-//    assert(fp);
+    pthread_mutex_lock(&fw_mutex);
+    _fw_close();
+    (void)_fw_open(O_TRUNC, 0);
+    pthread_mutex_unlock(&fw_mutex);
 #endif
     return;
 }
@@ -404,27 +676,387 @@ void HAL_Firmware_Persistence_Start(void)
 int HAL_Firmware_Persistence_Write(_IN_ char *buffer, _IN_ uint32_t length)
 {
 #ifdef __DEMO__
-    unsigned int written_len = 0;
-    written_len = fwrite(buffer, 1, length, fp);
+    uint32_t len;
+    int ret = 0;
+
+    pthread_mutex_lock(&fw_mutex);
+    if (fw.fd < 0) {
+        ret = -1;
+    } else if (NULL == fw.batch) {
+        ret = _fw_pwrite(fw.fd, buffer, length, fw.batch_offset);
+        fw.batch_offset += length;
+    } else {
+        while (0 == ret && length > 0) {
+            len = HAL_FIRMWARE_BATCH_SIZE - fw.batch_len;
+            len = len < length ? len : length;
+            memcpy(fw.batch + fw.batch_len, buffer, len);
+            fw.batch_len += len;
+            buffer += len;
+            length -= len;
+            if (HAL_FIRMWARE_BATCH_SIZE == fw.batch_len) {
+                ret = _fw_flush();
+            }
+        }
+    }
+    pthread_mutex_unlock(&fw_mutex);
+
+    return ret;
+#endif
+    return 0;
+}
+
+int HAL_Firmware_Persistence_WriteAt(_IN_ uint32_t offset, _IN_ char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    int fd;
+
+    /* what is batched goes first, the ranges are not batched */
+    pthread_mutex_lock(&fw_mutex);
+    fd = (fw.fd >= 0 && 0 == _fw_flush()) ? fw.fd : -1;
+    pthread_mutex_unlock(&fw_mutex);
+    if (fd < 0) {
+        return -1;
+    }
+    if (0 == length) {
+        return 0;
+    }
+
+    /* pwrite() takes no position of the file, the ranges are written from several threads */
+    return _fw_pwrite(fd, buffer, length, offset);
+#else
+    return -1;
+#endif
+}
+
+int HAL_Firmware_Persistence_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    ssize_t read_len;
+    uint32_t total = 0;
+    int fd;
+
+    pthread_mutex_lock(&fw_mutex);
+    fd = (fw.fd >= 0 && 0 == _fw_flush()) ? fw.fd : -1;
+    pthread_mutex_unlock(&fw_mutex);
+    if (fd < 0) {
+        return -1;
+    }
+
+    while (total < length) {
+        read_len = pread(fd, buffer + total, length - total, offset + total);
+        if (read_len < 0 && EINTR == errno) {
+            continue;
+        }
+        if (read_len < 0) {
+            return -1;
+        }
+        if (0 == read_len) {
+            break;
+        }
+        total += read_len;
+    }
 
-    if (written_len != length) {
+    return (int)total;
+#else
+    return -1;
+#endif
+}
+
+int HAL_Firmware_Persistence_Async(void)
+{
+    /* the file is written by the thread calling, nothing else is held up */
+    return 1;
+}
+
+int HAL_Firmware_Persistence_Resume(_IN_ uint32_t offset)
+{
+#ifdef __DEMO__
+    struct stat st;
+    int ret = 0;
+
+    pthread_mutex_lock(&fw_mutex);
+    /* an image of this process broken off is all in the file before it is measured */
+    if (fw.fd >= 0) {
+        (void)_fw_flush();
+    }
+    _fw_close();
+
+    if (0 != _fw_open(0, offset) || 0 != fstat(fw.fd, &st) || (uint32_t)st.st_size < offset ||
+        0 != ftruncate(fw.fd, offset)) {
+        _fw_close();
+        ret = -1;
+    }
+#ifdef HAL_FIRMWARE_DIRECT_IO
+    /* the head of the block it is in is batched again, for the batches to stay aligned */
+    if (0 == ret && fw.fd_direct >= 0 && fw.batch && 0 != offset % HAL_FIRMWARE_ALIGN &&
+        (ssize_t)(offset % HAL_FIRMWARE_ALIGN) == pread(fw.fd, fw.batch, offset % HAL_FIRMWARE_ALIGN,
+                offset - offset % HAL_FIRMWARE_ALIGN)) {
+        fw.batch_len = offset % HAL_FIRMWARE_ALIGN;
+        fw.batch_offset = offset - fw.batch_len;
+    }
+#endif
+    pthread_mutex_unlock(&fw_mutex);
+
+    return ret;
+#else
+    return -1;
+#endif
+}
+
+/* the image running in the demo, the one a patch is made of */
+#define otacurrentname otafilename ".current"
+
+int HAL_Firmware_Current_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    FILE *fp_current;
+    size_t read_len;
+
+    fp_current = fopen(otacurrentname, "rb");
+    if (NULL == fp_current) {
+        return -1;
+    }
+
+    if (0 != fseek(fp_current, offset, SEEK_SET)) {
+        fclose(fp_current);
         return -1;
     }
+    read_len = fread(buffer, 1, length, fp_current);
+    fclose(fp_current);
+
+    return (int)read_len;
+#else
+    return -1;
 #endif
+}
+
+/* the images a gateway keeps for its sub-devices, a file each slot */
+#define otacachename otafilename ".cache%d"
+
+int HAL_Firmware_Cache_Write(_IN_ int slot, _IN_ uint32_t offset, _IN_ const char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    char name[48];
+    FILE *fp_cache;
+    size_t written_len;
+
+    HAL_Snprintf(name, sizeof(name), otacachename, slot);
+    /* the first chunk starts the image anew */
+    fp_cache = fopen(name, 0 == offset ? "wb" : "r+b");
+    if (NULL == fp_cache) {
+        return -1;
+    }
+
+    if (0 != fseek(fp_cache, offset, SEEK_SET)) {
+        fclose(fp_cache);
+        return -1;
+    }
+    written_len = fwrite(buffer, 1, length, fp_cache);
+    if (0 != fclose(fp_cache) || written_len != length) {
+        return -1;
+    }
+
     return 0;
+#else
+    return -1;
+#endif
+}
+
+int HAL_Firmware_Cache_Read(_IN_ int slot, _IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    char name[48];
+    FILE *fp_cache;
+    size_t read_len;
+
+    HAL_Snprintf(name, sizeof(name), otacachename, slot);
+    fp_cache = fopen(name, "rb");
+    if (NULL == fp_cache) {
+        return -1;
+    }
+
+    if (0 != fseek(fp_cache, offset, SEEK_SET)) {
+        fclose(fp_cache);
+        return -1;
+    }
+    read_len = fread(buffer, 1, length, fp_cache);
+    fclose(fp_cache);
+
+    return (int)read_len;
+#else
+    return -1;
+#endif
 }
 
 int HAL_Firmware_Persistence_Stop(void)
 {
+    int ret = 0;
+
 #ifdef __DEMO__
-    if (fp != NULL) {
-        fclose(fp);
+    pthread_mutex_lock(&fw_mutex);
+    if (fw.fd < 0 || 0 != _fw_flush() || 0 != fdatasync(fw.fd)) {
+        ret = -1;
+    }
+    _fw_close();
+    if (fw.batch) {
+        free(fw.batch);
+        fw.batch = NULL;
     }
+    pthread_mutex_unlock(&fw_mutex);
 #endif
 
     /* check file md5, and burning it to flash ... finally reboot system */
 
+    return ret;
+}
+
+
+
+#define kvfiledir "/tmp/iotx_kv"
+
+static int _kv_path(const char *key, char *path, int path_len)
+{
+    const char *c;
+
+    if (NULL == key || '\0' == key[0]) {
+        return -1;
+    }
+    /* the key becomes a file name, keep it inside the directory */
+    for (c = key; *c != '\0'; c++) {
+        if (!isalnum((unsigned char)*c) && '_' != *c && '.' != *c) {
+            return -1;
+        }
+    }
+    if ('.' == key[0]) {
+        return -1;
+    }
+
+    if (snprintf(path, path_len, "%s/%s", kvfiledir, key) >= path_len) {
+        return -1;
+    }
+    return 0;
+}
+
+int HAL_Kv_Set(const char *key, const void *val, int len, int sync)
+{
+    char path[256];
+    char tmp_path[260];
+    FILE *kv_fp;
+    int ret = 0;
+
+    if (NULL == val || len < 0 || 0 != _kv_path(key, path, sizeof(path))) {
+        return -1;
+    }
+
+    mkdir(kvfiledir, 0700);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    /* write aside and rename, a power cut leaves the old value or the new one */
+    kv_fp = fopen(tmp_path, "wb");
+    if (NULL == kv_fp) {
+        perror("kv open fail");
+        return -1;
+    }
+    chmod(tmp_path, 0600);
+
+    if (fwrite(val, 1, len, kv_fp) != (size_t)len) {
+        ret = -1;
+    }
+    if (0 != fflush(kv_fp) || (sync && 0 != fsync(fileno(kv_fp)))) {
+        ret = -1;
+    }
+    fclose(kv_fp);
+
+    if (0 == ret && 0 != rename(tmp_path, path)) {
+        ret = -1;
+    }
+    if (0 != ret) {
+        perror("kv write fail");
+        remove(tmp_path);
+    }
+
+    return ret;
+}
+
+int HAL_Kv_Get(const char *key, void *val, int *buffer_len)
+{
+    char path[256];
+    FILE *kv_fp;
+    long size;
+    int ret = -1;
+
+    if (NULL == val || NULL == buffer_len || 0 != _kv_path(key, path, sizeof(path))) {
+        return -1;
+    }
+
+    kv_fp = fopen(path, "rb");
+    if (NULL == kv_fp) {
+        return -1;
+    }
+
+    if (0 == fseek(kv_fp, 0, SEEK_END) && (size = ftell(kv_fp)) >= 0 && size <= *buffer_len) {
+        rewind(kv_fp);
+        if (fread(val, 1, size, kv_fp) == (size_t)size) {
+            *buffer_len = (int)size;
+            ret = 0;
+        }
+    }
+    fclose(kv_fp);
+
+    return ret;
+}
+
+int HAL_Kv_Del(const char *key)
+{
+    char path[256];
+
+    if (0 != _kv_path(key, path, sizeof(path))) {
+        return -1;
+    }
+
+    if (0 != remove(path) && ENOENT != errno) {
+        return -1;
+    }
     return 0;
 }
 
+#ifdef HAL_CRYPTO_ENABLED
+/* no crypto engine here, every hook declines and the software implementations are used */
+int HAL_Crypto_Md5Process(uint32_t state[4], const unsigned char block[64])
+{
+    return -1;
+}
+
+int HAL_Crypto_Sha1Process(uint32_t state[5], const unsigned char block[64])
+{
+    return -1;
+}
+
+int HAL_Crypto_Sha256Process(uint32_t state[8], const unsigned char block[64])
+{
+    return -1;
+}
 
+int HAL_Crypto_Hmac(hal_digest_type_t type,
+                    const unsigned char *key, uint32_t key_len,
+                    const unsigned char *msg, uint32_t msg_len,
+                    unsigned char *digest)
+{
+    return -1;
+}
+
+#ifdef HAL_CRYPTO_AES_ENABLED
+/* AES has no software fallback, a port enabling HAL_CRYPTO_AES_ENABLED must implement these */
+int HAL_Crypto_AesEncrypt(const unsigned char *key, uint32_t keybits,
+                          const unsigned char input[16], unsigned char output[16])
+{
+    return -1;
+}
+
+int HAL_Crypto_AesDecrypt(const unsigned char *key, uint32_t keybits,
+                          const unsigned char input[16], unsigned char output[16])
+{
+    return -1;
+}
+#endif  /* HAL_CRYPTO_AES_ENABLED */
+#endif  /* HAL_CRYPTO_ENABLED */
@@ -21,9 +21,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <netinet/tcp.h>
@@ -63,61 +66,363 @@ static uint64_t _linux_time_left(uint64_t t_end, uint64_t t_now)
     return t_left;
 }
 
-uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
+#define HAL_TCP_CONNECT_TIMEOUT_MS  (10 * 1000)
+#define HAL_TCP_ATTEMPT_DELAY_MS    (250)   /* RFC 8305 connection attempt delay */
+#define HAL_TCP_ADDR_MAX            (4)     /* addresses tried per connect */
+#define HAL_DNS_CACHE_TTL_MS        (60 * 1000)
+#define HAL_DNS_CACHE_SIZE          (4)
+#define HAL_DNS_HOST_MAXLEN         (128)
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t               addrlen;
+} _linux_addr_t;
+
+typedef struct {
+    char            host[HAL_DNS_HOST_MAXLEN + 1];  /* empty, entry not used */
+    uint16_t        port;
+    uint64_t        expire_ms;
+    int             addr_num;
+    _linux_addr_t   addr[HAL_TCP_ADDR_MAX];
+} _linux_dns_entry_t;
+
+#ifdef HAL_NET_STATS_ENABLED
+/* by descriptor, the ones past it are not counted */
+#define HAL_TCP_STATS_FD_MAX        (64)
+
+static hal_net_stats_t g_tcp_stats[HAL_TCP_STATS_FD_MAX];
+
+#define TCP_STATS_ADD(fd, field, n) \
+    do { \
+        if ((uintptr_t)(fd) < HAL_TCP_STATS_FD_MAX) { \
+            g_tcp_stats[(uintptr_t)(fd)].field += (n); \
+        } \
+    } while (0)
+/* the wait started when t_left was taken */
+#define TCP_STATS_WAIT(fd, t_end, t_left) \
+    do { \
+        TCP_STATS_ADD(fd, syscalls, 1); \
+        TCP_STATS_ADD(fd, blocked_ms, (uint32_t)(_linux_get_time_ms() - ((t_end) - (t_left)))); \
+    } while (0)
+#define TCP_STATS_IO(fd, dir, ret) \
+    do { \
+        TCP_STATS_ADD(fd, syscalls, 1); \
+        if ((ret) > 0) { \
+            TCP_STATS_ADD(fd, packets_##dir, 1); \
+            TCP_STATS_ADD(fd, bytes_##dir, (ret)); \
+        } \
+    } while (0)
+
+int HAL_TCP_GetStats(uintptr_t fd, hal_net_stats_t *stats)
+{
+    if (fd >= HAL_TCP_STATS_FD_MAX || NULL == stats) {
+        return -1;
+    }
+
+    memcpy(stats, &g_tcp_stats[fd], sizeof(hal_net_stats_t));
+    return 0;
+}
+#else
+#define TCP_STATS_ADD(fd, field, n)
+#define TCP_STATS_WAIT(fd, t_end, t_left)
+#define TCP_STATS_IO(fd, dir, ret)
+#endif  /* HAL_NET_STATS_ENABLED */
+
+static pthread_mutex_t g_dns_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _linux_dns_entry_t g_dns_cache[HAL_DNS_CACHE_SIZE];
+static uint32_t g_dns_ttl_ms = HAL_DNS_CACHE_TTL_MS;
+static uint32_t g_connect_timeout_ms = HAL_TCP_CONNECT_TIMEOUT_MS;
+
+void HAL_TCP_SetConnectTimeout(uint32_t timeout_ms)
+{
+    g_connect_timeout_ms = (0 == timeout_ms) ? HAL_TCP_CONNECT_TIMEOUT_MS : timeout_ms;
+}
+
+void HAL_TCP_SetDnsCacheTTL(uint32_t ttl_ms)
+{
+    pthread_mutex_lock(&g_dns_mutex);
+    g_dns_ttl_ms = ttl_ms;
+    pthread_mutex_unlock(&g_dns_mutex);
+}
+
+void HAL_TCP_FlushDnsCache(void)
+{
+    pthread_mutex_lock(&g_dns_mutex);
+    memset(g_dns_cache, 0, sizeof(g_dns_cache));
+    pthread_mutex_unlock(&g_dns_mutex);
+}
+
+/* entry of host:port, or the one to replace when find_free, caller holds g_dns_mutex */
+static _linux_dns_entry_t *_linux_dns_entry(const char *host, uint16_t port, int find_free)
+{
+    int i;
+    _linux_dns_entry_t *victim = &g_dns_cache[0];
+
+    for (i = 0; i < HAL_DNS_CACHE_SIZE; i++) {
+        if (port == g_dns_cache[i].port && 0 == strcmp(g_dns_cache[i].host, host)) {
+            return &g_dns_cache[i];
+        }
+        if (g_dns_cache[i].expire_ms < victim->expire_ms) {
+            victim = &g_dns_cache[i];
+        }
+    }
+
+    return find_free ? victim : NULL;
+}
+
+static void _linux_dns_invalidate(const char *host, uint16_t port)
+{
+    _linux_dns_entry_t *entry;
+
+    pthread_mutex_lock(&g_dns_mutex);
+    entry = _linux_dns_entry(host, port, 0);
+    if (NULL != entry) {
+        memset(entry, 0, sizeof(*entry));
+    }
+    pthread_mutex_unlock(&g_dns_mutex);
+}
+
+/* copy cached addresses, expired ones only when allow_stale. 0 when none. */
+static int _linux_dns_lookup(const char *host, uint16_t port, _linux_addr_t *addr, int allow_stale)
+{
+    int num = 0;
+    _linux_dns_entry_t *entry;
+
+    pthread_mutex_lock(&g_dns_mutex);
+    entry = _linux_dns_entry(host, port, 0);
+    if (NULL != entry && (allow_stale || (0 != g_dns_ttl_ms && _linux_get_time_ms() < entry->expire_ms))) {
+        num = entry->addr_num;
+        memcpy(addr, entry->addr, num * sizeof(_linux_addr_t));
+    }
+    pthread_mutex_unlock(&g_dns_mutex);
+
+    return num;
+}
+
+static void _linux_dns_store(const char *host, uint16_t port, const _linux_addr_t *addr, int num)
+{
+    _linux_dns_entry_t *entry;
+
+    if (strlen(host) > HAL_DNS_HOST_MAXLEN) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_dns_mutex);
+    if (0 != g_dns_ttl_ms) {
+        entry = _linux_dns_entry(host, port, 1);
+        strcpy(entry->host, host);
+        entry->port = port;
+        entry->expire_ms = _linux_get_time_ms() + g_dns_ttl_ms;
+        entry->addr_num = num;
+        memcpy(entry->addr, addr, num * sizeof(_linux_addr_t));
+    }
+    pthread_mutex_unlock(&g_dns_mutex);
+}
+
+/*
+ * Resolve host into at most HAL_TCP_ADDR_MAX addresses, families interleaved starting with
+ * the first one returned (RFC 8305 section 4). getaddrinfo() runs without the cache lock held.
+ */
+static int _linux_dns_resolve(const char *host, uint16_t port, _linux_addr_t *addr, int *from_cache)
 {
     struct addrinfo hints;
     struct addrinfo *addrInfoList = NULL;
     struct addrinfo *cur = NULL;
-    int fd = 0;
-    int rc = 0;
+    struct addrinfo *family[2][HAL_TCP_ADDR_MAX];
+    int family_num[2] = {0, 0};
+    int first_family = AF_UNSPEC;
+    int num, i, k;
     char service[6];
 
-    memset(&hints, 0, sizeof(hints));
-
-    PLATFORM_LINUXSOCK_LOG("establish tcp connection with server(host=%s port=%u)", host, port);
+    num = _linux_dns_lookup(host, port, addr, 0);
+    if (num > 0) {
+        *from_cache = 1;
+        return num;
+    }
+    *from_cache = 0;
 
-    hints.ai_family = AF_INET; /* only IPv4 */
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_ADDRCONFIG;
     sprintf(service, "%u", port);
 
-    if ((rc = getaddrinfo(host, service, &hints, &addrInfoList)) != 0) {
+    if (getaddrinfo(host, service, &hints, &addrInfoList) != 0) {
         perror("getaddrinfo error");
-        return 0;
+        num = _linux_dns_lookup(host, port, addr, 1);
+        if (num > 0) {
+            PLATFORM_LINUXSOCK_LOG("use expired addresses of %s", host);
+            *from_cache = 1;
+        }
+        return num;
     }
 
     for (cur = addrInfoList; cur != NULL; cur = cur->ai_next) {
-        if (cur->ai_family != AF_INET) {
-            perror("socket type error");
-            rc = 0;
+        if ((cur->ai_family != AF_INET && cur->ai_family != AF_INET6) || cur->ai_addrlen > sizeof(struct sockaddr_storage)) {
             continue;
         }
+        if (AF_UNSPEC == first_family) {
+            first_family = cur->ai_family;
+        }
+        k = (cur->ai_family == first_family) ? 0 : 1;
+        if (family_num[k] < HAL_TCP_ADDR_MAX) {
+            family[k][family_num[k]++] = cur;
+        }
+    }
+
+    num = 0;
+    for (i = 0; i < HAL_TCP_ADDR_MAX && num < HAL_TCP_ADDR_MAX; i++) {
+        for (k = 0; k < 2 && num < HAL_TCP_ADDR_MAX; k++) {
+            if (i < family_num[k]) {
+                memcpy(&addr[num].addr, family[k][i]->ai_addr, family[k][i]->ai_addrlen);
+                addr[num].addrlen = family[k][i]->ai_addrlen;
+                num++;
+            }
+        }
+    }
+    freeaddrinfo(addrInfoList);
+
+    if (num > 0) {
+        _linux_dns_store(host, port, addr, num);
+    }
+
+    return num;
+}
+
+/* start a non-blocking connect, -1 when it failed already */
+static int _linux_connect_start(const _linux_addr_t *addr, int *connected)
+{
+    int fd;
+
+    fd = socket(addr->addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        perror("create socket error");
+        return -1;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 
-        fd = socket(cur->ai_family, cur->ai_socktype, cur->ai_protocol);
-        if (fd < 0) {
-            perror("create socket error");
-            rc = 0;
+    *connected = 0;
+    if (0 == connect(fd, (const struct sockaddr *)&addr->addr, addr->addrlen)) {
+        *connected = 1;
+    } else if (EINPROGRESS != errno) {
+        perror("connect error");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Happy eyeballs: start the next address every HAL_TCP_ATTEMPT_DELAY_MS, or right away when
+ * every attempt so far failed, keep all of them running and take the first connected.
+ */
+static int _linux_connect_race(const _linux_addr_t *addr, int addr_num, uint32_t timeout_ms)
+{
+    struct pollfd pfd[HAL_TCP_ADDR_MAX];
+    int pending = 0, started = 0, fd = -1;
+    int i, ret, err, connected;
+    socklen_t len;
+    uint64_t t_now, t_end, t_next, t_wait;
+
+    t_now = _linux_get_time_ms();
+    t_end = t_now + timeout_ms;
+    t_next = t_now;
+
+    while (fd < 0 && t_now < t_end) {
+        if (started < addr_num && (t_now >= t_next || 0 == pending)) {
+            ret = _linux_connect_start(&addr[started++], &connected);
+            t_next = t_now + HAL_TCP_ATTEMPT_DELAY_MS;
+            if (ret >= 0 && connected) {
+                fd = ret;
+            } else if (ret >= 0) {
+                pfd[pending].fd = ret;
+                pfd[pending].events = POLLOUT;
+                pending++;
+            }
             continue;
         }
+        if (0 == pending) {
+            break;
+        }
 
-        if (connect(fd, cur->ai_addr, cur->ai_addrlen) == 0) {
-            rc = fd;
+        t_wait = (started < addr_num && t_next < t_end) ? t_next : t_end;
+        ret = poll(pfd, pending, (int)_linux_time_left(t_wait, t_now));
+        if (ret < 0 && EINTR != errno) {
+            perror("poll error");
             break;
         }
 
-        close(fd);
-        perror("connect error");
-        rc = 0;
+        for (i = 0; ret > 0 && i < pending; i++) {
+            if (0 == pfd[i].revents) {
+                continue;
+            }
+
+            err = 0;
+            len = sizeof(err);
+            if (fd < 0 && 0 == getsockopt(pfd[i].fd, SOL_SOCKET, SO_ERROR, &err, &len) && 0 == err) {
+                fd = pfd[i].fd;
+            } else {
+                PLATFORM_LINUXSOCK_LOG("connect error, %s", strerror(err));
+                close(pfd[i].fd);
+            }
+            pfd[i--] = pfd[--pending];
+        }
+        t_now = _linux_get_time_ms();
+    }
+
+    for (i = 0; i < pending; i++) {
+        close(pfd[i].fd);
+    }
+
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    } else if (t_now >= t_end) {
+        PLATFORM_LINUXSOCK_LOG("connect timeout in %u ms", timeout_ms);
+    }
+
+    return fd;
+}
+
+uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
+{
+    _linux_addr_t addr[HAL_TCP_ADDR_MAX];
+    int addr_num, from_cache;
+    int fd;
+
+    PLATFORM_LINUXSOCK_LOG("establish tcp connection with server(host=%s port=%u)", host, port);
+
+    addr_num = _linux_dns_resolve(host, port, addr, &from_cache);
+    fd = _linux_connect_race(addr, addr_num, g_connect_timeout_ms);
+
+    if (fd < 0 && from_cache) {
+        /* the host may have moved, resolve it again */
+        _linux_dns_invalidate(host, port);
+        addr_num = _linux_dns_resolve(host, port, addr, &from_cache);
+        if (0 == from_cache) {
+            fd = _linux_connect_race(addr, addr_num, g_connect_timeout_ms);
+        }
     }
 
-    if (0 == rc) {
+    /* fd 0 is the failure value of this API */
+    if (fd <= 0) {
+        if (0 == fd) {
+            close(fd);
+        }
         PLATFORM_LINUXSOCK_LOG("fail to establish tcp");
-    } else {
-        PLATFORM_LINUXSOCK_LOG("success to establish tcp, fd=%d", rc);
+        return 0;
     }
-    freeaddrinfo(addrInfoList);
 
-    return (uintptr_t)rc;
+#ifdef HAL_NET_STATS_ENABLED
+    if (fd < HAL_TCP_STATS_FD_MAX) {
+        memset(&g_tcp_stats[fd], 0, sizeof(hal_net_stats_t));
+    }
+#endif
+
+    PLATFORM_LINUXSOCK_LOG("success to establish tcp, fd=%d", fd);
+    return (uintptr_t)fd;
 }
 
 
@@ -166,6 +471,7 @@ int32_t HAL_TCP_Write(uintptr_t fd, const char *buf, uint32_t len, uint32_t time
             timeout.tv_usec = (t_left % 1000) * 1000;
 
             ret = select(fd + 1, NULL, &sets, NULL, &timeout);
+            TCP_STATS_WAIT(fd, t_end, t_left);
             if (ret > 0) {
                 if (0 == FD_ISSET(fd, &sets)) {
                     PLATFORM_LINUXSOCK_LOG("Should NOT arrive");
@@ -183,12 +489,14 @@ int32_t HAL_TCP_Write(uintptr_t fd, const char *buf, uint32_t len, uint32_t time
                 }
 
                 perror("select-write fail");
+                TCP_STATS_ADD(fd, errors, 1);
                 break;
             }
         }
 
         if (ret > 0) {
             ret = send(fd, buf + len_sent, len - len_sent, 0);
+            TCP_STATS_IO(fd, sent, ret);
             if (ret > 0) {
                 len_sent += ret;
             } else if (0 == ret) {
@@ -200,6 +508,105 @@ int32_t HAL_TCP_Write(uintptr_t fd, const char *buf, uint32_t len, uint32_t time
                 }
 
                 perror("send fail");
+                TCP_STATS_ADD(fd, errors, 1);
+                break;
+            }
+        }
+    } while ((len_sent < len) && (_linux_time_left(t_end, _linux_get_time_ms()) > 0));
+
+    return len_sent;
+}
+
+
+#define HAL_TCP_WRITEV_MAX_IOV  (16)
+
+int32_t HAL_TCP_Writev(uintptr_t fd, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    int ret;
+    uint32_t len, len_sent, idx, off, cnt;
+    uint64_t t_end, t_left;
+    fd_set sets;
+    struct iovec vec[HAL_TCP_WRITEV_MAX_IOV];
+    struct msghdr msg;
+
+    for (len = 0, idx = 0; idx < iovcnt; idx++) {
+        len += iov[idx].len;
+    }
+    if (0 == len) {
+        return 0;
+    }
+
+    t_end = _linux_get_time_ms() + timeout_ms;
+    len_sent = 0;
+    idx = 0;    /* first piece not sent completely */
+    off = 0;    /* bytes of that piece already sent */
+    ret = 1; /* send one time if timeout_ms is value 0 */
+
+    do {
+        t_left = _linux_time_left(t_end, _linux_get_time_ms());
+
+        if (0 != t_left) {
+            struct timeval timeout;
+
+            FD_ZERO(&sets);
+            FD_SET(fd, &sets);
+
+            timeout.tv_sec = t_left / 1000;
+            timeout.tv_usec = (t_left % 1000) * 1000;
+
+            ret = select(fd + 1, NULL, &sets, NULL, &timeout);
+            TCP_STATS_WAIT(fd, t_end, t_left);
+            if (ret > 0) {
+                if (0 == FD_ISSET(fd, &sets)) {
+                    PLATFORM_LINUXSOCK_LOG("Should NOT arrive");
+                    /* If timeout in next loop, it will not sent any data */
+                    ret = 0;
+                    continue;
+                }
+            } else if (0 == ret) {
+                PLATFORM_LINUXSOCK_LOG("select-write timeout %d", (int)fd);
+                break;
+            } else {
+                if (EINTR == errno) {
+                    PLATFORM_LINUXSOCK_LOG("EINTR be caught");
+                    continue;
+                }
+
+                perror("select-write fail");
+                TCP_STATS_ADD(fd, errors, 1);
+                break;
+            }
+        }
+
+        if (ret > 0) {
+            for (cnt = 0; cnt < HAL_TCP_WRITEV_MAX_IOV && idx + cnt < iovcnt; cnt++) {
+                vec[cnt].iov_base = (void *)(iov[idx + cnt].buf + (0 == cnt ? off : 0));
+                vec[cnt].iov_len = iov[idx + cnt].len - (0 == cnt ? off : 0);
+            }
+
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = vec;
+            msg.msg_iovlen = cnt;
+
+            ret = sendmsg(fd, &msg, 0);
+            TCP_STATS_IO(fd, sent, ret);
+            if (ret > 0) {
+                len_sent += ret;
+                off += ret;
+                while (idx < iovcnt && off >= iov[idx].len) {
+                    off -= iov[idx].len;
+                    idx++;
+                }
+            } else if (0 == ret) {
+                PLATFORM_LINUXSOCK_LOG("No data be sent");
+            } else {
+                if (EINTR == errno) {
+                    PLATFORM_LINUXSOCK_LOG("EINTR be caught");
+                    continue;
+                }
+
+                perror("sendmsg fail");
+                TCP_STATS_ADD(fd, errors, 1);
                 break;
             }
         }
@@ -233,8 +640,10 @@ int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
         timeout.tv_usec = (t_left % 1000) * 1000;
 
         ret = select(fd + 1, &sets, NULL, NULL, &timeout);
+        TCP_STATS_WAIT(fd, t_end, t_left);
         if (ret > 0) {
             ret = recv(fd, buf + len_recv, len - len_recv, 0);
+            TCP_STATS_IO(fd, recv, ret);
             if (ret > 0) {
                 len_recv += ret;
             } else if (0 == ret) {
@@ -247,6 +656,7 @@ int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
                     continue;
                 }
                 perror("recv fail");
+                TCP_STATS_ADD(fd, errors, 1);
                 err_code = -2;
                 break;
             }
@@ -254,6 +664,7 @@ int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
             break;
         } else {
             perror("select-recv fail");
+            TCP_STATS_ADD(fd, errors, 1);
             err_code = -2;
             break;
         }
@@ -263,3 +674,48 @@ int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
     /* It will get error code on next calling */
     return (0 != len_recv) ? len_recv : err_code;
 }
+
+#ifdef HAL_EVENT_ENABLED
+int32_t HAL_TCP_ReadNonblock(uintptr_t fd, char *buf, uint32_t len)
+{
+    int ret;
+
+    do {
+        ret = recv(fd, buf, len, MSG_DONTWAIT);
+        TCP_STATS_IO(fd, recv, ret);
+    } while (ret < 0 && EINTR == errno);
+
+    if (ret > 0) {
+        return ret;
+    } else if (0 == ret) {
+        perror("connection is closed");
+        return -1;
+    } else if (EAGAIN == errno || EWOULDBLOCK == errno) {
+        return 0;
+    }
+
+    perror("recv fail");
+    TCP_STATS_ADD(fd, errors, 1);
+    return -2;
+}
+
+int32_t HAL_TCP_WriteNonblock(uintptr_t fd, const char *buf, uint32_t len)
+{
+    int ret;
+
+    do {
+        ret = send(fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        TCP_STATS_IO(fd, sent, ret);
+    } while (ret < 0 && EINTR == errno);
+
+    if (ret >= 0) {
+        return ret;
+    } else if (EAGAIN == errno || EWOULDBLOCK == errno) {
+        return 0;
+    }
+
+    perror("send fail");
+    TCP_STATS_ADD(fd, errors, 1);
+    return -1;
+}
+#endif  /* HAL_EVENT_ENABLED */
@@ -16,6 +16,9 @@
  *
  */
 
+#if defined(COAP_BATCH_RECV_ENABLED) || defined(COAP_BATCH_SEND_ENABLED)
+#define _GNU_SOURCE /* recvmmsg, sendmmsg */
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +34,73 @@
 
 #include "iot_import.h"
 
+#ifdef HAL_NET_STATS_ENABLED
+/* by descriptor, the ones past it are not counted */
+#define HAL_UDP_STATS_FD_MAX        (64)
+
+static hal_net_stats_t g_udp_stats[HAL_UDP_STATS_FD_MAX];
+
+#define UDP_STATS_ADD(fd, field, n) \
+    do { \
+        if ((unsigned long)(fd) < HAL_UDP_STATS_FD_MAX) { \
+            g_udp_stats[(unsigned long)(fd)].field += (n); \
+        } \
+    } while (0)
+#define UDP_STATS_IO(fd, dir, ret) \
+    do { \
+        UDP_STATS_ADD(fd, syscalls, 1); \
+        if ((ret) > 0) { \
+            UDP_STATS_ADD(fd, packets_##dir, 1); \
+            UDP_STATS_ADD(fd, bytes_##dir, (ret)); \
+        } else if ((ret) < 0 && EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno) { \
+            UDP_STATS_ADD(fd, errors, 1); \
+        } \
+    } while (0)
+
+int HAL_UDP_GetStats(void *p_socket, hal_net_stats_t *stats)
+{
+    unsigned long socket_id = (unsigned long)p_socket;
+
+    if (socket_id >= HAL_UDP_STATS_FD_MAX || NULL == stats) {
+        return -1;
+    }
+
+    memcpy(stats, &g_udp_stats[socket_id], sizeof(hal_net_stats_t));
+    return 0;
+}
+#else
+#define UDP_STATS_ADD(fd, field, n)
+#define UDP_STATS_IO(fd, dir, ret)
+#endif  /* HAL_NET_STATS_ENABLED */
+
+static unsigned int g_udp_sndbuf = 0;
+static unsigned int g_udp_rcvbuf = 0;
+
+void HAL_UDP_SetBufferSize(unsigned int sndbuf, unsigned int rcvbuf)
+{
+    g_udp_sndbuf = sndbuf;
+    g_udp_rcvbuf = rcvbuf;
+}
+
+/* failing to resize keeps the default size, the connection works all the same */
+static void _udp_set_buffer_size(int socket_id)
+{
+    int size;
+
+    if (0 != g_udp_sndbuf) {
+        size = (int)g_udp_sndbuf;
+        if (0 != setsockopt(socket_id, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size))) {
+            perror("setsockopt SO_SNDBUF fail");
+        }
+    }
+    if (0 != g_udp_rcvbuf) {
+        size = (int)g_udp_rcvbuf;
+        if (0 != setsockopt(socket_id, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size))) {
+            perror("setsockopt SO_RCVBUF fail");
+        }
+    }
+}
+
 void *HAL_UDP_create(char *host, unsigned short port)
 {
 #define NETWORK_ADDR_LEN    (16)
@@ -70,7 +140,14 @@ void *HAL_UDP_create(char *host, unsigned short port)
                 perror("create socket error");
                 continue;
             }
+            _udp_set_buffer_size(socket_id);
+            /* connected, so each send reuses the route looked up here */
             if (0 == connect(socket_id, ainfo->ai_addr, ainfo->ai_addrlen)) {
+#ifdef HAL_NET_STATS_ENABLED
+                if (socket_id < HAL_UDP_STATS_FD_MAX) {
+                    memset(&g_udp_stats[socket_id], 0, sizeof(hal_net_stats_t));
+                }
+#endif
                 break;
             }
 
@@ -101,6 +178,7 @@ int HAL_UDP_write(void *p_socket,
 
     socket_id = (long)p_socket;
     rc = send(socket_id, (char *)p_data, (int)datalen, 0);
+    UDP_STATS_IO(socket_id, sent, rc);
     if (-1 == rc) {
         return -1;
     }
@@ -121,6 +199,7 @@ int HAL_UDP_read(void *p_socket,
 
     socket_id = (long)p_socket;
     count = (int)read(socket_id, p_data, datalen);
+    UDP_STATS_IO(socket_id, recv, count);
 
     return count;
 }
@@ -134,6 +213,9 @@ int HAL_UDP_readTimeout(void *p_socket,
     struct timeval      tv;
     fd_set              read_fds;
     long                socket_id = -1;
+#ifdef HAL_NET_STATS_ENABLED
+    uint64_t            t_start;
+#endif
 
     if (NULL == p_socket || NULL == p_data) {
         return -1;
@@ -150,7 +232,12 @@ int HAL_UDP_readTimeout(void *p_socket,
     tv.tv_sec  = timeout / 1000;
     tv.tv_usec = (timeout % 1000) * 1000;
 
+#ifdef HAL_NET_STATS_ENABLED
+    t_start = HAL_UptimeMs();
+#endif
     ret = select(socket_id + 1, &read_fds, NULL, NULL, timeout == 0 ? NULL : &tv);
+    UDP_STATS_ADD(socket_id, syscalls, 1);
+    UDP_STATS_ADD(socket_id, blocked_ms, (uint32_t)(HAL_UptimeMs() - t_start));
 
     /* Zero fds ready means we timed out */
     if (ret == 0) {
@@ -162,6 +249,7 @@ int HAL_UDP_readTimeout(void *p_socket,
             return -3;    /* want read */
         }
 
+        UDP_STATS_ADD(socket_id, errors, 1);
         return -4; /* receive failed */
     }
 
@@ -169,3 +257,301 @@ int HAL_UDP_readTimeout(void *p_socket,
     return HAL_UDP_read(p_socket, p_data, datalen);
 }
 
+#ifdef LOCAL_CONTROL_ENABLED
+void *HAL_UDP_bind(unsigned short port)
+{
+    long                    socket_id = -1;
+    int                     opt_val = 1;
+    struct sockaddr_in      sa;
+
+    socket_id = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket_id < 0) {
+        perror("create socket error");
+        return (void *)(-1);
+    }
+    _udp_set_buffer_size(socket_id);
+    /* bound again at once after a restart */
+    setsockopt(socket_id, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+
+    memset(&sa, 0x00, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    sa.sin_port = htons(port);
+    if (0 != bind(socket_id, (struct sockaddr *)&sa, sizeof(sa))) {
+        perror("bind socket error");
+        close(socket_id);
+        return (void *)(-1);
+    }
+#ifdef HAL_NET_STATS_ENABLED
+    if (socket_id < HAL_UDP_STATS_FD_MAX) {
+        memset(&g_udp_stats[socket_id], 0, sizeof(hal_net_stats_t));
+    }
+#endif
+
+    return (void *)socket_id;
+}
+
+int HAL_UDP_recvfrom(void *p_socket,
+                     hal_udp_peer_t *peer,
+                     unsigned char *p_data,
+                     unsigned int datalen,
+                     unsigned int timeout_ms)
+{
+    int                 ret;
+    struct timeval      tv;
+    fd_set              read_fds;
+    long                socket_id = -1;
+    struct sockaddr_in  sa;
+    socklen_t           sa_len = sizeof(sa);
+
+    if (NULL == p_socket || NULL == peer || NULL == p_data) {
+        return -1;
+    }
+    socket_id = (long)p_socket;
+    if (socket_id < 0) {
+        return -1;
+    }
+
+    FD_ZERO(&read_fds);
+    FD_SET(socket_id, &read_fds);
+    tv.tv_sec  = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    ret = select(socket_id + 1, &read_fds, NULL, NULL, &tv);
+    UDP_STATS_ADD(socket_id, syscalls, 1);
+    if (0 == ret) {
+        return -2;
+    }
+    if (ret < 0) {
+        if (EINTR == errno) {
+            return -2;
+        }
+        UDP_STATS_ADD(socket_id, errors, 1);
+        return -4;
+    }
+
+    ret = (int)recvfrom(socket_id, p_data, datalen, 0, (struct sockaddr *)&sa, &sa_len);
+    UDP_STATS_IO(socket_id, recv, ret);
+    if (ret < 0) {
+        return (EAGAIN == errno || EINTR == errno) ? -2 : -4;
+    }
+
+    inet_ntop(AF_INET, &sa.sin_addr, peer->addr, sizeof(peer->addr));
+    peer->port = ntohs(sa.sin_port);
+
+    return ret;
+}
+
+int HAL_UDP_sendto(void *p_socket,
+                   const hal_udp_peer_t *peer,
+                   const unsigned char *p_data,
+                   unsigned int datalen)
+{
+    int                 rc = -1;
+    long                socket_id = -1;
+    struct sockaddr_in  sa;
+
+    if (NULL == p_socket || NULL == peer || NULL == p_data) {
+        return -1;
+    }
+    socket_id = (long)p_socket;
+
+    memset(&sa, 0x00, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(peer->port);
+    if (1 != inet_pton(AF_INET, peer->addr, &sa.sin_addr)) {
+        return -1;
+    }
+
+    rc = (int)sendto(socket_id, (const char *)p_data, datalen, 0, (struct sockaddr *)&sa, sizeof(sa));
+    UDP_STATS_IO(socket_id, sent, rc);
+    if (-1 == rc) {
+        return -1;
+    }
+
+    return rc;
+}
+#endif  /* LOCAL_CONTROL_ENABLED */
+
+#ifdef COAP_BATCH_SEND_ENABLED
+#define HAL_UDP_WRITE_BATCH_MAX (16)
+
+int HAL_UDP_writeBatch(void *p_socket,
+                       const unsigned char **p_data,
+                       const unsigned int *p_len,
+                       unsigned int count)
+{
+    int                 ret;
+    int                 i;
+    long                socket_id = -1;
+    struct mmsghdr      msgs[HAL_UDP_WRITE_BATCH_MAX];
+    struct iovec        iovecs[HAL_UDP_WRITE_BATCH_MAX];
+
+    if (NULL == p_socket || NULL == p_data || NULL == p_len) {
+        return -1;
+    }
+    socket_id = (long)p_socket;
+
+    if (count > HAL_UDP_WRITE_BATCH_MAX) {
+        count = HAL_UDP_WRITE_BATCH_MAX;
+    }
+
+    memset(msgs, 0x00, sizeof(msgs));
+    for (i = 0; i < (int)count; i++) {
+        iovecs[i].iov_base         = (void *)p_data[i];
+        iovecs[i].iov_len          = p_len[i];
+        msgs[i].msg_hdr.msg_iov    = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    do {
+        ret = sendmmsg(socket_id, msgs, count, 0);
+        UDP_STATS_ADD(socket_id, syscalls, 1);
+    } while (ret < 0 && EINTR == errno);
+
+#ifdef HAL_NET_STATS_ENABLED
+    for (i = 0; i < ret; i++) {
+        UDP_STATS_ADD(socket_id, packets_sent, 1);
+        UDP_STATS_ADD(socket_id, bytes_sent, msgs[i].msg_len);
+    }
+    if (ret < 0 && ENOSYS != errno) {
+        UDP_STATS_ADD(socket_id, errors, 1);
+    }
+#endif
+
+    /* a kernel without sendmmsg sends them one by one */
+    if (ret < 0 && ENOSYS == errno) {
+        for (ret = 0; ret < (int)count; ret++) {
+            if (HAL_UDP_write(p_socket, p_data[ret], p_len[ret]) < 0) {
+                return (0 == ret) ? -1 : ret;
+            }
+        }
+    }
+
+    return (ret < 0) ? -1 : ret;
+}
+#endif
+
+#ifdef COAP_BATCH_RECV_ENABLED
+#define HAL_UDP_READ_BATCH_MAX  (16)
+
+int HAL_UDP_readBatch(void *p_socket,
+                      unsigned char **p_data,
+                      unsigned int datalen,
+                      unsigned int *p_len,
+                      unsigned int count,
+                      unsigned int timeout)
+{
+    int                 ret;
+    int                 i;
+    struct timeval      tv;
+    fd_set              read_fds;
+    long                socket_id = -1;
+#ifdef HAL_NET_STATS_ENABLED
+    uint64_t            t_start;
+#endif
+    struct mmsghdr      msgs[HAL_UDP_READ_BATCH_MAX];
+    struct iovec        iovecs[HAL_UDP_READ_BATCH_MAX];
+
+    if (NULL == p_socket || NULL == p_data || NULL == p_len || 0 == count) {
+        return -1;
+    }
+    socket_id = (long)p_socket;
+
+    if (socket_id < 0) {
+        return -1;
+    }
+
+    if (count > HAL_UDP_READ_BATCH_MAX) {
+        count = HAL_UDP_READ_BATCH_MAX;
+    }
+
+    FD_ZERO(&read_fds);
+    FD_SET(socket_id, &read_fds);
+
+    tv.tv_sec  = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+
+#ifdef HAL_NET_STATS_ENABLED
+    t_start = HAL_UptimeMs();
+#endif
+    ret = select(socket_id + 1, &read_fds, NULL, NULL, timeout == 0 ? NULL : &tv);
+    UDP_STATS_ADD(socket_id, syscalls, 1);
+    UDP_STATS_ADD(socket_id, blocked_ms, (uint32_t)(HAL_UptimeMs() - t_start));
+
+    /* Zero fds ready means we timed out */
+    if (ret == 0) {
+        return -2;    /* receive timeout */
+    }
+
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return -3;    /* want read */
+        }
+
+        UDP_STATS_ADD(socket_id, errors, 1);
+        return -4; /* receive failed */
+    }
+
+    memset(msgs, 0x00, sizeof(msgs));
+    for (i = 0; i < (int)count; i++) {
+        iovecs[i].iov_base         = p_data[i];
+        iovecs[i].iov_len          = datalen;
+        msgs[i].msg_hdr.msg_iov    = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    /* the first datagram is ready, the others are taken only if already queued */
+    ret = recvmmsg(socket_id, msgs, count, MSG_DONTWAIT, NULL);
+    UDP_STATS_ADD(socket_id, syscalls, 1);
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return -3;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return -2;
+        }
+        UDP_STATS_ADD(socket_id, errors, 1);
+        return -4;
+    }
+
+    for (i = 0; i < ret; i++) {
+        p_len[i] = msgs[i].msg_len;
+        UDP_STATS_ADD(socket_id, packets_recv, 1);
+        UDP_STATS_ADD(socket_id, bytes_recv, msgs[i].msg_len);
+    }
+
+    return ret;
+}
+#endif
+
+#ifdef HAL_EVENT_ENABLED
+uintptr_t HAL_UDP_getFd(void *p_socket)
+{
+    return (uintptr_t)p_socket;
+}
+
+int HAL_UDP_readNonblock(void *p_socket,
+                         unsigned char *p_data,
+                         unsigned int datalen)
+{
+    int             ret;
+    long            socket_id = -1;
+
+    if (NULL == p_data || NULL == p_socket) {
+        return -1;
+    }
+    socket_id = (long)p_socket;
+
+    do {
+        ret = recv(socket_id, p_data, datalen, MSG_DONTWAIT);
+        UDP_STATS_IO(socket_id, recv, ret);
+    } while (ret < 0 && EINTR == errno);
+
+    if (ret < 0) {
+        return (EAGAIN == errno || EWOULDBLOCK == errno) ? -2 : -4;
+    }
+
+    return ret;
+}
+#endif  /* HAL_EVENT_ENABLED */
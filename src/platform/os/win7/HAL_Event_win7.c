@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/* GetQueuedCompletionStatusEx() and CancelIoEx() are there since Vista */
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+
+#include <winsock2.h>
+#include <windows.h>
+
+#include "iot_import.h"
+
+#ifdef HAL_EVENT_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PLATFORM_WINEVENT_PERROR printf
+
+#define HAL_EVENT_WAIT_MAX  64  /* completions dequeued per GetQueuedCompletionStatusEx */
+#define HAL_EVENT_DRAIN_MS  100 /* at most waited for the cancelled operations when destroyed */
+
+/*
+ * An I/O completion port reports finished operations, not readiness, so readiness is asked for
+ * with zero byte operations: a zero byte WSARecv() completes once data or the close of the peer
+ * arrives, a zero byte WSASend() once the connection takes data. Nothing is copied by them, the
+ * data is read and written afterwards by HAL_TCP_ReadNonblock() and HAL_TCP_WriteNonblock().
+ * A descriptor reported is asked again on the next HAL_EventLoop_wait(), which reports it again
+ * while it is still ready, as epoll does on linux.
+ *
+ * As the linux one, a loop is driven by one thread at a time. Many connections are driven by a
+ * few threads with one loop each.
+ */
+struct _hal_event_node;
+
+typedef struct {
+    OVERLAPPED               ov;        /* first, the completion hands back &ov */
+    struct _hal_event_node  *node;
+    unsigned int             event;     /* HAL_EVENT_READ or HAL_EVENT_WRITE */
+} hal_event_io_t;
+
+typedef struct _hal_event_node {
+    uintptr_t                fd;
+    void                    *user;
+    unsigned int             events;    /* registered */
+    unsigned int             armed;     /* operations not completed yet */
+    unsigned int             ready;     /* completed in the current wait */
+    int                      deleted;   /* freed once nothing is armed and it is not queued */
+    int                      queued;    /* in rearm */
+    hal_event_io_t           io_read;
+    hal_event_io_t           io_write;
+    struct _hal_event_node  *next;
+    struct _hal_event_node  *rearm_next;
+} hal_event_node_t;
+
+typedef struct {
+    HANDLE                   port;
+    hal_event_node_t        *nodes;     /* deleted ones too, till their operations complete */
+    hal_event_node_t        *rearm;     /* to be asked again on next wait */
+} hal_event_loop_t;
+
+static hal_event_node_t **_win7_event_find(hal_event_loop_t *event_loop, uintptr_t fd)
+{
+    hal_event_node_t **pos = &event_loop->nodes;
+
+    while (NULL != *pos && ((*pos)->fd != fd || (*pos)->deleted)) {
+        pos = &(*pos)->next;
+    }
+
+    return pos;
+}
+
+static void _win7_event_free(hal_event_loop_t *event_loop, hal_event_node_t *node)
+{
+    hal_event_node_t **pos = &event_loop->nodes;
+
+    while (*pos != node) {
+        pos = &(*pos)->next;
+    }
+    *pos = node->next;
+    free(node);
+}
+
+static void _win7_event_queue(hal_event_loop_t *event_loop, hal_event_node_t *node)
+{
+    if (!node->queued) {
+        node->queued = 1;
+        node->rearm_next = event_loop->rearm;
+        event_loop->rearm = node;
+    }
+}
+
+/* a failure to start is reported as a completion in error, as a failed operation would be */
+static void _win7_event_start(hal_event_loop_t *event_loop, hal_event_io_t *io)
+{
+    hal_event_node_t   *node = io->node;
+    WSABUF              buf = { 0, NULL };
+    DWORD               bytes = 0;
+    DWORD               flags = 0;
+    int                 ret;
+
+    memset(&io->ov, 0, sizeof(OVERLAPPED));
+    if (HAL_EVENT_READ == io->event) {
+        ret = WSARecv((SOCKET)node->fd, &buf, 1, &bytes, &flags, &io->ov, NULL);
+    } else {
+        ret = WSASend((SOCKET)node->fd, &buf, 1, &bytes, 0, &io->ov, NULL);
+    }
+    node->armed |= io->event;
+
+    if (0 != ret && WSA_IO_PENDING != WSAGetLastError()) {
+        io->ov.Internal = (ULONG_PTR)-1;
+        if (!PostQueuedCompletionStatus(event_loop->port, 0, 0, &io->ov)) {
+            PLATFORM_WINEVENT_PERROR("PostQueuedCompletionStatus fail");
+            node->armed &= ~io->event;
+        }
+    }
+}
+
+static void _win7_event_arm(hal_event_loop_t *event_loop, hal_event_node_t *node)
+{
+    if ((node->events & HAL_EVENT_READ) && !(node->armed & HAL_EVENT_READ)) {
+        _win7_event_start(event_loop, &node->io_read);
+    }
+    if ((node->events & HAL_EVENT_WRITE) && !(node->armed & HAL_EVENT_WRITE)) {
+        _win7_event_start(event_loop, &node->io_write);
+    }
+}
+
+void *HAL_EventLoop_create(void)
+{
+    hal_event_loop_t *event_loop = NULL;
+
+    event_loop = malloc(sizeof(hal_event_loop_t));
+    if (NULL == event_loop) {
+        return NULL;
+    }
+
+    event_loop->port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (NULL == event_loop->port) {
+        PLATFORM_WINEVENT_PERROR("CreateIoCompletionPort fail");
+        free(event_loop);
+        return NULL;
+    }
+    event_loop->nodes = NULL;
+    event_loop->rearm = NULL;
+
+    return event_loop;
+}
+
+void HAL_EventLoop_destroy(void *loop)
+{
+    hal_event_loop_t   *event_loop = loop;
+    hal_event_node_t   *node = NULL;
+    OVERLAPPED_ENTRY    entries[HAL_EVENT_WAIT_MAX];
+    ULONG               num = 0;
+    ULONG               i;
+    int                 armed = 0;
+    uint64_t            t_end;
+
+    if (NULL == event_loop) {
+        return;
+    }
+
+    /* the operations write into the nodes till they complete, cancelled ones too */
+    for (node = event_loop->nodes; NULL != node; node = node->next) {
+        if (node->armed) {
+            CancelIoEx((HANDLE)node->fd, NULL);
+            armed++;
+        }
+    }
+    t_end = GetTickCount64() + HAL_EVENT_DRAIN_MS;
+    while (armed > 0 && GetTickCount64() < t_end) {
+        if (!GetQueuedCompletionStatusEx(event_loop->port, entries, HAL_EVENT_WAIT_MAX, &num, HAL_EVENT_DRAIN_MS, FALSE)) {
+            break;
+        }
+        for (i = 0; i < num; i++) {
+            hal_event_io_t *io = (hal_event_io_t *)entries[i].lpOverlapped;
+
+            if (NULL != io) {
+                io->node->armed &= ~io->event;
+                if (0 == io->node->armed) {
+                    armed--;
+                }
+            }
+        }
+    }
+
+    while (NULL != event_loop->nodes) {
+        node = event_loop->nodes;
+        event_loop->nodes = node->next;
+        free(node);
+    }
+    CloseHandle(event_loop->port);
+    free(event_loop);
+}
+
+int HAL_EventLoop_add(void *loop, uintptr_t fd, unsigned int events, void *user)
+{
+    hal_event_loop_t   *event_loop = loop;
+    hal_event_node_t  **pos = NULL;
+    hal_event_node_t   *node = NULL;
+    u_long              nonblock = 1;
+
+    if (NULL == event_loop) {
+        return -1;
+    }
+
+    pos = _win7_event_find(event_loop, fd);
+    node = *pos;
+    if (NULL == node) {
+        /* a socket stays on the port it was first put on, so one added again fails here, and is fine */
+        if (NULL == CreateIoCompletionPort((HANDLE)fd, event_loop->port, 0, 0)
+            && ERROR_INVALID_PARAMETER != GetLastError()) {
+            PLATFORM_WINEVENT_PERROR("CreateIoCompletionPort fail");
+            return -1;
+        }
+        /* the nonblocking read and write need it, winsock has no MSG_DONTWAIT */
+        if (0 != ioctlsocket((SOCKET)fd, FIONBIO, &nonblock)) {
+            PLATFORM_WINEVENT_PERROR("ioctlsocket fail");
+            return -1;
+        }
+
+        node = malloc(sizeof(hal_event_node_t));
+        if (NULL == node) {
+            return -1;
+        }
+        memset(node, 0, sizeof(hal_event_node_t));
+        node->fd = fd;
+        node->io_read.node = node;
+        node->io_read.event = HAL_EVENT_READ;
+        node->io_write.node = node;
+        node->io_write.event = HAL_EVENT_WRITE;
+        node->next = event_loop->nodes;
+        event_loop->nodes = node;
+    }
+
+    /* an operation of an event no longer registered completes unreported */
+    node->events = events & (HAL_EVENT_READ | HAL_EVENT_WRITE);
+    node->user = user;
+    _win7_event_arm(event_loop, node);
+
+    return 0;
+}
+
+int HAL_EventLoop_delete(void *loop, uintptr_t fd)
+{
+    hal_event_loop_t   *event_loop = loop;
+    hal_event_node_t   *node = NULL;
+
+    if (NULL == event_loop) {
+        return -1;
+    }
+
+    node = *_win7_event_find(event_loop, fd);
+    if (NULL == node) {
+        return -1;
+    }
+
+    node->deleted = 1;
+    node->events = 0;
+    if (node->armed) {
+        CancelIoEx((HANDLE)fd, NULL);
+    } else if (!node->queued) {
+        _win7_event_free(event_loop, node);
+    }
+
+    return 0;
+}
+
+int HAL_EventLoop_wait(void *loop, hal_event_t *events, int count, uint32_t timeout_ms)
+{
+    hal_event_loop_t   *event_loop = loop;
+    hal_event_node_t   *node = NULL;
+    hal_event_io_t     *io = NULL;
+    hal_event_node_t   *reported[HAL_EVENT_WAIT_MAX];
+    OVERLAPPED_ENTRY    entries[HAL_EVENT_WAIT_MAX];
+    ULONG               num = 0;
+    ULONG               i;
+    int                 ret = 0;
+
+    if (NULL == event_loop || NULL == events || count <= 0) {
+        return -1;
+    }
+    if (count > HAL_EVENT_WAIT_MAX) {
+        count = HAL_EVENT_WAIT_MAX;
+    }
+
+    /* the ones reported last time are asked again, those still ready complete at once */
+    while (NULL != event_loop->rearm) {
+        node = event_loop->rearm;
+        event_loop->rearm = node->rearm_next;
+        node->queued = 0;
+        if (node->deleted) {
+            if (0 == node->armed) {
+                _win7_event_free(event_loop, node);
+            }
+        } else {
+            _win7_event_arm(event_loop, node);
+        }
+    }
+
+    if (!GetQueuedCompletionStatusEx(event_loop->port, entries, (ULONG)count, &num, timeout_ms, FALSE)) {
+        if (WAIT_TIMEOUT == GetLastError()) {
+            return 0;
+        }
+        PLATFORM_WINEVENT_PERROR("GetQueuedCompletionStatusEx fail");
+        return -1;
+    }
+
+    /* a read and a write completed together are one entry, at most one per completion */
+    for (i = 0; i < num; i++) {
+        io = (hal_event_io_t *)entries[i].lpOverlapped;
+        if (NULL == io) {
+            continue;
+        }
+        node = io->node;
+        node->armed &= ~io->event;
+
+        if (node->deleted) {
+            if (0 == node->armed && !node->queued) {
+                _win7_event_free(event_loop, node);
+            }
+            continue;
+        }
+        if (!(node->events & io->event)) {
+            continue;
+        }
+
+        /* the rearm list was emptied above, a node queued is reported already */
+        if (!node->queued) {
+            reported[ret++] = node;
+            _win7_event_queue(event_loop, node);
+        }
+        node->ready |= io->event;
+        if (0 != io->ov.Internal) {
+            node->ready |= HAL_EVENT_ERROR;
+        }
+    }
+
+    for (i = 0; i < (ULONG)ret; i++) {
+        events[i].fd = reported[i]->fd;
+        events[i].user = reported[i]->user;
+        events[i].events = reported[i]->ready;
+        reported[i]->ready = 0;
+    }
+
+    return ret;
+}
+
+#endif  /* HAL_EVENT_ENABLED */
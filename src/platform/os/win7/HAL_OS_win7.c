@@ -20,9 +20,11 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <memory.h>
+#include <ctype.h>
 
 #include <process.h>
 #include <windows.h>
+#include <io.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -75,6 +77,90 @@ void HAL_MutexUnlock(_IN_ void *mutex)
     ReleaseMutex(mutex);
 }
 
+typedef struct {
+    void               *(*work_routine)(void *);
+    void               *arg;
+} hal_win7_thread_start_t;
+
+static unsigned __stdcall _thread_start(void *start)
+{
+    hal_win7_thread_start_t run = *(hal_win7_thread_start_t *)start;
+
+    HAL_Free(start);
+    run.work_routine(run.arg);
+    return 0;
+}
+
+int HAL_ThreadCreate(void **thread_handle,
+                     void *(*work_routine)(void *),
+                     void *arg,
+                     hal_os_thread_param_t *hal_os_thread_param,
+                     int *stack_used)
+{
+    hal_win7_thread_start_t *start;
+    uintptr_t thread;
+
+    if (NULL != stack_used) {
+        *stack_used = 0;
+    }
+    if (NULL == thread_handle || NULL == work_routine
+        || NULL == (start = (hal_win7_thread_start_t *)HAL_Malloc(sizeof(hal_win7_thread_start_t)))) {
+        return -1;
+    }
+    start->work_routine = work_routine;
+    start->arg = arg;
+
+    thread = _beginthreadex(NULL,
+                            (NULL != hal_os_thread_param) ? (unsigned)hal_os_thread_param->stack_size : 0,
+                            _thread_start, start, 0, NULL);
+    if (0 == thread) {
+        PLATFORM_WINOS_PERROR("create thread error");
+        HAL_Free(start);
+        return -1;
+    }
+
+    *thread_handle = (void *)thread;
+    return 0;
+}
+
+void HAL_ThreadDetach(_IN_ void *thread_handle)
+{
+    CloseHandle((HANDLE)thread_handle);
+}
+
+void *HAL_SemaphoreCreate(void)
+{
+    HANDLE sem;
+
+    if (NULL == (sem = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL))) {
+        PLATFORM_WINOS_PERROR("create semaphore error");
+    }
+
+    return sem;
+}
+
+void HAL_SemaphoreDestroy(_IN_ void *sem)
+{
+    CloseHandle(sem);
+}
+
+void HAL_SemaphorePost(_IN_ void *sem)
+{
+    ReleaseSemaphore(sem, 1, NULL);
+}
+
+int HAL_SemaphoreWait(_IN_ void *sem, _IN_ uint32_t timeout_ms)
+{
+    DWORD wait = (PLATFORM_WAIT_INFINITE == timeout_ms) ? INFINITE : timeout_ms;
+
+    return (WAIT_OBJECT_0 == WaitForSingleObject(sem, wait)) ? 0 : -1;
+}
+
+int HAL_AtomicAdd(_IN_ volatile int *value, _IN_ int delta)
+{
+    return (int)InterlockedExchangeAdd((volatile LONG *)value, delta) + delta;
+}
+
 void *HAL_Malloc(_IN_ uint32_t size)
 {
     return malloc(size);
@@ -90,6 +176,18 @@ uint64_t HAL_UptimeMs(void)
     return (uint64_t)(GetTickCount());
 }
 
+uint64_t HAL_UptimeUs(void)
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart * 1000000 +
+                      counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
 void HAL_SleepMs(_IN_ uint32_t ms)
 {
     Sleep(ms);
@@ -363,6 +461,154 @@ int HAL_Firmware_Persistence_Write(_IN_ char *buffer, _IN_ uint32_t length)
     return 0;
 }
 
+int HAL_Firmware_Persistence_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    FILE *fp_read;
+    size_t read_len;
+
+    if (NULL == fp_temp || 0 != fflush(fp_temp)) {
+        return -1;
+    }
+
+    fp_read = fopen(otafilename, "rb");
+    if (NULL == fp_read) {
+        return -1;
+    }
+
+    if (0 != fseek(fp_read, offset, SEEK_SET)) {
+        fclose(fp_read);
+        return -1;
+    }
+    read_len = fread(buffer, 1, length, fp_read);
+    fclose(fp_read);
+
+    return (int)read_len;
+#else
+    return -1;
+#endif
+}
+
+int HAL_Firmware_Persistence_WriteAt(_IN_ uint32_t offset, _IN_ char *buffer, _IN_ uint32_t length)
+{
+    /* the file has one position for all threads, written in order only */
+    return -1;
+}
+
+int HAL_Firmware_Persistence_Async(void)
+{
+    /* the file is written by the thread calling, nothing else is held up */
+    return 1;
+}
+
+int HAL_Firmware_Persistence_Resume(_IN_ uint32_t offset)
+{
+#ifdef __DEMO__
+    long len;
+
+    fp_temp = fopen(otafilename, "r+b");
+    if (NULL == fp_temp) {
+        return -1;
+    }
+
+    if (0 != fseek(fp_temp, 0, SEEK_END) || (len = ftell(fp_temp)) < 0 || (uint32_t)len < offset ||
+        0 != _chsize(_fileno(fp_temp), offset) || 0 != fseek(fp_temp, offset, SEEK_SET)) {
+        fclose(fp_temp);
+        fp_temp = NULL;
+        return -1;
+    }
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* the image running in the demo, the one a patch is made of */
+#define otacurrentname otafilename ".current"
+
+int HAL_Firmware_Current_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    FILE *fp_current;
+    size_t read_len;
+
+    fp_current = fopen(otacurrentname, "rb");
+    if (NULL == fp_current) {
+        return -1;
+    }
+
+    if (0 != fseek(fp_current, offset, SEEK_SET)) {
+        fclose(fp_current);
+        return -1;
+    }
+    read_len = fread(buffer, 1, length, fp_current);
+    fclose(fp_current);
+
+    return (int)read_len;
+#else
+    return -1;
+#endif
+}
+
+/* the images a gateway keeps for its sub-devices, a file each slot */
+#define otacachename otafilename ".cache%d"
+
+int HAL_Firmware_Cache_Write(_IN_ int slot, _IN_ uint32_t offset, _IN_ const char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    char name[48];
+    FILE *fp_cache;
+    size_t written_len;
+
+    HAL_Snprintf(name, sizeof(name), otacachename, slot);
+    /* the first chunk starts the image anew */
+    fp_cache = fopen(name, 0 == offset ? "wb" : "r+b");
+    if (NULL == fp_cache) {
+        return -1;
+    }
+
+    if (0 != fseek(fp_cache, offset, SEEK_SET)) {
+        fclose(fp_cache);
+        return -1;
+    }
+    written_len = fwrite(buffer, 1, length, fp_cache);
+    if (0 != fclose(fp_cache) || written_len != length) {
+        return -1;
+    }
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int HAL_Firmware_Cache_Read(_IN_ int slot, _IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    char name[48];
+    FILE *fp_cache;
+    size_t read_len;
+
+    HAL_Snprintf(name, sizeof(name), otacachename, slot);
+    fp_cache = fopen(name, "rb");
+    if (NULL == fp_cache) {
+        return -1;
+    }
+
+    if (0 != fseek(fp_cache, offset, SEEK_SET)) {
+        fclose(fp_cache);
+        return -1;
+    }
+    read_len = fread(buffer, 1, length, fp_cache);
+    fclose(fp_cache);
+
+    return (int)read_len;
+#else
+    return -1;
+#endif
+}
+
 int HAL_Firmware_Persistence_Stop(void)
 {
 #ifdef __DEMO__
@@ -376,3 +622,132 @@ int HAL_Firmware_Persistence_Stop(void)
 }
 
 
+
+#define kvfiledir "iotx_kv"
+
+static int _kv_path(const char *key, char *path, int path_len)
+{
+    const char *c;
+
+    if (NULL == key || '\0' == key[0] || '.' == key[0]) {
+        return -1;
+    }
+    /* the key becomes a file name, keep it inside the directory */
+    for (c = key; *c != '\0'; c++) {
+        if (!isalnum((unsigned char)*c) && '_' != *c && '.' != *c) {
+            return -1;
+        }
+    }
+
+    if (_snprintf(path, path_len, "%s\\%s", kvfiledir, key) < 0) {
+        return -1;
+    }
+    path[path_len - 1] = '\0';
+    return 0;
+}
+
+int HAL_Kv_Set(const char *key, const void *val, int len, int sync)
+{
+    char path[256];
+    FILE *kv_fp;
+    int ret = 0;
+
+    if (NULL == val || len < 0 || 0 != _kv_path(key, path, sizeof(path))) {
+        return -1;
+    }
+
+    CreateDirectoryA(kvfiledir, NULL);
+
+    kv_fp = fopen(path, "wb");
+    if (NULL == kv_fp) {
+        return -1;
+    }
+    if (fwrite(val, 1, len, kv_fp) != (size_t)len || 0 != fflush(kv_fp)) {
+        ret = -1;
+    }
+    fclose(kv_fp);
+
+    (void)sync;
+    return ret;
+}
+
+int HAL_Kv_Get(const char *key, void *val, int *buffer_len)
+{
+    char path[256];
+    FILE *kv_fp;
+    long size;
+    int ret = -1;
+
+    if (NULL == val || NULL == buffer_len || 0 != _kv_path(key, path, sizeof(path))) {
+        return -1;
+    }
+
+    kv_fp = fopen(path, "rb");
+    if (NULL == kv_fp) {
+        return -1;
+    }
+
+    if (0 == fseek(kv_fp, 0, SEEK_END) && (size = ftell(kv_fp)) >= 0 && size <= *buffer_len) {
+        rewind(kv_fp);
+        if (fread(val, 1, size, kv_fp) == (size_t)size) {
+            *buffer_len = (int)size;
+            ret = 0;
+        }
+    }
+    fclose(kv_fp);
+
+    return ret;
+}
+
+int HAL_Kv_Del(const char *key)
+{
+    char path[256];
+
+    if (0 != _kv_path(key, path, sizeof(path))) {
+        return -1;
+    }
+
+    remove(path);
+    return 0;
+}
+
+#ifdef HAL_CRYPTO_ENABLED
+/* no crypto engine here, every hook declines and the software implementations are used */
+int HAL_Crypto_Md5Process(uint32_t state[4], const unsigned char block[64])
+{
+    return -1;
+}
+
+int HAL_Crypto_Sha1Process(uint32_t state[5], const unsigned char block[64])
+{
+    return -1;
+}
+
+int HAL_Crypto_Sha256Process(uint32_t state[8], const unsigned char block[64])
+{
+    return -1;
+}
+
+int HAL_Crypto_Hmac(hal_digest_type_t type,
+                    const unsigned char *key, uint32_t key_len,
+                    const unsigned char *msg, uint32_t msg_len,
+                    unsigned char *digest)
+{
+    return -1;
+}
+
+#ifdef HAL_CRYPTO_AES_ENABLED
+/* AES has no software fallback, a port enabling HAL_CRYPTO_AES_ENABLED must implement these */
+int HAL_Crypto_AesEncrypt(const unsigned char *key, uint32_t keybits,
+                          const unsigned char input[16], unsigned char output[16])
+{
+    return -1;
+}
+
+int HAL_Crypto_AesDecrypt(const unsigned char *key, uint32_t keybits,
+                          const unsigned char input[16], unsigned char output[16])
+{
+    return -1;
+}
+#endif  /* HAL_CRYPTO_AES_ENABLED */
+#endif  /* HAL_CRYPTO_ENABLED */
@@ -47,6 +47,22 @@ static uint64_t time_left(uint64_t t_end, uint64_t t_now)
 }
 
 
+/* this port resolves and connects with the blocking winsock 1.1 calls, the settings are accepted but not applied yet */
+void HAL_TCP_SetConnectTimeout(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+}
+
+void HAL_TCP_SetDnsCacheTTL(uint32_t ttl_ms)
+{
+    (void)ttl_ms;
+}
+
+void HAL_TCP_FlushDnsCache(void)
+{
+}
+
+
 uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
 {
     uintptr_t sockfd;
@@ -180,6 +196,36 @@ int32_t HAL_TCP_Write(uintptr_t fd, const char *buf, uint32_t len, uint32_t time
 }
 
 
+/* winsock 1.1 has no gathered send, write piece by piece within the same deadline */
+int32_t HAL_TCP_Writev(uintptr_t fd, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    int32_t ret;
+    uint32_t idx, len_sent;
+    uint64_t t_end;
+
+    t_end = GetTickCount() + timeout_ms;
+    len_sent = 0;
+
+    for (idx = 0; idx < iovcnt; idx++) {
+        if (0 == iov[idx].len) {
+            continue;
+        }
+
+        ret = HAL_TCP_Write(fd, iov[idx].buf, iov[idx].len, (uint32_t)time_left(t_end, GetTickCount()));
+        if (ret < 0) {
+            return (0 == len_sent) ? ret : len_sent;
+        }
+
+        len_sent += ret;
+        if ((uint32_t)ret < iov[idx].len) {
+            break;
+        }
+    }
+
+    return len_sent;
+}
+
+
 int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
 {
     int ret, err_code;
@@ -234,3 +280,45 @@ int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
     /* It will get error code on next calling */
     return (0 != len_recv) ? len_recv : err_code;
 }
+
+#ifdef HAL_EVENT_ENABLED
+/* the connection is made nonblocking when it is added to an event loop */
+int32_t HAL_TCP_ReadNonblock(uintptr_t fd, char *buf, uint32_t len)
+{
+    int ret;
+
+    do {
+        ret = recv(fd, buf, len, 0);
+    } while (ret < 0 && WSAEINTR == WSAGetLastError());
+
+    if (ret > 0) {
+        return ret;
+    } else if (0 == ret) {
+        PLATFORM_WINSOCK_LOG("connection is closed");
+        return -1;
+    } else if (WSAEWOULDBLOCK == WSAGetLastError()) {
+        return 0;
+    }
+
+    PLATFORM_WINSOCK_PERROR("recv fail");
+    return -2;
+}
+
+int32_t HAL_TCP_WriteNonblock(uintptr_t fd, const char *buf, uint32_t len)
+{
+    int ret;
+
+    do {
+        ret = send(fd, buf, len, 0);
+    } while (ret < 0 && WSAEINTR == WSAGetLastError());
+
+    if (ret >= 0) {
+        return ret;
+    } else if (WSAEWOULDBLOCK == WSAGetLastError()) {
+        return 0;
+    }
+
+    PLATFORM_WINSOCK_PERROR("send fail");
+    return -1;
+}
+#endif  /* HAL_EVENT_ENABLED */
@@ -30,6 +30,9 @@
     #include <signal.h>
     #include <unistd.h>
 #endif
+/* FEATURE_SSL_MAX_FRAGMENT_LENGTH_ENABLED sizes mbedtls-in-iotkit, itls is prebuilt as its own config.h says */
+#undef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+#undef MBEDTLS_SSL_MAX_CONTENT_LEN
 #include "itls/ssl.h"
 #include "itls/net.h"
 #include "itls/debug.h"
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef HAL_CRYPTO_ENABLED
+
+#include <string.h>
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/aes.h"
+
+#include "iot_import.h"
+#include "utils_sha1.h"
+#include "utils_sha256.h"
+
+/*
+ * mbedtls built with the *_PROCESS_ALT and AES_*_ALT options takes its block functions from here.
+ * Digest blocks go through the SDK digests, which try the HAL_Crypto_* hooks first and fall back
+ * to their software, the software of mbedtls itself is compiled out by these options.
+ */
+
+#if defined(MBEDTLS_SHA1_PROCESS_ALT)
+void mbedtls_sha1_process(mbedtls_sha1_context *ctx, const unsigned char data[64])
+{
+    iot_sha1_context sw;
+
+    memcpy(sw.state, ctx->state, sizeof(sw.state));
+    utils_sha1_process(&sw, data);
+    memcpy(ctx->state, sw.state, sizeof(ctx->state));
+    memset(&sw, 0, sizeof(sw));
+}
+#endif
+
+#if defined(MBEDTLS_SHA256_PROCESS_ALT)
+void mbedtls_sha256_process(mbedtls_sha256_context *ctx, const unsigned char data[64])
+{
+    iot_sha256_context sw;
+
+    /* the SDK software reads the block bytewise, any alignment is fine */
+    memcpy(sw.state, ctx->state, sizeof(sw.state));
+    utils_sha256_process(&sw, (const uint32_t *)data);
+    memcpy(ctx->state, sw.state, sizeof(ctx->state));
+    memset(&sw, 0, sizeof(sw));
+}
+#endif
+
+#ifdef HAL_CRYPTO_AES_ENABLED
+
+#ifndef MBEDTLS_ERR_AES_HW_ACCEL_FAILED
+    #define MBEDTLS_ERR_AES_HW_ACCEL_FAILED     -0x0025
+#endif
+
+/* the raw key, the first words of the encryption key schedule are the key itself */
+static uint32_t _aes_raw_key(const mbedtls_aes_context *ctx, unsigned char key[32])
+{
+    uint32_t i, len = (uint32_t)(ctx->nr - 6) * 4;     /* 10, 12, 14 rounds for 16, 24, 32 bytes */
+
+    for (i = 0; i < len; i++) {
+        key[i] = (unsigned char)(ctx->rk[i >> 2] >> ((i & 3) * 8));
+    }
+
+    return len * 8;
+}
+
+/* the engine decrypts from the raw key too, so decryption contexts hold the encryption schedule */
+int mbedtls_aes_setkey_dec(mbedtls_aes_context *ctx, const unsigned char *key, unsigned int keybits)
+{
+    return mbedtls_aes_setkey_enc(ctx, key, keybits);
+}
+
+int mbedtls_internal_aes_encrypt(mbedtls_aes_context *ctx, const unsigned char input[16], unsigned char output[16])
+{
+    unsigned char key[32];
+    int ret;
+
+    ret = HAL_Crypto_AesEncrypt(key, _aes_raw_key(ctx, key), input, output);
+    memset(key, 0, sizeof(key));
+    if (0 != ret) {
+        HAL_Printf("[err] %s(%d): aes encrypt failed\n", __FUNCTION__, __LINE__);
+        memset(output, 0, 16);
+        return MBEDTLS_ERR_AES_HW_ACCEL_FAILED;
+    }
+
+    return 0;
+}
+
+int mbedtls_internal_aes_decrypt(mbedtls_aes_context *ctx, const unsigned char input[16], unsigned char output[16])
+{
+    unsigned char key[32];
+    int ret;
+
+    ret = HAL_Crypto_AesDecrypt(key, _aes_raw_key(ctx, key), input, output);
+    memset(key, 0, sizeof(key));
+    if (0 != ret) {
+        HAL_Printf("[err] %s(%d): aes decrypt failed\n", __FUNCTION__, __LINE__);
+        memset(output, 0, 16);
+        return MBEDTLS_ERR_AES_HW_ACCEL_FAILED;
+    }
+
+    return 0;
+}
+
+#endif  /* HAL_CRYPTO_AES_ENABLED */
+
+#endif  /* HAL_CRYPTO_ENABLED */
@@ -44,9 +44,39 @@ typedef struct {
     mbedtls_net_context          fd;
     mbedtls_timing_delay_context timer;
     mbedtls_ssl_cookie_ctx       cookie_ctx;
+#ifdef HAL_NET_STATS_ENABLED
+    hal_ssl_stats_t              stats;
+#endif
 } dtls_session_t;
 
+#define DTLS_RESUME_HOST_LEN    (128)
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+#if MBEDTLS_SSL_MAX_CONTENT_LEN >= 4096
+    #define DTLS_MFL_CODE       MBEDTLS_SSL_MAX_FRAG_LEN_4096
+#elif MBEDTLS_SSL_MAX_CONTENT_LEN >= 2048
+    #define DTLS_MFL_CODE       MBEDTLS_SSL_MAX_FRAG_LEN_2048
+#elif MBEDTLS_SSL_MAX_CONTENT_LEN >= 1024
+    #define DTLS_MFL_CODE       MBEDTLS_SSL_MAX_FRAG_LEN_1024
+#else
+    #define DTLS_MFL_CODE       MBEDTLS_SSL_MAX_FRAG_LEN_512
+#endif
+#endif
+
+/* session of the last handshake, kept across HAL_DTLSSession_free to resume the next one to the same server */
+typedef struct {
+    int                          valid;
+    char                         host[DTLS_RESUME_HOST_LEN];
+    unsigned short               port;
+    mbedtls_ssl_session          session;
+} dtls_resume_t;
+
+static dtls_resume_t _DTLSResume;
+
 
+#ifdef SSL_MEMORY_POOL_ENABLED
+void _SSLPool_install(void);
+#else
 static  void *_DTLSCalloc_wrapper(size_t n, size_t s)
 {
     void *ptr = NULL;
@@ -65,6 +95,7 @@ static  void _DTLSFree_wrapper(void *ptr)
         ptr = NULL;
     }
 }
+#endif
 
 static unsigned int _DTLSVerifyOptions_set(dtls_session_t *p_dtls_session,
         unsigned char    *p_ca_cert_pem)
@@ -107,9 +138,103 @@ static void _DTLSLog_wrapper(void        *p_ctx, int level,
     DTLS_INFO("[mbedTLS]:[%s]:[%d]: %s\r\n", p_file, line, p_str);
 }
 
+static void _DTLSResume_clear(void)
+{
+    if (_DTLSResume.valid) {
+        mbedtls_ssl_session_free(&_DTLSResume.session);
+        _DTLSResume.valid = 0;
+    }
+}
+
+static int _DTLSResume_match(coap_dtls_options_t *p_options)
+{
+    return _DTLSResume.valid && _DTLSResume.port == p_options->port
+           && 0 == strncmp(_DTLSResume.host, p_options->p_host, DTLS_RESUME_HOST_LEN);
+}
+
+static void _DTLSResume_save(dtls_session_t *p_dtls_session, coap_dtls_options_t *p_options)
+{
+    _DTLSResume_clear();
+    if (strlen(p_options->p_host) >= DTLS_RESUME_HOST_LEN) {
+        return;
+    }
+
+    mbedtls_ssl_session_init(&_DTLSResume.session);
+    if (0 != mbedtls_ssl_get_session(&p_dtls_session->context, &_DTLSResume.session)) {
+        mbedtls_ssl_session_free(&_DTLSResume.session);
+        return;
+    }
+    strncpy(_DTLSResume.host, p_options->p_host, DTLS_RESUME_HOST_LEN - 1);
+    _DTLSResume.port  = p_options->port;
+    _DTLSResume.valid = 1;
+}
+
+#ifdef HAL_NET_STATS_ENABLED
+/* a send or receive of ret, timeouts and would-block are no errors */
+static void _DTLSStats_count(hal_net_stats_t *stats, int is_recv, int ret)
+{
+    stats->syscalls++;
+    if (ret > 0 && is_recv) {
+        stats->packets_recv++;
+        stats->bytes_recv += ret;
+    } else if (ret > 0) {
+        stats->packets_sent++;
+        stats->bytes_sent += ret;
+    } else if (ret < 0 && MBEDTLS_ERR_SSL_TIMEOUT != ret && MBEDTLS_ERR_SSL_WANT_READ != ret
+               && MBEDTLS_ERR_SSL_WANT_WRITE != ret) {
+        stats->errors++;
+    }
+}
+
+/* the bio of a session, counting the datagrams on the socket */
+static int _DTLSNet_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    dtls_session_t *p_dtls_session = (dtls_session_t *)ctx;
+    int ret = mbedtls_net_send(&p_dtls_session->fd, buf, len);
+
+    _DTLSStats_count(&p_dtls_session->stats.net, 0, ret);
+    return ret;
+}
+
+static int _DTLSNet_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    dtls_session_t *p_dtls_session = (dtls_session_t *)ctx;
+    int ret = mbedtls_net_recv(&p_dtls_session->fd, buf, len);
+
+    _DTLSStats_count(&p_dtls_session->stats.net, 1, ret);
+    return ret;
+}
+
+static int _DTLSNet_recv_timeout(void *ctx, unsigned char *buf, size_t len, uint32_t timeout)
+{
+    dtls_session_t *p_dtls_session = (dtls_session_t *)ctx;
+    uint64_t start = HAL_UptimeMs();
+    int ret = mbedtls_net_recv_timeout(&p_dtls_session->fd, buf, len, timeout);
+
+    /* the select, the recv is counted below unless it timed out */
+    p_dtls_session->stats.net.blocked_ms += (uint32_t)(HAL_UptimeMs() - start);
+    if (MBEDTLS_ERR_SSL_TIMEOUT != ret) {
+        p_dtls_session->stats.net.syscalls++;
+    }
+    _DTLSStats_count(&p_dtls_session->stats.net, 1, ret);
+    return ret;
+}
+
+int HAL_DTLSSession_GetStats(DTLSContext *context, hal_ssl_stats_t *stats)
+{
+    if (NULL == context || NULL == stats) {
+        return -1;
+    }
+
+    memcpy(stats, &((dtls_session_t *)context)->stats, sizeof(hal_ssl_stats_t));
+    return 0;
+}
+#endif  /* HAL_NET_STATS_ENABLED */
+
 static unsigned int _DTLSContext_setup(dtls_session_t *p_dtls_session, coap_dtls_options_t  *p_options)
 {
     int   result = 0;
+    int   resume = 0;
 
     mbedtls_ssl_init(&p_dtls_session->context);
 
@@ -128,18 +253,48 @@ static unsigned int _DTLSContext_setup(dtls_session_t *p_dtls_session, coap_dtls
         DTLS_TRC("mbedtls_ssl_set_hostname %s\r\n", p_options->p_host);
         mbedtls_ssl_set_hostname(&p_dtls_session->context, p_options->p_host);
 #endif
+#ifdef HAL_NET_STATS_ENABLED
+        mbedtls_ssl_set_bio(&p_dtls_session->context,
+                            (void *)p_dtls_session,
+                            _DTLSNet_send,
+                            _DTLSNet_recv,
+                            _DTLSNet_recv_timeout);
+#else
         mbedtls_ssl_set_bio(&p_dtls_session->context,
                             (void *)&p_dtls_session->fd,
                             mbedtls_net_send,
                             mbedtls_net_recv,
                             mbedtls_net_recv_timeout);
+#endif
         DTLS_TRC("mbedtls_ssl_set_bio result 0x%04x\r\n", result);
 
+#if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID)
+        /* RFC 9146, the server's connection ID keeps the session across NAT rebinding, the client needs none of its own */
+        mbedtls_ssl_set_cid(&p_dtls_session->context, MBEDTLS_SSL_CID_ENABLED, NULL, 0);
+#endif
+
+        /* an abbreviated handshake by ticket or session id, the server falls back to a full one when it refuses */
+        resume = _DTLSResume_match(p_options);
+        if (resume && 0 != mbedtls_ssl_set_session(&p_dtls_session->context, &_DTLSResume.session)) {
+            resume = 0;
+        }
+
         do {
             result = mbedtls_ssl_handshake(&p_dtls_session->context);
         } while (result == MBEDTLS_ERR_SSL_WANT_READ ||
                  result == MBEDTLS_ERR_SSL_WANT_WRITE);
         DTLS_TRC("mbedtls_ssl_handshake result 0x%04x\r\n", result);
+
+        if (0 == result) {
+            if (resume && NULL != p_dtls_session->context.session
+                && 0 == memcmp(p_dtls_session->context.session->master, _DTLSResume.session.master,
+                               sizeof(_DTLSResume.session.master))) {
+                DTLS_INFO("DTLS session resumed\r\n");
+            }
+            _DTLSResume_save(p_dtls_session, p_options);
+        } else {
+            _DTLSResume_clear();
+        }
     }
 
     return (result ? DTLS_HANDSHAKE_FAILED : DTLS_SUCCESS);
@@ -151,7 +306,11 @@ dtls_session_t *_DTLSSession_init()
     p_dtls_session = coap_malloc(sizeof(dtls_session_t));
 
     mbedtls_debug_set_threshold(0);
+#ifdef SSL_MEMORY_POOL_ENABLED
+    _SSLPool_install();
+#else
     mbedtls_platform_set_calloc_free(_DTLSCalloc_wrapper, _DTLSFree_wrapper);
+#endif
     if (NULL != p_dtls_session) {
         mbedtls_net_init(&p_dtls_session->fd);
         mbedtls_ssl_init(&p_dtls_session->context);
@@ -165,6 +324,9 @@ dtls_session_t *_DTLSSession_init()
 #endif
         mbedtls_ctr_drbg_init(&p_dtls_session->ctr_drbg);
         mbedtls_entropy_init(&p_dtls_session->entropy);
+#ifdef HAL_NET_STATS_ENABLED
+        memset(&p_dtls_session->stats, 0, sizeof(hal_ssl_stats_t));
+#endif
         DTLS_INFO("HAL_DTLSSession_init success\r\n");
 
     }
@@ -223,6 +385,17 @@ DTLSContext *HAL_DTLSSession_create(coap_dtls_options_t            *p_options)
         }
         mbedtls_ssl_conf_rng(&p_dtls_session->conf, mbedtls_ctr_drbg_random, &p_dtls_session->ctr_drbg);
         mbedtls_ssl_conf_dbg(&p_dtls_session->conf, _DTLSLog_wrapper, NULL);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+        mbedtls_ssl_conf_session_tickets(&p_dtls_session->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH) && MBEDTLS_SSL_MAX_CONTENT_LEN < 16384
+        /* datagrams bigger than the buffers can not be read at all, the server has to be asked for smaller ones */
+        result = mbedtls_ssl_conf_max_frag_len(&p_dtls_session->conf, DTLS_MFL_CODE);
+        if (0 != result) {
+            DTLS_ERR("mbedtls_ssl_conf_max_frag_len result 0x%04x\r\n", result);
+            goto error;
+        }
+#endif
 
         result = mbedtls_ssl_cookie_setup(&p_dtls_session->cookie_ctx,
                                           mbedtls_ctr_drbg_random, &p_dtls_session->ctr_drbg);
@@ -291,6 +464,9 @@ unsigned int HAL_DTLSSession_write(DTLSContext *context,
     if (NULL != p_dtls_session && NULL != p_data && p_datalen != NULL) {
         len = (*p_datalen);
         len = mbedtls_ssl_write(&p_dtls_session->context, p_data, len);
+#ifdef HAL_NET_STATS_ENABLED
+        _DTLSStats_count(&p_dtls_session->stats.app, 0, len);
+#endif
 
         if (len < 0) {
             if (len == MBEDTLS_ERR_SSL_CONN_EOF) {
@@ -319,6 +495,9 @@ unsigned int HAL_DTLSSession_read(DTLSContext *context,
     if (NULL != p_dtls_session && NULL != p_data && p_datalen != NULL) {
         mbedtls_ssl_conf_read_timeout(&(p_dtls_session->conf), timeout);
         len = mbedtls_ssl_read(&p_dtls_session->context, p_data, *p_datalen);
+#ifdef HAL_NET_STATS_ENABLED
+        _DTLSStats_count(&p_dtls_session->stats.app, 1, len);
+#endif
 
         if (0  <  len) {
             *p_datalen = len;
@@ -329,6 +508,8 @@ unsigned int HAL_DTLSSession_read(DTLSContext *context,
             if (MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE == len) {
                 err_code = DTLS_FATAL_ALERT_MESSAGE;
                 DTLS_INFO("Recv peer fatal alert message\r\n");
+                /* a fatal alert invalidates the session, the next connection does a full handshake */
+                _DTLSResume_clear();
             } else if (MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY == len) {
                 err_code = DTLS_PEER_CLOSE_NOTIFY;
                 DTLS_INFO("The DTLS session was closed by peer\r\n");
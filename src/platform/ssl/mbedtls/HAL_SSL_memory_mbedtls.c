@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef SSL_MEMORY_POOL_ENABLED
+
+#include <stdlib.h>
+#include <string.h>
+#include "mbedtls/platform.h"
+
+#include "iot_import.h"
+
+/*
+ * Static pool all mbedtls allocations of TLS and DTLS come from, so handshakes
+ * never fragment the system heap and peak TLS memory is bounded and measurable.
+ *
+ * Blocks are laid out back to back, each one behind a header holding its own
+ * size and the size of the block before it, so a freed block merges with both
+ * its neighbours at once. Allocation is first fit.
+ */
+#ifndef SSL_MEMORY_POOL_SIZE
+    #define SSL_MEMORY_POOL_SIZE    (64 * 1024)
+#endif
+
+#define SSL_POOL_ALIGN          (2 * sizeof(size_t))
+#define SSL_POOL_USED           ((size_t)1)
+#define SSL_POOL_ALIGN_UP(x)    (((x) + SSL_POOL_ALIGN - 1) & ~(SSL_POOL_ALIGN - 1))
+
+typedef struct {
+    size_t size;        /* bytes of the block, header included, SSL_POOL_USED set when allocated */
+    size_t prev_size;   /* bytes of the block before, 0 for the first one */
+} ssl_pool_hdr_t;
+
+#define SSL_POOL_HDR_SIZE       SSL_POOL_ALIGN_UP(sizeof(ssl_pool_hdr_t))
+#define SSL_POOL_MIN_BLOCK      (SSL_POOL_HDR_SIZE + SSL_POOL_ALIGN)
+
+static size_t _SSLPool_buf[SSL_MEMORY_POOL_SIZE / sizeof(size_t)];
+static unsigned char *const _SSLPool_start = (unsigned char *)_SSLPool_buf;
+static size_t _SSLPool_size;    /* usable bytes, 0 until initialized */
+static void *_SSLPool_mutex;
+static hal_ssl_memory_stats_t _SSLPool_stats;
+
+#define SSL_POOL_BLOCK_SIZE(h)  ((h)->size & ~SSL_POOL_USED)
+#define SSL_POOL_NEXT(h)        ((ssl_pool_hdr_t *)((unsigned char *)(h) + SSL_POOL_BLOCK_SIZE(h)))
+#define SSL_POOL_END            ((ssl_pool_hdr_t *)(_SSLPool_start + _SSLPool_size))
+
+static void _SSLPool_lock(void)
+{
+    if (NULL != _SSLPool_mutex) {
+        HAL_MutexLock(_SSLPool_mutex);
+    }
+}
+
+static void _SSLPool_unlock(void)
+{
+    if (NULL != _SSLPool_mutex) {
+        HAL_MutexUnlock(_SSLPool_mutex);
+    }
+}
+
+static void *_SSLPool_calloc(size_t n, size_t size)
+{
+    size_t need, block_size;
+    ssl_pool_hdr_t *hdr, *rest;
+    void *ptr = NULL;
+
+    if (0 == n || 0 == size || size > (SSL_MEMORY_POOL_SIZE / n)) {
+        return NULL;
+    }
+    need = SSL_POOL_HDR_SIZE + SSL_POOL_ALIGN_UP(n * size);
+
+    _SSLPool_lock();
+    for (hdr = (ssl_pool_hdr_t *)_SSLPool_start; hdr < SSL_POOL_END; hdr = SSL_POOL_NEXT(hdr)) {
+        block_size = SSL_POOL_BLOCK_SIZE(hdr);
+        if ((hdr->size & SSL_POOL_USED) || block_size < need) {
+            continue;
+        }
+
+        /* split off the tail when it can hold a block of its own */
+        if (block_size - need >= SSL_POOL_MIN_BLOCK) {
+            rest = (ssl_pool_hdr_t *)((unsigned char *)hdr + need);
+            rest->size = block_size - need;
+            rest->prev_size = need;
+            if (SSL_POOL_NEXT(rest) < SSL_POOL_END) {
+                SSL_POOL_NEXT(rest)->prev_size = rest->size;
+            }
+            block_size = need;
+        }
+
+        hdr->size = block_size | SSL_POOL_USED;
+        _SSLPool_stats.in_use += block_size;
+        if (_SSLPool_stats.in_use > _SSLPool_stats.peak) {
+            _SSLPool_stats.peak = _SSLPool_stats.in_use;
+        }
+
+        ptr = (unsigned char *)hdr + SSL_POOL_HDR_SIZE;
+        break;
+    }
+    if (NULL == ptr) {
+        _SSLPool_stats.failed++;
+    }
+    _SSLPool_unlock();
+
+    if (NULL != ptr) {
+        memset(ptr, 0, n * size);
+    } else {
+        HAL_Printf("[err] %s(%d): ssl memory pool exhausted, %u bytes wanted\n", __FUNCTION__, __LINE__,
+                   (unsigned int)(n * size));
+    }
+
+    return ptr;
+}
+
+static void _SSLPool_free(void *ptr)
+{
+    ssl_pool_hdr_t *hdr, *next, *prev;
+
+    if (NULL == ptr) {
+        return;
+    }
+    /* allocated by the default calloc before the pool took over */
+    if ((unsigned char *)ptr < _SSLPool_start || (unsigned char *)ptr >= (unsigned char *)SSL_POOL_END) {
+        free(ptr);
+        return;
+    }
+
+    hdr = (ssl_pool_hdr_t *)((unsigned char *)ptr - SSL_POOL_HDR_SIZE);
+
+    _SSLPool_lock();
+    if (!(hdr->size & SSL_POOL_USED)) {
+        _SSLPool_unlock();
+        HAL_Printf("[err] %s(%d): double free of %p\n", __FUNCTION__, __LINE__, ptr);
+        return;
+    }
+    hdr->size &= ~SSL_POOL_USED;
+    _SSLPool_stats.in_use -= hdr->size;
+
+    next = SSL_POOL_NEXT(hdr);
+    if (next < SSL_POOL_END && !(next->size & SSL_POOL_USED)) {
+        hdr->size += next->size;
+    }
+    if (0 != hdr->prev_size) {
+        prev = (ssl_pool_hdr_t *)((unsigned char *)hdr - hdr->prev_size);
+        if (!(prev->size & SSL_POOL_USED)) {
+            prev->size += hdr->size;
+            hdr = prev;
+        }
+    }
+    next = SSL_POOL_NEXT(hdr);
+    if (next < SSL_POOL_END) {
+        next->prev_size = hdr->size;
+    }
+    _SSLPool_unlock();
+}
+
+/* route mbedtls allocations into the pool, called before every TLS/DTLS connection is set up */
+void _SSLPool_install(void)
+{
+    ssl_pool_hdr_t *hdr;
+
+    if (0 != _SSLPool_size) {
+        return;
+    }
+
+    /* created by the first connection, before any other thread can race for it */
+    _SSLPool_mutex = HAL_MutexCreate();
+
+    _SSLPool_size = (sizeof(_SSLPool_buf) / SSL_POOL_ALIGN) * SSL_POOL_ALIGN;
+    hdr = (ssl_pool_hdr_t *)_SSLPool_start;
+    hdr->size = _SSLPool_size;
+    hdr->prev_size = 0;
+    _SSLPool_stats.pool_size = _SSLPool_size;
+
+    mbedtls_platform_set_calloc_free(_SSLPool_calloc, _SSLPool_free);
+}
+
+void HAL_SSL_MemoryStats(hal_ssl_memory_stats_t *stats)
+{
+    if (NULL == stats) {
+        return;
+    }
+
+    _SSLPool_lock();
+    memcpy(stats, &_SSLPool_stats, sizeof(hal_ssl_memory_stats_t));
+    stats->pool_size = (uint32_t)((sizeof(_SSLPool_buf) / SSL_POOL_ALIGN) * SSL_POOL_ALIGN);
+    _SSLPool_unlock();
+}
+
+void HAL_SSL_MemoryStatsReset(void)
+{
+    _SSLPool_lock();
+    _SSLPool_stats.peak = _SSLPool_stats.in_use;
+    _SSLPool_stats.failed = 0;
+    _SSLPool_unlock();
+}
+
+#endif  /* SSL_MEMORY_POOL_ENABLED */
@@ -40,15 +40,56 @@
 
 #include "iot_import.h"
 
+/* records sealed and opened by the kernel once the handshake is done, for the AES-GCM suites of TLS 1.2 only */
+#if defined(SSL_KTLS_ENABLED) && defined(_PLATFORM_IS_LINUX_) && defined(MBEDTLS_GCM_C) && defined(MBEDTLS_SSL_EXPORT_KEYS)
+    #define SSL_KTLS
+    #include <errno.h>
+    #include <poll.h>
+    #include <netinet/tcp.h>
+    #include <sys/uio.h>
+    #include <linux/tls.h>
+    #include "mbedtls/ssl_ciphersuites.h"
+    #ifndef TCP_ULP
+        #define TCP_ULP                 (31)
+    #endif
+    #ifndef SOL_TLS
+        #define SOL_TLS                 (282)
+    #endif
+#endif
+
 #define SEND_TIMEOUT_SECONDS (10)
 
-typedef struct _TLSDataParams {
-    mbedtls_ssl_context ssl;          /**< mbed TLS control context. */
-    mbedtls_net_context fd;           /**< mbed TLS network context. */
+/* certificates and configuration, parsed once and shared by every connection made with the same ones */
+typedef struct _TLSConfig {
+    struct _TLSConfig *next;
+    int refcount;
+    const char *ca_crt;               /**< as passed in, with length and hash, identifies the configuration. */
+    size_t ca_crt_len;
+    uint32_t ca_crt_hash;
+    const char *client_crt;
+    const char *client_key;
     mbedtls_ssl_config conf;          /**< mbed TLS configuration context. */
     mbedtls_x509_crt cacertl;         /**< mbed TLS CA certification. */
     mbedtls_x509_crt clicert;         /**< mbed TLS Client certification. */
     mbedtls_pk_context pkey;          /**< mbed TLS Client key. */
+} TLSConfig_t;
+
+typedef struct _TLSDataParams {
+    mbedtls_ssl_context ssl;          /**< mbed TLS control context. */
+    mbedtls_net_context fd;           /**< mbed TLS network context. */
+    TLSConfig_t *config;              /**< shared configuration, read only once set up. */
+    uint32_t read_timeout_ms;         /**< per connection, the shared configuration can not hold it. */
+    int read_nonblock;                /**< reads only take what already arrived. */
+    int net_status;                   /**< -2 once the peer closed the connection, -1 after an error, returned by every later read. */
+    unsigned char *stage;             /**< small pieces of HAL_SSL_Writev gathered into one record, allocated on first use. */
+#ifdef SSL_KTLS
+    int ktls;                         /**< the kernel seals and opens the records, reads and writes go to the socket. */
+    size_t ktls_keylen;               /**< of the keys exported by the handshake, 0 when they do not suit the kernel. */
+    unsigned char ktls_keys[2 * 32 + 2 * 4];  /**< client write key, server write key, then their fixed ivs. */
+#endif
+#ifdef HAL_NET_STATS_ENABLED
+    hal_ssl_stats_t stats;            /**< of this connection, for HAL_SSL_GetStats. */
+#endif
 } TLSDataParams_t, *TLSDataParams_pt;
 
 #define SSL_LOG(format, ...) \
@@ -60,6 +101,44 @@ typedef struct _TLSDataParams {
 
 #define DEBUG_LEVEL 10
 
+/* gathered writes are staged up to one record, but never more than this, a full 16KB record is not worth the RAM */
+#ifndef SSL_WRITEV_COALESCE_LEN
+    #define SSL_WRITEV_COALESCE_LEN     (2048)
+#endif
+
+#define TLS_SESSION_CACHE_SIZE      (2)
+#define TLS_SESSION_HOST_LEN        (128)
+
+/* session of the last handshake per server, kept across HAL_SSL_Destroy so the next HAL_SSL_Establish can resume it */
+typedef struct {
+    int                 valid;
+    char                host[TLS_SESSION_HOST_LEN];
+    uint16_t            port;
+    uint32_t            used;       /* bigger is more recent, the least recent one is replaced */
+    mbedtls_ssl_session session;
+} tls_session_entry_t;
+
+static tls_session_entry_t _TLSSessionCache[TLS_SESSION_CACHE_SIZE];
+static uint32_t _TLSSessionClock;
+static void *_TLSCacheMutex;    /* guards the session cache and the configuration list */
+static TLSConfig_t *_TLSConfigList;
+
+#ifdef SSL_SESSION_PERSIST_ENABLED
+/*
+ * persisted session, all numbers big endian:
+ * version, host len, host, port, ciphersuite, compression, id len, id, master,
+ * verify result, ticket len, ticket, ticket lifetime, mfl code, truncated hmac, encrypt then mac.
+ */
+#define TLS_SESSION_KV_VERSION      (1)
+#define TLS_SESSION_TICKET_MAXLEN   (512)  /* bigger tickets are resumed from RAM only */
+#define TLS_SESSION_KV_MAXLEN       (2 + TLS_SESSION_HOST_LEN + 2 + 4 + 4 + 1 + 32 + 48 + 4 + 2 + TLS_SESSION_TICKET_MAXLEN + 4 + 3)
+#define TLS_SESSION_KV_KEY_LEN      (24)
+#endif
+
+
+#ifdef SSL_MEMORY_POOL_ENABLED
+void _SSLPool_install(void);
+#endif
 
 static unsigned int _avRandom()
 {
@@ -117,6 +196,29 @@ static int _real_confirm(int verify_result)
     return 0;
 }
 
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+/*
+ * max_fragment_length asked of the server, the largest one the in/out buffers of MBEDTLS_SSL_MAX_CONTENT_LEN hold.
+ * A server ignoring the extension still sends records of up to 16KB, which do not fit into smaller buffers.
+ */
+static unsigned char _ssl_mfl_code(void)
+{
+#if MBEDTLS_SSL_MAX_CONTENT_LEN >= 16384
+    return MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+#elif MBEDTLS_SSL_MAX_CONTENT_LEN >= 4096
+    return MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+#elif MBEDTLS_SSL_MAX_CONTENT_LEN >= 2048
+    return MBEDTLS_SSL_MAX_FRAG_LEN_2048;
+#elif MBEDTLS_SSL_MAX_CONTENT_LEN >= 1024
+    return MBEDTLS_SSL_MAX_FRAG_LEN_1024;
+#elif MBEDTLS_SSL_MAX_CONTENT_LEN >= 512
+    return MBEDTLS_SSL_MAX_FRAG_LEN_512;
+#else
+#error "MBEDTLS_SSL_MAX_CONTENT_LEN must be 512 at least"
+#endif
+}
+#endif
+
 static int _ssl_parse_crt(mbedtls_x509_crt *crt)
 {
     char buf[1024];
@@ -148,9 +250,7 @@ static int _ssl_parse_crt(mbedtls_x509_crt *crt)
     return i;
 }
 
-static int _ssl_client_init(mbedtls_ssl_context *ssl,
-                            mbedtls_net_context *tcp_fd,
-                            mbedtls_ssl_config *conf,
+static int _ssl_client_init(mbedtls_ssl_config *conf,
                             mbedtls_x509_crt *crt509_ca, const char *ca_crt, size_t ca_len,
                             mbedtls_x509_crt *crt509_cli, const char *cli_crt, size_t cli_len,
                             mbedtls_pk_context *pk_cli, const char *cli_key, size_t key_len,  const char *cli_pwd, size_t pwd_len
@@ -164,8 +264,6 @@ static int _ssl_client_init(mbedtls_ssl_context *ssl,
 #if defined(MBEDTLS_DEBUG_C)
     mbedtls_debug_set_threshold((int)DEBUG_LEVEL);
 #endif
-    mbedtls_net_init(tcp_fd);
-    mbedtls_ssl_init(ssl);
     mbedtls_ssl_config_init(conf);
     mbedtls_x509_crt_init(crt509_ca);
 
@@ -225,6 +323,865 @@ static int _ssl_client_init(mbedtls_ssl_context *ssl,
     return 0;
 }
 
+static void _TLSCache_lock(void)
+{
+    /* created by the first connect, before any other thread can race for it */
+    if (NULL == _TLSCacheMutex) {
+        _TLSCacheMutex = HAL_MutexCreate();
+    }
+    if (NULL != _TLSCacheMutex) {
+        HAL_MutexLock(_TLSCacheMutex);
+    }
+}
+
+static void _TLSCache_unlock(void)
+{
+    if (NULL != _TLSCacheMutex) {
+        HAL_MutexUnlock(_TLSCacheMutex);
+    }
+}
+
+static tls_session_entry_t *_TLSSession_find(const char *host, uint16_t port)
+{
+    int i;
+
+    for (i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+        if (_TLSSessionCache[i].valid && _TLSSessionCache[i].port == port
+            && 0 == strncmp(_TLSSessionCache[i].host, host, TLS_SESSION_HOST_LEN)) {
+            return &_TLSSessionCache[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void _TLSSession_clear(tls_session_entry_t *entry)
+{
+    if (entry->valid) {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->valid = 0;
+    }
+}
+
+/* keep session in the cache, the entry takes the session over */
+static void _TLSSession_store(const char *host, uint16_t port, mbedtls_ssl_session *session)
+{
+    int i;
+    tls_session_entry_t *entry;
+
+    entry = _TLSSession_find(host, port);
+    if (NULL == entry) {
+        /* a free entry, or else the least recently used one */
+        entry = &_TLSSessionCache[0];
+        for (i = 1; i < TLS_SESSION_CACHE_SIZE && entry->valid; i++) {
+            if (!_TLSSessionCache[i].valid || _TLSSessionCache[i].used < entry->used) {
+                entry = &_TLSSessionCache[i];
+            }
+        }
+    }
+
+    _TLSSession_clear(entry);
+    memcpy(&entry->session, session, sizeof(mbedtls_ssl_session));
+    strncpy(entry->host, host, TLS_SESSION_HOST_LEN - 1);
+    entry->host[TLS_SESSION_HOST_LEN - 1] = '\0';
+    entry->port = port;
+    entry->used = ++_TLSSessionClock;
+    entry->valid = 1;
+}
+
+#ifdef SSL_SESSION_PERSIST_ENABLED
+static void _TLSSession_kv_key(const char *host, uint16_t port, char *key)
+{
+    uint32_t hash = 2166136261u;    /* FNV-1a of host and port, the host itself is checked on load */
+
+    while (*host) {
+        hash = (hash ^ (unsigned char) * host++) * 16777619u;
+    }
+    hash = (hash ^ (port >> 8)) * 16777619u;
+    hash = (hash ^ (port & 0xff)) * 16777619u;
+
+    HAL_Snprintf(key, TLS_SESSION_KV_KEY_LEN, "tls_session.%08x", (unsigned int)hash);
+}
+
+static unsigned char *_TLSSession_put(unsigned char *p, uint32_t value, int len)
+{
+    while (len-- > 0) {
+        *p++ = (unsigned char)(value >> (len * 8));
+    }
+    return p;
+}
+
+static const unsigned char *_TLSSession_get(const unsigned char *p, uint32_t *value, int len)
+{
+    *value = 0;
+    while (len-- > 0) {
+        *value = (*value << 8) | *p++;
+    }
+    return p;
+}
+
+static void _TLSSession_persist(const char *host, uint16_t port, const mbedtls_ssl_session *session)
+{
+    char key[TLS_SESSION_KV_KEY_LEN];
+    unsigned char *blob, *p;
+    size_t host_len = strlen(host);
+    size_t ticket_len = 0;
+    const unsigned char *ticket = NULL;
+    uint32_t ticket_lifetime = 0, mfl = 0, trunc_hmac = 0, etm = 0;
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    ticket = session->ticket;
+    ticket_len = session->ticket_len;
+    ticket_lifetime = session->ticket_lifetime;
+#endif
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    mfl = session->mfl_code;
+#endif
+#if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
+    trunc_hmac = session->trunc_hmac;
+#endif
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+    etm = session->encrypt_then_mac;
+#endif
+
+    _TLSSession_kv_key(host, port, key);
+    if (host_len >= TLS_SESSION_HOST_LEN || ticket_len > TLS_SESSION_TICKET_MAXLEN || session->id_len > 32) {
+        HAL_Kv_Del(key);
+        return;
+    }
+
+    blob = HAL_Malloc(TLS_SESSION_KV_MAXLEN);
+    if (NULL == blob) {
+        return;
+    }
+
+    p = _TLSSession_put(blob, TLS_SESSION_KV_VERSION, 1);
+    p = _TLSSession_put(p, host_len, 1);
+    memcpy(p, host, host_len);
+    p += host_len;
+    p = _TLSSession_put(p, port, 2);
+    p = _TLSSession_put(p, (uint32_t)session->ciphersuite, 4);
+    p = _TLSSession_put(p, (uint32_t)session->compression, 4);
+    p = _TLSSession_put(p, session->id_len, 1);
+    memcpy(p, session->id, 32);
+    p += 32;
+    memcpy(p, session->master, 48);
+    p += 48;
+    p = _TLSSession_put(p, session->verify_result, 4);
+    p = _TLSSession_put(p, ticket_len, 2);
+    if (ticket_len > 0) {
+        memcpy(p, ticket, ticket_len);
+        p += ticket_len;
+    }
+    p = _TLSSession_put(p, ticket_lifetime, 4);
+    p = _TLSSession_put(p, mfl, 1);
+    p = _TLSSession_put(p, trunc_hmac, 1);
+    p = _TLSSession_put(p, etm, 1);
+
+    if (0 != HAL_Kv_Set(key, blob, p - blob, 0)) {
+        SSL_LOG("persist tls session fail");
+    }
+    HAL_Free(blob);
+}
+
+/* load a persisted session of host:port into session, 0 when found */
+static int _TLSSession_restore(const char *host, uint16_t port, mbedtls_ssl_session *session)
+{
+    char key[TLS_SESSION_KV_KEY_LEN];
+    unsigned char *blob;
+    const unsigned char *p, *end;
+    int len = TLS_SESSION_KV_MAXLEN;
+    uint32_t value, ticket_len;
+    int inited = 0;
+    int ret = -1;
+
+    blob = HAL_Malloc(TLS_SESSION_KV_MAXLEN);
+    if (NULL == blob) {
+        return -1;
+    }
+
+    _TLSSession_kv_key(host, port, key);
+    if (0 != HAL_Kv_Get(key, blob, &len)) {
+        HAL_Free(blob);
+        return -1;
+    }
+
+    p = blob;
+    end = blob + len;
+    do {
+        if (end - p < 2 || TLS_SESSION_KV_VERSION != p[0] || end - p < 2 + p[1] + 2 + 4 + 4 + 1 + 32 + 48 + 4 + 2) {
+            break;
+        }
+        if (p[1] != strlen(host) || 0 != memcmp(p + 2, host, p[1])) {
+            break;
+        }
+        p += 2 + p[1];
+        p = _TLSSession_get(p, &value, 2);
+        if (value != port) {
+            break;
+        }
+
+        mbedtls_ssl_session_init(session);
+        inited = 1;
+        p = _TLSSession_get(p, &value, 4);
+        session->ciphersuite = (int)value;
+        p = _TLSSession_get(p, &value, 4);
+        session->compression = (int)value;
+        p = _TLSSession_get(p, &value, 1);
+        session->id_len = value > 32 ? 32 : value;
+        memcpy(session->id, p, 32);
+        p += 32;
+        memcpy(session->master, p, 48);
+        p += 48;
+        p = _TLSSession_get(p, &value, 4);
+        session->verify_result = value;
+        p = _TLSSession_get(p, &ticket_len, 2);
+        if (ticket_len > TLS_SESSION_TICKET_MAXLEN || end - p < (int)ticket_len + 4 + 3) {
+            break;
+        }
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+        if (ticket_len > 0) {
+            session->ticket = mbedtls_calloc(1, ticket_len);
+            if (NULL == session->ticket) {
+                break;
+            }
+            memcpy(session->ticket, p, ticket_len);
+            session->ticket_len = ticket_len;
+        }
+#endif
+        p += ticket_len;
+        p = _TLSSession_get(p, &value, 4);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+        session->ticket_lifetime = value;
+#endif
+        p = _TLSSession_get(p, &value, 1);
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+        session->mfl_code = (unsigned char)value;
+#endif
+        p = _TLSSession_get(p, &value, 1);
+#if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
+        session->trunc_hmac = (int)value;
+#endif
+        p = _TLSSession_get(p, &value, 1);
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+        session->encrypt_then_mac = (int)value;
+#endif
+        ret = 0;
+    } while (0);
+
+    if (0 != ret && inited) {
+        mbedtls_ssl_session_free(session);
+    }
+    memset(blob, 0, TLS_SESSION_KV_MAXLEN);
+    HAL_Free(blob);
+
+    return ret;
+}
+#endif  /* SSL_SESSION_PERSIST_ENABLED */
+
+/* offer the cached session of host:port for an abbreviated handshake, 1 and its master secret when offered */
+static int _TLSSession_offer(mbedtls_ssl_context *ssl, const char *host, uint16_t port, unsigned char master[48])
+{
+    int offered = 0;
+    tls_session_entry_t *entry;
+
+    _TLSCache_lock();
+    entry = _TLSSession_find(host, port);
+#ifdef SSL_SESSION_PERSIST_ENABLED
+    if (NULL == entry && strlen(host) < TLS_SESSION_HOST_LEN) {
+        mbedtls_ssl_session session;
+
+        if (0 == _TLSSession_restore(host, port, &session)) {
+            _TLSSession_store(host, port, &session);
+            entry = _TLSSession_find(host, port);
+        }
+    }
+#endif
+    if (NULL != entry && 0 == mbedtls_ssl_set_session(ssl, &entry->session)) {
+        entry->used = ++_TLSSessionClock;
+        memcpy(master, entry->session.master, 48);
+        offered = 1;
+    }
+    _TLSCache_unlock();
+
+    return offered;
+}
+
+static void _TLSSession_save(mbedtls_ssl_context *ssl, const char *host, uint16_t port)
+{
+    mbedtls_ssl_session session;
+
+    if (strlen(host) >= TLS_SESSION_HOST_LEN) {
+        return;
+    }
+
+    mbedtls_ssl_session_init(&session);
+    if (0 != mbedtls_ssl_get_session(ssl, &session)) {
+        mbedtls_ssl_session_free(&session);
+        return;
+    }
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+    /* an abbreviated handshake never looks at the peer certificate again, do not keep it in RAM */
+    if (NULL != session.peer_cert) {
+        mbedtls_x509_crt_free(session.peer_cert);
+        mbedtls_free(session.peer_cert);
+        session.peer_cert = NULL;
+    }
+#endif
+
+    _TLSCache_lock();
+#ifdef SSL_SESSION_PERSIST_ENABLED
+    _TLSSession_persist(host, port, &session);
+#endif
+    _TLSSession_store(host, port, &session);
+    _TLSCache_unlock();
+}
+
+static void _TLSSession_drop(const char *host, uint16_t port)
+{
+    tls_session_entry_t *entry;
+
+    _TLSCache_lock();
+    entry = _TLSSession_find(host, port);
+    if (NULL != entry) {
+        _TLSSession_clear(entry);
+    }
+#ifdef SSL_SESSION_PERSIST_ENABLED
+    {
+        char key[TLS_SESSION_KV_KEY_LEN];
+
+        _TLSSession_kv_key(host, port, key);
+        HAL_Kv_Del(key);
+    }
+#endif
+    _TLSCache_unlock();
+}
+
+static uint32_t _TLSConfig_hash(const char *buf, size_t len)
+{
+    uint32_t hash = 2166136261u;    /* FNV-1a */
+
+    while (len-- > 0) {
+        hash = (hash ^ (unsigned char) * buf++) * 16777619u;
+    }
+    return hash;
+}
+
+#ifdef SSL_KTLS
+/* connection handshaking in this thread, the key export callback of a shared configuration is told no other */
+static __thread TLSDataParams_t *_ktls_handshaking;
+
+/* the key block of an AEAD suite, after the handshake mbedtls only keeps the expanded keys */
+static int _ktls_export_keys(void *p_expkey, const unsigned char *ms, const unsigned char *kb,
+                             size_t maclen, size_t keylen, size_t ivlen)
+{
+    TLSDataParams_t *pTlsData = _ktls_handshaking;
+
+    (void)p_expkey;
+    (void)ms;
+    if (NULL == pTlsData) {
+        return 0;
+    }
+
+    pTlsData->ktls_keylen = 0;
+    if (0 == maclen && (16 == keylen || 32 == keylen) && 4 == ivlen) {
+        memcpy(pTlsData->ktls_keys, kb, 2 * keylen + 2 * ivlen);
+        pTlsData->ktls_keylen = keylen;
+    }
+
+    return 0;
+}
+#endif  /* SSL_KTLS */
+
+static void _TLSConfig_free(TLSConfig_t *config)
+{
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+    mbedtls_x509_crt_free(&(config->cacertl));
+    mbedtls_x509_crt_free(&(config->clicert));
+    mbedtls_pk_free(&(config->pkey));
+#endif
+    mbedtls_ssl_config_free(&(config->conf));
+    HAL_Free(config);
+}
+
+static TLSConfig_t *_TLSConfig_create(const char *ca_crt, size_t ca_crt_len,
+                                      const char *client_crt, size_t client_crt_len,
+                                      const char *client_key, size_t client_key_len,
+                                      const char *client_pwd, size_t client_pwd_len)
+{
+    int ret;
+    TLSConfig_t *config;
+
+    config = HAL_Malloc(sizeof(TLSConfig_t));
+    if (NULL == config) {
+        return NULL;
+    }
+    memset(config, 0, sizeof(TLSConfig_t));
+    mbedtls_x509_crt_init(&(config->clicert));
+    mbedtls_pk_init(&(config->pkey));
+
+    if (0 != (ret = _ssl_client_init(&(config->conf),
+                                     &(config->cacertl), ca_crt, ca_crt_len,
+                                     &(config->clicert), client_crt, client_crt_len,
+                                     &(config->pkey), client_key, client_key_len, client_pwd, client_pwd_len))) {
+        SSL_LOG(" failed ! ssl_client_init returned -0x%04x", -ret);
+        _TLSConfig_free(config);
+        return NULL;
+    }
+
+    SSL_LOG("  . Setting up the SSL/TLS structure...");
+    if ((ret = mbedtls_ssl_config_defaults(&(config->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                           MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
+        SSL_LOG(" failed! mbedtls_ssl_config_defaults returned %d", ret);
+        _TLSConfig_free(config);
+        return NULL;
+    }
+
+    mbedtls_ssl_conf_max_version(&config->conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+    mbedtls_ssl_conf_min_version(&config->conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+
+    SSL_LOG(" ok");
+
+    /* OPTIONAL is not optimal for security, but makes interop easier in this simplified example */
+    if (ca_crt != NULL) {
+#if defined(FORCE_SSL_VERIFY)
+        mbedtls_ssl_conf_authmode(&(config->conf), MBEDTLS_SSL_VERIFY_REQUIRED);
+#else
+        mbedtls_ssl_conf_authmode(&(config->conf), MBEDTLS_SSL_VERIFY_OPTIONAL);
+#endif
+    } else {
+        mbedtls_ssl_conf_authmode(&(config->conf), MBEDTLS_SSL_VERIFY_NONE);
+    }
+
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+    mbedtls_ssl_conf_ca_chain(&(config->conf), &(config->cacertl), NULL);
+
+    if (client_crt != NULL && client_key != NULL
+        && (ret = mbedtls_ssl_conf_own_cert(&(config->conf), &(config->clicert), &(config->pkey))) != 0) {
+        SSL_LOG(" failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n", ret);
+        _TLSConfig_free(config);
+        return NULL;
+    }
+#endif
+    mbedtls_ssl_conf_session_tickets(&(config->conf), MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    if (MBEDTLS_SSL_MAX_FRAG_LEN_NONE != _ssl_mfl_code()
+        && (ret = mbedtls_ssl_conf_max_frag_len(&(config->conf), _ssl_mfl_code())) != 0) {
+        SSL_LOG(" failed! mbedtls_ssl_conf_max_frag_len returned %d", ret);
+        _TLSConfig_free(config);
+        return NULL;
+    }
+#endif
+#ifdef SSL_KTLS
+    mbedtls_ssl_conf_export_keys_cb(&(config->conf), _ktls_export_keys, NULL);
+#endif
+    mbedtls_ssl_conf_rng(&(config->conf), _ssl_random, NULL);
+    mbedtls_ssl_conf_dbg(&(config->conf), _ssl_debug, NULL);
+    /* mbedtls_ssl_conf_dbg( &(config->conf), _ssl_debug, stdout ); */
+
+    config->ca_crt = ca_crt;
+    config->ca_crt_len = ca_crt_len;
+    config->ca_crt_hash = (NULL == ca_crt) ? 0 : _TLSConfig_hash(ca_crt, ca_crt_len);
+    config->client_crt = client_crt;
+    config->client_key = client_key;
+
+    return config;
+}
+
+/* the configuration for these certificates, parsed by the first connection using them */
+static TLSConfig_t *_TLSConfig_get(const char *ca_crt, size_t ca_crt_len,
+                                   const char *client_crt, size_t client_crt_len,
+                                   const char *client_key, size_t client_key_len,
+                                   const char *client_pwd, size_t client_pwd_len)
+{
+    TLSConfig_t *config;
+    uint32_t hash = (NULL == ca_crt) ? 0 : _TLSConfig_hash(ca_crt, ca_crt_len);
+
+    _TLSCache_lock();
+    for (config = _TLSConfigList; NULL != config; config = config->next) {
+        /* the same buffer still holding the same certificate */
+        if (config->ca_crt == ca_crt && config->ca_crt_len == ca_crt_len && config->ca_crt_hash == hash
+            && config->client_crt == client_crt && config->client_key == client_key) {
+            config->refcount++;
+            break;
+        }
+    }
+    if (NULL == config) {
+        config = _TLSConfig_create(ca_crt, ca_crt_len, client_crt, client_crt_len,
+                                   client_key, client_key_len, client_pwd, client_pwd_len);
+        if (NULL != config) {
+            config->refcount = 1;
+            config->next = _TLSConfigList;
+            _TLSConfigList = config;
+        }
+    }
+    _TLSCache_unlock();
+
+    return config;
+}
+
+static void _TLSConfig_put(TLSConfig_t *config)
+{
+    TLSConfig_t **pp;
+
+    _TLSCache_lock();
+    if (--config->refcount > 0) {
+        config = NULL;
+    } else {
+        for (pp = &_TLSConfigList; NULL != *pp; pp = &(*pp)->next) {
+            if (*pp == config) {
+                *pp = config->next;
+                break;
+            }
+        }
+    }
+    _TLSCache_unlock();
+
+    if (NULL != config) {
+        _TLSConfig_free(config);
+    }
+}
+
+#ifdef HAL_NET_STATS_ENABLED
+/* a send or receive of ret, timeouts and would-block are no errors */
+static void _ssl_stats_count(hal_net_stats_t *stats, int is_recv, int ret)
+{
+    if (ret > 0) {
+        if (is_recv) {
+            stats->packets_recv++;
+            stats->bytes_recv += ret;
+        } else {
+            stats->packets_sent++;
+            stats->bytes_sent += ret;
+        }
+    } else if (ret < 0 && MBEDTLS_ERR_SSL_TIMEOUT != ret && MBEDTLS_ERR_SSL_WANT_READ != ret
+               && MBEDTLS_ERR_SSL_WANT_WRITE != ret) {
+        stats->errors++;
+    }
+}
+
+/* a call of the caller, ret as HAL_SSL_* return it, below 0 only for a closed or broken connection */
+static int _ssl_stats_app(TLSDataParams_t *pTlsData, int is_recv, int ret)
+{
+    hal_net_stats_t *app = &pTlsData->stats.app;
+
+    app->syscalls++;
+    if (ret > 0 && is_recv) {
+        app->packets_recv++;
+        app->bytes_recv += ret;
+    } else if (ret > 0) {
+        app->packets_sent++;
+        app->bytes_sent += ret;
+    } else if (ret < 0) {
+        app->errors++;
+    }
+
+    return ret;
+}
+
+int HAL_SSL_GetStats(uintptr_t handle, hal_ssl_stats_t *stats)
+{
+    if ((uintptr_t)NULL == handle || NULL == stats) {
+        return -1;
+    }
+
+    memcpy(stats, &((TLSDataParams_t *)handle)->stats, sizeof(hal_ssl_stats_t));
+    return 0;
+}
+#define SSL_STATS_APP(pTlsData, is_recv, ret)   _ssl_stats_app(pTlsData, is_recv, ret)
+#else
+#define SSL_STATS_APP(pTlsData, is_recv, ret)   (ret)
+#endif  /* HAL_NET_STATS_ENABLED */
+
+/* bio of a connection, the read timeout lives here while the configuration is shared */
+static int _ssl_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    TLSDataParams_t *pTlsData = (TLSDataParams_t *)ctx;
+    int ret;
+
+    ret = mbedtls_net_send(&(pTlsData->fd), buf, len);
+#ifdef HAL_NET_STATS_ENABLED
+    pTlsData->stats.net.syscalls++;
+    _ssl_stats_count(&pTlsData->stats.net, 0, ret);
+#endif
+
+    return ret;
+}
+
+static int _ssl_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    TLSDataParams_t *pTlsData = (TLSDataParams_t *)ctx;
+    int ret;
+#ifdef HAL_NET_STATS_ENABLED
+    uint64_t start = HAL_UptimeMs();
+#endif
+
+    if (!pTlsData->read_nonblock) {
+        ret = mbedtls_net_recv_timeout(&(pTlsData->fd), buf, len, pTlsData->read_timeout_ms);
+#ifdef HAL_NET_STATS_ENABLED
+        /* a select, and a recv unless it timed out */
+        pTlsData->stats.net.syscalls += (MBEDTLS_ERR_SSL_TIMEOUT == ret) ? 1 : 2;
+        pTlsData->stats.net.blocked_ms += (uint32_t)(HAL_UptimeMs() - start);
+        _ssl_stats_count(&pTlsData->stats.net, 1, ret);
+#endif
+        return ret;
+    }
+
+    /* only what already arrived, mbedtls keeps a partly received record till the next read */
+    mbedtls_net_set_nonblock(&(pTlsData->fd));
+    ret = mbedtls_net_recv(&(pTlsData->fd), buf, len);
+    mbedtls_net_set_block(&(pTlsData->fd));
+#ifdef HAL_NET_STATS_ENABLED
+    pTlsData->stats.net.syscalls++;
+    _ssl_stats_count(&pTlsData->stats.net, 1, ret);
+#endif
+
+    return ret;
+}
+
+#ifdef SSL_KTLS
+#define KTLS_TX                     (1)
+#define KTLS_RX                     (2)
+#define KTLS_RECORD_ALERT           (21)
+#define KTLS_IOV_MAX                (16)
+
+typedef union {
+    struct tls12_crypto_info_aes_gcm_128 gcm128;
+    struct tls12_crypto_info_aes_gcm_256 gcm256;
+} ktls_crypto_info_t;
+
+/* keys of one direction, its salt is the fixed iv and the explicit nonce goes on from the sequence number as in mbedtls */
+static socklen_t _ktls_crypto_info(TLSDataParams_t *pTlsData, int tx, ktls_crypto_info_t *info)
+{
+    size_t keylen = pTlsData->ktls_keylen;
+    const unsigned char *key = pTlsData->ktls_keys + (tx ? 0 : keylen);
+    const unsigned char *salt = pTlsData->ktls_keys + 2 * keylen + (tx ? 0 : 4);
+    const unsigned char *seq = tx ? pTlsData->ssl.out_ctr : pTlsData->ssl.in_ctr;
+
+    memset(info, 0, sizeof(ktls_crypto_info_t));
+    if (16 == keylen) {
+        info->gcm128.info.version = TLS_1_2_VERSION;
+        info->gcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(info->gcm128.key, key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+        memcpy(info->gcm128.salt, salt, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+        memcpy(info->gcm128.iv, seq, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+        memcpy(info->gcm128.rec_seq, seq, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+        return sizeof(info->gcm128);
+    }
+
+    info->gcm256.info.version = TLS_1_2_VERSION;
+    info->gcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+    memcpy(info->gcm256.key, key, TLS_CIPHER_AES_GCM_256_KEY_SIZE);
+    memcpy(info->gcm256.salt, salt, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+    memcpy(info->gcm256.iv, seq, TLS_CIPHER_AES_GCM_256_IV_SIZE);
+    memcpy(info->gcm256.rec_seq, seq, TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+    return sizeof(info->gcm256);
+}
+
+/*
+ * Hands the records of the connection over to the kernel once the handshake is done, reads and writes are then
+ * plain socket calls with no copy through the buffers of mbedtls. Only when mbedtls holds nothing read or to be
+ * written, and only for the AES-GCM suites of TLS 1.2. A direction the kernel refuses stays with mbedtls.
+ */
+static void _ktls_start(TLSDataParams_t *pTlsData)
+{
+    const mbedtls_ssl_ciphersuite_t *suite;
+    ktls_crypto_info_t info;
+    socklen_t info_len;
+
+    suite = mbedtls_ssl_ciphersuite_from_string(mbedtls_ssl_get_ciphersuite(&(pTlsData->ssl)));
+    if (0 == pTlsData->ktls_keylen || NULL == suite || MBEDTLS_SSL_MINOR_VERSION_3 != pTlsData->ssl.minor_ver
+        || (MBEDTLS_CIPHER_AES_128_GCM != suite->cipher && MBEDTLS_CIPHER_AES_256_GCM != suite->cipher)) {
+        SSL_LOG("ktls not for this connection, records stay with mbedtls");
+        goto done;
+    }
+    if (0 != pTlsData->ssl.in_left || 0 != mbedtls_ssl_get_bytes_avail(&(pTlsData->ssl))
+        || 0 != pTlsData->ssl.out_left) {
+        SSL_LOG("ktls not started, mbedtls holds records");
+        goto done;
+    }
+
+    if (0 != setsockopt(pTlsData->fd.fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"))) {
+        SSL_LOG("ktls not supported by the kernel, errno = %d", errno);
+        goto done;
+    }
+
+    info_len = _ktls_crypto_info(pTlsData, 1, &info);
+    if (0 == setsockopt(pTlsData->fd.fd, SOL_TLS, TLS_TX, &info, info_len)) {
+        pTlsData->ktls |= KTLS_TX;
+    }
+    info_len = _ktls_crypto_info(pTlsData, 0, &info);
+    if (0 == setsockopt(pTlsData->fd.fd, SOL_TLS, TLS_RX, &info, info_len)) {
+        pTlsData->ktls |= KTLS_RX;
+    }
+    memset(&info, 0, sizeof(info));
+    SSL_LOG("ktls tx %s, rx %s", (pTlsData->ktls & KTLS_TX) ? "on" : "off", (pTlsData->ktls & KTLS_RX) ? "on" : "off");
+
+done:
+    memset(pTlsData->ktls_keys, 0, sizeof(pTlsData->ktls_keys));
+    pTlsData->ktls_keylen = 0;
+}
+
+/*
+ * Data of the records the kernel opened, as _ssl_recv returns it, waiting up to the read timeout of the connection
+ * unless it only takes what already arrived. A close notify or any other alert ends the connection, a record of
+ * another type breaks it, the kernel hands over no more than one record a call.
+ */
+static int _ktls_recv(TLSDataParams_t *pTlsData, unsigned char *buf, size_t len)
+{
+    char cbuf[CMSG_SPACE(sizeof(unsigned char))];
+    uint64_t deadline = HAL_UptimeMs() + pTlsData->read_timeout_ms;
+    uint64_t now;
+    unsigned char type;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec vec;
+    struct pollfd pfd;
+    ssize_t ret;
+
+    for (;;) {
+        if (!pTlsData->read_nonblock) {
+            now = HAL_UptimeMs();
+            if (now >= deadline) {
+                return MBEDTLS_ERR_SSL_TIMEOUT;
+            }
+            pfd.fd = pTlsData->fd.fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            ret = poll(&pfd, 1, (int)(deadline - now));
+#ifdef HAL_NET_STATS_ENABLED
+            pTlsData->stats.net.syscalls++;
+            pTlsData->stats.net.blocked_ms += (uint32_t)(HAL_UptimeMs() - now);
+#endif
+            if (0 == ret || (ret < 0 && EINTR == errno)) {
+                continue;
+            } else if (ret < 0) {
+                return MBEDTLS_ERR_NET_RECV_FAILED;
+            }
+        }
+
+        vec.iov_base = buf;
+        vec.iov_len = len;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &vec;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cbuf;
+        msg.msg_controllen = sizeof(cbuf);
+        ret = recvmsg(pTlsData->fd.fd, &msg, MSG_DONTWAIT);
+#ifdef HAL_NET_STATS_ENABLED
+        pTlsData->stats.net.syscalls++;
+        _ssl_stats_count(&pTlsData->stats.net, 1, (ret >= 0) ? (int)ret : MBEDTLS_ERR_SSL_WANT_READ);
+#endif
+        if (ret > 0) {
+            break;
+        } else if (0 == ret) {
+            return MBEDTLS_ERR_SSL_CONN_EOF;
+        } else if (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno) {
+            SSL_LOG("ktls recv fail, errno = %d", errno);
+            return MBEDTLS_ERR_NET_RECV_FAILED;
+        } else if (pTlsData->read_nonblock) {
+            return MBEDTLS_ERR_SSL_WANT_READ;
+        }
+    }
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (NULL != cmsg && SOL_TLS == cmsg->cmsg_level && TLS_GET_RECORD_TYPE == cmsg->cmsg_type) {
+        type = *(unsigned char *)CMSG_DATA(cmsg);
+        if (KTLS_RECORD_ALERT == type) {
+            return MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY;
+        } else if (MBEDTLS_SSL_MSG_APPLICATION_DATA != type) {
+            SSL_LOG("ktls record of type %d not expected", type);
+            return MBEDTLS_ERR_SSL_UNEXPECTED_MESSAGE;
+        }
+    }
+
+    return (int)ret;
+}
+
+/* one sendmsg of pieces the kernel seals into records of its own, as _ssl_send returns it */
+static int _ktls_send(TLSDataParams_t *pTlsData, const hal_iovec_t *iov, uint32_t iovcnt, unsigned char type)
+{
+    char cbuf[CMSG_SPACE(sizeof(unsigned char))];
+    struct iovec vec[KTLS_IOV_MAX];
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    uint32_t idx;
+    ssize_t ret;
+
+    memset(&msg, 0, sizeof(msg));
+    for (idx = 0; idx < iovcnt && idx < KTLS_IOV_MAX; idx++) {
+        vec[idx].iov_base = (void *)iov[idx].buf;
+        vec[idx].iov_len = iov[idx].len;
+    }
+    msg.msg_iov = vec;
+    msg.msg_iovlen = idx;
+    if (MBEDTLS_SSL_MSG_APPLICATION_DATA != type) {
+        msg.msg_control = cbuf;
+        msg.msg_controllen = sizeof(cbuf);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_TLS;
+        cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+        *(unsigned char *)CMSG_DATA(cmsg) = type;
+    }
+
+    do {
+        ret = sendmsg(pTlsData->fd.fd, &msg, MSG_NOSIGNAL);
+    } while (ret < 0 && EINTR == errno);
+#ifdef HAL_NET_STATS_ENABLED
+    pTlsData->stats.net.syscalls++;
+    _ssl_stats_count(&pTlsData->stats.net, 0, (ret >= 0) ? (int)ret : -1);
+#endif
+    if (ret < 0) {
+        SSL_LOG("ktls send fail, errno = %d", errno);
+        return (EAGAIN == errno || EWOULDBLOCK == errno) ? 0 : -1;
+    }
+
+    return (int)ret;
+}
+
+/* pieces are given to the kernel as they are, it gathers them into records itself and no stage is needed */
+static int _ktls_writev(TLSDataParams_t *pTlsData, const hal_iovec_t *iov, uint32_t iovcnt)
+{
+    hal_iovec_t rest;
+    uint32_t idx = 0, sent, len_sent = 0;
+    int ret;
+
+    while (idx < iovcnt) {
+        if (0 == iov[idx].len) {
+            idx++;
+            continue;
+        }
+        ret = _ktls_send(pTlsData, iov + idx, iovcnt - idx, MBEDTLS_SSL_MSG_APPLICATION_DATA);
+        if (ret <= 0) {
+            return (0 == len_sent) ? ret : (int)len_sent;
+        }
+        len_sent += ret;
+
+        /* on after what was taken, a piece taken in part goes on from where it stopped */
+        for (sent = (uint32_t)ret; idx < iovcnt && sent >= iov[idx].len; idx++) {
+            sent -= iov[idx].len;
+        }
+        while (sent > 0) {
+            rest.buf = iov[idx].buf + sent;
+            rest.len = iov[idx].len - sent;
+            ret = _ktls_send(pTlsData, &rest, 1, MBEDTLS_SSL_MSG_APPLICATION_DATA);
+            if (ret <= 0) {
+                return len_sent;
+            }
+            len_sent += ret;
+            sent += ret;
+            if (sent == iov[idx].len) {
+                idx++;
+                sent = 0;
+            }
+        }
+    }
+
+    return len_sent;
+}
+#endif  /* SSL_KTLS */
+
 #if defined(_PLATFORM_IS_LINUX_)
 static int net_prepare(void)
 {
@@ -329,15 +1286,20 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
                               const char *client_pwd, size_t client_pwd_len)
 {
     int ret = -1;
+    int resume = 0;
+    uint16_t port_num = (uint16_t)atoi(port);
+    unsigned char master[48];
     /*
      * 0. Init
      */
-    if (0 != (ret = _ssl_client_init(&(pTlsData->ssl), &(pTlsData->fd), &(pTlsData->conf),
-                                     &(pTlsData->cacertl), ca_crt, ca_crt_len,
-                                     &(pTlsData->clicert), client_crt, client_crt_len,
-                                     &(pTlsData->pkey), client_key, client_key_len, client_pwd, client_pwd_len))) {
-        SSL_LOG(" failed ! ssl_client_init returned -0x%04x", -ret);
-        return ret;
+    mbedtls_net_init(&(pTlsData->fd));
+    mbedtls_ssl_init(&(pTlsData->ssl));
+
+    pTlsData->config = _TLSConfig_get(ca_crt, ca_crt_len, client_crt, client_crt_len,
+                                      client_key, client_key_len, client_pwd, client_pwd_len);
+    if (NULL == pTlsData->config) {
+        SSL_LOG(" failed ! no tls configuration");
+        return -1;
     }
 
     /*
@@ -361,59 +1323,38 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
     /*
      * 2. Setup stuff
      */
-    SSL_LOG("  . Setting up the SSL/TLS structure...");
-    if ((ret = mbedtls_ssl_config_defaults(&(pTlsData->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
-                                           MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
-        SSL_LOG(" failed! mbedtls_ssl_config_defaults returned %d", ret);
-        return ret;
-    }
-
-    mbedtls_ssl_conf_max_version(&pTlsData->conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
-    mbedtls_ssl_conf_min_version(&pTlsData->conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
-
-    SSL_LOG(" ok");
-
-    /* OPTIONAL is not optimal for security, but makes interop easier in this simplified example */
-    if (ca_crt != NULL) {
-#if defined(FORCE_SSL_VERIFY)
-        mbedtls_ssl_conf_authmode(&(pTlsData->conf), MBEDTLS_SSL_VERIFY_REQUIRED);
-#else
-        mbedtls_ssl_conf_authmode(&(pTlsData->conf), MBEDTLS_SSL_VERIFY_OPTIONAL);
-#endif
-    } else {
-        mbedtls_ssl_conf_authmode(&(pTlsData->conf), MBEDTLS_SSL_VERIFY_NONE);
-    }
-
-#if defined(MBEDTLS_X509_CRT_PARSE_C)
-    mbedtls_ssl_conf_ca_chain(&(pTlsData->conf), &(pTlsData->cacertl), NULL);
-
-    if ((ret = mbedtls_ssl_conf_own_cert(&(pTlsData->conf), &(pTlsData->clicert), &(pTlsData->pkey))) != 0) {
-        SSL_LOG(" failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n", ret);
-        return ret;
-    }
-#endif
-    mbedtls_ssl_conf_rng(&(pTlsData->conf), _ssl_random, NULL);
-    mbedtls_ssl_conf_dbg(&(pTlsData->conf), _ssl_debug, NULL);
-    /* mbedtls_ssl_conf_dbg( &(pTlsData->conf), _ssl_debug, stdout ); */
-
-    if ((ret = mbedtls_ssl_setup(&(pTlsData->ssl), &(pTlsData->conf))) != 0) {
+    if ((ret = mbedtls_ssl_setup(&(pTlsData->ssl), &(pTlsData->config->conf))) != 0) {
         SSL_LOG("failed! mbedtls_ssl_setup returned %d", ret);
         return ret;
     }
     mbedtls_ssl_set_hostname(&(pTlsData->ssl), addr);
-    mbedtls_ssl_set_bio(&(pTlsData->ssl), &(pTlsData->fd), mbedtls_net_send, mbedtls_net_recv, mbedtls_net_recv_timeout);
+    mbedtls_ssl_set_bio(&(pTlsData->ssl), pTlsData, _ssl_send, _ssl_recv, NULL);
+
+    /* an abbreviated handshake by ticket or session id skips the certificate exchange and verify,
+     * the server falls back to a full one when it refuses */
+    resume = _TLSSession_offer(&(pTlsData->ssl), addr, port_num, master);
 
     /*
       * 4. Handshake
       */
     SSL_LOG("Performing the SSL/TLS handshake...");
 
+#ifdef SSL_KTLS
+    _ktls_handshaking = pTlsData;
+#endif
     while ((ret = mbedtls_ssl_handshake(&(pTlsData->ssl))) != 0) {
         if ((ret != MBEDTLS_ERR_SSL_WANT_READ) && (ret != MBEDTLS_ERR_SSL_WANT_WRITE)) {
             SSL_LOG("failed  ! mbedtls_ssl_handshake returned -0x%04x", -ret);
+#ifdef SSL_KTLS
+            _ktls_handshaking = NULL;
+#endif
+            _TLSSession_drop(addr, port_num);
             return ret;
         }
     }
+#ifdef SSL_KTLS
+    _ktls_handshaking = NULL;
+#endif
     SSL_LOG(" ok");
     /*
      * 5. Verify the server certificate
@@ -421,8 +1362,19 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
     SSL_LOG("  . Verifying peer X.509 certificate..");
     if (0 != (ret = _real_confirm(mbedtls_ssl_get_verify_result(&(pTlsData->ssl))))) {
         SSL_LOG(" failed  ! verify result not confirmed.");
+        _TLSSession_drop(addr, port_num);
         return ret;
     }
+
+    /* a resumed session keeps the master secret of the one offered */
+    if (resume && NULL != pTlsData->ssl.session && 0 == memcmp(pTlsData->ssl.session->master, master, sizeof(master))) {
+        SSL_LOG("tls session resumed");
+    }
+    _TLSSession_save(&(pTlsData->ssl), addr, port_num);
+    memset(master, 0, sizeof(master));
+#ifdef SSL_KTLS
+    _ktls_start(pTlsData);
+#endif
     /* n->my_socket = (int)((n->tlsdataparams.fd).fd); */
     /* WRITE_IOT_DEBUG_LOG("my_socket=%d", n->my_socket); */
 
@@ -430,46 +1382,65 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
 
 }
 
+/*
+ * Reads till 'len' bytes or the deadline of this call, the time is not restarted for every record
+ * waited for. All state lives in the connection and mbedtls, so a read stopped early loses nothing
+ * and the next one goes on where it stopped. timeout_ms 0 returns what already arrived at once.
+ */
 static int _network_ssl_read(TLSDataParams_t *pTlsData, char *buffer, int len, int timeout_ms)
 {
     uint32_t        readLen = 0;
-    static int      net_status = 0;
+    uint64_t        deadline = HAL_UptimeMs() + timeout_ms;
+    uint64_t        now;
     int             ret = -1;
     char            err_str[33];
 
-    mbedtls_ssl_conf_read_timeout(&(pTlsData->conf), timeout_ms);
+    if (0 != pTlsData->net_status) {
+        return pTlsData->net_status;
+    }
+
+    pTlsData->read_nonblock = (0 == timeout_ms);
     while (readLen < len) {
-        ret = mbedtls_ssl_read(&(pTlsData->ssl), (unsigned char *)(buffer + readLen), (len - readLen));
+        if (!pTlsData->read_nonblock) {
+            now = HAL_UptimeMs();
+            if (now >= deadline) {
+                break;
+            }
+            pTlsData->read_timeout_ms = (uint32_t)(deadline - now);
+        }
+
+#ifdef SSL_KTLS
+        if (pTlsData->ktls & KTLS_RX) {
+            ret = _ktls_recv(pTlsData, (unsigned char *)(buffer + readLen), (len - readLen));
+        } else
+#endif
+            ret = mbedtls_ssl_read(&(pTlsData->ssl), (unsigned char *)(buffer + readLen), (len - readLen));
         if (ret > 0) {
             readLen += ret;
-            net_status = 0;
-        } else if (ret == 0) {
-            /* if ret is 0 and net_status is -2, indicate the connection is closed during last call */
-            return (net_status == -2) ? net_status : readLen;
+        } else if ((0 == ret)
+                   || (MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY == ret)
+                   || (MBEDTLS_ERR_SSL_CONN_EOF == ret)) {
+            mbedtls_strerror(ret, err_str, sizeof(err_str));
+            SSL_LOG("ssl recv error: code = %d, err_str = '%s'", ret, err_str);
+            pTlsData->net_status = -2; /* connection is closed */
+            break;
+        } else if ((MBEDTLS_ERR_SSL_TIMEOUT == ret)
+                   || (MBEDTLS_ERR_SSL_WANT_READ == ret)
+                   || (MBEDTLS_ERR_SSL_SESSION_TICKET_EXPIRED == ret)
+                   || (MBEDTLS_ERR_SSL_NON_FATAL == ret)) {
+            /* nothing more in time, what was read is returned */
+            break;
         } else {
-            if (MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY == ret) {
-                mbedtls_strerror(ret, err_str, sizeof(err_str));
-                SSL_LOG("ssl recv error: code = %d, err_str = '%s'", ret, err_str);
-                net_status = -2; /* connection is closed */
-                break;
-            } else if ((MBEDTLS_ERR_SSL_TIMEOUT == ret)
-                       || (MBEDTLS_ERR_SSL_CONN_EOF == ret)
-                       || (MBEDTLS_ERR_SSL_SESSION_TICKET_EXPIRED == ret)
-                       || (MBEDTLS_ERR_SSL_NON_FATAL == ret)) {
-                /* read already complete */
-                /* if call mbedtls_ssl_read again, it will return 0 (means EOF) */
-
-                return readLen;
-            } else {
-                mbedtls_strerror(ret, err_str, sizeof(err_str));
-                SSL_LOG("ssl recv error: code = %d, err_str = '%s'", ret, err_str);
-                net_status = -1;
-                return -1; /* Connection error */
-            }
+            mbedtls_strerror(ret, err_str, sizeof(err_str));
+            SSL_LOG("ssl recv error: code = %d, err_str = '%s'", ret, err_str);
+            pTlsData->net_status = -1;
+            break; /* Connection error */
         }
     }
 
-    return (readLen > 0) ? readLen : net_status;
+    pTlsData->read_nonblock = 0;
+
+    return (readLen > 0) ? (int)readLen : pTlsData->net_status;
 }
 
 static int _network_ssl_write(TLSDataParams_t *pTlsData, const char *buffer, int len, int timeout_ms)
@@ -478,7 +1449,16 @@ static int _network_ssl_write(TLSDataParams_t *pTlsData, const char *buffer, int
     int ret = -1;
 
     while (writtenLen < len) {
-        ret = mbedtls_ssl_write(&(pTlsData->ssl), (unsigned char *)(buffer + writtenLen), (len - writtenLen));
+#ifdef SSL_KTLS
+        if (pTlsData->ktls & KTLS_TX) {
+            hal_iovec_t vec;
+
+            vec.buf = buffer + writtenLen;
+            vec.len = len - writtenLen;
+            ret = _ktls_send(pTlsData, &vec, 1, MBEDTLS_SSL_MSG_APPLICATION_DATA);
+        } else
+#endif
+            ret = mbedtls_ssl_write(&(pTlsData->ssl), (unsigned char *)(buffer + writtenLen), (len - writtenLen));
         if (ret > 0) {
             writtenLen += ret;
             continue;
@@ -496,33 +1476,152 @@ static int _network_ssl_write(TLSDataParams_t *pTlsData, const char *buffer, int
     return writtenLen;
 }
 
-static void _network_ssl_disconnect(TLSDataParams_t *pTlsData)
+/* largest record this connection sends, gathered writes are staged up to it */
+static size_t _network_ssl_stage_len(TLSDataParams_t *pTlsData)
 {
-    mbedtls_ssl_close_notify(&(pTlsData->ssl));
-    mbedtls_net_free(&(pTlsData->fd));
-#if defined(MBEDTLS_X509_CRT_PARSE_C)
-    mbedtls_x509_crt_free(&(pTlsData->cacertl));
-    if ((pTlsData->pkey).pk_info != NULL) {
-        SSL_LOG("need release client crt&key");
-#if defined(MBEDTLS_CERTS_C)
-        mbedtls_x509_crt_free(&(pTlsData->clicert));
-        mbedtls_pk_free(&(pTlsData->pkey));
+    size_t len = MBEDTLS_SSL_MAX_CONTENT_LEN;
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    len = mbedtls_ssl_get_max_frag_len(&(pTlsData->ssl));
 #endif
+
+    return (len > SSL_WRITEV_COALESCE_LEN) ? SSL_WRITEV_COALESCE_LEN : len;
+}
+
+/*
+ * Pieces are copied into the stage till it holds a full record, which is then written at once,
+ * so an MQTT header and its payload or several small packets share records instead of one each.
+ * Data already as big as a record is written as it is.
+ */
+static int _network_ssl_writev(TLSDataParams_t *pTlsData, const hal_iovec_t *iov, uint32_t iovcnt, int timeout_ms)
+{
+    uint32_t idx, n, left, used = 0, len_sent = 0;
+    size_t stage_len;
+    const char *buf;
+    int ret;
+
+    /* nothing to gather, no copy */
+    if (1 == iovcnt) {
+        return _network_ssl_write(pTlsData, iov[0].buf, iov[0].len, timeout_ms);
+    }
+#ifdef SSL_KTLS
+    if (pTlsData->ktls & KTLS_TX) {
+        return _ktls_writev(pTlsData, iov, iovcnt);
     }
 #endif
+
+    stage_len = _network_ssl_stage_len(pTlsData);
+    if (NULL == pTlsData->stage) {
+        pTlsData->stage = mbedtls_calloc(1, stage_len);
+        if (NULL == pTlsData->stage) {
+            SSL_LOG("no memory to stage %u pieces, write them one by one", (unsigned int)iovcnt);
+            for (idx = 0; idx < iovcnt; idx++) {
+                if (0 == iov[idx].len) {
+                    continue;
+                }
+                ret = _network_ssl_write(pTlsData, iov[idx].buf, iov[idx].len, timeout_ms);
+                if (ret <= 0) {
+                    return (0 == len_sent) ? ret : (int)len_sent;
+                }
+                len_sent += ret;
+            }
+            return len_sent;
+        }
+    }
+
+    for (idx = 0; idx < iovcnt; idx++) {
+        buf = iov[idx].buf;
+        left = iov[idx].len;
+        while (left > 0) {
+            if (0 == used && left >= stage_len) {
+                /* whole records straight from the caller, a tail shorter than one is staged unless nothing follows */
+                n = (idx + 1 == iovcnt) ? left : left - (left % stage_len);
+                ret = _network_ssl_write(pTlsData, buf, n, timeout_ms);
+                if (ret <= 0) {
+                    return (0 == len_sent) ? ret : (int)len_sent;
+                }
+                len_sent += ret;
+            } else {
+                n = (left < stage_len - used) ? left : (uint32_t)(stage_len - used);
+                memcpy(pTlsData->stage + used, buf, n);
+                used += n;
+                if (used == stage_len) {
+                    ret = _network_ssl_write(pTlsData, (const char *)pTlsData->stage, used, timeout_ms);
+                    if (ret <= 0) {
+                        return (0 == len_sent) ? ret : (int)len_sent;
+                    }
+                    len_sent += used;
+                    used = 0;
+                }
+            }
+            buf += n;
+            left -= n;
+        }
+    }
+
+    if (0 != used) {
+        ret = _network_ssl_write(pTlsData, (const char *)pTlsData->stage, used, timeout_ms);
+        if (ret <= 0) {
+            return (0 == len_sent) ? ret : (int)len_sent;
+        }
+        len_sent += used;
+    }
+
+    return len_sent;
+}
+
+static void _network_ssl_disconnect(TLSDataParams_t *pTlsData)
+{
+#ifdef SSL_KTLS
+    /* the kernel seals the alert, mbedtls would send it as a record of its own inside one */
+    if (pTlsData->ktls & KTLS_TX) {
+        static const char close_notify[2] = { MBEDTLS_SSL_ALERT_LEVEL_WARNING, MBEDTLS_SSL_ALERT_MSG_CLOSE_NOTIFY };
+        hal_iovec_t vec;
+
+        vec.buf = close_notify;
+        vec.len = sizeof(close_notify);
+        _ktls_send(pTlsData, &vec, 1, KTLS_RECORD_ALERT);
+    } else
+#endif
+        mbedtls_ssl_close_notify(&(pTlsData->ssl));
+    mbedtls_net_free(&(pTlsData->fd));
     mbedtls_ssl_free(&(pTlsData->ssl));
-    mbedtls_ssl_config_free(&(pTlsData->conf));
+#ifdef SSL_KTLS
+    memset(pTlsData->ktls_keys, 0, sizeof(pTlsData->ktls_keys));
+    pTlsData->ktls = 0;
+#endif
+    if (NULL != pTlsData->stage) {
+        mbedtls_free(pTlsData->stage);
+        pTlsData->stage = NULL;
+    }
+    if (NULL != pTlsData->config) {
+        _TLSConfig_put(pTlsData->config);
+        pTlsData->config = NULL;
+    }
     SSL_LOG("ssl_disconnect");
 }
 
 int HAL_SSL_Read(uintptr_t handle, char *buf, int len, int timeout_ms)
 {
-    return _network_ssl_read((TLSDataParams_t *)handle, buf, len, timeout_ms);;
+    return SSL_STATS_APP((TLSDataParams_t *)handle, 1,
+                         _network_ssl_read((TLSDataParams_t *)handle, buf, len, timeout_ms));
+}
+
+int HAL_SSL_ReadNonblock(uintptr_t handle, char *buf, int len)
+{
+    return SSL_STATS_APP((TLSDataParams_t *)handle, 1, _network_ssl_read((TLSDataParams_t *)handle, buf, len, 0));
 }
 
 int HAL_SSL_Write(uintptr_t handle, const char *buf, int len, int timeout_ms)
 {
-    return _network_ssl_write((TLSDataParams_t *)handle, buf, len, timeout_ms);
+    return SSL_STATS_APP((TLSDataParams_t *)handle, 0,
+                         _network_ssl_write((TLSDataParams_t *)handle, buf, len, timeout_ms));
+}
+
+int HAL_SSL_Writev(uintptr_t handle, const hal_iovec_t *iov, uint32_t iovcnt, int timeout_ms)
+{
+    return SSL_STATS_APP((TLSDataParams_t *)handle, 0,
+                         _network_ssl_writev((TLSDataParams_t *)handle, iov, iovcnt, timeout_ms));
 }
 
 int32_t HAL_SSL_Destroy(uintptr_t handle)
@@ -545,6 +1644,10 @@ uintptr_t HAL_SSL_Establish(const char *host,
     char port_str[6];
     TLSDataParams_pt pTlsData;
 
+#ifdef SSL_MEMORY_POOL_ENABLED
+    _SSLPool_install();
+#endif
+
     pTlsData = HAL_Malloc(sizeof(TLSDataParams_t));
     if (NULL == pTlsData) {
         return (uintptr_t)NULL;
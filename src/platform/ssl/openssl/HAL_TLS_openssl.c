@@ -1,4 +1,5 @@
 
+#include <string.h>
 #include "iot_import.h"
 
 #include "openssl/crypto.h"
@@ -366,8 +367,67 @@ int HAL_SSL_Read(uintptr_t handle, char *buf, int len, int timeout_ms)
     return platform_ssl_recv((void *)(((struct ssl_info_st *)handle)->ssl), buf, len, timeout_ms);
 }
 
+int HAL_SSL_ReadNonblock(uintptr_t handle, char *buf, int len)
+{
+    SSL *ssl = (SSL *)(((struct ssl_info_st *)handle)->ssl);
+    int pending = SSL_pending(ssl);
+
+    /* decrypted already, no need to look at the socket */
+    if (pending > 0) {
+        return SSL_read(ssl, buf, (pending < len) ? pending : len);
+    }
+
+    return platform_ssl_recv(ssl, buf, len, 0);
+}
+
 int HAL_SSL_Write(uintptr_t handle, const char *buf, int len, int timeout_ms)
 {
     timeout_ms = timeout_ms;
     return platform_ssl_send((void *)(((struct ssl_info_st *)handle)->ssl), buf, len);
 }
+
+#define SSL_WRITEV_COALESCE_LEN (1024)
+
+/* pieces smaller than SSL_WRITEV_COALESCE_LEN are gathered on the stack, so they share one record */
+int HAL_SSL_Writev(uintptr_t handle, const hal_iovec_t *iov, uint32_t iovcnt, int timeout_ms)
+{
+    void *ssl = (void *)(((struct ssl_info_st *)handle)->ssl);
+    char stage[SSL_WRITEV_COALESCE_LEN];
+    uint32_t idx, used = 0, len_sent = 0;
+    int ret;
+
+    timeout_ms = timeout_ms;
+    for (idx = 0; idx < iovcnt; idx++) {
+        if (used + iov[idx].len <= sizeof(stage)) {
+            memcpy(stage + used, iov[idx].buf, iov[idx].len);
+            used += iov[idx].len;
+            continue;
+        }
+
+        if (0 != used) {
+            if ((ret = platform_ssl_send(ssl, stage, used)) < 0) {
+                return (0 == len_sent) ? ret : (int)len_sent;
+            }
+            len_sent += used;
+            used = 0;
+        }
+
+        if (iov[idx].len <= sizeof(stage)) {
+            memcpy(stage, iov[idx].buf, iov[idx].len);
+            used = iov[idx].len;
+        } else if ((ret = platform_ssl_send(ssl, iov[idx].buf, iov[idx].len)) < 0) {
+            return (0 == len_sent) ? ret : (int)len_sent;
+        } else {
+            len_sent += ret;
+        }
+    }
+
+    if (0 != used) {
+        if ((ret = platform_ssl_send(ssl, stage, used)) < 0) {
+            return (0 == len_sent) ? ret : (int)len_sent;
+        }
+        len_sent += used;
+    }
+
+    return len_sent;
+}
@@ -0,0 +1,178 @@
+#! /bin/bash
+
+# Builds every profile of PROFILES in its own temporary directory, records text/data/bss of
+# each module staged for the libraries and the heap peak of the workload of the profile, and compares
+# them to ${BASELINE}. Exits 1 when something grew, text/data/bss by a byte or the heap peak by more
+# than FOOTPRINT_HEAP_TOLERANCE percent. 'footprint.sh update' checks the report in as the baseline.
+#
+# TOP_DIR is the tree built, FOOTPRINT_PROFILES the names of the profiles to build if not all of them
+# (the others are then reported missing), FOOTPRINT_CFLAGS is added to CONFIG_ENV_CFLAGS of every profile. It
+# defaults to -Wno-error as PERF_CFLAGS of perfgate.sh does, and the baseline records the FOOTPRINT_CFLAGS it was
+# made with. The report and the build logs go to ${FOOTPRINT_DIR}, the profiles are built out of TOP_DIR, as the
+# make of TOP_DIR takes every iot.mk under it but its own OUTPUT_DIR for a module.
+
+TOP_DIR=${TOP_DIR:-$(cd $(dirname $0)/../.. && pwd)}
+FOOTPRINT_DIR=${FOOTPRINT_DIR:-${TOP_DIR}/output/footprint}
+FOOTPRINT_HEAP_TOLERANCE=${FOOTPRINT_HEAP_TOLERANCE:-5}
+FOOTPRINT_JOBS=${FOOTPRINT_JOBS:-$(nproc 2>/dev/null || echo 1)}
+FOOTPRINT_CFLAGS=${FOOTPRINT_CFLAGS--Wno-error}
+BASELINE=${TOP_DIR}/src/scripts/footprint.baseline
+REPORT=${FOOTPRINT_DIR}/footprint.txt
+
+# name | config of src/configs | overrides of make.settings | workload, run in the bin directory
+PROFILES=(
+    "ubuntu | config.ubuntu.x86 | | ./mqtt-bench qos1 1000"
+    "win7 | config.win7.mingw32 | |"
+    "mqtt | config.ubuntu.x86 \
+        | FEATURE_COAP_COMM_ENABLED=n FEATURE_HTTP_COMM_ENABLED=n FEATURE_OTA_ENABLED=n \
+          FEATURE_SUBDEVICE_ENABLED=n FEATURE_CMP_ENABLED=n FEATURE_DM_ENABLED=n FEATURE_SERVICE_OTA_ENABLED=n \
+        | ./mqtt-bench qos1 1000"
+    "coap | config.ubuntu.x86 \
+        | FEATURE_MQTT_COMM_ENABLED=n FEATURE_MQTT_DIRECT=n FEATURE_COAP_COMM_ENABLED=y FEATURE_HTTP_COMM_ENABLED=n \
+          FEATURE_OTA_ENABLED=n FEATURE_SUBDEVICE_ENABLED=n FEATURE_SUBDEVICE_CHANNEL= FEATURE_CMP_ENABLED=n \
+          FEATURE_DM_ENABLED=n FEATURE_SERVICE_OTA_ENABLED=n \
+        |"
+    "dm | config.ubuntu.x86 \
+        | FEATURE_COAP_COMM_ENABLED=n FEATURE_HTTP_COMM_ENABLED=n FEATURE_SUBDEVICE_ENABLED=n \
+          FEATURE_CMP_ENABLED=y FEATURE_DM_ENABLED=y FEATURE_SERVICE_OTA_ENABLED=n \
+        | ./linkkit-bench 50 200"
+)
+
+field()
+{
+    echo "$1" | cut -d'|' -f$2 | sed 's:^ *::g;s: *$::g;s:  *: :g'
+}
+
+# builds profile $1 of config $2 with the overrides $3, and appends what it measured to ${REPORT}
+build_profile()
+{
+    local NAME=$1 CONFIG=$2 OVERRIDES=$3 WORKLOAD=$4
+    local WORK=${FOOTPRINT_WORK}/${NAME}
+    local LOG=${FOOTPRINT_DIR}/${NAME}.build.log
+    local PREFIX OBJDIR SIZE PEAK
+
+    PREFIX=$(sed -n 's/^CROSS_PREFIX *:*= *//p' ${TOP_DIR}/src/configs/${CONFIG})
+    if ! which ${PREFIX}gcc > /dev/null 2>&1; then
+        echo "[${NAME}] SKIPPED, ${PREFIX}gcc NOT FOUND"
+        return 0
+    fi
+    SIZE=${PREFIX}size
+
+    # the config of the profile under its own name, for VENDOR and MODEL, sizes without --coverage
+    rm -rf ${WORK} && mkdir -p ${WORK}
+    cp ${TOP_DIR}/src/configs/${CONFIG} ${WORK}/${CONFIG}
+    printf "\nCONFIG_ENV_CFLAGS := \$(filter-out --coverage,\$(CONFIG_ENV_CFLAGS)) %s\n" \
+        "${FOOTPRINT_CFLAGS}" >> ${WORK}/${CONFIG}
+
+    echo "[${NAME}] BUILDING ${CONFIG} ${OVERRIDES}"
+    if ! make -C ${TOP_DIR} -j${FOOTPRINT_JOBS} \
+            DEFAULT_BLD=${WORK}/${CONFIG} \
+            CONFIG_TPL=${WORK}/.config \
+            OUTPUT_DIR=${WORK}/.O \
+            DIST_DIR=${WORK}/output \
+            ${OVERRIDES} > ${LOG} 2>&1; then
+        # what is measured is the libraries, samples of some profiles do not build
+        if [ ! -f ${WORK}/.O/usr/lib/libiot_sdk.a ]; then
+            echo "[${NAME}] BUILD FAILED, SEE ${LOG}"
+            return 1
+        fi
+        echo "[${NAME}] SOME PROGRAMS NOT BUILT, SEE ${LOG}"
+    fi
+
+    OBJDIR=$(ls -d ${WORK}/.O/lib*.objs 2>/dev/null | head -1)
+    for mod in $(cd ${OBJDIR} && find . -name "*.o" | xargs -n 1 dirname | sort -u | sed 's:^\./::'); do
+        ${SIZE} $(find ${OBJDIR}/${mod} -maxdepth 1 -name "*.o") | \
+            awk -v p=${NAME} -v m=${mod} 'NR > 1 { t += $1; d += $2; b += $3 }
+                                          END { printf("size %-8s %-24s %8d %8d %8d\n", p, m, t, d, b) }'
+    done >> ${REPORT}
+
+    if [ "${WORKLOAD}" != "" ]; then
+        # the workloads save the device they run as in the working directory, which is the bin
+        PEAK=$(cd ${WORK}/.O/usr/bin && ${WORKLOAD} 2>&1 | sed -n 's/^heap peak \([0-9]*\) bytes.*/\1/p')
+        if [ "${PEAK}" = "" ]; then
+            echo "[${NAME}] '${WORKLOAD}' REPORTED NO HEAP PEAK"
+            return 1
+        fi
+        printf "heap %-8s %-24s %8d\n" ${NAME} "$(echo ${WORKLOAD} | sed 's:^\./::;s: :_:g')" ${PEAK} >> ${REPORT}
+    fi
+
+    rm -rf ${WORK}
+    return 0
+}
+
+mkdir -p ${FOOTPRINT_DIR}
+rm -f ${REPORT}
+# the profiles were built in ${FOOTPRINT_DIR} before, what a run left there would be modules of every build
+for profile in "${PROFILES[@]}"; do
+    rm -rf ${FOOTPRINT_DIR}/$(field "${profile}" 1)
+done
+FOOTPRINT_WORK=$(mktemp -d ${TMPDIR:-/tmp}/footprint.XXXXXX) || exit 1
+trap 'rm -rf ${FOOTPRINT_WORK}' EXIT
+unset MAKEFLAGS MAKELEVEL MFLAGS
+
+FAILED=0
+for profile in "${PROFILES[@]}"; do
+    if [ "${FOOTPRINT_PROFILES}" != "" ] && ! echo " ${FOOTPRINT_PROFILES} " | grep -q " $(field "${profile}" 1) "; then
+        continue
+    fi
+    build_profile "$(field "${profile}" 1)" "$(field "${profile}" 2)" \
+                  "$(field "${profile}" 3)" "$(field "${profile}" 4)" || FAILED=1
+done
+
+if [ "$1" = "update" ]; then
+    ( \
+        echo "# text/data/bss of each module and heap peaks in bytes, by 'make footprint UPDATE=1'" && \
+        echo "# $(gcc --version | head -1)" && \
+        echo "# FOOTPRINT_CFLAGS=${FOOTPRINT_CFLAGS}" && \
+        cat ${REPORT} \
+    ) > ${BASELINE}
+    echo "BASELINE ${BASELINE} UPDATED"
+    exit ${FAILED}
+fi
+
+echo ""
+# a baseline of other flags is compared all the same, its sizes may not be reproduced
+if [ -f ${BASELINE} ] && ! grep -qxF "# FOOTPRINT_CFLAGS=${FOOTPRINT_CFLAGS}" ${BASELINE}; then
+    RECORDED=$(grep '^# FOOTPRINT_CFLAGS=' ${BASELINE} | cut -c3-)
+    echo "NOTE: BASELINE MADE WITH ${RECORDED:-NO FOOTPRINT_CFLAGS RECORDED}, NOW FOOTPRINT_CFLAGS=${FOOTPRINT_CFLAGS}"
+fi
+printf "     %-8s %-24s %22s %22s %22s\n" "PROFILE" "MODULE" "TEXT" "DATA" "BSS / HEAP PEAK"
+awk -v tol=${FOOTPRINT_HEAP_TOLERANCE} '
+    function delta(old, new) {
+        return sprintf("%8d %+7d %5s", new, new - old, old ? sprintf("%+.1f%%", (new - old) * 100 / old) : "")
+    }
+    /^#/ { next }
+    FILENAME == ARGV[1] { base[$1 " " $2 " " $3] = $0; next }
+    {
+        key = $1 " " $2 " " $3
+        split(key in base ? base[key] : "", b, " ")
+        seen[key] = 1
+        if ($1 == "size") {
+            grew = $4 > b[4] || $5 > b[5] || $6 > b[6]
+            line = sprintf("%-8s %-24s %s %s %s", $2, $3, delta(b[4], $4), delta(b[5], $5), delta(b[6], $6))
+        } else {
+            grew = b[4] && $4 > b[4] * (100 + tol) / 100
+            line = sprintf("%-8s %-24s %22s %22s %s", $2, $3, "", "", delta(b[4], $4))
+        }
+        if (!(key in base)) {
+            printf("  +  %s\n", line)
+        } else {
+            printf("  %s  %s\n", grew ? "!" : " ", line)
+            regressed += grew
+        }
+    }
+    END {
+        for (key in base) {
+            if (!(key in seen)) {
+                split(key, k, " ")
+                printf("  -  %-8s %-24s\n", k[2], k[3])
+            }
+        }
+        exit regressed ? 1 : 0
+    }' $([ -f ${BASELINE} ] && echo ${BASELINE} || echo /dev/null) ${REPORT} || FAILED=1
+
+echo ""
+if [ "${FAILED}" != "0" ]; then
+    echo "FOOTPRINT REGRESSED OR NOT MEASURED ('!' ABOVE OR BUILD MESSAGES), REPORT IN ${REPORT}"
+fi
+exit ${FAILED}
@@ -0,0 +1,106 @@
+#! /usr/bin/env python3
+#
+# Makes a patch of a running firmware image to a new one, in the format of src/fota/service_ota_delta.h.
+# The patch is uploaded to the OTA console instead of the new image:
+#
+#   fota_delta.py <old image> <new image> <patch>
+#
+
+import hashlib
+import struct
+import sys
+
+MAGIC = b'IOTXDF01'
+BLOCK = 16          # bytes of the new image looked up in the old one, for where a copy of them starts
+MISS_RUN = 32       # bytes unlike the old ones before another place in the old image is looked for
+
+
+def index_of(old):
+    index = {}
+    for i in range(len(old) - BLOCK + 1):
+        index.setdefault(old[i:i + BLOCK], i)
+    return index
+
+
+# the runs of the new image made from the old one, as (new start, new end, old start)
+def regions_of(old, new):
+    index = index_of(old)
+    regions = []
+    start = shift = None
+    miss = 0
+    i = 0
+    while i < len(new):
+        if shift is not None and 0 <= i + shift < len(old):
+            miss = 0 if new[i] == old[i + shift] else miss + 1
+            if miss < MISS_RUN:
+                i += 1
+                continue
+            regions.append((start, i - miss + 1, start + shift))
+            shift = None
+            i = i - miss + 1
+            continue
+        if shift is not None:
+            regions.append((start, i, start + shift))
+            shift = None
+        found = index.get(new[i:i + BLOCK])
+        if found is None:
+            i += 1
+            continue
+        start, shift, miss = i, found - i, 0
+    if shift is not None:
+        regions.append((start, len(new), start + shift))
+    return regions
+
+
+def diff_of(old, new):
+    add = bytes((n - o) & 0xff for n, o in zip(new, old))
+    out = bytearray()
+    i = 0
+    while i < len(add):
+        j = i
+        while j < len(add) and j - i < 128 and add[j] == 0:
+            j += 1
+        if j - i >= 2 or j == len(add):
+            out.append(0x80 | (j - i - 1))
+            i = j
+            continue
+        j = i
+        while j < len(add) and j - i < 128 and not (add[j] == 0 and j + 1 < len(add) and add[j + 1] == 0):
+            j += 1
+        out.append(j - i - 1)
+        out += add[i:j]
+        i = j
+    return bytes(out)
+
+
+def patch_of(old, new):
+    out = bytearray(MAGIC)
+    out += struct.pack('<II', len(old), len(new))
+    out += hashlib.md5(old).digest() + hashlib.md5(new).digest()
+
+    regions = regions_of(old, new)
+    # a first record copying what comes before the first region
+    records = [(0, 0, 0)] + regions
+    for k, (start, end, old_start) in enumerate(records):
+        extra_end = regions[k][0] if k < len(regions) else len(new)
+        old_next = regions[k][2] if k < len(regions) else old_start + end - start
+        out += struct.pack('<IIi', end - start, extra_end - end, old_next - (old_start + end - start))
+        out += diff_of(old[old_start:old_start + end - start], new[start:end])
+        out += new[end:extra_end]
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.stderr.write('usage: %s <old image> <new image> <patch>\n' % sys.argv[0])
+        return 1
+    old = open(sys.argv[1], 'rb').read()
+    new = open(sys.argv[2], 'rb').read()
+    patch = patch_of(old, new)
+    open(sys.argv[3], 'wb').write(patch)
+    print('%d bytes, %d%% of the new image' % (len(patch), len(patch) * 100 // max(len(new), 1)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -17,11 +17,49 @@ SWITCH_VARS := \
     FEATURE_SUBDEVICE_ENABLED \
     FEATURE_CLOUD_CONN_ENABLED \
     FEATURE_CMP_ENABLED \
+    FEATURE_CMP_SUPPORT_MULTI_THREAD \
     FEATURE_DM_ENABLED \
+    FEATURE_DEVICEINFO_ENABLED \
+    FEATURE_RRPC_ENABLED \
     FEATURE_SERVICE_OTA_ENABLED \
     FEATURE_SERVICE_COTA_ENABLED \
     FEATURE_SUPPORT_PRODUCT_SECRET \
     FEATURE_MQTT_DIRECT_NOITLS \
+    FEATURE_DM_THING_ARENA_ENABLED \
+    FEATURE_DM_THING_COMPACT_VALUE_ENABLED \
+    FEATURE_DM_REPORT_POLICY_ENABLED \
+    FEATURE_DM_OFFLINE_ENABLED \
+    FEATURE_DM_UPLINK_PRIORITY_ENABLED \
+    FEATURE_DM_BACKPRESSURE_ENABLED \
+    FEATURE_LINKKIT_DISPATCH_WORKER_ENABLED \
+    FEATURE_COAP_BATCH_RECV_ENABLED \
+    FEATURE_COAP_BATCH_SEND_ENABLED \
+    FEATURE_COAP_GROUP_ENABLED \
+    FEATURE_HAL_EVENT_ENABLED \
+    FEATURE_SSL_SESSION_PERSIST_ENABLED \
+    FEATURE_SSL_MEMORY_POOL_ENABLED \
+    FEATURE_SSL_KTLS_ENABLED \
+    FEATURE_SSL_MAX_FRAGMENT_LENGTH_ENABLED \
+    FEATURE_HAL_CRYPTO_ENABLED \
+    FEATURE_HAL_CRYPTO_AES_ENABLED \
+    FEATURE_MQTT_ASYNC_PUBLISH_ENABLED \
+    FEATURE_NET_WRITE_BATCH_ENABLED \
+    FEATURE_MQTT_STREAM_ENABLED \
+    FEATURE_MQTT_STORE_ENABLED \
+    FEATURE_MQTT5_ENABLED \
+    FEATURE_NET_RECONNECT_BACKOFF_ENABLED \
+    FEATURE_MQTT_IO_THREAD_ENABLED \
+    FEATURE_HTTP_CONN_POOL_ENABLED \
+    FEATURE_HAL_NET_STATS_ENABLED \
+    FEATURE_PAYLOAD_COMPRESS_ENABLED \
+    FEATURE_TSL_CACHE_ENABLED \
+    FEATURE_RAW_DATA_DIRECT_ENABLED \
+    FEATURE_REGION_AUTO_ENABLED \
+    FEATURE_LOCAL_CONTROL_ENABLED \
+    FEATURE_DM_CHANNELS_ENABLED \
+    FEATURE_DM_MESSAGE_INFO_STATIC \
+    FEATURE_DM_STATIC_THING_ENABLED \
+    FEATURE_OTA_CACHE_ENABLED \
 
 $(foreach v, \
     $(SWITCH_VARS), \
@@ -54,6 +92,26 @@ endif # COAP
 endif # MQTT
 endif # OTA Enabled
 
+ifeq (y,$(strip $(FEATURE_SSL_KTLS_ENABLED)))
+CFLAGS += -DMBEDTLS_SSL_EXPORT_KEYS
+endif # FEATURE_SSL_KTLS_ENABLED
+
+ifeq (y,$(strip $(FEATURE_SSL_MAX_FRAGMENT_LENGTH_ENABLED)))
+FEATURE_SSL_MAX_CONTENT_LEN ?= 4096
+CFLAGS += -DMBEDTLS_SSL_MAX_FRAGMENT_LENGTH -DMBEDTLS_SSL_MAX_CONTENT_LEN=$(strip $(FEATURE_SSL_MAX_CONTENT_LEN))
+endif # FEATURE_SSL_MAX_FRAGMENT_LENGTH_ENABLED
+
+ifeq (y,$(strip $(FEATURE_HAL_CRYPTO_ENABLED)))
+CFLAGS += -DMBEDTLS_SHA1_PROCESS_ALT -DMBEDTLS_SHA256_PROCESS_ALT
+ifeq (y,$(strip $(FEATURE_HAL_CRYPTO_AES_ENABLED)))
+CFLAGS += -DMBEDTLS_AES_SETKEY_DEC_ALT -DMBEDTLS_AES_ENCRYPT_ALT -DMBEDTLS_AES_DECRYPT_ALT
+endif # FEATURE_HAL_CRYPTO_AES_ENABLED
+else
+ifeq (y,$(strip $(FEATURE_HAL_CRYPTO_AES_ENABLED)))
+$(error FEATURE_HAL_CRYPTO_AES_ENABLED = y requires FEATURE_HAL_CRYPTO_ENABLED = y!)
+endif
+endif # FEATURE_HAL_CRYPTO_ENABLED
+
 ifeq (y,$(strip $(FEATURE_SUBDEVICE_ENABLED)))
 ifneq (y,$(strip $(FEATURE_MQTT_COMM_ENABLED)))
 $(error FEATURE_SUBDEVICE_ENABLED = y requires FEATURE_MQTT_COMM_ENABLED = y!)
@@ -219,6 +277,50 @@ ifeq (y,$(strip $(FEATURE_DM_ENABLED)))
     endif
 endif
 
+ifeq (y,$(strip $(FEATURE_DM_REPORT_POLICY_ENABLED)))
+    ifneq (y,$(strip $(FEATURE_DM_ENABLED)))
+    $(error FEATURE_DM_REPORT_POLICY_ENABLED = y requires FEATURE_DM_ENABLED = y!)
+    endif
+endif
+ifeq (y,$(strip $(FEATURE_DM_OFFLINE_ENABLED)))
+    ifneq (y,$(strip $(FEATURE_DM_ENABLED)))
+    $(error FEATURE_DM_OFFLINE_ENABLED = y requires FEATURE_DM_ENABLED = y!)
+    endif
+endif
+ifeq (y,$(strip $(FEATURE_DM_UPLINK_PRIORITY_ENABLED)))
+    ifneq (y,$(strip $(FEATURE_DM_ENABLED)))
+    $(error FEATURE_DM_UPLINK_PRIORITY_ENABLED = y requires FEATURE_DM_ENABLED = y!)
+    endif
+endif
+ifeq (y,$(strip $(FEATURE_DM_BACKPRESSURE_ENABLED)))
+    ifneq (y,$(strip $(FEATURE_DM_ENABLED)))
+    $(error FEATURE_DM_BACKPRESSURE_ENABLED = y requires FEATURE_DM_ENABLED = y!)
+    endif
+endif
+ifeq (y,$(strip $(FEATURE_DM_STATIC_THING_ENABLED)))
+    ifneq (y,$(strip $(FEATURE_DM_ENABLED)))
+    $(error FEATURE_DM_STATIC_THING_ENABLED = y requires FEATURE_DM_ENABLED = y!)
+    endif
+endif
+
+ifeq (y,$(strip $(FEATURE_LOCAL_CONTROL_ENABLED)))
+    ifneq (y,$(strip $(FEATURE_DM_ENABLED)))
+    $(error FEATURE_LOCAL_CONTROL_ENABLED = y requires FEATURE_DM_ENABLED = y!)
+    endif
+    ifeq (y,$(strip $(FEATURE_CMP_SUPPORT_MULTI_THREAD)))
+    $(error FEATURE_LOCAL_CONTROL_ENABLED = y requires FEATURE_CMP_SUPPORT_MULTI_THREAD = n!)
+    endif
+endif
+
+ifeq (y,$(strip $(FEATURE_DM_CHANNELS_ENABLED)))
+    ifneq (y,$(strip $(FEATURE_DM_ENABLED)))
+    $(error FEATURE_DM_CHANNELS_ENABLED = y requires FEATURE_DM_ENABLED = y!)
+    endif
+    ifeq (y,$(strip $(FEATURE_CMP_SUPPORT_MULTI_THREAD)))
+    $(error FEATURE_DM_CHANNELS_ENABLED = y requires FEATURE_CMP_SUPPORT_MULTI_THREAD = n!)
+    endif
+endif
+
 ifeq (y,$(strip $(FEATURE_SERVICE_OTA_ENABLED)))    
     ifneq (y,$(strip $(FEATURE_CMP_ENABLED)))
     $(error FEATURE_SERVICE_OTA_ENABLED = y requires FEATURE_CMP_ENABLED = y!)
@@ -233,6 +335,12 @@ ifeq (y,$(strip $(FEATURE_SERVICE_OTA_ENABLED)))
 endif
 endif
 
+ifeq (y,$(strip $(FEATURE_OTA_CACHE_ENABLED)))
+    ifneq (y,$(strip $(FEATURE_SERVICE_OTA_ENABLED)))
+    $(error FEATURE_OTA_CACHE_ENABLED = y requires FEATURE_SERVICE_OTA_ENABLED = y!)
+    endif
+endif
+
 ifeq (y,$(strip $(FEATURE_SUPPORT_PRODUCT_SECRET)))
     CFLAGS  += -DSUPPORT_PRODUCT_SECRET
 endif
@@ -241,4 +349,19 @@ SUBDIRS += src/tls
 SUBDIRS += src/platform
 SUBDIRS += sample
 SUBDIRS += src/sdk-tests
+SUBDIRS += src/sdk-tests/sdk-benchmarks
+SUBDIRS += src/sdk-tests/digest-bench
+SUBDIRS += src/sdk-tests/id2-bench
+SUBDIRS += src/sdk-tests/lz-bench
+ifeq (y,$(strip $(FEATURE_SUBDEVICE_ENABLED)))
+SUBDIRS += src/sdk-tests/subdev-bench
+endif
+SUBDIRS += src/sdk-tests/mqtt-bench
+ifeq (y,$(strip $(FEATURE_COAP_COMM_ENABLED)))
+SUBDIRS += src/sdk-tests/coap-bench
+endif
+ifeq (y,$(strip $(FEATURE_DM_ENABLED)))
+SUBDIRS += src/sdk-tests/linkkit-bench
+SUBDIRS += src/sdk-tests/startup-bench
+endif
 
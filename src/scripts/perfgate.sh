@@ -0,0 +1,269 @@
+#! /bin/bash
+
+# Builds every profile of BUILDS in its own directory of ${PERF_DIR} and runs each workload of WORKLOADS on it
+# PERF_RUNS times, in its bin directory. The median of each metric of a workload and the spread of its runs,
+# (max - min) / median in percent, go to ${REPORT} and are compared to ${BASELINE}. A metric regressed when it
+# is worse than the baseline median by more than PERF_TOLERANCE percent, PERF_HEAP_TOLERANCE for heap peaks,
+# plus the spreads of the baseline and of this run, so a noisy metric has to move further. Exits 1 when
+# something regressed, after the stats_static_lib.sh lines of the modules each regressed workload exercises.
+# 'perfgate.sh update' checks the report in as the baseline, it only compares on the machine it was made on.
+#
+# The objects and programs of a build are kept in a temporary directory, its logs and runs in ${PERF_DIR}.
+#
+# TOP_DIR is the tree built, PERF_WORKLOADS the names of the workloads to run if not all of them (the others
+# are then reported missing), PERF_CFLAGS is added to CONFIG_ENV_CFLAGS of every build, as FOOTPRINT_CFLAGS is.
+# It defaults to -Wno-error, gcc 11 and later warn of mbedtls and of the HAL in ways -Werror of config.ubuntu.x86
+# fails the build on. The baseline records the PERF_CFLAGS it was made with.
+
+TOP_DIR=${TOP_DIR:-$(cd $(dirname $0)/../.. && pwd)}
+PERF_DIR=${PERF_DIR:-${TOP_DIR}/output/perfgate}
+PERF_RUNS=${PERF_RUNS:-3}
+PERF_TOLERANCE=${PERF_TOLERANCE:-10}
+PERF_HEAP_TOLERANCE=${PERF_HEAP_TOLERANCE:-5}
+PERF_JOBS=${PERF_JOBS:-$(nproc 2>/dev/null || echo 1)}
+BASELINE=${TOP_DIR}/src/scripts/perfgate.baseline
+PERF_CFLAGS=${PERF_CFLAGS--Wno-error}
+REPORT=${PERF_DIR}/perfgate.txt
+
+# name | config of src/configs | overrides of make.settings, CoAP on beside MQTT as the CoAP only profile
+# of footprint.sh builds no programs past the samples
+BUILDS=(
+    "bench | config.ubuntu.x86 | FEATURE_COAP_COMM_ENABLED=y"
+)
+
+# name | build | modules of stats_static_lib.sh it exercises | parser | command, run in the bin directory
+WORKLOADS=(
+    "json_parser | bench  | utils       | parse_cut     | ./sdk-benchmarks json_parser"
+    "json_token  | bench  | utils       | parse_cut     | ./sdk-benchmarks json_token"
+    "cjson       | bench  | dm          | parse_cut     | ./sdk-benchmarks json_cjson"
+    "dm          | bench  | dm cmp      | parse_linkkit | ./linkkit-bench 50 200"
+    "mqtt_qos0   | bench  | mqtt utils  | parse_mqtt    | ./mqtt-bench qos0 5000"
+    "mqtt_qos1   | bench  | mqtt utils  | parse_mqtt    | ./mqtt-bench qos1 1000"
+    "ota_digest  | bench  | utils       | parse_digest  | ./digest-bench 16"
+    "coap_clean  | bench  | coap        | parse_coap    | ./coap-bench clean 500"
+    "coap_loss   | bench  | coap        | parse_coap    | ./coap-bench loss 500"
+)
+
+field()
+{
+    echo "$1" | cut -d'|' -f$2 | sed 's:^ *::g;s: *$::g;s:  *: :g'
+}
+
+# the parsers turn the output of a workload into 'metric higher|lower|heap value' lines, heap is lower too
+
+# a JSON line of cut_bench_main() per benchmark
+parse_cut()
+{
+    sed -n 's/^{"suite":"\([^"]*\)","bench":"\([^"]*\)".*"median_ns":\([0-9]*\).*"peak_bytes":\([0-9]*\)}.*/\1.\2_ns lower \3\n\1.\2_peak heap \4/p'
+}
+
+parse_linkkit()
+{
+    awk '$NF == "bytes" && $1 == "heap" { print "heap_peak heap " $3; next }
+         {
+             for (i = 2; i <= NF && $i != "ok"; i++);
+             if (i > NF || $(i + 2) != "lost") next
+             name = $1
+             for (j = 2; j < i - 1; j++) name = name "_" $j
+             for (j = i; j < NF; j++) {
+                 if ($j == "p50" || $j == "p99") print name "_" $j "_ms lower " $(j + 1)
+             }
+         }'
+}
+
+parse_mqtt()
+{
+    awk '$3 == "ok" && $7 == "ops/s" { print $1 "_ops_per_s higher " $6 }
+         $1 == "heap" && $2 == "peak" { print "heap_peak heap " $3 }'
+}
+
+parse_digest()
+{
+    awk '$3 == "MB/s" { print $1 "_mb_per_s higher " $2 }'
+}
+
+# a row per setting of the profile: its ACKms, WIN and MODE, KB/s goodput and PEAKKB held in the send list
+parse_coap()
+{
+    awk '($4 == "cocoa" || $4 == "fixed") && NF == 17 {
+             name = $1 "_ack" $2 "_w" $3 "_" $4
+             print name "_kb_per_s higher " $8
+             print name "_list_peak_kb heap " $14
+         }'
+}
+
+# builds $1 of config $2 with the overrides $3 and runs the workloads of it, appends what they measured to ${REPORT}
+build_profile()
+{
+    local NAME=$1 CONFIG=$2 OVERRIDES=$3
+    local WORK=${PERF_DIR}/${NAME}
+    local BLD=${PERF_BLD}/${NAME}
+    local OBJDIR workload WNAME PARSER COMMAND RUN FAILED=0
+
+    # the config of the build under its own name, optimized as shipped and without --coverage
+    rm -rf ${WORK} && mkdir -p ${WORK}
+    cp ${TOP_DIR}/src/configs/${CONFIG} ${WORK}/${CONFIG}
+    printf "\nCONFIG_ENV_CFLAGS := \$(filter-out --coverage,\$(CONFIG_ENV_CFLAGS)) %s\n" \
+        "${PERF_CFLAGS}" >> ${WORK}/${CONFIG}
+
+    echo "[${NAME}] BUILDING ${CONFIG} ${OVERRIDES}"
+    if ! make -C ${TOP_DIR} -j${PERF_JOBS} \
+            DEFAULT_BLD=${WORK}/${CONFIG} \
+            CONFIG_TPL=${WORK}/.config \
+            OUTPUT_DIR=${BLD}/.O \
+            DIST_DIR=${BLD}/output \
+            ${OVERRIDES} > ${WORK}/build.log 2>&1; then
+        if [ ! -f ${BLD}/.O/usr/lib/libiot_sdk.a ]; then
+            echo "[${NAME}] BUILD FAILED, SEE ${WORK}/build.log"
+            return 1
+        fi
+        echo "[${NAME}] SOME PROGRAMS NOT BUILT, SEE ${WORK}/build.log"
+    fi
+
+    # kept for the modules of a regression, the objects are gone with .O
+    OBJDIR=$(ls -d ${BLD}/.O/lib*.objs 2>/dev/null | head -1)
+    STAGED=${OBJDIR} STRIP=strip bash ${TOP_DIR}/src/scripts/stats_static_lib.sh \
+        ${BLD}/.O/usr/lib/libiot_sdk.a > ${WORK}/stats.txt 2>&1
+
+    for workload in "${WORKLOADS[@]}"; do
+        WNAME=$(field "${workload}" 1)
+        if [ "$(field "${workload}" 2)" != "${NAME}" ] || \
+           ([ "${PERF_WORKLOADS}" != "" ] && ! echo " ${PERF_WORKLOADS} " | grep -q " ${WNAME} "); then
+            continue
+        fi
+        PARSER=$(field "${workload}" 4)
+        COMMAND=$(field "${workload}" 5)
+
+        echo "[${NAME}] RUNNING ${WNAME} '${COMMAND}' ${PERF_RUNS} TIMES"
+        rm -f ${WORK}/${WNAME}.runs
+        for RUN in $(seq ${PERF_RUNS}); do
+            # the workloads save the device they run as in the working directory, which is the bin
+            (cd ${BLD}/.O/usr/bin && ${COMMAND} 2>&1) | ${PARSER} >> ${WORK}/${WNAME}.runs
+        done
+        if [ ! -s ${WORK}/${WNAME}.runs ]; then
+            echo "[${NAME}] '${COMMAND}' REPORTED NOTHING"
+            FAILED=1
+            continue
+        fi
+
+        awk -v w=${WNAME} '
+            { key = $1 " " $2; n[key]++; v[key, n[key]] = $3 }
+            END {
+                for (key in n) {
+                    # insertion sort of the runs of a metric, there are a few
+                    for (i = 2; i <= n[key]; i++) {
+                        x = v[key, i]
+                        for (j = i - 1; j >= 1 && v[key, j] > x; j--) v[key, j + 1] = v[key, j]
+                        v[key, j + 1] = x
+                    }
+                    m = n[key] % 2 ? v[key, (n[key] + 1) / 2] : (v[key, n[key] / 2] + v[key, n[key] / 2 + 1]) / 2
+                    split(key, k, " ")
+                    printf("%-12s %-40s %-6s %14.3f %6.1f\n", w, k[1], k[2], m,
+                           m ? (v[key, n[key]] - v[key, 1]) * 100 / m : 0)
+                }
+            }' ${WORK}/${WNAME}.runs | sort >> ${REPORT}
+    done
+
+    rm -rf ${BLD}
+    return ${FAILED}
+}
+
+mkdir -p ${PERF_DIR}
+rm -f ${REPORT} ${PERF_DIR}/regressed
+# out of TOP_DIR, whose make takes every iot.mk under it but its own OUTPUT_DIR for a module
+PERF_BLD=$(mktemp -d ${TMPDIR:-/tmp}/perfgate.XXXXXX) || exit 1
+trap 'rm -rf ${PERF_BLD}' EXIT
+unset MAKEFLAGS MAKELEVEL MFLAGS
+
+FAILED=0
+for build in "${BUILDS[@]}"; do
+    NEEDED=0
+    for workload in "${WORKLOADS[@]}"; do
+        if [ "$(field "${workload}" 2)" = "$(field "${build}" 1)" ] && ([ "${PERF_WORKLOADS}" = "" ] || \
+                echo " ${PERF_WORKLOADS} " | grep -q " $(field "${workload}" 1) "); then
+            NEEDED=1
+        fi
+    done
+    if [ "${NEEDED}" = "1" ]; then
+        build_profile "$(field "${build}" 1)" "$(field "${build}" 2)" "$(field "${build}" 3)" || FAILED=1
+    fi
+done
+
+if [ "$1" = "update" ]; then
+    if [ "${FAILED}" != "0" ]; then
+        echo "BASELINE ${BASELINE} NOT UPDATED, NOT EVERYTHING WAS MEASURED"
+        exit 1
+    fi
+    ( \
+        echo "# medians and spreads in percent of ${PERF_RUNS} runs, by 'make perfgate UPDATE=1'" && \
+        echo "# $(uname -m), $(nproc 2>/dev/null) cpus, $(gcc --version | head -1)" && \
+        echo "# PERF_CFLAGS=${PERF_CFLAGS}" && \
+        cat ${REPORT} \
+    ) > ${BASELINE}
+    echo "BASELINE ${BASELINE} UPDATED"
+    exit ${FAILED}
+fi
+
+echo ""
+# a baseline of other flags is compared all the same, its numbers may not be reproduced
+if [ -f ${BASELINE} ] && ! grep -qxF "# PERF_CFLAGS=${PERF_CFLAGS}" ${BASELINE}; then
+    RECORDED=$(grep '^# PERF_CFLAGS=' ${BASELINE} | cut -c3-)
+    echo "NOTE: BASELINE MADE WITH ${RECORDED:-NO PERF_CFLAGS RECORDED}, NOW PERF_CFLAGS=${PERF_CFLAGS}"
+fi
+printf "     %-12s %-40s %14s %14s %8s %8s\n" "WORKLOAD" "METRIC" "BASELINE" "NOW" "WORSE" "ALLOWED"
+awk -v tol=${PERF_TOLERANCE} -v htol=${PERF_HEAP_TOLERANCE} -v regressed_file=${PERF_DIR}/regressed '
+    /^#/ { next }
+    FILENAME == ARGV[1] { base[$1 " " $2] = $0; next }
+    {
+        key = $1 " " $2
+        seen[key] = 1
+        if (!(key in base)) {
+            printf("  +  %-12s %-40s %14s %14.3f\n", $1, $2, "", $4)
+            next
+        }
+        split(base[key], b, " ")
+        if (b[4] == 0) {
+            # nothing was allocated before, any heap now is a regression
+            worse = ($3 == "heap" && $4 > 0) ? 100 : 0
+        } else {
+            worse = ($3 == "higher" ? b[4] - $4 : $4 - b[4]) * 100 / b[4]
+        }
+        allowed = ($3 == "heap" ? htol : tol) + b[5] + $5
+        grew = worse > allowed
+        printf("  %s  %-12s %-40s %14.3f %14.3f %+7.1f%% %7.1f%%\n", grew ? "!" : " ", $1, $2, b[4], $4, worse, allowed)
+        if (grew) {
+            print $1 >> regressed_file
+            regressed++
+        }
+    }
+    END {
+        for (key in base) {
+            if (!(key in seen)) {
+                split(key, k, " ")
+                printf("  -  %-12s %-40s\n", k[1], k[2])
+            }
+        }
+        exit regressed ? 1 : 0
+    }' $([ -f ${BASELINE} ] && echo ${BASELINE} || echo /dev/null) ${REPORT} || FAILED=1
+
+# the modules behind each regressed workload, as stats_static_lib.sh breaks them down in its build
+if [ -f ${PERF_DIR}/regressed ]; then
+    for WNAME in $(sort -u ${PERF_DIR}/regressed); do
+        for workload in "${WORKLOADS[@]}"; do
+            if [ "$(field "${workload}" 1)" != "${WNAME}" ]; then
+                continue
+            fi
+            echo ""
+            echo "o ${WNAME} REGRESSED, MODULES OF $(field "${workload}" 2):"
+            for mod in $(field "${workload}" 3); do
+                grep -e "\[ ${mod} \]" -e "| ${mod} " ${PERF_DIR}/$(field "${workload}" 2)/stats.txt
+            done
+        done
+    done
+fi
+
+echo ""
+if [ "${FAILED}" != "0" ]; then
+    echo "PERFORMANCE REGRESSED OR NOT MEASURED ('!' ABOVE OR BUILD MESSAGES), REPORT IN ${REPORT}"
+fi
+exit ${FAILED}
@@ -19,9 +19,16 @@ ar xf $(basename ${TARGET})
 rm -f $(basename ${TARGET})
 ${STRIP} *.o > /dev/null 2>&1
 
+# size of the same toolchain as strip, text + data goes to flash, data + bss to RAM
+if [ "${SIZE}" = "" ]; then
+    SIZE=$(echo ${STRIP}|sed 's/strip$/size/')
+    which ${SIZE} > /dev/null 2>&1 || SIZE=size
+fi
+
 for obj in $(ls *.o); do
     dir=$(find ${STAGED} -name ${obj}|xargs dirname|xargs basename)
-    printf "%-12s %-32s %s\n" ${dir} ${obj} $(du -b ${obj}|awk '{ print $1 }')
+    printf "%-12s %-32s %s %s\n" ${dir} ${obj} $(du -b ${obj}|awk '{ print $1 }') \
+        "$(${SIZE} ${obj} 2>/dev/null|awk 'NR == 2 { print $1 + $2, $2 + $3 }')"
 done | sort > ${TEMPF}
 
 MODS=$(cat ${TEMPF}|awk '{ print $1 }'|sort -u)
@@ -54,11 +61,18 @@ done
 echo ""
 for mod in ${MODS}; do
     MSIZE=$(grep "^${mod}" ${TEMPF}|awk '{ sum += $3 } END { print sum }')
-    printf "     %-8s %-12s %16s\n" \
+    printf "     %-8s %-12s %16s %16s %16s\n" \
         $(awk -v a=${MSIZE} -v b=${TOTAL} 'BEGIN { printf("%.2f%%\n", a/b*100); }') \
-        "[ ${mod} ]" "${MSIZE} Bytes"
+        "[ ${mod} ]" "${MSIZE} Bytes" \
+        "$(grep "^${mod}" ${TEMPF}|awk '{ sum += $4 } END { print sum }') Flash" \
+        "$(grep "^${mod}" ${TEMPF}|awk '{ sum += $5 } END { print sum }') RAM"
 done | sort -nr
 
+echo ""
+printf "     %-21s %16s %16s %16s\n" "[ TOTAL ]" "${TOTAL} Bytes" \
+    "$(awk '{ sum += $4 } END { print sum }' ${TEMPF}) Flash" \
+    "$(awk '{ sum += $5 } END { print sum }' ${TEMPF}) RAM"
+
 cd ${OLDPWD}
 rm -rf ${TEMPD}
 rm -f ${TEMPF}
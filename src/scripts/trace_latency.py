@@ -0,0 +1,113 @@
+#! /usr/bin/env python3
+#
+# Makes the latencies of the stages of each message from the "trace <us> <stage> <arg>" lines of
+# LITE_trace_dump(), see src/packages/LITE-utils/lite-trace.h. Other lines of the log are skipped:
+#
+#   trace_latency.py [-m] [log]
+#
+# A downlink is the points of its alink id from cmp_recv on, with the first of the reads since the
+# last point of another stage as its read. An uplink is the points of its id from serialize on, with
+# the first write after its cmp_send as its write, the uplinks written in the order they were sent.
+# -m prints every message too, the latencies are in us.
+#
+
+import re
+import sys
+
+POINT = re.compile(r'trace (\d+) ([a-z_]+) (\d+)')
+DOWNLINK = ['net_read', 'cmp_recv', 'tsl_set', 'queue_put', 'dispatch']
+UPLINK = ['serialize', 'cmp_send', 'net_write']
+
+
+def points_of(lines):
+    for line in lines:
+        found = POINT.search(line)
+        if found:
+            yield int(found.group(1)), found.group(2), int(found.group(3))
+
+
+# the downlinks and the uplinks, each a (id, {stage: us}) in the order they started
+def messages_of(points):
+    downlinks, uplinks = [], []
+    open_downlinks, open_uplinks = {}, {}
+    unwritten = []
+    read = None
+    for us, stage, arg in points:
+        if stage == 'net_read':
+            read = us if read is None else read
+            continue
+        if stage == 'net_write':
+            if unwritten:
+                unwritten.pop(0)['net_write'] = us
+        elif stage == 'cmp_recv':
+            message = {'cmp_recv': us}
+            if read is not None:
+                message['net_read'] = read
+            open_downlinks[arg] = message
+            downlinks.append((arg, message))
+        elif stage in DOWNLINK:
+            message = open_downlinks.get(arg)
+            if message is not None:
+                message.setdefault(stage, us)
+        elif stage == 'serialize':
+            message = {'serialize': us}
+            open_uplinks[arg] = message
+            uplinks.append((arg, message))
+        elif stage == 'cmp_send':
+            message = open_uplinks.pop(arg, None)
+            if message is not None and 'cmp_send' not in message:
+                message['cmp_send'] = us
+                unwritten.append(message)
+        read = None
+    return downlinks, uplinks
+
+
+# the latency between each stage and the next one the message went through, and of all of them
+def latencies_of(stages, message):
+    seen = [stage for stage in stages if stage in message]
+    latencies = [('%s>%s' % (a, b), message[b] - message[a]) for a, b in zip(seen, seen[1:])]
+    if len(seen) > 2:
+        latencies.append(('total', message[seen[-1]] - message[seen[0]]))
+    return latencies
+
+
+def percentile(values, p):
+    return values[min(len(values) - 1, len(values) * p // 100)]
+
+
+def report(name, stages, messages, verbose):
+    summary = {}
+    for arg, message in messages:
+        latencies = latencies_of(stages, message)
+        if verbose:
+            print('%s %u %s' % (name, arg, ' '.join('%s=%d' % latency for latency in latencies)))
+        for key, value in latencies:
+            summary.setdefault(key, []).append(value)
+
+    print('%s: %d messages' % (name, len(messages)))
+    print('  %-24s %8s %10s %10s %10s %10s %10s' % ('STAGE', 'COUNT', 'MEAN', 'P50', 'P90', 'P99', 'MAX'))
+    keys = ['%s>%s' % (a, b) for i, a in enumerate(stages) for b in stages[i + 1:]] + ['total']
+    for key in [key for key in keys if key in summary]:
+        values = sorted(summary[key])
+        print('  %-24s %8d %10d %10d %10d %10d %10d' % (key, len(values), sum(values) // len(values),
+                                                        percentile(values, 50), percentile(values, 90),
+                                                        percentile(values, 99), values[-1]))
+
+
+def main(argv):
+    verbose = '-m' in argv
+    argv = [arg for arg in argv if arg != '-m']
+    if len(argv) > 1:
+        print('usage: trace_latency.py [-m] [log]')
+        return 1
+
+    with (open(argv[0]) if argv else sys.stdin) as lines:
+        downlinks, uplinks = messages_of(points_of(lines))
+
+    report('downlink', DOWNLINK, downlinks, verbose)
+    report('uplink', UPLINK, uplinks, verbose)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
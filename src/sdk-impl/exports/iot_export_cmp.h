@@ -28,8 +28,12 @@
 #define CMP_DEVICE_ID_LEN       (64 + 1)
 
 
-/* support mutli thread
-#define CMP_SUPPORT_MULTI_THREAD */
+/*
+ * support mutli thread, defined by FEATURE_CMP_SUPPORT_MULTI_THREAD.
+ * cmp connects, reads and sends on its own thread, IOT_CMP_Register/Unregister/Send only queue the request
+ * for it, a bounded number of them wait and more fail. IOT_CMP_Yield is not there, callbacks
+ * are called on the cmp thread.
+ */
 
 /*
 * CMP: connection manager platform
@@ -88,11 +88,20 @@ typedef struct {
     int                   wait_time_ms; /*unit is micro second*/
     iotx_device_info_t   *p_devinfo;    /*Device info*/
     iotx_event_handle_t   event_handle; /*TODO, not supported now*/
+    unsigned char         nstart;       /*Confirmable requests in flight at once, 0 is no limit*/
+    unsigned char         cocoa;        /*Retransmit after an RTT estimated timeout instead of fixed doubling*/
+    void                 *p_group;      /*Shares the socket of a group of IOT_CoAP_GroupCreate when set, p_url is not used*/
 } iotx_coap_config_t;
 
 /* Callback function to handle the response message.*/
 typedef void (*iotx_response_callback_t)(void *p_arg, void *p_message);
 
+/* Callback function to read len bytes of a block-wise request body at offset, returns the bytes read, less than len at the end, <0 to abort.*/
+typedef int (*iotx_block_read_callback_t)(void *p_arg, unsigned int offset, unsigned char *p_buf, unsigned int len);
+
+/* Callback function to write len bytes of a block-wise response body at offset, more is 0 on the last block, returns <0 to abort.*/
+typedef int (*iotx_block_write_callback_t)(void *p_arg, unsigned int offset, unsigned char *p_data, unsigned int len, int more);
+
 /* IoTx message definition */
 typedef struct {
     unsigned char           *p_payload;
@@ -107,6 +116,12 @@ typedef struct {
 /*iotx coap context definition*/
 typedef void iotx_coap_context_t;
 
+/*a path split into its Uri-Path options once, for messages sent to it again and again*/
+typedef void iotx_coap_path_t;
+
+/*clients sharing one UDP socket and one receive loop*/
+typedef void iotx_coap_group_t;
+
 
 /** @defgroup group_api api
  *  @{
@@ -133,6 +148,8 @@ iotx_coap_context_t *IOT_CoAP_Init(iotx_coap_config_t *p_config);
  * @brief   De-initialize the CoAP client.
  *        This function release CoAP DTLS session.
  *        and release the related resource.
+ *        The DTLS session and auth token are kept, so the next IOT_CoAP_Init
+ *        of the same device resumes the session and skips the authentication.
  *
  * @param [in] p_context: Pointer of contex, specify the CoAP client.
  *
@@ -144,6 +161,8 @@ void IOT_CoAP_Deinit(iotx_coap_context_t **p_context);
 
 /**
  * @brief   Handle device name authentication with remote server.
+ *        A token kept by IOT_CoAP_Deinit for the same device is reused without
+ *        asking the server, it is dropped and renewed when the server rejects it.
  *
  * @param [in] p_context: Pointer of contex, specify the CoAP client.
  *
@@ -166,6 +185,79 @@ int  IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context);
  */
 int  IOT_CoAP_Yield(iotx_coap_context_t *p_context);
 
+#ifdef HAL_EVENT_ENABLED
+/**
+ * @brief   Descriptor of the CoAP client to register in a HAL event loop, so one thread serves many clients:
+ *          register it with HAL_EventLoop_add for HAL_EVENT_READ, wait with HAL_EventLoop_wait for at most
+ *          the least IOT_CoAP_GetTimeout of the clients, then call IOT_CoAP_Process of every client ready
+ *          or due instead of IOT_CoAP_Yield. IOT_CoAP_DeviceNameAuth still waits for its reply, and DTLS
+ *          sessions are not supported.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ *
+ * @return The descriptor, < 0 when the client has none to wait on.
+ */
+intptr_t IOT_CoAP_GetFd(iotx_coap_context_t *p_context);
+
+/**
+ * @brief   Handle the CoAP packets already received and the retransmissions due, never blocks.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ *
+ * @return status.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_Process(iotx_coap_context_t *p_context);
+
+/**
+ * @brief   Milliseconds till IOT_CoAP_Process of the client has retransmissions to check. The ticks
+ *          with nothing due are waited through, so a client with nothing outstanding does not wake.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ *
+ * @return The milliseconds, 0 when due now, 0xFFFFFFFF when nothing waits for a retransmission.
+ */
+unsigned int IOT_CoAP_GetTimeout(iotx_coap_context_t *p_context);
+#endif  /* HAL_EVENT_ENABLED */
+
+#ifdef COAP_GROUP_ENABLED
+/**
+ * @brief   Open one UDP socket for many CoAP clients, set as p_group of their IOT_CoAP_Init.
+ *          A datagram goes to its client by the slot each one tags on the tokens it sends, and
+ *          an ACK or RST by the slot in the high bits of its message id, so a client has only
+ *          65536 / capacity message ids to use within the exchange lifetime of the server.
+ *          The group and its clients are served from one thread, by IOT_CoAP_GroupYield.
+ *          DTLS sessions are not supported.
+ *
+ * @param [in] p_url: A coap:// server url.
+ * @param [in] capacity: Clients at most, a power of 2 up to 4096.
+ * @param [in] wait_time_ms: How long IOT_CoAP_GroupYield receives, 0 for the default.
+ *
+ * @retval NULL : Invalid parameter or the socket failed.
+ * @retval NOT_NULL : The group.
+ */
+iotx_coap_group_t *IOT_CoAP_GroupCreate(char *p_url, unsigned int capacity, int wait_time_ms);
+
+/**
+ * @brief   Close the socket of a group, after IOT_CoAP_Deinit of all its clients.
+ *
+ * @param [in] pp_group: Pointer of the group, it is set to NULL.
+ */
+void IOT_CoAP_GroupDestroy(iotx_coap_group_t **pp_group);
+
+/**
+ * @brief   Handle the CoAP packets of all clients of the group and their retransmissions,
+ *          instead of IOT_CoAP_Yield of each. IOT_CoAP_DeviceNameAuth of a client serves
+ *          the others while it waits for its reply.
+ *
+ * @param [in] p_group : The group.
+ *
+ * @return status.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_GroupYield(iotx_coap_group_t *p_group);
+#endif  /* COAP_GROUP_ENABLED */
+
 
 /**
  * @brief   Send a message with specific path to server.
@@ -182,8 +274,104 @@ int  IOT_CoAP_Yield(iotx_coap_context_t *p_context);
  */
 int  IOT_CoAP_SendMessage(iotx_coap_context_t *p_context,   char *p_path, iotx_message_t *p_message);
 
+/**
+ * @brief   Split a path into its Uri-Path options and serialize them once,
+ *        so the messages sent to it by IOT_CoAP_SendPathMessage copy them as they are.
+ *
+ * @param [in] p_path: Specify the path name.
+ *
+ * @retval NULL : Invalid path or not enough memory.
+ * @retval NOT_NULL : The path, for any CoAP client.
+ */
+iotx_coap_path_t *IOT_CoAP_PathCreate(const char *p_path);
+
+/**
+ * @brief   Release a path of IOT_CoAP_PathCreate, no message sent to it may still be built.
+ *
+ * @param [in] pp_path: Pointer of the path, it is set to NULL.
+ */
+void IOT_CoAP_PathDestroy(iotx_coap_path_t **pp_path);
+
+/**
+ * @brief   Send a message to a path of IOT_CoAP_PathCreate, as IOT_CoAP_SendMessage does.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ * @param [in] p_path: The path.
+ * @param [in] p_message: Message to be sent.
+ *
+ * @retval IOTX_SUCCESS             : Send the message success.
+ * @retval IOTX_ERR_MSG_TOO_LOOG    : The message length is too long.
+ * @retval IOTX_ERR_NOT_AUTHED      : The client hasn't authenticated with server
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_SendPathMessage(iotx_coap_context_t *p_context, iotx_coap_path_t *p_path, iotx_message_t *p_message);
+
+/**
+ * @brief   Send a message with specific path to server using block-wise transfer (RFC 7959).
+ *        The request body is read through read_cb in blocks, and the response body is
+ *        written through write_cb in blocks, so a body of any size only needs one block buffer.
+ *        resp_callback of p_message gets the final response, or NULL when the transfer fails.
+ *        Client must authentication with server before send message.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ * @param [in] p_path: Specify the path name.
+ * @param [in] p_message: Message to be sent, its payload is ignored.
+ * @param [in] read_cb: Reads the request body, NULL for no request body.
+ * @param [in] write_cb: Writes the response body, NULL to get the response unchanged.
+ * @param [in] block_size: Block size, power of two from 16 to 1024.
+ *
+ * @retval IOTX_SUCCESS             : The transfer started.
+ * @retval IOTX_ERR_INVALID_PARAM   : Invalid parameter or block size.
+ * @retval IOTX_ERR_NOT_AUTHED      : The client hasn't authenticated with server
+ * @retval IOTX_ERR_NO_MEM          : Not enough memory for the transfer.
+ * @retval IOTX_ERR_SEND_MSG_FAILED : Send the first block failed.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_SendBlockMessage(iotx_coap_context_t *p_context, char *p_path, iotx_message_t *p_message,
+                               iotx_block_read_callback_t read_cb, iotx_block_write_callback_t write_cb,
+                               unsigned int block_size);
+
+/**
+ * @brief   Observe a resource with specific path on server (RFC 7641), so the server
+ *        pushes its changes instead of being polled.
+ *        resp_callback of p_message gets every fresh notification, stale or reordered
+ *        ones are dropped. The observation ends with a response that is an error or
+ *        has no Observe option, or with NULL when the registration is dropped unanswered.
+ *        Client must authentication with server before observe.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ * @param [in] p_path: Specify the path name.
+ * @param [in] p_message: Message options and callback, its payload is ignored.
+ * @param [out] p_observe_id: Identifies the observation for IOT_CoAP_ObserveCancel.
+ *
+ * @retval IOTX_SUCCESS             : The registration is sent.
+ * @retval IOTX_ERR_INVALID_PARAM   : Invalid parameter.
+ * @retval IOTX_ERR_NOT_AUTHED      : The client hasn't authenticated with server
+ * @retval IOTX_ERR_NO_MEM          : Not enough memory for the observation.
+ * @retval IOTX_ERR_SEND_MSG_FAILED : Send the registration failed.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_Observe(iotx_coap_context_t *p_context, char *p_path, iotx_message_t *p_message,
+                      unsigned int *p_observe_id);
+
+/**
+ * @brief   Cancel an observation, the server is asked to deregister it,
+ *        resp_callback of the observation isn't called anymore.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ * @param [in] observe_id: The observation returned by IOT_CoAP_Observe.
+ *
+ * @retval IOTX_SUCCESS             : The observation is cancelled.
+ * @retval IOTX_ERR_INVALID_PARAM   : Invalid parameter or unknown observation.
+ * @retval IOTX_ERR_SEND_MSG_FAILED : Send the deregistration failed, the observation is forgotten anyway.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_ObserveCancel(iotx_coap_context_t *p_context, unsigned int observe_id);
+
 /**
 * @brief Retrieves the length and payload pointer of specified message.
+*        The payload is not copied, it points into the receive buffer and is not NUL terminated,
+*        so it is only valid inside the response callback, copy it to keep it.
 *
 * @param  [in] p_message: Pointer to the message to get the payload. Should not be NULL.
 * @param  [out] pp_payload: Pointer to the payload.
@@ -11,6 +11,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include "iot_export_fota.h"
 #define CONFIG_COTA_MODULE_NAME "service_cota"
 #define SERVICE_COTA_CLASS get_config_ota_class()
 
@@ -27,6 +28,8 @@
 
 typedef enum {
     service_cota_callback_type_new_version_detected = 10,
+    /* the download is over, see get_stats() for how it went, configid is the one downloaded */
+    service_cota_callback_type_download_finished,
 
     service_cota_callback_type_number,
 } service_cota_callback_type_t;
@@ -37,6 +40,23 @@ typedef void (*handle_service_cota_callback_fp_t)(service_cota_callback_type_t c
 																							  const char* sign,
 																							  const char* signmethod,
 																							  const char* cota_url);
+/*
+ * Streaming mode: each value of a json config is handed over as soon as it is downloaded instead of
+ * the config being persisted, named by its path like "servers[1].host". Values are NUL terminated,
+ * strings without their quotes. Return 0 to go on, else the rest of the config is not parsed. The
+ * config is checked against its sign only once all of it is downloaded, keep the values until
+ * perform_ota_service() returns 0.
+ */
+typedef enum {
+    service_cota_value_type_null = -1,
+    service_cota_value_type_string = 0,
+    service_cota_value_type_number = 3,
+    service_cota_value_type_boolean = 4,
+} service_cota_value_type_t;
+
+typedef int (*handle_service_cota_stream_fp_t)(const char* key, int key_len, const char* value, int value_len,
+                                               service_cota_value_type_t value_type, void* ctx);
+
 void* config_ota_lite_calloc(size_t nmemb, size_t size);
 void* config_ota_lite_malloc(size_t size);
 void config_ota_lite_free_func(void* ptr);
@@ -51,6 +71,9 @@ typedef struct {
     int   (*end)(void* _self);
     int   (*perform_ota_service)(void* _self, void* _data_buf, int _data_buf_length);
     void  (*install_callback_function)(void* _self, handle_service_cota_callback_fp_t linkkit_callback_fp);
+    void  (*install_stream_callback_function)(void* _self, handle_service_cota_stream_fp_t stream_callback_fp, void* ctx);
+    /* written counts what is persisted or parsed, a config is not resumed, retries and resumes stay 0 */
+    int   (*get_stats)(void* _self, service_ota_stats_t* stats);
 } cota_t;
 
 typedef struct {
@@ -71,6 +94,10 @@ typedef struct {
     char*       _rsp_getType;
     int         _ota_inited;
     int         _destructing;
+    void*       _stream_callback_fp;
+    void*       _stream_ctx;
+    service_ota_stats_t _stats;     /* of the last download */
+    uint64_t    _stats_start_ms;
 } config_ota_t;
 
 extern const void* get_config_ota_class();
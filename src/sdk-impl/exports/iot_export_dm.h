@@ -5,6 +5,8 @@
 extern "C" {
 #endif /* __cplusplus */
 
+#include <stdint.h>
+
 #define DM_IMPL_CLASS get_dm_impl_class()
 
 typedef struct {
@@ -22,7 +24,7 @@ typedef enum {
     dm_callback_type_property_value_set = 0,
     dm_callback_type_service_requested,
 #ifdef RRPC_ENABLED
-    dm_callback_type_rrpc_requested,
+    dm_callback_type_rrpc_requested, /* raw_data_length is the token to pass as rrpc of answer_service. */
 #endif /* RRPC_ENABLED */
     dm_callback_type_cloud_connected,
     dm_callback_type_cloud_disconnected,
@@ -31,10 +33,32 @@ typedef enum {
     dm_callback_type_thing_enabled,
     dm_callback_type_raw_data_arrived,
     dm_callback_type_response_arrived,
+#ifdef DM_BACKPRESSURE_ENABLED
+    dm_callback_type_send_writable, /* a post refused with DM_SEND_WOULD_BLOCK goes through now. */
+#endif /* DM_BACKPRESSURE_ENABLED */
 
     dm_callback_type_number,
 } dm_callback_type_t;
 
+/* encoding of uplink property and event posts. */
+typedef enum {
+    dm_payload_format_json = 0,
+    dm_payload_format_cbor, /* whole alink message as cbor (RFC 8949), sent as raw data. */
+
+    dm_payload_format_max,
+} dm_payload_format_t;
+
+#ifdef DM_CHANNELS_ENABLED
+/* what carries the uplinks of a route, see set_channel_route. */
+typedef enum {
+    dm_channel_mqtt = 0, /* the connection of CMP, the one of all uplinks not routed elsewhere. */
+    dm_channel_coap,     /* the CoAP client of the device, needs FEATURE_COAP_COMM_ENABLED. */
+    dm_channel_http,     /* the HTTP client of the device, needs FEATURE_HTTP_COMM_ENABLED. */
+
+    dm_channel_max,
+} dm_channel_t;
+#endif /* DM_CHANNELS_ENABLED */
+
 typedef void (*handle_dm_callback_fp_t)(dm_callback_type_t callback_type, void* thing_id,
                                         const char* property_service_identifier, int request_id,
                                         void* raw_data, int raw_data_length);
@@ -49,6 +73,80 @@ typedef enum {
     dm_cloud_domain_max,
 } dm_cloud_domain_type_t;
 
+/* one item of a batch property set, handle is used if not NULL, otherwise identifier. */
+typedef struct {
+    const char* identifier; /* property identifier, same format as set_property_value. */
+    const void* handle; /* property handle from resolve_property_handle. */
+    const void* value;
+    const char* value_str; /* used if value is NULL. */
+} dm_property_value_t;
+
+#ifdef DM_REPORT_POLICY_ENABLED
+/*
+ * report policy of a property, a value set is tracked for the next changed property post only when it passes.
+ * deadbands and on_change_only compare the value of int, float, double, enum, bool and date properties to the one
+ * last reported, other properties pass them. all 0 reports every set, as without a policy.
+ *
+ * with aggregate_window_ms > 0 the values set to a numeric property are aggregated instead, and at the end of each
+ * window with a value set the property is set to their average, the aggregate_* properties named to their min, max,
+ * count and last samples, and all of them are posted as changed properties. the other fields do not apply then.
+ */
+typedef struct {
+    double deadband; /* a value closer than this to the one last reported is not reported, 0 for none. */
+    double deadband_percent; /* same in percent of the value last reported, 0 for none. */
+    int    min_interval_ms; /* a value passing is held till this long after the last report, 0 for none. */
+    int    max_interval_ms; /* reported again this long after the last report even if not set, 0 for never. */
+    int    on_change_only; /* a value equal to the one last reported is not reported. */
+    int    aggregate_window_ms; /* length of the aggregation windows, 0 for no aggregation. */
+    const char* aggregate_min; /* numeric property set to the min of a window, NULL for none. */
+    const char* aggregate_max; /* numeric property set to the max of a window, NULL for none. */
+    const char* aggregate_count; /* numeric property set to the number of values of a window, NULL for none. */
+    const char* aggregate_samples; /* int, float or double array property holding the last values set, NULL for none. */
+} dm_report_policy_t;
+#endif /* DM_REPORT_POLICY_ENABLED */
+
+#ifdef DM_STATIC_THING_ENABLED
+/* properties of a static thing by id, the index of a property in its tsl, one bit each. */
+#define DM_STATIC_THING_IDS_SIZE(number)    (((number) + 7) / 8)
+#define DM_STATIC_THING_ID_ISSET(ids, id)   (((ids)[(id) / 8] >> ((id) % 8)) & 1)
+#define DM_STATIC_THING_ID_SET(ids, id)     ((ids)[(id) / 8] |= (unsigned char)(1 << ((id) % 8)))
+
+/*
+ * model of a static thing, generated by linkkit-tsl-codegen from its tsl. the values of its properties are the fields
+ * of a struct generated along, data, stored by the application and by property sets, formatted straight into posts.
+ */
+typedef struct {
+    int                property_number;
+    const char* const* identifiers; /* of the properties by id. */
+    /* "identifier":value members of the properties of ids, all if NULL, into writer, a dm_json_writer_t. */
+    void (*format_properties)(const void* data, const unsigned char* ids, void* writer);
+    /* store the members of params, a cJSON object, into data and set their ids. -1 when one is bad, unknown ones are skipped. */
+    int  (*parse_properties)(void* data, const void* params, unsigned char* ids);
+} dm_static_thing_model_t;
+#endif /* DM_STATIC_THING_ENABLED */
+
+/*
+ * handler of a custom downlink route.
+ * method is uri part after /sys/productKey/deviceName/, payload is params of the message, valid only during the call.
+ */
+typedef void (*dm_route_handler_fp_t)(const void* thing_id, const char* method, int message_id,
+                                      const char* payload, int payload_len, void* ctx);
+
+/* code of a request not replied in its timeout. */
+#define DM_REPLY_CODE_TIMEOUT (-1)
+
+#ifdef DM_BACKPRESSURE_ENABLED
+/* a property post not sent as the connection is saturated, dm_callback_type_send_writable tells when to try again. */
+#define DM_SEND_WOULD_BLOCK (-2)
+#endif /* DM_BACKPRESSURE_ENABLED */
+
+/*
+ * handler of the reply to an uplink request, code is alink code of the reply or DM_REPLY_CODE_TIMEOUT.
+ * payload is data of the reply, NULL on timeout, valid only during the call.
+ */
+typedef void (*dm_reply_handler_fp_t)(const void* thing_id, int request_id, int code,
+                                      const char* payload, int payload_len, void* ctx);
+
 typedef struct {
     size_t size;
     const char*  _class_name;
@@ -77,6 +175,68 @@ typedef struct {
     int   (*answer_raw_service)(const void* _self, const void* thing_id, void* raw_data, int raw_data_length);
 #ifndef CMP_SUPPORT_MULTI_THREAD
     int   (*yield)(const void* _self, int timeout_ms);
+#endif
+    /* resolve property identifier once, handle stays valid until released or thing destroyed. */
+    void* (*resolve_property_handle)(void* _self, const void* thing_id, const char* identifier);
+    void  (*release_property_handle)(void* _self, void* handle);
+    int   (*set_property_value_by_handle)(void* _self, const void* handle, const void* value, const char* value_str);
+    int   (*get_property_value_by_handle)(const void* _self, const void* handle, void* value, char** value_str);
+    /* copy native value and value string into buffers of caller, safe against sets of other threads. */
+    int   (*copy_property_value)(const void* _self, const void* thing_id, const char* identifier, void* value, char* buff, int buff_len);
+    int   (*copy_property_value_by_handle)(const void* _self, const void* handle, void* value, char* buff, int buff_len);
+    /* post properties set since last acked property post. */
+    int   (*post_changed_property)(const void* _self, const void* thing_id);
+    /* set several properties of one thing, 0 when all items set, -1 if any fails. */
+    int   (*set_property_values)(void* _self, const void* thing_id, const dm_property_value_t* values, int number);
+    /* copy number items of int, float or double array property from/to values, from item start on. */
+    int   (*set_property_array_values)(void* _self, const void* thing_id, const void* identifier, int start, const void* values, int number);
+    int   (*get_property_array_values)(void* _self, const void* thing_id, const void* identifier, int start, void* values, int number);
+    /* route downlink messages of method to handler, method must not be a built in one. */
+    int   (*register_route)(void* _self, const char* method, dm_route_handler_fp_t handler, void* ctx);
+    /*
+     * coalesce property posts of a thing, a post requested is sent min_interval_ms after the last one at the earliest,
+     * or max_latency_ms after it was first requested if that is sooner and max_latency_ms > 0. 0 min_interval_ms posts at once.
+     */
+    int   (*set_property_post_schedule)(void* _self, int min_interval_ms, int max_latency_ms);
+    /* send coalesced property posts due, all pending ones if force, and time requests out. */
+    int   (*flush_property_post)(void* _self, int force);
+    /* create number things at once, things[i] is NULL for tsls[i] failed. returns number of things created. */
+    int   (*generate_new_things)(void* _self, const char* const* tsls, const int* tsl_lens, int number, void** things);
+    /* encode property and event posts as format, replies and downlinks stay json. */
+    int   (*set_payload_format)(void* _self, dm_payload_format_t format);
+    /*
+     * post event without waiting, handler gets its reply or timeout after timeout_ms. posts are sent at once, not coalesced.
+     * returns request id > 0, or -1 when fail or DM_REQUEST_TABLE_SIZE requests wait for reply already.
+     */
+    int   (*trigger_event_async)(void* _self, const void* thing_id, const void* event_identifier, const char* property_identifier,
+                                 int timeout_ms, dm_reply_handler_fp_t handler, void* ctx);
+    /* forget request, its handler is not called. 0 when it was waiting for reply. */
+    int   (*cancel_request)(void* _self, int request_id);
+    /* post the metrics of lite-metrics.h every interval_ms as thing/sdk/metrics/post of the device, 0 stops(default). */
+    int   (*set_metrics_post_interval)(void* _self, int interval_ms);
+#ifndef CMP_SUPPORT_MULTI_THREAD
+    /* ms till yield has coalesced posts to send, requests to time out or the connection to keep, 0xFFFFFFFF for never. */
+    uint32_t (*get_timeout)(void* _self);
+#endif
+#ifdef DM_REPORT_POLICY_ENABLED
+    /*
+     * attach policy to property identifier of the thing, to all its properties if NULL, a NULL policy detaches.
+     * held values and max intervals due are posted by yield and flush_property_post.
+     */
+    int   (*set_property_report_policy)(void* _self, const void* thing_id, const char* identifier, const dm_report_policy_t* policy);
+#endif
+#ifdef DM_CHANNELS_ENABLED
+    /*
+     * send the uplink requests and raw data of the device whose uri after /sys/{productKey}/{deviceName}/ starts
+     * with prefix over channel, the route of the longest prefix wins. each channel sends from a queue of its own.
+     */
+    int   (*set_channel_route)(void* _self, const char* prefix, dm_channel_t channel);
+#endif /* DM_CHANNELS_ENABLED */
+#ifdef DM_STATIC_THING_ENABLED
+    /* keep the property values of the thing in data, laid out by model generated from its tsl, NULL model unbinds. */
+    int   (*bind_static_thing)(void* _self, const void* thing_id, const dm_static_thing_model_t* model, void* data);
+    /* mark properties of ids stored into data for the next changed property post, all if NULL. */
+    int   (*set_static_properties_changed)(void* _self, const void* thing_id, const unsigned char* ids);
 #endif
 } dm_t;
 
@@ -3,6 +3,7 @@
 
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #define SERVICE_FOTA_MODULE_NAME "service_fota"
 
@@ -10,10 +11,33 @@
 
 typedef enum {
     service_fota_callback_type_new_version_detected = 10,
+    /* the download is over, see get_stats() for how it went, before the device restarts when it succeeded */
+    service_fota_callback_type_download_finished,
 
     service_fota_callback_type_number,
 } service_fota_callback_type_t;
 
+/*
+ * Where the time of a download went, to tell a slow network from a slow flash. The fetch waits for
+ * the writes when all buffers are being written, the writes wait for the fetch when none is filled.
+ */
+typedef struct {
+    uint32_t    size;                   /* of the image or config */
+    uint32_t    fetched;                /* bytes received */
+    uint32_t    written;                /* bytes written, or parsed for a streamed config */
+    uint32_t    elapsed_ms;             /* from the start, to the end once it is over */
+    uint32_t    first_byte_ms;          /* from the start to the first byte received, 0 before */
+    uint32_t    write_ms;               /* spent writing */
+    uint32_t    fetch_stall_ms;         /* the fetch waited for the writes */
+    uint32_t    write_stall_ms;         /* the writes waited for the fetch */
+    uint32_t    fetch_bytes_per_s;      /* received per second the fetch did not wait for the writes */
+    uint32_t    write_bytes_per_s;      /* written per second spent writing */
+    uint32_t    retries;                /* fetches again after one broke */
+    uint32_t    resumes;                /* fetches going on from where an earlier one broke */
+    uint32_t    resume_offset;          /* where the last of them went on from */
+    int         result;                 /* 0 done, -1 failed, 1 going on */
+} service_ota_stats_t;
+
 typedef void (*handle_service_fota_callback_fp_t)(service_fota_callback_type_t callback_type, const char* version);
 
 typedef struct {
@@ -26,6 +50,7 @@ typedef struct {
     int   (*end)(void* _self);
     int   (*perform_ota_service)(void* _self, void* _data_buf, int _data_buf_length);
     void  (*install_callback_function)(void* _self, handle_service_fota_callback_fp_t linkkit_callback_fp);
+    int   (*get_stats)(void* _self, service_ota_stats_t* stats);
 } fota_t;
 
 void* service_ota_lite_malloc(size_t size);
@@ -50,10 +75,15 @@ typedef struct {
     int         _data_buf_length;
     int         _total_len;
     char*       _ota_version;
+    char*       _ota_url;           /* of the new version, fetched again from where it stopped */
+    unsigned int _ota_size;
     void*       _linkkit_callback_fp;
     char*       _current_verison;
     int         _ota_inited;
     int         _destructing;
+    service_ota_stats_t _stats;     /* of the last download */
+    uint64_t    _stats_start_ms;        /* HAL_UptimeMs() when it started */
+    uint64_t    _stats_write_end_ms;    /* when the last write ended, the writes wait for the fetch from there */
 } service_ota_t;
 
 extern const void* get_service_ota_class();
@@ -39,11 +39,14 @@ typedef struct {
     void               *httpc;
     int                 keep_alive;
     int                 timeout_ms;
+    char               *p_header;
 } iotx_http_t, *iotx_http_pt;
 
 /* IoTx http message definition
  * request_payload and response_payload need to be allocate in order to save memory.
  * topic_path specify the topic url you want to publish message.
+ * request_payload_len is the length of request_payload as sent, which may be binary;
+ * 0 sends request_payload as a string with its terminating '\0'.
  */
 typedef struct {
     char       *topic_path;
@@ -54,6 +57,34 @@ typedef struct {
     uint32_t   timeout_ms;
 } iotx_http_message_param_t;
 
+/* IoTx http batch message definition
+ * payload_len is the length of payload as sent, which may be binary;
+ * 0 sends payload as a string with its terminating '\0'.
+ */
+typedef struct {
+    const char *topic_path;
+    const char *payload;
+    uint32_t    payload_len;
+} iotx_http_batch_message_t;
+
+/* sets message to the one of index of the batch, non-zero when there is no more */
+typedef int (*iotx_http_batch_next_fpt)(void *pcontext, uint32_t index, iotx_http_batch_message_t *message);
+
+/* IoTx http batch definition
+ * the messages are either the message_num ones of messages, or, when messages is NULL, the ones next_cb hands.
+ * next_cb may be asked for an index again, when the request is sent again on a new connection.
+ * response_payload need to be allocate in order to save memory.
+ */
+typedef struct {
+    iotx_http_batch_message_t *messages;
+    uint32_t                   message_num;
+    iotx_http_batch_next_fpt   next_cb;
+    void                      *pcontext;
+    uint32_t                   response_payload_len;
+    char                      *response_payload;
+    uint32_t                   timeout_ms;
+} iotx_http_batch_param_t;
+
 /* The response code from sever */
 typedef enum {
     IOTX_HTTP_SUCCESS = 0,
@@ -122,6 +153,22 @@ int     IOT_HTTP_DeviceNameAuth(void *handle);
  */
 int     IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param);
 
+/**
+ * @brief   Send a batch of messages to server in one request, on the connection kept with keep_alive.
+ *        Each message is framed as the 2 bytes of the length of its topic path, the 4 bytes of the length of
+ *        its payload, both big endian, its topic path and its payload. The request is of the length of the
+ *        messages of batch_param->messages, or chunked for the ones of batch_param->next_cb.
+ *        Client must authentication with server before send message.
+ *
+ * @param [in] handle: Pointer of contex, specify the HTTP client.
+ * @param [in] batch_param: Specify the messages and the http response configuration.
+ *
+ * @retval  0 : Success.
+ * @retval -1 : Failed.
+ * @see iotx_err_t.
+ */
+int     IOT_HTTP_SendBatch(void *handle, iotx_http_batch_param_t *batch_param);
+
 /**
  * @brief   close tcp connection from client to server.
  *
@@ -162,6 +162,13 @@ typedef struct {
 
     iotx_mqtt_event_handle_t    handle_event;             /* Specify MQTT event handle */
 
+#ifdef MQTT5_ENABLED
+    /* Used by IOT_MQTT_ConstructV5() only, 0 for what MQTT 5.0 assumes when a property is absent */
+    uint32_t                    session_expiry_s;         /* Specify how long the server keeps the session after disconnect */
+    uint16_t                    receive_maximum;          /* Specify QoS1/2 messages the server may send unacknowledged, 0 for 65535 */
+    uint16_t                    topic_alias_maximum;      /* Specify topic aliases used towards the server at most, 0 for none */
+#endif
+
 } iotx_mqtt_param_t, *iotx_mqtt_param_pt;
 
 /** @defgroup group_api api
@@ -172,6 +179,12 @@ typedef struct {
  *  @{
  */
 
+/*
+ * IOT_MQTT_ConstructAsync(), IOT_MQTT_ConstructV5() and IOT_MQTT_ConstructThread() keep the clients they construct
+ * in a table of their module, which only they and the matching destroy write, without a lock. So a construct or
+ * destroy must not run at once with another one of the same kind, nor with any other call on that client.
+ */
+
 /**
  * @brief Construct the MQTT client
  *        This function initialize the data structures, establish MQTT connection.
@@ -223,6 +236,98 @@ int IOT_MQTT_Destroy(void **phandle);
 int IOT_MQTT_Yield(void *handle, int timeout_ms);
 
 
+/**
+ * @brief Milliseconds till the client has something to do on its own: the next keep-alive ping,
+ *        resending or giving up a request waiting for its ACK, or reconnecting.
+ *        IOT_MQTT_Yield() for that long, capped to the longest the application may sleep, waits in
+ *        the read of the connection until a packet comes or the time is up, so the CPU wakes for
+ *        nothing else and a tickless idle can engage. Ask again after each yield, what the handlers
+ *        did may have added an earlier deadline.
+ *
+ * @param [in] handle: specify the MQTT client.
+ *
+ * @return The milliseconds, 0 when due now, 0xFFFFFFFF when the client is not connecting at all.
+ * @see None.
+ */
+uint32_t IOT_MQTT_GetTimeout(void *handle);
+
+
+/* What the client takes now without waiting, see IOT_MQTT_GetSendBudget(). */
+typedef struct {
+    int             connected;      /* 1 when a publish is written at once, 0 while disconnected or reconnecting. */
+    uint32_t        pub_slots;      /* QoS1 publishes more that can wait for their PUBACK. */
+    uint32_t        pub_bytes;      /* bytes of the QoS1 publishes waiting for their PUBACK. */
+    uint32_t        packet_len;     /* longest packet written, the size of the send buffer. */
+} iotx_mqtt_send_budget_t, *iotx_mqtt_send_budget_pt;
+
+
+/**
+ * @brief Send budget of the client, for producers to hold back before the connection saturates
+ *        instead of finding out from a failed publish. A QoS1 publish takes a slot and its bytes
+ *        until its PUBACK, so a link that carries them slower than they come runs out of slots.
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [out] budget: the budget.
+ *
+ * @return 0 when filled in, -1 when there is no client.
+ * @see None.
+ */
+int IOT_MQTT_GetSendBudget(void *handle, iotx_mqtt_send_budget_pt budget);
+
+
+/**
+ * @brief Adaptive keep-alive, for NATs that drop idle mappings sooner than the keep-alive interval.
+ *        The client pings only once the connection was idle for the longest interval a ping was
+ *        answered after on the network, found by probing longer ones up to 'keepalive_interval_ms'
+ *        of 'iotx_mqtt_param_t', which stays what the server is told. A packet read or written puts
+ *        the ping off. A ping not answered in CONFIG_MQTT_KEEPALIVE_ANSWER_MS fails the read, so the
+ *        client reconnects at once. What is learnt is kept with HAL_Kv_Set() per network.
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [in] network_id: names the network, like the SSID or the MCC-MNC of the cell, "" for any one.
+ *                         Call again when the network changes. NULL ends the mode, do so before
+ *                         IOT_MQTT_Destroy().
+ *
+ * @retval  0 : Success.
+ * @retval -1 : Failed.
+ * @see None.
+ */
+int IOT_MQTT_SetKeepaliveAdaptive(void *handle, const char *network_id);
+
+
+/**
+ * @brief Growable buffers, so 'pread_buf' and 'pwrite_buf' of 'iotx_mqtt_param_t' can be sized for the
+ *        usual packets instead of the longest one. A packet longer than them is read into, or published
+ *        from, a buffer of a pool all the clients share, of CONFIG_MQTT_BUFFER_CLASS_MIN bytes doubled
+ *        till it fits. Once no packet needed it for CONFIG_MQTT_BUFFER_IDLE_MS the client goes back to
+ *        its own. The bytes taken of the pool are the gauge "mqtt.buffer" of the metrics, the most
+ *        ever taken "mqtt.buffer.peak".
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [in] max_len: longest packet in bytes, at most 128 times CONFIG_MQTT_BUFFER_CLASS_MIN, a longer
+ *                      one is dropped as before. 0 ends the mode, do so before IOT_MQTT_Destroy().
+ *
+ * @retval  0 : Success.
+ * @retval -1 : Failed.
+ * @see None.
+ */
+int IOT_MQTT_SetBufferGrowth(void *handle, uint32_t max_len);
+
+
+/**
+ * @brief Sync the epoch clock of the SDK over the cloud's ntp topic. The request is published and
+ *        this returns at once, the response is handled in a later IOT_MQTT_Yield(), after which
+ *        timestamps are taken from the uptime with no network I/O. Call it again now and then,
+ *        every UTILS_EPOCH_TIME_RESYNC_MS is enough, IOT_Shadow_Yield() does so for a shadow.
+ *
+ * @param [in] handle: specify the MQTT client.
+ *
+ * @return >= 0 when the request is sent, < 0 when it could not be.
+ * @see None.
+ */
+int IOT_MQTT_SyncTime(void *handle);
+
+
 /**
  * @brief check whether MQTT connection is established or not.
  *
@@ -247,6 +352,22 @@ int IOT_MQTT_CheckStateNormal(void *handle);
 int IOT_MQTT_Disable_Reconnect(void *handle);
 
 
+/**
+ * @brief check whether the server kept the session of the last connection, the session present flag of CONNACK.
+ *        Valid right after IOT_MQTT_Construct() and in the handler of IOTX_MQTT_EVENT_RECONNECT only,
+ *        before anything else is received. With 'clean_session' 0 and a session present,
+ *        the subscriptions of the client are still in place at the server.
+ *
+ * @param [in] handle: specify the MQTT client.
+ *
+ * @retval  1 : Session present.
+ * @retval  0 : New session, subscriptions must be made again.
+ * @retval -1 : Unknown, the last packet received is not an accepting CONNACK.
+ * @see None.
+ */
+int IOT_MQTT_SessionPresent(void *handle);
+
+
 /**
  * @brief Subscribe MQTT topic.
  *
@@ -269,6 +390,33 @@ int IOT_MQTT_Subscribe(void *handle,
                        void *pcontext);
 
 
+/**
+ * @brief Subscribe several MQTT topics with the same handle, without waiting on SUBACK in between.
+ *        Every filter is one request of its own, acknowledged through 'iotx_mqtt_param_t:handle_event'
+ *        with its own ID. The filter strings must stay valid as long as they are subscribed.
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [in] topic_filters: specify the topic filters.
+ * @param [in] filter_num: specify the number of @topic_filters.
+ * @param [in] qos: specify the MQTT Requested QoS.
+ * @param [in] topic_handle_func: specify the topic handle callback-function.
+ * @param [in] pcontext: specify context. When call 'topic_handle_func', it will be passed back.
+ * @param [out] packet_ids: the request IDs, one per sent filter. NULL if not wanted.
+ *
+ * @retval  <0 : Subscribe failed, no filter is sent.
+ * @retval >=0 : Number of filters sent, the first ones of @topic_filters.
+ *               Less than @filter_num when the client runs out of request space, yield and send the rest later.
+ * @see None.
+ */
+int IOT_MQTT_SubscribeMulti(void *handle,
+                            const char *topic_filters[],
+                            int filter_num,
+                            iotx_mqtt_qos_t qos,
+                            iotx_mqtt_event_handle_func_fpt topic_handle_func,
+                            void *pcontext,
+                            int packet_ids[]);
+
+
 /**
  * @brief Unsubscribe MQTT topic.
  *
@@ -299,6 +447,388 @@ int IOT_MQTT_Unsubscribe(void *handle, const char *topic_filter);
  * @see None.
  */
 int IOT_MQTT_Publish(void *handle, const char *topic_name, iotx_mqtt_topic_info_pt topic_msg);
+
+#ifdef MQTT_ASYNC_PUBLISH_ENABLED
+/* Outcome of an asynchronous publish */
+typedef enum {
+    /* QoS0 message written, or QoS1 message acknowledged by PUBACK */
+    IOTX_MQTT_PUBLISH_RESULT_SUCCESS = 0,
+
+    /* No PUBACK to the QoS1 message in three request timeouts */
+    IOTX_MQTT_PUBLISH_RESULT_TIMEOUT = 1,
+
+    /* The message could not be written, or the broker refused it */
+    IOTX_MQTT_PUBLISH_RESULT_FAILED = 2,
+
+    /* The client was destroyed before the message completed */
+    IOTX_MQTT_PUBLISH_RESULT_CANCELLED = 3,
+} iotx_mqtt_publish_result_t;
+
+/**
+ * @brief It define a datatype of function pointer.
+ *        This type of function will be called once per asynchronous publish when it completes,
+ *        from the thread calling IOT_MQTT_YieldAsync() or IOT_MQTT_DestroyAsync().
+ *
+ * @param pcontext : The context given to IOT_MQTT_PublishAsync().
+ * @param packet_id : MQTT packet identifier of a QoS1 message, 0 for QoS0 or when never written.
+ * @param result : The outcome of the publish.
+ *
+ * @return none
+ */
+typedef void (*iotx_mqtt_publish_cb_fpt)(void *pcontext, int packet_id, iotx_mqtt_publish_result_t result);
+
+/**
+ * @brief Construct the MQTT client with an outbound queue for asynchronous publish.
+ *        The client is used with every IOT_MQTT_* function, but it must be yielded by
+ *        IOT_MQTT_YieldAsync() and destroyed by IOT_MQTT_DestroyAsync(). All events are still
+ *        passed to 'iotx_mqtt_param_t:handle_event'.
+ *
+ * @param [in] pInitParams: specify the MQTT client parameter.
+ * @param [in] queue_len: specify how many messages may be queued, and as many may wait for PUBACK.
+ *
+ * @retval     NULL : Construct failed.
+ * @retval NOT_NULL : The handle of MQTT client.
+ * @see None.
+ */
+void *IOT_MQTT_ConstructAsync(iotx_mqtt_param_t *pInitParams, uint32_t queue_len);
+
+/**
+ * @brief Queue a message to specific topic and return at once.
+ *        The topic and payload are copied. The message is written by the next IOT_MQTT_YieldAsync()
+ *        while the connection is up, and 'publish_cb' tells how it ended.
+ *
+ * @param [in] handle: specify the MQTT client constructed by IOT_MQTT_ConstructAsync().
+ * @param [in] topic_name: specify the topic name.
+ * @param [in] topic_msg: specify the topic message, QoS0 or QoS1.
+ * @param [in] publish_cb: specify the completion callback-function, may be NULL.
+ * @param [in] pcontext: specify context. When call 'publish_cb', it will be passed back.
+ *
+ * @retval -1 :  Not queued, the queue is full or a parameter is invalid.
+ * @retval  0 :  Queued, 'publish_cb' will be called exactly once.
+ * @see None.
+ */
+int IOT_MQTT_PublishAsync(void *handle,
+                          const char *topic_name,
+                          iotx_mqtt_topic_info_pt topic_msg,
+                          iotx_mqtt_publish_cb_fpt publish_cb,
+                          void *pcontext);
+
+/**
+ * @brief Write out queued messages, complete timed out ones and do IOT_MQTT_Yield() in between.
+ *        Call it from a single thread in place of IOT_MQTT_Yield().
+ *
+ * @param [in] handle: specify the MQTT client constructed by IOT_MQTT_ConstructAsync().
+ * @param [in] timeout_ms: specify the timeout in millisecond in this loop.
+ *
+ * @return status of the last IOT_MQTT_Yield().
+ * @see None.
+ */
+int IOT_MQTT_YieldAsync(void *handle, int timeout_ms);
+
+/**
+ * @brief Deconstruct the MQTT client constructed by IOT_MQTT_ConstructAsync().
+ *        Messages not completed yet end with IOTX_MQTT_PUBLISH_RESULT_CANCELLED.
+ *
+ * @param [in] phandle: pointer of handle, specify the MQTT client.
+ *
+ * @retval  0 : Deconstruct success.
+ * @retval -1 : Deconstruct failed.
+ * @see None.
+ */
+int IOT_MQTT_DestroyAsync(void **phandle);
+#endif /* MQTT_ASYNC_PUBLISH_ENABLED */
+
+#ifdef MQTT_STORE_ENABLED
+/**
+ * @brief Open the persistent store of QoS1 messages named 'name', with what it kept from before.
+ *        The store lives in HAL_Kv_* values whose keys begin with 'name'.
+ *
+ * @param [in] name: specify the store, 1 to 16 letters, digits or '_'.
+ *
+ * @retval     NULL : Open failed.
+ * @retval NOT_NULL : The handle of store.
+ * @see None.
+ */
+void *IOT_MQTT_StoreOpen(const char *name);
+
+/**
+ * @brief Store a message to specific topic, it is published with QoS1 by the client bound to the store,
+ *        in the order stored, until its PUBACK arrives, across reconnects and reboots.
+ *        It may be called while no client is bound or connected.
+ *
+ * @param [in] store: specify the store opened by IOT_MQTT_StoreOpen().
+ * @param [in] topic_name: specify the topic name.
+ * @param [in] topic_msg: specify the topic message, 'qos' is ignored.
+ *
+ * @retval -1 :  Not stored, the store is full, the message exceeds a segment or a parameter is invalid.
+ * @retval  0 :  Written through to storage.
+ * @see None.
+ */
+int IOT_MQTT_StorePublish(void *store, const char *topic_name, iotx_mqtt_topic_info_pt topic_msg);
+
+/**
+ * @brief Number of stored messages not acknowledged yet.
+ *
+ * @param [in] store: specify the store opened by IOT_MQTT_StoreOpen().
+ *
+ * @retval -1 : The store is invalid.
+ * @retval >=0 : The number of messages.
+ * @see None.
+ */
+int IOT_MQTT_StorePending(void *store);
+
+/**
+ * @brief Close the store, what it holds stays for the next IOT_MQTT_StoreOpen().
+ *
+ * @param [in] pstore: pointer of handle, specify the store not bound to a client.
+ *
+ * @retval  0 : Close success.
+ * @retval -1 : Close failed.
+ * @see None.
+ */
+int IOT_MQTT_StoreClose(void **pstore);
+
+/**
+ * @brief Construct the MQTT client bound to a store, which it then replays.
+ *        The client is used with every IOT_MQTT_* function, but it must be yielded by
+ *        IOT_MQTT_YieldStore() and destroyed by IOT_MQTT_DestroyStore(). All events are still
+ *        passed to 'iotx_mqtt_param_t:handle_event'.
+ *
+ * @param [in] pInitParams: specify the MQTT client parameter.
+ * @param [in] store: specify the store opened by IOT_MQTT_StoreOpen(), one client at a time.
+ *
+ * @retval     NULL : Construct failed.
+ * @retval NOT_NULL : The handle of MQTT client.
+ * @see None.
+ */
+void *IOT_MQTT_ConstructStore(iotx_mqtt_param_t *pInitParams, void *store);
+
+/**
+ * @brief Replay stored messages and do IOT_MQTT_Yield(). Call it in place of IOT_MQTT_Yield().
+ *
+ * @param [in] handle: specify the MQTT client constructed by IOT_MQTT_ConstructStore().
+ * @param [in] timeout_ms: specify the timeout in millisecond in this loop.
+ *
+ * @return status of IOT_MQTT_Yield().
+ * @see None.
+ */
+int IOT_MQTT_YieldStore(void *handle, int timeout_ms);
+
+/**
+ * @brief Deconstruct the MQTT client constructed by IOT_MQTT_ConstructStore().
+ *        Messages not acknowledged stay in the store.
+ *
+ * @param [in] phandle: pointer of handle, specify the MQTT client.
+ *
+ * @retval  0 : Deconstruct success.
+ * @retval -1 : Deconstruct failed.
+ * @see None.
+ */
+int IOT_MQTT_DestroyStore(void **phandle);
+#endif /* MQTT_STORE_ENABLED */
+
+#ifdef MQTT_STREAM_ENABLED
+/**
+ * @brief It define a datatype of function pointer.
+ *        This type of function is called by IOT_MQTT_PublishStream() for the payload, chunk by chunk in order.
+ *
+ * @param pcontext : The context given to IOT_MQTT_PublishStream().
+ * @param offset : Offset in the payload of the first byte wanted.
+ * @param buf : Where to put the bytes.
+ * @param len : How many bytes fit in 'buf', never more than what remains of the payload.
+ *
+ * @return bytes put into 'buf', 1 to 'len'. 0 or negative value aborts the publish.
+ */
+typedef int (*iotx_mqtt_stream_read_fpt)(void *pcontext, uint32_t offset, char *buf, uint32_t len);
+
+/**
+ * @brief Publish a message whose payload is larger than the write buffer, or too large for
+ *        'iotx_mqtt_topic_info_t:payload_len'. The header is framed into the write buffer, which
+ *        then carries the payload as 'read_cb' provides it, so the payload is never held at once.
+ *        Other packets of the client wait until the whole message is written.
+ *        A QoS1 message streamed is not republished by the client, PUBACK is passed to
+ *        'iotx_mqtt_param_t:handle_event' as for IOT_MQTT_Publish().
+ *        If writing fails or 'read_cb' aborts, the connection is reconnected by the next IOT_MQTT_Yield().
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [in] topic_name: specify the topic name.
+ * @param [in] qos: specify the QoS, IOTX_MQTT_QOS0 or IOTX_MQTT_QOS1.
+ * @param [in] retain: specify the retain flag, 0 or 1.
+ * @param [in] payload_len: specify the total length of payload in byte.
+ * @param [in] read_cb: specify the function providing the payload.
+ * @param [in] pcontext: specify context. When call 'read_cb', it will be passed back.
+ *
+ * @retval <0 :  Publish failed.
+ * @retval  0 :  Publish successful, where QoS is 0.
+ * @retval >0 :  Publish successful, where QoS is 1.
+        The value is the packet ID passed back with IOTX_MQTT_EVENT_PUBLISH_SUCCESS.
+ * @see None.
+ */
+int IOT_MQTT_PublishStream(void *handle,
+                           const char *topic_name,
+                           iotx_mqtt_qos_t qos,
+                           uint8_t retain,
+                           uint32_t payload_len,
+                           iotx_mqtt_stream_read_fpt read_cb,
+                           void *pcontext);
+
+/* One piece of a message received by a stream subscription */
+typedef struct {
+    const char     *ptopic;         /* topic name, topic_len bytes */
+    uint16_t        topic_len;
+    uint8_t         qos;
+    uint16_t        packet_id;
+    uint32_t        total_len;      /* length of the whole payload */
+    uint32_t        offset;         /* offset of this piece in the payload */
+    const char     *payload;        /* this piece, valid only during the callback */
+    uint32_t        payload_len;
+    uint8_t         last;           /* 1 for the last piece of the message */
+} iotx_mqtt_stream_fragment_t, *iotx_mqtt_stream_fragment_pt;
+
+/**
+ * @brief It define a datatype of function pointer.
+ *        This type of function is called from IOT_MQTT_Yield() for the pieces of a message, in order.
+ *        A message that fits the read buffer comes as one piece.
+ *
+ * @param pcontext : The context given to IOT_MQTT_SubscribeStream().
+ * @param pclient : The MQTT client.
+ * @param fragment : The piece of the message.
+ *
+ * @return none
+ */
+typedef void (*iotx_mqtt_stream_recv_fpt)(void *pcontext, void *pclient, iotx_mqtt_stream_fragment_pt fragment);
+
+/**
+ * @brief Subscribe MQTT topic and receive its messages in pieces, so messages larger than the
+ *        read buffer are received through it rather than dropped with IOTX_MQTT_EVENT_BUFFER_OVERFLOW.
+ *        The first stream subscription of a client, and the unsubscription of its last, must not
+ *        run while another thread is in IOT_MQTT_Yield() of the client.
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [in] topic_filter: specify the topic filter.
+ * @param [in] qos: specify the MQTT Requested QoS, IOTX_MQTT_QOS0 or IOTX_MQTT_QOS1.
+ * @param [in] fragment_cb: specify the function receiving the pieces.
+ * @param [in] pcontext: specify context. When call 'fragment_cb', it will be passed back.
+ *
+ * @retval -1  : Subscribe failed.
+ * @retval >=0 : Subscribe successful, as IOT_MQTT_Subscribe().
+ * @see None.
+ */
+int IOT_MQTT_SubscribeStream(void *handle,
+                             const char *topic_filter,
+                             iotx_mqtt_qos_t qos,
+                             iotx_mqtt_stream_recv_fpt fragment_cb,
+                             void *pcontext);
+
+/**
+ * @brief Unsubscribe MQTT topic subscribed by IOT_MQTT_SubscribeStream().
+ *        Unsubscribe all of them before IOT_MQTT_Destroy().
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [in] topic_filter: specify the topic filter.
+ *
+ * @retval -1  : Unsubscribe failed.
+ * @retval >=0 : Unsubscribe successful, as IOT_MQTT_Unsubscribe().
+ * @see None.
+ */
+int IOT_MQTT_UnsubscribeStream(void *handle, const char *topic_filter);
+#endif /* MQTT_STREAM_ENABLED */
+
+#ifdef MQTT5_ENABLED
+/**
+ * @brief Construct the MQTT client connecting with MQTT 5.0, as IOT_MQTT_Construct() does with MQTT 3.1.1.
+ *        'session_expiry_s', 'receive_maximum' and 'topic_alias_maximum' of 'pInitParams' go into CONNECT,
+ *        a publish to a topic sent before goes with its 2-byte topic alias instead of the topic,
+ *        and QoS1 publishes wait while as many are unacknowledged as the receive maximum of the server.
+ *        All other calls of the client are used as with IOT_MQTT_Construct().
+ *
+ * @param [in] pInitParams: specify the MQTT client parameter.
+ *
+ * @retval     NULL : Construct failed.
+ * @retval NOT_NULL : The handle of MQTT client.
+ * @see None.
+ */
+void *IOT_MQTT_ConstructV5(iotx_mqtt_param_t *pInitParams);
+
+/**
+ * @brief Deconstruct the MQTT client constructed by IOT_MQTT_ConstructV5().
+ *
+ * @param [in,out] phandle: specify the pointer of MQTT client, set to NULL when destroyed.
+ *
+ * @retval < 0  : Deconstruct failed.
+ * @retval   0  : Deconstruct success.
+ * @see None.
+ */
+int IOT_MQTT_DestroyV5(void **phandle);
+#endif /* MQTT5_ENABLED */
+
+#ifdef MQTT_IO_THREAD_ENABLED
+/**
+ * @brief Construct the MQTT client run by an I/O thread of its own, IOT_MQTT_Yield() is not called on it.
+ *        The I/O thread reads, keeps alive and reconnects, and with MQTT_ASYNC_PUBLISH_ENABLED
+ *        writes the queue of IOT_MQTT_PublishAsync() too.
+ *        The event handler of 'pInitParams' and the handlers given to IOT_MQTT_SubscribeThread()
+ *        are called from one callback thread on copies of the events and messages,
+ *        a handler taking long delays the other handlers but not the I/O thread.
+ *        IOT_MQTT_Publish() and IOT_MQTT_CheckStateNormal() are used as with IOT_MQTT_Construct().
+ *
+ * @param [in] pInitParams: specify the MQTT client parameter.
+ *
+ * @retval     NULL : Construct failed.
+ * @retval NOT_NULL : The handle of MQTT client.
+ * @see None.
+ */
+void *IOT_MQTT_ConstructThread(iotx_mqtt_param_t *pInitParams);
+
+/**
+ * @brief Subscribe MQTT topic on the client constructed by IOT_MQTT_ConstructThread(),
+ *        'topic_handle_func' is called from the callback thread.
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [in] topic_filter: specify the topic filter.
+ * @param [in] qos: specify the MQTT Requested QoS.
+ * @param [in] topic_handle_func: specify the topic handle callback-function.
+ * @param [in] pcontext: specify context. When call 'topic_handle_func', it will be passed back.
+ *
+ * @retval -1  : Subscribe failed.
+ * @retval >=0 : Subscribe successful.
+          The value is a unique ID of this request.
+          The ID will be passed back when callback 'iotx_mqtt_param_t:handle_event'.
+ * @see None.
+ */
+int IOT_MQTT_SubscribeThread(void *handle,
+                             const char *topic_filter,
+                             iotx_mqtt_qos_t qos,
+                             iotx_mqtt_event_handle_func_fpt topic_handle_func,
+                             void *pcontext);
+
+/**
+ * @brief Unsubscribe MQTT topic subscribed by IOT_MQTT_SubscribeThread().
+ *
+ * @param [in] handle: specify the MQTT client.
+ * @param [in] topic_filter: specify the topic filter.
+ *
+ * @retval -1  : Unsubscribe failed.
+ * @retval >=0 : Unsubscribe successful.
+          The value is a unique ID of this request.
+          The ID will be passed back when callback 'iotx_mqtt_param_t:handle_event'.
+ * @see None.
+ */
+int IOT_MQTT_UnsubscribeThread(void *handle, const char *topic_filter);
+
+/**
+ * @brief Deconstruct the MQTT client constructed by IOT_MQTT_ConstructThread(),
+ *        waiting for both threads to end. Events and messages not handled yet are dropped.
+ *        It must not be called from a handler of the client.
+ *
+ * @param [in,out] phandle: specify the pointer of MQTT client, set to NULL when destroyed.
+ *
+ * @retval < 0  : Deconstruct failed.
+ * @retval   0  : Deconstruct success.
+ * @see None.
+ */
+int IOT_MQTT_DestroyThread(void **phandle);
+#endif /* MQTT_IO_THREAD_ENABLED */
 /* From mqtt_client.h */
 /** @} */ /* end of api_mqtt */
 
@@ -0,0 +1,47 @@
+#ifndef OTA_CACHE_EXPORT_H
+#define OTA_CACHE_EXPORT_H
+
+#include <stdint.h>
+
+/*
+ * Firmware of sub-devices kept by a gateway in the slots of HAL_Firmware_Cache_Write(), by product key, version
+ * and md5. The sub-devices of a product upgraded to the same version share one download, fetched by ranges and
+ * gone on with from where it broke, then read from the cache by chunks each sent to all of them over the local link.
+ */
+
+/* sends the chunk at offset of an image of size bytes to the sub-device of handle, 0 when it took it */
+typedef int (*iotx_ota_cache_send_fpt)(void *handle, uint32_t size, uint32_t offset, const char *data, uint32_t length);
+
+/**
+ * @brief Serve the upgrades announced to an OTA handle of a sub-device from the cache.
+ *        Call it after IOT_OTA_Init() of the sub-device, before its upgrade arrives.
+ * @param [in] handle: the OTA handle of the sub-device.
+ * @param [in] product_key: the product key of the sub-device.
+ * @retval  0 : Successful.
+ * @retval -1 : Failed.
+ */
+int IOT_OTA_CacheBind(void *handle, const char *product_key);
+
+/**
+ * @brief Stop serving the upgrades of handle from the cache, before IOT_OTA_Deinit() of it.
+ * @param [in] handle: the OTA handle bound.
+ * @retval  0 : Successful.
+ * @retval -1 : It is not bound.
+ */
+int IOT_OTA_CacheUnbind(void *handle);
+
+/**
+ * @brief Send the upgrade announced to each of handles through send. The image of each product, version and md5
+ *        is fetched into the cache unless it is there already, then each chunk of it is read once into buf and sent
+ *        to every sub-device upgraded to it in turn. The progress of each is reported by IOT_OTA_ReportProgress().
+ *        A sub-device send fails for is left out of the rest, the others go on.
+ * @param [in] handles: OTA handles bound, those not IOT_OTA_IsFetching() are left out.
+ * @param [in] count: of handles.
+ * @param [in] buf: for a chunk.
+ * @param [in] buf_len: length of buf.
+ * @param [in] send: sends a chunk to a sub-device.
+ * @return The number of sub-devices sent their whole image, -1 when the parameters are invalid.
+ */
+int IOT_OTA_CacheFanOut(void *handles[], int count, char *buf, uint32_t buf_len, iotx_ota_cache_send_fpt send);
+
+#endif /* OTA_CACHE_EXPORT_H */
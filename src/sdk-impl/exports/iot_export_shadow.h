@@ -42,10 +42,16 @@ typedef enum {
     IOTX_SHADOW_RW
 } iotx_shadow_datamode_t;
 
+/* what pattr_data points to for each type */
 typedef enum {
     IOTX_SHADOW_NULL,
-    IOTX_SHADOW_INT32,
-    IOTX_SHADOW_STRING,
+    IOTX_SHADOW_INT32,                      /* int32_t */
+    IOTX_SHADOW_STRING,                     /* char[], a delivered value is copied without a '\0' */
+    IOTX_SHADOW_INT64,                      /* int64_t */
+    IOTX_SHADOW_FLOAT,                      /* float */
+    IOTX_SHADOW_DOUBLE,                     /* double */
+    IOTX_SHADOW_BOOL,                       /* int32_t, 0 for false */
+    IOTX_SHADOW_JSON,                       /* char[] of json put in as it is, copied as STRING is */
 } iotx_shadow_attr_datatype_t;
 
 typedef struct {
@@ -122,6 +128,17 @@ iotx_err_t IOT_Shadow_Destroy(void *handle);
  */
 void IOT_Shadow_Yield(void *handle, uint32_t timeout_ms);
 
+/**
+ * @brief Milliseconds till IOT_Shadow_Yield() has something to do besides what comes from the cloud:
+ *        an UPDATE ACK timed out, changed attributes to push, or what IOT_MQTT_GetTimeout() of the
+ *        MQTT client tells. Yielding for that long lets the CPU sleep till then or till a packet comes.
+ *
+ * @param [in] handle: The handle of device shaodw.
+ * @return The milliseconds, 0 when due now, 0xFFFFFFFF when nothing is waited for.
+ * @see None.
+ */
+uint32_t IOT_Shadow_GetTimeout(void *handle);
+
 /**
  * @brief Create a data type registered to the server.
  *
@@ -225,9 +242,44 @@ int IOT_Shadow_Push_Async(
             iotx_push_cb_fpt cb_fpt,
             void *pcontext);
 
+/**
+ * @brief Have the attribute pushed with the others changed, by IOT_Shadow_Yield().
+ *        The update holds only the attributes changed since the last one acked, changes within the push window
+ *        go in one update, and one such update is in flight at a time. While it is, or while the UPDATE ACK list
+ *        is full, the changes wait. What a failed update held is pushed again.
+ *
+ * @param [in] handle: The handle of device shadow.
+ * @param [in] pattr: The registered attribute whose value is changed.
+ * @retval SUCCESS_RETURN : Success.
+ * @retval          other : See iotx_err_t.
+ * @see IOT_Shadow_Push_Config.
+ */
+iotx_err_t IOT_Shadow_Push_Changed(void *handle, iotx_shadow_attr_pt pattr);
+
+/**
+ * @brief Configure the updates IOT_Shadow_Push_Changed() leads to.
+ *
+ * @param [in] handle: The handle of device shadow.
+ * @param [in] window_ms: Changes within it after the first are pushed in one update, 200 by default.
+ * @param [in] timeout_s: Specify the timeout value of each update in second, 10 by default.
+ * @param [in] cb_fpt: Called with the ack_code of each update, may be NULL.
+ * @param [in] pcontext: Specify the context which passed to the callback function.
+ * @retval SUCCESS_RETURN : Success.
+ * @retval          other : See iotx_err_t.
+ * @see None.
+ */
+iotx_err_t IOT_Shadow_Push_Config(
+            void *handle,
+            uint32_t window_ms,
+            uint16_t timeout_s,
+            iotx_push_cb_fpt cb_fpt,
+            void *pcontext);
+
 /**
  * @brief Synchronize device shadow data from cloud.
  *        It is a synchronous interface.
+ *        Once a shadow document is applied, only the changes since its version are asked for,
+ *        and a reply whose version is not newer than it leaves the attributes alone.
  * @param [in] handle: The handle of device shaodw.
  * @retval SUCCESS_RETURN : Success.
  * @retval          other : See iotx_err_t.
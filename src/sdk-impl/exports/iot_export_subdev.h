@@ -25,7 +25,9 @@
 #define IOT_SUBDEVICE_CLIENT_ID_LEN     64
 
 
-/* option defined for gateway support multi-thread */
+/* option defined for gateway support multi-thread,
+ * the subdevice APIs may then be called from several threads, but not for a subdevice
+ * from one thread while it logs out from another, whose session is reused by the next login */
 /*#define IOT_GATEWAY_SUPPORT_MULTI_THREAD*/
 
 /* Topic maximum length value */
@@ -123,6 +125,44 @@ typedef void (*rrpc_request_callback)(void* gateway,
         const char* message_id, 
         const char* payload);
 
+/**
+ * @brief It define a datatype of function pointer.
+ *        This type of function will be called once when a request of
+ *        IOT_Subdevice_Register_Async/IOT_Subdevice_Login_Async/IOT_Subdevice_Logout_Async completes,
+ *        from the thread calling IOT_Gateway_Yield().
+ *
+ * @param gateway : The gateway.
+ * @param product_key : The product key of the subdevice.
+ * @param device_name : The device name of the subdevice.
+ * @param result : 0, success; ERROR_REPLY_TIMEOUT, no reply in time;
+ *                 FAIL_RETURN, the gateway is destroyed first; others, as the synchronous call returns.
+ * @param pcontext : The context given to the request.
+ *
+ * @return none
+ */
+typedef void (*iotx_subdev_reply_fpt)(void* gateway,
+        const char* product_key,
+        const char* device_name,
+        int result,
+        void* pcontext);
+
+/**
+ * @brief It define a datatype of function pointer.
+ *        This type of function will be called for each subdevice of the topology by
+ *        IOT_Gateway_Get_TOPO_Paged(), from the thread calling it.
+ *
+ * @param gateway : The gateway.
+ * @param product_key : The product key of the subdevice.
+ * @param device_name : The device name of the subdevice.
+ * @param pcontext : The context given to IOT_Gateway_Get_TOPO_Paged().
+ *
+ * @return 0, go on; others, stop after this subdevice.
+ */
+typedef int (*iotx_subdev_topo_fpt)(void* gateway,
+        const char* product_key,
+        const char* device_name,
+        void* pcontext);
+
 /**
  * @brief It define a datatype of function pointer.
  *        This type of function will be called when a related event occur.
@@ -138,6 +178,17 @@ typedef void (*rrpc_request_callback)(void* gateway,
 typedef void (*iotx_subdev_event_handle_func_fpt)(void *pcontext, void *pclient, void* msg);
 
 
+/* A subdevice of IOT_Subdevice_Register_Batch()/IOT_Subdevice_Login_Batch() */
+typedef struct {
+    const char*                         product_key;
+    const char*                         device_name;
+    const char*                         timestamp;                   /* NULL to log in a dynamically registered one */
+    const char*                         client_id;                   /* NULL to log in a dynamically registered one */
+    const char*                         sign;                        /* NULL to log in a dynamically registered one */
+    int                                 result;                      /* out, 0 or what the single device call returns */
+} iotx_subdev_batch_item_t, *iotx_subdev_batch_item_pt;
+
+
 /* The structure of gateway param */
 typedef struct {
     iotx_mqtt_param_pt                  mqtt;                        /* MQTT params */    
@@ -145,6 +196,34 @@ typedef struct {
      * must set the event_handler and event pcontext */
     void*                               event_pcontext;              /* the user of gateway */
     iotx_subdev_event_handle_func_fpt   event_handler;               /* event handler for gateway user*/
+    /* The subdevices logged in before a reconnect are logged in again in batches after it.
+     * restore_handler is called for each of them once its login completes, so the gateway
+     * can go on with the ones restored, and a last time with NULL product_key and device_name
+     * when all are done, result 0 if every one is logged in again. The ones not restored stay
+     * registered, IOT_Subdevice_Login() with NULL timestamp, client_id and sign retries them. */
+    void*                               restore_pcontext;
+    iotx_subdev_reply_fpt               restore_handler;             /* NULL if not wanted */
+    /* IOT_Gateway_Post_Property() packs the posts of many subdevices into one packet, sent when
+     * the next post does not fit in pack_len_max or pack_latency_ms after the first */
+    uint32_t                            pack_len_max;                /* 0 for the default, 1024 */
+    uint32_t                            pack_latency_ms;             /* 0 for the default, 200 */
+    /* The gateway device the mqtt params connect as, NULL for the one of IOT_SetupConnInfo(). Each
+     * IOT_Gateway_Construct() makes a gateway of its own, many of them run in one process, yielded
+     * by one thread or each by its own, and share the thread of the rrpc callbacks. They are
+     * constructed and destroyed from one thread. With SUBDEV_VIA_CLOUD_CONN the connection is made
+     * for the device of IOT_SetupConnInfo() whatever they are. */
+    const char*                         product_key;
+    const char*                         device_name;
+    /* Extra connections of the gateway, 8 at most, which a broker limiting each connection and
+     * one TLS stream no longer cap. A subdevice is hashed by product_key and device_name to one of
+     * them or to mqtt, IOT_Gateway_Publish(), IOT_Gateway_Subscribe() and IOT_Gateway_Unsubscribe()
+     * of its topics go over that one, so its messages keep their order, and a shard added or removed
+     * moves only the subdevices hashed to it. Publishes go over mqtt while the shard is down, the
+     * subscriptions are made again when it reconnects without the session. Login, logout, rrpc and
+     * the other requests of the gateway stay on mqtt. The brokers must take the connections of one
+     * gateway together, each shard_mqtt has its own client_id. Not with SUBDEV_VIA_CLOUD_CONN. */
+    iotx_mqtt_param_pt                  shard_mqtt;                  /* shard_num params */
+    int                                 shard_num;                   /* 0 for mqtt alone */
 } iotx_gateway_param_t, *iotx_gateway_param_pt;
 
 
@@ -268,6 +347,130 @@ int IOT_Subdevice_Logout(void* handle,
         const char* device_name);
 
 
+/**
+ * @brief Subdevice register in batch, static register only
+ *        This function splices the TOPO_ADD of many subdevices into as few packets as fit in
+ *        the MQTT write buffer, publishes them all and waits for the replies.
+ *        A subdevice gets the code of its entry in the "data" of the reply if there is one,
+ *        the code of the reply otherwise.
+ *
+ * @param pointer of handle, specify the gateway construction.
+ * @param subdevices, with timestamp, client_id and sign, 'result' of each is set.
+ * @param number of subdevices.
+ * @param sign_method.
+ *
+ * @return >= 0, number of subdevices registered; < 0, parameter error.
+ */
+int IOT_Subdevice_Register_Batch(void* handle, 
+        iotx_subdev_batch_item_pt items,
+        int count,
+        iotx_subdev_sign_method_types_t sign_type);
+
+
+/**
+ * @brief Subdevice login in batch
+ *        This function splices the LOGIN of many subdevices into as few packets as fit in
+ *        the MQTT write buffer, publishes them all and waits for the replies, then subscribes
+ *        the topics of the subdevices logged in.
+ *        A subdevice gets the code of its entry in the "data" of the reply if there is one,
+ *        the code of the reply otherwise.
+ *
+ * @param pointer of handle, specify the Gateway.
+ * @param subdevices, 'result' of each is set.
+ * @param number of subdevices.
+ * @param sign method,  HmacSha1 or HmacMd5.      
+ * @param clean session, ture or false.
+ *
+ * @return >= 0, number of subdevices logged in; < 0, parameter error.
+ */
+int IOT_Subdevice_Login_Batch(void* handle,
+        iotx_subdev_batch_item_pt items,
+        int count,
+        iotx_subdev_sign_method_types_t sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type);
+
+
+/**
+ * @brief Subdevice register, asynchronous
+ *        This function does what IOT_Subdevice_Register does, but returns once the first packet
+ *        is published. The reply is waited for in IOT_Gateway_Yield, which calls 'callback' with the result.
+ *        Requests of different subdevices may be in flight together, IOTX_GATEWAY_PENDING_NUM at most.
+ *
+ * @param pointer of handle, specify the gateway construction.
+ * @param register type.
+ * @param product key.
+ * @param device name.
+ * @param timestamp.           [if type = dynamic, must be NULL ]
+ * @param client_id.           [if type = dynamic, must be NULL ]
+ * @param sign.                [if type = dynamic, must be NULL ]
+ * @param sign_method.
+ * @param callback, called once the request completes.
+ * @param pcontext, passed back to 'callback'.
+ *
+ * @return 0, request published; < 0, failed and 'callback' will not be called.
+ */
+int IOT_Subdevice_Register_Async(void* handle, 
+        iotx_subdev_register_types_t type, 
+        const char* product_key, 
+        const char* device_name,
+        const char* timestamp, 
+        const char* client_id, 
+        const char* sign,
+        iotx_subdev_sign_method_types_t sign_type,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext);
+
+
+/**
+ * @brief Subdevice login, asynchronous
+ *        This function does what IOT_Subdevice_Login does, but returns once the LOGIN packet
+ *        is published. The reply is waited for in IOT_Gateway_Yield, which calls 'callback' with the result.
+ *
+ * @param pointer of handle, specify the Gateway.
+ * @param product key.
+ * @param device name.
+ * @param timestamp.           [if register_type = dynamic, must be NULL ]
+ * @param client_id.           [if register_type = dynamic, must be NULL ]
+ * @param sign.                [if register_type = dynamic, must be NULL ] 
+ * @param sign method,  HmacSha1 or HmacMd5.      
+ * @param clean session, ture or false.
+ * @param callback, called once the request completes.
+ * @param pcontext, passed back to 'callback'.
+ *
+ * @return 0, request published; < 0, failed and 'callback' will not be called.
+ */
+int IOT_Subdevice_Login_Async(void* handle,
+        const char* product_key, 
+        const char* device_name, 
+        const char* timestamp, 
+        const char* client_id, 
+        const char* sign, 
+        iotx_subdev_sign_method_types_t sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext);
+
+
+/**
+ * @brief Subdevice logout, asynchronous
+ *        This function does what IOT_Subdevice_Logout does, but returns once the LOGOUT packet
+ *        is published. The reply is waited for in IOT_Gateway_Yield, which calls 'callback' with the result.
+ *
+ * @param pointer of handle, specify the Gateway.
+ * @param product key.
+ * @param device name.
+ * @param callback, called once the request completes.
+ * @param pcontext, passed back to 'callback'.
+ *
+ * @return 0, request published; < 0, failed and 'callback' will not be called.
+ */
+int IOT_Subdevice_Logout_Async(void* handle, 
+        const char* product_key, 
+        const char* device_name,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext);
+
+
 /**
  * @brief Gateway get topo
  *        This function publish a packet with topo/get topic and wait for the reply (with TOPO_GET_REPLY topic).
@@ -282,6 +485,25 @@ int IOT_Gateway_Get_TOPO(void* handle,
         char* get_topo_reply, 
         uint32_t* length);
 
+/**
+ * @brief Gateway get topo page by page
+ *        This function asks for the topo with pageSize/pageNo from page 1 on, one page at a time, and
+ *        hands the subdevices of each page to 'callback' as it is parsed. Only one page is kept at once
+ *        whatever the size of the topo, and it may be larger than REPLY_MESSAGE_LEN_MAX, but not
+ *        than the MQTT read buffer. A page of less than 'page_size' subdevices is the last one.
+ *
+ * @param pointer of handle, specify the Gateway.
+ * @param page_size, subdevices of a page, 0 for IOTX_GATEWAY_TOPO_PAGE_SIZE.
+ * @param callback, called for each subdevice.
+ * @param pcontext, passed back to 'callback'.
+ *
+ * @return >= 0, the subdevices handed to 'callback'; < 0, a page failed.
+ */
+int IOT_Gateway_Get_TOPO_Paged(void* handle,
+        uint32_t page_size,
+        iotx_subdev_topo_fpt callback,
+        void* pcontext);
+
 /**
  * @brief Gateway get config
  *        This function publish a packet with config/get topic and wait for the reply (with CONFIG_GET_REPLY topic).
@@ -307,6 +529,64 @@ int IOT_Gateway_Get_Config(void* handle,
 int IOT_Gateway_Publish_Found_List(void* handle, const char* product_key, 
     const char* device_name);
 
+/**
+ * @brief Gateway report a found subdevice, batched
+ *        This function queues a subdevice discovered for a thing.list.found of many subdevices of the
+ *        gateway. One with a session on the gateway, or queued in the last 60s, is skipped. The packet goes out
+ *        when the next subdevice does not fit in pack_len_max, from IOT_Gateway_Yield once pack_latency_ms
+ *        passed since its first subdevice, or with IOT_Gateway_Found_List_Flush. No reply is waited for.
+ *
+ * @param pointer of handle, specify the Gateway.
+ * @param product key.
+ * @param device name.
+ *
+ * @return 0, queued or skipped; others, failed.
+ */
+int IOT_Gateway_Found_List_Add(void* handle,
+        const char* product_key,
+        const char* device_name);
+
+/**
+ * @brief Gateway flush the found subdevices
+ *        This function publishes the subdevices IOT_Gateway_Found_List_Add queued, if any.
+ *
+ * @param pointer of handle, specify the Gateway.
+ *
+ * @return 0, published or nothing queued; others, failed, the subdevices are dropped.
+ */
+int IOT_Gateway_Found_List_Flush(void* handle);
+
+
+/**
+ * @brief Subdevice post property, packed
+ *        This function queues the properties of a subdevice logged in for a thing.event.property.pack.post
+ *        of the gateway. The packet goes out when the next post does not fit in it, from IOT_Gateway_Yield
+ *        once pack_latency_ms passed since its first post, or with IOT_Gateway_Post_Property_Flush.
+ *        No reply is waited for.
+ *
+ * @param pointer of handle, specify the Gateway.
+ * @param product_key, the subdevice.
+ * @param device_name, the subdevice.
+ * @param properties, the "params" of its thing.event.property.post,
+ *        e.g. {"Power":{"value":"on","time":1524448722000}}.
+ *
+ * @return 0, queued; ERROR_SUBDEV_MSG_LEN, the post alone does not fit in a packet; others, failed.
+ */
+int IOT_Gateway_Post_Property(void* handle,
+        const char* product_key,
+        const char* device_name,
+        const char* properties);
+
+/**
+ * @brief Gateway flush the packed property posts
+ *        This function publishes the property posts IOT_Gateway_Post_Property queued, if any.
+ *
+ * @param pointer of handle, specify the Gateway.
+ *
+ * @return 0, published or nothing queued; others, failed, the posts are dropped.
+ */
+int IOT_Gateway_Post_Property_Flush(void* handle);
+
 
 /**
  * @brief Gateway Yield
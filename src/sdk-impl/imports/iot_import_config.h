@@ -17,4 +17,221 @@
     #define CONFIG_COAP_AUTH_TIMEOUT    (10 * 1000)
 #endif
 
+/* an auth token of HTTP or CoAP is taken to last this long when it does not tell */
+#ifndef CONFIG_AUTH_TOKEN_LIFETIME
+    #define CONFIG_AUTH_TOKEN_LIFETIME  (48 * 3600 * 1000ULL)
+#endif
+
+/* and is refreshed this long before it lapses, again this much later after a refresh failed */
+#ifndef CONFIG_AUTH_TOKEN_REFRESH
+    #define CONFIG_AUTH_TOKEN_REFRESH   (3600 * 1000)
+#endif
+
+#ifndef CONFIG_AUTH_TOKEN_RETRY
+    #define CONFIG_AUTH_TOKEN_RETRY     (60 * 1000)
+#endif
+
+/* with PAYLOAD_COMPRESS_ENABLED raw uplinks this long or longer go out compressed */
+#ifndef CONFIG_PAYLOAD_COMPRESS_MIN
+    #define CONFIG_PAYLOAD_COMPRESS_MIN         (1024)
+#endif
+
+/* the compressor finds matches in a table of 2 bytes per entry on the stack, 1 << this many entries */
+#ifndef CONFIG_PAYLOAD_COMPRESS_HASH_BITS
+    #define CONFIG_PAYLOAD_COMPRESS_HASH_BITS   (10)
+#endif
+
+/* with TSL_CACHE_ENABLED a tsl got from cloud is kept in kv when its record is no longer than this */
+#ifndef CONFIG_TSL_CACHE_MAXLEN
+    #define CONFIG_TSL_CACHE_MAXLEN             (4096)
+#endif
+
+/* with REGION_AUTO_ENABLED the MQTT endpoints of the regions are connected to on this port */
+#ifndef CONFIG_REGION_PROBE_PORT
+    #define CONFIG_REGION_PROBE_PORT            (1883)
+#endif
+
+/* the ranking of the regions is kept this long before they are probed again */
+#ifndef CONFIG_REGION_CACHE_TTL
+    #define CONFIG_REGION_CACHE_TTL             (7 * 24 * 3600 * 1000ULL)
+#endif
+
+/* a network moves on to the next region after this many connects in a row failed */
+#ifndef CONFIG_REGION_FAILOVER_FAILS
+    #define CONFIG_REGION_FAILOVER_FAILS        (3)
+#endif
+
+/* with LOCAL_CONTROL_ENABLED the local control channel takes CoAP requests of the LAN on this UDP port */
+#ifndef CONFIG_LOCAL_CONTROL_PORT
+    #define CONFIG_LOCAL_CONTROL_PORT           (5683)
+#endif
+
+/* a LAN request not answered in this long is dropped, its peer gets no answer */
+#ifndef CONFIG_LOCAL_CONTROL_ANSWER_TIMEOUT
+    #define CONFIG_LOCAL_CONTROL_ANSWER_TIMEOUT (10 * 1000)
+#endif
+
+/* the CMP yield waits in slices this long, a LAN request waits for the slice it came in at most */
+#ifndef CONFIG_LOCAL_CONTROL_POLL_MS
+    #define CONFIG_LOCAL_CONTROL_POLL_MS        (50)
+#endif
+
+/* property sets answered on the LAN and not yet posted to the cloud at most, the oldest goes when one more comes */
+#ifndef CONFIG_LOCAL_CONTROL_SYNC_MAX
+    #define CONFIG_LOCAL_CONTROL_SYNC_MAX       (8)
+#endif
+
+/* with DM_CHANNELS_ENABLED uplinks routed to CoAP or HTTP waiting to be sent at most per channel, one more is refused */
+#ifndef CONFIG_DM_CHANNEL_QUEUE_MAX
+    #define CONFIG_DM_CHANNEL_QUEUE_MAX         (16)
+#endif
+
+/* uplinks a channel sends per yield at most, the next yield starts from the next channel */
+#ifndef CONFIG_DM_CHANNEL_SEND_PER_YIELD
+    #define CONFIG_DM_CHANNEL_SEND_PER_YIELD    (4)
+#endif
+
+/* the CMP yield waits in slices this long while routes are set, the CoAP client waits as long for responses */
+#ifndef CONFIG_DM_CHANNEL_POLL_MS
+    #define CONFIG_DM_CHANNEL_POLL_MS           (50)
+#endif
+
+/* an HTTP request of the HTTP channel waits this long for the server at most */
+#ifndef CONFIG_DM_CHANNEL_HTTP_TIMEOUT
+    #define CONFIG_DM_CHANNEL_HTTP_TIMEOUT      (5 * 1000)
+#endif
+
+/* a CoAP request not answered in this long is given up, past the last retransmission of the CoAP client */
+#ifndef CONFIG_DM_CHANNEL_COAP_TIMEOUT
+    #define CONFIG_DM_CHANNEL_COAP_TIMEOUT      (120 * 1000)
+#endif
+
+/* a channel not connected is connected again after this long, doubled per failure up to CONFIG_DM_CHANNEL_RETRY_MAX */
+#ifndef CONFIG_DM_CHANNEL_RETRY_MIN
+    #define CONFIG_DM_CHANNEL_RETRY_MIN         (1000)
+#endif
+
+#ifndef CONFIG_DM_CHANNEL_RETRY_MAX
+    #define CONFIG_DM_CHANNEL_RETRY_MAX         (60 * 1000)
+#endif
+
+/* with DM_OFFLINE_ENABLED property posts failed are kept in blocks of this many bytes, one kv value each when persisted */
+#ifndef CONFIG_DM_OFFLINE_BLOCK_SIZE
+    #define CONFIG_DM_OFFLINE_BLOCK_SIZE        (512)
+#endif
+
+/* blocks kept at most, the oldest is dropped for a new one once they are all full */
+#ifndef CONFIG_DM_OFFLINE_BLOCKS
+    #define CONFIG_DM_OFFLINE_BLOCKS            (8)
+#endif
+
+/* 1 keeps the full blocks in kv through reboots, 0 in RAM */
+#ifndef CONFIG_DM_OFFLINE_KV
+    #define CONFIG_DM_OFFLINE_KV                (0)
+#endif
+
+/* float and double values are kept with this many decimals */
+#ifndef CONFIG_DM_OFFLINE_DECIMALS
+    #define CONFIG_DM_OFFLINE_DECIMALS          (3)
+#endif
+
+/* after a reconnect the values kept go in history posts this far apart, of this many values at most */
+#ifndef CONFIG_DM_OFFLINE_REPLAY_INTERVAL
+    #define CONFIG_DM_OFFLINE_REPLAY_INTERVAL   (1000)
+#endif
+
+#ifndef CONFIG_DM_OFFLINE_REPLAY_RECORDS
+    #define CONFIG_DM_OFFLINE_REPLAY_RECORDS    (32)
+#endif
+
+/* alert and error events not sent kept for the reconnect at most, the oldest of the lowest class goes first */
+#ifndef CONFIG_DM_UPLINK_PRIORITY_PENDING
+    #define CONFIG_DM_UPLINK_PRIORITY_PENDING   (8)
+#endif
+
+/* ms between tries of the events kept while connected */
+#ifndef CONFIG_DM_UPLINK_PRIORITY_RETRY_INTERVAL
+    #define CONFIG_DM_UPLINK_PRIORITY_RETRY_INTERVAL    (1000)
+#endif
+
+/* the connection counts as saturated with fewer QoS1 slots free, the others are left to acked requests and OTA */
+#ifndef CONFIG_DM_BACKPRESSURE_MIN_SLOTS
+    #define CONFIG_DM_BACKPRESSURE_MIN_SLOTS    (4)
+#endif
+
+/* or with more bytes waiting for their PUBACK */
+#ifndef CONFIG_DM_BACKPRESSURE_MAX_BYTES
+    #define CONFIG_DM_BACKPRESSURE_MAX_BYTES    (8192)
+#endif
+
+/* or when the last send waited this many ms for the socket */
+#ifndef CONFIG_DM_BACKPRESSURE_WRITE_MS
+    #define CONFIG_DM_BACKPRESSURE_WRITE_MS     (200)
+#endif
+
+/* coalesced property posts go this many min intervals apart at most while saturated */
+#ifndef CONFIG_DM_BACKPRESSURE_MAX_BACKOFF
+    #define CONFIG_DM_BACKPRESSURE_MAX_BACKOFF  (8)
+#endif
+
+/* ms between checks of the budget while a producer waits for writable */
+#ifndef CONFIG_DM_BACKPRESSURE_POLL_INTERVAL
+    #define CONFIG_DM_BACKPRESSURE_POLL_INTERVAL    (100)
+#endif
+
+/* rrpc requests waiting for their answers at most, a request past it pushes out the oldest */
+#ifndef CONFIG_DM_RRPC_PENDING
+    #define CONFIG_DM_RRPC_PENDING              (8)
+#endif
+
+/* ms a rrpc request can be answered in, the cloud gives up on it after that */
+#ifndef CONFIG_DM_RRPC_TIMEOUT_MS
+    #define CONFIG_DM_RRPC_TIMEOUT_MS           (8000)
+#endif
+
+/* ms deviceinfo updates and deletes of a thing are merged in before one request is sent, 0 sends at once */
+#ifndef CONFIG_DM_DEVICEINFO_MERGE_MS
+    #define CONFIG_DM_DEVICEINFO_MERGE_MS       (500)
+#endif
+
+/* 1 keeps the deviceinfo acked in kv through reboots, 0 in RAM */
+#ifndef CONFIG_DM_DEVICEINFO_KV
+    #define CONFIG_DM_DEVICEINFO_KV             (0)
+#endif
+
+/* bytes of the deviceinfo acked of a thing kept in kv at most, keys past it are sent again after reboot */
+#ifndef CONFIG_DM_DEVICEINFO_KV_MAXLEN
+    #define CONFIG_DM_DEVICEINFO_KV_MAXLEN      (512)
+#endif
+
+/* ms of idle a ping of the adaptive keep-alive is known to be answered after on any network */
+#ifndef CONFIG_MQTT_KEEPALIVE_MIN_MS
+    #define CONFIG_MQTT_KEEPALIVE_MIN_MS        (30000)
+#endif
+
+/* the adaptive keep-alive probes till it knows the longest idle a ping is answered after to this many ms */
+#ifndef CONFIG_MQTT_KEEPALIVE_STEP_MS
+    #define CONFIG_MQTT_KEEPALIVE_STEP_MS       (15000)
+#endif
+
+/* a ping of the adaptive keep-alive not answered in this many ms lost the connection */
+#ifndef CONFIG_MQTT_KEEPALIVE_ANSWER_MS
+    #define CONFIG_MQTT_KEEPALIVE_ANSWER_MS     (10000)
+#endif
+
+/* bytes of the smallest buffer of the pool of growable MQTT buffers, the classes double up to 128 times it */
+#ifndef CONFIG_MQTT_BUFFER_CLASS_MIN
+    #define CONFIG_MQTT_BUFFER_CLASS_MIN        (1024)
+#endif
+
+/* a growable MQTT buffer no packet needed for this many ms goes back to the pool, and is freed there after as many */
+#ifndef CONFIG_MQTT_BUFFER_IDLE_MS
+    #define CONFIG_MQTT_BUFFER_IDLE_MS          (30000)
+#endif
+
+/* images of sub-device firmware a gateway keeps in HAL_Firmware_Cache_Write() slots at once */
+#ifndef CONFIG_OTA_CACHE_SLOTS
+    #define CONFIG_OTA_CACHE_SLOTS              (2)
+#endif
+
 #endif  /* __IOT_IMPORT_CONFIG_H__ */
@@ -83,7 +83,9 @@ typedef void DTLSContext;
    @endverbatim
  * @return DSSL handle.
  * @see None.
- * @note None.
+ * @note The session of the last successful handshake should outlive HAL_DTLSSession_free, so that the next
+ *       connection to the same host and port resumes it by session ticket or id instead of a full handshake.
+ *       When the TLS stack supports it, the connection ID extension (RFC 9146) should be negotiated too.
  */
 DTLSContext *HAL_DTLSSession_create(coap_dtls_options_t  *p_options);
 
@@ -137,6 +139,19 @@ unsigned int HAL_DTLSSession_read(DTLSContext *context,
  */
 unsigned int HAL_DTLSSession_free(DTLSContext *context);
 
+#ifdef HAL_NET_STATS_ENABLED
+/**
+ * @brief Get the counters of the specific DSSL connection, see HAL_SSL_GetStats.
+ *
+ * @param[in] context: @n Handle of the specific connection.
+ * @param[out] stats: @n The counters, of the application data and of the records carrying it.
+ *
+ * @retval  0 : Success.
+ * @retval -1 : Invalid parameter.
+ */
+int HAL_DTLSSession_GetStats(DTLSContext *context, hal_ssl_stats_t *stats);
+#endif
+
 /** @} */ /* end of platform_dtls */
 /** @} */ /* end of platform */
 
@@ -155,10 +155,86 @@ int HAL_Firmware_Persistence_Write(_IN_ char *buffer, _IN_ uint32_t length);
 
 
 /**
- * @brief   结束固件写入
+ * @brief   在指定位置写入固件, 打开 SERVICE_OTA_PARALLEL_RANGES 时多个连接分段下载, 各自在不同线程中写入各段
+ *
+ * @param   offset : 写入的位置
+ * @param   buffer : 写入内容
+ * @param   length : 写入内容长度, 为 0 时只查询是否支持
+ * @return  0, 成功; -1, 失败或不支持, 只能顺序写入
+ */
+int HAL_Firmware_Persistence_WriteAt(_IN_ uint32_t offset, _IN_ char *buffer, _IN_ uint32_t length);
+
+
+/**
+ * @brief   读回已写入的固件, 打开 SERVICE_OTA_VERIFY_READ_BACK 时每次写入后用于校验
+ *
+ * @param   offset : 读取的起始位置
+ * @param   buffer : 存放读取内容的缓冲区
+ * @param   length : 读取长度
+ * @return  实际读取长度; -1, 失败
+ */
+int HAL_Firmware_Persistence_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length);
+
+
+/**
+ * @brief   固件写入能否与网络接收同时进行
  *
  * @param   NULL
- * @return  成功或失败
+ * @return  1, HAL_Firmware_Persistence_Write 可在另一个线程中调用, 写入期间不阻塞网络接收, 下载与写入流水进行;
+ *          0, 写入会停住整个系统 (如擦写片内 flash), 下载后再顺序写入
+ */
+int HAL_Firmware_Persistence_Async(void);
+
+
+/**
+ * @brief   继续之前中断的固件写入, 保留已写入的前 offset 字节, 之后从 offset 处写入
+ *
+ * @param   offset : 保留的长度
+ * @return  0, 成功; -1, 已写入的不足 offset 字节或不支持, 需从头写入
+ */
+int HAL_Firmware_Persistence_Resume(_IN_ uint32_t offset);
+
+
+/**
+ * @brief   读取正在运行的固件, 差分升级时以它为基础生成新固件
+ *
+ * @param   offset : 读取的起始位置
+ * @param   buffer : 存放读取内容的缓冲区
+ * @param   length : 读取长度
+ * @return  实际读取长度; -1, 失败或不支持, 只能整包升级
+ */
+int HAL_Firmware_Current_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length);
+
+
+/**
+ * @brief   写入网关为子设备缓存的固件, 打开 OTA_CACHE_ENABLED 时同一产品同一版本的固件只下载一次, 再分发给各子设备
+ *
+ * @param   slot : 缓存的序号, 0 到 CONFIG_OTA_CACHE_SLOTS - 1, 各自存放一个固件
+ * @param   offset : 写入的位置, 为 0 时该缓存重新开始写入
+ * @param   buffer : 写入内容
+ * @param   length : 写入内容长度
+ * @return  0, 成功; -1, 失败或不支持
+ */
+int HAL_Firmware_Cache_Write(_IN_ int slot, _IN_ uint32_t offset, _IN_ const char *buffer, _IN_ uint32_t length);
+
+
+/**
+ * @brief   读取网关为子设备缓存的固件, 重启后仍能读到之前写入的内容时, 中断的下载可以继续
+ *
+ * @param   slot : 缓存的序号
+ * @param   offset : 读取的起始位置
+ * @param   buffer : 存放读取内容的缓冲区
+ * @param   length : 读取长度
+ * @return  实际读取长度; -1, 失败或不支持
+ */
+int HAL_Firmware_Cache_Read(_IN_ int slot, _IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length);
+
+
+/**
+ * @brief   结束固件写入, 之前写入的内容在此全部落盘
+ *
+ * @param   NULL
+ * @return  0, 成功; -1, 之前的写入或落盘失败
  */
 int HAL_Firmware_Persistence_Stop(void);
 
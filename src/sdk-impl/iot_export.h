@@ -194,6 +194,22 @@ int     IOT_SetupConnInfoSecure(const char *product_key,
  */
 void    IOT_SetupDomain(int domain_type);
 
+#ifdef REGION_AUTO_ENABLED
+/**
+ * @brief Setup the domain of the region whose MQTT endpoint connects fastest, should be called before
+ *        IOT_SetupConnInfo(). The endpoints are connected to in parallel, the ranking is kept with
+ *        HAL_Kv_Set() for CONFIG_REGION_CACHE_TTL, and a connection moves on to the endpoint of the next
+ *        best region after CONFIG_REGION_FAILOVER_FAILS connects in a row failed.
+ *
+ * @param [in] product_key: @n Product Key, the endpoints are of the product.
+ *
+ * @retval -1 : No region answered, the domain is left as it is.
+ * @retval others : The domain type setup.
+ * @see None.
+ */
+int     IOT_SetupDomainAuto(const char *product_key);
+#endif
+
 
 /** @} */ /* end of api_conninfo */
 
@@ -220,6 +236,9 @@ void    IOT_SetupDomain(int domain_type);
 //#ifdef SERVICE_OTA_ENABLED
 #include "exports/iot_export_fota.h"
 //#endif /* SERVICE_OTA_ENABLED */
+#ifdef OTA_CACHE_ENABLED
+#include "exports/iot_export_ota_cache.h"
+#endif /* OTA_CACHE_ENABLED */
 
 
 #if defined(__cplusplus)
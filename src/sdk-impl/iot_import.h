@@ -95,6 +95,102 @@ void HAL_MutexUnlock(_IN_ void *mutex);
 /** @} */ /* end of platform_mutex */
 
 
+/** @defgroup group_platform_thread thread
+ *  @{
+ */
+
+#define PLATFORM_WAIT_INFINITE (~0U)
+
+/* Parameters of a thread, NULL or 0 for the defaults of the platform */
+typedef struct {
+    int             stack_size;     /* stack size in bytes */
+    const char     *name;           /* thread name */
+} hal_os_thread_param_t;
+
+/**
+ * @brief Create a thread running 'work_routine(arg)', it ends when 'work_routine' returns.
+ *
+ * @param [out] thread_handle @n The handle of the thread, for HAL_ThreadDetach().
+ * @param [in] work_routine @n The function the thread runs.
+ * @param [in] arg @n The argument of 'work_routine'.
+ * @param [in] hal_os_thread_param @n The parameters of the thread, NULL for the defaults.
+ * @param [out] stack_used @n 1 if the stack is allocated by the platform, 0 if not, may be NULL.
+ * @retval  0 : Success.
+ * @retval -1 : Fail.
+ * @see None.
+ * @note None.
+ */
+int HAL_ThreadCreate(_OU_ void **thread_handle,
+                     _IN_ void *(*work_routine)(void *),
+                     _IN_ void *arg,
+                     _IN_ hal_os_thread_param_t *hal_os_thread_param,
+                     _OU_ int *stack_used);
+
+/**
+ * @brief Let the resources of a thread go when it ends, nobody waits for it. The handle is invalid afterwards.
+ *
+ * @param [in] thread_handle @n The handle from HAL_ThreadCreate().
+ * @return None.
+ * @see None.
+ * @note None.
+ */
+void HAL_ThreadDetach(_IN_ void *thread_handle);
+
+/**
+ * @brief Create a counting semaphore, its count is 0.
+ *
+ * @return NULL, create failed; NOT NULL, the semaphore.
+ * @see None.
+ * @note None.
+ */
+void *HAL_SemaphoreCreate(void);
+
+/**
+ * @brief Destroy the semaphore, nobody may be waiting on it.
+ *
+ * @param [in] sem @n The semaphore.
+ * @return None.
+ * @see None.
+ * @note None.
+ */
+void HAL_SemaphoreDestroy(_IN_ void *sem);
+
+/**
+ * @brief Increase the count of the semaphore, one waiter wakes up.
+ *
+ * @param [in] sem @n The semaphore.
+ * @return None.
+ * @see None.
+ * @note None.
+ */
+void HAL_SemaphorePost(_IN_ void *sem);
+
+/**
+ * @brief Wait until the count of the semaphore is above 0 and decrease it.
+ *
+ * @param [in] sem @n The semaphore.
+ * @param [in] timeout_ms @n The longest wait in milliseconds, PLATFORM_WAIT_INFINITE for no limit.
+ * @retval  0 : The count is decreased.
+ * @retval -1 : Timeout.
+ * @see None.
+ * @note None.
+ */
+int HAL_SemaphoreWait(_IN_ void *sem, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief Add 'delta' to '*value' in one indivisible step, other threads see the value before or after it.
+ *
+ * @param [in] value @n The word.
+ * @param [in] delta @n What is added, negative to subtract, 0 to read the word.
+ * @return The value after the addition.
+ * @see None.
+ * @note Without atomic instructions an RTOS may lock the scheduler or the interrupts around the addition.
+ */
+int HAL_AtomicAdd(_IN_ volatile int *value, _IN_ int delta);
+
+/** @} */ /* end of platform_thread */
+
+
 /** @defgroup group_platform_memory_manage memory
  *  @{
  */
@@ -136,6 +232,15 @@ void HAL_Free(_IN_ void *ptr);
  */
 uint64_t HAL_UptimeMs(void);
 
+/**
+ * @brief Retrieves the number of microseconds that have elapsed since the system was boot.
+ *
+ * @return the number of microseconds.
+ * @see None.
+ * @note Only the trace points of WITH_TRACE in lite-utils_config.h call it, a port may leave it out without them.
+ */
+uint64_t HAL_UptimeUs(void);
+
 
 /**
  * @brief Sleep thread itself.
@@ -222,14 +327,150 @@ int HAL_GetPartnerID(_OU_ char pid_str[PID_STRLEN_MAX]);
  */
 int HAL_GetModuleID(_OU_ char mid_str[MID_STRLEN_MAX]);
 
+/**
+ * @brief Save a value in non-volatile storage, it must survive a reboot.
+ *
+ * @param [in] key: @n NUL terminated key, letters, digits, '_' and '.' only.
+ * @param [in] val: @n The value.
+ * @param [in] len: @n The length in bytes of 'val'.
+ * @param [in] sync: @n 1, written through before return; 0, may be written later.
+ * @retval  0 : Success.
+ * @retval -1 : Fail.
+ * @see None.
+ * @note The values may be secrets, e.g. TLS session keys, keep the storage private to the device.
+ */
+int HAL_Kv_Set(_IN_ const char *key, _IN_ const void *val, _IN_ int len, _IN_ int sync);
+
+/**
+ * @brief Load a value saved by HAL_Kv_Set.
+ *
+ * @param [in] key: @n NUL terminated key.
+ * @param [out] val: @n The buffer for the value.
+ * @param [in,out] buffer_len: @n The size of 'val' in, the length of the value out.
+ * @retval  0 : Success.
+ * @retval -1 : Fail, no such key or 'val' too small.
+ * @see None.
+ */
+int HAL_Kv_Get(_IN_ const char *key, _OU_ void *val, _OU_ int *buffer_len);
+
+/**
+ * @brief Remove a value saved by HAL_Kv_Set.
+ *
+ * @param [in] key: @n NUL terminated key.
+ * @retval  0 : Success, or no such key.
+ * @retval -1 : Fail.
+ * @see None.
+ */
+int HAL_Kv_Del(_IN_ const char *key);
+
 /** @} */ /* end of group_platform_other */
 
+#ifdef HAL_CRYPTO_ENABLED
+/** @defgroup group_platform_crypto crypto
+ *  @{
+ */
+
+typedef enum {
+    HAL_DIGEST_MD5,
+    HAL_DIGEST_SHA1,
+    HAL_DIGEST_SHA256,
+} hal_digest_type_t;
+
+/**
+ * @brief Compress one block into the intermediate state of an MD5 digest on the crypto engine.
+ *        Used by the SDK digests for every block, padding and lengths are done by the caller.
+ *
+ * @param [in,out] state: @n The intermediate hash words A, B, C, D as host integers.
+ * @param [in] block: @n The 64 bytes of message to compress.
+ * @retval  0 : Done by the engine.
+ * @retval -1 : Not done, the software implementation is used for this block.
+ * @see None.
+ */
+int HAL_Crypto_Md5Process(_IN_ uint32_t state[4], _IN_ const unsigned char block[64]);
+
+/**
+ * @brief Compress one block into the intermediate state of a SHA-1 digest on the crypto engine.
+ *        Used by the SDK digests and by mbedtls for every block.
+ *
+ * @param [in,out] state: @n The intermediate hash words H0 .. H4 as host integers.
+ * @param [in] block: @n The 64 bytes of message to compress.
+ * @retval  0 : Done by the engine.
+ * @retval -1 : Not done, the software implementation is used for this block.
+ * @see None.
+ */
+int HAL_Crypto_Sha1Process(_IN_ uint32_t state[5], _IN_ const unsigned char block[64]);
+
+/**
+ * @brief Compress one block into the intermediate state of a SHA-256 (or SHA-224) digest on the crypto engine.
+ *        Used by the SDK digests and by mbedtls for every block.
+ *
+ * @param [in,out] state: @n The intermediate hash words H0 .. H7 as host integers.
+ * @param [in] block: @n The 64 bytes of message to compress.
+ * @retval  0 : Done by the engine.
+ * @retval -1 : Not done, the software implementation is used for this block.
+ * @see None.
+ */
+int HAL_Crypto_Sha256Process(_IN_ uint32_t state[8], _IN_ const unsigned char block[64]);
+
+/**
+ * @brief Calculate a whole HMAC on the crypto engine, e.g. for the device sign with the device secret.
+ *
+ * @param [in] type: @n The digest the HMAC is based on.
+ * @param [in] key: @n The key.
+ * @param [in] key_len: @n The length in bytes of 'key'.
+ * @param [in] msg: @n The message.
+ * @param [in] msg_len: @n The length in bytes of 'msg'.
+ * @param [out] digest: @n The binary HMAC, 16, 20 or 32 bytes.
+ * @retval  0 : Done by the engine.
+ * @retval -1 : Not done, the software implementation is used.
+ * @see None.
+ */
+int HAL_Crypto_Hmac(_IN_ hal_digest_type_t type,
+                    _IN_ const unsigned char *key, _IN_ uint32_t key_len,
+                    _IN_ const unsigned char *msg, _IN_ uint32_t msg_len,
+                    _OU_ unsigned char *digest);
+
+#ifdef HAL_CRYPTO_AES_ENABLED
+/**
+ * @brief Encrypt one AES block on the crypto engine, used by mbedtls for every AES block of TLS/DTLS.
+ *
+ * @param [in] key: @n The raw key, the same for many blocks in a row, so worth caching in the engine.
+ * @param [in] keybits: @n 128, 192 or 256.
+ * @param [in] input: @n The 16 bytes to encrypt.
+ * @param [out] output: @n The 16 encrypted bytes.
+ * @retval  0 : Success.
+ * @retval -1 : Fail, there is no software fallback for AES.
+ * @see None.
+ */
+int HAL_Crypto_AesEncrypt(_IN_ const unsigned char *key, _IN_ uint32_t keybits,
+                          _IN_ const unsigned char input[16], _OU_ unsigned char output[16]);
+
+/**
+ * @brief Decrypt one AES block on the crypto engine, used by mbedtls for every AES block of TLS/DTLS.
+ *
+ * @param [in] key: @n The raw key, not the inverse key schedule.
+ * @param [in] keybits: @n 128, 192 or 256.
+ * @param [in] input: @n The 16 bytes to decrypt.
+ * @param [out] output: @n The 16 decrypted bytes.
+ * @retval  0 : Success.
+ * @retval -1 : Fail, there is no software fallback for AES.
+ * @see None.
+ */
+int HAL_Crypto_AesDecrypt(_IN_ const unsigned char *key, _IN_ uint32_t keybits,
+                          _IN_ const unsigned char input[16], _OU_ unsigned char output[16]);
+#endif  /* HAL_CRYPTO_AES_ENABLED */
+
+/** @} */ /* end of group_platform_crypto */
+#endif  /* HAL_CRYPTO_ENABLED */
+
 /** @defgroup group_platform_network network
  *  @{
  */
 
 /**
  * @brief Establish a TCP connection.
+ *        All the IPv6 and IPv4 addresses of the host may be tried, staggered and in parallel (RFC 8305),
+ *        the first connected wins.
  *
  * @param [in] host: @n Specify the hostname(IP) of the TCP server
  * @param [in] port: @n Specify the TCP port of TCP server
@@ -240,6 +481,33 @@ int HAL_GetModuleID(_OU_ char mid_str[MID_STRLEN_MAX]);
  */
 uintptr_t HAL_TCP_Establish(_IN_ const char *host, _IN_  uint16_t port);
 
+/**
+ * @brief Set how long HAL_TCP_Establish may take to connect, over all the addresses of the host.
+ *
+ * @param [in] timeout_ms: @n The timeout in millisecond, 0 restores the platform default.
+ * @return None.
+ * @see HAL_TCP_Establish.
+ */
+void HAL_TCP_SetConnectTimeout(_IN_ uint32_t timeout_ms);
+
+/**
+ * @brief Set how long HAL_TCP_Establish reuses the addresses resolved for a host.
+ *        A host which can not be resolved again keeps its expired addresses until it can.
+ *
+ * @param [in] ttl_ms: @n The time to live in millisecond, 0 resolves the host on every connect.
+ * @return None.
+ * @see HAL_TCP_Establish.
+ */
+void HAL_TCP_SetDnsCacheTTL(_IN_ uint32_t ttl_ms);
+
+/**
+ * @brief Forget all the addresses resolved by HAL_TCP_Establish, e.g. when the network changed.
+ *
+ * @return None.
+ * @see HAL_TCP_Establish.
+ */
+void HAL_TCP_FlushDnsCache(void);
+
 
 /**
  * @brief Destroy the specific TCP connection.
@@ -270,6 +538,28 @@ int32_t HAL_TCP_Destroy(_IN_ uintptr_t fd);
  */
 int32_t HAL_TCP_Write(_IN_ uintptr_t fd, _IN_ const char *buf, _IN_ uint32_t len, _IN_ uint32_t timeout_ms);
 
+/* one piece of a gathered write, the pieces are sent back to back as if concatenated */
+typedef struct {
+    const char     *buf;
+    uint32_t        len;
+} hal_iovec_t;
+
+/**
+ * @brief Write the pieces of 'iov' in order into the specific TCP connection, without copying them together first.
+ *        The API will return immediately if all the pieces be written into the specific TCP connection.
+ *
+ * @param [in] fd @n A descriptor identifying a connection.
+ * @param [in] iov @n The pieces of data to be transmitted.
+ * @param [in] iovcnt @n The number of pieces in 'iov'.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond. In other words, the API block 'timeout_ms' millisecond maximumly.
+ *
+ * @retval        < 0 : TCP connection error occur..
+ * @retval          0 : No any data be write into the TCP connection in 'timeout_ms' timeout period.
+ * @retval (0, total] : The total number of bytes be written in 'timeout_ms' timeout period.
+ * @see HAL_TCP_Write.
+ */
+int32_t HAL_TCP_Writev(_IN_ uintptr_t fd, _IN_ const hal_iovec_t *iov, _IN_ uint32_t iovcnt, _IN_ uint32_t timeout_ms);
+
 
 /**
  * @brief Read data from the specific TCP connection with timeout parameter.
@@ -336,6 +626,23 @@ int32_t HAL_SSL_Destroy(_IN_ uintptr_t handle);
 int32_t HAL_SSL_Write(_IN_ uintptr_t handle, _IN_ const char *buf, _IN_ int len, _IN_ int timeout_ms);
 
 
+/**
+ * @brief Write the pieces of 'iov' in order into the specific SSL connection.
+ *        Small pieces are coalesced so that they go out in as few TLS records as possible,
+ *        instead of one record per piece.
+ *
+ * @param [in] handle @n A descriptor identifying a connection.
+ * @param [in] iov @n The pieces of data to be transmitted.
+ * @param [in] iovcnt @n The number of pieces in 'iov'.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond. In other words, the API block 'timeout_ms' millisecond maximumly.
+ * @retval        < 0 : SSL connection error occur..
+ * @retval          0 : No any data be write into the SSL connection in 'timeout_ms' timeout period.
+ * @retval (0, total] : The total number of bytes be written in 'timeout_ms' timeout period.
+ * @see HAL_SSL_Write.
+ */
+int32_t HAL_SSL_Writev(_IN_ uintptr_t handle, _IN_ const hal_iovec_t *iov, _IN_ uint32_t iovcnt, _IN_ int timeout_ms);
+
+
 /**
  * @brief Read data from the specific SSL connection with timeout parameter.
  *        The API will return immediately if 'len' be received from the specific SSL connection.
@@ -353,6 +660,50 @@ int32_t HAL_SSL_Write(_IN_ uintptr_t handle, _IN_ const char *buf, _IN_ int len,
  */
 int32_t HAL_SSL_Read(_IN_ uintptr_t handle, _OU_ char *buf, _OU_ int len, _IN_ int timeout_ms);
 
+/**
+ * @brief Read the data already received on the specific SSL connection, never blocks.
+ *        A record only partly received is kept by the connection and completed by later reads,
+ *        so a caller can frame its data as it arrives instead of waiting for all of it.
+ *
+ * @param [in] handle @n A descriptor identifying a SSL connection.
+ * @param [out] buf @n A pointer to a buffer to receive incoming data.
+ * @param [in] len @n The size, in bytes, of 'buf'.
+ *
+ * @retval       -2 : SSL connection be closed by remote server.
+ * @retval       -1 : SSL connection error occur.
+ * @retval        0 : No any data received yet.
+ * @retval (0, len] : The number of bytes read.
+ * @see HAL_SSL_Read.
+ */
+int32_t HAL_SSL_ReadNonblock(_IN_ uintptr_t handle, _OU_ char *buf, _IN_ int len);
+
+#ifdef SSL_MEMORY_POOL_ENABLED
+/* usage of the static pool TLS/DTLS allocate from, in bytes, block headers included */
+typedef struct {
+    uint32_t pool_size;
+    uint32_t in_use;
+    uint32_t peak;          /* high water mark of in_use */
+    uint32_t failed;        /* allocations the pool could not serve */
+} hal_ssl_memory_stats_t;
+
+/**
+ * @brief Get the usage of the TLS/DTLS memory pool, to size SSL_MEMORY_POOL_SIZE with.
+ *
+ * @param [out] stats: @n The usage.
+ * @return None.
+ * @see HAL_SSL_MemoryStatsReset.
+ */
+void HAL_SSL_MemoryStats(_OU_ hal_ssl_memory_stats_t *stats);
+
+/**
+ * @brief Restart the high water mark from current usage and clear the failure count.
+ *
+ * @return None.
+ * @see HAL_SSL_MemoryStats.
+ */
+void HAL_SSL_MemoryStatsReset(void);
+#endif  /* SSL_MEMORY_POOL_ENABLED */
+
 /**
  * @brief Establish a UDP connection.
  *
@@ -365,6 +716,17 @@ int32_t HAL_SSL_Read(_IN_ uintptr_t handle, _OU_ char *buf, _OU_ int len, _IN_ i
  */
 void *HAL_UDP_create(_IN_ char *host, _IN_ unsigned short port);
 
+/**
+ * @brief Set the socket send and receive buffer sizes of the UDP connections HAL_UDP_create makes from now on,
+ *        e.g. so that a burst of datagrams is not dropped before it is read.
+ *
+ * @param [in] sndbuf: @n The send buffer size in bytes, 0 keeps the platform default.
+ * @param [in] rcvbuf: @n The receive buffer size in bytes, 0 keeps the platform default.
+ * @return None.
+ * @see HAL_UDP_create.
+ */
+void HAL_UDP_SetBufferSize(_IN_ unsigned int sndbuf, _IN_ unsigned int rcvbuf);
+
 /**
  * @brief Destroy the specific UDP connection.
  *
@@ -431,6 +793,279 @@ int HAL_UDP_readTimeout(
             _OU_ unsigned int datalen,
             _IN_ unsigned int timeout_ms);
 
+#ifdef LOCAL_CONTROL_ENABLED
+/* the other end of a datagram on a UDP socket not connected */
+typedef struct {
+    char            addr[16];   /* IPv4 address, dotted */
+    unsigned short  port;
+} hal_udp_peer_t;
+
+/**
+ * @brief Open a UDP socket taking datagrams from any peer on the specific local port.
+ *
+ * @param [in] port: @n Specify the local UDP port.
+ *
+ * @retval  < 0 : Fail.
+ * @retval >= 0 : Success, the value is handle of this UDP socket.
+ * @see HAL_UDP_recvfrom, HAL_UDP_sendto.
+ */
+void *HAL_UDP_bind(_IN_ unsigned short port);
+
+/**
+ * @brief Read one datagram and the peer it came from on a UDP socket of HAL_UDP_bind.
+ *
+ * @param [in] p_socket @n A descriptor from HAL_UDP_bind.
+ * @param [out] peer @n The peer the datagram came from.
+ * @param [out] p_data @n A pointer to a buffer to receive the datagram.
+ * @param [in] datalen @n The length, in bytes, of the data pointed to by the 'p_data' parameter.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond, 0 returns at once.
+ *
+ * @retval          -4 : UDP socket error occur.
+ * @retval          -2 : No any datagram arrived in 'timeout_ms' timeout period.
+ * @retval          -1 : Invalid parameter.
+ * @retval [0,datalen] : The number of byte read.
+ * @see HAL_UDP_bind.
+ */
+int HAL_UDP_recvfrom(
+            _IN_ void *p_socket,
+            _OU_ hal_udp_peer_t *peer,
+            _OU_ unsigned char *p_data,
+            _IN_ unsigned int datalen,
+            _IN_ unsigned int timeout_ms);
+
+/**
+ * @brief Write one datagram to the specific peer on a UDP socket of HAL_UDP_bind.
+ *
+ * @param [in] p_socket @n A descriptor from HAL_UDP_bind.
+ * @param [in] peer @n The peer to send to.
+ * @param [in] p_data @n A pointer to a buffer containing the data to be transmitted.
+ * @param [in] datalen @n The length, in bytes, of the data pointed to by the 'p_data' parameter.
+ *
+ * @retval          < 0 : UDP socket error occur.
+ * @retval [0,datalen ] : The number of bytes sent.
+ * @see HAL_UDP_bind.
+ */
+int HAL_UDP_sendto(
+            _IN_ void *p_socket,
+            _IN_ const hal_udp_peer_t *peer,
+            _IN_ const unsigned char *p_data,
+            _IN_ unsigned int datalen);
+#endif  /* LOCAL_CONTROL_ENABLED */
+
+#ifdef COAP_BATCH_SEND_ENABLED
+/**
+ * @brief Write several datagrams into the specific UDP connection at once, one datagram per buffer.
+ *
+ * @param [in] p_socket @n A descriptor identifying a UDP connection.
+ * @param [in] p_data @n 'count' buffers containing the datagrams to be transmitted.
+ * @param [in] p_len @n 'count' lengths, in bytes, of the datagrams in 'p_data'.
+ * @param [in] count @n The number of datagrams.
+ *
+ * @retval         < 0 : UDP connection error occur before any datagram was sent.
+ * @retval [0,count]   : The number of datagrams sent, the first ones in 'p_data'.
+ * @see HAL_UDP_write.
+ */
+int HAL_UDP_writeBatch(
+            _IN_ void *p_socket,
+            _IN_ const unsigned char **p_data,
+            _IN_ const unsigned int *p_len,
+            _IN_ unsigned int count);
+#endif
+
+#ifdef COAP_BATCH_RECV_ENABLED
+/**
+ * @brief Read all the datagrams already arrived on the specific UDP connection, waiting timeout parameter for the first one.
+ *
+ * @param [in] p_socket @n A descriptor identifying a UDP connection.
+ * @param [out] p_data @n 'count' buffers to receive the datagrams, one datagram each.
+ * @param [in] datalen @n The length, in bytes, of each buffer in 'p_data'.
+ * @param [out] p_len @n 'count' lengths, the number of bytes read into each buffer.
+ * @param [in] count @n The number of buffers in 'p_data'.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond. In other words, the API block timeout_ms millisecond maximumly.
+ *
+ * @retval          -4 : UDP connect error occur.
+ * @retval          -3 : The  call  was interrupted by a signal before any data was read.
+ * @retval          -2 : No any data be received in 'timeout_ms' timeout period.
+ * @retval          -1 : Invalid parameter.
+ * @retval (0,count]   : The number of datagrams read.
+ * @see None.
+ */
+int HAL_UDP_readBatch(
+            _IN_ void *p_socket,
+            _OU_ unsigned char **p_data,
+            _IN_ unsigned int datalen,
+            _OU_ unsigned int *p_len,
+            _IN_ unsigned int count,
+            _IN_ unsigned int timeout_ms);
+#endif
+
+#ifdef HAL_EVENT_ENABLED
+/*
+ * Readiness based I/O, one thread waits for many connections and then reads or writes
+ * each ready one without blocking, instead of one thread blocking per connection.
+ */
+#define HAL_EVENT_READ      (1 << 0)    /* ready to read */
+#define HAL_EVENT_WRITE     (1 << 1)    /* ready to write */
+#define HAL_EVENT_ERROR     (1 << 2)    /* error or hang up, reported whether registered for or not */
+
+typedef struct {
+    uintptr_t       fd;
+    unsigned int    events;     /* HAL_EVENT_* ready */
+    void           *user;       /* as registered */
+} hal_event_t;
+
+/**
+ * @brief Create an event loop, a set of descriptors waited for together.
+ *
+ * @return The event loop, NULL when fail.
+ * @see None.
+ */
+void *HAL_EventLoop_create(void);
+
+/**
+ * @brief Destroy an event loop, the descriptors registered are not closed.
+ *
+ * @param [in] loop @n The event loop.
+ * @return None.
+ * @see None.
+ */
+void HAL_EventLoop_destroy(_IN_ void *loop);
+
+/**
+ * @brief Register a descriptor, or change the events and user of one registered.
+ *
+ * @param [in] loop @n The event loop.
+ * @param [in] fd @n A TCP connection handle, or a UDP connection descriptor from HAL_UDP_getFd.
+ * @param [in] events @n HAL_EVENT_READ and/or HAL_EVENT_WRITE.
+ * @param [in] user @n Handed back in hal_event_t when fd is ready.
+ *
+ * @retval  0 : Success.
+ * @retval -1 : Fail.
+ * @see None.
+ */
+int HAL_EventLoop_add(_IN_ void *loop, _IN_ uintptr_t fd, _IN_ unsigned int events, _IN_ void *user);
+
+/**
+ * @brief Unregister a descriptor, must be done before it is closed.
+ *
+ * @param [in] loop @n The event loop.
+ * @param [in] fd @n A descriptor registered.
+ *
+ * @retval  0 : Success.
+ * @retval -1 : Fail, fd is not registered.
+ * @see None.
+ */
+int HAL_EventLoop_delete(_IN_ void *loop, _IN_ uintptr_t fd);
+
+/**
+ * @brief Wait till any descriptor registered is ready.
+ *
+ * @param [in] loop @n The event loop.
+ * @param [out] events @n Receives the descriptors ready.
+ * @param [in] count @n The number of entries in 'events'.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond, 0 returns at once, 0xFFFFFFFF never times out.
+ *
+ * @retval  -1 : Fail.
+ * @retval   0 : Nothing ready in 'timeout_ms' timeout period, or interrupted by a signal.
+ * @retval > 0 : The number of entries filled in 'events'.
+ * @see None.
+ */
+int HAL_EventLoop_wait(_IN_ void *loop, _OU_ hal_event_t *events, _IN_ int count, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief Read the data already received on the specific TCP connection, never blocks.
+ *
+ * @retval       -2 : TCP connection error occur.
+ * @retval       -1 : TCP connection be closed by remote server.
+ * @retval        0 : No any data received yet.
+ * @retval (0, len] : The number of bytes read.
+ * @see HAL_TCP_Read.
+ */
+int32_t HAL_TCP_ReadNonblock(_IN_ uintptr_t fd, _OU_ char *buf, _IN_ uint32_t len);
+
+/**
+ * @brief Write as much data as the specific TCP connection takes without blocking.
+ *
+ * @retval      < 0 : TCP connection error occur.
+ * @retval        0 : The connection takes no data now, wait for HAL_EVENT_WRITE.
+ * @retval (0, len] : The number of bytes written.
+ * @see HAL_TCP_Write.
+ */
+int32_t HAL_TCP_WriteNonblock(_IN_ uintptr_t fd, _IN_ const char *buf, _IN_ uint32_t len);
+
+/**
+ * @brief The descriptor of the specific UDP connection to register in an event loop.
+ *
+ * @param [in] p_socket @n A descriptor identifying a UDP connection.
+ * @return The descriptor.
+ * @see None.
+ */
+uintptr_t HAL_UDP_getFd(_IN_ void *p_socket);
+
+/**
+ * @brief Read one datagram already arrived on the specific UDP connection, never blocks.
+ *
+ * @retval          -4 : UDP connect error occur.
+ * @retval          -2 : No any datagram arrived yet.
+ * @retval          -1 : Invalid parameter.
+ * @retval (0,datalen] : The number of byte read.
+ * @see HAL_UDP_readTimeout.
+ */
+int HAL_UDP_readNonblock(_IN_ void *p_socket, _OU_ unsigned char *p_data, _IN_ unsigned int datalen);
+#endif  /* HAL_EVENT_ENABLED */
+
+#ifdef HAL_NET_STATS_ENABLED
+/* counters of one connection since it was made */
+typedef struct {
+    uint64_t bytes_sent;
+    uint64_t bytes_recv;
+    uint32_t packets_sent;      /* sends which moved data, datagrams for UDP */
+    uint32_t packets_recv;      /* receives which got data, bytes_recv / packets_recv is the size of a read */
+    uint32_t syscalls;          /* socket calls, waits included; the caller's calls for hal_ssl_stats_t:app */
+    uint32_t errors;            /* failed calls, timeouts excluded */
+    uint32_t blocked_ms;        /* waiting in select or poll for the socket */
+} hal_net_stats_t;
+
+/* a TLS or DTLS connection, what is over net and not in app is the overhead of the protocol */
+typedef struct {
+    hal_net_stats_t app;        /* plaintext through the read and write calls */
+    hal_net_stats_t net;        /* records on the socket, handshakes and alerts included */
+} hal_ssl_stats_t;
+
+/**
+ * @brief Get the counters of the specific TCP connection.
+ *
+ * @param [in] fd @n A descriptor identifying a connection.
+ * @param [out] stats @n The counters.
+ * @retval  0 : Success.
+ * @retval -1 : Not a connection counted, e.g. a descriptor too big for the table of the port.
+ * @see None.
+ */
+int HAL_TCP_GetStats(_IN_ uintptr_t fd, _OU_ hal_net_stats_t *stats);
+
+/**
+ * @brief Get the counters of the specific UDP connection.
+ *
+ * @param [in] p_socket @n A descriptor identifying a UDP connection.
+ * @param [out] stats @n The counters.
+ * @retval  0 : Success.
+ * @retval -1 : Not a connection counted.
+ * @see None.
+ */
+int HAL_UDP_GetStats(_IN_ void *p_socket, _OU_ hal_net_stats_t *stats);
+
+/**
+ * @brief Get the counters of the specific SSL connection.
+ *
+ * @param [in] handle @n A descriptor identifying a SSL connection.
+ * @param [out] stats @n The counters, of the application data and of the records carrying it.
+ * @retval  0 : Success.
+ * @retval -1 : Invalid handle.
+ * @see None.
+ */
+int HAL_SSL_GetStats(_IN_ uintptr_t handle, _OU_ hal_ssl_stats_t *stats);
+#endif  /* HAL_NET_STATS_ENABLED */
+
 /** @} */ /* end of platform_network */
 /** @} */ /* end of platform */
 
@@ -0,0 +1,207 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+
+#ifdef DM_CHANNELS_ENABLED
+#include "class_interface.h"
+#include "logger.h"
+#include "dm_import.h"
+#include "cmp_channel.h"
+
+#define URI_BASE        "/sys/pk/dn/"
+
+/* the clients of the channels, connected at once, every send returns send_ret. */
+static struct {
+    int     client;
+    int     connects;
+    int     disconnects;
+    int     sends;
+    int     send_ret;
+} fake;
+
+/* the reply a request taken by the cloud was answered with. */
+static struct {
+    int     replies;
+    int     id;
+    int     code;
+    char    uri[64];
+    char    data[8];
+} replied;
+
+static void *fake_connect(cmp_channel_t *channels)
+{
+    fake.connects++;
+    return &fake.client;
+}
+
+static void fake_disconnect(cmp_channel_t *channels, cmp_channel_queue_t *queue)
+{
+    fake.disconnects++;
+}
+
+static int fake_send(cmp_channel_t *channels, cmp_channel_queue_t *queue, cmp_channel_message_t *message, char *path)
+{
+    fake.sends++;
+    return fake.send_ret;
+}
+
+static const cmp_channel_transport_t fake_transport = {fake_connect, fake_disconnect, fake_send, 1};
+
+static void reply_handler(iotx_cmp_send_peer_pt source, iotx_cmp_message_info_pt msg, void *user_data)
+{
+    replied.replies++;
+    replied.id = msg->id;
+    replied.code = msg->code;
+    strncpy(replied.uri, msg->URI, sizeof(replied.uri) - 1);
+    strncpy(replied.data, msg->parameter, sizeof(replied.data) - 1);
+
+    /* freed as a message of CMP. */
+    dm_lite_free(msg->URI);
+    dm_lite_free(msg->parameter);
+}
+
+static int send_request(cmp_channel_t *channels, const char *uri, int id)
+{
+    iotx_cmp_message_info_t message_info;
+
+    memset(&message_info, 0, sizeof(iotx_cmp_message_info_t));
+    message_info.id = id;
+    message_info.URI = (char *)uri;
+    message_info.method = "thing.event.property.post";
+    message_info.parameter = "{}";
+    message_info.parameter_length = 2;
+    message_info.message_type = IOTX_CMP_MESSAGE_REQUEST;
+
+    return cmp_channel_send(channels, &message_info, dm_payload_format_json);
+}
+
+DATA(CMP_CHANNEL) {
+    void           *logger; /* the warnings of the channels go to the default logger of dm. */
+    cmp_channel_t   channels;
+};
+
+SETUP(CMP_CHANNEL)
+{
+    int             index;
+
+    memset(&fake, 0, sizeof(fake));
+    memset(&replied, 0, sizeof(replied));
+
+    data->logger = new_object(LOGGER_CLASS, "cmp channel", 0);
+    cmp_channel_create(&data->channels);
+    cmp_channel_init(&data->channels, "pk", "dn", "ds", "id");
+    for (index = 0; index < CMP_CHANNEL_QUEUE_NUMBER; index++) {
+        data->channels.queues[index].transport = &fake_transport;
+    }
+}
+
+TEARDOWN(CMP_CHANNEL)
+{
+    cmp_channel_destroy(&data->channels);
+    if (data->logger) {
+        delete_object(data->logger);
+    }
+}
+
+/* an uplink goes to the channel of the longest prefix it starts with, to MQTT when none or not of the device. */
+CASEs(CMP_CHANNEL, longest_prefix_wins) {
+    cmp_channel_t  *channels = &data->channels;
+
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/event/property/post", 1), 1);
+
+    ASSERT_EQ(cmp_channel_set_route(channels, "thing/event/", dm_channel_coap), 0);
+    ASSERT_EQ(cmp_channel_set_route(channels, "thing/event/property/", dm_channel_http), 0);
+
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/event/property/post", 2), 0);
+    ASSERT_EQ(channels->queues[dm_channel_http - dm_channel_coap].number, 1);
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/event/alarm/post", 3), 0);
+    ASSERT_EQ(channels->queues[dm_channel_coap - dm_channel_coap].number, 1);
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/service/property/set", 4), 1);
+    ASSERT_EQ(send_request(channels, "/sys/pk/other/thing/event/property/post", 5), 1);
+
+    /* routed back to MQTT, the shorter prefix does not take it over. */
+    ASSERT_EQ(cmp_channel_set_route(channels, "thing/event/property/", dm_channel_mqtt), 0);
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/event/property/post", 6), 1);
+}
+
+/* a full queue refuses what comes next and takes again once a yield sent some. */
+CASEs(CMP_CHANNEL, full_queue_refuses) {
+    cmp_channel_t  *channels = &data->channels;
+    cmp_channel_queue_t *queue = &channels->queues[dm_channel_http - dm_channel_coap];
+    int             index;
+
+    ASSERT_EQ(cmp_channel_set_route(channels, "thing/", dm_channel_http), 0);
+
+    for (index = 0; index < CONFIG_DM_CHANNEL_QUEUE_MAX; index++) {
+        ASSERT_EQ(send_request(channels, URI_BASE "thing/event/property/post", index + 1), 0);
+    }
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/event/property/post", index + 1), -1);
+    ASSERT_EQ(queue->number, CONFIG_DM_CHANNEL_QUEUE_MAX);
+
+    cmp_channel_yield(channels);
+    ASSERT_EQ(fake.sends, CONFIG_DM_CHANNEL_SEND_PER_YIELD);
+    ASSERT_EQ(queue->number, CONFIG_DM_CHANNEL_QUEUE_MAX - CONFIG_DM_CHANNEL_SEND_PER_YIELD);
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/event/property/post", index + 1), 0);
+}
+
+/* a send that fails is tried again on a new connection, the message is dropped after the last try. */
+CASEs(CMP_CHANNEL, retry_then_drop) {
+    cmp_channel_t  *channels = &data->channels;
+    cmp_channel_queue_t *queue = &channels->queues[dm_channel_coap - dm_channel_coap];
+    int             index;
+
+    ASSERT_EQ(cmp_channel_set_route(channels, "thing/", dm_channel_coap), 0);
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/event/property/post", 1), 0);
+    fake.send_ret = -1;
+
+    for (index = 1; index < 3; index++) {
+        cmp_channel_yield(channels);
+        ASSERT_EQ(fake.sends, index);
+        ASSERT_EQ(fake.disconnects, index);
+        ASSERT_EQ(queue->number, 1);
+    }
+
+    cmp_channel_yield(channels);
+    ASSERT_EQ(fake.sends, 3);
+    ASSERT_EQ(fake.connects, 3);
+    ASSERT_EQ(queue->number, 0);
+    ASSERT_NULL(queue->head);
+    ASSERT_EQ(replied.replies, 0);
+}
+
+/* a request the cloud took is answered to the handler of its reply as a reply of code 200. */
+CASEs(CMP_CHANNEL, taken_request_answered) {
+    cmp_channel_t  *channels = &data->channels;
+    iotx_cmp_message_info_t message_info;
+
+    ASSERT_EQ(cmp_channel_set_route(channels, "thing/", dm_channel_http), 0);
+    ASSERT_EQ(cmp_channel_regist(channels, URI_BASE "thing/event/property/post_reply", reply_handler, NULL), 0);
+
+    ASSERT_EQ(send_request(channels, URI_BASE "thing/event/property/post", 7), 0);
+    cmp_channel_yield(channels);
+    ASSERT_EQ(replied.replies, 1);
+    ASSERT_EQ(replied.id, 7);
+    ASSERT_EQ(replied.code, 200);
+    ASSERT_STR_EQ(replied.uri, URI_BASE "thing/event/property/post_reply");
+    ASSERT_STR_EQ(replied.data, "{}");
+
+    /* raw data is not answered. */
+    memset(&message_info, 0, sizeof(iotx_cmp_message_info_t));
+    message_info.URI = URI_BASE "thing/event/property/post";
+    message_info.parameter = "\x01\x02";
+    message_info.parameter_length = 2;
+    message_info.message_type = IOTX_CMP_MESSAGE_RAW;
+    ASSERT_EQ(cmp_channel_send(channels, &message_info, dm_payload_format_cbor), 0);
+    ASSERT_EQ(channels->queues[dm_channel_http - dm_channel_coap].head->payload_format, dm_payload_format_cbor);
+    cmp_channel_yield(channels);
+    ASSERT_EQ(fake.sends, 2);
+    ASSERT_EQ(replied.replies, 1);
+}
+
+SUITE(CMP_CHANNEL) = {
+    ADD_CASE(CMP_CHANNEL, longest_prefix_wins),
+    ADD_CASE(CMP_CHANNEL, full_queue_refuses),
+    ADD_CASE(CMP_CHANNEL, retry_then_drop),
+    ADD_CASE(CMP_CHANNEL, taken_request_answered),
+    ADD_CASE_NULL
+};
+#endif /* DM_CHANNELS_ENABLED */
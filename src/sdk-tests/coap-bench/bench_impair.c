@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "bench_impair.h"
+
+typedef struct {
+    int                 used;
+    uint64_t            due_us;
+    void               *p_socket;
+    unsigned int        len;
+    unsigned char       data[BENCH_IMPAIR_DATAGRAM_MAX];
+} bench_impair_slot_t;
+
+/* the link and the queue are shared with the thread sending the held datagrams under 'lock' */
+static bench_impair_t bench_impair;
+static bench_impair_stats_t bench_impair_stats;
+static bench_impair_slot_t bench_impair_queue[BENCH_IMPAIR_QUEUE_MAX];
+static int bench_impair_held;
+static uint32_t bench_impair_seed;
+static void *bench_impair_lock;
+static void *bench_impair_sem_exit;
+static volatile int bench_impair_running;
+static volatile int bench_impair_stopping;
+
+int __real_HAL_UDP_write(void *p_socket, const unsigned char *p_data, unsigned int datalen);
+
+/* xorshift32, under the lock */
+static uint32_t bench_impair_random(uint32_t range)
+{
+    bench_impair_seed ^= bench_impair_seed << 13;
+    bench_impair_seed ^= bench_impair_seed >> 17;
+    bench_impair_seed ^= bench_impair_seed << 5;
+    return range ? bench_impair_seed % range : 0;
+}
+
+static int bench_impair_percent(int percent)
+{
+    return percent > 0 && (int)bench_impair_random(100) < percent;
+}
+
+/* one copy of a datagram, lost, held or sent now when nothing holds it, under the lock */
+static void bench_impair_copy(void *p_socket, const unsigned char *p_data, unsigned int datalen)
+{
+    uint64_t hold_us = (uint64_t)bench_impair.delay_ms * 1000 + bench_impair_random(bench_impair.jitter_ms * 1000 + 1);
+    int i;
+
+    if (bench_impair_percent(bench_impair.loss)) {
+        bench_impair_stats.lost++;
+        return;
+    }
+    if (bench_impair_percent(bench_impair.reorder)) {
+        bench_impair_stats.reordered++;
+        hold_us += (uint64_t)bench_impair.reorder_ms * 1000;
+    }
+
+    if (0 == hold_us) {
+        bench_impair_stats.delivered++;
+        __real_HAL_UDP_write(p_socket, p_data, datalen);
+        return;
+    }
+
+    for (i = 0; i < BENCH_IMPAIR_QUEUE_MAX && bench_impair_queue[i].used; i++);
+    if (i == BENCH_IMPAIR_QUEUE_MAX || datalen > BENCH_IMPAIR_DATAGRAM_MAX) {
+        bench_impair_stats.overflowed++;
+        return;
+    }
+    bench_impair_queue[i].used = 1;
+    bench_impair_queue[i].due_us = HAL_UptimeUs() + hold_us;
+    bench_impair_queue[i].p_socket = p_socket;
+    bench_impair_queue[i].len = datalen;
+    memcpy(bench_impair_queue[i].data, p_data, datalen);
+    bench_impair_held++;
+}
+
+int bench_impair_write(void *p_socket, const unsigned char *p_data, unsigned int datalen)
+{
+    if (!bench_impair_running) {
+        return __real_HAL_UDP_write(p_socket, p_data, datalen);
+    }
+
+    HAL_MutexLock(bench_impair_lock);
+    bench_impair_stats.written++;
+    bench_impair_copy(p_socket, p_data, datalen);
+    if (bench_impair_percent(bench_impair.duplicate)) {
+        bench_impair_stats.duplicated++;
+        bench_impair_copy(p_socket, p_data, datalen);
+    }
+    HAL_MutexUnlock(bench_impair_lock);
+
+    /* as the socket would, a lost datagram was still written */
+    return (int)datalen;
+}
+
+/* the held datagrams due are sent, in the order they fall due within a turn at the most */
+static void *bench_impair_routine(void *arg)
+{
+    uint64_t now;
+    int i;
+
+    while (!bench_impair_stopping) {
+        HAL_MutexLock(bench_impair_lock);
+        now = HAL_UptimeUs();
+        for (i = 0; bench_impair_held && i < BENCH_IMPAIR_QUEUE_MAX; i++) {
+            if (bench_impair_queue[i].used && bench_impair_queue[i].due_us <= now) {
+                __real_HAL_UDP_write(bench_impair_queue[i].p_socket, bench_impair_queue[i].data,
+                                     bench_impair_queue[i].len);
+                bench_impair_queue[i].used = 0;
+                bench_impair_held--;
+                bench_impair_stats.delivered++;
+            }
+        }
+        HAL_MutexUnlock(bench_impair_lock);
+        HAL_SleepMs(1);
+    }
+
+    HAL_SemaphorePost(bench_impair_sem_exit);
+    return NULL;
+}
+
+int bench_impair_start(const bench_impair_t *impair, uint32_t seed)
+{
+    void *thread;
+
+    if (NULL == bench_impair_lock) {
+        bench_impair_lock = HAL_MutexCreate();
+        bench_impair_sem_exit = HAL_SemaphoreCreate();
+        if (NULL == bench_impair_lock || NULL == bench_impair_sem_exit) {
+            return -1;
+        }
+    }
+
+    bench_impair = *impair;
+    bench_impair_seed = seed ? seed : 1;
+    memset(&bench_impair_stats, 0, sizeof(bench_impair_stats));
+    memset(bench_impair_queue, 0, sizeof(bench_impair_queue));
+    bench_impair_held = 0;
+    bench_impair_stopping = 0;
+
+    if (0 != HAL_ThreadCreate(&thread, bench_impair_routine, NULL, NULL, NULL)) {
+        return -1;
+    }
+    HAL_ThreadDetach(thread);
+    bench_impair_running = 1;
+    return 0;
+}
+
+void bench_impair_stop(bench_impair_stats_t *stats)
+{
+    if (!bench_impair_running) {
+        return;
+    }
+
+    bench_impair_running = 0;
+    bench_impair_stopping = 1;
+    (void)HAL_SemaphoreWait(bench_impair_sem_exit, PLATFORM_WAIT_INFINITE);
+
+    bench_impair_stats.lost += bench_impair_held;
+    bench_impair_held = 0;
+    if (NULL != stats) {
+        *stats = bench_impair_stats;
+    }
+}
+
+int __wrap_HAL_UDP_write(void *p_socket, const unsigned char *p_data, unsigned int datalen)
+{
+    return bench_impair_write(p_socket, p_data, datalen);
+}
+
+/* one datagram at a time, each impaired alone */
+int __wrap_HAL_UDP_writeBatch(void *p_socket, const unsigned char **p_data, const unsigned int *p_len,
+                              unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        if (bench_impair_write(p_socket, p_data[i], p_len[i]) < 0) {
+            return (0 == i) ? -1 : (int)i;
+        }
+    }
+
+    return (int)count;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _BENCH_IMPAIR_H_
+#define _BENCH_IMPAIR_H_
+
+/*
+ * A program linked with bench_impair.c and -Wl,--wrap=HAL_UDP_write,--wrap=HAL_UDP_writeBatch has
+ * every datagram the SDK writes go through an impaired link, the way bench_impair_write() sends
+ * the datagrams of a peer. Each one is lost, held, held longer so that the later ones overtake it,
+ * or sent twice, at random from a fixed seed, so that a run is the same each time.
+ */
+
+#include <stdint.h>
+
+/* the datagrams held at once, what comes beyond is lost as a full router queue would lose it */
+#define BENCH_IMPAIR_QUEUE_MAX      (1024)
+#define BENCH_IMPAIR_DATAGRAM_MAX   (1280)
+
+typedef struct {
+    int                 loss;               /* percent of the datagrams lost */
+    int                 delay_ms;           /* every datagram held that long */
+    int                 jitter_ms;          /* and up to that long more */
+    int                 reorder;            /* percent of the datagrams held reorder_ms more */
+    int                 reorder_ms;
+    int                 duplicate;          /* percent of the datagrams sent twice, each copy impaired alone */
+} bench_impair_t;
+
+typedef struct {
+    int                 written;            /* datagrams the SDK or the peer wrote */
+    int                 lost;
+    int                 overflowed;         /* lost as the queue was full */
+    int                 reordered;
+    int                 duplicated;
+    int                 delivered;          /* datagrams sent on, the copies with them */
+} bench_impair_stats_t;
+
+/* 0 when the thread sending the held datagrams runs, the stats start from 0 */
+int     bench_impair_start(const bench_impair_t *impair, uint32_t seed);
+/* the datagrams still held are lost */
+void    bench_impair_stop(bench_impair_stats_t *stats);
+/* of a HAL_UDP_create() socket, or a connected descriptor cast as one, returns len as HAL_UDP_write() */
+int     bench_impair_write(void *p_socket, const unsigned char *p_data, unsigned int datalen);
+
+#endif  /* _BENCH_IMPAIR_H_ */
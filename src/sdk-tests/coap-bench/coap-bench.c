@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * The CON exchanges of iot-coap-c with a loopback server over a link of bench_impair.c, impaired
+ * both ways, for each link profile at each ACK timeout, send window and retransmission mode.
+ * Usage: coap-bench [clean|loss|heavy|delay|reorder|dup|mixed|all] [messages]
+ *
+ * The server answers each request with a piggybacked 2.04, retransmissions too. The application
+ * keeps BENCH_BACKLOG messages in the send list and drives it with CoAPMessage_cycle(), the ACK
+ * timeout is COAP_ACK_TIMEOUT cycle ticks of waittime each, doubled at each retransmission. A
+ * tick waits for the network until it is quiet that long, so under traffic it lasts longer, the
+ * TICK column is the mean tick it took. What the send list holds is sampled at each tick, the
+ * mean weighted by time, a node and its PDU as CoAPMessage_send() allocates them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "lite-metrics.h"
+#include "bench_impair.h"
+
+#define BENCH_MESSAGES_DEFAULT      (200)
+#define BENCH_BACKLOG               (32)
+#define BENCH_PAYLOAD_LEN           (64)
+#define BENCH_RUN_TIMEOUT_MS        (60000)
+#define BENCH_SEED                  (20181014)
+
+typedef struct {
+    const char         *name;
+    bench_impair_t      impair;
+} bench_profile_t;
+
+typedef struct {
+    int                 tick_ms;            /* waittime of the context, the ACK timeout is COAP_ACK_TIMEOUT of them */
+    int                 window;             /* nstart */
+    int                 cocoa;
+} bench_setting_t;
+
+/* loss, delay, jitter, reorder, reorder_ms, duplicate */
+static const bench_profile_t bench_profiles[] = {
+    { "clean",      { 0,  0,  0,  0,  0,  0 } },
+    { "loss",       { 5,  0,  0,  0,  0,  0 } },
+    { "heavy",      { 20, 0,  0,  0,  0,  0 } },
+    { "delay",      { 0,  20, 10, 0,  0,  0 } },
+    { "reorder",    { 0,  5,  0,  20, 15, 0 } },
+    { "dup",        { 0,  0,  0,  0,  0,  20 } },
+    { "mixed",      { 5,  10, 5,  5,  15, 5 } },
+};
+
+static const bench_setting_t bench_settings[] = {
+    { 10, 1, 0 }, { 10, 8, 0 }, { 50, 1, 0 }, { 50, 8, 0 },
+    { 10, 1, 1 }, { 10, 8, 1 }, { 50, 1, 1 }, { 50, 8, 1 },
+};
+
+typedef struct {
+    int                 fd;
+    void               *sem_exit;
+    volatile int        stop;
+    int                 requests;           /* the retransmitted and the duplicated ones too */
+} bench_server_t;
+
+typedef struct {
+    CoAPContext        *ctx;
+    int                 answered;
+    int                 dropped;
+    uint64_t           *sent_us;
+    uint32_t           *took_us;            /* from the send to the response of each answered one */
+    /* what the send list held, since the last sample for the areas */
+    uint64_t            sampled_us;
+    int                 count;
+    int                 bytes;
+    int                 count_peak;
+    int                 bytes_peak;
+    uint64_t            count_area;
+    uint64_t            bytes_area;
+} bench_run_t;
+
+static bench_run_t bench_run;
+
+static void *bench_server_routine(void *arg)
+{
+    bench_server_t *server = (bench_server_t *)arg;
+    unsigned char buf[BENCH_IMPAIR_DATAGRAM_MAX];
+    unsigned char reply[4 + 8];
+    struct sockaddr_in peer, last;
+    socklen_t peer_len;
+    struct timeval tv;
+    fd_set fds;
+    int len, tokenlen;
+
+    memset(&last, 0, sizeof(last));
+    while (!server->stop) {
+        FD_ZERO(&fds);
+        FD_SET(server->fd, &fds);
+        tv.tv_sec = 0;
+        tv.tv_usec = 1000;
+        if (select(server->fd + 1, &fds, NULL, NULL, &tv) <= 0) {
+            continue;
+        }
+
+        peer_len = sizeof(peer);
+        len = recvfrom(server->fd, buf, sizeof(buf), 0, (struct sockaddr *)&peer, &peer_len);
+        tokenlen = len > 0 ? buf[0] & 0x0f : 0;
+        if (len < 4 + tokenlen || tokenlen > 8 || COAP_MESSAGE_TYPE_CON != (buf[0] >> 4 & 0x03)) {
+            continue;
+        }
+        server->requests++;
+
+        /* connected to the client, the replies go through bench_impair_write() as its requests do */
+        if (0 != memcmp(&peer, &last, sizeof(peer))) {
+            connect(server->fd, (struct sockaddr *)&peer, peer_len);
+            last = peer;
+        }
+        reply[0] = COAP_CUR_VERSION << 6 | COAP_MESSAGE_TYPE_ACK << 4 | tokenlen;
+        reply[1] = COAP_MSG_CODE_204_CHANGED;
+        reply[2] = buf[2];
+        reply[3] = buf[3];
+        memcpy(reply + 4, buf + 4, tokenlen);
+        bench_impair_write((void *)(intptr_t)server->fd, reply, 4 + tokenlen);
+    }
+
+    HAL_SemaphorePost(server->sem_exit);
+    return NULL;
+}
+
+static int bench_server_start(bench_server_t *server, uint16_t *port)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    void *thread;
+
+    memset(server, 0, sizeof(bench_server_t));
+    server->sem_exit = HAL_SemaphoreCreate();
+    server->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (NULL == server->sem_exit || server->fd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 != bind(server->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        0 != getsockname(server->fd, (struct sockaddr *)&addr, &addr_len)) {
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+
+    if (0 != HAL_ThreadCreate(&thread, bench_server_routine, server, NULL, NULL)) {
+        return -1;
+    }
+    HAL_ThreadDetach(thread);
+    return 0;
+}
+
+static void bench_server_stop(bench_server_t *server)
+{
+    server->stop = 1;
+    (void)HAL_SemaphoreWait(server->sem_exit, PLATFORM_WAIT_INFINITE);
+    close(server->fd);
+    HAL_SemaphoreDestroy(server->sem_exit);
+}
+
+/* what the send list holds now, its nodes and their PDUs */
+static int bench_list_bytes(CoAPContext *ctx)
+{
+    CoAPSendNode *node;
+    int bytes = 0;
+
+    list_for_each_entry(node, &ctx->list.sendlist, sendlist, CoAPSendNode) {
+        bytes += sizeof(CoAPSendNode) + node->msglen;
+    }
+    return bytes;
+}
+
+/* at each change of the send list, the sends, the responses and the ticks */
+static void bench_sample(void)
+{
+    uint64_t now_us = HAL_UptimeUs();
+
+    bench_run.count_area += (uint64_t)bench_run.count * (now_us - bench_run.sampled_us);
+    bench_run.bytes_area += (uint64_t)bench_run.bytes * (now_us - bench_run.sampled_us);
+    bench_run.sampled_us = now_us;
+    bench_run.count = bench_run.ctx->list.count;
+    bench_run.bytes = bench_list_bytes(bench_run.ctx);
+    bench_run.count_peak = bench_run.count > bench_run.count_peak ? bench_run.count : bench_run.count_peak;
+    bench_run.bytes_peak = bench_run.bytes > bench_run.bytes_peak ? bench_run.bytes : bench_run.bytes_peak;
+}
+
+/* the response of a message, or NULL when it was dropped after its last retransmission */
+static void bench_on_response(void *user, void *message)
+{
+    int seq = (int)(intptr_t)user;
+
+    if (NULL == message) {
+        bench_run.dropped++;
+    } else {
+        bench_run.took_us[bench_run.answered++] = (uint32_t)(HAL_UptimeUs() - bench_run.sent_us[seq]);
+    }
+    bench_sample();
+}
+
+static int bench_send(CoAPContext *ctx, int seq)
+{
+    static unsigned char payload[BENCH_PAYLOAD_LEN];
+    unsigned char token[4];
+    CoAPMessage message;
+    int ret;
+
+    token[0] = seq >> 24;
+    token[1] = seq >> 16;
+    token[2] = seq >> 8;
+    token[3] = seq;
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_CON);
+    CoAPMessageCode_set(&message, COAP_MSG_CODE_POST);
+    CoAPMessageId_set(&message, CoAPMessageId_gen(ctx));
+    CoAPMessageToken_set(&message, token, sizeof(token));
+    CoAPStrOption_add(&message, COAP_OPTION_URI_PATH, (unsigned char *)"bench", 5);
+    CoAPMessagePayload_set(&message, payload, sizeof(payload));
+    CoAPMessageHandler_set(&message, bench_on_response);
+    CoAPMessageUserData_set(&message, (void *)(intptr_t)seq);
+    message.drop_notify = 1;
+
+    bench_run.sent_us[seq] = HAL_UptimeUs();
+    ret = CoAPMessage_send(ctx, &message);
+    CoAPMessage_destory(&message);
+    return ret;
+}
+
+static int bench_metric(const char *name)
+{
+    lite_metric_t *metric = LITE_metrics_find(name);
+
+    return NULL != metric ? LITE_metric_value(metric) : 0;
+}
+
+static int bench_uint32_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int bench_one(const bench_profile_t *profile, const bench_setting_t *setting, int messages)
+{
+    CoAPInitParam param;
+    CoAPContext *ctx;
+    bench_server_t server;
+    bench_impair_stats_t stats;
+    char url[32];
+    uint16_t port;
+    uint64_t start_us, deadline_us;
+    int retransmits, timeouts, ticks;
+    int sent = 0;
+    double took_s;
+
+    memset(&bench_run, 0, sizeof(bench_run));
+    bench_run.sent_us = calloc(messages, sizeof(uint64_t));
+    bench_run.took_us = calloc(messages, sizeof(uint32_t));
+    if (NULL == bench_run.sent_us || NULL == bench_run.took_us ||
+        0 != bench_server_start(&server, &port) || 0 != bench_impair_start(&profile->impair, BENCH_SEED)) {
+        HAL_Printf("%s: loopback server not started\n", profile->name);
+        return -1;
+    }
+
+    snprintf(url, sizeof(url), "coap://127.0.0.1:%u", port);
+    memset(&param, 0, sizeof(param));
+    param.url = url;
+    param.maxcount = BENCH_BACKLOG;
+    param.nstart = setting->window;
+    param.cocoa = setting->cocoa;
+    param.waittime = setting->tick_ms;
+    if (NULL == (ctx = CoAPContext_create(&param))) {
+        HAL_Printf("%s: no CoAP context\n", profile->name);
+        bench_server_stop(&server);
+        bench_impair_stop(NULL);
+        return -1;
+    }
+
+    retransmits = bench_metric("coap.retransmit");
+    timeouts = bench_metric("coap.timeout");
+    ticks = ctx->list.tick;
+    bench_run.ctx = ctx;
+    start_us = bench_run.sampled_us = HAL_UptimeUs();
+    deadline_us = start_us + (uint64_t)BENCH_RUN_TIMEOUT_MS * 1000;
+    while (bench_run.answered + bench_run.dropped < messages && bench_run.sampled_us < deadline_us) {
+        while (sent < messages && ctx->list.count < BENCH_BACKLOG) {
+            if (COAP_SUCCESS != bench_send(ctx, sent)) {
+                bench_run.dropped++;
+            }
+            sent++;
+        }
+        bench_sample();
+
+        CoAPMessage_cycle(ctx);
+        bench_sample();
+    }
+    took_s = (bench_run.sampled_us - start_us) / 1000000.0;
+    retransmits = bench_metric("coap.retransmit") - retransmits;
+    timeouts = bench_metric("coap.timeout") - timeouts;
+    ticks = ctx->list.tick - ticks;
+
+    CoAPContext_free(ctx);
+    bench_server_stop(&server);
+    bench_impair_stop(&stats);
+
+    qsort(bench_run.took_us, bench_run.answered, sizeof(uint32_t), bench_uint32_cmp);
+    HAL_Printf("%-8s %5d %3d %5s %5d %4d %8.1f %7.1f %5d %4d %6.2f %4d %6.1f %6.1f %7.1f %8.2f %8.2f\n",
+               profile->name, setting->tick_ms * COAP_ACK_TIMEOUT, setting->window, setting->cocoa ? "cocoa" : "fixed",
+               bench_run.answered, bench_run.dropped,
+               bench_run.answered / took_s, bench_run.answered * BENCH_PAYLOAD_LEN / took_s / 1024,
+               retransmits, timeouts, ticks ? took_s * 1000 / ticks : 0.0,
+               bench_run.count_peak, bench_run.count_area / (took_s * 1000000), bench_run.bytes_peak / 1024.0,
+               bench_run.bytes_area / (took_s * 1000000) / 1024,
+               bench_run.answered ? bench_run.took_us[(bench_run.answered - 1) / 2] / 1000.0 : 0.0,
+               bench_run.answered ? bench_run.took_us[(bench_run.answered * 99 - 1) / 100] / 1000.0 : 0.0);
+    HAL_Printf("%-8s link: %d written, %d lost, %d overflowed, %d reordered, %d duplicated, %d delivered,"
+               " server: %d requests\n", "", stats.written, stats.lost, stats.overflowed, stats.reordered,
+               stats.duplicated, stats.delivered, server.requests);
+
+    free(bench_run.sent_us);
+    free(bench_run.took_us);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *which = argc > 1 ? argv[1] : "all";
+    int messages = argc > 2 ? atoi(argv[2]) : BENCH_MESSAGES_DEFAULT;
+    int found = 0, i, j;
+
+    if (messages <= 0) {
+        HAL_Printf("usage: %s [clean|loss|heavy|delay|reorder|dup|mixed|all] [messages]\n", argv[0]);
+        return 1;
+    }
+
+    IOT_OpenLog("coap-bench");
+    IOT_SetLogLevel(IOT_LOG_CRIT);
+
+    HAL_Printf("%d CON messages of %d bytes per run, %d in the send list at most\n",
+               messages, BENCH_PAYLOAD_LEN, BENCH_BACKLOG);
+    for (i = 0; i < (int)(sizeof(bench_profiles) / sizeof(bench_profiles[0])); i++) {
+        if (0 != strcmp(which, "all") && 0 != strcmp(which, bench_profiles[i].name)) {
+            continue;
+        }
+        found = 1;
+        HAL_Printf("%-8s %5s %3s %5s %5s %4s %8s %7s %5s %4s %6s %4s %6s %6s %7s %8s %8s\n",
+                   "PROFILE", "ACKms", "WIN", "MODE", "DONE", "DROP", "MSG/s", "KB/s", "RETX", "TMO", "TICKms",
+                   "LIST", "MEAN", "PEAKKB", "MEANKB", "P50ms", "P99ms");
+        for (j = 0; j < (int)(sizeof(bench_settings) / sizeof(bench_settings[0])); j++) {
+            bench_one(&bench_profiles[i], &bench_settings[j], messages);
+        }
+    }
+
+    if (!found) {
+        HAL_Printf("usage: %s [clean|loss|heavy|delay|reorder|dup|mixed|all] [messages]\n", argv[0]);
+        return 1;
+    }
+
+    IOT_CloseLog();
+    return 0;
+}
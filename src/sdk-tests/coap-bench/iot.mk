@@ -0,0 +1,14 @@
+TARGET      := coap-bench
+HDR_REFS    := src
+SRCS        := $(wildcard $(TOP_DIR)/$(MODULE_NAME)/*.c)
+CFLAGS      := $(filter-out -ansi,$(CFLAGS))
+
+LDFLAGS     += -liot_sdk
+LDFLAGS     += -liot_platform
+LDFLAGS     += -Bstatic -liot_tls
+ifneq (,$(filter -DMBEDTLS_SHA1_PROCESS_ALT,$(CFLAGS)))
+# the sha blocks of mbedtls are in libiot_platform, which takes them from libiot_sdk
+LDFLAGS     += -liot_platform -liot_sdk
+endif
+# every datagram of the sdk through the impaired link, see bench_impair.c
+LDFLAGS     += -Wl,--wrap=HAL_UDP_write,--wrap=HAL_UDP_writeBatch
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Throughput of the SDK digests the way OTA uses them: an image streamed through
+ * one context a chunk at a time. Usage: digest-bench [image MB] [chunk bytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "utils_md5.h"
+#include "utils_sha1.h"
+#include "utils_sha256.h"
+
+#define BENCH_IMAGE_MB_DEFAULT      (16)
+#define BENCH_CHUNK_DEFAULT         (1024)
+#define BENCH_MIN_MS                (1000)
+
+typedef struct {
+    const char *name;
+    int digest_len;
+    void (*digest)(const unsigned char *input, size_t ilen, unsigned char *output, uint32_t chunk);
+    const char *abc;    /* digest of "abc", checked before timing */
+} bench_digest_t;
+
+static void bench_md5(const unsigned char *input, size_t ilen, unsigned char *output, uint32_t chunk)
+{
+    iot_md5_context ctx;
+    size_t off, n;
+
+    utils_md5_init(&ctx);
+    utils_md5_starts(&ctx);
+    for (off = 0; off < ilen; off += n) {
+        n = (ilen - off < chunk) ? ilen - off : chunk;
+        utils_md5_update(&ctx, input + off, n);
+    }
+    utils_md5_finish(&ctx, output);
+    utils_md5_free(&ctx);
+}
+
+static void bench_sha1(const unsigned char *input, size_t ilen, unsigned char *output, uint32_t chunk)
+{
+    iot_sha1_context ctx;
+    size_t off, n;
+
+    utils_sha1_init(&ctx);
+    utils_sha1_starts(&ctx);
+    for (off = 0; off < ilen; off += n) {
+        n = (ilen - off < chunk) ? ilen - off : chunk;
+        utils_sha1_update(&ctx, input + off, n);
+    }
+    utils_sha1_finish(&ctx, output);
+    utils_sha1_free(&ctx);
+}
+
+static void bench_sha256(const unsigned char *input, size_t ilen, unsigned char *output, uint32_t chunk)
+{
+    iot_sha256_context ctx;
+    size_t off, n;
+
+    utils_sha256_init(&ctx);
+    utils_sha256_starts(&ctx);
+    for (off = 0; off < ilen; off += n) {
+        n = (ilen - off < chunk) ? ilen - off : chunk;
+        utils_sha256_update(&ctx, input + off, n);
+    }
+    utils_sha256_finish(&ctx, output);
+    utils_sha256_free(&ctx);
+}
+
+static const bench_digest_t bench_digests[] = {
+    {"md5",     16, bench_md5,    "900150983cd24fb0d6963f7d28e17f72"},
+    {"sha1",    20, bench_sha1,   "a9993e364706816aba3e25717850c26c9cd0d89d"},
+    {"sha256",  32, bench_sha256, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+};
+
+static void bench_hex(const unsigned char *digest, int len, char *hex)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        sprintf(hex + i * 2, "%02x", digest[i]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t image_mb = BENCH_IMAGE_MB_DEFAULT;
+    uint32_t chunk = BENCH_CHUNK_DEFAULT;
+    size_t image_len, i;
+    unsigned char *image, digest[32];
+    char hex[65];
+    uint64_t start, elapsed;
+    uint32_t rounds;
+    int d, ret = 0;
+
+    if (argc > 1) {
+        image_mb = (uint32_t)atoi(argv[1]);
+    }
+    if (argc > 2) {
+        chunk = (uint32_t)atoi(argv[2]);
+    }
+    if (0 == image_mb || 0 == chunk) {
+        HAL_Printf("usage: %s [image MB] [chunk bytes]\n", argv[0]);
+        return 1;
+    }
+
+    image_len = (size_t)image_mb * 1024 * 1024;
+    image = malloc(image_len);
+    if (NULL == image) {
+        HAL_Printf("no memory for a %u MB image\n", image_mb);
+        return 1;
+    }
+    for (i = 0; i < image_len; i++) {
+        image[i] = (unsigned char)(i * 31 + (i >> 11));
+    }
+
+    HAL_Printf("%u MB image in %u byte chunks\n", image_mb, chunk);
+    for (d = 0; d < sizeof(bench_digests) / sizeof(bench_digests[0]); d++) {
+        const bench_digest_t *b = &bench_digests[d];
+
+        b->digest((const unsigned char *)"abc", 3, digest, chunk);
+        bench_hex(digest, b->digest_len, hex);
+        if (0 != strcmp(hex, b->abc)) {
+            HAL_Printf("%-8s wrong digest %s\n", b->name, hex);
+            ret = 1;
+            continue;
+        }
+
+        rounds = 0;
+        start = HAL_UptimeMs();
+        do {
+            b->digest(image, image_len, digest, chunk);
+            rounds++;
+            elapsed = HAL_UptimeMs() - start;
+        } while (elapsed < BENCH_MIN_MS);
+
+        bench_hex(digest, b->digest_len, hex);
+        HAL_Printf("%-8s %8.1f MB/s  %s\n", b->name,
+                   (double)image_mb * rounds * 1000 / (double)elapsed, hex);
+    }
+
+    free(image);
+    return ret;
+}
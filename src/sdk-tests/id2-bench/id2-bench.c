@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Cost per message of the AES-128-CBC of ID2 protected payloads, with the key expanded for every
+ * message as tfs_aes128_cbc_enc/dec do, and with the schedule of the connection reused as
+ * src/tfs/id2_crypto.c does. Payloads are zero padded to whole blocks, CBC runs in place.
+ * Built with FEATURE_HAL_CRYPTO_AES_ENABLED the blocks go through HAL_Crypto_Aes*.
+ * Usage: id2-bench [ms per case]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "mbedtls/aes.h"
+
+#define BENCH_MIN_MS_DEFAULT        (500)
+#define BENCH_PAYLOAD_MAX           (4096)
+
+static const uint32_t bench_payloads[] = {16, 64, 256, 1024, 4096};
+
+static const unsigned char bench_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static unsigned char bench_buf[BENCH_PAYLOAD_MAX];
+
+/* one message, the key expanded for it alone */
+static int bench_per_message(int mode, unsigned char *buf, uint32_t len)
+{
+    mbedtls_aes_context aes;
+    unsigned char iv[16] = {0};
+    int ret;
+
+    mbedtls_aes_init(&aes);
+    if (MBEDTLS_AES_ENCRYPT == mode) {
+        ret = mbedtls_aes_setkey_enc(&aes, bench_key, 128);
+    } else {
+        ret = mbedtls_aes_setkey_dec(&aes, bench_key, 128);
+    }
+    if (0 == ret) {
+        ret = mbedtls_aes_crypt_cbc(&aes, mode, len, iv, buf, buf);
+    }
+    mbedtls_aes_free(&aes);
+
+    return ret;
+}
+
+/* one message on the schedule of the connection */
+static int bench_cached(mbedtls_aes_context *aes, int mode, unsigned char *buf, uint32_t len)
+{
+    unsigned char iv[16] = {0};
+
+    return mbedtls_aes_crypt_cbc(aes, mode, len, iv, buf, buf);
+}
+
+/* ns per message, 0 on a failure */
+static double bench_case(mbedtls_aes_context *cached, int mode, uint32_t len, uint32_t min_ms)
+{
+    uint64_t start, elapsed;
+    uint32_t rounds = 0;
+
+    start = HAL_UptimeMs();
+    do {
+        if (0 != (cached ? bench_cached(cached, mode, bench_buf, len) : bench_per_message(mode, bench_buf, len))) {
+            return 0;
+        }
+        rounds++;
+        elapsed = HAL_UptimeMs() - start;
+    } while (elapsed < min_ms);
+
+    return (double)elapsed * 1000000 / rounds;
+}
+
+/* both ways give the same ciphertext and get the payload back */
+static int bench_check(mbedtls_aes_context *enc, mbedtls_aes_context *dec)
+{
+    unsigned char plain[64], a[64], b[64];
+    int i;
+
+    for (i = 0; i < sizeof(plain); i++) {
+        plain[i] = (unsigned char)(i * 7 + 1);
+    }
+    memcpy(a, plain, sizeof(a));
+    memcpy(b, plain, sizeof(b));
+    if (0 != bench_per_message(MBEDTLS_AES_ENCRYPT, a, sizeof(a))
+        || 0 != bench_cached(enc, MBEDTLS_AES_ENCRYPT, b, sizeof(b))
+        || 0 != memcmp(a, b, sizeof(a))) {
+        return -1;
+    }
+    if (0 != bench_per_message(MBEDTLS_AES_DECRYPT, a, sizeof(a))
+        || 0 != bench_cached(dec, MBEDTLS_AES_DECRYPT, b, sizeof(b))
+        || 0 != memcmp(a, plain, sizeof(a)) || 0 != memcmp(b, plain, sizeof(b))) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t min_ms = BENCH_MIN_MS_DEFAULT;
+    mbedtls_aes_context enc, dec;
+    double before, after;
+    int i, m, ret = 0;
+
+    if (argc > 1) {
+        min_ms = (uint32_t)atoi(argv[1]);
+    }
+    if (0 == min_ms) {
+        HAL_Printf("usage: %s [ms per case]\n", argv[0]);
+        return 1;
+    }
+
+    mbedtls_aes_init(&enc);
+    mbedtls_aes_init(&dec);
+    if (0 != mbedtls_aes_setkey_enc(&enc, bench_key, 128) || 0 != mbedtls_aes_setkey_dec(&dec, bench_key, 128)
+        || 0 != bench_check(&enc, &dec)) {
+        HAL_Printf("aes-128-cbc self check failed\n");
+        ret = 1;
+        goto exit;
+    }
+
+    for (i = 0; i < sizeof(bench_buf); i++) {
+        bench_buf[i] = (unsigned char)(i * 31 + (i >> 7));
+    }
+
+    HAL_Printf("%-8s %8s %14s %14s %8s\n", "", "payload", "per msg ns", "cached ns", "speedup");
+    for (m = 0; m < 2; m++) {
+        int mode = m ? MBEDTLS_AES_DECRYPT : MBEDTLS_AES_ENCRYPT;
+
+        for (i = 0; i < sizeof(bench_payloads) / sizeof(bench_payloads[0]); i++) {
+            before = bench_case(NULL, mode, bench_payloads[i], min_ms);
+            after = bench_case(m ? &dec : &enc, mode, bench_payloads[i], min_ms);
+            if (0 == before || 0 == after) {
+                HAL_Printf("%-8s %8u failed\n", m ? "decrypt" : "encrypt", bench_payloads[i]);
+                ret = 1;
+                continue;
+            }
+            HAL_Printf("%-8s %8u %14.0f %14.0f %7.2fx\n", m ? "decrypt" : "encrypt", bench_payloads[i],
+                       before, after, before / after);
+        }
+    }
+
+exit:
+    mbedtls_aes_free(&enc);
+    mbedtls_aes_free(&dec);
+    return ret;
+}
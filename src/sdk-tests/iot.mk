@@ -1,7 +1,10 @@
 TARGET      := sdk-testsuites
-HDR_REFS    := src build-rules
+HDR_REFS    := src build-rules sample/linkkit/include
 SRCS        := $(wildcard $(TOP_DIR)/$(MODULE_NAME)/*.c)
 SRCS        += $(TOP_DIR)/build-rules/misc/cut.c
+SRCS        += $(TOP_DIR)/sample/linkkit/src/lite_ring.c
+# the benches below build on their own, keep their sources out of the scan of this module
+LIB_SRCS    := $(wildcard $(TOP_DIR)/$(MODULE_NAME)/*.c)
 CFLAGS      := $(filter-out -ansi,$(CFLAGS))
 
 
@@ -12,4 +15,10 @@ LDFLAGS     += -ltfs
 endif
 
 LDFLAGS     += -Bstatic -liot_tls
-LDFLAGS     += -liot_sdk
\ No newline at end of file
+ifneq (,$(filter -DMBEDTLS_SHA1_PROCESS_ALT,$(CFLAGS)))
+# the sha blocks of mbedtls are in libiot_platform, which takes them from libiot_sdk
+LDFLAGS     += -liot_platform -liot_sdk
+endif
+LDFLAGS     += -liot_sdk
+# the HAL and TLS of what the cases pull out of libiot_sdk, as the DTLS and UDP of the CoAP client of the channels
+LDFLAGS     += -liot_platform -liot_tls
@@ -0,0 +1,24 @@
+TARGET      := linkkit-bench
+HDR_REFS    := src sample/linkkit/include src/sdk-tests/mqtt-bench
+SRCS        := $(TOP_DIR)/$(MODULE_NAME)/linkkit-bench.c \
+               $(TOP_DIR)/src/sdk-tests/mqtt-bench/bench_broker.c \
+               $(TOP_DIR)/src/sdk-tests/mqtt-bench/bench_heap.c \
+               $(TOP_DIR)/src/sdk-tests/mqtt-bench/bench_redirect.c \
+               $(TOP_DIR)/sample/linkkit/src/linkkit_export.c \
+               $(TOP_DIR)/sample/linkkit/src/lite_queue.c \
+               $(TOP_DIR)/sample/linkkit/src/lite_ring.c
+CFLAGS      := $(filter-out -ansi,$(CFLAGS))
+
+LDFLAGS     += -liot_dm
+LDFLAGS     += -liot_sdk
+LDFLAGS     += -liot_platform
+LDFLAGS     += -Bstatic -liot_tls
+ifneq (,$(filter -DMBEDTLS_SHA1_PROCESS_ALT,$(CFLAGS)))
+# the sha blocks of mbedtls are in libiot_platform, which takes them from libiot_sdk
+LDFLAGS     += -liot_platform -liot_sdk
+endif
+# every connection of the sdk to the loopback broker, see bench_redirect.c
+LDFLAGS     += -Wl,--wrap=HAL_TCP_Establish,--wrap=HAL_SSL_Establish,--wrap=HAL_SSL_Destroy
+LDFLAGS     += -Wl,--wrap=HAL_SSL_Read,--wrap=HAL_SSL_Write,--wrap=HAL_SSL_Writev
+# what the sdk takes from HAL_Malloc, see bench_heap.c
+LDFLAGS     += -Wl,--wrap=HAL_Malloc,--wrap=HAL_Free
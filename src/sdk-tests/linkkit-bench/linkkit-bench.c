@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Round trip of the thing model of linkkit: thing.service.property.set sent by the loopback broker
+ * of src/sdk-tests/mqtt-bench, to thing_prop_changed, to the property post written by cmp_impl_send
+ * on the connection. Latencies are from the set leaving the broker, as percentiles and a histogram.
+ * Usage: linkkit-bench [properties] [sets] [properties per set] [sets per second]
+ *
+ * The thing has 'properties' properties, Prop0 is the one the sets carry their sequence number in.
+ * The property is read when linkkit_dispatch hands it over, sets overwritten before are counted lost.
+ * A set of more than one property is posted back whole, which fails past what the DM payload takes
+ * (around 100 of these properties), the failed posts are counted.
+ * Built with WITH_TRACE, the last points of lite-trace.h are printed for src/scripts/trace_latency.py.
+ * The metrics of lite-metrics.h are printed at the end as one line, empty without WITH_METRICS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "linkkit_export.h"
+#include "lite-trace.h"
+#include "lite-metrics.h"
+#include "bench_broker.h"
+
+#define BENCH_PROPERTIES_DEFAULT    (50)
+#define BENCH_PROPERTIES_MAX        (2000)
+#define BENCH_SETS_DEFAULT          (500)
+#define BENCH_RATE_DEFAULT          (100)
+#define BENCH_BUFFERED_MSG          (64)
+#define BENCH_PHASE_TIMEOUT_MS      (60000)
+#define BENCH_HISTOGRAM_BUCKETS     (16)
+/* the first bucket, each next one twice as wide */
+#define BENCH_HISTOGRAM_FIRST_US    (64)
+
+#define BENCH_PRODUCT_KEY           "bench_pk"
+#define BENCH_DEVICE_NAME           "bench_dn"
+
+/* the latency of each set in us, 0 when it did not make it */
+typedef struct {
+    const char         *name;
+    uint32_t           *latency;
+    int                 num;
+    int                 done;
+} bench_op_t;
+
+static const char *bench_tsl_types[] = {"int", "float", "text", "enum"};
+static const char *bench_tsl_specs[] = {
+    "{\"min\":\"0\",\"max\":\"2147483647\",\"step\":\"1\"}",
+    "{\"min\":\"-40.0\",\"max\":\"85.0\",\"unit\":\"C\",\"step\":\"0.1\"}",
+    "{\"length\":\"255\"}",
+    "{\"0\":\"off\",\"1\":\"low\",\"2\":\"high\"}",
+};
+static const char *bench_set_values[] = {"1", "21.5", "\"bench\"", "1"};
+
+static bench_broker_t bench_broker;
+static bench_op_t bench_changed;
+static bench_op_t bench_posted;
+static int bench_post_all;
+static int bench_post_failed;
+
+/* a thing model the way the cloud sends it, of num properties posted and set as a whole */
+static char *bench_tsl(int num)
+{
+    int size = 1024 + num * 512;
+    char *tsl = malloc(size);
+    int len, i, pass;
+
+    if (NULL == tsl) {
+        return NULL;
+    }
+
+    len = snprintf(tsl, size,
+                   "{\"schema\":\"https://iot-tsl.oss-cn-shanghai.aliyuncs.com/schema.json\","
+                   "\"profile\":{\"productKey\":\"" BENCH_PRODUCT_KEY "\",\"deviceName\":\"" BENCH_DEVICE_NAME "\"},"
+                   "\"properties\":[");
+    for (i = 0; i < num; i++) {
+        len += snprintf(tsl + len, size - len,
+                        "%s{\"identifier\":\"Prop%d\",\"name\":\"property %d\",\"accessMode\":\"rw\","
+                        "\"required\":%s,\"dataType\":{\"type\":\"%s\",\"specs\":%s}}",
+                        i ? "," : "", i, i, (i % 7) ? "false" : "true",
+                        bench_tsl_types[i % 4], bench_tsl_specs[i % 4]);
+    }
+
+    /* the post event and the set service list the properties again */
+    for (pass = 0; pass < 2; pass++) {
+        len += snprintf(tsl + len, size - len, pass ?
+                        "],\"services\":[{\"identifier\":\"set\",\"name\":\"set\",\"required\":true,"
+                        "\"callType\":\"async\",\"method\":\"thing.service.property.set\",\"outputData\":[],"
+                        "\"inputData\":[" :
+                        "],\"events\":[{\"identifier\":\"post\",\"name\":\"post\",\"type\":\"info\","
+                        "\"required\":true,\"method\":\"thing.event.property.post\",\"outputData\":[");
+        for (i = 0; i < num; i++) {
+            len += snprintf(tsl + len, size - len,
+                            "%s{\"identifier\":\"Prop%d\",\"name\":\"property %d\","
+                            "\"dataType\":{\"type\":\"%s\",\"specs\":%s}}",
+                            i ? "," : "", i, i, bench_tsl_types[i % 4], bench_tsl_specs[i % 4]);
+        }
+        len += snprintf(tsl + len, size - len, "]}");
+    }
+    snprintf(tsl + len, size - len, "]}");
+
+    return tsl;
+}
+
+/* the payload of the sets, formatted by the broker with the sequence number into the id and Prop0 */
+static char *bench_set_format(int num)
+{
+    int size = 256 + num * 32;
+    char *fmt = malloc(size);
+    int len, i;
+
+    if (NULL == fmt) {
+        return NULL;
+    }
+
+    len = snprintf(fmt, size, "{\"id\":\"%%1$u\",\"version\":\"1.0\",\"method\":\"thing.service.property.set\","
+                   "\"params\":{\"Prop0\":%%1$u");
+    for (i = 1; i < num; i++) {
+        len += snprintf(fmt + len, size - len, ",\"Prop%d\":%s", i, bench_set_values[i % 4]);
+    }
+    snprintf(fmt + len, size - len, "}}");
+
+    return fmt;
+}
+
+static int bench_op_init(bench_op_t *op, const char *name, int num)
+{
+    memset(op, 0, sizeof(bench_op_t));
+    op->name = name;
+    op->num = num;
+    op->latency = calloc(num, sizeof(uint32_t));
+    return (NULL == op->latency) ? -1 : 0;
+}
+
+/* the set 'seq' got this far, the ones seen already or never sent are ignored */
+static void bench_op_complete(bench_op_t *op, int seq)
+{
+    uint64_t sent_us = bench_broker_sent_us(&bench_broker, seq);
+
+    if (seq < 0 || seq >= op->num || 0 == sent_us || 0 != op->latency[seq]) {
+        return;
+    }
+    op->latency[seq] = (uint32_t)(bench_now_us() - sent_us);
+    op->latency[seq] += op->latency[seq] ? 0 : 1;
+    op->done++;
+}
+
+static int bench_uint32_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* percentiles of the sets that made it and their histogram, the latencies are sorted */
+static void bench_op_report(bench_op_t *op)
+{
+    int counts[BENCH_HISTOGRAM_BUCKETS] = {0};
+    int lost = op->num - op->done, i, k, bar;
+    uint32_t bound;
+
+    qsort(op->latency, op->num, sizeof(uint32_t), bench_uint32_cmp);
+    if (0 == op->done) {
+        HAL_Printf("%-28s %6d ok %5d lost\n", op->name, 0, lost);
+        return;
+    }
+
+    /* lost ones are 0 and sorted first */
+    HAL_Printf("%-28s %6d ok %5d lost  p50 %8.3f ms  p90 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n",
+               op->name, op->done, lost,
+               op->latency[lost + (op->done - 1) / 2] / 1000.0,
+               op->latency[lost + (op->done * 90 - 1) / 100] / 1000.0,
+               op->latency[lost + (op->done * 99 - 1) / 100] / 1000.0,
+               op->latency[op->num - 1] / 1000.0);
+
+    for (i = lost; i < op->num; i++) {
+        for (k = 0, bound = BENCH_HISTOGRAM_FIRST_US; k < BENCH_HISTOGRAM_BUCKETS - 1 && op->latency[i] > bound; k++) {
+            bound *= 2;
+        }
+        counts[k]++;
+    }
+    for (k = 0, bound = BENCH_HISTOGRAM_FIRST_US; k < BENCH_HISTOGRAM_BUCKETS; k++, bound *= 2) {
+        if (0 == counts[k]) {
+            continue;
+        }
+        bar = (counts[k] * 50 + op->done - 1) / op->done;
+        HAL_Printf("    %s %9.3f ms %6d %.*s\n", k < BENCH_HISTOGRAM_BUCKETS - 1 ? "<=" : "> ",
+                   (k < BENCH_HISTOGRAM_BUCKETS - 1 ? bound : bound / 2) / 1000.0, counts[k], bar,
+                   "##################################################");
+    }
+}
+
+static const char *bench_memmem(const char *buf, int len, const char *s)
+{
+    int n = strlen(s), i;
+
+    for (i = 0; i + n <= len; i++) {
+        if (buf[i] == s[0] && 0 == memcmp(buf + i, s, n)) {
+            return buf + i;
+        }
+    }
+
+    return NULL;
+}
+
+/* what cmp_impl_send has written, the property posts carry the sequence number in Prop0 */
+static void bench_on_write(const char *buf, int len)
+{
+    const char *p;
+    int seq = 0;
+
+    if (NULL == bench_memmem(buf, len, "thing.event.property.post") ||
+        NULL == (p = bench_memmem(buf, len, "\"Prop0\":"))) {
+        return;
+    }
+    for (p += 8; p < buf + len && *p >= '0' && *p <= '9'; p++) {
+        seq = seq * 10 + *p - '0';
+    }
+    bench_op_complete(&bench_posted, seq);
+}
+
+static int bench_prop_changed(void *thing_id, char *property, void *ctx)
+{
+    int seq = -1;
+
+    if (0 != strcmp(property, "Prop0") ||
+        0 != linkkit_get_value(linkkit_method_get_property_value, thing_id, property, &seq, NULL)) {
+        return 0;
+    }
+    bench_op_complete(&bench_changed, seq);
+
+    /* the way an application reports back what the cloud set */
+    if (0 != linkkit_post_property(thing_id, bench_post_all ? NULL : property)) {
+        bench_post_failed++;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static linkkit_ops_t ops;
+    linkkit_dispatch_stats_t stats;
+    int properties = argc > 1 ? atoi(argv[1]) : BENCH_PROPERTIES_DEFAULT;
+    int sets = argc > 2 ? atoi(argv[2]) : BENCH_SETS_DEFAULT;
+    int set_properties = argc > 3 ? atoi(argv[3]) : 1;
+    int rate = argc > 4 ? atoi(argv[4]) : BENCH_RATE_DEFAULT;
+    uint32_t deadline, grace = 0;
+    char *tsl, *fmt, *metrics;
+    int metrics_len;
+    int ctx = 0;
+
+    if (properties <= 0 || properties > BENCH_PROPERTIES_MAX || sets <= 0 || rate <= 0 ||
+        set_properties <= 0 || set_properties > properties) {
+        HAL_Printf("usage: %s [properties, 1 to %d] [sets] [properties per set] [sets per second]\n",
+                   argv[0], BENCH_PROPERTIES_MAX);
+        return 1;
+    }
+    bench_post_all = set_properties > 1;
+
+    signal(SIGPIPE, SIG_IGN);
+    IOT_OpenLog("linkkit-bench");
+    IOT_SetLogLevel(IOT_LOG_CRIT);
+
+    tsl = bench_tsl(properties);
+    fmt = bench_set_format(set_properties);
+    if (NULL == tsl || NULL == fmt || 0 != bench_broker_start(&bench_broker) ||
+        0 != bench_op_init(&bench_changed, "set to thing_prop_changed", sets) ||
+        0 != bench_op_init(&bench_posted, "set to property post", sets)) {
+        HAL_Printf("loopback broker not started\n");
+        return 1;
+    }
+    bench_redirect(bench_broker.port, bench_on_write);
+    HAL_Printf("%d properties, %d sets of %d properties at %d/s, loopback broker at port %u\n",
+               properties, sets, set_properties, rate, bench_broker.port);
+
+    HAL_SetProductKey(BENCH_PRODUCT_KEY);
+    HAL_SetDeviceName(BENCH_DEVICE_NAME);
+    HAL_SetDeviceSecret("bench");
+
+    ops.thing_prop_changed = bench_prop_changed;
+    if (0 != linkkit_start(BENCH_BUFFERED_MSG, 0, linkkit_loglevel_crit, &ops, linkkit_cloud_domain_sh, &ctx) ||
+        NULL == linkkit_set_tsl(tsl, strlen(tsl)) ||
+        0 != bench_broker_inject(&bench_broker, "/sys/" BENCH_PRODUCT_KEY "/" BENCH_DEVICE_NAME
+                                 "/thing/service/property/set", fmt, sets, rate)) {
+        HAL_Printf("linkkit not started\n");
+        bench_broker_stop(&bench_broker);
+        return 1;
+    }
+
+    /* till every post is written, or the broker sent the last set BENCH_YIELD_MS * 100 ago */
+    deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS + sets * 1000 / rate;
+    while (bench_posted.done < sets && HAL_UptimeMs() < deadline) {
+        linkkit_dispatch();
+#ifdef CMP_SUPPORT_MULTI_THREAD
+        HAL_SleepMs(BENCH_YIELD_MS);
+#else
+        linkkit_yield(BENCH_YIELD_MS);
+#endif
+        if (0 == grace && bench_broker_get(&bench_broker, &bench_broker.inject_sent) == sets) {
+            grace = HAL_UptimeMs() + BENCH_YIELD_MS * 100;
+        }
+        if (0 != grace && HAL_UptimeMs() > grace) {
+            break;
+        }
+    }
+
+    bench_op_report(&bench_changed);
+    bench_op_report(&bench_posted);
+    HAL_Printf("%d property posts failed\n", bench_post_failed);
+    if (0 == linkkit_get_dispatch_stats(&stats)) {
+        HAL_Printf("%u dropped by the dispatch queue\n", stats.dropped);
+    }
+    HAL_Printf("heap peak %u bytes\n", bench_heap_peak());
+    metrics_len = LITE_metrics_format(NULL, 0) + 1;
+    if (NULL != (metrics = malloc(metrics_len))) {
+        LITE_metrics_format(metrics, metrics_len);
+        HAL_Printf("metrics %s\n", metrics);
+        free(metrics);
+    }
+    LITE_trace_dump();
+
+    linkkit_end();
+    bench_broker_stop(&bench_broker);
+    free(bench_changed.latency);
+    free(bench_posted.latency);
+    free(tsl);
+    free(fmt);
+    IOT_CloseLog();
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+#include "lite_ring.h"
+
+#define THING_NUMBER    256
+#define THING_SIZE      96
+
+/* things are allocated as dm allocates them, and every ring of 2, 4 and 8 gets some of them. */
+CASE(LITE_RING, pick_spreads_things) {
+    void           *things[THING_NUMBER];
+    int             picked[8];
+    int             ring_number;
+    int             index;
+
+    for (index = 0; index < THING_NUMBER; index++) {
+        things[index] = LITE_calloc(1, THING_SIZE);
+        ASSERT_NOT_NULL(things[index]);
+    }
+
+    for (ring_number = 2; ring_number <= 8; ring_number *= 2) {
+        memset(picked, 0, sizeof(picked));
+        for (index = 0; index < THING_NUMBER; index++) {
+            picked[lite_ring_pick(things[index], ring_number)]++;
+        }
+        for (index = 0; index < ring_number; index++) {
+            log_debug("%d rings, ring %d picked %d times", ring_number, index, picked[index]);
+            ASSERT_GT(picked[index], 0);
+        }
+    }
+
+    for (index = 0; index < THING_NUMBER; index++) {
+        LITE_free(things[index]);
+    }
+}
+
+/* one key goes to one ring, so the messages of a thing keep their order. */
+CASE(LITE_RING, pick_is_stable) {
+    void           *thing = LITE_calloc(1, THING_SIZE);
+
+    ASSERT_NOT_NULL(thing);
+    ASSERT_EQ(lite_ring_pick(thing, 4), lite_ring_pick(thing, 4));
+    ASSERT_LT(lite_ring_pick(thing, 4), 4);
+    ASSERT_EQ(lite_ring_pick(thing, 0), 0);
+
+    LITE_free(thing);
+}
+
+SUITE(LITE_RING) = {
+    ADD_CASE(LITE_RING, pick_spreads_things),
+    ADD_CASE(LITE_RING, pick_is_stable),
+    ADD_CASE_NULL
+};
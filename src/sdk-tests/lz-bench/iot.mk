@@ -0,0 +1,11 @@
+TARGET      := lz-bench
+HDR_REFS    := src
+CFLAGS      := $(filter-out -ansi,$(CFLAGS))
+
+LDFLAGS     += -liot_sdk
+LDFLAGS     += -liot_platform
+LDFLAGS     += -Bstatic -liot_tls
+ifneq (,$(filter -DMBEDTLS_SHA1_PROCESS_ALT,$(CFLAGS)))
+# the sha blocks of mbedtls are in libiot_platform, which takes them from libiot_sdk
+LDFLAGS     += -liot_platform -liot_sdk
+endif
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Size and cost of the frames utils_lz makes of uplinks as linkkit sends them with
+ * PAYLOAD_COMPRESS_ENABLED: a property post with long text fields, an event with a diagnostic
+ * log, and random bytes that do not compress. Each frame is decoded back and compared, then
+ * every truncation and a run of corruptions of it must be refused or decode within bounds.
+ * Usage: lz-bench [ms per case]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "utils_lz.h"
+
+#define BENCH_MIN_MS_DEFAULT        (500)
+#define BENCH_PAYLOAD_MAX           (8192)
+
+typedef enum {
+    BENCH_PROPERTY = 0,
+    BENCH_DIAGNOSTIC,
+    BENCH_RANDOM,
+    BENCH_KINDS
+} bench_kind_t;
+
+static const char *bench_kind_names[BENCH_KINDS] = {"property", "diag", "random"};
+static const uint32_t bench_payloads[] = {1024, 2048, 4096, 8192};
+
+static uint8_t bench_plain[BENCH_PAYLOAD_MAX];
+static uint8_t bench_frame[BENCH_PAYLOAD_MAX];
+static uint8_t bench_back[BENCH_PAYLOAD_MAX];
+static uint32_t bench_seed = 1;
+
+static uint32_t bench_rand(void)
+{
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return bench_seed >> 8;
+}
+
+/* len bytes of a payload of the kind */
+static void bench_fill(bench_kind_t kind, uint8_t *buf, uint32_t len)
+{
+    static const char *levels[] = {"INFO", "WARN", "DEBUG"};
+    static const char *modules[] = {"wifi", "sensor", "power", "storage"};
+    char line[160];
+    uint32_t pos = 0, n, i;
+
+    bench_seed = 1;
+    while (pos < len) {
+        if (BENCH_RANDOM == kind) {
+            buf[pos++] = (uint8_t)bench_rand();
+            continue;
+        }
+        if (BENCH_PROPERTY == kind) {
+            n = HAL_Snprintf(line, sizeof(line),
+                             "{\"Description_%u\":{\"value\":\"room %u on floor %u, west wing near the lift\",\"time\":%u},",
+                             bench_rand() % 64, bench_rand() % 500, bench_rand() % 30, 1523000000 + bench_rand() % 100000);
+        } else {
+            n = HAL_Snprintf(line, sizeof(line), "[%8u.%03u] <%s> %s: rssi=%d, retries=%u, heap=%u\\n",
+                             bench_rand() % 100000, bench_rand() % 1000, levels[bench_rand() % 3],
+                             modules[bench_rand() % 4], -40 - (int)(bench_rand() % 50), bench_rand() % 8,
+                             30000 + bench_rand() % 20000);
+        }
+        for (i = 0; i < n && pos < len; i++) {
+            buf[pos++] = (uint8_t)line[i];
+        }
+    }
+}
+
+/* ns per call of the frame encode, or of the decode when decode is set, 0 on a failure */
+static double bench_case(int decode, uint32_t len, int frame_len, uint32_t min_ms)
+{
+    uint64_t start, elapsed;
+    uint32_t rounds = 0;
+    int ret;
+
+    start = HAL_UptimeMs();
+    do {
+        if (decode) {
+            ret = utils_lz_frame_decode(bench_frame, frame_len, bench_back, sizeof(bench_back));
+        } else {
+            ret = utils_lz_frame_encode(bench_plain, len, bench_frame, len);
+        }
+        if (ret != (decode ? (int)len : frame_len)) {
+            return 0;
+        }
+        rounds++;
+        elapsed = HAL_UptimeMs() - start;
+    } while (elapsed < min_ms);
+
+    return (double)elapsed * 1000000 / rounds;
+}
+
+/* a truncated or corrupted frame is refused, or decoded without writing past the end */
+static int bench_check_bounds(int frame_len)
+{
+    static uint8_t bad[BENCH_PAYLOAD_MAX];
+    static uint8_t out[BENCH_PAYLOAD_MAX + 16];
+    int i, n, ret;
+
+    for (i = UTILS_LZ_FRAME_HEADER_LEN + 1; i < frame_len; i++) {
+        if (utils_lz_frame_decode(bench_frame, i, out, BENCH_PAYLOAD_MAX) >= 0) {
+            return -1;
+        }
+    }
+    for (n = 0; n < 2000; n++) {
+        memcpy(bad, bench_frame, frame_len);
+        for (i = 0; i < 3; i++) {
+            bad[UTILS_LZ_FRAME_HEADER_LEN + bench_rand() % (frame_len - UTILS_LZ_FRAME_HEADER_LEN)] = (uint8_t)bench_rand();
+        }
+        memset(out + BENCH_PAYLOAD_MAX, 0x5A, 16);
+        ret = utils_lz_frame_decode(bad, frame_len, out, BENCH_PAYLOAD_MAX);
+        if (ret > BENCH_PAYLOAD_MAX || 0x5A != out[BENCH_PAYLOAD_MAX] || 0x5A != out[BENCH_PAYLOAD_MAX + 15]) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t min_ms = BENCH_MIN_MS_DEFAULT;
+    double enc_ns, dec_ns;
+    int k, i, frame_len, ret = 0;
+
+    if (argc > 1) {
+        min_ms = (uint32_t)atoi(argv[1]);
+    }
+    if (0 == min_ms) {
+        HAL_Printf("usage: %s [ms per case]\n", argv[0]);
+        return 1;
+    }
+
+    HAL_Printf("%-9s %8s %8s %7s %12s %12s\n", "", "payload", "frame", "ratio", "encode ns", "decode ns");
+    for (k = 0; k < BENCH_KINDS; k++) {
+        for (i = 0; i < sizeof(bench_payloads) / sizeof(bench_payloads[0]); i++) {
+            uint32_t len = bench_payloads[i];
+
+            bench_fill((bench_kind_t)k, bench_plain, len);
+            frame_len = utils_lz_frame_encode(bench_plain, len, bench_frame, len);
+            if (frame_len < 0) {
+                /* sent as it is */
+                HAL_Printf("%-9s %8u %8s %7s\n", bench_kind_names[k], len, "plain", "-");
+                continue;
+            }
+            if ((int)len != utils_lz_frame_decode(bench_frame, frame_len, bench_back, sizeof(bench_back))
+                || 0 != memcmp(bench_plain, bench_back, len) || 0 != bench_check_bounds(frame_len)) {
+                HAL_Printf("%-9s %8u self check failed\n", bench_kind_names[k], len);
+                ret = 1;
+                continue;
+            }
+
+            enc_ns = bench_case(0, len, frame_len, min_ms);
+            dec_ns = bench_case(1, len, frame_len, min_ms);
+            if (0 == enc_ns || 0 == dec_ns) {
+                HAL_Printf("%-9s %8u failed\n", bench_kind_names[k], len);
+                ret = 1;
+                continue;
+            }
+            HAL_Printf("%-9s %8u %8d %6.1f%% %12.0f %12.0f\n", bench_kind_names[k], len, frame_len,
+                       100.0 * frame_len / len, enc_ns, dec_ns);
+        }
+    }
+
+    return ret;
+}
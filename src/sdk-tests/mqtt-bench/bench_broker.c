@@ -0,0 +1,544 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "iot_import.h"
+#include "bench_broker.h"
+
+uint64_t bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int bench_remaining_length(unsigned char *p, int len, int *value)
+{
+    int i, multiplier = 1;
+
+    *value = 0;
+    for (i = 1; i < len && i <= 4; i++) {
+        *value += (p[i] & 127) * multiplier;
+        multiplier *= 128;
+        if (0 == (p[i] & 128)) {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+/* '+' matches one level, '#' what is left */
+static int bench_topic_match(const char *filter, const char *topic, int topic_len)
+{
+    const char *end = topic + topic_len;
+
+    while ('\0' != *filter) {
+        if ('#' == *filter) {
+            return 1;
+        }
+        if ('+' == *filter) {
+            while (topic < end && '/' != *topic) {
+                topic++;
+            }
+            filter++;
+            continue;
+        }
+        if (topic == end || *filter != *topic) {
+            return 0;
+        }
+        filter++;
+        topic++;
+    }
+
+    return topic == end;
+}
+
+static void bench_conn_send(bench_broker_conn_t *conn, const unsigned char *packet, int len)
+{
+    int n;
+
+    while (conn->fd >= 0 && len > 0 && (n = send(conn->fd, packet, len, MSG_NOSIGNAL)) > 0) {
+        packet += n;
+        len -= n;
+    }
+}
+
+static void bench_conn_close(bench_broker_t *broker, bench_broker_conn_t *conn)
+{
+    close(conn->fd);
+    conn->fd = -1;
+    conn->buf_len = 0;
+    conn->filter_num = 0;
+
+    HAL_MutexLock(broker->lock);
+    if (conn->connected) {
+        broker->connected--;
+    }
+    HAL_MutexUnlock(broker->lock);
+    conn->connected = 0;
+}
+
+/* a QoS0 PUBLISH, in 'packet' of 5 + 2 + topic_len + payload_len bytes */
+static int bench_publish_packet(unsigned char *packet, const char *topic, int topic_len,
+                                const char *payload, int payload_len)
+{
+    int body = 2 + topic_len + payload_len, len = 0;
+
+    packet[len++] = 0x30;
+    do {
+        packet[len] = body % 128;
+        body /= 128;
+        packet[len++] |= body ? 128 : 0;
+    } while (body);
+    packet[len++] = topic_len >> 8;
+    packet[len++] = topic_len & 0xff;
+    memcpy(packet + len, topic, topic_len);
+    memcpy(packet + len + topic_len, payload, payload_len);
+
+    return len + topic_len + payload_len;
+}
+
+static int bench_conn_subscribed(bench_broker_conn_t *conn, const char *topic, int topic_len)
+{
+    int i;
+
+    for (i = 0; i < conn->filter_num; i++) {
+        if (bench_topic_match(conn->filters[i], topic, topic_len)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* to every connection subscribed to 'topic', the number of them */
+static int bench_broker_forward(bench_broker_t *broker, const char *topic, int topic_len,
+                                const char *payload, int payload_len)
+{
+    unsigned char *packet = NULL;
+    int i, len = 0, n = 0;
+
+    for (i = 0; i < BENCH_BROKER_CONN_MAX; i++) {
+        if (broker->conns[i].fd < 0 || !bench_conn_subscribed(&broker->conns[i], topic, topic_len)) {
+            continue;
+        }
+        if (NULL == packet) {
+            if (NULL == (packet = malloc(7 + topic_len + payload_len))) {
+                return 0;
+            }
+            len = bench_publish_packet(packet, topic, topic_len, payload, payload_len);
+        }
+        bench_conn_send(&broker->conns[i], packet, len);
+        n++;
+    }
+    free(packet);
+
+    return n;
+}
+
+static void bench_broker_on_publish(bench_broker_t *broker, bench_broker_conn_t *conn,
+                                    unsigned char *packet, int header, int len)
+{
+    unsigned char *body = packet + header;
+    int qos = (packet[0] >> 1) & 3, topic_len, k, n;
+
+    if (len < 2) {
+        return;
+    }
+    topic_len = body[0] << 8 | body[1];
+    k = 2 + topic_len + (qos ? 2 : 0);
+    if (k > len) {
+        return;
+    }
+    if (qos) {
+        unsigned char puback[4] = {0x40, 2, body[2 + topic_len], body[3 + topic_len]};
+        bench_conn_send(conn, puback, 4);
+    }
+
+    n = bench_broker_forward(broker, (char *)body + 2, topic_len, (char *)body + k, len - k);
+
+    HAL_MutexLock(broker->lock);
+    broker->publishes[qos ? 1 : 0]++;
+    broker->forwarded += n;
+    HAL_MutexUnlock(broker->lock);
+}
+
+static void bench_broker_on_subscribe(bench_broker_conn_t *conn, unsigned char *body, int len)
+{
+    unsigned char suback[4 + BENCH_BROKER_FILTER_MAX];
+    int k, filter_len, n = 0;
+
+    if (len < 2) {
+        return;
+    }
+
+    /* every filter granted the QoS asked for, the ones past BENCH_BROKER_FILTER_MAX refused */
+    for (k = 2; k + 2 < len && n < BENCH_BROKER_FILTER_MAX; k += 3 + filter_len) {
+        filter_len = body[k] << 8 | body[k + 1];
+        if (k + 2 + filter_len >= len) {
+            break;
+        }
+        if (conn->filter_num < BENCH_BROKER_FILTER_MAX && filter_len < BENCH_BROKER_FILTER_LEN) {
+            memcpy(conn->filters[conn->filter_num], body + k + 2, filter_len);
+            conn->filters[conn->filter_num++][filter_len] = '\0';
+            suback[4 + n++] = body[k + 2 + filter_len] & 3;
+        } else {
+            suback[4 + n++] = 0x80;
+        }
+    }
+    suback[0] = 0x90;
+    suback[1] = 2 + n;
+    suback[2] = body[0];
+    suback[3] = body[1];
+    bench_conn_send(conn, suback, 4 + n);
+}
+
+static void bench_broker_on_unsubscribe(bench_broker_conn_t *conn, unsigned char *body, int len)
+{
+    unsigned char unsuback[4] = {0xb0, 2, 0, 0};
+    int k, i, filter_len;
+
+    if (len < 2) {
+        return;
+    }
+
+    for (k = 2; k + 2 <= len; k += 2 + filter_len) {
+        filter_len = body[k] << 8 | body[k + 1];
+        if (k + 2 + filter_len > len) {
+            break;
+        }
+        for (i = 0; i < conn->filter_num; i++) {
+            if (filter_len == strlen(conn->filters[i]) && 0 == memcmp(conn->filters[i], body + k + 2, filter_len)) {
+                memmove(conn->filters[i], conn->filters[i + 1], (conn->filter_num - i - 1) * BENCH_BROKER_FILTER_LEN);
+                conn->filter_num--;
+                break;
+            }
+        }
+    }
+    unsuback[2] = body[0];
+    unsuback[3] = body[1];
+    bench_conn_send(conn, unsuback, 4);
+}
+
+static void bench_broker_on_packet(bench_broker_t *broker, bench_broker_conn_t *conn,
+                                   unsigned char *packet, int header, int len)
+{
+    static const unsigned char connack[4] = {0x20, 2, 0, 0};
+    static const unsigned char pingresp[2] = {0xd0, 0};
+
+    switch (packet[0] >> 4) {
+        case 1:     /* CONNECT */
+            bench_conn_send(conn, connack, 4);
+            HAL_MutexLock(broker->lock);
+            broker->connects++;
+            broker->connected += conn->connected ? 0 : 1;
+            HAL_MutexUnlock(broker->lock);
+            conn->connected = 1;
+            break;
+        case 3:     /* PUBLISH */
+            bench_broker_on_publish(broker, conn, packet, header, len);
+            break;
+        case 8:     /* SUBSCRIBE */
+            bench_broker_on_subscribe(conn, packet + header, len);
+            break;
+        case 10:    /* UNSUBSCRIBE */
+            bench_broker_on_unsubscribe(conn, packet + header, len);
+            break;
+        case 12:    /* PINGREQ */
+            bench_conn_send(conn, pingresp, 2);
+            break;
+        case 14:    /* DISCONNECT */
+            bench_conn_close(broker, conn);
+            break;
+        default:
+            break;
+    }
+}
+
+static void bench_broker_read(bench_broker_t *broker, bench_broker_conn_t *conn)
+{
+    int n, off, header, len;
+
+    n = recv(conn->fd, conn->buf + conn->buf_len, BENCH_BROKER_BUF_SIZE - conn->buf_len, 0);
+    if (n <= 0) {
+        bench_conn_close(broker, conn);
+        return;
+    }
+    conn->buf_len += n;
+
+    for (off = 0; conn->fd >= 0 && off < conn->buf_len; off += header + len) {
+        header = bench_remaining_length(conn->buf + off, conn->buf_len - off, &len);
+        if (0 == header || off + header + len > conn->buf_len) {
+            break;
+        }
+        bench_broker_on_packet(broker, conn, conn->buf + off, header, len);
+    }
+    if (conn->fd < 0) {
+        return;
+    }
+    memmove(conn->buf, conn->buf + off, conn->buf_len - off);
+    conn->buf_len -= off;
+    if (BENCH_BROKER_BUF_SIZE == conn->buf_len) {
+        HAL_Printf("broker: packet larger than %d bytes\n", BENCH_BROKER_BUF_SIZE);
+        bench_conn_close(broker, conn);
+    }
+}
+
+static void bench_broker_accept(bench_broker_t *broker)
+{
+    int i, fd, one = 1;
+
+    if ((fd = accept(broker->listen_fd, NULL, NULL)) < 0) {
+        return;
+    }
+    for (i = 0; i < BENCH_BROKER_CONN_MAX; i++) {
+        if (broker->conns[i].fd < 0) {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            broker->conns[i].fd = fd;
+            return;
+        }
+    }
+
+    HAL_Printf("broker: more than %d connections\n", BENCH_BROKER_CONN_MAX);
+    close(fd);
+}
+
+/* the downlinks due by now at inject_rate, once a connection is subscribed to inject_topic */
+static void bench_broker_send_injected(bench_broker_t *broker)
+{
+    char topic[BENCH_BROKER_FILTER_LEN], *payload;
+    uint64_t now;
+    int seq, due, topic_len, len, n;
+
+    HAL_MutexLock(broker->lock);
+    strcpy(topic, broker->inject_topic);
+    topic_len = strlen(topic);
+    while (broker->inject_sent < broker->inject_num) {
+        now = bench_now_us();
+        if (0 == broker->inject_start_us) {
+            for (n = 0; n < BENCH_BROKER_CONN_MAX; n++) {
+                if (broker->conns[n].fd >= 0 &&
+                    bench_conn_subscribed(&broker->conns[n], topic, topic_len)) {
+                    break;
+                }
+            }
+            if (BENCH_BROKER_CONN_MAX == n) {
+                break;
+            }
+            broker->inject_start_us = now;
+        }
+        due = broker->inject_rate ? (int)((now - broker->inject_start_us) * broker->inject_rate / 1000000) + 1
+              : broker->inject_num;
+        if (broker->inject_sent >= due) {
+            break;
+        }
+
+        seq = broker->inject_sent++;
+        len = snprintf(NULL, 0, broker->inject_fmt, seq);
+        if (NULL != (payload = malloc(len + 1))) {
+            snprintf(payload, len + 1, broker->inject_fmt, seq);
+        }
+        broker->inject_sent_us[seq] = now;
+        HAL_MutexUnlock(broker->lock);
+
+        n = (NULL == payload) ? 0 : bench_broker_forward(broker, topic, topic_len, payload, len);
+        free(payload);
+
+        HAL_MutexLock(broker->lock);
+        broker->forwarded += n;
+    }
+    HAL_MutexUnlock(broker->lock);
+}
+
+static void *bench_broker_routine(void *arg)
+{
+    bench_broker_t *broker = (bench_broker_t *)arg;
+    struct timeval tv;
+    fd_set fds;
+    int i, max_fd, drop;
+
+    while (!broker->stop) {
+        HAL_MutexLock(broker->lock);
+        drop = broker->drop;
+        broker->drop = 0;
+        HAL_MutexUnlock(broker->lock);
+        for (i = 0; drop && i < BENCH_BROKER_CONN_MAX; i++) {
+            if (broker->conns[i].fd >= 0) {
+                bench_conn_close(broker, &broker->conns[i]);
+            }
+        }
+
+        bench_broker_send_injected(broker);
+
+        FD_ZERO(&fds);
+        FD_SET(broker->listen_fd, &fds);
+        max_fd = broker->listen_fd;
+        for (i = 0; i < BENCH_BROKER_CONN_MAX; i++) {
+            if (broker->conns[i].fd >= 0) {
+                FD_SET(broker->conns[i].fd, &fds);
+                max_fd = broker->conns[i].fd > max_fd ? broker->conns[i].fd : max_fd;
+            }
+        }
+        tv.tv_sec = 0;
+        tv.tv_usec = 1000;
+        if (select(max_fd + 1, &fds, NULL, NULL, &tv) <= 0) {
+            continue;
+        }
+
+        if (FD_ISSET(broker->listen_fd, &fds)) {
+            bench_broker_accept(broker);
+        }
+        for (i = 0; i < BENCH_BROKER_CONN_MAX; i++) {
+            if (broker->conns[i].fd >= 0 && FD_ISSET(broker->conns[i].fd, &fds)) {
+                bench_broker_read(broker, &broker->conns[i]);
+            }
+        }
+    }
+
+    for (i = 0; i < BENCH_BROKER_CONN_MAX; i++) {
+        if (broker->conns[i].fd >= 0) {
+            bench_conn_close(broker, &broker->conns[i]);
+        }
+    }
+    HAL_SemaphorePost(broker->sem_exit);
+    return NULL;
+}
+
+int bench_broker_start(bench_broker_t *broker)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    void *thread;
+    int i, one = 1;
+
+    memset(broker, 0, sizeof(bench_broker_t));
+    for (i = 0; i < BENCH_BROKER_CONN_MAX; i++) {
+        broker->conns[i].fd = -1;
+        if (NULL == (broker->conns[i].buf = malloc(BENCH_BROKER_BUF_SIZE))) {
+            return -1;
+        }
+    }
+    broker->lock = HAL_MutexCreate();
+    broker->sem_exit = HAL_SemaphoreCreate();
+    broker->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (NULL == broker->lock || NULL == broker->sem_exit || broker->listen_fd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(broker->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (0 != bind(broker->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        0 != listen(broker->listen_fd, BENCH_BROKER_CONN_MAX) ||
+        0 != getsockname(broker->listen_fd, (struct sockaddr *)&addr, &addr_len)) {
+        return -1;
+    }
+    broker->port = ntohs(addr.sin_port);
+
+    if (0 != HAL_ThreadCreate(&thread, bench_broker_routine, broker, NULL, NULL)) {
+        return -1;
+    }
+    HAL_ThreadDetach(thread);
+    return 0;
+}
+
+void bench_broker_stop(bench_broker_t *broker)
+{
+    int i;
+
+    broker->stop = 1;
+    (void)HAL_SemaphoreWait(broker->sem_exit, PLATFORM_WAIT_INFINITE);
+    close(broker->listen_fd);
+    HAL_SemaphoreDestroy(broker->sem_exit);
+    HAL_MutexDestroy(broker->lock);
+    for (i = 0; i < BENCH_BROKER_CONN_MAX; i++) {
+        free(broker->conns[i].buf);
+    }
+    free(broker->inject_sent_us);
+    free(broker->inject_fmt);
+}
+
+int bench_broker_inject(bench_broker_t *broker, const char *topic, const char *payload_fmt, int num, uint32_t rate)
+{
+    uint64_t *sent_us = calloc(num > 0 ? num : 1, sizeof(uint64_t));
+    char *fmt = malloc(strlen(payload_fmt) + 1);
+
+    if (NULL == sent_us || NULL == fmt || strlen(topic) >= sizeof(broker->inject_topic)) {
+        free(sent_us);
+        free(fmt);
+        return -1;
+    }
+    strcpy(fmt, payload_fmt);
+
+    HAL_MutexLock(broker->lock);
+    free(broker->inject_sent_us);
+    free(broker->inject_fmt);
+    broker->inject_sent_us = sent_us;
+    broker->inject_fmt = fmt;
+    strcpy(broker->inject_topic, topic);
+    broker->inject_num = num;
+    broker->inject_sent = 0;
+    broker->inject_rate = rate;
+    broker->inject_start_us = 0;
+    HAL_MutexUnlock(broker->lock);
+
+    return 0;
+}
+
+uint64_t bench_broker_sent_us(bench_broker_t *broker, int seq)
+{
+    uint64_t sent_us = 0;
+
+    HAL_MutexLock(broker->lock);
+    if (seq >= 0 && seq < broker->inject_num) {
+        sent_us = broker->inject_sent_us[seq];
+    }
+    HAL_MutexUnlock(broker->lock);
+
+    return sent_us;
+}
+
+void bench_broker_drop(bench_broker_t *broker)
+{
+    HAL_MutexLock(broker->lock);
+    broker->drop = 1;
+    HAL_MutexUnlock(broker->lock);
+}
+
+int bench_broker_get(bench_broker_t *broker, int *counter)
+{
+    int value;
+
+    HAL_MutexLock(broker->lock);
+    value = *counter;
+    HAL_MutexUnlock(broker->lock);
+    return value;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _BENCH_BROKER_H_
+#define _BENCH_BROKER_H_
+
+/*
+ * A minimal MQTT 3.1.1 broker on the loopback, run by a thread of the process it is tested from.
+ * It accepts every CONNECT, grants every SUBSCRIBE, acks QoS1 publishes, forwards publishes at QoS0
+ * to the connections subscribed to them (a client subscribed to what it publishes gets it back),
+ * and injects downlinks at a configured rate. A session is not kept past its connection.
+ */
+
+#include <stdint.h>
+
+#define BENCH_BROKER_CONN_MAX       (64)
+#define BENCH_BROKER_FILTER_MAX     (32)
+#define BENCH_BROKER_FILTER_LEN     (128)
+#define BENCH_BROKER_BUF_SIZE       (64 * 1024)
+/*
+ * ms a bench client yields at once, for the benches on this broker and the others alike. the MQTT client
+ * reads what is left of a packet with what is left of the yield, too short a one breaks it.
+ */
+#define BENCH_YIELD_MS              (10)
+
+typedef struct {
+    int                 fd;
+    int                 connected;          /* CONNECT received */
+    unsigned char      *buf;
+    int                 buf_len;
+    int                 filter_num;
+    char                filters[BENCH_BROKER_FILTER_MAX][BENCH_BROKER_FILTER_LEN];
+} bench_broker_conn_t;
+
+/* the counters and the injection are shared with the broker thread under 'lock' */
+typedef struct {
+    int                 listen_fd;
+    uint16_t            port;
+    void               *lock;
+    void               *sem_exit;
+    int                 stop;
+    int                 drop;               /* connections to close at the next turn of the broker */
+    bench_broker_conn_t conns[BENCH_BROKER_CONN_MAX];
+
+    int                 connects;
+    int                 connected;
+    int                 publishes[2];       /* received at QoS0 and QoS1 */
+    int                 forwarded;
+
+    /* downlinks, payload_fmt formatted with the sequence number from 0 */
+    char                inject_topic[BENCH_BROKER_FILTER_LEN];
+    char               *inject_fmt;
+    int                 inject_num;
+    int                 inject_sent;
+    uint32_t            inject_rate;        /* per second, 0 as fast as the connections take them */
+    uint64_t            inject_start_us;
+    uint64_t           *inject_sent_us;     /* when each was sent, 0 when no connection was subscribed */
+} bench_broker_t;
+
+/* a monotonic clock in us, the broker and the clients measure latencies with it */
+uint64_t bench_now_us(void);
+
+/* listens on an ephemeral port of 127.0.0.1, in broker->port, 0 on success */
+int bench_broker_start(bench_broker_t *broker);
+void bench_broker_stop(bench_broker_t *broker);
+
+/* sends 'num' publishes to 'topic' at 'rate' per second once a connection is subscribed to it,
+ * the ones of an earlier call not sent yet are dropped */
+int bench_broker_inject(bench_broker_t *broker, const char *topic, const char *payload_fmt, int num, uint32_t rate);
+
+/* when downlink 'seq' was sent, 0 when not yet */
+uint64_t bench_broker_sent_us(bench_broker_t *broker, int seq);
+
+/* closes every connection, as a broker restart would */
+void bench_broker_drop(bench_broker_t *broker);
+
+/* reads a counter of the broker under its lock */
+int bench_broker_get(bench_broker_t *broker, int *counter);
+
+/* connections of the SDK to 'port' on the loopback, 'on_write' sees what goes over TLS, see bench_redirect.c */
+void bench_redirect(uint16_t port, void (*on_write)(const char *buf, int len));
+
+/* the most the sdk held from HAL_Malloc at once in bytes, see bench_heap.c */
+uint32_t bench_heap_peak(void);
+
+#endif /* _BENCH_BROKER_H_ */
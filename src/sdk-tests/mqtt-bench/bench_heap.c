@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * A program linked with this file and -Wl,--wrap=HAL_Malloc,--wrap=HAL_Free counts what the SDK
+ * holds from HAL_Malloc, by the usable size of each block. An allocation and a free of the same
+ * file as HAL_Malloc itself are not seen, which is the same block both ways.
+ */
+
+#include <malloc.h>
+
+#include "iot_import.h"
+#include "bench_broker.h"
+
+static long bench_heap_in_use;
+static long bench_heap_max;
+
+void *__real_HAL_Malloc(uint32_t size);
+void __real_HAL_Free(void *ptr);
+
+void *__wrap_HAL_Malloc(uint32_t size)
+{
+    void *ptr = __real_HAL_Malloc(size);
+    long in_use, max;
+
+    if (NULL == ptr) {
+        return NULL;
+    }
+    in_use = __sync_add_and_fetch(&bench_heap_in_use, (long)malloc_usable_size(ptr));
+    while (in_use > (max = bench_heap_max) && !__sync_bool_compare_and_swap(&bench_heap_max, max, in_use)) {
+    }
+
+    return ptr;
+}
+
+void __wrap_HAL_Free(void *ptr)
+{
+    if (NULL != ptr) {
+        __sync_sub_and_fetch(&bench_heap_in_use, (long)malloc_usable_size(ptr));
+    }
+    __real_HAL_Free(ptr);
+}
+
+uint32_t bench_heap_peak(void)
+{
+    return (uint32_t)bench_heap_max;
+}
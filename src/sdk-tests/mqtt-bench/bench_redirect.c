@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * A program linked with this file and
+ *     -Wl,--wrap=HAL_TCP_Establish,--wrap=HAL_SSL_Establish,--wrap=HAL_SSL_Destroy
+ *     -Wl,--wrap=HAL_SSL_Read,--wrap=HAL_SSL_Write,--wrap=HAL_SSL_Writev
+ * has every connection of the SDK go in clear to the loopback broker, whatever host and TLS it
+ * was asked for, and sees what it writes over TLS before it goes.
+ */
+
+#include <stdio.h>
+
+#include "iot_import.h"
+#include "bench_broker.h"
+
+static uint16_t bench_redirect_port;
+static void (*bench_redirect_on_write)(const char *buf, int len);
+
+uintptr_t __real_HAL_TCP_Establish(const char *host, uint16_t port);
+
+void bench_redirect(uint16_t port, void (*on_write)(const char *buf, int len))
+{
+    bench_redirect_port = port;
+    bench_redirect_on_write = on_write;
+}
+
+uintptr_t __wrap_HAL_TCP_Establish(const char *host, uint16_t port)
+{
+    return __real_HAL_TCP_Establish("127.0.0.1", bench_redirect_port);
+}
+
+uintptr_t __wrap_HAL_SSL_Establish(const char *host, uint16_t port, const char *ca_crt, size_t ca_crt_len)
+{
+    return __real_HAL_TCP_Establish("127.0.0.1", bench_redirect_port);
+}
+
+int32_t __wrap_HAL_SSL_Destroy(uintptr_t handle)
+{
+    return HAL_TCP_Destroy(handle);
+}
+
+int32_t __wrap_HAL_SSL_Write(uintptr_t handle, const char *buf, int len, int timeout_ms)
+{
+    if (NULL != bench_redirect_on_write) {
+        bench_redirect_on_write(buf, len);
+    }
+    return HAL_TCP_Write(handle, buf, len, timeout_ms);
+}
+
+int32_t __wrap_HAL_SSL_Writev(uintptr_t handle, const hal_iovec_t *iov, uint32_t iovcnt, int timeout_ms)
+{
+    uint32_t i;
+
+    for (i = 0; NULL != bench_redirect_on_write && i < iovcnt; i++) {
+        bench_redirect_on_write(iov[i].buf, iov[i].len);
+    }
+    return HAL_TCP_Writev(handle, iov, iovcnt, timeout_ms);
+}
+
+int32_t __wrap_HAL_SSL_Read(uintptr_t handle, char *buf, int len, int timeout_ms)
+{
+    return HAL_TCP_Read(handle, buf, len, timeout_ms);
+}
@@ -0,0 +1,26 @@
+TARGET      := mqtt-bench
+HDR_REFS    := src
+SRCS        := $(wildcard $(TOP_DIR)/$(MODULE_NAME)/*.c)
+CFLAGS      := $(filter-out -ansi,$(CFLAGS))
+
+ifneq (,$(filter -DCMP_ENABLED,$(CFLAGS)))
+ifneq (,$(filter -DDM_ENABLED,$(CFLAGS)))
+HDR_REFS    += sample/linkkit/include
+SRCS        += $(TOP_DIR)/sample/linkkit/src/linkkit_export.c \
+               $(TOP_DIR)/sample/linkkit/src/lite_queue.c \
+               $(TOP_DIR)/sample/linkkit/src/lite_ring.c
+LDFLAGS     += -liot_dm
+endif
+endif
+LDFLAGS     += -liot_sdk
+LDFLAGS     += -liot_platform
+LDFLAGS     += -Bstatic -liot_tls
+ifneq (,$(filter -DMBEDTLS_SHA1_PROCESS_ALT,$(CFLAGS)))
+# the sha blocks of mbedtls are in libiot_platform, which takes them from libiot_sdk
+LDFLAGS     += -liot_platform -liot_sdk
+endif
+# every connection of the sdk to the loopback broker, see bench_redirect.c
+LDFLAGS     += -Wl,--wrap=HAL_TCP_Establish,--wrap=HAL_SSL_Establish,--wrap=HAL_SSL_Destroy
+LDFLAGS     += -Wl,--wrap=HAL_SSL_Read,--wrap=HAL_SSL_Write,--wrap=HAL_SSL_Writev
+# what the sdk takes from HAL_Malloc, see bench_heap.c
+LDFLAGS     += -Wl,--wrap=HAL_Malloc,--wrap=HAL_Free
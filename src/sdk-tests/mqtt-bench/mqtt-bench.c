@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * End to end load of the MQTT client against the loopback broker of bench_broker.c, in this
+ * process. Usage: mqtt-bench [qos0|qos1|echo|downlink|linkkit|storm|all] [messages]
+ *
+ *   qos0       publishes, msgs/s until the broker got them all, latency of the call
+ *   qos1       publishes BENCH_QOS1_WINDOW in flight, latency to PUBACK
+ *   echo       publishes to a topic subscribed to, latency to the callback
+ *   downlink   publishes injected by the broker at BENCH_DOWNLINK_RATE, latency to the callback
+ *   linkkit    property sets injected by the broker at BENCH_LINKKIT_RATE, latency through
+ *              cmp_register_handler and linkkit_dispatch to thing_prop_changed, the sets overwritten
+ *              before they were dispatched are counted failed
+ *   storm      BENCH_STORM_CLIENTS clients dropped by the broker BENCH_STORM_ROUNDS times, latency
+ *              of each to get back
+ *
+ * Every connection of the SDK goes in clear to the loopback broker through bench_redirect.c. The
+ * device is BENCH_PRODUCT_KEY/BENCH_DEVICE_NAME, HAL_Set* saves it in the working directory.
+ * The peak of what the SDK held from HAL_Malloc is printed last, see bench_heap.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-utils.h"
+#include "lite-system.h"
+#if defined(CMP_ENABLED) && defined(DM_ENABLED)
+#include "linkkit_export.h"
+#endif
+#include "bench_broker.h"
+
+#define BENCH_MESSAGES_DEFAULT      (10000)
+/* below IOTX_MC_REPUB_NUM_MAX, the publishes waiting for an ack the client keeps */
+#define BENCH_QOS1_WINDOW           (16)
+#define BENCH_ECHO_WINDOW           (8)
+#define BENCH_DOWNLINK_RATE         (5000)
+/* the value is read when dispatched, sets in one yield come out as the last of them */
+#define BENCH_LINKKIT_RATE          (100)
+#define BENCH_LINKKIT_MESSAGES_MAX  (1000)
+#define BENCH_LINKKIT_BUFFERED_MSG  (64)
+#define BENCH_STORM_CLIENTS         (32)
+#define BENCH_STORM_ROUNDS          (3)
+#define BENCH_PHASE_TIMEOUT_MS      (60000)
+#define BENCH_MQTT_BUF_SIZE         (4096)
+
+#define BENCH_PRODUCT_KEY           "bench_pk"
+#define BENCH_DEVICE_NAME           "bench_dn"
+#define BENCH_TOPIC_UP              "/" BENCH_PRODUCT_KEY "/" BENCH_DEVICE_NAME "/update"
+#define BENCH_TOPIC_ECHO            "/" BENCH_PRODUCT_KEY "/" BENCH_DEVICE_NAME "/echo"
+#define BENCH_TOPIC_DOWN            "/" BENCH_PRODUCT_KEY "/" BENCH_DEVICE_NAME "/get"
+
+/* one operation, the latency of each of its requests in us */
+typedef struct {
+    const char         *name;
+    uint32_t           *latency;
+    uint64_t           *start;
+    int                 num;
+    int                 done;
+    int                 failed;
+    int                 in_flight;
+    uint64_t            elapsed_us;
+} bench_op_t;
+
+typedef struct {
+    void               *handle;
+    int                 index;
+    char                client_id[48];
+    char                write_buf[BENCH_MQTT_BUF_SIZE];
+    char                read_buf[BENCH_MQTT_BUF_SIZE];
+    bench_op_t         *op;                 /* of the acks counted */
+    int                 subscribed;
+    int                 reconnected;
+} bench_client_t;
+
+static bench_broker_t bench_broker;
+/* the request of each QoS1 packet id in flight */
+static int bench_packet_req[65536];
+
+static int bench_uint32_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* throughput of what completed and percentiles of the ones succeeded, the latencies are sorted */
+static void bench_op_report(bench_op_t *op)
+{
+    int ok = op->done - op->failed;
+    double rate = op->elapsed_us ? (double)op->done * 1000000 / (double)op->elapsed_us : 0;
+
+    qsort(op->latency, op->num, sizeof(uint32_t), bench_uint32_cmp);
+    if (0 >= ok) {
+        HAL_Printf("%-10s %6d ok %5d failed\n", op->name, 0, op->num);
+        return;
+    }
+
+    /* failed ones are 0 and sorted first */
+    HAL_Printf("%-10s %6d ok %5d failed %10.1f ops/s  p50 %8.3f ms  p99 %8.3f ms\n",
+               op->name, ok, op->num - ok, rate,
+               op->latency[op->num - ok + (ok - 1) / 2] / 1000.0,
+               op->latency[op->num - ok + (ok * 99 - 1) / 100] / 1000.0);
+}
+
+static int bench_op_init(bench_op_t *op, const char *name, int num)
+{
+    memset(op, 0, sizeof(bench_op_t));
+    op->name = name;
+    op->num = num;
+    op->latency = calloc(num, sizeof(uint32_t));
+    op->start = calloc(num, sizeof(uint64_t));
+    return (NULL == op->latency || NULL == op->start) ? -1 : 0;
+}
+
+static void bench_op_release(bench_op_t *op)
+{
+    free(op->latency);
+    free(op->start);
+}
+
+/* a callback of request 'i', the ones seen already or never sent are ignored */
+static void bench_op_complete(bench_op_t *op, int i, uint64_t start)
+{
+    if (i < 0 || i >= op->num || 0 == start || 0 != op->latency[i]) {
+        return;
+    }
+    op->latency[i] = (uint32_t)(bench_now_us() - start);
+    op->latency[i] += op->latency[i] ? 0 : 1;
+    op->done++;
+    op->in_flight--;
+}
+
+/* the sequence number the payload starts with */
+static int bench_payload_seq(const char *payload, int len)
+{
+    int i, seq = 0;
+
+    for (i = 0; i < len && payload[i] >= '0' && payload[i] <= '9'; i++) {
+        seq = seq * 10 + payload[i] - '0';
+    }
+
+    return i ? seq : -1;
+}
+
+static void bench_event_handle(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    bench_client_t *client = (bench_client_t *)pcontext;
+    bench_op_t *op = client->op;
+    int i;
+
+    switch (msg->event_type) {
+        case IOTX_MQTT_EVENT_PUBLISH_SUCCESS:
+            if (NULL != op) {
+                i = bench_packet_req[(uintptr_t)msg->msg & 0xffff];
+                bench_op_complete(op, i, op->start[i]);
+            }
+            break;
+        case IOTX_MQTT_EVENT_PUBLISH_TIMEOUT:
+        case IOTX_MQTT_EVENT_PUBLISH_NACK:
+            if (NULL != op) {
+                op->failed++;
+                op->done++;
+                op->in_flight--;
+            }
+            break;
+        case IOTX_MQTT_EVENT_SUBCRIBE_SUCCESS:
+            client->subscribed = 1;
+            break;
+        case IOTX_MQTT_EVENT_RECONNECT:
+            client->reconnected = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static int bench_client_connect(bench_client_t *client, int index)
+{
+    iotx_mqtt_param_t mqtt_param;
+
+    memset(client, 0, sizeof(bench_client_t));
+    client->index = index;
+    snprintf(client->client_id, sizeof(client->client_id), "%s.%s%d", BENCH_PRODUCT_KEY, BENCH_DEVICE_NAME, index);
+
+    memset(&mqtt_param, 0, sizeof(mqtt_param));
+    mqtt_param.host = "127.0.0.1";
+    mqtt_param.port = bench_broker.port;
+    mqtt_param.client_id = client->client_id;
+    mqtt_param.username = BENCH_DEVICE_NAME "&" BENCH_PRODUCT_KEY;
+    mqtt_param.password = "bench";
+    mqtt_param.clean_session = 1;
+    mqtt_param.request_timeout_ms = 2000;
+    mqtt_param.keepalive_interval_ms = 60000;
+    mqtt_param.pwrite_buf = client->write_buf;
+    mqtt_param.write_buf_size = sizeof(client->write_buf);
+    mqtt_param.pread_buf = client->read_buf;
+    mqtt_param.read_buf_size = sizeof(client->read_buf);
+    mqtt_param.handle_event.h_fp = bench_event_handle;
+    mqtt_param.handle_event.pcontext = client;
+
+    client->handle = IOT_MQTT_Construct(&mqtt_param);
+    return (NULL == client->handle) ? -1 : 0;
+}
+
+/* subscribed once the broker granted it */
+static int bench_client_subscribe(bench_client_t *client, const char *topic,
+                                  iotx_mqtt_event_handle_func_fpt handle, void *pcontext)
+{
+    uint32_t deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS;
+    client->subscribed = 0;
+    if (IOT_MQTT_Subscribe(client->handle, topic, IOTX_MQTT_QOS0, handle, pcontext) < 0) {
+        return -1;
+    }
+    while (!client->subscribed && HAL_UptimeMs() < deadline) {
+        IOT_MQTT_Yield(client->handle, BENCH_YIELD_MS);
+    }
+
+    return client->subscribed ? 0 : -1;
+}
+
+static void bench_message_set(iotx_mqtt_topic_info_t *msg, iotx_mqtt_qos_t qos, char *payload, int i)
+{
+    memset(msg, 0, sizeof(iotx_mqtt_topic_info_t));
+    msg->qos = qos;
+    msg->payload = payload;
+    msg->payload_len = snprintf(payload, 64, "%d {\"id\":%d,\"params\":{\"Power\":1}}", i, i);
+}
+
+/* the latency is the call, the throughput is until the broker has them all */
+static void bench_run_qos0(bench_client_t *client, bench_op_t *op)
+{
+    iotx_mqtt_topic_info_t msg;
+    char payload[64];
+    uint64_t start = bench_now_us();
+    uint32_t deadline;
+    int i, expected;
+
+    expected = bench_broker_get(&bench_broker, &bench_broker.publishes[0]);
+    for (i = 0; i < op->num; i++) {
+        bench_message_set(&msg, IOTX_MQTT_QOS0, payload, i);
+        op->start[i] = bench_now_us();
+        if (IOT_MQTT_Publish(client->handle, BENCH_TOPIC_UP, &msg) < 0) {
+            op->failed++;
+        } else {
+            op->latency[i] = (uint32_t)(bench_now_us() - op->start[i]);
+            op->latency[i] += op->latency[i] ? 0 : 1;
+            expected++;
+        }
+        op->done++;
+    }
+
+    deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS;
+    while (bench_broker_get(&bench_broker, &bench_broker.publishes[0]) < expected && HAL_UptimeMs() < deadline) {
+        HAL_SleepMs(1);
+    }
+    op->elapsed_us = bench_now_us() - start;
+}
+
+static void bench_echo_arrived(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    bench_op_t *op = (bench_op_t *)pcontext;
+    iotx_mqtt_topic_info_pt info = (iotx_mqtt_topic_info_pt)msg->msg;
+    int i = bench_payload_seq(info->payload, info->payload_len);
+
+    if (i >= 0 && i < op->num) {
+        bench_op_complete(op, i, op->start[i]);
+    }
+}
+
+/* QoS1 acked by the broker, or QoS0 to a topic subscribed to and back, 'window' in flight */
+static void bench_run_window(bench_client_t *client, bench_op_t *op, iotx_mqtt_qos_t qos,
+                             const char *topic, int window)
+{
+    iotx_mqtt_topic_info_t msg;
+    char payload[64];
+    uint64_t start = bench_now_us();
+    uint32_t deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS;
+    int i = 0, ret;
+
+    client->op = (IOTX_MQTT_QOS1 == qos) ? op : NULL;
+    while (op->done < op->num && HAL_UptimeMs() < deadline) {
+        while (i < op->num && op->in_flight < window) {
+            bench_message_set(&msg, qos, payload, i);
+            op->start[i] = bench_now_us();
+            ret = IOT_MQTT_Publish(client->handle, topic, &msg);
+            if (ret < 0) {
+                op->failed++;
+                op->done++;
+            } else {
+                bench_packet_req[ret & 0xffff] = i;
+                op->in_flight++;
+            }
+            i++;
+        }
+        IOT_MQTT_Yield(client->handle, BENCH_YIELD_MS);
+    }
+    op->elapsed_us = bench_now_us() - start;
+    op->failed += op->num - op->done;
+    op->done = op->num;
+    client->op = NULL;
+}
+
+static void bench_downlink_arrived(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    bench_op_t *op = (bench_op_t *)pcontext;
+    iotx_mqtt_topic_info_pt info = (iotx_mqtt_topic_info_pt)msg->msg;
+    int i = bench_payload_seq(info->payload, info->payload_len);
+
+    bench_op_complete(op, i, bench_broker_sent_us(&bench_broker, i));
+}
+
+/* yields till every downlink injected arrived, or the broker sent them all BENCH_YIELD_MS * 100 ago */
+static void bench_wait_injected(bench_op_t *op, int (*yield)(void *), void *handle)
+{
+    uint64_t start = bench_now_us();
+    uint32_t deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS, grace = 0;
+
+    while (op->done < op->num && HAL_UptimeMs() < deadline) {
+        yield(handle);
+        if (0 == grace && bench_broker_get(&bench_broker, &bench_broker.inject_sent) == op->num) {
+            grace = HAL_UptimeMs() + BENCH_YIELD_MS * 100;
+        }
+        if (0 != grace && HAL_UptimeMs() > grace) {
+            break;
+        }
+    }
+    op->elapsed_us = bench_now_us() - start;
+    op->failed = op->num - op->done;
+    op->done = op->num;
+}
+
+static int bench_mqtt_yield(void *handle)
+{
+    return IOT_MQTT_Yield(handle, BENCH_YIELD_MS);
+}
+
+static void bench_run_downlink(bench_client_t *client, bench_op_t *op)
+{
+    if (0 != bench_client_subscribe(client, BENCH_TOPIC_DOWN, bench_downlink_arrived, op) ||
+        0 != bench_broker_inject(&bench_broker, BENCH_TOPIC_DOWN, "%u {\"method\":\"thing.service.property.set\"}",
+                                 op->num, BENCH_DOWNLINK_RATE)) {
+        op->failed = op->done = op->num;
+        return;
+    }
+    bench_wait_injected(op, bench_mqtt_yield, client->handle);
+    IOT_MQTT_Unsubscribe(client->handle, BENCH_TOPIC_DOWN);
+}
+
+/* every client dropped at once, the latency is from the drop to the reconnect event of each */
+static void bench_run_storm(bench_op_t *op)
+{
+    bench_client_t *clients = calloc(BENCH_STORM_CLIENTS, sizeof(bench_client_t));
+    uint64_t start, dropped;
+    uint32_t deadline;
+    int i, round, rounds = BENCH_STORM_ROUNDS, back, connects;
+
+    if (NULL == clients) {
+        op->failed = op->done = op->num;
+        return;
+    }
+    for (i = 0; i < BENCH_STORM_CLIENTS; i++) {
+        if (0 != bench_client_connect(&clients[i], i)) {
+            HAL_Printf("storm: client %d not connected\n", i);
+            rounds = 0;
+            break;
+        }
+    }
+
+    start = bench_now_us();
+    connects = bench_broker_get(&bench_broker, &bench_broker.connects);
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < BENCH_STORM_CLIENTS; i++) {
+            clients[i].reconnected = 0;
+        }
+        dropped = bench_now_us();
+        bench_broker_drop(&bench_broker);
+
+        deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS;
+        for (back = 0; back < BENCH_STORM_CLIENTS && HAL_UptimeMs() < deadline;) {
+            for (i = 0; i < BENCH_STORM_CLIENTS; i++) {
+                if (clients[i].reconnected) {
+                    continue;
+                }
+                IOT_MQTT_Yield(clients[i].handle, 1);
+                if (clients[i].reconnected) {
+                    bench_op_complete(op, round * BENCH_STORM_CLIENTS + i, dropped);
+                    back++;
+                }
+            }
+        }
+        HAL_Printf("storm round %d: %d of %d clients back in %.1f ms\n", round, back, BENCH_STORM_CLIENTS,
+                   (bench_now_us() - dropped) / 1000.0);
+    }
+    op->elapsed_us = bench_now_us() - start;
+    op->failed = op->num - op->done;
+    op->done = op->num;
+    HAL_Printf("storm: %d connects for %d reconnects\n",
+               bench_broker_get(&bench_broker, &bench_broker.connects) - connects, op->num - op->failed);
+
+    for (i = 0; i < BENCH_STORM_CLIENTS; i++) {
+        if (NULL != clients[i].handle) {
+            IOT_MQTT_Destroy(&clients[i].handle);
+        }
+    }
+    free(clients);
+}
+
+#if defined(CMP_ENABLED) && defined(DM_ENABLED)
+/* one int property, set by the broker with its sequence number */
+static const char bench_tsl[] =
+            "{\"schema\":\"http://aliyun/iot/thing/desc/schema\",\"profile\":{\"productKey\":\"" BENCH_PRODUCT_KEY
+            "\",\"deviceName\":\"" BENCH_DEVICE_NAME "\"},\"services\":[{\"outputData\":[],\"identifier\":\"set\","
+            "\"inputData\":[{\"identifier\":\"Seq\",\"dataType\":{\"specs\":{\"min\":\"0\",\"max\":\"2147483647\"},"
+            "\"type\":\"int\"},\"name\":\"Seq\"}],\"method\":\"thing.service.property.set\",\"name\":\"set\","
+            "\"required\":true,\"callType\":\"sync\"},{\"outputData\":[{\"identifier\":\"Seq\",\"dataType\":{\"specs\":"
+            "{\"min\":\"0\",\"max\":\"2147483647\"},\"type\":\"int\"},\"name\":\"Seq\"}],\"identifier\":\"get\","
+            "\"inputData\":[\"Seq\"],\"method\":\"thing.service.property.get\",\"name\":\"get\",\"required\":true,"
+            "\"callType\":\"sync\"}],\"properties\":[{\"identifier\":\"Seq\",\"dataType\":{\"specs\":{\"min\":\"0\","
+            "\"max\":\"2147483647\"},\"type\":\"int\"},\"name\":\"Seq\",\"accessMode\":\"rw\",\"required\":true}],"
+            "\"events\":[{\"outputData\":[{\"identifier\":\"Seq\",\"dataType\":{\"specs\":{\"min\":\"0\",\"max\":"
+            "\"2147483647\"},\"type\":\"int\"},\"name\":\"Seq\"}],\"identifier\":\"post\",\"method\":"
+            "\"thing.event.property.post\",\"name\":\"post\",\"type\":\"info\",\"required\":true}]}";
+
+static int bench_linkkit_prop_changed(void *thing_id, char *property, void *ctx)
+{
+    bench_op_t *op = (bench_op_t *)ctx;
+    int seq = -1;
+
+    if (0 == strcmp(property, "Seq") &&
+        0 == linkkit_get_value(linkkit_method_get_property_value, thing_id, property, &seq, NULL)) {
+        bench_op_complete(op, seq, bench_broker_sent_us(&bench_broker, seq));
+    }
+
+    return 0;
+}
+
+static int bench_linkkit_yield(void *handle)
+{
+    linkkit_dispatch();
+#ifdef CMP_SUPPORT_MULTI_THREAD
+    HAL_SleepMs(BENCH_YIELD_MS);
+    return 0;
+#else
+    return linkkit_yield(BENCH_YIELD_MS);
+#endif
+}
+
+static void bench_run_linkkit(bench_op_t *op)
+{
+    static linkkit_ops_t ops;
+    linkkit_dispatch_stats_t stats;
+
+    memset(&ops, 0, sizeof(ops));
+    ops.thing_prop_changed = bench_linkkit_prop_changed;
+
+    if (0 != linkkit_start(BENCH_LINKKIT_BUFFERED_MSG, 0, linkkit_loglevel_crit, &ops, linkkit_cloud_domain_sh, op) ||
+        NULL == linkkit_set_tsl(bench_tsl, strlen(bench_tsl)) ||
+        0 != bench_broker_inject(&bench_broker, "/sys/" BENCH_PRODUCT_KEY "/" BENCH_DEVICE_NAME
+                                 "/thing/service/property/set",
+                                 "{\"id\":\"1\",\"version\":\"1.0\",\"method\":\"thing.service.property.set\","
+                                 "\"params\":{\"Seq\":%u}}", op->num, BENCH_LINKKIT_RATE)) {
+        op->failed = op->done = op->num;
+        linkkit_end();
+        return;
+    }
+    bench_wait_injected(op, bench_linkkit_yield, NULL);
+
+    if (0 == linkkit_get_dispatch_stats(&stats)) {
+        HAL_Printf("linkkit: %u dropped by the dispatch queue\n", stats.dropped);
+    }
+    linkkit_end();
+}
+#endif /* CMP_ENABLED && DM_ENABLED */
+
+static int bench_phase(const char *which, const char *name)
+{
+    return 0 == strcmp(which, "all") || 0 == strcmp(which, name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *which = argc > 1 ? argv[1] : "all";
+    int messages = argc > 2 ? atoi(argv[2]) : BENCH_MESSAGES_DEFAULT;
+    bench_client_t *client;
+    bench_op_t op;
+
+    if (messages <= 0 || (strcmp(which, "all") && strcmp(which, "qos0") && strcmp(which, "qos1") &&
+                          strcmp(which, "echo") && strcmp(which, "downlink") && strcmp(which, "linkkit") &&
+                          strcmp(which, "storm"))) {
+        HAL_Printf("usage: %s [qos0|qos1|echo|downlink|linkkit|storm|all] [messages]\n", argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    IOT_OpenLog("mqtt-bench");
+    IOT_SetLogLevel(IOT_LOG_CRIT);
+
+    client = calloc(1, sizeof(bench_client_t));
+    if (NULL == client || 0 != bench_broker_start(&bench_broker)) {
+        HAL_Printf("loopback broker not started\n");
+        return 1;
+    }
+    bench_redirect(bench_broker.port, NULL);
+    HAL_Printf("%d messages, loopback broker at port %u\n", messages, bench_broker.port);
+
+    HAL_SetProductKey(BENCH_PRODUCT_KEY);
+    HAL_SetDeviceName(BENCH_DEVICE_NAME);
+    HAL_SetDeviceSecret("bench");
+    iotx_device_info_init();
+    iotx_device_info_set(BENCH_PRODUCT_KEY, BENCH_DEVICE_NAME, "bench");
+    if (0 != bench_client_connect(client, 0)) {
+        HAL_Printf("not connected to the loopback broker\n");
+        bench_broker_stop(&bench_broker);
+        return 1;
+    }
+
+    if (bench_phase(which, "qos0") && 0 == bench_op_init(&op, "qos0", messages)) {
+        bench_run_qos0(client, &op);
+        bench_op_report(&op);
+        bench_op_release(&op);
+    }
+    if (bench_phase(which, "qos1") && 0 == bench_op_init(&op, "qos1", messages)) {
+        bench_run_window(client, &op, IOTX_MQTT_QOS1, BENCH_TOPIC_UP, BENCH_QOS1_WINDOW);
+        bench_op_report(&op);
+        bench_op_release(&op);
+    }
+    if (bench_phase(which, "echo") && 0 == bench_op_init(&op, "echo", messages)) {
+        if (0 == bench_client_subscribe(client, BENCH_TOPIC_ECHO, bench_echo_arrived, &op)) {
+            bench_run_window(client, &op, IOTX_MQTT_QOS0, BENCH_TOPIC_ECHO, BENCH_ECHO_WINDOW);
+            IOT_MQTT_Unsubscribe(client->handle, BENCH_TOPIC_ECHO);
+        } else {
+            op.failed = op.done = op.num;
+        }
+        bench_op_report(&op);
+        bench_op_release(&op);
+    }
+    if (bench_phase(which, "downlink") && 0 == bench_op_init(&op, "downlink", messages)) {
+        bench_run_downlink(client, &op);
+        bench_op_report(&op);
+        bench_op_release(&op);
+    }
+    IOT_MQTT_Destroy(&client->handle);
+
+    if (bench_phase(which, "storm") &&
+        0 == bench_op_init(&op, "reconnect", BENCH_STORM_CLIENTS * BENCH_STORM_ROUNDS)) {
+        bench_run_storm(&op);
+        bench_op_report(&op);
+        bench_op_release(&op);
+    }
+
+#if defined(CMP_ENABLED) && defined(DM_ENABLED)
+    if (bench_phase(which, "linkkit") && 0 == bench_op_init(&op, "linkkit",
+                                                          messages < BENCH_LINKKIT_MESSAGES_MAX ? messages : BENCH_LINKKIT_MESSAGES_MAX)) {
+        bench_run_linkkit(&op);
+        bench_op_report(&op);
+        bench_op_release(&op);
+    }
+#endif
+
+    HAL_Printf("heap peak %u bytes\n", bench_heap_peak());
+    bench_broker_stop(&bench_broker);
+    free(client);
+    IOT_CloseLog();
+    return 0;
+}
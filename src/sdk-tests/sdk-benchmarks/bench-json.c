@@ -0,0 +1,567 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/*
+ * The JSON engines of the SDK on a corpus of Alink payloads: cJSON of dm, the
+ * json_parser.c scanner and the json_token.c LITE_json_* helpers, each timed to
+ * parse a payload whole, to extract a few keys of it and, for cJSON and the
+ * dm_json_writer, to serialize it. cJSON allocates through LITE_malloc() here so
+ * that its allocations and peak heap are counted like those of LITE_json_*.
+ */
+
+#include "iot_import.h"
+#include "lite-utils.h"
+#include "json_parser.h"
+#include "cut.h"
+#if defined(CMP_ENABLED) && defined(DM_ENABLED)
+#include "cJSON.h"
+#include "dm_json_writer.h"
+#endif
+
+#define BENCH_JSON_KEYS_NUM         (4)
+#define BENCH_JSON_KEY_LEN          (64)
+
+enum {
+    BENCH_JSON_PROPERTY_SET,
+    BENCH_JSON_SERVICE_CALL,
+    BENCH_JSON_SHADOW_DELTA,
+    BENCH_JSON_TSL_5,
+    BENCH_JSON_TSL_50,
+    BENCH_JSON_TSL_500,
+    BENCH_JSON_PAYLOAD_NUM
+};
+
+typedef struct {
+    char           *json;
+    int             len;
+    const char     *keys[BENCH_JSON_KEYS_NUM];   /* dotted paths of object keys */
+} bench_json_payload_t;
+
+static const char bench_json_property_set[] =
+            "{\"method\":\"thing.service.property.set\",\"id\":\"185239263\",\"params\":{\"LightSwitch\":1,"
+            "\"ColorTemperature\":4000,\"Brightness\":80,\"WorkMode\":2,\"RGBColor\":{\"Red\":255,"
+            "\"Green\":128,\"Blue\":0}},\"version\":\"1.0.0\"}";
+
+static const char bench_json_service_call[] =
+            "{\"method\":\"thing.service.SetTimer\",\"id\":\"185239264\",\"params\":{\"Action\":\"open\","
+            "\"Timer\":{\"Enable\":1,\"Hour\":7,\"Minute\":30,\"Repeat\":[1,2,3,4,5]},"
+            "\"Comment\":\"workday morning, curtain \\\"living room\\\"\"},\"version\":\"1.0.0\"}";
+
+static const char bench_json_shadow_delta[] =
+            "{\"method\":\"control\",\"payload\":{\"status\":\"success\",\"state\":{\"desired\":{"
+            "\"color\":\"green\",\"temperature\":26,\"fan\":{\"speed\":3,\"swing\":true}},"
+            "\"reported\":{\"color\":\"red\",\"temperature\":24.5}},\"metadata\":{\"desired\":{"
+            "\"color\":{\"timestamp\":1469564492},\"temperature\":{\"timestamp\":1469564492},"
+            "\"fan\":{\"timestamp\":1469564576}},\"reported\":{\"color\":{\"timestamp\":1469564492}}}},"
+            "\"version\":14,\"timestamp\":1469564576}";
+
+static const char *bench_json_tsl_types[] = {"int", "float", "text", "enum"};
+static const char *bench_json_tsl_specs[] = {
+    "{\"min\":\"0\",\"max\":\"100\",\"unit\":\"%\",\"step\":\"1\"}",
+    "{\"min\":\"-40.0\",\"max\":\"85.0\",\"unit\":\"C\",\"step\":\"0.1\"}",
+    "{\"length\":\"255\"}",
+    "{\"0\":\"off\",\"1\":\"low\",\"2\":\"high\"}",
+};
+
+static bench_json_payload_t bench_json_payloads[BENCH_JSON_PAYLOAD_NUM];
+
+static char *_bench_json_dup(const char *json)
+{
+    int len = strlen(json);
+    char *dup = HAL_Malloc(len + 1);
+
+    if (NULL != dup) {
+        memcpy(dup, json, len + 1);
+    }
+    return dup;
+}
+
+/* a thing model the way the cloud sends it, of num properties posted and set as a whole */
+static char *_bench_json_tsl(int num)
+{
+    int size = 1024 + num * 512;
+    char *tsl = HAL_Malloc(size);
+    int len, i, pass;
+
+    if (NULL == tsl) {
+        return NULL;
+    }
+
+    len = HAL_Snprintf(tsl, size,
+                       "{\"schema\":\"https://iot-tsl.oss-cn-shanghai.aliyuncs.com/schema.json\","
+                       "\"profile\":{\"productKey\":\"a1AzoSi5TMc\",\"deviceName\":\"light_0001\"},"
+                       "\"link\":\"/sys/a1AzoSi5TMc/light_0001/thing/\",\"properties\":[");
+    for (i = 0; i < num; i++) {
+        len += HAL_Snprintf(tsl + len, size - len,
+                            "%s{\"identifier\":\"Prop%d\",\"name\":\"property %d\",\"accessMode\":\"%s\","
+                            "\"required\":%s,\"desc\":\"\",\"dataType\":{\"type\":\"%s\",\"specs\":%s}}",
+                            i ? "," : "", i, i, (i % 3) ? "rw" : "r", (i % 7) ? "false" : "true",
+                            bench_json_tsl_types[i % 4], bench_json_tsl_specs[i % 4]);
+    }
+
+    /* the post event and the set service list the properties again */
+    for (pass = 0; pass < 2; pass++) {
+        len += HAL_Snprintf(tsl + len, size - len, pass ?
+                            "],\"services\":[{\"identifier\":\"set\",\"name\":\"set\",\"required\":true,"
+                            "\"callType\":\"async\",\"method\":\"thing.service.property.set\",\"outputData\":[],"
+                            "\"inputData\":[" :
+                            "],\"events\":[{\"identifier\":\"post\",\"name\":\"post\",\"type\":\"info\","
+                            "\"required\":true,\"method\":\"thing.event.property.post\",\"outputData\":[");
+        for (i = 0; i < num; i++) {
+            len += HAL_Snprintf(tsl + len, size - len,
+                                "%s{\"identifier\":\"Prop%d\",\"name\":\"property %d\","
+                                "\"dataType\":{\"type\":\"%s\",\"specs\":%s}}",
+                                i ? "," : "", i, i, bench_json_tsl_types[i % 4], bench_json_tsl_specs[i % 4]);
+        }
+        len += HAL_Snprintf(tsl + len, size - len, "]}");
+    }
+    HAL_Snprintf(tsl + len, size - len, "]}");
+
+    return tsl;
+}
+
+static bench_json_payload_t *_bench_json_payload(int idx)
+{
+    static const char *keys[BENCH_JSON_PAYLOAD_NUM][BENCH_JSON_KEYS_NUM] = {
+        {"id", "method", "params.LightSwitch", "params.RGBColor.Green"},
+        {"id", "method", "params.Action", "params.Timer.Hour"},
+        {"method", "version", "payload.state.desired.color", "payload.metadata.desired"},
+        {"schema", "profile.productKey", "link", "events"},
+        {"schema", "profile.productKey", "link", "events"},
+        {"schema", "profile.productKey", "link", "events"},
+    };
+    bench_json_payload_t *p = &bench_json_payloads[idx];
+    int k;
+
+    if (NULL != p->json) {
+        return p;
+    }
+
+    switch (idx) {
+        case BENCH_JSON_PROPERTY_SET:
+            p->json = _bench_json_dup(bench_json_property_set);
+            break;
+        case BENCH_JSON_SERVICE_CALL:
+            p->json = _bench_json_dup(bench_json_service_call);
+            break;
+        case BENCH_JSON_SHADOW_DELTA:
+            p->json = _bench_json_dup(bench_json_shadow_delta);
+            break;
+        case BENCH_JSON_TSL_5:
+            p->json = _bench_json_tsl(5);
+            break;
+        case BENCH_JSON_TSL_50:
+            p->json = _bench_json_tsl(50);
+            break;
+        default:
+            p->json = _bench_json_tsl(500);
+            break;
+    }
+    if (NULL == p->json) {
+        HAL_Printf("no memory for json payload %d\n", idx);
+        exit(1);
+    }
+    p->len = strlen(p->json);
+    for (k = 0; k < BENCH_JSON_KEYS_NUM; k++) {
+        p->keys[k] = keys[idx][k];
+    }
+
+    return p;
+}
+
+/* json_parser.c: every value of every object and array visited */
+static int _bench_json_walk(char *str, int len, int type)
+{
+    char *pos, *key, *val;
+    int klen, vlen, vtype;
+    int count = 0;
+
+    if (JOBJECT == type) {
+        json_object_for_each_kv(str, len, pos, key, klen, val, vlen, vtype) {
+            count += 1 + _bench_json_walk(val, vlen, vtype);
+        }
+    } else if (JARRAY == type) {
+        json_array_for_each_entry(str, len, pos, val, vlen, vtype) {
+            count += 1 + _bench_json_walk(val, vlen, vtype);
+        }
+    }
+
+    return count;
+}
+
+static void _bench_parser_parse(struct cut_bench *bench, uint32_t n, int idx)
+{
+    bench_json_payload_t *p = _bench_json_payload(idx);
+    uint32_t i;
+
+    BENCH_SET_BYTES(p->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        if (0 == _bench_json_walk(p->json, p->len, JOBJECT)) {
+            HAL_Printf("json_parser found nothing in payload %d\n", idx);
+            exit(1);
+        }
+    }
+}
+
+static char *_bench_parser_value_of(char *json, int len, const char *path, int *value_len)
+{
+    const char *seg = path;
+    const char *dot;
+    int type;
+
+    for (;;) {
+        dot = strchr(seg, '.');
+        json = json_get_value_by_name_len(json, len, (char *)seg, dot ? dot - seg : strlen(seg), &len, &type);
+        if (NULL == json || NULL == dot) {
+            break;
+        }
+        seg = dot + 1;
+    }
+
+    *value_len = len;
+    return json;
+}
+
+static void _bench_parser_extract(struct cut_bench *bench, uint32_t n, int idx)
+{
+    bench_json_payload_t *p = _bench_json_payload(idx);
+    int k, value_len;
+    uint32_t i;
+
+    BENCH_SET_BYTES(p->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < BENCH_JSON_KEYS_NUM; k++) {
+            if (NULL == _bench_parser_value_of(p->json, p->len, p->keys[k], &value_len)) {
+                HAL_Printf("json_parser has no %s in payload %d\n", p->keys[k], idx);
+                exit(1);
+            }
+        }
+    }
+}
+
+/* json_token.c: LITE_json_keys_of() lists every object key, copied */
+static void _bench_token_parse(struct cut_bench *bench, uint32_t n, int idx)
+{
+    bench_json_payload_t *p = _bench_json_payload(idx);
+    list_head_t *keys;
+    uint32_t i;
+
+    BENCH_SET_BYTES(p->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        keys = LITE_json_keys_of(p->json, "");
+        if (NULL == keys) {
+            HAL_Printf("LITE_json_keys_of failed on payload %d\n", idx);
+            exit(1);
+        }
+        LITE_json_keys_release(keys);
+    }
+}
+
+static void _bench_token_extract(struct cut_bench *bench, uint32_t n, int idx)
+{
+    bench_json_payload_t *p = _bench_json_payload(idx);
+    char *value;
+    uint32_t i;
+    int k;
+
+    BENCH_SET_BYTES(p->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < BENCH_JSON_KEYS_NUM; k++) {
+            value = LITE_json_value_of((char *)p->keys[k], p->json);
+            if (NULL == value) {
+                HAL_Printf("LITE_json_value_of has no %s in payload %d\n", p->keys[k], idx);
+                exit(1);
+            }
+            LITE_free(value);
+        }
+    }
+}
+
+/* the one pass LITE_json_values_of(), nothing copied */
+static void _bench_views_extract(struct cut_bench *bench, uint32_t n, int idx)
+{
+    bench_json_payload_t *p = _bench_json_payload(idx);
+    lite_json_view_t views[BENCH_JSON_KEYS_NUM];
+    uint32_t i;
+    int k;
+
+    for (k = 0; k < BENCH_JSON_KEYS_NUM; k++) {
+        views[k].key = p->keys[k];
+    }
+
+    BENCH_SET_BYTES(p->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        if (BENCH_JSON_KEYS_NUM != LITE_json_values_of(p->json, p->len, views, BENCH_JSON_KEYS_NUM)) {
+            HAL_Printf("LITE_json_values_of missed keys of payload %d\n", idx);
+            exit(1);
+        }
+    }
+}
+
+#if defined(CMP_ENABLED) && defined(DM_ENABLED)
+static void *_bench_cjson_malloc(size_t size)
+{
+    return LITE_malloc(size);
+}
+
+static void _bench_cjson_free(void *ptr)
+{
+    if (NULL != ptr) {
+        LITE_free(ptr);
+    }
+}
+
+static cJSON *_bench_cjson_parse(int idx)
+{
+    static int hooked = 0;
+    cJSON *root;
+
+    if (!hooked) {
+        cJSON_Hooks hooks = {_bench_cjson_malloc, _bench_cjson_free};
+
+        cJSON_InitHooks(&hooks);
+        hooked = 1;
+    }
+
+    root = cJSON_Parse(_bench_json_payload(idx)->json);
+    if (NULL == root) {
+        HAL_Printf("cJSON_Parse failed on payload %d\n", idx);
+        exit(1);
+    }
+    return root;
+}
+
+static void _bench_cjson_parse_n(struct cut_bench *bench, uint32_t n, int idx)
+{
+    uint32_t i;
+
+    cJSON_Delete(_bench_cjson_parse(idx));
+    BENCH_SET_BYTES(_bench_json_payload(idx)->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        cJSON_Delete(_bench_cjson_parse(idx));
+    }
+}
+
+static cJSON *_bench_cjson_value_of(cJSON *item, const char *path)
+{
+    char seg[BENCH_JSON_KEY_LEN];
+    const char *dot;
+    int len;
+
+    for (;;) {
+        dot = strchr(path, '.');
+        len = dot ? dot - path : strlen(path);
+        memcpy(seg, path, len);
+        seg[len] = '\0';
+        item = cJSON_GetObjectItem(item, seg);
+        if (NULL == item || NULL == dot) {
+            break;
+        }
+        path = dot + 1;
+    }
+
+    return item;
+}
+
+/* cJSON has the tree built to find a key in */
+static void _bench_cjson_extract(struct cut_bench *bench, uint32_t n, int idx)
+{
+    bench_json_payload_t *p = _bench_json_payload(idx);
+    cJSON *root;
+    uint32_t i;
+    int k;
+
+    cJSON_Delete(_bench_cjson_parse(idx));
+    BENCH_SET_BYTES(p->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        root = _bench_cjson_parse(idx);
+        for (k = 0; k < BENCH_JSON_KEYS_NUM; k++) {
+            if (NULL == _bench_cjson_value_of(root, p->keys[k])) {
+                HAL_Printf("cJSON has no %s in payload %d\n", p->keys[k], idx);
+                exit(1);
+            }
+        }
+        cJSON_Delete(root);
+    }
+}
+
+static void _bench_cjson_serialize(struct cut_bench *bench, uint32_t n, int idx)
+{
+    cJSON *root = _bench_cjson_parse(idx);
+    char *out;
+    uint32_t i;
+
+    BENCH_SET_BYTES(_bench_json_payload(idx)->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        out = cJSON_PrintUnformatted(root);
+        if (NULL == out) {
+            HAL_Printf("cJSON_PrintUnformatted failed on payload %d\n", idx);
+            exit(1);
+        }
+        LITE_free(out);
+    }
+    cJSON_Delete(root);
+}
+
+static void _bench_writer_item(dm_json_writer_t *writer, const cJSON *item)
+{
+    const cJSON *child;
+    const char *str;
+
+    if (NULL != item->string) {
+        dm_json_writer_key(writer, item->string, strlen(item->string));
+    }
+
+    switch (item->type & 0xFF) {
+        case cJSON_Object:
+        case cJSON_Array:
+            if (cJSON_Object == (item->type & 0xFF)) {
+                dm_json_writer_object_begin(writer);
+            } else {
+                dm_json_writer_array_begin(writer);
+            }
+            for (child = item->child; NULL != child; child = child->next) {
+                _bench_writer_item(writer, child);
+            }
+            if (cJSON_Object == (item->type & 0xFF)) {
+                dm_json_writer_object_end(writer);
+            } else {
+                dm_json_writer_array_end(writer);
+            }
+            break;
+        case cJSON_String:
+            str = item->valuestring;
+#ifdef CJSON_STRING_ZEROCOPY
+            dm_json_writer_string(writer, str, item->valuestring_length);
+#else
+            dm_json_writer_string(writer, str, strlen(str));
+#endif
+            break;
+        case cJSON_Number:
+            if ((double)item->valueint == item->valuedouble) {
+                dm_json_writer_int(writer, item->valueint);
+            } else {
+                dm_json_writer_double(writer, item->valuedouble, 6);
+            }
+            break;
+        case cJSON_True:
+            dm_json_writer_raw(writer, "true", 4);
+            break;
+        case cJSON_False:
+            dm_json_writer_raw(writer, "false", 5);
+            break;
+        default:
+            dm_json_writer_raw(writer, "null", 4);
+            break;
+    }
+}
+
+/* the dm_json_writer into a buffer of the caller, from the same tree */
+static void _bench_writer_serialize(struct cut_bench *bench, uint32_t n, int idx)
+{
+    bench_json_payload_t *p = _bench_json_payload(idx);
+    cJSON *root = _bench_cjson_parse(idx);
+    dm_json_writer_t writer;
+    size_t size = p->len * 2 + 1;
+    char *buf = HAL_Malloc(size);
+    uint32_t i;
+
+    if (NULL == buf) {
+        HAL_Printf("no memory for the writer buffer\n");
+        exit(1);
+    }
+
+    BENCH_SET_BYTES(p->len);
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        dm_json_writer_init(&writer, buf, size);
+        _bench_writer_item(&writer, root);
+        if (dm_json_writer_truncated(&writer)) {
+            HAL_Printf("dm_json_writer truncated payload %d\n", idx);
+            exit(1);
+        }
+    }
+    HAL_Free(buf);
+    cJSON_Delete(root);
+}
+#endif  /* defined(CMP_ENABLED) && defined(DM_ENABLED) */
+
+#define BENCH_JSON(sname, op, fn, payload, idx) \
+    BENCH(sname, op##_##payload) { \
+        fn(bench, n, idx); \
+    }
+
+#define BENCH_JSON_PAYLOADS(sname, op, fn) \
+    BENCH_JSON(sname, op, fn, property_set, BENCH_JSON_PROPERTY_SET) \
+    BENCH_JSON(sname, op, fn, service_call, BENCH_JSON_SERVICE_CALL) \
+    BENCH_JSON(sname, op, fn, shadow_delta, BENCH_JSON_SHADOW_DELTA) \
+    BENCH_JSON(sname, op, fn, tsl_5, BENCH_JSON_TSL_5) \
+    BENCH_JSON(sname, op, fn, tsl_50, BENCH_JSON_TSL_50) \
+    BENCH_JSON(sname, op, fn, tsl_500, BENCH_JSON_TSL_500)
+
+#define ADD_BENCH_JSON_PAYLOADS(sname, op) \
+    ADD_BENCH(sname, op##_property_set), \
+    ADD_BENCH(sname, op##_service_call), \
+    ADD_BENCH(sname, op##_shadow_delta), \
+    ADD_BENCH(sname, op##_tsl_5), \
+    ADD_BENCH(sname, op##_tsl_50), \
+    ADD_BENCH(sname, op##_tsl_500)
+
+BENCH_JSON_PAYLOADS(json_parser, parse, _bench_parser_parse)
+BENCH_JSON_PAYLOADS(json_parser, extract, _bench_parser_extract)
+
+BENCH_SUITE(json_parser) = {
+    ADD_BENCH_JSON_PAYLOADS(json_parser, parse),
+    ADD_BENCH_JSON_PAYLOADS(json_parser, extract),
+    ADD_BENCH_NULL
+};
+
+BENCH_JSON_PAYLOADS(json_token, parse, _bench_token_parse)
+BENCH_JSON_PAYLOADS(json_token, extract, _bench_token_extract)
+BENCH_JSON_PAYLOADS(json_token, views, _bench_views_extract)
+
+BENCH_SUITE(json_token) = {
+    ADD_BENCH_JSON_PAYLOADS(json_token, parse),
+    ADD_BENCH_JSON_PAYLOADS(json_token, extract),
+    ADD_BENCH_JSON_PAYLOADS(json_token, views),
+    ADD_BENCH_NULL
+};
+
+#if defined(CMP_ENABLED) && defined(DM_ENABLED)
+BENCH_JSON_PAYLOADS(json_cjson, parse, _bench_cjson_parse_n)
+BENCH_JSON_PAYLOADS(json_cjson, extract, _bench_cjson_extract)
+BENCH_JSON_PAYLOADS(json_cjson, serialize, _bench_cjson_serialize)
+BENCH_JSON_PAYLOADS(json_cjson, writer, _bench_writer_serialize)
+
+BENCH_SUITE(json_cjson) = {
+    ADD_BENCH_JSON_PAYLOADS(json_cjson, parse),
+    ADD_BENCH_JSON_PAYLOADS(json_cjson, extract),
+    ADD_BENCH_JSON_PAYLOADS(json_cjson, serialize),
+    ADD_BENCH_JSON_PAYLOADS(json_cjson, writer),
+    ADD_BENCH_NULL
+};
+#endif
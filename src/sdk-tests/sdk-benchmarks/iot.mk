@@ -0,0 +1,16 @@
+TARGET      := sdk-benchmarks
+HDR_REFS    := src build-rules
+SRCS        := $(wildcard $(TOP_DIR)/$(MODULE_NAME)/*.c)
+SRCS        += $(TOP_DIR)/build-rules/misc/cut.c
+CFLAGS      := $(filter-out -ansi,$(CFLAGS))
+
+ifneq (,$(filter -DDM_ENABLED,$(CFLAGS)))
+LDFLAGS     += -liot_dm
+endif
+LDFLAGS     += -liot_sdk
+LDFLAGS     += -liot_platform
+LDFLAGS     += -Bstatic -liot_tls
+ifneq (,$(filter -DMBEDTLS_SHA1_PROCESS_ALT,$(CFLAGS)))
+# the sha blocks of mbedtls are in libiot_platform, which takes them from libiot_sdk
+LDFLAGS     += -liot_platform -liot_sdk
+endif
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/*
+ * Micro-benchmarks of the SDK utilities on the BENCH macros of cut.h, one JSON
+ * line of results per benchmark. Usage: sdk-benchmarks [--list] all | S-FILTER [B-FILTER]
+ */
+
+#include "iot_import.h"
+#include "lite-utils.h"
+#include "cut.h"
+#include "utils_md5.h"
+#include "utils_sha256.h"
+#include "utils_base64.h"
+#include "utils_topic.h"
+
+#define BENCH_BUF_LEN       (1024)
+
+static unsigned char bench_buf[BENCH_BUF_LEN];
+
+static const char *bench_json =
+            "{\"id\":\"123\",\"version\":\"1.0\",\"params\":{\"LightSwitch\":1,\"Color\":\"Red\","
+            "\"WIFI_Band\":\"2.4G\",\"WiFI_RSSI\":-36,\"ColorTemperature\":4000},\"method\":\"thing.event.property.post\"}";
+
+static int _bench_mem_stats(struct cut_bench_mem *mem, int restart_peak)
+{
+    lite_mem_stats_t stats;
+
+    if (restart_peak) {
+        LITE_reset_malloc_max_in_use();
+    }
+    if (0 != LITE_get_malloc_stats(-1, &stats)) {
+        return -1;
+    }
+    mem->allocs = (uint32_t)stats.iterations_allocated;
+    mem->bytes = (uint32_t)stats.bytes_total_allocated;
+    mem->in_use = (uint32_t)stats.bytes_total_in_use;
+    mem->peak = (uint32_t)stats.bytes_max_in_use;
+
+    return 0;
+}
+
+BENCH(digest, md5_1k) {
+    unsigned char out[16];
+    uint32_t i;
+
+    BENCH_SET_BYTES(BENCH_BUF_LEN);
+    for (i = 0; i < n; i++) {
+        utils_md5(bench_buf, BENCH_BUF_LEN, out);
+    }
+}
+
+BENCH(digest, sha256_1k) {
+    unsigned char out[32];
+    uint32_t i;
+
+    BENCH_SET_BYTES(BENCH_BUF_LEN);
+    for (i = 0; i < n; i++) {
+        utils_sha256(bench_buf, BENCH_BUF_LEN, out);
+    }
+}
+
+BENCH(digest, base64_encode_256) {
+    uint8_t out[400];
+    uint32_t out_len, i;
+
+    BENCH_SET_BYTES(256);
+    for (i = 0; i < n; i++) {
+        utils_base64encode(bench_buf, 256, sizeof(out), out, &out_len);
+    }
+}
+
+BENCH(digest, base64_decode_stream_1k) {
+    uint8_t enc[1400];
+    uint8_t out[BENCH_BUF_LEN];
+    utils_base64_stream_t stream;
+    uint32_t enc_len, off, i;
+
+    utils_base64encode(bench_buf, BENCH_BUF_LEN, sizeof(enc), enc, &enc_len);
+    BENCH_SET_BYTES(enc_len);
+    for (i = 0; i < n; i++) {
+        utils_base64_stream_init(&stream);
+        for (off = 0; off < enc_len; off += 100) {
+            utils_base64decode_update(&stream, enc + off, (enc_len - off < 100) ? enc_len - off : 100, out);
+        }
+        utils_base64decode_final(&stream);
+    }
+}
+
+BENCH_SUITE(digest) = {
+    ADD_BENCH(digest, md5_1k),
+    ADD_BENCH(digest, sha256_1k),
+    ADD_BENCH(digest, base64_encode_256),
+    ADD_BENCH(digest, base64_decode_stream_1k),
+    ADD_BENCH_NULL
+};
+
+BENCH(lite, json_value_of) {
+    char *json = LITE_strdup(bench_json);
+    char *value;
+    uint32_t i;
+
+    BENCH_SET_BYTES(strlen(bench_json));
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        value = LITE_json_value_of("params.ColorTemperature", json);
+        LITE_free(value);
+    }
+    LITE_free(json);
+}
+
+BENCH(lite, format_string) {
+    char *str;
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        str = LITE_format_string("/sys/%s/%s/thing/event/property/post_reply", "a1AzoSi5TMc", "light_0001");
+        LITE_free(str);
+    }
+}
+
+BENCH_SUITE(lite) = {
+    ADD_BENCH(lite, json_value_of),
+    ADD_BENCH(lite, format_string),
+    ADD_BENCH_NULL
+};
+
+static int _bench_topic_visit(void *value, void *ctx)
+{
+    (*(int *)ctx)++;
+    return 0;
+}
+
+BENCH(topic, trie_match_64) {
+    static const char *topic = "/sys/a1AzoSi5TMc/light_0001/thing/service/property/set";
+    utils_topic_trie_t trie;
+    char filter[64];
+    uint32_t i;
+    int hits = 0;
+
+    utils_topic_trie_init(&trie);
+    for (i = 0; i < 64; i++) {
+        HAL_Snprintf(filter, sizeof(filter), "/sys/a1AzoSi5TMc/light_0001/thing/service/cmd_%u", (unsigned int)i);
+        utils_topic_trie_insert(&trie, filter, &trie);
+    }
+    utils_topic_trie_insert(&trie, "/sys/a1AzoSi5TMc/light_0001/thing/service/+/set", &trie);
+    utils_topic_trie_insert(&trie, "/sys/a1AzoSi5TMc/light_0001/#", &trie);
+
+    BENCH_RESET_TIMER();
+    for (i = 0; i < n; i++) {
+        utils_topic_trie_match(&trie, topic, strlen(topic), _bench_topic_visit, &hits);
+    }
+    utils_topic_trie_deinit(&trie, NULL);
+}
+
+BENCH_SUITE(topic) = {
+    ADD_BENCH(topic, trie_match_64),
+    ADD_BENCH_NULL
+};
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    for (i = 0; i < BENCH_BUF_LEN; i++) {
+        bench_buf[i] = (unsigned char)(i * 31 + 7);
+    }
+
+    ADD_BENCH_SUITE(digest);
+    ADD_BENCH_SUITE(lite);
+    ADD_BENCH_SUITE(topic);
+    ADD_BENCH_SUITE(json_parser);
+    ADD_BENCH_SUITE(json_token);
+#if defined(CMP_ENABLED) && defined(DM_ENABLED)
+    ADD_BENCH_SUITE(json_cjson);
+#endif
+    cut.bench_mem_stats = _bench_mem_stats;
+
+    if (argc < 2) {
+        char *all[] = {argv[0], "all"};
+
+        return cut_bench_main(2, all);
+    }
+    return cut_bench_main(argc, argv);
+}
@@ -25,9 +25,18 @@ static void _setup_hal_suite(void)
     ADD_SUITE(HAL_OS);
 }
 
+static void _setup_linkkit_suite(void)
+{
+    ADD_SUITE(LITE_RING);
+#ifdef DM_CHANNELS_ENABLED
+    ADD_SUITE(CMP_CHANNEL);
+#endif
+}
+
 int main(int argc, char *argv[])
 {
     _setup_hal_suite();
+    _setup_linkkit_suite();
     cut_main(argc, argv);
 
     return 0;
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Getting online with linkkit over the loopback broker of src/sdk-tests/mqtt-bench, from linkkit_start
+ * to the reply of the first property post, phase by phase as lite-startup.h records them, 'rounds'
+ * times from a linkkit_end. The bench replies to the property post the way the cloud does.
+ * Usage: startup-bench [rounds] [properties]
+ *
+ * The connection goes in clear to the broker, net_connect is the TCP connect only then. The TSL is
+ * set locally, tsl_get is not reached, nor is ota_report without linkkit_fota_init.
+ *
+ * With RAW_DATA_DIRECT_ENABLED each round also sends raw data up once online, which DM publishes on
+ * the MQTT client of that round, and waits for the broker to get it, so rounds past the first one
+ * check the client of a linkkit_start after a linkkit_end is the one raw data goes on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "linkkit_export.h"
+#include "lite-startup.h"
+#include "bench_broker.h"
+
+#define BENCH_ROUNDS_DEFAULT        (20)
+#define BENCH_PROPERTIES_DEFAULT    (50)
+#define BENCH_PROPERTIES_MAX        (2000)
+#define BENCH_BUFFERED_MSG          (64)
+#define BENCH_ROUND_TIMEOUT_MS      (10000)
+
+#define BENCH_PRODUCT_KEY           "bench_pk"
+#define BENCH_DEVICE_NAME           "bench_dn"
+#define BENCH_POST_REPLY_TOPIC      "/sys/" BENCH_PRODUCT_KEY "/" BENCH_DEVICE_NAME "/thing/event/property/post_reply"
+#define BENCH_UP_RAW_TOPIC          "/sys/" BENCH_PRODUCT_KEY "/" BENCH_DEVICE_NAME "/thing/model/up_raw"
+
+/* what each phase took in each round in us, 0 when it was not reached */
+static uint32_t *bench_took[LITE_STARTUP_PHASE_MAX];
+static bench_broker_t bench_broker;
+static int bench_connected;
+#ifdef RAW_DATA_DIRECT_ENABLED
+static int bench_raw_written;
+static int bench_raw_lost;
+#endif
+
+/* a thing model the way the cloud sends it, of num int properties posted as a whole */
+static char *bench_tsl(int num)
+{
+    int size = 1024 + num * 256;
+    char *tsl = malloc(size);
+    int len, i;
+
+    if (NULL == tsl) {
+        return NULL;
+    }
+
+    len = snprintf(tsl, size,
+                   "{\"schema\":\"https://iot-tsl.oss-cn-shanghai.aliyuncs.com/schema.json\","
+                   "\"profile\":{\"productKey\":\"" BENCH_PRODUCT_KEY "\",\"deviceName\":\"" BENCH_DEVICE_NAME "\"},"
+                   "\"properties\":[");
+    for (i = 0; i < num; i++) {
+        len += snprintf(tsl + len, size - len,
+                        "%s{\"identifier\":\"Prop%d\",\"name\":\"property %d\",\"accessMode\":\"rw\",\"required\":false,"
+                        "\"dataType\":{\"type\":\"int\",\"specs\":{\"min\":\"0\",\"max\":\"65535\",\"step\":\"1\"}}}",
+                        i ? "," : "", i, i);
+    }
+    len += snprintf(tsl + len, size - len,
+                    "],\"events\":[{\"identifier\":\"post\",\"name\":\"post\",\"type\":\"info\",\"required\":true,"
+                    "\"method\":\"thing.event.property.post\",\"outputData\":[");
+    for (i = 0; i < num; i++) {
+        len += snprintf(tsl + len, size - len, "%s{\"identifier\":\"Prop%d\",\"name\":\"property %d\","
+                        "\"dataType\":{\"type\":\"int\",\"specs\":{\"min\":\"0\",\"max\":\"65535\",\"step\":\"1\"}}}",
+                        i ? "," : "", i, i);
+    }
+    snprintf(tsl + len, size - len, "]}],\"services\":[]}");
+
+    return tsl;
+}
+
+static const char *bench_memmem(const char *buf, int len, const char *s)
+{
+    int n = strlen(s), i;
+
+    for (i = 0; i + n <= len; i++) {
+        if (buf[i] == s[0] && 0 == memcmp(buf + i, s, n)) {
+            return buf + i;
+        }
+    }
+
+    return NULL;
+}
+
+/* a property post written has the broker send its reply, with the id of the post and code 200 */
+static void bench_on_write(const char *buf, int len)
+{
+    char reply[96];
+    const char *p;
+    int id = 0;
+
+#ifdef RAW_DATA_DIRECT_ENABLED
+    /* a PUBLISH, the SUBSCRIBE of up_raw_reply has the topic in it too */
+    if (len > 0 && 0x30 == (buf[0] & 0xF0) && NULL != bench_memmem(buf, len, BENCH_UP_RAW_TOPIC)) {
+        bench_raw_written = 1;
+        return;
+    }
+#endif
+    if (NULL == bench_memmem(buf, len, "thing.event.property.post") ||
+        NULL == (p = bench_memmem(buf, len, "\"id\":\""))) {
+        return;
+    }
+    for (p += 6; p < buf + len && *p >= '0' && *p <= '9'; p++) {
+        id = id * 10 + *p - '0';
+    }
+    snprintf(reply, sizeof(reply), "{\"id\":\"%d\",\"code\":200,\"data\":{}}", id);
+    bench_broker_inject(&bench_broker, BENCH_POST_REPLY_TOPIC, reply, 1, 0);
+}
+
+static int bench_on_connect(void *ctx)
+{
+    bench_connected = 1;
+    return 0;
+}
+
+static void bench_yield(void)
+{
+    linkkit_dispatch();
+#ifdef CMP_SUPPORT_MULTI_THREAD
+    HAL_SleepMs(BENCH_YIELD_MS);
+#else
+    linkkit_yield(BENCH_YIELD_MS);
+#endif
+}
+
+/* linkkit_start to the reply of the first post, what each phase took into round */
+static int bench_round(linkkit_ops_t *ops, const char *tsl, int round)
+{
+    const lite_startup_phase_t *phase;
+    uint64_t deadline = HAL_UptimeMs() + BENCH_ROUND_TIMEOUT_MS;
+    void *thing;
+    int posted = 0, ctx = 0, i;
+
+    bench_connected = 0;
+    if (0 != linkkit_start(BENCH_BUFFERED_MSG, 0, linkkit_loglevel_crit, ops, linkkit_cloud_domain_sh, &ctx) ||
+        NULL == (thing = linkkit_set_tsl(tsl, strlen(tsl)))) {
+        linkkit_end();
+        return -1;
+    }
+
+    while (!LITE_startup_phase(LITE_STARTUP_FIRST_POST)->ended && HAL_UptimeMs() < deadline) {
+        bench_yield();
+        /* the way an application reports its state once online */
+        if (bench_connected && !posted) {
+            posted = (0 == linkkit_post_property(thing, NULL));
+        }
+    }
+
+#ifdef RAW_DATA_DIRECT_ENABLED
+    bench_raw_written = 0;
+    if (LITE_startup_phase(LITE_STARTUP_FIRST_POST)->ended &&
+        0 == linkkit_invoke_raw_service(thing, 1, (void *)"raw", 3)) {
+        while (!bench_raw_written && HAL_UptimeMs() < deadline) {
+            bench_yield();
+        }
+    }
+    bench_raw_lost += !bench_raw_written;
+#endif
+
+    for (i = 0; i < LITE_STARTUP_PHASE_MAX; i++) {
+        phase = LITE_startup_phase(i);
+        if (phase->ended) {
+            bench_took[i][round] = (uint32_t)(phase->end_us - phase->begin_us);
+            bench_took[i][round] += bench_took[i][round] ? 0 : 1;
+        }
+    }
+    if (0 == round) {
+        LITE_startup_dump();
+    }
+
+    linkkit_end();
+    return 0;
+}
+
+static int bench_uint32_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* percentiles of each phase over the rounds it was reached in, the times are sorted */
+static void bench_report(int rounds)
+{
+    uint32_t *took;
+    int i, lost;
+
+    HAL_Printf("%-14s %6s %10s %10s %10s %10s\n", "PHASE", "ROUNDS", "P50 ms", "P90 ms", "MAX ms", "MIN ms");
+    for (i = 0; i < LITE_STARTUP_PHASE_MAX; i++) {
+        took = bench_took[i];
+        qsort(took, rounds, sizeof(uint32_t), bench_uint32_cmp);
+        /* what was not reached is 0 and sorted first */
+        for (lost = 0; lost < rounds && 0 == took[lost]; lost++);
+        if (lost == rounds) {
+            HAL_Printf("%-14s %6d %10s %10s %10s %10s\n", LITE_startup_name(i), 0, "-", "-", "-", "-");
+            continue;
+        }
+        HAL_Printf("%-14s %6d %10.3f %10.3f %10.3f %10.3f\n", LITE_startup_name(i), rounds - lost,
+                   took[lost + (rounds - lost - 1) / 2] / 1000.0,
+                   took[lost + ((rounds - lost) * 90 - 1) / 100] / 1000.0,
+                   took[rounds - 1] / 1000.0, took[lost] / 1000.0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static linkkit_ops_t ops;
+    int rounds = argc > 1 ? atoi(argv[1]) : BENCH_ROUNDS_DEFAULT;
+    int properties = argc > 2 ? atoi(argv[2]) : BENCH_PROPERTIES_DEFAULT;
+    int failed = 0, round, i;
+    char *tsl;
+
+    if (rounds <= 0 || properties <= 0 || properties > BENCH_PROPERTIES_MAX) {
+        HAL_Printf("usage: %s [rounds] [properties, 1 to %d]\n", argv[0], BENCH_PROPERTIES_MAX);
+        return 1;
+    }
+
+    IOT_OpenLog("startup-bench");
+    IOT_SetLogLevel(IOT_LOG_CRIT);
+
+    tsl = bench_tsl(properties);
+    for (i = 0; i < LITE_STARTUP_PHASE_MAX; i++) {
+        bench_took[i] = calloc(rounds, sizeof(uint32_t));
+        failed |= (NULL == bench_took[i]);
+    }
+    if (NULL == tsl || failed || 0 != bench_broker_start(&bench_broker)) {
+        HAL_Printf("loopback broker not started\n");
+        return 1;
+    }
+    bench_redirect(bench_broker.port, bench_on_write);
+    HAL_Printf("%d rounds with %d properties, loopback broker at port %u\n", rounds, properties, bench_broker.port);
+
+    HAL_SetProductKey(BENCH_PRODUCT_KEY);
+    HAL_SetDeviceName(BENCH_DEVICE_NAME);
+    HAL_SetDeviceSecret("bench");
+
+    ops.on_connect = bench_on_connect;
+    for (round = 0; round < rounds; round++) {
+        if (0 != bench_round(&ops, tsl, round)) {
+            failed++;
+        }
+    }
+
+    bench_report(rounds);
+    HAL_Printf("%d rounds not started\n", failed);
+#ifdef RAW_DATA_DIRECT_ENABLED
+    HAL_Printf("%d rounds without their raw data written\n", bench_raw_lost);
+#endif
+
+    bench_broker_stop(&bench_broker);
+    for (i = 0; i < LITE_STARTUP_PHASE_MAX; i++) {
+        free(bench_took[i]);
+    }
+    free(tsl);
+    IOT_CloseLog();
+    return 0;
+}
@@ -0,0 +1,720 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Load of the subdevice APIs: a gateway with N simulated subdevices against a loopback broker
+ * in this process, which answers register, login and logout the way the cloud does and sends
+ * RRPC requests. Throughput and p50/p99 latency of each operation and the memory of the gateway
+ * per subdevice, as LITE_malloc() counts it, are printed. Usage: subdev-bench [subdevices] [rrpc subdevices]
+ *
+ * RRPC requests go to the first 'rrpc subdevices' in turn, BENCH_RRPC_PER_DEVICE each.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-utils.h"
+#include "lite-system.h"
+
+#define BENCH_DEVICES_DEFAULT       (100)
+#define BENCH_DEVICES_MAX           (10000)
+#define BENCH_RRPC_DEVICES_DEFAULT  (8)
+#define BENCH_RRPC_PER_DEVICE       (16)
+#define BENCH_RRPC_WINDOW           (8)
+/* requests in flight, below the pending requests and the subscribe acks waited for of the gateway */
+#define BENCH_ASYNC_WINDOW          (16)
+#define BENCH_PHASE_TIMEOUT_MS      (60000)
+/* as BENCH_YIELD_MS of mqtt-bench/bench_broker.h for the benches on its broker, see there */
+#define BENCH_YIELD_MS              (10)
+#define BENCH_BUF_SIZE              (64 * 1024)
+#define BENCH_MQTT_BUF_SIZE         (4096)
+
+#define BENCH_PRODUCT_KEY           "bench_pk"
+#define BENCH_GATEWAY_DN            "bench_gateway"
+#define BENCH_PROPERTIES            "{\"Power\":{\"value\":1}}"
+
+/* the loopback broker, its counters are shared with the gateway thread under 'lock' */
+typedef struct {
+    int                 listen_fd;
+    int                 fd;
+    uint16_t            port;
+    void               *lock;
+    void               *sem_exit;
+    int                 stop;
+    unsigned char      *buf;
+    int                 buf_len;
+    int                 posts;              /* property posts received, packed ones counted one by one */
+    int                 rrpc_num;           /* RRPC requests to send */
+    int                 rrpc_sent;
+    int                 rrpc_done;
+    int                 rrpc_devices;
+    uint64_t           *rrpc_start;
+    uint32_t           *rrpc_latency;
+} bench_broker_t;
+
+/* one operation, the latency of each of its requests in us */
+typedef struct {
+    const char         *name;
+    uint32_t           *latency;
+    uint64_t           *start;
+    int                 num;
+    int                 done;
+    int                 failed;
+    int                 in_flight;
+    uint64_t            elapsed_us;
+} bench_op_t;
+
+static char (*bench_dn)[24];
+static int bench_devices = BENCH_DEVICES_DEFAULT;
+
+static uint64_t bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int bench_uint32_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* throughput of what completed and percentiles of the ones succeeded, the latencies are sorted */
+static void bench_op_report(bench_op_t *op)
+{
+    int ok = op->done - op->failed;
+    double rate = op->elapsed_us ? (double)op->done * 1000000 / (double)op->elapsed_us : 0;
+
+    qsort(op->latency, op->num, sizeof(uint32_t), bench_uint32_cmp);
+    if (0 == ok) {
+        HAL_Printf("%-10s %6d ok %5d failed\n", op->name, ok, op->num - ok);
+        return;
+    }
+
+    /* failed ones are 0 and sorted first */
+    HAL_Printf("%-10s %6d ok %5d failed %10.1f ops/s  p50 %8.3f ms  p99 %8.3f ms\n",
+               op->name, ok, op->num - ok, rate,
+               op->latency[op->num - ok + (ok - 1) / 2] / 1000.0,
+               op->latency[op->num - ok + (ok * 99 - 1) / 100] / 1000.0);
+}
+
+static int bench_op_init(bench_op_t *op, const char *name, int num)
+{
+    memset(op, 0, sizeof(bench_op_t));
+    op->name = name;
+    op->num = num;
+    op->latency = calloc(num, sizeof(uint32_t));
+    op->start = calloc(num, sizeof(uint64_t));
+    return (NULL == op->latency || NULL == op->start) ? -1 : 0;
+}
+
+static void bench_op_release(bench_op_t *op)
+{
+    free(op->latency);
+    free(op->start);
+}
+
+static void bench_op_reply(void *gateway, const char *product_key, const char *device_name,
+                           int result, void *pcontext)
+{
+    bench_op_t *op = (bench_op_t *)pcontext;
+    int i = atoi(device_name + 3);
+
+    if (0 == result) {
+        op->latency[i] = (uint32_t)(bench_now_us() - op->start[i]);
+    } else {
+        op->failed++;
+    }
+    op->done++;
+    op->in_flight--;
+}
+
+static int bench_remaining_length(unsigned char *p, int len, int *value)
+{
+    int i, multiplier = 1;
+
+    *value = 0;
+    for (i = 1; i < len && i <= 4; i++) {
+        *value += (p[i] & 127) * multiplier;
+        multiplier *= 128;
+        if (0 == (p[i] & 128)) {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+static void bench_broker_send(bench_broker_t *broker, unsigned char *packet, int len)
+{
+    int n;
+
+    while (len > 0 && (n = send(broker->fd, packet, len, 0)) > 0) {
+        packet += n;
+        len -= n;
+    }
+}
+
+static void bench_broker_publish(bench_broker_t *broker, const char *topic, const char *payload)
+{
+    int topic_len = strlen(topic), payload_len = strlen(payload);
+    int body = 2 + topic_len + payload_len, len = 0;
+    unsigned char *packet = malloc(body + 5);
+
+    if (NULL == packet) {
+        return;
+    }
+
+    packet[len++] = 0x30;
+    do {
+        packet[len] = body % 128;
+        body /= 128;
+        packet[len++] |= body ? 128 : 0;
+    } while (body);
+    packet[len++] = topic_len >> 8;
+    packet[len++] = topic_len & 0xff;
+    memcpy(packet + len, topic, topic_len);
+    memcpy(packet + len + topic_len, payload, payload_len);
+    bench_broker_send(broker, packet, len + topic_len + payload_len);
+    free(packet);
+}
+
+static int bench_ends_with(const char *s, int len, const char *suffix)
+{
+    int n = strlen(suffix);
+
+    return len >= n && 0 == memcmp(s + len - n, suffix, n);
+}
+
+/* "{"id":N,"code":200,"data":[...]}", the entries echo the devices of the request */
+static void bench_broker_reply(bench_broker_t *broker, char *topic, char *payload, int is_register)
+{
+    char reply_topic[160];
+    char *reply, *pk, *dn, *id;
+    int len = 0, max = strlen(payload) * 2 + 64, pk_len, dn_len;
+
+    if (NULL == (id = strstr(payload, "\"id\":")) || NULL == (reply = malloc(max))) {
+        return;
+    }
+
+    id += 5;
+    if ('"' == *id) {
+        id++;
+    }
+    len += snprintf(reply, max, "{\"id\":%d,\"code\":200,\"data\":[", atoi(id));
+    for (pk = payload; NULL != (pk = strstr(pk, "\"productKey\":\"")); pk = dn) {
+        pk += 14;
+        pk_len = strcspn(pk, "\"");
+        if (NULL == (dn = strstr(pk, "\"deviceName\":\""))) {
+            break;
+        }
+        dn += 14;
+        dn_len = strcspn(dn, "\"");
+        len += snprintf(reply + len, max - len, "%s{\"productKey\":\"%.*s\",\"deviceName\":\"%.*s\"%s}",
+                        '[' == reply[len - 1] ? "" : ",", pk_len, pk, dn_len, dn,
+                        is_register ? ",\"deviceSecret\":\"bench\"" : "");
+    }
+    snprintf(reply + len, max - len, "]}");
+
+    snprintf(reply_topic, sizeof(reply_topic), "%s_reply", topic);
+    bench_broker_publish(broker, reply_topic, reply);
+    free(reply);
+}
+
+static void bench_broker_on_publish(bench_broker_t *broker, unsigned char *packet, int header, int len)
+{
+    unsigned char *body = packet + header;
+    int qos = (packet[0] >> 1) & 3, topic_len, k, n = 0;
+    char *topic, *payload, *p;
+
+    topic_len = body[0] << 8 | body[1];
+    k = 2 + topic_len + (qos ? 2 : 0);
+    if (k > len) {
+        return;
+    }
+    if (qos) {
+        unsigned char puback[4] = {0x40, 2, body[2 + topic_len], body[3 + topic_len]};
+        bench_broker_send(broker, puback, 4);
+    }
+
+    topic = malloc(topic_len + 1);
+    payload = malloc(len - k + 1);
+    if (NULL == topic || NULL == payload) {
+        free(topic);
+        free(payload);
+        return;
+    }
+    memcpy(topic, body + 2, topic_len);
+    topic[topic_len] = '\0';
+    memcpy(payload, body + k, len - k);
+    payload[len - k] = '\0';
+
+    if (NULL != (p = strstr(topic, "/rrpc/response/"))) {
+        k = atoi(p + 15) - 1;
+        HAL_MutexLock(broker->lock);
+        if (k >= 0 && k < broker->rrpc_num && 0 == broker->rrpc_latency[k]) {
+            broker->rrpc_latency[k] = (uint32_t)(bench_now_us() - broker->rrpc_start[k]);
+            broker->rrpc_done++;
+        }
+        HAL_MutexUnlock(broker->lock);
+    } else if (bench_ends_with(topic, topic_len, "/property/pack/post")) {
+        for (p = payload; NULL != (p = strstr(p, "\"identity\"")); p++) {
+            n++;
+        }
+    } else if (bench_ends_with(topic, topic_len, "/property/post")) {
+        n = 1;
+    } else if (bench_ends_with(topic, topic_len, "/register")) {
+        bench_broker_reply(broker, topic, payload, 1);
+    } else if (bench_ends_with(topic, topic_len, "/login") || bench_ends_with(topic, topic_len, "/logout") ||
+               bench_ends_with(topic, topic_len, "/topo/add") || bench_ends_with(topic, topic_len, "/topo/delete")) {
+        bench_broker_reply(broker, topic, payload, 0);
+    }
+
+    if (n) {
+        HAL_MutexLock(broker->lock);
+        broker->posts += n;
+        HAL_MutexUnlock(broker->lock);
+    }
+    free(topic);
+    free(payload);
+}
+
+static void bench_broker_on_packet(bench_broker_t *broker, unsigned char *packet, int header, int len)
+{
+    unsigned char *body = packet + header;
+    unsigned char ack[4];
+    int k;
+
+    switch (packet[0] >> 4) {
+        case 1:     /* CONNECT */
+            ack[0] = 0x20;
+            ack[1] = 2;
+            ack[2] = 0;
+            ack[3] = 0;
+            bench_broker_send(broker, ack, 4);
+            break;
+        case 3:     /* PUBLISH */
+            bench_broker_on_publish(broker, packet, header, len);
+            break;
+        case 8: {   /* SUBSCRIBE, every filter granted the QoS asked for */
+            unsigned char *suback = malloc(len + 4);
+            int n = 0;
+
+            if (NULL == suback || len < 2) {
+                free(suback);
+                break;
+            }
+            for (k = 2; k + 2 < len; k += 3 + (body[k] << 8 | body[k + 1])) {
+                suback[4 + n++] = body[k + 2 + (body[k] << 8 | body[k + 1])] & 3;
+            }
+            suback[0] = 0x90;
+            suback[1] = 2 + n;
+            suback[2] = body[0];
+            suback[3] = body[1];
+            bench_broker_send(broker, suback, 4 + n);
+            free(suback);
+            break;
+        }
+        case 10:    /* UNSUBSCRIBE */
+            ack[0] = 0xb0;
+            ack[1] = 2;
+            ack[2] = body[0];
+            ack[3] = body[1];
+            bench_broker_send(broker, ack, 4);
+            break;
+        case 12:    /* PINGREQ */
+            ack[0] = 0xd0;
+            ack[1] = 0;
+            bench_broker_send(broker, ack, 2);
+            break;
+        default:
+            break;
+    }
+}
+
+/* RRPC requests go to the first rrpc_devices subdevices in turn, BENCH_RRPC_WINDOW in flight */
+static void bench_broker_send_rrpc(bench_broker_t *broker)
+{
+    char topic[128];
+    int k;
+
+    HAL_MutexLock(broker->lock);
+    while (broker->rrpc_sent < broker->rrpc_num && broker->rrpc_sent - broker->rrpc_done < BENCH_RRPC_WINDOW) {
+        k = broker->rrpc_sent++;
+        broker->rrpc_start[k] = bench_now_us();
+        HAL_MutexUnlock(broker->lock);
+        snprintf(topic, sizeof(topic), "/sys/%s/%s/rrpc/request/%d",
+                 BENCH_PRODUCT_KEY, bench_dn[k % broker->rrpc_devices], k + 1);
+        bench_broker_publish(broker, topic, "{\"method\":\"thing.service.property.get\",\"params\":[\"Power\"]}");
+        HAL_MutexLock(broker->lock);
+    }
+    HAL_MutexUnlock(broker->lock);
+}
+
+static void *bench_broker_routine(void *arg)
+{
+    bench_broker_t *broker = (bench_broker_t *)arg;
+    struct timeval tv;
+    fd_set fds;
+    int n, off, header, len, one = 1;
+
+    broker->fd = accept(broker->listen_fd, NULL, NULL);
+    if (broker->fd >= 0) {
+        setsockopt(broker->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    while (broker->fd >= 0 && !broker->stop) {
+        bench_broker_send_rrpc(broker);
+
+        FD_ZERO(&fds);
+        FD_SET(broker->fd, &fds);
+        tv.tv_sec = 0;
+        tv.tv_usec = 1000;
+        if (select(broker->fd + 1, &fds, NULL, NULL, &tv) <= 0) {
+            continue;
+        }
+
+        n = recv(broker->fd, broker->buf + broker->buf_len, BENCH_BUF_SIZE - broker->buf_len, 0);
+        if (n <= 0) {
+            break;
+        }
+        broker->buf_len += n;
+
+        for (off = 0; off < broker->buf_len; off += header + len) {
+            header = bench_remaining_length(broker->buf + off, broker->buf_len - off, &len);
+            if (0 == header || off + header + len > broker->buf_len) {
+                break;
+            }
+            bench_broker_on_packet(broker, broker->buf + off, header, len);
+        }
+        memmove(broker->buf, broker->buf + off, broker->buf_len - off);
+        broker->buf_len -= off;
+        if (BENCH_BUF_SIZE == broker->buf_len) {
+            HAL_Printf("broker: packet larger than %d bytes\n", BENCH_BUF_SIZE);
+            break;
+        }
+    }
+
+    if (broker->fd >= 0) {
+        close(broker->fd);
+    }
+    HAL_SemaphorePost(broker->sem_exit);
+    return NULL;
+}
+
+static int bench_broker_start(bench_broker_t *broker)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    void *thread;
+
+    memset(broker, 0, sizeof(bench_broker_t));
+    broker->fd = -1;
+    broker->lock = HAL_MutexCreate();
+    broker->sem_exit = HAL_SemaphoreCreate();
+    broker->buf = malloc(BENCH_BUF_SIZE);
+    broker->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (NULL == broker->lock || NULL == broker->sem_exit || NULL == broker->buf || broker->listen_fd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 != bind(broker->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        0 != listen(broker->listen_fd, 1) ||
+        0 != getsockname(broker->listen_fd, (struct sockaddr *)&addr, &addr_len)) {
+        return -1;
+    }
+    broker->port = ntohs(addr.sin_port);
+
+    if (0 != HAL_ThreadCreate(&thread, bench_broker_routine, broker, NULL, NULL)) {
+        return -1;
+    }
+    HAL_ThreadDetach(thread);
+    return 0;
+}
+
+static void bench_broker_stop(bench_broker_t *broker)
+{
+    broker->stop = 1;
+    shutdown(broker->listen_fd, SHUT_RDWR);
+    (void)HAL_SemaphoreWait(broker->sem_exit, PLATFORM_WAIT_INFINITE);
+    close(broker->listen_fd);
+    HAL_SemaphoreDestroy(broker->sem_exit);
+    HAL_MutexDestroy(broker->lock);
+    free(broker->buf);
+    free(broker->rrpc_start);
+    free(broker->rrpc_latency);
+}
+
+static int bench_broker_get(bench_broker_t *broker, int *counter)
+{
+    int value;
+
+    HAL_MutexLock(broker->lock);
+    value = *counter;
+    HAL_MutexUnlock(broker->lock);
+    return value;
+}
+
+/* 0 register, 1 login, 2 logout, BENCH_ASYNC_WINDOW of them in flight */
+static void bench_run_async(void *gateway, bench_op_t *op, int which)
+{
+    uint64_t start = bench_now_us(), deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS;
+    int i = 0, ret;
+
+    while (op->done < op->num && HAL_UptimeMs() < deadline) {
+        while (i < op->num && op->in_flight < BENCH_ASYNC_WINDOW) {
+            op->start[i] = bench_now_us();
+            if (0 == which) {
+                ret = IOT_Subdevice_Register_Async(gateway, IOTX_SUBDEV_REGISTER_TYPE_DYNAMIC,
+                                                   BENCH_PRODUCT_KEY, bench_dn[i], NULL, NULL, NULL,
+                                                   IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA, bench_op_reply, op);
+            } else if (1 == which) {
+                ret = IOT_Subdevice_Login_Async(gateway, BENCH_PRODUCT_KEY, bench_dn[i], NULL, NULL, NULL,
+                                                IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA, IOTX_SUBDEV_CLEAN_SESSION_TRUE,
+                                                bench_op_reply, op);
+            } else {
+                ret = IOT_Subdevice_Logout_Async(gateway, BENCH_PRODUCT_KEY, bench_dn[i], bench_op_reply, op);
+            }
+            if (0 == ret) {
+                op->in_flight++;
+            } else {
+                op->failed++;
+                op->done++;
+            }
+            i++;
+        }
+        IOT_Gateway_Yield(gateway, BENCH_YIELD_MS);
+    }
+    op->elapsed_us = bench_now_us() - start;
+}
+
+/* packed posts with IOT_Gateway_Post_Property(), or one publish of each subdevice;
+ * the latency is the call, the throughput is until the broker has them all */
+static void bench_run_post(void *gateway, bench_broker_t *broker, bench_op_t *op, int packed)
+{
+    char topic[128];
+    iotx_mqtt_topic_info_t msg;
+    uint64_t start = bench_now_us();
+    uint32_t deadline;
+    int i, ret, expected;
+
+    expected = bench_broker_get(broker, &broker->posts);
+    for (i = 0; i < op->num; i++) {
+        op->start[i] = bench_now_us();
+        if (packed) {
+            ret = IOT_Gateway_Post_Property(gateway, BENCH_PRODUCT_KEY, bench_dn[i], BENCH_PROPERTIES);
+        } else {
+            memset(&msg, 0, sizeof(msg));
+            msg.qos = IOTX_MQTT_QOS0;
+            msg.payload = (void *)"{\"id\":1,\"version\":\"1.0\",\"params\":" BENCH_PROPERTIES
+                          ",\"method\":\"thing.event.property.post\"}";
+            msg.payload_len = strlen(msg.payload);
+            snprintf(topic, sizeof(topic), "/sys/%s/%s/thing/event/property/post", BENCH_PRODUCT_KEY, bench_dn[i]);
+            ret = IOT_Gateway_Publish(gateway, topic, &msg);
+        }
+        if (0 == ret) {
+            op->latency[i] = (uint32_t)(bench_now_us() - op->start[i]);
+            expected++;
+        } else {
+            op->failed++;
+        }
+        op->done++;
+    }
+    if (packed) {
+        IOT_Gateway_Post_Property_Flush(gateway);
+    }
+
+    deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS;
+    while (bench_broker_get(broker, &broker->posts) < expected && HAL_UptimeMs() < deadline) {
+        HAL_SleepMs(1);
+    }
+    op->elapsed_us = bench_now_us() - start;
+}
+
+static void bench_rrpc_request(void *gateway, const char *product_key, const char *device_name,
+                               const char *message_id, const char *payload)
+{
+    IOT_Gateway_RRPC_Response(gateway, product_key, device_name, message_id, "{\"code\":200,\"data\":{\"Power\":1}}");
+}
+
+/* the latency is from the request sent by the broker to the response it gets */
+static void bench_run_rrpc(void *gateway, bench_broker_t *broker, bench_op_t *op, int rrpc_devices)
+{
+    uint64_t start;
+    uint32_t deadline;
+    int i;
+
+    for (i = 0; i < rrpc_devices; i++) {
+        IOT_Gateway_RRPC_Register(gateway, BENCH_PRODUCT_KEY, bench_dn[i], bench_rrpc_request);
+    }
+
+    HAL_MutexLock(broker->lock);
+    broker->rrpc_start = calloc(op->num, sizeof(uint64_t));
+    broker->rrpc_latency = calloc(op->num, sizeof(uint32_t));
+    broker->rrpc_devices = rrpc_devices;
+    broker->rrpc_num = (NULL == broker->rrpc_start || NULL == broker->rrpc_latency) ? 0 : op->num;
+    HAL_MutexUnlock(broker->lock);
+
+    start = bench_now_us();
+    deadline = HAL_UptimeMs() + BENCH_PHASE_TIMEOUT_MS;
+    while (bench_broker_get(broker, &broker->rrpc_done) < broker->rrpc_num && HAL_UptimeMs() < deadline) {
+        IOT_Gateway_Yield(gateway, BENCH_YIELD_MS);
+    }
+    op->elapsed_us = bench_now_us() - start;
+
+    HAL_MutexLock(broker->lock);
+    op->done = broker->rrpc_done;
+    op->failed = op->num - broker->rrpc_done;
+    if (broker->rrpc_num) {
+        memcpy(op->latency, broker->rrpc_latency, op->num * sizeof(uint32_t));
+    }
+    HAL_MutexUnlock(broker->lock);
+}
+
+int main(int argc, char *argv[])
+{
+    static char write_buf[BENCH_MQTT_BUF_SIZE], read_buf[BENCH_MQTT_BUF_SIZE];
+    iotx_mqtt_param_t mqtt_param;
+    iotx_gateway_param_t gateway_param;
+    bench_broker_t broker;
+    bench_op_t ops[6];
+    void *gateway;
+    int rrpc_devices = BENCH_RRPC_DEVICES_DEFAULT;
+    int i, mem_base, mem_registered, mem_logged_in;
+
+    if (argc > 1) {
+        bench_devices = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        rrpc_devices = atoi(argv[2]);
+    }
+    if (bench_devices <= 0 || bench_devices > BENCH_DEVICES_MAX || rrpc_devices < 0) {
+        HAL_Printf("usage: %s [subdevices, 1 to %d] [rrpc subdevices]\n", argv[0], BENCH_DEVICES_MAX);
+        return 1;
+    }
+    if (rrpc_devices > bench_devices) {
+        rrpc_devices = bench_devices;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    IOT_OpenLog("subdev-bench");
+    /* the subdevices past the topic handles of the MQTT client are logged as errors, one by one */
+    IOT_SetLogLevel(IOT_LOG_CRIT);
+
+    bench_dn = calloc(bench_devices, sizeof(bench_dn[0]));
+    if (NULL == bench_dn || 0 != bench_broker_start(&broker)) {
+        HAL_Printf("loopback broker not started\n");
+        return 1;
+    }
+    for (i = 0; i < bench_devices; i++) {
+        snprintf(bench_dn[i], sizeof(bench_dn[i]), "dev%05d", i);
+    }
+
+    iotx_device_info_init();
+    iotx_device_info_set(BENCH_PRODUCT_KEY, BENCH_GATEWAY_DN, "bench");
+
+    memset(&mqtt_param, 0, sizeof(mqtt_param));
+    mqtt_param.host = "127.0.0.1";
+    mqtt_param.port = broker.port;
+    mqtt_param.client_id = BENCH_PRODUCT_KEY "." BENCH_GATEWAY_DN;
+    mqtt_param.username = BENCH_GATEWAY_DN "&" BENCH_PRODUCT_KEY;
+    mqtt_param.password = "bench";
+    mqtt_param.request_timeout_ms = 2000;
+    mqtt_param.keepalive_interval_ms = 60000;
+    mqtt_param.pwrite_buf = write_buf;
+    mqtt_param.write_buf_size = sizeof(write_buf);
+    mqtt_param.pread_buf = read_buf;
+    mqtt_param.read_buf_size = sizeof(read_buf);
+
+    memset(&gateway_param, 0, sizeof(gateway_param));
+    gateway_param.mqtt = &mqtt_param;
+
+    mem_base = LITE_get_malloc_bytes_in_use();
+    gateway = IOT_Gateway_Construct(&gateway_param);
+    if (NULL == gateway) {
+        HAL_Printf("gateway not constructed\n");
+        bench_broker_stop(&broker);
+        return 1;
+    }
+    mem_base = LITE_get_malloc_bytes_in_use() - mem_base;
+
+    if (0 != bench_op_init(&ops[0], "register", bench_devices) ||
+        0 != bench_op_init(&ops[1], "login", bench_devices) ||
+        0 != bench_op_init(&ops[2], "publish", bench_devices) ||
+        0 != bench_op_init(&ops[3], "pack post", bench_devices) ||
+        0 != bench_op_init(&ops[4], "rrpc", rrpc_devices ? rrpc_devices * BENCH_RRPC_PER_DEVICE : 1) ||
+        0 != bench_op_init(&ops[5], "logout", bench_devices)) {
+        HAL_Printf("no memory for %d subdevices\n", bench_devices);
+        return 1;
+    }
+
+    HAL_Printf("%d subdevices, rrpc to %d of them, loopback broker at port %u\n",
+               bench_devices, rrpc_devices, broker.port);
+
+    mem_registered = LITE_get_malloc_bytes_in_use();
+    bench_run_async(gateway, &ops[0], 0);
+    mem_registered = LITE_get_malloc_bytes_in_use() - mem_registered;
+    bench_op_report(&ops[0]);
+
+    mem_logged_in = LITE_get_malloc_bytes_in_use();
+    bench_run_async(gateway, &ops[1], 1);
+    mem_logged_in = LITE_get_malloc_bytes_in_use() - mem_logged_in;
+    bench_op_report(&ops[1]);
+
+    bench_run_post(gateway, &broker, &ops[2], 0);
+    bench_op_report(&ops[2]);
+    bench_run_post(gateway, &broker, &ops[3], 1);
+    bench_op_report(&ops[3]);
+
+    if (rrpc_devices) {
+        bench_run_rrpc(gateway, &broker, &ops[4], rrpc_devices);
+        bench_op_report(&ops[4]);
+    }
+
+    bench_run_async(gateway, &ops[5], 2);
+    bench_op_report(&ops[5]);
+
+    HAL_Printf("gateway memory: %d bytes, per subdevice %d registered, %d more logged in\n",
+               mem_base, mem_registered / bench_devices, mem_logged_in / bench_devices);
+
+    IOT_Gateway_Destroy(&gateway);
+    bench_broker_stop(&broker);
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        bench_op_release(&ops[i]);
+    }
+    free(bench_dn);
+    IOT_CloseLog();
+    return 0;
+}
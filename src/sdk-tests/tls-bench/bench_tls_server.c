@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+#include "iot_import.h"
+#include "bench_tls_server.h"
+
+#define BENCH_TLS_CA_MAX            (4096)
+#define BENCH_TLS_RECORD_MAX        (16384)
+#define BENCH_TLS_IO_TIMEOUT_S      (10)
+#define BENCH_DTLS_LINK_MTU         (1400)
+
+typedef struct {
+    bench_tls_listener_t    which;
+    int                     fd;
+    uint16_t                port;
+    SSL_CTX                *ctx;
+    void                   *sem_exit;
+    volatile int            handshakes;
+    volatile int            resumed;
+    unsigned char           buf[BENCH_TLS_RECORD_MAX];   /* of the DTLS session, one at a time */
+} bench_tls_listener_ctx_t;
+
+typedef struct {
+    bench_tls_listener_ctx_t   *listener;
+    int                         fd;
+} bench_tls_conn_t;
+
+static EVP_PKEY *bench_tls_key;
+static X509 *bench_tls_crt;
+static char bench_tls_ca[BENCH_TLS_CA_MAX];
+static bench_tls_listener_ctx_t bench_tls_listeners[BENCH_TLS_LISTENERS];
+static volatile int bench_tls_stopping;
+static volatile int bench_tls_conns;
+
+/* self-signed, CN only as a subjectAltName would have mbedtls ignore the CN and it matches no IP */
+static int bench_tls_cert_create(int key_bits)
+{
+    X509_NAME *name;
+    X509_EXTENSION *ext;
+    BIO *bio;
+    int len;
+
+    bench_tls_key = EVP_RSA_gen(key_bits);
+    bench_tls_crt = X509_new();
+    if (NULL == bench_tls_key || NULL == bench_tls_crt) {
+        return -1;
+    }
+
+    X509_set_version(bench_tls_crt, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(bench_tls_crt), key_bits);
+    X509_gmtime_adj(X509_getm_notBefore(bench_tls_crt), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(bench_tls_crt), 24 * 3600);
+    X509_set_pubkey(bench_tls_crt, bench_tls_key);
+    name = X509_get_subject_name(bench_tls_crt);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"127.0.0.1", -1, -1, 0);
+    X509_set_issuer_name(bench_tls_crt, name);
+    ext = X509V3_EXT_conf_nid(NULL, NULL, NID_basic_constraints, "critical,CA:TRUE");
+    if (NULL == ext) {
+        return -1;
+    }
+    X509_add_ext(bench_tls_crt, ext, -1);
+    X509_EXTENSION_free(ext);
+    if (X509_sign(bench_tls_crt, bench_tls_key, EVP_sha256()) <= 0) {
+        return -1;
+    }
+
+    if (NULL == (bio = BIO_new(BIO_s_mem()))) {
+        return -1;
+    }
+    PEM_write_bio_X509(bio, bench_tls_crt);
+    len = BIO_read(bio, bench_tls_ca, sizeof(bench_tls_ca) - 1);
+    BIO_free(bio);
+    if (len <= 0) {
+        return -1;
+    }
+    bench_tls_ca[len] = '\0';
+    return 0;
+}
+
+static SSL_CTX *bench_tls_ctx_create(bench_tls_listener_t which, const char *ciphers)
+{
+    int dtls = which >= BENCH_DTLS_FULL;
+    SSL_CTX *ctx = SSL_CTX_new(dtls ? DTLS_server_method() : TLS_server_method());
+
+    if (NULL == ctx) {
+        return NULL;
+    }
+
+    /* the suites and key sizes of the small devices, whatever the policy of the host */
+    SSL_CTX_set_security_level(ctx, 0);
+    SSL_CTX_set_min_proto_version(ctx, dtls ? DTLS1_2_VERSION : TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(ctx, dtls ? DTLS1_2_VERSION : TLS1_2_VERSION);
+    if (1 != SSL_CTX_use_certificate(ctx, bench_tls_crt) || 1 != SSL_CTX_use_PrivateKey(ctx, bench_tls_key) ||
+        1 != SSL_CTX_set_cipher_list(ctx, ciphers)) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    SSL_CTX_set_session_id_context(ctx, (const unsigned char *)"tls-bench", strlen("tls-bench"));
+
+    switch (which) {
+        case BENCH_TLS_FULL:
+        case BENCH_DTLS_FULL:
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+            break;
+        case BENCH_TLS_SESSION_ID:
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+            break;
+        case BENCH_TLS_TICKET:
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+            break;
+        default:
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+            break;
+    }
+    if (dtls) {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_QUERY_MTU);
+    }
+
+    return ctx;
+}
+
+static int bench_tls_read_full(SSL *ssl, unsigned char *buf, int len)
+{
+    int got = 0, ret;
+
+    while (got < len) {
+        if ((ret = SSL_read(ssl, buf + got, len - got)) <= 0) {
+            return -1;
+        }
+        got += ret;
+    }
+
+    return 0;
+}
+
+static void bench_tls_serve(SSL *ssl, unsigned char *buf, uint32_t buf_len)
+{
+    unsigned char header[BENCH_TLS_HEADER_LEN];
+    uint32_t len, record, n;
+    int ret;
+
+    while (0 == bench_tls_read_full(ssl, header, sizeof(header))) {
+        len = (uint32_t)header[4] << 24 | header[5] << 16 | header[6] << 8 | header[7];
+        record = (uint32_t)header[8] << 24 | header[9] << 16 | header[10] << 8 | header[11];
+        if (0 == record || record > buf_len) {
+            record = buf_len;
+        }
+
+        if ('U' == header[0]) {
+            while (len > 0) {
+                n = len < buf_len ? len : buf_len;
+                if ((ret = SSL_read(ssl, buf, n)) <= 0) {
+                    return;
+                }
+                len -= ret;
+            }
+            if (SSL_write(ssl, "K", 1) <= 0) {
+                return;
+            }
+        } else if ('D' == header[0]) {
+            while (len > 0) {
+                n = len < record ? len : record;
+                if (SSL_write(ssl, buf, n) <= 0) {
+                    return;
+                }
+                len -= n;
+            }
+        } else {
+            return;
+        }
+    }
+}
+
+static void *bench_tls_conn_routine(void *arg)
+{
+    bench_tls_conn_t *conn = (bench_tls_conn_t *)arg;
+    bench_tls_listener_ctx_t *listener = conn->listener;
+    unsigned char *buf = calloc(1, BENCH_TLS_RECORD_MAX);
+    SSL *ssl;
+
+    if (NULL != buf && NULL != (ssl = SSL_new(listener->ctx))) {
+        SSL_set_fd(ssl, conn->fd);
+        if (1 == SSL_accept(ssl)) {
+            HAL_AtomicAdd(&listener->handshakes, 1);
+            HAL_AtomicAdd(&listener->resumed, SSL_session_reused(ssl) ? 1 : 0);
+            bench_tls_serve(ssl, buf, BENCH_TLS_RECORD_MAX);
+            SSL_shutdown(ssl);
+        }
+        SSL_free(ssl);
+    }
+    ERR_clear_error();
+    close(conn->fd);
+    free(buf);
+    free(conn);
+
+    HAL_AtomicAdd(&bench_tls_conns, -1);
+    return NULL;
+}
+
+/* each connection in a thread of its own, one can stay open while the others come and go */
+static void bench_tls_accept(bench_tls_listener_ctx_t *listener)
+{
+    struct timeval tv = { BENCH_TLS_IO_TIMEOUT_S, 0 };
+    bench_tls_conn_t *conn;
+    void *thread;
+    int one = 1;
+    int fd;
+
+    if ((fd = accept(listener->fd, NULL, NULL)) < 0) {
+        return;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (NULL == (conn = malloc(sizeof(bench_tls_conn_t)))) {
+        close(fd);
+        return;
+    }
+    conn->listener = listener;
+    conn->fd = fd;
+    HAL_AtomicAdd(&bench_tls_conns, 1);
+    if (0 != HAL_ThreadCreate(&thread, bench_tls_conn_routine, conn, NULL, NULL)) {
+        HAL_AtomicAdd(&bench_tls_conns, -1);
+        close(fd);
+        free(conn);
+        return;
+    }
+    HAL_ThreadDetach(thread);
+}
+
+/* with the peer of the first datagram waiting, the socket stays unconnected as a disconnect would unbind it */
+static void bench_dtls_accept(bench_tls_listener_ctx_t *listener)
+{
+    struct timeval tv = { BENCH_TLS_IO_TIMEOUT_S, 0 };
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    unsigned char byte;
+    BIO *bio;
+    SSL *ssl;
+    int reused = -1, ret;
+
+    if (recvfrom(listener->fd, &byte, 1, MSG_PEEK, (struct sockaddr *)&peer, &peer_len) < 0) {
+        return;
+    }
+
+    bio = BIO_new_dgram(listener->fd, BIO_NOCLOSE);
+    ssl = SSL_new(listener->ctx);
+    if (NULL != bio && NULL != ssl) {
+        BIO_dgram_set_peer(bio, &peer);
+        BIO_ctrl(bio, BIO_CTRL_DGRAM_SET_RECV_TIMEOUT, 0, &tv);
+        SSL_set_bio(ssl, bio, bio);
+        bio = NULL;
+        DTLS_set_link_mtu(ssl, BENCH_DTLS_LINK_MTU);
+        if (1 == SSL_accept(ssl)) {
+            reused = SSL_session_reused(ssl) ? 1 : 0;
+            while ((ret = SSL_read(ssl, listener->buf, sizeof(listener->buf))) > 0) {
+                if (SSL_write(ssl, listener->buf, ret) <= 0) {
+                    break;
+                }
+            }
+            SSL_shutdown(ssl);
+        }
+    }
+    SSL_free(ssl);
+    BIO_free(bio);
+    ERR_clear_error();
+
+    /* counted once the session ended, the datagrams of the next client are not taken for this one's */
+    if (reused >= 0) {
+        HAL_AtomicAdd(&listener->resumed, reused);
+        HAL_AtomicAdd(&listener->handshakes, 1);
+    }
+}
+
+static void *bench_tls_routine(void *arg)
+{
+    bench_tls_listener_ctx_t *listener = (bench_tls_listener_ctx_t *)arg;
+    struct pollfd pfd;
+
+    while (!bench_tls_stopping) {
+        pfd.fd = listener->fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        if (listener->which >= BENCH_DTLS_FULL) {
+            bench_dtls_accept(listener);
+        } else {
+            bench_tls_accept(listener);
+        }
+    }
+
+    HAL_SemaphorePost(listener->sem_exit);
+    return NULL;
+}
+
+static int bench_tls_listener_start(bench_tls_listener_ctx_t *listener, bench_tls_listener_t which,
+                                    const char *ciphers)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    void *thread;
+
+    listener->which = which;
+    listener->fd = socket(AF_INET, which >= BENCH_DTLS_FULL ? SOCK_DGRAM : SOCK_STREAM, 0);
+    listener->ctx = bench_tls_ctx_create(which, ciphers);
+    if (listener->fd < 0 || NULL == listener->ctx) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 != bind(listener->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        0 != getsockname(listener->fd, (struct sockaddr *)&addr, &addr_len) ||
+        (which < BENCH_DTLS_FULL && 0 != listen(listener->fd, 4))) {
+        return -1;
+    }
+    listener->port = ntohs(addr.sin_port);
+
+    if (NULL == (listener->sem_exit = HAL_SemaphoreCreate())) {
+        return -1;
+    }
+    if (0 != HAL_ThreadCreate(&thread, bench_tls_routine, listener, NULL, NULL)) {
+        HAL_SemaphoreDestroy(listener->sem_exit);
+        listener->sem_exit = NULL;
+        return -1;
+    }
+    HAL_ThreadDetach(thread);
+    return 0;
+}
+
+int bench_tls_server_start(int key_bits, const char *ciphers)
+{
+    int i;
+
+    bench_tls_stopping = 0;
+    memset(bench_tls_listeners, 0, sizeof(bench_tls_listeners));
+    for (i = 0; i < BENCH_TLS_LISTENERS; i++) {
+        bench_tls_listeners[i].fd = -1;
+    }
+
+    if (0 != bench_tls_cert_create(key_bits)) {
+        bench_tls_server_stop();
+        return -1;
+    }
+    for (i = 0; i < BENCH_TLS_LISTENERS; i++) {
+        if (0 != bench_tls_listener_start(&bench_tls_listeners[i], (bench_tls_listener_t)i, ciphers)) {
+            bench_tls_server_stop();
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void bench_tls_server_stop(void)
+{
+    bench_tls_listener_ctx_t *listener;
+    int i;
+
+    bench_tls_stopping = 1;
+    for (i = 0; i < BENCH_TLS_LISTENERS; i++) {
+        listener = &bench_tls_listeners[i];
+        if (NULL != listener->sem_exit) {
+            (void)HAL_SemaphoreWait(listener->sem_exit, PLATFORM_WAIT_INFINITE);
+            HAL_SemaphoreDestroy(listener->sem_exit);
+            listener->sem_exit = NULL;
+        }
+        if (listener->fd >= 0) {
+            close(listener->fd);
+            listener->fd = -1;
+        }
+    }
+    /* the connections end at the latest BENCH_TLS_IO_TIMEOUT_S after their client went */
+    while (HAL_AtomicAdd(&bench_tls_conns, 0) > 0) {
+        HAL_SleepMs(10);
+    }
+    for (i = 0; i < BENCH_TLS_LISTENERS; i++) {
+        SSL_CTX_free(bench_tls_listeners[i].ctx);
+        bench_tls_listeners[i].ctx = NULL;
+    }
+
+    X509_free(bench_tls_crt);
+    EVP_PKEY_free(bench_tls_key);
+    bench_tls_crt = NULL;
+    bench_tls_key = NULL;
+}
+
+const char *bench_tls_server_ca(void)
+{
+    return bench_tls_ca;
+}
+
+uint16_t bench_tls_server_port(bench_tls_listener_t listener)
+{
+    return bench_tls_listeners[listener].port;
+}
+
+void bench_tls_server_counts(bench_tls_listener_t listener, int *handshakes, int *resumed)
+{
+    *handshakes = HAL_AtomicAdd(&bench_tls_listeners[listener].handshakes, 0);
+    *resumed = HAL_AtomicAdd(&bench_tls_listeners[listener].resumed, 0);
+}
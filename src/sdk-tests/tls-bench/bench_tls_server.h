@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _BENCH_TLS_SERVER_H_
+#define _BENCH_TLS_SERVER_H_
+
+/*
+ * A loopback TLS 1.2 and DTLS 1.2 server on the OpenSSL of the host, the bundled mbedtls has no
+ * server side. Its certificate is self-signed for 127.0.0.1, so the PEM is the CA the client
+ * verifies it against. A TLS listener serves each connection in a thread of its own, a DTLS one
+ * serves one session at a time, as below.
+ *
+ * TLS, after the handshake the client sends a header of BENCH_TLS_HEADER_LEN bytes, the op, 3
+ * bytes of 0, the length and the record size, both 4 bytes big endian:
+ *   'U'  the client writes length bytes, the server answers one byte once it read them all
+ *   'D'  the server writes length bytes, in records of the size asked for
+ * DTLS, each record the client writes comes back as it is.
+ */
+
+#include <stdint.h>
+
+#define BENCH_TLS_HEADER_LEN        (12)
+
+typedef enum {
+    BENCH_TLS_FULL = 0,             /* resumption refused, every handshake is a full one */
+    BENCH_TLS_SESSION_ID,           /* resumed from the session cache of the server */
+    BENCH_TLS_TICKET,               /* resumed from a ticket, the server keeps no state */
+    BENCH_DTLS_FULL,
+    BENCH_DTLS_RESUME,              /* by ticket or session id, whichever the client offers */
+    BENCH_TLS_LISTENERS
+} bench_tls_listener_t;
+
+/* a new key of key_bits and a certificate of it, then the listeners, ciphers as OpenSSL lists them */
+int         bench_tls_server_start(int key_bits, const char *ciphers);
+void        bench_tls_server_stop(void);
+/* the PEM of the certificate, NUL terminated */
+const char *bench_tls_server_ca(void);
+uint16_t    bench_tls_server_port(bench_tls_listener_t listener);
+/* handshakes the listener completed, and those of them that resumed a session, since the start, a DTLS
+ * one counts them once the session ended */
+void        bench_tls_server_counts(bench_tls_listener_t listener, int *handshakes, int *resumed);
+
+#endif  /* _BENCH_TLS_SERVER_H_ */
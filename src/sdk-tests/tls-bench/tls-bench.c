@@ -0,0 +1,604 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * The handshakes and records of the HAL_SSL_* backend linked in, and of HAL_DTLSSession_* with
+ * COAP_DTLS_SUPPORT, with the loopback server of bench_tls_server.c, for each RSA key size and
+ * cipher suite the bundled mbedtls configuration has.
+ * Usage: tls-bench [handshake|bulk|dtls|parse|all] [count]
+ *
+ * MODE 'full' is a handshake with a server refusing resumption, 'id', 'ticket' and 'resume' resume
+ * a session from the session cache of the server or from a ticket, the first handshake aside. The
+ * configuration of a CA is parsed by the first connection with it and freed with the last one, so
+ * connections one after another each parse it, CFG 'parse', unless another one holds it, CFG
+ * 'held'. RSA keys under 2048 bits fail the default profile of mbedtls. WALLms is what
+ * HAL_SSL_Establish() took, the server's share too, CPUms what the calling thread spent in it, what
+ * a device spends. PEAKKB is the most the backend allocated at once during it over what was
+ * allocated before, KEPTKB what it still holds once established. The allocator is counted by way of
+ * mbedtls_platform_set_calloc_free(), whichever the backend installs, the SSL pool too.
+ * PARSEus and INFOus are the two steps of _ssl_parse_crt() when a configuration is created, the CA
+ * parsed, then its info formatted and cut in lines, the printing of them aside.
+ * The sdk's own lines go to stderr, 2>/dev/null to read the report alone.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "iot_import.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+#ifdef COAP_DTLS_SUPPORT
+#include "iot_import_dtls.h"
+#endif
+#include "bench_tls_server.h"
+
+#define BENCH_COUNT_DEFAULT         (20)
+#define BENCH_BULK_BYTES            (4 * 1024 * 1024)
+#define BENCH_BULK_KEY_BITS         (2048)
+#define BENCH_ECHOES                (500)
+#define BENCH_TIMEOUT_MS            (5000)
+#define BENCH_RECORD_MAX            (16384)
+
+static const int bench_key_bits[] = { 2048, 3072, 4096 };
+/* of what the bundled config enables, TLS_RSA_WITH_AES_*_CBC_*, no GCM and no ECC there */
+static const char *bench_suites[] = { "AES128-SHA", "AES128-SHA256", "AES256-SHA256" };
+static const int bench_records[] = { 256, 1024, 4096, 16384 };
+#ifdef COAP_DTLS_SUPPORT
+static const int bench_echoes[] = { 64, 256, 1024 };
+static char bench_host[] = "127.0.0.1";
+#endif
+
+typedef struct {
+    int                 done;
+    int                 failed;
+    uint64_t            wall_us;            /* sums of the handshakes done */
+    uint64_t            cpu_us;
+    uint32_t            wall_max_us;
+    size_t              peak;               /* the most of them */
+    size_t              kept;
+} bench_hs_t;
+
+/* 'what' of the argument, the others skip the server */
+static const char *bench_what;
+static int bench_count;
+static unsigned char bench_buf[BENCH_RECORD_MAX];
+
+/* mbedtls allocations, on the thread of the bench only, the server is OpenSSL */
+typedef union {
+    struct {
+        size_t          size;
+        void (*free_func)(void *);
+    } h;
+    long double         align;
+} bench_heap_hdr_t;
+
+static void *(*bench_heap_calloc_inner)(size_t, size_t) = calloc;
+static void (*bench_heap_free_inner)(void *) = free;
+static size_t bench_heap_in_use;
+static size_t bench_heap_peak;
+
+int __real_mbedtls_platform_set_calloc_free(void *(*calloc_func)(size_t, size_t), void (*free_func)(void *));
+void __real_HAL_Printf(const char *fmt, ...);
+
+static void *bench_heap_calloc(size_t n, size_t size)
+{
+    bench_heap_hdr_t *hdr;
+
+    if (0 != size && n > (((size_t) - 1) - sizeof(bench_heap_hdr_t)) / size) {
+        return NULL;
+    }
+    if (NULL == (hdr = bench_heap_calloc_inner(1, sizeof(bench_heap_hdr_t) + n * size))) {
+        return NULL;
+    }
+
+    /* freed by the allocator it came from, the backend may install another since */
+    hdr->h.size = n * size;
+    hdr->h.free_func = bench_heap_free_inner;
+    bench_heap_in_use += n * size;
+    if (bench_heap_in_use > bench_heap_peak) {
+        bench_heap_peak = bench_heap_in_use;
+    }
+    return hdr + 1;
+}
+
+static void bench_heap_free(void *ptr)
+{
+    bench_heap_hdr_t *hdr;
+
+    if (NULL == ptr) {
+        return;
+    }
+
+    hdr = (bench_heap_hdr_t *)ptr - 1;
+    bench_heap_in_use -= hdr->h.size;
+    hdr->h.free_func(hdr);
+}
+
+int __wrap_mbedtls_platform_set_calloc_free(void *(*calloc_func)(size_t, size_t), void (*free_func)(void *))
+{
+    bench_heap_calloc_inner = calloc_func;
+    bench_heap_free_inner = free_func;
+    return __real_mbedtls_platform_set_calloc_free(bench_heap_calloc, bench_heap_free);
+}
+
+void __wrap_HAL_Printf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+static uint64_t bench_cpu_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void bench_hs_add(bench_hs_t *hs, uint64_t wall_us, uint64_t cpu_us, size_t peak, size_t kept)
+{
+    hs->done++;
+    hs->wall_us += wall_us;
+    hs->cpu_us += cpu_us;
+    if (wall_us > hs->wall_max_us) {
+        hs->wall_max_us = (uint32_t)wall_us;
+    }
+    if (peak > hs->peak) {
+        hs->peak = peak;
+    }
+    if (kept > hs->kept) {
+        hs->kept = kept;
+    }
+}
+
+static void bench_hs_print(int key_bits, const char *suite, const char *mode, const char *cfg,
+                           const bench_hs_t *hs, int resumed)
+{
+    __real_HAL_Printf("%-5d %-14s %-7s %-6s %4d %4d %8.2f %8.2f %8.2f %7.1f %7.1f %5d\n",
+                      key_bits, suite, mode, cfg, hs->done, hs->failed,
+                      hs->done ? hs->wall_us / 1000.0 / hs->done : 0.0, hs->wall_max_us / 1000.0,
+                      hs->done ? hs->cpu_us / 1000.0 / hs->done : 0.0,
+                      hs->peak / 1024.0, hs->kept / 1024.0, resumed);
+}
+
+static uintptr_t bench_tls_connect(bench_tls_listener_t listener, bench_hs_t *hs)
+{
+    const char *ca = bench_tls_server_ca();
+    size_t base = bench_heap_in_use;
+    uint64_t wall_us, cpu_us;
+    uintptr_t handle;
+
+    bench_heap_peak = base;
+    wall_us = HAL_UptimeUs();
+    cpu_us = bench_cpu_us();
+    handle = HAL_SSL_Establish("127.0.0.1", bench_tls_server_port(listener), ca, strlen(ca) + 1);
+    cpu_us = bench_cpu_us() - cpu_us;
+    wall_us = HAL_UptimeUs() - wall_us;
+
+    if (0 == handle) {
+        if (NULL != hs) {
+            hs->failed++;
+        }
+        return 0;
+    }
+    if (NULL != hs) {
+        bench_hs_add(hs, wall_us, cpu_us, bench_heap_peak - base, bench_heap_in_use - base);
+    }
+    return handle;
+}
+
+/*
+ * the server counts a handshake once SSL_accept() returned, its session cached by then, a DTLS one
+ * once the session ended, the next handshake waits for that, the resumed ones returned
+ */
+static int bench_tls_settle(bench_tls_listener_t listener, int handshakes)
+{
+    int done, resumed, i;
+
+    for (i = 0; i < 1000; i++) {
+        bench_tls_server_counts(listener, &done, &resumed);
+        if (done >= handshakes) {
+            break;
+        }
+        HAL_SleepMs(1);
+    }
+
+    return resumed;
+}
+
+/* count handshakes with the listener, after one not counted, which the others resume from */
+static void bench_tls_handshakes(int key_bits, const char *suite, bench_tls_listener_t listener,
+                                 const char *mode, int held)
+{
+    bench_hs_t hs;
+    uintptr_t keeper = 0, handle;
+    int handshakes, resumed, i;
+
+    memset(&hs, 0, sizeof(hs));
+    bench_tls_server_counts(listener, &handshakes, &resumed);
+    if (held && 0 == (keeper = bench_tls_connect(BENCH_TLS_FULL, NULL))) {
+        __real_HAL_Printf("%-5d %-14s %-7s no connection holding the configuration\n", key_bits, suite, mode);
+        return;
+    }
+    handshakes += BENCH_TLS_FULL == listener ? held : 0;
+    if (BENCH_TLS_FULL != listener && 0 != (handle = bench_tls_connect(listener, NULL))) {
+        HAL_SSL_Destroy(handle);
+        handshakes++;
+    }
+    resumed = bench_tls_settle(listener, handshakes);
+
+    for (i = 0; i < bench_count; i++) {
+        if (0 != (handle = bench_tls_connect(listener, &hs))) {
+            HAL_SSL_Destroy(handle);
+        }
+        bench_tls_settle(listener, handshakes + hs.done);
+    }
+    resumed = bench_tls_settle(listener, handshakes + hs.done) - resumed;
+
+    if (0 != keeper) {
+        HAL_SSL_Destroy(keeper);
+    }
+    bench_hs_print(key_bits, suite, mode, held ? "held" : "parse", &hs, resumed);
+}
+
+static void bench_handshake(int key_bits, const char *suite)
+{
+    bench_tls_handshakes(key_bits, suite, BENCH_TLS_FULL, "full", 0);
+    bench_tls_handshakes(key_bits, suite, BENCH_TLS_FULL, "full", 1);
+    bench_tls_handshakes(key_bits, suite, BENCH_TLS_SESSION_ID, "id", 0);
+    bench_tls_handshakes(key_bits, suite, BENCH_TLS_SESSION_ID, "id", 1);
+    bench_tls_handshakes(key_bits, suite, BENCH_TLS_TICKET, "ticket", 0);
+    bench_tls_handshakes(key_bits, suite, BENCH_TLS_TICKET, "ticket", 1);
+}
+
+static int bench_tls_header(uintptr_t handle, char op, uint32_t len, uint32_t record)
+{
+    unsigned char header[BENCH_TLS_HEADER_LEN] = { 0 };
+    int i;
+
+    header[0] = op;
+    for (i = 0; i < 4; i++) {
+        header[4 + i] = (unsigned char)(len >> (24 - 8 * i));
+        header[8 + i] = (unsigned char)(record >> (24 - 8 * i));
+    }
+
+    return HAL_SSL_Write(handle, (const char *)header, sizeof(header), BENCH_TIMEOUT_MS) ==
+           (int)sizeof(header) ? 0 : -1;
+}
+
+/* MB/s of the wall clock, and of the CPU time the thread spent, what a device would reach */
+static void bench_bulk_one(uintptr_t handle, const char *suite, int record)
+{
+    uint64_t wall_us[2], cpu_us[2];
+    uint32_t left;
+    int dir, n, ret = 0;
+    char ack;
+
+    for (dir = 0; dir < 2; dir++) {
+        wall_us[dir] = HAL_UptimeUs();
+        cpu_us[dir] = bench_cpu_us();
+        if (0 != bench_tls_header(handle, dir ? 'D' : 'U', BENCH_BULK_BYTES, record)) {
+            ret = -1;
+        }
+        for (left = BENCH_BULK_BYTES; 0 == ret && left > 0;) {
+            if (dir) {
+                n = HAL_SSL_Read(handle, (char *)bench_buf, left < sizeof(bench_buf) ? left : sizeof(bench_buf),
+                                 BENCH_TIMEOUT_MS);
+            } else {
+                n = HAL_SSL_Write(handle, (const char *)bench_buf, left < (uint32_t)record ? left : record,
+                                  BENCH_TIMEOUT_MS);
+            }
+            if (n > 0) {
+                left -= n;
+            } else {
+                ret = -1;
+            }
+        }
+        if (0 == dir && 0 == ret && 1 != HAL_SSL_Read(handle, &ack, 1, BENCH_TIMEOUT_MS)) {
+            ret = -1;
+        }
+        if (ret < 0) {
+            __real_HAL_Printf("%-14s %6d %s failed\n", suite, record, dir ? "download" : "upload");
+            return;
+        }
+        cpu_us[dir] = bench_cpu_us() - cpu_us[dir];
+        wall_us[dir] = HAL_UptimeUs() - wall_us[dir];
+    }
+
+    __real_HAL_Printf("%-14s %6d %9.2f %9.2f %9.2f %9.2f\n", suite, record,
+                      BENCH_BULK_BYTES / (wall_us[0] + 1.0), BENCH_BULK_BYTES / (cpu_us[0] + 1.0),
+                      BENCH_BULK_BYTES / (wall_us[1] + 1.0), BENCH_BULK_BYTES / (cpu_us[1] + 1.0));
+}
+
+static void bench_bulk(int key_bits, const char *suite)
+{
+    uintptr_t handle;
+    int i;
+
+    if (0 == (handle = bench_tls_connect(BENCH_TLS_TICKET, NULL))) {
+        __real_HAL_Printf("%-14s no connection\n", suite);
+        return;
+    }
+    for (i = 0; i < (int)(sizeof(bench_records) / sizeof(bench_records[0])); i++) {
+        bench_bulk_one(handle, suite, bench_records[i]);
+    }
+    HAL_SSL_Destroy(handle);
+}
+
+#ifdef COAP_DTLS_SUPPORT
+static DTLSContext *bench_dtls_connect(bench_tls_listener_t listener, bench_hs_t *hs)
+{
+    coap_dtls_options_t options;
+    size_t base = bench_heap_in_use;
+    uint64_t wall_us, cpu_us;
+    DTLSContext *ctx;
+
+    memset(&options, 0, sizeof(options));
+    options.p_ca_cert_pem = (unsigned char *)bench_tls_server_ca();
+    options.p_host = bench_host;
+    options.port = bench_tls_server_port(listener);
+
+    bench_heap_peak = base;
+    wall_us = HAL_UptimeUs();
+    cpu_us = bench_cpu_us();
+    ctx = HAL_DTLSSession_create(&options);
+    cpu_us = bench_cpu_us() - cpu_us;
+    wall_us = HAL_UptimeUs() - wall_us;
+
+    if (NULL == ctx) {
+        if (NULL != hs) {
+            hs->failed++;
+        }
+        return NULL;
+    }
+    if (NULL != hs) {
+        bench_hs_add(hs, wall_us, cpu_us, bench_heap_peak - base, bench_heap_in_use - base);
+    }
+    return ctx;
+}
+
+static void bench_dtls_handshakes(int key_bits, const char *suite, bench_tls_listener_t listener, const char *mode)
+{
+    DTLSContext *ctx;
+    bench_hs_t hs;
+    int handshakes, resumed, i;
+
+    memset(&hs, 0, sizeof(hs));
+    bench_tls_server_counts(listener, &handshakes, &resumed);
+    if (BENCH_DTLS_FULL != listener && NULL != (ctx = bench_dtls_connect(listener, NULL))) {
+        HAL_DTLSSession_free(ctx);
+        handshakes++;
+    }
+    resumed = bench_tls_settle(listener, handshakes);
+
+    for (i = 0; i < bench_count; i++) {
+        if (NULL != (ctx = bench_dtls_connect(listener, &hs))) {
+            HAL_DTLSSession_free(ctx);
+        }
+        bench_tls_settle(listener, handshakes + hs.done);
+    }
+    resumed = bench_tls_settle(listener, handshakes + hs.done) - resumed;
+
+    bench_hs_print(key_bits, suite, mode, "parse", &hs, resumed);
+}
+
+/* round trips of a record each, those the server did not send back in time are lost */
+static void bench_dtls_echo(const char *suite, int len)
+{
+    DTLSContext *ctx;
+    uint64_t wall_us, cpu_us;
+    unsigned int n;
+    int handshakes, resumed, echoed = 0, i;
+
+    bench_tls_server_counts(BENCH_DTLS_RESUME, &handshakes, &resumed);
+    if (NULL == (ctx = bench_dtls_connect(BENCH_DTLS_RESUME, NULL))) {
+        __real_HAL_Printf("%-14s %6d no session\n", suite, len);
+        return;
+    }
+
+    wall_us = HAL_UptimeUs();
+    cpu_us = bench_cpu_us();
+    for (i = 0; i < BENCH_ECHOES; i++) {
+        n = len;
+        if (DTLS_SUCCESS != HAL_DTLSSession_write(ctx, bench_buf, &n) || n != (unsigned int)len) {
+            break;
+        }
+        n = sizeof(bench_buf);
+        if (DTLS_SUCCESS == HAL_DTLSSession_read(ctx, bench_buf, &n, 1000) && n == (unsigned int)len) {
+            echoed++;
+        }
+    }
+    cpu_us = bench_cpu_us() - cpu_us;
+    wall_us = HAL_UptimeUs() - wall_us;
+    HAL_DTLSSession_free(ctx);
+    bench_tls_settle(BENCH_DTLS_RESUME, handshakes + 1);
+
+    __real_HAL_Printf("%-14s %6d %6d %6d %9.0f %9.1f %9.1f\n", suite, len, BENCH_ECHOES, BENCH_ECHOES - echoed,
+                      echoed * 1000000.0 / (wall_us + 1), echoed * 1000000.0 / (wall_us + 1) * len * 2 / 1024,
+                      cpu_us / 1.0 / (echoed ? echoed : 1));
+}
+#endif
+
+/* _ssl_parse_crt() but the printing, on the CA as HAL_SSL_Establish() takes it */
+static int bench_crt_info(mbedtls_x509_crt *crt)
+{
+    char buf[1024];
+    char str[512];
+    const char *start, *cur;
+    size_t len;
+    int lines = 0;
+
+    for (; NULL != crt; crt = crt->next) {
+        mbedtls_x509_crt_info(buf, sizeof(buf) - 1, "", crt);
+        start = buf;
+        for (cur = buf; *cur != '\0'; cur++) {
+            if (*cur == '\n') {
+                len = cur - start + 1;
+                len = len > 511 ? 511 : len;
+                memcpy(str, start, len);
+                str[len] = '\0';
+                start = cur + 1;
+                lines++;
+            }
+        }
+    }
+
+    return lines;
+}
+
+static void bench_parse(int key_bits)
+{
+    const char *ca = bench_tls_server_ca();
+    mbedtls_x509_crt crt;
+    uint64_t parse_us = 0, info_us = 0, at;
+    size_t base, peak = 0;
+    int times = bench_count * 10, lines = 0, i;
+
+    for (i = 0; i < times; i++) {
+        base = bench_heap_peak = bench_heap_in_use;
+        mbedtls_x509_crt_init(&crt);
+        at = HAL_UptimeUs();
+        if (0 != mbedtls_x509_crt_parse(&crt, (const unsigned char *)ca, strlen(ca) + 1)) {
+            mbedtls_x509_crt_free(&crt);
+            __real_HAL_Printf("%-5d CA not parsed\n", key_bits);
+            return;
+        }
+        parse_us += HAL_UptimeUs() - at;
+        at = HAL_UptimeUs();
+        lines = bench_crt_info(&crt);
+        info_us += HAL_UptimeUs() - at;
+        peak = bench_heap_peak - base > peak ? bench_heap_peak - base : peak;
+        mbedtls_x509_crt_free(&crt);
+    }
+
+    __real_HAL_Printf("%-5d %7d %8.1f %8.1f %6d %7.1f\n", key_bits, (int)strlen(ca),
+                      parse_us / 1.0 / times, info_us / 1.0 / times, lines, peak / 1024.0);
+}
+
+static int bench_wants(const char *what)
+{
+    return 0 == strcmp(bench_what, "all") || 0 == strcmp(bench_what, what);
+}
+
+int main(int argc, char *argv[])
+{
+    int bits, suite;
+#ifdef COAP_DTLS_SUPPORT
+    int i;
+#endif
+
+    bench_what = argc > 1 ? argv[1] : "all";
+    bench_count = argc > 2 ? atoi(argv[2]) : BENCH_COUNT_DEFAULT;
+    if (bench_count <= 0 || (!bench_wants("handshake") && !bench_wants("bulk") && !bench_wants("dtls") &&
+                             !bench_wants("parse"))) {
+        __real_HAL_Printf("usage: %s [handshake|bulk|dtls|parse|all] [count]\n", argv[0]);
+        return 1;
+    }
+
+    /* counted from the first allocation on */
+    mbedtls_platform_set_calloc_free(calloc, free);
+    __real_HAL_Printf("records of %d bytes at most, %d handshakes per row\n", MBEDTLS_SSL_MAX_CONTENT_LEN, bench_count);
+
+    if (bench_wants("handshake")) {
+        __real_HAL_Printf("\nTLS handshakes\n%-5s %-14s %-7s %-6s %4s %4s %8s %8s %8s %7s %7s %5s\n",
+                          "KEY", "SUITE", "MODE", "CFG", "DONE", "FAIL", "WALLms", "MAXms", "CPUms",
+                          "PEAKKB", "KEPTKB", "RESUM");
+        for (bits = 0; bits < (int)(sizeof(bench_key_bits) / sizeof(bench_key_bits[0])); bits++) {
+            for (suite = 0; suite < (int)(sizeof(bench_suites) / sizeof(bench_suites[0])); suite++) {
+                if (0 != bench_tls_server_start(bench_key_bits[bits], bench_suites[suite])) {
+                    __real_HAL_Printf("%-5d %-14s server not started\n", bench_key_bits[bits], bench_suites[suite]);
+                    continue;
+                }
+                bench_handshake(bench_key_bits[bits], bench_suites[suite]);
+                bench_tls_server_stop();
+            }
+        }
+    }
+
+    if (bench_wants("bulk")) {
+        __real_HAL_Printf("\nTLS records, %d KB each way, MB/s of the wall clock and of the CPU time\n"
+                          "%-14s %6s %9s %9s %9s %9s\n", BENCH_BULK_BYTES / 1024,
+                          "SUITE", "RECORD", "UP", "UPCPU", "DOWN", "DOWNCPU");
+        for (suite = 0; suite < (int)(sizeof(bench_suites) / sizeof(bench_suites[0])); suite++) {
+            if (0 != bench_tls_server_start(BENCH_BULK_KEY_BITS, bench_suites[suite])) {
+                __real_HAL_Printf("%-14s server not started\n", bench_suites[suite]);
+                continue;
+            }
+            bench_bulk(BENCH_BULK_KEY_BITS, bench_suites[suite]);
+            bench_tls_server_stop();
+        }
+    }
+
+#ifdef COAP_DTLS_SUPPORT
+    if (bench_wants("dtls")) {
+        __real_HAL_Printf("\nDTLS handshakes\n%-5s %-14s %-7s %-6s %4s %4s %8s %8s %8s %7s %7s %5s\n",
+                          "KEY", "SUITE", "MODE", "CFG", "DONE", "FAIL", "WALLms", "MAXms", "CPUms",
+                          "PEAKKB", "KEPTKB", "RESUM");
+        for (bits = 0; bits < (int)(sizeof(bench_key_bits) / sizeof(bench_key_bits[0])); bits++) {
+            for (suite = 0; suite < (int)(sizeof(bench_suites) / sizeof(bench_suites[0])); suite++) {
+                if (0 != bench_tls_server_start(bench_key_bits[bits], bench_suites[suite])) {
+                    __real_HAL_Printf("%-5d %-14s server not started\n", bench_key_bits[bits], bench_suites[suite]);
+                    continue;
+                }
+                bench_dtls_handshakes(bench_key_bits[bits], bench_suites[suite], BENCH_DTLS_FULL, "full");
+                bench_dtls_handshakes(bench_key_bits[bits], bench_suites[suite], BENCH_DTLS_RESUME, "resume");
+                bench_tls_server_stop();
+            }
+        }
+
+        __real_HAL_Printf("\nDTLS records, %d round trips of a record each\n%-14s %6s %6s %6s %9s %9s %9s\n",
+                          BENCH_ECHOES, "SUITE", "RECORD", "SENT", "LOST", "RTT/s", "KB/s", "CPUus");
+        for (suite = 0; suite < (int)(sizeof(bench_suites) / sizeof(bench_suites[0])); suite++) {
+            if (0 != bench_tls_server_start(BENCH_BULK_KEY_BITS, bench_suites[suite])) {
+                __real_HAL_Printf("%-14s server not started\n", bench_suites[suite]);
+                continue;
+            }
+            for (i = 0; i < (int)(sizeof(bench_echoes) / sizeof(bench_echoes[0])); i++) {
+                bench_dtls_echo(bench_suites[suite], bench_echoes[i]);
+            }
+            bench_tls_server_stop();
+        }
+    }
+#else
+    if (0 == strcmp(bench_what, "dtls")) {
+        __real_HAL_Printf("built without COAP_DTLS_SUPPORT\n");
+    }
+#endif
+
+    if (bench_wants("parse")) {
+        __real_HAL_Printf("\n_ssl_parse_crt() of a self-signed CA, %d times\n%-5s %7s %8s %8s %6s %7s\n",
+                          bench_count * 10, "KEY", "PEMLEN", "PARSEus", "INFOus", "LINES", "PEAKKB");
+        for (bits = 0; bits < (int)(sizeof(bench_key_bits) / sizeof(bench_key_bits[0])); bits++) {
+            if (0 != bench_tls_server_start(bench_key_bits[bits], bench_suites[0])) {
+                __real_HAL_Printf("%-5d server not started\n", bench_key_bits[bits]);
+                continue;
+            }
+            bench_parse(bench_key_bits[bits]);
+            bench_tls_server_stop();
+        }
+    }
+
+    return 0;
+}
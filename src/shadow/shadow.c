@@ -177,7 +177,8 @@ int IOT_Shadow_Push_Async(
 
     LITE_ASSERT(NULL != ptoken);
 
-    pelement = iotx_shadow_update_wait_ack_list_add(pshadow, ptoken, strlen(ptoken), cb_fpt, pcontext, timeout_s);
+    pelement = iotx_shadow_update_wait_ack_list_add(pshadow, ptoken, strlen(ptoken), cb_fpt, pcontext,
+               timeout_s * 1000);
     if (NULL == pelement) {
         LITE_free(ptoken);
         return ERROR_SHADOW_WAIT_LIST_OVERFLOW;
@@ -253,6 +254,40 @@ iotx_err_t IOT_Shadow_Push(
 }
 
 
+iotx_err_t IOT_Shadow_Push_Changed(void *handle, iotx_shadow_attr_pt pattr)
+{
+    if ((NULL == handle) || (NULL == pattr)) {
+        return NULL_VALUE_ERROR;
+    }
+
+    return iotx_ds_update_push_changed((iotx_shadow_pt)handle, pattr);
+}
+
+
+iotx_err_t IOT_Shadow_Push_Config(
+            void *handle,
+            uint32_t window_ms,
+            uint16_t timeout_s,
+            iotx_push_cb_fpt cb_fpt,
+            void *pcontext)
+{
+    iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
+
+    if (NULL == pshadow) {
+        return NULL_VALUE_ERROR;
+    }
+
+    HAL_MutexLock(pshadow->mutex);
+    pshadow->inner_data.push.window_ms = window_ms;
+    pshadow->inner_data.push.timeout_s = timeout_s;
+    pshadow->inner_data.push.callback = cb_fpt;
+    pshadow->inner_data.push.pcontext = pcontext;
+    HAL_MutexUnlock(pshadow->mutex);
+
+    return SUCCESS_RETURN;
+}
+
+
 iotx_err_t IOT_Shadow_Pull(void *handle)
 {
 #define SHADOW_SYNC_MSG_SIZE      (256)
@@ -260,17 +295,29 @@ iotx_err_t IOT_Shadow_Pull(void *handle)
     iotx_err_t ret;
     void *buf;
     format_data_t format;
+    char since[sizeof("\"sinceVersion\":") + 10];
+    uint32_t applied;
     iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
 
     log_info("Device Shadow sync start.");
 
+    HAL_MutexLock(pshadow->mutex);
+    applied = pshadow->inner_data.applied_version;
+    HAL_MutexUnlock(pshadow->mutex);
+
+    /* only what changed since the version applied is asked, a reply of it is not applied again */
+    if (0 != applied) {
+        ret = HAL_Snprintf(since, sizeof(since), "\"sinceVersion\":%u", (unsigned int)applied);
+        CHECK_SNPRINTF_RET(ret, sizeof(since));
+    }
+
     buf = LITE_malloc(SHADOW_SYNC_MSG_SIZE);
     if (NULL == buf) {
         log_err("Device Shadow sync failed");
         return ERROR_NO_MEM;
     }
 
-    iotx_ds_common_format_init(pshadow, &format, buf, SHADOW_SYNC_MSG_SIZE, "get", NULL);
+    iotx_ds_common_format_init(pshadow, &format, buf, SHADOW_SYNC_MSG_SIZE, "get", 0 != applied ? since : NULL);
     iotx_ds_common_format_finalize(pshadow, &format, NULL);
 
     ret = IOT_Shadow_Push(pshadow, format.buf, format.offset, 10);
@@ -342,6 +389,9 @@ void *IOT_Shadow_Construct(iotx_shadow_para_pt pparams)
         return NULL;
     }
     memset(pshadow, 0x0, sizeof(iotx_shadow_t));
+    pshadow->inner_data.push.window_ms = IOTX_DS_PUSH_WINDOW_MS;
+    pshadow->inner_data.push.timeout_s = IOTX_DS_PUSH_TIMEOUT_S;
+    utils_timer_wheel_init(&pshadow->inner_data.update_ack_wheel, IOTX_DS_UPDATE_WAIT_ACK_TICK_MS, HAL_UptimeMs());
 
     if (NULL == (pshadow->mutex = HAL_MutexCreate())) {
         log_err("create mutex failed");
@@ -400,6 +450,24 @@ void IOT_Shadow_Yield(void *handle, uint32_t timeout)
     iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
     IOT_MQTT_Yield(pshadow->mqtt, timeout);
     iotx_ds_handle_expire(pshadow);
+    iotx_ds_update_push_handle(pshadow);
+    iotx_ds_common_sync_time(pshadow);
+}
+
+
+uint32_t IOT_Shadow_GetTimeout(void *handle)
+{
+    iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
+    uint32_t timeout, mqtt;
+
+    if (NULL == pshadow) {
+        return 0;
+    }
+
+    timeout = iotx_ds_update_next_timeout(pshadow);
+    mqtt = IOT_MQTT_GetTimeout(pshadow->mqtt);
+
+    return (mqtt < timeout) ? mqtt : timeout;
 }
 
 
@@ -427,6 +495,8 @@ iotx_err_t IOT_Shadow_Destroy(void *handle)
     if (NULL != pshadow->inner_data.attr_list) {
         list_destroy(pshadow->inner_data.attr_list);
     }
+    iotx_ds_common_release_attr_index(pshadow);
+    iotx_ds_common_doc_release(&pshadow->inner_data.push_doc);
 
     if (NULL != pshadow->mutex) {
         HAL_MutexDestroy(pshadow->mutex);
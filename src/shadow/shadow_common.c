@@ -21,8 +21,10 @@
 #include "iot_import.h"
 #include "lite-log.h"
 #include "lite-utils.h"
+#include "lite-number.h"
 #include "utils_timer.h"
 #include "utils_list.h"
+#include "utils_epoch_time.h"
 #include "lite-system.h"
 
 #include "shadow.h"
@@ -37,17 +39,37 @@
     }while(0);
 
 
-/* check return code of HAL_Snprintf */
-#define CHECK_SNPRINTF_RET(ret_code, buf_len) \
+/* check return code of iotx_ds_common_put_text() */
+#define CHECK_PUT_TEXT_RET(ret_code) \
     do{ \
         if ((ret_code) < 0) { \
-            return FAIL_RETURN; \
-        } else if ((ret_code) >= (buf_len)) { \
             return ERROR_NO_ENOUGH_MEM; \
         } \
     }while(0);
 
 
+/* a json value of the text without going through HAL_Snprintf(), quoted when asked to */
+static int iotx_ds_common_put_text(char *buf, size_t buf_len, const char *text, int text_len, int quoted)
+{
+    int len = text_len + (quoted ? 2 : 0);
+
+    if (len >= buf_len) {
+        return -1;
+    }
+
+    if (quoted) {
+        buf[0] = '"';
+        memcpy(buf + 1, text, text_len);
+        buf[len - 1] = '"';
+    } else {
+        memcpy(buf, text, text_len);
+    }
+    buf[len] = '\0';
+
+    return len;
+}
+
+
 /* return handle of format data. */
 iotx_err_t iotx_ds_common_format_init(iotx_shadow_pt pshadow,
                                       format_data_pt pformat,
@@ -57,7 +79,6 @@ iotx_err_t iotx_ds_common_format_init(iotx_shadow_pt pshadow,
                                       const char *head_str)
 {
     int ret;
-    uint32_t size_free_space;
     memset(pformat, 0, sizeof(format_data_t));
 
     pformat->buf = buf;
@@ -67,26 +88,23 @@ iotx_err_t iotx_ds_common_format_init(iotx_shadow_pt pshadow,
         return ERROR_SHADOW_NO_METHOD;
     }
 
-    size_free_space = pformat->buf_size;
-
-    ret = HAL_Snprintf(pformat->buf,
-                       size_free_space,
-                       "{\"%s\":\"%s\"",
-                       "method",
-                       method);
-
-    CHECK_SNPRINTF_RET(ret, size_free_space);
+    /* {"method":"${method}" */
+    ret = iotx_ds_common_put_text(pformat->buf, pformat->buf_size, "{\"method\":", sizeof("{\"method\":") - 1, 0);
+    CHECK_PUT_TEXT_RET(ret);
     pformat->offset = ret;
-
+    ret = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset,
+                                  method, strlen(method), 1);
+    CHECK_PUT_TEXT_RET(ret);
+    pformat->offset += ret;
 
     /* copy the JOSN head */
-    size_free_space = pformat->buf_size - pformat->offset;
     if (NULL != head_str) {
-        ret = HAL_Snprintf(pformat->buf + pformat->offset,
-                           size_free_space,
-                           ",%s",
-                           head_str);
-        CHECK_SNPRINTF_RET(ret, size_free_space);
+        ret = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset, ",", 1, 0);
+        CHECK_PUT_TEXT_RET(ret);
+        pformat->offset += ret;
+        ret = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset,
+                                      head_str, strlen(head_str), 0);
+        CHECK_PUT_TEXT_RET(ret);
         pformat->offset += ret;
     }
 
@@ -119,17 +137,15 @@ iotx_err_t iotx_ds_common_format_add(iotx_shadow_pt pshadow,
         }
     }
 
-    size_free_space = pformat->buf_size - pformat->offset;
-
-    /* add the string: "${pattr->pattr_name}":" */
-    ret = HAL_Snprintf(pformat->buf + pformat->offset,
-                       size_free_space,
-                       "\"%s\":",
-                       name);
-
-    CHECK_SNPRINTF_RET(ret, size_free_space);
-
+    /* add the string: "${pattr->pattr_name}": */
+    ret = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset,
+                                  name, strlen(name), 1);
+    if (ret < 0 || pformat->offset + ret + 1 >= pformat->buf_size) {
+        return ERROR_NO_ENOUGH_MEM;
+    }
     pformat->offset += ret;
+    pformat->buf[pformat->offset++] = ':';
+
     size_free_space = pformat->buf_size - pformat->offset;
 
     /* convert attribute data to JSON string, and add to buffer */
@@ -147,34 +163,118 @@ iotx_err_t iotx_ds_common_format_add(iotx_shadow_pt pshadow,
 }
 
 
-iotx_err_t iotx_ds_common_format_finalize(iotx_shadow_pt pshadow, format_data_pt pformat, const char *tail_str)
+/* ${token}","version":${version}} after "clientToken":"${device_id}- */
+static iotx_err_t iotx_ds_common_format_token(iotx_shadow_pt pshadow, format_data_pt pformat)
 {
-#define UPDATE_JSON_STR_END         ",\"clientToken\":\"%s-%d\",\"version\":%d}"
+    char temp[LITE_NUMBER_LEN_MAX * 2 + 16];
+    int len;
+
+    len = LITE_format_llong(temp, iotx_ds_common_get_tokennum(pshadow));
+    memcpy(temp + len, "\",\"version\":", sizeof("\",\"version\":") - 1);
+    len += sizeof("\",\"version\":") - 1;
+    len += LITE_format_llong(temp + len, iotx_ds_common_get_version(pshadow));
+    temp[len++] = '}';
+
+    len = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset,
+                                  temp, len, 0);
+    CHECK_PUT_TEXT_RET(len);
+    pformat->offset += len;
+
+    return SUCCESS_RETURN;
+}
 
+
+iotx_err_t iotx_ds_common_format_finalize(iotx_shadow_pt pshadow, format_data_pt pformat, const char *tail_str)
+{
+    const char *device_id = iotx_device_info_get()->device_id;
     int ret;
-    uint16_t size_free_space = pformat->buf_size - pformat->offset;
 
     if (NULL != tail_str) {
-        ret = HAL_Snprintf(pformat->buf + pformat->offset, size_free_space, "%s", tail_str);
-        CHECK_SNPRINTF_RET(ret, size_free_space);
+        ret = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset,
+                                      tail_str, strlen(tail_str), 0);
+        CHECK_PUT_TEXT_RET(ret);
         pformat->offset += ret;
     }
 
-    size_free_space = pformat->buf_size - pformat->offset;
+    /* ,"clientToken":"${device_id}-${token}","version":${version}} */
+    ret = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset,
+                                  ",\"clientToken\":\"", sizeof(",\"clientToken\":\"") - 1, 0);
+    CHECK_PUT_TEXT_RET(ret);
+    pformat->offset += ret;
+    ret = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset,
+                                  device_id, strlen(device_id), 0);
+    if (ret < 0 || pformat->offset + ret + 1 >= pformat->buf_size) {
+        return ERROR_NO_ENOUGH_MEM;
+    }
+    pformat->offset += ret;
+    pformat->buf[pformat->offset++] = '-';
 
-    ret = HAL_Snprintf(pformat->buf + pformat->offset,
-                       size_free_space,
-                       UPDATE_JSON_STR_END,
-                       iotx_device_info_get()->device_id,
-                       iotx_ds_common_get_tokennum(pshadow),
-                       iotx_ds_common_get_version(pshadow));
+    return iotx_ds_common_format_token(pshadow, pformat);
+}
 
-    CHECK_SNPRINTF_RET(ret, size_free_space);
-    pformat->offset += ret;
+
+#define IOTX_DS_DOC_TAIL_HEAD       "}},\"clientToken\":\""
+
+iotx_err_t iotx_ds_common_doc_begin(iotx_shadow_pt pshadow, iotx_shadow_doc_t *doc, format_data_pt pformat)
+{
+    format_data_t format;
+    const char *device_id = iotx_device_info_get()->device_id;
+    int ret;
+
+    if (NULL == doc->buf) {
+        doc->buf = LITE_malloc(IOTX_DS_PUSH_BUF_LEN);
+        doc->tail_len = sizeof(IOTX_DS_DOC_TAIL_HEAD) - 1 + strlen(device_id) + 1;
+        doc->tail = LITE_malloc(doc->tail_len + 1);
+        if (NULL == doc->buf || NULL == doc->tail) {
+            iotx_ds_common_doc_release(doc);
+            return ERROR_NO_MEM;
+        }
+
+        ret = iotx_ds_common_format_init(pshadow, &format, doc->buf, IOTX_DS_PUSH_BUF_LEN, "update",
+                                         "\"state\":{\"reported\":{");
+        if (SUCCESS_RETURN != ret) {
+            iotx_ds_common_doc_release(doc);
+            return ret;
+        }
+        doc->head_len = format.offset;
+
+        memcpy(doc->tail, IOTX_DS_DOC_TAIL_HEAD, sizeof(IOTX_DS_DOC_TAIL_HEAD) - 1);
+        memcpy(doc->tail + sizeof(IOTX_DS_DOC_TAIL_HEAD) - 1, device_id, strlen(device_id));
+        doc->tail[doc->tail_len - 1] = '-';
+        doc->tail[doc->tail_len] = '\0';
+    }
+
+    pformat->buf = doc->buf;
+    pformat->buf_size = IOTX_DS_PUSH_BUF_LEN;
+    pformat->offset = doc->head_len;
+    pformat->flag_new = IOT_TRUE;
 
     return SUCCESS_RETURN;
+}
+
+
+iotx_err_t iotx_ds_common_doc_end(iotx_shadow_pt pshadow, iotx_shadow_doc_t *doc, format_data_pt pformat)
+{
+    int ret;
 
-#undef UPDATE_JSON_STR_END
+    ret = iotx_ds_common_put_text(pformat->buf + pformat->offset, pformat->buf_size - pformat->offset,
+                                  doc->tail, doc->tail_len, 0);
+    CHECK_PUT_TEXT_RET(ret);
+    pformat->offset += ret;
+
+    return iotx_ds_common_format_token(pshadow, pformat);
+}
+
+
+void iotx_ds_common_doc_release(iotx_shadow_doc_t *doc)
+{
+    if (NULL != doc->buf) {
+        LITE_free(doc->buf);
+    }
+    if (NULL != doc->tail) {
+        LITE_free(doc->tail);
+    }
+    memset(doc, 0, sizeof(iotx_shadow_doc_t));
 }
 
 
@@ -184,30 +284,53 @@ int iotx_ds_common_convert_data2string(
             iotx_shadow_attr_datatype_t type,
             const void *pData)
 {
-
-    int ret = -1;
+    char temp[LITE_NUMBER_LEN_MAX];
+    double value;
+    int len;
 
     if ((NULL == buf) || (buf_len == 0)
         || ((IOTX_SHADOW_NULL != type) && (NULL == pData))) {
         return ERROR_NULL_VALUE;
     }
 
-    if (IOTX_SHADOW_INT32 == type) {
-        ret = HAL_Snprintf(buf, buf_len, "%" PRIi32, *(int32_t *)(pData));
-    } else if (IOTX_SHADOW_STRING == type) {
-        ret = HAL_Snprintf(buf, buf_len, "\"%s\"", (char *)(pData));
-    } else if (IOTX_SHADOW_NULL == type) {
-        ret = HAL_Snprintf(buf, buf_len, "%s", "\"null\"");
-    } else {
-        log_err("Error data type");
-        ret = -1;
+    switch (type) {
+        case IOTX_SHADOW_INT32:
+            len = LITE_format_llong(temp, *(int32_t *)(pData));
+            break;
+        case IOTX_SHADOW_INT64:
+            len = LITE_format_llong(temp, *(int64_t *)(pData));
+            break;
+        case IOTX_SHADOW_FLOAT:
+        case IOTX_SHADOW_DOUBLE:
+            value = (IOTX_SHADOW_FLOAT == type) ? *(float *)(pData) : *(double *)(pData);
+            /* json has no nan nor infinity */
+            if (value != value || value - value != 0) {
+                return iotx_ds_common_put_text(buf, buf_len, "null", 4, 0);
+            }
+            len = (IOTX_SHADOW_FLOAT == type) ? LITE_format_float(temp, *(float *)(pData))
+                  : LITE_format_double(temp, value);
+            break;
+        case IOTX_SHADOW_BOOL:
+            return *(int32_t *)(pData) ? iotx_ds_common_put_text(buf, buf_len, "true", 4, 0)
+                   : iotx_ds_common_put_text(buf, buf_len, "false", 5, 0);
+        case IOTX_SHADOW_STRING:
+            return iotx_ds_common_put_text(buf, buf_len, (char *)(pData), strlen((char *)(pData)), 1);
+        case IOTX_SHADOW_JSON:
+            return iotx_ds_common_put_text(buf, buf_len, (char *)(pData), strlen((char *)(pData)), 0);
+        case IOTX_SHADOW_NULL:
+            return iotx_ds_common_put_text(buf, buf_len, "null", 4, 1);
+        default:
+            log_err("Error data type");
+            return -1;
     }
 
-    if ((ret < 0) || (ret >= buf_len)) {
-        return -1;
-    }
+    return iotx_ds_common_put_text(buf, buf_len, temp, len, 0);
+}
 
-    return ret;
+
+static int iotx_ds_common_is_text(const char *buf, size_t buf_len, const char *text)
+{
+    return (buf_len == strlen(text)) && (0 == memcmp(buf, text, buf_len));
 }
 
 
@@ -217,25 +340,39 @@ iotx_err_t iotx_ds_common_convert_string2data(
             iotx_shadow_attr_datatype_t type,
             void *pdata)
 {
+    int flag;
+
     if ((NULL == buf) || (buf_len == 0) || (NULL == pdata)) {
         return ERROR_NULL_VALUE;
     }
 
-    if (type == IOTX_SHADOW_INT32) {
-        if (0 == strcmp(pdata, "true")) {
-            *((int32_t *)pdata) = 1;
-        } else if (0 == strcmp(pdata, "false")) {
-            *((int32_t *)pdata) = 0;
-        } else if (0 == strcmp(pdata, "null")) {
-            *((int32_t *)pdata) = 0;
-        } else {
-            *((int32_t *)pdata) = atoi(buf);
-        }
-    } else if (type == IOTX_SHADOW_STRING) {
-        memcpy(pdata, buf, buf_len);
-    } else {
-        log_err("Error data type");
-        return ERROR_SHADOW_UNDEF_TYPE;
+    /* buf is in the json document, not ended by '\0', the parsers stop at what is not part of a number */
+    flag = iotx_ds_common_is_text(buf, buf_len, "true") ? 1
+           : ((iotx_ds_common_is_text(buf, buf_len, "false") || iotx_ds_common_is_text(buf, buf_len, "null")) ? 0 : -1);
+
+    switch (type) {
+        case IOTX_SHADOW_INT32:
+            *((int32_t *)pdata) = flag >= 0 ? flag : LITE_parse_int(buf, NULL);
+            break;
+        case IOTX_SHADOW_INT64:
+            *((int64_t *)pdata) = flag >= 0 ? flag : LITE_parse_llong(buf, NULL);
+            break;
+        case IOTX_SHADOW_FLOAT:
+            *((float *)pdata) = flag >= 0 ? flag : (float)LITE_parse_double(buf, NULL);
+            break;
+        case IOTX_SHADOW_DOUBLE:
+            *((double *)pdata) = flag >= 0 ? flag : LITE_parse_double(buf, NULL);
+            break;
+        case IOTX_SHADOW_BOOL:
+            *((int32_t *)pdata) = flag >= 0 ? flag : (0 != LITE_parse_double(buf, NULL));
+            break;
+        case IOTX_SHADOW_STRING:
+        case IOTX_SHADOW_JSON:
+            memcpy(pdata, buf, buf_len);
+            break;
+        default:
+            log_err("Error data type");
+            return ERROR_SHADOW_UNDEF_TYPE;
     }
 
     return SUCCESS_RETURN;
@@ -249,21 +386,188 @@ void iotx_ds_common_update_time(iotx_shadow_pt pshadow, uint32_t new_timestamp)
     pshadow->inner_data.time.epoch_time = new_timestamp;
     HAL_MutexUnlock(pshadow->mutex);
 
+    /* whole seconds, only good enough till the ntp response comes */
+    if (0 == utils_epoch_time_now()) {
+        utils_epoch_time_set((uint64_t)new_timestamp * 1000, HAL_UptimeMs());
+    }
+
     log_info("update system time");
 }
 
 
+void iotx_ds_common_sync_time(iotx_shadow_pt pshadow)
+{
+    uint64_t now = HAL_UptimeMs();
+
+    if (!IOT_MQTT_CheckStateNormal(pshadow->mqtt)) {
+        return;
+    }
+    /* the first is sent whatever the clock, it may be set from the seconds of a shadow reply only */
+    if (0 != pshadow->inner_data.ntp_request_ms
+        && (!utils_epoch_time_need_sync() || now - pshadow->inner_data.ntp_request_ms < IOTX_DS_NTP_RETRY_MS)) {
+        return;
+    }
+
+    if (IOT_MQTT_SyncTime(pshadow->mqtt) >= 0) {
+        pshadow->inner_data.ntp_request_ms = now;
+    }
+}
+
+
+static uint32_t iotx_ds_common_attr_hash(const char *name, int name_len)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < name_len; ++i) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+static void iotx_ds_common_index_put(iotx_shadow_attr_index_t *index, const iotx_shadow_attr_slot_t *slot)
+{
+    uint32_t pos = slot->hash & (index->slot_num - 1);
+
+    while (NULL != index->slots[pos].node) {
+        pos = (pos + 1) & (index->slot_num - 1);
+    }
+    index->slots[pos] = *slot;
+}
+
+
+static iotx_err_t iotx_ds_common_index_grow(iotx_shadow_attr_index_t *index)
+{
+    iotx_shadow_attr_slot_t *old_slots = index->slots;
+    uint32_t old_slot_num = index->slot_num;
+    uint32_t i;
+
+    index->slot_num = old_slot_num ? old_slot_num << 1 : 8;
+    index->slots = LITE_malloc(index->slot_num * sizeof(iotx_shadow_attr_slot_t));
+    if (NULL == index->slots) {
+        index->slots = old_slots;
+        index->slot_num = old_slot_num;
+        return ERROR_NO_MEM;
+    }
+    memset(index->slots, 0, index->slot_num * sizeof(iotx_shadow_attr_slot_t));
+
+    for (i = 0; i < old_slot_num; ++i) {
+        if (NULL != old_slots[i].node) {
+            iotx_ds_common_index_put(index, &old_slots[i]);
+        }
+    }
+    if (NULL != old_slots) {
+        LITE_free(old_slots);
+    }
+
+    return SUCCESS_RETURN;
+}
+
+
+/* the slot of pattr, or -1 */
+static int iotx_ds_common_index_find(iotx_shadow_attr_index_t *index, iotx_shadow_attr_pt pattr)
+{
+    uint32_t pos;
+
+    if (0 == index->attr_num) {
+        return -1;
+    }
+
+    pos = iotx_ds_common_attr_hash(pattr->pattr_name, strlen(pattr->pattr_name)) & (index->slot_num - 1);
+    while (NULL != index->slots[pos].node) {
+        if (pattr == index->slots[pos].node->val) {
+            return pos;
+        }
+        pos = (pos + 1) & (index->slot_num - 1);
+    }
+
+    return -1;
+}
+
+
+/* the slots after pos up to an empty one are moved back as far as where they hash to lets them */
+static void iotx_ds_common_index_del(iotx_shadow_attr_index_t *index, uint32_t pos)
+{
+    uint32_t mask = index->slot_num - 1;
+    uint32_t next = (pos + 1) & mask;
+    uint32_t home;
+
+    while (NULL != index->slots[next].node) {
+        home = index->slots[next].hash & mask;
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            index->slots[pos] = index->slots[next];
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
+    memset(&index->slots[pos], 0, sizeof(iotx_shadow_attr_slot_t));
+    --index->attr_num;
+}
+
+
+iotx_shadow_attr_slot_pt iotx_ds_common_lookup_attr(
+            iotx_shadow_pt pshadow,
+            const char *name,
+            int name_len,
+            int *pos)
+{
+    iotx_shadow_attr_index_t *index = &pshadow->inner_data.attr_index;
+    iotx_shadow_attr_slot_pt slot;
+    iotx_shadow_attr_pt pattr;
+    uint32_t hash = iotx_ds_common_attr_hash(name, name_len);
+    uint32_t i;
+
+    if (0 == index->attr_num) {
+        return NULL;
+    }
+
+    i = (*pos < 0) ? (hash & (index->slot_num - 1)) : ((*pos + 1) & (index->slot_num - 1));
+    for (; NULL != index->slots[i].node; i = (i + 1) & (index->slot_num - 1)) {
+        slot = &index->slots[i];
+        pattr = (iotx_shadow_attr_pt)slot->node->val;
+        if (hash == slot->hash && 0 == strncmp(pattr->pattr_name, name, name_len)
+            && '\0' == pattr->pattr_name[name_len]) {
+            *pos = i;
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+
+iotx_shadow_attr_slot_pt iotx_ds_common_find_attr(iotx_shadow_pt pshadow, iotx_shadow_attr_pt pattr)
+{
+    int pos = iotx_ds_common_index_find(&pshadow->inner_data.attr_index, pattr);
+
+    return (pos < 0) ? NULL : &pshadow->inner_data.attr_index.slots[pos];
+}
+
+
+void iotx_ds_common_release_attr_index(iotx_shadow_pt pshadow)
+{
+    if (NULL != pshadow->inner_data.attr_index.slots) {
+        LITE_free(pshadow->inner_data.attr_index.slots);
+    }
+    memset(&pshadow->inner_data.attr_index, 0, sizeof(iotx_shadow_attr_index_t));
+}
+
+
 int iotx_ds_common_check_attr_existence(
             iotx_shadow_pt pshadow,
             iotx_shadow_attr_pt pattr)
 {
-    list_node_t *node;
+    int pos;
 
     HAL_MutexLock(pshadow->mutex);
-    node = list_find(pshadow->inner_data.attr_list, pattr);
+    pos = iotx_ds_common_index_find(&pshadow->inner_data.attr_index, pattr);
     HAL_MutexUnlock(pshadow->mutex);
 
-    return (NULL != node);
+    return (pos >= 0);
 }
 
 
@@ -272,13 +576,28 @@ iotx_err_t iotx_ds_common_register_attr(
             iotx_shadow_pt pshadow,
             iotx_shadow_attr_pt pattr)
 {
+    iotx_shadow_attr_index_t *index = &pshadow->inner_data.attr_index;
+    iotx_shadow_attr_slot_t slot;
     list_node_t *node = list_node_new(pattr);
     if (NULL == node) {
         return ERROR_NO_MEM;
     }
 
     HAL_MutexLock(pshadow->mutex);
+    if ((index->attr_num + 1) * 2 > index->slot_num && SUCCESS_RETURN != iotx_ds_common_index_grow(index)) {
+        HAL_MutexUnlock(pshadow->mutex);
+        LITE_free(node);
+        return ERROR_NO_MEM;
+    }
+
     list_lpush(pshadow->inner_data.attr_list, node);
+
+    slot.node = node;
+    slot.hash = iotx_ds_common_attr_hash(pattr->pattr_name, strlen(pattr->pattr_name));
+    slot.seq = index->seq++;
+    slot.match = 0;
+    iotx_ds_common_index_put(index, &slot);
+    ++index->attr_num;
     HAL_MutexUnlock(pshadow->mutex);
 
     return SUCCESS_RETURN;
@@ -291,15 +610,17 @@ iotx_err_t iotx_ds_common_remove_attr(
             iotx_shadow_attr_pt pattr)
 {
     iotx_err_t rc = SUCCESS_RETURN;
-    list_node_t *node;
+    iotx_shadow_attr_index_t *index = &pshadow->inner_data.attr_index;
+    int pos;
 
     HAL_MutexLock(pshadow->mutex);
-    node = list_find(pshadow->inner_data.attr_list, pattr);
-    if (NULL == node) {
+    pos = iotx_ds_common_index_find(index, pattr);
+    if (pos < 0) {
         rc = ERROR_SHADOW_NO_ATTRIBUTE;
         log_err("Try to remove a non-existent attribute.");
     } else {
-        list_remove(pshadow->inner_data.attr_list, node);
+        list_remove(pshadow->inner_data.attr_list, index->slots[pos].node);
+        iotx_ds_common_index_del(index, pos);
     }
     HAL_MutexUnlock(pshadow->mutex);
 
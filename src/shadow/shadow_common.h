@@ -24,6 +24,7 @@
 
 #include "iot_import.h"
 #include "utils_timer.h"
+#include "utils_timer_wheel.h"
 #include "utils_list.h"
 #include "shadow.h"
 #include "shadow_config.h"
@@ -33,16 +34,71 @@ typedef struct iotx_update_ack_wait_list_st {
     char                token[IOTX_DS_TOKEN_LEN];
     iotx_push_cb_fpt    callback;
     void               *pcontext;
-    iotx_time_t         timer;
+    utils_timer_t       timer;     /* in update_ack_wheel while busy */
 } iotx_update_ack_wait_list_t, *iotx_update_ack_wait_list_pt;
 
 
+/* a registered attribute, where it is in attr_list stays the same until it is removed */
+typedef struct {
+    list_node_t *node;                      /* NULL for an empty slot */
+    uint32_t hash;                          /* of the attribute name */
+    uint32_t seq;                           /* in the order of registration */
+    int match;                              /* index + 1 among the attributes of the delta being applied */
+    int push;                               /* IOTX_DS_ATTR_CHANGED, IOTX_DS_ATTR_SENT */
+} iotx_shadow_attr_slot_t, *iotx_shadow_attr_slot_pt;
+
+#define IOTX_DS_ATTR_CHANGED                    (0x1) /* since the last update of changes was built */
+#define IOTX_DS_ATTR_SENT                       (0x2) /* in the update of changes not acked yet */
+
+/* the registered attributes by name, open addressed with linear probing */
+typedef struct {
+    iotx_shadow_attr_slot_t *slots;
+    uint32_t slot_num;                      /* a power of 2, at least twice attr_num */
+    uint32_t attr_num;
+    uint32_t seq;
+} iotx_shadow_attr_index_t;
+
+
+/* the updates of changed attributes IOT_Shadow_Yield() pushes, one in flight at a time */
+typedef struct {
+    uint32_t window_ms;
+    uint16_t timeout_s;
+    int requested;                          /* an attribute is changed, pushed when window expires */
+    iotx_time_t window;
+    int in_flight;
+    int ack_code;                           /* of the update in flight, IOTX_SHADOW_ACK_NONE until it comes */
+    iotx_push_cb_fpt callback;
+    void *pcontext;
+} iotx_shadow_push_t;
+
+
+/* the update document of changes, its head and the start of its tail are written once */
+typedef struct {
+    char *buf;                              /* of IOTX_DS_PUSH_BUF_LEN */
+    uint16_t head_len;
+    char *tail;                             /* }},"clientToken":"${device_id}- */
+    uint16_t tail_len;
+} iotx_shadow_doc_t;
+
+/* what is left of the tail, ${token}","version":${version}} */
+#define IOTX_DS_DOC_TAIL_LEN(doc)               ((doc)->tail_len + 10 + 13 + 10 + 2)
+
+/* how long an ntp request may go unanswered before it is sent again */
+#define IOTX_DS_NTP_RETRY_MS                    (60 * 1000)
+
+
 typedef struct iotx_inner_data_st {
     uint32_t token_num;
     uint32_t version;
+    uint32_t applied_version;               /* of the last document applied to the attributes, 0 for none */
     iotx_shadow_time_t time;
+    uint64_t ntp_request_ms;                /* uptime of the last ntp request, 0 for none */
     iotx_update_ack_wait_list_t update_ack_wait_list[IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM];
+    utils_timer_wheel_t update_ack_wheel;
     list_t *attr_list;
+    iotx_shadow_attr_index_t attr_index;
+    iotx_shadow_push_t push;
+    iotx_shadow_doc_t push_doc;
     char *ptopic_update;
     char *ptopic_get;
     int32_t sync_status;
@@ -72,6 +128,16 @@ iotx_err_t iotx_ds_common_format_finalize(iotx_shadow_pt pshadow, format_data_pt
 
 void iotx_ds_common_update_time(iotx_shadow_pt pshadow, uint32_t new_timestamp);
 
+/* sends an ntp request when the epoch clock needs a sync, see IOT_MQTT_SyncTime() */
+void iotx_ds_common_sync_time(iotx_shadow_pt pshadow);
+
+/* the document kept in doc with only its head, to add the attributes to with iotx_ds_common_format_add() */
+iotx_err_t iotx_ds_common_doc_begin(iotx_shadow_pt pshadow, iotx_shadow_doc_t *doc, format_data_pt pformat);
+
+iotx_err_t iotx_ds_common_doc_end(iotx_shadow_pt pshadow, iotx_shadow_doc_t *doc, format_data_pt pformat);
+
+void iotx_ds_common_doc_release(iotx_shadow_doc_t *doc);
+
 int iotx_ds_common_convert_data2string(
             char *buf,
             size_t buf_len,
@@ -94,6 +160,18 @@ iotx_err_t iotx_ds_common_remove_attr(
             iotx_shadow_pt pshadow,
             iotx_shadow_attr_pt pattr);
 
+/* the attributes of a name one by one, *pos is -1 for the first, called with pshadow->mutex locked */
+iotx_shadow_attr_slot_pt iotx_ds_common_lookup_attr(
+            iotx_shadow_pt pshadow,
+            const char *name,
+            int name_len,
+            int *pos);
+
+/* the slot of pattr or NULL, called with pshadow->mutex locked */
+iotx_shadow_attr_slot_pt iotx_ds_common_find_attr(iotx_shadow_pt pshadow, iotx_shadow_attr_pt pattr);
+
+void iotx_ds_common_release_attr_index(iotx_shadow_pt pshadow);
+
 char *iotx_ds_common_generate_topic_name(iotx_shadow_pt pshadow, const char *topic);
 
 int iotx_ds_common_publish2update(iotx_shadow_pt pshadow, char *data, uint32_t data_len);
@@ -26,4 +26,12 @@
 
 #define IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM        (5)   /**< indicate the maximum element of UPDATE ACK list. */
 
+#define IOTX_DS_UPDATE_WAIT_ACK_TICK_MS         (100) /**< the timeouts of UPDATE ACK are this late at most. */
+
+#define IOTX_DS_PUSH_WINDOW_MS                  (200) /**< changes within it are pushed in one update, by default. */
+
+#define IOTX_DS_PUSH_TIMEOUT_S                  (10)  /**< to wait the ACK of an update of changes, by default. */
+
+#define IOTX_DS_PUSH_BUF_LEN                    (1024) /**< the most of an update of changes, what is left goes in the next. */
+
 #endif /* _IOTX_SHADOW_CONFIG_H_ */
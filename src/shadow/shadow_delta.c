@@ -22,6 +22,7 @@
 
 #include "lite-log.h"
 #include "lite-utils.h"
+#include "json_parser.h"
 #include "utils_list.h"
 #include "shadow_delta.h"
 
@@ -51,26 +52,15 @@ static int iotx_shadow_delta_response(iotx_shadow_pt pshadow)
 
 
 
-static uint32_t iotx_shadow_get_timestamp(const char *pmetadata_desired,
-        size_t len_metadata_desired,
-        const char *pname)
-{
-    const char *pdata;
-
-    /* attribute be matched, and then get timestamp */
-
-    pdata = LITE_json_value_of((char *)pname, (char *)pmetadata_desired);
-
-    if (NULL != pdata) {
-        pdata = LITE_json_value_of((char *)"timestamp", (char *)pdata);
-        if (NULL != pdata) {
-            return atoi(pdata);
-        }
-    }
-
-    log_err("NOT timestamp in JSON doc");
-    return 0;
-}
+/* a registered attribute the delta has a value for */
+typedef struct {
+    iotx_shadow_attr_pt pattr;
+    iotx_shadow_attr_slot_pt slot;          /* until the mutex is unlocked */
+    uint32_t seq;
+    char *pvalue;
+    int value_len;
+    uint32_t timestamp;
+} iotx_shadow_delta_attr_t;
 
 
 static iotx_err_t iotx_shadow_delta_update_attr_value(
@@ -88,49 +78,100 @@ static void iotx_shadow_delta_update_attr(iotx_shadow_pt pshadow,
         const char *json_doc_metadata,
         uint32_t json_doc_metadata_len)
 {
-    const char *pvalue;
-    iotx_shadow_attr_pt pattr;
-    list_iterator_t *iter;
-    list_node_t *node;
+    iotx_shadow_delta_attr_t *attrs, *attr, temp;
+    iotx_shadow_attr_slot_pt slot;
+    lite_json_view_t view;
+    char *pos, *key, *val;
+    int klen, vlen, vtype;
+    int attr_num = 0;
+    int i, j;
 
-    /* Iterate the list and check JSON document according to list_node.val.pattr_name */
-    /* If the attribute be found, call the function registered by calling iotx_shadow_delta_register_attr() */
+    /* Walk the state and the metadata of the JSON document once each, looking every key up in the attribute index */
+    /* For each attribute found, call the function registered by calling iotx_shadow_delta_register_attr() */
 
     HAL_MutexLock(pshadow->mutex);
-    iter = list_iterator_new(pshadow->inner_data.attr_list, LIST_TAIL);
-    if (NULL == iter) {
+    if (0 == pshadow->inner_data.attr_index.attr_num) {
+        HAL_MutexUnlock(pshadow->mutex);
+        return;
+    }
+
+    attrs = LITE_malloc(pshadow->inner_data.attr_index.attr_num * sizeof(iotx_shadow_delta_attr_t));
+    if (NULL == attrs) {
         HAL_MutexUnlock(pshadow->mutex);
         log_warning("Allocate memory failed");
         return ;
     }
 
-    while (node = list_iterator_next(iter), NULL != node) {
-        pattr = (iotx_shadow_attr_pt)node->val;
-        pvalue = LITE_json_value_of((char *)pattr->pattr_name, (char *)json_doc_attr);
-
-        /* check if match attribute or not be matched */
-        if (NULL != pvalue) { /* attribute be matched */
-            /* get timestamp */
-            pattr->timestamp = iotx_shadow_get_timestamp(
-                                           json_doc_metadata,
-                                           json_doc_metadata_len,
-                                           pattr->pattr_name);
-
-            /* convert string of JSON value according to destination data type. */
-            if (SUCCESS_RETURN != iotx_shadow_delta_update_attr_value(pattr, pvalue, strlen(pvalue))) {
-                log_warning("Update attribute value failed.");
+    json_object_for_each_kv((char *)json_doc_attr, json_doc_attr_len, pos, key, klen, val, vlen, vtype) {
+        if (NULL == key || !klen || NULL == val || !vlen) {
+            continue;
+        }
+        for (i = -1; NULL != (slot = iotx_ds_common_lookup_attr(pshadow, key, klen, &i));) {
+            /* a key given twice is taken the first time */
+            if (slot->match) {
+                continue;
             }
+            attr = &attrs[attr_num];
+            attr->pattr = (iotx_shadow_attr_pt)slot->node->val;
+            attr->slot = slot;
+            attr->seq = slot->seq;
+            attr->pvalue = val;
+            attr->value_len = vlen;
+            attr->timestamp = 0;
+            slot->match = ++attr_num;
+        }
+    }
 
-            if (NULL != pattr->callback) {
-                HAL_MutexUnlock(pshadow->mutex);
-                /* call related callback function */
-                pattr->callback(pattr);
-                HAL_MutexLock(pshadow->mutex);
+    json_object_for_each_kv((char *)json_doc_metadata, json_doc_metadata_len, pos, key, klen, val, vlen, vtype) {
+        if (NULL == key || !klen || NULL == val || !vlen) {
+            continue;
+        }
+        view.value = NULL;
+        for (i = -1; NULL != (slot = iotx_ds_common_lookup_attr(pshadow, key, klen, &i));) {
+            if (!slot->match) {
+                continue;
+            }
+            view.key = "timestamp";
+            if (NULL != view.value || LITE_json_values_of(val, vlen, &view, 1)) {
+                attrs[slot->match - 1].timestamp = atoi(view.value);
             }
         }
     }
 
-    list_iterator_destroy(iter);
+    for (i = 0; i < attr_num; ++i) {
+        attrs[i].slot->match = 0;
+    }
+
+    /* called back in the order they were registered, the few of them sorted by insertion */
+    for (i = 1; i < attr_num; ++i) {
+        temp = attrs[i];
+        for (j = i; j > 0 && attrs[j - 1].seq > temp.seq; --j) {
+            attrs[j] = attrs[j - 1];
+        }
+        attrs[j] = temp;
+    }
+
+    for (i = 0; i < attr_num; ++i) {
+        attr = &attrs[i];
+        if (0 == attr->timestamp) {
+            log_err("NOT timestamp in JSON doc");
+        }
+        attr->pattr->timestamp = attr->timestamp;
+
+        /* convert string of JSON value according to destination data type. */
+        if (SUCCESS_RETURN != iotx_shadow_delta_update_attr_value(attr->pattr, attr->pvalue, attr->value_len)) {
+            log_warning("Update attribute value failed.");
+        }
+
+        if (NULL != attr->pattr->callback) {
+            HAL_MutexUnlock(pshadow->mutex);
+            /* call related callback function */
+            attr->pattr->callback(attr->pattr);
+            HAL_MutexLock(pshadow->mutex);
+        }
+    }
+
+    LITE_free(attrs);
     HAL_MutexUnlock(pshadow->mutex);
 }
 
@@ -140,35 +181,69 @@ void iotx_shadow_delta_entry(
             const char *json_doc,
             size_t json_doc_len)
 {
-    const char *key_metadata;
-    const char *pstate, *pmetadata;
-
-    pstate = LITE_json_value_of((char *)"payload.state.desired", (char *)json_doc);
-    if (NULL != pstate) {
-        key_metadata = "payload.metadata.desired";
-    } else {
+    lite_json_view_t views[] = {
+        { "payload.state.desired" },
+        { "payload.metadata.desired" },
+        { "payload.state.reported" },
+        { "payload.metadata.reported" },
+        { "version" },
+    };
+    lite_json_view_t *pstate, *pmetadata;
+
+    LITE_json_values_of((char *)json_doc, json_doc_len, views, sizeof(views) / sizeof(views[0]));
+
+    pstate = &views[0];
+    pmetadata = &views[1];
+    if (NULL == pstate->value) {
         /* if have not desired key, get reported key instead. */
-        key_metadata = "payload.metadata.reported";
-        pstate = LITE_json_value_of((char *)"payload.state.reported", (char *)json_doc);
+        pstate = &views[2];
+        pmetadata = &views[3];
     }
 
-    pmetadata = LITE_json_value_of((char *)key_metadata, (char *)json_doc);
-
-    if ((NULL == pstate) || (NULL == pmetadata)) {
+    if ((NULL == pstate->value) || (NULL == pmetadata->value)) {
         log_err("Invalid JSON Doc");
         return;
     }
 
     iotx_shadow_delta_update_attr(pshadow,
-                                  pstate,
-                                  strlen(pstate),
-                                  pmetadata,
-                                  strlen(pmetadata));
-
-    LITE_free(pstate);
-    LITE_free(pmetadata);
+                                  pstate->value,
+                                  pstate->value_len,
+                                  pmetadata->value,
+                                  pmetadata->value_len);
+
+    if (NULL != views[4].value) {
+        HAL_MutexLock(pshadow->mutex);
+        pshadow->inner_data.applied_version = (uint32_t)strtoul(views[4].value, NULL, 10);
+        HAL_MutexUnlock(pshadow->mutex);
+    }
 
     /* generate ACK and publish to @update topic using QOS1 */
     iotx_shadow_delta_response(pshadow);
 }
 
+
+/* handle the state in the reply of GET, skipped when it is not newer than the one applied */
+void iotx_shadow_delta_pull_entry(
+            iotx_shadow_pt pshadow,
+            const char *json_doc,
+            size_t json_doc_len)
+{
+    lite_json_view_t view = { "version" };
+    uint32_t version, applied;
+
+    LITE_json_values_of((char *)json_doc, json_doc_len, &view, 1);
+    if (NULL != view.value) {
+        version = (uint32_t)strtoul(view.value, NULL, 10);
+
+        HAL_MutexLock(pshadow->mutex);
+        applied = pshadow->inner_data.applied_version;
+        HAL_MutexUnlock(pshadow->mutex);
+
+        if (0 != applied && version <= applied) {
+            log_debug("shadow is current at version %u", (unsigned int)applied);
+            return;
+        }
+    }
+
+    iotx_shadow_delta_entry(pshadow, json_doc, json_doc_len);
+}
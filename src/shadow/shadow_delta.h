@@ -35,6 +35,12 @@ void iotx_shadow_delta_entry(
             const char *json_doc,
             size_t json_doc_len);
 
+/* as iotx_shadow_delta_entry(), unless the version of json_doc is not newer than the one applied */
+void iotx_shadow_delta_pull_entry(
+            iotx_shadow_pt pshadow,
+            const char *json_doc,
+            size_t json_doc_len);
+
 iotx_err_t iotx_shadow_delta_register_attr(
             iotx_shadow_pt pshadow,
             iotx_shadow_attr_pt pattr);
@@ -26,7 +26,7 @@
 
 #include "shadow_update.h"
 
-extern void iotx_shadow_delta_entry(
+extern void iotx_shadow_delta_pull_entry(
             iotx_shadow_pt pshadow,
             const char *json_doc,
             size_t json_doc_len);
@@ -70,8 +70,9 @@ iotx_update_ack_wait_list_pt iotx_shadow_update_wait_ack_list_add(
     memcpy(list[i].token, ptoken, token_len);
     list[i].token[token_len] = '\0';
 
-    iotx_time_init(&list[i].timer);
-    utils_time_countdown_ms(&list[i].timer, timeout);
+    HAL_MutexLock(pshadow->mutex);
+    utils_timer_add(&pshadow->inner_data.update_ack_wheel, &list[i].timer, timeout);
+    HAL_MutexUnlock(pshadow->mutex);
 
     log_debug("Add update ACK list");
 
@@ -82,30 +83,29 @@ iotx_update_ack_wait_list_pt iotx_shadow_update_wait_ack_list_add(
 void iotx_shadow_update_wait_ack_list_remove(iotx_shadow_pt pshadow, iotx_update_ack_wait_list_pt element)
 {
     HAL_MutexLock(pshadow->mutex);
+    utils_timer_cancel(&pshadow->inner_data.update_ack_wheel, &element->timer);
     element->flag_busy = 0;
     memset(element, 0, sizeof(iotx_update_ack_wait_list_t));
     HAL_MutexUnlock(pshadow->mutex);
 }
 
 
+/* the elements whose timer is due, the busy ones are not looked at otherwise */
 void iotx_ds_update_wait_ack_list_handle_expire(iotx_shadow_pt pshadow)
 {
-    size_t i;
-
-    iotx_update_ack_wait_list_pt pelement = pshadow->inner_data.update_ack_wait_list;
+    uint64_t now = HAL_UptimeMs();
+    utils_timer_t *timer;
+    iotx_update_ack_wait_list_pt pelement;
 
     HAL_MutexLock(pshadow->mutex);
 
-    for (i = 0; i < IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM; ++i) {
-        if (0 != pelement[i].flag_busy) {
-            if (utils_time_is_expired(&pelement[i].timer)) {
-                if (NULL != pelement[i].callback) {
-                    pelement[i].callback(pelement[i].pcontext, IOTX_SHADOW_ACK_TIMEOUT, NULL, 0);
-                }
-                /* free it. */
-                memset(&pelement[i], 0, sizeof(iotx_update_ack_wait_list_t));
-            }
+    while (NULL != (timer = utils_timer_wheel_take_expired(&pshadow->inner_data.update_ack_wheel, now))) {
+        pelement = UTILS_TIMER_ENTRY(timer, iotx_update_ack_wait_list_t, timer);
+        if (NULL != pelement->callback) {
+            pelement->callback(pelement->pcontext, IOTX_SHADOW_ACK_TIMEOUT, NULL, 0);
         }
+        /* free it. */
+        memset(pelement, 0, sizeof(iotx_update_ack_wait_list_t));
     }
 
     HAL_MutexUnlock(pshadow->mutex);
@@ -145,6 +145,8 @@ void iotx_ds_update_wait_ack_list_handle_response(
             /* check the related */
             if (0 == memcmp(pdata, pelement[i].token, strlen(pelement[i].token))) {
                 LITE_free(pdata);
+                /* answered, it does not time out while the callback runs */
+                utils_timer_cancel(&pshadow->inner_data.update_ack_wheel, &pelement[i].timer);
                 HAL_MutexUnlock(pshadow->mutex);
                 //log_debug("token=%s", pelement[i].token);
                 do {
@@ -160,7 +162,7 @@ void iotx_ds_update_wait_ack_list_handle_response(
                         /* If have 'state' keyword in @json_shadow.payload, attribute value should be updated. */
                         temp = LITE_json_value_of("state", (char *)ppayload);
                         if (NULL != temp) {
-                            iotx_shadow_delta_entry(pshadow, json_doc, json_doc_len); /* update attribute */
+                            iotx_shadow_delta_pull_entry(pshadow, json_doc, json_doc_len); /* update attribute */
                             LITE_free(temp);
                         }
 
@@ -206,3 +208,211 @@ void iotx_ds_update_wait_ack_list_handle_response(
     HAL_MutexUnlock(pshadow->mutex);
     log_warning("Not match any wait element in list.");
 }
+
+
+/* the ACK, or the timeout, of the update in flight, taken up by iotx_ds_update_push_handle() */
+static void iotx_ds_update_push_ack(
+            void *pcontext,
+            int ack_code,
+            const char *ack_msg, /* NOTE: NOT a string. */
+            uint32_t ack_msg_len)
+{
+    iotx_shadow_pt pshadow = (iotx_shadow_pt)pcontext;
+
+    /* called with pshadow->mutex locked when it times out, and unlocked when it is answered */
+    pshadow->inner_data.push.ack_code = ack_code;
+}
+
+
+iotx_err_t iotx_ds_update_push_changed(iotx_shadow_pt pshadow, iotx_shadow_attr_pt pattr)
+{
+    iotx_shadow_push_t *push = &pshadow->inner_data.push;
+    iotx_shadow_attr_slot_pt slot;
+
+    HAL_MutexLock(pshadow->mutex);
+    slot = iotx_ds_common_find_attr(pshadow, pattr);
+    if (NULL == slot) {
+        HAL_MutexUnlock(pshadow->mutex);
+        return ERROR_SHADOW_NO_ATTRIBUTE;
+    }
+
+    slot->push |= IOTX_DS_ATTR_CHANGED;
+    if (!push->requested) {
+        push->requested = 1;
+        iotx_time_init(&push->window);
+        utils_time_countdown_ms(&push->window, push->window_ms);
+    }
+    HAL_MutexUnlock(pshadow->mutex);
+
+    return SUCCESS_RETURN;
+}
+
+
+/* what was sent is changed again, to go in the next update */
+static void iotx_ds_update_push_resend(iotx_shadow_pt pshadow)
+{
+    iotx_shadow_attr_index_t *index = &pshadow->inner_data.attr_index;
+    uint32_t i;
+
+    for (i = 0; i < index->slot_num; ++i) {
+        if (NULL != index->slots[i].node && (index->slots[i].push & IOTX_DS_ATTR_SENT)) {
+            index->slots[i].push = IOTX_DS_ATTR_CHANGED;
+            pshadow->inner_data.push.requested = 1;
+        }
+    }
+}
+
+
+/* the changed attributes that fit, up to room left for the tail, with pshadow->mutex locked */
+static int iotx_ds_update_push_format(iotx_shadow_pt pshadow, format_data_pt pformat, uint16_t room)
+{
+    iotx_shadow_attr_index_t *index = &pshadow->inner_data.attr_index;
+    iotx_shadow_attr_pt pattr;
+    uint32_t offset;
+    uint16_t buf_size = pformat->buf_size;
+    int flag_new;
+    int count = 0;
+    uint32_t i;
+
+    pformat->buf_size = room;
+    pshadow->inner_data.push.requested = 0;
+
+    for (i = 0; i < index->slot_num; ++i) {
+        if (NULL == index->slots[i].node || !(index->slots[i].push & IOTX_DS_ATTR_CHANGED)) {
+            continue;
+        }
+
+        pattr = (iotx_shadow_attr_pt)index->slots[i].node->val;
+        offset = pformat->offset;
+        flag_new = pformat->flag_new;
+        if (SUCCESS_RETURN != iotx_ds_common_format_add(pshadow, pformat, pattr->pattr_name, pattr->pattr_data,
+                pattr->attr_type)) {
+            pformat->offset = offset;
+            pformat->flag_new = flag_new;
+            if (0 == count) {
+                /* would never fit */
+                log_err("attribute %s can not be pushed in %d bytes", pattr->pattr_name, IOTX_DS_PUSH_BUF_LEN);
+                index->slots[i].push = 0;
+                continue;
+            }
+            pshadow->inner_data.push.requested = 1;
+            continue;
+        }
+
+        index->slots[i].push = IOTX_DS_ATTR_SENT;
+        ++count;
+    }
+
+    pformat->buf_size = buf_size;
+
+    return count;
+}
+
+
+static int iotx_ds_update_push_has_room(iotx_shadow_pt pshadow)
+{
+    int i;
+
+    for (i = 0; i < IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM; ++i) {
+        if (0 == pshadow->inner_data.update_ack_wait_list[i].flag_busy) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* called by IOT_Shadow_Yield() */
+void iotx_ds_update_push_handle(iotx_shadow_pt pshadow)
+{
+    iotx_shadow_push_t *push = &pshadow->inner_data.push;
+    format_data_t format;
+    iotx_push_cb_fpt callback;
+    void *pcontext;
+    int ack_code;
+    int count;
+    int rc;
+
+    HAL_MutexLock(pshadow->mutex);
+    if (push->in_flight && IOTX_SHADOW_ACK_NONE != push->ack_code) {
+        ack_code = push->ack_code;
+        if ((IOTX_SHADOW_ACK_SUCCESS == ack_code) || (IOTX_SHADOW_ACK_ERR_SHADOW_DOCUMENT_IS_NULL == ack_code)) {
+            uint32_t i;
+            for (i = 0; i < pshadow->inner_data.attr_index.slot_num; ++i) {
+                pshadow->inner_data.attr_index.slots[i].push &= ~IOTX_DS_ATTR_SENT;
+            }
+        } else {
+            iotx_ds_update_push_resend(pshadow);
+        }
+        push->in_flight = 0;
+        callback = push->callback;
+        pcontext = push->pcontext;
+        HAL_MutexUnlock(pshadow->mutex);
+
+        if (NULL != callback) {
+            callback(pcontext, ack_code, NULL, 0);
+        }
+        HAL_MutexLock(pshadow->mutex);
+    }
+
+    /* the changes wait while an update is in flight or the ACK list is full */
+    if (push->in_flight || !push->requested || !utils_time_is_expired(&push->window)
+        || !iotx_ds_update_push_has_room(pshadow) || !IOT_MQTT_CheckStateNormal(pshadow->mqtt)) {
+        HAL_MutexUnlock(pshadow->mutex);
+        return;
+    }
+
+    if (SUCCESS_RETURN != iotx_ds_common_doc_begin(pshadow, &pshadow->inner_data.push_doc, &format)) {
+        HAL_MutexUnlock(pshadow->mutex);
+        return;
+    }
+
+    count = iotx_ds_update_push_format(pshadow, &format,
+                                       IOTX_DS_PUSH_BUF_LEN - IOTX_DS_DOC_TAIL_LEN(&pshadow->inner_data.push_doc));
+    if (0 == count) {
+        HAL_MutexUnlock(pshadow->mutex);
+        return;
+    }
+    push->in_flight = 1;
+    push->ack_code = IOTX_SHADOW_ACK_NONE;
+    HAL_MutexUnlock(pshadow->mutex);
+
+    /* the document is only used here, in the thread that yields */
+    rc = iotx_ds_common_doc_end(pshadow, &pshadow->inner_data.push_doc, &format);
+    if (SUCCESS_RETURN == rc) {
+        rc = IOT_Shadow_Push_Async(pshadow, format.buf, format.offset, push->timeout_s, iotx_ds_update_push_ack, pshadow);
+    }
+
+    if (SUCCESS_RETURN != rc) {
+        log_warning("push changes failed, rc = %d", rc);
+        HAL_MutexLock(pshadow->mutex);
+        iotx_ds_update_push_resend(pshadow);
+        push->in_flight = 0;
+        HAL_MutexUnlock(pshadow->mutex);
+    }
+}
+
+
+/* ms till IOT_Shadow_Yield() has an ACK timed out or changes to push, 0xFFFFFFFF when there is neither */
+uint32_t iotx_ds_update_next_timeout(iotx_shadow_pt pshadow)
+{
+    iotx_shadow_push_t *push = &pshadow->inner_data.push;
+    uint32_t timeout;
+    uint32_t window;
+
+    HAL_MutexLock(pshadow->mutex);
+    timeout = utils_timer_wheel_next_timeout(&pshadow->inner_data.update_ack_wheel, HAL_UptimeMs());
+
+    /* as iotx_ds_update_push_handle() takes them up, a push held back for room or connection waits on those */
+    if (push->in_flight && IOTX_SHADOW_ACK_NONE != push->ack_code) {
+        timeout = 0;
+    } else if (!push->in_flight && push->requested
+               && iotx_ds_update_push_has_room(pshadow) && IOT_MQTT_CheckStateNormal(pshadow->mqtt)) {
+        window = iotx_time_left(&push->window);
+        timeout = (window < timeout) ? window : timeout;
+    }
+    HAL_MutexUnlock(pshadow->mutex);
+
+    return timeout;
+}
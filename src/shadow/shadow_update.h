@@ -45,5 +45,11 @@ void iotx_ds_update_wait_ack_list_handle_response(
             const char *json_doc,
             size_t json_doc_len);
 
+iotx_err_t iotx_ds_update_push_changed(iotx_shadow_pt pshadow, iotx_shadow_attr_pt pattr);
+
+void iotx_ds_update_push_handle(iotx_shadow_pt pshadow);
+
+uint32_t iotx_ds_update_next_timeout(iotx_shadow_pt pshadow);
+
 
 #endif /* _IOTX_SHADOW_UPDATE_H_ */
@@ -2,12 +2,12 @@
 
 #include "utils_list.h"
 #include "lite-utils.h"
+#include "json_parser.h"
 #include "lite-system.h"
+#include "utils_timer.h"
+#include "utils_timer_wheel.h"
 #include "iotx_subdev_common.h"
 
-iotx_gateway_t g_gateway_subdevice = {0};
-iotx_gateway_pt g_gateway_subdevice_t = &g_gateway_subdevice;
-
 static void iotx_mqtt_reconnect_callback(iotx_gateway_pt gateway);
 
 static int iotx_gateway_recv_publish_callbacks(iotx_gateway_pt gateway, 
@@ -18,6 +18,17 @@ static int iotx_subdevice_recv_rrpc_callback(iotx_gateway_pt gateway,
         char* recv_topic,
         char* recv_payload);
 
+static void iotx_gateway_pending_complete(iotx_gateway_pt gateway, 
+        iotx_gateway_pending_pt pending,
+        int result,
+        char* payload);
+
+static void iotx_gateway_restore_reply(void* gateway, 
+        const char* product_key, 
+        const char* device_name, 
+        int result, 
+        void* pcontext);
+
 
 #ifdef SUBDEV_VIA_CLOUD_CONN
 static void _event_handle(void *pcontext, iotx_cloud_connection_event_msg_pt msg)
@@ -39,11 +50,17 @@ void _response_handle(void *pcontext, void *pconnection, iotx_cloud_connection_m
         case IOTX_CLOUD_CONNECTION_RESPONSE_SUBSCRIBE_SUCCESS: 
         case IOTX_CLOUD_CONNECTION_RESPONSE_UNSUBSCRIBE_SUCCESS:
             gateway->gateway_data.sync_status = 0;
+        #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+            HAL_SemaphorePost(gateway->gateway_data.sem_sync);
+        #endif
             break;
         
         case IOTX_CLOUD_CONNECTION_RESPONSE_SUBSCRIBE_FAIL:
         case IOTX_CLOUD_CONNECTION_RESPONSE_UNSUBSCRIBE_FAIL:
             gateway->gateway_data.sync_status = -1;
+        #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+            HAL_SemaphorePost(gateway->gateway_data.sem_sync);
+        #endif
             break;
         
         case IOTX_CLOUD_CONNECTION_RESPONSE_SEND_SUCCESS: 
@@ -90,12 +107,65 @@ void _response_handle(void *pcontext, void *pconnection, iotx_cloud_connection_m
 #endif
 
 
+/* "data" of the replies that carry any, kept until read */
+static int iotx_subdevice_reply_message_save(iotx_gateway_pt gateway, 
+        const char* value,
+        int value_len,
+        iotx_gateway_publish_t reply_type)
+{
+    char* node = NULL;
+    char** message = NULL;
+    const char* name = NULL;
+
+    if (IOTX_GATEWAY_PUBLISH_REGISTER == reply_type) {
+        message = &gateway->gateway_data.register_message;
+        name = "register";
+    } else if (IOTX_GATEWAY_PUBLISH_TOPO_GET == reply_type) {
+        message = &gateway->gateway_data.topo_get_message;
+        name = "topo_get";
+    } else if (IOTX_GATEWAY_PUBLISH_CONFIG_GET == reply_type) {
+        message = &gateway->gateway_data.config_get_message;
+        name = "config_get";
+    }
+
+    if (NULL != message) {
+        /* parse   data */
+        if (value == NULL) {
+            log_err("%s reply: get data of json error!", name);
+            return ERROR_SUBDEV_GET_JSON_VAL;
+        }
+        if (value_len > REPLY_MESSAGE_LEN_MAX 
+                && !(IOTX_GATEWAY_PUBLISH_TOPO_GET == reply_type && gateway->gateway_data.topo_get_paged)) {
+            log_err("%s reply size is large then REPLY_MESSAGE_LEN_MAX, please modify the REPLY_MESSAGE_LEN_MAX", name);
+            return ERROR_SUBDEV_DATA_LEN_OVERFLOW;
+        }
+        node = LITE_malloc(value_len + 1);
+        if (node == NULL) {
+            log_err("%s reply: memory error!", name);
+            return ERROR_MALLOC;
+        }
+        memcpy(node, value, value_len);
+        node[value_len] = '\0';
+        if (NULL != *message) {
+            LITE_free(*message);
+        }
+        *message = node;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+
 static int iotx_subdevice_common_reply_proc(iotx_gateway_pt gateway, 
         char* payload,
         iotx_gateway_publish_t reply_type)
 {
-    char* node = NULL;
+    int code = 0;
+    int matched = 0;
+    int rc = 0;
     iotx_common_reply_data_pt reply_data = NULL;    
+    iotx_gateway_pending_pt pending = NULL;
+    lite_json_view_t views[] = { { "id" }, { "code" }, { "data" } };
 
     log_info("recv reply");
 
@@ -137,105 +207,274 @@ static int iotx_subdevice_common_reply_proc(iotx_gateway_pt gateway,
             return ERROR_SUBDEV_REPLY_TYPE_NOT_DEF;
     }
 
-    /* parse result */
-    /* parse   id */
-    node = LITE_json_value_of("id", payload);
-    if (node == NULL) { 
+    /* parse result, id, code and data in one pass */
+    LITE_json_values_of(payload, strlen(payload), views, sizeof(views) / sizeof(views[0]));
+    if (views[0].value == NULL) { 
         log_err("get id of json error!");
         return ERROR_SUBDEV_GET_JSON_VAL;
     }
-    
-    if (reply_data->id == atoi(node)) {
-        reply_data->id = 0;
+
+    /* a request of an asynchronous call, completed here whatever the slot of its type waits for */
+    if (NULL != (pending = iotx_gateway_pending_take(gateway, atoi(views[0].value)))) {
+        if (views[1].value == NULL) {
+            log_err("get code of json error!");
+            iotx_gateway_pending_complete(gateway, pending, ERROR_SUBDEV_GET_JSON_VAL, NULL);
+            return ERROR_SUBDEV_GET_JSON_VAL;
+        }
+        code = atoi(views[1].value);
+        iotx_gateway_pending_complete(gateway, pending, 200 == code ? SUCCESS_RETURN : (~code + 1), payload);
+        return SUCCESS_RETURN;
     }
+    
+    matched = (reply_data->id == atoi(views[0].value));
 
-    LITE_free(node);
-    node = NULL;
     /* parse   code */
-    node = LITE_json_value_of("code", payload);
-    if (node == NULL) {
+    if (views[1].value == NULL) {
         log_err("get code of json error!");
-        return ERROR_SUBDEV_GET_JSON_VAL;
+        rc = ERROR_SUBDEV_GET_JSON_VAL;
+    } else {
+        reply_data->code = atoi(views[1].value);
+        rc = iotx_subdevice_reply_message_save(gateway, views[2].value, views[2].value_len, reply_type);
     }
-    
-    reply_data->code = atoi(node);
-    LITE_free(node);
-    node = NULL;
 
-    if (IOTX_GATEWAY_PUBLISH_REGISTER == reply_type) {        
-        /* parse   code */
-        node = LITE_json_value_of("data", payload);
-        if (node == NULL) {
-            log_err("register reply: get data of json error!");
-            return ERROR_SUBDEV_GET_JSON_VAL;
-        }
-        if (strlen(node) > REPLY_MESSAGE_LEN_MAX) {
-            log_err("topo_get reply size is large then REPLY_MESSAGE_LEN_MAX, please modify the REPLY_MESSAGE_LEN_MAX");
-            return ERROR_SUBDEV_DATA_LEN_OVERFLOW;
+    /* the waiter reads code and message once id is 0 */
+    if (matched) {
+        reply_data->id = 0;
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_SemaphorePost(reply_data->sem);
+#endif
+    }
+
+    return rc;
+}
+
+#define GATEWAY_RRPC_REQUEST                "/rrpc/request/"
+#define GATEWAY_RRPC_REQUEST_LEN            (sizeof(GATEWAY_RRPC_REQUEST) - 1)
+
+/* the message id of ".../rrpc/request/<message_id>" read back from the end, 
+ * returns the length of the topic before it or -1 */
+static int iotx_parse_rrpc_message_id(const char* topic, char message_id[IOTX_GATEWAY_RRPC_ID_LEN_MAX + 1])
+{
+    int len = strlen(topic);
+    int pos = len;
+
+    while (pos > 0 && len - pos < IOTX_GATEWAY_RRPC_ID_LEN_MAX && topic[pos - 1] >= '0' && topic[pos - 1] <= '9') {
+        pos--;
+    }
+    if (pos == len || pos < (int)GATEWAY_RRPC_REQUEST_LEN || 
+            0 != memcmp(topic + pos - GATEWAY_RRPC_REQUEST_LEN, GATEWAY_RRPC_REQUEST, GATEWAY_RRPC_REQUEST_LEN)) {
+        log_err("parse error");
+        return -1;
+    }
+
+    memcpy(message_id, topic + pos, len - pos);
+    message_id[len - pos] = '\0';
+
+    return pos;
+}
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+/* a request for the worker thread, the payload follows */
+typedef struct iotx_gateway_rrpc_st {
+    struct iotx_gateway_rrpc_st*        next;
+    iotx_gateway_pt                     gateway;
+    rrpc_request_callback               callback;
+    char                                product_key[PRODUCT_KEY_LEN];
+    char                                device_name[DEVICE_NAME_LEN];
+    char                                message_id[IOTX_GATEWAY_RRPC_ID_LEN_MAX + 1];
+} iotx_gateway_rrpc_t, *iotx_gateway_rrpc_pt;
+
+/* one worker thread for the rrpc callbacks of every gateway of the process, started with the first
+ * and stopped with the last, so a gateway more costs no stack */
+typedef struct {
+    void*                               lock;
+    void*                               sem;                /* posted once per request queued and once to stop */
+    void*                               sem_exit;
+    iotx_gateway_rrpc_pt                head;
+    iotx_gateway_rrpc_pt                tail;
+    iotx_gateway_pt                     calling;            /* whose callback runs, under lock */
+    int                                 users;
+    volatile int                        stop;
+} iotx_gateway_rrpc_worker_t;
+
+static iotx_gateway_rrpc_worker_t g_gateway_rrpc_worker = {0};
+
+static void *iotx_gateway_rrpc_worker(void *arg)
+{
+    iotx_gateway_rrpc_worker_t* worker = (iotx_gateway_rrpc_worker_t*)arg;
+    iotx_gateway_rrpc_pt request = NULL;
+
+    for (;;) {
+        (void)HAL_SemaphoreWait(worker->sem, PLATFORM_WAIT_INFINITE);
+        if (worker->stop) {
+            break;
         }
-        memset(gateway->gateway_data.register_message, 0x0, REPLY_MESSAGE_LEN_MAX);   
-        strncpy(gateway->gateway_data.register_message, node, strlen(node));    
-         
-        LITE_free(node);
-        node = NULL;
-    } else if (IOTX_GATEWAY_PUBLISH_TOPO_GET == reply_type) {        
-        /* parse   code */
-        node = LITE_json_value_of("data", payload);
-        if (node == NULL) {
-            log_err("topo_get reply: get data of json error!");
-            return ERROR_SUBDEV_GET_JSON_VAL;
+
+        HAL_MutexLock(worker->lock);
+        if (NULL != (request = worker->head)) {
+            worker->head = request->next;
+            if (NULL == worker->head) {
+                worker->tail = NULL;
+            }
+            request->gateway->gateway_data.rrpc_num--;
+            worker->calling = request->gateway;
         }
-        if (strlen(node) > REPLY_MESSAGE_LEN_MAX) {  
-            LITE_free(node);
-            log_err("topo_get reply size is large then REPLY_MESSAGE_LEN_MAX, please modify the REPLY_MESSAGE_LEN_MAX");
-            return ERROR_SUBDEV_DATA_LEN_OVERFLOW;
+        HAL_MutexUnlock(worker->lock);
+
+        if (NULL != request) {
+            request->callback((void*)request->gateway, 
+                    request->product_key, 
+                    request->device_name, 
+                    request->message_id, 
+                    (char*)(request + 1));
+            LITE_free(request);
+
+            HAL_MutexLock(worker->lock);
+            worker->calling = NULL;
+            HAL_MutexUnlock(worker->lock);
         }
-        memset(gateway->gateway_data.topo_get_message, 0x0, REPLY_MESSAGE_LEN_MAX);   
-        strncpy(gateway->gateway_data.topo_get_message, node, strlen(node));   
-        LITE_free(node);
-        node = NULL;
-    } else if (IOTX_GATEWAY_PUBLISH_CONFIG_GET == reply_type) {        
-        /* parse   code */
-        node = LITE_json_value_of("data", payload);
-        if (node == NULL) {
-            log_err("config_get reply: get data of json error!");
-            return ERROR_SUBDEV_GET_JSON_VAL;
+    }
+
+    HAL_SemaphorePost(worker->sem_exit);
+    return NULL;
+}
+
+static void iotx_gateway_rrpc_worker_free(iotx_gateway_rrpc_worker_t* worker)
+{
+    if (NULL != worker->lock) {
+        HAL_MutexDestroy(worker->lock);
+    }
+    if (NULL != worker->sem) {
+        HAL_SemaphoreDestroy(worker->sem);
+    }
+    if (NULL != worker->sem_exit) {
+        HAL_SemaphoreDestroy(worker->sem_exit);
+    }
+    memset(worker, 0x0, sizeof(iotx_gateway_rrpc_worker_t));
+}
+
+static void iotx_gateway_rrpc_worker_start(iotx_gateway_pt gateway)
+{
+    iotx_gateway_rrpc_worker_t* worker = &g_gateway_rrpc_worker;
+    void *thread = NULL;
+    hal_os_thread_param_t param;
+
+    if (0 == worker->users) {
+        worker->lock = HAL_MutexCreate();
+        worker->sem = HAL_SemaphoreCreate();
+        worker->sem_exit = HAL_SemaphoreCreate();
+        if (NULL == worker->lock || NULL == worker->sem || NULL == worker->sem_exit) {
+            log_err("create semaphore error, rrpc callbacks are called by the yield");
+            iotx_gateway_rrpc_worker_free(worker);
+            return;
         }
-        if (strlen(node) > REPLY_MESSAGE_LEN_MAX) {  
-            LITE_free(node);
-            log_err("config_get reply size is large then REPLY_MESSAGE_LEN_MAX, please modify the REPLY_MESSAGE_LEN_MAX");
-            return ERROR_SUBDEV_DATA_LEN_OVERFLOW;
+
+        memset(&param, 0, sizeof(param));
+        param.stack_size = IOTX_GATEWAY_RRPC_STACK_SIZE;
+        param.name = "gateway_rrpc";
+        if (0 != HAL_ThreadCreate(&thread, iotx_gateway_rrpc_worker, worker, &param, NULL)) {
+            log_err("create thread error, rrpc callbacks are called by the yield");
+            iotx_gateway_rrpc_worker_free(worker);
+            return;
         }
-        memset(gateway->gateway_data.config_get_message, 0x0, REPLY_MESSAGE_LEN_MAX);   
-        strncpy(gateway->gateway_data.config_get_message, node, strlen(node));   
-        LITE_free(node);
-        node = NULL;
+        /* sem_exit tells when it ends */
+        HAL_ThreadDetach(thread);
     }
 
-    return SUCCESS_RETURN;
+    worker->users++;
+    gateway->gateway_data.rrpc_worker = 1;
 }
 
-static int iotx_parse_rrpc_message_id(const char* topic, char* message, uint32_t message_len)
+/* the requests of the gateway not called yet are dropped, the one being called is waited for */
+static void iotx_gateway_rrpc_worker_stop(iotx_gateway_pt gateway)
 {
-    char* temp;
-    temp = strstr(topic, "/rrpc/request/");        
-    if (temp == NULL) {
-        log_err("parse error");
-        return ERROR_SUBDEV_NULL_VALUE;
+    iotx_gateway_rrpc_worker_t* worker = &g_gateway_rrpc_worker;
+    iotx_gateway_rrpc_pt request = NULL;
+    iotx_gateway_rrpc_pt* link = NULL;
+
+    if (!gateway->gateway_data.rrpc_worker) {
+        return;
     }
+    gateway->gateway_data.rrpc_worker = 0;
 
-    temp = temp + strlen("/rrpc/request/");
+    HAL_MutexLock(worker->lock);
+    worker->tail = NULL;
+    for (link = &worker->head; NULL != (request = *link); ) {
+        if (request->gateway == gateway) {
+            *link = request->next;
+            LITE_free(request);
+            continue;
+        }
+        worker->tail = request;
+        link = &request->next;
+    }
+    gateway->gateway_data.rrpc_num = 0;
+    while (worker->calling == gateway) {
+        HAL_MutexUnlock(worker->lock);
+        HAL_SleepMs(1);
+        HAL_MutexLock(worker->lock);
+    }
+    HAL_MutexUnlock(worker->lock);
 
-    if (strlen(temp) + 1 > message_len) {
-        log_info("message len error");
-        return ERROR_SUBDEV_MSG_LEN;
+    if (0 == --worker->users) {
+        worker->stop = 1;
+        HAL_SemaphorePost(worker->sem);
+        (void)HAL_SemaphoreWait(worker->sem_exit, PLATFORM_WAIT_INFINITE);
+        iotx_gateway_rrpc_worker_free(worker);
     }
+}
+#endif
 
-    strncpy(message, temp, strlen(temp));
+/* a slow callback holds the worker thread instead of the yield loop, when there is one */
+static void iotx_gateway_rrpc_dispatch(iotx_gateway_pt gateway,
+        rrpc_request_callback callback,
+        const char* product_key,
+        const char* device_name,
+        const char* message_id,
+        char* payload)
+{
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    iotx_gateway_rrpc_pt request = NULL;
 
-    log_info("message %s", message);
+    iotx_gateway_rrpc_worker_t* worker = &g_gateway_rrpc_worker;
 
-    return SUCCESS_RETURN;
+    if (gateway->gateway_data.rrpc_worker) {
+        HAL_MutexLock(worker->lock);
+        if (gateway->gateway_data.rrpc_num >= IOTX_GATEWAY_RRPC_QUEUE_MAX) {
+            HAL_MutexUnlock(worker->lock);
+            log_err("rrpc queue full, %s of %s.%s dropped", message_id, product_key, device_name);
+            return;
+        }
+        HAL_MutexUnlock(worker->lock);
+
+        if (NULL == (request = LITE_malloc(sizeof(iotx_gateway_rrpc_t) + strlen(payload) + 1))) {
+            log_err("Not enough memory, rrpc %s dropped", message_id);
+            return;
+        }
+        memset(request, 0x0, sizeof(iotx_gateway_rrpc_t));
+        request->gateway = gateway;
+        request->callback = callback;
+        strncpy(request->product_key, product_key, PRODUCT_KEY_LEN - 1);
+        strncpy(request->device_name, device_name, DEVICE_NAME_LEN - 1);
+        strncpy(request->message_id, message_id, IOTX_GATEWAY_RRPC_ID_LEN_MAX);
+        strcpy((char*)(request + 1), payload);
+
+        HAL_MutexLock(worker->lock);
+        if (NULL == worker->tail) {
+            worker->head = request;
+        } else {
+            worker->tail->next = request;
+        }
+        worker->tail = request;
+        gateway->gateway_data.rrpc_num++;
+        HAL_MutexUnlock(worker->lock);
+
+        HAL_SemaphorePost(worker->sem);
+        return;
+    }
+#endif
+
+    callback((void*)gateway, product_key, device_name, message_id, payload);
 }
 
 
@@ -244,7 +483,13 @@ static int iotx_subdevice_recv_rrpc_callback(iotx_gateway_pt gateway,
         char* recv_topic,
         char* recv_payload)
 {    
-    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
+    int prefix_len = 0;
+    char product_key[PRODUCT_KEY_LEN] = {0};
+    char device_name[DEVICE_NAME_LEN] = {0};
+    char message_id[IOTX_GATEWAY_RRPC_ID_LEN_MAX + 1] = {0};
+    const char* pos = NULL;
+    const char* sep = NULL;
+    const char* end = NULL;
     iotx_subdevice_session_pt session = NULL;
     
     if (gateway == NULL || recv_topic == NULL || recv_payload == NULL) {
@@ -252,35 +497,41 @@ static int iotx_subdevice_recv_rrpc_callback(iotx_gateway_pt gateway,
         return ERROR_SUBDEV_NULL_VALUE;
     }
 
-    session = gateway->session_list;
+    /* "/sys/<product_key>/<device_name>/rrpc/request/<message_id>", the prefix the session subscribed
+     * names it, the session is found by the hash of the names */
+    if (0 != strncmp(recv_topic, "/sys/", strlen("/sys/")) ||
+            (prefix_len = iotx_parse_rrpc_message_id(recv_topic, message_id)) < 0) {
+        return ERROR_SUBDEV_SESSION_NOT_FOUND;
+    }
+    pos = recv_topic + strlen("/sys/");
+    end = recv_topic + prefix_len - GATEWAY_RRPC_REQUEST_LEN;
+    if (end <= pos || NULL == (sep = memchr(pos, '/', end - pos)) || 
+            sep - pos >= PRODUCT_KEY_LEN || end - sep - 1 <= 0 || end - sep - 1 >= DEVICE_NAME_LEN) {
+        return ERROR_SUBDEV_SESSION_NOT_FOUND;
+    }
+    memcpy(product_key, pos, sep - pos);
+    memcpy(device_name, sep + 1, end - sep - 1);
 
-    while (session) {        
-        memset(topic, 0x0, GATEWAY_TOPIC_LEN_MAX);
-        HAL_Snprintf(topic, GATEWAY_TOPIC_LEN_MAX, TOPIC_SYS_RRPC_FMT, session->product_key, 
-                session->device_name, "request");
-        if ((strlen(recv_topic) >= strlen(topic) - 2) && 
-          (0 == strncmp(recv_topic, topic, strlen(topic) - 2))) {
-            /* subdev rrpc */
-            log_info("session rrpc callback");
-            
-            if (session->rrpc_callback) {
-                char message_id[200] = {0};
-                if (SUCCESS_RETURN == iotx_parse_rrpc_message_id(recv_topic, message_id, 20)) {
-                    session->rrpc_callback((void*)gateway, 
-                                    session->product_key,
-                                    session->device_name,
-                                    message_id, 
-                                    recv_payload);
-                }
-            }
-            else
-                log_info("recv rrpc request, but not register callback");
-            return SUCCESS_RETURN;
-        }
-        session = session->next;
+    session = iotx_subdevice_find_session(gateway, product_key, device_name);
+
+    if (NULL == session) {
+        return ERROR_SUBDEV_SESSION_NOT_FOUND;
     }
 
-    return ERROR_SUBDEV_SESSION_NOT_FOUND;
+    /* subdev rrpc */
+    log_info("session rrpc callback");
+    
+    if (session->rrpc_callback) {
+        iotx_gateway_rrpc_dispatch(gateway, 
+                session->rrpc_callback, 
+                session->product_key, 
+                session->device_name, 
+                message_id, 
+                recv_payload);
+    }
+    else
+        log_info("recv rrpc request, but not register callback");
+    return SUCCESS_RETURN;
 }
 
 /*recv gateway publish message proc*/ 
@@ -288,166 +539,44 @@ static int iotx_gateway_recv_publish_callbacks(iotx_gateway_pt gateway,
         char* recv_topic,
         char* recv_payload)
 {
-    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
-    iotx_device_info_pt pdevice_info = NULL;
-    
+    int type = 0;
     if (gateway == NULL || recv_topic == NULL || recv_payload == NULL) {
         log_info("param error");
         return ERROR_SUBDEV_NULL_VALUE;
     }
-    
-    pdevice_info = iotx_device_info_get();
-
-    /* login_reply */
-    HAL_Snprintf(topic,
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_COMBINE_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "login_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-      (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-        iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_LOGIN);
-        return SUCCESS_RETURN;
-    }
 
-    /* logout_reply */
-    HAL_Snprintf(topic,
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_COMBINE_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "logout_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-      (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-        iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_LOGOUT);
-        return SUCCESS_RETURN;
+    /* the reply topics are kept by the gateway, nothing to format per message */
+    type = iotx_gateway_reply_type(gateway, recv_topic);
+    if (type < 0) {
+        return ERROR_SUBDEV_REPLY_TOPIC_NOT_MATCH;
     }
 
-    /* register_reply */
-    HAL_Snprintf(topic,
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_SUB_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "register_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-      (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-        if (SUCCESS_RETURN == iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_REGISTER))
-            return SUCCESS_RETURN;
-        else
+    if (IOTX_GATEWAY_PUBLISH_MAX != type) {
+        if (SUCCESS_RETURN != iotx_subdevice_common_reply_proc(gateway, recv_payload, (iotx_gateway_publish_t)type) &&
+                IOTX_GATEWAY_PUBLISH_REGISTER == type) {
             return ERROR_SUBDEV_REPLY_PROC;
-    }
-
-    /* unregister_reply */
-    HAL_Snprintf(topic,
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_SUB_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "unregister_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-      (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-        iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_UNREGISTER);
-        return SUCCESS_RETURN;
-    }
-
-    /* todo_add_reply */
-    HAL_Snprintf(topic,
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_TOPO_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "add_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-      (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-        iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_TOPO_ADD);
+        }
         return SUCCESS_RETURN;
-    }      
-      
-    /* todo_delete_reply */
-    HAL_Snprintf(topic,
-          GATEWAY_TOPIC_LEN_MAX, 
-          TOPIC_SESSION_TOPO_FMT, 
-          pdevice_info->product_key, 
-          pdevice_info->device_name, 
-          "delete_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-    (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-      iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_TOPO_DELETE);
-      return SUCCESS_RETURN;
-    }
-
-    /* todo_get_reply */
-    HAL_Snprintf(topic,
-          GATEWAY_TOPIC_LEN_MAX, 
-          TOPIC_SESSION_TOPO_FMT, 
-          pdevice_info->product_key, 
-          pdevice_info->device_name, 
-          "get_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-    (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-      iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_TOPO_GET);
-      return SUCCESS_RETURN;
-    }
-
-    /* config_get_reply */
-    HAL_Snprintf(topic,
-          GATEWAY_TOPIC_LEN_MAX, 
-          TOPIC_SESSION_CONFIG_FMT, 
-          pdevice_info->product_key, 
-          pdevice_info->device_name, 
-          "get_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-    (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-      iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_CONFIG_GET);
-      return SUCCESS_RETURN;
-    }
-
-    /* list_found_reply */
-    HAL_Snprintf(topic,
-          GATEWAY_TOPIC_LEN_MAX, 
-          TOPIC_SESSION_LIST_FOUND_FMT, 
-          pdevice_info->product_key, 
-          pdevice_info->device_name, 
-          "found_reply");
-    if ((strlen(recv_topic) == strlen(topic)) && 
-    (0 == strncmp(recv_topic, topic, strlen(topic)))) {
-      iotx_subdevice_common_reply_proc(gateway, recv_payload, IOTX_GATEWAY_PUBLISH_LIST_FOUND);
-      return SUCCESS_RETURN;
     }
 
-
     /* rrpc request */
-    memset(topic, 0x0, GATEWAY_TOPIC_LEN_MAX);
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SYS_RRPC_FMT, 
-            pdevice_info->product_key,
-            pdevice_info->device_name, 
-            "request");
-    /* note: rrpc topic      /+ */
-    if ((strlen(recv_topic) >= strlen(topic) - 2) && 
-      (0 == strncmp(recv_topic, topic, strlen(topic) - 2))) {   
-        log_info("gateway rrpc callback");        
-        
-        if (gateway->gateway_data.rrpc_callback) {
-            char message_id[200] = {0};
-            if (SUCCESS_RETURN == iotx_parse_rrpc_message_id(recv_topic, message_id, 20)) {
-                gateway->gateway_data.rrpc_callback((void*)gateway, 
-                                            pdevice_info->product_key, 
-                                            pdevice_info->device_name, 
-                                            message_id, 
-                                            recv_payload);        
-            }
+    log_info("gateway rrpc callback");        
+    
+    if (gateway->gateway_data.rrpc_callback) {
+        char message_id[IOTX_GATEWAY_RRPC_ID_LEN_MAX + 1] = {0};
+        if (0 <= iotx_parse_rrpc_message_id(recv_topic, message_id)) {
+            iotx_gateway_rrpc_dispatch(gateway,
+                    gateway->gateway_data.rrpc_callback, 
+                    gateway->product_key, 
+                    gateway->device_name, 
+                    message_id, 
+                    recv_payload);        
         }
-        else
-            log_info("there is no gateway rrpc callback, please call IOT_RRPC_Register with gateway's device_cloud_id first");
-        
-        return SUCCESS_RETURN;
-    }     
-      
-    return ERROR_SUBDEV_REPLY_TOPIC_NOT_MATCH;
+    }
+    else
+        log_info("there is no gateway rrpc callback, please call IOT_RRPC_Register with gateway's device_cloud_id first");
+    
+    return SUCCESS_RETURN;
 }
 
         
@@ -455,7 +584,6 @@ static int iotx_gateway_recv_publish_callbacks(iotx_gateway_pt gateway,
 static void iotx_mqtt_reconnect_callback(iotx_gateway_pt gateway)
 {    
     iotx_subdevice_session_pt session = NULL;
-    iotx_subdevice_session_pt next_session = NULL;
     
     if (NULL == gateway) {
         log_info("param error");
@@ -464,29 +592,37 @@ static void iotx_mqtt_reconnect_callback(iotx_gateway_pt gateway)
     
     log_info("iotx_mqtt_reconnect_callback"); 
 
-    session = gateway->session_list;
+    gateway->restore.session_present = 0;
+#ifndef SUBDEV_VIA_CLOUD_CONN
+    /* the subscriptions of a session the server kept are in place, only a new session needs them again */
+    if (1 == IOT_MQTT_SessionPresent(gateway->mqtt)) {
+        log_info("session present, default topics still subscribed");
+        gateway->restore.session_present = 1;
+    } else if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_default(gateway, 1)) {
+        log_err("resubscribe default topic failed");
+    }
+#endif
 
-    while (session) {
-    #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-        HAL_MutexLock(session->lock_status);
-    #endif
-        session->session_status = IOTX_SUBDEVICE_SEESION_STATUS_INIT;
-    #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-        HAL_MutexUnlock(session->lock_status);
-    #endif
-        next_session = session->next;
-        if (SUCCESS_RETURN != IOT_Subdevice_Login(gateway,
-                                session->product_key, 
-                                session->device_name, 
-                                session->timestamp,
-                                session->client_id,
-                                session->sign,
-                                session->sign_method,
-                                session->clean_session)) {
-            log_info("reconnect, %s re_login error", session->device_cloud_id);
+    /* logged in, or on the way there when the connection broke; IOT_Gateway_Yield() sends the batches */
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_session);
+#endif
+    for (session = gateway->session_list; session; session = session->next) {
+        if (IOTX_SUBDEVICE_SEESION_STATUS_LOGIN == session->session_status ||
+                IOTX_SUBDEVICE_SEESION_STATUS_INIT == session->session_status ||
+                IOTX_SUBDEVICE_SEESION_STATUS_RESTORE == session->session_status) {
+            iotx_subdevice_set_session_status(gateway, session, IOTX_SUBDEVICE_SEESION_STATUS_RESTORE);
         }
-        session = next_session;
     }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_session);
+#endif
+
+    gateway->restore.generation++;
+    gateway->restore.active = 1;
+    gateway->restore.in_flight = 0;
+    gateway->restore.restored = 0;
+    gateway->restore.failed = 0;
 }
 
 
@@ -496,8 +632,8 @@ static int iotx_subdevice_parse_register_reply(        char* message,
         const char* device_name,
         char* device_secret)
 {
-    char* node = NULL;
     char* data = message;
+    lite_json_view_t views[] = { { "productKey" }, { "deviceName" }, { "deviceSecret" } };
 
     /* check parameter */
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(data, ERROR_SUBDEV_STRING_NULL_VALUE);
@@ -509,44 +645,33 @@ static int iotx_subdevice_parse_register_reply(        char* message,
     if (data[0] == '[')
         data++;   
 
-    /* product key */
-    node = LITE_json_value_of("productKey", data);
-    if (node == NULL) { 
+    /* product key, device name and device secret in one pass */
+    LITE_json_values_of(data, strlen(data), views, sizeof(views) / sizeof(views[0]));
+    if (views[0].value == NULL) { 
         log_err("get id of json error!");
         return ERROR_SUBDEV_GET_JSON_VAL;
     }
-    if (0 != strncmp(node, product_key, strlen(product_key))) {
-        LITE_free(node);
+    if (0 != strncmp(views[0].value, product_key, strlen(product_key))) {
         log_err("productkey error!");
         return ERROR_SUBDEV_REPLY_VAL_CHECK;
     }
 
     /* device name */
-    LITE_free(node);
-    node = NULL;
-    node = LITE_json_value_of("deviceName", data);
-    if (node == NULL) { 
+    if (views[1].value == NULL) { 
         log_err("get id of json error!");
         return ERROR_SUBDEV_GET_JSON_VAL;
     }    
-    if (0 != strncmp(node, device_name, strlen(device_name))) {
-        LITE_free(node);
+    if (0 != strncmp(views[1].value, device_name, strlen(device_name))) {
         log_err("deviceName error!");
         return ERROR_SUBDEV_REPLY_VAL_CHECK;
     }
     
     /* device secret */    
-    LITE_free(node);
-    node = NULL;
-    node = LITE_json_value_of("deviceSecret", data);
-    if (node == NULL) { 
+    if (views[2].value == NULL) { 
         log_err("get id of json error!");
         return ERROR_SUBDEV_GET_JSON_VAL;
     }   
-    strncpy(device_secret, node, strlen(node));   
-
-    LITE_free(node);
-    node = NULL;
+    strncpy(device_secret, views[2].value, views[2].value_len);   
     
     return SUCCESS_RETURN;
 }
@@ -568,11 +693,18 @@ void iotx_gateway_event_handle(void *pcontext, void *pclient, iotx_mqtt_event_ms
     switch (msg->event_type) {
         case IOTX_MQTT_EVENT_SUBCRIBE_SUCCESS:
         case IOTX_MQTT_EVENT_UNSUBCRIBE_SUCCESS:
+            if (iotx_gateway_sync_batch_ack(gateway, (int)packet_id, 1)) {
+                return;
+            }
         #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
             HAL_MutexLock(gateway->gateway_data.lock_sync);
         #endif
             if (gateway->gateway_data.sync_status == packet_id) {
                 gateway->gateway_data.sync_status = 0;
+            #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+                HAL_SemaphorePost(gateway->gateway_data.sem_sync);
+                HAL_MutexUnlock(gateway->gateway_data.lock_sync);
+            #endif
                 return;
             }
         #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
@@ -584,11 +716,18 @@ void iotx_gateway_event_handle(void *pcontext, void *pclient, iotx_mqtt_event_ms
         case IOTX_MQTT_EVENT_UNSUBCRIBE_TIMEOUT:
         case IOTX_MQTT_EVENT_SUBCRIBE_NACK:
         case IOTX_MQTT_EVENT_UNSUBCRIBE_NACK:
+            if (iotx_gateway_sync_batch_ack(gateway, (int)packet_id, 0)) {
+                return;
+            }
         #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
             HAL_MutexLock(gateway->gateway_data.lock_sync);
         #endif
             if (gateway->gateway_data.sync_status == packet_id) {
                 gateway->gateway_data.sync_status = -1;
+            #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+                HAL_SemaphorePost(gateway->gateway_data.sem_sync);
+                HAL_MutexUnlock(gateway->gateway_data.lock_sync);
+            #endif
                 return;
             }        
         #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
@@ -665,6 +804,92 @@ void iotx_gateway_event_handle(void *pcontext, void *pclient, iotx_mqtt_event_ms
 
     return;
 }
+
+/* the events of a shard, the user sees the same ones as of the gateway's own connection */
+static void iotx_gateway_shard_event_handle(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    iotx_gateway_shard_pt shard = (iotx_gateway_shard_pt)pcontext;
+    iotx_gateway_pt gateway = shard->gateway;
+    iotx_gateway_shard_sub_pt sub = NULL;
+
+    switch (msg->event_type) {
+        case IOTX_MQTT_EVENT_RECONNECT:
+            if (1 == IOT_MQTT_SessionPresent(shard->mqtt)) {
+                return;
+            }
+            log_info("shard %d reconnected, subscribe again", (int)(shard - gateway->shard) + 1);
+        #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+            HAL_MutexLock(gateway->gateway_data.lock_shard);
+        #endif
+            for (sub = shard->subs; NULL != sub; sub = sub->next) {
+                if (IOT_MQTT_Subscribe(shard->mqtt, sub->topic_filter, sub->qos,
+                                       (iotx_mqtt_event_handle_func_fpt)sub->handle_func, sub->pcontext) < 0) {
+                    log_err("subscribe %s again failed", sub->topic_filter);
+                }
+            }
+        #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+            HAL_MutexUnlock(gateway->gateway_data.lock_shard);
+        #endif
+            return;
+
+        case IOTX_MQTT_EVENT_SUBCRIBE_SUCCESS:
+        case IOTX_MQTT_EVENT_UNSUBCRIBE_SUCCESS:
+        case IOTX_MQTT_EVENT_SUBCRIBE_TIMEOUT:
+        case IOTX_MQTT_EVENT_UNSUBCRIBE_TIMEOUT:
+        case IOTX_MQTT_EVENT_SUBCRIBE_NACK:
+        case IOTX_MQTT_EVENT_UNSUBCRIBE_NACK:
+        case IOTX_MQTT_EVENT_PUBLISH_RECVEIVED:
+            break;
+
+        default:
+            return;
+    }
+
+    if (gateway->event_handler) {
+        gateway->event_handler(gateway->event_pcontext, pclient, msg);
+    }
+}
+
+static int iotx_gateway_shard_construct(iotx_gateway_pt gateway, iotx_gateway_shard_pt shard, 
+        iotx_mqtt_param_pt mqtt_param)
+{
+    shard->gateway = gateway;
+    mqtt_param->handle_event.h_fp = iotx_gateway_shard_event_handle;
+    mqtt_param->handle_event.pcontext = shard;
+
+#ifndef MQTT_ID2_AUTH
+    shard->mqtt = IOT_MQTT_Construct(mqtt_param);
+#else
+    shard->mqtt = IOT_MQTT_ConstructSecure(mqtt_param);
+#endif /**< MQTT_ID2_AUTH*/
+
+    return (NULL == shard->mqtt) ? FAIL_RETURN : SUCCESS_RETURN;
+}
+
+static void iotx_gateway_shard_destroy(iotx_gateway_shard_pt shard)
+{
+    iotx_gateway_shard_sub_pt sub = NULL;
+
+    if (NULL != shard->mqtt) {
+        IOT_MQTT_Destroy(&shard->mqtt);
+    }
+    while (NULL != (sub = shard->subs)) {
+        shard->subs = sub->next;
+        LITE_free(sub);
+    }
+}
+
+/* the connection a publish of the topic goes over, the gateway's own one while the shard is down */
+static void* iotx_gateway_publish_mqtt(iotx_gateway_pt gateway, const char* topic)
+{
+    iotx_gateway_shard_pt shard = iotx_gateway_shard_of(gateway, topic);
+
+    if (NULL != shard && IOT_MQTT_CheckStateNormal(shard->mqtt)) {
+        return shard->mqtt;
+    }
+
+    return gateway->mqtt;
+}
 #endif
 
 /* global message id */
@@ -685,34 +910,49 @@ void* IOT_Gateway_Construct(iotx_gateway_param_pt gateway_param)
     iotx_cloud_connection_param_t param = {0};
     iotx_device_info_pt pdevice_info = iotx_device_info_get();
 #endif
+    iotx_gateway_pt gateway = NULL;
     
     PARAMETER_NULL_CHECK_WITH_RESULT(gateway_param, NULL);
     PARAMETER_NULL_CHECK_WITH_RESULT(gateway_param->mqtt, NULL);
 
-    if (g_gateway_subdevice_t->is_construct) {
-        log_err("gateway have been construct");
+    if (NULL == (gateway = LITE_malloc(sizeof(iotx_gateway_t)))) {
+        log_err("Not enough memory");
         return NULL;
     }
-
-    memset(g_gateway_subdevice_t, 0x0, sizeof(iotx_gateway_t));
+    memset(gateway, 0x0, sizeof(iotx_gateway_t));
+    strncpy(gateway->product_key, (NULL != gateway_param->product_key) ? 
+            gateway_param->product_key : iotx_device_info_get()->product_key, PRODUCT_KEY_LEN);
+    strncpy(gateway->device_name, (NULL != gateway_param->device_name) ? 
+            gateway_param->device_name : iotx_device_info_get()->device_name, DEVICE_NAME_LEN);
+    utils_timer_wheel_init(&gateway->pending_wheel, IOTX_GATEWAY_PENDING_TICK_MS, HAL_UptimeMs());
+    gateway->packet_len_max = gateway_param->mqtt->write_buf_size;
     
 #ifndef SUBDEV_VIA_CLOUD_CONN       
+    if (gateway_param->shard_num < 0 || gateway_param->shard_num > IOTX_GATEWAY_SHARD_NUM_MAX ||
+        (0 < gateway_param->shard_num && NULL == gateway_param->shard_mqtt)) {
+        log_err("shard_num should be 0 to %d", IOTX_GATEWAY_SHARD_NUM_MAX);
+        LITE_free(gateway);
+        return NULL;
+    }
+
     gateway_param->mqtt->handle_event.h_fp = iotx_gateway_event_handle;
-    gateway_param->mqtt->handle_event.pcontext = g_gateway_subdevice_t;
+    gateway_param->mqtt->handle_event.pcontext = gateway;
 
     /* construct MQTT client */
 #ifndef MQTT_ID2_AUTH
-    if (NULL == (g_gateway_subdevice_t->mqtt = IOT_MQTT_Construct(gateway_param->mqtt))) {
+    if (NULL == (gateway->mqtt = IOT_MQTT_Construct(gateway_param->mqtt))) {
 #else
-	if (NULL == (g_gateway_subdevice_t->mqtt = IOT_MQTT_ConstructSecure(gateway_param->mqtt))) {
+	if (NULL == (gateway->mqtt = IOT_MQTT_ConstructSecure(gateway_param->mqtt))) {
 #endif /**< MQTT_ID2_AUTH*/
         log_err("construct MQTT failed");
+        LITE_free(gateway);
         return NULL;
     }
 #else /* SUBDEV_VIA_CLOUD_CONN */      
     param.device_info = LITE_malloc(sizeof(iotx_deviceinfo_t));
     if (NULL == param.device_info) {
         log_info("memory error!");    
+        LITE_free(gateway);
         return NULL;
     }
     memset(param.device_info, 0x00, sizeof(iotx_device_info_t));
@@ -726,66 +966,240 @@ void* IOT_Gateway_Construct(iotx_gateway_param_pt gateway_param)
     param.request_timeout_ms = gateway_param->mqtt->request_timeout_ms;
     param.protocol_type = IOTX_CLOUD_CONNECTION_PROTOCOL_TYPE_MQTT;
     param.event_handler = _event_handle;
-    param.event_pcontext = (void*)g_gateway_subdevice_t;
+    param.event_pcontext = (void*)gateway;
 
     handle = IOT_Cloud_Connection_Init(&param);
 
     if (handle == NULL) {   
+        LITE_free(gateway);
         return NULL;
     }
 
-    g_gateway_subdevice_t->mqtt = handle;
+    gateway->mqtt = handle;
 #endif /* SUBDEV_VIA_CLOUD_CONN */
 
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-    g_gateway_subdevice_t->gateway_data.lock_sync = HAL_MutexCreate();
-    g_gateway_subdevice_t->gateway_data.lock_sync_enter = HAL_MutexCreate();
-    if (NULL == g_gateway_subdevice_t->gateway_data.lock_sync || 
-        NULL == g_gateway_subdevice_t->gateway_data.lock_sync_enter)
+    gateway->gateway_data.lock_sync = HAL_MutexCreate();
+    gateway->gateway_data.lock_sync_enter = HAL_MutexCreate();
+    gateway->gateway_data.lock_pending = HAL_MutexCreate();
+    gateway->gateway_data.lock_session = HAL_MutexCreate();
+    gateway->gateway_data.lock_pack = HAL_MutexCreate();
+    gateway->gateway_data.lock_shard = HAL_MutexCreate();
+    if (NULL == gateway->gateway_data.lock_sync || 
+        NULL == gateway->gateway_data.lock_sync_enter ||
+        NULL == gateway->gateway_data.lock_pending ||
+        NULL == gateway->gateway_data.lock_session ||
+        NULL == gateway->gateway_data.lock_pack ||
+        NULL == gateway->gateway_data.lock_shard)
     {
         log_err("create mutex error");
         return NULL;
     }
+    if (SUCCESS_RETURN != iotx_gateway_sync_init(gateway)) {
+        log_err("create semaphore error");
+        return NULL;
+    }
+    iotx_gateway_rrpc_worker_start(gateway);
 #endif
     
     /* handle mqtt event for user */
-    g_gateway_subdevice_t->event_handler = gateway_param->event_handler;
-    g_gateway_subdevice_t->event_pcontext = gateway_param->event_pcontext;
-
-    /* subscribe default topic */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_default(g_gateway_subdevice_t, 1)) {
+    gateway->event_handler = gateway_param->event_handler;
+    gateway->event_pcontext = gateway_param->event_pcontext;
+    gateway->restore.handler = gateway_param->restore_handler;
+    gateway->restore.pcontext = gateway_param->restore_pcontext;
+    gateway->pack.len_limit = (0 == gateway_param->pack_len_max) ? 
+            IOTX_GATEWAY_PACK_LEN_MAX : gateway_param->pack_len_max;
+    gateway->pack.latency_ms = (0 == gateway_param->pack_latency_ms) ? 
+            IOTX_GATEWAY_PACK_LATENCY_MS : gateway_param->pack_latency_ms;
+    gateway->found.len_limit = gateway->pack.len_limit;
+    gateway->found.latency_ms = gateway->pack.latency_ms;
+
+    /* subscribe default topic, a gateway that fails it is destroyed as a constructed one */
+    gateway->is_construct = 1;
+#ifndef SUBDEV_VIA_CLOUD_CONN
+    for (gateway->shard_num = 0; gateway->shard_num < gateway_param->shard_num; gateway->shard_num++) {
+        if (SUCCESS_RETURN != iotx_gateway_shard_construct(gateway, &gateway->shard[gateway->shard_num], 
+                                    &gateway_param->shard_mqtt[gateway->shard_num])) {
+            log_err("construct MQTT of shard %d failed", gateway->shard_num + 1);
+            IOT_Gateway_Destroy((void**)&gateway); 
+            return NULL;
+        }
+    }
+#endif
+    if (FAIL_RETURN == iotx_gateway_default_topic_init(gateway, 
+                            gateway->product_key,
+                            gateway->device_name) ||
+        FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_default(gateway, 1)) {
         log_err("subscribe default topic fialed");
-        IOT_Gateway_Destroy((void**)&g_gateway_subdevice_t); 
+        IOT_Gateway_Destroy((void**)&gateway); 
         return NULL;
     }
 
-    g_gateway_subdevice_t->is_construct = 1;
-
-    return g_gateway_subdevice_t;
+    return gateway;
 }
 
 
-/* Register: static and dynamic */    
-int IOT_Subdevice_Register(void* handle, 
-        iotx_subdev_register_types_t type, 
+/* a dynamically registered subdevice keeps its sign in the session, registering it again
+ * needs neither the secret nor the HMAC, only the topo add */
+static iotx_subdevice_session_pt iotx_subdevice_registered_session(iotx_gateway_pt gateway,
         const char* product_key, 
         const char* device_name,
-        char* timestamp, 
-        char* client_id, 
-        char* sign,
         iotx_subdev_sign_method_types_t sign_type)
-{    
-    uint32_t msg_id = 0;
-    int rc = 0;
-    char* packet = NULL;
-    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
-    char device_secret[DEVICE_SECRET_LEN] = {0};
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
-    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
-    iotx_subdevice_session_pt session = NULL;
+{
+    iotx_subdevice_session_pt session = iotx_subdevice_find_session(gateway, product_key, device_name);
 
-    /* parameter check */
-    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    if (NULL == session || 
+            !iotx_subdevice_get_session_dynamic_register(session) ||
+            sign_type != session->sign_method ||
+            '\0' == session->sign[0]) {
+        return NULL;
+    }
+
+    return session;
+}
+
+/* the session of a dynamically registered subdevice, signed with the secret in the register reply */
+static int iotx_subdevice_register_session(iotx_gateway_pt gateway,
+        const char* product_key, 
+        const char* device_name,
+        char* register_message,
+        iotx_subdev_sign_method_types_t sign_type,
+        iotx_subdevice_session_pt* psession)
+{
+    int rc = 0;
+    char timestamp[20] = {0};
+    char client_id[IOT_SUBDEVICE_CLIENT_ID_LEN] = {0};
+    char sign[41] = {0};
+    char device_secret[DEVICE_SECRET_LEN] = {0};
+    iotx_subdevice_session_pt session = NULL;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(register_message, ERROR_SUBDEV_GET_JSON_VAL);
+
+    /* a second reply of the same subdevice */
+    if (NULL != (session = iotx_subdevice_registered_session(gateway, product_key, device_name, sign_type))) {
+        *psession = session;
+        return SUCCESS_RETURN;
+    }
+
+    if (SUCCESS_RETURN != (rc = iotx_subdevice_parse_register_reply(register_message,
+                             product_key, 
+                             device_name, 
+                             device_secret))) {
+        log_info("parse register reply error");
+        return rc;
+    }        
+    //log_info("register success, secret %s", device_secret);
+    
+    /* timestamp */
+    strncpy(timestamp, "2524608000000", strlen("2524608000000") + 1);
+   
+    /* client id */
+    iotx_subdevice_calc_client_id(client_id, product_key, device_name);     
+
+    /* sign */  
+    if (FAIL_RETURN == (rc = iotx_gateway_calc_sign(product_key,
+                            device_name,
+                            device_secret,
+                            sign, 
+                            41,
+                            sign_type,
+                            client_id,
+                            timestamp))) {
+        log_err("sign fail");
+        return rc;
+    }                
+
+    if (NULL == (session = iotx_subdevice_add_session(gateway,
+                                product_key, 
+                                device_name, 
+                                sign,
+                                timestamp,
+                                client_id,
+                                sign_type,
+                                IOTX_SUBDEV_CLEAN_SESSION_FALSE))) {
+        log_err("create session error!");
+        return ERROR_SUBDEV_CREATE_SESSION_FAIL;
+    }    
+    iotx_subdevice_set_session_status(gateway, session, IOTX_SUBDEVICE_SEESION_STATUS_REGISTER);
+    iotx_subdevice_set_session_dynamic_register(session);
+
+    *psession = session;
+    return SUCCESS_RETURN;
+}
+
+static char* iotx_subdevice_register_packet(iotx_gateway_pt gateway, 
+        const char* product_key, 
+        const char* device_name,
+        char* topic,
+        uint32_t* msg_id)
+{
+    /* topic */
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_REGISTER, topic);
+
+    /* packet */    
+    return iotx_gateway_splice_common_packet(product_key,
+                device_name,
+                "thing.sub.register",
+                msg_id);
+}
+
+static char* iotx_subdevice_topo_add_packet(iotx_gateway_pt gateway, 
+        const char* product_key, 
+        const char* device_name,
+        const char* timestamp, 
+        const char* client_id, 
+        const char* sign,
+        iotx_subdev_sign_method_types_t sign_type,
+        char* topic,
+        uint32_t* msg_id)
+{
+    /* topic */
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_TOPO_ADD, topic);
+                            
+    /* topo packet */
+    if (sign_type == IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA) {
+        return iotx_gateway_splice_topo_add_packet(product_key, 
+                        device_name, 
+                        client_id,
+                        timestamp,  
+                        "hmacsha1", 
+                        sign, 
+                        "thing.topo.add",
+                        msg_id);
+    } else if (sign_type == IOTX_SUBDEV_SIGN_METHOD_TYPE_MD5) {
+        return iotx_gateway_splice_topo_add_packet(product_key, 
+                        device_name, 
+                        client_id,
+                        timestamp,  
+                        "hmacmd5", 
+                        sign, 
+                        "thing.topo.add",
+                        msg_id);
+    }
+
+    return NULL;
+}
+
+
+/* Register: static and dynamic */    
+int IOT_Subdevice_Register(void* handle, 
+        iotx_subdev_register_types_t type, 
+        const char* product_key, 
+        const char* device_name,
+        char* timestamp, 
+        char* client_id, 
+        char* sign,
+        iotx_subdev_sign_method_types_t sign_type)
+{    
+    uint32_t msg_id = 0;
+    int rc = 0;
+    char* packet = NULL;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+    iotx_subdevice_session_pt session = NULL;
+
+    /* parameter check */
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, ERROR_SUBDEV_STRING_NULL_VALUE);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
     /* check register type */
@@ -795,6 +1209,15 @@ int IOT_Subdevice_Register(void* handle,
         return ERROR_SUBDEV_REGISTER_TYPE_NOT_DEF;
     }
 
+    /* dynamic, signed already */
+    if (IOTX_SUBDEV_REGISTER_TYPE_DYNAMIC == type && 
+            NULL != (session = iotx_subdevice_registered_session(gateway, product_key, device_name, sign_type))) {
+        type = IOTX_SUBDEV_REGISTER_TYPE_STATIC;
+        timestamp = session->timestamp;
+        client_id = session->client_id;
+        sign = session->sign;
+    }
+
     /* dynamic: get device secret first */
     /* sync wait for response */
     if (IOTX_SUBDEV_REGISTER_TYPE_DYNAMIC == type) {
@@ -803,20 +1226,7 @@ int IOT_Subdevice_Register(void* handle,
             return ERROR_SUBDEV_NOT_NULL_VALUE;
         }                
 
-        /* topic */
-        HAL_Snprintf(topic, 
-                GATEWAY_TOPIC_LEN_MAX, 
-                TOPIC_SESSION_SUB_FMT, 
-                pdevice_info->product_key, 
-                pdevice_info->device_name, 
-                "register");
-    
-        /* packet */    
-        packet = iotx_gateway_splice_common_packet(product_key,
-                            device_name,
-                            "thing.sub.register",
-                            &msg_id);
-                
+        packet = iotx_subdevice_register_packet(gateway, product_key, device_name, topic, &msg_id);
         if (packet == NULL) {
             log_err("login packet splice error!");
             return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
@@ -836,53 +1246,24 @@ int IOT_Subdevice_Register(void* handle,
         }
                 
         LITE_free(packet);  
+        packet = NULL;
                                 
-        if (SUCCESS_RETURN != (rc = iotx_subdevice_parse_register_reply(gateway->gateway_data.register_message,
+        rc = iotx_subdevice_register_session(gateway,
                                  product_key, 
                                  device_name, 
-                                 device_secret))) {
-            log_info("parse register reply error");
+                                 gateway->gateway_data.register_message,
+                                 sign_type,
+                                 &session);
+        if (NULL != gateway->gateway_data.register_message) {
+            LITE_free(gateway->gateway_data.register_message);
+        }
+        if (SUCCESS_RETURN != rc) {
             return rc;
         }        
-        //log_info("register success, secret %s", device_secret);
-        
-        /* timestamp */
-        MALLOC_MEMORY_WITH_RESULT(timestamp, 20, FAIL_RETURN);
-        strncpy(timestamp, "2524608000000", strlen("2524608000000") + 1);
-       
-        /* client id */
-        MALLOC_MEMORY_WITH_FREE_AND_RESULT(client_id, IOT_SUBDEVICE_CLIENT_ID_LEN, timestamp, FAIL_RETURN);
-        iotx_subdevice_calc_client_id(client_id, product_key, device_name);     
-
-        /* sign */  
-        MALLOC_MEMORY_WITH_FREE_AND_RESULT(sign, 41, timestamp, FAIL_RETURN);    
-        if (FAIL_RETURN == (rc = iotx_gateway_calc_sign(product_key,
-                                device_name,
-                                device_secret,
-                                sign, 
-                                41,
-                                sign_type,
-                                client_id,
-                                timestamp))) {
-            log_err("sign fail");
-            goto exit;
-        }                
 
-        if (NULL == (session = iotx_subdevice_add_session(gateway,
-                                    product_key, 
-                                    device_name, 
-                                    NULL, 
-                                    sign,
-                                    timestamp,
-                                    client_id,
-                                    sign_type,
-                                    IOTX_SUBDEV_CLEAN_SESSION_FALSE))) {
-            log_err("create session error!");
-            rc = ERROR_SUBDEV_CREATE_SESSION_FAIL;
-            goto exit;
-        }    
-        iotx_subdevice_set_session_status(session, IOTX_SUBDEVICE_SEESION_STATUS_REGISTER);
-        iotx_subdevice_set_session_dynamic_register(session);
+        timestamp = session->timestamp;
+        client_id = session->client_id;
+        sign = session->sign;
     } 
 
     /* check parameter */
@@ -894,68 +1275,125 @@ int IOT_Subdevice_Register(void* handle,
     if (sign_type != IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA && 
             sign_type != IOTX_SUBDEV_SIGN_METHOD_TYPE_MD5) {
         log_info("register type not support");
-        rc = ERROR_SUBDEV_REGISTER_TYPE_NOT_DEF;
-        goto exit;
+        return ERROR_SUBDEV_REGISTER_TYPE_NOT_DEF;
     }
 
     /* topo add */   
-    /* topic */
-    memset(topic, 0x0, GATEWAY_TOPIC_LEN_MAX);
-    HAL_Snprintf(topic,
-            GATEWAY_TOPIC_LEN_MAX,
-            TOPIC_SESSION_TOPO_FMT,
-            pdevice_info->product_key,
-            pdevice_info->device_name,
-            "add");  
-                            
-    /* topo packet */
-    if (sign_type == IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA) {
-        packet = iotx_gateway_splice_topo_add_packet(product_key, 
-                        device_name, 
-                        client_id,
-                        timestamp,  
-                        "hmacsha1", 
-                        sign, 
-                        "thing.topo.add",
-                        &msg_id);
-    } else if (sign_type == IOTX_SUBDEV_SIGN_METHOD_TYPE_MD5) {
-        packet = iotx_gateway_splice_topo_add_packet(product_key, 
-                        device_name, 
-                        client_id,
-                        timestamp,  
-                        "hmacmd5", 
-                        sign, 
-                        "thing.topo.add",
-                        &msg_id);
-    }
-    
+    packet = iotx_subdevice_topo_add_packet(gateway, 
+                    product_key, 
+                    device_name, 
+                    timestamp,
+                    client_id,
+                    sign,
+                    sign_type,
+                    topic,
+                    &msg_id);
     if (packet == NULL) {
         log_err("login packet splice error!");
-        rc = ERROR_SUBDEV_PACKET_SPLICE_FAIL;
-        goto exit;
+        return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
     }        
     
     /* publish packet */
-    if (SUCCESS_RETURN != (rc = iotx_gateway_publish_sync(gateway,
+    rc = iotx_gateway_publish_sync(gateway,
             IOTX_MQTT_QOS0, 
             topic, 
             packet, 
             msg_id, 
             &(gateway->gateway_data.topo_add_reply),
-            IOTX_GATEWAY_PUBLISH_TOPO_ADD))) {
-        goto exit;
+            IOTX_GATEWAY_PUBLISH_TOPO_ADD);
+
+    LITE_free(packet);    
+
+    return rc;
+}
+
+/* Register without waiting: the topo add, after the register reply when dynamic, completes it */
+int IOT_Subdevice_Register_Async(void* handle, 
+        iotx_subdev_register_types_t type, 
+        const char* product_key, 
+        const char* device_name,
+        const char* timestamp, 
+        const char* client_id, 
+        const char* sign,
+        iotx_subdev_sign_method_types_t sign_type,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext)
+{    
+    uint32_t msg_id = 0;
+    int rc = 0;
+    char* packet = NULL;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+    iotx_subdevice_session_pt session = NULL;
+    iotx_gateway_publish_t publish_type;
+
+    /* parameter check */
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_NULL_CHECK_WITH_RESULT(callback, ERROR_SUBDEV_NULL_VALUE);
+
+    /* check sign type */
+    if (sign_type != IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA && 
+            sign_type != IOTX_SUBDEV_SIGN_METHOD_TYPE_MD5) {
+        log_info("register type not support");
+        return ERROR_SUBDEV_REGISTER_TYPE_NOT_DEF;
+    }
+
+    /* dynamic, signed already */
+    if (IOTX_SUBDEV_REGISTER_TYPE_DYNAMIC == type && 
+            NULL != (session = iotx_subdevice_registered_session(gateway, product_key, device_name, sign_type))) {
+        type = IOTX_SUBDEV_REGISTER_TYPE_STATIC;
+        timestamp = session->timestamp;
+        client_id = session->client_id;
+        sign = session->sign;
     }
 
-exit: 
-    if (packet)
-        LITE_free(packet);    
-    
     if (IOTX_SUBDEV_REGISTER_TYPE_DYNAMIC == type) {
-        LITE_free(timestamp);
-        LITE_free(client_id);
-        LITE_free(sign);
+        if (NULL != timestamp && NULL != client_id && NULL != sign) {
+            log_info("parameter error, if dynamic register, timestamp = client_id = sign = NULL");
+            return ERROR_SUBDEV_NOT_NULL_VALUE;
+        }                
+        packet = iotx_subdevice_register_packet(gateway, product_key, device_name, topic, &msg_id);
+        publish_type = IOTX_GATEWAY_PUBLISH_REGISTER;
+    } else if (IOTX_SUBDEV_REGISTER_TYPE_STATIC == type) {
+        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(timestamp, FAIL_RETURN);
+        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(client_id, FAIL_RETURN);
+        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(sign, FAIL_RETURN);
+        packet = iotx_subdevice_topo_add_packet(gateway, 
+                    product_key, 
+                        device_name, 
+                        timestamp,
+                        client_id,
+                        sign,
+                        sign_type,
+                        topic,
+                        &msg_id);
+        publish_type = IOTX_GATEWAY_PUBLISH_TOPO_ADD;
+    } else {
+        log_info("register type not support");
+        return ERROR_SUBDEV_REGISTER_TYPE_NOT_DEF;
     }
 
+    if (packet == NULL) {
+        log_err("register packet splice error!");
+        return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+    }        
+
+    rc = iotx_gateway_publish_async(gateway,
+            IOTX_MQTT_QOS0, 
+            topic, 
+            packet, 
+            msg_id, 
+            publish_type,
+            product_key,
+            device_name,
+            sign_type,
+            callback,
+            pcontext);
+
+    LITE_free(packet);    
+
     return rc;
 }
 
@@ -965,7 +1403,6 @@ int IOT_Subdevice_Unregister(void* handle,
         const char* device_name)
 {
     uint32_t msg_id = 0;
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
     iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
     char* packet = NULL;
     char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
@@ -978,12 +1415,7 @@ int IOT_Subdevice_Unregister(void* handle,
 
     /* unregister */
     /* topic */
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_SUB_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "unregister");
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_UNREGISTER, topic);
 
     /* splice unregister packet */
     packet = iotx_gateway_splice_common_packet(product_key, 
@@ -1011,12 +1443,7 @@ int IOT_Subdevice_Unregister(void* handle,
 
     /* topo delete */
     /* topic */
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_TOPO_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "delete");
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_TOPO_DELETE, topic);
 
     /* splice logout packet */
     packet = iotx_gateway_splice_common_packet(product_key, 
@@ -1044,12 +1471,7 @@ int IOT_Subdevice_Unregister(void* handle,
             
     /* unregister */
     /* topic */
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_SUB_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "unregister");
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_UNREGISTER, topic);
 
     /* splice unregister packet */
     packet = iotx_gateway_splice_common_packet(product_key, 
@@ -1079,29 +1501,20 @@ int IOT_Subdevice_Unregister(void* handle,
 }
 
 
-int IOT_Subdevice_Login(void* handle, 
+/* the session to log in and its LOGIN packet, a session created for it is removed on failure */
+/* finds or creates the session to log in, and the sign to log in with */
+static int iotx_subdevice_login_session(iotx_gateway_pt gateway, 
         const char* product_key, 
         const char* device_name, 
-        const char* timestamp, 
-        const char* client_id, 
-        const char* sign, 
-        iotx_subdev_sign_method_types_t sign_method_type,
-        iotx_subdev_clean_session_types_t clean_session_type)
+        const char** timestamp, 
+        const char** client_id, 
+        const char** sign, 
+        iotx_subdev_sign_method_types_t* sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type,
+        iotx_subdevice_session_pt* psession)
 {
-	int rc = 0;
-    uint32_t msg_id = 0;
-    char * login_packet = NULL;
-    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
-    char sign_method[10] = {0};
-    char clean_session[10] = {0};
     iotx_subdevice_session_pt session = NULL;
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
-    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
 
-    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, ERROR_SUBDEV_STRING_NULL_VALUE);
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
-    
     /* check sign method */            
     if (clean_session_type != IOTX_SUBDEV_CLEAN_SESSION_TRUE && 
             clean_session_type != IOTX_SUBDEV_CLEAN_SESSION_FALSE) {
@@ -1114,19 +1527,18 @@ int IOT_Subdevice_Login(void* handle,
                                 device_name))) {
         log_info("there is no seesion, create a new session");
     
-        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(sign, FAIL_RETURN);
-        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(client_id, FAIL_RETURN);
-        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(timestamp, FAIL_RETURN);
+        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(*sign, FAIL_RETURN);
+        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(*client_id, FAIL_RETURN);
+        PARAMETER_STRING_NULL_CHECK_WITH_RESULT(*timestamp, FAIL_RETURN);
         
         /* create subdev session */
         if (NULL == (session = iotx_subdevice_add_session(gateway,
                                     product_key, 
                                     device_name, 
-                                    NULL, 
-                                    sign,
-                                    timestamp,
-                                    client_id,
-                                    sign_method_type,
+                                    *sign,
+                                    *timestamp,
+                                    *client_id,
+                                    *sign_method_type,
                                     clean_session_type))) {
             log_err("create session error!");
             return ERROR_SUBDEV_CREATE_SESSION_FAIL;
@@ -1138,24 +1550,54 @@ int IOT_Subdevice_Login(void* handle,
         }
     }
 
-    /* topic */
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_COMBINE_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "login");
-
-    if (IOTX_SUBDEVICE_SEESION_STATUS_REGISTER == session->session_status) {
-        sign = session->sign;
-        sign_method_type = session->sign_method;
-        client_id = session->client_id;
-        timestamp = session->timestamp;        
+    if (IOTX_SUBDEVICE_SEESION_STATUS_REGISTER == session->session_status ||
+            IOTX_SUBDEVICE_SEESION_STATUS_RESTORE == session->session_status) {
+        *sign = session->sign;
+        *sign_method_type = session->sign_method;
+        *client_id = session->client_id;
+        *timestamp = session->timestamp;        
     }
     
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(sign, ERROR_SUBDEV_STRING_NULL_VALUE);
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(client_id, ERROR_SUBDEV_STRING_NULL_VALUE);
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(timestamp, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(*sign, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(*client_id, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(*timestamp, ERROR_SUBDEV_STRING_NULL_VALUE);
+
+    *psession = session;
+
+    return SUCCESS_RETURN;
+}
+
+static int iotx_subdevice_login_packet(iotx_gateway_pt gateway, 
+        const char* product_key, 
+        const char* device_name, 
+        const char* timestamp, 
+        const char* client_id, 
+        const char* sign, 
+        iotx_subdev_sign_method_types_t sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type,
+        char* topic,
+        char** packet,
+        uint32_t* msg_id)
+{
+    int rc = 0;
+    char sign_method[10] = {0};
+    char clean_session[10] = {0};
+    iotx_subdevice_session_pt session = NULL;
+
+    if (SUCCESS_RETURN != (rc = iotx_subdevice_login_session(gateway,
+                                    product_key,
+                                    device_name,
+                                    &timestamp,
+                                    &client_id,
+                                    &sign,
+                                    &sign_method_type,
+                                    clean_session_type,
+                                    &session))) {
+        return rc;
+    }
+
+    /* topic */
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_LOGIN, topic);
     
     if (sign_method_type == IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA) {
         strncpy(sign_method, "hmacsha1", strlen("hmacsha1"));
@@ -1170,153 +1612,1090 @@ int IOT_Subdevice_Login(void* handle,
     }
     
     /* packet */    
-    login_packet = iotx_gateway_splice_login_packet(session->product_key,
+    *packet = iotx_gateway_splice_login_packet(session->product_key,
                         session->device_name,
                         client_id, 
                         timestamp, 
                         sign_method,
                         sign,      
                         clean_session,
-                        &msg_id);
+                        msg_id);
             
     
-    if (login_packet == NULL) {
+    if (*packet == NULL) {
         log_err("login packet splice error!");
         iotx_subdevice_remove_session(gateway, session->product_key, session->device_name);
         return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
     }
 
-    /* publish packet */
-    if (SUCCESS_RETURN != (rc = iotx_gateway_publish_sync(gateway,
-            IOTX_MQTT_QOS0, 
-            topic, 
-            login_packet, 
-            msg_id, 
-            &(gateway->gateway_data.login_reply),
-            IOTX_GATEWAY_PUBLISH_LOGIN))) {
-        LITE_free(login_packet);
+    return SUCCESS_RETURN;
+}
+
+/* LOGIN accepted: the session is logged in and gets its rrpc requests,
+ * async replies are handled inside IOT_Gateway_Yield and must not wait for the SUBACK */
+static int iotx_subdevice_login_done(iotx_gateway_pt gateway, iotx_subdevice_session_pt session, int wait)
+{
+    iotx_subdevice_set_session_status(gateway, session, IOTX_SUBDEVICE_SEESION_STATUS_LOGIN);
+
+    /* subscribe rrpc request */
+    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_rrpc(gateway, session, 1, wait)) {
         iotx_subdevice_remove_session(gateway, session->product_key, session->device_name);
+        return ERROR_SUBDEV_SUB_UNSUB_FAIL;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+/* a failed login keeps the session of a dynamically registered subdevice, a retry reuses its sign,
+ * as well as one not restored after a reconnect */
+static void iotx_subdevice_login_failed(iotx_gateway_pt gateway, 
+        const char* product_key, 
+        const char* device_name)
+{
+    iotx_subdevice_session_pt session = iotx_subdevice_find_session(gateway, product_key, device_name);
+
+    if (NULL != session && IOTX_SUBDEVICE_SEESION_STATUS_RESTORE == session->session_status) {
+        iotx_subdevice_set_session_status(gateway, session, IOTX_SUBDEVICE_SEESION_STATUS_REGISTER);
+        return;
+    }
+
+    if (NULL != session && 
+            iotx_subdevice_get_session_dynamic_register(session) &&
+            IOTX_SUBDEVICE_SEESION_STATUS_REGISTER == session->session_status) {
+        return;
+    }
+
+    iotx_subdevice_remove_session(gateway, product_key, device_name);
+}
+
+int IOT_Subdevice_Login(void* handle, 
+        const char* product_key, 
+        const char* device_name, 
+        const char* timestamp, 
+        const char* client_id, 
+        const char* sign, 
+        iotx_subdev_sign_method_types_t sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type)
+{
+	int rc = 0;
+    uint32_t msg_id = 0;
+    char * login_packet = NULL;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
+    iotx_subdevice_session_pt session = NULL;
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
+    
+    if (SUCCESS_RETURN != (rc = iotx_subdevice_login_packet(gateway,
+                                    product_key, 
+                                    device_name, 
+                                    timestamp,
+                                    client_id,
+                                    sign,
+                                    sign_method_type,
+                                    clean_session_type,
+                                    topic,
+                                    &login_packet,
+                                    &msg_id))) {
+        return rc;
+    }
+
+    /* publish packet */
+    if (SUCCESS_RETURN != (rc = iotx_gateway_publish_sync(gateway,
+            IOTX_MQTT_QOS0, 
+            topic, 
+            login_packet, 
+            msg_id, 
+            &(gateway->gateway_data.login_reply),
+            IOTX_GATEWAY_PUBLISH_LOGIN))) {
+        LITE_free(login_packet);
+        iotx_subdevice_login_failed(gateway, product_key, device_name);
         log_err("MQTT Publish error!");
         return rc;
     }
-            
-    LITE_free(login_packet);   
-                   
+            
+    LITE_free(login_packet);   
+                   
+    if (NULL == (session = iotx_subdevice_find_session(gateway, product_key, device_name))) {
+        return ERROR_SUBDEV_SESSION_NOT_FOUND;
+    }
+
+    return iotx_subdevice_login_done(gateway, session, 1);
+}
+
+int IOT_Subdevice_Login_Async(void* handle, 
+        const char* product_key, 
+        const char* device_name, 
+        const char* timestamp, 
+        const char* client_id, 
+        const char* sign, 
+        iotx_subdev_sign_method_types_t sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext)
+{
+	int rc = 0;
+    uint32_t msg_id = 0;
+    char * login_packet = NULL;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_NULL_CHECK_WITH_RESULT(callback, ERROR_SUBDEV_NULL_VALUE);
+    
+    if (SUCCESS_RETURN != (rc = iotx_subdevice_login_packet(gateway,
+                                    product_key, 
+                                    device_name, 
+                                    timestamp,
+                                    client_id,
+                                    sign,
+                                    sign_method_type,
+                                    clean_session_type,
+                                    topic,
+                                    &login_packet,
+                                    &msg_id))) {
+        return rc;
+    }
+
+    if (SUCCESS_RETURN != (rc = iotx_gateway_publish_async(gateway,
+            IOTX_MQTT_QOS0, 
+            topic, 
+            login_packet, 
+            msg_id, 
+            IOTX_GATEWAY_PUBLISH_LOGIN,
+            product_key,
+            device_name,
+            sign_method_type,
+            callback,
+            pcontext))) {
+        iotx_subdevice_login_failed(gateway, product_key, device_name);
+        log_err("MQTT Publish error!");
+    }
+            
+    LITE_free(login_packet);   
+
+    return rc;
+}
+
+
+/* unsubscribe the rrpc requests of a logged in session and splice its LOGOUT packet */
+static int iotx_subdevice_logout_packet(iotx_gateway_pt gateway, 
+        const char * product_key, 
+        const char * device_name,
+        char* topic,
+        char** packet,
+        uint32_t* msg_id,
+        int wait)
+{
+    iotx_subdevice_session_pt session = NULL;
+        
+    session = iotx_subdevice_find_session(gateway, product_key, device_name);
+    if (NULL == session) {
+        log_info("no session, can not logout");
+        return ERROR_SUBDEV_SESSION_NOT_FOUND;
+    }
+
+    if (IOTX_SUBDEVICE_SEESION_STATUS_LOGIN != session->session_status) {
+        log_info("status is not login, can not logout");
+        iotx_subdevice_remove_session(gateway, product_key, device_name);
+        return ERROR_SUBDEV_SESSION_STATE_FAIL;
+    }
+    
+    /* unsubscribe rrpc request */
+    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_rrpc(gateway, session, 0, wait)) {
+        return ERROR_SUBDEV_SUB_UNSUB_FAIL;
+    }            
+
+    /* topic */
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_LOGOUT, topic);
+
+    /* splice logout packet */
+    *packet = iotx_gateway_splice_logout_packet(session->product_key, 
+                            session->device_name, 
+                            msg_id);
+    if (*packet == NULL) {
+        log_err("logout packet splice error!");
+        return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+/* LOGOUT accepted: the session is gone */
+static void iotx_subdevice_logout_done(iotx_gateway_pt gateway, iotx_subdevice_session_pt session)
+{
+    iotx_subdevice_set_session_status(gateway, session, IOTX_SUBDEVICE_SEESION_STATUS_LOGOUT);
+
+    /* free session */
+    iotx_subdevice_remove_session(gateway, session->product_key, session->device_name);
+}
+
+int IOT_Subdevice_Logout(void* handle, 
+        const char * product_key, 
+        const char * device_name)
+{
+	int rc = 0;
+    uint32_t msg_id = 0;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
+    iotx_subdevice_session_pt session = NULL;
+    char* logout_packet = NULL;
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+    
+    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
+
+    if (SUCCESS_RETURN != (rc = iotx_subdevice_logout_packet(gateway,
+                                    product_key,
+                                    device_name,
+                                    topic,
+                                    &logout_packet,
+                                    &msg_id,
+                                    1))) {
+        return rc;
+    }
+
+    if (SUCCESS_RETURN != (rc = iotx_gateway_publish_sync(gateway,
+            IOTX_MQTT_QOS0, 
+            topic, 
+            logout_packet, 
+            msg_id, 
+            &(gateway->gateway_data.logout_reply),
+            IOTX_GATEWAY_PUBLISH_LOGIN))) {
+        LITE_free(logout_packet);
+        log_err("MQTT Publish error!");
+        return rc;
+    }
+
+    LITE_free(logout_packet); 
+    
+    if (NULL != (session = iotx_subdevice_find_session(gateway, product_key, device_name))) {
+        iotx_subdevice_logout_done(gateway, session);
+    }
+
+    return SUCCESS_RETURN;
+}
+
+int IOT_Subdevice_Logout_Async(void* handle, 
+        const char * product_key, 
+        const char * device_name,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext)
+{
+	int rc = 0;
+    uint32_t msg_id = 0;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
+    char* logout_packet = NULL;
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+    
+    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
+    PARAMETER_NULL_CHECK_WITH_RESULT(callback, FAIL_RETURN);
+
+    if (SUCCESS_RETURN != (rc = iotx_subdevice_logout_packet(gateway,
+                                    product_key,
+                                    device_name,
+                                    topic,
+                                    &logout_packet,
+                                    &msg_id,
+                                    0))) {
+        return rc;
+    }
+
+    rc = iotx_gateway_publish_async(gateway,
+            IOTX_MQTT_QOS0, 
+            topic, 
+            logout_packet, 
+            msg_id, 
+            IOTX_GATEWAY_PUBLISH_LOGOUT,
+            product_key,
+            device_name,
+            IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA,
+            callback,
+            pcontext);
+
+    LITE_free(logout_packet); 
+
+    return rc;
+}
+
+
+/* counts the packets of a batch call whose requests completed */
+static void iotx_subdevice_batch_reply(void* gateway, 
+        const char* product_key, 
+        const char* device_name, 
+        int result, 
+        void* pcontext)
+{
+    (*(int*)pcontext)++;
+}
+
+/* the room for the batch packet in the write buffer of the client, 0 if there is none */
+static uint32_t iotx_subdevice_batch_len_max(iotx_gateway_pt gateway, const char* topic)
+{
+    /* the packet and the fixed header, topic and packet id of PUBLISH fit in the write buffer */
+    if (gateway->packet_len_max <= strlen(topic) + 8) {
+        log_err("MQTT write buffer too small");
+        return 0;
+    }
+
+    return gateway->packet_len_max - strlen(topic) - 8;
+}
+
+/* the devices from items[*next] on that fit in one packet get IOTX_SUBDEV_BATCH_RESULT_SENT,
+ * *next is the first one of the next packet. NULL when none could be spliced */
+static char* iotx_subdevice_batch_packet(iotx_gateway_pt gateway, 
+        iotx_gateway_publish_t type,
+        iotx_subdev_batch_item_pt items,
+        int count,
+        int* next,
+        uint32_t len_max,
+        uint32_t* msg_id,
+        iotx_subdev_sign_method_types_t sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type)
+{
+    int i = *next, entries = 0;
+    char* packet = NULL;
+    const char* method = NULL;
+    const char* clean_session = NULL;
+    const char* timestamp = NULL;
+    const char* client_id = NULL;
+    const char* sign = NULL;
+    iotx_subdev_sign_method_types_t sign_type;
+    iotx_subdevice_session_pt session = NULL;
+
+    if (IOTX_GATEWAY_PUBLISH_LOGIN == type) {
+        clean_session = (IOTX_SUBDEV_CLEAN_SESSION_TRUE == clean_session_type) ? "true" : "false";
+    } else {
+        method = "thing.topo.add";
+    }
+
+    if (NULL == (packet = iotx_gateway_splice_batch_begin(len_max, msg_id))) {
+        return NULL;
+    }
+
+    /* as many devices as fit */
+    for (; i < count; i++) {
+        timestamp = items[i].timestamp;
+        client_id = items[i].client_id;
+        sign = items[i].sign;
+        sign_type = sign_method_type;
+
+        if (NULL == items[i].product_key || '\0' == items[i].product_key[0] 
+                || NULL == items[i].device_name || '\0' == items[i].device_name[0]) {
+            items[i].result = ERROR_SUBDEV_STRING_NULL_VALUE;
+        } else if (IOTX_GATEWAY_PUBLISH_LOGIN == type) {
+            items[i].result = iotx_subdevice_login_session(gateway,
+                                    items[i].product_key,
+                                    items[i].device_name,
+                                    &timestamp,
+                                    &client_id,
+                                    &sign,
+                                    &sign_type,
+                                    clean_session_type,
+                                    &session);
+        } else if (NULL == timestamp || NULL == client_id || NULL == sign) {
+            items[i].result = ERROR_SUBDEV_STRING_NULL_VALUE;
+        } else {
+            items[i].result = SUCCESS_RETURN;
+        }
+        if (SUCCESS_RETURN != items[i].result) {
+            continue;
+        }
+
+        if (SUCCESS_RETURN != iotx_gateway_splice_batch_entry(packet, 
+                                    len_max,
+                                    items[i].product_key,
+                                    items[i].device_name,
+                                    client_id,
+                                    timestamp,
+                                    (IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA == sign_type) ? "hmacsha1" : "hmacmd5",
+                                    sign,
+                                    clean_session,
+                                    method)) {
+            if (entries) {
+                /* the first of the next packet */
+                break;
+            }
+            log_err("%s.%s does not fit in a packet", items[i].product_key, items[i].device_name);
+            items[i].result = ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+            if (IOTX_GATEWAY_PUBLISH_LOGIN == type) {
+                iotx_subdevice_login_failed(gateway, items[i].product_key, items[i].device_name);
+            }
+            continue;
+        }
+
+        items[i].result = IOTX_SUBDEV_BATCH_RESULT_SENT;
+        entries++;
+    }
+    *next = i;
+
+    if (0 == entries || SUCCESS_RETURN != iotx_gateway_splice_batch_end(packet, len_max, method)) {
+        LITE_free(packet);
+        return NULL;
+    }
+
+    return packet;
+}
+
+static int iotx_subdevice_batch(iotx_gateway_pt gateway, 
+        iotx_gateway_publish_t type,
+        iotx_subdev_batch_item_pt items,
+        int count,
+        iotx_subdev_sign_method_types_t sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type)
+{
+    int rc = 0;
+    int i = 0, first = 0, entries = 0, sent = 0, done = 0, succeeded = 0;
+    uint32_t msg_id = 0;
+    uint32_t len_max = 0;
+    char* packet = NULL;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+
+    /* topic */
+    iotx_gateway_request_topic(gateway, type, topic);
+
+    if (0 == (len_max = iotx_subdevice_batch_len_max(gateway, topic))) {
+        return FAIL_RETURN;
+    }
+
+    while (i < count) {
+        first = i;
+        if (NULL == (packet = iotx_subdevice_batch_packet(gateway, 
+                                    type,
+                                    items,
+                                    count,
+                                    &i,
+                                    len_max,
+                                    &msg_id,
+                                    sign_method_type,
+                                    clean_session_type))) {
+            if (first == i) {
+                /* out of memory */
+                break;
+            }
+            continue;
+        }
+
+        rc = iotx_gateway_publish_batch_async(gateway,
+                    IOTX_MQTT_QOS0,
+                    topic,
+                    packet,
+                    msg_id,
+                    type,
+                    &items[first],
+                    i - first,
+                    iotx_subdevice_batch_reply,
+                    &done);
+        /* the table of requests is full of our own packets, wait for one of them */
+        while (ERROR_SUBDEV_MEMORY_NOT_ENOUGH == rc && done < sent) {
+            entries = done;
+            while (entries == done) {
+                IOT_Gateway_Yield(gateway, 200);
+            }
+            rc = iotx_gateway_publish_batch_async(gateway,
+                        IOTX_MQTT_QOS0,
+                        topic,
+                        packet,
+                        msg_id,
+                        type,
+                        &items[first],
+                        i - first,
+                        iotx_subdevice_batch_reply,
+                        &done);
+        }
+        LITE_free(packet);
+
+        if (SUCCESS_RETURN == rc) {
+            sent++;
+            continue;
+        }
+
+        for (; first < i; first++) {
+            if (IOTX_SUBDEV_BATCH_RESULT_SENT != items[first].result) {
+                continue;
+            }
+            items[first].result = rc;
+            if (IOTX_GATEWAY_PUBLISH_LOGIN == type) {
+                iotx_subdevice_login_failed(gateway, items[first].product_key, items[first].device_name);
+            }
+        }
+    }
+
+    /* devices of no packet, out of memory */
+    for (; i < count; i++) {
+        items[i].result = ERROR_SUBDEV_MEMORY_NOT_ENOUGH;
+    }
+
+    /* timeouts complete the packets with no reply */
+    while (done < sent) {
+        IOT_Gateway_Yield(gateway, 200);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (SUCCESS_RETURN == items[i].result) {
+            succeeded++;
+        }
+    }
+
+    log_info("batch of %d devices in %d packets, %d succeeded", count, sent, succeeded);
+
+    return succeeded;
+}
+
+int IOT_Subdevice_Register_Batch(void* handle, 
+        iotx_subdev_batch_item_pt items,
+        int count,
+        iotx_subdev_sign_method_types_t sign_type)
+{
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    PARAMETER_NULL_CHECK_WITH_RESULT(items, ERROR_SUBDEV_NULL_VALUE);
+
+    /* check sign type */
+    if (sign_type != IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA && 
+            sign_type != IOTX_SUBDEV_SIGN_METHOD_TYPE_MD5) {
+        log_info("register type not support");
+        return ERROR_SUBDEV_REGISTER_TYPE_NOT_DEF;
+    }
+
+    return iotx_subdevice_batch(gateway, 
+                IOTX_GATEWAY_PUBLISH_TOPO_ADD,
+                items,
+                count,
+                sign_type,
+                IOTX_SUBDEV_CLEAN_SESSION_FALSE);
+}
+
+int IOT_Subdevice_Login_Batch(void* handle,
+        iotx_subdev_batch_item_pt items,
+        int count,
+        iotx_subdev_sign_method_types_t sign_method_type,
+        iotx_subdev_clean_session_types_t clean_session_type)
+{
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    PARAMETER_NULL_CHECK_WITH_RESULT(items, ERROR_SUBDEV_NULL_VALUE);
+
+    return iotx_subdevice_batch(gateway, 
+                IOTX_GATEWAY_PUBLISH_LOGIN,
+                items,
+                count,
+                sign_method_type,
+                clean_session_type);
+}
+
+
+/* the devices of a restore packet, the names are copied as the sessions may go meanwhile */
+typedef struct {
+    uint32_t                            generation;
+    int                                 count;
+    iotx_subdev_batch_item_pt           items;
+    char                               (*device_name)[DEVICE_NAME_LEN];
+} iotx_gateway_restore_packet_t, *iotx_gateway_restore_packet_pt;
+
+static int iotx_gateway_restore_current(iotx_gateway_pt gateway, iotx_gateway_restore_packet_pt restore_packet)
+{
+    return gateway->restore.active && restore_packet->generation == gateway->restore.generation;
+}
+
+static void iotx_gateway_restore_report(iotx_gateway_pt gateway, iotx_subdev_batch_item_pt item)
+{
+    if (SUCCESS_RETURN == item->result) {
+        gateway->restore.restored++;
+    } else {
+        gateway->restore.failed++;
+        log_info("%s.%s not restored, code:%d", item->product_key, item->device_name, item->result);
+    }
+
+    if (gateway->restore.handler) {
+        gateway->restore.handler((void*)gateway, item->product_key, item->device_name, 
+                item->result, gateway->restore.pcontext);
+    }
+}
+
+/* a device of a restore packet: logged in, or left registered; a packet of an earlier reconnect changes nothing */
+static void iotx_gateway_restore_item_done(iotx_gateway_pt gateway, 
+        iotx_gateway_pending_pt pending,
+        iotx_subdev_batch_item_pt item,
+        int result)
+{
+    iotx_subdevice_session_pt session = NULL;
+
+    item->result = result;
+
+    if (!iotx_gateway_restore_current(gateway, (iotx_gateway_restore_packet_pt)pending->pcontext)) {
+        return;
+    }
+
+    session = iotx_subdevice_find_session(gateway, item->product_key, item->device_name);
+    if (NULL == session || IOTX_SUBDEVICE_SEESION_STATUS_INIT != session->session_status) {
+        /* logged out, or logged in by the application meanwhile */
+        item->result = (NULL == session) ? ERROR_SUBDEV_SESSION_NOT_FOUND : item->result;
+        return;
+    }
+
+    iotx_subdevice_set_session_status(gateway, session, (SUCCESS_RETURN == result) ? 
+            IOTX_SUBDEVICE_SEESION_STATUS_LOGIN : IOTX_SUBDEVICE_SEESION_STATUS_REGISTER);
+}
+
+/* the rrpc topics of the restored devices of a packet, with no wait for the acknowledgements */
+static void iotx_gateway_restore_subscribe(iotx_gateway_pt gateway, iotx_gateway_restore_packet_pt restore_packet)
+{
+    int i;
+    int num = 0;
+    const char* topics[IOTX_GATEWAY_RESTORE_BATCH_NUM];
+    iotx_subdevice_session_pt session = NULL;
+
+    for (i = 0; i < restore_packet->count; i++) {
+        if (SUCCESS_RETURN != restore_packet->items[i].result || 
+                NULL == (session = iotx_subdevice_find_session(gateway, 
+                                        restore_packet->items[i].product_key, 
+                                        restore_packet->items[i].device_name))) {
+            continue;
+        }
+#ifndef SUBDEV_VIA_CLOUD_CONN
+        /* the filter the client was given at the first login */
+        if ('\0' != session->rrpc_topic[0]) {
+            topics[num++] = session->rrpc_topic;
+            continue;
+        }
+#endif
+        if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_rrpc(gateway, session, 1, 0)) {
+            log_err("%s.%s resubscribe rrpc error", session->product_key, session->device_name);
+        }
+    }
+
+#ifndef SUBDEV_VIA_CLOUD_CONN
+    if (num > 0) {
+        i = IOT_MQTT_SubscribeMulti(gateway->mqtt,
+                    topics,
+                    num,
+                    IOTX_MQTT_QOS0,
+                    (iotx_mqtt_event_handle_func_fpt)iotx_gateway_event_handle,
+                    gateway,
+                    NULL);
+        if (i < num) {
+            log_err("%d of %d rrpc topics not resubscribed", (i < 0) ? num : num - i, num);
+        }
+    }
+#else
+    (void)topics;
+    (void)num;
+#endif
+}
+
+static void iotx_gateway_restore_reply(void* gateway, 
+        const char* product_key, 
+        const char* device_name, 
+        int result, 
+        void* pcontext)
+{
+    int i;
+    iotx_gateway_pt pgateway = (iotx_gateway_pt)gateway;
+    iotx_gateway_restore_packet_pt restore_packet = (iotx_gateway_restore_packet_pt)pcontext;
+
+    if (iotx_gateway_restore_current(pgateway, restore_packet)) {
+        if (!pgateway->restore.session_present) {
+            iotx_gateway_restore_subscribe(pgateway, restore_packet);
+        }
+        for (i = 0; i < restore_packet->count; i++) {
+            iotx_gateway_restore_report(pgateway, &restore_packet->items[i]);
+        }
+        pgateway->restore.in_flight--;
+    }
+
+    LITE_free(restore_packet);
+}
+
+/* up to IOTX_GATEWAY_RESTORE_BATCH_NUM sessions to restore with the same clean session, NULL if there are none */
+static iotx_gateway_restore_packet_pt iotx_gateway_restore_collect(iotx_gateway_pt gateway, 
+        iotx_subdev_clean_session_types_t* clean_session)
+{
+    int num = 0;
+    iotx_subdevice_session_pt session = NULL;
+    iotx_subdevice_session_pt sessions[IOTX_GATEWAY_RESTORE_BATCH_NUM];
+    iotx_gateway_restore_packet_pt restore_packet = NULL;
+
+    /* the names are copied before another thread can remove the sessions */
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-    HAL_MutexLock(session->lock_status);
+    HAL_MutexLock(gateway->gateway_data.lock_session);
 #endif
-    session->session_status = IOTX_SUBDEVICE_SEESION_STATUS_LOGIN;
+    for (session = gateway->session_list; session && num < IOTX_GATEWAY_RESTORE_BATCH_NUM; session = session->next) {
+        if (IOTX_SUBDEVICE_SEESION_STATUS_RESTORE != session->session_status ||
+                (num > 0 && *clean_session != session->clean_session)) {
+            continue;
+        }
+        *clean_session = session->clean_session;
+        sessions[num++] = session;
+    }
+
+    if (0 == num) {
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-    HAL_MutexUnlock(session->lock_status);
+        HAL_MutexUnlock(gateway->gateway_data.lock_session);
 #endif
+        return NULL;
+    }
 
-    /* subscribe rrpc request */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-            session->product_key, 
-            session->device_name,
-            TOPIC_SYS_RRPC_FMT,  
-            "request",
-            1)) {
-        iotx_subdevice_remove_session(gateway, session->product_key, session->device_name);
-        return ERROR_SUBDEV_SUB_UNSUB_FAIL;
+    restore_packet = LITE_malloc(sizeof(iotx_gateway_restore_packet_t) + 
+                            num * (sizeof(iotx_subdev_batch_item_t) + DEVICE_NAME_LEN));
+    if (NULL == restore_packet) {
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_session);
+#endif
+        log_err("Not enough memory");
+        return NULL;
     }
+    memset(restore_packet, 0x0, sizeof(iotx_gateway_restore_packet_t) + 
+                            num * (sizeof(iotx_subdev_batch_item_t) + DEVICE_NAME_LEN));
+    restore_packet->generation = gateway->restore.generation;
+    restore_packet->count = num;
+    restore_packet->items = (iotx_subdev_batch_item_pt)(restore_packet + 1);
+    restore_packet->device_name = (char (*)[DEVICE_NAME_LEN])(restore_packet->items + num);
 
-    return SUCCESS_RETURN;
-}
+    for (num = 0; num < restore_packet->count; num++) {
+        strncpy(restore_packet->device_name[num], sessions[num]->device_name, DEVICE_NAME_LEN - 1);
+        restore_packet->items[num].product_key = sessions[num]->product_key;
+        restore_packet->items[num].device_name = restore_packet->device_name[num];
+    }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_session);
+#endif
 
+    return restore_packet;
+}
 
-int IOT_Subdevice_Logout(void* handle, 
-        const char * product_key, 
-        const char * device_name)
+/* batched logins of the sessions to restore, IOTX_GATEWAY_RESTORE_WINDOW packets in flight at most */
+static void iotx_gateway_restore_send(iotx_gateway_pt gateway)
 {
-	int rc = 0;
+    int rc = 0;
+    int i = 0, next = 0, sent = 0;
     uint32_t msg_id = 0;
-    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
+    uint32_t len_max = 0;
+    char* packet = NULL;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
     iotx_subdevice_session_pt session = NULL;
-    char* logout_packet = NULL;
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
-    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
-    
-    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
-        
-    session = iotx_subdevice_find_session(gateway, product_key, device_name);
-    if (NULL == session) {
-        log_info("no session, can not logout");
-        return ERROR_SUBDEV_SESSION_NOT_FOUND;
+    iotx_gateway_restore_packet_pt restore_packet = NULL;
+    iotx_subdev_clean_session_types_t clean_session = IOTX_SUBDEV_CLEAN_SESSION_FALSE;
+
+    if (!gateway->restore.active) {
+        return;
     }
 
-    if (IOTX_SUBDEVICE_SEESION_STATUS_LOGIN != session->session_status) {
-        log_info("status is not login, can not logout");
-        iotx_subdevice_remove_session(gateway, product_key, device_name);
-        return ERROR_SUBDEV_SESSION_STATE_FAIL;
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_LOGIN, topic);
+    len_max = iotx_subdevice_batch_len_max(gateway, topic);
+    if (0 == len_max) {
+        /* no login fits in the write buffer, the sessions are left registered */
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexLock(gateway->gateway_data.lock_session);
+#endif
+        for (session = gateway->session_list; session; session = session->next) {
+            if (IOTX_SUBDEVICE_SEESION_STATUS_RESTORE == session->session_status) {
+                iotx_subdevice_set_session_status(gateway, session, IOTX_SUBDEVICE_SEESION_STATUS_REGISTER);
+                gateway->restore.failed++;
+            }
+        }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_session);
+#endif
     }
-    
-    /* unsubscribe rrpc request */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-            session->product_key, 
-            session->device_name,
-            TOPIC_SYS_RRPC_FMT,  
-            "request",
-            0)){
-        return ERROR_SUBDEV_SUB_UNSUB_FAIL;
-    }            
 
-    /* topic */
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_COMBINE_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "logout");
+    while (gateway->restore.in_flight < IOTX_GATEWAY_RESTORE_WINDOW) {
+        if (NULL == (restore_packet = iotx_gateway_restore_collect(gateway, &clean_session))) {
+            break;
+        }
 
-    /* splice logout packet */
-    logout_packet = iotx_gateway_splice_logout_packet(session->product_key, 
-                            session->device_name, 
-                            &msg_id);
-    if (logout_packet == NULL) {
-        log_err("logout packet splice error!");
-        return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
-    }
+        next = 0;
+        packet = iotx_subdevice_batch_packet(gateway, 
+                    IOTX_GATEWAY_PUBLISH_LOGIN,
+                    restore_packet->items,
+                    restore_packet->count,
+                    &next,
+                    len_max,
+                    &msg_id,
+                    IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA,
+                    clean_session);
+        if (0 == next) {
+            /* no memory, a later yield tries again */
+            LITE_free(restore_packet);
+            break;
+        }
 
-    /* publish logout packet */
-    iotx_mqtt_topic_info_t topic_msg;
-    memset(&topic_msg, 0x0, sizeof(iotx_mqtt_topic_info_t));
+        /* the devices in the packet first, the ones that failed are reported now */
+        for (i = 0, sent = 0; i < next; i++) {
+            if (IOTX_SUBDEV_BATCH_RESULT_SENT == restore_packet->items[i].result) {
+                restore_packet->items[sent++] = restore_packet->items[i];
+            } else {
+                iotx_gateway_restore_report(gateway, &restore_packet->items[i]);
+            }
+        }
+        restore_packet->count = sent;
 
-    topic_msg.qos = IOTX_MQTT_QOS0;
-    topic_msg.retain = 0;
-    topic_msg.dup = 0;
-    topic_msg.payload = (void *)logout_packet;
-    topic_msg.payload_len = strlen(logout_packet);
-    topic_msg.packet_id = 0;
+        if (NULL == packet) {
+            LITE_free(restore_packet);
+            continue;
+        }
 
-    if (SUCCESS_RETURN != (rc = iotx_gateway_publish_sync(gateway,
-            IOTX_MQTT_QOS0, 
-            topic, 
-            logout_packet, 
-            msg_id, 
-            &(gateway->gateway_data.logout_reply),
-            IOTX_GATEWAY_PUBLISH_LOGIN))) {
-        LITE_free(logout_packet);
-        log_err("MQTT Publish error!");
-        return rc;
+        rc = iotx_gateway_publish_batch_async(gateway,
+                    IOTX_MQTT_QOS0,
+                    topic,
+                    packet,
+                    msg_id,
+                    IOTX_GATEWAY_PUBLISH_LOGIN,
+                    restore_packet->items,
+                    restore_packet->count,
+                    iotx_gateway_restore_reply,
+                    restore_packet);
+        LITE_free(packet);
+
+        if (ERROR_SUBDEV_MEMORY_NOT_ENOUGH == rc) {
+            /* the table of requests is full, the sessions are still to restore */
+            LITE_free(restore_packet);
+            break;
+        }
+
+        for (i = 0; i < restore_packet->count; i++) {
+            if (SUCCESS_RETURN != rc) {
+                restore_packet->items[i].result = rc;
+                iotx_subdevice_login_failed(gateway, restore_packet->items[i].product_key, 
+                        restore_packet->items[i].device_name);
+                iotx_gateway_restore_report(gateway, &restore_packet->items[i]);
+            } else if (NULL != (session = iotx_subdevice_find_session(gateway, 
+                                restore_packet->items[i].product_key, 
+                                restore_packet->items[i].device_name))) {
+                /* in flight */
+                iotx_subdevice_set_session_status(gateway, session, IOTX_SUBDEVICE_SEESION_STATUS_INIT);
+            }
+        }
+
+        if (SUCCESS_RETURN != rc) {
+            LITE_free(restore_packet);
+            continue;
+        }
+        gateway->restore.in_flight++;
     }
 
-    LITE_free(logout_packet); 
-    
+    if (0 != gateway->restore.in_flight) {
+        return;
+    }
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-    HAL_MutexLock(session->lock_status);
+    HAL_MutexLock(gateway->gateway_data.lock_session);
 #endif
-    session->session_status = IOTX_SUBDEVICE_SEESION_STATUS_LOGOUT;
+    for (session = gateway->session_list; session; session = session->next) {
+        if (IOTX_SUBDEVICE_SEESION_STATUS_RESTORE == session->session_status) {
+            break;
+        }
+    }
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-    HAL_MutexUnlock(session->lock_status);
+    HAL_MutexUnlock(gateway->gateway_data.lock_session);
 #endif
+    if (NULL != session) {
+        return;
+    }
 
-    /* free session */
-    iotx_subdevice_remove_session(gateway, session->product_key, session->device_name);
+    log_info("restore done, %d subdevices logged in again, %d not", 
+            gateway->restore.restored, gateway->restore.failed);
+    gateway->restore.active = 0;
+    if (gateway->restore.handler) {
+        gateway->restore.handler((void*)gateway, NULL, NULL, 
+                (0 == gateway->restore.failed) ? SUCCESS_RETURN : FAIL_RETURN, gateway->restore.pcontext);
+    }
+}
 
-    return SUCCESS_RETURN;
+/* 'result' of an asynchronous request from its reply, 'payload' is NULL when it timed out or is cancelled */
+/* the result of a device of a batch packet, a logged in device gets its topics subscribed */
+static void iotx_subdevice_batch_item_done(iotx_gateway_pt gateway, 
+        iotx_gateway_pending_pt pending,
+        iotx_subdev_batch_item_pt item,
+        int result)
+{
+    iotx_subdevice_session_pt session = NULL;
+
+    if (iotx_gateway_restore_reply == pending->callback) {
+        iotx_gateway_restore_item_done(gateway, pending, item, result);
+        return;
+    }
+
+    if (IOTX_GATEWAY_PUBLISH_LOGIN == pending->type) {
+        session = iotx_subdevice_find_session(gateway, item->product_key, item->device_name);
+        if (NULL == session) {
+            result = ERROR_SUBDEV_SESSION_NOT_FOUND;
+        } else if (SUCCESS_RETURN == result) {
+            result = iotx_subdevice_login_done(gateway, session, 0);
+        } else {
+            iotx_subdevice_login_failed(gateway, item->product_key, item->device_name);
+        }
+    }
+
+    if (SUCCESS_RETURN != result) {
+        log_info("%s.%s of batch request %u error!code:%d", item->product_key, item->device_name, pending->id, result);
+    }
+
+    item->result = result;
+}
+
+/* devices listed in "data" of the reply get the code of their entry, the others the code of the reply */
+static void iotx_subdevice_batch_complete(iotx_gateway_pt gateway, 
+        iotx_gateway_pending_pt pending,
+        int result,
+        char* payload)
+{
+    int i;
+    int entry_len = 0, entry_type = 0, pk_len = 0, dn_len = 0, code_len = 0;
+    char* data = NULL;
+    char* pos = NULL;
+    char* entry = NULL;
+    char* pk = NULL;
+    char* dn = NULL;
+    char* code = NULL;
+    iotx_subdev_batch_item_pt item = NULL;
+
+    if (NULL != payload && NULL != (data = LITE_json_value_of("data", payload))) {
+        json_array_for_each_entry(data, (int)strlen(data), pos, entry, entry_len, entry_type) {
+            if (JOBJECT != entry_type) {
+                continue;
+            }
+            pk = json_get_value_by_name(entry, entry_len, "productKey", &pk_len, 0);
+            dn = json_get_value_by_name(entry, entry_len, "deviceName", &dn_len, 0);
+            code = json_get_value_by_name(entry, entry_len, "code", &code_len, 0);
+            if (NULL == pk || NULL == dn) {
+                continue;
+            }
+
+            for (i = 0; i < pending->batch_num; i++) {
+                item = &pending->batch[i];
+                if (IOTX_SUBDEV_BATCH_RESULT_SENT == item->result 
+                        && pk_len == (int)strlen(item->product_key) && 0 == strncmp(pk, item->product_key, pk_len) 
+                        && dn_len == (int)strlen(item->device_name) && 0 == strncmp(dn, item->device_name, dn_len)) {
+                    if (NULL == code) {
+                        iotx_subdevice_batch_item_done(gateway, pending, item, result);
+                    } else {
+                        iotx_subdevice_batch_item_done(gateway, pending, item, 
+                                200 == atoi(code) ? SUCCESS_RETURN : (~atoi(code) + 1));
+                    }
+                    break;
+                }
+            }
+        }
+        LITE_free(data);
+    }
+
+    for (i = 0; i < pending->batch_num; i++) {
+        if (IOTX_SUBDEV_BATCH_RESULT_SENT == pending->batch[i].result) {
+            iotx_subdevice_batch_item_done(gateway, pending, &pending->batch[i], result);
+        }
+    }
+
+    log_info("batch request %u of %d devices done, code:%d", pending->id, pending->batch_num, result);
+
+    pending->callback((void*)gateway, pending->product_key, pending->device_name, result, pending->pcontext);
+    LITE_free(pending);
+}
+
+
+static void iotx_gateway_pending_complete(iotx_gateway_pt gateway, 
+        iotx_gateway_pending_pt pending,
+        int result,
+        char* payload)
+{
+    uint32_t msg_id = 0;
+    char* node = NULL;
+    char* packet = NULL;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+    iotx_subdevice_session_pt session = NULL;
+
+    if (NULL != pending->batch) {
+        iotx_subdevice_batch_complete(gateway, pending, result, payload);
+        return;
+    }
+
+    session = iotx_subdevice_find_session(gateway, pending->product_key, pending->device_name);
+
+    switch (pending->type) {
+        case IOTX_GATEWAY_PUBLISH_REGISTER:
+            if (SUCCESS_RETURN != result) {
+                break;
+            }
+            /* dynamic: the topo add goes on with the secret in the reply */
+            if (NULL == (node = LITE_json_value_of("data", payload))) {
+                log_err("register reply: get data of json error!");
+                result = ERROR_SUBDEV_GET_JSON_VAL;
+                break;
+            }
+            result = iotx_subdevice_register_session(gateway,
+                            pending->product_key,
+                            pending->device_name,
+                            node,
+                            pending->sign_method,
+                            &session);
+            LITE_free(node);
+            if (SUCCESS_RETURN != result) {
+                break;
+            }
+            packet = iotx_subdevice_topo_add_packet(gateway, 
+                            session->product_key, 
+                            session->device_name, 
+                            session->timestamp,
+                            session->client_id,
+                            session->sign,
+                            session->sign_method,
+                            topic,
+                            &msg_id);
+            if (packet == NULL) {
+                log_err("login packet splice error!");
+                result = ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+                break;
+            }        
+            result = iotx_gateway_publish_async(gateway,
+                            IOTX_MQTT_QOS0, 
+                            topic, 
+                            packet, 
+                            msg_id, 
+                            IOTX_GATEWAY_PUBLISH_TOPO_ADD,
+                            pending->product_key,
+                            pending->device_name,
+                            pending->sign_method,
+                            pending->callback,
+                            pending->pcontext);
+            LITE_free(packet);
+            if (SUCCESS_RETURN == result) {
+                LITE_free(pending);
+                return;
+            }
+            break;
+        case IOTX_GATEWAY_PUBLISH_LOGIN:
+            if (NULL == session) {
+                result = ERROR_SUBDEV_SESSION_NOT_FOUND;
+            } else if (SUCCESS_RETURN == result) {
+                result = iotx_subdevice_login_done(gateway, session, 0);
+            } else {
+                iotx_subdevice_login_failed(gateway, pending->product_key, pending->device_name);
+            }
+            break;
+        case IOTX_GATEWAY_PUBLISH_LOGOUT:
+            if (SUCCESS_RETURN == result && NULL != session) {
+                iotx_subdevice_logout_done(gateway, session);
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (SUCCESS_RETURN == result) {
+        log_info("%s.%s request %u successfully", pending->product_key, pending->device_name, pending->id);
+    } else {
+        log_info("%s.%s request %u error!code:%d", pending->product_key, pending->device_name, pending->id, result);
+    }
+
+    pending->callback((void*)gateway, pending->product_key, pending->device_name, result, pending->pcontext);
+    LITE_free(pending);
 }
 
 
@@ -1329,19 +2708,13 @@ int IOT_Gateway_Get_TOPO(void* handle,
     char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
     char* topo_get_packet = NULL;
     iotx_mqtt_topic_info_t topic_msg;
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
     iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
     
     PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
     PARAMETER_NULL_CHECK_WITH_RESULT(get_toop_reply, ERROR_SUBDEV_NULL_VALUE);
     
     /* topic */
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_TOPO_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "get");
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_TOPO_GET, topic);
 
     /* splice topo_get packet */
     topo_get_packet = iotx_gateway_splice_topo_get_packet(&msg_id);
@@ -1374,16 +2747,147 @@ int IOT_Gateway_Get_TOPO(void* handle,
 
     LITE_free(topo_get_packet); 
 
+    if (NULL == gateway->gateway_data.topo_get_message) {
+        log_err("topo_get reply without data");
+        return ERROR_SUBDEV_GET_JSON_VAL;
+    }
+
     if (*length < strlen(gateway->gateway_data.topo_get_message)) {
+        if (NULL != gateway->gateway_data.topo_get_message) {
+            LITE_free(gateway->gateway_data.topo_get_message);
+        }
         log_err("set memory too small");
         return ERROR_SUBDEV_MEMORY_NOT_ENOUGH;
     }
 
-    strncpy(get_toop_reply, gateway->gateway_data.topo_get_message, strlen(gateway->gateway_data.topo_get_message));
+    strncpy(get_toop_reply, gateway->gateway_data.topo_get_message, strlen(gateway->gateway_data.topo_get_message));
+
+    *length = strlen(gateway->gateway_data.topo_get_message);
+    if (NULL != gateway->gateway_data.topo_get_message) {
+        LITE_free(gateway->gateway_data.topo_get_message);
+    }
+            
+    return SUCCESS_RETURN;
+}
+
+/* one page of the topo, its subdevices handed to 'callback' as they are parsed, 
+ * returns the entries of the page or < 0 */
+static int iotx_gateway_get_topo_page(iotx_gateway_pt gateway, 
+        uint32_t page_size,
+        uint32_t page_no,
+        iotx_subdev_topo_fpt callback,
+        void* pcontext,
+        int* handed,
+        int* stop)
+{
+    int rc = 0;
+    int count = 0;
+    int entry_len = 0, entry_type = 0, pk_len = 0, dn_len = 0;
+    uint32_t msg_id = 0;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
+    char product_key[PRODUCT_KEY_LEN + 1];
+    char device_name[DEVICE_NAME_LEN + 1];
+    char* packet = NULL;
+    char* data = NULL;
+    char* pos = NULL;
+    char* entry = NULL;
+    char* pk = NULL;
+    char* dn = NULL;
+
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_TOPO_GET, topic);
+
+    packet = iotx_gateway_splice_topo_get_page_packet(page_size, page_no, &msg_id);
+    if (packet == NULL) {
+        log_err("topo_get packet splice error!");
+        return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+    }
+
+    /* what an unrelated reply left */
+    if (NULL != gateway->gateway_data.topo_get_message) {
+        LITE_free(gateway->gateway_data.topo_get_message);
+    }
+
+    gateway->gateway_data.topo_get_paged = 1;
+    rc = iotx_gateway_publish_sync(gateway,
+            IOTX_MQTT_QOS0, 
+            topic, 
+            packet, 
+            msg_id, 
+            &(gateway->gateway_data.topo_get_reply),
+            IOTX_GATEWAY_PUBLISH_TOPO_GET);
+    gateway->gateway_data.topo_get_paged = 0;
+    LITE_free(packet);
+    if (SUCCESS_RETURN != rc) {
+        log_err("topo_get page %u error!", page_no);
+        return rc;
+    }
+
+    data = gateway->gateway_data.topo_get_message;
+    gateway->gateway_data.topo_get_message = NULL;
+    if (NULL == data) {
+        log_err("topo_get reply without data");
+        return ERROR_SUBDEV_GET_JSON_VAL;
+    }
+
+    json_array_for_each_entry(data, (int)strlen(data), pos, entry, entry_len, entry_type) {
+        if (JOBJECT != entry_type) {
+            continue;
+        }
+        count++;
+        pk = json_get_value_by_name(entry, entry_len, "productKey", &pk_len, 0);
+        dn = json_get_value_by_name(entry, entry_len, "deviceName", &dn_len, 0);
+        if (NULL == pk || NULL == dn || pk_len > PRODUCT_KEY_LEN || dn_len > DEVICE_NAME_LEN) {
+            log_err("topo_get page %u: entry %d without productKey or deviceName", page_no, count);
+            continue;
+        }
+        memcpy(product_key, pk, pk_len);
+        product_key[pk_len] = '\0';
+        memcpy(device_name, dn, dn_len);
+        device_name[dn_len] = '\0';
+
+        (*handed)++;
+        if (0 != callback((void*)gateway, product_key, device_name, pcontext)) {
+            *stop = 1;
+            break;
+        }
+    }
+    LITE_free(data);
+
+    return count;
+}
+
+int IOT_Gateway_Get_TOPO_Paged(void* handle,
+        uint32_t page_size,
+        iotx_subdev_topo_fpt callback,
+        void* pcontext)
+{
+    int rc = 0;
+    int handed = 0;
+    int stop = 0;
+    uint32_t page_no = 0;
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    PARAMETER_NULL_CHECK_WITH_RESULT(callback, ERROR_SUBDEV_NULL_VALUE);
+
+    if (0 == page_size) {
+        page_size = IOTX_GATEWAY_TOPO_PAGE_SIZE;
+    }
+
+    /* a page short of page_size is the last one */
+    for (page_no = 1; !stop; page_no++) {
+        rc = iotx_gateway_get_topo_page(gateway, page_size, page_no, callback, pcontext, &handed, &stop);
+        if (rc < 0) {
+            return rc;
+        }
+        if ((uint32_t)rc < page_size) {
+            break;
+        }
+    }
+
+    log_info("topo_get %d subdevices", handed);
 
-    *length = strlen(gateway->gateway_data.topo_get_message);
-            
-    return SUCCESS_RETURN;
+    return handed;
 }
 
 int IOT_Gateway_Get_Config(void* handle, 
@@ -1395,19 +2899,13 @@ int IOT_Gateway_Get_Config(void* handle,
     char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
     char* config_get_packet = NULL;
     iotx_mqtt_topic_info_t topic_msg;
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
     iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
     
     PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
     PARAMETER_NULL_CHECK_WITH_RESULT(get_config_reply, ERROR_SUBDEV_NULL_VALUE);
     
     /* topic */
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_CONFIG_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "get");
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_CONFIG_GET, topic);
 
     /* splice config_get packet */
     config_get_packet = iotx_gateway_splice_config_get_packet(&msg_id);
@@ -1440,7 +2938,15 @@ int IOT_Gateway_Get_Config(void* handle,
 
     LITE_free(config_get_packet); 
 
+    if (NULL == gateway->gateway_data.config_get_message) {
+        log_err("config_get reply without data");
+        return ERROR_SUBDEV_GET_JSON_VAL;
+    }
+
     if (*length < strlen(gateway->gateway_data.config_get_message)) {
+        if (NULL != gateway->gateway_data.config_get_message) {
+            LITE_free(gateway->gateway_data.config_get_message);
+        }
         log_err("set memory too small");
         return ERROR_SUBDEV_MEMORY_NOT_ENOUGH;
     }
@@ -1448,6 +2954,9 @@ int IOT_Gateway_Get_Config(void* handle,
     strncpy(get_config_reply, gateway->gateway_data.config_get_message, strlen(gateway->gateway_data.config_get_message));
 
     *length = strlen(gateway->gateway_data.config_get_message);
+    if (NULL != gateway->gateway_data.config_get_message) {
+        LITE_free(gateway->gateway_data.config_get_message);
+    }
             
     return SUCCESS_RETURN;
 }
@@ -1459,18 +2968,12 @@ int IOT_Gateway_Publish_Found_List(void* handle, const char* product_key,
     uint32_t msg_id = 0;
     char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
     char* list_found_packet = NULL;
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
     iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
     
     PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
     
     /* topic */
-    HAL_Snprintf(topic, 
-            GATEWAY_TOPIC_LEN_MAX, 
-            TOPIC_SESSION_LIST_FOUND_FMT, 
-            pdevice_info->product_key, 
-            pdevice_info->device_name, 
-            "found");
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_LIST_FOUND, topic);
 
     /* splice list_found packet */
     list_found_packet = iotx_gateway_splice_common_packet(product_key, 
@@ -1501,15 +3004,326 @@ int IOT_Gateway_Publish_Found_List(void* handle, const char* product_key,
 
 
 
+/* the subdevices found go out, called with lock_pack held */
+static int iotx_gateway_found_flush(iotx_gateway_pt gateway)
+{
+    int rc = 0;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+    iotx_mqtt_topic_info_t topic_msg;
+
+    if (NULL == gateway->found.packet) {
+        return SUCCESS_RETURN;
+    }
+
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_LIST_FOUND, topic);
+
+    if (SUCCESS_RETURN != iotx_gateway_splice_found_end(gateway->found.packet, gateway->found.len_max)) {
+        rc = ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+    } else {
+        memset(&topic_msg, 0x0, sizeof(iotx_mqtt_topic_info_t));
+        topic_msg.qos = IOTX_MQTT_QOS0;
+        topic_msg.payload = (void *)gateway->found.packet;
+        topic_msg.payload_len = strlen(gateway->found.packet);
+        if (0 > IOT_Gateway_Publish(gateway, topic, &topic_msg)) {
+            rc = ERROR_SUBDEV_MQTT_PUBLISH_FAIL;
+        }
+    }
+
+    if (SUCCESS_RETURN != rc) {
+        log_err("%d found subdevices dropped, code:%d", gateway->found.count, rc);
+    }
+
+    LITE_free(gateway->found.packet);
+    gateway->found.count = 0;
+
+    return rc;
+}
+
+/* begins the packet of the first subdevice found, with room for what a publish of the topic can carry */
+static int iotx_gateway_found_begin(iotx_gateway_pt gateway)
+{
+    uint32_t len_max = 0;
+    uint32_t msg_id = 0;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+
+    iotx_gateway_request_topic(gateway, IOTX_GATEWAY_PUBLISH_LIST_FOUND, topic);
+    len_max = iotx_subdevice_batch_len_max(gateway, topic);
+    if (0 == len_max) {
+        return ERROR_SUBDEV_MSG_LEN;
+    }
+    /* the terminating NUL is not sent */
+    gateway->found.len_max = (len_max + 1 < gateway->found.len_limit) ? len_max + 1 : gateway->found.len_limit;
+
+    if (NULL == (gateway->found.packet = iotx_gateway_splice_found_begin(gateway->found.len_max, &msg_id))) {
+        return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+    }
+    utils_time_countdown_ms(&gateway->found.timeout, gateway->found.latency_ms);
+
+    return SUCCESS_RETURN;
+}
+
+int IOT_Gateway_Found_List_Add(void* handle,
+        const char* product_key,
+        const char* device_name)
+{
+    int rc = 0;
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
+
+    if (strlen(product_key) > PRODUCT_KEY_LEN || strlen(device_name) > DEVICE_NAME_LEN) {
+        log_err("product_key or device_name too long");
+        return ERROR_SUBDEV_MSG_LEN;
+    }
+
+    /* known to the gateway already */
+    if (NULL != iotx_subdevice_find_session(gateway, product_key, device_name)) {
+        return SUCCESS_RETURN;
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_pack);
+#endif
+    /* found again by this scan or the ones before, in a packet queued or sent */
+    if (iotx_gateway_found_recent(gateway, product_key, device_name, HAL_UptimeMs())) {
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+        return SUCCESS_RETURN;
+    }
+    if (NULL == gateway->found.packet && SUCCESS_RETURN != (rc = iotx_gateway_found_begin(gateway))) {
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+        return rc;
+    }
+
+    rc = iotx_gateway_splice_found_entry(gateway->found.packet, gateway->found.len_max, product_key, device_name);
+    if (SUCCESS_RETURN != rc && 0 != gateway->found.count) {
+        /* a full packet goes out first */
+        iotx_gateway_found_flush(gateway);
+        if (SUCCESS_RETURN == (rc = iotx_gateway_found_begin(gateway))) {
+            rc = iotx_gateway_splice_found_entry(gateway->found.packet, 
+                        gateway->found.len_max, product_key, device_name);
+        }
+    }
+    if (SUCCESS_RETURN != rc) {
+        if (NULL != gateway->found.packet && 0 == gateway->found.count) {
+            LITE_free(gateway->found.packet);
+        }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+        if (FAIL_RETURN == rc) {
+            log_err("found subdevice too long");
+            return ERROR_SUBDEV_MSG_LEN;
+        }
+        return rc;
+    }
+    gateway->found.count++;
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+
+    return SUCCESS_RETURN;
+}
+
+int IOT_Gateway_Found_List_Flush(void* handle)
+{
+    int rc = 0;
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_pack);
+#endif
+    rc = iotx_gateway_found_flush(gateway);
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+
+    return rc;
+}
+
+
+#define TOPIC_PACK_POST_FMT                   "/sys/%s/%s/thing/event/property/pack/post"
+
+/* the packed posts go out, called with lock_pack held */
+static int iotx_gateway_pack_flush(iotx_gateway_pt gateway)
+{
+    int rc = 0;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+    iotx_mqtt_topic_info_t topic_msg;
+
+    if (NULL == gateway->pack.packet) {
+        return SUCCESS_RETURN;
+    }
+
+    HAL_Snprintf(topic, 
+            GATEWAY_TOPIC_LEN_MAX, 
+            TOPIC_PACK_POST_FMT, 
+            gateway->product_key,
+            gateway->device_name);
+
+    if (SUCCESS_RETURN != iotx_gateway_splice_pack_end(gateway->pack.packet, gateway->pack.len_max)) {
+        rc = ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+    } else {
+        memset(&topic_msg, 0x0, sizeof(iotx_mqtt_topic_info_t));
+        topic_msg.qos = IOTX_MQTT_QOS0;
+        topic_msg.payload = (void *)gateway->pack.packet;
+        topic_msg.payload_len = strlen(gateway->pack.packet);
+        if (0 > IOT_Gateway_Publish(gateway, topic, &topic_msg)) {
+            rc = ERROR_SUBDEV_MQTT_PUBLISH_FAIL;
+        }
+    }
+
+    if (SUCCESS_RETURN != rc) {
+        log_err("%d property posts dropped, code:%d", gateway->pack.count, rc);
+    }
+
+    LITE_free(gateway->pack.packet);
+    gateway->pack.count = 0;
+
+    return rc;
+}
+
+/* begins the packet of the first post, with room for what a publish of the topic can carry */
+static int iotx_gateway_pack_begin(iotx_gateway_pt gateway)
+{
+    uint32_t len_max = 0;
+    uint32_t msg_id = 0;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+
+    HAL_Snprintf(topic, 
+            GATEWAY_TOPIC_LEN_MAX, 
+            TOPIC_PACK_POST_FMT, 
+            gateway->product_key,
+            gateway->device_name);
+    len_max = iotx_subdevice_batch_len_max(gateway, topic);
+    if (0 == len_max) {
+        return ERROR_SUBDEV_MSG_LEN;
+    }
+    /* the terminating NUL is not sent */
+    gateway->pack.len_max = (len_max + 1 < gateway->pack.len_limit) ? len_max + 1 : gateway->pack.len_limit;
+
+    if (NULL == (gateway->pack.packet = iotx_gateway_splice_pack_begin(gateway->pack.len_max, &msg_id))) {
+        return ERROR_SUBDEV_PACKET_SPLICE_FAIL;
+    }
+    utils_time_countdown_ms(&gateway->pack.timeout, gateway->pack.latency_ms);
+
+    return SUCCESS_RETURN;
+}
+
+int IOT_Gateway_Post_Property(void* handle,
+        const char* product_key,
+        const char* device_name,
+        const char* properties)
+{
+    int rc = 0;
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+    iotx_subdevice_session_pt session = NULL;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(properties, ERROR_SUBDEV_STRING_NULL_VALUE);
+
+    if (NULL == (session = iotx_subdevice_find_session(gateway, product_key, device_name))) {
+        log_err("no session, can not post");
+        return ERROR_SUBDEV_SESSION_NOT_FOUND;
+    }
+    if (IOTX_SUBDEVICE_SEESION_STATUS_LOGIN != iotx_subdevice_get_session_status(session)) {
+        log_err("%s.%s not login", product_key, device_name);
+        return ERROR_SUBDEV_SESSION_STATE_FAIL;
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_pack);
+#endif
+    if (NULL == gateway->pack.packet && SUCCESS_RETURN != (rc = iotx_gateway_pack_begin(gateway))) {
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+        return rc;
+    }
+
+    rc = iotx_gateway_splice_pack_entry(gateway->pack.packet, 
+                gateway->pack.len_max, product_key, device_name, properties);
+    if (SUCCESS_RETURN != rc && 0 != gateway->pack.count) {
+        /* a full packet goes out first, the post alone may fit in the next one */
+        iotx_gateway_pack_flush(gateway);
+        if (SUCCESS_RETURN == (rc = iotx_gateway_pack_begin(gateway))) {
+            rc = iotx_gateway_splice_pack_entry(gateway->pack.packet, 
+                        gateway->pack.len_max, product_key, device_name, properties);
+        }
+    }
+    if (SUCCESS_RETURN != rc) {
+        if (NULL != gateway->pack.packet && 0 == gateway->pack.count) {
+            LITE_free(gateway->pack.packet);
+        }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+        if (FAIL_RETURN == rc) {
+            log_err("property post too long");
+            return ERROR_SUBDEV_MSG_LEN;
+        }
+        return rc;
+    }
+    gateway->pack.count++;
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+
+    return SUCCESS_RETURN;
+}
+
+int IOT_Gateway_Post_Property_Flush(void* handle)
+{
+    int rc = 0;
+    iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
+
+    PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_pack);
+#endif
+    rc = iotx_gateway_pack_flush(gateway);
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+#endif
+
+    return rc;
+}
+
 int IOT_Gateway_Destroy(void** handle)
 {
     iotx_subdevice_session_pt session, pre_session;
     iotx_gateway_pt gateway = NULL;
+    iotx_gateway_pending_pt pending = NULL;
 
     PARAMETER_NULL_CHECK_WITH_RESULT(handle, ERROR_SUBDEV_NULL_VALUE);
     
     gateway  = (iotx_gateway_pt)(*handle);
     PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    /* no rrpc callbacks from now on */
+    iotx_gateway_rrpc_worker_stop(gateway);
+#endif
+
+    /* the packed posts of subdevices still logged in */
+    IOT_Gateway_Post_Property_Flush(gateway);
+    IOT_Gateway_Found_List_Flush(gateway);
+
+    /* asynchronous requests still waiting, the restore is over */
+    gateway->restore.active = 0;
+    while (NULL != (pending = iotx_gateway_pending_take_expired(gateway, 0, 1))) {
+        iotx_gateway_pending_complete(gateway, pending, FAIL_RETURN, NULL);
+    }
     
     /* free session list */
     pre_session = session = gateway->session_list;
@@ -1528,17 +3342,40 @@ int IOT_Gateway_Destroy(void** handle)
 #else
     /* MQTT disconnect*/
     IOT_MQTT_Destroy(&gateway->mqtt); 
+    while (gateway->shard_num > 0) {
+        iotx_gateway_shard_destroy(&gateway->shard[--gateway->shard_num]);
+    }
 #endif
+
+    /* not referenced by the client any more */
+    iotx_gateway_default_topic_free(gateway);
+
+    /* sessions whose logout failed, and the slabs */
+    iotx_subdevice_free_sessions(gateway);
     
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD  
-    HAL_MutexDestroy(gateway->gateway_data.lock_login);
-    HAL_MutexDestroy(gateway->gateway_data.lock_login_enter);
     HAL_MutexDestroy(gateway->gateway_data.lock_sync);
     HAL_MutexDestroy(gateway->gateway_data.lock_sync_enter);
+    HAL_MutexDestroy(gateway->gateway_data.lock_pending);
+    HAL_MutexDestroy(gateway->gateway_data.lock_session);
+    HAL_MutexDestroy(gateway->gateway_data.lock_pack);
+    HAL_MutexDestroy(gateway->gateway_data.lock_shard);
+    iotx_gateway_sync_deinit(gateway);
 #endif
 
-    /* actually *handle is g_gateway_subdevice_t */
-    g_gateway_subdevice_t->is_construct = 0;
+    /* replies nobody read */
+    if (NULL != gateway->gateway_data.register_message) {
+        LITE_free(gateway->gateway_data.register_message);
+    }
+    if (NULL != gateway->gateway_data.topo_get_message) {
+        LITE_free(gateway->gateway_data.topo_get_message);
+    }
+    if (NULL != gateway->gateway_data.config_get_message) {
+        LITE_free(gateway->gateway_data.config_get_message);
+    }
+
+    gateway->is_construct = 0;
+    LITE_free(gateway);
     *handle = NULL;
     
     return SUCCESS_RETURN;
@@ -1549,13 +3386,53 @@ int IOT_Gateway_Yield(void* handle, uint32_t timeout)
 {
     iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
     
+    iotx_gateway_pending_pt pending = NULL;
+    uint64_t now = 0;
+    int rc = 0;
+#ifndef SUBDEV_VIA_CLOUD_CONN
+    int i;
+#endif
+    
     PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
 
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_AtomicAdd(&gateway->gateway_data.yield_num, 1);
+#endif
 #ifdef SUBDEV_VIA_CLOUD_CONN
-    return IOT_Cloud_Connection_Yield(gateway->mqtt, timeout);
+    rc = IOT_Cloud_Connection_Yield(gateway->mqtt, timeout);
 #else    
-    return IOT_MQTT_Yield(gateway->mqtt, timeout);
+    /* the timeout shared by the connections */
+    rc = IOT_MQTT_Yield(gateway->mqtt, timeout / (gateway->shard_num + 1));
+    for (i = 0; i < gateway->shard_num; i++) {
+        IOT_MQTT_Yield(gateway->shard[i].mqtt, timeout / (gateway->shard_num + 1));
+    }
+#endif
+
+    /* asynchronous requests with no reply in time */
+    now = HAL_UptimeMs();
+    while (NULL != (pending = iotx_gateway_pending_take_expired(gateway, now, 0))) {
+        iotx_gateway_pending_complete(gateway, pending, ERROR_REPLY_TIMEOUT, NULL);
+    }
+
+    /* the sessions of a reconnect, as the window opens */
+    iotx_gateway_restore_send(gateway);
+
+    /* property posts waited long enough for others */
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_pack);
+#endif
+    if (NULL != gateway->pack.packet && utils_time_is_expired(&gateway->pack.timeout)) {
+        iotx_gateway_pack_flush(gateway);
+    }
+    if (NULL != gateway->found.packet && utils_time_is_expired(&gateway->found.timeout)) {
+        iotx_gateway_found_flush(gateway);
+    }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_pack);
+    HAL_AtomicAdd(&gateway->gateway_data.yield_num, -1);
 #endif
+
+    return rc;
 }
 
 int IOT_Gateway_Subscribe(void* handle, 
@@ -1586,8 +3463,42 @@ int IOT_Gateway_Subscribe(void* handle,
     else
         return rc;
 #else    
-    return IOT_MQTT_Subscribe(gateway->mqtt, topic_filter, qos, 
+    iotx_gateway_shard_pt shard = iotx_gateway_shard_of(gateway, topic_filter);
+    iotx_gateway_shard_sub_pt sub = NULL;
+    int rc = 0;
+
+    if (NULL == shard) {
+        return IOT_MQTT_Subscribe(gateway->mqtt, topic_filter, qos, 
+                (iotx_mqtt_event_handle_func_fpt)topic_handle_func, pcontext);
+    }
+
+    /* kept for a reconnect, the downlinks of a subdevice come over its shard only */
+    if (NULL == (sub = LITE_malloc(sizeof(iotx_gateway_shard_sub_t)))) {
+        log_err("Not enough memory");
+        return FAIL_RETURN;
+    }
+    sub->topic_filter = topic_filter;
+    sub->qos = qos;
+    sub->handle_func = topic_handle_func;
+    sub->pcontext = pcontext;
+
+    rc = IOT_MQTT_Subscribe(shard->mqtt, topic_filter, qos, 
             (iotx_mqtt_event_handle_func_fpt)topic_handle_func, pcontext);
+    if (rc < 0) {
+        LITE_free(sub);
+        return rc;
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_shard);
+#endif
+    sub->next = shard->subs;
+    shard->subs = sub;
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_shard);
+#endif
+
+    return rc;
 #endif    
 }
 
@@ -1615,7 +3526,30 @@ int IOT_Gateway_Unsubscribe(void* handle,
     else
         return rc;
 #else        
-    return IOT_MQTT_Unsubscribe(gateway->mqtt, topic_filter);
+    iotx_gateway_shard_pt shard = iotx_gateway_shard_of(gateway, topic_filter);
+    iotx_gateway_shard_sub_pt *prev = NULL;
+    iotx_gateway_shard_sub_pt sub = NULL;
+
+    if (NULL == shard) {
+        return IOT_MQTT_Unsubscribe(gateway->mqtt, topic_filter);
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_shard);
+#endif
+    for (prev = &shard->subs; NULL != (sub = *prev); ) {
+        if (0 == strcmp(sub->topic_filter, topic_filter)) {
+            *prev = sub->next;
+            LITE_free(sub);
+        } else {
+            prev = &sub->next;
+        }
+    }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_shard);
+#endif
+
+    return IOT_MQTT_Unsubscribe(shard->mqtt, topic_filter);
 #endif    
 }
 
@@ -1658,7 +3592,7 @@ int IOT_Gateway_Publish(void*        handle,
     msg.message_type = IOTX_MESSAGE_CONFIRMABLE;
     return IOT_Cloud_Connection_Send_Message(gateway->mqtt, &msg);
 #else        
-    return IOT_MQTT_Publish(gateway->mqtt, topic_name, topic_msg);
+    return IOT_MQTT_Publish(iotx_gateway_publish_mqtt(gateway, topic_name), topic_name, topic_msg);
 #endif    
     
 }
@@ -1670,16 +3604,14 @@ int IOT_Gateway_RRPC_Register(void* handle,
 {
     iotx_subdevice_session_pt session = NULL;
     iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();  
-    
     PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, ERROR_SUBDEV_STRING_NULL_VALUE);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
     PARAMETER_NULL_CHECK_WITH_RESULT(rrpc_callback, ERROR_SUBDEV_NULL_VALUE);
 
     /* gateway rrpc */
-    if(0 == strncmp(pdevice_info->product_key, product_key, strlen(product_key)) && 
-        0 == strncmp(pdevice_info->device_name, device_name, strlen(device_name))) {
+    if(0 == strncmp(gateway->product_key, product_key, strlen(product_key)) && 
+        0 == strncmp(gateway->device_name, device_name, strlen(device_name))) {
         if (gateway->gateway_data.rrpc_callback != NULL) {
             log_info("rrpc_callback have been set");
             return ERROR_SUBDEV_RRPC_CB_NOT_NULL;
@@ -1720,7 +3652,6 @@ int IOT_Gateway_RRPC_Response(void* handle,
     char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
     iotx_mqtt_topic_info_t topic_msg;
     iotx_gateway_pt gateway = (iotx_gateway_pt)handle;
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
     iotx_subdevice_session_pt session = NULL;    
 
     PARAMETER_GATEWAY_CHECK(gateway, ERROR_SUBDEV_INVALID_GATEWAY_HANDLE);
@@ -1728,19 +3659,15 @@ int IOT_Gateway_RRPC_Response(void* handle,
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, ERROR_SUBDEV_STRING_NULL_VALUE);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(response, ERROR_SUBDEV_STRING_NULL_VALUE);
 
-    if (0 == strncmp(product_key, pdevice_info->product_key, strlen(product_key)) &&
-        0 == strncmp(device_name, pdevice_info->device_name, strlen(device_name))) {
+    if (0 == strncmp(product_key, gateway->product_key, strlen(product_key)) &&
+        0 == strncmp(device_name, gateway->device_name, strlen(device_name))) {
         log_info("gateway RRPC response");
         goto publish_response;
     } else {
-        session = gateway->session_list;
-        while (session) {
-            if (0 == strncmp(product_key, session->product_key, strlen(product_key)) &&
-                0 == strncmp(device_name, session->device_name, strlen(device_name))) {
-                 log_info("session RRPC response");
-                 goto publish_response;
-            }
-            session = session->next;
+        session = iotx_subdevice_find_session(gateway, product_key, device_name);
+        if (session) {
+            log_info("session RRPC response");
+            goto publish_response;
         }
         log_info("no session, can not response");
         return ERROR_SUBDEV_SESSION_NOT_FOUND;
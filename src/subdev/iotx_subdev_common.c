@@ -2,6 +2,7 @@
 #include "lite-log.h"
 #include "lite-utils.h"
 #include "utils_timer.h"
+#include "utils_timer_wheel.h"
 #include "utils_list.h"
 #include "lite-system.h"
 #include "utils_hmac.h"
@@ -81,6 +82,36 @@ char *iotx_gateway_splice_topo_get_packet(uint32_t* msg_id)
     return msg;
 }
 
+/* one page of the topology, pages are numbered from 1 */
+char *iotx_gateway_splice_topo_get_page_packet(uint32_t page_size, uint32_t page_no, uint32_t* msg_id)
+{
+#define TOPOGET_PAGE_PACKET_FMT     "{\"id\":%d,\"version\":\"1.0\",\"params\":{\"pageSize\":%u,\"pageNo\":%u},\"method\":\"thing.topo.get\"}"
+
+    int len, ret;
+    char* msg = NULL;
+    uint32_t id = 0;
+
+    /* sum the string length */
+    len = strlen(TOPOGET_PAGE_PACKET_FMT) + 12 + 10 + 10;
+    MALLOC_MEMORY_WITH_RESULT(msg, len, NULL);
+    id = IOT_Gateway_Generate_Message_ID();
+    ret = HAL_Snprintf(msg,
+                   len,
+                   TOPOGET_PAGE_PACKET_FMT,
+                   id,
+                   page_size,
+                   page_no);
+    if (ret < 0) {
+        log_err("splice packet error!");
+        LITE_free(msg);
+        return NULL;
+    }
+
+    *msg_id = id;
+
+    return msg;
+}
+
 char *iotx_gateway_splice_config_get_packet(uint32_t* msg_id)
 {
 #define CONFIGGET_PACKET_FMT     "{\"id\":%d,\"version\":\"1.0\",\"params\":{\"configScope\":\"product\",\"getType\":\"file\"},\"method\":\"thing.config.get\"}"
@@ -245,17 +276,281 @@ char *iotx_gateway_splice_topo_add_packet(const char *product_key,
     return msg;
 }
 
-static void iotx_gateway_splice_device_cloud_id(char* device_cloud_id, 
-        const char* product_key, 
+#define BATCH_PACKET_BEGIN_FMT     "{\"id\":%d,\"params\":["
+#define BATCH_ENTRY_FMT            "%s{\"productKey\":\"%s\",\"deviceName\":\"%s\",\"clientId\":\"%s\",\"timestamp\":\"%s\",\"signMethod\":\"%s\",\"sign\":\"%s\"%s%s%s}"
+#define BATCH_PACKET_END_FMT       "]%s%s%s}"
+
+/* the length of what BATCH_PACKET_END_FMT appends */
+static uint32_t iotx_gateway_splice_batch_end_len(const char* method)
+{
+    return NULL == method ? strlen("]}") : strlen("],\"method\":\"\"}") + strlen(method);
+}
+
+char *iotx_gateway_splice_batch_begin(uint32_t len_max,
+        uint32_t* msg_id)
+{
+    int ret;
+    char* msg = NULL;
+    uint32_t id = 0;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(msg_id, NULL);
+
+    MALLOC_MEMORY_WITH_RESULT(msg, len_max, NULL);
+    id = IOT_Gateway_Generate_Message_ID();
+    ret = HAL_Snprintf(msg,
+                   len_max,
+                   BATCH_PACKET_BEGIN_FMT,
+                   id);
+    if (ret < 0 || (uint32_t)ret >= len_max) {
+        log_err("splice packet error!");
+        LITE_free(msg);
+        return NULL;
+    }
+
+    *msg_id = id;
+
+    return msg;
+}
+
+/* appends the entry only if the packet can still be ended within len_max, cleanSession is NULL for topo/add */
+int iotx_gateway_splice_batch_entry(char* packet,
+        uint32_t len_max,
+        const char *product_key,
+        const char* device_name,
+        const char* clientId, 
+        const char* timestamp, 
+        const char* sign_method,
+        const char* sign,
+        const char* cleanSession,
+        const char* method)
+{
+    int ret;
+    uint32_t used, left;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
+    PARAMETER_NULL_CHECK_WITH_RESULT(clientId, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(timestamp, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(sign_method, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(sign, FAIL_RETURN);
+
+    used = strlen(packet);
+    if (used + iotx_gateway_splice_batch_end_len(method) >= len_max) {
+        return FAIL_RETURN;
+    }
+    left = len_max - used - iotx_gateway_splice_batch_end_len(method);
+
+    ret = HAL_Snprintf(packet + used,
+                   left,
+                   BATCH_ENTRY_FMT,
+                   '[' == packet[used - 1] ? "" : ",",
+                   product_key,
+                   device_name,
+                   clientId,
+                   timestamp,
+                   sign_method,
+                   sign,
+                   NULL == cleanSession ? "" : ",\"cleanSession\":\"",
+                   NULL == cleanSession ? "" : cleanSession,
+                   NULL == cleanSession ? "" : "\"");
+    if (ret < 0 || (uint32_t)ret >= left) {
+        /* does not fit, the packet is left as it was */
+        packet[used] = '\0';
+        return FAIL_RETURN;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+int iotx_gateway_splice_batch_end(char* packet,
+        uint32_t len_max,
+        const char* method)
+{
+    int ret;
+    uint32_t used;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+
+    used = strlen(packet);
+    ret = HAL_Snprintf(packet + used,
+                   len_max - used,
+                   BATCH_PACKET_END_FMT,
+                   NULL == method ? "" : ",\"method\":\"",
+                   NULL == method ? "" : method,
+                   NULL == method ? "" : "\"");
+    if (ret < 0 || (uint32_t)ret >= len_max - used) {
+        log_err("splice packet error!");
+        return FAIL_RETURN;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+#define PACK_PACKET_BEGIN_FMT      "{\"id\":%d,\"version\":\"1.0\",\"params\":{\"subDevices\":["
+#define PACK_ENTRY_FMT             "%s{\"identity\":{\"productKey\":\"%s\",\"deviceName\":\"%s\"},\"properties\":%s}"
+#define PACK_PACKET_END            "]},\"method\":\"thing.event.property.pack.post\"}"
+
+char *iotx_gateway_splice_pack_begin(uint32_t len_max,
+        uint32_t* msg_id)
+{
+    int ret;
+    char* msg = NULL;
+    uint32_t id = 0;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(msg_id, NULL);
+
+    MALLOC_MEMORY_WITH_RESULT(msg, len_max, NULL);
+    id = IOT_Gateway_Generate_Message_ID();
+    ret = HAL_Snprintf(msg,
+                   len_max,
+                   PACK_PACKET_BEGIN_FMT,
+                   id);
+    if (ret < 0 || (uint32_t)ret >= len_max) {
+        log_err("splice packet error!");
+        LITE_free(msg);
+        return NULL;
+    }
+
+    *msg_id = id;
+
+    return msg;
+}
+
+/* appends the entry only if the packet can still be ended within len_max */
+int iotx_gateway_splice_pack_entry(char* packet,
+        uint32_t len_max,
+        const char *product_key,
+        const char* device_name,
+        const char* properties)
+{
+    int ret;
+    uint32_t used, left;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(properties, FAIL_RETURN);
+
+    used = strlen(packet);
+    if (used + strlen(PACK_PACKET_END) >= len_max) {
+        return FAIL_RETURN;
+    }
+    left = len_max - used - strlen(PACK_PACKET_END);
+
+    ret = HAL_Snprintf(packet + used,
+                   left,
+                   PACK_ENTRY_FMT,
+                   '[' == packet[used - 1] ? "" : ",",
+                   product_key,
+                   device_name,
+                   properties);
+    if (ret < 0 || (uint32_t)ret >= left) {
+        /* does not fit, the packet is left as it was */
+        packet[used] = '\0';
+        return FAIL_RETURN;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+int iotx_gateway_splice_pack_end(char* packet,
+        uint32_t len_max)
+{
+    uint32_t used;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+
+    used = strlen(packet);
+    if (used + strlen(PACK_PACKET_END) >= len_max) {
+        log_err("splice packet error!");
+        return FAIL_RETURN;
+    }
+    strcpy(packet + used, PACK_PACKET_END);
+
+    return SUCCESS_RETURN;
+}
+
+#define FOUND_PACKET_BEGIN_FMT     "{\"id\":%d,\"version\":\"1.0\",\"params\":["
+#define FOUND_ENTRY_FMT            "%s{\"productKey\":\"%s\",\"deviceName\":\"%s\"}"
+#define FOUND_PACKET_END           "],\"method\":\"thing.list.found\"}"
+
+char *iotx_gateway_splice_found_begin(uint32_t len_max,
+        uint32_t* msg_id)
+{
+    int ret;
+    char* msg = NULL;
+    uint32_t id = 0;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(msg_id, NULL);
+
+    MALLOC_MEMORY_WITH_RESULT(msg, len_max, NULL);
+    id = IOT_Gateway_Generate_Message_ID();
+    ret = HAL_Snprintf(msg,
+                   len_max,
+                   FOUND_PACKET_BEGIN_FMT,
+                   id);
+    if (ret < 0 || (uint32_t)ret >= len_max) {
+        log_err("splice packet error!");
+        LITE_free(msg);
+        return NULL;
+    }
+
+    *msg_id = id;
+
+    return msg;
+}
+
+/* appends the entry only if the packet can still be ended within len_max */
+int iotx_gateway_splice_found_entry(char* packet,
+        uint32_t len_max,
+        const char *product_key,
         const char* device_name)
 {
-    PARAMETER_STRING_NULL_CHECK(product_key);
-    PARAMETER_STRING_NULL_CHECK(device_name);
-    PARAMETER_NULL_CHECK(device_cloud_id);
-    
-    HAL_Snprintf(device_cloud_id, DEVICE_ID_LEN, "%s.%s", product_key, device_name);
+    int ret;
+    uint32_t used, left;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
+
+    used = strlen(packet);
+    if (used + strlen(FOUND_PACKET_END) >= len_max) {
+        return FAIL_RETURN;
+    }
+    left = len_max - used - strlen(FOUND_PACKET_END);
+
+    ret = HAL_Snprintf(packet + used,
+                   left,
+                   FOUND_ENTRY_FMT,
+                   '[' == packet[used - 1] ? "" : ",",
+                   product_key,
+                   device_name);
+    if (ret < 0 || (uint32_t)ret >= left) {
+        /* does not fit, the packet is left as it was */
+        packet[used] = '\0';
+        return FAIL_RETURN;
+    }
+
+    return SUCCESS_RETURN;
 }
 
+int iotx_gateway_splice_found_end(char* packet,
+        uint32_t len_max)
+{
+    uint32_t used;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+
+    used = strlen(packet);
+    if (used + strlen(FOUND_PACKET_END) >= len_max) {
+        log_err("splice packet error!");
+        return FAIL_RETURN;
+    }
+    strcpy(packet + used, FOUND_PACKET_END);
+
+    return SUCCESS_RETURN;
+}
 
 int iotx_gateway_calc_sign(const char* product_key, 
         const char* device_name,
@@ -374,16 +669,17 @@ void iotx_gateway_calc_client_id(char* client_id,
     log_info("client_id %s", client_id);
 }
 
-int iotx_gateway_subscribe_unsubscribe_topic(iotx_gateway_pt gateway,
+/* send the subscribe or unsubscribe request, returns the value sync_status is compared with */
+static int iotx_gateway_subscribe_unsubscribe_send(iotx_gateway_pt gateway,
         const char* product_key,
         const char* device_name,
         const char* topic_fmt,
         const char* params,
-        int is_subscribe)
+        int is_subscribe,
+        char* topic,
+        int topic_len)
 {
     int ret = 0;
-    int yiled_count = 0;
-    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
 
     PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
     
@@ -394,7 +690,7 @@ int iotx_gateway_subscribe_unsubscribe_topic(iotx_gateway_pt gateway,
 
     /* topic */
     ret = HAL_Snprintf(topic, 
-                GATEWAY_TOPIC_LEN_MAX, 
+                topic_len, 
                 topic_fmt, 
                 product_key,
                 device_name, 
@@ -449,7 +745,89 @@ int iotx_gateway_subscribe_unsubscribe_topic(iotx_gateway_pt gateway,
         ret = IOT_MQTT_Unsubscribe(gateway->mqtt, topic);
     #endif /* SUBDEV_VIA_CLOUD_CONN */
     }
-   
+
+    return ret;
+}
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+#define IOTX_GATEWAY_REPLY_NUM              9
+
+static void iotx_gateway_reply_slots(iotx_gateway_data_pt data, iotx_common_reply_data_pt slot[IOTX_GATEWAY_REPLY_NUM])
+{
+    slot[0] = &data->login_reply;
+    slot[1] = &data->logout_reply;
+    slot[2] = &data->topo_add_reply;
+    slot[3] = &data->topo_delete_reply;
+    slot[4] = &data->topo_get_reply;
+    slot[5] = &data->config_get_reply;
+    slot[6] = &data->list_found_reply;
+    slot[7] = &data->register_reply;
+    slot[8] = &data->unregister_reply;
+}
+
+int iotx_gateway_sync_init(iotx_gateway_pt gateway)
+{
+    iotx_common_reply_data_pt slot[IOTX_GATEWAY_REPLY_NUM];
+    int i;
+
+    iotx_gateway_reply_slots(&gateway->gateway_data, slot);
+    if (NULL == (gateway->gateway_data.sem_sync = HAL_SemaphoreCreate())) {
+        return FAIL_RETURN;
+    }
+    for (i = 0; i < IOTX_GATEWAY_REPLY_NUM; i++) {
+        if (NULL == (slot[i]->sem = HAL_SemaphoreCreate())) {
+            iotx_gateway_sync_deinit(gateway);
+            return FAIL_RETURN;
+        }
+    }
+
+    return SUCCESS_RETURN;
+}
+
+void iotx_gateway_sync_deinit(iotx_gateway_pt gateway)
+{
+    iotx_common_reply_data_pt slot[IOTX_GATEWAY_REPLY_NUM];
+    int i;
+
+    iotx_gateway_reply_slots(&gateway->gateway_data, slot);
+    for (i = 0; i < IOTX_GATEWAY_REPLY_NUM; i++) {
+        if (NULL != slot[i]->sem) {
+            HAL_SemaphoreDestroy(slot[i]->sem);
+            slot[i]->sem = NULL;
+        }
+    }
+    if (NULL != gateway->gateway_data.sem_sync) {
+        HAL_SemaphoreDestroy(gateway->gateway_data.sem_sync);
+        gateway->gateway_data.sem_sync = NULL;
+    }
+}
+
+#define IOTX_GATEWAY_SYNC_SEM(sem)          (sem)
+#else
+#define IOTX_GATEWAY_SYNC_SEM(sem)          NULL
+#endif
+
+/* one step of a synchronous wait of at most 200ms. While another thread reads the network in
+ * IOT_Gateway_Yield() the reply wakes the wait through sem, else this thread reads it itself.
+ * a post of a reply that came after its wait ended only makes the next wait check once more */
+static void iotx_gateway_sync_wait_step(iotx_gateway_pt gateway, void* sem)
+{
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    if (HAL_AtomicAdd(&gateway->gateway_data.yield_num, 0) > 0) {
+        (void)HAL_SemaphoreWait(sem, 200);
+        return;
+    }
+#endif
+    IOT_Gateway_Yield(gateway, 200);
+}
+
+/* wait until the ack of the request sent as ret arrives */
+static int iotx_gateway_subscribe_unsubscribe_wait(iotx_gateway_pt gateway,
+        int ret,
+        const char* topic)
+{
+    int yiled_count = 0;
+
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
     HAL_MutexLock(gateway->gateway_data.lock_sync_enter);
     HAL_MutexLock(gateway->gateway_data.lock_sync);
@@ -468,7 +846,7 @@ int iotx_gateway_subscribe_unsubscribe_topic(iotx_gateway_pt gateway,
             return FAIL_RETURN;
         }
 
-        IOT_Gateway_Yield(gateway, 200);
+        iotx_gateway_sync_wait_step(gateway, IOTX_GATEWAY_SYNC_SEM(gateway->gateway_data.sem_sync));
         yiled_count++;
     }    
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
@@ -485,120 +863,466 @@ int iotx_gateway_subscribe_unsubscribe_topic(iotx_gateway_pt gateway,
     return SUCCESS_RETURN;
 }
 
-int iotx_gateway_subscribe_unsubscribe_default(iotx_gateway_pt gateway,
+int iotx_gateway_subscribe_unsubscribe_topic(iotx_gateway_pt gateway,
+        const char* product_key,
+        const char* device_name,
+        const char* topic_fmt,
+        const char* params,
         int is_subscribe)
 {
-    iotx_device_info_pt pdevice_info = iotx_device_info_get();
-    
-    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);       
+    int ret = 0;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0}; 
 
-    /* register_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_SUB_FMT, 
-                            "register_reply", 
-                            is_subscribe)){
-        return FAIL_RETURN;
-    }     
-
-    /* unregister_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_SUB_FMT, 
-                            "unregister_reply", 
-                            is_subscribe)){
+    ret = iotx_gateway_subscribe_unsubscribe_send(gateway,
+                product_key,
+                device_name,
+                topic_fmt,
+                params,
+                is_subscribe,
+                topic,
+                GATEWAY_TOPIC_LEN_MAX);
+    if (FAIL_RETURN == ret) {
         return FAIL_RETURN;
     }
-        
-    /* topo_add_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_TOPO_FMT, 
-                            "add_reply", 
-                            is_subscribe)){
-        return FAIL_RETURN;
-    }     
-        
-    /* topo_delete_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_TOPO_FMT, 
-                            "delete_reply", 
-                            is_subscribe)){
-        return FAIL_RETURN;
-    }     
-        
-    /* topo_get_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_TOPO_FMT, 
-                            "get_reply", 
-                            is_subscribe)){
-        return FAIL_RETURN;
-    } 
 
-    /* config_get_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_CONFIG_FMT, 
-                            "get_reply", 
-                            is_subscribe)){
-        return FAIL_RETURN;
-    } 
+    return iotx_gateway_subscribe_unsubscribe_wait(gateway, ret, topic);
+}
 
-    /* list_found_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_LIST_FOUND_FMT, 
-                            "found_reply", 
-                            is_subscribe)){
-        return FAIL_RETURN;
+/* topic format and its last level, in the order they are subscribed and of iotx_gateway_publish_t */
+static const char *g_gateway_default_topic[GATEWAY_DEFAULT_TOPIC_NUM][2] = {
+    {TOPIC_SESSION_SUB_FMT,         "register_reply"},
+    {TOPIC_SESSION_SUB_FMT,         "unregister_reply"},
+    {TOPIC_SESSION_TOPO_FMT,        "add_reply"},
+    {TOPIC_SESSION_TOPO_FMT,        "delete_reply"},
+    {TOPIC_SESSION_TOPO_FMT,        "get_reply"},
+    {TOPIC_SESSION_CONFIG_FMT,      "get_reply"},
+    {TOPIC_SESSION_LIST_FOUND_FMT,  "found_reply"},
+    {TOPIC_SESSION_COMBINE_FMT,     "login_reply"},
+    {TOPIC_SESSION_COMBINE_FMT,     "logout_reply"},
+    {TOPIC_SYS_RRPC_FMT,            "request"},
+};
+
+/* the reply topics of the requests differ from them only by this */
+#define GATEWAY_REPLY_SUFFIX                "_reply"
+#define GATEWAY_REPLY_SUFFIX_LEN            (sizeof(GATEWAY_REPLY_SUFFIX) - 1)
+
+int iotx_gateway_default_topic_init(iotx_gateway_pt gateway,
+        const char* product_key,
+        const char* device_name)
+{
+    int i, ret;
+    char topic[GATEWAY_TOPIC_LEN_MAX] = {0};
+    iotx_gateway_data_pt data = &gateway->gateway_data;
+
+    for (i = 0; i < GATEWAY_DEFAULT_TOPIC_NUM; i++) {
+        ret = HAL_Snprintf(topic,
+                    GATEWAY_TOPIC_LEN_MAX,
+                    g_gateway_default_topic[i][0],
+                    product_key,
+                    device_name,
+                    g_gateway_default_topic[i][1]);
+        if (ret < 0 || ret >= GATEWAY_TOPIC_LEN_MAX) {
+            return FAIL_RETURN;
+        }
+
+        data->default_topic[i] = LITE_malloc(ret + 1);
+        if (NULL == data->default_topic[i]) {
+            log_err("Not enough memory");
+            return FAIL_RETURN;
+        }
+        memcpy(data->default_topic[i], topic, ret + 1);
+        data->default_topic_len[i] = ret;
     }
 
-    /* login_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_COMBINE_FMT, 
-                            "login_reply", 
-                            is_subscribe)){
-        return FAIL_RETURN;
+    return SUCCESS_RETURN;
+}
+
+void iotx_gateway_default_topic_free(iotx_gateway_pt gateway)
+{
+    int i;
+
+    for (i = 0; i < GATEWAY_DEFAULT_TOPIC_NUM; i++) {
+        if (NULL != gateway->gateway_data.default_topic[i]) {
+            LITE_free(gateway->gateway_data.default_topic[i]);
+            gateway->gateway_data.default_topic[i] = NULL;
+        }
     }
+}
+
+int iotx_gateway_request_topic(iotx_gateway_pt gateway, 
+        iotx_gateway_publish_t type, 
+        char* topic)
+{
+    int len = 0;
 
-    /* logout_reply */
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SESSION_COMBINE_FMT, 
-                            "logout_reply", 
-                            is_subscribe)){
+    if (type < 0 || type >= IOTX_GATEWAY_PUBLISH_MAX || NULL == gateway->gateway_data.default_topic[type]) {
         return FAIL_RETURN;
     }
 
-    /* RRPC request*/
-    if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway, 
-                            pdevice_info->product_key,
-                            pdevice_info->device_name,
-                            TOPIC_SYS_RRPC_FMT, 
-                            "request", 
-                            is_subscribe)){
-        return FAIL_RETURN;
-    }    
-    
+    len = gateway->gateway_data.default_topic_len[type] - GATEWAY_REPLY_SUFFIX_LEN;
+    memcpy(topic, gateway->gateway_data.default_topic[type], len);
+    topic[len] = '\0';
+
     return SUCCESS_RETURN;
 }
 
+int iotx_gateway_reply_type(iotx_gateway_pt gateway, const char* topic)
+{
+    int i;
+    int len = strlen(topic);
+    iotx_gateway_data_pt data = &gateway->gateway_data;
+
+    for (i = 0; i < IOTX_GATEWAY_PUBLISH_MAX; i++) {
+        if (NULL != data->default_topic[i] && len == data->default_topic_len[i] &&
+                0 == memcmp(topic, data->default_topic[i], len)) {
+            return i;
+        }
+    }
+
+    /* the rrpc filter ends with "/+" */
+    i = IOTX_GATEWAY_PUBLISH_MAX;
+    if (NULL != data->default_topic[i] && len >= data->default_topic_len[i] - 2 &&
+            0 == memcmp(topic, data->default_topic[i], data->default_topic_len[i] - 2)) {
+        return i;
+    }
+
+    return -1;
+}
+
+#ifndef SUBDEV_VIA_CLOUD_CONN
+int iotx_gateway_sync_batch_ack(iotx_gateway_pt gateway,
+        int packet_id,
+        int is_success)
+{
+    int i, found = 0;
+    iotx_gateway_data_pt data = &gateway->gateway_data;
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(data->lock_sync);
+#endif
+    for (i = 0; i < data->sync_batch_num; i++) {
+        if (0 != data->sync_batch_id[i] && packet_id == data->sync_batch_id[i]) {
+            data->sync_batch_id[i] = 0;
+            data->sync_batch_pending--;
+            if (!is_success) {
+                data->sync_batch_failed++;
+            }
+            found = 1;
+            break;
+        }
+    }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    if (found && 0 == data->sync_batch_pending) {
+        HAL_SemaphorePost(data->sem_sync);
+    }
+    HAL_MutexUnlock(data->lock_sync);
+#endif
+
+    return found;
+}
+
+/* all requests are sent before the acknowledgements are waited for, so they share one round-trip */
+static int iotx_gateway_subscribe_unsubscribe_batch(iotx_gateway_pt gateway,
+        int is_subscribe)
+{
+    int i, ret;
+    int sent = 0;
+    int yiled_count = 0;
+    iotx_gateway_data_pt data = &gateway->gateway_data;
+
+    /* the MQTT client keeps the filter strings of its subscriptions, so they belong to the gateway */
+    for (i = 0; i < GATEWAY_DEFAULT_TOPIC_NUM; i++) {
+        if (NULL == data->default_topic[i]) {
+            return FAIL_RETURN;
+        }
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(data->lock_sync_enter);
+    HAL_MutexLock(data->lock_sync);
+#endif
+    if (is_subscribe) {
+        sent = IOT_MQTT_SubscribeMulti(gateway->mqtt,
+                    (const char **)data->default_topic,
+                    GATEWAY_DEFAULT_TOPIC_NUM,
+                    IOTX_MQTT_QOS0,
+                    (iotx_mqtt_event_handle_func_fpt)iotx_gateway_event_handle,
+                    gateway,
+                    data->sync_batch_id);
+        if (sent < 0) {
+            sent = 0;
+        }
+    } else {
+        for (sent = 0; sent < GATEWAY_DEFAULT_TOPIC_NUM && NULL != data->default_topic[sent]; sent++) {
+            ret = IOT_MQTT_Unsubscribe(gateway->mqtt, data->default_topic[sent]);
+            if (ret < 0) {
+                break;
+            }
+            data->sync_batch_id[sent] = ret;
+        }
+    }
+    data->sync_batch_num = sent;
+    data->sync_batch_pending = sent;
+    data->sync_batch_failed = 0;
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(data->lock_sync);
+#endif
+
+    while (data->sync_batch_pending > 0) {
+        if (yiled_count > IOT_GATEWAY_YIELD_MAX_COUNT) {
+            log_info("yiled max count, time out");
+            break;
+        }
+
+        iotx_gateway_sync_wait_step(gateway, IOTX_GATEWAY_SYNC_SEM(data->sem_sync));
+        yiled_count++;
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(data->lock_sync);
+#endif
+    ret = (GATEWAY_DEFAULT_TOPIC_NUM == sent && 0 == data->sync_batch_pending && 0 == data->sync_batch_failed) ?
+                SUCCESS_RETURN : FAIL_RETURN;
+    data->sync_batch_num = 0;
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(data->lock_sync);
+    HAL_MutexUnlock(data->lock_sync_enter);
+#endif
+
+    if (SUCCESS_RETURN == ret) {
+        log_info("subscribe or unsubscribe %d default topics successfully", sent);
+    } else {
+        log_info("subscribe or unsubscribe default topics error! %d sent, %d failed, %d timeout",
+                 sent, data->sync_batch_failed, data->sync_batch_pending);
+    }
+
+    return ret;
+}
+#endif /* SUBDEV_VIA_CLOUD_CONN */
+
+/* the MQTT client keeps the topic filter it is given, so it lives in the session.
+ * wait is 0 from the reply handlers of async requests, they run inside IOT_Gateway_Yield */
+int iotx_gateway_subscribe_unsubscribe_rrpc(iotx_gateway_pt gateway,
+        iotx_subdevice_session_pt session,
+        int is_subscribe,
+        int wait)
+{
+    int ret = 0;
+
+    PARAMETER_NULL_CHECK_WITH_RESULT(session, FAIL_RETURN);
+
+    ret = iotx_gateway_subscribe_unsubscribe_send(gateway,
+                session->product_key,
+                session->device_name,
+                TOPIC_SYS_RRPC_FMT,
+                "request",
+                is_subscribe,
+                session->rrpc_topic,
+                IOTX_SUBDEV_RRPC_TOPIC_LEN);
+    if (FAIL_RETURN == ret) {
+        return FAIL_RETURN;
+    }
+
+    if (wait) {
+        return iotx_gateway_subscribe_unsubscribe_wait(gateway, ret, session->rrpc_topic);
+    }
+
+    if (ret < 0 && -4 != ret) {
+        log_info("subscribe or unsubscribe [%s] error!", session->rrpc_topic);
+        return FAIL_RETURN;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+
+int iotx_gateway_subscribe_unsubscribe_default(iotx_gateway_pt gateway,
+        int is_subscribe)
+{
+#ifdef SUBDEV_VIA_CLOUD_CONN
+    int i;
+#endif
+
+    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);       
+
+#ifdef SUBDEV_VIA_CLOUD_CONN
+    /* the cloud connection does not tell the responses apart, one request at a time */
+    for (i = 0; i < GATEWAY_DEFAULT_TOPIC_NUM; i++) {
+        if (FAIL_RETURN == iotx_gateway_subscribe_unsubscribe_topic(gateway,
+                                gateway->product_key,
+                                gateway->device_name,
+                                g_gateway_default_topic[i][0],
+                                g_gateway_default_topic[i][1],
+                                is_subscribe)){
+            return FAIL_RETURN;
+        }
+    }
+
+    return SUCCESS_RETURN;
+#else
+    return iotx_gateway_subscribe_unsubscribe_batch(gateway, is_subscribe);
+#endif
+}
+
+/* sessions come from slabs that stay allocated until the gateway is destroyed */
+typedef struct iotx_subdevice_session_slab_st {
+    struct iotx_subdevice_session_slab_st  *next;
+    iotx_subdevice_session_t                session[IOTX_SUBDEV_SESSION_SLAB_NUM];
+} iotx_subdevice_session_slab_t;
+
+/* FNV-1a over product_key, a NUL and device_name */
+static uint32_t iotx_subdevice_device_hash(const char* product_key, const char* device_name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*product_key) {
+        hash = (hash ^ (uint8_t)*product_key++) * 16777619u;
+    }
+    hash *= 16777619u;
+    while (*device_name) {
+        hash = (hash ^ (uint8_t)*device_name++) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t iotx_subdevice_session_hash(const char* product_key, const char* device_name)
+{
+    return iotx_subdevice_device_hash(product_key, device_name) & (IOTX_SUBDEV_SESSION_BUCKET_NUM - 1);
+}
+
+/* 4 slots a hash, the oldest of them makes room. a subdevice pushed out is reported again, one of the same hash is not */
+int iotx_gateway_found_recent(iotx_gateway_pt gateway, 
+        const char* product_key, 
+        const char* device_name,
+        uint64_t now_ms)
+{
+    uint32_t hash = iotx_subdevice_device_hash(product_key, device_name);
+    uint32_t now = (uint32_t)now_ms | 1;
+    iotx_gateway_found_recent_t* set = &gateway->found_recent[hash & (IOTX_GATEWAY_FOUND_RECENT_NUM - 4)];
+    iotx_gateway_found_recent_t* oldest = set;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (0 != set[i].time_ms && now - set[i].time_ms >= IOTX_GATEWAY_FOUND_RECENT_MS) {
+            set[i].time_ms = 0;
+        }
+        if (0 != set[i].time_ms && hash == set[i].hash) {
+            return 1;
+        }
+        if (0 == set[i].time_ms || (0 != oldest->time_ms && now - set[i].time_ms > now - oldest->time_ms)) {
+            oldest = &set[i];
+        }
+    }
+
+    oldest->hash = hash;
+    oldest->time_ms = now;
+
+    return 0;
+}
+
+#ifndef SUBDEV_VIA_CLOUD_CONN
+/* the product key and device name of "/sys/pk/dn/..." or "/pk/dn/...", -1 for a topic of no device */
+static int iotx_gateway_topic_device(const char* topic, 
+        char product_key[PRODUCT_KEY_LEN + 1], 
+        char device_name[DEVICE_NAME_LEN + 1])
+{
+    const char* begin = topic;
+    const char* end = NULL;
+
+    if ('/' != *begin) {
+        return -1;
+    }
+    if (0 == strncmp(begin, "/sys/", 5)) {
+        begin += 4;
+    } else if (0 == strncmp(begin, "/ext/", 5)) {
+        return -1;
+    }
+
+    begin++;
+    if (NULL == (end = strchr(begin, '/')) || end == begin || end - begin > PRODUCT_KEY_LEN) {
+        return -1;
+    }
+    memcpy(product_key, begin, end - begin);
+    product_key[end - begin] = '\0';
+
+    begin = end + 1;
+    if (NULL == (end = strchr(begin, '/')) || end == begin || end - begin > DEVICE_NAME_LEN) {
+        return -1;
+    }
+    memcpy(device_name, begin, end - begin);
+    device_name[end - begin] = '\0';
+
+    return 0;
+}
+
+/* murmur3 finalizer */
+static uint32_t iotx_gateway_shard_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/* rendezvous hashing over the gateway's own connection, 0, and the shards, 1 on, so a shard
+ * more or less moves only the subdevices hashed to it */
+iotx_gateway_shard_pt iotx_gateway_shard_of(iotx_gateway_pt gateway, const char* topic)
+{
+    char product_key[PRODUCT_KEY_LEN + 1];
+    char device_name[DEVICE_NAME_LEN + 1];
+    uint32_t hash, score, best_score = 0;
+    int i, best = 0;
+
+    if (0 == gateway->shard_num || NULL == topic ||
+        0 != iotx_gateway_topic_device(topic, product_key, device_name) ||
+        (0 == strcmp(product_key, gateway->product_key) && 0 == strcmp(device_name, gateway->device_name))) {
+        return NULL;
+    }
+
+    hash = iotx_gateway_shard_mix(iotx_subdevice_device_hash(product_key, device_name));
+    for (i = 0; i <= gateway->shard_num; i++) {
+        score = iotx_gateway_shard_mix(hash + (uint32_t)i * 0x9e3779b9u);
+        if (0 == i || score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+
+    return (0 == best) ? NULL : &gateway->shard[best - 1];
+}
+#endif
+
+static iotx_subdevice_session_pt iotx_subdevice_session_alloc(iotx_gateway_pt gateway)
+{
+    iotx_subdevice_session_slab_t* slab = NULL;
+    iotx_subdevice_session_pt session = NULL;
+    int i;
+
+    if (NULL == gateway->session_free) {
+        MALLOC_MEMORY_WITH_RESULT(slab, sizeof(iotx_subdevice_session_slab_t), NULL);
+        slab->next = gateway->session_slab;
+        gateway->session_slab = slab;
+        for (i = 0; i < IOTX_SUBDEV_SESSION_SLAB_NUM; i++) {
+            slab->session[i].next = gateway->session_free;
+            gateway->session_free = &slab->session[i];
+        }
+    }
+
+    session = gateway->session_free;
+    gateway->session_free = session->next;
+    memset(session, 0x0, sizeof(iotx_subdevice_session_t));
+
+    return session;
+}
+
 iotx_subdevice_session_pt iotx_subdevice_find_session(iotx_gateway_pt gateway, 
         const char* product_key, 
         const char* device_name)
 {            
+    uint32_t hash = 0;
     iotx_subdevice_session_pt session = NULL;
     
     PARAMETER_GATEWAY_CHECK(gateway, NULL);
@@ -606,52 +1330,101 @@ iotx_subdevice_session_pt iotx_subdevice_find_session(iotx_gateway_pt gateway,
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, NULL);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, NULL);
     
-    session = gateway->session_list;
+    hash = iotx_subdevice_session_hash(product_key, device_name);
+
+    /* only the walk of the bucket is locked. a removed session goes back to the free list, and the next
+     * add takes and clears it, so the session returned stays valid only till the subdevice is removed,
+     * callers must not use it across a logout or a failed login of the same subdevice in another thread */
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_session);
+#endif
+    session = gateway->session_bucket[hash];
     
     /* session is exist */
     while(session) {
-        if (0 == strncmp(session->product_key, product_key, strlen(product_key)) && 
-           0 == strncmp(session->device_name, device_name, strlen(device_name))) {
-            return session;
+        if (0 == strcmp(session->product_key, product_key) && 
+           0 == strcmp(session->device_name, device_name)) {
+            break;
         }
-        session = session->next;
+        session = session->hash_next;
     } 
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_session);
+#endif
 
-    return NULL;
+    return session;
 }
 
 
+/* the interned copy of product_key, shared by the sessions of the product */
+static const char* iotx_subdevice_intern_product_key(iotx_gateway_pt gateway, const char* product_key)
+{
+    iotx_subdevice_product_pt product = NULL;
+
+    for (product = gateway->products; product; product = product->next) {
+        if (0 == strcmp(product->product_key, product_key)) {
+            return product->product_key;
+        }
+    }
+
+    MALLOC_MEMORY_WITH_RESULT(product, sizeof(iotx_subdevice_product_t), NULL);
+    strncpy(product->product_key, product_key, PRODUCT_KEY_LEN - 1);
+    product->next = gateway->products;
+    gateway->products = product;
+
+    return product->product_key;
+}
+
 iotx_subdevice_session_pt iotx_subdevice_add_session(iotx_gateway_pt gateway, 
         const char* product_key, 
         const char* device_name, 
-        const char* device_cloud_secret,
         const char* sign, 
         const char* timestamp, 
         const char* client_id,
         iotx_subdev_sign_method_types_t sign_method_type,
         iotx_subdev_clean_session_types_t clean_session_type)
 {
+    const char* interned = NULL;
     iotx_subdevice_session_pt session = NULL;
+    iotx_subdevice_session_pt* bucket = NULL;
     
     PARAMETER_GATEWAY_CHECK(gateway, NULL);
     
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, NULL);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, NULL);
 
-    /* create a new subdev session  */
-    MALLOC_MEMORY_WITH_RESULT(session, sizeof(iotx_subdevice_session_t), NULL);
+    /* sessions are found by the exact names, they must fit terminated */
+    if (strlen(product_key) >= PRODUCT_KEY_LEN || strlen(device_name) >= DEVICE_NAME_LEN) {
+        log_err("product_key or device_name too long");
+        return NULL;
+    }
+    if ((sign && strlen(sign) >= sizeof(session->sign)) 
+            || (timestamp && strlen(timestamp) >= sizeof(session->timestamp))
+            || (client_id && strlen(client_id) >= sizeof(session->client_id))) {
+        log_err("sign, timestamp or client_id too long");
+        return NULL;
+    }
 
-    /* add session to list */
-    session->next = gateway->session_list;
-    gateway->session_list = session;   
-    
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-    HAL_MutexLock(session->lock_generic);
+    HAL_MutexLock(gateway->gateway_data.lock_session);
+#endif
+    if (NULL == (interned = iotx_subdevice_intern_product_key(gateway, product_key))) {
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_session);
+#endif
+        return NULL;
+    }
+
+    /* create a new subdev session  */
+    if (NULL == (session = iotx_subdevice_session_alloc(gateway))) {
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_session);
 #endif
-    strncpy(session->product_key, product_key, strlen(product_key));
+        return NULL;
+    }
+
+    session->product_key = interned;
     strncpy(session->device_name, device_name, strlen(device_name));
-    if (device_cloud_secret)
-        strncpy(session->device_cloud_secret, device_cloud_secret, strlen(device_cloud_secret));
     if (timestamp)
         strncpy(session->timestamp, timestamp, strlen(timestamp));
     if (sign)
@@ -661,14 +1434,19 @@ iotx_subdevice_session_pt iotx_subdevice_add_session(iotx_gateway_pt gateway,
     session->sign_method = sign_method_type;
     session->clean_session = clean_session_type;
     session->dynamic_register = 0;
-    iotx_gateway_splice_device_cloud_id(session->device_cloud_id, product_key, device_name);    
-#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-    HAL_MutexUnlock(session->lock_generic);
-    HAL_MutexLock(session->lock_status);
-#endif
     session->session_status = IOTX_SUBDEVICE_SEESION_STATUS_INIT;
+
+    /* add session to list */
+    session->next = gateway->session_list;
+    if (gateway->session_list) {
+        gateway->session_list->prev = session;
+    }
+    gateway->session_list = session;   
+    bucket = &gateway->session_bucket[iotx_subdevice_session_hash(product_key, device_name)];
+    session->hash_next = *bucket;
+    *bucket = session;
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
-    HAL_MutexUnlock(session->lock_status);
+    HAL_MutexUnlock(gateway->gateway_data.lock_session);
 #endif
 
     return session;
@@ -679,65 +1457,85 @@ int iotx_subdevice_remove_session(iotx_gateway_pt gateway,
         const char* device_name)
 {
     iotx_subdevice_session_pt cur_session = NULL;
-    iotx_subdevice_session_pt pre_session = NULL;
+    iotx_subdevice_session_pt* link = NULL;
     
     PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
     
-    pre_session = cur_session = gateway->session_list;
-
-    if (NULL == cur_session) {
+    if (NULL == gateway->session_list) {
         log_err("session list is empty");
         return SUCCESS_RETURN;
     }    
 
-    /* session is exist */
-    while(cur_session) {
-        if (0 == strncmp(cur_session->product_key, product_key, strlen(product_key)) &&
-            0 == strncmp(cur_session->device_name, device_name, strlen(device_name)) ) {
-            if (cur_session == gateway->session_list) {
-                gateway->session_list = cur_session->next;
+    /* product_key and device_name may be those of the session, compare before it is freed */
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_session);
+#endif
+    link = &gateway->session_bucket[iotx_subdevice_session_hash(product_key, device_name)];
+    while (*link) {
+        cur_session = *link;
+        if (0 == strcmp(cur_session->product_key, product_key) &&
+            0 == strcmp(cur_session->device_name, device_name)) {
+            *link = cur_session->hash_next;
+            if (cur_session->prev) {
+                cur_session->prev->next = cur_session->next;
             } else {
-                pre_session->next = cur_session->next;
+                gateway->session_list = cur_session->next;
+            }
+            if (cur_session->next) {
+                cur_session->next->prev = cur_session->prev;
             }
-        #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD  
-            HAL_MutexDestroy(cur_session->lock_generic);
-            HAL_MutexDestroy(cur_session->lock_status);
-        #endif
-            LITE_free(cur_session);
+            cur_session->next = gateway->session_free;
+            gateway->session_free = cur_session;
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+            HAL_MutexUnlock(gateway->gateway_data.lock_session);
+#endif
             return SUCCESS_RETURN;
         }
-        pre_session = cur_session;
-        cur_session = cur_session->next;
+        link = &cur_session->hash_next;
     }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_session);
+#endif
     
     return FAIL_RETURN;
 }
 
+void iotx_subdevice_free_sessions(iotx_gateway_pt gateway)
+{
+    iotx_subdevice_session_slab_t* slab = NULL;
+    iotx_subdevice_product_pt product = NULL;
+
+    if (NULL == gateway) {
+        return;
+    }
+
+    /* called once the MQTT client is gone, no gateway check on the way */
+    gateway->session_list = NULL;
+    memset(gateway->session_bucket, 0x0, sizeof(gateway->session_bucket));
+
+    while (NULL != (slab = gateway->session_slab)) {
+        gateway->session_slab = slab->next;
+        LITE_free(slab);
+    }
+    gateway->session_free = NULL;
+
+    while (NULL != (product = gateway->products)) {
+        gateway->products = product->next;
+        LITE_free(product);
+    }
+}
+
 
-int iotx_gateway_publish_sync(iotx_gateway_t* gateway, 
+static int iotx_gateway_publish_packet(iotx_gateway_t* gateway, 
         iotx_mqtt_qos_t qos, 
         const char* topic,
-        const char* packet,
-        uint32_t message_id,
-        iotx_common_reply_data_pt reply_data,
-        iotx_gateway_publish_t publish_type)
+        const char* packet)
 {
 #ifdef SUBDEV_VIA_CLOUD_CONN
     iotx_cloud_connection_msg_t msg;
-#else
-    iotx_mqtt_topic_info_t topic_msg;
-#endif
-
-    int yiled_count = 0;
-    
-    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
-    
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(topic, FAIL_RETURN);
-    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
 
-#ifdef SUBDEV_VIA_CLOUD_CONN
     memset(&msg, 0x0, sizeof(iotx_cloud_connection_msg_t));
     msg.type = IOTX_CLOUD_CONNECTION_MESSAGE_TYPE_PUBLISH;
     msg.QoS = (iotx_message_qos_t)qos;
@@ -754,6 +1552,8 @@ int iotx_gateway_publish_sync(iotx_gateway_t* gateway,
     }
 
 #else
+    iotx_mqtt_topic_info_t topic_msg;
+
     memset(&topic_msg, 0x0, sizeof(iotx_mqtt_topic_info_t));
     topic_msg.qos = qos;
     topic_msg.retain = 0;
@@ -767,6 +1567,28 @@ int iotx_gateway_publish_sync(iotx_gateway_t* gateway,
         return FAIL_RETURN;
     }
 #endif
+
+    return SUCCESS_RETURN;
+}
+
+int iotx_gateway_publish_sync(iotx_gateway_t* gateway, 
+        iotx_mqtt_qos_t qos, 
+        const char* topic,
+        const char* packet,
+        uint32_t message_id,
+        iotx_common_reply_data_pt reply_data,
+        iotx_gateway_publish_t publish_type)
+{
+    int yiled_count = 0;
+    
+    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
+    
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(topic, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+
+    if (SUCCESS_RETURN != iotx_gateway_publish_packet(gateway, qos, topic, packet)) {
+        return FAIL_RETURN;
+    }
     
     log_info("iotx_gateway_publish_sync topic [%s]\n", topic); 
     
@@ -780,7 +1602,7 @@ int iotx_gateway_publish_sync(iotx_gateway_t* gateway,
             return FAIL_RETURN;
         }
         
-        IOT_Gateway_Yield(gateway, 200);
+        iotx_gateway_sync_wait_step(gateway, IOTX_GATEWAY_SYNC_SEM(reply_data->sem));
         yiled_count++;
     }
     
@@ -800,10 +1622,208 @@ int iotx_gateway_publish_sync(iotx_gateway_t* gateway,
 }
         
 
-int iotx_subdevice_set_session_status(iotx_subdevice_session_pt session, iotx_subdevice_session_status_t status)
+/* keeps the request in the table and publishes its packet, the request is freed on failure */
+static int iotx_gateway_pending_publish(iotx_gateway_t* gateway, 
+        iotx_mqtt_qos_t qos, 
+        const char* topic,
+        const char* packet,
+        iotx_gateway_pending_pt pending)
+{
+    int i, slot;
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_pending);
+#endif
+    if (gateway->pending_num >= IOTX_GATEWAY_PENDING_NUM) {
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+        HAL_MutexUnlock(gateway->gateway_data.lock_pending);
+#endif
+        LITE_free(pending);
+        log_err("%d requests waiting for replies already", IOTX_GATEWAY_PENDING_NUM);
+        return ERROR_SUBDEV_MEMORY_NOT_ENOUGH;
+    }
+    /* message ids go up one by one, the slot of the id is nearly always free */
+    for (i = 0; i < IOTX_GATEWAY_PENDING_NUM; i++) {
+        slot = (pending->id + i) % IOTX_GATEWAY_PENDING_NUM;
+        if (NULL == gateway->pending[slot]) {
+            gateway->pending[slot] = pending;
+            gateway->pending_num++;
+            utils_timer_add(&gateway->pending_wheel, &pending->timer, IOT_GATEWAY_YIELD_MAX_COUNT * 200);
+            break;
+        }
+    }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_pending);
+#endif
+
+    if (SUCCESS_RETURN != iotx_gateway_publish_packet(gateway, qos, topic, packet)) {
+        pending = iotx_gateway_pending_take(gateway, pending->id);
+        LITE_free(pending);
+        return ERROR_SUBDEV_MQTT_PUBLISH_FAIL;
+    }
+
+    log_info("iotx_gateway_publish_async topic [%s], id %u\n", topic, pending->id); 
+
+    return SUCCESS_RETURN;
+}
+
+int iotx_gateway_publish_async(iotx_gateway_t* gateway, 
+        iotx_mqtt_qos_t qos, 
+        const char* topic,
+        const char* packet,
+        uint32_t message_id,
+        iotx_gateway_publish_t publish_type,
+        const char* product_key,
+        const char* device_name,
+        iotx_subdev_sign_method_types_t sign_method,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext)
+{
+    iotx_gateway_pending_pt pending = NULL;
+    
+    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
+    
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(topic, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
+    PARAMETER_NULL_CHECK_WITH_RESULT(callback, FAIL_RETURN);
+
+    if (strlen(product_key) >= PRODUCT_KEY_LEN || strlen(device_name) >= DEVICE_NAME_LEN) {
+        log_err("product_key or device_name too long");
+        return FAIL_RETURN;
+    }
+
+    MALLOC_MEMORY_WITH_RESULT(pending, sizeof(iotx_gateway_pending_t), ERROR_SUBDEV_MEMORY_NOT_ENOUGH);
+    pending->id = message_id;
+    pending->type = publish_type;
+    pending->sign_method = sign_method;
+    strncpy(pending->product_key, product_key, strlen(product_key));
+    strncpy(pending->device_name, device_name, strlen(device_name));
+    pending->callback = callback;
+    pending->pcontext = pcontext;
+
+    return iotx_gateway_pending_publish(gateway, qos, topic, packet, pending);
+}
+
+/* the request of a batch packet, 'items' must stay until 'callback' is called */
+int iotx_gateway_publish_batch_async(iotx_gateway_t* gateway, 
+        iotx_mqtt_qos_t qos, 
+        const char* topic,
+        const char* packet,
+        uint32_t message_id,
+        iotx_gateway_publish_t publish_type,
+        iotx_subdev_batch_item_pt items,
+        int count,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext)
+{
+    iotx_gateway_pending_pt pending = NULL;
+    
+    PARAMETER_GATEWAY_CHECK(gateway, FAIL_RETURN);
+    
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(topic, FAIL_RETURN);
+    PARAMETER_STRING_NULL_CHECK_WITH_RESULT(packet, FAIL_RETURN);
+    PARAMETER_NULL_CHECK_WITH_RESULT(items, FAIL_RETURN);
+    PARAMETER_NULL_CHECK_WITH_RESULT(callback, FAIL_RETURN);
+
+    if (count <= 0) {
+        return FAIL_RETURN;
+    }
+
+    MALLOC_MEMORY_WITH_RESULT(pending, sizeof(iotx_gateway_pending_t), ERROR_SUBDEV_MEMORY_NOT_ENOUGH);
+    pending->id = message_id;
+    pending->type = publish_type;
+    /* for the logs, the first device stands for the packet */
+    strncpy(pending->product_key, items[0].product_key, PRODUCT_KEY_LEN - 1);
+    strncpy(pending->device_name, items[0].device_name, DEVICE_NAME_LEN - 1);
+    pending->callback = callback;
+    pending->pcontext = pcontext;
+    pending->batch = items;
+    pending->batch_num = count;
+
+    return iotx_gateway_pending_publish(gateway, qos, topic, packet, pending);
+}
+
+iotx_gateway_pending_pt iotx_gateway_pending_take(iotx_gateway_t* gateway, uint32_t message_id)
+{
+    iotx_gateway_pending_pt pending = NULL;
+    int i, slot;
+
+    if (NULL == gateway || 0 == gateway->pending_num) {
+        return NULL;
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_pending);
+#endif
+    for (i = 0; i < IOTX_GATEWAY_PENDING_NUM; i++) {
+        slot = (message_id + i) % IOTX_GATEWAY_PENDING_NUM;
+        if (NULL != gateway->pending[slot] && message_id == gateway->pending[slot]->id) {
+            pending = gateway->pending[slot];
+            gateway->pending[slot] = NULL;
+            gateway->pending_num--;
+            utils_timer_cancel(&gateway->pending_wheel, &pending->timer);
+            break;
+        }
+    }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_pending);
+#endif
+
+    return pending;
+}
+
+/* one request timed out by now_ms, or any request when 'all' is set, NULL if there is none */
+iotx_gateway_pending_pt iotx_gateway_pending_take_expired(iotx_gateway_t* gateway, uint64_t now_ms, int all)
+{
+    iotx_gateway_pending_pt pending = NULL;
+    utils_timer_t* timer = NULL;
+    int i, slot;
+
+    if (NULL == gateway || 0 == gateway->pending_num) {
+        return NULL;
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_pending);
+#endif
+    if (all) {
+        for (i = 0; i < IOTX_GATEWAY_PENDING_NUM && NULL == pending; i++) {
+            pending = gateway->pending[i];
+        }
+        if (NULL != pending) {
+            utils_timer_cancel(&gateway->pending_wheel, &pending->timer);
+        }
+    } else if (NULL != (timer = utils_timer_wheel_take_expired(&gateway->pending_wheel, now_ms))) {
+        pending = UTILS_TIMER_ENTRY(timer, iotx_gateway_pending_t, timer);
+    }
+
+    /* its slot, from the slot of its id on */
+    for (i = 0; NULL != pending && i < IOTX_GATEWAY_PENDING_NUM; i++) {
+        slot = (pending->id + i) % IOTX_GATEWAY_PENDING_NUM;
+        if (pending == gateway->pending[slot]) {
+            gateway->pending[slot] = NULL;
+            gateway->pending_num--;
+            break;
+        }
+    }
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_pending);
+#endif
+
+    return pending;
+}
+        
+
+int iotx_subdevice_set_session_status(iotx_gateway_pt gateway, 
+        iotx_subdevice_session_pt session, 
+        iotx_subdevice_session_status_t status)
 {
+    PARAMETER_NULL_CHECK_WITH_RESULT(gateway, FAIL_RETURN);
     PARAMETER_NULL_CHECK_WITH_RESULT(session, FAIL_RETURN);
 
+    /* a single store, readers on other threads see the old or the new status */
     session->session_status = status;
 
     return SUCCESS_RETURN;
@@ -25,41 +25,187 @@ typedef enum IOTX_SUBDEVICE_SESSION_STATUS_CODES {
     
     /* Unregister */
     IOTX_SUBDEVICE_SEESION_STATUS_UNREGISTER,
+
+    /* Logged in before a reconnect, to be logged in again */
+    IOTX_SUBDEVICE_SEESION_STATUS_RESTORE,
         
     /* Maximum number of seesion status type */
     IOTX_SUBDEVICE_SEESION_STATUS_MAX
 }iotx_subdevice_session_status_t;
 
+/* "/sys/<product_key>/<device_name>/rrpc/request/+" */
+#define IOTX_SUBDEV_RRPC_TOPIC_LEN          (PRODUCT_KEY_LEN + DEVICE_NAME_LEN + 24)
+
 /* The structure of subdevice session */
+/* only what a login and a re-login after reconnect need. The session table is guarded by the gateway
+ * lock_session, the status is one word stored and loaded without it */
 typedef struct iotx_subdevice_session_st{
-    char                                device_cloud_id[DEVICE_ID_LEN];           
-    char                                device_cloud_secret[DEVICE_SECRET_LEN]; 
-    char                                product_key[PRODUCT_KEY_LEN];
+    const char*                         product_key;                     /* interned, gateway->products */
     char                                device_name[DEVICE_NAME_LEN];
     char                                timestamp[20];
     char                                sign[41];
     char                                client_id[IOT_SUBDEVICE_CLIENT_ID_LEN];
     iotx_subdev_sign_method_types_t     sign_method;                     /* HmacSha1, HmacMd5 */
     iotx_subdev_clean_session_types_t   clean_session;                   /* ture, false */
-    iotx_subdevice_session_status_t     session_status;
+    volatile iotx_subdevice_session_status_t session_status;
     rrpc_request_callback               rrpc_callback; 
-#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD    
-    void*                               lock_generic; 
-    void*                               lock_status; 
-#endif
+    char                                rrpc_topic[IOTX_SUBDEV_RRPC_TOPIC_LEN]; /* subscribed while logged in */
     int                                 dynamic_register;
     struct iotx_subdevice_session_st*   next;
+    struct iotx_subdevice_session_st*   prev;
+    struct iotx_subdevice_session_st*   hash_next;                       /* next in the same bucket */
 } iotx_subdevice_session_t, *iotx_subdevice_session_pt;
 
+/* buckets of the session table indexed by (product_key, device_name), a power of 2 */
+#ifndef IOTX_SUBDEV_SESSION_BUCKET_NUM
+    #define IOTX_SUBDEV_SESSION_BUCKET_NUM  (256)
+#endif
+
+/* sessions allocated at a time, freed sessions are kept for reuse until the gateway is destroyed */
+#ifndef IOTX_SUBDEV_SESSION_SLAB_NUM
+    #define IOTX_SUBDEV_SESSION_SLAB_NUM    (16)
+#endif
+
+struct iotx_subdevice_session_slab_st;
+
+/* a product key shared by the sessions of its subdevices, kept until the gateway is destroyed */
+typedef struct iotx_subdevice_product_st {
+    struct iotx_subdevice_product_st*   next;
+    char                                product_key[PRODUCT_KEY_LEN];
+} iotx_subdevice_product_t, *iotx_subdevice_product_pt;
+
+/* devices asked for in a page of IOT_Gateway_Get_TOPO_Paged() when it is given 0, a page is one publish
+ * to be read whole by the MQTT read buffer */
+#ifndef IOTX_GATEWAY_TOPO_PAGE_SIZE
+    #define IOTX_GATEWAY_TOPO_PAGE_SIZE     (20)
+#endif
+
+/* subdevices IOT_Gateway_Found_List_Add() remembers as reported, a power of 2 from 4, and for how long */
+#ifndef IOTX_GATEWAY_FOUND_RECENT_NUM
+    #define IOTX_GATEWAY_FOUND_RECENT_NUM   (512)
+#endif
+
+#ifndef IOTX_GATEWAY_FOUND_RECENT_MS
+    #define IOTX_GATEWAY_FOUND_RECENT_MS    (60000)
+#endif
+
+typedef struct {
+    uint32_t                            hash;               /* of product_key and device_name */
+    uint32_t                            time_ms;            /* uptime it was queued, 0 for none */
+} iotx_gateway_found_recent_t;
+
+/* requests of the asynchronous calls waiting for their replies at most */
+#ifndef IOTX_GATEWAY_PENDING_NUM
+    #define IOTX_GATEWAY_PENDING_NUM        (64)
+#endif
+
+/* the requests time out this late at most */
+#ifndef IOTX_GATEWAY_PENDING_TICK_MS
+    #define IOTX_GATEWAY_PENDING_TICK_MS    (100)
+#endif
+
+struct iotx_gateway_pending_st;
+
+/* batch packets of the restore after a reconnect waiting for replies at most,
+ * the rest of IOTX_GATEWAY_PENDING_NUM is left to the asynchronous calls */
+#ifndef IOTX_GATEWAY_RESTORE_WINDOW
+    #define IOTX_GATEWAY_RESTORE_WINDOW     (8)
+#endif
+
+/* devices of a restore packet at most, fewer when the MQTT write buffer is full first */
+#ifndef IOTX_GATEWAY_RESTORE_BATCH_NUM
+    #define IOTX_GATEWAY_RESTORE_BATCH_NUM  (16)
+#endif
+
+/* sessions in IOTX_SUBDEVICE_SEESION_STATUS_RESTORE are logged in again from IOT_Gateway_Yield() */
+typedef struct iotx_gateway_restore_st {
+    uint32_t                            generation;         /* one per reconnect, packets of an earlier one are not counted */
+    int                                 active;
+    int                                 session_present;    /* the rrpc topics are still subscribed */
+    int                                 in_flight;          /* packets waiting for replies */
+    int                                 restored;
+    int                                 failed;
+    iotx_subdev_reply_fpt               handler;
+    void*                               pcontext;
+} iotx_gateway_restore_t, *iotx_gateway_restore_pt;
+
+/* digits of an rrpc message id at most, it is read back from the end of the request topic */
+#ifndef IOTX_GATEWAY_RRPC_ID_LEN_MAX
+    #define IOTX_GATEWAY_RRPC_ID_LEN_MAX    (20)
+#endif
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+/* rrpc requests waiting for the worker thread at most, what comes in while it is full is dropped */
+#ifndef IOTX_GATEWAY_RRPC_QUEUE_MAX
+    #define IOTX_GATEWAY_RRPC_QUEUE_MAX     (16)
+#endif
+
+/* stack of the worker thread, 0 for the platform default */
+#ifndef IOTX_GATEWAY_RRPC_STACK_SIZE
+    #define IOTX_GATEWAY_RRPC_STACK_SIZE    (0)
+#endif
+
+struct iotx_gateway_rrpc_st;
+#endif
+
+#ifndef SUBDEV_VIA_CLOUD_CONN
+/* extra connections of a gateway at most */
+#ifndef IOTX_GATEWAY_SHARD_NUM_MAX
+    #define IOTX_GATEWAY_SHARD_NUM_MAX      (8)
+#endif
+
+/* a topic IOT_Gateway_Subscribe() made over a shard, subscribed again when it reconnects without the session */
+typedef struct iotx_gateway_shard_sub_st {
+    struct iotx_gateway_shard_sub_st*   next;
+    const char*                         topic_filter;       /* held by the MQTT client as well */
+    int                                 qos;
+    iotx_subdev_event_handle_func_fpt   handle_func;
+    void*                               pcontext;
+} iotx_gateway_shard_sub_t, *iotx_gateway_shard_sub_pt;
+
+/* an extra connection of the gateway, the subdevices hashed to it publish and subscribe over it */
+typedef struct iotx_gateway_shard_st {
+    void*                               mqtt;
+    struct iotx_gateway_st*             gateway;
+    iotx_gateway_shard_sub_pt           subs;               /* under lock_shard */
+} iotx_gateway_shard_t, *iotx_gateway_shard_pt;
+#endif
+
+/* size of a thing.event.property.pack.post at most, less if the MQTT write buffer is smaller */
+#ifndef IOTX_GATEWAY_PACK_LEN_MAX
+    #define IOTX_GATEWAY_PACK_LEN_MAX       (1024)
+#endif
+
+/* time a property post waits in the pack for others at most */
+#ifndef IOTX_GATEWAY_PACK_LATENCY_MS
+    #define IOTX_GATEWAY_PACK_LATENCY_MS    (200)
+#endif
+
+/* property posts, or subdevices found, waiting to go out in one packet of the gateway */
+typedef struct iotx_gateway_pack_st {
+    char*                               packet;             /* begun with the first post, NULL when empty */
+    uint32_t                            len_max;            /* of packet, len_limit unless a publish carries less */
+    uint32_t                            len_limit;
+    uint32_t                            latency_ms;
+    int                                 count;
+    iotx_time_t                         timeout;            /* of the first post */
+} iotx_gateway_pack_t, *iotx_gateway_pack_pt;
+
 
 /* The structure of common reply data */
 typedef struct iotx_common_reply_data_st{
     uint32_t                            id;
     uint32_t                            code;
     iotx_subdevice_session_pt           session;                          /* subdevice session */
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    void*                               sem;                              /* posted once id is 0 */
+#endif
 }iotx_common_reply_data_t,*iotx_common_reply_data_pt;
 
 
+/* topics subscribed by iotx_gateway_subscribe_unsubscribe_default() */
+#define GATEWAY_DEFAULT_TOPIC_NUM           10
+
 /* The structure of gateway data */
 typedef struct iotx_gateway_data_st {
     uint32_t                            sync_status;
@@ -72,13 +218,34 @@ typedef struct iotx_gateway_data_st {
     iotx_common_reply_data_t            list_found_reply;
     iotx_common_reply_data_t            register_reply;
     iotx_common_reply_data_t            unregister_reply;
-    char                                register_message[REPLY_MESSAGE_LEN_MAX];
-    char                                topo_get_message[REPLY_MESSAGE_LEN_MAX];
-    char                                config_get_message[REPLY_MESSAGE_LEN_MAX];
+    /* "data" of the last replies, NULL once read */
+    char*                               register_message;
+    char*                               topo_get_message;
+    int                                 topo_get_paged;     /* a page is as long as it is, not REPLY_MESSAGE_LEN_MAX */
+    char*                               config_get_message;
     rrpc_request_callback               rrpc_callback; 
+    /* built once by iotx_gateway_default_topic_init(), requests use them without "_reply" */
+    char*                               default_topic[GATEWAY_DEFAULT_TOPIC_NUM];   /* held by the MQTT client while subscribed */
+    int                                 default_topic_len[GATEWAY_DEFAULT_TOPIC_NUM];
+#ifndef SUBDEV_VIA_CLOUD_CONN
+    int                                 sync_batch_id[GATEWAY_DEFAULT_TOPIC_NUM];   /* 0 once acknowledged */
+    int                                 sync_batch_num;
+    int                                 sync_batch_pending;
+    int                                 sync_batch_failed;
+#endif
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
     void*                               lock_sync; 
     void*                               lock_sync_enter;  
+    void*                               lock_pending;
+    void*                               lock_session;
+    void*                               lock_pack;
+    void*                               lock_shard;
+    /* synchronous waits block on the semaphores while another thread is in IOT_Gateway_Yield() */
+    void*                               sem_sync;           /* posted as sync_status or sync_batch_pending change */
+    volatile int                        yield_num;          /* threads in IOT_Gateway_Yield() */
+    /* rrpc requests copied by the yield loop, the worker thread of all gateways calls the callbacks */
+    int                                 rrpc_num;           /* queued for the worker, under its lock */
+    int                                 rrpc_worker;        /* 0 if it could not start, the callbacks are called inline */
 #endif
 } iotx_gateway_data_t, *iotx_gateway_data_pt;
 
@@ -86,8 +253,28 @@ typedef struct iotx_gateway_data_st {
 /* The structure of gateway context */
 typedef struct iotx_gateway_st {
     void                               *mqtt;      
+    char                                product_key[PRODUCT_KEY_LEN + 1];   /* of the gateway itself */
+    char                                device_name[DEVICE_NAME_LEN + 1];
     iotx_subdevice_session_pt           session_list;
+    iotx_subdevice_session_pt           session_bucket[IOTX_SUBDEV_SESSION_BUCKET_NUM];
+    iotx_subdevice_session_pt           session_free;
+    struct iotx_subdevice_session_slab_st  *session_slab;
+    iotx_subdevice_product_pt           products;
+    /* found by message id from slot id % IOTX_GATEWAY_PENDING_NUM on */
+    struct iotx_gateway_pending_st     *pending[IOTX_GATEWAY_PENDING_NUM];
+    int                                 pending_num;
+    utils_timer_wheel_t                 pending_wheel;      /* the timeouts of pending, under lock_pending */
+    uint32_t                            packet_len_max;     /* of a publish, the MQTT write buffer */
+    iotx_gateway_restore_t              restore;
+    iotx_gateway_pack_t                 pack;
+    iotx_gateway_pack_t                 found;              /* of IOT_Gateway_Found_List_Add(), under lock_pack too */
+    iotx_gateway_found_recent_t         found_recent[IOTX_GATEWAY_FOUND_RECENT_NUM];    /* under lock_pack */
     iotx_gateway_data_t                 gateway_data;    
+#ifndef SUBDEV_VIA_CLOUD_CONN
+    /* each subdevice is hashed to one of them or to mqtt, which carries the rest of the traffic */
+    iotx_gateway_shard_t                shard[IOTX_GATEWAY_SHARD_NUM_MAX];
+    int                                 shard_num;
+#endif
     /* If there is another user want to handle the MQTT event,
      * must set the event_handler and event pcontext */
     void*                               event_pcontext;
@@ -95,8 +282,6 @@ typedef struct iotx_gateway_st {
     int                                 is_construct;
 } iotx_gateway_t, *iotx_gateway_pt;
 
-extern iotx_gateway_pt g_gateway_subdevice_t;
-
 #define MALLOC_MEMORY(buffer, length) \
     do { \
         if (buffer) \
@@ -193,7 +378,7 @@ extern iotx_gateway_pt g_gateway_subdevice_t;
             log_info("param error"); \
             return (result); \
         } \
-        if ((gateway_t) != g_gateway_subdevice_t) { \
+        if (!(gateway_t)->is_construct) { \
             log_info("param error"); \
             return (result); \
         } \
@@ -217,6 +402,7 @@ typedef enum IOTX_GATEWAY_PUBLISH_TYPE {
     IOTX_GATEWAY_PUBLISH_MAX
 }iotx_gateway_publish_t;
 
+/* valid till the session is removed, its slot is reused by the next add */
 iotx_subdevice_session_pt iotx_subdevice_find_session(iotx_gateway_pt gateway, 
         const char* product_key, 
         const char* device_name);
@@ -224,13 +410,19 @@ iotx_subdevice_session_pt iotx_subdevice_find_session(iotx_gateway_pt gateway,
 iotx_subdevice_session_pt iotx_subdevice_add_session(iotx_gateway_pt gateway, 
         const char * product_key, 
         const char* device_name, 
-        const char* device_cloud_secret, 
         const char* sign, 
         const char* timestamp, 
         const char* client_id,
         iotx_subdev_sign_method_types_t sign_method_type,
         iotx_subdev_clean_session_types_t clean_session_type);
 
+void iotx_subdevice_free_sessions(iotx_gateway_pt gateway);
+
+#ifndef SUBDEV_VIA_CLOUD_CONN
+/* the shard the subdevice of a topic is hashed to, NULL for a topic of the gateway or of no device */
+iotx_gateway_shard_pt iotx_gateway_shard_of(iotx_gateway_pt gateway, const char* topic);
+#endif
+
 int iotx_subdevice_remove_session(iotx_gateway_pt gateway, 
         const char* product_key,
         const char* device_name);
@@ -242,9 +434,42 @@ int iotx_gateway_subscribe_unsubscribe_topic(iotx_gateway_pt gateway,
         const char* params,
         int is_subscribe);
 
+int iotx_gateway_subscribe_unsubscribe_rrpc(iotx_gateway_pt gateway,
+        iotx_subdevice_session_pt session,
+        int is_subscribe,
+        int wait);
+
 int iotx_gateway_subscribe_unsubscribe_default(iotx_gateway_pt gateway, 
         int is_subscribe);
 
+#ifndef SUBDEV_VIA_CLOUD_CONN
+/* 1 if @packet_id belongs to the pending default (un)subscribe, which is then updated */
+int iotx_gateway_sync_batch_ack(iotx_gateway_pt gateway,
+        int packet_id,
+        int is_success);
+#endif
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+/* the semaphores of the synchronous waits, sem_sync and one per reply */
+int iotx_gateway_sync_init(iotx_gateway_pt gateway);
+void iotx_gateway_sync_deinit(iotx_gateway_pt gateway);
+#endif
+
+/* the topics of the gateway device, before anything is subscribed or published */
+int iotx_gateway_default_topic_init(iotx_gateway_pt gateway,
+        const char* product_key,
+        const char* device_name);
+
+void iotx_gateway_default_topic_free(iotx_gateway_pt gateway);
+
+/* @topic of GATEWAY_TOPIC_LEN_MAX gets the request topic of @type */
+int iotx_gateway_request_topic(iotx_gateway_pt gateway, 
+        iotx_gateway_publish_t type, 
+        char* topic);
+
+/* the type whose reply comes on @topic, IOTX_GATEWAY_PUBLISH_MAX for a rrpc request, -1 for none */
+int iotx_gateway_reply_type(iotx_gateway_pt gateway, const char* topic);
+
 /* topo/delete    register   unregister*/
 char *iotx_gateway_splice_common_packet(const char *product_key,
         const char* device_name,
@@ -254,6 +479,8 @@ char *iotx_gateway_splice_common_packet(const char *product_key,
         
 char *iotx_gateway_splice_topo_get_packet(uint32_t* msg_id);
 
+char *iotx_gateway_splice_topo_get_page_packet(uint32_t page_size, uint32_t page_no, uint32_t* msg_id);
+
 char *iotx_gateway_splice_config_get_packet(uint32_t* msg_id);
 
 
@@ -276,6 +503,50 @@ char *iotx_gateway_splice_login_packet(const char *product_key,
         const char* cleanSession,
         uint32_t* msg_id);
         
+/* topo/add    login of many devices: begin, an entry per device, end */
+char *iotx_gateway_splice_batch_begin(uint32_t len_max,
+        uint32_t* msg_id);
+
+int iotx_gateway_splice_batch_entry(char* packet,
+        uint32_t len_max,
+        const char *product_key,
+        const char* device_name,
+        const char* clientId, 
+        const char* timestamp, 
+        const char* sign_method,
+        const char* sign,
+        const char* cleanSession,
+        const char* method);
+
+int iotx_gateway_splice_batch_end(char* packet,
+        uint32_t len_max,
+        const char* method);
+
+/* thing.event.property.pack.post of the properties of many subdevices: begin, an entry per post, end */
+char *iotx_gateway_splice_pack_begin(uint32_t len_max,
+        uint32_t* msg_id);
+
+int iotx_gateway_splice_pack_entry(char* packet,
+        uint32_t len_max,
+        const char *product_key,
+        const char* device_name,
+        const char* properties);
+
+int iotx_gateway_splice_pack_end(char* packet,
+        uint32_t len_max);
+
+/* thing.list.found of many subdevices: begin, an entry per subdevice, end */
+char *iotx_gateway_splice_found_begin(uint32_t len_max,
+        uint32_t* msg_id);
+
+int iotx_gateway_splice_found_entry(char* packet,
+        uint32_t len_max,
+        const char *product_key,
+        const char* device_name);
+
+int iotx_gateway_splice_found_end(char* packet,
+        uint32_t len_max);
+
 char *iotx_gateway_splice_logout_packet(const char *product_key,
         const char* device_name,
         uint32_t* msg_id);
@@ -307,7 +578,59 @@ int iotx_gateway_publish_sync(iotx_gateway_t* gateway,
         iotx_common_reply_data_pt reply_data,
         iotx_gateway_publish_t publish_type);
 
-int iotx_subdevice_set_session_status(iotx_subdevice_session_pt session, 
+/* 'result' of a device of a batch packet waiting for the reply */
+#define IOTX_SUBDEV_BATCH_RESULT_SENT       (1)
+
+/* A request of an asynchronous call, completed by its reply or by timeout in IOT_Gateway_Yield() */
+typedef struct iotx_gateway_pending_st {
+    uint32_t                            id;
+    iotx_gateway_publish_t              type;
+    iotx_subdev_sign_method_types_t     sign_method;        /* of a dynamic register, for the topo add after it */
+    char                                product_key[PRODUCT_KEY_LEN];
+    char                                device_name[DEVICE_NAME_LEN];
+    utils_timer_t                       timer;              /* in pending_wheel while in the table */
+    iotx_subdev_reply_fpt               callback;
+    void*                               pcontext;
+    iotx_subdev_batch_item_pt           batch;              /* devices of a batch packet, NULL for one device */
+    int                                 batch_num;
+} iotx_gateway_pending_t, *iotx_gateway_pending_pt;
+
+int iotx_gateway_publish_async(iotx_gateway_t* gateway, 
+        iotx_mqtt_qos_t qos, 
+        const char* topic,
+        const char* packet,
+        uint32_t message_id,
+        iotx_gateway_publish_t publish_type,
+        const char* product_key,
+        const char* device_name,
+        iotx_subdev_sign_method_types_t sign_method,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext);
+
+int iotx_gateway_publish_batch_async(iotx_gateway_t* gateway, 
+        iotx_mqtt_qos_t qos, 
+        const char* topic,
+        const char* packet,
+        uint32_t message_id,
+        iotx_gateway_publish_t publish_type,
+        iotx_subdev_batch_item_pt items,
+        int count,
+        iotx_subdev_reply_fpt callback,
+        void* pcontext);
+
+iotx_gateway_pending_pt iotx_gateway_pending_take(iotx_gateway_t* gateway, uint32_t message_id);
+
+iotx_gateway_pending_pt iotx_gateway_pending_take_expired(iotx_gateway_t* gateway, uint64_t now_ms, int all);
+
+/* 1 if the subdevice was queued for a thing.list.found in the last IOTX_GATEWAY_FOUND_RECENT_MS, 
+ * else it is remembered as queued now */
+int iotx_gateway_found_recent(iotx_gateway_pt gateway, 
+        const char* product_key, 
+        const char* device_name,
+        uint64_t now_ms);
+
+int iotx_subdevice_set_session_status(iotx_gateway_pt gateway, 
+        iotx_subdevice_session_pt session, 
         iotx_subdevice_session_status_t status);
         
 iotx_subdevice_session_status_t iotx_subdevice_get_session_status(iotx_subdevice_session_pt session);
@@ -22,8 +22,8 @@
 #include <stddef.h>
 #include "iot_export.h"
 #include "sdk-impl_internal.h"
-#include "tfs.h"
 #include "utils_hmac.h"
+#include "mbedtls/aes.h"
 
 #define HASH_SHA1_LEN           (20)
 #define HMAC_MD5_LEN            (16)
@@ -73,6 +73,50 @@ typedef struct _MQTT_ReplayFender {
 #endif
 } __attribute__((packed)) MQTT_ReplayFender;
 
+/*
+ * the key schedules of the connection, expanded from the key of the ID2 auth on the first message and again
+ * once a new auth changed it, rather than by tfs for every message. mbedtls built with the AES ALT options
+ * runs the blocks on HAL_Crypto_Aes*. each direction has its own, publishing touches only the one and
+ * receiving only the other
+ */
+typedef struct {
+    int                     ready;
+    uint8_t                 key[AESKEY_HEX_LEN];
+    mbedtls_aes_context     aes;
+} id2_aes_ctx_t;
+
+static id2_aes_ctx_t g_id2_aes_enc;
+static id2_aes_ctx_t g_id2_aes_dec;
+
+static mbedtls_aes_context *_id2_aes_ctx(id2_aes_ctx_t *ctx, int mode, const uint8_t *key)
+{
+    int ret;
+
+    if (ctx->ready && 0 == memcmp(ctx->key, key, sizeof(ctx->key))) {
+        return &ctx->aes;
+    }
+
+    if (ctx->ready) {
+        mbedtls_aes_free(&ctx->aes);
+        ctx->ready = 0;
+    }
+    mbedtls_aes_init(&ctx->aes);
+    if (MBEDTLS_AES_ENCRYPT == mode) {
+        ret = mbedtls_aes_setkey_enc(&ctx->aes, key, AESKEY_HEX_LEN * 8);
+    } else {
+        ret = mbedtls_aes_setkey_dec(&ctx->aes, key, AESKEY_HEX_LEN * 8);
+    }
+    if (0 != ret) {
+        log_err("aes setkey error, ret = -0x%04x", -ret);
+        mbedtls_aes_free(&ctx->aes);
+        return NULL;
+    }
+
+    memcpy(ctx->key, key, sizeof(ctx->key));
+    ctx->ready = 1;
+    return &ctx->aes;
+}
+
 static int _fill_replay_fender(
             MQTT_ReplayFender *f,
             const char *topic,
@@ -124,27 +168,34 @@ static int _fill_replay_fender(
     return 0;
 }
 
+/*
+ * in place, as the payload grows by the fender and the padding the buffer of the caller has to have room for
+ * them, and it reads the ciphertext back from there
+ */
 int iotx_mqtt_id2_payload_encrypt(char *topic, iotx_mqtt_topic_info_pt topic_msg)
 {
     MQTT_ReplayFender       fender;
     int                     ret = -1;
-    int                     out_buf_len = 0;
-    uint8_t                *out_buf = NULL;
+    int                     padded_len = 0;
+    uint8_t                *buf = NULL;
     uint8_t                 iv[16] = {0};
-    int                     enc_len = 0;
+    mbedtls_aes_context    *aes;
     iotx_conn_info_pt       conn;
 
-    if (!topic || !topic_msg) {
+    if (!topic || !topic_msg || !topic_msg->payload) {
         return -1;
     }
 
     if (!(conn = iotx_conn_info_get())) {
         return -1;
     }
+    if (!(aes = _id2_aes_ctx(&g_id2_aes_enc, MBEDTLS_AES_ENCRYPT, conn->aeskey_hex))) {
+        return -1;
+    }
 
-    out_buf_len = (topic_msg->payload_len / 16) * 16;
+    padded_len = (topic_msg->payload_len / 16) * 16;
     if (topic_msg->payload_len % 16 != 0) {
-        out_buf_len += 16;
+        padded_len += 16;
     }
 
     /* get fender (fender is between mqtt header and mqtt message) */
@@ -152,82 +203,83 @@ int iotx_mqtt_id2_payload_encrypt(char *topic, iotx_mqtt_topic_info_pt topic_msg
     _fill_replay_fender(&fender,
                         topic,
                         topic_msg->packet_id,
-                        out_buf_len);
+                        padded_len);
 
-    out_buf_len += sizeof(MQTT_ReplayFender);
-    out_buf = (uint8_t *)LITE_malloc(out_buf_len + 1);
-    memset(out_buf, 0, out_buf_len + 1);
-    memcpy(out_buf, &fender, sizeof(MQTT_ReplayFender));
+    /* the message moves behind the fender, zero padded to whole blocks, CBC encrypts it where it is */
+    buf = (uint8_t *)topic_msg->payload;
+    memmove(buf + sizeof(MQTT_ReplayFender), buf, topic_msg->payload_len);
+    memset(buf + sizeof(MQTT_ReplayFender) + topic_msg->payload_len, 0, padded_len - topic_msg->payload_len);
 
     /* encode MQTT message */
-    ret = tfs_aes128_cbc_enc(conn->aeskey_hex,
-                             iv,
-                             topic_msg->payload_len,
-                             (const uint8_t *)topic_msg->payload,
-                             &enc_len,
-                             out_buf + sizeof(MQTT_ReplayFender),
-                             TFS_AES_ZERO_PADDING);
-    log_debug("rc = tfs_aes128_cbc_enc() = %d, enc_len = %d", ret, enc_len);
+    ret = mbedtls_aes_crypt_cbc(aes,
+                                MBEDTLS_AES_ENCRYPT,
+                                padded_len,
+                                iv,
+                                buf + sizeof(MQTT_ReplayFender),
+                                buf + sizeof(MQTT_ReplayFender));
+    log_debug("rc = mbedtls_aes_crypt_cbc() = %d, enc_len = %d", ret, padded_len);
 
     if (ret != 0) {
-        log_err("tfs_aes128_cbc_enc error!");
-        ret = -1;
-        goto exit;
+        log_err("aes cbc encrypt error!");
+        return -1;
     }
-    memset((void *)topic_msg->payload, 0, topic_msg->payload_len);
-    memcpy((void *)topic_msg->payload, out_buf, out_buf_len);
-    topic_msg->payload_len = out_buf_len;
+    memcpy(buf, &fender, sizeof(MQTT_ReplayFender));
+    topic_msg->payload_len = sizeof(MQTT_ReplayFender) + padded_len;
 
     HEXDUMP_DEBUG(topic_msg->payload, topic_msg->payload_len);
 
-exit:
-    LITE_free(out_buf);
-
     return ret;
 }
 
+/* in place in the read buffer, the payload then starts behind the fender */
 int iotx_mqtt_id2_payload_decrypt(iotx_mqtt_topic_info_pt topic_msg)
 {
     int                 ret = -1;
     uint8_t             iv[16] = {0};
     int32_t             dec_len = 0;
     int                 offset = sizeof(MQTT_ReplayFender);
-    uint8_t            *dec_out = NULL;
+    uint8_t            *buf = NULL;
+    mbedtls_aes_context *aes;
     iotx_conn_info_pt   conn = NULL;
 
     conn = iotx_conn_info_get();
     if (!conn) {
         return -1;
     }
-    dec_out = LITE_malloc(topic_msg->payload_len);
-    if (!dec_out) {
+    if (!topic_msg->payload || topic_msg->payload_len <= offset || (topic_msg->payload_len - offset) % 16 != 0) {
+        return -1;
+    }
+    if (!(aes = _id2_aes_ctx(&g_id2_aes_dec, MBEDTLS_AES_DECRYPT, conn->aeskey_hex))) {
         return -1;
     }
 
-    memset(dec_out, 0, topic_msg->payload_len);
-    ret = tfs_aes128_cbc_dec(conn->aeskey_hex,
-                             iv,
-                             topic_msg->payload_len - offset,
-                             (const uint8_t *)topic_msg->payload + offset,
-                             &dec_len,
-                             dec_out,
-                             TFS_AES_ZERO_PADDING);
-    log_debug("rc = tfs_aes128_cbc_dec() = %d, dec_len = %d", ret, dec_len);
+    buf = (uint8_t *)topic_msg->payload + offset;
+    /* the zero padding stays in, as tfs left it */
+    dec_len = topic_msg->payload_len - offset;
+    ret = mbedtls_aes_crypt_cbc(aes,
+                                MBEDTLS_AES_DECRYPT,
+                                dec_len,
+                                iv,
+                                buf,
+                                buf);
+    log_debug("rc = mbedtls_aes_crypt_cbc() = %d, dec_len = %d", ret, dec_len);
 
     if (ret != 0) {
-        log_err("tfs_aes128_cbc_dec error!");
-        LITE_free(dec_out);
+        log_err("aes cbc decrypt error!");
         return -1;
     }
 
-    memset((void *)topic_msg->payload, 0, topic_msg->payload_len);
-    memcpy((void *)topic_msg->payload, dec_out, dec_len);
+    /* NUL terminated as before, by the zero padding, or moved over the fender to end within the payload */
+    if (dec_len > 0 && buf[dec_len - 1] != '\0') {
+        memmove((void *)topic_msg->payload, buf, dec_len);
+        buf = (uint8_t *)topic_msg->payload;
+        buf[dec_len] = '\0';
+    }
+    topic_msg->payload = (const char *)buf;
     topic_msg->payload_len = dec_len;
 
     log_debug("ID2 decrypt publish[%d]: %s", topic_msg->payload_len, topic_msg->payload);
-    LITE_free(dec_out);
 
     return ret;
 }
 #endif
-
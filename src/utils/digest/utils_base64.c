@@ -17,7 +17,6 @@
  */
 
 
-
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -27,41 +26,225 @@
 #include "lite-log.h"
 #include "utils_base64.h"
 
-static int8_t g_encodingTable[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
-                                   'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
-                                   'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',
-                                   'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
-                                   'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n',
-                                   'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
-                                   'w', 'x', 'y', 'z', '0', '1', '2', '3',
-                                   '4', '5', '6', '7', '8', '9', '+', '/'
-                                  };
+static const uint8_t g_encodingTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* sextet of a char, 0xFF for a char not of base64, 0xFE for '=' */
+#define B64_BAD     0xFF
+#define B64_PAD     0xFE
+
+static const uint8_t g_decodingTable[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/* 12 bytes into 16 chars at a time, three words of 32 bits loaded a byte at a time, whatever the alignment */
+static uint32_t base64_encode_blocks(const uint8_t *data, uint32_t len, uint8_t *out)
+{
+    const uint8_t *end = data + len / 12 * 12;
+    uint8_t *start = out;
+
+    while (data < end) {
+        uint32_t w0 = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+        uint32_t w1 = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7];
+        uint32_t w2 = ((uint32_t)data[8] << 24) | ((uint32_t)data[9] << 16) | ((uint32_t)data[10] << 8) | data[11];
+
+        out[0] = g_encodingTable[w0 >> 26];
+        out[1] = g_encodingTable[(w0 >> 20) & 0x3F];
+        out[2] = g_encodingTable[(w0 >> 14) & 0x3F];
+        out[3] = g_encodingTable[(w0 >> 8) & 0x3F];
+        out[4] = g_encodingTable[(w0 >> 2) & 0x3F];
+        out[5] = g_encodingTable[((w0 << 4) | (w1 >> 28)) & 0x3F];
+        out[6] = g_encodingTable[(w1 >> 22) & 0x3F];
+        out[7] = g_encodingTable[(w1 >> 16) & 0x3F];
+        out[8] = g_encodingTable[(w1 >> 10) & 0x3F];
+        out[9] = g_encodingTable[(w1 >> 4) & 0x3F];
+        out[10] = g_encodingTable[((w1 << 2) | (w2 >> 30)) & 0x3F];
+        out[11] = g_encodingTable[(w2 >> 24) & 0x3F];
+        out[12] = g_encodingTable[(w2 >> 18) & 0x3F];
+        out[13] = g_encodingTable[(w2 >> 12) & 0x3F];
+        out[14] = g_encodingTable[(w2 >> 6) & 0x3F];
+        out[15] = g_encodingTable[w2 & 0x3F];
+
+        data += 12;
+        out += 16;
+    }
 
-static int8_t g_decodingTable[256];
-static int32_t g_modTable[] = { 0, 2, 1 };
+    return (uint32_t)(out - start);
+}
 
-static void build_decoding_table()
+/* 4 chars into 3 bytes at a time, stops before a quantum with a char not of base64 or '=' */
+static uint32_t base64_decode_blocks(const uint8_t *data, uint32_t len, uint8_t *out, uint32_t *used)
 {
-    static int32_t signal = 0;
-    int32_t i = 0;
+    const uint8_t *end = data + len / 4 * 4;
+    const uint8_t *begin = data;
+    uint8_t *start = out;
+
+    while (data < end) {
+        uint32_t a = g_decodingTable[data[0]];
+        uint32_t b = g_decodingTable[data[1]];
+        uint32_t c = g_decodingTable[data[2]];
+        uint32_t d = g_decodingTable[data[3]];
+        uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+
+        /* '=' and the chars not of base64 have the top bit set */
+        if (0 != ((a | b | c | d) & 0x80)) {
+            break;
+        }
 
-    if (signal != 0) {
-        return;
+        out[0] = (uint8_t)(triple >> 16);
+        out[1] = (uint8_t)(triple >> 8);
+        out[2] = (uint8_t)triple;
+        data += 4;
+        out += 3;
     }
 
-    for (i = 0; i < 64; i++) {
-        g_decodingTable[(uint8_t) g_encodingTable[i]] = i;
+    *used = (uint32_t)(data - begin);
+    return (uint32_t)(out - start);
+}
+
+void utils_base64_stream_init(utils_base64_stream_t *stream)
+{
+    stream->bits = 0;
+    stream->count = 0;
+    stream->pad = 0;
+}
+
+uint32_t utils_base64encode_update(utils_base64_stream_t *stream, const uint8_t *data, uint32_t len, uint8_t *out)
+{
+    uint8_t *start = out;
+    uint32_t n;
+
+    /* the bytes of the quantum the chunk before left */
+    while (0 != stream->count && len > 0) {
+        stream->bits = (stream->bits << 8) | *data++;
+        len--;
+        if (3 == ++stream->count) {
+            *out++ = g_encodingTable[(stream->bits >> 18) & 0x3F];
+            *out++ = g_encodingTable[(stream->bits >> 12) & 0x3F];
+            *out++ = g_encodingTable[(stream->bits >> 6) & 0x3F];
+            *out++ = g_encodingTable[stream->bits & 0x3F];
+            stream->bits = 0;
+            stream->count = 0;
+        }
     }
 
-    signal = 1;
-    return;
+    n = base64_encode_blocks(data, len, out);
+    out += n;
+    data += n / 4 * 3;
+    len -= n / 4 * 3;
+
+    for (; len >= 3; len -= 3, data += 3) {
+        uint32_t triple = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+
+        *out++ = g_encodingTable[triple >> 18];
+        *out++ = g_encodingTable[(triple >> 12) & 0x3F];
+        *out++ = g_encodingTable[(triple >> 6) & 0x3F];
+        *out++ = g_encodingTable[triple & 0x3F];
+    }
+
+    for (; len > 0; len--) {
+        stream->bits = (stream->bits << 8) | *data++;
+        stream->count++;
+    }
+
+    return (uint32_t)(out - start);
+}
+
+uint32_t utils_base64encode_final(utils_base64_stream_t *stream, uint8_t *out)
+{
+    uint32_t bits = stream->bits << (8 * (3 - stream->count));
+
+    if (0 == stream->count) {
+        return 0;
+    }
+
+    out[0] = g_encodingTable[(bits >> 18) & 0x3F];
+    out[1] = g_encodingTable[(bits >> 12) & 0x3F];
+    out[2] = (2 == stream->count) ? g_encodingTable[(bits >> 6) & 0x3F] : '=';
+    out[3] = '=';
+
+    utils_base64_stream_init(stream);
+    return 4;
+}
+
+int32_t utils_base64decode_update(utils_base64_stream_t *stream, const uint8_t *data, uint32_t len, uint8_t *out)
+{
+    uint8_t *start = out;
+    uint32_t used;
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        uint32_t sextet;
+
+        if (0 == stream->count && 0 == stream->pad && len - i >= 4) {
+            out += base64_decode_blocks(data + i, len - i, out, &used);
+            i += used;
+            if (i == len) {
+                break;
+            }
+        }
+
+        sextet = g_decodingTable[data[i]];
+        if (B64_PAD == sextet) {
+            if (0 == stream->pad) {
+                if (stream->count < 2) {
+                    return -1;
+                }
+                stream->bits <<= 6 * (4 - stream->count);
+                *out++ = (uint8_t)(stream->bits >> 16);
+                if (3 == stream->count) {
+                    *out++ = (uint8_t)(stream->bits >> 8);
+                }
+                stream->pad = stream->count;
+            }
+            if (4 < ++stream->pad) {
+                return -1;
+            }
+            continue;
+        }
+        if (B64_BAD == sextet || 0 != stream->pad) {
+            return -1;
+        }
+
+        stream->bits = (stream->bits << 6) | sextet;
+        if (4 == ++stream->count) {
+            *out++ = (uint8_t)(stream->bits >> 16);
+            *out++ = (uint8_t)(stream->bits >> 8);
+            *out++ = (uint8_t)stream->bits;
+            stream->bits = 0;
+            stream->count = 0;
+        }
+    }
+
+    return (int32_t)(out - start);
+}
+
+iotx_err_t utils_base64decode_final(utils_base64_stream_t *stream)
+{
+    int ok = (0 == stream->pad) ? (0 == stream->count) : (4 == stream->pad);
+
+    utils_base64_stream_init(stream);
+    return ok ? SUCCESS_RETURN : FAIL_RETURN;
 }
 
 iotx_err_t utils_base64encode(const uint8_t *data, uint32_t inputLength, uint32_t outputLenMax,
                               uint8_t *encodedData, uint32_t *outputLength)
 {
-    uint32_t i = 0;
-    uint32_t j = 0;
+    utils_base64_stream_t stream;
 
     if (NULL == encodedData) {
         log_err("pointer of encodedData is NULL!");
@@ -75,22 +258,8 @@ iotx_err_t utils_base64encode(const uint8_t *data, uint32_t inputLength, uint32_
         return FAIL_RETURN;
     }
 
-    for (i = 0, j = 0; i < inputLength;) {
-        uint32_t octet_a = i < inputLength ? (uint8_t) data[i++] : 0;
-        uint32_t octet_b = i < inputLength ? (uint8_t) data[i++] : 0;
-        uint32_t octet_c = i < inputLength ? (uint8_t) data[i++] : 0;
-
-        uint32_t triple = (octet_a << 0x10) + (octet_b << 0x08) + octet_c;
-
-        encodedData[j++] = g_encodingTable[(triple >> 3 * 6) & 0x3F];
-        encodedData[j++] = g_encodingTable[(triple >> 2 * 6) & 0x3F];
-        encodedData[j++] = g_encodingTable[(triple >> 1 * 6) & 0x3F];
-        encodedData[j++] = g_encodingTable[(triple >> 0 * 6) & 0x3F];
-    }
-
-    for (i = 0; i < g_modTable[inputLength % 3]; i++) {
-        encodedData[*outputLength - 1 - i] = '=';
-    }
+    utils_base64_stream_init(&stream);
+    utils_base64encode_final(&stream, encodedData + utils_base64encode_update(&stream, data, inputLength, encodedData));
 
     return SUCCESS_RETURN;
 }
@@ -98,10 +267,8 @@ iotx_err_t utils_base64encode(const uint8_t *data, uint32_t inputLength, uint32_
 iotx_err_t utils_base64decode(const uint8_t *data, uint32_t inputLength, uint32_t outputLenMax,
                               uint8_t *decodedData, uint32_t *outputLength)
 {
-    uint32_t i = 0;
-    uint32_t j = 0;
-
-    build_decoding_table();
+    utils_base64_stream_t stream;
+    int32_t len;
 
     if (inputLength % 4 != 0) {
         log_err("the input length is error!");
@@ -110,12 +277,11 @@ iotx_err_t utils_base64decode(const uint8_t *data, uint32_t inputLength, uint32_
 
     *outputLength = inputLength / 4 * 3;
 
-
-    if (data[inputLength - 1] == '=') {
+    if (inputLength > 0 && data[inputLength - 1] == '=') {
         (*outputLength)--;
     }
 
-    if (data[inputLength - 2] == '=') {
+    if (inputLength > 1 && data[inputLength - 2] == '=') {
         (*outputLength)--;
     }
 
@@ -124,33 +290,12 @@ iotx_err_t utils_base64decode(const uint8_t *data, uint32_t inputLength, uint32_
         return FAIL_RETURN;
     }
 
-    uint32_t sextet_a = 0;
-    uint32_t sextet_b = 0;
-    uint32_t sextet_c = 0;
-    uint32_t sextet_d = 0;
-    uint32_t triple = 0;
-
-    for (i = 0, j = 0; i < inputLength;) {
-        sextet_a = data[i] == '=' ? 0 & i++ : g_decodingTable[data[i++]];
-        sextet_b = data[i] == '=' ? 0 & i++ : g_decodingTable[data[i++]];
-        sextet_c = data[i] == '=' ? 0 & i++ : g_decodingTable[data[i++]];
-        sextet_d = data[i] == '=' ? 0 & i++ : g_decodingTable[data[i++]];
-
-        triple = (sextet_a << 3 * 6) + (sextet_b << 2 * 6) + (sextet_c << 1 * 6) + (sextet_d << 0 * 6);
-
-        if (j < *outputLength) {
-            decodedData[j++] = (triple >> 2 * 8) & 0xFF;
-        }
-
-        if (j < *outputLength) {
-            decodedData[j++] = (triple >> 1 * 8) & 0xFF;
-        }
-
-        if (j < *outputLength) {
-            decodedData[j++] = (triple >> 0 * 8) & 0xFF;
-        }
+    utils_base64_stream_init(&stream);
+    len = utils_base64decode_update(&stream, data, inputLength, decodedData);
+    if (len < 0 || SUCCESS_RETURN != utils_base64decode_final(&stream)) {
+        log_err("the input is not base64!");
+        return FAIL_RETURN;
     }
 
     return SUCCESS_RETURN;
 }
-
@@ -28,4 +28,26 @@ iotx_err_t utils_base64encode(const uint8_t *data, uint32_t inputLength, uint32_
 iotx_err_t utils_base64decode(const uint8_t *data, uint32_t inputLength, uint32_t outputLenMax,
                               uint8_t *decodedData, uint32_t *outputLength);
 
+/* state of an encoding or a decoding fed in chunks, for input too long to hold at once */
+typedef struct {
+    uint32_t bits;      /* bytes, or sextets, of the quantum not complete yet */
+    uint32_t count;
+    uint32_t pad;       /* decoding: '=' seen, counting the sextets before them */
+} utils_base64_stream_t;
+
+/* chars utils_base64encode_update() writes at most for len bytes more */
+#define UTILS_BASE64_ENCODE_UPDATE_LEN(stream, len)     (((stream)->count + (len)) / 3 * 4)
+/* bytes utils_base64decode_update() writes at most for len chars more */
+#define UTILS_BASE64_DECODE_UPDATE_LEN(stream, len)     (((stream)->count + (len)) / 4 * 3)
+
+void utils_base64_stream_init(utils_base64_stream_t *stream);
+/* returns the chars written to out, 4 for each 3 bytes complete, the rest waits for the next chunk */
+uint32_t utils_base64encode_update(utils_base64_stream_t *stream, const uint8_t *data, uint32_t len, uint8_t *out);
+/* writes the last quantum padded, returns 0 or 4, the stream is ready for the next encoding */
+uint32_t utils_base64encode_final(utils_base64_stream_t *stream, uint8_t *out);
+/* returns the bytes written to out, -1 for a char not of base64 or misplaced '=' */
+int32_t utils_base64decode_update(utils_base64_stream_t *stream, const uint8_t *data, uint32_t len, uint8_t *out);
+/* checks the input ended on a quantum, the stream is ready for the next decoding */
+iotx_err_t utils_base64decode_final(utils_base64_stream_t *stream);
+
 #endif
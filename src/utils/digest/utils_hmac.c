@@ -18,6 +18,7 @@
 
 
 #include <string.h>
+#include "iot_import.h"
 #include "lite-log.h"
 #include "utils_md5.h"
 #include "utils_sha1.h"
@@ -28,6 +29,16 @@
 #define MD5_DIGEST_SIZE 16
 #define SHA1_DIGEST_SIZE 20
 
+static void utils_hmac_hex(const unsigned char *out, int len, char *digest)
+{
+    int i;
+
+    for (i = 0; i < len; ++i) {
+        digest[i * 2] = utils_hb2hex(out[i] >> 4);
+        digest[i * 2 + 1] = utils_hb2hex(out[i]);
+    }
+}
+
 void utils_hmac_md5(const char *msg, int msg_len, char *digest, const char *key, int key_len)
 {
     if((NULL == msg) || (NULL == digest) || (NULL == key)) {
@@ -46,6 +57,14 @@ void utils_hmac_md5(const char *msg, int msg_len, char *digest, const char *key,
     unsigned char out[MD5_DIGEST_SIZE];
     int i;
 
+#ifdef HAL_CRYPTO_ENABLED
+    if (0 == HAL_Crypto_Hmac(HAL_DIGEST_MD5, (const unsigned char *)key, key_len,
+                             (const unsigned char *)msg, msg_len, out)) {
+        utils_hmac_hex(out, MD5_DIGEST_SIZE, digest);
+        return;
+    }
+#endif
+
     /* start out by storing key in pads */
     memset(k_ipad, 0, sizeof(k_ipad));
     memset(k_opad, 0, sizeof(k_opad));
@@ -72,10 +91,7 @@ void utils_hmac_md5(const char *msg, int msg_len, char *digest, const char *key,
     utils_md5_update(&context, out, MD5_DIGEST_SIZE);      /* then results of 1st hash */
     utils_md5_finish(&context, out);                       /* finish up 2nd pass */
 
-    for (i = 0; i < MD5_DIGEST_SIZE; ++i) {
-        digest[i * 2] = utils_hb2hex(out[i] >> 4);
-        digest[i * 2 + 1] = utils_hb2hex(out[i]);
-    }
+    utils_hmac_hex(out, MD5_DIGEST_SIZE, digest);
 }
 
 void utils_hmac_sha1(const char *msg, int msg_len, char *digest, const char *key, int key_len)
@@ -96,6 +112,14 @@ void utils_hmac_sha1(const char *msg, int msg_len, char *digest, const char *key
     unsigned char out[SHA1_DIGEST_SIZE];
     int i;
 
+#ifdef HAL_CRYPTO_ENABLED
+    if (0 == HAL_Crypto_Hmac(HAL_DIGEST_SHA1, (const unsigned char *)key, key_len,
+                             (const unsigned char *)msg, msg_len, out)) {
+        utils_hmac_hex(out, SHA1_DIGEST_SIZE, digest);
+        return;
+    }
+#endif
+
     /* start out by storing key in pads */
     memset(k_ipad, 0, sizeof(k_ipad));
     memset(k_opad, 0, sizeof(k_opad));
@@ -122,9 +146,107 @@ void utils_hmac_sha1(const char *msg, int msg_len, char *digest, const char *key
     utils_sha1_update(&context, out, SHA1_DIGEST_SIZE);     /* then results of 1st hash */
     utils_sha1_finish(&context, out);                       /* finish up 2nd pass */
 
-    for (i = 0; i < SHA1_DIGEST_SIZE; ++i) {
-        digest[i * 2] = utils_hb2hex(out[i] >> 4);
-        digest[i * 2 + 1] = utils_hb2hex(out[i]);
+    utils_hmac_hex(out, SHA1_DIGEST_SIZE, digest);
+}
+
+int utils_hmac_setkey(utils_hmac_ctx_t *ctx, utils_hmac_method_t method, const char *key, int key_len)
+{
+    unsigned char k_ipad[KEY_IOPAD_SIZE];    /* inner padding - key XORd with ipad  */
+    unsigned char k_opad[KEY_IOPAD_SIZE];    /* outer padding - key XORd with opad */
+    int i;
+
+    if ((NULL == ctx) || (NULL == key)) {
+        log_err("parameter is Null,failed!");
+        return -1;
+    }
+
+    if (key_len > KEY_IOPAD_SIZE) {
+        log_err("key_len > size(%d) of array", KEY_IOPAD_SIZE);
+        return -1;
+    }
+
+    memset(ctx, 0, sizeof(utils_hmac_ctx_t));
+    ctx->method = method;
+#ifdef HAL_CRYPTO_ENABLED
+    memcpy(ctx->key, key, key_len);
+    ctx->key_len = key_len;
+#endif
+
+    memset(k_ipad, 0, sizeof(k_ipad));
+    memset(k_opad, 0, sizeof(k_opad));
+    memcpy(k_ipad, key, key_len);
+    memcpy(k_opad, key, key_len);
+
+    for (i = 0; i < KEY_IOPAD_SIZE; i++) {
+        k_ipad[i] ^= 0x36;
+        k_opad[i] ^= 0x5c;
+    }
+
+    /* the pads are a block each, the states after them are all a sign needs of the key */
+    if (UTILS_HMAC_SHA1 == method) {
+        utils_sha1_init(&ctx->inner.sha1);
+        utils_sha1_starts(&ctx->inner.sha1);
+        utils_sha1_update(&ctx->inner.sha1, k_ipad, KEY_IOPAD_SIZE);
+        utils_sha1_init(&ctx->outer.sha1);
+        utils_sha1_starts(&ctx->outer.sha1);
+        utils_sha1_update(&ctx->outer.sha1, k_opad, KEY_IOPAD_SIZE);
+    } else {
+        utils_md5_init(&ctx->inner.md5);
+        utils_md5_starts(&ctx->inner.md5);
+        utils_md5_update(&ctx->inner.md5, k_ipad, KEY_IOPAD_SIZE);
+        utils_md5_init(&ctx->outer.md5);
+        utils_md5_starts(&ctx->outer.md5);
+        utils_md5_update(&ctx->outer.md5, k_opad, KEY_IOPAD_SIZE);
+    }
+
+    memset(k_ipad, 0, sizeof(k_ipad));
+    memset(k_opad, 0, sizeof(k_opad));
+    return 0;
+}
+
+void utils_hmac_sign(const utils_hmac_ctx_t *ctx, const char *msg, int msg_len, char *digest)
+{
+    iot_md5_context md5;
+    iot_sha1_context sha1;
+    unsigned char out[SHA1_DIGEST_SIZE];
+
+    if ((NULL == ctx) || (NULL == msg) || (NULL == digest)) {
+        log_err("parameter is Null,failed!");
+        return;
+    }
+
+#ifdef HAL_CRYPTO_ENABLED
+    if (0 == HAL_Crypto_Hmac((UTILS_HMAC_SHA1 == ctx->method) ? HAL_DIGEST_SHA1 : HAL_DIGEST_MD5,
+                             ctx->key, ctx->key_len, (const unsigned char *)msg, msg_len, out)) {
+        utils_hmac_hex(out, (UTILS_HMAC_SHA1 == ctx->method) ? SHA1_DIGEST_SIZE : MD5_DIGEST_SIZE, digest);
+        return;
+    }
+#endif
+
+    if (UTILS_HMAC_SHA1 == ctx->method) {
+        utils_sha1_clone(&sha1, &ctx->inner.sha1);
+        utils_sha1_update(&sha1, (const unsigned char *)msg, msg_len);
+        utils_sha1_finish(&sha1, out);
+        utils_sha1_clone(&sha1, &ctx->outer.sha1);
+        utils_sha1_update(&sha1, out, SHA1_DIGEST_SIZE);
+        utils_sha1_finish(&sha1, out);
+        utils_sha1_free(&sha1);
+        utils_hmac_hex(out, SHA1_DIGEST_SIZE, digest);
+    } else {
+        utils_md5_clone(&md5, &ctx->inner.md5);
+        utils_md5_update(&md5, (const unsigned char *)msg, msg_len);
+        utils_md5_finish(&md5, out);
+        utils_md5_clone(&md5, &ctx->outer.md5);
+        utils_md5_update(&md5, out, MD5_DIGEST_SIZE);
+        utils_md5_finish(&md5, out);
+        utils_md5_free(&md5);
+        utils_hmac_hex(out, MD5_DIGEST_SIZE, digest);
     }
 }
 
+void utils_hmac_free(utils_hmac_ctx_t *ctx)
+{
+    if (NULL != ctx) {
+        memset(ctx, 0, sizeof(utils_hmac_ctx_t));
+    }
+}
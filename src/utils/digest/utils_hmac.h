@@ -22,10 +22,41 @@
 #define _IOTX_COMMON_HMAC_H_
 
 #include <string.h>
+#include "utils_md5.h"
+#include "utils_sha1.h"
+
+typedef enum {
+    UTILS_HMAC_MD5,
+    UTILS_HMAC_SHA1
+} utils_hmac_method_t;
+
+/*
+ * a key with its inner and outer padding blocks compressed once, each sign then costs the blocks of
+ * its message alone, for a device secret signing every auth of a connection
+ */
+typedef struct {
+    utils_hmac_method_t     method;
+    union {
+        iot_md5_context     md5;
+        iot_sha1_context    sha1;
+    } inner, outer;
+#ifdef HAL_CRYPTO_ENABLED
+    unsigned char           key[64];    /* HAL_Crypto_Hmac takes the key for the whole HMAC */
+    int                     key_len;
+#endif
+} utils_hmac_ctx_t;
 
 void utils_hmac_md5(const char *msg, int msg_len, char *digest, const char *key, int key_len);
 
 void utils_hmac_sha1(const char *msg, int msg_len, char *digest, const char *key, int key_len);
 
+/* 0 once the key is set up, -1 for a key longer than a block */
+int utils_hmac_setkey(utils_hmac_ctx_t *ctx, utils_hmac_method_t method, const char *key, int key_len);
+
+/* the hex HMAC of msg, as utils_hmac_md5/sha1 give it for the key of ctx */
+void utils_hmac_sign(const utils_hmac_ctx_t *ctx, const char *msg, int msg_len, char *digest);
+
+void utils_hmac_free(utils_hmac_ctx_t *ctx);
+
 #endif
 
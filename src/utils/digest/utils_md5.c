@@ -99,6 +99,16 @@ void utils_md5_process(iot_md5_context *ctx, const unsigned char data[64])
 {
     uint32_t X[16], A, B, C, D;
 
+#ifdef HAL_CRYPTO_ENABLED
+    if (0 == HAL_Crypto_Md5Process(ctx->state, data)) {
+        return;
+    }
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    /* the block already is the little endian words, take them at once whatever the alignment */
+    memcpy(X, data, sizeof(X));
+#else
     IOT_MD5_GET_UINT32_LE(X[ 0], data,  0);
     IOT_MD5_GET_UINT32_LE(X[ 1], data,  4);
     IOT_MD5_GET_UINT32_LE(X[ 2], data,  8);
@@ -115,6 +125,7 @@ void utils_md5_process(iot_md5_context *ctx, const unsigned char data[64])
     IOT_MD5_GET_UINT32_LE(X[13], data, 52);
     IOT_MD5_GET_UINT32_LE(X[14], data, 56);
     IOT_MD5_GET_UINT32_LE(X[15], data, 60);
+#endif
 
 #define S(x,n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
 
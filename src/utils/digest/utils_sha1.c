@@ -95,6 +95,12 @@ void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
 {
     uint32_t temp, W[16], A, B, C, D, E;
 
+#ifdef HAL_CRYPTO_ENABLED
+    if (0 == HAL_Crypto_Sha1Process(ctx->state, data)) {
+        return;
+    }
+#endif
+
     IOT_SHA1_GET_UINT32_BE(W[ 0], data,  0);
     IOT_SHA1_GET_UINT32_BE(W[ 1], data,  4);
     IOT_SHA1_GET_UINT32_BE(W[ 2], data,  8);
@@ -134,80 +134,228 @@ void utils_sha256_starts(iot_sha256_context *ctx)
     memset(ctx->buffer, 0, SHA256_BLOCK_LENGTH);
     ctx->bitcount = 0;
 }
-void utils_sha256_process(iot_sha256_context *ctx, const uint32_t *data)
+/*
+ * The block kernel works on whole blocks straight from the caller's buffer, which may have any
+ * alignment. Targets with SHA instructions get them at compile time: x86 SHA-NI with -msha (or
+ * -march=native on a capable host), ARMv8 with the crypto extension (e.g. -march=armv8-a+crypto).
+ */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+static inline uint32_t utils_sha256_load_be32(const unsigned char *p)
+{
+    uint32_t w;
+
+    memcpy(&w, p, 4);
+    return __builtin_bswap32(w);
+}
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+static inline uint32_t utils_sha256_load_be32(const unsigned char *p)
+{
+    uint32_t w;
+
+    memcpy(&w, p, 4);
+    return w;
+}
+#else
+static inline uint32_t utils_sha256_load_be32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+#endif
+
+#if defined(__SHA__) && defined(__SSE4_1__)
+
+#include <immintrin.h>
+
+/* state is kept as ABEF/CDGH across the blocks, the layout sha256rnds2 works on */
+static void utils_sha256_blocks_hw(uint32_t state[8], const unsigned char *data, size_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, msg, tmp, m[4], abef_save, cdgh_save;
+    int g;
+
+#if defined(__AVX__)
+    /* sha256rnds2 has no VEX form, leave no dirty upper halves behind for it to stall on */
+    _mm256_zeroupper();
+#endif
+
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);       /* CDAB */
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);    /* EFGH */
+    state0 = _mm_alignr_epi8(tmp, state1, 8);                                           /* ABEF */
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);                                        /* CDGH */
+
+    while (nblocks--) {
+        abef_save = state0;
+        cdgh_save = state1;
+
+        for (g = 0; g < 4; g++) {
+            m[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * g)), mask);
+        }
+
+        /* four rounds per group, the schedule of group g + 4 is built while group g runs */
+        for (g = 0; g < 16; g++) {
+            msg = _mm_add_epi32(m[g & 3], _mm_loadu_si128((const __m128i *)&K256[4 * g]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g <= 14) {
+                tmp = _mm_alignr_epi8(m[g & 3], m[(g + 3) & 3], 4);
+                m[(g + 1) & 3] = _mm_add_epi32(m[(g + 1) & 3], tmp);
+                m[(g + 1) & 3] = _mm_sha256msg2_epu32(m[(g + 1) & 3], m[g & 3]);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g <= 12) {
+                m[(g + 3) & 3] = _mm_sha256msg1_epu32(m[(g + 3) & 3], m[g & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+        data += SHA256_BLOCK_LENGTH;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);                                              /* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xB1);                                           /* DCHG */
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));         /* DCBA */
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, tmp, 8));            /* HGFE */
+}
+#define UTILS_SHA256_BLOCKS     utils_sha256_blocks_hw
+
+#elif defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+
+#include <arm_neon.h>
+
+static void utils_sha256_blocks_hw(uint32_t state[8], const unsigned char *data, size_t nblocks)
+{
+    uint32x4_t state0, state1, abef_save, cdgh_save, tmp0, tmp2, m[4];
+    int g;
+
+    state0 = vld1q_u32(&state[0]);
+    state1 = vld1q_u32(&state[4]);
+
+    while (nblocks--) {
+        abef_save = state0;
+        cdgh_save = state1;
+
+        for (g = 0; g < 4; g++) {
+            m[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * g)));
+        }
+
+        /* four rounds per group, the schedule of group g + 4 is built while group g runs */
+        for (g = 0; g < 16; g++) {
+            tmp0 = vaddq_u32(m[g & 3], vld1q_u32(&K256[4 * g]));
+            if (g < 12) {
+                m[g & 3] = vsha256su0q_u32(m[g & 3], m[(g + 1) & 3]);
+            }
+            tmp2 = state0;
+            state0 = vsha256hq_u32(state0, state1, tmp0);
+            state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+            if (g < 12) {
+                m[g & 3] = vsha256su1q_u32(m[g & 3], m[(g + 2) & 3], m[(g + 3) & 3]);
+            }
+        }
+
+        state0 = vaddq_u32(state0, abef_save);
+        state1 = vaddq_u32(state1, cdgh_save);
+        data += SHA256_BLOCK_LENGTH;
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+#define UTILS_SHA256_BLOCKS     utils_sha256_blocks_hw
+
+#else
+
+/* message schedule kept in a ring of 16 words, W(i) expands word i in place */
+#define SHA256_W(i)     (W[(i) & 0x0f] += sigma1_256(W[((i) + 14) & 0x0f]) + W[((i) + 9) & 0x0f] \
+                                          + sigma0_256(W[((i) + 1) & 0x0f]))
+
+#define SHA256_ROUND(a,b,c,d,e,f,g,h,i,w)                                   \
+    {                                                                       \
+        T1 = (h) + Sigma1_256(e) + Ch((e), (f), (g)) + K256[i] + (w);       \
+        (d) += T1;                                                          \
+        (h) = T1 + Sigma0_256(a) + Maj((a), (b), (c));                      \
+    }
+
+static void utils_sha256_blocks_sw(uint32_t state[8], const unsigned char *data, size_t nblocks)
 {
-    uint32_t a, b, c, d, e, f, g, h, s0, s1;
-    uint32_t T1, T2, *W256;
+    uint32_t a, b, c, d, e, f, g, h, T1, W[16];
     int j;
 
-    W256 = (uint32_t *) ctx->buffer;
-
-    /* Initialize registers with the prev. intermediate value */
-    a = ctx->state[0];
-    b = ctx->state[1];
-    c = ctx->state[2];
-    d = ctx->state[3];
-    e = ctx->state[4];
-    f = ctx->state[5];
-    g = ctx->state[6];
-    h = ctx->state[7];
-
-    j = 0;
-
-    do {
-        /* Copy data while converting to host byte order */
-        W256[j] = os_htobe32(*data++);
-
-        /* Apply the SHA-256 compression function to update a..h */
-        T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] + W256[j];
-
-        T2 = Sigma0_256(a) + Maj(a, b, c);
-        h = g;
-        g = f;
-        f = e;
-        e = d + T1;
-        d = c;
-        c = b;
-        b = a;
-        a = T1 + T2;
-
-        j++;
-    } while (j < 16);
-
-    do {
-        /* Part of the message block expansion: */
-        s0 = W256[(j + 1) & 0x0f];
-        s0 = sigma0_256(s0);
-        s1 = W256[(j + 14) & 0x0f];
-        s1 = sigma1_256(s1);
-
-        /* Apply the SHA-256 compression function to update a..h */
-        T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] + (W256[j & 0x0f] += s1 + W256[(j + 9) & 0x0f] + s0);
-        T2 = Sigma0_256(a) + Maj(a, b, c);
-        h = g;
-        g = f;
-        f = e;
-        e = d + T1;
-        d = c;
-        c = b;
-        b = a;
-        a = T1 + T2;
-
-        j++;
-    } while (j < 64);
-
-    /* Compute the current intermediate hash value */
-    ctx->state[0] += a;
-    ctx->state[1] += b;
-    ctx->state[2] += c;
-    ctx->state[3] += d;
-    ctx->state[4] += e;
-    ctx->state[5] += f;
-    ctx->state[6] += g;
-    ctx->state[7] += h;
+    while (nblocks--) {
+        for (j = 0; j < 16; j++) {
+            W[j] = utils_sha256_load_be32(data + 4 * j);
+        }
+
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+        e = state[4];
+        f = state[5];
+        g = state[6];
+        h = state[7];
+
+        /* eight rounds per pass, the registers rotate through the argument order instead of moving */
+        for (j = 0; j < 16; j += 8) {
+            SHA256_ROUND(a, b, c, d, e, f, g, h, j,     W[j]);
+            SHA256_ROUND(h, a, b, c, d, e, f, g, j + 1, W[j + 1]);
+            SHA256_ROUND(g, h, a, b, c, d, e, f, j + 2, W[j + 2]);
+            SHA256_ROUND(f, g, h, a, b, c, d, e, j + 3, W[j + 3]);
+            SHA256_ROUND(e, f, g, h, a, b, c, d, j + 4, W[j + 4]);
+            SHA256_ROUND(d, e, f, g, h, a, b, c, j + 5, W[j + 5]);
+            SHA256_ROUND(c, d, e, f, g, h, a, b, j + 6, W[j + 6]);
+            SHA256_ROUND(b, c, d, e, f, g, h, a, j + 7, W[j + 7]);
+        }
+        for (j = 16; j < 64; j += 8) {
+            SHA256_ROUND(a, b, c, d, e, f, g, h, j,     SHA256_W(j));
+            SHA256_ROUND(h, a, b, c, d, e, f, g, j + 1, SHA256_W(j + 1));
+            SHA256_ROUND(g, h, a, b, c, d, e, f, j + 2, SHA256_W(j + 2));
+            SHA256_ROUND(f, g, h, a, b, c, d, e, j + 3, SHA256_W(j + 3));
+            SHA256_ROUND(e, f, g, h, a, b, c, d, j + 4, SHA256_W(j + 4));
+            SHA256_ROUND(d, e, f, g, h, a, b, c, j + 5, SHA256_W(j + 5));
+            SHA256_ROUND(c, d, e, f, g, h, a, b, j + 6, SHA256_W(j + 6));
+            SHA256_ROUND(b, c, d, e, f, g, h, a, j + 7, SHA256_W(j + 7));
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        data += SHA256_BLOCK_LENGTH;
+    }
 
     /* Clean up */
-    a = b = c = d = e = f = g = h = T1 = T2 = 0;
+    a = b = c = d = e = f = g = h = T1 = 0;
+    utils_sha256_zeroize(W, sizeof(W));
+}
+#define UTILS_SHA256_BLOCKS     utils_sha256_blocks_sw
+
+#endif
+
+static void utils_sha256_blocks(iot_sha256_context *ctx, const unsigned char *data, size_t nblocks)
+{
+#ifdef HAL_CRYPTO_ENABLED
+    /* the engine takes one block at a time, software finishes whatever it declines */
+    for (; nblocks > 0; nblocks--, data += SHA256_BLOCK_LENGTH) {
+        if (0 != HAL_Crypto_Sha256Process(ctx->state, data)) {
+            break;
+        }
+    }
+    if (0 == nblocks) {
+        return;
+    }
+#endif
+
+    UTILS_SHA256_BLOCKS(ctx->state, data, nblocks);
+}
+
+void utils_sha256_process(iot_sha256_context *ctx, const uint32_t *data)
+{
+    utils_sha256_blocks(ctx, (const unsigned char *)data, 1);
 }
 void utils_sha256_update(iot_sha256_context *ctx, const unsigned char *input, size_t ilen)
 {
@@ -234,7 +382,7 @@ void utils_sha256_update(iot_sha256_context *ctx, const unsigned char *input, si
             ctx->bitcount += freespace << 3;
             ilen -= freespace;
             input += freespace;
-            utils_sha256_process(ctx, (uint32_t *) ctx->buffer);
+            utils_sha256_blocks(ctx, ctx->buffer, 1);
         } else {
             /* The buffer is not yet full */
             memcpy(&ctx->buffer[usedspace], input, ilen);
@@ -244,12 +392,14 @@ void utils_sha256_update(iot_sha256_context *ctx, const unsigned char *input, si
             return;
         }
     }
-    while (ilen >= SHA256_BLOCK_LENGTH) {
-        /* Process as many complete blocks as we can */
-        utils_sha256_process(ctx, (uint32_t *) input);
-        ctx->bitcount += SHA256_BLOCK_LENGTH << 3;
-        ilen -= SHA256_BLOCK_LENGTH;
-        input += SHA256_BLOCK_LENGTH;
+    if (ilen >= SHA256_BLOCK_LENGTH) {
+        /* Process as many complete blocks as we can, in one call */
+        size_t nblocks = ilen / SHA256_BLOCK_LENGTH;
+
+        utils_sha256_blocks(ctx, input, nblocks);
+        ctx->bitcount += (uint64_t)nblocks * SHA256_BLOCK_LENGTH << 3;
+        ilen -= nblocks * SHA256_BLOCK_LENGTH;
+        input += nblocks * SHA256_BLOCK_LENGTH;
     }
     if (ilen > 0) {
         /* There's left-overs, so save 'em */
@@ -228,11 +228,15 @@ uint64_t utils_get_epoch_time_from_ntp(char copy[], int len)
     char ntp_server[20] = {0};
     int ntp_server_index = 1;
     uint64_t time_in_ms = 0;
+    uint64_t sent_ms;
 
     for (ntp_server_index = 1; ntp_server_index <= 7; ntp_server_index ++) {
         HAL_Snprintf(ntp_server, 20, ALIYUN_NTP_SERVER, ntp_server_index);
+        sent_ms = HAL_UptimeMs();
         time_in_ms = _get_timestamp_from_ntp(ntp_server);
         if (time_in_ms > 0) {
+            /* the server stamped its reply about half way through the exchange */
+            utils_epoch_time_set(time_in_ms, sent_ms + (HAL_UptimeMs() - sent_ms) / 2);
             HAL_Snprintf(copy, len, "%lu", time_in_ms);
             break;
         }
@@ -240,3 +244,33 @@ uint64_t utils_get_epoch_time_from_ntp(char copy[], int len)
 
     return time_in_ms;
 }
+
+/* epoch time minus uptime, 0 till the first sync */
+static volatile int64_t g_epoch_offset_ms = 0;
+static volatile uint64_t g_epoch_synced_ms = 0;
+
+uint64_t utils_epoch_time_now(void)
+{
+    int64_t offset = g_epoch_offset_ms;
+
+    if (0 == offset) {
+        return 0;
+    }
+
+    return (uint64_t)((int64_t)HAL_UptimeMs() + offset);
+}
+
+void utils_epoch_time_set(uint64_t epoch_ms, uint64_t uptime_ms)
+{
+    if (0 == epoch_ms) {
+        return;
+    }
+
+    g_epoch_offset_ms = (int64_t)epoch_ms - (int64_t)uptime_ms;
+    g_epoch_synced_ms = HAL_UptimeMs();
+}
+
+int utils_epoch_time_need_sync(void)
+{
+    return (0 == g_epoch_offset_ms || HAL_UptimeMs() - g_epoch_synced_ms >= UTILS_EPOCH_TIME_RESYNC_MS);
+}
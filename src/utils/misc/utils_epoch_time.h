@@ -35,7 +35,40 @@ extern "C" {
  */
 uint64_t utils_get_epoch_time_from_ntp(char copy[], int len);
 
+/*
+ * One epoch clock for the whole SDK: a sync from NTP, the cloud's ntp topic or a timestamp the
+ * cloud sent records the epoch time against the uptime, and now() adds the uptime since, so a
+ * timestamp costs no I/O. utils_get_epoch_time_from_ntp() syncs it too.
+ */
+
+/* a sync older than this is due again */
+#ifndef UTILS_EPOCH_TIME_RESYNC_MS
+#define UTILS_EPOCH_TIME_RESYNC_MS      (6 * 3600 * 1000)
+#endif
+
+/**
+ * @brief Get epoch time in millisecond from the last sync and the uptime since, without any I/O.
+ *
+ * @return 0, never synced; OTHERS, epoch time
+ */
+uint64_t utils_epoch_time_now(void);
+
+/**
+ * @brief Sync the epoch clock from a time learnt elsewhere.
+ *
+ * @param epoch_ms: the epoch time in millisecond
+ * @param uptime_ms: HAL_UptimeMs() when it was @epoch_ms, the middle of the round-trip for a reply
+ */
+void utils_epoch_time_set(uint64_t epoch_ms, uint64_t uptime_ms);
+
+/**
+ * @brief Whether the clock was never synced or UTILS_EPOCH_TIME_RESYNC_MS passed since.
+ *
+ * @return 1, a sync is due; 0, not due
+ */
+int utils_epoch_time_need_sync(void);
+
 #ifdef __cplusplus
-extern "C" {
+}
 #endif
 #endif /* _ALIOT_EPOCH_TIME_H_ */
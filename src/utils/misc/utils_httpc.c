@@ -20,6 +20,7 @@
 #include <string.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 #include "iot_import.h"
 #include "utils_timer.h"
@@ -31,8 +32,6 @@
 
 #define HTTPCLIENT_AUTHB_SIZE     128
 
-#define HTTPCLIENT_CHUNK_SIZE     1024          /* read payload */
-#define HTTPCLIENT_RAED_HEAD_SIZE 32            /* read header */
 #define HTTPCLIENT_SEND_BUF_SIZE  1024          /* send */
 
 #define HTTPCLIENT_MAX_HOST_LEN   128
@@ -40,6 +39,23 @@
 
 #define HTTP_RETRIEVE_MORE_DATA   (1)            /**< More data needs to be retrieved. */
 
+/* a kept connection idle longer is not used again, servers close theirs after a while */
+#ifndef HTTPCLIENT_KEEPALIVE_IDLE_MS
+    #define HTTPCLIENT_KEEPALIVE_IDLE_MS    (30000)
+#endif
+
+#ifdef HTTP_CONN_POOL_ENABLED
+/* connections kept between requests, for any host, the one idle longest makes room for a new one */
+#ifndef HTTPCLIENT_POOL_SIZE
+    #define HTTPCLIENT_POOL_SIZE            (2)
+#endif
+
+/* the connection of a request by httpclient_common() is kept in the pool too */
+#define HTTPCLIENT_COMMON_KEEP_ALIVE        (1)
+#else
+#define HTTPCLIENT_COMMON_KEEP_ALIVE        (0)
+#endif
+
 #if defined(MBEDTLS_DEBUG_C)
     #define DEBUG_LEVEL 2
 #endif
@@ -50,10 +66,6 @@ static int httpclient_parse_url(const char *url, char *scheme, uint32_t max_sche
 static int httpclient_conn(httpclient_t *client);
 static int httpclient_recv(httpclient_t *client, char *buf, int min_len, int max_len, int *p_read_len,
                            uint32_t timeout);
-static int httpclient_retrieve_content(httpclient_t *client, char *data, int len, uint32_t timeout,
-                                       httpclient_data_t *client_data);
-static int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_t timeout,
-                                     httpclient_data_t *client_data);
 
 static void httpclient_base64enc(char *out, const char *in)
 {
@@ -301,8 +313,12 @@ int httpclient_send_header(httpclient_t *client, const char *url, int method, ht
         httpclient_get_info(client, send_buf, &len, (char *) client->header, strlen(client->header));
     }
 
-    if (client_data->post_buf != NULL) {
-        HAL_Snprintf(buf, sizeof(buf), "Content-Length: %d\r\n", client_data->post_buf_len);
+    if (client_data->post_buf != NULL || client_data->on_post != NULL) {
+        if (client_data->post_buf_len < 0) {
+            HAL_Snprintf(buf, sizeof(buf), "Transfer-Encoding: chunked\r\n");
+        } else {
+            HAL_Snprintf(buf, sizeof(buf), "Content-Length: %d\r\n", client_data->post_buf_len);
+        }
         httpclient_get_info(client, send_buf, &len, buf, strlen(buf));
 
         if (client_data->post_content_type != NULL) {
@@ -331,12 +347,74 @@ int httpclient_send_header(httpclient_t *client, const char *url, int method, ht
     return SUCCESS_RETURN;
 }
 
+static int httpclient_write_all(httpclient_t *client, const char *data, int len)
+{
+    int ret = client->net.write(&client->net, (char *)data, len, 5000);
+    if (ret > 0) {
+        return SUCCESS_RETURN;
+    } else if (ret == 0) {
+        log_err("ret == 0,Connection was closed by server");
+        return ERROR_HTTP_CLOSED; /* Connection was closed by server */
+    } else {
+        log_err("Connection error (send returned %d)", ret);
+        return ERROR_HTTP_CONN;
+    }
+}
+
+/* the body on_post hands, each piece as a chunk of its own when the length is not known */
+static int httpclient_send_post_cb(httpclient_t *client, httpclient_data_t *client_data)
+{
+    char size_line[12];
+    const char *data = NULL;
+    int len = 0;
+    int chunked = (client_data->post_buf_len < 0);
+    int ret;
+
+    if (client_data->on_post(client_data->on_post_ctx, NULL, NULL) < 0) {
+        return ERROR_HTTP;
+    }
+
+    do {
+        len = 0;
+        if (client_data->on_post(client_data->on_post_ctx, &data, &len) < 0) {
+            return ERROR_HTTP;
+        }
+
+        if (chunked) {
+            ret = HAL_Snprintf(size_line, sizeof(size_line), "%x\r\n", len);
+            ret = httpclient_write_all(client, size_line, ret);
+            if (SUCCESS_RETURN != ret) {
+                return ret;
+            }
+        }
+        if (len > 0) {
+            ret = httpclient_write_all(client, data, len);
+            if (SUCCESS_RETURN != ret) {
+                return ret;
+            }
+        }
+        if (chunked) {
+            /* ends the chunk, or the body with an empty trailer after the last one */
+            ret = httpclient_write_all(client, "\r\n", 2);
+            if (SUCCESS_RETURN != ret) {
+                return ret;
+            }
+        }
+    } while (len > 0);
+
+    return SUCCESS_RETURN;
+}
+
 int httpclient_send_userdata(httpclient_t *client, httpclient_data_t *client_data)
 {
     int ret = 0;
 
+    if (NULL != client_data->on_post) {
+        return httpclient_send_post_cb(client, client_data);
+    }
+
     if (client_data->post_buf && client_data->post_buf_len) {
-        log_debug("client_data->post_buf: %s", client_data->post_buf);
+        log_debug("client_data->post_buf: %d bytes", client_data->post_buf_len);
         {
             /* ret = httpclient_tcp_send_all(client->handle, (char *)client_data->post_buf, client_data->post_buf_len); */
             ret = client->net.write(&client->net, (char *)client_data->post_buf, client_data->post_buf_len, 5000);
@@ -413,282 +491,349 @@ int httpclient_recv(httpclient_t *client, char *buf, int min_len, int max_len, i
     /*    return 0; */
 }
 
-int httpclient_retrieve_content(httpclient_t *client, char *data, int len,
-                                uint32_t timeout_ms, httpclient_data_t *client_data)
+/* what the parser of a response reads next */
+enum {
+    HTTPCLIENT_PARSE_STATUS = 0,    /* status line */
+    HTTPCLIENT_PARSE_HEADER,        /* header lines, to the blank one */
+    HTTPCLIENT_PARSE_CHUNK_SIZE,    /* size line of a chunk */
+    HTTPCLIENT_PARSE_BODY,          /* retrieve_len bytes of the body, or of a chunk */
+    HTTPCLIENT_PARSE_CHUNK_END,     /* CRLF after the data of a chunk */
+    HTTPCLIENT_PARSE_TRAILER,       /* trailer lines after the last chunk, to the blank one */
+    HTTPCLIENT_PARSE_UNTIL_CLOSE,   /* body without a length, it ends when the server closes */
+    HTTPCLIENT_PARSE_DONE
+};
+
+#define HTTPCLIENT_PARSE_IN_BODY(state) \
+    (HTTPCLIENT_PARSE_BODY == (state) || HTTPCLIENT_PARSE_UNTIL_CLOSE == (state))
+
+/* if the header line is 'name: ...', both case insensitive, the value after the spaces or NULL */
+static char *httpclient_header_value(char *line, const char *name)
 {
-    int count = 0;
-    int templen = 0;
-    int crlf_pos;
-    iotx_time_t timer;
+    size_t name_len = strlen(name);
+    size_t i;
 
-    iotx_time_init(&timer);
-    utils_time_countdown_ms(&timer, timeout_ms);
+    for (i = 0; i < name_len && tolower((unsigned char)line[i]) == tolower((unsigned char)name[i]); i++);
+    if (i != name_len || line[i] != ':') {
+        return NULL;
+    }
 
-    /* Receive data */
-    log_debug("Current data: %s", data);
+    for (line += i + 1; *line == ' ' || *line == '\t'; line++);
+    return line;
+}
 
-    client_data->is_more = IOT_TRUE;
+static int httpclient_value_is(const char *value, const char *expected)
+{
+    size_t i;
 
-    /* the header is not received finished */
-    if (client_data->response_content_len == -1 && client_data->is_chunked == IOT_FALSE) {
-        /* can not enter this if */
-        while (1) {
-            int ret, max_len;
-            if (count + len < client_data->response_buf_len - 1) {
-                memcpy(client_data->response_buf + count, data, len);
-                count += len;
-                client_data->response_buf[count] = '\0';
-            } else {
-                memcpy(client_data->response_buf + count, data, client_data->response_buf_len - 1 - count);
-                client_data->response_buf[client_data->response_buf_len - 1] = '\0';
-                return HTTP_RETRIEVE_MORE_DATA;
-            }
+    for (i = 0; expected[i] && tolower((unsigned char)value[i]) == expected[i]; i++);
+    return ('\0' == expected[i]);
+}
+
+/* the status line */
+static int httpclient_parse_status(httpclient_t *client, httpclient_data_t *client_data, char *line)
+{
+    if ('\0' == line[0]) {
+        /* a CRLF some servers leave after the body before */
+        return SUCCESS_RETURN;
+    }
+    if (0 != memcmp(line, "HTTP/", 5) || strlen(line) < 12) {
+        log_err("Not a correct HTTP answer : %s", line);
+        return ERROR_HTTP_PRTCL;
+    }
 
-            /* try to read more header */
-            max_len = HTTPCLIENT_MIN(HTTPCLIENT_RAED_HEAD_SIZE, client_data->response_buf_len - 1 - count);
-            ret = httpclient_recv(client, data, 1, max_len, &len, iotx_time_left(&timer));
+    client->response_code = atoi(line + 9);
+    /* HTTP/1.0 servers close the connection unless they say otherwise */
+    client->server_close = (0 == memcmp(line, "HTTP/1.0", 8));
+    log_debug("Reading headers: %s", line);
 
-            /* Receive data */
-            log_debug("data len: %d %d", len, count);
+    if ((client->response_code < 200) || (client->response_code >= 400)) {
+        log_warning("Response code %d", client->response_code);
+    }
 
-            if (ret == ERROR_HTTP_CONN) {
-                log_debug("ret == ERROR_HTTP_CONN");
-                return ret;
-            }
+    client_data->parser.state = HTTPCLIENT_PARSE_HEADER;
+    return SUCCESS_RETURN;
+}
 
-            if (len == 0) {
-                /* read no more data */
-                log_debug("no more len == 0");
-                client_data->is_more = IOT_FALSE;
-                return SUCCESS_RETURN;
+/* a header line, at the blank one the body is known to have a length, be chunked or end with the connection */
+static int httpclient_parse_header(httpclient_t *client, httpclient_data_t *client_data, char *line)
+{
+    httpclient_parser_t *parser = &client_data->parser;
+    char *value;
+
+    if ('\0' != line[0]) {
+        if (NULL != (value = httpclient_header_value(line, "Content-Length"))) {
+            client_data->response_content_len = atoi(value);
+        } else if (NULL != (value = httpclient_header_value(line, "Transfer-Encoding"))) {
+            client_data->is_chunked = httpclient_value_is(value, "chunked");
+        } else if (NULL != (value = httpclient_header_value(line, "Connection"))) {
+            if (httpclient_value_is(value, "close")) {
+                client->server_close = 1;
+            } else if (httpclient_value_is(value, "keep-alive")) {
+                client->server_close = 0;
             }
         }
+        return SUCCESS_RETURN;
     }
 
-    while (1) {
-        uint32_t readLen = 0;
-
-        if (client_data->is_chunked && client_data->retrieve_len <= 0) {
-            /* Read chunk header */
-            int foundCrlf;
-            int n;
-            do {
-                foundCrlf = IOT_FALSE;
-                crlf_pos = 0;
-                data[len] = 0;
-                if (len >= 2) {
-                    for (; crlf_pos < len - 2; crlf_pos++) {
-                        if (data[crlf_pos] == '\r' && data[crlf_pos + 1] == '\n') {
-                            foundCrlf = IOT_TRUE;
-                            break;
-                        }
-                    }
-                }
-                if (!foundCrlf) {
-                    /* Try to read more */
-                    if (len < HTTPCLIENT_CHUNK_SIZE) {
-                        int new_trf_len, ret;
-                        ret = httpclient_recv(client,
-                                              data + len,
-                                              0,
-                                              HTTPCLIENT_CHUNK_SIZE - len - 1,
-                                              &new_trf_len,
-                                              iotx_time_left(&timer));
-                        len += new_trf_len;
-                        if (ret == ERROR_HTTP_CONN) {
-                            return ret;
-                        } else {
-                            continue;
-                        }
-                    } else {
-                        return ERROR_HTTP;
-                    }
-                }
-            } while (!foundCrlf);
-            data[crlf_pos] = '\0';
-
-            /* chunk length */
-            /* n = sscanf(data, "%x", &readLen); */
-
-            readLen = strtoul(data, NULL, 16);
-            n = (0 == readLen) ? 0 : 1;
-            client_data->retrieve_len = readLen;
-            client_data->response_content_len += client_data->retrieve_len;
-            if (readLen == 0) {
-                /* Last chunk */
-                client_data->is_more = IOT_FALSE;
-                log_debug("no more (last chunk)");
-            }
+    if (client->response_code >= 100 && client->response_code < 200) {
+        /* an interim response, the real one follows */
+        client_data->response_content_len = -1;
+        client_data->is_chunked = IOT_FALSE;
+        parser->state = HTTPCLIENT_PARSE_STATUS;
+    } else if (client_data->is_chunked) {
+        client_data->response_content_len = 0;
+        client_data->retrieve_len = 0;
+        parser->state = HTTPCLIENT_PARSE_CHUNK_SIZE;
+    } else if (client_data->response_content_len >= 0) {
+        client_data->retrieve_len = client_data->response_content_len;
+        parser->state = (client_data->retrieve_len > 0) ? HTTPCLIENT_PARSE_BODY : HTTPCLIENT_PARSE_DONE;
+    } else if (204 == client->response_code || 304 == client->response_code) {
+        client_data->response_content_len = 0;
+        client_data->retrieve_len = 0;
+        parser->state = HTTPCLIENT_PARSE_DONE;
+    } else {
+        log_debug("no length of the body, read it until the connection closes");
+        client->server_close = 1;
+        client_data->response_content_len = 0;
+        client_data->retrieve_len = 0;
+        parser->state = HTTPCLIENT_PARSE_UNTIL_CLOSE;
+    }
 
-            if (n != 1) {
-                log_err("Could not read chunk length");
-                return ERROR_HTTP_UNRESOLVED_DNS;
-            }
+    return SUCCESS_RETURN;
+}
 
-            memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2)); /* Not need to move NULL-terminating char any more */
-            len -= (crlf_pos + 2);
-        } else {
-            readLen = client_data->retrieve_len;
-        }
+/* the size line of a chunk, extensions after ';' are ignored */
+static int httpclient_parse_chunk_size(httpclient_data_t *client_data, char *line)
+{
+    char *end;
+    unsigned long size = strtoul(line, &end, 16);
 
-        log_debug("Total-Payload: %d Bytes; Read: %d Bytes", readLen, len);
+    if (end == line) {
+        log_err("Could not read chunk length");
+        return ERROR_HTTP_PRTCL;
+    }
 
-        do {
-            templen = HTTPCLIENT_MIN(len, readLen);
-            if (count + templen < client_data->response_buf_len - 1) {
-                memcpy(client_data->response_buf + count, data, templen);
-                count += templen;
-                client_data->response_buf[count] = '\0';
-                client_data->retrieve_len -= templen;
-            } else {
-                memcpy(client_data->response_buf + count, data, client_data->response_buf_len - 1 - count);
-                client_data->response_buf[client_data->response_buf_len - 1] = '\0';
-                client_data->retrieve_len -= (client_data->response_buf_len - 1 - count);
-                return HTTP_RETRIEVE_MORE_DATA;
-            }
+    if (0 == size) {
+        log_debug("no more (last chunk)");
+        client_data->parser.state = HTTPCLIENT_PARSE_TRAILER;
+        return SUCCESS_RETURN;
+    }
 
-            if (len > readLen) {
-                log_debug("memmove %d %d %d\n", readLen, len, client_data->retrieve_len);
-                memmove(data, &data[readLen], len - readLen); /* chunk case, read between two chunks */
-                len -= readLen;
-                readLen = 0;
-                client_data->retrieve_len = 0;
-            } else {
-                readLen -= len;
-            }
+    client_data->retrieve_len = size;
+    client_data->response_content_len += size;
+    client_data->parser.state = HTTPCLIENT_PARSE_BODY;
+    return SUCCESS_RETURN;
+}
 
-            if (readLen) {
-                int ret;
-                int max_len = HTTPCLIENT_MIN(HTTPCLIENT_CHUNK_SIZE - 1, client_data->response_buf_len - 1 - count);
-                max_len = HTTPCLIENT_MIN(max_len, readLen);
-                ret = httpclient_recv(client, data, 1, max_len, &len, iotx_time_left(&timer));
-                if (ret == ERROR_HTTP_CONN) {
-                    return ret;
-                }
-            }
-        } while (readLen);
-
-        if (client_data->is_chunked) {
-            if (len < 2) {
-                int new_trf_len, ret;
-                /* Read missing chars to find end of chunk */
-                ret = httpclient_recv(client, data + len, 2 - len, HTTPCLIENT_CHUNK_SIZE - len - 1, &new_trf_len,
-                                      iotx_time_left(&timer));
-                if (ret == ERROR_HTTP_CONN) {
-                    return ret;
-                }
-                len += new_trf_len;
+static int httpclient_parse_line(httpclient_t *client, httpclient_data_t *client_data, char *line)
+{
+    httpclient_parser_t *parser = &client_data->parser;
+
+    switch (parser->state) {
+        case HTTPCLIENT_PARSE_STATUS:
+            return httpclient_parse_status(client, client_data, line);
+        case HTTPCLIENT_PARSE_HEADER:
+            return httpclient_parse_header(client, client_data, line);
+        case HTTPCLIENT_PARSE_CHUNK_SIZE:
+            return httpclient_parse_chunk_size(client_data, line);
+        case HTTPCLIENT_PARSE_CHUNK_END:
+            if ('\0' != line[0]) {
+                log_err("Format error, %s", line);
+                return ERROR_HTTP_PRTCL;
             }
-            if ((data[0] != '\r') || (data[1] != '\n')) {
-                log_err("Format error, %s", data); /* after memmove, the beginning of next chunk */
-                return ERROR_HTTP_UNRESOLVED_DNS;
+            parser->state = HTTPCLIENT_PARSE_CHUNK_SIZE;
+            return SUCCESS_RETURN;
+        case HTTPCLIENT_PARSE_TRAILER:
+            if ('\0' == line[0]) {
+                parser->state = HTTPCLIENT_PARSE_DONE;
             }
-            memmove(data, &data[2], len - 2); /* remove the \r\n */
-            len -= 2;
-        } else {
-            log_debug("no more (content-length)");
-            client_data->is_more = IOT_FALSE;
-            break;
-        }
-
+            return SUCCESS_RETURN;
+        default:
+            return ERROR_HTTP;
     }
-
-    return SUCCESS_RETURN;
 }
 
-int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_t timeout_ms,
-                              httpclient_data_t *client_data)
+/* takes the bytes of the next line out of data[0, len), the bytes taken, or negative at a bad line */
+static int httpclient_take_line(httpclient_t *client, httpclient_data_t *client_data, char *data, int len)
 {
-    int crlf_pos;
-    iotx_time_t timer;
-    char *tmp_ptr, *ptr_body_end;
-    
-    int new_trf_len, ret;
+    httpclient_parser_t *parser = &client_data->parser;
+    char *lf = memchr(data, '\n', len);
+    int taken = (NULL == lf) ? len : (int)(lf - data) + 1;
+    int line_len = (NULL == lf) ? len : (int)(lf - data);
+    int kept = HTTPCLIENT_MIN(line_len, HTTPCLIENT_PARSE_LINE_SIZE - 1 - HTTPCLIENT_MIN(parser->line_len,
+                              HTTPCLIENT_PARSE_LINE_SIZE - 1));
+    int end;
+    int ret;
 
-    iotx_time_init(&timer);
-    utils_time_countdown_ms(&timer, timeout_ms);
+    if (kept > 0) {
+        memcpy(parser->line + parser->line_len, data, kept);
+    }
+    parser->line_len += line_len;
 
-    client_data->response_content_len = -1;
+    if (NULL == lf) {
+        return taken;
+    }
 
-    /* http client response */
-    /* <status-line> HTTP/1.1 200 OK(CRLF)
+    end = HTTPCLIENT_MIN(parser->line_len, HTTPCLIENT_PARSE_LINE_SIZE - 1);
+    if (end > 0 && '\r' == parser->line[end - 1] && parser->line_len <= HTTPCLIENT_PARSE_LINE_SIZE - 1) {
+        end--;
+    }
+    parser->line[end] = '\0';
+    parser->line_len = 0;
 
-       <headers> ...(CRLF)
+    ret = httpclient_parse_line(client, client_data, parser->line);
+    return (ret < 0) ? ret : taken;
+}
+
+/* len bytes of the body at data are taken, to on_body if set */
+static int httpclient_take_body(httpclient_data_t *client_data, char *data, int len)
+{
+    httpclient_parser_t *parser = &client_data->parser;
 
-       <blank line> (CRLF)
+    client_data->response_received_len += len;
+    if (HTTPCLIENT_PARSE_UNTIL_CLOSE == parser->state) {
+        client_data->response_content_len += len;
+    } else {
+        client_data->retrieve_len -= len;
+        if (0 == client_data->retrieve_len) {
+            parser->state = client_data->is_chunked ? HTTPCLIENT_PARSE_CHUNK_END : HTTPCLIENT_PARSE_DONE;
+        }
+    }
 
-      [<response-body>] */
-    char *crlf_ptr = strstr(data, "\r\n");
-    if (crlf_ptr == NULL) {
-        log_err("\r\n not found");
-        return ERROR_HTTP_UNRESOLVED_DNS;
+    if (NULL != client_data->on_body && 0 != client_data->on_body(client_data->on_body_ctx, data, len)) {
+        log_info("response body stopped by its callback");
+        return ERROR_HTTP_BREAK;
     }
 
-    crlf_pos = crlf_ptr - data;
-    data[crlf_pos] = '\0';
+    return SUCCESS_RETURN;
+}
 
-    /* Parse HTTP response */
-#if 0
-    if (sscanf(data, "HTTP/%*d.%*d %d %*[^\r\n]", &(client->response_code)) != 1) {
-        /* Cannot match string, error */
-        log_err("Not a correct HTTP answer : %s\n", data);
-        return ERROR_HTTP_UNRESOLVED_DNS;
+/* the most of the body the next read may take, the rest of the body, of the chunk, or of response_buf */
+static int httpclient_body_room(httpclient_data_t *client_data, int count)
+{
+    int room = (NULL != client_data->on_body) ? client_data->response_buf_len : client_data->response_buf_len - 1 - count;
+
+    if (HTTPCLIENT_PARSE_BODY == client_data->parser.state) {
+        room = HTTPCLIENT_MIN(room, client_data->retrieve_len);
     }
-#endif
+    return room;
+}
 
-    client->response_code = atoi(data + 9);
+/*
+ * Parses the response on any boundaries the bytes are read on. Lines go through the bytes read ahead, the body is
+ * read straight into response_buf, or handed to on_body from where it was read, it is copied at most once.
+ */
+int httpclient_recv_response(httpclient_t *client, uint32_t timeout_ms, httpclient_data_t *client_data)
+{
+    httpclient_parser_t *parser = &client_data->parser;
+    iotx_time_t timer;
+    char *data;
+    int count = 0;  /* bytes of the body in response_buf */
+    int room, len, ret;
 
-    if ((client->response_code < 200) || (client->response_code >= 400)) {
-        /* Did not return a 2xx code; TODO fetch headers/(&data?) anyway and implement a mean of writing/reading headers */
-        log_warning("Response code %d", client->response_code);
+    if (0 == client->net.handle) {
+        log_debug("not connection have been established");
+        return ERROR_HTTP_CONN;
+    }
+
+    if (!client_data->is_more) {
+        /* a new response */
+        memset(parser, 0, sizeof(httpclient_parser_t));
+        parser->state = HTTPCLIENT_PARSE_STATUS;
+        client->response_code = 0;
+        client_data->is_more = IOT_TRUE;
+        client_data->is_chunked = IOT_FALSE;
+        client_data->response_content_len = -1;
+        client_data->retrieve_len = 0;
+        client_data->response_received_len = 0;
+    }
+    if (NULL == client_data->on_body) {
+        client_data->response_buf[0] = '\0';
     }
 
-    log_debug("Reading headers: %s", data);
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, timeout_ms);
 
-    memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1); /* Be sure to move NULL-terminating char as well */
-    len -= (crlf_pos + 2);       /* remove status_line length */
+    while (HTTPCLIENT_PARSE_DONE != parser->state) {
+        room = HTTPCLIENT_PARSE_IN_BODY(parser->state) ? httpclient_body_room(client_data, count) : 0;
+        if (HTTPCLIENT_PARSE_IN_BODY(parser->state) && room <= 0) {
+            /* response_buf is full */
+            return HTTP_RETRIEVE_MORE_DATA;
+        }
 
-    client_data->is_chunked = IOT_FALSE;
+        if (parser->ahead_pos < parser->ahead_len) {
+            data = parser->ahead + parser->ahead_pos;
+            len = parser->ahead_len - parser->ahead_pos;
+            if (!HTTPCLIENT_PARSE_IN_BODY(parser->state)) {
+                ret = httpclient_take_line(client, client_data, data, len);
+                if (ret < 0) {
+                    return ret;
+                }
+                parser->ahead_pos += ret;
+                continue;
+            }
 
-    /*If not ending of response body*/
-    /* try to read more header again until find response head ending "\r\n\r\n" */
-    while(NULL == (ptr_body_end = strstr(data, "\r\n\r\n"))) {
-        /* try to read more header */
-        ret = httpclient_recv(client, data + len, 1, HTTPCLIENT_RAED_HEAD_SIZE, &new_trf_len, iotx_time_left(&timer));
-        if (ret == ERROR_HTTP_CONN) {
+            len = HTTPCLIENT_MIN(len, room);
+            parser->ahead_pos += len;
+            if (NULL == client_data->on_body) {
+                memcpy(client_data->response_buf + count, data, len);
+                count += len;
+                client_data->response_buf[count] = '\0';
+            }
+            ret = httpclient_take_body(client_data, data, len);
+            if (ret < 0) {
+                return ret;
+            }
+            continue;
+        }
+
+        /* all read ahead is parsed, the body is read where it goes, lines ahead */
+        if (HTTPCLIENT_PARSE_IN_BODY(parser->state)) {
+            data = (NULL == client_data->on_body) ? client_data->response_buf + count : client_data->response_buf;
+        } else {
+            data = parser->ahead;
+            room = HTTPCLIENT_PARSE_AHEAD_SIZE;
+            parser->ahead_pos = 0;
+            parser->ahead_len = 0;
+        }
+
+        ret = httpclient_recv(client, data, 1, room, &len, iotx_time_left(&timer));
+        if (ERROR_HTTP_CONN == ret && HTTPCLIENT_PARSE_UNTIL_CLOSE == parser->state) {
+            log_debug("no more (connection closed)");
+            parser->state = HTTPCLIENT_PARSE_DONE;
+            break;
+        }
+        if (0 != ret) {
             return ret;
         }
-        len += new_trf_len;
-        data[len] = '\0';
-    }
+        if (NULL != client_data->on_body) {
+            /* with the body going on, each read has all the time for it */
+            utils_time_countdown_ms(&timer, timeout_ms);
+        }
 
-    /* parse response_content_len */
-    if (NULL != (tmp_ptr = strstr(data, "Content-Length"))) {
-        client_data->response_content_len = atoi(tmp_ptr + strlen("Content-Length: "));
-        client_data->retrieve_len = client_data->response_content_len;
-    } else if (NULL != (tmp_ptr = strstr(data, "Transfer-Encoding"))) {
-        int len_chunk = strlen("Chunked");
-        char *chunk_value = data + strlen("Transfer-Encoding: ");
+        if (data == parser->ahead) {
+            parser->ahead_len = len;
+            continue;
+        }
 
-        if ((! memcmp(chunk_value, "Chunked", len_chunk))
-            || (! memcmp(chunk_value, "chunked", len_chunk))) {
-            client_data->is_chunked = IOT_TRUE;
-            client_data->response_content_len = 0;
-            client_data->retrieve_len = 0;
+        if (NULL == client_data->on_body) {
+            count += len;
+            client_data->response_buf[count] = '\0';
+        }
+        ret = httpclient_take_body(client_data, data, len);
+        if (ret < 0) {
+            return ret;
         }
-    } else {
-        log_err("Could not parse header");
-        return ERROR_HTTP;
     }
-    
-    /* remove header length */
-    /* len is Had read body's length */
-    /* if client_data->response_content_len != 0, it is know response length */
-    /* the remain length is client_data->response_content_len - len */
-    len = len - (ptr_body_end + 4 - data);   
-    memmove(data, ptr_body_end + 4, len + 1);
-    client_data->response_received_len += len;
-    return httpclient_retrieve_content(client, data, len, iotx_time_left(&timer), client_data);
+
+    if (parser->ahead_pos < parser->ahead_len) {
+        /* requests are not pipelined, what follows the response can not be told for the next one */
+        log_warning("%d bytes after the response", parser->ahead_len - parser->ahead_pos);
+        client->server_close = 1;
+    }
+
+    client_data->is_more = IOT_FALSE;
+    return SUCCESS_RETURN;
 }
 
 int httpclient_connect(httpclient_t *client)
@@ -729,60 +874,142 @@ int httpclient_send_request(httpclient_t *client, const char *url, HTTPCLIENT_RE
     return ret;
 }
 
-int httpclient_recv_response(httpclient_t *client, uint32_t timeout_ms, httpclient_data_t *client_data)
+void httpclient_close(httpclient_t *client)
 {
-    int reclen = 0, ret = ERROR_HTTP_CONN;
-    char buf[HTTPCLIENT_CHUNK_SIZE] = { 0 };
-    iotx_time_t timer;
+    if (client->net.handle > 0) {
+        client->net.disconnect(&client->net);
+    }
+    client->net.handle = 0;
+    log_debug("client disconnected");
+}
 
-    iotx_time_init(&timer);
-    utils_time_countdown_ms(&timer, timeout_ms);
+#ifdef HTTP_CONN_POOL_ENABLED
+typedef struct {
+    char                host[HTTPCLIENT_MAX_HOST_LEN];
+    int                 port;
+    const char         *ca_crt;
+    utils_network_t     net;
+    uint64_t            idle_since;
+} httpclient_pool_entry_t;
 
-    if (0 == client->net.handle) {
-        log_debug("not connection have been established");
-        return ret;
+static httpclient_pool_entry_t  g_httpclient_pool[HTTPCLIENT_POOL_SIZE];
+static void                    *g_httpclient_pool_lock = NULL;
+
+static void httpclient_pool_lock(void)
+{
+    /* created by the first request to keep a connection, before others can come from other threads */
+    if (NULL == g_httpclient_pool_lock) {
+        g_httpclient_pool_lock = HAL_MutexCreate();
+    }
+    if (NULL != g_httpclient_pool_lock) {
+        HAL_MutexLock(g_httpclient_pool_lock);
     }
+}
 
-    if (client_data->is_more) {
-        client_data->response_buf[0] = '\0';
-        ret = httpclient_retrieve_content(client, buf, reclen, iotx_time_left(&timer), client_data);
-    } else {
-        client_data->is_more = 1;
-        /* try to read header */
-        ret = httpclient_recv(client, buf, 1, HTTPCLIENT_RAED_HEAD_SIZE, &reclen, iotx_time_left(&timer));
-        if (ret != 0) {
-            return ret;
-        }
+static void httpclient_pool_unlock(void)
+{
+    if (NULL != g_httpclient_pool_lock) {
+        HAL_MutexUnlock(g_httpclient_pool_lock);
+    }
+}
 
-        buf[reclen] = '\0';
+static void httpclient_pool_drop(httpclient_pool_entry_t *entry)
+{
+    log_debug("close kept connection to %s:%d", entry->host, entry->port);
+    entry->net.disconnect(&entry->net);
+    memset(entry, 0, sizeof(httpclient_pool_entry_t));
+}
 
-        if (reclen) {
-            log_multi_line(LOG_DEBUG_LEVEL, "RESPONSE", "%s", buf, "<");
-            ret = httpclient_response_parse(client, buf, reclen, iotx_time_left(&timer), client_data);
+/* moves a connection kept to host:port into client, 1 if there was one */
+static int httpclient_pool_take(httpclient_t *client, const char *host, int port, const char *ca_crt)
+{
+    httpclient_pool_entry_t *entry;
+    uint64_t now = HAL_UptimeMs();
+    int taken = 0;
+    int i;
+
+    httpclient_pool_lock();
+    for (i = 0; i < HTTPCLIENT_POOL_SIZE; i++) {
+        entry = &g_httpclient_pool[i];
+        if (0 == entry->net.handle) {
+            continue;
+        }
+        if (now - entry->idle_since > HTTPCLIENT_KEEPALIVE_IDLE_MS) {
+            httpclient_pool_drop(entry);
+            continue;
+        }
+        if (!taken && entry->port == port && entry->ca_crt == ca_crt && 0 == strcmp(entry->host, host)) {
+            client->net = entry->net;
+            client->idle_since = entry->idle_since;
+            memset(entry, 0, sizeof(httpclient_pool_entry_t));
+            taken = 1;
         }
     }
+    httpclient_pool_unlock();
 
-    return ret;
+    if (taken) {
+        log_debug("reuse kept connection to %s:%d", host, port);
+    }
+    return taken;
 }
 
-void httpclient_close(httpclient_t *client)
+/* keeps the connection of client for the next request to host:port */
+static void httpclient_pool_put(httpclient_t *client, const char *host, int port, const char *ca_crt)
 {
-    if (client->net.handle > 0) {
-        client->net.disconnect(&client->net);
+    httpclient_pool_entry_t *slot = NULL;
+    int i;
+
+    httpclient_pool_lock();
+    for (i = 0; i < HTTPCLIENT_POOL_SIZE; i++) {
+        if (0 == g_httpclient_pool[i].net.handle) {
+            slot = &g_httpclient_pool[i];
+            break;
+        }
+        if (NULL == slot || g_httpclient_pool[i].idle_since < slot->idle_since) {
+            slot = &g_httpclient_pool[i];
+        }
+    }
+    if (0 != slot->net.handle) {
+        httpclient_pool_drop(slot);
     }
+
+    strncpy(slot->host, host, sizeof(slot->host) - 1);
+    slot->port = port;
+    slot->ca_crt = ca_crt;
+    slot->net = client->net;
+    slot->idle_since = client->idle_since;
+    httpclient_pool_unlock();
+
     client->net.handle = 0;
-    log_debug("client disconnected");
 }
 
-int httpclient_common(httpclient_t *client, const char *url, int port, const char *ca_crt,
-                      HTTPCLIENT_REQUEST_TYPE method, uint32_t timeout_ms, httpclient_data_t *client_data)
+void httpclient_pool_clear(const char *url)
 {
-    iotx_time_t timer;
-    int ret = 0;
     char host[HTTPCLIENT_MAX_HOST_LEN] = { 0 };
+    int i;
 
-    httpclient_parse_host(url, host, sizeof(host));
-    log_debug("host: '%s', port: %d", host, port);
+    if (NULL != url && SUCCESS_RETURN != httpclient_parse_host(url, host, sizeof(host))) {
+        return;
+    }
+
+    httpclient_pool_lock();
+    for (i = 0; i < HTTPCLIENT_POOL_SIZE; i++) {
+        if (0 != g_httpclient_pool[i].net.handle && (NULL == url || 0 == strcmp(g_httpclient_pool[i].host, host))) {
+            httpclient_pool_drop(&g_httpclient_pool[i]);
+        }
+    }
+    httpclient_pool_unlock();
+}
+#endif  /* HTTP_CONN_POOL_ENABLED */
+
+/* connects client unless it has a connection kept from before, and sends the request */
+static int httpclient_open(httpclient_t *client, const char *host, int port, const char *ca_crt, const char *url,
+                           HTTPCLIENT_REQUEST_TYPE method, httpclient_data_t *client_data)
+{
+    int ret;
+
+    client->response_code = 0;
+    client->server_close = 0;
 
     if (0 == client->net.handle) {
         /* Establish connection if no. */
@@ -801,37 +1028,153 @@ int httpclient_common(httpclient_t *client, const char *url, int port, const cha
             httpclient_close(client);
             return ret;
         }
+    }
 
-        ret = httpclient_send_request(client, url, method, client_data);
-        if (0 != ret) {
-            log_err("httpclient_send_request is error, ret = %d", ret);
-            httpclient_close(client);
-            return ret;
-        }
+    ret = httpclient_send_request(client, url, method, client_data);
+    if (0 != ret) {
+        log_err("httpclient_send_request is error, ret = %d", ret);
+        httpclient_close(client);
+    }
+
+    return ret;
+}
+
+/*
+ * sends the request and receives the response. when the request went on a kept connection the server had
+ * closed before answering, it is sent once more on a new connection.
+ */
+static int httpclient_exchange(httpclient_t *client, const char *host, int port, const char *ca_crt, const char *url,
+                               HTTPCLIENT_REQUEST_TYPE method, uint32_t timeout_ms, httpclient_data_t *client_data,
+                               int reused)
+{
+    iotx_time_t timer;
+    int ret;
+
+    ret = httpclient_open(client, host, port, ca_crt, url, method, client_data);
+    if (0 != ret && reused) {
+        log_info("kept connection closed by the server, send again on a new one");
+        reused = 0;
+        ret = httpclient_open(client, host, port, ca_crt, url, method, client_data);
+    }
+    if (0 != ret) {
+        return ret;
+    }
+
+    if ((NULL == client_data->response_buf)
+        || (0 == client_data->response_buf_len)) {
+        return 0;
     }
 
     iotx_time_init(&timer);
     utils_time_countdown_ms(&timer, timeout_ms);
 
-    if ((NULL != client_data->response_buf)
-        && (0 != client_data->response_buf_len)) {
+    ret = httpclient_recv_response(client, iotx_time_left(&timer), client_data);
+    if (ret == ERROR_HTTP_CONN && reused && 0 == client->response_code) {
+        log_info("kept connection closed by the server, send again on a new one");
+        httpclient_close(client);
+        client_data->is_more = IOT_FALSE;
+        ret = httpclient_open(client, host, port, ca_crt, url, method, client_data);
+        if (0 != ret) {
+            return ret;
+        }
         ret = httpclient_recv_response(client, iotx_time_left(&timer), client_data);
+    }
+    if (ret < 0) {
+        log_err("httpclient_recv_response is error,ret = %d", ret);
+        httpclient_close(client);
+    }
+
+    return ret;
+}
+
+/* keeps the connection for the next request if it can carry one, else closes it */
+static void httpclient_release(httpclient_t *client, const char *host, int port, const char *ca_crt, int keep_alive)
+{
+    if (!keep_alive || client->server_close || 0 == client->net.handle) {
+        log_info("close http channel");
+        httpclient_close(client);
+        return;
+    }
+
+    client->idle_since = HAL_UptimeMs();
+#ifdef HTTP_CONN_POOL_ENABLED
+    httpclient_pool_put(client, host, port, ca_crt);
+#endif
+}
+
+int httpclient_common(httpclient_t *client, const char *url, int port, const char *ca_crt,
+                      HTTPCLIENT_REQUEST_TYPE method, uint32_t timeout_ms, httpclient_data_t *client_data)
+{
+    int ret = 0;
+    int reused = 0;
+    char host[HTTPCLIENT_MAX_HOST_LEN] = { 0 };
+
+    httpclient_parse_host(url, host, sizeof(host));
+    log_debug("host: '%s', port: %d", host, port);
+
+    if (0 == client->net.handle) {
+#ifdef HTTP_CONN_POOL_ENABLED
+        reused = httpclient_pool_take(client, host, port, ca_crt);
+#endif
+        ret = httpclient_exchange(client, host, port, ca_crt, url, method, timeout_ms, client_data, reused);
+    } else if ((NULL != client_data->response_buf)
+               && (0 != client_data->response_buf_len)) {
+        /* the rest of the response */
+        ret = httpclient_recv_response(client, timeout_ms, client_data);
         if (ret < 0) {
             log_err("httpclient_recv_response is error,ret = %d", ret);
             httpclient_close(client);
-            return ret;
         }
     }
+    if (ret < 0) {
+        return ret;
+    }
 
     if (! client_data->is_more) {
-        /* Close the HTTP if no more data. */
-        log_info("close http channel");
-        httpclient_close(client);
+        /* Close the HTTP if no more data, or keep it in the pool. */
+        httpclient_release(client, host, port, ca_crt, HTTPCLIENT_COMMON_KEEP_ALIVE);
     }
 
     return (ret >= 0) ? 0 : -1;
 }
 
+int iotx_post_recv(httpclient_t *client,
+                   const char *url,
+                   int port,
+                   const char *ca_crt,
+                   uint32_t timeout_ms,
+                   httpclient_data_t *client_data,
+                   int keep_alive)
+{
+    int ret;
+    int reused;
+    char host[HTTPCLIENT_MAX_HOST_LEN] = { 0 };
+
+    httpclient_parse_host(url, host, sizeof(host));
+    log_debug("host: '%s', port: %d", host, port);
+
+    if (0 != client->net.handle && HAL_UptimeMs() - client->idle_since > HTTPCLIENT_KEEPALIVE_IDLE_MS) {
+        log_info("kept connection idle too long, close it");
+        httpclient_close(client);
+    }
+#ifdef HTTP_CONN_POOL_ENABLED
+    if (0 == client->net.handle) {
+        httpclient_pool_take(client, host, port, ca_crt);
+    }
+#endif
+    reused = (0 != client->net.handle);
+
+    ret = httpclient_exchange(client, host, port, ca_crt, url, HTTPCLIENT_POST, timeout_ms, client_data, reused);
+    if (ret < 0) {
+        return ret;
+    }
+
+    /* what is left of a response too long for the buffer would be taken for the next response */
+    httpclient_release(client, host, port, ca_crt, keep_alive && !client_data->is_more);
+
+    return ret;
+}
+
 int utils_get_response_code(httpclient_t *client)
 {
     return client->response_code;
@@ -84,8 +84,42 @@ typedef struct {
     char               *header;         /**< Custom header. */
     char               *auth_user;      /**< Username for basic authentication. */
     char               *auth_password;  /**< Password for basic authentication. */
+    int                 server_close;   /**< The server closes the connection after the response being read. */
+    uint64_t            idle_since;     /**< Uptime the connection was last done with, to let it go once idle too long. */
 } httpclient_t;
 
+/** @brief   This macro defines the bytes read ahead of the response parser, header and chunk lines are read in such slices. */
+#ifndef HTTPCLIENT_PARSE_AHEAD_SIZE
+    #define HTTPCLIENT_PARSE_AHEAD_SIZE     (256)
+#endif
+
+/** @brief   This macro defines the bytes of a status, header or chunk line looked at, the rest of a longer line is skipped. */
+#define HTTPCLIENT_PARSE_LINE_SIZE          (64)
+
+/** @brief   This structure defines where the parse of a response is, kept from one part of the response to the next. */
+typedef struct {
+    int     state;                               /**< What the next bytes are, status line, headers, body, chunk line... */
+    int     line_len;                            /**< Length of the line being read, it may be more than line holds. */
+    char    line[HTTPCLIENT_PARSE_LINE_SIZE];    /**< Start of the line being read. */
+    int     ahead_pos;                           /**< Where the bytes in ahead not parsed yet start. */
+    int     ahead_len;                           /**< Bytes in ahead. */
+    char    ahead[HTTPCLIENT_PARSE_AHEAD_SIZE];  /**< Bytes read past what is parsed. */
+} httpclient_parser_t;
+
+/**
+ * @brief   This type defines the callback taking the body of a response as it is read. data is in response_buf, or
+ *          in the bytes read ahead with the headers, and is not kept once it returns. It may point response_buf at
+ *          another buffer the next bytes are read into. Non-zero stops the response with ERROR_HTTP_BREAK.
+ */
+typedef int (*httpclient_body_cb_t)(void *ctx, char *data, int len);
+
+/**
+ * @brief   This type defines the callback handing the body of a request piece by piece, written as it is and not
+ *          copied. It is called with data NULL first, to start the body over as a request may be sent again on a new
+ *          connection, then for each piece until it sets len 0. Negative stops the request.
+ */
+typedef int (*httpclient_post_cb_t)(void *ctx, const char **data, int *len);
+
 /** @brief   This structure defines the HTTP data structure.  */
 typedef struct {
     int     is_more;                /**< Indicates if more data needs to be retrieved. */
@@ -98,6 +132,11 @@ typedef struct {
     char   *post_content_type;      /**< Content type of the post data. */
     char   *post_buf;               /**< User data to be posted. */
     char   *response_buf;           /**< Buffer to store the response data. */
+    httpclient_body_cb_t on_body;   /**< Takes the body as it is read into response_buf instead, to the end of it. */
+    void   *on_body_ctx;            /**< Context of on_body. */
+    httpclient_post_cb_t on_post;   /**< Hands the body posted instead of post_buf, of post_buf_len, or chunked when it is negative. */
+    void   *on_post_ctx;            /**< Context of on_post. */
+    httpclient_parser_t parser;     /**< Parse of the response, for the parts of it not received yet. */
 } httpclient_data_t;
 
 int iotx_post(httpclient_t *client,
@@ -106,6 +145,29 @@ int iotx_post(httpclient_t *client,
               const char *ca_crt,
               httpclient_data_t *client_data);
 
+/**
+ * @brief Posts on the connection the client kept from an earlier request if there is one, else on a new one, and
+ *        receives the response. A kept connection the server has closed meanwhile is replaced once. With keep_alive
+ *        the connection is kept for the next request, unless the server closes it or the response is not read to
+ *        its end, else it is closed.
+ *
+ * @return as httpclient_recv_response(), negative when failed.
+ */
+int iotx_post_recv(httpclient_t *client,
+                   const char *url,
+                   int port,
+                   const char *ca_crt,
+                   uint32_t timeout_ms,
+                   httpclient_data_t *client_data,
+                   int keep_alive);
+
+/**
+ * @brief Receives the response, or the next part of it while client_data->is_more. Without on_body, the body is read
+ *        into response_buf up to its length, and is_more tells there is more of it; timeout_ms is for this part.
+ *        With on_body, the body goes to on_body as it is read, to its end; timeout_ms is for each read.
+ *
+ * @return 0 at the end of the response, positive when response_buf is full of it, negative when failed.
+ */
 int httpclient_recv_response(httpclient_t *client, uint32_t timeout_ms, httpclient_data_t *client_data);
 
 int httpclient_common(httpclient_t *client, const char *url, int port, const char *ca_crt,
@@ -113,6 +175,13 @@ int httpclient_common(httpclient_t *client, const char *url, int port, const cha
 
 void httpclient_close(httpclient_t *client);
 
+#ifdef HTTP_CONN_POOL_ENABLED
+/**
+ * @brief Closes the connections kept in the pool to the host of url, or all of them when url is NULL.
+ */
+void httpclient_pool_clear(const char *url);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
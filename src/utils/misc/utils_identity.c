@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <string.h>
+#include "iot_import.h"
+#include "utils_identity.h"
+
+static utils_identity_t g_identity;
+static int g_identity_loaded = 0;
+
+static struct {
+    utils_identity_changed_fpt  hook;
+    void                       *ctx;
+} g_identity_hooks[UTILS_IDENTITY_HOOK_NUM];
+
+static void _identity_read(utils_identity_t *identity)
+{
+    memset(identity, 0, sizeof(utils_identity_t));
+
+    HAL_GetProductKey(identity->product_key);
+    HAL_GetDeviceName(identity->device_name);
+    HAL_GetDeviceSecret(identity->device_secret);
+    HAL_GetDeviceID(identity->device_id);
+    HAL_GetFirmwareVesion(identity->firmware_version);
+
+    HAL_Snprintf(identity->client_id, sizeof(identity->client_id), "%s.%s",
+                 identity->product_key, identity->device_name);
+    HAL_Snprintf(identity->sys_topic_prefix, sizeof(identity->sys_topic_prefix), "/sys/%s/%s/",
+                 identity->product_key, identity->device_name);
+    HAL_Snprintf(identity->topic_prefix, sizeof(identity->topic_prefix), "/%s/%s/",
+                 identity->product_key, identity->device_name);
+}
+
+const utils_identity_t *utils_identity_get(void)
+{
+    if (!g_identity_loaded) {
+        _identity_read(&g_identity);
+        g_identity_loaded = 1;
+    }
+
+    return &g_identity;
+}
+
+int utils_identity_reload(void)
+{
+    utils_identity_t identity;
+    int i;
+
+    _identity_read(&identity);
+    if (g_identity_loaded && 0 == memcmp(&identity, &g_identity, sizeof(utils_identity_t))) {
+        return 0;
+    }
+    memcpy(&g_identity, &identity, sizeof(utils_identity_t));
+    g_identity_loaded = 1;
+
+    for (i = 0; i < UTILS_IDENTITY_HOOK_NUM; i++) {
+        if (NULL != g_identity_hooks[i].hook) {
+            g_identity_hooks[i].hook(&g_identity, g_identity_hooks[i].ctx);
+        }
+    }
+
+    return 1;
+}
+
+int utils_identity_add_hook(utils_identity_changed_fpt hook, void *ctx)
+{
+    int i;
+
+    for (i = 0; i < UTILS_IDENTITY_HOOK_NUM; i++) {
+        if (NULL == g_identity_hooks[i].hook) {
+            g_identity_hooks[i].hook = hook;
+            g_identity_hooks[i].ctx = ctx;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+void utils_identity_remove_hook(utils_identity_changed_fpt hook, void *ctx)
+{
+    int i;
+
+    for (i = 0; i < UTILS_IDENTITY_HOOK_NUM; i++) {
+        if (hook == g_identity_hooks[i].hook && ctx == g_identity_hooks[i].ctx) {
+            g_identity_hooks[i].hook = NULL;
+            g_identity_hooks[i].ctx = NULL;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _IOTX_COMMON_IDENTITY_H_
+#define _IOTX_COMMON_IDENTITY_H_
+
+#include "iot_import.h"
+
+/*
+ * The device identity read through HAL_Get*() once, with what is built from it, so the paths that
+ * publish, sign or build topics do not go to flash each time. Whoever changes the identity with
+ * HAL_Set*() calls utils_identity_reload() after, and the hooks are told when something changed.
+ */
+
+#ifndef UTILS_IDENTITY_HOOK_NUM
+#define UTILS_IDENTITY_HOOK_NUM     (4)
+#endif
+
+typedef struct {
+    char        product_key[PRODUCT_KEY_MAXLEN];
+    char        device_name[DEVICE_NAME_MAXLEN];
+    char        device_secret[DEVICE_SECRET_MAXLEN];
+    char        device_id[DEVICE_ID_MAXLEN];
+    char        firmware_version[FIRMWARE_VERSION_MAXLEN];
+    /* "<product_key>.<device_name>" */
+    char        client_id[PRODUCT_KEY_MAXLEN + DEVICE_NAME_MAXLEN];
+    /* "/sys/<product_key>/<device_name>/", what the system topics start with */
+    char        sys_topic_prefix[PRODUCT_KEY_MAXLEN + DEVICE_NAME_MAXLEN + 6];
+    /* "/<product_key>/<device_name>/", what the custom topics start with */
+    char        topic_prefix[PRODUCT_KEY_MAXLEN + DEVICE_NAME_MAXLEN + 2];
+} utils_identity_t;
+
+typedef void (*utils_identity_changed_fpt)(const utils_identity_t *identity, void *ctx);
+
+/* reads the HAL on the first call, the identity stays valid and is updated in place by reloads */
+const utils_identity_t *utils_identity_get(void);
+
+/* reads the HAL again, 1 when the identity changed and the hooks were called, 0 when it did not */
+int utils_identity_reload(void);
+
+/* 0 on success, -1 when UTILS_IDENTITY_HOOK_NUM hooks are set already */
+int utils_identity_add_hook(utils_identity_changed_fpt hook, void *ctx);
+void utils_identity_remove_hook(utils_identity_changed_fpt hook, void *ctx);
+
+#endif /* _IOTX_COMMON_IDENTITY_H_ */
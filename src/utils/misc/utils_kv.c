@@ -0,0 +1,699 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "lite-utils.h"
+#include "lite-log.h"
+#include "utils_kv.h"
+
+/*
+ * A sector begins with its sequence and magic, the magic written last and zeroed first, and the
+ * sequences of the sectors in use run up by one from the oldest to head. A record is its crc, type,
+ * key length and value length, the key and the value, padded to UTILS_KV_ALIGN. A transaction never
+ * spans sectors, so all of a sector up to its last commit is committed, and that end is kept in RAM
+ * for each sector.
+ */
+#define KV_MAGIC                (0x314C564B)    /* "KVL1" */
+#define KV_SECTOR_HDR_LEN       (8)
+#define KV_REC_HDR_LEN          (8)
+#define KV_TYPE_SET             (1)
+#define KV_TYPE_DEL             (2)
+#define KV_TYPE_COMMIT          (3)
+#define KV_DROP_LEN             (UTILS_KV_ALIGN > 4 ? 8 : 4)
+#define KV_STAGE_SIZE           (32)            /* a multiple of UTILS_KV_ALIGN */
+#define KV_COPY_SIZE            (64)
+
+#define KV_ALIGN_UP(n)          (((n) + UTILS_KV_ALIGN - 1) & ~(uint32_t)(UTILS_KV_ALIGN - 1))
+#define KV_REC_LEN(klen, vlen)  KV_ALIGN_UP(KV_REC_HDR_LEN + (uint32_t)(klen) + (uint32_t)(vlen))
+#define KV_COMMIT_LEN           KV_REC_LEN(0, 0)
+#define KV_SECTOR_BASE(kv, s)   ((uint32_t)(s) * (kv)->flash.sector_size)
+#define KV_AGE_SECTOR(kv, age)  (((kv)->oldest + (age)) % (kv)->flash.sector_num)
+
+typedef struct {
+    uint8_t         type;       /* 0xFF on erased flash */
+    uint8_t         klen;
+    uint16_t        vlen;
+    uint32_t        crc;
+} kv_hdr_t;
+
+/* writes go out in aligned chunks of the stage, whatever pieces they are put in */
+typedef struct {
+    utils_kv_t     *kv;
+    uint32_t        addr;
+    uint32_t        len;
+    int             err;
+    unsigned char   buf[KV_STAGE_SIZE];
+} kv_writer_t;
+
+static const uint32_t kv_crc_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static const unsigned char kv_pad[UTILS_KV_ALIGN < 8 ? 8 : UTILS_KV_ALIGN] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+static uint32_t _kv_crc(uint32_t crc, const unsigned char *data, uint32_t len)
+{
+    while (len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ kv_crc_table[crc & 0x0F];
+        crc = (crc >> 4) ^ kv_crc_table[crc & 0x0F];
+    }
+
+    return crc;
+}
+
+static void _kv_put32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t _kv_get32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* the crc covers what follows it in the record, so a record is the same wherever it is copied to */
+static void _kv_encode_hdr(unsigned char *buf, uint8_t type, const char *key, uint32_t klen,
+                           const void *val, uint32_t vlen)
+{
+    uint32_t crc;
+
+    buf[4] = type;
+    buf[5] = (unsigned char)klen;
+    buf[6] = (unsigned char)vlen;
+    buf[7] = (unsigned char)(vlen >> 8);
+
+    crc = _kv_crc(0xFFFFFFFF, buf + 4, 4);
+    crc = _kv_crc(crc, (const unsigned char *)key, klen);
+    crc = _kv_crc(crc, (const unsigned char *)val, vlen);
+    _kv_put32(buf, ~crc);
+}
+
+static void _kv_decode_hdr(const unsigned char *buf, kv_hdr_t *hdr)
+{
+    hdr->crc = _kv_get32(buf);
+    hdr->type = buf[4];
+    hdr->klen = buf[5];
+    hdr->vlen = (uint16_t)(buf[6] | (buf[7] << 8));
+}
+
+static int _kv_read_hdr(utils_kv_t *kv, uint32_t addr, kv_hdr_t *hdr)
+{
+    unsigned char buf[KV_REC_HDR_LEN];
+
+    if (0 != kv->flash.read(kv->flash.ctx, addr, buf, KV_REC_HDR_LEN)) {
+        return -1;
+    }
+    _kv_decode_hdr(buf, hdr);
+
+    return 0;
+}
+
+static void _kv_writer_flush(kv_writer_t *w)
+{
+    if (0 != w->len && 0 == w->err) {
+        if (0 != w->kv->flash.write(w->kv->flash.ctx, w->addr, w->buf, w->len)) {
+            log_err("kv flash write fail at 0x%x", (unsigned int)w->addr);
+            w->err = -1;
+        }
+    }
+    w->addr += w->len;
+    w->len = 0;
+}
+
+static void _kv_writer_put(kv_writer_t *w, const void *data, uint32_t len)
+{
+    const unsigned char *p = data;
+    uint32_t n;
+
+    while (len > 0) {
+        n = KV_STAGE_SIZE - w->len;
+        n = (n < len) ? n : len;
+        memcpy(w->buf + w->len, p, n);
+        w->len += n;
+        p += n;
+        len -= n;
+        if (KV_STAGE_SIZE == w->len) {
+            _kv_writer_flush(w);
+        }
+    }
+}
+
+static void _kv_writer_put_record(kv_writer_t *w, uint8_t type, const char *key, uint32_t klen,
+                                  const void *val, uint32_t vlen)
+{
+    unsigned char hdr[KV_REC_HDR_LEN];
+
+    _kv_encode_hdr(hdr, type, key, klen, val, vlen);
+    _kv_writer_put(w, hdr, KV_REC_HDR_LEN);
+    _kv_writer_put(w, key, klen);
+    _kv_writer_put(w, val, vlen);
+    _kv_writer_put(w, kv_pad, KV_REC_LEN(klen, vlen) - KV_REC_HDR_LEN - klen - vlen);
+}
+
+static int _kv_writer_finish(kv_writer_t *w)
+{
+    _kv_writer_flush(w);
+    return w->err;
+}
+
+static void _kv_writer_init(kv_writer_t *w, utils_kv_t *kv, uint32_t addr)
+{
+    w->kv = kv;
+    w->addr = addr;
+    w->len = 0;
+    w->err = 0;
+}
+
+/* erases the sector after head and makes it head */
+static int _kv_open_sector(utils_kv_t *kv)
+{
+    uint32_t sector = (kv->head + 1) % kv->flash.sector_num;
+    unsigned char hdr[KV_SECTOR_HDR_LEN];
+    kv_writer_t w;
+
+    if (0 != kv->flash.erase(kv->flash.ctx, KV_SECTOR_BASE(kv, sector))) {
+        log_err("kv flash erase fail, sector %u", (unsigned int)sector);
+        return -1;
+    }
+
+    _kv_put32(hdr, kv->seq + 1);
+    _kv_put32(hdr + 4, KV_MAGIC);
+    _kv_writer_init(&w, kv, KV_SECTOR_BASE(kv, sector));
+    _kv_writer_put(&w, hdr, KV_SECTOR_HDR_LEN);
+    if (0 != _kv_writer_finish(&w)) {
+        return -1;
+    }
+
+    kv->head = sector;
+    kv->seq++;
+    kv->used++;
+    kv->head_off = KV_SECTOR_HDR_LEN;
+    kv->end[sector] = KV_SECTOR_HDR_LEN;
+
+    return 0;
+}
+
+/* the magic programmed to zeros, the sector is free and is erased when it is opened */
+static void _kv_drop_sector(utils_kv_t *kv, uint32_t sector)
+{
+    static const unsigned char zeros[KV_DROP_LEN] = {0};
+
+    if (0 != kv->flash.write(kv->flash.ctx, KV_SECTOR_BASE(kv, sector) + KV_SECTOR_HDR_LEN - KV_DROP_LEN,
+                             zeros, KV_DROP_LEN)) {
+        log_err("kv flash write fail, sector %u", (unsigned int)sector);
+    }
+}
+
+/* the last committed record of key, 0 when there is one */
+static int _kv_find_last(utils_kv_t *kv, const char *key, uint32_t klen, uint32_t *addr, kv_hdr_t *hdr)
+{
+    char name[UTILS_KV_KEY_LEN_MAX];
+    kv_hdr_t cur;
+    uint32_t age, base, off;
+    int found = -1;
+
+    for (age = 0; age < kv->used; age++) {
+        base = KV_SECTOR_BASE(kv, KV_AGE_SECTOR(kv, age));
+        for (off = KV_SECTOR_HDR_LEN; off < kv->end[KV_AGE_SECTOR(kv, age)]; off += KV_REC_LEN(cur.klen, cur.vlen)) {
+            if (0 != _kv_read_hdr(kv, base + off, &cur)) {
+                break;
+            }
+            if (KV_TYPE_COMMIT == cur.type || cur.klen != klen
+                || 0 != kv->flash.read(kv->flash.ctx, base + off + KV_REC_HDR_LEN, name, klen)
+                || 0 != memcmp(name, key, klen)) {
+                continue;
+            }
+            *addr = base + off;
+            *hdr = cur;
+            found = 0;
+        }
+    }
+
+    return found;
+}
+
+/*
+ * Moves what is still live in the oldest sector to head, as one transaction, and frees the oldest.
+ * A deletion is dropped with it, nothing older than the oldest sector is left for it to hide.
+ */
+static int _kv_collect(utils_kv_t *kv)
+{
+    uint32_t oldest = kv->oldest;
+    uint32_t base = KV_SECTOR_BASE(kv, oldest);
+    unsigned char buf[KV_COPY_SIZE];
+    unsigned char commit[KV_REC_HDR_LEN];
+    char name[UTILS_KV_KEY_LEN_MAX];
+    kv_hdr_t hdr, last;
+    uint32_t off, len, done, n, addr;
+    uint32_t copied = 0;
+    kv_writer_t w;
+
+    _kv_writer_init(&w, kv, KV_SECTOR_BASE(kv, kv->head) + kv->head_off);
+    for (off = KV_SECTOR_HDR_LEN; off < kv->end[oldest]; off += len) {
+        if (0 != _kv_read_hdr(kv, base + off, &hdr)) {
+            return -1;
+        }
+        len = KV_REC_LEN(hdr.klen, hdr.vlen);
+        if (KV_TYPE_SET != hdr.type) {
+            continue;
+        }
+
+        if (0 != kv->flash.read(kv->flash.ctx, base + off + KV_REC_HDR_LEN, name, hdr.klen)
+            || 0 != _kv_find_last(kv, name, hdr.klen, &addr, &last) || addr != base + off) {
+            continue;
+        }
+
+        if (kv->head_off + copied + len + KV_COMMIT_LEN > kv->flash.sector_size) {
+            return -1;
+        }
+        for (done = 0; done < len; done += n) {
+            n = (len - done < KV_COPY_SIZE) ? len - done : KV_COPY_SIZE;
+            if (0 != kv->flash.read(kv->flash.ctx, base + off + done, buf, n)) {
+                return -1;
+            }
+            _kv_writer_put(&w, buf, n);
+        }
+        copied += len;
+    }
+
+    if (0 != copied) {
+        _kv_encode_hdr(commit, KV_TYPE_COMMIT, NULL, 0, NULL, 0);
+        _kv_writer_put(&w, commit, KV_COMMIT_LEN);
+        if (0 != _kv_writer_finish(&w)) {
+            kv->head_off = kv->flash.sector_size;
+            return -1;
+        }
+        kv->head_off += copied + KV_COMMIT_LEN;
+        kv->end[kv->head] = kv->head_off;
+    }
+
+    _kv_drop_sector(kv, oldest);
+    kv->oldest = (oldest + 1) % kv->flash.sector_num;
+    kv->used--;
+
+    return 0;
+}
+
+/* room for need bytes in head; a sector is always left free to collect the oldest into */
+static int _kv_reserve(utils_kv_t *kv, uint32_t need)
+{
+    uint32_t tries = 0;
+
+    while (kv->flash.sector_size - kv->head_off < need) {
+        if (++tries > kv->flash.sector_num) {
+            log_err("kv flash full");
+            return -1;
+        }
+        if (0 != _kv_open_sector(kv)) {
+            return -1;
+        }
+        if (kv->used == kv->flash.sector_num && 0 != _kv_collect(kv)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* the coalesced records and then the one given, if any, closed by a commit */
+static int _kv_write_txn(utils_kv_t *kv, uint8_t type, const char *key, uint32_t klen,
+                         const void *val, uint32_t vlen)
+{
+    unsigned char commit[KV_REC_HDR_LEN];
+    uint32_t need = kv->cache_len + ((NULL != key) ? KV_REC_LEN(klen, vlen) : 0) + KV_COMMIT_LEN;
+    kv_writer_t w;
+
+    if (0 == kv->cache_len && NULL == key) {
+        return 0;
+    }
+    if (need > kv->flash.sector_size - KV_SECTOR_HDR_LEN) {
+        log_err("kv transaction of %u bytes exceeds a sector", (unsigned int)need);
+        return -1;
+    }
+    if (0 != _kv_reserve(kv, need)) {
+        return -1;
+    }
+
+    _kv_writer_init(&w, kv, KV_SECTOR_BASE(kv, kv->head) + kv->head_off);
+    _kv_writer_put(&w, kv->cache, kv->cache_len);
+    if (NULL != key) {
+        _kv_writer_put_record(&w, type, key, klen, val, vlen);
+    }
+    _kv_encode_hdr(commit, KV_TYPE_COMMIT, NULL, 0, NULL, 0);
+    _kv_writer_put(&w, commit, KV_COMMIT_LEN);
+    if (0 != _kv_writer_finish(&w)) {
+        /* what was written of it is never committed, nothing more goes after it */
+        kv->head_off = kv->flash.sector_size;
+        return -1;
+    }
+
+    kv->head_off += need;
+    kv->end[kv->head] = kv->head_off;
+    kv->cache_len = 0;
+
+    return 0;
+}
+
+/* offset of the coalesced record of key, -1 when there is none */
+static int _kv_cache_find(utils_kv_t *kv, const char *key, uint32_t klen, kv_hdr_t *hdr)
+{
+    uint32_t off;
+
+    for (off = 0; off < kv->cache_len; off += KV_REC_LEN(hdr->klen, hdr->vlen)) {
+        _kv_decode_hdr(kv->cache + off, hdr);
+        if (hdr->klen == klen && 0 == memcmp(kv->cache + off + KV_REC_HDR_LEN, key, klen)) {
+            return (int)off;
+        }
+    }
+
+    return -1;
+}
+
+static void _kv_cache_remove(utils_kv_t *kv, const char *key, uint32_t klen)
+{
+    kv_hdr_t hdr;
+    uint32_t len;
+    int off = _kv_cache_find(kv, key, klen, &hdr);
+
+    if (off >= 0) {
+        len = KV_REC_LEN(hdr.klen, hdr.vlen);
+        memmove(kv->cache + off, kv->cache + off + len, kv->cache_len - off - len);
+        kv->cache_len -= len;
+    }
+}
+
+static void _kv_cache_add(utils_kv_t *kv, uint8_t type, const char *key, uint32_t klen,
+                          const void *val, uint32_t vlen)
+{
+    unsigned char *p = kv->cache + kv->cache_len;
+    uint32_t len = KV_REC_LEN(klen, vlen);
+
+    _kv_encode_hdr(p, type, key, klen, val, vlen);
+    memcpy(p + KV_REC_HDR_LEN, key, klen);
+    if (0 != vlen) {
+        memcpy(p + KV_REC_HDR_LEN + klen, val, vlen);
+    }
+    memset(p + KV_REC_HDR_LEN + klen + vlen, 0xFF, len - KV_REC_HDR_LEN - klen - vlen);
+    kv->cache_len += len;
+}
+
+static int _kv_update(utils_kv_t *kv, uint8_t type, const char *key, uint32_t klen,
+                      const void *val, uint32_t vlen, int sync)
+{
+    uint32_t len = KV_REC_LEN(klen, vlen);
+    uint32_t replaced = 0;
+    kv_hdr_t hdr;
+
+    /* an older value of key still coalesced goes in the same transaction before it, and loses to it */
+    if (sync || len > UTILS_KV_CACHE_SIZE) {
+        return _kv_write_txn(kv, type, key, klen, val, vlen);
+    }
+
+    /* nothing is dropped before what replaces it is in, a failure leaves all as it was */
+    if (_kv_cache_find(kv, key, klen, &hdr) >= 0) {
+        replaced = KV_REC_LEN(hdr.klen, hdr.vlen);
+    }
+    if (kv->cache_len - replaced + len > UTILS_KV_CACHE_SIZE && 0 != _kv_write_txn(kv, 0, NULL, 0, NULL, 0)) {
+        return -1;
+    }
+    _kv_cache_remove(kv, key, klen);
+    _kv_cache_add(kv, type, key, klen, val, vlen);
+
+    return 0;
+}
+
+/* checks every record up to the first one which is not whole, so a torn write ends the sector */
+static void _kv_mount_sector(utils_kv_t *kv, uint32_t sector, int is_head)
+{
+    uint32_t base = KV_SECTOR_BASE(kv, sector);
+    uint32_t off = KV_SECTOR_HDR_LEN;
+    uint32_t commit_end = KV_SECTOR_HDR_LEN;
+    uint32_t len, done, n, crc;
+    unsigned char raw[KV_REC_HDR_LEN];
+    unsigned char buf[KV_COPY_SIZE];
+    kv_hdr_t hdr;
+    int clean = 0;
+
+    while (1) {
+        if (off + KV_REC_HDR_LEN > kv->flash.sector_size) {
+            clean = 1;
+            break;
+        }
+        if (0 != kv->flash.read(kv->flash.ctx, base + off, raw, KV_REC_HDR_LEN)) {
+            break;
+        }
+        if (0 == memcmp(raw, kv_pad, KV_REC_HDR_LEN)) {
+            clean = 1;
+            break;
+        }
+        _kv_decode_hdr(raw, &hdr);
+        len = KV_REC_LEN(hdr.klen, hdr.vlen);
+        if (hdr.type < KV_TYPE_SET || hdr.type > KV_TYPE_COMMIT || (KV_TYPE_COMMIT == hdr.type) != (0 == hdr.klen)
+            || off + len > kv->flash.sector_size) {
+            break;
+        }
+
+        crc = _kv_crc(0xFFFFFFFF, raw + 4, 4);
+        for (done = 0; done < (uint32_t)hdr.klen + hdr.vlen; done += n) {
+            n = hdr.klen + hdr.vlen - done;
+            n = (n < KV_COPY_SIZE) ? n : KV_COPY_SIZE;
+            if (0 != kv->flash.read(kv->flash.ctx, base + off + KV_REC_HDR_LEN + done, buf, n)) {
+                break;
+            }
+            crc = _kv_crc(crc, buf, n);
+        }
+        if (done < (uint32_t)hdr.klen + hdr.vlen || ~crc != hdr.crc) {
+            break;
+        }
+
+        off += len;
+        if (KV_TYPE_COMMIT == hdr.type) {
+            commit_end = off;
+        }
+    }
+
+    kv->end[sector] = commit_end;
+    if (is_head) {
+        /* after records left uncommitted, or not whole, the next transaction goes in a new sector */
+        kv->head_off = (clean && off == commit_end) ? off : kv->flash.sector_size;
+    }
+}
+
+static int _kv_sector_seq(utils_kv_t *kv, uint32_t sector, uint32_t *seq)
+{
+    unsigned char hdr[KV_SECTOR_HDR_LEN];
+
+    if (0 != kv->flash.read(kv->flash.ctx, KV_SECTOR_BASE(kv, sector), hdr, KV_SECTOR_HDR_LEN)
+        || KV_MAGIC != _kv_get32(hdr + 4)) {
+        return -1;
+    }
+    *seq = _kv_get32(hdr);
+
+    return 0;
+}
+
+static int _kv_mount(utils_kv_t *kv)
+{
+    uint32_t sector, seq, age;
+    int found = 0;
+
+    /* head has the highest sequence, the sectors before it with one less each are in use */
+    for (sector = 0; sector < kv->flash.sector_num; sector++) {
+        if (0 == _kv_sector_seq(kv, sector, &seq) && (!found || seq > kv->seq)) {
+            kv->head = sector;
+            kv->seq = seq;
+            found = 1;
+        }
+    }
+    if (!found) {
+        kv->head = kv->flash.sector_num - 1;
+        kv->seq = 0;
+        kv->oldest = 0;
+        kv->used = 0;
+        return _kv_open_sector(kv);
+    }
+
+    for (kv->used = 1; kv->used < kv->flash.sector_num; kv->used++) {
+        sector = (kv->head + kv->flash.sector_num - kv->used) % kv->flash.sector_num;
+        if (0 != _kv_sector_seq(kv, sector, &seq) || seq != kv->seq - kv->used) {
+            break;
+        }
+    }
+    kv->oldest = (kv->head + kv->flash.sector_num - (kv->used - 1)) % kv->flash.sector_num;
+
+    for (age = 0; age < kv->used; age++) {
+        _kv_mount_sector(kv, KV_AGE_SECTOR(kv, age), KV_AGE_SECTOR(kv, age) == kv->head);
+    }
+
+    /* power went while the oldest was being collected into the last free sector */
+    if (kv->used == kv->flash.sector_num) {
+        if (KV_SECTOR_HDR_LEN == kv->end[kv->head]) {
+            /* nothing was committed in it, it is opened again later */
+            _kv_drop_sector(kv, kv->head);
+            kv->head = (kv->head + kv->flash.sector_num - 1) % kv->flash.sector_num;
+            kv->seq--;
+            kv->used--;
+            kv->head_off = kv->flash.sector_size;
+        } else {
+            /* the copy was committed */
+            _kv_drop_sector(kv, kv->oldest);
+            kv->oldest = (kv->oldest + 1) % kv->flash.sector_num;
+            kv->used--;
+        }
+    }
+
+    return 0;
+}
+
+int utils_kv_init(utils_kv_t *kv, const utils_kv_flash_t *flash)
+{
+    if (NULL == kv || NULL == flash || NULL == flash->read || NULL == flash->write || NULL == flash->erase
+        || flash->sector_num < 2 || 0 != flash->sector_size % UTILS_KV_ALIGN
+        || flash->sector_size < KV_SECTOR_HDR_LEN + KV_REC_LEN(1, 0) + KV_COMMIT_LEN) {
+        return -1;
+    }
+
+    memset(kv, 0, sizeof(utils_kv_t));
+    kv->flash = *flash;
+    kv->end = LITE_malloc(flash->sector_num * sizeof(uint32_t));
+    if (NULL == kv->end) {
+        return -1;
+    }
+    kv->lock = HAL_MutexCreate();
+    if (NULL == kv->lock || 0 != _kv_mount(kv)) {
+        utils_kv_deinit(kv);
+        return -1;
+    }
+
+    return 0;
+}
+
+void utils_kv_deinit(utils_kv_t *kv)
+{
+    if (NULL == kv) {
+        return;
+    }
+
+    if (NULL != kv->lock) {
+        HAL_MutexDestroy(kv->lock);
+        kv->lock = NULL;
+    }
+    if (NULL != kv->end) {
+        LITE_free(kv->end);
+        kv->end = NULL;
+    }
+}
+
+int utils_kv_set(utils_kv_t *kv, const char *key, const void *val, int len, int sync)
+{
+    uint32_t klen = (NULL == key) ? 0 : strlen(key);
+    int ret;
+
+    if (NULL == kv || 0 == klen || klen > UTILS_KV_KEY_LEN_MAX || NULL == val || len < 0 || len > 0xFFFF) {
+        return -1;
+    }
+
+    HAL_MutexLock(kv->lock);
+    ret = _kv_update(kv, KV_TYPE_SET, key, klen, val, (uint32_t)len, sync);
+    HAL_MutexUnlock(kv->lock);
+
+    return ret;
+}
+
+int utils_kv_get(utils_kv_t *kv, const char *key, void *val, int *buffer_len)
+{
+    uint32_t klen = (NULL == key) ? 0 : strlen(key);
+    uint32_t addr = 0;
+    kv_hdr_t hdr;
+    int off;
+    int ret = -1;
+
+    if (NULL == kv || 0 == klen || klen > UTILS_KV_KEY_LEN_MAX || NULL == val || NULL == buffer_len) {
+        return -1;
+    }
+
+    HAL_MutexLock(kv->lock);
+    off = _kv_cache_find(kv, key, klen, &hdr);
+    if (off >= 0) {
+        if (KV_TYPE_SET == hdr.type && hdr.vlen <= *buffer_len) {
+            memcpy(val, kv->cache + off + KV_REC_HDR_LEN + klen, hdr.vlen);
+            *buffer_len = hdr.vlen;
+            ret = 0;
+        }
+    } else if (0 == _kv_find_last(kv, key, klen, &addr, &hdr) && KV_TYPE_SET == hdr.type && hdr.vlen <= *buffer_len) {
+        if (0 == kv->flash.read(kv->flash.ctx, addr + KV_REC_HDR_LEN + klen, val, hdr.vlen)) {
+            *buffer_len = hdr.vlen;
+            ret = 0;
+        }
+    }
+    HAL_MutexUnlock(kv->lock);
+
+    return ret;
+}
+
+int utils_kv_del(utils_kv_t *kv, const char *key, int sync)
+{
+    uint32_t klen = (NULL == key) ? 0 : strlen(key);
+    uint32_t addr = 0;
+    kv_hdr_t hdr;
+    int ret = 0;
+
+    if (NULL == kv || 0 == klen || klen > UTILS_KV_KEY_LEN_MAX) {
+        return -1;
+    }
+
+    HAL_MutexLock(kv->lock);
+    /* a key never committed needs no deletion record, unless its coalesced value goes out with this one */
+    if ((0 == _kv_find_last(kv, key, klen, &addr, &hdr) && KV_TYPE_SET == hdr.type)
+        || (sync && _kv_cache_find(kv, key, klen, &hdr) >= 0)) {
+        ret = _kv_update(kv, KV_TYPE_DEL, key, klen, NULL, 0, sync);
+    } else {
+        _kv_cache_remove(kv, key, klen);
+        if (sync) {
+            ret = _kv_write_txn(kv, 0, NULL, 0, NULL, 0);
+        }
+    }
+    HAL_MutexUnlock(kv->lock);
+
+    return ret;
+}
+
+int utils_kv_commit(utils_kv_t *kv)
+{
+    int ret;
+
+    if (NULL == kv) {
+        return -1;
+    }
+
+    HAL_MutexLock(kv->lock);
+    ret = _kv_write_txn(kv, 0, NULL, 0, NULL, 0);
+    HAL_MutexUnlock(kv->lock);
+
+    return ret;
+}
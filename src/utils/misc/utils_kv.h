@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _IOTX_COMMON_KV_H_
+#define _IOTX_COMMON_KV_H_
+
+#include "iot_import.h"
+
+/*
+ * A key value store in raw NOR flash, for a port to implement HAL_Kv_* with on a device without a
+ * file system:
+ *
+ *     static utils_kv_t g_kv;     (utils_kv_init(&g_kv, &flash) once at boot)
+ *     int HAL_Kv_Set(const char *key, const void *val, int len, int sync)
+ *     {
+ *         return utils_kv_set(&g_kv, key, val, len, sync);
+ *     }
+ *
+ * Values are appended to a log of sectors, a sector is erased only when the log comes round to it
+ * again, so every sector wears alike and an update costs no erase. Records are written in
+ * transactions closed by a commit record, what a power cut leaves without its commit is ignored.
+ * Values set with sync 0 are coalesced in RAM, a later set of the same key replaces them there, and
+ * are written together as one transaction by the next sync set or utils_kv_commit(), so they are
+ * saved all or none as long as they fit UTILS_KV_CACHE_SIZE.
+ */
+
+/* coalesced values not written yet, a value longer than it is written at once */
+#ifndef UTILS_KV_CACHE_SIZE
+#define UTILS_KV_CACHE_SIZE     (512)
+#endif
+
+/* the smallest write of the flash, a power of 2 up to 8 */
+#ifndef UTILS_KV_ALIGN
+#define UTILS_KV_ALIGN          (4)
+#endif
+
+#define UTILS_KV_KEY_LEN_MAX    (255)
+
+/* the flash, its sectors from address 0; a write only ever programs erased bytes */
+typedef struct {
+    uint32_t                    sector_size;
+    uint32_t                    sector_num;     /* 2 at least, one is always kept free */
+    int                       (*read)(void *ctx, uint32_t addr, void *buf, uint32_t len);
+    int                       (*write)(void *ctx, uint32_t addr, const void *buf, uint32_t len);
+    int                       (*erase)(void *ctx, uint32_t addr);  /* the sector at addr, 0 on success */
+    void                       *ctx;
+} utils_kv_flash_t;
+
+typedef struct {
+    utils_kv_flash_t            flash;
+    uint32_t                   *end;            /* per sector, past its last commit */
+    uint32_t                    oldest;         /* the sectors in use, oldest to head, round the flash */
+    uint32_t                    head;
+    uint32_t                    used;
+    uint32_t                    seq;            /* of head */
+    uint32_t                    head_off;       /* where head is written next */
+    void                       *lock;
+    uint32_t                    cache_len;
+    unsigned char               cache[UTILS_KV_CACHE_SIZE];
+} utils_kv_t;
+
+/* mounts the log on flash, formats it when there is none, 0 on success */
+int utils_kv_init(utils_kv_t *kv, const utils_kv_flash_t *flash);
+
+/* the values not committed yet are lost */
+void utils_kv_deinit(utils_kv_t *kv);
+
+/* as HAL_Kv_Set(), HAL_Kv_Get() and HAL_Kv_Del() */
+int utils_kv_set(utils_kv_t *kv, const char *key, const void *val, int len, int sync);
+int utils_kv_get(utils_kv_t *kv, const char *key, void *val, int *buffer_len);
+int utils_kv_del(utils_kv_t *kv, const char *key, int sync);
+
+/* writes the coalesced values as one transaction */
+int utils_kv_commit(utils_kv_t *kv);
+
+#endif /* _IOTX_COMMON_KV_H_ */
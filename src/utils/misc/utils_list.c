@@ -160,32 +160,26 @@ list_node_t *list_lpush(list_t *self, list_node_t *node)
 
 /*
  * Return the node associated to val or NULL.
+ * The nodes are walked in place, a lookup allocates nothing.
  */
 list_node_t *list_find(list_t *self, void *val)
 {
-    list_iterator_t *it;
     list_node_t *node;
 
-    if (NULL == (it = list_iterator_new(self, LIST_HEAD))) {
-        return NULL;
-    }
-    node = list_iterator_next(it);
-    while (node) {
-        if (self->match) {
+    if (self->match) {
+        for (node = self->head; node; node = node->next) {
             if (self->match(val, node->val)) {
-                list_iterator_destroy(it);
                 return node;
             }
-        } else {
+        }
+    } else {
+        for (node = self->head; node; node = node->next) {
             if (val == node->val) {
-                list_iterator_destroy(it);
                 return node;
             }
         }
-        node = list_iterator_next(it);
     }
 
-    list_iterator_destroy(it);
     return NULL;
 }
 
@@ -194,30 +188,22 @@ list_node_t *list_find(list_t *self, void *val)
  */
 list_node_t *list_at(list_t *self, int index)
 {
-    list_direction_t direction = LIST_HEAD;
+    list_node_t *node;
 
     if (index < 0) {
-        direction = LIST_TAIL;
         index = ~index;
-    }
-
-    if ((unsigned) index < self->len) {
-        list_iterator_t *it;
-        list_node_t *node;
-
-        if (NULL == (it = list_iterator_new(self, direction))) {
+        if ((unsigned) index >= self->len) {
             return NULL;
         }
-        node = list_iterator_next(it);
-
-        while (index--) {
-            node = list_iterator_next(it);
-        }
-        list_iterator_destroy(it);
+        for (node = self->tail; index--; node = node->prev);
         return node;
     }
 
-    return NULL;
+    if ((unsigned) index >= self->len) {
+        return NULL;
+    }
+    for (node = self->head; index--; node = node->next);
+    return node;
 }
 
 /*
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "utils_lz.h"
+
+/* as the LZ4 block format has them, the last match starts 12 bytes before the end, 5 literals close it */
+#define LZ_MIN_MATCH        (4)
+#define LZ_MF_LIMIT         (12)
+#define LZ_LAST_LITERALS    (5)
+#define LZ_RUN_MASK         (15)
+
+#define LZ_FRAME_MAGIC_0    (0xA7)
+#define LZ_FRAME_MAGIC_1    ('L')
+#define LZ_FRAME_MAGIC_2    ('4')
+
+static uint32_t _lz_read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t _lz_hash(const uint8_t *p)
+{
+    return (_lz_read32(p) * 2654435761U) >> (32 - CONFIG_PAYLOAD_COMPRESS_HASH_BITS);
+}
+
+/* a length of 15 or more goes on in bytes of 255 and one below */
+static uint8_t *_lz_put_length(uint8_t *op, uint32_t len)
+{
+    for (; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/* the literals from anchor and a match of match_len at offset behind, no match when match_len is 0 */
+static uint8_t *_lz_put_sequence(uint8_t *op, const uint8_t *oend, const uint8_t *anchor, uint32_t lit_len,
+                                 uint32_t offset, uint32_t match_len)
+{
+    uint8_t *token = op;
+
+    if ((uint32_t)(oend - op) < 1 + lit_len + lit_len / 255 + 1 + (match_len ? 2 + match_len / 255 + 1 : 0)) {
+        return NULL;
+    }
+    op++;
+
+    *token = (uint8_t)((lit_len >= LZ_RUN_MASK ? LZ_RUN_MASK : lit_len) << 4);
+    if (lit_len >= LZ_RUN_MASK) {
+        op = _lz_put_length(op, lit_len - LZ_RUN_MASK);
+    }
+    memcpy(op, anchor, lit_len);
+    op += lit_len;
+
+    if (match_len) {
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        match_len -= LZ_MIN_MATCH;
+        *token |= (uint8_t)(match_len >= LZ_RUN_MASK ? LZ_RUN_MASK : match_len);
+        if (match_len >= LZ_RUN_MASK) {
+            op = _lz_put_length(op, match_len - LZ_RUN_MASK);
+        }
+    }
+
+    return op;
+}
+
+int utils_lz_compress(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_size)
+{
+    uint16_t table[1 << CONFIG_PAYLOAD_COMPRESS_HASH_BITS];
+    const uint8_t *ip = in, *anchor = in, *ref;
+    const uint8_t *end = in + in_len;
+    uint8_t *op = out;
+    const uint8_t *oend = out + out_size;
+    uint32_t h, len;
+
+    if (NULL == in || NULL == out || 0 == out_size || in_len > UTILS_LZ_MAX_INPUT) {
+        return -1;
+    }
+
+    if (in_len > LZ_MF_LIMIT) {
+        memset(table, 0, sizeof(table));
+        ip++;
+        while (ip < end - LZ_MF_LIMIT) {
+            h = _lz_hash(ip);
+            ref = in + table[h];
+            table[h] = (uint16_t)(ip - in);
+            if (ref >= ip || _lz_read32(ref) != _lz_read32(ip)) {
+                /* the further from the last match, the faster it skips what does not compress */
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            for (len = LZ_MIN_MATCH; ip + len < end - LZ_LAST_LITERALS && ip[len] == ref[len]; len++);
+
+            op = _lz_put_sequence(op, oend, anchor, ip - anchor, ip - ref, len);
+            if (NULL == op) {
+                return -1;
+            }
+            ip += len;
+            anchor = ip;
+            if (ip < end - LZ_MF_LIMIT) {
+                table[_lz_hash(ip - 2)] = (uint16_t)(ip - 2 - in);
+            }
+        }
+    }
+
+    op = _lz_put_sequence(op, oend, anchor, end - anchor, 0, 0);
+    if (NULL == op) {
+        return -1;
+    }
+
+    return op - out;
+}
+
+/* a length of 15 continued in the bytes at *ip, -1 when they run past iend */
+static int _lz_get_length(const uint8_t **ip, const uint8_t *iend, uint32_t *len)
+{
+    uint8_t b;
+
+    do {
+        if (*ip >= iend) {
+            return -1;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (255 == b);
+
+    return 0;
+}
+
+int utils_lz_decompress(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_size)
+{
+    const uint8_t *ip = in, *iend = in + in_len, *ref;
+    uint8_t *op = out;
+    uint32_t len, offset;
+    uint8_t token;
+
+    if (NULL == in || NULL == out || 0 == in_len) {
+        return -1;
+    }
+
+    while (ip < iend) {
+        token = *ip++;
+        len = token >> 4;
+        if (LZ_RUN_MASK == len && 0 != _lz_get_length(&ip, iend, &len)) {
+            return -1;
+        }
+        if (len > (uint32_t)(iend - ip) || len > out_size - (uint32_t)(op - out)) {
+            return -1;
+        }
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        offset = ip[0] | ((uint32_t)ip[1] << 8);
+        ip += 2;
+        if (0 == offset || offset > (uint32_t)(op - out)) {
+            return -1;
+        }
+        len = token & LZ_RUN_MASK;
+        if (LZ_RUN_MASK == len && 0 != _lz_get_length(&ip, iend, &len)) {
+            return -1;
+        }
+        len += LZ_MIN_MATCH;
+        if (len > out_size - (uint32_t)(op - out)) {
+            return -1;
+        }
+        /* byte by byte, a match may overlap what it copies */
+        for (ref = op - offset; len > 0; len--) {
+            *op++ = *ref++;
+        }
+    }
+
+    return op - out;
+}
+
+int utils_lz_frame_encode(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_size)
+{
+    int len;
+
+    if (out_size <= UTILS_LZ_FRAME_HEADER_LEN) {
+        return -1;
+    }
+    /* one byte short of out_size, so a frame as long as the plain payload is never made */
+    len = utils_lz_compress(in, in_len, out + UTILS_LZ_FRAME_HEADER_LEN, out_size - UTILS_LZ_FRAME_HEADER_LEN - 1);
+    if (len < 0) {
+        return -1;
+    }
+
+    out[0] = LZ_FRAME_MAGIC_0;
+    out[1] = LZ_FRAME_MAGIC_1;
+    out[2] = LZ_FRAME_MAGIC_2;
+    out[3] = (uint8_t)(in_len >> 16);
+    out[4] = (uint8_t)(in_len >> 8);
+    out[5] = (uint8_t)in_len;
+
+    return UTILS_LZ_FRAME_HEADER_LEN + len;
+}
+
+int utils_lz_frame_length(const uint8_t *in, uint32_t in_len)
+{
+    uint32_t len;
+
+    if (NULL == in || in_len <= UTILS_LZ_FRAME_HEADER_LEN
+        || LZ_FRAME_MAGIC_0 != in[0] || LZ_FRAME_MAGIC_1 != in[1] || LZ_FRAME_MAGIC_2 != in[2]) {
+        return -1;
+    }
+    len = ((uint32_t)in[3] << 16) | ((uint32_t)in[4] << 8) | in[5];
+
+    return (len > UTILS_LZ_MAX_INPUT) ? -1 : (int)len;
+}
+
+int utils_lz_frame_decode(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_size)
+{
+    int len = utils_lz_frame_length(in, in_len);
+
+    if (len < 0 || (uint32_t)len > out_size) {
+        return -1;
+    }
+    if (len != utils_lz_decompress(in + UTILS_LZ_FRAME_HEADER_LEN, in_len - UTILS_LZ_FRAME_HEADER_LEN, out, len)) {
+        return -1;
+    }
+
+    return len;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _UTILS_LZ_H_
+#define _UTILS_LZ_H_
+
+#include "iot_import.h"
+
+/*
+ * Compression of payloads in the LZ4 block format, so the other end decodes them with
+ * LZ4_decompress_safe() of any liblz4. The compressor keeps a table of
+ * 1 << CONFIG_PAYLOAD_COMPRESS_HASH_BITS positions on the stack and nothing else, the
+ * decompressor no state at all. The compressor takes at most UTILS_LZ_MAX_INPUT bytes.
+ *
+ * A frame is a block behind a header of UTILS_LZ_FRAME_HEADER_LEN bytes, 0xA7 'L' '4' and the
+ * original length in 3 bytes big endian, which tells a compressed payload from a plain one.
+ */
+
+#define UTILS_LZ_MAX_INPUT          (0xFFFF)
+#define UTILS_LZ_FRAME_HEADER_LEN   (6)
+
+/* the block of in to out, its length, -1 when it does not fit out_size */
+int utils_lz_compress(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_size);
+
+/* the block in decoded to out, its length, -1 when it is malformed or does not fit out_size */
+int utils_lz_decompress(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_size);
+
+/* the frame of in to out, its length, -1 unless it is shorter than out_size */
+int utils_lz_frame_encode(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_size);
+
+/* the original length of the frame in, -1 when in is not one */
+int utils_lz_frame_length(const uint8_t *in, uint32_t in_len);
+
+/* the frame in decoded to out, its length, -1 when in is not a whole frame or does not fit out_size */
+int utils_lz_frame_decode(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_size);
+
+#endif  /* _UTILS_LZ_H_ */
@@ -20,18 +20,64 @@
 
 #include "iot_import.h"
 #include "utils_net.h"
+#include "utils_timer.h"
 #include "lite-log.h"
+#include "lite-trace.h"
+#include "lite-metrics.h"
+#include "lite-startup.h"
+#ifdef REGION_AUTO_ENABLED
+#include "utils_region.h"
+#endif
+
+/* of every network, registered by the first iotx_net_init() */
+LITE_METRIC_DEFINE_COUNTER(net_reconnects, "net.reconnect");
+LITE_METRIC_DEFINE_COUNTER(net_connect_fails, "net.connect_fail");
+
+/* the bytes a read or write moved on the transport, for the trace points of lite-trace.h */
+static int net_traced(int id, int ret)
+{
+    if (ret > 0) {
+        LITE_TRACE(id, ret);
+    }
+
+    return ret;
+}
+
+/*
+ * counts what a connect of the transport of pNetwork ended in, the connections after the first are reconnects.
+ * the first connection made ends the net connect of the startup, and the MQTT connect goes on from there.
+ */
+static int net_connected(utils_network_pt pNetwork, int ret)
+{
+    LITE_STARTUP_END(LITE_STARTUP_NET_CONNECT, 0 == ret);
+    if (0 != ret) {
+        LITE_METRIC_ADD(net_connect_fails, 1);
+        return ret;
+    }
+
+    LITE_STARTUP_BEGIN(LITE_STARTUP_MQTT_CONNECT);
+    if (0 != pNetwork->connect_count++) {
+        LITE_METRIC_ADD(net_reconnects, 1);
+    }
+
+    return ret;
+}
 
 /*** TCP connection ***/
-int read_tcp(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
+static int read_tcp(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
 {
-    return HAL_TCP_Read(pNetwork->handle, buffer, len, timeout_ms);
+    return net_traced(LITE_TRACE_NET_READ, HAL_TCP_Read(pNetwork->handle, buffer, len, timeout_ms));
 }
 
 
 static int write_tcp(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
 {
-    return HAL_TCP_Write(pNetwork->handle, buffer, len, timeout_ms);
+    return net_traced(LITE_TRACE_NET_WRITE, HAL_TCP_Write(pNetwork->handle, buffer, len, timeout_ms));
+}
+
+static int writev_tcp(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    return net_traced(LITE_TRACE_NET_WRITE, HAL_TCP_Writev(pNetwork->handle, iov, iovcnt, timeout_ms));
 }
 
 static int disconnect_tcp(utils_network_pt pNetwork)
@@ -52,14 +98,46 @@ static int connect_tcp(utils_network_pt pNetwork)
         return 1;
     }
 
+    LITE_STARTUP_BEGIN(LITE_STARTUP_NET_CONNECT);
     pNetwork->handle = HAL_TCP_Establish(pNetwork->pHostAddress, pNetwork->port);
     if (0 == pNetwork->handle) {
-        return -1;
+        return net_connected(pNetwork, -1);
     }
 
-    return 0;
+    return net_connected(pNetwork, 0);
 }
 
+#ifndef IOTX_WITHOUT_ITLS
+/* every piece still becomes its own record, but the caller need not copy them together */
+static int writev_by_piece(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    int         ret;
+    uint32_t    idx, len_sent = 0;
+    iotx_time_t timer;
+
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, timeout_ms);
+
+    for (idx = 0; idx < iovcnt; idx++) {
+        if (0 == iov[idx].len) {
+            continue;
+        }
+
+        ret = pNetwork->write(pNetwork, iov[idx].buf, iov[idx].len, iotx_time_left(&timer));
+        if (ret < 0) {
+            return (0 == len_sent) ? ret : (int)len_sent;
+        }
+
+        len_sent += ret;
+        if ((uint32_t)ret < iov[idx].len) {
+            break;
+        }
+    }
+
+    return len_sent;
+}
+#endif
+
 /*** SSL connection ***/
 #ifndef IOTX_WITHOUT_TLS
 static int read_ssl(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
@@ -69,7 +147,7 @@ static int read_ssl(utils_network_pt pNetwork, char *buffer, uint32_t len, uint3
         return -1;
     }
 
-    return HAL_SSL_Read((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
+    return net_traced(LITE_TRACE_NET_READ, HAL_SSL_Read((uintptr_t)pNetwork->handle, buffer, len, timeout_ms));
 }
 
 static int write_ssl(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
@@ -79,7 +157,17 @@ static int write_ssl(utils_network_pt pNetwork, const char *buffer, uint32_t len
         return -1;
     }
 
-    return HAL_SSL_Write((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
+    return net_traced(LITE_TRACE_NET_WRITE, HAL_SSL_Write((uintptr_t)pNetwork->handle, buffer, len, timeout_ms));
+}
+
+static int writev_ssl(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        log_err("network is null");
+        return -1;
+    }
+
+    return net_traced(LITE_TRACE_NET_WRITE, HAL_SSL_Writev((uintptr_t)pNetwork->handle, iov, iovcnt, timeout_ms));
 }
 
 static int disconnect_ssl(utils_network_pt pNetwork)
@@ -102,17 +190,18 @@ static int connect_ssl(utils_network_pt pNetwork)
         return 1;
     }
 
+    LITE_STARTUP_BEGIN(LITE_STARTUP_NET_CONNECT);
     if (0 != (pNetwork->handle = (intptr_t)HAL_SSL_Establish(
                                      pNetwork->pHostAddress,
                                      pNetwork->port,
                                      pNetwork->ca_crt,
                                      pNetwork->ca_crt_len + 1))) {
-        return 0;
+        return net_connected(pNetwork, 0);
     } else {
         /* TODO SHOLUD not remove this handle space */
         /* The space will be freed by calling disconnect_ssl() */
         /* utils_memory_free((void *)pNetwork->handle); */
-        return -1;
+        return net_connected(pNetwork, -1);
     }
 }
 #endif  /* #ifndef IOTX_WITHOUT_TLS */
@@ -126,7 +215,7 @@ static int read_itls(utils_network_pt pNetwork, char *buffer, uint32_t len, uint
         return -1;
     }
 
-    return HAL_iTLS_Read((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
+    return net_traced(LITE_TRACE_NET_READ, HAL_iTLS_Read((uintptr_t)pNetwork->handle, buffer, len, timeout_ms));
 }
 
 static int write_itls(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
@@ -136,7 +225,7 @@ static int write_itls(utils_network_pt pNetwork, const char *buffer, uint32_t le
         return -1;
     }
 
-    return HAL_iTLS_Write((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
+    return net_traced(LITE_TRACE_NET_WRITE, HAL_iTLS_Write((uintptr_t)pNetwork->handle, buffer, len, timeout_ms));
 }
 
 static int disconnect_itls(utils_network_pt pNetwork)
@@ -159,121 +248,340 @@ static int connect_itls(utils_network_pt pNetwork)
         return 1;
     }
 
+    LITE_STARTUP_BEGIN(LITE_STARTUP_NET_CONNECT);
     if (0 != (pNetwork->handle = (intptr_t)HAL_iTLS_Establish(
             pNetwork->pHostAddress,
             pNetwork->port,
             pNetwork->product_key))) {
-        return 0;
+        return net_connected(pNetwork, 0);
     } else {
         /* TODO SHOLUD not remove this handle space */
         /* The space will be freed by calling disconnect_ssl() */
         /* utils_memory_free((void *)pNetwork->handle); */
-        return -1;
+        return net_connected(pNetwork, -1);
     }
 }
 #endif  /* #ifndef IOTX_WITHOUT_iTLS */
 
-/****** network interface ******/
-int utils_net_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
-{
-    int     ret = 0;
+/*** write batching ***/
+#ifdef NET_WRITE_BATCH_ENABLED
+/*
+ * Small writes, such as the PUBLISH and PUBACK packets of MQTT, are gathered and sent by one
+ * transport write, so they share one TLS record and TCP segment. What is gathered goes out when
+ * the next write would not fit, when it has waited NET_WRITE_BATCH_LATENCY_MS, and before any
+ * read, so an answer is never waited for while its request is still held back. Reads wait in
+ * slices of the same latency, so writes of other threads also go out in time while one blocks.
+ */
+#ifndef NET_WRITE_BATCH_SIZE
+    #define NET_WRITE_BATCH_SIZE            (1024)
+#endif
 
-    if (NULL == pNetwork->ca_crt && NULL == pNetwork->product_key) {
-        ret = read_tcp(pNetwork, buffer, len, timeout_ms);
-    }
-#ifndef IOTX_WITHOUT_ITLS
-    else if (NULL == pNetwork->ca_crt && NULL != pNetwork->product_key) {
-        ret = read_itls(pNetwork, buffer, len, timeout_ms);
-    }
+#ifndef NET_WRITE_BATCH_LATENCY_MS
+    #define NET_WRITE_BATCH_LATENCY_MS      (10)
 #endif
-#ifndef IOTX_WITHOUT_TLS
-    else if (NULL != pNetwork->ca_crt && NULL == pNetwork->product_key) {
-        ret = read_ssl(pNetwork, buffer, len, timeout_ms);
+
+/* called with batch_lock held */
+static int batch_flush(utils_network_pt pNetwork)
+{
+    int         ret;
+    uint32_t    len_sent = 0;
+    iotx_time_t timer;
+
+    if (0 == pNetwork->batch_len) {
+        return 0;
     }
-#endif
-    else {
-        ret = -1;
-        log_err("no method match!");
+
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, pNetwork->batch_timeout_ms);
+
+    do {
+        ret = pNetwork->write_raw(pNetwork, pNetwork->batch_buf + len_sent, pNetwork->batch_len - len_sent,
+                                  iotx_time_left(&timer));
+        if (ret < 0) {
+            break;
+        }
+        len_sent += ret;
+    } while (len_sent < pNetwork->batch_len && !utils_time_is_expired(&timer));
+
+    /* a stream cut short can not be resumed, the connection fails as a whole */
+    if (len_sent < pNetwork->batch_len) {
+        log_err("batched write failed, %u of %u bytes sent", len_sent, pNetwork->batch_len);
+        pNetwork->batch_len = 0;
+        return -1;
     }
 
-    return ret;
+    pNetwork->batch_len = 0;
+    return 0;
 }
 
-int utils_net_write(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
+static int batch_append(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
 {
-    int     ret = 0;
+    uint32_t idx, total = 0;
+    int ret;
 
-    if (NULL == pNetwork->ca_crt && NULL == pNetwork->product_key) {
-        ret = write_tcp(pNetwork, buffer, len, timeout_ms);
+    for (idx = 0; idx < iovcnt; idx++) {
+        total += iov[idx].len;
     }
-#ifndef IOTX_WITHOUT_ITLS
-    else if (NULL == pNetwork->ca_crt && NULL != pNetwork->product_key) {
-        ret = write_itls(pNetwork, buffer, len, timeout_ms);
+
+    HAL_MutexLock(pNetwork->batch_lock);
+    if (pNetwork->batch_len + total > NET_WRITE_BATCH_SIZE && 0 != batch_flush(pNetwork)) {
+        HAL_MutexUnlock(pNetwork->batch_lock);
+        return -1;
     }
-#endif
-#ifndef IOTX_WITHOUT_TLS
-    else if (NULL != pNetwork->ca_crt && NULL == pNetwork->product_key) {
-        ret = write_ssl(pNetwork, buffer, len, timeout_ms);
+
+    /* too big to gather, it is a record of its own anyway */
+    if (total > NET_WRITE_BATCH_SIZE) {
+        ret = (1 == iovcnt) ? pNetwork->write_raw(pNetwork, iov[0].buf, iov[0].len, timeout_ms)
+              : pNetwork->writev_raw(pNetwork, iov, iovcnt, timeout_ms);
+        HAL_MutexUnlock(pNetwork->batch_lock);
+        return ret;
     }
-#endif
-    else {
+
+    if (0 == pNetwork->batch_len) {
+        pNetwork->batch_since = HAL_UptimeMs();
+        pNetwork->batch_timeout_ms = timeout_ms;
+    } else if (timeout_ms > pNetwork->batch_timeout_ms) {
+        pNetwork->batch_timeout_ms = timeout_ms;
+    }
+    for (idx = 0; idx < iovcnt; idx++) {
+        memcpy(pNetwork->batch_buf + pNetwork->batch_len, iov[idx].buf, iov[idx].len);
+        pNetwork->batch_len += iov[idx].len;
+    }
+
+    ret = (int)total;
+    if (HAL_UptimeMs() - pNetwork->batch_since >= NET_WRITE_BATCH_LATENCY_MS && 0 != batch_flush(pNetwork)) {
         ret = -1;
-        log_err("no method match!");
     }
+    HAL_MutexUnlock(pNetwork->batch_lock);
 
     return ret;
 }
 
-int iotx_net_disconnect(utils_network_pt pNetwork)
+static int write_batch(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
 {
-    int     ret = 0;
+    hal_iovec_t iov;
 
-    if (NULL == pNetwork->ca_crt && NULL == pNetwork->product_key) {
-        ret = disconnect_tcp(pNetwork);
+    if (NULL == pNetwork->batch_buf) {
+        return pNetwork->write_raw(pNetwork, buffer, len, timeout_ms);
     }
-#ifndef IOTX_WITHOUT_ITLS
-    else if (NULL == pNetwork->ca_crt && NULL != pNetwork->product_key) {
-        ret = disconnect_itls(pNetwork);
-    }
-#endif
-#ifndef IOTX_WITHOUT_TLS
-    else if (NULL != pNetwork->ca_crt && NULL == pNetwork->product_key) {
-        ret = disconnect_ssl(pNetwork);
+
+    iov.buf = buffer;
+    iov.len = len;
+    return batch_append(pNetwork, &iov, 1, timeout_ms);
+}
+
+static int writev_batch(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork->batch_buf) {
+        return pNetwork->writev_raw(pNetwork, iov, iovcnt, timeout_ms);
     }
-#endif
-    else {
-        ret = -1;
-        log_err("no method match!");
+
+    return batch_append(pNetwork, iov, iovcnt, timeout_ms);
+}
+
+static int read_batch(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    int         ret, flushed;
+    uint32_t    len_recv = 0, slice;
+    iotx_time_t timer;
+
+    if (NULL == pNetwork->batch_buf) {
+        return pNetwork->read_raw(pNetwork, buffer, len, timeout_ms);
     }
 
-    return  ret;
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, timeout_ms);
+
+    do {
+        HAL_MutexLock(pNetwork->batch_lock);
+        flushed = batch_flush(pNetwork);
+        HAL_MutexUnlock(pNetwork->batch_lock);
+        if (0 != flushed) {
+            return (0 == len_recv) ? -1 : (int)len_recv;
+        }
+
+        slice = iotx_time_left(&timer);
+        if (slice > NET_WRITE_BATCH_LATENCY_MS) {
+            slice = NET_WRITE_BATCH_LATENCY_MS;
+        }
+
+        ret = pNetwork->read_raw(pNetwork, buffer + len_recv, len - len_recv, slice);
+        if (ret < 0) {
+            return (0 == len_recv) ? ret : (int)len_recv;
+        }
+        len_recv += ret;
+    } while (len_recv < len && !utils_time_is_expired(&timer));
+
+    return len_recv;
 }
 
-int iotx_net_connect(utils_network_pt pNetwork)
+static int connect_batch(utils_network_pt pNetwork)
 {
-    int     ret = 0;
+    int ret = pNetwork->connect_raw(pNetwork);
 
-    if (NULL == pNetwork->ca_crt && NULL == pNetwork->product_key) {
-        ret = connect_tcp(pNetwork);
+    if (0 != ret) {
+        return ret;
     }
-#ifndef IOTX_WITHOUT_ITLS
-    else if (NULL == pNetwork->ca_crt && NULL != pNetwork->product_key) {
-        ret = connect_itls(pNetwork);
+
+    /* without a buffer the connection simply writes through */
+    pNetwork->batch_len = 0;
+    pNetwork->batch_lock = HAL_MutexCreate();
+    pNetwork->batch_buf = (NULL == pNetwork->batch_lock) ? NULL : HAL_Malloc(NET_WRITE_BATCH_SIZE);
+    if (NULL == pNetwork->batch_buf) {
+        log_err("no memory for write batching, writing through");
+        if (NULL != pNetwork->batch_lock) {
+            HAL_MutexDestroy(pNetwork->batch_lock);
+            pNetwork->batch_lock = NULL;
+        }
     }
-#endif
-#ifndef IOTX_WITHOUT_TLS
-    else if (NULL != pNetwork->ca_crt && NULL == pNetwork->product_key) {
-        ret = connect_ssl(pNetwork);
+
+    return 0;
+}
+
+static int disconnect_batch(utils_network_pt pNetwork)
+{
+    if (NULL != pNetwork->batch_buf) {
+        /* the last packets, e.g. an MQTT DISCONNECT, are still owed to the peer */
+        HAL_MutexLock(pNetwork->batch_lock);
+        (void)batch_flush(pNetwork);
+        HAL_MutexUnlock(pNetwork->batch_lock);
+
+        HAL_Free(pNetwork->batch_buf);
+        pNetwork->batch_buf = NULL;
+        HAL_MutexDestroy(pNetwork->batch_lock);
+        pNetwork->batch_lock = NULL;
     }
+
+    return pNetwork->disconnect_raw(pNetwork);
+}
+
+static void batch_bind(utils_network_pt pNetwork)
+{
+    pNetwork->read_raw = pNetwork->read;
+    pNetwork->write_raw = pNetwork->write;
+    pNetwork->writev_raw = pNetwork->writev;
+    pNetwork->disconnect_raw = pNetwork->disconnect;
+    pNetwork->connect_raw = pNetwork->connect;
+    pNetwork->batch_buf = NULL;
+    pNetwork->batch_len = 0;
+    pNetwork->batch_lock = NULL;
+
+    pNetwork->read = read_batch;
+    pNetwork->write = write_batch;
+    pNetwork->writev = writev_batch;
+    pNetwork->disconnect = disconnect_batch;
+    pNetwork->connect = connect_batch;
+}
+#endif  /* #ifdef NET_WRITE_BATCH_ENABLED */
+
+#ifdef NET_RECONNECT_BACKOFF_ENABLED
+/*
+ * Every connect of a network but its first waits a random time between 0 and a cap doubling
+ * from NET_RECONNECT_BACKOFF_BASE_MS per attempt up to NET_RECONNECT_BACKOFF_MAX_MS, the full
+ * jitter spreads devices dropped together, e.g. by a broker restart, over the whole interval.
+ * The cap starts over once a connection has been up for NET_RECONNECT_STABLE_MS. The wait adds
+ * to whatever schedule the caller reconnects on, HAL_Srandom() must be seeded per device.
+ */
+#ifndef NET_RECONNECT_BACKOFF_BASE_MS
+    #define NET_RECONNECT_BACKOFF_BASE_MS   (1000)
 #endif
-    else {
-        ret = -1;
-        log_err("no method match!");
+
+#ifndef NET_RECONNECT_BACKOFF_MAX_MS
+    #define NET_RECONNECT_BACKOFF_MAX_MS    (60000)
+#endif
+
+#ifndef NET_RECONNECT_STABLE_MS
+    #define NET_RECONNECT_STABLE_MS         (60000)
+#endif
+
+static int connect_backoff(utils_network_pt pNetwork)
+{
+    uint32_t cap = NET_RECONNECT_BACKOFF_MAX_MS, delay;
+    int ret;
+
+    if (pNetwork->backoff_tried) {
+        if (0 != pNetwork->backoff_up_since
+            && HAL_UptimeMs() - pNetwork->backoff_up_since >= NET_RECONNECT_STABLE_MS) {
+            pNetwork->backoff_attempt = 0;
+        }
+        if (pNetwork->backoff_attempt < 16
+            && ((uint32_t)NET_RECONNECT_BACKOFF_BASE_MS << pNetwork->backoff_attempt) < cap) {
+            cap = (uint32_t)NET_RECONNECT_BACKOFF_BASE_MS << pNetwork->backoff_attempt;
+        }
+        delay = HAL_Random(cap + 1);
+        pNetwork->backoff_attempt++;
+
+        log_info("reconnect attempt %u waits %u ms", pNetwork->backoff_attempt, delay);
+        HAL_SleepMs(delay);
     }
+    pNetwork->backoff_tried = 1;
+
+    ret = pNetwork->connect_backoff_raw(pNetwork);
+    pNetwork->backoff_up_since = (0 == ret) ? HAL_UptimeMs() : 0;
 
     return ret;
 }
 
+static void backoff_bind(utils_network_pt pNetwork)
+{
+    pNetwork->connect_backoff_raw = pNetwork->connect;
+    pNetwork->backoff_tried = 0;
+    pNetwork->backoff_attempt = 0;
+    pNetwork->backoff_up_since = 0;
+
+    pNetwork->connect = connect_backoff;
+}
+#endif  /* #ifdef NET_RECONNECT_BACKOFF_ENABLED */
+
+#ifdef REGION_AUTO_ENABLED
+/*
+ * A network whose host is the MQTT endpoint of a region connects to the one of the region in use,
+ * which moves on to the next best after too many connects in a row failed, see utils_region.h.
+ */
+static int connect_region(utils_network_pt pNetwork)
+{
+    int ret;
+
+    pNetwork->pHostAddress = utils_region_host(pNetwork->pHostAddress);
+    ret = pNetwork->connect_region_raw(pNetwork);
+    utils_region_connected(pNetwork->pHostAddress, ret);
+
+    return ret;
+}
+
+static void region_bind(utils_network_pt pNetwork)
+{
+    pNetwork->connect_region_raw = pNetwork->connect;
+    pNetwork->connect = connect_region;
+}
+#endif  /* #ifdef REGION_AUTO_ENABLED */
+
+/****** network interface ******/
+int utils_net_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    return pNetwork->read(pNetwork, buffer, len, timeout_ms);
+}
+
+int utils_net_write(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
+{
+    return pNetwork->write(pNetwork, buffer, len, timeout_ms);
+}
+
+int utils_net_writev(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    return pNetwork->writev(pNetwork, iov, iovcnt, timeout_ms);
+}
+
+int iotx_net_disconnect(utils_network_pt pNetwork)
+{
+    return pNetwork->disconnect(pNetwork);
+}
+
+int iotx_net_connect(utils_network_pt pNetwork)
+{
+    return pNetwork->connect(pNetwork);
+}
+
 int iotx_net_init(utils_network_pt pNetwork, const char *host, uint16_t port, const char *ca_crt, char *product_key)
 {
     if (!pNetwork || !host) {
@@ -296,10 +604,60 @@ int iotx_net_init(utils_network_pt pNetwork, const char *host, uint16_t port, co
     }
 
     pNetwork->handle = 0;
-    pNetwork->read = utils_net_read;
-    pNetwork->write = utils_net_write;
-    pNetwork->disconnect = iotx_net_disconnect;
-    pNetwork->connect = iotx_net_connect;
+    pNetwork->connect_count = 0;
+
+    LITE_METRIC_REGISTER(net_reconnects);
+    LITE_METRIC_REGISTER(net_connect_fails);
+
+    /* the transport never changes for a network, pick it once here instead of on every call */
+    if (NULL == pNetwork->ca_crt && NULL == pNetwork->product_key) {
+        pNetwork->read = read_tcp;
+        pNetwork->write = write_tcp;
+        pNetwork->writev = writev_tcp;
+        pNetwork->disconnect = disconnect_tcp;
+        pNetwork->connect = connect_tcp;
+    }
+#ifndef IOTX_WITHOUT_ITLS
+    else if (NULL == pNetwork->ca_crt && NULL != pNetwork->product_key) {
+        pNetwork->read = read_itls;
+        pNetwork->write = write_itls;
+        pNetwork->writev = writev_by_piece;
+        pNetwork->disconnect = disconnect_itls;
+        pNetwork->connect = connect_itls;
+    }
+#endif
+#ifndef IOTX_WITHOUT_TLS
+    else if (NULL != pNetwork->ca_crt && NULL == pNetwork->product_key) {
+        pNetwork->read = read_ssl;
+        pNetwork->write = write_ssl;
+        pNetwork->writev = writev_ssl;
+        pNetwork->disconnect = disconnect_ssl;
+        pNetwork->connect = connect_ssl;
+    }
+#endif
+    else {
+        log_err("no method match!");
+        return -1;
+    }
+
+#ifdef REGION_AUTO_ENABLED
+    /* below the backoff, a connect picks its host once the wait is over */
+    region_bind(pNetwork);
+#endif
+
+#ifdef NET_RECONNECT_BACKOFF_ENABLED
+    /* below the batching, which allocates for a connection only once it is made */
+    backoff_bind(pNetwork);
+#endif
+
+#ifdef NET_WRITE_BATCH_ENABLED
+    batch_bind(pNetwork);
+#endif
+
+#ifdef MQTT5_ENABLED
+    /* above the batching, which then gathers what is already translated */
+    iotx_mqtt5_net_bind(pNetwork);
+#endif
 
     return 0;
 }
@@ -44,6 +44,9 @@ struct utils_network {
     /**< connection handle: 0, NOT connection; NOT 0, handle of the connection */
     uintptr_t handle;
 
+    /**< Connections made since iotx_net_init(), the ones after the first are reconnects. */
+    uint32_t connect_count;
+
     /**< Read data from server function pointer. */
     int (*read)(utils_network_pt, char *, uint32_t, uint32_t);
 
@@ -55,11 +58,49 @@ struct utils_network {
 
     /**< Establish the network */
     int (*connect)(utils_network_pt);
+
+    /**< Send the pieces of data back to back without concatenating them first. */
+    int (*writev)(utils_network_pt, const hal_iovec_t *, uint32_t, uint32_t);
+
+#ifdef NET_WRITE_BATCH_ENABLED
+    /**< The transport itself, wrapped by the batching functions above. */
+    int (*read_raw)(utils_network_pt, char *, uint32_t, uint32_t);
+    int (*write_raw)(utils_network_pt, const char *, uint32_t, uint32_t);
+    int (*writev_raw)(utils_network_pt, const hal_iovec_t *, uint32_t, uint32_t);
+    int (*disconnect_raw)(utils_network_pt);
+    int (*connect_raw)(utils_network_pt);
+
+    /**< Writes waiting to go out in one transport write, allocated while connected. */
+    char *batch_buf;
+    uint32_t batch_len;
+    uint32_t batch_timeout_ms;
+    uint64_t batch_since;
+    void *batch_lock;
+#endif
+
+#ifdef REGION_AUTO_ENABLED
+    /**< The connect wrapped by the choice of the region. */
+    int (*connect_region_raw)(utils_network_pt);
+#endif
+
+#ifdef NET_RECONNECT_BACKOFF_ENABLED
+    /**< The connect wrapped by the backoff, and the attempts since the last stable connection. */
+    int (*connect_backoff_raw)(utils_network_pt);
+    uint8_t backoff_tried;
+    uint8_t backoff_attempt;
+    uint64_t backoff_up_since;
+#endif
 };
 
 
+#ifdef MQTT5_ENABLED
+/* translates the network into MQTT 5.0 if it is of the client IOT_MQTT_ConstructV5() constructs */
+void iotx_mqtt5_net_bind(utils_network_pt pNetwork);
+#endif
+
 int utils_net_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms);
 int utils_net_write(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms);
+int utils_net_writev(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms);
 int iotx_net_disconnect(utils_network_pt pNetwork);
 int iotx_net_connect(utils_network_pt pNetwork);
 int iotx_net_init(utils_network_pt pNetwork, const char *host, uint16_t port, const char *ca_crt, char *product_key);
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_epoch_time.h"
+#include "utils_region.h"
+
+#ifdef REGION_AUTO_ENABLED
+
+#define UTILS_REGION_KV_KEY         "region"
+#define UTILS_REGION_KV_VERSION     (1)
+#define UTILS_REGION_KV_LEN         (1 + 1 + UTILS_REGION_NUM + 8)
+#define UTILS_REGION_RTT_NONE       (0xFFFFFFFF)
+
+static const char *g_region_domain[UTILS_REGION_NUM] = {
+    "iot-as-mqtt.cn-shanghai.aliyuncs.com",
+    "iot-as-mqtt.ap-southeast-1.aliyuncs.com",
+    "iot-as-mqtt.ap-northeast-1.aliyuncs.com",
+    "iot-as-mqtt.us-west-1.aliyuncs.com",
+    "iot-as-mqtt.eu-central-1.aliyuncs.com"
+};
+
+/* the endpoints of the product selected for, the networks keep pointing at them */
+static char g_region_host[UTILS_REGION_NUM][HOST_ADDRESS_LEN + 1];
+static uint8_t g_region_rank[UTILS_REGION_NUM];
+static int g_region_current = -1;       /* in g_region_rank */
+static int g_region_fails = 0;          /* connects in a row to the region in use */
+static uint64_t g_region_expire = 0;    /* epoch ms the ranking is probed again at, 0 unknown */
+
+typedef struct {
+    const char     *host;
+    uint32_t        rtt;
+    void           *sem_done;
+} utils_region_probe_t;
+
+static void *_region_probe(void *arg)
+{
+    utils_region_probe_t *probe = (utils_region_probe_t *)arg;
+    uint64_t start = HAL_UptimeMs();
+    uintptr_t fd;
+
+    fd = HAL_TCP_Establish(probe->host, CONFIG_REGION_PROBE_PORT);
+    if (0 != fd) {
+        probe->rtt = (uint32_t)(HAL_UptimeMs() - start);
+        HAL_TCP_Destroy(fd);
+    }
+    if (NULL != probe->sem_done) {
+        HAL_SemaphorePost(probe->sem_done);
+    }
+
+    return NULL;
+}
+
+/* the regions by the connect time of their endpoints, the ones not answering last, the number answering */
+static int _region_rank(void)
+{
+    utils_region_probe_t probe[UTILS_REGION_NUM];
+    void *sem_done = HAL_SemaphoreCreate();
+    void *thread = NULL;
+    int i, j, started = 0, answered = 0;
+    uint8_t r;
+
+    for (i = 0; i < UTILS_REGION_NUM; i++) {
+        probe[i].host = g_region_host[i];
+        probe[i].rtt = UTILS_REGION_RTT_NONE;
+        probe[i].sem_done = sem_done;
+        if (NULL != sem_done && 0 == HAL_ThreadCreate(&thread, _region_probe, &probe[i], NULL, NULL)) {
+            HAL_ThreadDetach(thread);
+            started++;
+        } else {
+            /* one after the other when there are no threads */
+            probe[i].sem_done = NULL;
+            _region_probe(&probe[i]);
+        }
+    }
+    /* each as long as HAL_TCP_Establish() takes at most */
+    while (started-- > 0) {
+        (void)HAL_SemaphoreWait(sem_done, PLATFORM_WAIT_INFINITE);
+    }
+    if (NULL != sem_done) {
+        HAL_SemaphoreDestroy(sem_done);
+    }
+
+    for (i = 0; i < UTILS_REGION_NUM; i++) {
+        g_region_rank[i] = (uint8_t)i;
+        answered += (UTILS_REGION_RTT_NONE != probe[i].rtt);
+        log_info("region %d, connect %u ms", i, probe[i].rtt);
+    }
+    for (i = 1; i < UTILS_REGION_NUM; i++) {
+        r = g_region_rank[i];
+        for (j = i; j > 0 && probe[g_region_rank[j - 1]].rtt > probe[r].rtt; j--) {
+            g_region_rank[j] = g_region_rank[j - 1];
+        }
+        g_region_rank[j] = r;
+    }
+
+    return answered;
+}
+
+static void _region_save(void)
+{
+    uint8_t blob[UTILS_REGION_KV_LEN];
+    int i;
+
+    blob[0] = UTILS_REGION_KV_VERSION;
+    blob[1] = (uint8_t)g_region_current;
+    memcpy(blob + 2, g_region_rank, UTILS_REGION_NUM);
+    for (i = 0; i < 8; i++) {
+        blob[2 + UTILS_REGION_NUM + i] = (uint8_t)(g_region_expire >> (56 - i * 8));
+    }
+
+    if (0 != HAL_Kv_Set(UTILS_REGION_KV_KEY, blob, sizeof(blob), 0)) {
+        log_debug("save region fail");
+    }
+}
+
+/* 0 with the saved ranking when it did not expire, of an age not known it serves till a failover */
+static int _region_load(void)
+{
+    uint8_t blob[UTILS_REGION_KV_LEN];
+    uint8_t seen = 0;
+    int len = sizeof(blob), i;
+    uint64_t expire = 0, epoch = utils_epoch_time_now();
+
+    if (0 != HAL_Kv_Get(UTILS_REGION_KV_KEY, blob, &len) || sizeof(blob) != len
+        || UTILS_REGION_KV_VERSION != blob[0] || blob[1] >= UTILS_REGION_NUM) {
+        return -1;
+    }
+    for (i = 0; i < UTILS_REGION_NUM; i++) {
+        if (blob[2 + i] >= UTILS_REGION_NUM || (seen & (1 << blob[2 + i]))) {
+            return -1;
+        }
+        seen |= 1 << blob[2 + i];
+    }
+    for (i = 0; i < 8; i++) {
+        expire = (expire << 8) | blob[2 + UTILS_REGION_NUM + i];
+    }
+    if (0 != expire && 0 != epoch && expire <= epoch) {
+        return -1;
+    }
+
+    g_region_current = blob[1];
+    memcpy(g_region_rank, blob + 2, UTILS_REGION_NUM);
+    g_region_expire = expire;
+    return 0;
+}
+
+int utils_region_select(const char *product_key)
+{
+    uint64_t epoch;
+    int i;
+
+    if (NULL == product_key) {
+        return -1;
+    }
+    for (i = 0; i < UTILS_REGION_NUM; i++) {
+        HAL_Snprintf(g_region_host[i], sizeof(g_region_host[i]), "%s.%s", product_key, g_region_domain[i]);
+    }
+    g_region_fails = 0;
+
+    if (0 != _region_load()) {
+        if (0 == _region_rank()) {
+            log_err("no region answered");
+            g_region_current = -1;
+            return -1;
+        }
+        g_region_current = 0;
+        epoch = utils_epoch_time_now();
+        g_region_expire = (0 == epoch) ? 0 : epoch + CONFIG_REGION_CACHE_TTL;
+        _region_save();
+    }
+
+    log_info("region %d selected", g_region_rank[g_region_current]);
+    return g_region_rank[g_region_current];
+}
+
+const char *utils_region_host(const char *host)
+{
+    int i;
+
+    if (g_region_current < 0 || NULL == host) {
+        return host;
+    }
+    for (i = 0; i < UTILS_REGION_NUM; i++) {
+        if (host == g_region_host[i] || 0 == strcmp(host, g_region_host[i])) {
+            return g_region_host[g_region_rank[g_region_current]];
+        }
+    }
+
+    return host;
+}
+
+void utils_region_connected(const char *host, int ret)
+{
+    if (g_region_current < 0 || host != g_region_host[g_region_rank[g_region_current]]) {
+        return;
+    }
+    if (0 == ret) {
+        g_region_fails = 0;
+        return;
+    }
+    if (++g_region_fails < CONFIG_REGION_FAILOVER_FAILS) {
+        return;
+    }
+
+    /* the next best, back to the best after the last */
+    g_region_fails = 0;
+    g_region_current = (g_region_current + 1) % UTILS_REGION_NUM;
+    log_warning("region %d failed, moving to region %d", g_region_rank[(g_region_current + UTILS_REGION_NUM - 1) %
+                UTILS_REGION_NUM], g_region_rank[g_region_current]);
+    _region_save();
+}
+
+#endif  /* #ifdef REGION_AUTO_ENABLED */
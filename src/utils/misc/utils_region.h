@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _UTILS_REGION_H_
+#define _UTILS_REGION_H_
+
+#include "iot_import.h"
+
+/*
+ * The region of the cloud a device connects to, in the order of iotx_cloud_domain_types_t. The MQTT
+ * endpoint "<product key>.iot-as-mqtt.<region>.aliyuncs.com" of each is connected to in parallel,
+ * the regions are ranked by the time the TCP connect took, and the ranking is saved with HAL_Kv_Set()
+ * for CONFIG_REGION_CACHE_TTL. A network connecting to the endpoint of the region in use moves on to
+ * the next one of the ranking after CONFIG_REGION_FAILOVER_FAILS connects in a row failed.
+ */
+
+#define UTILS_REGION_NUM        (5)
+
+/* the region ranked first, probed unless the saved ranking is still good, -1 when none answered */
+int utils_region_select(const char *product_key);
+
+/* the endpoint of the region in use when host is the endpoint of one, else host */
+const char *utils_region_host(const char *host);
+
+/* a connect to host ended in ret, 0 for a connection made */
+void utils_region_connected(const char *host, int ret);
+
+#endif  /* _UTILS_REGION_H_ */
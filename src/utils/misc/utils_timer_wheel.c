@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "utils_timer_wheel.h"
+
+#define TIMER_WHEEL_MASK            (UTILS_TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_SPAN(level)     ((uint32_t)1 << (UTILS_TIMER_WHEEL_BITS * (level)))
+#define TIMER_WHEEL_INDEX(tick, level) \
+    (((tick) >> (UTILS_TIMER_WHEEL_BITS * (level))) & TIMER_WHEEL_MASK)
+
+static void _timer_link(utils_timer_t **head, utils_timer_t *timer)
+{
+    timer->next = *head;
+    if (NULL != timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+}
+
+static void _timer_unlink(utils_timer_t *timer)
+{
+    *timer->pprev = timer->next;
+    if (NULL != timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/* the finest wheel whose span holds the distance, so it is moved down no more than once per wheel */
+static void _timer_file(utils_timer_wheel_t *wheel, utils_timer_t *timer)
+{
+    uint32_t    delta = timer->expire - wheel->tick;
+    uint32_t    expire = timer->expire;
+    int         level;
+
+    /* overdue, in the slot run next */
+    if ((int32_t)delta < 0) {
+        _timer_link(&wheel->slot[0][TIMER_WHEEL_INDEX(wheel->tick, 0)], timer);
+        return;
+    }
+
+    for (level = 0; level < UTILS_TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < TIMER_WHEEL_SPAN(level + 1)) {
+            break;
+        }
+    }
+    if (level == UTILS_TIMER_WHEEL_LEVELS - 1 && delta >= TIMER_WHEEL_SPAN(UTILS_TIMER_WHEEL_LEVELS) - 1) {
+        expire = wheel->tick + TIMER_WHEEL_SPAN(UTILS_TIMER_WHEEL_LEVELS) - 1;
+    }
+
+    _timer_link(&wheel->slot[level][TIMER_WHEEL_INDEX(expire, level)], timer);
+}
+
+/* the timers of a slot of a coarser wheel, filed again as the finer wheels come round to it */
+static uint32_t _timer_cascade(utils_timer_wheel_t *wheel, int level)
+{
+    uint32_t        index = TIMER_WHEEL_INDEX(wheel->tick, level);
+    utils_timer_t  *timer;
+
+    while (NULL != (timer = wheel->slot[level][index])) {
+        _timer_unlink(timer);
+        _timer_file(wheel, timer);
+    }
+
+    return index;
+}
+
+void utils_timer_wheel_init(utils_timer_wheel_t *wheel, uint32_t tick_ms, uint64_t now_ms)
+{
+    memset(wheel, 0, sizeof(utils_timer_wheel_t));
+    wheel->tick_ms = (0 == tick_ms) ? 1 : tick_ms;
+    wheel->base_ms = now_ms;
+}
+
+void utils_timer_add(utils_timer_wheel_t *wheel, utils_timer_t *timer, uint32_t timeout_ms)
+{
+    if (NULL != timer->pprev) {
+        _timer_unlink(timer);
+        wheel->timer_num--;
+    }
+
+    timer->expire = wheel->tick + (timeout_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+    _timer_file(wheel, timer);
+    wheel->timer_num++;
+}
+
+void utils_timer_cancel(utils_timer_wheel_t *wheel, utils_timer_t *timer)
+{
+    if (NULL == timer->pprev) {
+        return;
+    }
+
+    _timer_unlink(timer);
+    wheel->timer_num--;
+}
+
+int utils_timer_is_pending(const utils_timer_t *timer)
+{
+    return NULL != timer->pprev;
+}
+
+utils_timer_t *utils_timer_wheel_take_expired(utils_timer_wheel_t *wheel, uint64_t now_ms)
+{
+    uint32_t        now_tick = (uint32_t)((now_ms - wheel->base_ms) / wheel->tick_ms);
+    utils_timer_t  *timer;
+    uint32_t        index;
+    int             level;
+
+    while (NULL == wheel->expired && (int32_t)(now_tick - wheel->tick) >= 0) {
+        /* nothing to run, idle ticks are skipped all at once */
+        if (0 == wheel->timer_num) {
+            wheel->tick = now_tick + 1;
+            break;
+        }
+
+        /* the coarser wheels move down first as the finer ones come round */
+        index = TIMER_WHEEL_INDEX(wheel->tick, 0);
+        for (level = 1; 0 == index && level < UTILS_TIMER_WHEEL_LEVELS; level++) {
+            index = _timer_cascade(wheel, level);
+        }
+
+        index = TIMER_WHEEL_INDEX(wheel->tick, 0);
+        while (NULL != (timer = wheel->slot[0][index])) {
+            _timer_unlink(timer);
+            _timer_link(&wheel->expired, timer);
+        }
+        wheel->tick++;
+    }
+
+    if (NULL == (timer = wheel->expired)) {
+        return NULL;
+    }
+    _timer_unlink(timer);
+    wheel->timer_num--;
+
+    return timer;
+}
+
+/* the tick the first timers of a wheel are due in, those of its first slot holding any, as slots run in order */
+static int _timer_first_tick(const utils_timer_wheel_t *wheel, int level, uint32_t *tick)
+{
+    uint32_t        shift = UTILS_TIMER_WHEEL_BITS * level;
+    utils_timer_t  *timer;
+    uint32_t        t;
+    uint32_t        d;
+    int             found = 0;
+
+    for (d = 0; d <= UTILS_TIMER_WHEEL_SLOTS && !found; d++) {
+        t = (0 == level) ? wheel->tick + d : (((wheel->tick >> shift) + d) << shift);
+        if ((int32_t)(t - wheel->tick) < 0) {
+            continue;
+        }
+        for (timer = wheel->slot[level][TIMER_WHEEL_INDEX(t, level)]; NULL != timer; timer = timer->next) {
+            if (!found || (int32_t)(timer->expire - *tick) < 0) {
+                *tick = timer->expire;
+                found = 1;
+            }
+        }
+    }
+
+    return found ? 0 : -1;
+}
+
+uint32_t utils_timer_wheel_next_timeout(const utils_timer_wheel_t *wheel, uint64_t now_ms)
+{
+    uint64_t    elapsed = now_ms - wheel->base_ms;
+    uint64_t    due_ms;
+    uint32_t    now_tick;
+    uint32_t    first = 0;
+    uint32_t    t = 0;
+    int         found = 0;
+    int         level;
+
+    if (0 == wheel->timer_num) {
+        return UTILS_TIMER_WHEEL_IDLE;
+    }
+    if (NULL != wheel->expired) {
+        return 0;
+    }
+
+    for (level = 0; level < UTILS_TIMER_WHEEL_LEVELS; level++) {
+        if (0 == _timer_first_tick(wheel, level, &t) && (!found || (int32_t)(t - first) < 0)) {
+            first = t;
+            found = 1;
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+
+    /* tick first runs once the uptime is in it */
+    now_tick = (uint32_t)(elapsed / wheel->tick_ms);
+    if ((int32_t)(first - now_tick) <= 0) {
+        return 0;
+    }
+    due_ms = (uint64_t)(first - now_tick) * wheel->tick_ms - elapsed % wheel->tick_ms;
+
+    return (due_ms >= UTILS_TIMER_WHEEL_IDLE) ? UTILS_TIMER_WHEEL_IDLE - 1 : (uint32_t)due_ms;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _IOTX_COMMON_TIMER_WHEEL_H_
+#define _IOTX_COMMON_TIMER_WHEEL_H_
+
+#include "iot_import.h"
+
+/*
+ * Timeouts of many outstanding requests at O(1) each to add and to cancel. A timer is filed in the
+ * slot of the tick it is due in, timers further away in coarser wheels, and are moved down as their
+ * time comes, so checking costs what expires rather than what is outstanding. The owner reads the
+ * uptime once and hands it to utils_timer_wheel_take_expired(), nothing here reads the clock.
+ * A wheel is not locked, its owner locks it as it locks the requests the timers belong to.
+ */
+
+#ifndef UTILS_TIMER_WHEEL_BITS
+#define UTILS_TIMER_WHEEL_BITS      (4)
+#endif
+#define UTILS_TIMER_WHEEL_SLOTS     (1 << UTILS_TIMER_WHEEL_BITS)
+/* the wheels cover 2^16 ticks, a timer further away waits in the top wheel and is filed again */
+#ifndef UTILS_TIMER_WHEEL_LEVELS
+#define UTILS_TIMER_WHEEL_LEVELS    (4)
+#endif
+
+/* kept in the request it times, all zero when not pending */
+typedef struct utils_timer_st {
+    struct utils_timer_st      *next;
+    struct utils_timer_st     **pprev;      /* NULL when not pending */
+    uint32_t                    expire;     /* the tick it is due in */
+} utils_timer_t;
+
+typedef struct {
+    utils_timer_t              *slot[UTILS_TIMER_WHEEL_LEVELS][UTILS_TIMER_WHEEL_SLOTS];
+    utils_timer_t              *expired;    /* due, not taken yet */
+    uint64_t                    base_ms;    /* uptime of tick 0 */
+    uint32_t                    tick_ms;
+    uint32_t                    tick;       /* the next tick to run */
+    int                         timer_num;  /* pending, the expired ones too */
+} utils_timer_wheel_t;
+
+/* the request a timer is kept in, from the timer taken out */
+#define UTILS_TIMER_ENTRY(timer, type, member) \
+    ((type *)((char *)(timer) - (size_t)&((type *)0)->member))
+
+void utils_timer_wheel_init(utils_timer_wheel_t *wheel, uint32_t tick_ms, uint64_t now_ms);
+
+/* pending again if it was, due timeout_ms after the last utils_timer_wheel_take_expired(), at most a tick later */
+void utils_timer_add(utils_timer_wheel_t *wheel, utils_timer_t *timer, uint32_t timeout_ms);
+
+/* nothing happens if it is not pending */
+void utils_timer_cancel(utils_timer_wheel_t *wheel, utils_timer_t *timer);
+
+int utils_timer_is_pending(const utils_timer_t *timer);
+
+/* one timer due by now_ms, not pending any more, NULL when there is none */
+utils_timer_t *utils_timer_wheel_take_expired(utils_timer_wheel_t *wheel, uint64_t now_ms);
+
+#define UTILS_TIMER_WHEEL_IDLE      (0xFFFFFFFF)
+
+/*
+ * ms from now_ms till utils_timer_wheel_take_expired() has a timer, 0 when it has one now, IDLE when
+ * nothing is pending. It looks at the first slot holding timers of each wheel only.
+ */
+uint32_t utils_timer_wheel_next_timeout(const utils_timer_wheel_t *wheel, uint64_t now_ms);
+
+#endif /* _IOTX_COMMON_TIMER_WHEEL_H_ */
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "json_parser.h"
+#include "utils_base64.h"
+#include "utils_epoch_time.h"
+#include "utils_token.h"
+
+#define UTILS_TOKEN_KV_VERSION      (1)
+#define UTILS_TOKEN_KV_MAXLEN       (1 + 8 + 1 + 64 + 1 + 64 + 2 + 256)
+#define UTILS_TOKEN_JWT_MAXLEN      (256)
+
+/* the epoch ms of "expire" in the payload of a JWT, 0 for a token of any other form */
+static uint64_t _token_jwt_expire(const char *token)
+{
+    char b64[UTILS_TOKEN_JWT_MAXLEN + 4];
+    uint8_t json[UTILS_TOKEN_JWT_MAXLEN];
+    const char *begin, *end;
+    char *value;
+    uint32_t len, json_len, i;
+    int value_len = 0;
+    uint64_t expire = 0;
+
+    if (NULL == (begin = strchr(token, '.')) || NULL == (end = strchr(++begin, '.'))) {
+        return 0;
+    }
+    len = end - begin;
+    if (0 == len || len > UTILS_TOKEN_JWT_MAXLEN || 1 == len % 4) {
+        return 0;
+    }
+
+    /* base64url without its padding, as utils_base64decode() takes it */
+    for (i = 0; i < len; i++) {
+        b64[i] = ('-' == begin[i]) ? '+' : ('_' == begin[i]) ? '/' : begin[i];
+    }
+    while (0 != len % 4) {
+        b64[len++] = '=';
+    }
+    if (SUCCESS_RETURN != utils_base64decode((const uint8_t *)b64, len, sizeof(json) - 1, json, &json_len)) {
+        return 0;
+    }
+    json[json_len] = '\0';
+
+    value = json_get_value_by_name((char *)json, json_len, "expire", &value_len, NULL);
+    for (i = 0; NULL != value && i < (uint32_t)value_len && value[i] >= '0' && value[i] <= '9'; i++) {
+        expire = expire * 10 + (value[i] - '0');
+    }
+
+    return expire;
+}
+
+/* a life of left ms from now, refreshed ahead by the margin, or half way when it is shorter than twice that */
+static void _token_set_life(utils_token_t *life, uint64_t now, uint64_t left)
+{
+    life->lapse_ms = now + left;
+    life->refresh_ms = now + ((left > 2 * CONFIG_AUTH_TOKEN_REFRESH) ? left - CONFIG_AUTH_TOKEN_REFRESH : left / 2);
+}
+
+void utils_token_start(utils_token_t *life, const char *token)
+{
+    uint64_t epoch = utils_epoch_time_now();
+    uint64_t left = CONFIG_AUTH_TOKEN_LIFETIME;
+
+    life->expire = _token_jwt_expire(token);
+    if (0 != life->expire && 0 != epoch) {
+        left = (life->expire > epoch) ? life->expire - epoch : 0;
+    } else if (0 == life->expire && 0 != epoch) {
+        life->expire = epoch + CONFIG_AUTH_TOKEN_LIFETIME;
+    }
+
+    _token_set_life(life, HAL_UptimeMs(), left);
+}
+
+int utils_token_due(const utils_token_t *life)
+{
+    return 0 != life->lapse_ms && HAL_UptimeMs() >= life->refresh_ms;
+}
+
+uint32_t utils_token_left(const utils_token_t *life)
+{
+    uint64_t now = HAL_UptimeMs();
+
+    if (0 == life->lapse_ms) {
+        return 0xFFFFFFFF;
+    }
+    if (now >= life->refresh_ms) {
+        return 0;
+    }
+
+    return (life->refresh_ms - now > 0xFFFFFFFE) ? 0xFFFFFFFE : (uint32_t)(life->refresh_ms - now);
+}
+
+void utils_token_retry(utils_token_t *life)
+{
+    life->refresh_ms = HAL_UptimeMs() + CONFIG_AUTH_TOKEN_RETRY;
+}
+
+static unsigned char *_token_put_str(unsigned char *p, const char *str, uint32_t len_bytes)
+{
+    uint32_t len = strlen(str);
+
+    if (2 == len_bytes) {
+        *p++ = (unsigned char)(len >> 8);
+    }
+    *p++ = (unsigned char)len;
+    memcpy(p, str, len);
+    return p + len;
+}
+
+/* the string of len_bytes length at p, NULL past end */
+static const unsigned char *_token_get_str(const unsigned char *p, const unsigned char *end, uint32_t len_bytes,
+        const unsigned char **str, uint32_t *len)
+{
+    if (end - p < (int)len_bytes) {
+        return NULL;
+    }
+    *len = (2 == len_bytes) ? ((uint32_t)p[0] << 8 | p[1]) : p[0];
+    p += len_bytes;
+    if (end - p < (int)*len) {
+        return NULL;
+    }
+    *str = p;
+    return p + *len;
+}
+
+void utils_token_save(const char *kv_key, const char *product_key, const char *device_name,
+                      const char *token, const utils_token_t *life)
+{
+    unsigned char blob[UTILS_TOKEN_KV_MAXLEN];
+    unsigned char *p = blob;
+    int i;
+
+    if (strlen(product_key) > 64 || strlen(device_name) > 64 || strlen(token) > 256) {
+        return;
+    }
+
+    *p++ = UTILS_TOKEN_KV_VERSION;
+    for (i = 7; i >= 0; i--) {
+        *p++ = (unsigned char)(life->expire >> (i * 8));
+    }
+    p = _token_put_str(p, product_key, 1);
+    p = _token_put_str(p, device_name, 1);
+    p = _token_put_str(p, token, 2);
+
+    if (0 != HAL_Kv_Set(kv_key, blob, p - blob, 0)) {
+        log_debug("save token fail");
+    }
+}
+
+int utils_token_load(const char *kv_key, const char *product_key, const char *device_name,
+                     char *token, int token_len, utils_token_t *life)
+{
+    unsigned char blob[UTILS_TOKEN_KV_MAXLEN];
+    const unsigned char *p, *end, *str;
+    int len = sizeof(blob);
+    uint32_t str_len;
+    uint64_t expire = 0, epoch;
+    int i;
+
+    if (0 != HAL_Kv_Get(kv_key, blob, &len) || len < 1 + 8 || UTILS_TOKEN_KV_VERSION != blob[0]) {
+        return -1;
+    }
+    end = blob + len;
+    for (i = 1; i <= 8; i++) {
+        expire = (expire << 8) | blob[i];
+    }
+    p = blob + 1 + 8;
+
+    if (NULL == (p = _token_get_str(p, end, 1, &str, &str_len))
+        || str_len != strlen(product_key) || 0 != memcmp(str, product_key, str_len)) {
+        return -1;
+    }
+    if (NULL == (p = _token_get_str(p, end, 1, &str, &str_len))
+        || str_len != strlen(device_name) || 0 != memcmp(str, device_name, str_len)) {
+        return -1;
+    }
+    if (NULL == (p = _token_get_str(p, end, 2, &str, &str_len)) || 0 == str_len || (int)str_len >= token_len) {
+        return -1;
+    }
+
+    epoch = utils_epoch_time_now();
+    if (0 != expire && 0 != epoch && expire <= epoch) {
+        utils_token_forget(kv_key);
+        return -1;
+    }
+
+    memcpy(token, str, str_len);
+    token[str_len] = '\0';
+    life->expire = expire;
+    if (0 != expire && 0 != epoch) {
+        _token_set_life(life, HAL_UptimeMs(), expire - epoch);
+    } else {
+        /* of an age not known, it serves till refused and is refreshed soon */
+        _token_set_life(life, HAL_UptimeMs(), CONFIG_AUTH_TOKEN_REFRESH);
+    }
+
+    return 0;
+}
+
+void utils_token_forget(const char *kv_key)
+{
+    (void)HAL_Kv_Del(kv_key);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _UTILS_TOKEN_H_
+#define _UTILS_TOKEN_H_
+
+#include "iot_import.h"
+
+/*
+ * The life of the auth token of a HTTP or CoAP channel. A token of JWT form tells when it expires, the
+ * epoch ms of "expire" in its payload, any other is taken to last CONFIG_AUTH_TOKEN_LIFETIME from the
+ * auth. It is refreshed CONFIG_AUTH_TOKEN_REFRESH before, while it still serves the messages, and
+ * saved with HAL_Kv_Set() so a restart within its life takes it up again without an auth round trip.
+ */
+
+typedef struct {
+    uint64_t    lapse_ms;       /* HAL_UptimeMs() it lapses at */
+    uint64_t    refresh_ms;     /* and is due for a refresh at */
+    uint64_t    expire;         /* epoch ms it expires at, 0 unknown */
+} utils_token_t;
+
+/* a token just handed out by an auth */
+void utils_token_start(utils_token_t *life, const char *token);
+
+/* 1 when the refresh of the token is due */
+int utils_token_due(const utils_token_t *life);
+
+/* ms till the refresh is due, 0 when it is */
+uint32_t utils_token_left(const utils_token_t *life);
+
+/* a refresh started, the next one is due CONFIG_AUTH_TOKEN_RETRY later unless it restarts the life */
+void utils_token_retry(utils_token_t *life);
+
+/* the token of the device saved under kv_key */
+void utils_token_save(const char *kv_key, const char *product_key, const char *device_name,
+                      const char *token, const utils_token_t *life);
+
+/* 0 with the saved token of the device and its life when it did not lapse, -1 when there is none */
+int utils_token_load(const char *kv_key, const char *product_key, const char *device_name,
+                     char *token, int token_len, utils_token_t *life);
+
+/* the saved token was refused */
+void utils_token_forget(const char *kv_key);
+
+#endif  /* _UTILS_TOKEN_H_ */
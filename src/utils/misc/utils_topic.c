@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "lite-log.h"
+#include "lite-utils.h"
+#include "utils_topic.h"
+
+#define TOPIC_LEVEL_LEN_MAX     (0xFFFF)
+
+static utils_topic_node_t *_topic_node_new(const char *level, uint32_t level_len)
+{
+    utils_topic_node_t *node;
+
+    node = (utils_topic_node_t *)LITE_malloc(sizeof(utils_topic_node_t) + level_len);
+    if (NULL == node) {
+        return NULL;
+    }
+    memset(node, 0, sizeof(utils_topic_node_t));
+    memcpy(node->level, level, level_len);
+    node->level[level_len] = '\0';
+    node->level_len = (uint16_t)level_len;
+
+    return node;
+}
+
+static void _topic_node_free(utils_topic_node_t *node, void (*free_value)(void *))
+{
+    uint16_t i;
+
+    if (NULL == node) {
+        return;
+    }
+
+    for (i = 0; i < node->child_num; i++) {
+        _topic_node_free(node->children[i], free_value);
+    }
+    _topic_node_free(node->plus, free_value);
+    _topic_node_free(node->hash, free_value);
+    if (NULL != node->value && NULL != free_value) {
+        free_value(node->value);
+    }
+    if (NULL != node->children) {
+        LITE_free(node->children);
+    }
+    LITE_free(node);
+}
+
+static int _topic_level_cmp(const utils_topic_node_t *node, const char *level, uint32_t level_len)
+{
+    uint32_t len = (node->level_len < level_len) ? node->level_len : level_len;
+    int rc = memcmp(node->level, level, len);
+
+    if (0 != rc) {
+        return rc;
+    }
+
+    return (int)node->level_len - (int)level_len;
+}
+
+/* index of the literal child, or where it belongs with *found set to 0 */
+static uint16_t _topic_child_search(const utils_topic_node_t *node, const char *level, uint32_t level_len, int *found)
+{
+    uint16_t low = 0, high = node->child_num;
+    int rc;
+
+    while (low < high) {
+        uint16_t mid = low + (high - low) / 2;
+
+        rc = _topic_level_cmp(node->children[mid], level, level_len);
+        if (0 == rc) {
+            *found = 1;
+            return mid;
+        }
+        if (rc < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    *found = 0;
+    return low;
+}
+
+static utils_topic_node_t *_topic_child_get(utils_topic_node_t *node, const char *level, uint32_t level_len, int create)
+{
+    utils_topic_node_t **slot = NULL, *child;
+    uint16_t idx = 0;
+    int found = 0;
+
+    if (1 == level_len && '+' == level[0]) {
+        slot = &node->plus;
+    } else if (1 == level_len && '#' == level[0]) {
+        slot = &node->hash;
+    }
+
+    if (NULL != slot) {
+        if (NULL == *slot && create) {
+            *slot = _topic_node_new(level, level_len);
+        }
+        return *slot;
+    }
+
+    idx = _topic_child_search(node, level, level_len, &found);
+    if (found) {
+        return node->children[idx];
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    if (node->child_num == node->child_size) {
+        utils_topic_node_t **children;
+        uint32_t size = (0 == node->child_size) ? 2 : (uint32_t)node->child_size * 2;
+
+        if (size > 0xFFFF) {
+            return NULL;
+        }
+        children = (utils_topic_node_t **)LITE_malloc(size * sizeof(utils_topic_node_t *));
+        if (NULL == children) {
+            return NULL;
+        }
+        if (NULL != node->children) {
+            memcpy(children, node->children, node->child_num * sizeof(utils_topic_node_t *));
+            LITE_free(node->children);
+        }
+        node->children = children;
+        node->child_size = (uint16_t)size;
+    }
+
+    child = _topic_node_new(level, level_len);
+    if (NULL == child) {
+        return NULL;
+    }
+    memmove(node->children + idx + 1, node->children + idx, (node->child_num - idx) * sizeof(utils_topic_node_t *));
+    node->children[idx] = child;
+    node->child_num++;
+
+    return child;
+}
+
+/* length of the level starting at 'p' */
+static uint32_t _topic_level_len(const char *p, const char *end)
+{
+    const char *q = p;
+
+    while (q < end && '/' != *q) {
+        q++;
+    }
+
+    return (uint32_t)(q - p);
+}
+
+static utils_topic_node_t *_topic_node_of(utils_topic_trie_t *trie, const char *filter, int create)
+{
+    const char *p = filter, *end = filter + strlen(filter);
+    utils_topic_node_t *node = trie->root;
+    uint32_t level_len;
+
+    while (NULL != node) {
+        level_len = _topic_level_len(p, end);
+        if (level_len > TOPIC_LEVEL_LEN_MAX) {
+            return NULL;
+        }
+        node = _topic_child_get(node, p, level_len, create);
+        p += level_len;
+        if (p == end) {
+            break;
+        }
+        p++;
+    }
+
+    return node;
+}
+
+/* a filter has its wildcards alone in their level, '#' only as the last one */
+static int _topic_filter_valid(const char *filter)
+{
+    const char *p;
+
+    for (p = filter; '\0' != *p; p++) {
+        if ('+' != *p && '#' != *p) {
+            continue;
+        }
+        if ((p != filter && '/' != p[-1]) || ('\0' != p[1] && '/' != p[1])) {
+            return 0;
+        }
+        if ('#' == *p && '\0' != p[1]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void utils_topic_trie_init(utils_topic_trie_t *trie)
+{
+    memset(trie, 0, sizeof(utils_topic_trie_t));
+}
+
+void utils_topic_trie_deinit(utils_topic_trie_t *trie, void (*free_value)(void *))
+{
+    _topic_node_free(trie->root, free_value);
+    memset(trie, 0, sizeof(utils_topic_trie_t));
+}
+
+int utils_topic_trie_insert(utils_topic_trie_t *trie, const char *filter, void *value)
+{
+    utils_topic_node_t *node;
+
+    if (NULL == filter || NULL == value || !_topic_filter_valid(filter)) {
+        return -1;
+    }
+
+    if (NULL == trie->root) {
+        trie->root = _topic_node_new("", 0);
+        if (NULL == trie->root) {
+            return -1;
+        }
+    }
+
+    /* levels created before running out of memory stay, empty, until the trie is freed */
+    node = _topic_node_of(trie, filter, 1);
+    if (NULL == node) {
+        log_err("no memory for topic filter %s", filter);
+        return -1;
+    }
+    if (NULL != node->value) {
+        return 1;
+    }
+
+    node->value = value;
+    trie->count++;
+
+    return 0;
+}
+
+void *utils_topic_trie_find(utils_topic_trie_t *trie, const char *filter)
+{
+    utils_topic_node_t *node;
+
+    if (NULL == filter || NULL == trie->root) {
+        return NULL;
+    }
+
+    node = _topic_node_of(trie, filter, 0);
+
+    return (NULL == node) ? NULL : node->value;
+}
+
+static int _topic_node_empty(const utils_topic_node_t *node)
+{
+    return NULL == node->value && 0 == node->child_num && NULL == node->plus && NULL == node->hash;
+}
+
+/* remove the filter below 'node', and the levels it leaves empty */
+static void *_topic_remove(utils_topic_node_t *node, const char *p, const char *end)
+{
+    utils_topic_node_t *child;
+    uint32_t level_len = _topic_level_len(p, end);
+    uint16_t idx = 0;
+    int found = 0;
+    void *value;
+
+    child = _topic_child_get(node, p, level_len, 0);
+    if (NULL == child) {
+        return NULL;
+    }
+
+    if (p + level_len == end) {
+        value = child->value;
+        child->value = NULL;
+    } else {
+        value = _topic_remove(child, p + level_len + 1, end);
+    }
+
+    if (NULL != value && _topic_node_empty(child)) {
+        if (child == node->plus) {
+            node->plus = NULL;
+        } else if (child == node->hash) {
+            node->hash = NULL;
+        } else {
+            idx = _topic_child_search(node, p, level_len, &found);
+            memmove(node->children + idx, node->children + idx + 1,
+                    (node->child_num - idx - 1) * sizeof(utils_topic_node_t *));
+            node->child_num--;
+        }
+        _topic_node_free(child, NULL);
+    }
+
+    return value;
+}
+
+void *utils_topic_trie_remove(utils_topic_trie_t *trie, const char *filter)
+{
+    void *value;
+
+    if (NULL == filter || NULL == trie->root) {
+        return NULL;
+    }
+
+    value = _topic_remove(trie->root, filter, filter + strlen(filter));
+    if (NULL != value) {
+        trie->count--;
+    }
+
+    return value;
+}
+
+typedef struct {
+    utils_topic_visit_fpt   visit;
+    void                   *ctx;
+    int                     visited;
+    int                     stop;
+} topic_match_t;
+
+static void _topic_visit(topic_match_t *match, const utils_topic_node_t *node)
+{
+    if (NULL == node || NULL == node->value || match->stop) {
+        return;
+    }
+
+    match->visited++;
+    match->stop = match->visit(node->value, match->ctx);
+}
+
+/* 'p' is the next level of the topic, NULL when all levels are matched */
+static void _topic_match(topic_match_t *match, const utils_topic_node_t *node, const char *p, const char *end,
+                         int wildcard)
+{
+    const utils_topic_node_t *child;
+    uint32_t level_len;
+    uint16_t idx;
+    int found = 0;
+
+    if (match->stop) {
+        return;
+    }
+
+    /* "a/#" matches "a" as well as everything below it */
+    if (wildcard) {
+        _topic_visit(match, node->hash);
+    }
+    if (NULL == p) {
+        _topic_visit(match, node);
+        return;
+    }
+
+    level_len = _topic_level_len(p, end);
+    if (0 != node->child_num) {
+        idx = _topic_child_search(node, p, level_len, &found);
+        if (found) {
+            child = node->children[idx];
+            _topic_match(match, child, (p + level_len == end) ? NULL : p + level_len + 1, end, 1);
+        }
+    }
+    if (wildcard && NULL != node->plus) {
+        _topic_match(match, node->plus, (p + level_len == end) ? NULL : p + level_len + 1, end, 1);
+    }
+}
+
+int utils_topic_trie_match(utils_topic_trie_t *trie, const char *topic, uint32_t topic_len,
+                           utils_topic_visit_fpt visit, void *ctx)
+{
+    topic_match_t match;
+
+    if (NULL == topic || NULL == visit || NULL == trie->root) {
+        return 0;
+    }
+
+    match.visit = visit;
+    match.ctx = ctx;
+    match.visited = 0;
+    match.stop = 0;
+
+    /* topics beginning with '$' are not matched by a leading wildcard */
+    _topic_match(&match, trie->root, topic, topic + topic_len, !(topic_len > 0 && '$' == topic[0]));
+
+    return match.visited;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _IOTX_COMMON_TOPIC_H_
+#define _IOTX_COMMON_TOPIC_H_
+
+#include "iot_import.h"
+
+/*
+ * Trie of MQTT topic filters, one node per topic level.
+ * Literal levels of a node are kept sorted, '+' and '#' have a child of their own, so a topic is
+ * matched against all filters in one walk down its levels, whatever the number of filters.
+ */
+
+typedef struct utils_topic_node utils_topic_node_t;
+
+struct utils_topic_node {
+    utils_topic_node_t    **children;       /* literal levels, sorted */
+    uint16_t                child_num;
+    uint16_t                child_size;
+    utils_topic_node_t     *plus;           /* level '+' */
+    utils_topic_node_t     *hash;           /* level '#' */
+    void                   *value;          /* of the filter ending at this level, NULL for none */
+    uint16_t                level_len;
+    char                    level[1];       /* level_len bytes, allocated with the node */
+};
+
+typedef struct {
+    utils_topic_node_t *root;
+    uint32_t            count;              /* filters in the trie */
+} utils_topic_trie_t;
+
+/* return not 0 to stop the match */
+typedef int (*utils_topic_visit_fpt)(void *value, void *ctx);
+
+void utils_topic_trie_init(utils_topic_trie_t *trie);
+
+/* free all nodes, and every value by 'free_value' when not NULL */
+void utils_topic_trie_deinit(utils_topic_trie_t *trie, void (*free_value)(void *));
+
+/* return: 0, inserted; 1, filter exists; -1, invalid filter or no memory */
+int utils_topic_trie_insert(utils_topic_trie_t *trie, const char *filter, void *value);
+
+/* value of the filter itself, not of the filters matching it */
+void *utils_topic_trie_find(utils_topic_trie_t *trie, const char *filter);
+
+/* return the value of the filter removed, NULL when it is not in the trie */
+void *utils_topic_trie_remove(utils_topic_trie_t *trie, const char *filter);
+
+/* call 'visit' with the value of each filter matching the topic, return how many were visited */
+int utils_topic_trie_match(utils_topic_trie_t *trie, const char *topic, uint32_t topic_len,
+                           utils_topic_visit_fpt visit, void *ctx);
+
+#endif /* _IOTX_COMMON_TOPIC_H_ */